@@ -0,0 +1,491 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "AssetPack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+AssetPack* AssetPack::global = nullptr;
+
+AssetPack::AssetPack()
+{
+	entries = nullptr;
+	entryCount = 0;
+	names = nullptr;
+}
+
+bool AssetPack::Open(const char* path)
+{
+	// the pack itself is never looked for in a pack
+	AssetPack* previous = global;
+	global = nullptr;
+	bool opened = file.Open(path);
+	global = previous;
+
+	if (!opened)
+		return false;
+
+	const char* data = file.GetData();
+	size_t size = file.GetSize();
+	const AssetPackHeader* header = (const AssetPackHeader*)data;
+
+	if (size < sizeof(AssetPackHeader) || header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION ||
+		header->tocOffset + (uint64_t)header->entryCount * sizeof(AssetPackEntry) > size)
+	{
+		printf("%s is not an asset pack of version %u\n", path, ASSET_PACK_VERSION);
+		file.Close();
+		return false;
+	}
+
+	entries = (const AssetPackEntry*)(data + header->tocOffset);
+	entryCount = header->entryCount;
+	this->path = path;
+
+	// the names are the rest of the file, and the
+	// last one ends with the last byte of the file
+	size_t namesStart = header->tocOffset + (size_t)entryCount * sizeof(AssetPackEntry);
+	size_t namesSize = size - namesStart;
+	names = data + namesStart;
+
+	// an entry that goes past the end was cut off
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		if (entries[i].offset + entries[i].storedSize > size || entries[i].nameOffset >= namesSize || data[size - 1] != '\0')
+		{
+			printf("%s is cut off, it is not used\n", path);
+			file.Close();
+			entries = nullptr;
+			entryCount = 0;
+			names = nullptr;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint64_t AssetPack::HashName(const char* path)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (const char* c = path; *c != '\0'; c++)
+	{
+		char ch = *c;
+
+		if (ch == '\\')
+			ch = '/';
+		if (ch >= 'A' && ch <= 'Z')
+			ch = ch - 'A' + 'a';
+
+		hash ^= (uint8_t)ch;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+bool AssetPack::SameName(const char* a, const char* b)
+{
+	for (;; a++, b++)
+	{
+		char ca = (*a == '\\') ? '/' : *a;
+		char cb = (*b == '\\') ? '/' : *b;
+
+		if (ca >= 'A' && ca <= 'Z')
+			ca = ca - 'A' + 'a';
+		if (cb >= 'A' && cb <= 'Z')
+			cb = cb - 'A' + 'a';
+
+		if (ca != cb)
+			return false;
+		if (ca == '\0')
+			return true;
+	}
+}
+
+const AssetPackEntry* AssetPack::Find(const char* path)
+{
+	uint64_t hash = HashName(path);
+	uint32_t low = 0;
+	uint32_t high = entryCount;
+
+	while (low < high)
+	{
+		uint32_t middle = (low + high) / 2;
+
+		if (entries[middle].nameHash < hash)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	// Build made sure that no two names have the same hash,
+	// so only one entry can be the one, if its name is the same
+	if (low < entryCount && entries[low].nameHash == hash && SameName(names + entries[low].nameOffset, path))
+		return &entries[low];
+
+	return nullptr;
+}
+
+const char* AssetPack::GetData(const AssetPackEntry* entry)
+{
+	return file.GetData() + entry->offset;
+}
+
+// the length of a token that is 15 or more goes on in extra
+// bytes, each one adds up to 255, until a byte that is less
+static void WriteLength(std::vector<char>* out, size_t length)
+{
+	while (length >= 255)
+	{
+		out->push_back((char)255);
+		length -= 255;
+	}
+
+	out->push_back((char)length);
+}
+
+void AssetPack::CompressBlock(const char* src, size_t size, std::vector<char>* out)
+{
+	// The last match has to start 12 bytes before the end, and the
+	// last 5 bytes are always literals, so that a decoder can copy
+	// 8 bytes at a time without reading past the end
+	const size_t hashSize = 4096;
+	std::vector<int64_t> table(hashSize, -1);
+	size_t anchor = 0;
+	size_t i = 0;
+
+	while (size >= 12 && i + 12 <= size)
+	{
+		uint32_t sequence;
+		memcpy(&sequence, src + i, 4);
+
+		uint32_t hash = (sequence * 2654435761u) >> 20;
+		int64_t candidate = table[hash];
+		table[hash] = (int64_t)i;
+
+		uint32_t found = 0;
+		if (candidate >= 0)
+			memcpy(&found, src + candidate, 4);
+
+		if (candidate < 0 || i - (size_t)candidate > 65535 || found != sequence)
+		{
+			i++;
+			continue;
+		}
+
+		size_t length = 4;
+		while (i + length < size - 5 && src[candidate + length] == src[i + length])
+			length++;
+
+		size_t literals = i - anchor;
+		size_t extra = length - 4;
+		out->push_back((char)(((literals < 15 ? literals : 15) << 4) | (extra < 15 ? extra : 15)));
+
+		if (literals >= 15)
+			WriteLength(out, literals - 15);
+
+		out->insert(out->end(), src + anchor, src + i);
+
+		uint16_t offset = (uint16_t)(i - (size_t)candidate);
+		out->push_back((char)(offset & 0xFF));
+		out->push_back((char)(offset >> 8));
+
+		if (extra >= 15)
+			WriteLength(out, extra - 15);
+
+		i += length;
+		anchor = i;
+	}
+
+	// the last sequence only has literals
+	size_t literals = size - anchor;
+	out->push_back((char)((literals < 15 ? literals : 15) << 4));
+
+	if (literals >= 15)
+		WriteLength(out, literals - 15);
+
+	out->insert(out->end(), src + anchor, src + size);
+}
+
+bool AssetPack::DecompressBlock(const char* src, size_t srcSize, char* dst, size_t dstSize)
+{
+	const uint8_t* s = (const uint8_t*)src;
+	const uint8_t* sEnd = s + srcSize;
+	char* d = dst;
+	char* dEnd = dst + dstSize;
+
+	while (s < sEnd)
+	{
+		uint8_t token = *s++;
+		size_t literals = token >> 4;
+
+		if (literals == 15)
+		{
+			uint8_t b;
+			do
+			{
+				if (s >= sEnd)
+					return false;
+				b = *s++;
+				literals += b;
+			} while (b == 255);
+		}
+
+		if (literals > (size_t)(sEnd - s) || literals > (size_t)(dEnd - d))
+			return false;
+
+		memcpy(d, s, literals);
+		d += literals;
+		s += literals;
+
+		// the last sequence has no match
+		if (s == sEnd)
+			break;
+
+		if (sEnd - s < 2)
+			return false;
+
+		size_t offset = s[0] | (s[1] << 8);
+		s += 2;
+
+		if (offset == 0 || offset > (size_t)(d - dst))
+			return false;
+
+		size_t length = token & 15;
+
+		if (length == 15)
+		{
+			uint8_t b;
+			do
+			{
+				if (s >= sEnd)
+					return false;
+				b = *s++;
+				length += b;
+			} while (b == 255);
+		}
+
+		length += 4;
+
+		if (length > (size_t)(dEnd - d))
+			return false;
+
+		// the match can overlap the bytes that it
+		// writes, so it is copied one byte at a time
+		const char* match = d - offset;
+		for (size_t i = 0; i < length; i++)
+			d[i] = match[i];
+
+		d += length;
+	}
+
+	return d == dEnd;
+}
+
+void AssetPack::Compress(const char* src, size_t size, std::vector<char>* out)
+{
+	AssetPackBlocks blocks = {};
+	blocks.blockCount = (uint32_t)((size + ASSET_PACK_BLOCK_SIZE - 1) / ASSET_PACK_BLOCK_SIZE);
+
+	// the table is written when the size of every block is known
+	size_t tableSize = sizeof(AssetPackBlocks) + blocks.blockCount * sizeof(AssetPackBlock);
+	std::vector<AssetPackBlock> table(blocks.blockCount);
+	out->assign(tableSize, 0);
+
+	for (uint32_t i = 0; i < blocks.blockCount; i++)
+	{
+		size_t offset = (size_t)i * ASSET_PACK_BLOCK_SIZE;
+		size_t blockSize = (size - offset < ASSET_PACK_BLOCK_SIZE) ? size - offset : ASSET_PACK_BLOCK_SIZE;
+
+		table[i].srcOffset = (uint32_t)out->size();
+		table[i].dstOffset = (uint32_t)offset;
+		table[i].dstSize = (uint32_t)blockSize;
+
+		CompressBlock(src + offset, blockSize, out);
+		table[i].srcSize = (uint32_t)(out->size() - table[i].srcOffset);
+	}
+
+	memcpy(out->data(), &blocks, sizeof(blocks));
+
+	if (!table.empty())
+		memcpy(out->data() + sizeof(blocks), table.data(), table.size() * sizeof(AssetPackBlock));
+}
+
+bool AssetPack::Decompress(const char* src, size_t srcSize, char* dst, size_t dstSize)
+{
+	AssetPackBlocks blocks;
+
+	if (srcSize < sizeof(blocks))
+		return false;
+
+	memcpy(&blocks, src, sizeof(blocks));
+
+	if (sizeof(blocks) + (uint64_t)blocks.blockCount * sizeof(AssetPackBlock) > srcSize)
+		return false;
+
+	size_t written = 0;
+
+	for (uint32_t i = 0; i < blocks.blockCount; i++)
+	{
+		AssetPackBlock block;
+		memcpy(&block, src + sizeof(blocks) + i * sizeof(AssetPackBlock), sizeof(block));
+
+		if ((uint64_t)block.srcOffset + block.srcSize > srcSize || (uint64_t)block.dstOffset + block.dstSize > dstSize)
+			return false;
+
+		if (!DecompressBlock(src + block.srcOffset, block.srcSize, dst + block.dstOffset, block.dstSize))
+			return false;
+
+		written += block.dstSize;
+	}
+
+	return written == dstSize;
+}
+
+bool AssetPack::DecompressHead(const char* src, size_t srcSize, std::vector<char>* out)
+{
+	AssetPackBlocks blocks;
+	AssetPackBlock block;
+
+	if (srcSize < sizeof(blocks) + sizeof(block))
+		return false;
+
+	memcpy(&blocks, src, sizeof(blocks));
+	memcpy(&block, src + sizeof(blocks), sizeof(block));
+
+	if (blocks.blockCount == 0 || (uint64_t)block.srcOffset + block.srcSize > srcSize)
+		return false;
+
+	out->resize(block.dstSize);
+	return DecompressBlock(src + block.srcOffset, block.srcSize, out->data(), block.dstSize);
+}
+
+bool AssetPack::Build(const char* packPath, const char* const* paths, uint32_t count)
+{
+	std::vector<AssetPackEntry> toc;
+	std::vector<char> pack(sizeof(AssetPackHeader), 0);
+	std::vector<char> compressed;
+	std::vector<char> names;
+	bool collided = false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint64_t nameHash = HashName(paths[i]);
+		bool skip = false;
+
+		for (const AssetPackEntry& other : toc)
+		{
+			if (other.nameHash != nameHash)
+				continue;
+
+			// the same file twice is only left out, but two
+			// files with one hash can not both be found
+			if (SameName(names.data() + other.nameOffset, paths[i]))
+			{
+				printf("%s is in the list more than once\n", paths[i]);
+			}
+			else
+			{
+				printf("%s has the same hash as %s, one of them has to be renamed\n", paths[i], names.data() + other.nameOffset);
+				collided = true;
+			}
+
+			skip = true;
+		}
+
+		if (skip)
+			continue;
+
+		char* data = nullptr;
+		int size = 0;
+		Helper::ReadFile(paths[i], &data, &size);
+
+		if (data == nullptr || size == 0)
+		{
+			printf("%s could not be read, it is not in the pack\n", paths[i]);
+			free(data);
+			continue;
+		}
+
+		AssetPackEntry entry = {};
+		entry.nameHash = nameHash;
+		entry.nameOffset = (uint32_t)names.size();
+		names.insert(names.end(), paths[i], paths[i] + strlen(paths[i]) + 1);
+
+		// every blob starts on a page
+		pack.resize((pack.size() + ASSET_PACK_ALIGN - 1) / ASSET_PACK_ALIGN * ASSET_PACK_ALIGN, 0);
+		entry.offset = pack.size();
+		entry.size = (uint64_t)size;
+
+		Compress(data, (size_t)size, &compressed);
+
+		if (compressed.size() <= (size_t)(size * (1.0 - ASSET_PACK_MIN_SAVING)))
+		{
+			entry.flags = ASSET_PACK_COMPRESSED;
+			entry.storedSize = compressed.size();
+			pack.insert(pack.end(), compressed.begin(), compressed.end());
+		}
+		else
+		{
+			entry.storedSize = (uint64_t)size;
+			pack.insert(pack.end(), data, data + size);
+		}
+
+		printf("%s: %llu bytes, %llu in the pack\n", paths[i], (unsigned long long)entry.size, (unsigned long long)entry.storedSize);
+		toc.push_back(entry);
+		free(data);
+	}
+
+	if (collided)
+	{
+		printf("%s was not written\n", packPath);
+		return false;
+	}
+
+	std::sort(toc.begin(), toc.end(), [](const AssetPackEntry& a, const AssetPackEntry& b) { return a.nameHash < b.nameHash; });
+
+	pack.resize((pack.size() + ASSET_PACK_ALIGN - 1) / ASSET_PACK_ALIGN * ASSET_PACK_ALIGN, 0);
+
+	AssetPackHeader header = {};
+	header.magic = ASSET_PACK_MAGIC;
+	header.version = ASSET_PACK_VERSION;
+	header.entryCount = (uint32_t)toc.size();
+	header.tocOffset = pack.size();
+	memcpy(pack.data(), &header, sizeof(header));
+
+	const char* tocBytes = (const char*)toc.data();
+	pack.insert(pack.end(), tocBytes, tocBytes + toc.size() * sizeof(AssetPackEntry));
+
+	// the names, which the entries point into, even when
+	// there are none there is one zero, to end the file
+	if (names.empty())
+		names.push_back('\0');
+	pack.insert(pack.end(), names.begin(), names.end());
+
+	return Helper::WriteFile(packPath, pack.data(), pack.size());
+}
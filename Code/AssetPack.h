@@ -0,0 +1,168 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <string>
+#include "Helper.h"
+
+// The pack that Main opens, if it is there, "-pack" makes it
+#define ASSET_PACK_FILE "../../../Assets/assets.pak"
+
+// "VKPK", and the version of the layout below
+#define ASSET_PACK_MAGIC 0x4B504B56
+#define ASSET_PACK_VERSION 3
+
+// Every blob starts on a page, so the view of a blob is as aligned
+// as a mapped file, and reading one blob never touches another
+#define ASSET_PACK_ALIGN 4096
+
+// the blob is compressed (see AssetPack::Compress), size is
+// the size after it is decompressed, storedSize is in the pack
+#define ASSET_PACK_COMPRESSED 1
+
+// A blob is only kept compressed if it saves at least this much of
+// its size, PNG files and block-compressed KTX2 files barely shrink,
+// and then it is faster to map them than to decompress them
+#define ASSET_PACK_MIN_SAVING 0.1
+
+// A compressed blob is cut into blocks of this size, and each one is
+// compressed by itself, so that every block can be decompressed at the
+// same time, by its own invocation of cube_decompress.comp (see
+// GpuDecompressor). No match can reach into another block
+#define ASSET_PACK_BLOCK_SIZE 65536
+
+// at the start of the pack
+struct AssetPackHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+	uint64_t tocOffset;
+};
+
+// The table of contents is at tocOffset, sorted by nameHash, so a
+// name is found with a binary search (see AssetPack::HashName). The
+// names come right after the table, each one ends with a zero, and
+// nameOffset is from the start of the names. Find compares the name
+// too, so a path that is not in the pack, but has the same hash as
+// one that is, is not given the wrong file
+struct AssetPackEntry
+{
+	uint64_t nameHash;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t storedSize;
+	uint32_t flags;
+	uint32_t nameOffset;
+};
+
+// A compressed blob starts with this, and then one AssetPackBlock
+// for each block, then the blocks. The GPU reads the blob as it is,
+// so everything in it is a uint, and the offsets of the blocks are
+// from the start of the blob
+struct AssetPackBlocks
+{
+	uint32_t blockCount;
+	uint32_t reserved[3];
+};
+
+struct AssetPackBlock
+{
+	uint32_t srcOffset;
+	uint32_t srcSize;
+	uint32_t dstOffset;
+	uint32_t dstSize;
+};
+
+// One file that has every asset in it. It is mapped once, so
+// starting the program is one open and one mapping, instead of one
+// for every asset, and reading a cold pack from the disk is one
+// sequential read, instead of a seek to every loose file.
+// MappedFile::Open looks in the global pack first, so every loader
+// (TextureLoader, KtxFile, MeshFile) reads from the pack without
+// knowing about it, and a file that is not in the pack is still
+// read from its own path
+class AssetPack
+{
+private:
+	MappedFile file;
+	std::string path;
+	const AssetPackEntry* entries;
+	uint32_t entryCount;
+	const char* names;
+
+public:
+	// The pack that MappedFile::Open looks in, or nullptr. It is one
+	// for the process, not one for each Demo (see DeviceContext.h),
+	// because it is set before the first Demo is made, and after that
+	// it is only read, so every Demo can look in it on any thread
+	static AssetPack* global;
+
+	AssetPack();
+
+	// returns false if the file is not there, or is not a pack
+	bool Open(const char* path);
+
+	// the entry of that path, or nullptr if it is not in the pack
+	const AssetPackEntry* Find(const char* path);
+
+	// the bytes of an entry, as they are stored in the pack
+	const char* GetData(const AssetPackEntry* entry);
+
+	// the path that the pack was opened from, so that
+	// AsyncFileReader can open the pack itself
+	const char* GetPath() { return path.c_str(); }
+
+	// FNV-1a of the path, in lower case, with / and \ as the same
+	// character, because Windows paths are not case sensitive
+	static uint64_t HashName(const char* path);
+
+	// if two paths are the same file, the same way as HashName
+	static bool SameName(const char* a, const char* b);
+
+	// An LZ4 block: each sequence is a token, literals that are
+	// copied, and a match of at least 4 bytes in the last 64 KB of
+	// the output. It is fast to decompress, because it is only copies.
+	// CompressBlock adds the block to the end of out
+	static void CompressBlock(const char* src, size_t size, std::vector<char>* out);
+	static bool DecompressBlock(const char* src, size_t srcSize, char* dst, size_t dstSize);
+
+	// a whole blob, in blocks of ASSET_PACK_BLOCK_SIZE (see AssetPackBlocks)
+	static void Compress(const char* src, size_t size, std::vector<char>* out);
+	static bool Decompress(const char* src, size_t srcSize, char* dst, size_t dstSize);
+
+	// only the first block of a blob, which has the header of the file
+	static bool DecompressHead(const char* src, size_t srcSize, std::vector<char>* out);
+
+	// Reads every file in paths, and writes the pack. Paths that can
+	// not be read are left out, with a message, and so is a path that
+	// was given twice. It fails if two paths have the same hash, one
+	// of them would have to be renamed
+	static bool Build(const char* packPath, const char* const* paths, uint32_t count);
+};
@@ -0,0 +1,257 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "AsyncFileReader.h"
+#include "AssetPack.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+AsyncFileReader::AsyncFileReader()
+{
+	for (uint32_t i = 0; i < ASYNC_READ_DEPTH; i++)
+	{
+#ifdef _WIN32
+		chunks[i].overlapped = new OVERLAPPED();
+#else
+		chunks[i].overlapped = nullptr;
+#endif
+		chunks[i].read = nullptr;
+		chunks[i].size = 0;
+		chunks[i].busy = false;
+	}
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	// the operating system must not write into
+	// staging memory after it is deleted
+	Cancel();
+
+	for (size_t i = 0; i < handles.size(); i++)
+	{
+#ifdef _WIN32
+		CloseHandle((HANDLE)handles[i]);
+#else
+		close((int)(intptr_t)handles[i]);
+#endif
+	}
+
+#ifdef _WIN32
+	for (uint32_t i = 0; i < ASYNC_READ_DEPTH; i++)
+		delete (OVERLAPPED*)chunks[i].overlapped;
+#endif
+}
+
+uint32_t AsyncFileReader::Open(const char* path)
+{
+	const char* openPath = path;
+	uint64_t base = 0;
+
+	if (AssetPack::global != nullptr)
+	{
+		const AssetPackEntry* entry = AssetPack::global->Find(path);
+
+		if (entry != nullptr)
+		{
+			if (entry->flags & ASSET_PACK_COMPRESSED)
+				return UINT32_MAX;
+
+			openPath = AssetPack::global->GetPath();
+			base = entry->offset;
+		}
+	}
+
+#ifdef _WIN32
+	// FILE_FLAG_OVERLAPPED is what lets ReadFile
+	// return before the bytes are there
+	HANDLE handle = CreateFile(openPath, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return UINT32_MAX;
+
+	handles.push_back(handle);
+#else
+	int fd = open(openPath, O_RDONLY);
+
+	if (fd < 0)
+		return UINT32_MAX;
+
+	handles.push_back((void*)(intptr_t)fd);
+#endif
+
+	bases.push_back(base);
+	return (uint32_t)handles.size() - 1;
+}
+
+void AsyncFileReader::Read(uint32_t file, uint64_t offset, size_t size, AsyncReadCallback callback)
+{
+	AsyncRead* read = new AsyncRead();
+	read->file = file;
+	read->offset = bases[file] + offset;
+	read->size = size;
+	read->staging.resize(size);
+	read->issued = 0;
+	read->inFlight = 0;
+	read->failed = false;
+	read->callback = callback;
+
+	reads.push_back(read);
+
+	// the first chunks start now, not at the next Poll
+	Issue();
+}
+
+void AsyncFileReader::Issue()
+{
+	// The reads go to the operating system in the order they were
+	// made, so the first texture that asked is the first one done
+	std::list<AsyncRead*>::iterator it = reads.begin();
+
+	for (uint32_t i = 0; i < ASYNC_READ_DEPTH && it != reads.end(); i++)
+	{
+		AsyncChunk& chunk = chunks[i];
+
+		if (chunk.busy)
+			continue;
+
+		while (it != reads.end() && (*it)->issued == (*it)->size)
+			it++;
+
+		if (it == reads.end())
+			break;
+
+		AsyncRead* read = *it;
+		size_t size = read->size - read->issued;
+		size = (size > ASYNC_READ_CHUNK) ? ASYNC_READ_CHUNK : size;
+
+		uint64_t offset = read->offset + read->issued;
+		char* dst = read->staging.data() + read->issued;
+
+		chunk.read = read;
+		chunk.size = size;
+		chunk.busy = true;
+		read->issued += size;
+		read->inFlight++;
+
+#ifdef _WIN32
+		OVERLAPPED* overlapped = (OVERLAPPED*)chunk.overlapped;
+		memset(overlapped, 0, sizeof(OVERLAPPED));
+		overlapped->Offset = (DWORD)(offset & 0xFFFFFFFF);
+		overlapped->OffsetHigh = (DWORD)(offset >> 32);
+
+		// It is either done already, or pending, anything else is an
+		// error, and then the chunk is done (and failed) right away
+		if (!ReadFile((HANDLE)handles[read->file], dst, (DWORD)size, NULL, overlapped) &&
+			GetLastError() != ERROR_IO_PENDING)
+		{
+			read->failed = true;
+			read->inFlight--;
+			chunk.busy = false;
+		}
+#else
+		if (pread((int)(intptr_t)handles[read->file], dst, size, (off_t)offset) != (ssize_t)size)
+			read->failed = true;
+#endif
+	}
+}
+
+bool AsyncFileReader::Finish(AsyncChunk& chunk, bool wait)
+{
+#ifdef _WIN32
+	OVERLAPPED* overlapped = (OVERLAPPED*)chunk.overlapped;
+
+	if (!wait && !HasOverlappedIoCompleted(overlapped))
+		return false;
+
+	DWORD bytes = 0;
+
+	if (!GetOverlappedResult((HANDLE)handles[chunk.read->file], overlapped, &bytes, wait ? TRUE : FALSE) ||
+		bytes != (DWORD)chunk.size)
+		chunk.read->failed = true;
+#else
+	// pread was already done in Issue, there is nothing to wait for
+	(void)wait;
+#endif
+
+	chunk.read->inFlight--;
+	chunk.read = nullptr;
+	chunk.busy = false;
+	return true;
+}
+
+void AsyncFileReader::Poll()
+{
+	for (uint32_t i = 0; i < ASYNC_READ_DEPTH; i++)
+	{
+		if (chunks[i].busy)
+			Finish(chunks[i], false);
+	}
+
+	// the chunks that are free now get the next bytes
+	// before the callbacks run, so the disk stays busy
+	Issue();
+
+	for (std::list<AsyncRead*>::iterator it = reads.begin(); it != reads.end(); )
+	{
+		AsyncRead* read = *it;
+
+		if (read->issued != read->size || read->inFlight != 0)
+		{
+			it++;
+			continue;
+		}
+
+		if (read->failed)
+			printf("An asynchronous read of %llu bytes failed\n", (unsigned long long)read->size);
+
+		// the callback can call Read, so the read is
+		// out of the list before the callback runs
+		it = reads.erase(it);
+		read->callback(read->staging.data(), read->size, !read->failed);
+		delete read;
+	}
+}
+
+void AsyncFileReader::Cancel()
+{
+	for (uint32_t i = 0; i < ASYNC_READ_DEPTH; i++)
+	{
+		if (chunks[i].busy)
+			Finish(chunks[i], true);
+	}
+
+	for (std::list<AsyncRead*>::iterator it = reads.begin(); it != reads.end(); it++)
+		delete *it;
+
+	reads.clear();
+}
@@ -0,0 +1,119 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <list>
+#include <functional>
+
+// Every read is split into chunks of this size, and this many
+// chunks are given to the operating system at the same time. An
+// NVMe drive is only fast when it has many reads to do at once,
+// one read at a time waits for the whole trip to the drive every time
+#define ASYNC_READ_CHUNK (256 * 1024)
+#define ASYNC_READ_DEPTH 32
+
+// Called by Poll when all of the bytes are read. The data is in the
+// staging memory of the reader, it is freed when the callback returns,
+// so the callback copies it (into the staging ring of the Uploader,
+// for example). ok is false if any chunk could not be read
+typedef std::function<void(const char* data, size_t size, bool ok)> AsyncReadCallback;
+
+// one Read, until its callback is called
+struct AsyncRead
+{
+	uint32_t file;
+	uint64_t offset;
+	size_t size;
+
+	// the staging memory that the chunks are read into
+	std::vector<char> staging;
+
+	// how many bytes were given to the operating system,
+	// and how many chunks are still being read
+	size_t issued;
+	uint32_t inFlight;
+	bool failed;
+
+	AsyncReadCallback callback;
+};
+
+// one chunk that the operating system is reading
+struct AsyncChunk
+{
+	// an OVERLAPPED on Windows, which has to stay
+	// in the same place until the read is done
+	void* overlapped;
+	AsyncRead* read;
+	size_t size;
+	bool busy;
+};
+
+// Reads parts of files without waiting for them, so the thread that
+// draws the frames never waits for the disk. Streaming used to read the
+// levels of the mapped KtxFile, which stops the thread on every page
+// that is not in memory yet, one page at a time.
+// On Windows, the files are opened for overlapped I/O, and Poll checks
+// which chunks are done. Elsewhere, the chunks are read with pread when
+// they are issued (io_uring would need liburing, which is not here)
+class AsyncFileReader
+{
+private:
+	// the open files, and where each one starts in them, because
+	// a file in the asset pack is a part of the pack
+	std::vector<void*> handles;
+	std::vector<uint64_t> bases;
+
+	std::list<AsyncRead*> reads;
+	AsyncChunk chunks[ASYNC_READ_DEPTH];
+
+	void Issue();
+	bool Finish(AsyncChunk& chunk, bool wait);
+
+public:
+	AsyncFileReader();
+	~AsyncFileReader();
+
+	// Returns the index of the file, or UINT32_MAX if it can not be read.
+	// A file in the asset pack is read from the pack, unless it is
+	// compressed there, then it can only be read through MappedFile
+	uint32_t Open(const char* path);
+
+	// reads size bytes from offset of the file, the callback is called by Poll
+	void Read(uint32_t file, uint64_t offset, size_t size, AsyncReadCallback callback);
+
+	// Gives more chunks to the operating system, and calls the callbacks
+	// of the reads that are done, on this thread. Called once per frame
+	void Poll();
+
+	// waits for the chunks that are being read, and drops
+	// every read without calling its callback
+	void Cancel();
+
+	// how many reads have not called their callback yet
+	uint32_t GetPending() { return (uint32_t)reads.size(); }
+};
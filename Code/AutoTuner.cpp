@@ -0,0 +1,269 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "AutoTuner.h"
+#include "Helper.h"
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+AutoTuner::AutoTuner(VkPhysicalDeviceProperties properties, const char* results)
+{
+	resultFile = results;
+	vendorID = properties.vendorID;
+	deviceID = properties.deviceID;
+	driverVersion = properties.driverVersion;
+	targetMs = 1000.0 / 60.0;
+}
+
+bool AutoTuner::Load(TunedSettings* settings)
+{
+	FILE* file = fopen(AUTO_TUNE_FILE, "r");
+
+	if (file == nullptr)
+		return false;
+
+	char line[256];
+	bool found = false;
+
+	while (!found && fgets(line, sizeof(line), file) != nullptr)
+	{
+		uint32_t vendor, device, driver, present;
+		TunedSettings s;
+
+		if (sscanf(line, "%x %x %u %u %f %u %u %u", &vendor, &device, &driver,
+			&s.msaaSamples, &s.renderScale, &s.frameLag, &present, &s.culling) != 8)
+			continue;
+
+		if (vendor == vendorID && device == deviceID && driver == driverVersion)
+		{
+			s.presentMode = (VkPresentModeKHR)present;
+			*settings = s;
+			found = true;
+		}
+	}
+
+	fclose(file);
+	return found;
+}
+
+void AutoTuner::Save(const TunedSettings& settings)
+{
+	// every line of other GPUs is kept, and the line
+	// of this one (from an older tuning) is replaced
+	std::vector<char> kept;
+	FILE* file = fopen(AUTO_TUNE_FILE, "r");
+
+	if (file != nullptr)
+	{
+		char line[256];
+
+		while (fgets(line, sizeof(line), file) != nullptr)
+		{
+			uint32_t vendor, device, driver;
+
+			if (sscanf(line, "%x %x %u", &vendor, &device, &driver) == 3 &&
+				vendor == vendorID && device == deviceID && driver == driverVersion)
+				continue;
+
+			kept.insert(kept.end(), line, line + strlen(line));
+		}
+
+		fclose(file);
+	}
+
+	file = fopen(AUTO_TUNE_FILE, "w");
+
+	if (file == nullptr)
+	{
+		printf("Could not write %s\n", AUTO_TUNE_FILE);
+		return;
+	}
+
+	fwrite(kept.data(), 1, kept.size(), file);
+	fprintf(file, "%x %x %u %u %.2f %u %u %u\n", vendorID, deviceID, driverVersion,
+		settings.msaaSamples, settings.renderScale, settings.frameLag,
+		(uint32_t)settings.presentMode, settings.culling);
+	fclose(file);
+}
+
+bool AutoTuner::ParseCandidate(const char* cmdLine, TunedSettings* settings)
+{
+	const char* arg = strstr(cmdLine, "-candidate ");
+
+	if (arg == nullptr)
+		return false;
+
+	uint32_t present;
+	TunedSettings s;
+
+	if (sscanf(arg + strlen("-candidate "), "%u %f %u %u %u",
+		&s.msaaSamples, &s.renderScale, &s.frameLag, &present, &s.culling) != 5)
+		return false;
+
+	s.presentMode = (VkPresentModeKHR)present;
+	*settings = s;
+	return true;
+}
+
+TuneResult AutoTuner::Run(const TunedSettings& settings)
+{
+	TuneResult result = {};
+
+	// The same program, in benchmark mode. It finds the same GPU
+	// (VKCUBE_GPU is inherited with the rest of the environment)
+	char path[MAX_PATH];
+	GetModuleFileNameA(NULL, path, MAX_PATH);
+
+	char cmdLine[MAX_PATH + 128];
+	snprintf(cmdLine, sizeof(cmdLine), "\"%s\" -benchmark %u -novalidate -candidate %u %.2f %u %u %u",
+		path, AUTO_TUNE_FRAMES, settings.msaaSamples, settings.renderScale,
+		settings.frameLag, (uint32_t)settings.presentMode, settings.culling);
+
+	STARTUPINFOA startup = {};
+	startup.cb = sizeof(startup);
+	PROCESS_INFORMATION process = {};
+
+	remove(resultFile);
+
+	if (!CreateProcessA(NULL, cmdLine, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &process))
+	{
+		printf("Could not run a candidate of the tuner\n");
+		return result;
+	}
+
+	WaitForSingleObject(process.hProcess, INFINITE);
+	CloseHandle(process.hThread);
+	CloseHandle(process.hProcess);
+
+	// The exit code only says if there was a regression against
+	// the baseline, which does not matter here, the file has everything
+	char* text = nullptr;
+	int size = 0;
+	Helper::ReadFile(resultFile, &text, &size);
+
+	if (text == nullptr)
+		return result;
+
+	const char* keys[] = { "\"frameMs\":", "\"gpuMs\":", "\"cpuMs\":" };
+	double* values[] = { &result.frameMs, &result.gpuMs, &result.cpuMs };
+	result.valid = true;
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const char* found = strstr(text, keys[i]);
+
+		if (found == nullptr || sscanf(found + strlen(keys[i]), "%lf", values[i]) != 1)
+			result.valid = false;
+	}
+
+	free(text);
+
+	printf("Candidate: MSAA %u, scale %.2f, %u frames in flight, present mode %u, culling %u: %.3f ms\n",
+		settings.msaaSamples, settings.renderScale, settings.frameLag,
+		(uint32_t)settings.presentMode, settings.culling, result.frameMs);
+
+	return result;
+}
+
+void AutoTuner::Tune(TunedSettings* settings)
+{
+	printf("Tuning the settings for this GPU, this takes a little while\n");
+
+	// The speed knobs are tuned at the lowest quality, so that the
+	// GPU is not the only thing that the frame time shows
+	TunedSettings best = *settings;
+	best.msaaSamples = 1;
+	best.renderScale = renderScales.empty() ? best.renderScale : renderScales.back();
+
+	TuneResult bestResult = Run(best);
+
+	// One knob at a time, every other knob stays at the best so far.
+	// The first value of each list has priority, so a later value has
+	// to be faster by more than AUTO_TUNE_MARGIN to replace it
+	for (uint32_t knob = 0; knob < 3; knob++)
+	{
+		uint32_t count = (uint32_t)(knob == 0 ? cullingPaths.size() : knob == 1 ? frameLags.size() : presentModes.size());
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			TunedSettings candidate = best;
+
+			if (knob == 0)
+				candidate.culling = cullingPaths[i];
+			else if (knob == 1)
+				candidate.frameLag = frameLags[i];
+			else
+				candidate.presentMode = presentModes[i];
+
+			if (memcmp(&candidate, &best, sizeof(candidate)) == 0)
+				continue;
+
+			TuneResult result = Run(candidate);
+
+			if (!result.valid)
+				continue;
+
+			if (!bestResult.valid || result.frameMs * (100.0 + AUTO_TUNE_MARGIN) / 100.0 < bestResult.frameMs)
+			{
+				best = candidate;
+				bestResult = result;
+			}
+		}
+	}
+
+	// From the best quality down, the first one that fits. The
+	// frame time could be limited by the present mode (FIFO waits
+	// for the monitor), so the work of the GPU and the CPU is
+	// what has to fit, not the time between frames
+	TunedSettings quality = best;
+	bool fits = false;
+
+	for (uint32_t m = 0; m < msaaLevels.size() && !fits; m++)
+	{
+		for (uint32_t r = 0; r < renderScales.size() && !fits; r++)
+		{
+			// a lower render scale only comes after MSAA is off
+			if (m + 1 < msaaLevels.size() && r > 0)
+				break;
+
+			TunedSettings candidate = best;
+			candidate.msaaSamples = msaaLevels[m];
+			candidate.renderScale = renderScales[r];
+
+			TuneResult result = Run(candidate);
+			quality = candidate;
+
+			if (result.valid && result.gpuMs <= targetMs && result.cpuMs <= targetMs)
+				fits = true;
+		}
+	}
+
+	if (!fits)
+		printf("Even the lowest quality does not fit into %.2f ms\n", targetMs);
+
+	*settings = quality;
+}
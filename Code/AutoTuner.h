@@ -0,0 +1,116 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <stdint.h>
+#include <vector>
+
+// the settings that were picked for each GPU are kept here,
+// one line for each GPU and driver version
+#define AUTO_TUNE_FILE "autotune.txt"
+
+// how many frames each candidate is benchmarked for
+#define AUTO_TUNE_FRAMES 240
+
+// Two candidates that are closer than this (in percent) are the
+// same, then the one that was tried first is kept, which is the
+// one with lower latency (fewer frames in flight, and so on)
+#define AUTO_TUNE_MARGIN 2.0
+
+// which of the culling paths the cubes go through
+enum TuneCulling
+{
+	TUNE_CULLING_NONE,
+	TUNE_CULLING_CPU,
+	TUNE_CULLING_GPU
+};
+
+// Everything that the tuner picks. Demo::apply_tuned_settings
+// puts them into the demo, before anything uses them
+struct TunedSettings
+{
+	uint32_t msaaSamples;
+	float renderScale;
+	uint32_t frameLag;
+	VkPresentModeKHR presentMode;
+	uint32_t culling;
+};
+
+// The results of one benchmark, see BENCHMARK_FILE
+struct TuneResult
+{
+	bool valid;
+	double frameMs;
+	double gpuMs;
+	double cpuMs;
+};
+
+// The first time that the demo runs on a GPU (or on a new driver), the
+// tuner runs the demo again, in benchmark mode, once for each candidate,
+// with "-candidate" on its command line, and reads the results of each
+// run. The knobs that only change the speed (culling, frames in flight,
+// and the present mode) are tuned one at a time, for the lowest frame
+// time. The knobs that trade quality for speed (MSAA and the render scale)
+// are lowered, one step at a time, from the best quality, until the frame
+// fits into targetMs. What it picks is saved in AUTO_TUNE_FILE, so every
+// run after that on the same GPU and driver starts with those settings
+class AutoTuner
+{
+private:
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+
+	// where the benchmark writes its results (BENCHMARK_FILE)
+	const char* resultFile;
+
+	TuneResult Run(const TunedSettings& settings);
+
+public:
+	// the knobs that this configuration of the demo can change,
+	// each list starts with the setting that has priority
+	std::vector<uint32_t> cullingPaths;
+	std::vector<uint32_t> frameLags;
+	std::vector<VkPresentModeKHR> presentModes;
+	std::vector<uint32_t> msaaLevels;
+	std::vector<float> renderScales;
+
+	// the frame time that the quality knobs have to fit into
+	double targetMs;
+
+	AutoTuner(VkPhysicalDeviceProperties properties, const char* results);
+
+	// true if this GPU and driver were already tuned
+	bool Load(TunedSettings* settings);
+	void Save(const TunedSettings& settings);
+
+	// starts at settings, and changes them to the best ones
+	void Tune(TunedSettings* settings);
+
+	// reads the settings that "-candidate" gave to a child process
+	static bool ParseCandidate(const char* cmdLine, TunedSettings* settings);
+};
@@ -24,34 +24,47 @@ that utilizes Vulkan, see more at http://cemu.info
 
 #include "BufferCPU.h"
 #include "Helper.h"
+#include "HostAllocator.h"
+
+BufferCPU::BufferCPU()
+{
+	device = VK_NULL_HANDLE;
+	allocator = nullptr;
+	buffer = VK_NULL_HANDLE;
+	memory = {};
+	mapped = nullptr;
+	deviceLocal = false;
+}
 
 // When we create a CPU buffer, we need the Device (lets us give commands to GPU),
 // Even though this is a CPU buffer, we still need information from the GPU
-// we need the Memory Properties from the PhysicalDevice (same GPU, but the properties of teh GPU),
-// and we need the BufferCreateInfo, to tell us what type of buffer this is (uniform, vertex, index, etc)
-BufferCPU::BufferCPU(VkDevice d, VkPhysicalDeviceMemoryProperties memory_properties, VkBufferCreateInfo info)
+// we need the MemoryAllocator, which hands out pieces of large memory blocks,
+// and we need the BufferCreateInfo, to tell us what type of buffer this is (uniform, vertex, index, etc).
+// If persistent is true, the buffer is mapped once, right here, and it stays mapped
+// until the buffer is deleted, which is good for buffers that change every frame
+BufferCPU::BufferCPU(VkDevice d, MemoryAllocator* a, VkBufferCreateInfo info, bool persistent, bool preferDeviceLocal, bool preferCached)
 {
 	// save device, so that
 	// we can use it to store
 	// data, and delete data
 	device = d;
 
+	// save the allocator, so that we can
+	// give our memory back when we are deleted
+	allocator = a;
+
 	// create buffer with the device,
 	// and the VkBufferCreateInfo
-	vkCreateBuffer(device, &info, NULL, &buffer);
+	vkCreateBuffer(device, &info, HostAllocator::callbacks, &buffer);
+
+	// every buffer gets a name, SetName can give it a better one
+	DEBUG_NAME(device, VK_OBJECT_TYPE_BUFFER, buffer, "BufferCPU");
 
 	// get memory requirements, so that we know
 	// what we need in order to allocate the memory
 	VkMemoryRequirements mem_reqs;
 	vkGetBufferMemoryRequirements(device, buffer, &mem_reqs);
 
-	// create allocation information
-	// this uses the memory requirements
-	// to tell the device how to allocate the buffer
-	VkMemoryAllocateInfo memAllocInfo = {};
-	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAllocInfo.allocationSize = mem_reqs.size;
-
 	// There are only a few different combinations of 
 	// memory properties that Vulkan supports. The
 	// combination we want to use here is
@@ -64,59 +77,199 @@ BufferCPU::BufferCPU(VkDevice d, VkPhysicalDeviceMemoryProperties memory_propert
 	// HOST_VISIBLE says we are in CPU's RAM
 	// HOST_COHERENT says we can use vkMapMemory
 
-	// This function writes to the memoryTypeIndex variable
-	// that is inside our VkMemoryAllocationInfo.
+	// Rather than calling vkAllocateMemory for every buffer,
+	// we ask the allocator for a piece of one of its blocks.
+	// The allocator finds the right memoryTypeIndex for us,
+	// and it makes sure our offset has the right alignment.
+	// Buffers are "linear" resources, which the allocator needs
+	// to know so that buffers and images do not overlap badly
+	deviceLocal = false;
 
-	// memory_properties is a structure of VkPhysicalDeviceMemoryProperties
-	// which holds arrays of memory types (VkMemoryType), and arrays of memory heaps (VkMemoryHeaps)
-	// memoryTypeIndex is an index identifying a memory type from the memoryTypes array
-	Helper::memory_type_from_properties(
-		memory_properties,
-		mem_reqs.memoryTypeBits,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&memAllocInfo.memoryTypeIndex);
+	// Some GPUs let the CPU write into part of VRAM (the "BAR"), and
+	// with resizable BAR, into all of it. A buffer that the GPU reads
+	// every frame, like the uniform buffer, is faster to read there,
+	// than from the CPU's RAM over PCIe. The CPU writes go over PCIe
+	// instead, so it is only good for buffers that the CPU writes once
+	// per frame, and never reads. If the BAR is full, we use CPU RAM
+	if (preferDeviceLocal)
+	{
+		deviceLocal = allocator->AllocateBuffer(
+			buffer,
+			mem_reqs,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&memory);
+	}
+
+	// HOST_COHERENT memory is often uncached on the CPU, so every
+	// write goes straight over the bus, and reading it is very slow.
+	// HOST_CACHED memory goes through the CPU's caches like normal
+	// memory, which is a lot faster to read, and faster to write in
+	// big pieces, but it might not be coherent. Then the GPU only sees
+	// what we wrote after Flush, and we only see what the GPU wrote
+	// after Invalidate, see MemoryAllocator::Flush
+	bool allocated = deviceLocal;
 
-	// allocate memory
-	// our memoryAllocationInfo got the required size
-	// from the VkMemoryRequirements, and it got
-	// the type of memory from memory_type_from_properties
-	vkAllocateMemory(device, &memAllocInfo, NULL, &memory);
+	if (!allocated && preferCached)
+	{
+		allocated = allocator->AllocateBuffer(
+			buffer,
+			mem_reqs,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+			&memory);
+	}
+
+	if (!allocated && !allocator->AllocateBuffer(
+		buffer,
+		mem_reqs,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&memory))
+	{
+		ERR_EXIT("Failed to allocate memory for BufferCPU\n", "Memory Allocation Failure");
+	}
 
 	// After our memory is allocated, we have
 	// to bind the buffer to the memory, so that
-	// we can use the memory
-	vkBindBufferMemory(device, buffer, memory, 0);
+	// we can use the memory. Our buffer starts at
+	// the offset that the allocator gave us
+	vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
+
+	// Mapping and unmapping can be a trip into the driver's kernel
+	// code on some systems. If this buffer is going to be written
+	// every frame, we map it one time now, and keep the pointer
+	mapped = nullptr;
+	if (persistent)
+		mapped = (uint8_t*)allocator->Map(&memory);
+}
+
+BufferCPU::BufferCPU(BufferCPU&& other)
+{
+	Take(other);
+}
+
+BufferCPU& BufferCPU::operator=(BufferCPU&& other)
+{
+	// whatever this buffer had before is destroyed first
+	if (this != &other)
+	{
+		Destroy();
+		Take(other);
+	}
+
+	return *this;
+}
+
+void BufferCPU::Take(BufferCPU& other)
+{
+	device = other.device;
+	allocator = other.allocator;
+	buffer = other.buffer;
+	memory = other.memory;
+	mapped = other.mapped;
+	deviceLocal = other.deviceLocal;
+
+	// the other one is empty now, so
+	// its destructor does nothing
+	other.buffer = VK_NULL_HANDLE;
+	other.memory = {};
+	other.mapped = nullptr;
 }
 
 BufferCPU::~BufferCPU()
 {
+	Destroy();
+}
+
+void BufferCPU::Destroy()
+{
+	// an empty (or moved) buffer has nothing to destroy
+	if (buffer == VK_NULL_HANDLE)
+		return;
+
 	// when we want to delete this CPU memory
 	// we delete the buffer, which is what we
 	// used to access the memory
-	vkDestroyBuffer(device, buffer, NULL);
+	vkDestroyBuffer(device, buffer, HostAllocator::callbacks);
+
+	// if we mapped the memory when the buffer was created,
+	// then we let the allocator know that we are done with it
+	if (mapped != nullptr)
+		allocator->Unmap(&memory);
 
 	// after deleting the buffer, there is no
-	// way to access the memory, so we delete
-	// the memory
-	vkFreeMemory(device, memory, NULL);
+	// way to access the memory, so we give
+	// the memory back to the allocator
+	allocator->Free(&memory);
+
+	buffer = VK_NULL_HANDLE;
+	memory = {};
+	mapped = nullptr;
+}
+
+void BufferCPU::SetName(const char* name)
+{
+	DEBUG_NAME(device, VK_OBJECT_TYPE_BUFFER, buffer, name);
 }
 
 void BufferCPU::Store(void* d, int size)
 {
+	// store the data at the very beginning of the buffer
+	Store(d, size, 0);
+}
+
+void BufferCPU::Store(void* d, int size, VkDeviceSize offset)
+{
+	// If the buffer is already mapped, then we
+	// only need to copy the data, and flush it (if the
+	// memory is not coherent), with no map or unmap at all
+	if (mapped != nullptr)
+	{
+		memcpy(mapped + offset, d, size);
+		Flush(offset, size);
+		return;
+	}
+
 	// create a pointer that does not go anywhere
 	uint8_t *pData = nullptr;
 
 	// Basically, this gives us a pointer to where
-	// the buffer's memory is stored in RAM. 
-	vkMapMemory(device, memory, 0, size, 0, (void **)&pData);
+	// the buffer's memory is stored in RAM. The allocator
+	// maps the whole block that our buffer lives in, because
+	// other buffers may be sharing the same VkDeviceMemory
+	pData = (uint8_t*)allocator->Map(&memory);
 
 	// pData now points to the location in RAM
 	// where the buffer's memory is,
 	// so we use memcpy to transfer data into
-	// the buffer's memory
-	memcpy(pData, d, size);
+	// the buffer's memory, starting at the offset
+	// that we were given
+	memcpy(pData + offset, d, size);
+	Flush(offset, size);
 	
 	// we unmap the memory, because we don't need
 	// to write to it, so we leave it alone
-	vkUnmapMemory(device, memory);
+	allocator->Unmap(&memory);
+}
+
+void* BufferCPU::GetPointer()
+{
+	// This lets the caller write directly into the buffer,
+	// without copying into a temporary structure first.
+	// It only works if the buffer is persistently mapped
+	return mapped;
+}
+
+void BufferCPU::Flush(VkDeviceSize offset, VkDeviceSize size)
+{
+	// After writing through GetPointer(), call this
+	// so that the GPU can see the bytes that changed.
+	// If the memory is HOST_COHERENT, this does nothing
+	allocator->Flush(&memory, offset, size);
+}
+
+void BufferCPU::Invalidate(VkDeviceSize offset, VkDeviceSize size)
+{
+	// Before reading what the GPU wrote, call this, so that
+	// the CPU's caches do not give us old bytes. If the
+	// memory is HOST_COHERENT, this does nothing
+	allocator->Invalidate(&memory, offset, size);
 }
@@ -25,22 +25,68 @@ that utilizes Vulkan, see more at http://cemu.info
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vulkan/vk_sdk_platform.h>
+#include "MemoryAllocator.h"
+#include "DebugUtils.h"
 
 class BufferCPU
 {
 private:
-	VkDeviceMemory memory;
+	MemoryAllocation memory;
+	MemoryAllocator* allocator;
 	VkDevice device;
 
+	// if the buffer is persistently mapped, this
+	// points to the buffer's memory for the whole
+	// lifetime of the buffer, otherwise it is nullptr
+	uint8_t* mapped;
+
+	// takes everything from other, which is left empty
+	void Take(BufferCPU& other);
+
 public:
 	VkBuffer buffer;
 
+	// true if the buffer ended up in VRAM that the CPU can write
+	bool deviceLocal;
+
+	// an empty buffer, which has no VkBuffer and no memory,
+	// so that a BufferCPU can be a member before it is made
+	BufferCPU();
+
+	// With preferDeviceLocal, the buffer goes into memory that is
+	// DEVICE_LOCAL and HOST_VISIBLE, if there is room, so the GPU
+	// reads it from VRAM, and nothing has to copy it there.
+	// With preferCached, it goes into HOST_CACHED memory, which might
+	// not be coherent, then whoever writes through GetPointer has
+	// to call Flush, and whoever reads has to call Invalidate first
 	BufferCPU(
 		VkDevice d, 
-		VkPhysicalDeviceMemoryProperties memory_properties, 
-		VkBufferCreateInfo info);
+		MemoryAllocator* a, 
+		VkBufferCreateInfo info,
+		bool persistent = false,
+		bool preferDeviceLocal = false,
+		bool preferCached = false);
+
+	// Only moved, never copied, like BufferGPU. The mapped
+	// pointer moves with it, so GetPointer still works
+	BufferCPU(const BufferCPU&) = delete;
+	BufferCPU& operator=(const BufferCPU&) = delete;
+	BufferCPU(BufferCPU&& other);
+	BufferCPU& operator=(BufferCPU&& other);
 
 	~BufferCPU();
 
+	// destroys the buffer now, and leaves it empty,
+	// no frame on the GPU can still be using it
+	void Destroy();
+
+	// the name that debuggers show for the buffer (debug builds only)
+	void SetName(const char* name);
+
 	void Store(void* d, int size);
+	void Store(void* d, int size, VkDeviceSize offset);
+
+	void* GetPointer();
+	void Flush(VkDeviceSize offset, VkDeviceSize size);
+	void Invalidate(VkDeviceSize offset, VkDeviceSize size);
 };
@@ -24,34 +24,54 @@ that utilizes Vulkan, see more at http://cemu.info
 
 #include "BufferGPU.h"
 #include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+
+BufferGPU::BufferGPU()
+{
+	device = VK_NULL_HANDLE;
+	allocator = nullptr;
+	concurrent = false;
+	buffer = VK_NULL_HANDLE;
+	memory = {};
+}
 
 // When we create a GPU buffer, we need the Device (lets us give commands to GPU),
-// we need the Memory Properties from the PhysicalDevice (same GPU, but the properties of teh GPU),
+// we need the MemoryAllocator, which hands out pieces of large memory blocks,
 // and we need the BufferCreateInfo, to tell us what type of buffer this is (uniform, vertex, index, etc)
-BufferGPU::BufferGPU(VkDevice d, VkPhysicalDeviceMemoryProperties memory_properties, VkBufferCreateInfo info)
+BufferGPU::BufferGPU(VkDevice d, MemoryAllocator* a, VkBufferCreateInfo info, bool bindLater)
 {
 	// save device, so that
 	// we can use it to store
 	// data, and delete data
 	device = d;
 
+	// save the allocator, so that we can
+	// give our memory back when we are deleted
+	allocator = a;
+
+	concurrent = (info.sharingMode == VK_SHARING_MODE_CONCURRENT);
+
 	// create buffer with the device,
 	// and the VkBufferCreateInfo
-	vkCreateBuffer(device, &info, NULL, &buffer);
+	vkCreateBuffer(device, &info, HostAllocator::callbacks, &buffer);
+
+	// every buffer gets a name, SetName can give it a better one
+	DEBUG_NAME(device, VK_OBJECT_TYPE_BUFFER, buffer, "BufferGPU");
+
+	// memory stays empty, so the allocator is not
+	// given anything back when the buffer is destroyed
+	memory = {};
+
+	if (bindLater)
+		return;
 
 	// get memory requirements, so that we know
 	// what we need in order to allocate the memory
 	VkMemoryRequirements mem_reqs;
 	vkGetBufferMemoryRequirements(device, buffer, &mem_reqs);
 
-	// create allocation information
-	// this uses the memory requirements
-	// to tell the device how to allocate the buffer
-	VkMemoryAllocateInfo memAllocInfo = {};
-	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAllocInfo.allocationSize = mem_reqs.size;
-
-	// This function works the same as it did when
+	// This works the same as it did when
 	// we made a CPU Buffer, but this time it looks
 	// for a memoryTypeIndex that lets us make
 	// a buffer in the GPU's memory
@@ -59,50 +79,116 @@ BufferGPU::BufferGPU(VkDevice d, VkPhysicalDeviceMemoryProperties memory_propert
 	// find memory on the GPU's VRAM
 	// VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT says we are in Device memory
 	// Reminder: Device (vkDevice) references the graphics card
-	Helper::memory_type_from_properties(
-		memory_properties,
-		mem_reqs.memoryTypeBits,
+	if (!allocator->AllocateBuffer(
+		buffer,
+		mem_reqs,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		&memAllocInfo.memoryTypeIndex);
-
-	// allocate memory
-	// our memoryAllocationInfo got the required size
-	// from the VkMemoryRequirements, and it got
-	// the type of memory from memory_type_from_properties
-	vkAllocateMemory(device, &memAllocInfo, NULL, &memory);
+		&memory))
+	{
+		ERR_EXIT("Failed to allocate memory for BufferGPU\n", "Memory Allocation Failure");
+	}
 
 	// After our memory is allocated, we have
 	// to bind the buffer to the memory, so that
-	// we can use the memory
-	vkBindBufferMemory(device, buffer, memory, 0);
+	// we can use the memory. Our buffer starts at
+	// the offset that the allocator gave us
+	vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
+}
+
+BufferGPU::BufferGPU(BufferGPU&& other)
+{
+	Take(other);
+}
+
+BufferGPU& BufferGPU::operator=(BufferGPU&& other)
+{
+	// whatever this buffer had before is destroyed first
+	if (this != &other)
+	{
+		Destroy();
+		Take(other);
+	}
+
+	return *this;
+}
+
+void BufferGPU::Take(BufferGPU& other)
+{
+	device = other.device;
+	allocator = other.allocator;
+	concurrent = other.concurrent;
+	buffer = other.buffer;
+	memory = other.memory;
+
+	// the other one is empty now, so
+	// its destructor does nothing
+	other.buffer = VK_NULL_HANDLE;
+	other.memory = {};
 }
 
 BufferGPU::~BufferGPU()
 {
+	Destroy();
+}
+
+void BufferGPU::Destroy()
+{
+	// an empty (or moved) buffer has nothing to destroy
+	if (buffer == VK_NULL_HANDLE)
+		return;
+
 	// when we want to delete this CPU memory
 	// we delete the buffer, which is what we
 	// used to access the memory
-	vkDestroyBuffer(device, buffer, NULL);
+	vkDestroyBuffer(device, buffer, HostAllocator::callbacks);
 
 	// after deleting the buffer, there is no
-	// way to access the memory, so we delete
-	// the memory
-	vkFreeMemory(device, memory, NULL);
+	// way to access the memory, so we give
+	// the memory back to the allocator
+	allocator->Free(&memory);
+
+	buffer = VK_NULL_HANDLE;
+	memory = {};
+}
+
+void BufferGPU::SetName(const char* name)
+{
+	DEBUG_NAME(device, VK_OBJECT_TYPE_BUFFER, buffer, name);
+}
+
+VkMemoryRequirements BufferGPU::GetRequirements()
+{
+	VkMemoryRequirements mem_reqs;
+	vkGetBufferMemoryRequirements(device, buffer, &mem_reqs);
+	return mem_reqs;
+}
+
+void BufferGPU::Bind(VkDeviceMemory deviceMemory, VkDeviceSize offset)
+{
+	vkBindBufferMemory(device, buffer, deviceMemory, offset);
 }
 
-void BufferGPU::Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int size)
+// srcFamily and dstFamily are only used if the copy happens on a
+// transfer queue, and the buffer will be used on a graphics queue
+// of a different family, see Uploader.cpp
+void BufferGPU::Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int size, VkDeviceSize srcOffset, uint32_t srcFamily, uint32_t dstFamily, VkDeviceSize dstOffset)
 {
 	// Storing memory on the GPU is different from
 	// how we did it on the CPU. We need a command buffer
 	// to copy memory from CPU to GPU. This cmd will be
-	// the initialization command buffer from prepare().
-	// This command buffer is started in prepare(), and it
-	// will be executed before prepare() ends.
+	// a command buffer from the Uploader, which is
+	// submitted when Uploader::Submit() is called.
 
 	// First we make a copyRegion, which does
 	// not require an sType, to my surprise.
-	// We give it the size of the buffer
+	// We give it the size of the buffer, and where
+	// the data starts in the CPU buffer (the staging
+	// ring puts many uploads in one buffer), and where
+	// it goes in this buffer (MeshPool puts many meshes
+	// in one buffer)
 	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = srcOffset;
+	copyRegion.dstOffset = dstOffset;
 	copyRegion.size = size;
 
 	// We put a command into the command buffer, that
@@ -114,5 +200,61 @@ void BufferGPU::Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int size)
 	// buffer. Data will finally be copied from CPU to GPU
 	// after the command buffer with this vkCmdCopy command,
 	// is executed, which will happen before the end of prepare()
-	vkCmdCopyBuffer(cmd, cpuBuffer, buffer, 1, &copyRegion);
+	DeviceTable::CmdCopyBuffer(cmd, cpuBuffer, buffer, 1, &copyRegion);
+
+	// If the copy happened on a different queue family than the one
+	// that is going to use the buffer, then this queue has to give up
+	// ownership of the buffer ("release"). The other queue will take
+	// ownership with Acquire(), using an identical barrier.
+	// A CONCURRENT buffer has no owner, the semaphore between
+	// the queues is enough
+	if (srcFamily != dstFamily && !concurrent)
+	{
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		DeviceTable::CmdPipelineBarrier(cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, NULL, 1, &barrier, 0, NULL);
+	}
+}
+
+void BufferGPU::Acquire(VkCommandBuffer cmd, uint32_t srcFamily, uint32_t dstFamily, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage)
+{
+	// This barrier makes sure that the copy is finished before
+	// dstStage reads from the buffer. If the families are different,
+	// this is also the "acquire" half of the ownership transfer,
+	// and it has to be recorded on a queue of dstFamily.
+	// If both families are VK_QUEUE_FAMILY_IGNORED, then it is
+	// just a normal barrier on the same queue as the copy.
+	// A CONCURRENT buffer is never transferred, so it gets a normal
+	// barrier, the semaphore already waited for the copy
+	if (concurrent)
+	{
+		srcFamily = VK_QUEUE_FAMILY_IGNORED;
+		dstFamily = VK_QUEUE_FAMILY_IGNORED;
+	}
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = (srcFamily != dstFamily) ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = srcFamily;
+	barrier.dstQueueFamilyIndex = dstFamily;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		(srcFamily != dstFamily) ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT,
+		dstStage,
+		0, 0, NULL, 1, &barrier, 0, NULL);
 }
@@ -25,23 +25,75 @@ that utilizes Vulkan, see more at http://cemu.info
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vulkan/vk_sdk_platform.h>
+#include "MemoryAllocator.h"
+#include "DebugUtils.h"
 
 class BufferGPU
 {
 private:
-	VkDeviceMemory memory;
+	MemoryAllocation memory;
+	MemoryAllocator* allocator;
 	VkDevice device;
 
+	// a CONCURRENT buffer can be used by every family in its
+	// list, without transferring ownership between them
+	bool concurrent;
+
+	// takes everything from other, which is left empty
+	void Take(BufferGPU& other);
+
 public:
 	VkBuffer buffer;
 
+	// an empty buffer, which has no VkBuffer and no memory,
+	// so that a BufferGPU can be a member before it is made
+	BufferGPU();
+
+	// With bindLater, the buffer gets no memory yet, whoever made
+	// it binds it to memory with Bind (see ExternalMemory)
 	BufferGPU(
 		VkDevice d, 
-		VkPhysicalDeviceMemoryProperties memory_properties, 
-		VkBufferCreateInfo info);
-	
+		MemoryAllocator* a, 
+		VkBufferCreateInfo info,
+		bool bindLater = false);
+
+	// A BufferGPU owns its VkBuffer and its memory, so it can not be
+	// copied, two copies would destroy the same buffer. It can be moved,
+	// then the old one is empty. Something that still has a pointer to
+	// it (like a pending upload) has to be done before it moves
+	BufferGPU(const BufferGPU&) = delete;
+	BufferGPU& operator=(const BufferGPU&) = delete;
+	BufferGPU(BufferGPU&& other);
+	BufferGPU& operator=(BufferGPU&& other);
+
 	~BufferGPU();
 
-	void Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int size);
+	// destroys the buffer now, and leaves it empty,
+	// no frame on the GPU can still be using it
+	void Destroy();
+
+	// the name that debuggers show for the buffer (debug builds only)
+	void SetName(const char* name);
+
+	// binds a buffer that was made with bindLater
+	// to memory that someone else owns
+	VkMemoryRequirements GetRequirements();
+	void Bind(VkDeviceMemory deviceMemory, VkDeviceSize offset);
+
+	void Store(
+		VkCommandBuffer cmd,
+		VkBuffer cpuBuffer,
+		int size,
+		VkDeviceSize srcOffset = 0,
+		uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED,
+		uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED,
+		VkDeviceSize dstOffset = 0);
+
+	void Acquire(
+		VkCommandBuffer cmd,
+		uint32_t srcFamily,
+		uint32_t dstFamily,
+		VkAccessFlags dstAccess,
+		VkPipelineStageFlags dstStage);
 };
 
@@ -0,0 +1,114 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "Camera.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+Camera::Camera()
+{
+	eye = glm::vec3(0.0f, 0.0f, 1.0f);
+	focus = glm::vec3(0.0f);
+	up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+	fovY = 45.0f * 3.14159f / 180.0f;
+	aspect = 1.0f;
+	nearZ = 0.1f;
+	farZ = 100.0f;
+
+	view = glm::mat4(1.0f);
+	projection = glm::mat4(1.0f);
+	viewProjection = glm::mat4(1.0f);
+
+	viewDirty = true;
+	projectionDirty = true;
+}
+
+void Camera::LookAt(glm::vec3 position, glm::vec3 target, glm::vec3 upDirection)
+{
+	if (position == eye && target == focus && upDirection == up)
+		return;
+
+	eye = position;
+	focus = target;
+	up = upDirection;
+	viewDirty = true;
+}
+
+void Camera::SetPerspective(float fov, float aspectRatio, float nearPlane, float farPlane)
+{
+	if (fov == fovY && aspectRatio == aspect && nearPlane == nearZ && farPlane == farZ)
+		return;
+
+	fovY = fov;
+	aspect = aspectRatio;
+	nearZ = nearPlane;
+	farZ = farPlane;
+	projectionDirty = true;
+}
+
+void Camera::SetAspect(float aspectRatio)
+{
+	SetPerspective(fovY, aspectRatio, nearZ, farZ);
+}
+
+void Camera::Update()
+{
+	if (!viewDirty && !projectionDirty)
+		return;
+
+	if (viewDirty)
+		view = glm::lookAt(eye, focus, up);
+
+	// Vulkan's Y axis goes down, so the projection
+	// flips it, then the GLSL shaders do not have to
+	if (projectionDirty)
+	{
+		projection = glm::perspective(fovY, aspect, nearZ, farZ);
+		projection[1][1] *= -1;
+	}
+
+	viewProjection = projection * view;
+
+	viewDirty = false;
+	projectionDirty = false;
+}
+
+const glm::mat4& Camera::GetView()
+{
+	Update();
+	return view;
+}
+
+const glm::mat4& Camera::GetProjection()
+{
+	Update();
+	return projection;
+}
+
+const glm::mat4& Camera::GetViewProjection()
+{
+	Update();
+	return viewProjection;
+}
@@ -0,0 +1,77 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+// The view, the projection, and the view-projection of the camera,
+// which are only built again when something that they depend on changes.
+// The setters can be called every frame with the same values (like the
+// size of the window), that costs a few compares, and the matrices stay
+// cached until the camera moves, or the window is resized
+class Camera
+{
+private:
+	glm::vec3 eye;
+	glm::vec3 focus;
+	glm::vec3 up;
+
+	float fovY;
+	float aspect;
+	float nearZ;
+	float farZ;
+
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+
+	bool viewDirty;
+	bool projectionDirty;
+
+	void Update();
+
+public:
+	Camera();
+
+	// where the camera is, the point it looks at, and which way is up
+	void LookAt(glm::vec3 position, glm::vec3 target, glm::vec3 upDirection);
+
+	// fov is the vertical field of view, in radians, aspect is the
+	// width divided by the height. The Y axis of the projection is
+	// flipped for Vulkan, see prepare_uniform_buffer
+	void SetPerspective(float fov, float aspectRatio, float nearPlane, float farPlane);
+	void SetAspect(float aspectRatio);
+
+	const glm::mat4& GetView();
+	const glm::mat4& GetProjection();
+	const glm::mat4& GetViewProjection();
+
+	// the view moves the eye to (0, 0, 0), so this is
+	// what the inverse of the view would give back
+	glm::vec3 GetPosition() { return eye; }
+};
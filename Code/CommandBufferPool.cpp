@@ -0,0 +1,156 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "CommandBufferPool.h"
+#include "JobSystem.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <stdio.h>
+#include <assert.h>
+
+// The CommandRecorder keeps one secondary command buffer for each
+// slice and frame slot, because it always records the same number.
+// One-shot work is different, one frame might copy nothing, and the
+// next might copy ten times, so each list grows to the most that one
+// frame has needed, and never shrinks
+
+CommandBufferPool::CommandBufferPool(VkDevice d, uint32_t queueFamily, uint32_t slotCount, uint32_t threads)
+{
+	device = d;
+	threadCount = threads;
+	columnCount = threadCount + COMMAND_POOL_OTHER_THREADS - 1;
+	slot = 0;
+	allocatedCount = 0;
+
+	// TRANSIENT, because the command buffers are reset after
+	// every frame, and each one is only recorded once
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+
+	lists.resize(slotCount * columnCount);
+
+	for (size_t i = 0; i < lists.size(); i++)
+	{
+		vkCreateCommandPool(device, &poolInfo, HostAllocator::callbacks, &lists[i].pool);
+		lists[i].used = 0;
+	}
+}
+
+CommandBufferPool::~CommandBufferPool()
+{
+	// the device is idle when the demo deletes us,
+	// destroying the pools also frees the command buffers
+	for (size_t i = 0; i < lists.size(); i++)
+		vkDestroyCommandPool(device, lists[i].pool, HostAllocator::callbacks);
+}
+
+uint32_t CommandBufferPool::GetColumn()
+{
+	// worker threads have their own index, and
+	// nobody else uses it, so there is nothing to lock
+	uint32_t thread = JobSystem::GetThreadIndex();
+
+	if (thread != 0)
+		return thread;
+
+	// Every other thread is thread 0 for the JobSystem, so they
+	// are told apart here. The main thread records while the demo
+	// starts, and the render thread after that, and if they ever
+	// did it at the same time, they still would not share a pool
+	std::lock_guard<std::mutex> lock(ownerMutex);
+	std::thread::id id = std::this_thread::get_id();
+
+	uint32_t owner = 0;
+	while (owner < owners.size() && owners[owner] != id)
+		owner++;
+
+	if (owner == owners.size())
+	{
+		if (owners.size() == COMMAND_POOL_OTHER_THREADS)
+		{
+			printf("More than %u threads that are not workers use the one-shot command buffers\n", COMMAND_POOL_OTHER_THREADS);
+			assert(!"Raise COMMAND_POOL_OTHER_THREADS");
+			owner = COMMAND_POOL_OTHER_THREADS - 1;
+		}
+		else
+			owners.push_back(id);
+	}
+
+	return (owner == 0) ? 0 : threadCount + owner - 1;
+}
+
+VkCommandBuffer CommandBufferPool::Begin()
+{
+	CommandBufferList& list = lists[slot * columnCount + GetColumn()];
+
+	// only allocate when every command buffer
+	// of this list was already used in this frame
+	if (list.used == list.cmds.size())
+	{
+		VkCommandBufferAllocateInfo cmdInfo = {};
+		cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmdInfo.commandPool = list.pool;
+		cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmdInfo.commandBufferCount = 1;
+
+		VkCommandBuffer cmd;
+		vkAllocateCommandBuffers(device, &cmdInfo, &cmd);
+		list.cmds.push_back(cmd);
+		allocatedCount++;
+	}
+
+	VkCommandBuffer cmd = list.cmds[list.used];
+	list.used++;
+
+	// The pool was reset, so the command buffer does not need
+	// a reset of its own before it is recorded again
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	DeviceTable::BeginCommandBuffer(cmd, &beginInfo);
+
+	return cmd;
+}
+
+void CommandBufferPool::BeginFrame(uint32_t frame)
+{
+	slot = frame;
+
+	// one reset for each thread, instead of one
+	// for each command buffer, and lists that
+	// were not used in the last frame are skipped
+	for (uint32_t i = 0; i < columnCount; i++)
+	{
+		CommandBufferList& list = lists[slot * columnCount + i];
+
+		if (list.used == 0)
+			continue;
+
+		DeviceTable::ResetCommandPool(device, list.pool, 0);
+		list.used = 0;
+	}
+}
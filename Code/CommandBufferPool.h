@@ -0,0 +1,99 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// How many threads that are not workers of the JobSystem (like the main
+// thread, while the demo starts, and the render thread) can call Begin,
+// each one gets pools of its own, the first time that it calls Begin
+#define COMMAND_POOL_OTHER_THREADS 4
+
+// The command buffers that one thread records for one frame slot.
+// Begin hands them out in order, BeginFrame resets the pool, and
+// then the same command buffers are handed out again
+struct CommandBufferList
+{
+	VkCommandPool pool;
+	std::vector<VkCommandBuffer> cmds;
+	uint32_t used;
+};
+
+// Primary command buffers for work that is recorded once and submitted
+// once, like a copy, a readback, or the moves of the defragmenter.
+// Allocating and freeing a command buffer for each of those is slow, so
+// each thread gets a TRANSIENT pool for each frame slot, and when the
+// slot comes back (its fence was waited on), the whole pool is reset
+// at once, and its command buffers are used again. A VkCommandPool can
+// only be used by one thread at a time, so no two threads share a pool:
+// a worker uses the index that the JobSystem gives it, and every other
+// thread (which the JobSystem calls thread 0) gets a column of its own
+class CommandBufferPool
+{
+private:
+	VkDevice device;
+	uint32_t threadCount;
+
+	// threadCount, plus the columns of the other threads
+	uint32_t columnCount;
+
+	// lists[slot * columnCount + column]
+	std::vector<CommandBufferList> lists;
+
+	// The threads that are not workers, in the order that they first
+	// called Begin. The first one uses column 0, the others use the
+	// columns after the workers. This is only locked by those threads
+	std::mutex ownerMutex;
+	std::vector<std::thread::id> owners;
+
+	uint32_t GetColumn();
+
+	// the slot of the frame that is being recorded
+	uint32_t slot;
+
+public:
+	// how many command buffers were allocated, which
+	// stops growing once every list has enough
+	std::atomic<uint32_t> allocatedCount;
+
+	CommandBufferPool(VkDevice d, uint32_t queueFamily, uint32_t slotCount, uint32_t threads);
+	~CommandBufferPool();
+
+	// Returns a command buffer that has been started with ONE_TIME_SUBMIT.
+	// It must be submitted in the frame of this slot (or before it), because
+	// it is reset when the slot comes back. Any thread of the JobSystem can call
+	// it, and up to COMMAND_POOL_OTHER_THREADS other threads
+	VkCommandBuffer Begin();
+
+	// The fence of this slot was waited on, so nothing
+	// from its pools is on the GPU anymore. No thread can
+	// be recording from this pool while this runs
+	void BeginFrame(uint32_t frame);
+};
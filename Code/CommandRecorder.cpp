@@ -0,0 +1,173 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#include "CommandRecorder.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+
+// Recording thousands of draws into one command buffer, on one
+// thread, can take longer than the GPU takes to draw them. Vulkan
+// lets many threads record at the same time, as long as each thread
+// uses its own command pool.
+
+// Each job records a "secondary" command buffer, which holds
+// a slice of the draws. Secondary command buffers cannot be submitted
+// to a queue by themselves, but the primary command buffer can run
+// them inside of its render pass with vkCmdExecuteCommands
+
+CommandRecorder::CommandRecorder(VkDevice d, uint32_t queueFamily, uint32_t slotCount, JobSystem* js, uint32_t sliceCount)
+{
+	device = d;
+	jobs = js;
+	slot = 0;
+	inheritance = {};
+
+	if (sliceCount < 1)
+		sliceCount = 1;
+
+	// TRANSIENT, because these command buffers are
+	// recorded again every frame
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+
+	for (uint32_t i = 0; i < sliceCount; i++)
+	{
+		RecordWorker* worker = new RecordWorker();
+		worker->first = 0;
+		worker->count = 0;
+		worker->pools.resize(slotCount);
+		worker->cmds.resize(slotCount);
+
+		for (uint32_t s = 0; s < slotCount; s++)
+		{
+			vkCreateCommandPool(device, &poolInfo, HostAllocator::callbacks, &worker->pools[s]);
+
+			VkCommandBufferAllocateInfo cmdInfo = {};
+			cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			cmdInfo.commandPool = worker->pools[s];
+			cmdInfo.commandBufferCount = 1;
+			vkAllocateCommandBuffers(device, &cmdInfo, &worker->cmds[s]);
+		}
+
+		workers.push_back(worker);
+	}
+}
+
+CommandRecorder::~CommandRecorder()
+{
+	// Record waits for its jobs before it returns,
+	// so nothing is using the pools anymore
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		// destroying the pools also frees the command buffers
+		for (size_t s = 0; s < workers[i]->pools.size(); s++)
+			vkDestroyCommandPool(device, workers[i]->pools[s], HostAllocator::callbacks);
+
+		delete workers[i];
+	}
+
+	workers.clear();
+}
+
+void CommandRecorder::RecordSlice(uint32_t index)
+{
+	RecordWorker* worker = workers[index];
+
+	// The fence of this frame slot was already waited on,
+	// so nothing from this pool is on the GPU anymore
+	DeviceTable::ResetCommandPool(device, worker->pools[slot], 0);
+
+	// RENDER_PASS_CONTINUE says that this command buffer
+	// runs entirely inside of a render pass, which is
+	// described by the inheritance info
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+
+	VkCommandBuffer cmd = worker->cmds[slot];
+	DeviceTable::BeginCommandBuffer(cmd, &beginInfo);
+	function(cmd, worker->first, worker->count);
+	DeviceTable::EndCommandBuffer(cmd);
+}
+
+void CommandRecorder::Record(
+	uint32_t frameSlot,
+	VkCommandBufferInheritanceInfo inherit,
+	uint32_t drawCount,
+	RecordFunction fn,
+	std::vector<VkCommandBuffer>* secondaries)
+{
+	// figure out how many slices are worth waking up threads for
+	uint32_t count = (drawCount + RECORD_MIN_DRAWS_PER_THREAD - 1) / RECORD_MIN_DRAWS_PER_THREAD;
+	if (count > (uint32_t)workers.size())
+		count = (uint32_t)workers.size();
+	if (count < 1)
+		count = 1;
+
+	// give each slice an equal part of the draws
+	uint32_t perWorker = drawCount / count;
+	uint32_t extra = drawCount % count;
+	uint32_t first = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		workers[i]->first = first;
+		workers[i]->count = perWorker + (i < extra ? 1 : 0);
+		first += workers[i]->count;
+	}
+
+	// the jobs read these, Run makes sure
+	// that they see them before they start
+	slot = frameSlot;
+	inheritance = inherit;
+	function = fn;
+
+	// one job for every slice except the first
+	for (uint32_t i = 1; i < count; i++)
+		jobs->Run([this, i]() { RecordSlice(i); }, &counter);
+
+	// this thread records the first slice,
+	// while the others record theirs
+	RecordSlice(0);
+
+	// wait for the others, this thread
+	// records the slices that nobody took yet
+	jobs->Wait(&counter);
+
+	// give back the secondary command buffers,
+	// in the same order as the slices
+	secondaries->clear();
+	for (uint32_t i = 0; i < count; i++)
+		secondaries->push_back(workers[i]->cmds[frameSlot]);
+}
+
+uint32_t CommandRecorder::GetThreadCount()
+{
+	return (uint32_t)workers.size();
+}
@@ -0,0 +1,87 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include <functional>
+#include "JobSystem.h"
+
+// If there are fewer draws than this for each thread,
+// then we use fewer threads, because waking up a thread
+// takes longer than recording a handful of draws
+#define RECORD_MIN_DRAWS_PER_THREAD 64
+
+// the function that records draws [first, first + count)
+// into a secondary command buffer
+typedef std::function<void(VkCommandBuffer cmd, uint32_t first, uint32_t count)> RecordFunction;
+
+// Each slice has its own command pools, because a command pool can
+// only be used by one thread at a time. A slice is only recorded by
+// one job, so it does not matter which thread runs that job
+struct RecordWorker
+{
+	// one pool, and one secondary command buffer,
+	// for each frame that can be in flight
+	std::vector<VkCommandPool> pools;
+	std::vector<VkCommandBuffer> cmds;
+
+	// the slice of draws that this job records
+	uint32_t first;
+	uint32_t count;
+};
+
+// Records secondary command buffers on many threads at once.
+// Slice 0 is recorded by the thread that calls Record, every
+// other slice is a job of the JobSystem
+class CommandRecorder
+{
+private:
+	VkDevice device;
+	JobSystem* jobs;
+	std::vector<RecordWorker*> workers;
+
+	// the frame that the jobs are recording right now,
+	// this only changes while no jobs are running
+	uint32_t slot;
+	VkCommandBufferInheritanceInfo inheritance;
+	RecordFunction function;
+	JobCounter counter;
+
+	void RecordSlice(uint32_t index);
+
+public:
+	CommandRecorder(VkDevice d, uint32_t queueFamily, uint32_t slotCount, JobSystem* js, uint32_t sliceCount);
+	~CommandRecorder();
+
+	void Record(
+		uint32_t frameSlot,
+		VkCommandBufferInheritanceInfo inherit,
+		uint32_t drawCount,
+		RecordFunction fn,
+		std::vector<VkCommandBuffer>* secondaries);
+
+	uint32_t GetThreadCount();
+};
@@ -0,0 +1,205 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "CommandState.h"
+#include "DeviceTable.h"
+#include <string.h>
+
+CommandState::CommandState(VkCommandBuffer commandBuffer)
+{
+	cmd = commandBuffer;
+
+	// nothing is bound in a new command buffer
+	pipeline = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+	dynamicOffset = 0;
+
+	staticLayout = VK_NULL_HANDLE;
+
+	for (uint32_t i = 0; i < COMMAND_STATE_MAX_SETS; i++)
+		staticSets[i] = VK_NULL_HANDLE;
+
+	for (uint32_t i = 0; i < COMMAND_STATE_MAX_BINDINGS; i++)
+	{
+		vertexBuffers[i] = VK_NULL_HANDLE;
+		vertexOffsets[i] = 0;
+	}
+
+	indexBuffer = VK_NULL_HANDLE;
+	indexOffset = 0;
+	indexType = VK_INDEX_TYPE_UINT16;
+
+	viewportSet = false;
+	viewport = {};
+	scissorSet = false;
+	scissor = {};
+
+	pushLayout = VK_NULL_HANDLE;
+	pushWritten = 0;
+
+	recorded = 0;
+	elided = 0;
+	draws = 0;
+}
+
+bool CommandState::Count(bool redundant)
+{
+	if (redundant)
+		elided++;
+	else
+		recorded++;
+
+	return !redundant;
+}
+
+void CommandState::BindPipeline(VkPipeline p)
+{
+	if (!Count(p == pipeline))
+		return;
+
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, p);
+	pipeline = p;
+}
+
+void CommandState::BindDescriptorSet(VkPipelineLayout layout, VkDescriptorSet s, uint32_t offset)
+{
+	if (!Count(layout == setLayout && s == set && offset == dynamicOffset))
+		return;
+
+	DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &s, 1, &offset);
+	setLayout = layout;
+	set = s;
+	dynamicOffset = offset;
+}
+
+void CommandState::BindStaticSet(VkPipelineLayout layout, uint32_t index, VkDescriptorSet s)
+{
+	// sets that were bound with another layout are forgotten
+	if (layout != staticLayout)
+	{
+		for (uint32_t i = 0; i < COMMAND_STATE_MAX_SETS; i++)
+			staticSets[i] = VK_NULL_HANDLE;
+
+		staticLayout = layout;
+	}
+
+	bool known = index < COMMAND_STATE_MAX_SETS;
+
+	if (!Count(known && staticSets[index] == s))
+		return;
+
+	DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, index, 1, &s, 0, NULL);
+
+	if (known)
+		staticSets[index] = s;
+}
+
+void CommandState::BindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset)
+{
+	// bindings that are not remembered are always recorded
+	bool known = binding < COMMAND_STATE_MAX_BINDINGS;
+
+	if (!Count(known && vertexBuffers[binding] == buffer && vertexOffsets[binding] == offset))
+		return;
+
+	DeviceTable::CmdBindVertexBuffers(cmd, binding, 1, &buffer, &offset);
+
+	if (known)
+	{
+		vertexBuffers[binding] = buffer;
+		vertexOffsets[binding] = offset;
+	}
+}
+
+void CommandState::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType type)
+{
+	if (!Count(buffer == indexBuffer && offset == indexOffset && type == indexType))
+		return;
+
+	DeviceTable::CmdBindIndexBuffer(cmd, buffer, offset, type);
+	indexBuffer = buffer;
+	indexOffset = offset;
+	indexType = type;
+}
+
+void CommandState::SetViewport(const VkViewport& v)
+{
+	if (!Count(viewportSet && memcmp(&v, &viewport, sizeof(VkViewport)) == 0))
+		return;
+
+	DeviceTable::CmdSetViewport(cmd, 0, 1, &v);
+	viewport = v;
+	viewportSet = true;
+}
+
+void CommandState::SetScissor(const VkRect2D& r)
+{
+	if (!Count(scissorSet && memcmp(&r, &scissor, sizeof(VkRect2D)) == 0))
+		return;
+
+	DeviceTable::CmdSetScissor(cmd, 0, 1, &r);
+	scissor = r;
+	scissorSet = true;
+}
+
+void CommandState::PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data)
+{
+	// a push that does not fit is always recorded, and
+	// forgets everything, so it can never be skipped wrongly
+	if (offset + size > COMMAND_STATE_PUSH_SIZE)
+	{
+		Count(false);
+		DeviceTable::CmdPushConstants(cmd, layout, stages, offset, size, data);
+		pushWritten = 0;
+		return;
+	}
+
+	if (layout != pushLayout)
+	{
+		pushLayout = layout;
+		pushWritten = 0;
+	}
+
+	// the bits of the 4-byte words that this push writes
+	uint32_t words = size / 4;
+	uint32_t mask = (words >= 32) ? 0xFFFFFFFF : (((1u << words) - 1) << (offset / 4));
+
+	bool redundant = ((pushWritten & mask) == mask) && memcmp(pushData + offset, data, size) == 0;
+
+	if (!Count(redundant))
+		return;
+
+	DeviceTable::CmdPushConstants(cmd, layout, stages, offset, size, data);
+	memcpy(pushData + offset, data, size);
+	pushWritten |= mask;
+}
+
+void CommandState::Finish(CommandStateStats* stats)
+{
+	stats->recorded += recorded;
+	stats->elided += elided;
+	stats->draws += draws;
+}
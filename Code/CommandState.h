@@ -0,0 +1,124 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <stdint.h>
+#include <atomic>
+
+// the vertex buffer bindings that are remembered, the
+// cube uses binding 0 for vertices, and 1 for instances
+#define COMMAND_STATE_MAX_BINDINGS 4
+
+// the most push constant bytes that every GPU has to
+// support, the push constants of the cube are 68 bytes
+#define COMMAND_STATE_PUSH_SIZE 128
+
+// the sets after set 0 that are remembered, see DescriptorSets.h
+#define COMMAND_STATE_MAX_SETS 4
+
+// How many binds the command buffers of one frame recorded, and how
+// many they skipped, because the same thing was already bound. Every
+// thread adds its counts when its command buffer is finished
+struct CommandStateStats
+{
+	std::atomic<uint32_t> recorded;
+	std::atomic<uint32_t> elided;
+
+	// the draw calls, which the HUD shows
+	std::atomic<uint32_t> draws;
+};
+
+// A thin layer in front of the binds of one command buffer. It
+// remembers what is bound, so when a draw binds the same pipeline,
+// descriptor set, vertex buffer, index buffer, viewport, scissor or
+// push constants again, nothing is recorded. Secondary command buffers
+// inherit no state, so every one starts with nothing bound.
+// Only one thread uses a CommandState, it lives on the stack of
+// the function that records the command buffer
+class CommandState
+{
+private:
+	VkCommandBuffer cmd;
+
+	VkPipeline pipeline;
+
+	// the descriptor set at set 0, with its dynamic offset
+	VkPipelineLayout setLayout;
+	VkDescriptorSet set;
+	uint32_t dynamicOffset;
+
+	// The sets without a dynamic offset, at their set number. Binding
+	// set 0 again with the same layout leaves them bound
+	VkPipelineLayout staticLayout;
+	VkDescriptorSet staticSets[COMMAND_STATE_MAX_SETS];
+
+	VkBuffer vertexBuffers[COMMAND_STATE_MAX_BINDINGS];
+	VkDeviceSize vertexOffsets[COMMAND_STATE_MAX_BINDINGS];
+
+	VkBuffer indexBuffer;
+	VkDeviceSize indexOffset;
+	VkIndexType indexType;
+
+	bool viewportSet;
+	VkViewport viewport;
+	bool scissorSet;
+	VkRect2D scissor;
+
+	// The push constants that were pushed, one bit for each 4 bytes
+	// that were written. They are the same for every pipeline with
+	// the same layout, so they are forgotten when the layout changes
+	VkPipelineLayout pushLayout;
+	uint32_t pushWritten;
+	uint8_t pushData[COMMAND_STATE_PUSH_SIZE];
+
+	uint32_t recorded;
+	uint32_t elided;
+	uint32_t draws;
+
+	// counts one bind, and says if it has to be recorded
+	bool Count(bool redundant);
+
+public:
+	CommandState(VkCommandBuffer commandBuffer);
+
+	void BindPipeline(VkPipeline p);
+	void BindDescriptorSet(VkPipelineLayout layout, VkDescriptorSet s, uint32_t offset);
+	void BindStaticSet(VkPipelineLayout layout, uint32_t index, VkDescriptorSet s);
+	void BindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset);
+	void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType type);
+	void SetViewport(const VkViewport& v);
+	void SetScissor(const VkRect2D& r);
+
+	// offset and size are multiples of 4, like vkCmdPushConstants needs
+	void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data);
+
+	// the draws are recorded by the caller, this only counts them
+	void CountDraws(uint32_t count) { draws += count; }
+
+	// adds the counts of this command buffer to the frame
+	void Finish(CommandStateStats* stats);
+};
@@ -0,0 +1,202 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "CpuProfiler.h"
+#include "TraceCapture.h"
+#include <stdio.h>
+#include <string.h>
+
+// the names of the markers, for the CSV file and the trace
+static const char* markerNames[CPU_MARKER_COUNT] =
+{
+	"frame",
+	"wait_fence",
+	"update_uniforms",
+	"acquire",
+	"record",
+	"submit",
+	"present"
+};
+
+static double ElapsedMs(CpuClock::time_point start, CpuClock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+CpuProfiler::CpuProfiler()
+{
+	memset(samples, 0, sizeof(samples));
+	memset(&current, 0, sizeof(current));
+	memset(totals, 0, sizeof(totals));
+	sampleCount = 0;
+	started = false;
+	trace = nullptr;
+}
+
+void CpuProfiler::BeginFrame()
+{
+	CpuClock::time_point now = CpuClock::now();
+
+	// the first frame has nothing before it
+	if (started)
+		current.ms[CPU_MARKER_FRAME] = ElapsedMs(lastFrameStart, now);
+
+	lastFrameStart = now;
+	started = true;
+}
+
+void CpuProfiler::EndFrame()
+{
+	// the frame in the trace is only draw(), from BeginFrame
+	if (trace != nullptr && trace->IsActive())
+		trace->AddCpu(markerNames[CPU_MARKER_FRAME], lastFrameStart, CpuClock::now());
+
+	// put the frame in the ring, over the oldest frame
+	samples[sampleCount % CPU_PROFILER_HISTORY] = current;
+	sampleCount++;
+
+	for (uint32_t m = 0; m < CPU_MARKER_COUNT; m++)
+		totals[m] += current.ms[m];
+
+	memset(&current, 0, sizeof(current));
+}
+
+void CpuProfiler::Begin(CpuMarker marker)
+{
+	markerStart[marker] = CpuClock::now();
+}
+
+void CpuProfiler::End(CpuMarker marker)
+{
+	CpuClock::time_point now = CpuClock::now();
+
+	// += so a marker can be used more than once in a frame
+	current.ms[marker] += ElapsedMs(markerStart[marker], now);
+
+	if (trace != nullptr && trace->IsActive())
+		trace->AddCpu(markerNames[marker], markerStart[marker], now);
+}
+
+void CpuProfiler::SetTrace(TraceCapture* t)
+{
+	trace = t;
+}
+
+uint32_t CpuProfiler::GetSampleCount()
+{
+	return (sampleCount < CPU_PROFILER_HISTORY) ? (uint32_t)sampleCount : CPU_PROFILER_HISTORY;
+}
+
+CpuFrameSample CpuProfiler::GetSample(uint32_t index)
+{
+	// index 0 is the oldest frame in the ring
+	uint64_t first = sampleCount - GetSampleCount();
+	return samples[(first + index) % CPU_PROFILER_HISTORY];
+}
+
+double CpuProfiler::GetAverage(CpuMarker marker)
+{
+	if (sampleCount == 0)
+		return 0;
+
+	return totals[marker] / sampleCount;
+}
+
+const char* CpuProfiler::GetMarkerName(CpuMarker marker)
+{
+	return markerNames[marker];
+}
+
+bool CpuProfiler::ExportCsv(const char* path)
+{
+	FILE* file = fopen(path, "w");
+
+	if (file == nullptr)
+	{
+		printf("Could not write %s\n", path);
+		return false;
+	}
+
+	// one column for each marker, one row for each frame
+	for (uint32_t m = 0; m < CPU_MARKER_COUNT; m++)
+		fprintf(file, (m == 0) ? "%s" : ",%s", markerNames[m]);
+	fprintf(file, "\n");
+
+	uint32_t count = GetSampleCount();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		CpuFrameSample sample = GetSample(i);
+
+		for (uint32_t m = 0; m < CPU_MARKER_COUNT; m++)
+			fprintf(file, (m == 0) ? "%.4f" : ",%.4f", sample.ms[m]);
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
+	return true;
+}
+
+void CpuProfiler::PrintHistogram()
+{
+	uint32_t count = GetSampleCount();
+
+	if (count == 0)
+		return;
+
+	// count how many frames took 0-1 ms, 1-2 ms, and so on
+	uint32_t buckets[CPU_PROFILER_BUCKETS] = {};
+	uint32_t largest = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t b = (uint32_t)GetSample(i).ms[CPU_MARKER_FRAME];
+		if (b >= CPU_PROFILER_BUCKETS)
+			b = CPU_PROFILER_BUCKETS - 1;
+
+		buckets[b]++;
+		if (buckets[b] > largest)
+			largest = buckets[b];
+	}
+
+	// each bar is at most 60 characters wide
+	printf("CPU frame times of the last %u frames:\n", count);
+
+	for (uint32_t b = 0; b < CPU_PROFILER_BUCKETS; b++)
+	{
+		if (buckets[b] == 0)
+			continue;
+
+		if (b == CPU_PROFILER_BUCKETS - 1)
+			printf("   >%2u ms | ", b);
+		else
+			printf("%2u-%2u ms | ", b, b + 1);
+
+		uint32_t bar = (buckets[b] * 60 + largest - 1) / largest;
+		for (uint32_t i = 0; i < bar; i++)
+			printf("#");
+
+		printf(" %u\n", buckets[b]);
+	}
+}
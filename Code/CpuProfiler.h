@@ -0,0 +1,132 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <chrono>
+
+// how many frames the profiler remembers,
+// older frames are written over
+#define CPU_PROFILER_HISTORY 1024
+
+// the histogram has one bucket for each millisecond,
+// and the last bucket has every frame that is slower
+#define CPU_PROFILER_BUCKETS 34
+
+// The parts of a frame that are measured
+enum CpuMarker
+{
+	CPU_MARKER_FRAME,
+	CPU_MARKER_WAIT_FENCE,
+	CPU_MARKER_UPDATE_UNIFORMS,
+	CPU_MARKER_ACQUIRE,
+	CPU_MARKER_RECORD,
+	CPU_MARKER_SUBMIT,
+	CPU_MARKER_PRESENT,
+	CPU_MARKER_COUNT
+};
+
+// milliseconds of each marker, in one frame
+struct CpuFrameSample
+{
+	double ms[CPU_MARKER_COUNT];
+};
+
+typedef std::chrono::steady_clock CpuClock;
+
+// see TraceCapture.h, which needs CpuClock from here
+class TraceCapture;
+
+// Measures where the CPU time of each frame goes. Nothing here
+// allocates memory or prints after it is created, so it can be
+// left on all the time. The frames are kept in a ring, which can
+// be written to a CSV file, or printed as a histogram
+class CpuProfiler
+{
+private:
+	CpuFrameSample samples[CPU_PROFILER_HISTORY];
+	uint64_t sampleCount;
+
+	// the sum of every frame, even frames
+	// that are not in the ring anymore
+	double totals[CPU_MARKER_COUNT];
+
+	// the frame that is being measured right now
+	CpuFrameSample current;
+	CpuClock::time_point markerStart[CPU_MARKER_COUNT];
+	CpuClock::time_point lastFrameStart;
+	bool started;
+
+	// every marker also goes to the trace, while it records
+	TraceCapture* trace;
+
+public:
+	CpuProfiler();
+
+	// FRAME is the time from the last BeginFrame to this one,
+	// which includes everything, even time outside of draw()
+	void BeginFrame();
+	void EndFrame();
+
+	void Begin(CpuMarker marker);
+	void End(CpuMarker marker);
+
+	// nullptr for no trace
+	void SetTrace(TraceCapture* t);
+
+	uint32_t GetSampleCount();
+	CpuFrameSample GetSample(uint32_t index);
+
+	// the average of every frame since the profiler was made
+	double GetAverage(CpuMarker marker);
+
+	// the name of a marker, like in the CSV file
+	static const char* GetMarkerName(CpuMarker marker);
+
+	bool ExportCsv(const char* path);
+	void PrintHistogram();
+};
+
+// Begins a marker when it is made, and ends the
+// marker when it goes out of scope
+class CpuScope
+{
+private:
+	CpuProfiler* profiler;
+	CpuMarker marker;
+
+public:
+	CpuScope(CpuProfiler* p, CpuMarker m)
+	{
+		profiler = p;
+		marker = m;
+		profiler->Begin(marker);
+	}
+
+	~CpuScope()
+	{
+		profiler->End(marker);
+	}
+};
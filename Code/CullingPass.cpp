@@ -0,0 +1,357 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "CullingPass.h"
+#include "FrustumCulling.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <string.h>
+
+CullingPass::CullingPass(VkDevice d, MemoryAllocator* a, VkBuffer objects, uint32_t count, VkPipelineCache cache, PFN_vkCmdDrawIndexedIndirectCountKHR drawIndirectCount, bool occlusionCulling, uint32_t slots, uint32_t familyCount, const uint32_t* families)
+{
+	device = d;
+	allocator = a;
+	objectCount = count;
+	slotCount = slots;
+	fpCmdDrawIndexedIndirectCountKHR = drawIndirectCount;
+	occlusion = occlusionCulling;
+	hasPreviousMvp = false;
+	pyramidLayout = VK_NULL_HANDLE;
+	occlusionBuffer = nullptr;
+
+	// The draw buffer has room for every object, even though
+	// only the visible objects are written. The compute shader
+	// writes to it (STORAGE), the GPU reads draws from it (INDIRECT),
+	// and we clear it with vkCmdFillBuffer (TRANSFER_DST).
+	// If it is written on a compute queue, and drawn from on the
+	// graphics queue, both families share it (CONCURRENT)
+	drawSliceSize = objectCount * sizeof(VkDrawIndexedIndirectCommand);
+	drawSliceSize = (drawSliceSize + CULL_SLICE_ALIGNMENT - 1) & ~(VkDeviceSize)(CULL_SLICE_ALIGNMENT - 1);
+
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.size = drawSliceSize * slotCount;
+
+	if (familyCount > 1)
+	{
+		info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		info.queueFamilyIndexCount = familyCount;
+		info.pQueueFamilyIndices = families;
+	}
+
+	drawBuffer = new BufferGPU(device, allocator, info);
+	drawBuffer->SetName("Culling draws");
+
+	// The count buffer is one integer for each slot, the number of draws
+	info.size = CULL_SLICE_ALIGNMENT * slotCount;
+	countBuffer = new BufferGPU(device, allocator, info);
+	countBuffer->SetName("Culling draw count");
+
+	// With occlusion culling, the MVP of the last frame is copied
+	// into this buffer before the shader runs (TRANSFER_DST)
+	uint32_t bindingCount = 3;
+
+	if (occlusion)
+	{
+		info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		info.size = sizeof(OcclusionConstants);
+		info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		info.queueFamilyIndexCount = 0;
+		info.pQueueFamilyIndices = NULL;
+		occlusionBuffer = new BufferGPU(device, allocator, info);
+		occlusionBuffer->SetName("Culling last MVP");
+		bindingCount = 4;
+	}
+
+	// The shader has three storage buffers, the objects, the
+	// draws, and the count, at bindings 0, 1, and 2, and
+	// the uniform buffer of occlusion culling at binding 3.
+	// The draws and the count are DYNAMIC, the slot's slice
+	// is picked with an offset when the set is bound
+	VkDescriptorSetLayoutBinding bindings[4];
+	memset(bindings, 0, sizeof(bindings));
+
+	for (uint32_t i = 0; i < bindingCount; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = (i < 3) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = bindingCount;
+	layoutInfo.pBindings = bindings;
+	vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &descLayout);
+
+	// The pyramid is in a second set, because it is made
+	// again when the window is resized, and this set is not
+	if (occlusion)
+	{
+		VkDescriptorSetLayoutBinding pyramidBinding = {};
+		pyramidBinding.binding = 0;
+		pyramidBinding.descriptorCount = 1;
+		pyramidBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		pyramidBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &pyramidBinding;
+		vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &pyramidLayout);
+	}
+
+	// This pass has its own pool, with one set
+	// that holds three storage buffers (and a uniform buffer)
+	VkDescriptorPoolSize poolSizes[3];
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	poolSizes[1].descriptorCount = 2;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[2].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = occlusion ? 3 : 2;
+	poolInfo.pPoolSizes = poolSizes;
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &descPool);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &descLayout;
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, &descSet);
+
+	VkDescriptorBufferInfo bufferInfo[4] = {};
+	bufferInfo[0].buffer = objects;
+	bufferInfo[0].range = VK_WHOLE_SIZE;
+	bufferInfo[1].buffer = drawBuffer->buffer;
+	bufferInfo[1].range = drawSliceSize;
+	bufferInfo[2].buffer = countBuffer->buffer;
+	bufferInfo[2].range = sizeof(uint32_t);
+
+	if (occlusion)
+	{
+		bufferInfo[3].buffer = occlusionBuffer->buffer;
+		bufferInfo[3].range = VK_WHOLE_SIZE;
+	}
+
+	VkWriteDescriptorSet writes[4];
+	memset(writes, 0, sizeof(writes));
+
+	for (uint32_t i = 0; i < bindingCount; i++)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = descSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = bindings[i].descriptorType;
+		writes[i].pBufferInfo = &bufferInfo[i];
+	}
+
+	DeviceTable::UpdateDescriptorSets(device, bindingCount, writes, 0, NULL);
+
+	// The frustum planes and the number of
+	// objects are given with push constants
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(CullConstants);
+
+	VkDescriptorSetLayout setLayouts[2] = { descLayout, pyramidLayout };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = occlusion ? 2 : 1;
+	pipelineLayoutInfo.pSetLayouts = setLayouts;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &pipelineLayoutInfo, HostAllocator::callbacks, &pipelineLayout);
+
+	// Compute Shader compiled to header, see compileShaders.cmd.
+	// The occlusion shader is the same, with the pyramid test
+	const unsigned char cs_code[] = {
+		#include "cube_cull.comp.inc"
+	};
+
+	const unsigned char cs_occlusion_code[] = {
+		#include "cube_cull_hiz.comp.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = occlusion ? (uint32_t*)cs_occlusion_code : (uint32_t*)cs_code;
+	shaderInfo.codeSize = occlusion ? sizeof(cs_occlusion_code) : sizeof(cs_code);
+
+	VkShaderModule module;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &module);
+
+	// A compute pipeline only has one stage,
+	// so it is much smaller than a graphics pipeline
+	VkComputePipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeInfo.stage.module = module;
+	pipeInfo.stage.pName = "main";
+	pipeInfo.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the culling pipeline\n", "Pipeline Failure");
+	}
+
+	// the pipeline keeps the shader, so
+	// we do not need the module anymore
+	vkDestroyShaderModule(device, module, HostAllocator::callbacks);
+}
+
+CullingPass::~CullingPass()
+{
+	vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+
+	// destroying the pool also frees the set
+	vkDestroyDescriptorPool(device, descPool, HostAllocator::callbacks);
+	vkDestroyDescriptorSetLayout(device, descLayout, HostAllocator::callbacks);
+
+	if (pyramidLayout != VK_NULL_HANDLE)
+		vkDestroyDescriptorSetLayout(device, pyramidLayout, HostAllocator::callbacks);
+
+	delete drawBuffer;
+	delete countBuffer;
+	delete occlusionBuffer;
+}
+
+// This must be recorded outside of a render pass,
+// before the render pass that calls Draw
+void CullingPass::Cull(VkCommandBuffer cmd, uint32_t slot, glm::mat4x4 mvp, uint32_t indexCount, uint32_t firstIndex, uint32_t firstObject, HiZPyramid* pyramid)
+{
+	// The frame graph already waited for the draws of the last frame
+	// to read the buffers, and for the last culling pass to read the
+	// last MVP (see Demo::record_cmd), so the buffers can be written
+
+	// The objects are tested against the pyramid with the MVP that
+	// drew it, which is the one that the last frame was culled with
+	bool testOcclusion = occlusion && hasPreviousMvp && pyramid != nullptr && pyramid->ready;
+
+	if (testOcclusion)
+	{
+		OcclusionConstants occlusionConstants;
+		occlusionConstants.viewProj = previousMvp;
+		DeviceTable::CmdUpdateBuffer(cmd, occlusionBuffer->buffer, 0, sizeof(OcclusionConstants), &occlusionConstants);
+	}
+
+	previousMvp = mvp;
+	hasPreviousMvp = true;
+
+	// Set the count to zero, the shader adds one for every
+	// visible object. Without vkCmdDrawIndexedIndirectCountKHR,
+	// every draw in the buffer is used, so we clear all of them,
+	// and the draws of hidden objects draw zero instances
+	VkDeviceSize drawOffset = slot * drawSliceSize;
+	VkDeviceSize countOffset = slot * CULL_SLICE_ALIGNMENT;
+
+	DeviceTable::CmdFillBuffer(cmd, countBuffer->buffer, countOffset, sizeof(uint32_t), 0);
+
+	if (fpCmdDrawIndexedIndirectCountKHR == NULL)
+		DeviceTable::CmdFillBuffer(cmd, drawBuffer->buffer, drawOffset, drawSliceSize, 0);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+
+	// Get the six planes of the view frustum from the MVP
+	// matrix, the same way as the CPU culling does. The planes
+	// are in the same space as the objects, because the MVP
+	// includes the model matrix
+	CullConstants constants = {};
+	ExtractFrustumPlanes(mvp, constants.planes);
+	constants.objectCount = objectCount;
+	constants.indexCount = indexCount;
+	constants.firstIndex = firstIndex;
+	constants.firstObject = firstObject;
+
+	if (testOcclusion)
+	{
+		constants.depthWidth = pyramid->depthWidth;
+		constants.depthHeight = pyramid->depthHeight;
+		constants.pyramidLevels = pyramid->levels;
+		constants.occlusionEnabled = 1;
+	}
+
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	uint32_t dynamicOffsets[2] = { (uint32_t)drawOffset, (uint32_t)countOffset };
+	DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descSet, 2, dynamicOffsets);
+
+	// the occlusion shader uses the pyramid's set, even
+	// in a frame where occlusionEnabled is 0, so it is
+	// always bound (the pyramid is always in GENERAL)
+	if (occlusion)
+		DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1, &pyramid->cullSet, 0, NULL);
+	DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+
+	// one invocation for every object
+	DeviceTable::CmdDispatch(cmd, (objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+	// The draws cannot be read until the shader is finished,
+	// the frame graph waits for that, before the render pass
+}
+
+// This is recorded inside the render pass, after the
+// pipeline, vertex buffers, and index buffer are bound
+void CullingPass::Draw(VkCommandBuffer cmd, uint32_t slot)
+{
+	VkDeviceSize drawOffset = slot * drawSliceSize;
+
+	// The GPU reads the number of draws from the count buffer,
+	// so the CPU never needs to know how many objects are visible
+	if (fpCmdDrawIndexedIndirectCountKHR != NULL)
+	{
+		fpCmdDrawIndexedIndirectCountKHR(cmd,
+			drawBuffer->buffer, drawOffset,
+			countBuffer->buffer, slot * CULL_SLICE_ALIGNMENT,
+			objectCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+	// Otherwise, draw every command in the buffer,
+	// the hidden objects were cleared to zero instances
+	else
+	{
+		DeviceTable::CmdDrawIndexedIndirect(cmd, drawBuffer->buffer, drawOffset, objectCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
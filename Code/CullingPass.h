@@ -0,0 +1,143 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "BufferGPU.h"
+#include "MemoryAllocator.h"
+#include "HiZPyramid.h"
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+// the number of objects that are tested by each
+// workgroup of the culling shader (local_size_x)
+#define CULL_WORKGROUP_SIZE 64
+
+// Each slot has its own draws and count, at offsets that are a multiple
+// of this, which is the largest minStorageBufferOffsetAlignment allowed
+#define CULL_SLICE_ALIGNMENT 256
+
+// This is given to the culling shader with push constants,
+// it must match CullVals in cube_cull.comp
+struct CullConstants
+{
+	glm::vec4 planes[6];
+	uint32_t objectCount;
+
+	// the range of the index buffer that every draw uses,
+	// which is the level of detail of the objects
+	uint32_t indexCount;
+	uint32_t firstIndex;
+
+	// the first object of this frame's slice of the objects buffer
+	uint32_t firstObject;
+
+	// the depth pyramid of the last frame, for occlusion
+	// culling, which is only used if occlusionEnabled is 1
+	uint32_t depthWidth;
+	uint32_t depthHeight;
+	uint32_t pyramidLevels;
+	uint32_t occlusionEnabled;
+};
+
+// This is in a uniform buffer, because the push constants are
+// full, it must match OcclusionVals in cube_cull_hiz.comp
+struct OcclusionConstants
+{
+	glm::mat4 viewProj;
+};
+
+// Tests every object against the view frustum with a compute
+// shader, and writes one VkDrawIndexedIndirectCommand for every
+// object that is visible, so that the CPU never has to look at
+// the objects, no matter how many objects there are.
+// With occlusion culling, the objects that are in the frustum
+// are also tested against the depth pyramid of the last frame
+// (see HiZPass), so the objects behind other objects are not drawn
+class CullingPass
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+	uint32_t objectCount;
+
+	// one slice of drawBuffer and countBuffer for each slot
+	uint32_t slotCount;
+	VkDeviceSize drawSliceSize;
+
+	// if this is NULL, VK_KHR_draw_indirect_count is not supported
+	PFN_vkCmdDrawIndexedIndirectCountKHR fpCmdDrawIndexedIndirectCountKHR;
+
+	VkDescriptorSetLayout descLayout;
+	VkDescriptorPool descPool;
+	VkDescriptorSet descSet;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	// The depth pyramid was drawn with the MVP of the last
+	// frame, so the objects are projected with that one.
+	// The first frame has no last frame, so it is not culled
+	bool occlusion;
+	glm::mat4x4 previousMvp;
+	bool hasPreviousMvp;
+
+public:
+	// the set layout that every pyramid allocates its
+	// cullSet with, VK_NULL_HANDLE without occlusion
+	VkDescriptorSetLayout pyramidLayout;
+
+	// the MVP of the last frame, written with vkCmdUpdateBuffer
+	BufferGPU* occlusionBuffer;
+
+	// one draw command for every object, and the number of draws,
+	// for each slot, so that async compute can cull one frame while
+	// the graphics queue still draws the one before it
+	BufferGPU* drawBuffer;
+	BufferGPU* countBuffer;
+
+	CullingPass(
+		VkDevice d,
+		MemoryAllocator* a,
+		VkBuffer objects,
+		uint32_t count,
+		VkPipelineCache cache,
+		PFN_vkCmdDrawIndexedIndirectCountKHR drawIndirectCount,
+		bool occlusionCulling,
+		uint32_t slots = 1,
+		uint32_t familyCount = 0,
+		const uint32_t* families = NULL);
+
+	~CullingPass();
+
+	// The pyramid is only used if it is ready, and it must be nullptr
+	// without occlusion culling. The barriers before and after the pass
+	// come from the frame graph, it writes drawBuffer and countBuffer
+	// at TRANSFER and COMPUTE_SHADER, and occlusionBuffer at TRANSFER.
+	// Without occlusion, this can be recorded on a compute queue
+	void Cull(VkCommandBuffer cmd, uint32_t slot, glm::mat4x4 mvp, uint32_t indexCount, uint32_t firstIndex, uint32_t firstObject, HiZPyramid* pyramid = nullptr);
+	void Draw(VkCommandBuffer cmd, uint32_t slot);
+};
@@ -0,0 +1,83 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "DebugUtils.h"
+#include <stdio.h>
+
+// Nothing in here is compiled in release builds,
+// because nothing calls it, see DEBUG_UTILS_ENABLED
+#ifdef DEBUG_UTILS_ENABLED
+
+PFN_vkSetDebugUtilsObjectNameEXT DebugUtils::fpSetDebugUtilsObjectNameEXT = NULL;
+PFN_vkCmdBeginDebugUtilsLabelEXT DebugUtils::fpCmdBeginDebugUtilsLabelEXT = NULL;
+PFN_vkCmdEndDebugUtilsLabelEXT DebugUtils::fpCmdEndDebugUtilsLabelEXT = NULL;
+
+void DebugUtils::Init(VkInstance inst)
+{
+	// debug utils is an instance extension, so the functions come from
+	// the instance, even the ones that take a device or a command buffer
+	fpSetDebugUtilsObjectNameEXT = (PFN_vkSetDebugUtilsObjectNameEXT)vkGetInstanceProcAddr(inst, "vkSetDebugUtilsObjectNameEXT");
+	fpCmdBeginDebugUtilsLabelEXT = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(inst, "vkCmdBeginDebugUtilsLabelEXT");
+	fpCmdEndDebugUtilsLabelEXT = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(inst, "vkCmdEndDebugUtilsLabelEXT");
+}
+
+void DebugUtils::SetName(VkDevice device, VkObjectType type, uint64_t handle, const char* name)
+{
+	if (fpSetDebugUtilsObjectNameEXT == NULL || handle == 0)
+		return;
+
+	// the driver copies the name, so it
+	// does not need to live after this
+	VkDebugUtilsObjectNameInfoEXT info = {};
+	info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+	info.objectType = type;
+	info.objectHandle = handle;
+	info.pObjectName = name;
+	fpSetDebugUtilsObjectNameEXT(device, &info);
+}
+
+void DebugUtils::BeginLabel(VkCommandBuffer cmd, const char* name)
+{
+	if (fpCmdBeginDebugUtilsLabelEXT == NULL)
+		return;
+
+	// Every command between BeginLabel and EndLabel is shown in
+	// a group with this name. The color is left at zero, which
+	// lets the tool pick one
+	VkDebugUtilsLabelEXT label = {};
+	label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+	label.pLabelName = name;
+	fpCmdBeginDebugUtilsLabelEXT(cmd, &label);
+}
+
+void DebugUtils::EndLabel(VkCommandBuffer cmd)
+{
+	if (fpCmdEndDebugUtilsLabelEXT == NULL)
+		return;
+
+	fpCmdEndDebugUtilsLabelEXT(cmd);
+}
+
+#endif
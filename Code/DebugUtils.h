@@ -0,0 +1,66 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <stdint.h>
+
+// Debug builds give names to Vulkan objects, and labels to parts of
+// the command buffers, with VK_EXT_debug_utils. RenderDoc, Nsight, and
+// Radeon GPU Profiler show these names, instead of "Buffer 0x1F3A...".
+// In release builds, every DEBUG_ macro is nothing, so it costs nothing
+#ifdef _DEBUG
+#define DEBUG_UTILS_ENABLED
+#endif
+
+#ifdef DEBUG_UTILS_ENABLED
+#define DEBUG_NAME(device, type, handle, name) DebugUtils::SetName(device, type, (uint64_t)(handle), name)
+#define DEBUG_LABEL_BEGIN(cmd, name) DebugUtils::BeginLabel(cmd, name)
+#define DEBUG_LABEL_END(cmd) DebugUtils::EndLabel(cmd)
+#else
+#define DEBUG_NAME(device, type, handle, name) ((void)0)
+#define DEBUG_LABEL_BEGIN(cmd, name) ((void)0)
+#define DEBUG_LABEL_END(cmd) ((void)0)
+#endif
+
+// The functions of the extension are the same for every device
+// and every thread, so they are kept in one place. If the extension
+// was not enabled, the function pointers are NULL, and nothing happens
+class DebugUtils
+{
+private:
+	static PFN_vkSetDebugUtilsObjectNameEXT fpSetDebugUtilsObjectNameEXT;
+	static PFN_vkCmdBeginDebugUtilsLabelEXT fpCmdBeginDebugUtilsLabelEXT;
+	static PFN_vkCmdEndDebugUtilsLabelEXT fpCmdEndDebugUtilsLabelEXT;
+
+public:
+	// called after the instance is made with VK_EXT_debug_utils
+	static void Init(VkInstance inst);
+
+	static void SetName(VkDevice device, VkObjectType type, uint64_t handle, const char* name);
+	static void BeginLabel(VkCommandBuffer cmd, const char* name);
+	static void EndLabel(VkCommandBuffer cmd);
+};
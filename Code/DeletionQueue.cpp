@@ -0,0 +1,132 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "DeletionQueue.h"
+#include "HostAllocator.h"
+#include <stdio.h>
+
+// Frames are submitted in order, and they finish in order, so the
+// objects that were retired first are always the first ones that can
+// be destroyed. BeginFrame only looks at the front of the queue, and
+// stops at the first object that a frame on the GPU might still use
+
+DeletionQueue::DeletionQueue(VkDevice d)
+{
+	device = d;
+}
+
+DeletionQueue::~DeletionQueue()
+{
+	Flush();
+}
+
+void DeletionQueue::Retire(VkObjectType type, uint64_t handle, uint64_t frame)
+{
+	// there is nothing to destroy
+	if (handle == 0)
+		return;
+
+	RetiredObject object;
+	object.retireFrame = frame;
+	object.type = type;
+	object.handle = handle;
+	objects.push_back(object);
+}
+
+void DeletionQueue::Retire(std::function<void()> destroy, uint64_t frame)
+{
+	RetiredObject object;
+	object.retireFrame = frame;
+	object.type = VK_OBJECT_TYPE_UNKNOWN;
+	object.handle = 0;
+	object.destroy = destroy;
+	objects.push_back(object);
+}
+
+void DeletionQueue::Destroy(RetiredObject& object)
+{
+	const VkAllocationCallbacks* callbacks = HostAllocator::callbacks;
+
+	switch (object.type)
+	{
+	case VK_OBJECT_TYPE_BUFFER:
+		vkDestroyBuffer(device, (VkBuffer)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_IMAGE:
+		vkDestroyImage(device, (VkImage)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_IMAGE_VIEW:
+		vkDestroyImageView(device, (VkImageView)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_FRAMEBUFFER:
+		vkDestroyFramebuffer(device, (VkFramebuffer)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_SAMPLER:
+		vkDestroySampler(device, (VkSampler)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_PIPELINE:
+		vkDestroyPipeline(device, (VkPipeline)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+		vkDestroyPipelineLayout(device, (VkPipelineLayout)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_SHADER_MODULE:
+		vkDestroyShaderModule(device, (VkShaderModule)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+		vkDestroyDescriptorPool(device, (VkDescriptorPool)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:
+		vkDestroyDescriptorSetLayout(device, (VkDescriptorSetLayout)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_RENDER_PASS:
+		vkDestroyRenderPass(device, (VkRenderPass)object.handle, callbacks);
+		break;
+	case VK_OBJECT_TYPE_UNKNOWN:
+		object.destroy();
+		break;
+	default:
+		printf("DeletionQueue can not destroy objects of type %d\n", (int)object.type);
+		break;
+	}
+}
+
+void DeletionQueue::BeginFrame(uint64_t completedFrames)
+{
+	while (!objects.empty() && objects.front().retireFrame <= completedFrames)
+	{
+		Destroy(objects.front());
+		objects.pop_front();
+	}
+}
+
+void DeletionQueue::Flush()
+{
+	while (!objects.empty())
+	{
+		Destroy(objects.front());
+		objects.pop_front();
+	}
+}
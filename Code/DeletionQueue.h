@@ -0,0 +1,86 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <stdint.h>
+#include <deque>
+#include <functional>
+
+// One thing that is waiting to be destroyed. Vulkan objects are kept as
+// their type and handle, so retiring them does not allocate, anything
+// else (a swapchain, or a class that owns many objects) is a function
+struct RetiredObject
+{
+	// frames before this one might still use it
+	uint64_t retireFrame;
+
+	VkObjectType type;
+	uint64_t handle;
+
+	// used when type is VK_OBJECT_TYPE_UNKNOWN
+	std::function<void()> destroy;
+};
+
+// Destroying anything that a frame on the GPU might still use means
+// waiting for the GPU first. Instead, whatever is not needed anymore is
+// retired here, with the number of frames that were submitted so far,
+// and BeginFrame destroys it when the fences (or the timeline) say
+// that those frames are done. The GPU never has to be idle for it.
+// Things are destroyed in the order that they were retired, so a view
+// that is retired before its image is also destroyed before it
+class DeletionQueue
+{
+private:
+	VkDevice device;
+	std::deque<RetiredObject> objects;
+
+	void Destroy(RetiredObject& object);
+
+public:
+	DeletionQueue(VkDevice d);
+
+	// the device has to be idle, see Flush
+	~DeletionQueue();
+
+	// Buffers, images, views, framebuffers, samplers, pipelines, pipeline
+	// layouts, shader modules, descriptor pools, descriptor set layouts,
+	// and render passes. Frames before frame might still use the handle
+	void Retire(VkObjectType type, uint64_t handle, uint64_t frame);
+
+	// anything else, destroy runs when the frames before frame are done
+	void Retire(std::function<void()> destroy, uint64_t frame);
+
+	// the first completedFrames frames are done on the GPU, so
+	// everything that only they could use is destroyed now
+	void BeginFrame(uint64_t completedFrames);
+
+	// Destroys everything. The caller has to have waited
+	// for every frame, like the destructor of the demo
+	void Flush();
+
+	uint32_t GetCount() { return (uint32_t)objects.size(); }
+};
@@ -23,32 +23,27 @@ that utilizes Vulkan, see more at http://cemu.info
 */
 
 #include "Demo.h"
+#include "HostAllocator.h"
+#include "LargePages.h"
+#include "DeviceTable.h"
 
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <float.h>
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
 #include <signal.h>
 #include <vector>
-
-#define STBI_ONLY_PNG
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <algorithm>
 
 #include "Helper.h"
 #include "Main.h"
 #include "CubeDataArrays.h"
 
-// This boolean keeps track of how many times we have executed the
-// "prepare()" function. If we have never used the function before
-// then we know we are initializing the program for the first time,
-// if the boolean is false, then we know the program has already
-// been initialized
-bool firstInit = true;
-
 // The structure of data
 // that is given to the
 // uniform buffer
@@ -58,6 +53,10 @@ struct uniform_struct
 	// projection matrices, all
 	// multiplied together into one matrix
 	glm::mat4x4 mvp;
+
+	// x is the time of this frame in seconds,
+	// for GPU animation, see cube_animated.vert
+	glm::vec4 time;
 };
 
 // The structure of each Vertex
@@ -72,6 +71,21 @@ struct VertexStructure
 	float uv[2];
 };
 
+// The same vertex, in 12 bytes instead of 20.
+// The position is three 16-bit floats ("half" floats),
+// the fourth one is only padding, because 16-bit formats
+// with three channels are not supported as vertex input
+// on a lot of GPUs. The UV is two 16-bit UNORM numbers,
+// where 0 means 0.0 and 65535 means 1.0, which is perfect
+// for UVs that are between 0 and 1. The GPU turns both into
+// normal floats before the vertex shader sees them, so
+// the shader does not change at all
+struct CompactVertexStructure
+{
+	uint16_t position[4];
+	uint16_t uv[2];
+};
+
 void Demo::prepare_console()
 {
 	// This line is commented out,
@@ -125,6 +139,14 @@ void Demo::prepare_window()
 	// while the program loads
 	strncpy(name, "Loading...", APP_NAME_STR_LEN);
 
+	// in headless mode, nobody would see the window
+	if (window_mode == WINDOW_MODE_HEADLESS)
+	{
+		window = NULL;
+		window_monitor = NULL;
+		return;
+	}
+
 	WNDCLASSEX win_class = {};
 
 	// Initialize the window class structure:
@@ -148,8 +170,9 @@ void Demo::prepare_window()
 	// we can use win_class to make a window
 
 	// If the function fails to register win_class
-	// then give an error
-	if (!RegisterClassEx(&win_class))
+	// then give an error. With "-contexts", the first
+	// Demo registered it already, which is fine
+	if (!RegisterClassEx(&win_class) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
 	{
 		// It didn't work, so try to give a useful error:
 		printf("Unexpected error trying to start the application!\n");
@@ -169,26 +192,52 @@ void Demo::prepare_window()
 	// DirectX 11 sometimes does, is organize
 	// all parameters into a structure, and then
 	// pass the structure as one parameter
-	window = CreateWindowEx(0,
-		name,            // class name
-		name,            // app name
-		WS_OVERLAPPEDWINDOW |  // window style
-		WS_VISIBLE | WS_SYSMENU,
-
-		// The position (0,0) is the top-left
-		// corner of the screen, which is where
-		// the command prompt is, and the command 
-		// prompt is 640 pixels wide, so lets put
-		// the Vulkan window right next to the console window
-		640, 0,				 // (x,y) position
-		wr.right - wr.left,  // width
-		wr.bottom - wr.top,  // height
-		NULL,                // handle to parent, no parent exists
-
-		// This would give you "File" "Edit" "Help", etc
-		NULL,                // handle to menu, no menu exists
-		(HINSTANCE)0,		 // no hInstance
-		NULL);               // no extra parameters
+
+	// The fullscreen modes cover the whole primary monitor, with a
+	// popup window, which has no border and no title bar. A window
+	// that covers the monitor exactly, with nothing on top of it, is
+	// shown with independent flip, the swapchain image goes right to
+	// the monitor, without being copied into the desktop first
+	window_monitor = MonitorFromPoint(POINT{ 0, 0 }, MONITOR_DEFAULTTOPRIMARY);
+
+	if (window_mode != WINDOW_MODE_WINDOWED)
+	{
+		MONITORINFO monitorInfo = {};
+		monitorInfo.cbSize = sizeof(MONITORINFO);
+		GetMonitorInfo(window_monitor, &monitorInfo);
+
+		width = monitorInfo.rcMonitor.right - monitorInfo.rcMonitor.left;
+		height = monitorInfo.rcMonitor.bottom - monitorInfo.rcMonitor.top;
+
+		window = CreateWindowEx(0, name, name,
+			WS_POPUP | WS_VISIBLE,
+			monitorInfo.rcMonitor.left, monitorInfo.rcMonitor.top,
+			width, height,
+			NULL, NULL, (HINSTANCE)0, NULL);
+	}
+	else
+	{
+		window = CreateWindowEx(0,
+			name,            // class name
+			name,            // app name
+			WS_OVERLAPPEDWINDOW |  // window style
+			WS_VISIBLE | WS_SYSMENU,
+
+			// The position (0,0) is the top-left
+			// corner of the screen, which is where
+			// the command prompt is, and the command 
+			// prompt is 640 pixels wide, so lets put
+			// the Vulkan window right next to the console window
+			640, 0,				 // (x,y) position
+			wr.right - wr.left,  // width
+			wr.bottom - wr.top,  // height
+			NULL,                // handle to parent, no parent exists
+
+			// This would give you "File" "Edit" "Help", etc
+			NULL,                // handle to menu, no menu exists
+			(HINSTANCE)0,		 // no hInstance
+			NULL);               // no extra parameters
+	}
 
 	// if we failed to make the window
 	// then give an error that the window failed
@@ -223,31 +272,42 @@ void Demo::prepare_instance()
 	// as fast, but layers can still be very helpful, or even
 	// simplify the programming process
 
-	// In this case, we want the "Khronos Validation Layer".
+	// In this case, we can have the "Khronos Validation Layer".
 	// Just like an HTML validation (which you may have used if you
 	// made a website), the Vulkan validator will check our code for us,
 	// and tell us if it thinks we've made any mistakes. This layer
-	// can be disabled when development of a project is finished
-	char *instance_validation_layer = "VK_LAYER_KHRONOS_validation";
+	// can be disabled when development of a project is finished.
+	// api_dump prints every Vulkan call that we make, and monitor
+	// shows the frame rate in the title of the window. They are all
+	// in the Bin folder, and Visual Studio sets VK_LAYER_PATH to it
+	const char* layer_names[3] = {
+		"VK_LAYER_KHRONOS_validation",
+		"VK_LAYER_LUNARG_api_dump",
+		"VK_LAYER_LUNARG_monitor"
+	};
+
+	// these are in the same order as layer_names
+	const uint32_t layer_bits[3] = { LAYER_VALIDATION, LAYER_API_DUMP, LAYER_MONITOR };
 
 	// our window is not minimized
 	is_minimized = false;
+	swapchain_extent = {};
+	swapchain_stale = false;
 
-	// We have one validation layer that we want to enable,
-	// but we do not know if the layer is supported on the
-	// computer that is running the software, so lets quickly
-	// find out if it is supported
-
-	// we create a boolean to see if we found the layer
-	VkBool32 validation_found = 0;
+	// no layers are enabled yet
+	enabled_layer_count = 0;
 
-	// only enable validation if the validate bool
-	// is true. This boolean was set to true in init().
-	// This is set to true or false by the programmer, it
-	// does not depend on anything. It should be set to true
-	// during development, and set to false when it is time 
-	// to release the software
-	if (validate)
+	// We have some layers that we might want to enable,
+	// but we do not know if the layers are supported on the
+	// computer that is running the software, so lets quickly
+	// find out if they are supported
+
+	// only look for layers if we want any. layer_flags was
+	// set by the command line, or by the environment (see Main.cpp).
+	// With no layers, our code speaks directly to the driver, so there
+	// is nothing in between that costs time, and we never install a
+	// debug callback, so nothing runs on the hot path either
+	if (layer_flags != 0)
 	{
 		// set the number of instance layers to zero
 		// This is the number of total layers supported by 
@@ -279,75 +339,58 @@ void Demo::prepare_instance()
 		// get number of instance layers supported by the GPU
 		vkEnumerateInstanceLayerProperties(&total_instance_layers, NULL);
 
+		// Create an array that can hold the properties of every layer available
+		// The properties of each layer (VkLayerProperties) will tell us 
+		// the name of the layer, the version, and even a description of the layer
+		std::vector<VkLayerProperties> instance_layers(total_instance_layers);
+
+		// call vkEnumerateInstanceLayerProperties for the 2nd time,
+		// get the properties of all instance layers that are available
 		if (total_instance_layers > 0)
+			vkEnumerateInstanceLayerProperties(&total_instance_layers, instance_layers.data());
+
+		// If you did not understand the last three lines, please read the comments again.
+		// This pattern WILL be used several times, maybe over 10 times, throughout the
+		// course of the program
+
+		// For every layer that we want, check all the available layers to
+		// see if it is supported. We are checking each layer to see if the
+		// name of each layer is equal to the name of the layer we want
+		for (uint32_t i = 0; i < 3; i++)
 		{
-			// Create an array that can hold the properties of every layer available
-			// The properties of each layer (VkLayerProperties) will tell us 
-			// the name of the layer, the version, and even a description of the layer
-			VkLayerProperties* instance_layers = new VkLayerProperties[total_instance_layers];
-
-			// call vkEnumerateInstanceLayerProperties for the 2nd time,
-			// get the properties of all instance layers that are available
-			vkEnumerateInstanceLayerProperties(&total_instance_layers, instance_layers);
-
-			// If you did not understand the last three lines, please read the comments again.
-			// This pattern WILL be used several times, maybe over 10 times, throughout the
-			// course of the program
-
-			// out of all the available layers,
-			// check all the layers to see if the Khronos Validation Layer is supported.
-			// We are checking each layer to see if the name of each layer is equal
-			// to the name of the layer we want. If the layer we want is on the list
-			// of supported layers, then we can use the validation layer, which we 
-			// set at the beginning of the function
+			if (!(layer_flags & layer_bits[i]))
+				continue;
+
+			bool found = false;
+
 			for (uint32_t j = 0; j < total_instance_layers; j++)
 			{
 				// check to see if this layer has the same name as the one we want
-				if (!strcmp(instance_validation_layer, instance_layers[j].layerName))
+				if (!strcmp(layer_names[i], instance_layers[j].layerName))
 				{
-					// we found the validation layer, woo!
-					validation_found = 1;
+					found = true;
 					break;
 				}
 			}
 
-			// we set the number of enabled layers to zero.
-			// regardless if we found the validation layer in the 'for'
-			// loop or not, we still have not enabled any layers yet
-			enabled_layer_count = 0;
-
-			// If we found the validation layer
-			if (validation_found)
+			// add our layer to the list of enabled layers. Technically
+			// this layer is still not enabled yet, but it is guarranteed
+			// that it can be enabled successfully, because we just confirmed
+			// that it is supported. It will be enabled by the end of this function
+			if (found)
+				enabled_layers[enabled_layer_count++] = (char*)layer_names[i];
+
+			// A layer that is not installed is not an error, the program
+			// works the same without it, so we let the user know, and go on.
+			// If this happens, check VK_LAYER_PATH, or install the Vulkan SDK
+			else
 			{
-				// then we have one layer that we can enable
-				enabled_layer_count = 1;
-
-				// add our validation layer to the list
-				// of enabled layers. Technically this layer
-				// is still not enabled yet, but it is guarranteed
-				// that it can be enabled successfully, because we
-				// just confirmed that it is supported. Don't worry
-				// though, it will be enabled by the end of this function
-				enabled_layers[0] = instance_validation_layer;
+				printf("%s was not found, it is not enabled\n", layer_names[i]);
+				layer_flags &= ~layer_bits[i];
 			}
-
-			// we dont need the full list of instance layers
-			// we can remove it now that we're done with it
-			free(instance_layers);
 		}
 
-		// if we did not find a validation layer,
-		// or, if we did not find any layers at all
-		if (!validation_found || total_instance_layers <= 0)
-		{
-			// Give the user an error that we failed to find the validation layer.
-			// If this error is found, you can fix it by disabling validate
-			// in init()
-			ERR_EXIT(
-				"vkEnumerateInstanceLayerProperties failed to find required validation layer.\n\n"
-				"Please look at the Getting Started guide for additional information.\n",
-				"vkCreateInstance Failure");
-		}
+		validate = (layer_flags & LAYER_VALIDATION) != 0;
 	}
 
 	// Ok, we're done with layers, now it is time for
@@ -370,11 +413,23 @@ void Demo::prepare_instance()
 	// set a boolean to see if we found the extension that
 	// lets us render to a surface
 	VkBool32 surfaceExtFound = 0;
+	properties2_enabled = false;
+	external_capabilities_enabled = false;
+	device_group_creation_enabled = false;
+	surface_capabilities2_enabled = false;
 
 	// set a boolean to see if we found the extension that
 	// lets us connect a surface to a window
 	VkBool32 platformSurfaceExtFound = 0;
 
+	// both are needed for external memory, and both need properties2
+	bool externalMemoryCapsFound = false;
+	bool externalSemaphoreCapsFound = false;
+
+	// set a boolean to see if we found the extension
+	// that gives names and labels to debuggers
+	VkBool32 debugUtilsExtFound = 0;
+
 	// clear the list of extension names in our "demo" structure
 	memset(extension_names, 0, sizeof(extension_names));
 
@@ -442,6 +497,48 @@ void Demo::prepare_instance()
 				// to the number of extensions that we are enabling
 				extension_names[enabled_extension_count++] = VK_KHR_WIN32_SURFACE_EXTENSION_NAME;
 			}
+
+			// This one is optional, it lets us ask the GPU about features
+			// of device extensions, like present wait (see prepare_physical_device)
+			if (!strcmp(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, instance_extensions[i].extensionName))
+			{
+				properties2_enabled = true;
+				extension_names[enabled_extension_count++] = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
+			}
+
+			// exclusive fullscreen asks the surface if it can
+			// be exclusive, with vkGetPhysicalDeviceSurfaceCapabilities2KHR
+			if (window_mode == WINDOW_MODE_EXCLUSIVE && !strcmp(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME, instance_extensions[i].extensionName))
+			{
+				surface_capabilities2_enabled = true;
+				extension_names[enabled_extension_count++] = VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME;
+			}
+
+			// the device extensions of external memory (and
+			// semaphores) need these, see prepare_physical_device
+			if (use_external_memory && !strcmp(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME, instance_extensions[i].extensionName))
+				externalMemoryCapsFound = true;
+
+			if (use_external_memory && !strcmp(VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME, instance_extensions[i].extensionName))
+				externalSemaphoreCapsFound = true;
+
+			// Device groups are found with vkEnumeratePhysicalDeviceGroupsKHR,
+			// which comes from this extension (see prepare_physical_device)
+			if (use_device_group && !strcmp(VK_KHR_DEVICE_GROUP_CREATION_EXTENSION_NAME, instance_extensions[i].extensionName))
+			{
+				device_group_creation_enabled = true;
+				extension_names[enabled_extension_count++] = VK_KHR_DEVICE_GROUP_CREATION_EXTENSION_NAME;
+			}
+
+#ifdef DEBUG_UTILS_ENABLED
+			// Debug builds give names to objects, and labels to command
+			// buffers, so that profilers and RenderDoc can show them
+			if (!strcmp(VK_EXT_DEBUG_UTILS_EXTENSION_NAME, instance_extensions[i].extensionName))
+			{
+				debugUtilsExtFound = 1;
+				extension_names[enabled_extension_count++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+			}
+#endif
 		}
 
 		// we dont need the full list of instance extensions
@@ -449,10 +546,18 @@ void Demo::prepare_instance()
 		free(instance_extensions);
 	}
 
+	if (use_external_memory && externalMemoryCapsFound && externalSemaphoreCapsFound && properties2_enabled)
+	{
+		external_capabilities_enabled = true;
+		extension_names[enabled_extension_count++] = VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME;
+		extension_names[enabled_extension_count++] = VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME;
+	}
+
 	// If we failed to find the extension that allows us
 	// to send images to the "surface", then let the user
 	// know that this failed
-	if (!surfaceExtFound)
+	// headless mode makes no surface, so it does not need them
+	if (!surfaceExtFound && window_mode != WINDOW_MODE_HEADLESS)
 	{
 		ERR_EXIT("vkEnumerateInstanceExtensionProperties failed to find the " VK_KHR_SURFACE_EXTENSION_NAME
 			" extension.\n\n"
@@ -464,7 +569,7 @@ void Demo::prepare_instance()
 	// If we failed to find the extension that allows the
 	// surface to send an image to the window, then let the user
 	// know that this failed
-	if (!platformSurfaceExtFound)
+	if (!platformSurfaceExtFound && window_mode != WINDOW_MODE_HEADLESS)
 	{
 		ERR_EXIT("vkEnumerateInstanceExtensionProperties failed to find the " VK_KHR_WIN32_SURFACE_EXTENSION_NAME
 			" extension.\n\n"
@@ -539,10 +644,36 @@ void Demo::prepare_instance()
 	inst_info.enabledExtensionCount = enabled_extension_count;
 	inst_info.ppEnabledExtensionNames = (const char *const *)extension_names;
 
+	// Another Demo might have made the instance already (see DeviceContext.h).
+	// It was made with the same options, so it has every extension that we
+	// picked above, and if it does not, the two Demos can not share it
+	InstanceContext* sharedInstance = device_context->instanceContext;
+
+	if (!makes_instance)
+	{
+		for (uint32_t i = 0; i < enabled_extension_count; i++)
+		{
+			if (!sharedInstance->HasExtension(extension_names[i]))
+			{
+				printf("The shared instance was made without %s\n", extension_names[i]);
+				ERR_EXIT("A Demo needs an instance extension that the shared instance does not have.\n",
+					"vkCreateInstance Failure");
+			}
+		}
+
+		inst = sharedInstance->instance;
+
+#ifdef DEBUG_UTILS_ENABLED
+		if (debugUtilsExtFound)
+			DebugUtils::Init(inst);
+#endif
+		return;
+	}
+
 	// Attempt to create a Vulkan Instance with the information provided.
 	// We take the value that this returns, so that we can see if the
 	// instance was created correctly
-	VkResult err = vkCreateInstance(&inst_info, NULL, &inst);
+	VkResult err = vkCreateInstance(&inst_info, HostAllocator::callbacks, &inst);
 
 	// If the function returns a value of -9,
 	// then the driver is not compatible with Vulkan
@@ -577,6 +708,95 @@ void Demo::prepare_instance()
 			"Please look at the Getting Started guide for additional information.\n",
 			"vkCreateInstance Failure");
 	}
+
+	// the Demos that join later use it
+	sharedInstance->instance = inst;
+	sharedInstance->extensions.assign(extension_names, extension_names + enabled_extension_count);
+
+#ifdef DEBUG_UTILS_ENABLED
+	// get the functions that give names and labels
+	if (debugUtilsExtFound)
+		DebugUtils::Init(inst);
+#endif
+}
+
+uint64_t Demo::score_physical_device(VkPhysicalDevice physical_device, bool needsSwapchain)
+{
+	// A GPU that we can use needs a queue family that can draw,
+	// and the swapchain extension (unless it is headless), or
+	// else the score is zero
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, NULL);
+
+	std::vector<VkQueueFamilyProperties> families(family_count);
+
+	if (family_count > 0)
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+	bool graphics = false;
+	bool transferOnly = false;
+
+	for (uint32_t i = 0; i < family_count; i++)
+	{
+		if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			graphics = true;
+		else if (families[i].queueFlags & VK_QUEUE_TRANSFER_BIT)
+			transferOnly = true;
+	}
+
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(physical_device, NULL, &extension_count, NULL);
+
+	std::vector<VkExtensionProperties> extensions(extension_count);
+
+	if (extension_count > 0)
+		vkEnumerateDeviceExtensionProperties(physical_device, NULL, &extension_count, extensions.data());
+
+	bool swapchainExt = false;
+
+	for (uint32_t i = 0; i < extension_count; i++)
+		if (!strcmp(VK_KHR_SWAPCHAIN_EXTENSION_NAME, extensions[i].extensionName))
+			swapchainExt = true;
+
+	if (!graphics || (needsSwapchain && !swapchainExt))
+		return 0;
+
+	// The type of GPU matters the most, a dedicated GPU is almost
+	// always faster than an integrated one, which is faster than
+	// a virtual GPU, or a GPU that is emulated on the CPU
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+	uint64_t score = 1;
+
+	if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+		score += 4ull << 40;
+	else if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU)
+		score += 3ull << 40;
+	else if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU)
+		score += 2ull << 40;
+	else if (properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_CPU)
+		score += 1ull << 40;
+
+	// A queue family that can only copy lets the uploads run next
+	// to the drawing (see prepare_device_queue), which is worth a bit
+	if (transferOnly)
+		score += 1ull << 39;
+
+	// Between GPUs of the same type, the one with the most
+	// VRAM wins (in megabytes, so it can not reach the bits above)
+	VkPhysicalDeviceMemoryProperties memory;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory);
+
+	VkDeviceSize largestHeap = 0;
+
+	for (uint32_t i = 0; i < memory.memoryHeapCount; i++)
+		if ((memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memory.memoryHeaps[i].size > largestHeap)
+			largestHeap = memory.memoryHeaps[i].size;
+
+	score += largestHeap >> 20;
+
+	return score;
 }
 
 void Demo::prepare_physical_device()
@@ -627,18 +847,74 @@ void Demo::prepare_physical_device()
 		// support graphics, some only support compute, there are
 		// a lot of different types of GPUs out there that support Vulkan.
 
-		// If someone wanted to, they could do a search to find which GPU
-		// in the list most powerwful, or they could check for different
-		// properties, but for this simple example, just take 
-		// the first on the list, because that is usually best one
+		// The first GPU on the list is not always the best one, on a
+		// laptop it is often the GPU that is integrated in the CPU.
+		// So every GPU gets a score (see score_physical_device), and
+		// we take the one with the highest score. The VKCUBE_GPU
+		// environment variable picks a GPU by hand, with its number
+		// on the list ("1"), or a part of its name ("Radeon")
+		// A Demo that shares a device takes the GPU of the device, and a
+		// context for one GPU (see DeviceContext::gpuIndex) takes that one
+		const char* gpuEnv = getenv("VKCUBE_GPU");
+		VkPhysicalDevice sharedGpu = device_context->gpu;
+		uint32_t pinnedGpu = device_context->gpuIndex;
+		bool pinned = (sharedGpu != VK_NULL_HANDLE || pinnedGpu != UINT32_MAX);
+		uint32_t best = UINT32_MAX;
+		uint64_t bestScore = 0;
+
+		for (uint32_t i = 0; i < gpu_count; i++)
+		{
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(physical_devices[i], &properties);
+
+			uint64_t score = score_physical_device(physical_devices[i], window_mode != WINDOW_MODE_HEADLESS);
+			printf("GPU %d: %s, score %llu\n", i, properties.deviceName, (unsigned long long)score);
+
+			// a GPU that can not draw to the window can not be picked by hand either
+			if (score == 0)
+				continue;
+
+			if (pinned)
+			{
+				if (physical_devices[i] == sharedGpu || i == pinnedGpu)
+				{
+					best = i;
+					bestScore = UINT64_MAX;
+				}
+			}
+			else if (gpuEnv != nullptr)
+			{
+				bool isNumber = (gpuEnv[0] >= '0' && gpuEnv[0] <= '9');
+
+				if ((isNumber && (uint32_t)atoi(gpuEnv) == i) ||
+					(!isNumber && strstr(properties.deviceName, gpuEnv) != nullptr))
+				{
+					best = i;
+					bestScore = UINT64_MAX;
+				}
+			}
+
+			if (score > bestScore && !pinned)
+			{
+				best = i;
+				bestScore = score;
+			}
+		}
+
+		if (best == UINT32_MAX)
+		{
+			ERR_EXIT(
+				"vkEnumeratePhysicalDevices found no GPU with a graphics queue and the swapchain extension.\n\n"
+				"Do you have a compatible Vulkan installable client driver (ICD) installed?\n"
+				"Please look at the Getting Started guide for additional information.\n",
+				"vkEnumeratePhysicalDevices Failure");
+		}
+
+		if (gpuEnv != nullptr && bestScore != UINT64_MAX && !pinned)
+			printf("VKCUBE_GPU=%s matches no usable GPU\n", gpuEnv);
 
-		// If you have multiple GPUs in your computer, maybe you have
-		// both a dedicated GPU and a GPU integrated in the CPU,
-		// set your dedicated GPU as your default graphics processor
-		// in the Nvidia Control Panel, or AMD Catalayst, or Intel
-		// Graphics Settings, and then that one will be the first
-		// that shows up in the array
-		gpu = physical_devices[0];
+		printf("Using GPU %d\n", best);
+		gpu = physical_devices[best];
 
 		// we do not need all of the devices anymore, we have
 		// the one that we want
@@ -656,6 +932,13 @@ void Demo::prepare_physical_device()
 		// set the title of the window to the name of the GPU,
 		// so that we know we are using the GPU that we want to use
 		SetWindowText(window, features.deviceName);
+
+		// Everything that the tuner picks is used after this, and
+		// the frames in flight are still rounded for a device group
+		if (has_tune_candidate)
+			apply_tuned_settings(tune_candidate);
+		else if (use_auto_tuning && benchmark_frames == 0)
+			tune_settings(features);
 	}
 
 	// If no GPUs were found, then 
@@ -669,6 +952,79 @@ void Demo::prepare_physical_device()
 			"vkEnumeratePhysicalDevices Failure");
 	}
 
+	// Some computers have several GPUs of the same kind that are linked
+	// together (SLI or CrossFire), and the driver shows them as one device
+	// group. One VkDevice is made from all of them, and every frame is drawn
+	// by the next GPU in the group (alternate frame rendering, see draw).
+	// We use the group of the GPU that we picked, or else the first group
+	// that has more than one GPU, and the first GPU of the group is the
+	// one that we ask about extensions and features
+	device_group_devices.clear();
+	device_group_count = 1;
+
+	for (uint32_t i = 0; i < VK_MAX_DEVICE_GROUP_SIZE; i++)
+		device_group_present_device[i] = i;
+
+	if (use_device_group && device_group_creation_enabled)
+	{
+		uint32_t group_count = 0;
+		fpEnumeratePhysicalDeviceGroupsKHR(inst, &group_count, NULL);
+
+		std::vector<VkPhysicalDeviceGroupPropertiesKHR> groups(group_count);
+
+		for (uint32_t i = 0; i < group_count; i++)
+			groups[i].sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GROUP_PROPERTIES_KHR;
+
+		if (group_count > 0)
+			fpEnumeratePhysicalDeviceGroupsKHR(inst, &group_count, groups.data());
+
+		// the group that has the GPU that we picked above is best
+		for (uint32_t i = 0; i < group_count; i++)
+		{
+			if (groups[i].physicalDeviceCount < 2)
+				continue;
+
+			bool hasGpu = std::find(groups[i].physicalDevices,
+				groups[i].physicalDevices + groups[i].physicalDeviceCount, gpu) !=
+				groups[i].physicalDevices + groups[i].physicalDeviceCount;
+
+			if (device_group_devices.empty() || hasGpu)
+				device_group_devices.assign(groups[i].physicalDevices,
+					groups[i].physicalDevices + groups[i].physicalDeviceCount);
+
+			if (hasGpu)
+				break;
+		}
+	}
+
+	if (use_device_group && device_group_devices.empty())
+	{
+		printf("There is no device group with more than one GPU, device groups are disabled\n");
+		use_device_group = false;
+	}
+
+	// Each frame_index always goes to the same GPU (frame_index % device_group_count),
+	// so that the timestamps and fences of a slot are always on the same GPU.
+	// Then frame_lag has to be a multiple of the number of GPUs
+	if (use_device_group)
+	{
+		uint32_t count = (uint32_t)device_group_devices.size();
+		uint32_t lag = ((frame_lag + count - 1) / count) * count;
+
+		if (lag > MAX_FRAME_LAG)
+		{
+			printf("%d GPUs need more than %d frames in flight, device groups are disabled\n", count, MAX_FRAME_LAG);
+			use_device_group = false;
+		}
+		else
+		{
+			gpu = device_group_devices[0];
+			device_group_count = count;
+			frame_lag = lag;
+			printf("Using a device group with %d GPUs, %d frames in flight\n", count, frame_lag);
+		}
+	}
+
 	// When we created the instance, we chose to use some extensions of the instance,
 	// such as the SURFACE and WIN32 extensions. Now, we will enable extensions from
 	// the PhysicalDevice. These extensions will help us with creating the "swapchain".
@@ -679,6 +1035,53 @@ void Demo::prepare_physical_device()
 
 	// by default, we have not found the swapchain extension (yet)
 	VkBool32 swapchainExtFound = 0;
+	draw_indirect_count_supported = false;
+	display_timing_enabled = false;
+	bool timelineExtFound = false;
+	bool presentIdExtFound = false;
+	bool presentWaitExtFound = false;
+	present_wait_enabled = false;
+	present_id_enabled = false;
+	bool nvLowLatencyExtFound = false;
+	bool antiLagExtFound = false;
+	latency_nv_enabled = false;
+	anti_lag_enabled = false;
+	bool calibratedTimestampsExtFound = false;
+	calibrated_timestamps_enabled = false;
+	bool performanceQueryExtFound = false;
+	performance_query_enabled = false;
+	bool descriptorIndexingExtFound = false;
+	bool maintenance3ExtFound = false;
+	update_template_enabled = false;
+	bool pushDescriptorExtFound = false;
+	bool pipelineLibraryExtFound = false;
+	bool graphicsPipelineLibraryExtFound = false;
+	memory_budget_enabled = false;
+	dedicated_allocation_enabled = false;
+	bool memoryRequirements2ExtFound = false;
+	bool dedicatedAllocationExtFound = false;
+	bool deviceGroupExtFound = false;
+	bool dynamicRenderingExtFound = false;
+	bool bufferDeviceAddressExtFound = false;
+	bool depthStencilResolveExtFound = false;
+	bool createRenderpass2ExtFound = false;
+	bool multiviewExtFound = false;
+	bool maintenance2ExtFound = false;
+	bool fragmentShadingRateExtFound = false;
+	bool conditionalRenderingExtFound = false;
+	bool hostImageCopyExtFound = false;
+	bool copyCommands2ExtFound = false;
+	bool formatFeatureFlags2ExtFound = false;
+	bool ycbcrConversionExtFound = false;
+	bool shaderFloat16Int8ExtFound = false;
+	bool maintenance1ExtFound = false;
+	bool bindMemory2ExtFound = false;
+	bool externalMemoryExtFound = false;
+	bool externalMemoryWin32ExtFound = false;
+	bool externalSemaphoreExtFound = false;
+	bool externalSemaphoreWin32ExtFound = false;
+	bool incrementalPresentExtFound = false;
+	bool fullScreenExclusiveExtFound = false;
 
 	// Set the number of enabled_extensions to zero,
 	// and clear the list of extension names. These
@@ -718,2939 +1121,12614 @@ void Demo::prepare_physical_device()
 				// and increment the counter for the number of extensions
 				extension_names[enabled_extension_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
 			}
-		}
 
-		// we do not need the list of extensions anymore,
-		// now that we have already searched through it,
-		// so we can delete it now
-		free(device_extensions);
-	}
+			// The GPU culling pass can tell the GPU how many draws
+			// there are, with a number in a buffer, if this is supported.
+			// It still works without it, it just draws every object,
+			// with zero instances for the objects that are hidden
+			if (use_gpu_culling && !strcmp(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME, device_extensions[i].extensionName))
+			{
+				draw_indirect_count_supported = true;
+				extension_names[enabled_extension_count++] = VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+			}
 
-	// if the swapchain was not found, then give an error and let the
-	// user know that the swapchain could not be found
-	if (!swapchainExtFound)
-	{
-		ERR_EXIT("vkEnumerateDeviceExtensionProperties failed to find the " VK_KHR_SWAPCHAIN_EXTENSION_NAME
-			" extension.\n\nDo you have a compatible Vulkan installable client driver (ICD) installed?\n"
-			"Please look at the Getting Started guide for additional information.\n",
-			"vkCreateInstance Failure");
-	}
-}
+			// Display timing tells us when each image was really put on
+			// the screen, and it lets us ask for a time to present each
+			// image, which we use to keep frames evenly spaced (see draw)
+			if (!strcmp(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME, device_extensions[i].extensionName) &&
+				window_mode != WINDOW_MODE_HEADLESS)
+			{
+				display_timing_enabled = true;
+				extension_names[enabled_extension_count++] = VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME;
+			}
 
-void Demo::prepare_instance_functionPointers()
-{
-	// Almost all functions in Vulkan are built-in to the SDK.
-	// We can access Vulkan functions through a static link (.lib),
-	// or a dynamic link (.dll). However, some Vulkan functions are
-	// not in the SDK, but they are actually inside the Vulkan Driver
-	// itself. To get access to functions that are in the driver,
-	// we need to use the VkInstance to get a pointer to the functions.
+			// timeline semaphores, see prepare_synchronization
+			if (use_timeline_semaphores && !strcmp(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, device_extensions[i].extensionName))
+			{
+				timelineExtFound = true;
+				extension_names[enabled_extension_count++] = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME;
+			}
 
-	// To shorten the code, we use a macro function to help
-	// The macro function GET_INSTANCE_PROC_ADDR is completely optional.
-	// If a student has not learned macro functions, i suggest googling it.
-	// This macro function never needs to be changed, so you can just leave it here
+			// present wait needs present id, both are checked below
+			if (!strcmp(VK_KHR_PRESENT_ID_EXTENSION_NAME, device_extensions[i].extensionName))
+				presentIdExtFound = true;
 
-	// There are 6 function pointers that we need to get from the instance
-	// Without this macro function, we would need to rewrite this over and over:
-	//		fpGetPhysicalDeviceSurfaceSupportKHR = (PFN_vkGetPhysicalDeviceSurfaceSupportKHR)vkGetInstanceProcAddr(inst, "vkGetPhysicalDeviceSurfaceSupportKHR");
-	// and then check to see if each function pointer is null, and then return an error message
+			if (!strcmp(VK_KHR_PRESENT_WAIT_EXTENSION_NAME, device_extensions[i].extensionName))
+				presentWaitExtFound = true;
 
-	// However, because we have the macro, we only need to write
-	// GET_INSTANCE_PROC_ADDR(inst, "name"); for each function pointer that we want
+			// the low latency extensions of NV and AMD, checked below
+			if (!strcmp(VK_NV_LOW_LATENCY_2_EXTENSION_NAME, device_extensions[i].extensionName))
+				nvLowLatencyExtFound = true;
 
-	#define GET_INSTANCE_PROC_ADDR(inst, entrypoint)															\
-    {																											\
-        fp##entrypoint = (PFN_vk##entrypoint)vkGetInstanceProcAddr(inst, "vk" #entrypoint);						\
-        if (fp##entrypoint == NULL)																				\
-		{																										\
-            ERR_EXIT("vkGetInstanceProcAddr failed to find vk" #entrypoint, "vkGetInstanceProcAddr Failure");	\
-        }																										\
-    }
+			if (!strcmp(VK_AMD_ANTI_LAG_EXTENSION_NAME, device_extensions[i].extensionName))
+				antiLagExtFound = true;
 
-	// All of these functions will be used later on in the code,
-	// and they will be thoroughly explained when it is time to use them.
-	GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceSurfaceSupportKHR);
-	GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceSurfaceCapabilitiesKHR);
-	GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceSurfaceFormatsKHR);
-	GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceSurfacePresentModesKHR);
-	GET_INSTANCE_PROC_ADDR(inst, GetSwapchainImagesKHR);
-	GET_INSTANCE_PROC_ADDR(inst, GetDeviceProcAddr);
-}
+			// lines up the GPU timestamps of the trace, checked below
+			if (!strcmp(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME, device_extensions[i].extensionName))
+				calibratedTimestampsExtFound = true;
 
+			// hardware counters, checked below
+			if (!strcmp(VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME, device_extensions[i].extensionName))
+				performanceQueryExtFound = true;
 
-void Demo::prepare_surface()
-{
-	// Create a Surface:
-	// The "surface" is an abstraction layer that sends
-	// a finished image from Vulkan to the screen
+			// bindless textures need descriptor indexing, which
+			// needs maintenance3, both are checked below
+			if (!strcmp(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, device_extensions[i].extensionName))
+				descriptorIndexingExtFound = true;
 
-	// There are lots of different windows that can be used
-	// With Vulkan, there are Win32 windows, GLFW windows, 
-	// there are different windows on iOS, Android, Linux, and Mac.
+			if (!strcmp(VK_KHR_MAINTENANCE3_EXTENSION_NAME, device_extensions[i].extensionName))
+				maintenance3ExtFound = true;
 
-	// The Surface is a middle-man that takes an image that Vulkan
-	// creates (the image we want on the screen), and then the 
-	// surface puts it on the screen
+			// dynamic rendering needs depth stencil resolve, which needs
+			// create renderpass 2, which needs multiview and maintenance2,
+			// all of them are checked below
+			if (!strcmp(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, device_extensions[i].extensionName))
+				dynamicRenderingExtFound = true;
 
-	// Today, we will create a surface by using VkWin32SurfaceCreateInfoKHR,
-	// because we are using a Win32 window, so we will give it the 
-	// necessary sType, and we will give it our window that we just created
-	VkWin32SurfaceCreateInfoKHR createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-	createInfo.hwnd = window;
+			if (!strcmp(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME, device_extensions[i].extensionName))
+				depthStencilResolveExtFound = true;
 
-	// We use the instance we made, and the createInfo (which has
-	// our window) to create a surface.
-	vkCreateWin32SurfaceKHR(inst, &createInfo, NULL, &surface);
+			// vertex pulling reads the vertex buffer through its address
+			if (!strcmp(VK_EXT_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME, device_extensions[i].extensionName))
+				bufferDeviceAddressExtFound = true;
 
-	// Now that we have our surface, we need to find a format that
-	// is supported by (both) the surface, and the GPU. If the 
-	// GPU can only export R8-B8-G8 images, but the surface (which connects
-	// to the window) can only read R16-G16-B16-A16 images, that's bad.
+			if (!strcmp(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, device_extensions[i].extensionName))
+				createRenderpass2ExtFound = true;
 
-	// the number of formats that are suppported by (both) the GPU, and our surface,
-	// will be set to zero by default
-	uint32_t formatCount = 0;
-	
-	// Just like we've seen before, Vulkan has a pattern of calling the same
-	// function twice. First time gets the number of elements, Second time
-	// fills an array with elements
+			if (!strcmp(VK_KHR_MULTIVIEW_EXTENSION_NAME, device_extensions[i].extensionName))
+				multiviewExtFound = true;
 
-	// get the number of formats
-	fpGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &formatCount, NULL);
+			if (!strcmp(VK_KHR_MAINTENANCE2_EXTENSION_NAME, device_extensions[i].extensionName))
+				maintenance2ExtFound = true;
 
-	// create an array of surfaces that can hold the list of formats
-	VkSurfaceFormatKHR *surfFormats = new VkSurfaceFormatKHR[formatCount];
+			// variable rate shading needs create renderpass 2 as well
+			if (!strcmp(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME, device_extensions[i].extensionName))
+				fragmentShadingRateExtFound = true;
 
-	// Get the list of formats
-	fpGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &formatCount, surfFormats);
+			// occlusion queries skip draws with conditional rendering
+			if (!strcmp(VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME, device_extensions[i].extensionName))
+				conditionalRenderingExtFound = true;
 
-	// If there is only one format in the list, and if thath one format
-	// is UNDEFINED, then there is no format that is supported by both
-	// GPU and Surface. That means, we have to take a random guess and
-	// hope we get lucky, so lets go with R8-G8-B8-A8.
-	if (formatCount == 1 && surfFormats[0].format == VK_FORMAT_UNDEFINED)
-	{
-		format = VK_FORMAT_R8G8B8A8_UNORM;
-	}
+			// host image copy needs copy commands 2 and
+			// format feature flags 2, all are checked below
+			if (!strcmp(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME, device_extensions[i].extensionName))
+				hostImageCopyExtFound = true;
 
-	// If we find a format that is supported by the GPU and Surface
-	// then we choose which format we want to use
-	else
-	{
-		// we use an assert statement to make sure
-		// that we have at least one format in the list.
-		// I have never seen this assertion fail, but its
-		// good to have it just in case
-		assert(formatCount >= 1);
+			if (!strcmp(VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME, device_extensions[i].extensionName))
+				copyCommands2ExtFound = true;
 
-		// Out of all the formats that support GPU and Surface,
-		// it really does not matter which one you pick, so lets
-		// just go with the first one. Just like when we had
-		// a list of VkPhysicalDevice, just pick the first one
-		format = surfFormats[0].format;
-	}
+			if (!strcmp(VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME, device_extensions[i].extensionName))
+				formatFeatureFlags2ExtFound = true;
 
-	// Format holds the type of image format that
-	// the monitor can draw, while color_space is the 
-	// type of format that the monitor uses. They sound
-	// similar, but think about how the colors of a 
-	// computer monitor might look a little different 
-	// than a living-room TV or a movie theater. The 
-	// same image with the same "format" on multiple
-	// screens can end up looking a little different.
-	// color_space gives us the format of the monitor,
-	// so that the image can be sent to the monitor correctly
-	color_space = surfFormats[0].colorSpace;
+			// the video texture samples with a YCbCr conversion,
+			// which needs maintenance1 and bind memory 2, checked below
+			if (!strcmp(VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME, device_extensions[i].extensionName))
+				ycbcrConversionExtFound = true;
 
-	// We don't need our array of surface formats,
-	// now that we have the data we want, so we 
-	// delete the array
-	free(surfFormats);
-}
+			if (!strcmp(VK_KHR_MAINTENANCE1_EXTENSION_NAME, device_extensions[i].extensionName))
+				maintenance1ExtFound = true;
 
-void Demo::prepare_device_queue()
-{
-	//		Here is an explaination of how we will handle queues
+			if (!strcmp(VK_KHR_BIND_MEMORY_2_EXTENSION_NAME, device_extensions[i].extensionName))
+				bindMemory2ExtFound = true;
 
-	// In Vulkan, we have something called VkQueue. This queue allows us
-	// to submit commands to the graphics card. The handling of queues
-	// can vary from tutorial to tutorial, so I will quickly explain the 
-	// differences
+			// the 16-bit fragment shaders, checked below
+			if (!strcmp(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME, device_extensions[i].extensionName))
+				shaderFloat16Int8ExtFound = true;
 
-	// In Khronos' textured cube sample, they have two queues, one for
-	// command buffers, and one for sending images to the screen. This
-	// is not a good habit to have, because AMD GPUs only support one queue,
-	// and performance is usually better with one queue, than multiple.
-	// The Khronos tutorial also does not use staging buffers correctly,
-	// it makes one staging buffer for an array of textures, where one 
-	// buffer overwrites the other, causing memory leaks (more on that later)
+			// sharing memory and semaphores with other processes, checked below
+			if (!strcmp(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME, device_extensions[i].extensionName))
+				externalMemoryExtFound = true;
 
-	// Before writing this tutorial, I spoke to a Vulkan expert, who goes
-	// by the name of Exzap, he is the lead Vulkan programmer for the 
-	// Cemu project (Wii U emulator). He says that if multiple queues were
-	// used, then "any performance gain will be ruined by synchronization
-	// overhead from using multiple queues", so we will stick to one queue.
-	// In addition, the RPCS3 and Xenia projects also only use one queue
+			if (!strcmp(VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME, device_extensions[i].extensionName))
+				externalMemoryWin32ExtFound = true;
 
-	//		How to make a queue
+			if (!strcmp(VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME, device_extensions[i].extensionName))
+				externalSemaphoreExtFound = true;
 
-	// get number of queues on the GPU
-	uint32_t queue_family_count;
+			if (!strcmp(VK_KHR_EXTERNAL_SEMAPHORE_WIN32_EXTENSION_NAME, device_extensions[i].extensionName))
+				externalSemaphoreWin32ExtFound = true;
 
-	// we use NULL for the array of queues to get the count
-	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_family_count, NULL);
-	assert(queue_family_count >= 1);
+			// exclusive fullscreen, checked below
+			if (!strcmp(VK_EXT_FULL_SCREEN_EXCLUSIVE_EXTENSION_NAME, device_extensions[i].extensionName))
+				fullScreenExclusiveExtFound = true;
 
-	// we need to find if this queue supports graphics commands.
-	// Rather than putting graphics commands and surface 
-	// submission on seperate queues, we will put them on one queue
+			// present regions, see find_dirty_rect
+			if (use_incremental_present && !strcmp(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME, device_extensions[i].extensionName))
+			{
+				incrementalPresentExtFound = true;
+				extension_names[enabled_extension_count++] = VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME;
+			}
 
-	// make an array of queue properties
-	VkQueueFamilyProperties *queue_props;
+			// Update templates write a whole descriptor set with one
+			// call, see prepare_descriptor_template. We use them if
+			// the GPU has them, and vkUpdateDescriptorSets if it does not
+			if (!strcmp(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME, device_extensions[i].extensionName))
+			{
+				update_template_enabled = true;
+				extension_names[enabled_extension_count++] = VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME;
+			}
 
-	// allocate it
-	queue_props = new VkQueueFamilyProperties[queue_family_count];
-	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_family_count, queue_props);
+			// push descriptors need update templates, checked below
+			if (!strcmp(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME, device_extensions[i].extensionName))
+				pushDescriptorExtFound = true;
 
-	// we need to get properties of each queue on the graphics device.
-	// out of all the queues on the gpu, we need to know which ones support
-	// presenting to the surface, and which ones don't, so lets make a list
-	// that can hold booleans for all the queues
-	VkBool32 *queueSupportsPresent = new VkBool32[queue_family_count];
+			// graphics pipeline libraries are linked
+			// with the pipeline library extension
+			if (!strcmp(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME, device_extensions[i].extensionName))
+				graphicsPipelineLibraryExtFound = true;
 
-	// Iterate over each queue to learn whether it supports presenting
-	// to the type of surface that we have, which is Win32Surface
-	for (uint32_t i = 0; i < queue_family_count; i++)
+			if (!strcmp(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, device_extensions[i].extensionName))
+				pipelineLibraryExtFound = true;
+
+			// The memory budget is read with GetPhysicalDeviceMemoryProperties2,
+			// it tells the allocator how much memory we can use, see
+			// MemoryAllocator::UpdateBudget
+			if (properties2_enabled && !strcmp(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, device_extensions[i].extensionName))
+			{
+				memory_budget_enabled = true;
+				extension_names[enabled_extension_count++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+			}
+
+			// dedicated allocations need memory requirements 2, checked below
+			if (!strcmp(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, device_extensions[i].extensionName))
+				memoryRequirements2ExtFound = true;
+
+			if (!strcmp(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME, device_extensions[i].extensionName))
+				dedicatedAllocationExtFound = true;
+
+			// device masks for command buffers, submits, acquires,
+			// and presents, with a device group
+			if (use_device_group && !strcmp(VK_KHR_DEVICE_GROUP_EXTENSION_NAME, device_extensions[i].extensionName))
+			{
+				deviceGroupExtFound = true;
+				extension_names[enabled_extension_count++] = VK_KHR_DEVICE_GROUP_EXTENSION_NAME;
+			}
+		}
+
+		// we do not need the list of extensions anymore,
+		// now that we have already searched through it,
+		// so we can delete it now
+		free(device_extensions);
+	}
+
+	// The driver says which images and buffers should have memory of
+	// their own with VkMemoryDedicatedRequirements, which is returned by
+	// vkGetImageMemoryRequirements2, see MemoryAllocator::AllocateImage
+	if (memoryRequirements2ExtFound && dedicatedAllocationExtFound)
 	{
-		// This is one of the functions that are built-in to the Vulkan driver,
-		// we got the pointer to this function earlier in the code
-		fpGetPhysicalDeviceSurfaceSupportKHR(gpu, i, surface, &queueSupportsPresent[i]);
+		dedicated_allocation_enabled = true;
+		extension_names[enabled_extension_count++] = VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME;
+		extension_names[enabled_extension_count++] = VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME;
 	}
 
-	// Search for a graphics and a present queue in the array of queue
-	// families, try to find one that supports both
-	uint32_t queue_family_index = UINT32_MAX;
+	// The frame_lag was already rounded up for the group, that
+	// is fine to keep, it only makes more frames in flight
+	if (use_device_group && !deviceGroupExtFound)
+	{
+		printf("VK_KHR_device_group is not supported, device groups are disabled\n");
+		use_device_group = false;
+		device_group_count = 1;
+	}
 
-	// check the properties of all queues on the device
-	for (uint32_t i = 0; i < queue_family_count; i++)
+	if (use_timeline_semaphores && !timelineExtFound)
 	{
-		// if this queue has a property flag that supports
-		// graphics, then we can use this queue as a graphics queue
-		if ((queue_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0)
+		printf("Timeline semaphores are not supported, using fences\n");
+		use_timeline_semaphores = false;
+	}
+
+	// In low latency mode, we want to wait until the last frame is on
+	// the screen, before we start the next one (see draw). That needs
+	// present wait, and present id, and the GPU has to support both
+	// features, which we can only ask about with GetPhysicalDeviceFeatures2
+	if (low_latency && presentIdExtFound && presentWaitExtFound && properties2_enabled)
+	{
+		VkPhysicalDevicePresentWaitFeaturesKHR waitFeatures = {};
+		waitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+		VkPhysicalDevicePresentIdFeaturesKHR idFeatures = {};
+		idFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		idFeatures.pNext = &waitFeatures;
+
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &idFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
+
+		if (idFeatures.presentId && waitFeatures.presentWait)
 		{
-			// if we have not found a queue index for graphics yet
-			if (queueSupportsPresent[i] == VK_TRUE)
+			present_wait_enabled = true;
+			present_id_enabled = true;
+			extension_names[enabled_extension_count++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+		}
+	}
+
+	// The NV markers are given with the present ID of the frame, so
+	// the driver can match them with the present, which needs present
+	// id, and the sleep signals a timeline semaphore. The present
+	// thread would present after the PRESENT_END marker, on another
+	// thread, so the driver would see the wrong times
+	if (use_latency_markers && nvLowLatencyExtFound && !use_present_thread)
+	{
+		if (!present_id_enabled && presentIdExtFound && properties2_enabled)
+		{
+			VkPhysicalDevicePresentIdFeaturesKHR idFeatures = {};
+			idFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+			VkPhysicalDeviceFeatures2KHR features2 = {};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features2.pNext = &idFeatures;
+			fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
+
+			if (idFeatures.presentId)
 			{
-				// set the graphics index queue equal to this one
-				queue_family_index = i;
-				break;
+				present_id_enabled = true;
+				extension_names[enabled_extension_count++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
 			}
 		}
+
+		if (present_id_enabled && use_timeline_semaphores)
+		{
+			latency_nv_enabled = true;
+			extension_names[enabled_extension_count++] = VK_NV_LOW_LATENCY_2_EXTENSION_NAME;
+		}
+		else
+		{
+			printf("VK_NV_low_latency2 needs present id and timeline semaphores, it is not used\n");
+		}
 	}
 
-	// we're done checking for support, so we can
-	// delete the array of booleans
-	free(queueSupportsPresent);
+	// anti-lag is a feature of the extension, which
+	// has to be supported, and turned on with the device
+	if (use_latency_markers && antiLagExtFound && properties2_enabled)
+	{
+		VkPhysicalDeviceAntiLagFeaturesAMD antiLagFeatures = {};
+		antiLagFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ANTI_LAG_FEATURES_AMD;
 
-	// we don't need queue properties either
-	free(queue_props);
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &antiLagFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
 
-	// Generate error if could not find both a graphics and a present queue
-	if (queue_family_index == UINT32_MAX)
-	{
-		ERR_EXIT("Could not find queue\n", "Swapchain Initialization Failure");
+		if (antiLagFeatures.antiLag)
+		{
+			anti_lag_enabled = true;
+			extension_names[enabled_extension_count++] = VK_AMD_ANTI_LAG_EXTENSION_NAME;
+		}
 	}
 
-	// queues will have no priorities
-	float queue_priorities[1] = { 0.0 };
+	// The trace needs the GPU to read its own clock together with
+	// QueryPerformanceCounter, which is what CpuClock uses on Windows
+	if (use_trace_capture && calibratedTimestampsExtFound)
+	{
+		PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+			vkGetInstanceProcAddr(inst, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
 
-	// create a queue info
-	// this will describe how many queues to make (just one)
-	// and which family indices to make the queues at (just one)
-	VkDeviceQueueCreateInfo queueInfo = {};
-	queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queueInfo.queueFamilyIndex = queue_family_index;
-	queueInfo.queueCount = 1;
-	queueInfo.pQueuePriorities = queue_priorities;
+		uint32_t domainCount = 0;
+		if (getTimeDomains != NULL)
+			getTimeDomains(gpu, &domainCount, NULL);
 
-	// create the device info
-	// this tells us how a device will be made,
-	// with the extensions that we can enable,
-	// and with our queueInfo
-	VkDeviceCreateInfo deviceInfo = {};
-	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceInfo.queueCreateInfoCount = 1;
-	deviceInfo.pQueueCreateInfos = &queueInfo;
-	deviceInfo.enabledExtensionCount = enabled_extension_count;
-	deviceInfo.ppEnabledExtensionNames = (const char *const *)extension_names;
+		std::vector<VkTimeDomainEXT> domains(domainCount);
+		if (domainCount > 0)
+			getTimeDomains(gpu, &domainCount, domains.data());
 
-	// This function is called vkCreateDevice, but it actually
-	// creates the device, and the queues, at the same time.
-	// This works because the queueInfo is inside the deviceInfo
-	vkCreateDevice(gpu, &deviceInfo, NULL, &device);
+		bool deviceDomain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+		bool counterDomain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT) != domains.end();
 
-	// now that the device is created, the queues must also be created as well.
-	// This function does not create the queues, because VkCreateDevice created the queues,
-	// so insteadm, this function gets the queue from the device
-	vkGetDeviceQueue(device, queue_family_index, 0, &queue);
-}
+		if (deviceDomain && counterDomain)
+		{
+			calibrated_timestamps_enabled = true;
+			extension_names[enabled_extension_count++] = VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME;
+		}
+	}
 
-void Demo::prepare_device_functionPointers()
-{
-	// When we ran the function prepare_instance_functionPointers() earlier in the code,
-	// it allowed us to use the VkInstance to get functions that are not found in the SDK's .lib or .dll files,
-	// but are instead in the Vulkan driver. Now, rather than using the VkInstance to get functions,
-	// we will get some functions that are in the driver, but are only accessible through the VkDevice
+	// Query pools of hardware counters are a feature of the extension.
+	// The counters are listed by functions of the instance, which the
+	// loader only gives us if some GPU has the extension
+	fpEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR = NULL;
+	fpGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR = NULL;
 
-	// Previously, in prepare_instance_functionPointers(), we used vkGetInstanceProcAddr in the 
-	// GET_INSTANCE_PROC_ADDR macro function to get function-pointers from the driver, via the VkInstance.
+	if (use_performance_counters && performanceQueryExtFound && properties2_enabled)
+	{
+		VkPhysicalDevicePerformanceQueryFeaturesKHR performanceFeatures = {};
+		performanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PERFORMANCE_QUERY_FEATURES_KHR;
+
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &performanceFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
+
+		fpEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR = (PFN_vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR)
+			vkGetInstanceProcAddr(inst, "vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR");
+		fpGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR = (PFN_vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR)
+			vkGetInstanceProcAddr(inst, "vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR");
+
+		if (performanceFeatures.performanceCounterQueryPools &&
+			fpEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR != NULL &&
+			fpGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR != NULL)
+		{
+			performance_query_enabled = true;
+			extension_names[enabled_extension_count++] = VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME;
+		}
+	}
 
-	// This time, we will use fpGetDeviceProcAddr in the GET_DEVICE_PROC_ADDR macro function to get
-	// function-pointers from the VUlkan driver, via the VkDevice (our graphics card).
-	
-	// An important note is that the vkGetInstanceProcAddr function was built-in to the SDK,
-	// while fpGetDeviceProcAddr itself is a function pointer, which we got earlier in
-	// prepare_instance_functionPointers()
+	if (use_performance_counters && !performance_query_enabled)
+	{
+		printf("VK_KHR_performance_query is not supported, performance counters are disabled\n");
+		use_performance_counters = false;
+	}
 
-	#define GET_DEVICE_PROC_ADDR(dev, entrypoint)															\
-    {																										\
-        fp##entrypoint = (PFN_vk##entrypoint) fpGetDeviceProcAddr(dev, "vk" #entrypoint);					\
-        if (fp##entrypoint == NULL)																			\
-		{																									\
-            ERR_EXIT("vkGetDeviceProcAddr failed to find vk" #entrypoint, "vkGetDeviceProcAddr Failure");	\
-        }																									\
-    }
+	// Bindless textures put BINDLESS_TEXTURE_COUNT textures in one
+	// array of descriptors (see prepare_descriptor_layout). Most of the
+	// array is empty (partially bound), and textures can be written to it
+	// while the descriptor set is in use (update after bind). The shader
+	// picks a texture with an index from push constants, which needs
+	// shaderSampledImageArrayDynamicIndexing. The GPU also has to allow
+	// that many textures in one set, which is in the indexing properties
+	bool bindlessSupported = false;
 
-	// All of these functions will be used later on in the code,
-	// and they will be thoroughly explained when it is time to use them.
-	GET_DEVICE_PROC_ADDR(device, CreateSwapchainKHR);
-	GET_DEVICE_PROC_ADDR(device, DestroySwapchainKHR);
-	GET_DEVICE_PROC_ADDR(device, GetSwapchainImagesKHR);
-	GET_DEVICE_PROC_ADDR(device, AcquireNextImageKHR);
-	GET_DEVICE_PROC_ADDR(device, QueuePresentKHR);
-}
+	if (use_bindless_textures && descriptorIndexingExtFound && maintenance3ExtFound && properties2_enabled)
+	{
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &indexingFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
+
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+		VkPhysicalDeviceProperties2KHR properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		properties2.pNext = &indexingProperties;
+		fpGetPhysicalDeviceProperties2KHR(gpu, &properties2);
+
+		bindlessSupported =
+			features2.features.shaderSampledImageArrayDynamicIndexing &&
+			indexingFeatures.descriptorBindingPartiallyBound &&
+			indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers >= BINDLESS_TEXTURE_COUNT &&
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages >= BINDLESS_TEXTURE_COUNT &&
+			indexingProperties.maxDescriptorSetUpdateAfterBindSamplers >= BINDLESS_TEXTURE_COUNT &&
+			indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages >= BINDLESS_TEXTURE_COUNT;
+
+		if (bindlessSupported)
+		{
+			extension_names[enabled_extension_count++] = VK_KHR_MAINTENANCE3_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME;
+		}
+	}
 
-void Demo::prepare_synchronization()
-{
-	// Create semaphores to synchronize acquiring presentable buffers before
-	// rendering and waiting for drawing to be complete before presenting
-	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
-	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	if (use_bindless_textures && !bindlessSupported)
+	{
+		printf("Descriptor indexing is not supported, bindless textures are disabled\n");
+		use_bindless_textures = false;
+	}
 
-	// Create fences that we can use to throttle if we get too far
-	// ahead of the image presentation
-	VkFenceCreateInfo fenceInfo = {};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	// Dynamic rendering is a feature of its extension, so we
+	// ask the GPU about it with GetPhysicalDeviceFeatures2, the
+	// same way as present wait. The extensions that it needs
+	// are enabled together with it
+	bool dynamicRenderingSupported = false;
 
-	for (uint32_t i = 0; i < FRAME_LAG; i++)
+	if (use_dynamic_rendering && dynamicRenderingExtFound && depthStencilResolveExtFound &&
+		createRenderpass2ExtFound && multiviewExtFound && maintenance2ExtFound && properties2_enabled)
 	{
-		vkCreateFence(device, &fenceInfo, NULL, &drawFences[i]);
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR renderingFeatures = {};
+		renderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &renderingFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
+
+		dynamicRenderingSupported = (renderingFeatures.dynamicRendering == VK_TRUE);
 
-		vkCreateSemaphore(device, &semaphoreCreateInfo, NULL, &image_acquired_semaphores[i]);
-		vkCreateSemaphore(device, &semaphoreCreateInfo, NULL, &draw_complete_semaphores[i]);
+		if (dynamicRenderingSupported)
+		{
+			extension_names[enabled_extension_count++] = VK_KHR_MULTIVIEW_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_KHR_MAINTENANCE2_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+		}
 	}
-	
-	// start our frame_index at zero,
-	// because that's where arrays
-	// always start counting
-	frame_index = 0;
-}
 
-void Demo::prepare_swapchain()
-{
-	// This function will create a swapchain,
-	// and all of the images in the swapchain
+	if (use_dynamic_rendering && !dynamicRenderingSupported)
+	{
+		printf("Dynamic rendering is not supported, using a render pass\n");
+		use_dynamic_rendering = false;
+	}
 
-	//			If you are new to graphics APIs
-	//			Here is an explaination of a swapchain:
-	//			What it does, and why we need it
-	//
-	// Lets pretend that Vulkan can render to the screen, and only
-	// to the screen. That would mean that Vulkan would have to draw each pixel
-	// on the screen, and then delete every pixel on the screen, and then start
-	// rendering the next image to the screen. This is slow.
-	// With a swapchain, we can have two images. When we first initialize Vulkan,
-	// both swapchain images will be blank. Then, Vulkan will draw an image to one
-	// of the swapchain images. After that, the completed image can be sent to the
-	// monitor, while the 2nd swapchain image is being rendered. Then, after the 1st
-	// image is done drawing on the screen and after the 2nd image is fully rendered,
-	// they swap, which is why it is called "swapchain". Then, the 2nd image is being
-	// drawn on the screen, while VUlkan is rendering a new frame to the 1st swapchain
-	// image. Some swapchains have 2 images, and some have 3 images.
+	// Variable rate shading is a feature of its extension too. The rate
+	// of each draw needs pipelineFragmentShadingRate, and the shading
+	// rate image needs attachmentFragmentShadingRate, and dynamic
+	// rendering, because our render pass is made with vkCreateRenderPass,
+	// which can not have a shading rate attachment. The extensions that
+	// it needs might already be enabled by dynamic rendering
+	bool shadingRateSupported = false;
+	bool shadingRateImageSupported = false;
+
+	if ((use_shading_rate || use_shading_rate_image) && fragmentShadingRateExtFound &&
+		createRenderpass2ExtFound && multiviewExtFound && maintenance2ExtFound && properties2_enabled)
+	{
+		VkPhysicalDeviceFragmentShadingRateFeaturesKHR shadingRateFeatures = {};
+		shadingRateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
 
-	// If a swapchain is so important, some might wonder why it is only available in an
-	// extension (as discussed in a previous function), rather than being a core feature 
-	// of Vulkan. Truthfully, not all Vulkan softwares use a swapchain, and not all GPUs 
-	// support swapchains. Some Vulkan GPUs don't support graphics at all, and those will
-	// Vulkan only for Compute, but those GPUs are your typical gaming cards.
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &shadingRateFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
 
-	// Swapchains are an abolute standard for the gaming industry. Even the 
-	// PlayStation 1 had the ability to use a swapchain, so I can guarrantee that any
-	// popular consumer-level graphics card will support the swapchain extension.
+		VkPhysicalDeviceFragmentShadingRatePropertiesKHR shadingRateProperties = {};
+		shadingRateProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_PROPERTIES_KHR;
 
-	// Before we start making a new swapchain,
-	// make a backup of the current swapchain.
-	
-	// If the swapchain is currently NULL
-	// (during first init), then that's fine, 
-	// the oldSwapchain will be NULL too. Otherwise
-	// thd oldSwapchain will be a valid backup.
-	VkSwapchainKHR oldSwapchain = swapchain;
+		VkPhysicalDeviceProperties2KHR properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		properties2.pNext = &shadingRateProperties;
+		fpGetPhysicalDeviceProperties2KHR(gpu, &properties2);
 
-	// Part 1: Get the dimensions
-	// =======================================
+		shadingRateSupported = use_shading_rate && shadingRateFeatures.pipelineFragmentShadingRate;
+		shadingRateImageSupported = use_shading_rate_image && use_dynamic_rendering && shadingRateFeatures.attachmentFragmentShadingRate;
 
-	// Check the surface capabilities and formats.
-	// This tells us what the surface is capable of doing
-	VkSurfaceCapabilitiesKHR surfCapabilities;
-	fpGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, surface, &surfCapabilities);
+		if (shadingRateSupported || shadingRateImageSupported)
+		{
+			if (!use_dynamic_rendering)
+			{
+				extension_names[enabled_extension_count++] = VK_KHR_MULTIVIEW_EXTENSION_NAME;
+				extension_names[enabled_extension_count++] = VK_KHR_MAINTENANCE2_EXTENSION_NAME;
+				extension_names[enabled_extension_count++] = VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME;
+			}
 
-	// this holds the dimensions of all the swapcahin images,
-	// which we will set in a minute
-	VkExtent2D swapchainExtent;
+			extension_names[enabled_extension_count++] = VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME;
+		}
 
-	// When we call fpGetPhysicalDeviceSurfaceCapabilitiesKHR, there are two
-	// possible outcomes:
-	//	1: width and height are both 0xFFFFFFFF, 
-	//	2: width and height are both not 0xFFFFFFFF.
-	// That means we only need to check width.
+		// A texel of the image covers 16x16 pixels, if the GPU allows
+		// it, otherwise the closest size that it does allow (they are
+		// all powers of two)
+		VkExtent2D minTexel = shadingRateProperties.minFragmentShadingRateAttachmentTexelSize;
+		VkExtent2D maxTexel = shadingRateProperties.maxFragmentShadingRateAttachmentTexelSize;
+		shading_rate_texel.width = std::min(std::max(16u, minTexel.width), maxTexel.width);
+		shading_rate_texel.height = std::min(std::max(16u, minTexel.height), maxTexel.height);
+
+		// With both, the coarser of the two rates is used, if the GPU can
+		// combine them (MAX is not a trivial combiner), otherwise the rate
+		// of the image replaces the rate of the draw
+		if (shadingRateImageSupported)
+		{
+			shading_rate_combiner = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR;
 
-	// If width is 0xFFFFFFFF, that means the surface is undefined,
-	// and we need to define the surface by giving it dimensions.
-	// This happens if the window is too big or too small for Vulkan
-	// to handle
-	if (surfCapabilities.currentExtent.width == 0xFFFFFFFF)
+			if (shadingRateSupported && shadingRateProperties.fragmentShadingRateNonTrivialCombinerOps)
+				shading_rate_combiner = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_MAX_KHR;
+		}
+	}
+
+	if (use_shading_rate && !shadingRateSupported)
 	{
-		// If the surface size is undefined, the size is set to the size
-		// of the images requested, which we need to adjust to make it
-		// fit within the minimum and maximum values that are supported by the surface
-		swapchainExtent.width = width;
-		swapchainExtent.height = height;
+		printf("Fragment shading rate is not supported, every draw is shaded at every pixel\n");
+		use_shading_rate = false;
+	}
 
-		// if we are trying to use a width is less than the smallest width that is 
-		// supported by our surface, then set the width to the smallest width that
-		// is supported by the surface. We clamp the values to what is supported
-		if (swapchainExtent.width < surfCapabilities.minImageExtent.width)
-			swapchainExtent.width = surfCapabilities.minImageExtent.width;
-
-		// if we are trying to use a width is bigger than the biggest width that is 
-		// supported by our surface, then set the width to the biggest width that
-		// is supported by the surface. We clamp the values to what is supported
-		else if (swapchainExtent.width > surfCapabilities.maxImageExtent.width)
-				 swapchainExtent.width = surfCapabilities.maxImageExtent.width;
+	if (use_shading_rate_image && !shadingRateImageSupported)
+	{
+		printf("The shading rate image needs attachmentFragmentShadingRate and dynamic rendering, it is disabled\n");
+		use_shading_rate_image = false;
+	}
 
-		// if we are trying to use a height is less than the smallest height that is 
-		// supported by our surface, then set the height to the smallest height that
-		// is supported by the surface. We clamp the values to what is supported
-		if (swapchainExtent.height < surfCapabilities.minImageExtent.height)
-			swapchainExtent.height = surfCapabilities.minImageExtent.height;
+	// Occlusion queries feed conditional rendering, which is a
+	// feature of its extension. We only begin it in secondary command
+	// buffers, so inheritedConditionalRendering is not needed
+	bool conditionalRenderingSupported = false;
 
-		// if we are trying to use a height is bigger than the biggest height that is 
-		// supported by our surface, then set the height to the biggest height that
-		// is supported by the surface. We clamp the values to what is supported
-		else if (swapchainExtent.height > surfCapabilities.maxImageExtent.height)
-				 swapchainExtent.height = surfCapabilities.maxImageExtent.height;
-	}
-	
-	else 
+	if (use_occlusion_queries && conditionalRenderingExtFound && properties2_enabled)
 	{
-		// If the surface size is already pre-defined, that
-		// means that when we called fpGetPhysicalDeviceSurfaceCapabilitiesKHR,
-		// the surface found a width and height that it wants to use,
-		// which may be the size of the window, or it may be (0, 0) 
-		// while minimizing, it could be a number of different things.
+		VkPhysicalDeviceConditionalRenderingFeaturesEXT conditionalFeatures = {};
+		conditionalFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONDITIONAL_RENDERING_FEATURES_EXT;
 
-		// The point is, we have dimensions that the surface wants us to use,
-		// and we need to make a swapchain with those dimensions so that the
-		// images that Vulkan renders can be compatible with the current state
-		// of the surface. This function will be called every time we call
-		// prepare(), not just during the first initialization. This will
-		// allow us to resize the window whenever we want.
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &conditionalFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
 
-		// We set the swapchainExtent to the size that 
-		// the surface wants us to use.
-		swapchainExtent = surfCapabilities.currentExtent;
+		conditionalRenderingSupported = (conditionalFeatures.conditionalRendering == VK_TRUE);
 
-		// We set width and height to those dimensions provided
-		width = swapchainExtent.width;
-		height = swapchainExtent.height;
+		if (conditionalRenderingSupported)
+			extension_names[enabled_extension_count++] = VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME;
 	}
 
-	// if width and height are zero, then set the boolean
-	// to let us know that the window is minimized, and then
-	// return, do not continue creating swapchain images. There
-	// is no point in making a swapchain if there are no pixels
-	// to render
-	if (width == 0 || height == 0)
+	if (use_occlusion_queries && !conditionalRenderingSupported)
 	{
-		is_minimized = true;
-		return;
+		printf("Conditional rendering is not supported, occlusion queries are disabled\n");
+		use_occlusion_queries = false;
 	}
 
-	// if our window is not minimzed, then set the boolean so
-	// we know that it is not minimized, and then we continue
-	// through the function to make the swapchain
-	else 
-	{
-		is_minimized = false;
-	}
+	// Host image copy is a feature of its extension. The CPU writes
+	// the images in SHADER_READ_ONLY layout, so the fragment shader
+	// can read them right away, and the GPU has to allow that layout
+	bool hostImageCopySupported = false;
 
-	// Part 2: Get the present mode
-	//=======================================================
+	if (use_host_image_copy && hostImageCopyExtFound && copyCommands2ExtFound &&
+		formatFeatureFlags2ExtFound && properties2_enabled)
+	{
+		VkPhysicalDeviceHostImageCopyFeaturesEXT hostCopyFeatures = {};
+		hostCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
 
-	// We need to find a "Present Mode" that the surface supports. A "Present mode"
-	// tells the surface and the window how to handle the images that we give it.
-	// There are only 4 or 5 present modes that exist. Here is a list of them:
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &hostCopyFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
 
-	//		Here is an explaination of what other present modes do
-	//		The one that we use in this tutorial is FIFO
+		// the first call gives the number of layouts, the second one the layouts
+		VkPhysicalDeviceHostImageCopyPropertiesEXT hostCopyProperties = {};
+		hostCopyProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
 
-	// FIFO stands for First-in, FIrst-out
-	// The PRESENT_MODE_FIFO present mode will give us VSYNC, and it will 
-	// prevent tearing, so it will wait until one image is fully drawn
-	// on the screen, before we try to draw another image.
+		VkPhysicalDeviceProperties2KHR properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		properties2.pNext = &hostCopyProperties;
+		fpGetPhysicalDeviceProperties2KHR(gpu, &properties2);
 
-	// IMMEDIATE will start drawing one frame to the screen,
-	// even if another image is in the middle of being drawn, causes tearing.
-	// VK_PRESENT_MODE_IMMEDIATE_KHR is for applications that don't care about
-	// tearing, or have some way of synchronizing their rendering with the
-	// display.
+		std::vector<VkImageLayout> dstLayouts(hostCopyProperties.copyDstLayoutCount);
+		hostCopyProperties.copySrcLayoutCount = 0;
+		hostCopyProperties.pCopyDstLayouts = dstLayouts.data();
+		fpGetPhysicalDeviceProperties2KHR(gpu, &properties2);
 
-	// MAILBOX_KHR will disable VSYNC, and uncap the 60fps limit,
-	// or whatever the limit of the monitor is.
-	// VK_PRESENT_MODE_MAILBOX_KHR may be useful for applications that
-	// generally render a new presentable image every refresh cycle, but are
-	// occasionally early.  In this case, the application wants the new image
-	// to be displayed instead of the previously-queued-for-presentation image
-	// that has not yet been displayed.
+		bool readOnlyLayout = false;
 
-	// VK_PRESENT_MODE_FIFO_RELAXED_KHR is for applications that generally
-	// render a new presentable image every refresh cycle, but are occasionally
-	// late. In this case (perhaps because of stuttering/latency concerns),
-	// the application wants the late image to be immediately displayed, even
-	// though that may mean some tearing.
+		for (uint32_t i = 0; i < hostCopyProperties.copyDstLayoutCount; i++)
+		{
+			if (dstLayouts[i] == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+				readOnlyLayout = true;
+		}
 
-	// This is the number of present modes are supported 
-	// by the surface and the GPU. It is zero by default
-	uint32_t presentModeCount = 0;
-	
-	// we get the number of modes that are supported
-	fpGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &presentModeCount, NULL);
+		hostImageCopySupported = (hostCopyFeatures.hostImageCopy == VK_TRUE) && readOnlyLayout;
 
-	// we make an array to hold the list of supported modes
-	VkPresentModeKHR *presentModes = new VkPresentModeKHR[presentModeCount];
+		if (hostImageCopySupported)
+		{
+			extension_names[enabled_extension_count++] = VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME;
+		}
+	}
 
-	// Finally, we get the list of supported modes,
-	// we use a function pointer that we got from the instance,
-	// this function is built-in to the driver, not the SDK.
-	fpGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &presentModeCount, presentModes);
-	
-	// currentPresentMode is a member of the Demo class,
-	// it is the presentation mode that is currently active.
-	// If this is our first time here (firstInit), then the 
-	// mode will be NULL (0), because there is no current
-	// mode. Otherwise, That currentPresentMode will have the value
-	// that it was given the last time this function was called,
-	// which is the mode that is currently active
+	if (use_host_image_copy && !hostImageCopySupported)
+	{
+		printf("Host image copy is not supported, textures are uploaded with staging buffers\n");
+		use_host_image_copy = false;
+	}
 
-	// The mode we want is FIFO, becuase it locks our frame-rate to 
-	// 60fps (or the limit of the monitor) and prevents tearing of images.
-	VkPresentModeKHR desiredPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	// The YCbCr conversion is a feature of its extension. It also needs
+	// memory requirements 2, which dedicated allocations might have
+	// enabled already. The formats are checked in prepare
+	bool ycbcrConversionSupported = false;
 
-	// If the current present mode is not equal to the 
-	// present mode that we want to use. This will probably
-	// only happen during firstInit
-	if (desiredPresentMode != currentPresentMode)
+	if (use_video_texture && ycbcrConversionExtFound && maintenance1ExtFound &&
+		bindMemory2ExtFound && memoryRequirements2ExtFound && properties2_enabled)
 	{
-		// check all of the present modes that are supported
-		// by the GPu and the surface
-		for (size_t i = 0; i < presentModeCount; ++i)
+		VkPhysicalDeviceSamplerYcbcrConversionFeaturesKHR ycbcrFeatures = {};
+		ycbcrFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES_KHR;
+
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &ycbcrFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
+
+		ycbcrConversionSupported = (ycbcrFeatures.samplerYcbcrConversion == VK_TRUE);
+
+		if (ycbcrConversionSupported)
 		{
-			// if the mode we want to use is on the list
-			// of supported modes
-			if (presentModes[i] == desiredPresentMode)
-			{
-				// then assign current to desired, allowing
-				// us to use the mode that we want to use
-				currentPresentMode = desiredPresentMode;
-				break;
-			}
+			if (!dedicated_allocation_enabled)
+				extension_names[enabled_extension_count++] = VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME;
+
+			extension_names[enabled_extension_count++] = VK_KHR_MAINTENANCE1_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_KHR_BIND_MEMORY_2_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME;
 		}
 	}
 
-	// If current is stil not equal to desire,
-	// Then it means that our desired mdoe is not 
-	// supported by the surface or GPU, so we 
-	// give an error that addresses the problem
-	if (currentPresentMode != desiredPresentMode)
+	if (use_video_texture && !ycbcrConversionSupported)
 	{
-		ERR_EXIT("Present mode specified is not supported\n", "Present mode unsupported");
+		printf("YCbCr conversion is not supported, the video texture is disabled\n");
+		use_video_texture = false;
 	}
 
-	// delete the list of modes, we found the one we want,
-	// so we don't need the entire list anymore
-	if (presentModes != NULL)
-		free(presentModes);
+	// 16-bit math in shaders is shaderFloat16, a feature of its
+	// extension. The 16-bit shaders only keep 16-bit values in
+	// registers, their inputs and outputs are 32-bit, so they do
+	// not need any of the features of VK_KHR_16bit_storage
+	bool float16Supported = false;
 
-	// Determine the number of VkImages to use in the swapchain.
-	// Application desires to acquire 3 images at a time for triple buffering.
-	// This allows one image to be sent to the screen, while another image is
-	// being created, while another image is being deleted.
-	// In my opinion, I don't think there's a reason for more than three
-	uint32_t desiredNumOfSwapchainImages = 3;
+	if (use_half_precision && shaderFloat16Int8ExtFound && properties2_enabled)
+	{
+		VkPhysicalDeviceFloat16Int8FeaturesKHR float16Features = {};
+		float16Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FLOAT16_INT8_FEATURES_KHR;
 
-	// If the number of images we want to use is less than
-	// the minimum number of images that the surface supports
-	if (desiredNumOfSwapchainImages < surfCapabilities.minImageCount)
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &float16Features;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
+
+		float16Supported = (float16Features.shaderFloat16 == VK_TRUE);
+
+		if (float16Supported)
+			extension_names[enabled_extension_count++] = VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME;
+	}
+
+	if (use_half_precision && !float16Supported)
 	{
-		// then change the number of images to the minimum that
-		// the surface supports. This would only happen if we tried
-		// to use 0 images, or 1 image, but 3 images will totally be
-		// above the minimum.
-		desiredNumOfSwapchainImages = surfCapabilities.minImageCount;
+		printf("shaderFloat16 is not supported, the shaders use 32-bit floats\n");
+		use_half_precision = false;
 	}
 
-	// If maxImageCount is 0, then that means we can have as many
-	// images as we want, because max is set to zero when there is no limit.
-	// If max is more than zero, then there is a limit that we need to obey
-	if (surfCapabilities.maxImageCount > 0)
+	// External memory is always a dedicated allocation (see
+	// ExternalMemory.h), so it needs dedicated allocations too
+	if (use_external_memory && external_capabilities_enabled && dedicated_allocation_enabled &&
+		externalMemoryExtFound && externalMemoryWin32ExtFound &&
+		externalSemaphoreExtFound && externalSemaphoreWin32ExtFound)
 	{
-		// if the amount of images that we want in the swapchain,
-		// is more than the maximum number that is supported by the 
-		// GPU and the surface
-		if (desiredNumOfSwapchainImages > surfCapabilities.maxImageCount)
+		extension_names[enabled_extension_count++] = VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME;
+		extension_names[enabled_extension_count++] = VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME;
+		extension_names[enabled_extension_count++] = VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME;
+		extension_names[enabled_extension_count++] = VK_KHR_EXTERNAL_SEMAPHORE_WIN32_EXTENSION_NAME;
+	}
+	else if (use_external_memory)
+	{
+		printf("External memory is not supported, it is disabled\n");
+		use_external_memory = false;
+	}
+
+	if (use_incremental_present && !incrementalPresentExtFound)
+	{
+		printf("Incremental present is not supported, it is disabled\n");
+		use_incremental_present = false;
+	}
+
+	// Exclusive fullscreen needs its device extension, and the
+	// instance extension that asks the surface about it. Without
+	// them, the window is still borderless, which is almost as good
+	full_screen_exclusive_enabled = false;
+	full_screen_exclusive_acquired = false;
+
+	if (window_mode == WINDOW_MODE_EXCLUSIVE)
+	{
+		if (fullScreenExclusiveExtFound && surface_capabilities2_enabled && properties2_enabled)
 		{
-			// Application must settle for fewer images than desired:
-			desiredNumOfSwapchainImages = surfCapabilities.maxImageCount;
+			full_screen_exclusive_enabled = true;
+			extension_names[enabled_extension_count++] = VK_EXT_FULL_SCREEN_EXCLUSIVE_EXTENSION_NAME;
 		}
+		else
+			printf("Exclusive fullscreen is not supported, the window is borderless\n");
 	}
 
-	// Part 3: Get Flags
-	// ===================================================
+	// Vertex pulling needs the bufferDeviceAddress feature,
+	// so the shader can read the vertex buffer through a pointer
+	bool vertexPullingSupported = false;
 
-	// This is a transformation flag, it tells the swapchain
-	// how to scale, rotate, or move an image, before it is sent to the surface.
-	VkSurfaceTransformFlagsKHR preTransform;
+	if (use_vertex_pulling && bufferDeviceAddressExtFound && properties2_enabled)
+	{
+		VkPhysicalDeviceBufferDeviceAddressFeaturesEXT addressFeatures = {};
+		addressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_EXT;
 
-	// I know what students are going to think:
-	// "Can't we just send an image to the screen without transforming the image?"
-	// Yes, you can, but only if the Surface allows you to do that.
-	// Some surfaces require transformations, and some don't.
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &addressFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
 
-	// we check to see if our surface supports IDENTITY_TRANSFORM.
-	// This is exactly what it sounds like, it is just like any other
-	// identity matrix, it has no transformation, which means that if 
-	// our surface supports IDENTITY, then we do not need to scale,
-	// rotate, or translate an image, before it goes from swapchain to surface
-	if (surfCapabilities.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
+		vertexPullingSupported = (addressFeatures.bufferDeviceAddress == VK_TRUE);
+
+		if (vertexPullingSupported)
+			extension_names[enabled_extension_count++] = VK_EXT_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME;
+	}
+
+	if (use_vertex_pulling && !vertexPullingSupported)
 	{
-		// we set the pre-transformation flag (the transformation of an image
-		// after it is rendered, and before it goes to the surface) to IDENTITY,
-		// so that there is no transformation
-		preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+		printf("Buffer device address is not supported, vertex pulling is disabled\n");
+		use_vertex_pulling = false;
 	}
 
-	// If the surface does not support IDENTITY, then it must require some kind
-	// of transformation to be done to it, before the image is sent to the screen
-	else 
+	// Push descriptors are written with an update template
+	// (see record_draws), and the push descriptor extension
+	// needs VK_KHR_get_physical_device_properties2
+	if (use_push_descriptors)
 	{
-		// set preTransform to the transformation that the surface requires
-		preTransform = surfCapabilities.currentTransform;
+		if (pushDescriptorExtFound && update_template_enabled && properties2_enabled)
+			extension_names[enabled_extension_count++] = VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME;
+		else
+		{
+			printf("Push descriptors are not supported, using a descriptor set\n");
+			use_push_descriptors = false;
+		}
 	}
 
-	// When our image is done being rendered, there are red pixels,
-	// green pixels, blue pixels, and alpha pixels. We all know what
-	// the red, green, and blue pixels will do, but we do not know what the
-	// alpha pixels will do. Should they be used for transparency? Should
-	// they be ignored?
+	// Graphics pipeline libraries are a feature of their extension.
+	// Without fast linking, linking the fast pipeline could take as long
+	// as making a whole one, but it still does not compile the parts again
+	bool pipelineLibrarySupported = false;
 
-	// We need to choose what the Alpha pixels will do
+	if (use_pipeline_library && graphicsPipelineLibraryExtFound && pipelineLibraryExtFound && properties2_enabled)
+	{
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures = {};
+		libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
 
-	// By default, we use VK_COMPOSITE_ALPHA_OPAQUE, which will
-	// not do anything with the alpha channel, it will just ignore it
-	VkCompositeAlphaFlagBitsKHR desiredAlphaFlag = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &libraryFeatures;
+		fpGetPhysicalDeviceFeatures2KHR(gpu, &features2);
 
-	// Here are a few modes that we can set to handle the alpha.
-	// These modes are in priority for what we want, depending on 
-	// what the GPU supports. If the GPU does not support the ability
-	// to ignore alpha, then we try using alpha to modify the RGB
-	// values, and if that is not supported, then Vulkan will inherit
-	// alpha properties from the surface
-	VkCompositeAlphaFlagBitsKHR compositeAlphaFlags[4] = {
-		VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-		VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR,
-		VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR,
-		VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
-	};
+		VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties = {};
+		libraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
 
-	// loop through all the possibilities of alpha flags
-	for (uint32_t i = 0; i < ARRAY_SIZE(compositeAlphaFlags); i++)
-	{
-		// find the first flag that our sruface supports
-		if (surfCapabilities.supportedCompositeAlpha & compositeAlphaFlags[i])
+		VkPhysicalDeviceProperties2KHR properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		properties2.pNext = &libraryProperties;
+		fpGetPhysicalDeviceProperties2KHR(gpu, &properties2);
+
+		pipelineLibrarySupported = (libraryFeatures.graphicsPipelineLibrary == VK_TRUE);
+
+		if (pipelineLibrarySupported)
 		{
-			// set our desired flag to the one that
-			// our surface supports
-			desiredAlphaFlag = compositeAlphaFlags[i];
+			extension_names[enabled_extension_count++] = VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME;
+			extension_names[enabled_extension_count++] = VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME;
 
-			// leave the loop, stop looking for flags,
-			// because we found the one that we want
-			break;
+			if (libraryProperties.graphicsPipelineLibraryFastLinking != VK_TRUE)
+				printf("Pipeline libraries are supported, but linking them is not fast\n");
 		}
 	}
 
-	// Part 4: Make the empty swapchain
-	//====================================================
+	if (use_pipeline_library && !pipelineLibrarySupported)
+	{
+		printf("Graphics pipeline libraries are not supported, pipelines are made as derivatives\n");
+		use_pipeline_library = false;
+	}
 
-	// Lets take everything that we've made so far,
-	// bundle it together, and make a swapchain with it
+	// if the swapchain was not found, then give an error and let the
+	// user know that the swapchain could not be found.
+	// Headless mode has no swapchain, so it does not need it
+	swapchain_enabled = swapchainExtFound;
 
-	VkSwapchainCreateInfoKHR swapchain_ci = {};
-	swapchain_ci.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-	swapchain_ci.surface = surface;
-	swapchain_ci.minImageCount = desiredNumOfSwapchainImages;
-	swapchain_ci.imageFormat = format;
-	swapchain_ci.imageColorSpace = color_space;
-	swapchain_ci.imageExtent.width = swapchainExtent.width;
-	swapchain_ci.imageExtent.height = swapchainExtent.height;
-	swapchain_ci.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-	swapchain_ci.preTransform = (VkSurfaceTransformFlagBitsKHR)preTransform;
-	swapchain_ci.compositeAlpha = desiredAlphaFlag;
-	swapchain_ci.imageArrayLayers = 1;
-	swapchain_ci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	swapchain_ci.presentMode = currentPresentMode;
-	swapchain_ci.oldSwapchain = oldSwapchain;
-	swapchain_ci.clipped = true;
-	
-	// We create the swapchain with a function pointer,
-	// because this function is not in the SDK, it is in the VUlkan Driver,
-	// and we get access to it by finding the pointer via the device
-	// (we found the function pointers earlier in the code)
-
-	// use the function pointer, the device, and the 
-	// swapchain CreateInfo structure to create the swapchain
-	fpCreateSwapchainKHR(device, &swapchain_ci, NULL, &swapchain);
-
-	// If we just re-created an existing swapchain, we should destroy the old
-	// swapchain. We know if an old swapchain exists by checking if it is NULL.
-	// Note: destroying the swapchain also cleans up all its associated
-	// presentable images once the platform is done with them.
-	if (oldSwapchain != VK_NULL_HANDLE)
+	if (!swapchainExtFound && window_mode != WINDOW_MODE_HEADLESS)
 	{
-		// destroy the old swapchain
-		fpDestroySwapchainKHR(device, oldSwapchain, NULL);
+		ERR_EXIT("vkEnumerateDeviceExtensionProperties failed to find the " VK_KHR_SWAPCHAIN_EXTENSION_NAME
+			" extension.\n\nDo you have a compatible Vulkan installable client driver (ICD) installed?\n"
+			"Please look at the Getting Started guide for additional information.\n",
+			"vkCreateInstance Failure");
 	}
+}
 
-	// Part 5: Make the swapchain's images usable
-	//=================================================================
+void Demo::prepare_instance_functionPointers()
+{
+	// Almost all functions in Vulkan are built-in to the SDK.
+	// We can access Vulkan functions through a static link (.lib),
+	// or a dynamic link (.dll). However, some Vulkan functions are
+	// not in the SDK, but they are actually inside the Vulkan Driver
+	// itself. To get access to functions that are in the driver,
+	// we need to use the VkInstance to get a pointer to the functions.
 
-	// Now that we've used the fpCreateSwapchainKHR function,
-	// we now have a swapchain, and it is filled with images that
-	// we can render to, but first we need to put these images into
-	// a state that we can work with
+	// To shorten the code, we use a macro function to help
+	// The macro function GET_INSTANCE_PROC_ADDR is completely optional.
+	// If a student has not learned macro functions, i suggest googling it.
+	// This macro function never needs to be changed, so you can just leave it here
 
-	// get the amount of images that are in the swapchain
-	fpGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, NULL);
+	// There are 6 function pointers that we need to get from the instance
+	// Without this macro function, we would need to rewrite this over and over:
+	//		fpGetPhysicalDeviceSurfaceSupportKHR = (PFN_vkGetPhysicalDeviceSurfaceSupportKHR)vkGetInstanceProcAddr(inst, "vkGetPhysicalDeviceSurfaceSupportKHR");
+	// and then check to see if each function pointer is null, and then return an error message
 
-	// make an array to hold the swapchain's images
-	VkImage *swapchainImages = new VkImage[swapchainImageCount];
+	// However, because we have the macro, we only need to write
+	// GET_INSTANCE_PROC_ADDR(inst, "name"); for each function pointer that we want
 
-	// get the images that are in the swapchain that we just made
-	fpGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, swapchainImages);
+	#define GET_INSTANCE_PROC_ADDR(inst, entrypoint)															\
+    {																											\
+        fp##entrypoint = (PFN_vk##entrypoint)vkGetInstanceProcAddr(inst, "vk" #entrypoint);						\
+        if (fp##entrypoint == NULL)																				\
+		{																										\
+            ERR_EXIT("vkGetInstanceProcAddr failed to find vk" #entrypoint, "vkGetInstanceProcAddr Failure");	\
+        }																										\
+    }
 
-	// Our swapchain images are in the form of VkImage. While
-	// they are in the form of VkImage, they cannot be directly
-	// accessed by the CPU or GPU
+	// All of these functions will be used later on in the code,
+	// and they will be thoroughly explained when it is time to use them.
+	GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceSurfaceSupportKHR);
+	GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceSurfaceCapabilitiesKHR);
+	GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceSurfaceFormatsKHR);
+	GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceSurfacePresentModesKHR);
+	GET_INSTANCE_PROC_ADDR(inst, GetSwapchainImagesKHR);
+	GET_INSTANCE_PROC_ADDR(inst, GetDeviceProcAddr);
 
-	// The structure SwapchainImageResources is defined in Demo.h,
-	// and we have an array in the Demo class that holds elements of 
-	// SwapchainImageResources, which we will be using throughout
-	// the rest of the tutorial, so make an array of SwapchainImageResources
-	// so that we have resources for every swapchain image
-	swapchain_image_resources = new SwapchainImageResources[swapchainImageCount];
+	fpGetPhysicalDeviceFeatures2KHR = NULL;
 
-	// The swapchain_image_resources array, basically makes it so each
-	// swapchain iamge has its own image (itself), its own imageView
-	// (which makes the image usable), its own frameBuffer (which allows
-	// the imageView to be used in drawing), and its own command buffer,
-	// which will be explained later
+	fpGetPhysicalDeviceProperties2KHR = NULL;
 
-	// loop through all the swapchain images
-	for (uint32_t i = 0; i < swapchainImageCount; i++)
-	{
-		// Create an image veiw
-		// VkImageView will act as a wrapper for VkImage
-		// which allows the data of VkImage to be accessible
-		// by the CPU and GPU
+	fpGetPhysicalDeviceMemoryProperties2KHR = NULL;
 
-		// One way to imagine it is:
-		// VkImage is the a package in the Post Office,
-		// but the package can't go anywhere without a stamp.
-		// VkImageView is the stamp
+	fpGetPhysicalDeviceImageFormatProperties2KHR = NULL;
 
-		// We have to set a number of variables that 
-		// describe the image that will be inside imageView
-		// sType will always be VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO
-		VkImageViewCreateInfo viewInfo = {};
-		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	if (properties2_enabled)
+	{
+		GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceFeatures2KHR);
+		GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceProperties2KHR);
+		GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceMemoryProperties2KHR);
+		GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceImageFormatProperties2KHR);
+	}
 
-		// we have to give the type of image, this is a 2D
-		// image. Sounds obvious, but it is possible to have
-		// 3D images, or image arrays
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		
-		// we have to include the format of the images
-		// which we got from Surface
-		viewInfo.format = format;
+	fpEnumeratePhysicalDeviceGroupsKHR = NULL;
 
-		// we hvae to label each of the color components
-		viewInfo.components.r = VK_COMPONENT_SWIZZLE_R;
-		viewInfo.components.g = VK_COMPONENT_SWIZZLE_G;
-		viewInfo.components.b = VK_COMPONENT_SWIZZLE_B;
-		viewInfo.components.a = VK_COMPONENT_SWIZZLE_A;
+	if (device_group_creation_enabled)
+		GET_INSTANCE_PROC_ADDR(inst, EnumeratePhysicalDeviceGroupsKHR);
 
-		// we have to mention that this is a color image,
-		// there are other types of images that are used
-		// for things other than color, like depth
-		// but more information will be given about that later
-		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	fpGetPhysicalDeviceSurfaceCapabilities2KHR = NULL;
 
-		// If you don't know what mipmaps are, or mipmap chains, 
-		// don't worry about it. This image (the swapchain image),
-		// does not have a mipmap chain, so the base level is 0,
-		// and there is 1 level. Honestly just don't worry about it.
-		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
+	if (surface_capabilities2_enabled)
+		GET_INSTANCE_PROC_ADDR(inst, GetPhysicalDeviceSurfaceCapabilities2KHR);
+}
 
-		// Technically, in Vulkan's eyes, every image is an array
-		// so we tell it that there is one image in the array,
-		// and that the element of the array we want is 0,
-		// which literally means "there is one image, so use
-		// that one image"
-		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = 1;
 
-		// set the imageView's image to the swapchain image
-		viewInfo.image = swapchainImages[i];
+void Demo::prepare_surface()
+{
+	// Create a Surface:
+	// The "surface" is an abstraction layer that sends
+	// a finished image from Vulkan to the screen
 
-		// Make a backup of the image, so each
-		// member of the swapchain_image_resources has the 
-		// original VkImage
-		swapchain_image_resources[i].image = viewInfo.image;
+	// There are lots of different windows that can be used
+	// With Vulkan, there are Win32 windows, GLFW windows, 
+	// there are different windows on iOS, Android, Linux, and Mac.
 
-		// Use the viewInfo to make an imageView, for each swapchain image,
-		// in the array of swapchain_image_resources
-		vkCreateImageView(device, &viewInfo, NULL, &swapchain_image_resources[i].view);
+	// The Surface is a middle-man that takes an image that Vulkan
+	// creates (the image we want on the screen), and then the 
+	// surface puts it on the screen
 
+	// In headless mode there is no window, and no surface. Our own
+	// images can be any format, and this one can be saved with frame capture
+	if (window_mode == WINDOW_MODE_HEADLESS)
+	{
+		surface = VK_NULL_HANDLE;
+		format = VK_FORMAT_B8G8R8A8_UNORM;
+		color_space = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+		return;
 	}
 
-	// if an array of swapchainImages exists delete the array.
-	// Keep in mind, this is not the array of swapchain_image_resources,
-	// this is just the array of VkImage. We can delete this now because
-	// the images have been copied to the swapchain_image_resources array
-	if (swapchainImages != NULL)
-		free(swapchainImages);
-}
+	// Today, we will create a surface by using VkWin32SurfaceCreateInfoKHR,
+	// because we are using a Win32 window, so we will give it the 
+	// necessary sType, and we will give it our window that we just created
+	VkWin32SurfaceCreateInfoKHR createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+	createInfo.hwnd = window;
 
-void Demo::prepare_init_cmd()
-{
-	// This command buffer will be used to copy data from
-	// the CPU to the GPU. We will finish this command buffer
-	// after we have given it all of our copy commands
+	// We use the instance we made, and the createInfo (which has
+	// our window) to create a surface.
+	vkCreateWin32SurfaceKHR(inst, &createInfo, HostAllocator::callbacks, &surface);
 
-	VkCommandBufferAllocateInfo cmdInfo = {};
-	cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	cmdInfo.commandPool = cmd_pool;
-	cmdInfo.commandBufferCount = 1;
+	// Now that we have our surface, we need to find a format that
+	// is supported by (both) the surface, and the GPU. If the 
+	// GPU can only export R8-B8-G8 images, but the surface (which connects
+	// to the window) can only read R16-G16-B16-A16 images, that's bad.
 
-	vkAllocateCommandBuffers(device, &cmdInfo, &initCmd);
-}
+	// the number of formats that are suppported by (both) the GPU, and our surface,
+	// will be set to zero by default
+	uint32_t formatCount = 0;
+	
+	// Just like we've seen before, Vulkan has a pattern of calling the same
+	// function twice. First time gets the number of elements, Second time
+	// fills an array with elements
 
-void Demo::begin_init_cmd()
-{
-	// This is the easiest function in the tutorial
+	// get the number of formats
+	fpGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &formatCount, NULL);
 
-	// make a structure for all parameters that we want
-	// for the command buffer. In this case we don't want
-	// any specific adjustments, but we will have more 
-	// parameters for other command buffers later.
-	// sType is required
-	VkCommandBufferBeginInfo cmd_buf_info = {};
-	cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	// create an array of surfaces that can hold the list of formats
+	VkSurfaceFormatKHR *surfFormats = new VkSurfaceFormatKHR[formatCount];
+
+	// Get the list of formats
+	fpGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &formatCount, surfFormats);
+
+	// If there is only one format in the list, and if thath one format
+	// is UNDEFINED, then the surface takes any format. That means,
+	// we can pick any format we like, so lets go with R8-G8-B8-A8.
+
+	// Otherwise, out of all the formats that the GPU and the surface
+	// support, we pick the cheapest one. Every pixel of the swapchain
+	// is written every frame, and read again by the compositor, so
+	// an 8-bit format moves half the bytes of a half float one. The
+	// offscreen image uses the same format, so the blit into the
+	// swapchain is only a copy, it never converts the pixels. With
+	// a wide swapchain format, 10-bit formats are picked first, and
+	// formats that cost the same keep the order of the driver
+
+	// Format holds the type of image format that
+	// the monitor can draw, while color_space is the 
+	// type of format that the monitor uses. They sound
+	// similar, but think about how the colors of a 
+	// computer monitor might look a little different 
+	// than a living-room TV or a movie theater. The 
+	// same image with the same "format" on multiple
+	// screens can end up looking a little different.
+	// color_space gives us the format of the monitor,
+	// so that the image can be sent to the monitor correctly
+	VkSurfaceFormatKHR selected = SelectSurfaceFormat(surfFormats, formatCount,
+		use_wide_swapchain_format, VK_FORMAT_UNDEFINED, VK_FORMAT_R8G8B8A8_UNORM);
 
-	// Begin the command buffer, so all Vulkan commands
-	// will go here until further notice. All commands
-	// in this command buffer will be executed later 
-	// in the prepare() function, before we start drawing
-	// to the screen
-	vkBeginCommandBuffer(initCmd, &cmd_buf_info);
+	format = selected.format;
+	color_space = selected.colorSpace;
+
+	// We don't need our array of surface formats,
+	// now that we have the data we want, so we 
+	// delete the array
+	free(surfFormats);
 }
 
-void Demo::prepare_uniform_buffer()
+void Demo::prepare_device_queue()
 {
-	// make temporary data where
-	// we can store data that will be
-	// in our buffer
-	uniform_struct temporaryData;
+	//		Here is an explaination of how we will handle queues
 
-	glm::vec3 eye = { 0.0f, 3.0f, 5.0f };		// The position of the camera
-	glm::vec3 focus = { 0, 0, 0 };				// The position the camera is looking at
-	glm::vec3 up = { 0.0f, 1.0f, 0.0 };			// The direction that faces up, which is the Y axis
-	view_matrix = glm::lookAt(eye, focus, up);	// build the view matrix from thsi data
+	// In Vulkan, we have something called VkQueue. This queue allows us
+	// to submit commands to the graphics card. The handling of queues
+	// can vary from tutorial to tutorial, so I will quickly explain the 
+	// differences
 
-	// we do this exactly the same way as we do in OpenGL
-	// We give it our field-of-view, which is 45 degrees (converted to radians),
-	// we give it our aspect ratio (window width divdied by height),
-	// we give it the nearest distance to the camera that something can be, so anything closer than 0.1f is not drawn,
-	// we give it the farthest distance from the camera that something can be, so anything farther tha 100.0f will not be drawn
-	projection_matrix = glm::perspective(45.0f * 3.14159f / 180.0f, (float)width / (float)height, 0.1f, 100.0f);
+	// In Khronos' textured cube sample, they have two queues, one for
+	// command buffers, and one for sending images to the screen. This
+	// is not a good habit to have, because AMD GPUs only support one queue,
+	// and performance is usually better with one queue, than multiple.
+	// The Khronos tutorial also does not use staging buffers correctly,
+	// it makes one staging buffer for an array of textures, where one 
+	// buffer overwrites the other, causing memory leaks (more on that later)
 
-	// In OpenGL
-	//	The X axis moves from left to right
-	//	The Y axis moves from bottom to top
-	// In Vulkan
-	//	The X axis moves from left to right
-	//	The Y axis moves from top to bottom
-	// That means, by default, Vulkan will render everything upside down.
-	// Not sure why the Vulkan devs made that decision, but there is an easy
-	// fix. If we multiply matrix[1][1] by -1, then everything will be drawn
-	// correctly, and we can use our OpenGL GLSL shaders without any problem
-	projection_matrix[1][1] *= -1;
+	// Before writing this tutorial, I spoke to a Vulkan expert, who goes
+	// by the name of Exzap, he is the lead Vulkan programmer for the 
+	// Cemu project (Wii U emulator). He says that if multiple queues were
+	// used, then "any performance gain will be ruined by synchronization
+	// overhead from using multiple queues", so we will stick to one queue.
+	// In addition, the RPCS3 and Xenia projects also only use one queue
 
-	// Create the model matrix
-	// For now, the model matrix will 
-	// be an identity matrix. That means there will be
-	// no translation, scaling, or rotating. The cube
-	// will be rotated in update_uniform_buffer()
-	model_matrix = glm::mat4();
+	// There is one exception. Many GPUs have a queue family that can
+	// only copy memory (a DMA engine), which runs next to the graphics
+	// engine. Copies that go there do not take time away from drawing,
+	// so if the GPU has one, we make a second queue for uploads only.
+	// Rendering and presenting still happen on one queue
 
-	// We multiply the model, the veiw, and the projection matrices together.
-	// We send this MVP matrix to the shader, and then each vertex in the 
-	// geometry is multiplied by MVP. As a result, we will convert the
-	// (X, Y) position of each point 
-	// FROM: 
-	//		the position of the point that is relative to the world
-	// TO:
-	//		the position of the point that is relative to the screen
-	// This allows the fragment shader to know where the vertices are,
-	// so that each pixel of the geometry can be colored, it is exactly
-	// the same as OpenGL
+	//		How to make a queue
 
-	// create the model view and projection matrices
-	glm::mat4x4	MVP = projection_matrix * view_matrix * model_matrix;
-	
-	// put our MVP into the temporary data buffer
-	temporaryData.mvp = MVP;
+	// get number of queues on the GPU
+	uint32_t queue_family_count;
 
-	// make a createInfo for the buffer.
-	// It has the necessary sType, and it
-	// has a usage bit that says this will be 
-	// a Uniform Buffer. Throughout these tutorials
-	// we will be making many buffers that will be used
-	// for many different things. We also set the size to
-	// the size of uniform_struct
-	VkBufferCreateInfo buf_info = {};
-	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-	buf_info.size = sizeof(uniform_struct);
+	// we use NULL for the array of queues to get the count
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_family_count, NULL);
+	assert(queue_family_count >= 1);
 
-	// we make a new CPU buffer, and we copy our data into the buffer.
-	// we give memory_properties (which was created earlier) to help us
-	// create the buffer
-	matrixBufferCPU = new BufferCPU(device, memory_properties, buf_info);
-	matrixBufferCPU->Store(&temporaryData, sizeof(uniform_struct));
-}
+	// we need to find if this queue supports graphics commands.
+	// Rather than putting graphics commands and surface 
+	// submission on seperate queues, we will put them on one queue
 
-void Demo::prepare_sampler()
-{
-	// A sampler is used by the graphics card to get each pixel from the texture. Raw
-	// pixel data from a texture is not enough, the sampler gets the pixel out of the 
-	// texture, depending on UV coordinates. We only need one sampler for the entire
-	// program, regardless of how many textures we have. In extreme cases like
-	// Call of Duty and Grand Theft Auto, they probably have 10 different samplers
-	// (probably less) that are shared for all of their textures
+	// make an array of queue properties
+	VkQueueFamilyProperties *queue_props;
 
-	// Create information about our sampler
-	// Give it the required sType
-	VkSamplerCreateInfo samplerInfo = {};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	// allocate it
+	queue_props = new VkQueueFamilyProperties[queue_family_count];
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_family_count, queue_props);
 
-	// This handles filtering of the texture.
-	// If the pixels of the texture don't perfectly
-	// allign with pixels on the screen, grab the
-	// pixel of the texture that is nearest to the 
-	// pixel on the screen
-	samplerInfo.magFilter = VK_FILTER_NEAREST;
-	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	// we need to get properties of each queue on the graphics device.
+	// out of all the queues on the gpu, we need to know which ones support
+	// presenting to the surface, and which ones don't, so lets make a list
+	// that can hold booleans for all the queues
+	VkBool32 *queueSupportsPresent = new VkBool32[queue_family_count];
 
-	// This is for mipmaps, and we don't have mipmaps
-	// so just ignore this for now. It grabs the nearest 
-	// mipmap layer, but images with no mipmaps will have
-	// all pixels on one layer, so just ignore it for now
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	// Iterate over each queue to learn whether it supports presenting
+	// to the type of surface that we have, which is Win32Surface
+	for (uint32_t i = 0; i < queue_family_count; i++)
+	{
+		// This is one of the functions that are built-in to the Vulkan driver,
+		// we got the pointer to this function earlier in the code.
+		// Without a surface, every graphics queue will do
+		if (surface == VK_NULL_HANDLE)
+			queueSupportsPresent[i] = VK_TRUE;
+		else
+			fpGetPhysicalDeviceSurfaceSupportKHR(gpu, i, surface, &queueSupportsPresent[i]);
+	}
 
-	// All images have UV values that range from 0 to 1.
-	// If we go outside of this 0 to 1 range, then the texture
-	// repeats. Our UVs wont go outside of the 0 to 1 range,
-	// so you can ignore it. We can also use BORDER and CLAMP
-	// which make pixels outside the 0 to 1 range the same as
-	// the pixels on the edge of the texture, or they can all
-	// default to black, it doesn't really matter for now
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	// Search for a graphics and a present queue in the array of queue
+	// families, try to find one that supports both
+	uint32_t queue_family_index = UINT32_MAX;
 
-	// We don't have anisotropy, so the max has to be set to 1
-	samplerInfo.maxAnisotropy = 1;
+	// check the properties of all queues on the device
+	for (uint32_t i = 0; i < queue_family_count; i++)
+	{
+		// if this queue has a property flag that supports
+		// graphics, then we can use this queue as a graphics queue
+		if ((queue_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0)
+		{
+			// if we have not found a queue index for graphics yet
+			if (queueSupportsPresent[i] == VK_TRUE)
+			{
+				// set the graphics index queue equal to this one
+				queue_family_index = i;
+				break;
+			}
+		}
+	}
 
-	// we don't need any compare operations, we just need pixels
-	samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+	// Now look for a family that supports transfers, but not
+	// graphics or compute. That is the dedicated copy engine.
+	// If there is none, uploads go to the graphics queue
+	uint32_t transfer_family_index = queue_family_index;
 
-	// if we are using CLAMP for addressMode, then default 
-	// the pixel color to WHITE
-	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	for (uint32_t i = 0; i < queue_family_count; i++)
+	{
+		VkQueueFlags flags = queue_props[i].queueFlags;
 
-	// create the sampler, based on the information we want
-	vkCreateSampler(device, &samplerInfo, NULL, &sampler);
-}
+		if ((flags & VK_QUEUE_TRANSFER_BIT) != 0 &&
+			(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0)
+		{
+			transfer_family_index = i;
+			break;
+		}
+	}
 
-void Demo::prepare_textures()
-{
-	// This may be hard to believe, but there
-	// are some GPUs out there that do not support
-	// image textures. These GPUs are, of course, not
-	// any kind of consumer-level GPU, but we still should
-	// check the GPu to see if it supports textures, just
-	// in case. Here we create VkFormatProperties to 
-	// check to see if the GPU supports the texture
-	// format we want
-	VkFormatProperties props;
+	// With async compute, look for a family that can compute, but
+	// not draw. Its queue runs next to the graphics queue, so the
+	// culling pass of one frame can overlap the drawing of another
+	uint32_t compute_family_index = UINT32_MAX;
 
-	// This is the texture format we want, it 
-	// is very simple, it has a red channel, a green
-	// channel, a blue channel, and an alpha channel
-	const VkFormat tex_format = VK_FORMAT_R8G8B8A8_UNORM;
+	for (uint32_t i = 0; i < queue_family_count && use_async_compute; i++)
+	{
+		VkQueueFlags flags = queue_props[i].queueFlags;
 
-	// Check the properties that the GPU supports for this 
-	// texture format. If the GPU does not support this format,
-	// then the format properties it returns will be NULL
-	vkGetPhysicalDeviceFormatProperties(gpu, tex_format, &props);
+		if ((flags & VK_QUEUE_COMPUTE_BIT) != 0 && (flags & VK_QUEUE_GRAPHICS_BIT) == 0)
+		{
+			compute_family_index = i;
+			break;
+		}
+	}
 
-	// The process of using a sampler (which we just made) to get
-	// pixels from the texture, is caled "sampling pixels from the image".
+	if (use_async_compute && compute_family_index == UINT32_MAX)
+	{
+		printf("There is no compute-only queue family, async compute is disabled\n");
+		use_async_compute = false;
+	}
 
-	// If our GPU has the ability to sample pixels from
-	// this image format (RGBA), then we can load our texture
-	if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+	// Sparse binds are sent to the graphics queue, so its
+	// family has to support them too
+	bool sparse_queue_supported = queue_family_index != UINT32_MAX &&
+		(queue_props[queue_family_index].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) != 0;
+
+	// we're done checking for support, so we can
+	// delete the array of booleans
+	free(queueSupportsPresent);
+
+	// we don't need queue properties either
+	free(queue_props);
+
+	// Generate error if could not find both a graphics and a present queue
+	if (queue_family_index == UINT32_MAX)
 	{
-		// create a pointer to our png data.
-		// This is not the pixel data, this is
-		// an array that holds every byte of
-		// the PNG texture file
-		char* pngData;
-		
-		// create an int to store the size
-		int png_size;
+		ERR_EXIT("Could not find queue\n", "Swapchain Initialization Failure");
+	}
 
-		// the number of channels that the image
-		// has, honestly just ignore it, we won't 
-		// use it, but we need to have it
-		int nchan;
-		
-		// create variables for the width and
-		// the height of the texture we load
-		int tex_width;
-		int tex_height;
-
-		// Use a helper function to read the file. 
-		// Every pixel in the flie will be copied into the pngData
-		// array of bytes, and the size of the array will go into png_size
-		Helper::ReadFile("../../../Assets/logo.png", &pngData, &png_size);
-
-		// Use STB Image to texture data from the PNG bytes.
-		// I personally use STB becasue it is lightweight and it
-		// works on every platform that I develop for. It works
-		// with OpenGL, DirectX 11 / 12, Xbox One, Switch, PlayStation, and more
-
-		// We give it the pngData, and the size,
-		// then the function gives us (via pointers) the texture's width and height,
-		// as well as the number of channels, which we ignore. The function returns
-		// a pointer (stored into 'img'), which is the pointer to the pixel data that
-		// the PNG holds
-		stbi_uc* img = stbi_load_from_memory((const stbi_uc*)pngData, png_size, &tex_width, &tex_height, &nchan, 4);
-
-		// now that the image is loaded, we don't need the original file data
-		// we delete pngData, and use 'img', the pointer to our pixels
-		delete pngData;
-
-		// We are going to combine what we did to create the Vertex / Index buffers,
-		// with what we did to create the depth buffers. We need to create a CPU
-		// buffer to hold the pixel data, then we need to create an identical GPU
-		// buffer that is empty, then we need to copy the pixel data from the CPU
-		// buffer to the GPU, so that it can be used by the shaders
-
-		// information we need to create the buffer
-		VkBufferCreateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;	// sType always needs to be this
-		info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;		// this is a source, which will be copied to the GPU
-		info.size = tex_width * tex_height * 4;				// amount of bytes in the image
-
-		textureCPU = new BufferCPU(device, memory_properties, info);
-		textureCPU->Store(img, (int)info.size);
-
-		// after copying this to the buffer
-		// we don't need the original,
-		stbi_image_free(img);
-
-		// The CPU buffer is ready, now we need the GPU buffer
-
-		// Just like when we created the depth buffer,
-		// we have a VkImageCreateInfo. We give it the
-		// required sType, we let it know that it is a 2D
-		// image, we give it the texture dimensions, we 
-		// let it know that this is PREINITIALIZED, which means
-		// that the GPU buffer  is currently empty 
-		VkImageCreateInfo image_create_info = {};
-		image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		image_create_info.imageType = VK_IMAGE_TYPE_2D;
-		image_create_info.format = tex_format;
-		image_create_info.extent.width = tex_width;
-		image_create_info.extent.height = tex_height;
-		image_create_info.extent.depth = 1;
-		image_create_info.mipLevels = 1;
-		image_create_info.arrayLayers = 1;
-		image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-		image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-		image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		image_create_info.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+	// queues will have no priorities
+	float queue_priorities[1] = { 0.0 };
 
-		// We create the GPU texture the same way that
-		// we created the depth buffer, except this time,
-		// we use the Color aspect instead of depth
-		textureGPU = new TextureGPU(
-			device,
-			memory_properties,
-			image_create_info,
-			VK_IMAGE_ASPECT_COLOR_BIT);
+	// create a queue info
+	// this will describe how many queues to make (just one)
+	// and which family indices to make the queues at (just one).
+	// If we found a transfer-only family, we make a second
+	// queue info for one queue in that family
+	VkDeviceQueueCreateInfo queueInfo[3] = {};
+	queueInfo[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueInfo[0].queueFamilyIndex = queue_family_index;
+	queueInfo[0].queueCount = 1;
+	queueInfo[0].pQueuePriorities = queue_priorities;
+
+	uint32_t queueInfoCount = 1;
+
+	if (transfer_family_index != queue_family_index)
+	{
+		queueInfo[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueInfo[1].queueFamilyIndex = transfer_family_index;
+		queueInfo[1].queueCount = 1;
+		queueInfo[1].pQueuePriorities = queue_priorities;
+		queueInfoCount = 2;
+	}
+
+	// create the device info
+	// this tells us how a device will be made,
+	// with the extensions that we can enable,
+	// and with our queueInfo
+	VkDeviceCreateInfo deviceInfo = {};
+	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceInfo.queueCreateInfoCount = queueInfoCount;
+	deviceInfo.pQueueCreateInfos = queueInfo;
+	deviceInfo.enabledExtensionCount = enabled_extension_count;
+	deviceInfo.ppEnabledExtensionNames = (const char *const *)extension_names;
+
+	// The GPU culling pass writes many draws into one buffer
+	// (multiDrawIndirect), and each draw starts at the instance
+	// of its object (drawIndirectFirstInstance). If the GPU can't
+	// do that, we draw the objects without GPU culling
+	VkPhysicalDeviceFeatures supported_features;
+	vkGetPhysicalDeviceFeatures(gpu, &supported_features);
 
-		// We put a command in the command buffer that we want to copy an image
-		// from the CPU to the GPU. This command will execute when we submit
-		// the initCmd command buffer to the queue, which happens later in prepare().
-		// It works the same way as normal buffers, except we give it the texture
-		// parameters, and a few extra steps are required under-the-hood in the 
-		// TextureGPU class. Students don't need to understand how TextureGPU works,
-		// but they can try to learn it if they want to. What is important is that
-		// they know how to use the class.
-		textureGPU->Store(initCmd, textureCPU->buffer, tex_width, tex_height);
+	VkPhysicalDeviceFeatures enabled_features = {};
+
+	if (use_gpu_culling)
+	{
+		if (supported_features.multiDrawIndirect && supported_features.drawIndirectFirstInstance)
+		{
+			enabled_features.multiDrawIndirect = VK_TRUE;
+			enabled_features.drawIndirectFirstInstance = VK_TRUE;
+		}
+		else
+		{
+			printf("multiDrawIndirect is not supported, GPU culling is disabled\n");
+			use_gpu_culling = false;
+			use_async_compute = false;
+		}
 	}
 
-	// If the GPU does not support the ability to sample
-	// pixels from this texture format with our sampler, 
-	// then give an error that says the format is not supported
-	else
+	// Meshlet culling draws the visible meshlets of a cube with one
+	// indirect draw, which needs multiDrawIndirect when there is more
+	// than one draw. Without it, each draw is its own indirect draw
+	meshlet_multi_draw = false;
+
+	if (use_meshlets && supported_features.multiDrawIndirect)
 	{
-		assert(!"No support for R8G8B8A8_UNORM as texture image format");
+		enabled_features.multiDrawIndirect = VK_TRUE;
+		meshlet_multi_draw = true;
 	}
-}
 
-void Demo::prepare_descriptor_layout()
-{
-	// Each descriptorSetLayoutBinding will describe what type
-	// of descriptor we will have at each binding in the shaders
-	VkDescriptorSetLayoutBinding layout_bindings[2];
-	memset(layout_bindings, 0, sizeof(VkDescriptorSetLayoutBinding) * 2);
+	// one queue in the compute-only family, for
+	// the culling pass, if it still runs on the GPU
+	if (use_async_compute)
+	{
+		queueInfo[queueInfoCount].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueInfo[queueInfoCount].queueFamilyIndex = compute_family_index;
+		queueInfo[queueInfoCount].queueCount = 1;
+		queueInfo[queueInfoCount].pQueuePriorities = queue_priorities;
+		queueInfoCount++;
+		deviceInfo.queueCreateInfoCount = queueInfoCount;
+	}
 
-	// What I like about the VkDescriptorSetLayoutBinding is that
-	// it is structured similarly to an english sentence. For
-	// example, look at the comment below, compared to the 
-	// structure
+	// the bindless fragment shader indexes into an array of
+	// textures, this was checked in prepare_physical_device
+	if (use_bindless_textures)
+		enabled_features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
 
-	// In the Veretx Shader, at binding 0, we have 1 descriptor, which is a uniform buffer
-	layout_bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	layout_bindings[0].binding = 0;
-	layout_bindings[0].descriptorCount = 1;
-	layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	// Anisotropic filtering keeps textures sharp when they are seen
+	// at a steep angle, like the sides of the cube when it turns away
+	// from the camera. Almost every GPU has it, but it is still a feature
+	if (use_anisotropy)
+	{
+		if (supported_features.samplerAnisotropy)
+			enabled_features.samplerAnisotropy = VK_TRUE;
+		else
+		{
+			printf("samplerAnisotropy is not supported, anisotropic filtering is disabled\n");
+			use_anisotropy = false;
+		}
+	}
 
-	// In the Fragment Shader, at binding 1, we have 1 descriptor, which is an image
-	layout_bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-	layout_bindings[1].binding = 1;
-	layout_bindings[1].descriptorCount = 1;
-	layout_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	// Pipeline statistics queries are a feature, and the draws are
+	// recorded in secondary command buffers, which are executed while the
+	// query is active, so the secondary buffers need inheritedQueries
+	if (use_pipeline_statistics)
+	{
+		if (supported_features.pipelineStatisticsQuery && supported_features.inheritedQueries)
+		{
+			enabled_features.pipelineStatisticsQuery = VK_TRUE;
+			enabled_features.inheritedQueries = VK_TRUE;
+		}
+		else
+		{
+			printf("pipelineStatisticsQuery is not supported, pipeline statistics are disabled\n");
+			use_pipeline_statistics = false;
+		}
+	}
 
-	// That was easy enough, and it didn't require sType
-	// Now we have to create a descriptor layout with our array
-	// of descriptor layout bindings
+	// Sparse textures bind memory to the tiles of an image
+	// (sparseResidencyImage2D), and binding needs sparseBinding
+	if (use_sparse_textures)
+	{
+		if (supported_features.sparseBinding && supported_features.sparseResidencyImage2D && sparse_queue_supported)
+		{
+			enabled_features.sparseBinding = VK_TRUE;
+			enabled_features.sparseResidencyImage2D = VK_TRUE;
+		}
+		else
+		{
+			printf("sparseResidencyImage2D is not supported, sparse textures are disabled\n");
+			use_sparse_textures = false;
+		}
+	}
 
-	// descriptor layout with two bindings
-	// we give it the array, and we let the structure
-	// know that there are 2 elements in the array.
-	// sType is required
-	VkDescriptorSetLayoutCreateInfo descriptor_layout = {};
-	descriptor_layout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	descriptor_layout.bindingCount = 2;
-	descriptor_layout.pBindings = layout_bindings;
+	deviceInfo.pEnabledFeatures = &enabled_features;
 
-	// create the descriptor layout with the information we provided
-	vkCreateDescriptorSetLayout(device, &descriptor_layout, NULL, &desc_layout);
-}
+	// Features of extensions are turned on with structs in the
+	// pNext chain of the deviceInfo, each one points to the next.
+	// Every GPU that has the timeline semaphore extension
+	// supports the feature, but it still has to be turned on
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
 
-void Demo::prepare_descriptor_pool()
-{
-	// There are two types of descriptors in the pool
-	// Uniform Buffer Descriptors
-	// Texture Descriptors
-	// We need to keep count of how many there are of each
-	VkDescriptorPoolSize type_counts[2];
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentIdFeatures.presentId = VK_TRUE;
 
-	// descriptor count is the number of buffers (of each type)
-	// that will be used in all pipelines for the entire program.
-	// In this case, its one uniform buffer and one texture.
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	presentWaitFeatures.presentWait = VK_TRUE;
 
-	// we will have one uniform buffer in the entire program
-	type_counts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	type_counts[0].descriptorCount = 1;
+	VkPhysicalDeviceAntiLagFeaturesAMD antiLagFeatures = {};
+	antiLagFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ANTI_LAG_FEATURES_AMD;
+	antiLagFeatures.antiLag = VK_TRUE;
 
-	// we will have one image sampler in the entire program
-	type_counts[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	type_counts[1].descriptorCount = 1;
+	VkPhysicalDevicePerformanceQueryFeaturesKHR performanceFeatures = {};
+	performanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PERFORMANCE_QUERY_FEATURES_KHR;
+	performanceFeatures.performanceCounterQueryPools = VK_TRUE;
 
-	// poolSizeCount is 2 
-	// that is the number of elements in the type_counts array.
-	// If we increase the number of descriptors, this number should
-	// still be two. We would increase that number of we wanted
-	// other types of descriptors, like Storage Buffers (compute)
-	
-	// Max Sets will store the number of dsecriptor sets that
-	// we will have in the pool, which will be just one,
-	// we will talk more about sets right after this function is done
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+	indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
 
-	VkDescriptorPoolCreateInfo descriptor_pool = {};
-	descriptor_pool.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	descriptor_pool.maxSets = 1;
-	descriptor_pool.poolSizeCount = 2;
-	descriptor_pool.pPoolSizes = type_counts;
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures = {};
+	libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+	libraryFeatures.graphicsPipelineLibrary = VK_TRUE;
 
-	// create descriptor pool, based on the information provided
-	vkCreateDescriptorPool(device, &descriptor_pool, NULL, &desc_pool);
-}
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR renderingFeatures = {};
+	renderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+	renderingFeatures.dynamicRendering = VK_TRUE;
 
-void Demo::prepare_descriptor_set()
-{
-	// we need to allocate a space in memory for
-	// our descriptor set. In this case, we will
-	// only have one descriptor set. This set will
-	// be stored in the descriptor pool that we made,
-	// and this descriptor set will use the layout that
-	// we made earlier (desc_layout) which is given to
-	// the pipeline (explained later)
-	VkDescriptorSetAllocateInfo alloc_info = {};
-	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	alloc_info.descriptorPool = desc_pool;
-	alloc_info.descriptorSetCount = 1;
-	alloc_info.pSetLayouts = &desc_layout;
-	vkAllocateDescriptorSets(device, &alloc_info, &descriptor_set);
+	VkPhysicalDeviceBufferDeviceAddressFeaturesEXT addressFeatures = {};
+	addressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_EXT;
+	addressFeatures.bufferDeviceAddress = VK_TRUE;
 
-	// The first descriptor will be the uniform buffer
-	// because this descriptor is at binding #0 of the shader
-	VkDescriptorBufferInfo buffer_info = {};
-	buffer_info.range = sizeof(uniform_struct);
-	buffer_info.buffer = matrixBufferCPU->buffer;
+	// every GPU that has the attachment rate has the pipeline rate,
+	// and the image combines its rate with the rate of the pipeline
+	VkPhysicalDeviceFragmentShadingRateFeaturesKHR shadingRateFeatures = {};
+	shadingRateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
+	shadingRateFeatures.pipelineFragmentShadingRate = VK_TRUE;
+	shadingRateFeatures.attachmentFragmentShadingRate = use_shading_rate_image ? VK_TRUE : VK_FALSE;
 
-	// The next descriptor is the texture descriptor,
-	// because this descriptor is at binding #1 of the shader
-	VkDescriptorImageInfo texDesc = {};
-	texDesc.sampler = sampler;
-	texDesc.imageView = textureGPU->imageView;
-	texDesc.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	VkPhysicalDeviceConditionalRenderingFeaturesEXT conditionalFeatures = {};
+	conditionalFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONDITIONAL_RENDERING_FEATURES_EXT;
+	conditionalFeatures.conditionalRendering = VK_TRUE;
 
-	// VkWriteDescriptorSet does not a structure that allows
-	// us to write to an entire set of descriptors,
-	// it is a structure that allows us to write to one descriptor
-	// that is part of a set
+	VkPhysicalDeviceHostImageCopyFeaturesEXT hostCopyFeatures = {};
+	hostCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+	hostCopyFeatures.hostImageCopy = VK_TRUE;
 
-	// we need two of these, one for each descriptor in the set
-	VkWriteDescriptorSet writes[2];
-	
-	// this initializes the bytes in the array to all be zero
-	memset(&writes, 0, sizeof(writes));
+	VkPhysicalDeviceSamplerYcbcrConversionFeaturesKHR ycbcrFeatures = {};
+	ycbcrFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES_KHR;
+	ycbcrFeatures.samplerYcbcrConversion = VK_TRUE;
 
-	// sType is required
-	// we are writing one descriptor per structure, so the 
-	// descriptorCount per structure will be 1
-	// dstSet is the destination set that we want to write to,
-	// we only have one descriptor set (called "descriptor_set")
-	// so that is the one we are using
-	
-	// The binding we are writing to is 0
-	// The type of descriptor in this structure is a UNIFORM_BUFFER
-	// and buffer_info is the VkDescriptorBufferInfo that we made
-	// just a minute ago in this function
-	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	writes[0].descriptorCount = 1;
-	writes[0].dstSet = descriptor_set;
-	writes[0].dstBinding = 0;
-	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	writes[0].pBufferInfo = &buffer_info;
+	VkPhysicalDeviceFloat16Int8FeaturesKHR float16Features = {};
+	float16Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FLOAT16_INT8_FEATURES_KHR;
+	float16Features.shaderFloat16 = VK_TRUE;
 
-	// sType, descriptorCount, and dstSet is the same as before
-	// The binding we are writing to is 1
-	// The type of descriptor in this structure is a IMAGE_SAMPLER
-	// and buffer_info is the VkDescriptorImageInfo that we made
-	// just a minute ago in this function
-	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	writes[1].descriptorCount = 1;
-	writes[1].dstSet = descriptor_set;
-	writes[1].dstBinding = 1;
-	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	writes[1].pImageInfo = &texDesc;
+	void* featureChain = NULL;
 
-	// update the descriptors, we give it the device (GPU),
-	// we give it 2, because there are two elements in the
-	// "writes" array, and we give it the "writes" array
-	vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
-}
+	if (use_timeline_semaphores)
+	{
+		timelineFeatures.pNext = featureChain;
+		featureChain = &timelineFeatures;
+	}
 
-void Demo::prepare_vb_ib()
-{
-	// Create empty creationInfo
-	// we will be re-using this several times
-	// Leave it empty for now
-	VkBufferCreateInfo info = {};
+	if (present_wait_enabled)
+	{
+		presentIdFeatures.pNext = featureChain;
+		presentWaitFeatures.pNext = &presentIdFeatures;
+		featureChain = &presentWaitFeatures;
+	}
+	else if (present_id_enabled)
+	{
+		presentIdFeatures.pNext = featureChain;
+		featureChain = &presentIdFeatures;
+	}
 
-	// Vertex Buffer
-	//=====================================
+	if (anti_lag_enabled)
+	{
+		antiLagFeatures.pNext = featureChain;
+		featureChain = &antiLagFeatures;
+	}
 
-	// We make an array of 36 vertices
-	// There are 8 different positions on a cube, but if 
-	// you include UVs, then there are 36 total different vertices
-	VertexStructure vertexArray[36];
+	if (performance_query_enabled)
+	{
+		performanceFeatures.pNext = featureChain;
+		featureChain = &performanceFeatures;
+	}
 
-	// We will copy data into the vertex array from 
-	// arrays called g_vertex_buffer_data, and 
-	// g_uv_buffer_data. These arrays can be found
-	// in the CCubeDataArrays.h file, when we load
-	// 3D Obj files in the future, we won't need to do this
-	for (unsigned int i = 0; i < 36; i++)
+	if (use_bindless_textures)
 	{
-		vertexArray[i].position[0] = g_vertex_buffer_data[i * 3];
-		vertexArray[i].position[1] = g_vertex_buffer_data[i * 3 + 1];
-		vertexArray[i].position[2] = g_vertex_buffer_data[i * 3 + 2];
-		vertexArray[i].uv[0] = g_uv_buffer_data[2 * i];
-		vertexArray[i].uv[1] = g_uv_buffer_data[2 * i + 1];
+		indexingFeatures.pNext = featureChain;
+		featureChain = &indexingFeatures;
 	}
 
-	// The size of our Vertex Array, will be the amount of 
-	// elements (36) multiplied by the size of one vertex
-	uint32_t vertexArraySize = 36 * sizeof(VertexStructure);
+	if (use_pipeline_library)
+	{
+		libraryFeatures.pNext = featureChain;
+		featureChain = &libraryFeatures;
+	}
 
-	// Lets make a buffer that is designed to be
-	// a source (TRANSFER_SRC), that is large enough
-	// to hold our vertex buffer
-	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	info.size = vertexArraySize;
-
-	// make the buffer, and store the data into the buffer
-	// For more information on how this works, look at BufferCPU.cpp
-	// Learning about BufferCPU is optional
-	vertexDataCPU = new BufferCPU(device, memory_properties, info);
-	vertexDataCPU->Store(vertexArray, vertexArraySize);
-
-	// This next buffer will be on the GPU, it is designed to be a 
-	// destination (TRANSFER_DST) for our data, and it will also be
-	// a VERTEX_BUFFER, which allows us to bind this buffer as a
-	// vertex buffer when we set up the pipeline
-	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	info.size = vertexArraySize;
-
-	// build the buffer, and make a command to send the data from the CPU 
-	// buffer to the GPU buffer. This command will be added to the initCmd
-	// command buffer, and the data will finally be copied from CPU to GPU
-	// when we execute the initCmd command buffer (later in prepare).
-	// After that, we will delete the CPU buffer, becasue it won't be
-	// needed once the data is copied to GPU.
-	// For more information on how this works, look at BufferGPU.cpp
-	// Learning about BufferGPU is optional
-	vertexDataGPU = new BufferGPU(device, memory_properties, info);
-	vertexDataGPU->Store(initCmd, vertexDataCPU->buffer, vertexArraySize);
-
-	// Index Buffer
-	//=====================================
+	if (use_dynamic_rendering)
+	{
+		renderingFeatures.pNext = featureChain;
+		featureChain = &renderingFeatures;
+	}
 
-	// We make an array of indices
-	// These indices will determine which vertices
-	// to connect for each triangle. It will connect
-	// the first three indices into a triangle, and 
-	// then the next three, and so on.
-	std::vector<uint32_t> indexArray;
+	if (use_vertex_pulling)
+	{
+		addressFeatures.pNext = featureChain;
+		featureChain = &addressFeatures;
+	}
 
-	// For this simple tutorial, the index buffer
-	// is { 0, 1, 2, 3... }
-	for (int i = 0; i < 36; i++)
-		indexArray.push_back(i);
+	if (use_shading_rate || use_shading_rate_image)
+	{
+		shadingRateFeatures.pNext = featureChain;
+		featureChain = &shadingRateFeatures;
+	}
 
-	// For more complicated 3D models (covered in later
-	// tutorials), we will be using index buffers to 
-	// lower the amount of vertices in the Vertex Buffer
-	// by removing repeating vertices. We also have an
-	// OpenGL tutorial on ATLAS that teaches this concept
+	if (use_occlusion_queries)
+	{
+		conditionalFeatures.pNext = featureChain;
+		featureChain = &conditionalFeatures;
+	}
 
-	// The size of this index array will be the number
-	// of elements, multiplied by the size of one element
-	uint32_t indexArraySize = 36 * sizeof(uint32_t);
+	if (use_host_image_copy)
+	{
+		hostCopyFeatures.pNext = featureChain;
+		featureChain = &hostCopyFeatures;
+	}
 
-	// This is the Index CPU buffer, so we useTRANSFER_SRC 
-	// because we will copy the buffer to GPU
-	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	info.size = indexArraySize;
+	if (use_video_texture)
+	{
+		ycbcrFeatures.pNext = featureChain;
+		featureChain = &ycbcrFeatures;
+	}
 
-	// Just like before, we make the buffer and we store data into it
-	indexDataCPU = new BufferCPU(device, memory_properties, info);
-	indexDataCPU->Store(indexArray.data(), indexArraySize);
+	if (use_half_precision)
+	{
+		float16Features.pNext = featureChain;
+		featureChain = &float16Features;
+	}
 
-	// This is the Index GPU buffer, so we use TRANSFER_DST 
-	// because we will get data from CPU, just like the Vertex
-	// GPU buffer
-	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	info.size = indexArraySize;
+	// With a device group, the device is made from every GPU in the
+	// group. Memory and resources are on every GPU, and each command
+	// buffer is only run on the GPUs in its device mask
+	VkDeviceGroupDeviceCreateInfoKHR groupInfo = {};
+	groupInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_DEVICE_CREATE_INFO_KHR;
+	groupInfo.physicalDeviceCount = (uint32_t)device_group_devices.size();
+	groupInfo.pPhysicalDevices = device_group_devices.data();
 
-	// build the buffer, and add a command to the initCmd command buffer
-	// to copy data from the CPU buffer to the GPU buffer
-	indexDataGPU = new BufferGPU(device, memory_properties, info);
-	indexDataGPU->Store(initCmd, indexDataCPU->buffer, indexArraySize);
-}
+	if (use_device_group)
+	{
+		groupInfo.pNext = featureChain;
+		featureChain = &groupInfo;
+	}
 
-void Demo::prepare_depth_buffer()
-{
-	// The depth buffer holds the depth of each 
-	// pixel, so that when the final image is being
-	// created, the GPU will prioritize pixels with
-	// the smallest depth. That way, polygons closer
-	// to the camera will draw on top of polygons
-	// that are farther from the camera.
-	
-	// This ^^ is set in pipelineState's
-	// depthStencilState, which will be described
-	// later. That is what allows us to choose
-	// what the depth buffer is used for
+	deviceInfo.pNext = featureChain;
 
-	// The format of this image will be 16-bit.
-	// There will be 16 bits that will store the depth 
-	// of each pixel, which is plenty for this example.
-	// If a scene has more depth, it can be expanded
-	// to D32_UNORM
-	const VkFormat depth_format = VK_FORMAT_D16_UNORM;
+	// This function is called vkCreateDevice, but it actually
+	// creates the device, and the queues, at the same time.
+	// This works because the queueInfo is inside the deviceInfo.
+	// A Demo that shares the device takes it from the context, like
+	// the instance, and the queues that it needs have to be there
+	if (makes_device)
+	{
+		vkCreateDevice(gpu, &deviceInfo, HostAllocator::callbacks, &device);
 
-	// We create an image for the depth buffer.
-	// This is our first time making an image by hand,
-	// because the Swapchain's create-function generated
-	// the images for us, and then we put the images
-	// into an imageView. This is how an image is created
-	// normally
+		device_context->gpu = gpu;
+		device_context->device = device;
+		device_context->extensions.assign(extension_names, extension_names + enabled_extension_count);
+		device_context->queueFamilies.clear();
 
-	// The sType is always the same
-	// This is a 2D image, not an array, not a skybox
-	// we give it the format
-	// we give it the width and height (same as screen size)
-	// the depth is 1, but this depth is not the same as pixel depth.
-	// There are 3D textures that have a width, height, and depth.
-	// This is a 2D image, so we have a width, a height, and a depth of 1 pixel
-	// the usage of this image is for the depth stencil
-	VkImageCreateInfo image = {};
-	image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	image.imageType = VK_IMAGE_TYPE_2D;
-	image.format = depth_format;
-	image.extent.width = width;
-	image.extent.height = height;
-	image.extent.depth = 1;
-	image.mipLevels = 1;
-	image.arrayLayers = 1;
-	image.samples = VK_SAMPLE_COUNT_1_BIT;
-	image.tiling = VK_IMAGE_TILING_OPTIMAL;
-	image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		for (uint32_t i = 0; i < deviceInfo.queueCreateInfoCount; i++)
+			device_context->queueFamilies.push_back(queueInfo[i].queueFamilyIndex);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < enabled_extension_count; i++)
+		{
+			if (!device_context->HasExtension(extension_names[i]))
+			{
+				printf("The shared device was made without %s\n", extension_names[i]);
+				ERR_EXIT("A Demo needs a device extension that the shared device does not have.\n",
+					"vkCreateDevice Failure");
+			}
+		}
 
-	// We use our TextureGPU class to make a special type of buffer for the texture
-	// that is on the GPU. Unlike the Vertex and Index buffers, we do not copy
-	// a CPU buffer into this GPU image, because depth information is generated
-	// by the GPU. The GPU will store data here, and read data here, no CPU involvement
-	// is necessary. We tell the GPU to use this buffer in the render_pass function,
-	// which will be explained later
-	depthBufferGPU = new TextureGPU(
-		device,
-		memory_properties,
-		image,
-		VK_IMAGE_ASPECT_DEPTH_BIT);
+		for (uint32_t i = 0; i < deviceInfo.queueCreateInfoCount; i++)
+		{
+			if (!device_context->HasQueueFamily(queueInfo[i].queueFamilyIndex))
+			{
+				ERR_EXIT("A Demo needs a queue family that the shared device has no queue of.\n",
+					"vkCreateDevice Failure");
+			}
+		}
 
-	// we give it the format of depth that we want it to use,
-	// which was set earlier in the function
-	depthBufferGPU->format = depth_format;
+		device = device_context->device;
+	}
+
+	// now that the device is created, the queues must also be created as well.
+	// This function does not create the queues, because VkCreateDevice created the queues,
+	// so insteadm, this function gets the queue from the device
+	vkGetDeviceQueue(device, queue_family_index, 0, &queue);
+	vkGetDeviceQueue(device, transfer_family_index, 0, &transfer_queue);
+
+	// save the family indices, command pools and 
+	// ownership barriers need to know them
+	graphics_queue_family_index = queue_family_index;
+	transfer_queue_family_index = transfer_family_index;
+
+	if (transfer_family_index != queue_family_index)
+		printf("Using queue family %d for uploads\n", transfer_family_index);
+
+	// Buffers that the compute queue and the graphics queue both use
+	// are CONCURRENT, with every family that touches them in this list
+	// (the transfer family copies the instance buffer), so they never
+	// need an ownership transfer
+	compute_queue = VK_NULL_HANDLE;
+	compute_queue_family_index = UINT32_MAX;
+	async_compute_families.clear();
+
+	if (use_async_compute)
+	{
+		vkGetDeviceQueue(device, compute_family_index, 0, &compute_queue);
+		compute_queue_family_index = compute_family_index;
+
+		async_compute_families.push_back(queue_family_index);
+		async_compute_families.push_back(compute_family_index);
+
+		if (transfer_family_index != queue_family_index)
+			async_compute_families.push_back(transfer_family_index);
+
+		printf("Using queue family %d for async compute\n", compute_family_index);
+	}
 }
 
-void Demo::execute_init_cmd()
+void Demo::prepare_device_functionPointers()
 {
-	// end the initialization command buffer.
-	// all command buffers need to be ended
-	// before submission, and now we are ready
-	// to submit this list of commands, which should
-	// copy buffers from CPU to GPU (vertex, index,
-	// textures, etc).
-	vkEndCommandBuffer(initCmd);
+	// When we ran the function prepare_instance_functionPointers() earlier in the code,
+	// it allowed us to use the VkInstance to get functions that are not found in the SDK's .lib or .dll files,
+	// but are instead in the Vulkan driver. Now, rather than using the VkInstance to get functions,
+	// we will get some functions that are in the driver, but are only accessible through the VkDevice
 
-	// we create a VkSubmitInfo
-	// All we do here, is provide information that
-	// says there will be one command buffer, which
-	// is the initialization command buffer.
-	// no other information is needed right now
+	// Previously, in prepare_instance_functionPointers(), we used vkGetInstanceProcAddr in the 
+	// GET_INSTANCE_PROC_ADDR macro function to get function-pointers from the driver, via the VkInstance.
 
-	// other members of VkSubmitInfo this structure include
-	// semaphores to wait for, and semaphores to trigger,
-	// allowing for certain command buffers to wait for 
-	// other command buffers to finish, prior to execution
-	VkSubmitInfo submit_info = {};
-	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &initCmd;
+	// This time, we will use fpGetDeviceProcAddr in the GET_DEVICE_PROC_ADDR macro function to get
+	// function-pointers from the VUlkan driver, via the VkDevice (our graphics card).
+	
+	// An important note is that the vkGetInstanceProcAddr function was built-in to the SDK,
+	// while fpGetDeviceProcAddr itself is a function pointer, which we got earlier in
+	// prepare_instance_functionPointers()
 
-	// we submit the VkSubmitInfo to the queue
-	// so that the command buffer can be executed 
-	// by the GPU.
+	#define GET_DEVICE_PROC_ADDR(dev, entrypoint)															\
+    {																										\
+        fp##entrypoint = (PFN_vk##entrypoint) fpGetDeviceProcAddr(dev, "vk" #entrypoint);					\
+        if (fp##entrypoint == NULL)																			\
+		{																									\
+            ERR_EXIT("vkGetDeviceProcAddr failed to find vk" #entrypoint, "vkGetDeviceProcAddr Failure");	\
+        }																									\
+    }
 
-	// we give it the fence, which is "closed" by default.
-	// when the GPU finishes executing the command buffer,
-	// then the GPU will "open" the fence.
-	vkQueueSubmit(queue, 1, &submit_info, initFence);
+	// The functions that we call every frame (every vkCmd, vkQueueSubmit,
+	// and the fences) are called through DeviceTable, which gets them from
+	// the device too, so they skip the loader, see DeviceTable.h
+	DeviceTable::Load(fpGetDeviceProcAddr, device);
 
-	// after the queue is finished, we have to wait until command
-	// buffer is finished executing, we will know it is done when
-	// the "fence" tells us, with this function.
+	// All of these functions will be used later on in the code,
+	// and they will be thoroughly explained when it is time to use them.
+	// In headless mode, the swapchain might not be there at all
+	fpCreateSwapchainKHR = NULL;
+	fpDestroySwapchainKHR = NULL;
+	fpGetSwapchainImagesKHR = NULL;
+	fpAcquireNextImageKHR = NULL;
+	fpQueuePresentKHR = NULL;
+
+	if (swapchain_enabled)
+	{
+		GET_DEVICE_PROC_ADDR(device, CreateSwapchainKHR);
+		GET_DEVICE_PROC_ADDR(device, DestroySwapchainKHR);
+		GET_DEVICE_PROC_ADDR(device, GetSwapchainImagesKHR);
+		GET_DEVICE_PROC_ADDR(device, AcquireNextImageKHR);
+		GET_DEVICE_PROC_ADDR(device, QueuePresentKHR);
+	}
 
-	// vkWaitForFences will pause the program while a fence is 
-	// closed. 
-	
-	// Imageine in real life, 
-	// standing in front of a physical fence,
-	// the fence is closed, so you cannot continue walking.
-	// When the fence opens, you continue walking. 
-	
-	// Our C++ code sees that the fence is closed, so it pauses.
-	// When the fence is open, our code will contiue past this line
-	vkWaitForFences(device, 1, &initFence, VK_TRUE, UINT64_MAX);
+	// this one is only here if the extension was enabled
+	fpCmdDrawIndexedIndirectCountKHR = NULL;
 
-	// Now that we've gotten past that line ^^
-	// that means the fence must be open,
-	// which means the GPU must be finished executing 
-	// the initalization command buffer
+	if (draw_indirect_count_supported)
+		GET_DEVICE_PROC_ADDR(device, CmdDrawIndexedIndirectCountKHR);
 
-	// We will need the command buffer later if we resize
-	// the window (to rebuild the depth buffer), so lets
-	// not delete the command buffer, but instead clear it,
-	// so that can be used again
+	fpGetRefreshCycleDurationGOOGLE = NULL;
+	fpGetPastPresentationTimingGOOGLE = NULL;
+	fpWaitSemaphoresKHR = NULL;
+	fpGetSemaphoreCounterValueKHR = NULL;
+	fpWaitForPresentKHR = NULL;
+	fpCreateDescriptorUpdateTemplateKHR = NULL;
+	fpDestroyDescriptorUpdateTemplateKHR = NULL;
+	fpUpdateDescriptorSetWithTemplateKHR = NULL;
+	fpCmdPushDescriptorSetWithTemplateKHR = NULL;
 
-	// reset the command buffer
-	vkResetCommandBuffer(initCmd, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
+	if (present_wait_enabled)
+		GET_DEVICE_PROC_ADDR(device, WaitForPresentKHR);
 
-	// same for fence, don't destroy, just reset
-	vkResetFences(device, 1, &initFence);
-}
+	fpSetLatencySleepModeNV = NULL;
+	fpLatencySleepNV = NULL;
+	fpSetLatencyMarkerNV = NULL;
+	fpAntiLagUpdateAMD = NULL;
 
-void Demo::prepare_render_pass()
-{
-	// The Render Pass describes what the GPU is outputting.
-	// Every time we draw a scene on the graphics card, we want the 
-	// graphics card to give us an image (which goes on the screen),
-	// and a depth buffer, to make sure objects close to the camera are drawn
-	// on top of the objects that are far away from the camera.
-	// In previous tutorials, there was only color, but now there is color and depth
+	if (latency_nv_enabled)
+	{
+		GET_DEVICE_PROC_ADDR(device, SetLatencySleepModeNV);
+		GET_DEVICE_PROC_ADDR(device, LatencySleepNV);
+		GET_DEVICE_PROC_ADDR(device, SetLatencyMarkerNV);
+	}
 
-	// The initial layout for the color and depth attachments will be LAYOUT_UNDEFINED
-	// because at the start of the renderpass, we don't care about their contents.
-	// At the start of the subpass, the color attachment's layout will be transitioned
-	// to LAYOUT_COLOR_ATTACHMENT_OPTIMAL and the depth stencil attachment's layout
-	// will be transitioned to LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL.  At the end of
-	// the renderpass, the color attachment's layout will be transitioned to
-	// LAYOUT_PRESENT_SRC_KHR to be ready to present.  This is all done as part of
-	// the renderpass, no barriers are necessary.
-	VkAttachmentDescription attachments[2];
+	if (anti_lag_enabled)
+		GET_DEVICE_PROC_ADDR(device, AntiLagUpdateAMD);
 
-	// The first attachment is our color
-	attachments[0].format = format;
-	attachments[0].flags = 0;
-	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	fpGetCalibratedTimestampsEXT = NULL;
 
-	// The second attachment is our depth
-	attachments[1].format = depthBufferGPU->format;
-	attachments[1].flags = 0;
-	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	if (calibrated_timestamps_enabled)
+		GET_DEVICE_PROC_ADDR(device, GetCalibratedTimestampsEXT);
 
-	// For now, the attatchments array is finished, we 
-	// will use the array at the bottom of the function, don't
-	// worry about it for now
+	fpAcquireProfilingLockKHR = NULL;
+	fpReleaseProfilingLockKHR = NULL;
 
-	// Now we need to make what is called a "subpass" which is 
-	// part of the render pass. The subpass needs a color reference
-	// and a depth reference, so we tell it that the color reference
-	// will be the first attachment (0) as we described in the
-	// attachments array, and we tell it that depth will be the 
-	// second attachment (1), as described by the array above
+	if (performance_query_enabled)
+	{
+		GET_DEVICE_PROC_ADDR(device, AcquireProfilingLockKHR);
+		GET_DEVICE_PROC_ADDR(device, ReleaseProfilingLockKHR);
+	}
 
-	VkAttachmentReference color_reference;
-	color_reference.attachment = 0;
-	color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	fpAcquireFullScreenExclusiveModeEXT = NULL;
 
-	VkAttachmentReference depth_reference;
-	depth_reference.attachment = 1;
-	depth_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	if (full_screen_exclusive_enabled)
+		GET_DEVICE_PROC_ADDR(device, AcquireFullScreenExclusiveModeEXT);
 
-	// We create the subpass by telling it that we will use this
-	// subpass in a GRAPHICS pipeline (and not a compute or raytracing pipeline),
-	// we tell it that there will be one color reference, and we give it the 
-	// color_reference that we made. In a subpass, there can only be a maximum
-	// of one depth references, or there can just be no depth references, so 
-	// we do not have to specify that there is only one depth reference.
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &color_reference;
-	subpass.pDepthStencilAttachment = &depth_reference;
-
-	// Now we have our subpass description, 
-	// we will use this at the bottom of the function
+	fpCmdBeginRenderingKHR = NULL;
+	fpCmdEndRenderingKHR = NULL;
 
-	// create an array of dependences, this tells the
-	// subpass what each attatchment in the subpass depends on
-	VkSubpassDependency attachmentDependencies[2];
+	if (use_dynamic_rendering)
+	{
+		GET_DEVICE_PROC_ADDR(device, CmdBeginRenderingKHR);
+		GET_DEVICE_PROC_ADDR(device, CmdEndRenderingKHR);
+	}
 
-	// initialize the array as empty
-	memset(attachmentDependencies, 0, sizeof(VkSubpassDependency) * 2);
+	fpGetBufferDeviceAddressEXT = NULL;
 
-	// The first attachment is our swapchain image, which is what we are
-	// outputting to, so that the completed image can get to the screen.
-	// We are not moving the image from one stage to another, so the source
-	// and the destination are the same, the swapchain image will always
-	// be the pipeline's output for color.
-	// Image Layout Transition
-	attachmentDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-	attachmentDependencies[0].dstSubpass = 0;
-	attachmentDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	attachmentDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	attachmentDependencies[0].srcAccessMask = 0;
-	attachmentDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+	if (use_vertex_pulling)
+		GET_DEVICE_PROC_ADDR(device, GetBufferDeviceAddressEXT);
 
-	// The second attachment is the depth buffer
-	// Depth buffer is shared between swapchain images
-	// We use this depth buffer for tests in the fragment shader, determine the depth
-	// of the pixels, to make sure objects close to the camera are drawn over those
-	// that are far from the camera. 
-	attachmentDependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
-	attachmentDependencies[1].dstSubpass = 0;
-	attachmentDependencies[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	attachmentDependencies[1].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	attachmentDependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-	attachmentDependencies[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+	fpCmdSetFragmentShadingRateKHR = NULL;
 
-	// create information that describes what
-	// we want in our renderpass
-	VkRenderPassCreateInfo rp_info = {};
+	if (use_shading_rate)
+		GET_DEVICE_PROC_ADDR(device, CmdSetFragmentShadingRateKHR);
 
-	// sType for all VkRenderPassCreateInfo structures
-	rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	fpCmdBeginConditionalRenderingEXT = NULL;
+	fpCmdEndConditionalRenderingEXT = NULL;
 
-	// the array of pAttatchments will be the "attatchments"
-	// array that we just made, and there are 2 elements
-	// in the array
-	rp_info.attachmentCount = 2;
-	rp_info.pAttachments = attachments;
+	if (use_occlusion_queries)
+	{
+		GET_DEVICE_PROC_ADDR(device, CmdBeginConditionalRenderingEXT);
+		GET_DEVICE_PROC_ADDR(device, CmdEndConditionalRenderingEXT);
+	}
 
-	// The "array" of pSubpasses won't really be an array
-	// but we will make it think that it is an array, so we 
-	// give it a pointer to the subpass we just made, and we
-	// tell it that there is one element
-	rp_info.subpassCount = 1;
-	rp_info.pSubpasses = &subpass;
+	if (use_timeline_semaphores)
+	{
+		GET_DEVICE_PROC_ADDR(device, WaitSemaphoresKHR);
+		GET_DEVICE_PROC_ADDR(device, GetSemaphoreCounterValueKHR);
+	}
 
-	// we give it the attatchment dependencies, there
-	// are 2 elements in the attachmentDependencies array
-	rp_info.dependencyCount = 2;
-	rp_info.pDependencies = attachmentDependencies;
+	fpTransitionImageLayoutEXT = NULL;
+	fpCopyMemoryToImageEXT = NULL;
 
-	// create a renderpass based on the information we provided
-	vkCreateRenderPass(device, &rp_info, NULL, &render_pass);
-}
+	if (use_host_image_copy)
+	{
+		GET_DEVICE_PROC_ADDR(device, TransitionImageLayoutEXT);
+		GET_DEVICE_PROC_ADDR(device, CopyMemoryToImageEXT);
+	}
 
-void Demo::prepare_pipeline()
-{
-	// Now we create a pipeline layout, which will have
-	// one descriptor set in it. Super simple, just use 
-	// the required sType, give it the layout we just made,
-	// and let it know that there is one descriptor layout
-	VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = {};
-	pPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pPipelineLayoutCreateInfo.setLayoutCount = 1;
-	pPipelineLayoutCreateInfo.pSetLayouts = &desc_layout;
+	fpCreateSamplerYcbcrConversionKHR = NULL;
+	fpDestroySamplerYcbcrConversionKHR = NULL;
 
-	// Make the layout, we will use this when we build the pipeline later on
-	vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, NULL, &pipeline_layout);
-	
-	// This is the CreateInfo for full pipeline
-	// This will be the largest CreateInfo structure of the
-	// entire Vulkan program, so get ready for it
+	if (use_video_texture)
+	{
+		GET_DEVICE_PROC_ADDR(device, CreateSamplerYcbcrConversionKHR);
+		GET_DEVICE_PROC_ADDR(device, DestroySamplerYcbcrConversionKHR);
+	}
 
-	// first we give the pipeline our required sType, then
-	// we give it the pipeline layout and the render pass 
-	// that we made earlier
-	VkGraphicsPipelineCreateInfo pipeInfo = {};
-	pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipeInfo.layout = pipeline_layout;
-	pipeInfo.renderPass = render_pass;
+	fpGetMemoryWin32HandleKHR = NULL;
+	fpGetMemoryWin32HandlePropertiesKHR = NULL;
+	fpGetSemaphoreWin32HandleKHR = NULL;
+	fpImportSemaphoreWin32HandleKHR = NULL;
 
-	// Vertex input binding
-	// This example uses a single vertex input binding at binding point 0 (see vkCmdBindVertexBuffers)
-	// The binding description says that vertices will be given to the GPU, one at a time,
-	// and we tell it how large each Vertex is. If the GPU has a Vertex Buffer that is 100kb large,
-	// the GPU needs to know where each vertex starts and ends, and it knows that by knowing
-	// how large each vertex is, which we tell it here
-	VkVertexInputBindingDescription vertexInputBinding = {};
-	vertexInputBinding.binding = 0;
-	vertexInputBinding.stride = sizeof(VertexStructure);
-	vertexInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	if (use_external_memory)
+	{
+		GET_DEVICE_PROC_ADDR(device, GetMemoryWin32HandleKHR);
+		GET_DEVICE_PROC_ADDR(device, GetMemoryWin32HandlePropertiesKHR);
+		GET_DEVICE_PROC_ADDR(device, GetSemaphoreWin32HandleKHR);
+		GET_DEVICE_PROC_ADDR(device, ImportSemaphoreWin32HandleKHR);
+	}
 
-	// Input attribute bindings describe shader attribute locations and memory layouts
-	// This is very similar to how vertex attributes work in any other. Basically,
-	// in the last structure, we say how large each vertex is, but in this structure,
-	// we say how large each piece of the vertex is
-	VkVertexInputAttributeDescription vertexInputAttributs[2];
-	memset(vertexInputAttributs, 0, sizeof(VkVertexInputAttributeDescription) * 2);
+	external_functions.getMemoryHandle = fpGetMemoryWin32HandleKHR;
+	external_functions.getMemoryHandleProperties = fpGetMemoryWin32HandlePropertiesKHR;
+	external_functions.getSemaphoreHandle = fpGetSemaphoreWin32HandleKHR;
+	external_functions.importSemaphoreHandle = fpImportSemaphoreWin32HandleKHR;
 
-	// location = 0, because this is the first element of the vertex
-	vertexInputAttributs[0].location = 0;
+	if (display_timing_enabled)
+	{
+		GET_DEVICE_PROC_ADDR(device, GetRefreshCycleDurationGOOGLE);
+		GET_DEVICE_PROC_ADDR(device, GetPastPresentationTimingGOOGLE);
+	}
 
-	// offsetof returns 0, because position starts 0 bytes after the start of the vertex
-	vertexInputAttributs[0].offset = offsetof(VertexStructure, position);
+	if (update_template_enabled)
+	{
+		GET_DEVICE_PROC_ADDR(device, CreateDescriptorUpdateTemplateKHR);
+		GET_DEVICE_PROC_ADDR(device, DestroyDescriptorUpdateTemplateKHR);
+		GET_DEVICE_PROC_ADDR(device, UpdateDescriptorSetWithTemplateKHR);
+	}
 
-	// format is R32-G32-B32, because there are three 32-bit floats in the position data,
-	// one float for X, one float for Y, and one float for Z, of each position, of each vertex
-	vertexInputAttributs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	if (use_push_descriptors)
+		GET_DEVICE_PROC_ADDR(device, CmdPushDescriptorSetWithTemplateKHR);
 
-	// location = 1, because this is the second element of the vertex
-	vertexInputAttributs[1].location = 1;
+	fpAcquireNextImage2KHR = NULL;
+	fpGetDeviceGroupPresentCapabilitiesKHR = NULL;
+	fpGetDeviceGroupSurfacePresentModesKHR = NULL;
 
-	// offsetof returns 12, because uv starts 12 bytes after the start of the vertex,
-	// because there are 12 bits in position (3 floats that are 4 bytes large)
-	vertexInputAttributs[1].offset = offsetof(VertexStructure, uv);	
+	if (use_device_group)
+	{
+		GET_DEVICE_PROC_ADDR(device, AcquireNextImage2KHR);
+		GET_DEVICE_PROC_ADDR(device, GetDeviceGroupPresentCapabilitiesKHR);
+		GET_DEVICE_PROC_ADDR(device, GetDeviceGroupSurfacePresentModesKHR);
+	}
 
-	// format is R32-B32, because there are two floats in every UV.
-	vertexInputAttributs[1].format = VK_FORMAT_R32G32_SFLOAT;
+	if (dedicated_allocation_enabled)
+	{
+		GET_DEVICE_PROC_ADDR(device, GetImageMemoryRequirements2KHR);
+		GET_DEVICE_PROC_ADDR(device, GetBufferMemoryRequirements2KHR);
+	}
+}
 
-	// Vertex Input State
-	// This combines the last two structures we made
-	// We give it the requires sType, we give it the number of 
-	// binding descriptions, which is one, and we give it the 
-	// pointer to the bindingInput, because it is not an array.
-	// We tell it how many attributes there are (two) (pos and uv),
-	// then we give it the array of two attributes (which is already
-	// a pointer)
-	VkPipelineVertexInputStateCreateInfo vi = {};
-	vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vi.vertexBindingDescriptionCount = 1;
-	vi.pVertexBindingDescriptions = &vertexInputBinding;
-	vi.vertexAttributeDescriptionCount = 2;
-	vi.pVertexAttributeDescriptions = vertexInputAttributs;
-	
-	// we put the InputStateCrateInfo into the PipelineCreateInfo
-	pipeInfo.pVertexInputState = &vi;
+void Demo::prepare_synchronization()
+{
+	// Create semaphores to synchronize acquiring presentable buffers before
+	// rendering and waiting for drawing to be complete before presenting
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	// All that, and now the pipeline knows how to take in
-	// each vertex as input. Next, we will tell the GPU what
-	// to do with the vertices. In thsi case, we want to draw 
-	// a list of trangles with the vertices. This will connect
-	// vertices 0, 1, and 2 together, then it will connect 3, 4,
-	// and 5 toghether, and so on
+	// Create fences that we can use to throttle if we get too far
+	// ahead of the image presentation
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-	// Input Assembly State
-	// we give it the required sType, and then we tell it
-	// that we want to draw triangles, but you could also draw
-	// points or lines if someone wanted to try that. In this case,
-	// we set Topology to TRIANGLE_LIST, so that we can draw triangles
-	VkPipelineInputAssemblyStateCreateInfo ia = {};
-	ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	
-	// we give the InputAssemblyStateCreateInfo to the PipelineCreateInfo
-	pipeInfo.pInputAssemblyState = &ia;
+	// one fence and two semaphores for each frame in flight
+	drawFences.resize(frame_lag);
+	image_acquired_semaphores.resize(frame_lag);
+	draw_complete_semaphores.resize(frame_lag);
 
-	// This is an of DynamicStates
-	// This is part of the DynamicStateCreateInfo
-	// which goes into PipelineCreateInfo. We want
-	// two types of dynamic states, we want the
-	// viewport and the scissor, which we set in
-	// the command buffers that draw our scene
-	VkDynamicState dynamicStateEnables[VK_DYNAMIC_STATE_RANGE_SIZE];
-	memset(dynamicStateEnables, 0, sizeof dynamicStateEnables);
-	dynamicStateEnables[0] = VK_DYNAMIC_STATE_VIEWPORT;
-	dynamicStateEnables[1] = VK_DYNAMIC_STATE_SCISSOR;
+	for (uint32_t i = 0; i < frame_lag; i++)
+	{
+		vkCreateFence(device, &fenceInfo, HostAllocator::callbacks, &drawFences[i]);
 
-	// This is the dynamic state
-	// we give it the requierd sType, we tell it that
-	// we have two dynamicStates, and we give the array
-	// of dynamic states that we have
-	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = 2;
-	dynamicState.pDynamicStates = dynamicStateEnables;
+		vkCreateSemaphore(device, &semaphoreCreateInfo, HostAllocator::callbacks, &image_acquired_semaphores[i]);
+		vkCreateSemaphore(device, &semaphoreCreateInfo, HostAllocator::callbacks, &draw_complete_semaphores[i]);
+	}
 
-	// we give our DynamicStateCreateInfo to the PipelineCreateInfo
-	pipeInfo.pDynamicState = &dynamicState;
+	// With async compute, the compute queue signals this when the
+	// culling pass of a frame is done, and the graphics queue waits
+	// for it before it reads the draws
+	compute_complete_semaphores.resize(use_async_compute ? frame_lag : 0);
 
-	// We tell Vulkan how many viewports and scissors there are.
-	// I know this feels repetitive, it is, but after we set this
-	// up, we don't need to change it. We will change some parts of
-	// the pipeline after this in future tutorials, but we won't change
-	// anything to do with viewport and scissor
+	for (size_t i = 0; i < compute_complete_semaphores.size(); i++)
+		vkCreateSemaphore(device, &semaphoreCreateInfo, HostAllocator::callbacks, &compute_complete_semaphores[i]);
 	
-	// give it the sType it requires
-	// let it know that there is one viewport and one scissor
-	VkPipelineViewportStateCreateInfo vp = {};
-	vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	vp.viewportCount = 1;
-	vp.scissorCount = 1;
+	// The timeline semaphore starts at 0, and every frame signals
+	// its number (frame_count + 1) when the GPU is done with it. The
+	// CPU waits for a number, which it never has to reset, and
+	// anything can ask "is frame N done" by reading the value
+	frame_timeline = VK_NULL_HANDLE;
 
-	// give the viewportStateCreateInfo to the PipelineCreateInfo
-	pipeInfo.pViewportState = &vp;
+	if (use_timeline_semaphores)
+	{
+		VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo timelineInfo = {};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		timelineInfo.pNext = &typeInfo;
+		vkCreateSemaphore(device, &timelineInfo, HostAllocator::callbacks, &frame_timeline);
+	}
 
-	// This structure togggles all the options in the rasterizer,
-	// which is what converts polygons into pixels, so that they can
-	// be shaded in the fragment shader. There are around 10 different
-	// variables that we can configure with the rasterizer, but for
-	// now we will keep it simple, we give it the required sType,
-	// we say that we want the polygons to be filled (opposed to lines),
-	// we cull the back sides of the polygon faces, so that only the
-	// front sides of the polygons are drawn. If you don't know what that does
-	// try replacing VK_CULL_MODE_BACK_BIT with VK_CULL_MODE_FRONT_BIT, and then
-	// only the front sides of the polygon will be drawn. Alternatively, if you
-	// want both sides of the polygons to be drawn (which is useless when 
-	// drawing a cube), try VK_CULL_MODE_NONE_BIT.
-	// We set the line width to 1.0f, even though we aren't drawing lines,
-	// because Vulkan validator will yell at us if we don't
-	VkPipelineRasterizationStateCreateInfo rs = {};
-	rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rs.polygonMode = VK_POLYGON_MODE_FILL;
-	rs.cullMode = VK_CULL_MODE_BACK_BIT;
-	rs.lineWidth = 1.0f;
+	// start our frame_index at zero,
+	// because that's where arrays
+	// always start counting
+	frame_index = 0;
+}
 
-	// give the RasterizationInfo to the PipelineCreateInfo
-	pipeInfo.pRasterizationState = &rs;
+uint64_t Demo::get_completed_frames()
+{
+	// With fences, all we know is that the frame from frame_lag
+	// frames ago is done, because draw() waited for its fence
+	if (!use_timeline_semaphores)
+		return (frame_count + 1 > frame_lag) ? frame_count + 1 - frame_lag : 0;
+
+	uint64_t value = 0;
+	fpGetSemaphoreCounterValueKHR(device, frame_timeline, &value);
+	return value;
+}
 
-	// one of these is needed for every render target
-	// there is one in this case, which is the swapchain,
-	// so we create an array of one blendAttachmentState
+void Demo::wait_for_frames(uint64_t count)
+{
+	// wait until the first "count" frames are done on the GPU
+	VkSemaphoreWaitInfoKHR waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &frame_timeline;
+	waitInfo.pValues = &count;
+	fpWaitSemaphoresKHR(device, &waitInfo, UINT64_MAX);
+}
 
-	// this handles transparency. In this case, we do not
-	// want transparency, so we set blending to disable,
-	// and we set the colorWrite to 0xF, which is the maximum
-	// value, so the polygons are 100% drawn.
-	VkPipelineColorBlendAttachmentState att_state[1];
-	memset(att_state, 0, sizeof(att_state));
-	att_state[0].colorWriteMask = 0xF;
-	att_state[0].blendEnable = VK_FALSE;
+void Demo::prepare_swapchain()
+{
+	// This function will create a swapchain,
+	// and all of the images in the swapchain
 
-	// create the blend attachment state, which holds
-	// all of our blendStateAttachments. In this case, we
-	// give it the requierd sType, we tell it there is one
-	// member of the array of attachments, and we give it the
-	// array of one attachment
-	VkPipelineColorBlendStateCreateInfo cb = {};
-	cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	cb.attachmentCount = 1;
-	cb.pAttachments = att_state;
+	//			If you are new to graphics APIs
+	//			Here is an explaination of a swapchain:
+	//			What it does, and why we need it
+	//
+	// Lets pretend that Vulkan can render to the screen, and only
+	// to the screen. That would mean that Vulkan would have to draw each pixel
+	// on the screen, and then delete every pixel on the screen, and then start
+	// rendering the next image to the screen. This is slow.
+	// With a swapchain, we can have two images. When we first initialize Vulkan,
+	// both swapchain images will be blank. Then, Vulkan will draw an image to one
+	// of the swapchain images. After that, the completed image can be sent to the
+	// monitor, while the 2nd swapchain image is being rendered. Then, after the 1st
+	// image is done drawing on the screen and after the 2nd image is fully rendered,
+	// they swap, which is why it is called "swapchain". Then, the 2nd image is being
+	// drawn on the screen, while VUlkan is rendering a new frame to the 1st swapchain
+	// image. Some swapchains have 2 images, and some have 3 images.
+
+	// If a swapchain is so important, some might wonder why it is only available in an
+	// extension (as discussed in a previous function), rather than being a core feature 
+	// of Vulkan. Truthfully, not all Vulkan softwares use a swapchain, and not all GPUs 
+	// support swapchains. Some Vulkan GPUs don't support graphics at all, and those will
+	// Vulkan only for Compute, but those GPUs are your typical gaming cards.
+
+	// Swapchains are an abolute standard for the gaming industry. Even the 
+	// PlayStation 1 had the ability to use a swapchain, so I can guarrantee that any
+	// popular consumer-level graphics card will support the swapchain extension.
+
+	// Before we start making a new swapchain,
+	// make a backup of the current swapchain.
 	
-	// give the blendState to the PipelineCreateInfo
-	pipeInfo.pColorBlendState = &cb;
+	// If the swapchain is currently NULL
+	// (during first init), then that's fine, 
+	// the oldSwapchain will be NULL too. Otherwise
+	// thd oldSwapchain will be a valid backup.
+	VkSwapchainKHR oldSwapchain = swapchain;
 
-	// Now that we've gone through all the necessary 
-	// struggle to make a depth buffer, allocate data on 
-	// the GPU for it, make a vkImageView to make it accessible,
-	// and setup our renderpass + framebuffer to use the depth buffer,
-	// we can finally tell the computer what to do with 
-	// the depth buffer. Here we create the DepthStateCreateInfo
+	// headless mode draws into images of its own instead
+	if (window_mode == WINDOW_MODE_HEADLESS)
+	{
+		prepare_headless_images();
+		return;
+	}
 
-	// First we give it the necessary sType,
-	// we set DepthTest to true, because we want to compare depth
-	// of each pixel to the depth buffer, we enable writing to the
-	// depth buffer, we use the LESS_OR_EQUAL operation, so that
-	// new pixels are drawn to the screen if they are closer to 
-	// the camera than any pixel that is already rendered (or equal),
-	// then we let the pipeline know that we are always comparing depths
-	VkPipelineDepthStencilStateCreateInfo ds = {};
-	ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	ds.depthTestEnable = VK_TRUE;
-	ds.depthWriteEnable = VK_TRUE;
-	ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-	ds.back.compareOp = VK_COMPARE_OP_ALWAYS;
+	// the present thread must be done with the old swapchain,
+	// before the new one is made from it
+	if (present_thread != nullptr)
+		present_thread->Wait(0);
 
-	// give the depthState to the PipelineCreateInfo
-	pipeInfo.pDepthStencilState = &ds;
+	// Part 1: Get the dimensions
+	// =======================================
 
-	// multisample state
-	// this allows for multisample anti-aliasing (MSAA).
-	// In this tutorial, we won't be using MSAA, so we set
-	// the number of samples to 1, and we give the necessary sType.
-	// If someone wants MSAA, it takes a little more effort than
-	// changing COUNT-1-BIT to COUNT-8-BIT, but this is definetely
-	// where it starts, there may be a tutorial on MSAA later
-	VkPipelineMultisampleStateCreateInfo ms = {};
-	ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	// Check the surface capabilities and formats.
+	// This tells us what the surface is capable of doing
+	VkSurfaceCapabilitiesKHR surfCapabilities;
+	fpGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, surface, &surfCapabilities);
 
-	// give multisample state to the PipelineCreateInfo
-	pipeInfo.pMultisampleState = &ms;
+	// this holds the dimensions of all the swapcahin images,
+	// which we will set in a minute
+	VkExtent2D swapchainExtent;
 
-	// Time for shaders, and there is a lot to say about shaders.
-	// The way I've set up shaders is I've written the Vertex
-	// and Fragment shaders into two files: cube.vert and cube.frag.
+	// When we call fpGetPhysicalDeviceSurfaceCapabilitiesKHR, there are two
+	// possible outcomes:
+	//	1: width and height are both 0xFFFFFFFF, 
+	//	2: width and height are both not 0xFFFFFFFF.
+	// That means we only need to check width.
 
-	// If you want to have GLSL code inside the CPP file, and then
-	// compile the GLSL code at runtime, you can do that with a 
-	// library called "shaderc". This library is actually already
-	// built-in to the visual studio solution, linked and ready 
-	// to go. Here is a tutorial if anyone is interested:
-	// https://www.reddit.com/r/vulkan/comments/bbuh0p/compiling_glsl_in_shader_rather_than_precompiling/
+	// If width is 0xFFFFFFFF, that means the surface is undefined,
+	// and we need to define the surface by giving it dimensions.
+	// This happens if the window is too big or too small for Vulkan
+	// to handle
+	if (surfCapabilities.currentExtent.width == 0xFFFFFFFF)
+	{
+		// If the surface size is undefined, the size is set to the size
+		// of the images requested, which we need to adjust to make it
+		// fit within the minimum and maximum values that are supported by the surface
+		swapchainExtent.width = width;
+		swapchainExtent.height = height;
 
-	// If you don't want to do that, there are two more options.
+		// if we are trying to use a width is less than the smallest width that is 
+		// supported by our surface, then set the width to the smallest width that
+		// is supported by the surface. We clamp the values to what is supported
+		if (swapchainExtent.width < surfCapabilities.minImageExtent.width)
+			swapchainExtent.width = surfCapabilities.minImageExtent.width;
+
+		// if we are trying to use a width is bigger than the biggest width that is 
+		// supported by our surface, then set the width to the biggest width that
+		// is supported by the surface. We clamp the values to what is supported
+		else if (swapchainExtent.width > surfCapabilities.maxImageExtent.width)
+				 swapchainExtent.width = surfCapabilities.maxImageExtent.width;
+
+		// if we are trying to use a height is less than the smallest height that is 
+		// supported by our surface, then set the height to the smallest height that
+		// is supported by the surface. We clamp the values to what is supported
+		if (swapchainExtent.height < surfCapabilities.minImageExtent.height)
+			swapchainExtent.height = surfCapabilities.minImageExtent.height;
+
+		// if we are trying to use a height is bigger than the biggest height that is 
+		// supported by our surface, then set the height to the biggest height that
+		// is supported by the surface. We clamp the values to what is supported
+		else if (swapchainExtent.height > surfCapabilities.maxImageExtent.height)
+				 swapchainExtent.height = surfCapabilities.maxImageExtent.height;
+	}
 	
-	// 1.You can precompile shaders, and load the shaders
-	// from files at runtime.
-	// 2. You can precompile shaders, and then turn the shader files
-	// into an array of bytes, and compile those bytes into the 
-	// EXE file. This way, the shaders are compiled AND inside the
-	// program, so the end-user won't have any shader files.
+	else 
+	{
+		// If the surface size is already pre-defined, that
+		// means that when we called fpGetPhysicalDeviceSurfaceCapabilitiesKHR,
+		// the surface found a width and height that it wants to use,
+		// which may be the size of the window, or it may be (0, 0) 
+		// while minimizing, it could be a number of different things.
 
-	// Right now, I have written a program called "compileShaders.cmd"
-	// First, it compiles the GLSL files cube.vert and cube.frag into
-	// compiled shader files:
-	//		..\Bin\glslangValidator.exe -V cube.vert -o cube.vert.spv
-	// Next, it optimizes the compiled shader by removing the 
-	// debug features of the shader. This can be disabled if you want
-	//		..\Bin\spirv-opt --strip-debug cube.vert.spv -o cube2.vert.spv
+		// The point is, we have dimensions that the surface wants us to use,
+		// and we need to make a swapchain with those dimensions so that the
+		// images that Vulkan renders can be compatible with the current state
+		// of the surface. This function will be called every time we call
+		// prepare(), not just during the first initialization. This will
+		// allow us to resize the window whenever we want.
 
-	// If you want to load precompiled shaders from files at runtime,
-	// you can use cube2.vert.spv and cube2.frag.spv. However,
-	// you will not find these files anywhere, and I will explain why 
-	// in a second.
+		// We set the swapchainExtent to the size that 
+		// the surface wants us to use.
+		swapchainExtent = surfCapabilities.currentExtent;
 
-	// What we do next is, take the optimized compiled shader files,
-	// and turn them into an array of bytes
-	//		bin2hex --i cube2.vert.spv --o cube.vert.inc
-	// Then, after it is converted to an array of bytes,
-	// the original compiled shader files are deleted
-	//		del cube.vert.spv
-	//		del cube2.vert.spv
+		// We set width and height to those dimensions provided
+		width = swapchainExtent.width;
+		height = swapchainExtent.height;
+	}
 
-	// Finally, the array of bytes are included here.
-	// If you open the inc files in notepad, you will
-	// see the bytes of the compiled shader, looks like
-	// this:
-	//	0x03, 0x02, 0x23, 0x07, 0x00, 0x00, 0x01, ...
+	// if width and height are zero, then set the boolean
+	// to let us know that the window is minimized, and then
+	// return, do not continue creating swapchain images. There
+	// is no point in making a swapchain if there are no pixels
+	// to render
+	if (width == 0 || height == 0)
+	{
+		is_minimized = true;
+		return;
+	}
+
+	// if our window is not minimzed, then set the boolean so
+	// we know that it is not minimized, and then we continue
+	// through the function to make the swapchain
+	else 
+	{
+		is_minimized = false;
+	}
+
+	// Part 2: Get the present mode
+	//=======================================================
+
+	// We need to find a "Present Mode" that the surface supports. A "Present mode"
+	// tells the surface and the window how to handle the images that we give it.
+	// There are only 4 or 5 present modes that exist. Here is a list of them:
+
+	//		Here is an explaination of what other present modes do
+	//		The one that we use in this tutorial is FIFO
+
+	// FIFO stands for First-in, FIrst-out
+	// The PRESENT_MODE_FIFO present mode will give us VSYNC, and it will 
+	// prevent tearing, so it will wait until one image is fully drawn
+	// on the screen, before we try to draw another image.
+
+	// IMMEDIATE will start drawing one frame to the screen,
+	// even if another image is in the middle of being drawn, causes tearing.
+	// VK_PRESENT_MODE_IMMEDIATE_KHR is for applications that don't care about
+	// tearing, or have some way of synchronizing their rendering with the
+	// display.
+
+	// MAILBOX_KHR will disable VSYNC, and uncap the 60fps limit,
+	// or whatever the limit of the monitor is.
+	// VK_PRESENT_MODE_MAILBOX_KHR may be useful for applications that
+	// generally render a new presentable image every refresh cycle, but are
+	// occasionally early.  In this case, the application wants the new image
+	// to be displayed instead of the previously-queued-for-presentation image
+	// that has not yet been displayed.
+
+	// VK_PRESENT_MODE_FIFO_RELAXED_KHR is for applications that generally
+	// render a new presentable image every refresh cycle, but are occasionally
+	// late. In this case (perhaps because of stuttering/latency concerns),
+	// the application wants the late image to be immediately displayed, even
+	// though that may mean some tearing.
+
+	// This is the number of present modes are supported 
+	// by the surface and the GPU. It is zero by default
+	uint32_t presentModeCount = 0;
+	
+	// we get the number of modes that are supported
+	fpGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &presentModeCount, NULL);
+
+	// we make an array to hold the list of supported modes
+	VkPresentModeKHR *presentModes = new VkPresentModeKHR[presentModeCount];
+
+	// Finally, we get the list of supported modes,
+	// we use a function pointer that we got from the instance,
+	// this function is built-in to the driver, not the SDK.
+	fpGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &presentModeCount, presentModes);
+	
+	// currentPresentMode is a member of the Demo class,
+	// it is the presentation mode that is currently active.
+	// If this is our first time here (firstInit), then the 
+	// mode will be NULL (0), because there is no current
+	// mode. Otherwise, That currentPresentMode will have the value
+	// that it was given the last time this function was called,
+	// which is the mode that is currently active
+
+	// The mode we want is present_mode, which is set in prepare(),
+	// or on the command line, or with the P key while the program runs.
+	// FIFO locks our frame-rate to 60fps (or the limit of the monitor)
+	// and prevents tearing of images, but a frame can wait in line for
+	// frame_lag refreshes before it is on the screen. FIFO_RELAXED is
+	// the same, but a late frame is shown right away, with tearing.
+	// MAILBOX replaces the waiting image with the newest one, so it
+	// has low latency without tearing. IMMEDIATE never waits at all.
+
+	// If the mode we want is not supported, we try the modes that
+	// are the most like it. FIFO is always last, because every
+	// GPU and surface has to support FIFO
+	VkPresentModeKHR fallbacks[3];
+	uint32_t fallbackCount = 0;
+	fallbacks[fallbackCount++] = present_mode;
+
+	if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR)
+		fallbacks[fallbackCount++] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+
+	else if (present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+		fallbacks[fallbackCount++] = VK_PRESENT_MODE_MAILBOX_KHR;
+
+	if (present_mode != VK_PRESENT_MODE_FIFO_KHR)
+		fallbacks[fallbackCount++] = VK_PRESENT_MODE_FIFO_KHR;
+
+	VkPresentModeKHR desiredPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	bool found = false;
+
+	// check the modes we want, in order, against all of
+	// the present modes that are supported by the GPU and the surface
+	for (uint32_t f = 0; f < fallbackCount && !found; f++)
+	{
+		for (size_t i = 0; i < presentModeCount; ++i)
+		{
+			if (presentModes[i] == fallbacks[f])
+			{
+				desiredPresentMode = fallbacks[f];
+				found = true;
+				break;
+			}
+		}
+	}
+
+	if (desiredPresentMode != present_mode)
+		printf("%s is not supported, using %s\n", present_mode_name(present_mode), present_mode_name(desiredPresentMode));
+
+	// tell the user when the mode changes
+	if (desiredPresentMode != currentPresentMode)
+		printf("Present mode: %s\n", present_mode_name(desiredPresentMode));
+
+	currentPresentMode = desiredPresentMode;
+
+	// delete the list of modes, we found the one we want,
+	// so we don't need the entire list anymore
+	if (presentModes != NULL)
+		free(presentModes);
+
+	// Determine the number of VkImages to use in the swapchain.
+	// Application desires to acquire 3 images at a time for triple buffering.
+	// This allows one image to be sent to the screen, while another image is
+	// being created, while another image is being deleted.
+	// In my opinion, I don't think there's a reason for more than three
+	uint32_t desiredNumOfSwapchainImages = 3;
+
+	// IMMEDIATE never waits for the monitor, so an image is given back
+	// right after it is presented, and two images are enough
+	if (currentPresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+		desiredNumOfSwapchainImages = 2;
+
+	// MAILBOX needs one image on the screen, one image waiting in the
+	// mailbox, and one image to draw into, on top of what the surface
+	// needs at least, or we would wait for an image anyway
+	if (currentPresentMode == VK_PRESENT_MODE_MAILBOX_KHR &&
+		desiredNumOfSwapchainImages < surfCapabilities.minImageCount + 1)
+		desiredNumOfSwapchainImages = surfCapabilities.minImageCount + 1;
+
+	// If the number of images we want to use is less than
+	// the minimum number of images that the surface supports
+	if (desiredNumOfSwapchainImages < surfCapabilities.minImageCount)
+	{
+		// then change the number of images to the minimum that
+		// the surface supports. This would only happen if we tried
+		// to use 0 images, or 1 image, but 3 images will totally be
+		// above the minimum.
+		desiredNumOfSwapchainImages = surfCapabilities.minImageCount;
+	}
+
+	// If maxImageCount is 0, then that means we can have as many
+	// images as we want, because max is set to zero when there is no limit.
+	// If max is more than zero, then there is a limit that we need to obey
+	if (surfCapabilities.maxImageCount > 0)
+	{
+		// if the amount of images that we want in the swapchain,
+		// is more than the maximum number that is supported by the 
+		// GPU and the surface
+		if (desiredNumOfSwapchainImages > surfCapabilities.maxImageCount)
+		{
+			// Application must settle for fewer images than desired:
+			desiredNumOfSwapchainImages = surfCapabilities.maxImageCount;
+		}
+	}
+
+	// Part 3: Get Flags
+	// ===================================================
+
+	// This is a transformation flag, it tells the swapchain
+	// how to scale, rotate, or move an image, before it is sent to the surface.
+	VkSurfaceTransformFlagsKHR preTransform;
+
+	// I know what students are going to think:
+	// "Can't we just send an image to the screen without transforming the image?"
+	// Yes, you can, but only if the Surface allows you to do that.
+	// Some surfaces require transformations, and some don't.
+
+	// we check to see if our surface supports IDENTITY_TRANSFORM.
+	// This is exactly what it sounds like, it is just like any other
+	// identity matrix, it has no transformation, which means that if 
+	// our surface supports IDENTITY, then we do not need to scale,
+	// rotate, or translate an image, before it goes from swapchain to surface
+	if (surfCapabilities.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
+	{
+		// we set the pre-transformation flag (the transformation of an image
+		// after it is rendered, and before it goes to the surface) to IDENTITY,
+		// so that there is no transformation
+		preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+	}
+
+	// If the surface does not support IDENTITY, then it must require some kind
+	// of transformation to be done to it, before the image is sent to the screen
+	else 
+	{
+		// set preTransform to the transformation that the surface requires
+		preTransform = surfCapabilities.currentTransform;
+	}
+
+	// When our image is done being rendered, there are red pixels,
+	// green pixels, blue pixels, and alpha pixels. We all know what
+	// the red, green, and blue pixels will do, but we do not know what the
+	// alpha pixels will do. Should they be used for transparency? Should
+	// they be ignored?
+
+	// We need to choose what the Alpha pixels will do
+
+	// By default, we use VK_COMPOSITE_ALPHA_OPAQUE, which will
+	// not do anything with the alpha channel, it will just ignore it
+	VkCompositeAlphaFlagBitsKHR desiredAlphaFlag = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+
+	// Here are a few modes that we can set to handle the alpha.
+	// These modes are in priority for what we want, depending on 
+	// what the GPU supports. If the GPU does not support the ability
+	// to ignore alpha, then we try using alpha to modify the RGB
+	// values, and if that is not supported, then Vulkan will inherit
+	// alpha properties from the surface
+	VkCompositeAlphaFlagBitsKHR compositeAlphaFlags[4] = {
+		VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+		VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR,
+		VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR,
+		VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+	};
+
+	// loop through all the possibilities of alpha flags
+	for (uint32_t i = 0; i < ARRAY_SIZE(compositeAlphaFlags); i++)
+	{
+		// find the first flag that our sruface supports
+		if (surfCapabilities.supportedCompositeAlpha & compositeAlphaFlags[i])
+		{
+			// set our desired flag to the one that
+			// our surface supports
+			desiredAlphaFlag = compositeAlphaFlags[i];
+
+			// leave the loop, stop looking for flags,
+			// because we found the one that we want
+			break;
+		}
+	}
+
+	// Part 4: Make the empty swapchain
+	//====================================================
+
+	// Lets take everything that we've made so far,
+	// bundle it together, and make a swapchain with it
+
+	VkSwapchainCreateInfoKHR swapchain_ci = {};
+	swapchain_ci.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	swapchain_ci.surface = surface;
+	swapchain_ci.minImageCount = desiredNumOfSwapchainImages;
+	swapchain_ci.imageFormat = format;
+	swapchain_ci.imageColorSpace = color_space;
+	swapchain_ci.imageExtent.width = swapchainExtent.width;
+	swapchain_ci.imageExtent.height = swapchainExtent.height;
+	swapchain_ci.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+	// With the offscreen target, the swapchain image is not drawn
+	// to, the offscreen image is blitted (scaled) into it instead,
+	// so the surface and the format have to allow that
+	if (use_offscreen_target)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(gpu, format, &props);
+
+		VkFormatFeatureFlags blitFeatures =
+			VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+			VK_FORMAT_FEATURE_BLIT_DST_BIT |
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+		if (!(surfCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) ||
+			(props.optimalTilingFeatures & blitFeatures) != blitFeatures)
+		{
+			printf("The swapchain can not be blitted to, offscreen rendering, dynamic resolution, temporal upscaling, and output windows are disabled\n");
+			use_offscreen_target = false;
+			use_dynamic_resolution = false;
+			use_temporal_upscale = false;
+			use_output_windows = false;
+		}
+	}
+
+	if (use_offscreen_target)
+		swapchain_ci.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+	// frame capture copies from the swapchain image, 4 bytes at a time
+	if (use_frame_capture)
+	{
+		bool fourBytes =
+			format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB ||
+			format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+
+		if (!(surfCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) || !fourBytes)
+		{
+			printf("The swapchain can not be copied from, frame capture is disabled\n");
+			use_frame_capture = false;
+		}
+		else
+			swapchain_ci.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	// the encoder output blits from it, any format works
+	if (use_encoder_output)
+	{
+		if (!(surfCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+		{
+			printf("The swapchain can not be copied from, encoder output is disabled\n");
+			use_encoder_output = false;
+		}
+		else
+			swapchain_ci.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	swapchain_ci.preTransform = (VkSurfaceTransformFlagBitsKHR)preTransform;
+	swapchain_ci.compositeAlpha = desiredAlphaFlag;
+	swapchain_ci.imageArrayLayers = 1;
+	swapchain_ci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	swapchain_ci.presentMode = currentPresentMode;
+	swapchain_ci.oldSwapchain = oldSwapchain;
+	swapchain_ci.clipped = true;
+
+	// With a device group, each GPU has its own copy of every swapchain
+	// image. A GPU that is connected to the monitor presents its own
+	// images (LOCAL), and it can present the images of the other GPUs
+	// if the driver can copy them over (REMOTE). presentMask[p] has
+	// bit i set if GPU p can present the images of GPU i, so we look
+	// for a GPU that can present each one, and use the modes we need
+	VkDeviceGroupSwapchainCreateInfoKHR groupSwapchainInfo = {};
+	groupSwapchainInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SWAPCHAIN_CREATE_INFO_KHR;
+
+	if (use_device_group)
+	{
+		VkDeviceGroupPresentCapabilitiesKHR presentCaps = {};
+		presentCaps.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_CAPABILITIES_KHR;
+		fpGetDeviceGroupPresentCapabilitiesKHR(device, &presentCaps);
+
+		VkDeviceGroupPresentModeFlagsKHR surfaceModes = 0;
+		fpGetDeviceGroupSurfacePresentModesKHR(device, surface, &surfaceModes);
+
+		VkDeviceGroupPresentModeFlagsKHR modes = presentCaps.modes & surfaceModes;
+		bool presentable = true;
+
+		for (uint32_t i = 0; i < device_group_count; i++)
+		{
+			device_group_present_device[i] = UINT32_MAX;
+
+			// a GPU that presents its own images is best, there is no copy
+			if ((modes & VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR) && (presentCaps.presentMask[i] & (1u << i)))
+				device_group_present_device[i] = i;
+
+			for (uint32_t p = 0; p < device_group_count && device_group_present_device[i] == UINT32_MAX; p++)
+				if ((modes & VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR) && (presentCaps.presentMask[p] & (1u << i)))
+					device_group_present_device[i] = p;
+
+			if (device_group_present_device[i] == UINT32_MAX)
+				presentable = false;
+			else if (device_group_present_device[i] == i)
+				groupSwapchainInfo.modes |= VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR;
+			else
+				groupSwapchainInfo.modes |= VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR;
+		}
+
+		// Without masks, every GPU draws every frame, and the first
+		// one presents, which is slower, but still correct
+		if (!presentable)
+		{
+			printf("The surface can not present from every GPU, device groups are disabled\n");
+			use_device_group = false;
+			device_group_count = 1;
+		}
+		else
+			swapchain_ci.pNext = &groupSwapchainInfo;
+	}
+	
+	// We create the swapchain with a function pointer,
+	// because this function is not in the SDK, it is in the VUlkan Driver,
+	// and we get access to it by finding the pointer via the device
+	// (we found the function pointers earlier in the code)
+
+	// With exclusive fullscreen, we say when the swapchain owns the
+	// monitor (APPLICATION_CONTROLLED), instead of letting the driver
+	// guess, so it only happens while our window is in front. That
+	// mode needs to know the monitor. We ask the surface first, a
+	// surface on some monitors can not be exclusive at all
+	VkSurfaceFullScreenExclusiveWin32InfoEXT exclusiveWin32Info = {};
+	exclusiveWin32Info.sType = VK_STRUCTURE_TYPE_SURFACE_FULL_SCREEN_EXCLUSIVE_WIN32_INFO_EXT;
+	exclusiveWin32Info.hmonitor = window_monitor;
+
+	VkSurfaceFullScreenExclusiveInfoEXT exclusiveInfo = {};
+	exclusiveInfo.sType = VK_STRUCTURE_TYPE_SURFACE_FULL_SCREEN_EXCLUSIVE_INFO_EXT;
+	exclusiveInfo.pNext = &exclusiveWin32Info;
+	exclusiveInfo.fullScreenExclusive = VK_FULL_SCREEN_EXCLUSIVE_APPLICATION_CONTROLLED_EXT;
+
+	if (full_screen_exclusive_enabled)
+	{
+		VkPhysicalDeviceSurfaceInfo2KHR surfaceInfo = {};
+		surfaceInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR;
+		surfaceInfo.pNext = &exclusiveInfo;
+		surfaceInfo.surface = surface;
+
+		VkSurfaceCapabilitiesFullScreenExclusiveEXT exclusiveCaps = {};
+		exclusiveCaps.sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_FULL_SCREEN_EXCLUSIVE_EXT;
+
+		VkSurfaceCapabilities2KHR surfaceCaps2 = {};
+		surfaceCaps2.sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR;
+		surfaceCaps2.pNext = &exclusiveCaps;
+		fpGetPhysicalDeviceSurfaceCapabilities2KHR(gpu, &surfaceInfo, &surfaceCaps2);
+
+		if (exclusiveCaps.fullScreenExclusiveSupported)
+		{
+			exclusiveWin32Info.pNext = swapchain_ci.pNext;
+			swapchain_ci.pNext = &exclusiveInfo;
+		}
+		else
+		{
+			printf("The surface can not be exclusive, the window is borderless\n");
+			full_screen_exclusive_enabled = false;
+		}
+	}
+
+	// the NV low latency mode is turned on for each swapchain
+	VkSwapchainLatencyCreateInfoNV latencyInfo = {};
+	latencyInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_LATENCY_CREATE_INFO_NV;
+	latencyInfo.latencyModeEnable = VK_TRUE;
+
+	if (latency_nv_enabled)
+	{
+		latencyInfo.pNext = swapchain_ci.pNext;
+		swapchain_ci.pNext = &latencyInfo;
+	}
+
+	// use the function pointer, the device, and the 
+	// swapchain CreateInfo structure to create the swapchain
+	fpCreateSwapchainKHR(device, &swapchain_ci, HostAllocator::callbacks, &swapchain);
+	swapchain_count++;
+
+	if (use_latency_markers)
+		latency_markers->SetSwapchain(swapchain);
+
+	// a new swapchain does not own the monitor yet
+	full_screen_exclusive_acquired = false;
+	acquire_full_screen_exclusive();
+
+	// remember the size, so that resize() knows when
+	// there is nothing to rebuild
+	swapchain_extent = swapchainExtent;
+
+	// nothing was presented to the new swapchain yet,
+	// so the first present changes the whole image
+	previous_dirty_rect_valid = false;
+
+	// If we just re-created an existing swapchain, we should destroy the old
+	// swapchain. We know if an old swapchain exists by checking if it is NULL.
+	// Note: destroying the swapchain also cleans up all its associated
+	// presentable images once the platform is done with them.
+	// Frames that are still on the GPU might be drawing to the old
+	// images, so we do not destroy it right now, we retire it, and it
+	// is destroyed when those frames are done (see DeletionQueue.cpp)
+	if (oldSwapchain != VK_NULL_HANDLE)
+	{
+		// retire the old swapchain
+		retire_swapchain(oldSwapchain);
+	}
+
+	// Present IDs belong to one swapchain, so present wait
+	// can only wait for presents from this frame on
+	swapchain_first_frame = frame_count;
+
+	// With display timing, ask how long one refresh of the monitor
+	// is (in nanoseconds). We start by trying to present one image every
+	// refresh, and draw() slows down (or speeds up) if frames are late.
+	// The present IDs, and the times of past presents, belong to one
+	// swapchain, so everything starts over with the new swapchain
+	if (display_timing_enabled)
+	{
+		VkRefreshCycleDurationGOOGLE refreshCycle = {};
+		fpGetRefreshCycleDurationGOOGLE(device, swapchain, &refreshCycle);
+
+		refresh_duration = refreshCycle.refreshDuration;
+		refresh_duration_multiplier = 1;
+		target_IPD = refresh_duration;
+		prev_desired_present_time = 0;
+		syncd_with_actual_presents = false;
+		next_present_id = 1;
+		last_early_id = 0;
+		last_late_id = 0;
+	}
+
+	// Part 5: Make the swapchain's images usable
+	//=================================================================
+
+	// Now that we've used the fpCreateSwapchainKHR function,
+	// we now have a swapchain, and it is filled with images that
+	// we can render to, but first we need to put these images into
+	// a state that we can work with
+
+	// get the amount of images that are in the swapchain
+	fpGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, NULL);
+
+	// make an array to hold the swapchain's images
+	VkImage *swapchainImages = new VkImage[swapchainImageCount];
+
+	// get the images that are in the swapchain that we just made
+	fpGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, swapchainImages);
+
+	// Our swapchain images are in the form of VkImage. While
+	// they are in the form of VkImage, they cannot be directly
+	// accessed by the CPU or GPU
+
+	// The structure SwapchainImageResources is defined in Demo.h,
+	// and we have an array in the Demo class that holds elements of 
+	// SwapchainImageResources, which we will be using throughout
+	// the rest of the tutorial, so make an array of SwapchainImageResources
+	// so that we have resources for every swapchain image
+	swapchain_image_resources = new SwapchainImageResources[swapchainImageCount];
+
+	// The swapchain_image_resources array, basically makes it so each
+	// swapchain iamge has its own image (itself), its own imageView
+	// (which makes the image usable), its own frameBuffer (which allows
+	// the imageView to be used in drawing)
+
+	// loop through all the swapchain images
+	for (uint32_t i = 0; i < swapchainImageCount; i++)
+	{
+		// Create an image veiw
+		// VkImageView will act as a wrapper for VkImage
+		// which allows the data of VkImage to be accessible
+		// by the CPU and GPU
+
+		// One way to imagine it is:
+		// VkImage is the a package in the Post Office,
+		// but the package can't go anywhere without a stamp.
+		// VkImageView is the stamp
+
+		// We have to set a number of variables that 
+		// describe the image that will be inside imageView
+		// sType will always be VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+
+		// we have to give the type of image, this is a 2D
+		// image. Sounds obvious, but it is possible to have
+		// 3D images, or image arrays
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		
+		// we have to include the format of the images
+		// which we got from Surface
+		viewInfo.format = format;
+
+		// we hvae to label each of the color components
+		viewInfo.components.r = VK_COMPONENT_SWIZZLE_R;
+		viewInfo.components.g = VK_COMPONENT_SWIZZLE_G;
+		viewInfo.components.b = VK_COMPONENT_SWIZZLE_B;
+		viewInfo.components.a = VK_COMPONENT_SWIZZLE_A;
+
+		// we have to mention that this is a color image,
+		// there are other types of images that are used
+		// for things other than color, like depth
+		// but more information will be given about that later
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+		// If you don't know what mipmaps are, or mipmap chains, 
+		// don't worry about it. This image (the swapchain image),
+		// does not have a mipmap chain, so the base level is 0,
+		// and there is 1 level. Honestly just don't worry about it.
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+
+		// Technically, in Vulkan's eyes, every image is an array
+		// so we tell it that there is one image in the array,
+		// and that the element of the array we want is 0,
+		// which literally means "there is one image, so use
+		// that one image"
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		// set the imageView's image to the swapchain image
+		viewInfo.image = swapchainImages[i];
+
+		// Make a backup of the image, so each
+		// member of the swapchain_image_resources has the 
+		// original VkImage
+		swapchain_image_resources[i].image = viewInfo.image;
+
+		// Use the viewInfo to make an imageView, for each swapchain image,
+		// in the array of swapchain_image_resources
+		vkCreateImageView(device, &viewInfo, HostAllocator::callbacks, &swapchain_image_resources[i].view);
+
+	}
+
+	// if an array of swapchainImages exists delete the array.
+	// Keep in mind, this is not the array of swapchain_image_resources,
+	// this is just the array of VkImage. We can delete this now because
+	// the images have been copied to the swapchain_image_resources array
+	if (swapchainImages != NULL)
+		free(swapchainImages);
+}
+
+void Demo::prepare_headless_images()
+{
+	// The images of the last size might still be drawn to by frames
+	// on the GPU, so they are retired, just like an old swapchain
+	if (!headless_images.empty())
+	{
+		std::vector<TextureGPU*> old = headless_images;
+
+		deletion_queue->Retire([old]()
+			{
+				for (size_t i = 0; i < old.size(); i++)
+					delete old[i];
+			},
+			frame_count);
+
+		headless_images.clear();
+	}
+
+	// There is no surface to ask for the size, so we use the size
+	// that we want. There is never a minimized window either
+	swapchain_extent.width = width;
+	swapchain_extent.height = height;
+	is_minimized = false;
+	previous_dirty_rect_valid = false;
+	swapchain_first_frame = frame_count;
+
+	// One image for each frame in flight. Frame N draws into image
+	// N % swapchainImageCount (see acquire_next_image), and the frame
+	// that drew into it before was frame_lag frames ago (or more),
+	// which draw() already waited for, so it is never needed by two frames.
+	// The images are copied from by frame capture, and blitted to by
+	// the offscreen target, like a swapchain that allows both
+	swapchainImageCount = frame_lag;
+	swapchain_image_resources = new SwapchainImageResources[swapchainImageCount];
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = format;
+	image_create_info.extent.width = width;
+	image_create_info.extent.height = height;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage =
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	for (uint32_t i = 0; i < swapchainImageCount; i++)
+	{
+		TextureGPU* texture = new TextureGPU(device, allocator, image_create_info, VK_IMAGE_ASPECT_COLOR_BIT);
+		texture->SetName("Headless image");
+		headless_images.push_back(texture);
+
+		// The texture has a view already, but the views of the
+		// swapchain images are destroyed with the framebuffers
+		// (see delete_resolution_dependencies), so this is another one
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.image = texture->image;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		swapchain_image_resources[i].image = texture->image;
+		vkCreateImageView(device, &viewInfo, HostAllocator::callbacks, &swapchain_image_resources[i].view);
+	}
+}
+
+void Demo::prepare_uniform_buffer()
+{
+	// make temporary data where
+	// we can store data that will be
+	// in our buffer
+	uniform_struct temporaryData;
+
+	glm::vec3 eye = { 0.0f, 3.0f, 5.0f };		// The position of the camera
+	glm::vec3 focus = { 0, 0, 0 };				// The position the camera is looking at
+	glm::vec3 up = { 0.0f, 1.0f, 0.0 };			// The direction that faces up, which is the Y axis
+	camera.LookAt(eye, focus, up);				// the camera builds the view matrix from thsi data
+
+	// we do this exactly the same way as we do in OpenGL
+	// We give it our field-of-view, which is 45 degrees (converted to radians),
+	// we give it our aspect ratio (window width divdied by height),
+	// we give it the nearest distance to the camera that something can be, so anything closer than 0.1f is not drawn,
+	// we give it the farthest distance from the camera that something can be, so anything farther tha 100.0f will not be drawn
+	// The camera keeps both matrices, and only builds them again when
+	// one of these changes, see Camera.h
+	camera.SetPerspective(45.0f * 3.14159f / 180.0f, (float)width / (float)height, 0.1f, 100.0f);
+
+	// In OpenGL
+	//	The X axis moves from left to right
+	//	The Y axis moves from bottom to top
+	// In Vulkan
+	//	The X axis moves from left to right
+	//	The Y axis moves from top to bottom
+	// That means, by default, Vulkan will render everything upside down.
+	// Not sure why the Vulkan devs made that decision, but there is an easy
+	// fix. If we multiply matrix[1][1] by -1, then everything will be drawn
+	// correctly, and we can use our OpenGL GLSL shaders without any problem.
+	// The camera does that when it builds the projection
+	view_matrix = camera.GetView();
+	projection_matrix = camera.GetProjection();
+	view_projection = camera.GetViewProjection();
+
+	// Create the model matrix
+	// For now, the model matrix will 
+	// be an identity matrix. That means there will be
+	// no translation, scaling, or rotating. The cube
+	// will be rotated in update_uniform_buffer()
+	model_matrix = glm::mat4();
+
+	// We multiply the model, the veiw, and the projection matrices together.
+	// We send this MVP matrix to the shader, and then each vertex in the 
+	// geometry is multiplied by MVP. As a result, we will convert the
+	// (X, Y) position of each point 
+	// FROM: 
+	//		the position of the point that is relative to the world
+	// TO:
+	//		the position of the point that is relative to the screen
+	// This allows the fragment shader to know where the vertices are,
+	// so that each pixel of the geometry can be colored, it is exactly
+	// the same as OpenGL
+
+	// create the model view and projection matrices
+	glm::mat4x4	MVP = view_projection * model_matrix;
+	
+	// put our MVP into the temporary data buffer
+	temporaryData.mvp = MVP;
+	temporaryData.time = glm::vec4(0.0f);
+
+	// keep a copy of the matrix of every cube,
+	// for when we send it with push constants instead
+	TransformBatch(&object_transforms, 0, scene_object_count, view_projection, nullptr, object_mvps.data());
+
+	// There can be frame_lag frames in flight at the same time.
+	// If all of them read the same uniform buffer, then the CPU
+	// would overwrite the matrices of a frame that the GPU is
+	// still drawing. Instead, we make one buffer that is big enough
+	// for frame_lag copies of uniform_struct, and each frame_index
+	// gets its own "slice" of the buffer.
+
+	// Each slice needs to start at a multiple of 
+	// minUniformBufferOffsetAlignment, which is usually 
+	// 256 bytes, so we round the size of each slice up
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(gpu, &props);
+	VkDeviceSize alignment = props.limits.minUniformBufferOffsetAlignment;
+	uniform_slice_size = (uint32_t)((sizeof(uniform_struct) + alignment - 1) & ~(alignment - 1));
+
+	// With the uniform arena, each slice also has room for one
+	// uniform_struct for every draw of the frame, which is every
+	// cube, twice with the depth pre-pass (see record_draws)
+	VkDeviceSize reserved = uniform_slice_size;
+
+	if (use_uniform_arena)
+	{
+		uint32_t drawsPerFrame = scene_object_count * (use_depth_prepass ? 2 : 1);
+		uniform_slice_size += (uint32_t)reserved * drawsPerFrame;
+	}
+
+	// make a createInfo for the buffer.
+	// It has the necessary sType, and it
+	// has a usage bit that says this will be 
+	// a Uniform Buffer. Throughout these tutorials
+	// we will be making many buffers that will be used
+	// for many different things. We also set the size to
+	// the size of all slices together
+	VkBufferCreateInfo buf_info = {};
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	buf_info.size = uniform_slice_size * frame_lag;
+
+	// we make a new CPU buffer, and we copy our data into every
+	// slice of the buffer. we give the allocator (which was created
+	// earlier) to help us create the buffer. This buffer is written
+	// every frame, so we keep it mapped for its whole lifetime
+	matrixBufferCPU = BufferCPU(device, allocator, buf_info, true, use_device_local_host_buffers);
+	matrixBufferCPU.SetName("Uniform buffer");
+
+	for (uint32_t i = 0; i < frame_lag; i++)
+		matrixBufferCPU.Store(&temporaryData, sizeof(uniform_struct), i * uniform_slice_size);
+
+	if (use_uniform_arena)
+		uniform_arena = new UniformArena(&matrixBufferCPU, uniform_slice_size, reserved, alignment);
+}
+
+void Demo::prepare_sampler()
+{
+	// A sampler is used by the graphics card to get each pixel from the texture. Raw
+	// pixel data from a texture is not enough, the sampler gets the pixel out of the 
+	// texture, depending on UV coordinates. We only need one sampler for the entire
+	// program, regardless of how many textures we have. In extreme cases like
+	// Call of Duty and Grand Theft Auto, they probably have 10 different samplers
+	// (probably less) that are shared for all of their textures
+
+	// The sampler cache makes sure that textures that want the same kind
+	// of sampler share one, see SamplerCache.cpp. Any other texture, or
+	// material, should get its sampler from the same cache
+	sampler_cache = new SamplerCache(device, gpu, use_anisotropy);
+
+	// Create information about our sampler
+	// Give it the required sType
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+
+	// This handles filtering of the texture.
+	// If the pixels of the texture don't perfectly
+	// allign with pixels on the screen, blend the
+	// pixels of the texture that are nearest to the 
+	// pixel on the screen
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+
+	// This is for mipmaps. When the cube is far away, the
+	// sampler reads from the smaller mip levels, and it blends
+	// the two levels that are closest to the size on the screen.
+	// Reading small levels is faster than reading the full
+	// image, because the pixels are closer together in memory.
+	// maxLod lets the sampler use every level that exists
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	// All images have UV values that range from 0 to 1.
+	// If we go outside of this 0 to 1 range, then the texture
+	// repeats. Our UVs wont go outside of the 0 to 1 range,
+	// so you can ignore it. We can also use BORDER and CLAMP
+	// which make pixels outside the 0 to 1 range the same as
+	// the pixels on the edge of the texture, or they can all
+	// default to black, it doesn't really matter for now
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+
+	// Without anisotropy, the sampler blends the mip levels by the
+	// shorter side of each pixel's footprint on the texture, which makes
+	// surfaces at a steep angle blurry. Anisotropy takes several samples
+	// along the longer side instead. The cache lowers the amount to what
+	// the GPU supports, and turns it off if the feature is not enabled
+	samplerInfo.anisotropyEnable = use_anisotropy ? VK_TRUE : VK_FALSE;
+	samplerInfo.maxAnisotropy = use_anisotropy ? SAMPLER_MAX_ANISOTROPY : 1.0f;
+
+	// we don't need any compare operations, we just need pixels
+	samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+
+	// if we are using CLAMP for addressMode, then default 
+	// the pixel color to WHITE
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+	// get the sampler, based on the information we want,
+	// the cache only creates it if it does not have one yet
+	sampler = sampler_cache->Get(samplerInfo);
+}
+
+bool Demo::prepare_compressed_texture()
+{
+	// A PNG file is small on the disk, but the CPU has to decode it,
+	// and then it takes 4 bytes per pixel on the GPU. Block-compressed
+	// formats are decoded by the GPU while it samples the texture,
+	// so they stay small on the GPU too: BC1 is half a byte per pixel,
+	// BC7 and ASTC 4x4 are one byte per pixel. KTX2 files have the
+	// blocks ready to copy, and every mip level is already in the file
+
+	// Not every GPU supports every format. Desktop GPUs support BC,
+	// and phones support ASTC, so we try each file in this order,
+	// and use the first one that exists and that our GPU can sample
+	const char* candidates[] =
+	{
+		"../../../Assets/logo_bc7.ktx2",
+		"../../../Assets/logo_astc.ktx2",
+		"../../../Assets/logo_bc1.ktx2",
+	};
+
+	for (uint32_t i = 0; i < ARRAY_SIZE(candidates); i++)
+	{
+		KtxFile ktx;
+
+		// With GPU decompression, a file that is compressed in the asset
+		// pack is not opened with MappedFile, which would decompress all
+		// of it on the CPU. Only its first block is, for the header
+		const AssetPackEntry* packed = nullptr;
+
+		if (use_gpu_decompression && AssetPack::global != nullptr)
+		{
+			packed = AssetPack::global->Find(candidates[i]);
+
+			if (packed != nullptr && !(packed->flags & ASSET_PACK_COMPRESSED))
+				packed = nullptr;
+		}
+
+		if (packed != nullptr)
+		{
+			std::vector<char> head;
+
+			if (!AssetPack::DecompressHead(AssetPack::global->GetData(packed), (size_t)packed->storedSize, &head) ||
+				!ktx.Parse(head.data(), (size_t)packed->size, candidates[i]))
+				continue;
+		}
+		else if (!ktx.Load(candidates[i]))
+			continue;
+
+		// The sampler uses LINEAR filtering, so
+		// the format has to support that too
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(gpu, ktx.format, &props);
+
+		VkFormatFeatureFlags needed =
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+		if ((props.optimalTilingFeatures & needed) != needed)
+			continue;
+
+		// The streamer keeps its own copy of the file mapped, because
+		// it loads the levels from it later. For now, only the tail
+		// of the texture is uploaded, see TextureStreamer::Add
+		if (use_texture_streaming)
+		{
+			KtxFile* streamed = new KtxFile();
+			streamed->Load(candidates[i]);
+
+			// a GPU with sparse residency might not have it for every format
+			if (use_sparse_textures)
+			{
+				uint32_t sparseCount = 0;
+				vkGetPhysicalDeviceSparseImageFormatProperties(gpu, ktx.format, VK_IMAGE_TYPE_2D,
+					VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+					VK_IMAGE_TILING_OPTIMAL, &sparseCount, NULL);
+
+				if (sparseCount == 0)
+				{
+					printf("The texture format can not be sparse, sparse textures are disabled\n");
+					use_sparse_textures = false;
+				}
+				else
+					sparse_pool = new SparseTilePool(device, allocator, queue, sync_pool);
+			}
+
+			texture_streamer = new TextureStreamer(device, allocator, uploader, texture_budget, sparse_pool);
+
+			// the copies go to the queue that draws the frames
+			if (use_defragmentation && !use_sparse_textures)
+				texture_streamer->EnableDefrag(queue, oneshot_cmds, graphics_submits);
+
+			if (use_async_reads)
+			{
+				async_reader = new AsyncFileReader();
+				texture_streamer->EnableAsyncReads(async_reader);
+			}
+
+			texture_streamer->Add(streamed, "Cube texture", candidates[i]);
+			textureGPU = texture_streamer->GetTexture(0);
+
+			printf("Streaming compressed texture %s\n", candidates[i]);
+			return true;
+		}
+
+		// This is the same as the PNG texture in prepare_textures,
+		// but the format and the number of mip levels come from the file
+		VkImageCreateInfo image_create_info = {};
+		image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_create_info.imageType = VK_IMAGE_TYPE_2D;
+		image_create_info.format = ktx.format;
+		image_create_info.extent.width = ktx.width;
+		image_create_info.extent.height = ktx.height;
+		image_create_info.extent.depth = 1;
+		image_create_info.mipLevels = ktx.levelCount;
+		image_create_info.arrayLayers = 1;
+		image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		image_create_info.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+
+		// the GPU decompressor copies on the GPU, it does not use the uploader
+		if (packed == nullptr)
+			add_host_transfer_usage(&image_create_info);
+
+		textureGPU = new TextureGPU(
+			device,
+			allocator,
+			image_create_info,
+			VK_IMAGE_ASPECT_COLOR_BIT);
+
+		textureGPU->SetName("Cube texture");
+
+		// The whole file goes into the staging ring, and each
+		// level is copied from where it is in the file. With GPU
+		// decompression, the compressed blob goes to the GPU instead,
+		// and the levels are copied from the file that the GPU made
+		if (packed != nullptr)
+		{
+			gpu_decompressor->UploadTexture(textureGPU, AssetPack::global->GetData(packed), (size_t)packed->storedSize,
+				(size_t)packed->size, ktx.levelCount, ktx.regions.data());
+
+			printf("Decompressed %s on the GPU\n", candidates[i]);
+		}
+		else
+			uploader->UploadTextureLevels(textureGPU, (void*)ktx.GetData(), ktx.GetSize(),
+				ktx.levelCount, ktx.regions.data());
+
+		printf("Loaded compressed texture %s\n", candidates[i]);
+		return true;
+	}
+
+	return false;
+}
+
+bool Demo::prepare_transcoded_texture()
+{
+	// the streamer loads levels from a KTX2 file, and there is none
+	if (use_texture_streaming)
+	{
+		printf("The texture is transcoded, texture streaming is disabled\n");
+		use_texture_streaming = false;
+		use_sparse_textures = false;
+	}
+
+	// The PNG file is the source of every format, it is decoded
+	// the same way as in prepare_textures, but the pixels are read
+	// by the CPU, and never uploaded as they are
+	TextureLoader loader(device, allocator, job_system);
+	loader.Add("../../../Assets/logo.png");
+
+	if (use_texture_cache)
+		loader.EnableCache();
+
+	loader.Decode();
+
+	DecodedImage* logo = loader.Get(0);
+
+	if (logo->staging == nullptr)
+		return false;
+
+	TextureTranscoder transcoder(job_system);
+	VkFormat format = TextureTranscoder::SelectFormat(gpu);
+	transcoder.Transcode((const uint8_t*)logo->staging->GetPointer(), (uint32_t)logo->width, (uint32_t)logo->height, format);
+
+	// This is the same as the KTX2 texture in prepare_compressed_texture,
+	// but the format and the levels come from the transcoder
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = transcoder.format;
+	image_create_info.extent.width = (uint32_t)logo->width;
+	image_create_info.extent.height = (uint32_t)logo->height;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = transcoder.levelCount;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+	add_host_transfer_usage(&image_create_info);
+
+	textureGPU = new TextureGPU(
+		device,
+		allocator,
+		image_create_info,
+		VK_IMAGE_ASPECT_COLOR_BIT);
+
+	textureGPU->SetName("Cube texture");
+
+	uploader->UploadTextureLevels(textureGPU, transcoder.data.data(), transcoder.data.size(),
+		transcoder.levelCount, transcoder.regions.data());
+
+	const char* name =
+		(transcoder.format == VK_FORMAT_ASTC_4x4_UNORM_BLOCK) ? "ASTC 4x4" :
+		(transcoder.format == VK_FORMAT_BC1_RGB_UNORM_BLOCK) ? "BC1" : "R8G8B8A8";
+
+	printf("Transcoded the texture to %s, %u levels, %u jobs, %.2f ms\n",
+		name, transcoder.levelCount, transcoder.jobCount, transcoder.milliseconds);
+
+	return true;
+}
+
+void Demo::prepare_textures()
+{
+	// The video texture has its own images, the first frame of the
+	// video is uploaded now, and is shown in the first frame
+	if (use_video_texture)
+	{
+		video_texture = new VideoTexture(device, gpu, allocator, video_format, 256, 256,
+			fpCreateSamplerYcbcrConversionKHR, fpDestroySamplerYcbcrConversionKHR);
+
+		TextureGPU* image = video_texture->Acquire(0);
+		video_texture->MakeTestFrame(video_frame_index++, video_frame);
+		video_texture->Submit(image, video_texture->Upload(uploader, image, video_frame.data()));
+		video_texture->Update(uploader, 0);
+
+		textureGPU = video_texture->GetTexture();
+		return;
+	}
+
+	// a texture from another process replaces the file
+	if (use_external_memory && prepare_shared_texture())
+	{
+		use_texture_streaming = false;
+		use_sparse_textures = false;
+		use_placeholder_texture = false;
+		return;
+	}
+
+	// Use a compressed texture, if there is one that our
+	// GPU supports, otherwise decode the PNG file
+	if ((use_texture_transcoding && prepare_transcoded_texture()) || prepare_compressed_texture())
+	{
+		if (use_placeholder_texture)
+		{
+			printf("The texture is not decoded, the placeholder texture is disabled\n");
+			use_placeholder_texture = false;
+		}
+
+		return;
+	}
+
+	// a PNG file only has one level, so there is nothing to stream
+	if (use_texture_streaming)
+	{
+		printf("There is no compressed texture, texture streaming is disabled\n");
+		use_texture_streaming = false;
+		use_sparse_textures = false;
+	}
+
+	// This may be hard to believe, but there
+	// are some GPUs out there that do not support
+	// image textures. These GPUs are, of course, not
+	// any kind of consumer-level GPU, but we still should
+	// check the GPu to see if it supports textures, just
+	// in case. Here we create VkFormatProperties to 
+	// check to see if the GPU supports the texture
+	// format we want
+	VkFormatProperties props;
+
+	// This is the texture format we want, it 
+	// is very simple, it has a red channel, a green
+	// channel, a blue channel, and an alpha channel
+	const VkFormat tex_format = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// Check the properties that the GPU supports for this 
+	// texture format. If the GPU does not support this format,
+	// then the format properties it returns will be NULL
+	vkGetPhysicalDeviceFormatProperties(gpu, tex_format, &props);
+
+	// The process of using a sampler (which we just made) to get
+	// pixels from the texture, is caled "sampling pixels from the image".
+
+	// If our GPU has the ability to sample pixels from
+	// this image format (RGBA), then we can load our texture
+	if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+	{
+		// PNG files take a long time to decode, so they are decoded
+		// by the TextureLoader, on many threads at the same time.
+		// We only have one texture, but every texture that is added
+		// here is decoded together with the others. The loader maps
+		// each file into memory, and decodes it straight into a CPU
+		// buffer that the uploader can copy from. With the placeholder
+		// texture, the loader keeps decoding after this returns, and
+		// update_placeholder_texture uploads the logo when it is finished
+		if (use_placeholder_texture)
+		{
+			texture_loader = new TextureLoader(device, allocator, job_system);
+			texture_loader->Add("../../../Assets/logo.png");
+
+			if (use_texture_cache)
+				texture_loader->EnableCache();
+
+			texture_loader->Start(&texture_decode);
+			textureGPU = create_placeholder_texture();
+			return;
+		}
+
+		TextureLoader loader(device, allocator, job_system);
+		loader.Add("../../../Assets/logo.png");
+
+		if (use_texture_cache)
+			loader.EnableCache();
+
+		loader.Decode();
+
+		textureGPU = create_logo_texture(&loader);
+	}
+
+	// If the GPU does not support the ability to sample
+	// pixels from this texture format with our sampler, 
+	// then give an error that says the format is not supported
+	else
+	{
+		assert(!"No support for R8G8B8A8_UNORM as texture image format");
+	}
+}
+
+bool Demo::prepare_shared_texture()
+{
+	const char* sharedEnv = getenv("VKCUBE_SHARED_TEXTURE");
+
+	if (sharedEnv == nullptr)
+		return false;
+
+	char name[256] = {};
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	if (sscanf(sharedEnv, "%255[^,],%u,%u", name, &width, &height) != 3 || width == 0 || height == 0)
+	{
+		printf("VKCUBE_SHARED_TEXTURE should be name,width,height\n");
+		return false;
+	}
+
+	// the names of shared objects are wide strings
+	wchar_t wideName[256] = {};
+
+	for (uint32_t i = 0; name[i] != 0; i++)
+		wideName[i] = (wchar_t)name[i];
+
+	// The other process made the image with this same create info, and
+	// the handle type of ExternalMemory. It released the image to
+	// VK_QUEUE_FAMILY_EXTERNAL in GENERAL layout, after it wrote it
+	VkExternalMemoryImageCreateInfoKHR externalInfo = ExternalMemory::GetImageInfo();
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.pNext = &externalInfo;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+	image_create_info.extent.width = width;
+	image_create_info.extent.height = height;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	TextureGPU* texture = new TextureGPU(device, allocator, image_create_info, VK_IMAGE_ASPECT_COLOR_BIT, true);
+	shared_texture = new ExternalMemory(device, allocator, &external_functions);
+
+	if (!shared_texture->ImportImage(texture, NULL, wideName))
+	{
+		printf("Could not open the shared texture %s, loading the texture file\n", name);
+		delete texture;
+		delete shared_texture;
+		shared_texture = nullptr;
+		return false;
+	}
+
+	texture->SetName("Shared texture");
+
+	// The image belongs to the other process until the graphics queue
+	// acquires it. This only happens once, so the CPU waits for it
+	VkCommandBuffer cmd = oneshot_cmds->Begin();
+	ExternalMemory::AcquireImage(cmd, texture, VK_IMAGE_LAYOUT_GENERAL, graphics_queue_family_index);
+	DeviceTable::EndCommandBuffer(cmd);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+
+	VkFence fence = sync_pool->AcquireFence();
+
+	VkResult err;
+	{
+		QueueLock queueLock;
+		err = DeviceTable::QueueSubmit(queue, 1, &submitInfo, fence);
+	}
+	if (err != VK_SUCCESS)
+		ERR_EXIT("vkQueueSubmit failed\n", "Shared Texture Failure");
+
+	DeviceTable::WaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	sync_pool->ReleaseFence(fence);
+
+	textureGPU = texture;
+	printf("Sampling the shared texture %s (%ux%u)\n", name, width, height);
+	return true;
+}
+
+void Demo::prepare_encoder_output()
+{
+	const char* encoderEnv = getenv("VKCUBE_ENCODER_OUTPUT");
+
+	char name[256] = {};
+	uint32_t encodeWidth = 0;
+	uint32_t encodeHeight = 0;
+
+	if (sscanf(encoderEnv, "%255[^,],%u,%u", name, &encodeWidth, &encodeHeight) != 3 || encodeWidth == 0 || encodeHeight == 0)
+	{
+		printf("VKCUBE_ENCODER_OUTPUT should be name,width,height\n");
+		use_encoder_output = false;
+		return;
+	}
+
+	// The encoder knows which image is done by the value of a timeline
+	// semaphore, and tells us which one it is done with the same way
+	if (!use_external_memory || !use_timeline_semaphores)
+	{
+		printf("Encoder output needs external memory and timeline semaphores, it is disabled\n");
+		use_encoder_output = false;
+		return;
+	}
+
+	// the final image is scaled to the size of the encoder, with a blit
+	VkFormatProperties formatProps;
+	vkGetPhysicalDeviceFormatProperties(gpu, format, &formatProps);
+
+	VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+
+	if ((formatProps.optimalTilingFeatures & blitFeatures) != blitFeatures)
+	{
+		printf("The swapchain format can not be blitted, encoder output is disabled\n");
+		use_encoder_output = false;
+		return;
+	}
+
+	// One slot more than the frames in flight, so the encoder can
+	// read one image while the GPU draws the frames that come after it
+	encoder_bridge = new EncoderBridge(device, allocator, &external_functions, fpGetSemaphoreCounterValueKHR,
+		graphics_queue_family_index, frame_lag + 1, encodeWidth, encodeHeight, format, name);
+
+	if (!encoder_bridge->IsReady())
+	{
+		printf("Could not export the images of the encoder output %s, it is disabled\n", name);
+		delete encoder_bridge;
+		encoder_bridge = nullptr;
+		use_encoder_output = false;
+		return;
+	}
+
+	printf("Encoder output %s (%ux%u), the encoder opens %s_image_0 to %s_image_%u\n",
+		name, encodeWidth, encodeHeight, name, name, frame_lag);
+}
+
+TextureGPU* Demo::create_logo_texture(TextureLoader* loader)
+{
+	if (use_texture_cache)
+		printf("Texture cache: %u images from the cache, %u decoded\n", loader->cacheHits, loader->decodeCount);
+
+	// STB Image (inside of the loader) gives us the texture's width
+	// and height. The pixels are always RGBA. I personally use STB
+	// becasue it is lightweight and it works on every platform that
+	// I develop for. It works with OpenGL, DirectX 11 / 12, Xbox One,
+	// Switch, PlayStation, and more
+	DecodedImage* logo = loader->Get(0);
+
+	if (logo->width == 0)
+		ERR_EXIT("Could not load logo.png\n", "Texture Failure");
+
+	// create variables for the width and
+	// the height of the texture we load
+	int tex_width = logo->width;
+	int tex_height = logo->height;
+
+	// We are going to combine what we did to create the Vertex / Index buffers,
+	// with what we did to create the depth buffers. We need to create a GPU
+	// image that is empty, then we need to give the CPU buffer to the uploader,
+	// which copies it to the GPU, so that it can be used by the shaders
+
+	// Just like when we created the depth buffer,
+	// we have a VkImageCreateInfo. We give it the
+	// required sType, we let it know that it is a 2D
+	// image, we give it the texture dimensions, we 
+	// let it know that this is PREINITIALIZED, which means
+	// that the GPU buffer  is currently empty 
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+	image_create_info.extent.width = tex_width;
+	image_create_info.extent.height = tex_height;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	// We want a full mipmap chain, every level is half the size
+	// of the last level, until the level is 1x1. The levels are
+	// made on the GPU with vkCmdBlitImage (see TextureGPU::GenerateMips),
+	// which reads from the image (TRANSFER_SRC), and it needs
+	// the GPU to be able to blit and filter this format
+	VkFormatFeatureFlags mipFeatures =
+		VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+		VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(gpu, image_create_info.format, &props);
+
+	if ((props.optimalTilingFeatures & mipFeatures) == mipFeatures)
+	{
+		uint32_t largest = (tex_width > tex_height) ? tex_width : tex_height;
+
+		image_create_info.mipLevels = (uint32_t)floor(log2((double)largest)) + 1;
+		image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+
+	// We create the GPU texture the same way that
+	// we created the depth buffer, except this time,
+	// we use the Color aspect instead of depth
+	TextureGPU* texture = new TextureGPU(
+		device,
+		allocator,
+		image_create_info,
+		VK_IMAGE_ASPECT_COLOR_BIT);
+
+	texture->SetName("Cube texture");
+
+	// We give a command to the uploader that we want to copy an image
+	// from the CPU to the GPU. This command will execute when we submit
+	// the uploader, which happens later in prepare().
+	// It works the same way as normal buffers, except we give it the texture
+	// parameters, and a few extra steps are required under-the-hood in the 
+	// TextureGPU class. Students don't need to understand how TextureGPU works,
+	// but they can try to learn it if they want to. What is important is that
+	// they know how to use the class.
+	// The pixels are already in a CPU buffer, so the uploader
+	// copies straight from it, and it deletes the buffer when
+	// the copy is finished, so the loader must not delete it
+	uploader->UploadTexture(texture, logo->staging, tex_width, tex_height);
+	logo->staging = nullptr;
+	return texture;
+}
+
+TextureGPU* Demo::create_placeholder_texture()
+{
+	// A checkerboard of two grays, 8x8 pixels. It is so small that its
+	// upload is part of the first batch, and the first frame can be
+	// drawn before the PNG is decoded. It has no mipmaps, because
+	// it is only seen for a few frames
+	const int size = 8;
+	uint32_t pixels[size * size];
+
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+			pixels[y * size + x] = ((x ^ y) & 1) ? 0xFF808080 : 0xFFC0C0C0;
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+	image_create_info.extent.width = size;
+	image_create_info.extent.height = size;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+
+	// it has all of its levels, so the CPU can copy it
+	add_host_transfer_usage(&image_create_info);
+
+	TextureGPU* texture = new TextureGPU(
+		device,
+		allocator,
+		image_create_info,
+		VK_IMAGE_ASPECT_COLOR_BIT);
+
+	texture->SetName("Placeholder texture");
+
+	// the pixels are copied into the staging ring, so they can be on the stack
+	uploader->UploadTexture(texture, pixels, size, size);
+	return texture;
+}
+
+void Demo::update_placeholder_texture(uint32_t slot)
+{
+	// The PNG is decoded, so its texture is made and uploaded. This
+	// happens here, on the thread of the frames, because the allocator
+	// is not used by two threads at the same time. The uploader has the
+	// staging buffer now, so the loader is not needed anymore
+	if (texture_loader != nullptr && texture_decode.value == 0)
+	{
+		pending_texture = create_logo_texture(texture_loader);
+		pending_texture_ticket = uploader->Submit();
+
+		delete texture_loader;
+		texture_loader = nullptr;
+	}
+
+	// When the upload is finished, the logo replaces the placeholder.
+	// The frames before this one might still be using the placeholder,
+	// so the deletion queue destroys it when they are done
+	if (pending_texture != nullptr && uploader->IsComplete(pending_texture_ticket))
+	{
+		TextureGPU* placeholder = textureGPU;
+		deletion_queue->Retire([placeholder]() { delete placeholder; }, frame_count);
+
+		textureGPU = pending_texture;
+		pending_texture = nullptr;
+		texture_generation++;
+
+		printf("The placeholder texture was replaced after %llu frames\n", (unsigned long long)frame_count);
+	}
+
+	descriptor_data[slot].texture.imageView = textureGPU->imageView;
+	write_frame_descriptors(slot, texture_generation);
+}
+
+void Demo::update_video_texture(uint32_t slot)
+{
+	// The next frame of the video goes into an image that no frame on
+	// the GPU is reading. If they are all in use, this frame of the
+	// video waits for the next frame of the demo
+	TextureGPU* image = video_texture->Acquire(get_completed_frames());
+
+	if (image != nullptr)
+	{
+		video_texture->MakeTestFrame(video_frame_index++, video_frame);
+		video_texture->Submit(image, video_texture->Upload(uploader, image, video_frame.data()));
+		uploader->Submit();
+	}
+
+	// the newest frame of the video that is finished is shown
+	video_texture->Update(uploader, frame_count);
+	textureGPU = video_texture->GetTexture();
+
+	descriptor_data[slot].texture.imageView = textureGPU->imageView;
+	write_frame_descriptors(slot, video_texture->generation);
+}
+
+void Demo::prepare_bindless_textures()
+{
+	// This is the list of every texture in the bindless array,
+	// the index of a texture in this list is the index that the
+	// fragment shader uses. To draw more textures, load them after
+	// textureGPU and add them here, prepare_descriptor_set writes them
+	// all into the array, up to BINDLESS_TEXTURE_COUNT of them
+	bindless_textures.clear();
+	bindless_textures.push_back(textureGPU);
+
+	// Each cube picks one of the textures, if there are more cubes
+	// than textures, the textures are used again, in the same order
+	object_textures.resize(scene_object_count);
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+		object_textures[i] = i % (uint32_t)bindless_textures.size();
+
+	if (use_scene_generator)
+		prepare_scene_textures();
+}
+
+void Demo::prepare_voxel_world()
+{
+	// One block is a sixteenth of the cube's size, so one chunk is as
+	// wide as a cube, and the world is centered under the cubes.
+	// A streamed world has no middle, it starts at block 0, and the
+	// first ring is around that, until the first frame moves it
+	float blockSize = 1.0f / 16.0f;
+	glm::vec3 size = glm::vec3((float)voxel_params.chunksX, (float)voxel_params.chunksY, (float)voxel_params.chunksZ) * (float)VOXEL_CHUNK_SIZE * blockSize;
+
+	if (use_voxel_streaming)
+		size.x = size.z = 0.0f;
+
+	voxel_model = glm::translate(glm::mat4(), glm::vec3(-0.5f * size.x, -3.0f - size.y, -0.5f * size.z));
+	voxel_model = glm::scale(voxel_model, glm::vec3(blockSize));
+
+	voxel_world->Prepare(mesh_pool, uploader, job_system);
+}
+
+void Demo::prepare_scene_textures()
+{
+	// Only the bindless array has a place for more than one texture
+	uint32_t textureCount = scene_generator->params.textureCount;
+
+	if (use_texture_arrays)
+	{
+		prepare_texture_arrays();
+		return;
+	}
+
+	if (!use_bindless_textures && textureCount > 1)
+	{
+		printf("The generated textures need bindless textures, every object uses the same texture\n");
+		textureCount = 1;
+	}
+
+	if (textureCount > BINDLESS_TEXTURE_COUNT)
+	{
+		printf("The bindless array has room for %u textures, the scene uses that many\n", BINDLESS_TEXTURE_COUNT);
+		textureCount = BINDLESS_TEXTURE_COUNT;
+	}
+
+	// texture 0 is the cube's texture, which is already
+	// in the array, the others are made by the generator
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+	image_create_info.extent.width = SCENE_TEXTURE_SIZE;
+	image_create_info.extent.height = SCENE_TEXTURE_SIZE;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	add_host_transfer_usage(&image_create_info);
+
+	std::vector<uint32_t> pixels;
+
+	for (uint32_t t = 1; t < textureCount; t++)
+	{
+		TextureGPU* texture = new TextureGPU(device, allocator, image_create_info, VK_IMAGE_ASPECT_COLOR_BIT);
+		texture->SetName("Generated texture");
+
+		scene_generator->BuildTexture(t, &pixels);
+		uploader->UploadTexture(texture, pixels.data(), SCENE_TEXTURE_SIZE, SCENE_TEXTURE_SIZE);
+
+		scene_textures.push_back(texture);
+		bindless_textures.push_back(texture);
+	}
+
+	// The shader reads the RGBA textures, so their uploads have to be
+	// finished first, then each one is replaced by a BC1 texture. The
+	// pointers stay the same, and the descriptors are written after this
+	if (use_gpu_texture_compression && !scene_textures.empty())
+	{
+		uploader->Wait(uploader->Submit());
+
+		for (size_t i = 0; i < scene_textures.size(); i++)
+			texture_compressor->Compress(scene_textures[i]);
+
+		printf("Compressed %u generated textures on the GPU, from %llu KB to %llu KB\n", (uint32_t)scene_textures.size(),
+			(unsigned long long)(texture_compressor->bytesBefore / 1024), (unsigned long long)(texture_compressor->bytesAfter / 1024));
+	}
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+		object_textures[i] = scene_generator->textures[i] % textureCount;
+}
+
+void Demo::add_host_transfer_usage(VkImageCreateInfo* info)
+{
+	// Not every format (or every size) can be copied by the CPU,
+	// the GPU says so when it is asked about an image that has the
+	// usage. Without it, the texture is uploaded like before
+	if (!use_host_image_copy)
+		return;
+
+	VkImageFormatProperties props;
+	VkResult err = vkGetPhysicalDeviceImageFormatProperties(gpu, info->format, info->imageType, info->tiling,
+		info->usage | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT, info->flags, &props);
+
+	if (err == VK_SUCCESS)
+		info->usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+}
+
+void Demo::prepare_texture_arrays()
+{
+	// Every generated texture has the same size, so they all fit in
+	// one array, unless there are more than the GPU has layers for
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(gpu, &properties);
+
+	uint32_t textureCount = scene_generator->params.textureCount;
+	std::vector<uint32_t> pixels;
+
+	for (uint32_t t = 0; t < textureCount; t++)
+	{
+		scene_generator->BuildTexture(t, &pixels);
+		texture_packer->Add(SCENE_TEXTURE_SIZE, SCENE_TEXTURE_SIZE, pixels.data());
+	}
+
+	texture_packer->Pack(device, allocator, uploader, properties.limits.maxImageArrayLayers);
+
+	// There is one descriptor for the array, so a texture
+	// that went into a second array is drawn with layer 0
+	if (texture_packer->arrays.size() > 1)
+		printf("The generated textures need %u arrays, the textures after the first array use layer 0\n", (uint32_t)texture_packer->arrays.size());
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		const PackedTexture& packed = texture_packer->placements[scene_generator->textures[i] % textureCount];
+		object_textures[i] = (packed.array == 0) ? packed.layer : 0;
+	}
+}
+
+void Demo::prepare_descriptor_layout()
+{
+	// Each descriptorSetLayoutBinding will describe what type
+	// of descriptor we will have at each binding in the shaders
+	VkDescriptorSetLayoutBinding layout_bindings[2];
+	memset(layout_bindings, 0, sizeof(VkDescriptorSetLayoutBinding) * 2);
+
+	// What I like about the VkDescriptorSetLayoutBinding is that
+	// it is structured similarly to an english sentence. For
+	// example, look at the comment below, compared to the 
+	// structure
+
+	// In the Veretx Shader, at binding 0, we have 1 descriptor, which is a uniform buffer.
+	// It is a DYNAMIC uniform buffer, which means that we give it an offset
+	// when we bind the descriptor set, so we can pick which slice to read
+	layout_bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	layout_bindings[0].binding = 0;
+	layout_bindings[0].descriptorCount = 1;
+	layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+
+	// Push descriptors can not be dynamic, so each command buffer
+	// pushes a normal uniform buffer, with the offset of its slice
+	if (use_push_descriptors)
+		layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+	// In the Fragment Shader, at binding 1, we have 1 descriptor, which is an image
+	layout_bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	layout_bindings[1].binding = 1;
+	layout_bindings[1].descriptorCount = 1;
+	layout_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	// With bindless textures, binding 1 is an array of BINDLESS_TEXTURE_COUNT images.
+	// PARTIALLY_BOUND means that the elements we never write to are allowed
+	// to stay empty, as long as the shader never reads them.
+	// UPDATE_AFTER_BIND means that we can write new textures into the array
+	// while command buffers that use the set are still waiting to run,
+	// so loading a texture never has to wait for the GPU
+	VkDescriptorBindingFlagsEXT binding_flags[2] = {};
+	binding_flags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info = {};
+	binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	binding_flags_info.bindingCount = 2;
+	binding_flags_info.pBindingFlags = binding_flags;
+
+	if (use_bindless_textures)
+		layout_bindings[1].descriptorCount = BINDLESS_TEXTURE_COUNT;
+
+	// the sampler of the video texture has a YCbCr conversion,
+	// and a sampler like that has to be in the layout itself
+	if (use_video_texture)
+		layout_bindings[1].pImmutableSamplers = &video_texture->sampler;
+
+	// That was easy enough, and it didn't require sType
+	// Now we have to create a descriptor layout with our array
+	// of descriptor layout bindings
+
+	// descriptor layout with two bindings
+	// we give it the array, and we let the structure
+	// know that there are 2 elements in the array.
+	// sType is required
+	VkDescriptorSetLayoutCreateInfo descriptor_layout = {};
+	descriptor_layout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptor_layout.bindingCount = 2;
+	descriptor_layout.pBindings = layout_bindings;
+
+	// a layout with an UPDATE_AFTER_BIND binding can only
+	// be used with a pool that was made for it
+	if (use_bindless_textures)
+	{
+		descriptor_layout.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		descriptor_layout.pNext = &binding_flags_info;
+	}
+
+	// a layout for push descriptors never has a set that
+	// is allocated from a pool, the descriptors are written
+	// into the command buffer with vkCmdPushDescriptorSet
+	if (use_push_descriptors)
+		descriptor_layout.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+
+	// With the sets split by frequency, the uniform buffer is
+	// the only binding of the frame set, and the texture is the
+	// only binding of the material set. The pass set is empty,
+	// there is nothing that the cube reads from an earlier pass
+	if (use_frequency_sets)
+	{
+		descriptor_layout.bindingCount = 1;
+		descriptor_layout.pBindings = &layout_bindings[1];
+		vkCreateDescriptorSetLayout(device, &descriptor_layout, HostAllocator::callbacks, &frequency_layouts[DESCRIPTOR_SET_MATERIAL]);
+
+		descriptor_layout.pBindings = &layout_bindings[0];
+		frequency_layouts[DESCRIPTOR_SET_PASS] = DescriptorSets::CreateEmptyLayout(device);
+	}
+
+	// create the descriptor layout with the information we provided
+	vkCreateDescriptorSetLayout(device, &descriptor_layout, HostAllocator::callbacks, &desc_layout);
+	frequency_layouts[DESCRIPTOR_SET_FRAME] = desc_layout;
+}
+
+void Demo::prepare_descriptor_pool()
+{
+	// There are two types of descriptors in the pool
+	// Uniform Buffer Descriptors
+	// Texture Descriptors
+	// We need to keep count of how many there are of each
+	VkDescriptorPoolSize type_counts[2];
+
+	// descriptor count is the number of buffers (of each type)
+	// that one descriptor set needs. The pools of the
+	// DescriptorAllocator have room for many sets of this size.
+	// In this case, its one uniform buffer and one texture.
+
+	// we will have one (dynamic) uniform buffer in each set
+	type_counts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	type_counts[0].descriptorCount = 1;
+
+	// we will have one image sampler in each set
+	type_counts[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	type_counts[1].descriptorCount = 1;
+
+	// unless we use bindless textures, then the
+	// whole array of textures is in the pool
+	if (use_bindless_textures)
+		type_counts[1].descriptorCount = BINDLESS_TEXTURE_COUNT;
+
+	// and a texture with a YCbCr conversion might need more than one
+	if (use_video_texture)
+		type_counts[1].descriptorCount = VideoTexture::GetDescriptorCount(gpu, video_format, fpGetPhysicalDeviceImageFormatProperties2KHR);
+
+	// poolSizeCount is 2 
+	// that is the number of elements in the type_counts array.
+	// If we increase the number of descriptors, this number should
+	// still be two. We would increase that number of we wanted
+	// other types of descriptors, like Storage Buffers (compute)
+	
+	// The DescriptorAllocator makes the pools, each one has room
+	// for DESCRIPTOR_SETS_PER_POOL sets, and it makes another pool
+	// when one is full. It also has pools for each frame_index, for sets
+	// that are only used for one frame, look at DescriptorAllocator.cpp
+	// for more information. We will talk more about sets right after
+	// this function is done
+	VkDescriptorPoolCreateFlags poolFlags = 0;
+	uint32_t setsPerPool = DESCRIPTOR_SETS_PER_POOL;
+
+	// The bindless layout needs pools that allow update after bind.
+	// Each bindless set has the whole array of textures, and there is
+	// only one of them, so each pool only needs room for one set
+	if (use_bindless_textures)
+	{
+		poolFlags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		setsPerPool = 1;
+	}
+
+	descriptor_allocator = new DescriptorAllocator(device, type_counts, 2, frame_lag, setsPerPool, poolFlags);
+}
+
+void Demo::prepare_descriptor_set()
+{
+	// The descriptors of every frame_index, as one DescriptorSetData
+	// each. With a descriptor set, only the first one is used, because
+	// the slice of the uniform buffer is picked with a dynamic offset.
+	// With push descriptors, each frame_index pushes the uniform buffer
+	// with the offset of its own slice, see record_draws
+	descriptor_data.resize(frame_lag);
+
+	for (uint32_t i = 0; i < frame_lag; i++)
+	{
+		descriptor_data[i].uniformBuffer.buffer = matrixBufferCPU.buffer;
+		descriptor_data[i].uniformBuffer.offset = use_push_descriptors ? i * uniform_slice_size : 0;
+		descriptor_data[i].uniformBuffer.range = sizeof(uniform_struct);
+
+		descriptor_data[i].texture.sampler = sampler;
+		descriptor_data[i].texture.imageView = use_texture_arrays ? texture_packer->arrays[0]->imageView : textureGPU->imageView;
+		descriptor_data[i].texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	// There is no set to allocate or write, the push descriptor
+	// template is made after the pipeline layout (see prepare_pipeline)
+	descriptor_set = VK_NULL_HANDLE;
+	descriptor_template = VK_NULL_HANDLE;
+
+	if (use_push_descriptors)
+		return;
+
+	// we need to allocate a space in memory for
+	// our descriptor set. In this case, we will
+	// only have one descriptor set. This set will
+	// be stored in a pool of the descriptor allocator,
+	// it stays there until the program closes,
+	// and this descriptor set will use the layout that
+	// we made earlier (desc_layout) which is given to
+	// the pipeline (explained later)
+	descriptor_set = descriptor_allocator->Allocate(desc_layout);
+
+	// the texture gets a set of its own, which stays bound while
+	// the frame set is bound again at other dynamic offsets
+	material_set = VK_NULL_HANDLE;
+
+	if (use_frequency_sets)
+		material_set = descriptor_allocator->Allocate(frequency_layouts[DESCRIPTOR_SET_MATERIAL]);
+
+	// With an update template, the whole set is written
+	// from descriptor_data with one call, and the template knows
+	// where each descriptor is, so none of the
+	// VkWriteDescriptorSet structures below are needed.
+	// The template writes both bindings into one set, so
+	// the split sets are written one descriptor at a time
+	bool templateWrites = update_template_enabled && !use_frequency_sets;
+
+	if (templateWrites)
+	{
+		prepare_descriptor_template(VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR);
+		fpUpdateDescriptorSetWithTemplateKHR(device, descriptor_set, descriptor_template, &descriptor_data[0]);
+	}
+
+	// The first descriptor will be the uniform buffer
+	// because this descriptor is at binding #0 of the shader.
+	// The range is only one slice, the offset of the slice
+	// is given later, when the descriptor set is bound
+	VkDescriptorBufferInfo buffer_info = {};
+	buffer_info.range = sizeof(uniform_struct);
+	buffer_info.buffer = matrixBufferCPU.buffer;
+
+	// The next descriptor is the texture descriptor,
+	// because this descriptor is at binding #1 of the shader
+	VkDescriptorImageInfo texDesc = {};
+	texDesc.sampler = sampler;
+	texDesc.imageView = use_texture_arrays ? texture_packer->arrays[0]->imageView : textureGPU->imageView;
+	texDesc.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	// VkWriteDescriptorSet does not a structure that allows
+	// us to write to an entire set of descriptors,
+	// it is a structure that allows us to write to one descriptor
+	// that is part of a set
+
+	// we need two of these, one for each descriptor in the set
+	VkWriteDescriptorSet writes[2];
+	
+	// this initializes the bytes in the array to all be zero
+	memset(&writes, 0, sizeof(writes));
+
+	// sType is required
+	// we are writing one descriptor per structure, so the 
+	// descriptorCount per structure will be 1
+	// dstSet is the destination set that we want to write to,
+	// we only have one descriptor set (called "descriptor_set")
+	// so that is the one we are using
+	
+	// The binding we are writing to is 0
+	// The type of descriptor in this structure is a UNIFORM_BUFFER_DYNAMIC
+	// and buffer_info is the VkDescriptorBufferInfo that we made
+	// just a minute ago in this function
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].descriptorCount = 1;
+	writes[0].dstSet = descriptor_set;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	writes[0].pBufferInfo = &buffer_info;
+
+	// sType, descriptorCount, and dstSet is the same as before
+	// The binding we are writing to is 1
+	// The type of descriptor in this structure is a IMAGE_SAMPLER
+	// and buffer_info is the VkDescriptorImageInfo that we made
+	// just a minute ago in this function
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].descriptorCount = 1;
+	writes[1].dstSet = use_frequency_sets ? material_set : descriptor_set;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[1].pImageInfo = &texDesc;
+
+	// update the descriptors, we give it the device (GPU),
+	// we give it 2, because there are two elements in the
+	// "writes" array, and we give it the "writes" array
+	if (!templateWrites)
+		DeviceTable::UpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+	// With texture streaming (or the placeholder texture, or the video
+	// texture), the texture can change while frames are still using the
+	// descriptor set, so each frame_index gets its own set, see
+	// write_frame_descriptors
+	if (use_texture_streaming || use_placeholder_texture || use_video_texture)
+	{
+		streamed_sets.resize(frame_lag);
+		streamed_set_generations.assign(frame_lag, UINT32_MAX);
+
+		for (uint32_t i = 0; i < frame_lag; i++)
+			streamed_sets[i] = descriptor_allocator->Allocate(desc_layout);
+	}
+
+	// With bindless textures, every texture gets its own element
+	// of the array at binding 1, at the index that the cubes use to
+	// pick it (see prepare_bindless_textures). The first one is
+	// textureGPU, which was already written above
+	if (use_bindless_textures && bindless_textures.size() > 1)
+	{
+		std::vector<VkDescriptorImageInfo> bindlessDesc(bindless_textures.size() - 1);
+
+		for (uint32_t i = 0; i < bindlessDesc.size(); i++)
+		{
+			bindlessDesc[i].sampler = sampler;
+			bindlessDesc[i].imageView = bindless_textures[i + 1]->imageView;
+			bindlessDesc[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+
+		writes[1].dstArrayElement = 1;
+		writes[1].descriptorCount = (uint32_t)bindlessDesc.size();
+		writes[1].pImageInfo = bindlessDesc.data();
+		DeviceTable::UpdateDescriptorSets(device, 1, &writes[1], 0, NULL);
+	}
+}
+
+void Demo::prepare_descriptor_template(VkDescriptorUpdateTemplateTypeKHR type)
+{
+	// An update template is a list of where each descriptor is,
+	// inside of a struct (DescriptorSetData). Instead of one
+	// VkWriteDescriptorSet for each descriptor, which the driver has
+	// to read one at a time, we give it a pointer to the struct, and
+	// the driver copies all of the descriptors out of it at once
+	VkDescriptorUpdateTemplateEntryKHR entries[2] = {};
+
+	// binding 0 is the uniform buffer, it is a normal uniform
+	// buffer with push descriptors (see prepare_descriptor_layout)
+	entries[0].dstBinding = 0;
+	entries[0].dstArrayElement = 0;
+	entries[0].descriptorCount = 1;
+	entries[0].descriptorType = use_push_descriptors ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	entries[0].offset = offsetof(DescriptorSetData, uniformBuffer);
+	entries[0].stride = sizeof(DescriptorSetData);
+
+	// binding 1 is the texture, with bindless textures this is
+	// only the first element of the array, the others are
+	// written by prepare_descriptor_set
+	entries[1].dstBinding = 1;
+	entries[1].dstArrayElement = 0;
+	entries[1].descriptorCount = 1;
+	entries[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	entries[1].offset = offsetof(DescriptorSetData, texture);
+	entries[1].stride = sizeof(DescriptorSetData);
+
+	// A template for a set needs the layout of the set. A template
+	// for push descriptors needs the pipeline layout, and which
+	// set of the pipeline layout is pushed
+	VkDescriptorUpdateTemplateCreateInfoKHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+	info.descriptorUpdateEntryCount = 2;
+	info.pDescriptorUpdateEntries = entries;
+	info.templateType = type;
+	info.descriptorSetLayout = desc_layout;
+	info.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	info.pipelineLayout = pipeline_layout;
+	info.set = 0;
+
+	VkResult err = fpCreateDescriptorUpdateTemplateKHR(device, &info, HostAllocator::callbacks, &descriptor_template);
+
+	if (err != VK_SUCCESS)
+		ERR_EXIT("vkCreateDescriptorUpdateTemplateKHR failed", "Descriptor Template Failure");
+}
+
+std::vector<char> Demo::build_cube_mesh()
+{
+	// This makes the same bytes that are saved in MESH_FILE.
+	// It only runs when there is no mesh file yet (or when the
+	// file has the wrong vertex format), which is usually only
+	// the first time that the program runs
+
+	// The cube has 36 corners of triangles (6 sides, 2 triangles
+	// each, 3 corners per triangle), but a lot of those corners are
+	// the same: two triangles of one side share two corners. If two
+	// corners have the same position AND the same UV, then they are
+	// the same vertex, and we only need to store it once. Then the
+	// index buffer says which vertex each corner uses. A cube has
+	// 8 positions, but each side has its own UVs, so there are
+	// 4 unique vertices on each side, 24 at most. Where two sides
+	// meet with the same UV, they can share even more, and the
+	// cube in CubeDataArrays.h ends up with 20 vertices.
+
+	// Fewer vertices also means that the GPU can reuse more vertices
+	// that it already ran the vertex shader for (the post-transform
+	// cache), because the same index shows up more than once
+	std::vector<VertexStructure> vertexArray;
+	std::vector<uint32_t> indexArray;
+
+	// Every level of detail (LOD) is a whole cube, and they all go in
+	// the same vertex and index buffers, one after the other. The last
+	// LOD is the cube from CubeDataArrays.h, and each LOD before it
+	// cuts every triangle into 4 smaller triangles (2 times as many
+	// on each edge). A flat cube does not need more triangles to look
+	// right, but this is the same kind of LOD chain that a curved model
+	// would have, where the far LODs would be the ones with less detail
+	std::vector<MeshLod> lods(mesh_lod_count);
+	std::vector<uint32_t> lodFirstVertex(mesh_lod_count);
+
+	for (uint32_t lod = 0; lod < mesh_lod_count; lod++)
+	{
+		uint32_t firstVertex = (uint32_t)vertexArray.size();
+		uint32_t n = 1 << (mesh_lod_count - 1 - lod);
+
+		lodFirstVertex[lod] = firstVertex;
+		lods[lod].firstIndex = (uint32_t)indexArray.size();
+
+		// LOD 0 is used when the cube is at least half as tall as the
+		// screen, each LOD after it when the cube is 4 times smaller
+		// than that, and the last LOD is used for everything smaller
+		lods[lod].minScreenHeight = (lod == mesh_lod_count - 1) ? 0.0f : 0.5f / (float)(1 << (2 * lod));
+
+		// We will copy data into the vertex array from 
+		// arrays called g_vertex_buffer_data, and 
+		// g_uv_buffer_data. These arrays can be found
+		// in the CCubeDataArrays.h file, when we load
+		// 3D Obj files in the future, we won't need to do this
+		for (unsigned int t = 0; t < 12; t++)
+		{
+			// the three corners of this triangle
+			VertexStructure c[3];
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				unsigned int i = t * 3 + k;
+				c[k].position[0] = g_vertex_buffer_data[i * 3];
+				c[k].position[1] = g_vertex_buffer_data[i * 3 + 1];
+				c[k].position[2] = g_vertex_buffer_data[i * 3 + 2];
+				c[k].uv[0] = g_uv_buffer_data[2 * i];
+				c[k].uv[1] = g_uv_buffer_data[2 * i + 1];
+			}
+
+			// Cut the triangle into n * n triangles. Each small corner
+			// is (row, col) steps from corner 0, where col goes to
+			// corner 1, and row goes to corner 2. With n = 1, these
+			// are the same two corners of the original triangle
+			for (unsigned int row = 0; row < n; row++)
+			{
+				for (unsigned int col = 0; col < n - row; col++)
+				{
+					// one triangle pointing the same way as the big one,
+					// and one upside down triangle, if there is room for it
+					unsigned int grid[2][3][2] =
+					{
+						{ { row, col }, { row, col + 1 }, { row + 1, col } },
+						{ { row, col + 1 }, { row + 1, col + 1 }, { row + 1, col } }
+					};
+					unsigned int triangles = (col + 1 < n - row) ? 2 : 1;
+
+					for (unsigned int g = 0; g < triangles; g++)
+					{
+						for (unsigned int k = 0; k < 3; k++)
+						{
+							float u = (float)grid[g][k][1] / (float)n;
+							float w = (float)grid[g][k][0] / (float)n;
+
+							VertexStructure v;
+							for (int e = 0; e < 3; e++)
+								v.position[e] = c[0].position[e] + (c[1].position[e] - c[0].position[e]) * u + (c[2].position[e] - c[0].position[e]) * w;
+							for (int e = 0; e < 2; e++)
+								v.uv[e] = c[0].uv[e] + (c[1].uv[e] - c[0].uv[e]) * u + (c[2].uv[e] - c[0].uv[e]) * w;
+
+							// Look for a vertex of this LOD that we already
+							// have, that is exactly the same. The cube is tiny,
+							// so checking every vertex is fast enough, a big
+							// model would use a hash table here instead
+							uint32_t index = (uint32_t)vertexArray.size();
+							for (uint32_t j = firstVertex; j < (uint32_t)vertexArray.size(); j++)
+							{
+								if (memcmp(&vertexArray[j], &v, sizeof(VertexStructure)) == 0)
+								{
+									index = j;
+									break;
+								}
+							}
+
+							// if we did not find it, it is a new vertex
+							if (index == (uint32_t)vertexArray.size())
+								vertexArray.push_back(v);
+
+							indexArray.push_back(index);
+						}
+					}
+				}
+			}
+		}
+
+		lods[lod].indexCount = (uint32_t)indexArray.size() - lods[lod].firstIndex;
+	}
+
+	// The order of the triangles and vertices matters to the GPU, see
+	// MeshOptimizer.cpp. First, triangles that share vertices are put
+	// close together, so the GPU can reuse vertices from its cache. Then
+	// groups of triangles that face outwards are moved to the front, so
+	// they hide what is behind them. Each LOD is optimized by itself,
+	// because each one is drawn by itself. The ACMR and ATVR of
+	// each LOD are printed before and after
+	std::vector<MeshCacheStats> before(mesh_lod_count);
+
+	for (uint32_t lod = 0; lod < mesh_lod_count; lod++)
+	{
+		uint32_t* lodIndices = indexArray.data() + lods[lod].firstIndex;
+		uint32_t lodVertices = ((lod + 1 < mesh_lod_count) ? lodFirstVertex[lod + 1] : (uint32_t)vertexArray.size()) - lodFirstVertex[lod];
+
+		before[lod] = MeshOptimizer::AnalyzeVertexCache(lodIndices, lods[lod].indexCount, lodVertices);
+
+		MeshOptimizer::OptimizeVertexCache(lodIndices, lods[lod].indexCount, vertexArray.size());
+		MeshOptimizer::OptimizeOverdraw(lodIndices, lods[lod].indexCount,
+			vertexArray[0].position, sizeof(VertexStructure));
+	}
+
+	// Then the vertices are put in the order that the triangles use
+	// them, so the GPU reads the vertex buffer in order. The LODs are
+	// one after the other in the index buffer, so the vertices of
+	// each LOD stay together, in the same order as the LODs
+	size_t usedVertices = MeshOptimizer::OptimizeVertexFetch(vertexArray.data(),
+		indexArray.data(), indexArray.size(), vertexArray.size(), sizeof(VertexStructure));
+	vertexArray.resize(usedVertices);
+
+	// Last, each LOD is cut into meshlets, in the order that the
+	// triangles are in now, so each meshlet is a range of the final
+	// index buffer. Their spheres and cones are saved with them, so
+	// loading the mesh does not have to look at the triangles again
+	std::vector<Meshlet> meshlets;
+
+	for (uint32_t lod = 0; lod < mesh_lod_count; lod++)
+	{
+		lods[lod].firstMeshlet = (uint32_t)meshlets.size();
+		MeshOptimizer::BuildMeshlets(indexArray.data() + lods[lod].firstIndex, lods[lod].indexCount,
+			lods[lod].firstIndex, vertexArray[0].position, sizeof(VertexStructure), &meshlets);
+		lods[lod].meshletCount = (uint32_t)meshlets.size() - lods[lod].firstMeshlet;
+	}
+
+	for (uint32_t lod = 0; lod < mesh_lod_count; lod++)
+	{
+		uint32_t lodVertices = ((lod + 1 < mesh_lod_count) ? lodFirstVertex[lod + 1] : (uint32_t)vertexArray.size()) - lodFirstVertex[lod];
+
+		MeshCacheStats after = MeshOptimizer::AnalyzeVertexCache(
+			indexArray.data() + lods[lod].firstIndex, lods[lod].indexCount, lodVertices);
+
+		printf("Mesh LOD %d: %d triangles, %d vertices, %d meshlets, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+			lod, lods[lod].indexCount / 3, lodVertices, lods[lod].meshletCount,
+			before[lod].acmr, after.acmr, before[lod].atvr, after.atvr);
+	}
+
+	// The vertices are stored the way the pipeline reads them,
+	// by default that is the VertexStructure that we just made
+	MeshVertexFormat vertexFormat = MESH_VERTEX_FLOAT;
+	uint32_t vertexStride = sizeof(VertexStructure);
+	void* vertexData = vertexArray.data();
+
+	std::vector<CompactVertexStructure> compactArray;
+
+	if (use_compact_vertices)
+	{
+		// Convert every vertex. Half floats have 11 bits of precision,
+		// which is more than enough for a model near the origin, and
+		// exact for the corners of our cube (-1 and 1).
+		// If a model has UVs that go past 1.0 (repeating
+		// textures), it has to keep float UVs
+		for (size_t i = 0; i < vertexArray.size(); i++)
+		{
+			CompactVertexStructure c;
+			c.position[0] = glm::packHalf1x16(vertexArray[i].position[0]);
+			c.position[1] = glm::packHalf1x16(vertexArray[i].position[1]);
+			c.position[2] = glm::packHalf1x16(vertexArray[i].position[2]);
+			c.position[3] = glm::packHalf1x16(1.0f);
+			c.uv[0] = glm::packUnorm1x16(vertexArray[i].uv[0]);
+			c.uv[1] = glm::packUnorm1x16(vertexArray[i].uv[1]);
+			compactArray.push_back(c);
+		}
+
+		vertexFormat = MESH_VERTEX_COMPACT;
+		vertexStride = sizeof(CompactVertexStructure);
+		vertexData = compactArray.data();
+	}
+
+	// If there are less than 65536 vertices, every index fits in
+	// 16 bits, so the index buffer can be half as big, and the GPU
+	// reads half as many bytes for each index. Bigger models need
+	// 32-bit indices. The value 0xFFFF is skipped, because it can
+	// mean "restart the strip" for some pipelines
+	std::vector<uint16_t> shortIndexArray;
+	void* indexData = indexArray.data();
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+	if (vertexArray.size() < 0xFFFF)
+	{
+		for (size_t i = 0; i < indexArray.size(); i++)
+			shortIndexArray.push_back((uint16_t)indexArray[i]);
+
+		indexData = shortIndexArray.data();
+		indexType = VK_INDEX_TYPE_UINT16;
+	}
+
+	// Put the header, the vertices, and the indices together,
+	// exactly the way that they are stored in the file
+	return MeshFile::Build(
+		vertexFormat,
+		vertexStride,
+		(uint32_t)vertexArray.size(),
+		vertexData,
+		(uint32_t)indexArray.size(),
+		indexType,
+		indexData,
+		mesh_lod_count,
+		lods.data(),
+		(uint32_t)meshlets.size(),
+		meshlets.data());
+}
+
+void Demo::prepare_vb_ib()
+{
+	// If the GPU can read these formats from a vertex buffer
+	// (almost every GPU can), then we can shrink every vertex,
+	// the GPU reads 40% fewer bytes for each vertex
+	if (use_compact_vertices)
+	{
+		VkFormatProperties posProps;
+		VkFormatProperties uvProps;
+		vkGetPhysicalDeviceFormatProperties(gpu, VK_FORMAT_R16G16B16A16_SFLOAT, &posProps);
+		vkGetPhysicalDeviceFormatProperties(gpu, VK_FORMAT_R16G16_UNORM, &uvProps);
+
+		if (!(posProps.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) ||
+			!(uvProps.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT))
+		{
+			use_compact_vertices = false;
+		}
+	}
+
+	// The mesh file already has the vertices and indices in the
+	// layout that the GPU uses, so loading it is only mapping the
+	// file, no parsing, and no copies into temporary arrays.
+	// If the file is not there, or it was saved with the other vertex
+	// format or LOD count, we build the mesh, and save it for next time
+	MeshVertexFormat wantedFormat = use_compact_vertices ? MESH_VERTEX_COMPACT : MESH_VERTEX_FLOAT;
+
+	MeshFile mesh;
+	std::vector<char> builtMesh;
+
+	if (!mesh.Load(MESH_FILE) || mesh.vertexFormat != wantedFormat || mesh.lodCount != mesh_lod_count)
+	{
+		// the old file has to be closed,
+		// before it can be replaced
+		mesh.Close();
+		builtMesh = build_cube_mesh();
+
+		if (!Helper::WriteFile(MESH_FILE, builtMesh.data(), builtMesh.size()))
+			printf("Failed to save the mesh to %s\n", MESH_FILE);
+
+		// the mesh reads its sections from builtMesh, which
+		// lives until the end of this function
+		if (!mesh.Parse(builtMesh.data(), builtMesh.size(), MESH_FILE))
+			ERR_EXIT("Failed to build the cube mesh\n", "Mesh Failure");
+	}
+
+	// Vertex Buffer and Index Buffer
+	//=====================================
+
+	// We do not need to make CPU buffers for the vertices and
+	// indices. The uploader has one CPU buffer (the staging ring)
+	// that is always mapped, and it copies the mesh into it
+	// straight from the mapped file, when we give it to the pool.
+
+	// The pool has one GPU buffer for the vertices of every mesh,
+	// and one for the indices, each designed to be a destination
+	// (TRANSFER_DST) for our data, and a VERTEX_BUFFER or INDEX_BUFFER.
+	// The cube is the only mesh, so the pool is exactly big enough
+	// for it, a scene with more meshes would add their sizes up.
+	// For more information on how this works, look at MeshPool.cpp,
+	// BufferGPU.cpp, and StagingRing.cpp. Learning about them is optional
+
+	// The depth pre-pass only reads positions, so the pool also gets a
+	// buffer with nothing else in it, and every byte that the GPU fetches is
+	// a byte that it uses. The position is at the start of both vertex
+	// formats, and it is copied exactly, so both passes get the same depth
+	position_stride = use_compact_vertices ? sizeof(CompactVertexStructure::position) : sizeof(VertexStructure::position);
+
+	// These indices will determine which vertices
+	// to connect for each triangle. It will connect
+	// the first three indices into a triangle, and 
+	// then the next three, and so on. They are 16-bit
+	// if the mesh has few enough vertices, see build_cube_mesh
+	// With vertex pulling, the vertex shader reads the
+	// vertex buffer through its address, see cube_pull.vert
+	VkBufferUsageFlags pullUsage = use_vertex_pulling ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_EXT : 0;
+
+	// the skinning shader writes the vertices and the positions
+	if (use_compute_skinning)
+		pullUsage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	// with occlusion queries, the box of the mesh is in the pool too
+	uint32_t boxVertices = use_occlusion_queries ? 8 : 0;
+	uint32_t boxIndices = use_occlusion_queries ? 36 : 0;
+
+	// The generated meshes are copies of the cube, with all of its LODs.
+	// Meshlets and instancing draw the cube of every object in their own
+	// way, so with them, every object is the cube (mesh 0)
+	uint32_t sceneMeshes = 0;
+
+	if (use_scene_generator)
+	{
+		sceneMeshes = scene_generator->params.meshCount - 1;
+
+		if (sceneMeshes > 0 && (use_meshlets || use_instancing))
+		{
+			printf("The generated meshes are not drawn with meshlets or instancing, every object is the cube\n");
+			sceneMeshes = 0;
+		}
+	}
+
+	// The instanced and meshlet draws replace the whole scene, and vertex
+	// pulling and GPU animation have shaders of their own, so the voxel
+	// world is only drawn with the plain cube pipeline
+	uint32_t voxelVertices = 0;
+	uint32_t voxelIndices = 0;
+
+	if (voxel_world != nullptr && (use_meshlets || use_instancing || use_vertex_pulling || use_gpu_animation))
+	{
+		printf("The voxel world is not drawn with meshlets, instancing, vertex pulling or GPU animation, it is disabled\n");
+		delete voxel_world;
+		voxel_world = nullptr;
+		use_voxel_world = false;
+	}
+
+	if (voxel_world != nullptr)
+	{
+		voxelVertices = voxel_world->GetVertexCapacity();
+		voxelIndices = voxel_world->GetIndexCapacity();
+	}
+
+	mesh_pool = new MeshPool(device, allocator, mesh.vertexStride,
+		(use_depth_prepass || use_shadow_cache || use_gpu_picking) ? position_stride : 0, mesh.indexType,
+		mesh.vertexCount * (1 + sceneMeshes) + boxVertices + voxelVertices,
+		mesh.indexCount * (1 + sceneMeshes) + boxIndices + voxelIndices, pullUsage);
+
+	// The data will finally be copied from CPU to GPU when we
+	// submit the uploader (later in prepare), and it will be
+	// read by the VERTEX_INPUT stage
+	cube_mesh = mesh_pool->Add(uploader, mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount);
+
+	// the first generated mesh is the cube itself, the
+	// indices of the others are the same as the cube's
+	if (use_scene_generator)
+	{
+		scene_meshes.assign(1, cube_mesh);
+		std::vector<char> vertices;
+
+		for (uint32_t m = 1; m <= sceneMeshes; m++)
+		{
+			scene_generator->BuildMesh(m, mesh, &vertices);
+			scene_meshes.push_back(mesh_pool->Add(uploader, vertices.data(), mesh.vertexCount, mesh.indices, mesh.indexCount));
+		}
+	}
+
+	if (use_occlusion_queries)
+		prepare_occlusion_box(mesh);
+
+	if (use_compute_skinning)
+		prepare_skinning(mesh);
+
+	if (voxel_world != nullptr)
+		prepare_voxel_world();
+
+	// The LODs in the file count from the first index of the mesh,
+	// the draws count from the first index of the pool
+	mesh_lods.assign(mesh.lods, mesh.lods + mesh.lodCount);
+
+	for (MeshLod& lod : mesh_lods)
+		lod.firstIndex += cube_mesh.firstIndex;
+
+	// the meshlets are ranges of the same indices
+	mesh_meshlets.assign(mesh.meshlets, mesh.meshlets + mesh.meshletCount);
+
+	for (Meshlet& meshlet : mesh_meshlets)
+		meshlet.firstIndex += cube_mesh.firstIndex;
+
+	// The address never changes, because the pool's buffer is never
+	// made again, so it is pushed as it is in every command buffer.
+	// Both vertex formats are a whole number of 32-bit words
+	vertex_pull_constants = {};
+
+	if (use_vertex_pulling)
+	{
+		VkBufferDeviceAddressInfoEXT addressInfo = {};
+		addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_EXT;
+		addressInfo.buffer = mesh_pool->vertexBuffer.buffer;
+
+		vertex_pull_constants.vertices = fpGetBufferDeviceAddressEXT(device, &addressInfo);
+		vertex_pull_constants.vertexWords = mesh.vertexStride / sizeof(uint32_t);
+		vertex_pull_constants.compact = use_compact_vertices ? 1 : 0;
+	}
+}
+
+void Demo::prepare_skinning(const MeshFile& mesh)
+{
+	// The weights of every vertex come from its height: the bottom of the
+	// cube only follows bone 0, the top only follows bone 1, and the
+	// vertices in between follow both, more of bone 1 the higher they
+	// are. The position is at the start of both vertex formats
+	std::vector<uint32_t> skin((size_t)mesh.vertexCount * 2);
+
+	for (uint32_t i = 0; i < mesh.vertexCount; i++)
+	{
+		const char* vertex = mesh.vertices + (size_t)i * mesh.vertexStride;
+		float y;
+
+		if (mesh.vertexFormat == MESH_VERTEX_COMPACT)
+		{
+			uint16_t half[2];
+			memcpy(half, vertex, sizeof(half));
+			y = glm::unpackHalf1x16(half[1]);
+		}
+		else
+			memcpy(&y, vertex + sizeof(float), sizeof(y));
+
+		float t = glm::clamp((y + 1.0f) * 0.5f, 0.0f, 1.0f);
+		uint32_t top = (uint32_t)(t * t * (3.0f - 2.0f * t) * 255.0f + 0.5f);
+
+		// bone 0 and bone 1, the other two have no weight
+		skin[i * 2] = (1u << 8);
+		skin[i * 2 + 1] = (255u - top) | (top << 8);
+	}
+
+	uint32_t positionStride = (use_depth_prepass || use_shadow_cache || use_gpu_picking) ? position_stride : 0;
+
+	skinning_pass = new SkinningPass(device, allocator, uploader, mesh_pool, cube_mesh,
+		mesh.vertices, mesh.vertexStride, positionStride, mesh.vertexFormat == MESH_VERTEX_COMPACT, skin.data());
+}
+
+void Demo::prepare_occlusion_box(const MeshFile& mesh)
+{
+	// The bounding box of the mesh, from the position at the start of
+	// every vertex, which is 3 floats, or 4 half floats when compact
+	glm::vec3 boxMin(FLT_MAX);
+	glm::vec3 boxMax(-FLT_MAX);
+
+	for (uint32_t i = 0; i < mesh.vertexCount; i++)
+	{
+		const char* vertex = mesh.vertices + (size_t)i * mesh.vertexStride;
+		glm::vec3 p;
+
+		if (mesh.vertexFormat == MESH_VERTEX_COMPACT)
+		{
+			uint16_t half[3];
+			memcpy(half, vertex, sizeof(half));
+			p = glm::vec3(glm::unpackHalf1x16(half[0]), glm::unpackHalf1x16(half[1]), glm::unpackHalf1x16(half[2]));
+		}
+		else
+			memcpy(&p, vertex, sizeof(p));
+
+		boxMin = glm::min(boxMin, p);
+		boxMax = glm::max(boxMax, p);
+	}
+
+	// The faces of the box are on the faces of the cube, and the same
+	// plane made of other triangles can round to a slightly different
+	// depth, so the box is a little bigger, to never be behind the cube
+	glm::vec3 margin = (boxMax - boxMin) * 0.01f + glm::vec3(0.001f);
+	boxMin -= margin;
+	boxMax += margin;
+
+	// The 8 corners, in the vertex format of the pool. Bit 0 of the
+	// corner picks x, bit 1 picks y, and bit 2 picks z. Nothing but
+	// the position is read, so the rest of each vertex stays 0
+	std::vector<char> vertices(8 * mesh.vertexStride, 0);
+
+	for (uint32_t c = 0; c < 8; c++)
+	{
+		glm::vec3 p((c & 1) ? boxMax.x : boxMin.x, (c & 2) ? boxMax.y : boxMin.y, (c & 4) ? boxMax.z : boxMin.z);
+		char* vertex = vertices.data() + c * mesh.vertexStride;
+
+		if (mesh.vertexFormat == MESH_VERTEX_COMPACT)
+		{
+			uint16_t half[4] = { glm::packHalf1x16(p.x), glm::packHalf1x16(p.y), glm::packHalf1x16(p.z), glm::packHalf1x16(1.0f) };
+			memcpy(vertex, half, sizeof(half));
+		}
+		else
+			memcpy(vertex, &p, sizeof(p));
+	}
+
+	// two triangles on each side, the box pipeline does not
+	// cull back faces, so the winding does not matter
+	const uint32_t boxIndices[36] =
+	{
+		0, 2, 6, 0, 6, 4,
+		1, 5, 7, 1, 7, 3,
+		0, 4, 5, 0, 5, 1,
+		2, 3, 7, 2, 7, 6,
+		0, 1, 3, 0, 3, 2,
+		4, 6, 7, 4, 7, 5
+	};
+
+	// the pool has one index type for every mesh
+	uint16_t shortIndices[36];
+
+	for (uint32_t i = 0; i < 36; i++)
+		shortIndices[i] = (uint16_t)boxIndices[i];
+
+	const void* indices = boxIndices;
+
+	if (mesh.indexType == VK_INDEX_TYPE_UINT16)
+		indices = shortIndices;
+
+	occlusion_box = mesh_pool->Add(uploader, vertices.data(), 8, indices, 36);
+}
+
+void Demo::prepare_scene()
+{
+	// Every cube in the scene uses the same vertex buffer and
+	// index buffer, the only difference is where the cube is.
+	// We put the cubes in a square grid, with the first cube
+	// in the middle of the front row, and 3 units between cubes
+	object_transforms.Resize(scene_object_count);
+	object_mvps.resize(scene_object_count);
+	object_lods.resize(scene_object_count, 0);
+
+	// every cube is drawn without a condition until it has
+	// been seen, see update_occlusion_queries
+	if (use_occlusion_queries)
+	{
+		object_in_view.resize(scene_object_count, 0);
+		object_conditional.resize(scene_object_count, 0);
+		occlusion_visible.resize(scene_object_count);
+	}
+
+	uint32_t side = (uint32_t)ceil(sqrt((double)scene_object_count));
+
+	for (uint32_t i = 0; i < scene_object_count && !use_scene_generator; i++)
+	{
+		float x = ((float)(i % side) - (float)(side - 1) / 2.0f) * 3.0f;
+		float z = -(float)(i / side) * 3.0f;
+
+		object_transforms.SetPosition(i, glm::vec3(x, 0.0f, z));
+	}
+
+	// the generated scene has its own places, in a box, and
+	// a snapshot of it has every transform, as ten arrays
+	if (use_scene_generator)
+	{
+		if (scene_snapshot != nullptr)
+			object_transforms.Load(scene_snapshot->objectTransforms, scene_object_count);
+
+		for (uint32_t i = 0; i < scene_object_count && scene_snapshot == nullptr; i++)
+			object_transforms.SetPosition(i, scene_generator->positions[i]);
+
+		printf("Generated scene: %u objects, %u meshes, %u textures, %u animated\n",
+			scene_object_count, (uint32_t)scene_meshes.size(),
+			scene_generator->params.textureCount, (uint32_t)scene_generator->animated.size());
+	}
+
+	if (!use_meshlets)
+		return;
+
+	// Each cube can have at most one draw for each meshlet of the
+	// LOD with the most meshlets, and every frame in flight has its
+	// own slice of draws, which the CPU writes while the GPU reads
+	// the slices of the other frames, like the uniform buffer
+	meshlet_slice_draws = 0;
+
+	for (const MeshLod& lod : mesh_lods)
+		meshlet_slice_draws = std::max(meshlet_slice_draws, lod.meshletCount * scene_object_count);
+
+	object_models.resize(scene_object_count);
+	object_meshlet_first.resize(scene_object_count, 0);
+	object_meshlet_count.resize(scene_object_count, 0);
+	meshlet_draws.reserve(meshlet_slice_draws);
+
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+	info.size = (VkDeviceSize)meshlet_slice_draws * sizeof(VkDrawIndexedIndirectCommand) * frame_lag;
+
+	meshlet_draws_cpu = BufferCPU(device, allocator, info, true);
+	meshlet_draws_cpu.SetName("Meshlet draws");
+}
+
+void Demo::prepare_instances()
+{
+	// without instancing, there is no instance buffer,
+	// and both instance buffers stay empty
+	instance_transforms = nullptr;
+	instance_hierarchy = nullptr;
+	instance_spin_first = 0;
+
+	// The corner of a cube is sqrt(3) away from the middle,
+	// select_lod uses this to know how big the cube is
+	lod_object_radius = 1.7320508f;
+
+	if (!use_instancing)
+		return;
+
+	// With dynamic instances, the store keeps track of which
+	// matrices each slice of the instance buffer is missing. With
+	// CPU culling, the visible matrices are copied every frame,
+	// so the slices do not need to be tracked
+	// With instance deltas, there is only one copy of the
+	// instances, so the store only tracks that one
+	bool trackSlices = use_dynamic_instances && !use_cpu_culling;
+	uint32_t sliceCount = use_instance_deltas ? 1 : frame_lag;
+	instance_transforms = new TransformStore(instance_count, trackSlices ? sliceCount : 0);
+
+	// every instance is visible, until the first frame is culled
+	visible_instances.resize(instance_count);
+	visible_instance_count = instance_count;
+
+	// We pack all of the instances into a block that is the
+	// same size as the original cube, so that 100,000 cubes still
+	// fit on the screen. Each instance has a model matrix, which
+	// moves the small cube to its place in the block, and makes
+	// it smaller, see cube_instanced.vert
+	uint32_t side = (uint32_t)ceil(cbrt((double)instance_count));
+	float cell = 2.0f / (float)side;
+
+	// A snapshot with the same number of instances already has all of
+	// their transforms and matrices, which are loaded as they are. The
+	// hierarchy has nodes that are not in the file, so it is made again
+	bool fromSnapshot = (scene_snapshot != nullptr && scene_snapshot->instanceCount == instance_count && !use_instance_hierarchy);
+
+	if (fromSnapshot)
+		instance_transforms->Load(scene_snapshot->instanceTransforms, scene_snapshot->instanceModels);
+
+	// The hierarchy is added breadth first: the root (the whole block),
+	// then one node for each layer (every instance with the same z),
+	// then the instances, which are the children of their layer
+	if (use_instance_hierarchy)
+	{
+		instance_hierarchy = new TransformHierarchy(job_system, instance_transforms);
+		uint32_t root = instance_hierarchy->Add(HIERARCHY_NONE, glm::vec3(0.0f), glm::quat(), glm::vec3(1.0f), HIERARCHY_NONE);
+
+		for (uint32_t z = 0; z < side; z++)
+		{
+			glm::vec3 layerPosition(0.0f, 0.0f, -1.0f + cell * ((float)z + 0.5f));
+			instance_hierarchy->Add(root, layerPosition, glm::quat(), glm::vec3(1.0f), HIERARCHY_NONE);
+		}
+	}
+
+	for (uint32_t i = 0; i < instance_count && !fromSnapshot; i++)
+	{
+		uint32_t x = i % side;
+		uint32_t y = (i / side) % side;
+		uint32_t z = i / (side * side);
+
+		// the middle of each cell in the block,
+		// and half of the cell is empty space
+		glm::vec3 position;
+		position.x = -1.0f + cell * ((float)x + 0.5f);
+		position.y = -1.0f + cell * ((float)y + 0.5f);
+		position.z = -1.0f + cell * ((float)z + 0.5f);
+
+		// an instance of the hierarchy is in the middle of its layer
+		if (use_instance_hierarchy)
+		{
+			glm::vec3 localPosition(position.x, position.y, 0.0f);
+			instance_hierarchy->Add(1 + z, localPosition, glm::quat(), glm::vec3(cell * 0.25f), i);
+			continue;
+		}
+
+		instance_transforms->SetPosition(i, position);
+		instance_transforms->SetScale(i, glm::vec3(cell * 0.25f));
+	}
+
+	// the hierarchy gives the world transforms to the store
+	if (use_instance_hierarchy)
+		instance_hierarchy->Update();
+
+	// every instance is dirty, so this makes all of the matrices
+	if (!fromSnapshot)
+		instance_transforms->Update();
+
+	// the small cubes are all the same size, and the
+	// LOD of a block is the LOD of one of its small cubes
+	lod_object_radius *= cell * 0.25f;
+
+	uint32_t instanceArraySize = instance_count * sizeof(glm::mat4);
+
+	// This is made exactly like the vertex buffer, in prepare_vb_ib,
+	// because the GPU reads it the same way as a vertex buffer,
+	// but it moves forward once per instance, not once per vertex
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.size = instanceArraySize;
+
+	// the culling shader also reads this buffer, as a storage buffer
+	VkAccessFlags access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	VkPipelineStageFlags stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+
+	if (use_gpu_culling)
+	{
+		info.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		access |= VK_ACCESS_SHADER_READ_BIT;
+		stage |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	}
+
+	// the scatter shader writes the matrices that changed
+	if (use_instance_deltas)
+	{
+		info.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		access |= VK_ACCESS_SHADER_WRITE_BIT;
+		stage |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	}
+
+	// with async compute, the compute queue reads it too
+	if (use_async_compute)
+	{
+		info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		info.queueFamilyIndexCount = (uint32_t)async_compute_families.size();
+		info.pQueueFamilyIndices = async_compute_families.data();
+	}
+
+	// Dynamic instances are in a CPU buffer that stays mapped, with one
+	// slice for each frame in flight, like the uniform buffer. The GPU
+	// reads it directly, so there is no copy, and each slice starts
+	// with every matrix, after that it only gets the ones that changed
+	if (use_dynamic_instances && !use_instance_deltas)
+	{
+		info.usage &= ~VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		info.size = (VkDeviceSize)instanceArraySize * frame_lag;
+
+		instanceDataCPU = BufferCPU(device, allocator, info, true, use_device_local_host_buffers);
+		instanceDataCPU.SetName("Dynamic instance buffer");
+
+		for (uint32_t i = 0; i < frame_lag && trackSlices; i++)
+			instance_transforms->Write(i, (glm::mat4*)instanceDataCPU.GetPointer() + i * instance_count);
+
+		return;
+	}
+
+	instanceDataGPU = BufferGPU(device, allocator, info);
+	instanceDataGPU.SetName("Instance buffer");
+	// the staging ring copies the matrices right out of the mapped file
+	void* models = fromSnapshot ? (void*)scene_snapshot->instanceModels : (void*)instance_transforms->GetModels();
+	uploader->UploadBuffer(&instanceDataGPU, models, instanceArraySize, access, stage);
+
+	// The upload has every matrix, so after this, the
+	// deltas only have the instances that move
+	if (use_instance_deltas)
+	{
+		instance_transforms->MarkWritten(0);
+		instance_scatter = new InstanceScatter(device, allocator, instanceDataGPU.buffer, frame_lag);
+		return;
+	}
+
+	if (use_gpu_animation)
+		prepare_animation();
+}
+
+void Demo::save_scene_snapshot()
+{
+	// The arrays of a snapshot that was loaded are all copied by now,
+	// and the instances are in the staging ring, so the file is closed
+	if (scene_snapshot != nullptr)
+	{
+		delete scene_snapshot;
+		scene_snapshot = nullptr;
+		return;
+	}
+
+	// The rotations are still the ones that the objects start with,
+	// nothing has spun yet. Without instancing, there are no instances
+	std::vector<char> bytes = SceneFile::Build(&object_transforms,
+		scene_generator->meshes.data(), scene_generator->textures.data(),
+		(uint32_t)scene_generator->animated.size(), scene_generator->animated.data(),
+		scene_generator->params.meshCount, scene_generator->meshScales.data(),
+		scene_generator->params.textureCount, scene_generator->params.seed, instance_transforms);
+
+	if (Helper::WriteFile(scene_snapshot_path, bytes.data(), bytes.size()))
+		printf("Saved the scene snapshot %s, %zu bytes\n", scene_snapshot_path, bytes.size());
+}
+
+void Demo::prepare_animation()
+{
+	// Every instance gets an axis, and a speed from 1 to 2 radians
+	// per second (about what the cube turned at 60 frames per second),
+	// and half of them turn the other way. They come from a hash of the
+	// index, so they look random, but they are the same every time
+	std::vector<glm::vec4> animations(instance_count);
+
+	for (uint32_t i = 0; i < instance_count; i++)
+	{
+		uint32_t hash = (i + 1) * 2654435761u;
+		glm::vec3 axis;
+		axis.x = (float)((hash >> 0) & 0xFF) / 255.0f - 0.5f;
+		axis.y = (float)((hash >> 8) & 0xFF) / 255.0f - 0.5f;
+		axis.z = (float)((hash >> 16) & 0xFF) / 255.0f - 0.5f;
+
+		// an axis that is too short has no direction
+		if (glm::length(axis) < 0.01f)
+			axis = glm::vec3(0.0f, 1.0f, 0.0f);
+
+		float speed = 1.0f + (float)((hash >> 24) & 0x7F) / 127.0f;
+
+		if (hash & 0x80000000)
+			speed = -speed;
+
+		animations[i] = glm::vec4(glm::normalize(axis), speed);
+	}
+
+	// the GPU reads it like the instance buffer, once per instance
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.size = instance_count * sizeof(glm::vec4);
+
+	animationDataGPU = BufferGPU(device, allocator, info);
+	animationDataGPU.SetName("Animation buffer");
+	uploader->UploadBuffer(&animationDataGPU, animations.data(), (uint32_t)info.size,
+		VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
+
+// Moves the instances forward by one frame, or by one step of
+// the fixed timestep, which is the number that picks what moves
+void Demo::move_instances(uint64_t step)
+{
+	// With the hierarchy, one layer turns a little bit every frame.
+	// Only the layer node changes, and the hierarchy gives the new
+	// transform of the layer to all of its instances
+	if (use_instance_hierarchy)
+	{
+		uint32_t layerCount = instance_hierarchy->GetCount() - instance_count - 1;
+		uint32_t layer = 1 + (uint32_t)(step % layerCount);
+
+		glm::quat turn = glm::angleAxis(0.1f, glm::vec3(0.0f, 0.0f, 1.0f));
+		instance_hierarchy->SetLocalRotation(layer, instance_hierarchy->GetLocalRotation(layer) * turn);
+	}
+
+	// Otherwise, a band of DYNAMIC_INSTANCES_PER_FRAME instances
+	// spins a little bit every frame, and the band moves forward,
+	// so at any time, most of the instances are not moving
+	else
+	{
+		glm::quat spin = glm::angleAxis(0.1f, glm::vec3(0.0f, 1.0f, 0.0f));
+		uint32_t count = (instance_count < DYNAMIC_INSTANCES_PER_FRAME) ? instance_count : DYNAMIC_INSTANCES_PER_FRAME;
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t index = (instance_spin_first + i) % instance_count;
+			instance_transforms->SetRotation(index, instance_transforms->GetRotation(index) * spin);
+		}
+
+		instance_spin_first = (instance_spin_first + count / 4) % instance_count;
+	}
+}
+
+void Demo::update_instances()
+{
+	// With the fixed timestep, the instances were already
+	// moved by the steps of this frame, in step_simulation
+	if (!use_fixed_timestep && !animation_paused)
+		move_instances(frame_count);
+
+	// the layers that turned give their
+	// transform to all of their instances
+	if (use_instance_hierarchy)
+		instance_hierarchy->Update();
+
+	// Only the instances that changed get a new matrix, and
+	// this frame's slice only gets the matrices that it is
+	// missing, which includes the ones from the frames before,
+	// that were written to the other slices
+	instance_transforms->Update();
+
+	// With instance deltas, the matrices that changed go into the
+	// ring, and record_cmd copies them into the instance buffer
+	if (use_instance_deltas)
+	{
+		instance_scatter->Write(frame_index, instance_transforms);
+		return;
+	}
+
+	glm::mat4* slice = (glm::mat4*)instanceDataCPU.GetPointer() + frame_index * instance_count;
+
+	// The planes come from the MVP of the first cube, so they are in
+	// the space of the instances, like in the GPU culling pass. Only
+	// the visible matrices go into the slice, one after the other
+	if (use_cpu_culling)
+	{
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(object_mvps[0], planes);
+
+		visible_instance_count = CullSpheres(instance_transforms->GetTransforms(), planes, 1.7320508f, visible_instances.data());
+		instance_transforms->Gather(visible_instances.data(), visible_instance_count, slice);
+		return;
+	}
+
+	instance_transforms->Write(frame_index, slice);
+}
+
+uint32_t Demo::select_lod(uint32_t object)
+{
+	// Find how far the middle of the cube is in front of the camera
+	glm::vec4 center = view_matrix * glm::vec4(object_transforms.GetPosition(object), 1.0f);
+	float distance = -center.z;
+
+	// if the camera is inside of the cube, use the most detail
+	if (distance <= lod_object_radius)
+		return 0;
+
+	// The projection matrix turns the "height" of a distance into a part of
+	// the screen, where 1 is the top and -1 is the bottom, so an object that
+	// is radius tall (from its middle to its top) covers this much of the
+	// screen, 1.0 is the whole height of the screen
+	float screenHeight = lod_object_radius * fabsf(projection_matrix[1][1]) / distance;
+
+	// the LODs go from the most detail to the least, so
+	// the first LOD that the object is big enough for is used
+	for (uint32_t i = 0; i < (uint32_t)mesh_lods.size(); i++)
+	{
+		if (screenHeight >= mesh_lods[i].minScreenHeight)
+			return i;
+	}
+
+	return (uint32_t)mesh_lods.size() - 1;
+}
+
+VkExtent2D Demo::select_shading_rate(uint32_t lod)
+{
+	// The LOD already says how big the cube is on the screen. The
+	// most detailed LOD is shaded at every pixel, the least detailed
+	// one (the cubes that are far away) 4x4, and the ones in between
+	// 2x2. A GPU that can not do a rate uses the closest smaller one
+	VkExtent2D rate = { 1, 1 };
+	uint32_t last = (uint32_t)mesh_lods.size() - 1;
+
+	if (lod > 0 && lod == last)
+		rate = { 4, 4 };
+	else if (lod > 0)
+		rate = { 2, 2 };
+
+	return rate;
+}
+
+void Demo::request_texture_levels()
+{
+	// This is the same idea as select_lod. One face of a cube is 2
+	// units wide, and the whole texture is on each face, so the face
+	// of the closest cube is this many pixels wide on the screen.
+	// The level where one texel covers one pixel is the one we need,
+	// every level is half the size of the level before it
+	float closest = FLT_MAX;
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		glm::vec4 center = view_matrix * glm::vec4(object_transforms.GetPosition(i), 1.0f);
+		closest = (-center.z < closest) ? -center.z : closest;
+	}
+
+	uint32_t level = 0;
+	uint32_t tex_width = texture_streamer->GetExtent(0).width;
+
+	if (closest > lod_object_radius)
+	{
+		float facePixels = fabsf(projection_matrix[1][1]) * render_height / closest;
+
+		while (level < 15 && (tex_width >> (level + 1)) >= facePixels)
+			level++;
+	}
+
+	texture_streamer->Request(0, level, frame_count);
+}
+
+void Demo::update_streamed_descriptors(uint32_t slot)
+{
+	// the texture of this frame, from the streamer
+	textureGPU = texture_streamer->GetTexture(0);
+	descriptor_data[slot].texture.imageView = texture_streamer->GetView(0);
+	write_frame_descriptors(slot, texture_streamer->generation);
+}
+
+void Demo::write_frame_descriptors(uint32_t slot, uint32_t generation)
+{
+	// push descriptors are written from descriptor_data every frame
+	if (use_push_descriptors || streamed_set_generations[slot] == generation)
+		return;
+
+	// The last frame of this frame_index is done on the GPU, so its
+	// set can be written. The uniform buffer has the same descriptor as
+	// descriptor_set, the slice is picked with a dynamic offset
+	if (update_template_enabled)
+		fpUpdateDescriptorSetWithTemplateKHR(device, streamed_sets[slot], descriptor_template, &descriptor_data[slot]);
+	else
+	{
+		VkWriteDescriptorSet writes[2] = {};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].descriptorCount = 1;
+		writes[0].dstSet = streamed_sets[slot];
+		writes[0].dstBinding = 0;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		writes[0].pBufferInfo = &descriptor_data[slot].uniformBuffer;
+
+		writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].descriptorCount = 1;
+		writes[1].dstSet = streamed_sets[slot];
+		writes[1].dstBinding = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[1].pImageInfo = &descriptor_data[slot].texture;
+
+		DeviceTable::UpdateDescriptorSets(device, 2, writes, 0, NULL);
+	}
+
+	streamed_set_generations[slot] = generation;
+}
+
+VkFormat Demo::select_depth_format()
+{
+	// Not every GPU can use every depth format as a depth attachment,
+	// the only ones that Vulkan promises are D16_UNORM, and one of
+	// X8_D24 or D32_SFLOAT. We make a list of the formats that we want,
+	// in the order that we want them, and pick the first one that works.
+	
+	// By default, smaller is better, every pixel of the depth
+	// buffer is read and written many times per frame.
+	// We do not use stencil, so the stencil formats come last
+	VkFormat compact[] =
+	{
+		VK_FORMAT_D16_UNORM,
+		VK_FORMAT_X8_D24_UNORM_PACK32,
+		VK_FORMAT_D32_SFLOAT,
+		VK_FORMAT_D16_UNORM_S8_UINT,
+		VK_FORMAT_D24_UNORM_S8_UINT,
+		VK_FORMAT_D32_SFLOAT_S8_UINT
+	};
+
+	// If more precision was asked for, we try the 32-bit formats
+	// first, then 24-bit, and only use 16-bit if nothing else works
+	VkFormat precise[] =
+	{
+		VK_FORMAT_D32_SFLOAT,
+		VK_FORMAT_D32_SFLOAT_S8_UINT,
+		VK_FORMAT_X8_D24_UNORM_PACK32,
+		VK_FORMAT_D24_UNORM_S8_UINT,
+		VK_FORMAT_D16_UNORM,
+		VK_FORMAT_D16_UNORM_S8_UINT
+	};
+
+	VkFormat* candidates = depth_high_precision ? precise : compact;
+	uint32_t count = depth_high_precision ? ARRAY_SIZE(precise) : ARRAY_SIZE(compact);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		// The depth buffer uses optimal tiling, so we
+		// check the features of optimally-tiled images
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(gpu, candidates[i], &props);
+
+		if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			return candidates[i];
+	}
+
+	// This should never happen, D16_UNORM is always supported
+	ERR_EXIT("No depth format can be used as a depth attachment\n", "Depth Format Failure");
+	return VK_FORMAT_D16_UNORM;
+}
+
+VkSampleCountFlagBits Demo::select_msaa_samples()
+{
+	// The color and the depth attachments must have the same number
+	// of samples, so we need a count that both of them support.
+	// If the GPU can not do msaa_samples, we use the next lower count
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(gpu, &props);
+
+	VkSampleCountFlags supported =
+		props.limits.framebufferColorSampleCounts &
+		props.limits.framebufferDepthSampleCounts;
+
+	for (uint32_t samples = msaa_samples; samples > 1; samples /= 2)
+	{
+		if (supported & samples)
+			return (VkSampleCountFlagBits)samples;
+	}
+
+	return VK_SAMPLE_COUNT_1_BIT;
+}
+
+void Demo::prepare_msaa_target()
+{
+	msaaColorGPU = nullptr;
+
+	if (msaa_sample_count == VK_SAMPLE_COUNT_1_BIT)
+		return;
+
+	// This is the image that the scene is really drawn into, with
+	// MSAA. Only the resolved image (the swapchain image) is kept
+	// after the subpass, so this one is TRANSIENT, and it gets
+	// LAZILY_ALLOCATED memory when the GPU has it, see TextureGPU.cpp.
+	// On a tiled GPU, the samples never leave the tile memory
+	VkImageCreateInfo image = {};
+	image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image.imageType = VK_IMAGE_TYPE_2D;
+	image.format = format;
+	image.extent.width = width;
+	image.extent.height = height;
+	image.extent.depth = 1;
+	image.mipLevels = 1;
+	image.arrayLayers = 1;
+	image.samples = msaa_sample_count;
+	image.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+	// it is resolved at the end of the render pass
+	msaaColorGPU = transient_pool->Add(image, VK_IMAGE_ASPECT_COLOR_BIT,
+		FRAME_PHASE_RENDER_PASS, FRAME_PHASE_RENDER_PASS, "MSAA color");
+
+	msaaColorGPU->format = format;
+}
+
+void Demo::prepare_scene_color()
+{
+	sceneColorGPU = nullptr;
+
+	if (!use_post_subpass)
+		return;
+
+	// This is the image that the scene is drawn into, before the
+	// post subpass grades it. It is only read by the post subpass, as
+	// an input attachment, at the same pixel, so it never has to leave
+	// the tile memory, and it is TRANSIENT, like the MSAA color
+	VkImageCreateInfo image = {};
+	image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image.imageType = VK_IMAGE_TYPE_2D;
+	image.format = POST_SCENE_FORMAT;
+	image.extent.width = width;
+	image.extent.height = height;
+	image.extent.depth = 1;
+	image.mipLevels = 1;
+	image.arrayLayers = 1;
+	image.samples = VK_SAMPLE_COUNT_1_BIT;
+	image.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+	sceneColorGPU = transient_pool->Add(image, VK_IMAGE_ASPECT_COLOR_BIT,
+		FRAME_PHASE_RENDER_PASS, FRAME_PHASE_RENDER_PASS, "Scene color");
+
+	sceneColorGPU->format = POST_SCENE_FORMAT;
+}
+
+void Demo::prepare_offscreen_target()
+{
+	offscreenColorGPU = nullptr;
+
+	// the whole window is drawn, until update_render_size changes it
+	render_width = width;
+	render_height = height;
+
+	if (!use_offscreen_target)
+		return;
+
+	// The controller is made once, and it keeps its scale when the
+	// window is resized. The target is a little under 1/60 of a second,
+	// so a 60 Hz monitor still gets every frame when the CPU is a little
+	// late, and the image is never drawn at less than half of the size
+	if (firstInit && use_dynamic_resolution)
+		dynamic_resolution = new DynamicResolution(15.0, 0.5f, frame_lag);
+
+	// This is where the scene is drawn (or resolved, with MSAA),
+	// instead of the swapchain image. It always has the size of the
+	// window, the biggest that render_width and render_height can be,
+	// so changing the resolution never makes a new image, it only
+	// changes how much of this image is used. It is the source of
+	// the blit afterwards, so it is not TRANSIENT
+	VkImageCreateInfo image = {};
+	image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image.imageType = VK_IMAGE_TYPE_2D;
+	image.format = format;
+	image.extent.width = width;
+	image.extent.height = height;
+	image.extent.depth = 1;
+	image.mipLevels = 1;
+	image.arrayLayers = 1;
+	image.samples = VK_SAMPLE_COUNT_1_BIT;
+	image.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	// the temporal upscaler reads it in a compute shader
+	if (use_temporal_upscale)
+		image.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	// it is drawn in the render pass, and read by the upscale
+	offscreenColorGPU = transient_pool->Add(image, VK_IMAGE_ASPECT_COLOR_BIT,
+		FRAME_PHASE_RENDER_PASS, FRAME_PHASE_UPSCALE, "Offscreen color");
+
+	offscreenColorGPU->format = format;
+
+	// Without dynamic resolution, the temporal upscaler always
+	// draws the same part of the window, update_render_size
+	// picks the size with it
+	if (use_temporal_upscale && !use_dynamic_resolution)
+	{
+		render_width = (uint32_t)(width * temporal_render_scale + 0.5f);
+		render_height = (uint32_t)(height * temporal_render_scale + 0.5f);
+
+		render_width = (render_width < 1) ? 1 : render_width;
+		render_height = (render_height < 1) ? 1 : render_height;
+	}
+}
+
+void Demo::update_render_size()
+{
+	// The GPU timer tells us when it has the time of another frame,
+	// and only then does the controller look at it
+	uint64_t measured = gpu_timer->GetMeasuredFrames();
+
+	if (measured != dynamic_resolution_frames)
+	{
+		dynamic_resolution_frames = measured;
+		dynamic_resolution->Update(gpu_timer->GetLastFrameMs());
+	}
+
+	// Both sides are scaled the same way, so
+	// the aspect ratio of the projection stays correct
+	render_width = (uint32_t)(width * dynamic_resolution->scale + 0.5f);
+	render_height = (uint32_t)(height * dynamic_resolution->scale + 0.5f);
+
+	render_width = (render_width < 1) ? 1 : (render_width > (uint32_t)width) ? (uint32_t)width : render_width;
+	render_height = (render_height < 1) ? 1 : (render_height > (uint32_t)height) ? (uint32_t)height : render_height;
+}
+
+void Demo::record_upscale(VkCommandBuffer cmd, uint32_t image)
+{
+	// The render pass already made the offscreen image TRANSFER_SRC,
+	// and the frame graph waited for the draws, and made the swapchain
+	// image TRANSFER_DST, in one barrier (see record_cmd). LINEAR
+	// filtering blends the pixels, when the part of the image that was
+	// drawn is scaled up to the whole swapchain image
+	// With temporal upscaling, the history that was just written is
+	// copied instead, it already has the size of the window
+	VkImage source = offscreenColorGPU->image;
+	uint32_t sourceWidth = render_width;
+	uint32_t sourceHeight = render_height;
+
+	if (use_temporal_upscale)
+	{
+		source = temporal_history->images[temporal_history->current]->image;
+		sourceWidth = width;
+		sourceHeight = height;
+	}
+
+	VkImageBlit blit = {};
+	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.srcSubresource.layerCount = 1;
+	blit.srcOffsets[1].x = (int32_t)sourceWidth;
+	blit.srcOffsets[1].y = (int32_t)sourceHeight;
+	blit.srcOffsets[1].z = 1;
+	blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.dstSubresource.layerCount = 1;
+	blit.dstOffsets[1].x = width;
+	blit.dstOffsets[1].y = height;
+	blit.dstOffsets[1].z = 1;
+
+	DeviceTable::CmdBlitImage(cmd,
+		source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		swapchain_image_resources[image].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &blit, VK_FILTER_LINEAR);
+}
+
+void Demo::record_temporal(VkCommandBuffer cmd)
+{
+	// The history was drawn with the matrices of the last frame,
+	// so a position in the clip space of this frame goes back to
+	// world space, and then into the clip space of the last frame.
+	// Until there is a history, only this frame is used
+	TemporalConstants constants;
+	constants.reprojection = temporal_previous_vp * glm::inverse(temporal_vp);
+	constants.jitter = glm::vec4(temporal_jitter, temporal_history->valid ? temporal_blend : 1.0f, 0.0f);
+	constants.renderWidth = (int32_t)render_width;
+	constants.renderHeight = (int32_t)render_height;
+	constants.outputWidth = (int32_t)width;
+	constants.outputHeight = (int32_t)height;
+
+	temporal_pass->Resolve(cmd, temporal_history, constants);
+}
+
+void Demo::prepare_depth_buffer()
+{
+	// The depth buffer holds the depth of each 
+	// pixel, so that when the final image is being
+	// created, the GPU will prioritize pixels with
+	// the smallest depth. That way, polygons closer
+	// to the camera will draw on top of polygons
+	// that are farther from the camera.
+	
+	// This ^^ is set in pipelineState's
+	// depthStencilState, which will be described
+	// later. That is what allows us to choose
+	// what the depth buffer is used for
+
+	// The format of this image will usually be 16-bit.
+	// There will be 16 bits that will store the depth 
+	// of each pixel, which is plenty for this example.
+	// If a scene has more depth, set depth_high_precision
+	// to use a 32-bit format, see select_depth_format
+	const VkFormat depth_format = select_depth_format();
+
+	// The depth buffer has as many samples as the color, and
+	// this is where we find out how many the GPU can do
+	if (firstInit)
+	{
+		msaa_sample_count = select_msaa_samples();
+
+		if ((uint32_t)msaa_sample_count != msaa_samples && msaa_samples > 1)
+			printf("%ux MSAA is not supported, using %ux\n", msaa_samples, (uint32_t)msaa_sample_count);
+
+		// The post subpass is a subpass of the render pass, and it
+		// reads one sample of the scene color, at its own pixel. With
+		// MSAA, the third attachment is already the resolve attachment
+		if (use_post_subpass && (use_dynamic_rendering || msaa_sample_count != VK_SAMPLE_COUNT_1_BIT))
+		{
+			printf("The post subpass needs a render pass without MSAA, the post subpass is disabled\n");
+			use_post_subpass = false;
+		}
+	}
+
+	// The depth pyramid is made with one depth value per pixel,
+	// so occlusion culling can not read a multisampled depth buffer
+	if (use_occlusion_culling && msaa_sample_count != VK_SAMPLE_COUNT_1_BIT)
+	{
+		printf("Occlusion culling does not work with MSAA, occlusion culling is disabled\n");
+		use_occlusion_culling = false;
+	}
+
+	// The temporal upscaler reads one depth value for every pixel, and
+	// it is the other way to smooth the edges, it does not need MSAA
+	if (firstInit && use_temporal_upscale)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(gpu, depth_format, &props);
+
+		if (msaa_sample_count != VK_SAMPLE_COUNT_1_BIT || !(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+		{
+			printf("The depth buffer can not be sampled, or MSAA is on, temporal upscaling is disabled\n");
+			use_temporal_upscale = false;
+		}
+	}
+
+	// The depth pyramid has the size of the window, but with dynamic
+	// resolution (or temporal upscaling), the scene only covers a
+	// part of the depth buffer
+	if (use_occlusion_culling && (use_dynamic_resolution || use_temporal_upscale))
+	{
+		printf("Occlusion culling does not work with dynamic resolution, occlusion culling is disabled\n");
+		use_occlusion_culling = false;
+	}
+
+	// Occlusion culling reads the depth buffer in a compute
+	// shader, so the format has to be SAMPLED_IMAGE. That is also
+	// where we find out if the GPU culling pass was turned off
+	if (use_occlusion_culling)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(gpu, depth_format, &props);
+
+		if (!use_gpu_culling || !(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+		{
+			printf("The depth buffer can not be sampled, occlusion culling is disabled\n");
+			use_occlusion_culling = false;
+		}
+	}
+
+	// Formats with stencil need the stencil aspect in
+	// their image view, because they are used as a
+	// depth-stencil attachment
+	depth_aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (depth_format == VK_FORMAT_D16_UNORM_S8_UINT ||
+		depth_format == VK_FORMAT_D24_UNORM_S8_UINT ||
+		depth_format == VK_FORMAT_D32_SFLOAT_S8_UINT)
+	{
+		depth_aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+
+	// We create an image for the depth buffer.
+	// This is our first time making an image by hand,
+	// because the Swapchain's create-function generated
+	// the images for us, and then we put the images
+	// into an imageView. This is how an image is created
+	// normally
+
+	// The sType is always the same
+	// This is a 2D image, not an array, not a skybox
+	// we give it the format
+	// we give it the width and height (same as screen size)
+	// the depth is 1, but this depth is not the same as pixel depth.
+	// There are 3D textures that have a width, height, and depth.
+	// This is a 2D image, so we have a width, a height, and a depth of 1 pixel
+	// the usage of this image is for the depth stencil.
+	// It is also TRANSIENT, because we never need the depth after
+	// the render pass is finished (the store op is DONT_CARE), so
+	// the GPU may never give it real memory, see TextureGPU.cpp.
+	// With occlusion culling, the next frame reads it (SAMPLED),
+	// so it needs real memory, and it can not be TRANSIENT.
+	// The temporal upscaler reads it after the render pass too
+	VkImageCreateInfo image = {};
+	image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image.imageType = VK_IMAGE_TYPE_2D;
+	image.format = depth_format;
+	image.extent.width = width;
+	image.extent.height = height;
+	image.extent.depth = 1;
+	image.mipLevels = 1;
+	image.arrayLayers = 1;
+	image.samples = msaa_sample_count;
+	image.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+	if (use_occlusion_culling || use_temporal_upscale)
+		image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	// We use our TextureGPU class to make a special type of buffer for the texture
+	// that is on the GPU. Unlike the Vertex and Index buffers, we do not copy
+	// a CPU buffer into this GPU image, because depth information is generated
+	// by the GPU. The GPU will store data here, and read data here, no CPU involvement
+	// is necessary. We tell the GPU to use this buffer in the render_pass function,
+	// which will be explained later.
+	// It is only used in the render pass, but with occlusion culling,
+	// the next frame reads it before its render pass, so then it is
+	// alive in every phase, and nothing can share its memory
+	uint32_t depthFirstPhase = use_occlusion_culling ? FRAME_PHASE_CULLING : FRAME_PHASE_RENDER_PASS;
+	uint32_t depthLastPhase = (use_occlusion_culling || use_temporal_upscale) ? FRAME_PHASE_UPSCALE : FRAME_PHASE_RENDER_PASS;
+
+	depthBufferGPU = transient_pool->Add(image, depth_aspect,
+		depthFirstPhase, depthLastPhase, "Depth buffer");
+
+	// we give it the format of depth that we want it to use,
+	// which was set earlier in the function
+	depthBufferGPU->format = depth_format;
+	depth_buffer_format = depth_format;
+}
+
+void Demo::prepare_render_pass()
+{
+	// The Render Pass describes what the GPU is outputting.
+	// Every time we draw a scene on the graphics card, we want the 
+	// graphics card to give us an image (which goes on the screen),
+	// and a depth buffer, to make sure objects close to the camera are drawn
+	// on top of the objects that are far away from the camera.
+	// In previous tutorials, there was only color, but now there is color and depth
+
+	// The initial layout for the color and depth attachments will be LAYOUT_UNDEFINED
+	// because at the start of the renderpass, we don't care about their contents.
+	// At the start of the subpass, the color attachment's layout will be transitioned
+	// to LAYOUT_COLOR_ATTACHMENT_OPTIMAL and the depth stencil attachment's layout
+	// will be transitioned to LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL.  At the end of
+	// the renderpass, the color attachment's layout will be transitioned to
+	// LAYOUT_PRESENT_SRC_KHR to be ready to present.  This is all done as part of
+	// the renderpass, no barriers are necessary.
+
+	// With dynamic rendering, there is no render pass, the
+	// attachments are given to vkCmdBeginRenderingKHR in
+	// record_render_pass, and destroying VK_NULL_HANDLE does nothing
+	render_pass = VK_NULL_HANDLE;
+
+	if (use_dynamic_rendering)
+		return;
+
+	VkAttachmentDescription attachments[3];
+
+	// The first attachment is our color
+	attachments[0].format = format;
+	attachments[0].flags = 0;
+	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[0].finalLayout = present_layout;
+
+	// The second attachment is our depth
+	attachments[1].format = depthBufferGPU->format;
+	attachments[1].flags = 0;
+	attachments[1].samples = msaa_sample_count;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	// With occlusion culling, the depth is kept after the render
+	// pass, and the next frame reads it to make the depth pyramid.
+	// The temporal upscaler reads it right after the render pass
+	if (use_occlusion_culling || use_temporal_upscale)
+	{
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	}
+
+	// With MSAA, the first attachment is the multisampled image,
+	// which is thrown away after the subpass, and the swapchain
+	// image becomes the third attachment. Nothing is loaded into it,
+	// the resolve writes every pixel of it
+	// With the offscreen target, the color goes into the offscreen
+	// image, which is blitted to the swapchain after the render pass
+	if (use_offscreen_target)
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	if (msaa_sample_count != VK_SAMPLE_COUNT_1_BIT)
+	{
+		attachments[2] = attachments[0];
+		attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+		attachments[0].samples = msaa_sample_count;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	// With the post subpass, the scene is drawn into the third
+	// attachment, which is cleared, and thrown away at the end of the
+	// render pass. The post subpass writes every pixel of the first
+	// attachment, so nothing is loaded into it
+	if (use_post_subpass)
+	{
+		attachments[2] = attachments[0];
+		attachments[2].format = POST_SCENE_FORMAT;
+		attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[2].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	}
+
+	// For now, the attatchments array is finished, we 
+	// will use the array at the bottom of the function, don't
+	// worry about it for now
+
+	// Now we need to make what is called a "subpass" which is 
+	// part of the render pass. The subpass needs a color reference
+	// and a depth reference, so we tell it that the color reference
+	// will be the first attachment (0) as we described in the
+	// attachments array, and we tell it that depth will be the 
+	// second attachment (1), as described by the array above
+
+	VkAttachmentReference color_reference;
+	color_reference.attachment = use_post_subpass ? 2 : 0;
+	color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depth_reference;
+	depth_reference.attachment = 1;
+	depth_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	// We create the subpass by telling it that we will use this
+	// subpass in a GRAPHICS pipeline (and not a compute or raytracing pipeline),
+	// we tell it that there will be one color reference, and we give it the 
+	// color_reference that we made. In a subpass, there can only be a maximum
+	// of one depth references, or there can just be no depth references, so 
+	// we do not have to specify that there is only one depth reference.
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_reference;
+	subpass.pDepthStencilAttachment = &depth_reference;
+
+	// With MSAA, the samples of the color attachment are averaged
+	// into the swapchain image at the end of the subpass. The GPU does
+	// this while the pixels are still in its cache (or tile memory),
+	// instead of reading the whole image again in another pass
+	VkAttachmentReference resolve_reference;
+	resolve_reference.attachment = 2;
+	resolve_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	if (msaa_sample_count != VK_SAMPLE_COUNT_1_BIT)
+		subpass.pResolveAttachments = &resolve_reference;
+
+	// The post subpass reads the scene color at its own pixel, as
+	// an input attachment, and writes the first attachment
+	VkAttachmentReference post_input_reference;
+	post_input_reference.attachment = 2;
+	post_input_reference.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkAttachmentReference post_color_reference;
+	post_color_reference.attachment = 0;
+	post_color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	// With the depth pre-pass, the subpass above becomes the second
+	// subpass, and the first one only has the depth attachment.
+	// The post subpass is always the last one
+	VkSubpassDescription subpasses[3];
+	uint32_t subpassCount = 0;
+
+	if (use_depth_prepass)
+	{
+		subpasses[subpassCount] = {};
+		subpasses[subpassCount].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpasses[subpassCount].pDepthStencilAttachment = &depth_reference;
+		subpassCount++;
+	}
+
+	uint32_t mainSubpass = subpassCount;
+	subpasses[subpassCount++] = subpass;
+
+	if (use_post_subpass)
+	{
+		subpasses[subpassCount] = {};
+		subpasses[subpassCount].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpasses[subpassCount].inputAttachmentCount = 1;
+		subpasses[subpassCount].pInputAttachments = &post_input_reference;
+		subpasses[subpassCount].colorAttachmentCount = 1;
+		subpasses[subpassCount].pColorAttachments = &post_color_reference;
+		subpassCount++;
+	}
+
+	// Now we have our subpass description, 
+	// we will use this at the bottom of the function
+
+	// create an array of dependences, this tells the
+	// subpass what each attatchment in the subpass depends on
+	VkSubpassDependency attachmentDependencies[5];
+	uint32_t dependencyCount = 2;
+
+	// initialize the array as empty
+	memset(attachmentDependencies, 0, sizeof(VkSubpassDependency) * 5);
+
+	// The first attachment is our swapchain image, which is what we are
+	// outputting to, so that the completed image can get to the screen.
+	// We are not moving the image from one stage to another, so the source
+	// and the destination are the same, the swapchain image will always
+	// be the pipeline's output for color.
+	// Image Layout Transition
+	attachmentDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	attachmentDependencies[0].dstSubpass = 0;
+	attachmentDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	attachmentDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	attachmentDependencies[0].srcAccessMask = 0;
+	attachmentDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+
+	// The second attachment is the depth buffer
+	// Depth buffer is shared between swapchain images
+	// We use this depth buffer for tests in the fragment shader, determine the depth
+	// of the pixels, to make sure objects close to the camera are drawn over those
+	// that are far from the camera. 
+	attachmentDependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+	attachmentDependencies[1].dstSubpass = 0;
+	attachmentDependencies[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	attachmentDependencies[1].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	attachmentDependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	attachmentDependencies[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+	// the depth pyramid is made from the depth buffer before
+	// the render pass, so the render pass waits for it
+	if (use_occlusion_culling)
+		attachmentDependencies[1].srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	// With the depth pre-pass, the color is first used in the second
+	// subpass, and the second subpass tests against the depth that
+	// the first subpass wrote, so it waits for those writes
+	if (use_depth_prepass)
+	{
+		attachmentDependencies[0].dstSubpass = mainSubpass;
+
+		VkSubpassDependency& prepass = attachmentDependencies[dependencyCount++];
+		prepass.srcSubpass = 0;
+		prepass.dstSubpass = mainSubpass;
+		prepass.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		prepass.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		prepass.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		prepass.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		prepass.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	}
+
+	// With the offscreen target, the blit of the last frame has to be
+	// done reading the color before this frame draws over it. The blit
+	// after the render pass waits for the draws with a barrier from the
+	// frame graph, together with the swapchain image (see record_cmd)
+	if (use_offscreen_target)
+		attachmentDependencies[0].srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	// With the post subpass, the first attachment is only written by
+	// the post subpass, so it waits for the same things there. The main
+	// subpass draws into the scene color, which the post subpass of the
+	// last frame was still reading, and the post subpass waits for the
+	// draws, but only at its own pixel (BY_REGION), which is what lets
+	// a tiled GPU run both subpasses on one tile
+	if (use_post_subpass)
+	{
+		uint32_t postSubpass = mainSubpass + 1;
+
+		VkSubpassDependency& color = attachmentDependencies[dependencyCount++];
+		color = attachmentDependencies[0];
+		color.dstSubpass = postSubpass;
+
+		attachmentDependencies[0].srcStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+		VkSubpassDependency& post = attachmentDependencies[dependencyCount++];
+		post.srcSubpass = mainSubpass;
+		post.dstSubpass = postSubpass;
+		post.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		post.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		post.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		post.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		post.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	}
+
+	// create information that describes what
+	// we want in our renderpass
+	VkRenderPassCreateInfo rp_info = {};
+
+	// sType for all VkRenderPassCreateInfo structures
+	rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+
+	// the array of pAttatchments will be the "attatchments"
+	// array that we just made, and there are 2 elements
+	// in the array
+	rp_info.attachmentCount = (msaa_sample_count != VK_SAMPLE_COUNT_1_BIT || use_post_subpass) ? 3 : 2;
+	rp_info.pAttachments = attachments;
+
+	// The array of pSubpasses has the subpass we just made,
+	// and the depth pre-pass before it, and the post subpass
+	// after it, if they are used
+	rp_info.subpassCount = subpassCount;
+	rp_info.pSubpasses = subpasses;
+
+	// we give it the attatchment dependencies, there are 2
+	// elements in the attachmentDependencies array, one more
+	// for the depth pre-pass, and two more for the post subpass
+	rp_info.dependencyCount = dependencyCount;
+	rp_info.pDependencies = attachmentDependencies;
+
+	// create a renderpass based on the information we provided
+	vkCreateRenderPass(device, &rp_info, HostAllocator::callbacks, &render_pass);
+}
+
+void Demo::prepare_pipeline_cache()
+{
+	// We want to create a PipelineCache, so that we
+	// can cache the pipeline after we create it. Creating a
+	// pipeline compiles the shaders for our GPU, which is slow.
+	// The cache keeps the compiled shaders, and we save the cache
+	// to a file when the program closes (save_pipeline_cache), so
+	// the next time the program launches, the driver can skip
+	// compiling the shaders, if they have not changed.
+	// Demos that share the device share the cache too, the first
+	// one made it, and prewarmed it already, if it had to
+	if (!makes_device)
+	{
+		pipelineCache = device_context->pipelineCache;
+		pipeline_cache_valid = true;
+		return;
+	}
+
+	MappedFile cacheFile;
+	cacheFile.Open(PIPELINE_CACHE_FILE);
+
+	const char* cacheData = cacheFile.GetData();
+	size_t cacheSize = cacheFile.GetSize();
+
+	// The cache file starts with a header, which tells us which GPU
+	// and which driver made the cache. If this is a different GPU,
+	// or if the driver was updated, then we can not use the cache.
+	// The header is 16 bytes of integers, followed by the 16-byte UUID
+	bool valid = false;
+
+	if (cacheData != nullptr && cacheSize >= 16 + VK_UUID_SIZE)
+	{
+		uint32_t header[4];
+		memcpy(header, cacheData, sizeof(header));
+
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties(gpu, &props);
+
+		valid =
+			header[0] >= 16 + VK_UUID_SIZE &&
+			header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header[2] == props.vendorID &&
+			header[3] == props.deviceID &&
+			memcmp(cacheData + 16, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+		if (!valid)
+			printf("Pipeline cache was made by a different GPU or driver, ignoring it\n");
+	}
+
+	// without a cache that we can use, the prewarm fills it
+	pipeline_cache_valid = valid;
+
+	// We have a CacheCreateInfo with the required sType,
+	// and the data from the file, if the file can be used.
+	// Without the data, the cache starts out empty
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	if (valid)
+	{
+		cacheInfo.initialDataSize = cacheSize;
+		cacheInfo.pInitialData = cacheData;
+	}
+
+	vkCreatePipelineCache(device, &cacheInfo, HostAllocator::callbacks, &pipelineCache);
+	device_context->pipelineCache = pipelineCache;
+
+	// the driver copied the data, so the file
+	// is unmapped when cacheFile goes away
+}
+
+void Demo::save_pipeline_cache()
+{
+	// Ask the driver how large the cache is, then get
+	// the data of the cache, and write it to the file,
+	// which is loaded in prepare_pipeline_cache
+	size_t cacheSize = 0;
+	vkGetPipelineCacheData(device, pipelineCache, &cacheSize, NULL);
+
+	if (cacheSize == 0)
+		return;
+
+	std::vector<char> cacheData(cacheSize);
+
+	if (vkGetPipelineCacheData(device, pipelineCache, &cacheSize, cacheData.data()) != VK_SUCCESS)
+		return;
+
+	if (!Helper::WriteFile(PIPELINE_CACHE_FILE, cacheData.data(), cacheSize))
+		printf("Failed to save the pipeline cache to %s\n", PIPELINE_CACHE_FILE);
+}
+
+void Demo::select_shader_sources()
+{
+	// the GLSL files of the shaders that the pipeline uses,
+	// which depend on the same options as the .inc files
+	vs_source_name = use_instancing ?
+		(use_push_constants ? "cube_instanced_push.vert" : "cube_instanced.vert") :
+		(use_push_constants ? "cube_push.vert" : "cube.vert");
+
+	if (use_vertex_pulling)
+		vs_source_name = "cube_pull.vert";
+
+	if (use_gpu_animation)
+		vs_source_name = "cube_animated.vert";
+
+	fs_source_name = use_bindless_textures ? "cube_bindless.frag" : "cube.frag";
+
+	if (use_half_precision && !use_bindless_textures)
+		fs_source_name = "cube_half.frag";
+
+	if (use_texture_arrays)
+		fs_source_name = "cube_array.frag";
+}
+
+VkPipelineLayout Demo::create_pipeline_layout(bool pushMatrix, bool pullVertices)
+{
+	// Now we create a pipeline layout, which will have
+	// one descriptor set in it. Super simple, just use 
+	// the required sType, give it the layout we just made,
+	// and let it know that there is one descriptor layout
+	VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = {};
+	pPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pPipelineLayoutCreateInfo.setLayoutCount = 1;
+	pPipelineLayoutCreateInfo.pSetLayouts = &desc_layout;
+
+	// with the sets split by frequency, it has all of them,
+	// in the order of DescriptorFrequency
+	if (use_frequency_sets)
+	{
+		pPipelineLayoutCreateInfo.setLayoutCount = DESCRIPTOR_SET_COUNT;
+		pPipelineLayoutCreateInfo.pSetLayouts = frequency_layouts;
+	}
+
+	// If we are using push constants, the layout needs to know
+	// how many bytes of push constants there are (one 4x4 matrix),
+	// and which shader stage reads them (vertex). Every GPU supports
+	// at least 128 bytes of push constants, our matrix is 64 bytes
+	VkPushConstantRange pushRanges[2] = {};
+	pushRanges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushRanges[0].offset = 0;
+	pushRanges[0].size = sizeof(glm::mat4x4);
+
+	// With bindless textures, the fragment shader reads the index of
+	// the texture from push constants too, right after the matrix
+	pushRanges[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushRanges[1].offset = sizeof(glm::mat4x4);
+	pushRanges[1].size = sizeof(uint32_t);
+
+	// Vertex pulling never reads the matrix from push constants
+	// (it is off with use_push_constants), so the address of the
+	// vertex buffer takes the place of the matrix
+	if (pullVertices)
+		pushRanges[0].size = sizeof(VertexPullConstants);
+
+	bool vertexPush = pushMatrix || pullVertices;
+
+	if (vertexPush)
+	{
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = pushRanges;
+	}
+
+	if (use_bindless_textures || use_texture_arrays)
+	{
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = vertexPush ? 2 : 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = vertexPush ? pushRanges : &pushRanges[1];
+	}
+
+	// Make the layout, we will use this when we build the pipeline later on
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, HostAllocator::callbacks, &layout);
+	return layout;
+}
+
+void Demo::prepare_pipeline(VkPipeline basePipeline)
+{
+	// The layout has the descriptor sets, and the push
+	// constants of the shaders that the options picked
+	pipeline_layout = create_pipeline_layout(use_push_constants, use_vertex_pulling);
+
+	// push descriptors are pushed into this pipeline layout,
+	// so their template can only be made now
+	if (use_push_descriptors)
+		prepare_descriptor_template(VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR);
+	
+	// Time for shaders, and there is a lot to say about shaders.
+	// The way I've set up shaders is I've written the Vertex
+	// and Fragment shaders into two files: cube.vert and cube.frag.
+
+	// If you want to have GLSL code inside the CPP file, and then
+	// compile the GLSL code at runtime, you can do that with a 
+	// library called "shaderc". This library is actually already
+	// built-in to the visual studio solution, linked and ready 
+	// to go. Here is a tutorial if anyone is interested:
+	// https://www.reddit.com/r/vulkan/comments/bbuh0p/compiling_glsl_in_shader_rather_than_precompiling/
+
+	// If you don't want to do that, there are two more options.
+	
+	// 1.You can precompile shaders, and load the shaders
+	// from files at runtime.
+	// 2. You can precompile shaders, and then turn the shader files
+	// into an array of bytes, and compile those bytes into the 
+	// EXE file. This way, the shaders are compiled AND inside the
+	// program, so the end-user won't have any shader files.
+
+	// Right now, I have written a program called "compileShaders.cmd"
+	// First, it compiles the GLSL files cube.vert and cube.frag into
+	// compiled shader files:
+	//		..\Bin\glslangValidator.exe -V cube.vert -o cube.vert.spv
+	// Next, it optimizes the compiled shader by removing the 
+	// debug features of the shader. This can be disabled if you want
+	//		..\Bin\spirv-opt --strip-debug cube.vert.spv -o cube2.vert.spv
+
+	// If you want to load precompiled shaders from files at runtime,
+	// you can use cube2.vert.spv and cube2.frag.spv. However,
+	// you will not find these files anywhere, and I will explain why 
+	// in a second.
+
+	// What we do next is, take the optimized compiled shader files,
+	// and turn them into an array of bytes
+	//		bin2hex --i cube2.vert.spv --o cube.vert.inc
+	// Then, after it is converted to an array of bytes,
+	// the original compiled shader files are deleted
+	//		del cube.vert.spv
+	//		del cube2.vert.spv
+
+	// Finally, the array of bytes are included here.
+	// If you open the inc files in notepad, you will
+	// see the bytes of the compiled shader, looks like
+	// this:
+	//	0x03, 0x02, 0x23, 0x07, 0x00, 0x00, 0x01, ...
+
+	// By using #include, we can put those 
+	// arrays into the C++ program, and then
+	// we can compile the arrays into the EXE
+
+	// Vertex Shader compiled to header
+	const unsigned char vs_code[] = {
+		#include "cube.vert.inc"
+	};
+
+	// Vertex Shader that reads the matrix from push constants
+	const unsigned char vs_push_code[] = {
+		#include "cube_push.vert.inc"
+	};
+
+	// Vertex Shaders that also read the instance buffer,
+	// with a uniform buffer, or with push constants
+	const unsigned char vs_instanced_code[] = {
+		#include "cube_instanced.vert.inc"
+	};
+
+	const unsigned char vs_instanced_push_code[] = {
+		#include "cube_instanced_push.vert.inc"
+	};
+
+	// Vertex Shader that turns each instance by the time, for GPU animation
+	const unsigned char vs_animated_code[] = {
+		#include "cube_animated.vert.inc"
+	};
+
+	// Vertex Shader that reads its own vertices, with vertex pulling
+	const unsigned char vs_pull_code[] = {
+		#include "cube_pull.vert.inc"
+	};
+
+	// Fragment Shader compiled to header
+	const unsigned char fs_code[] = {
+		#include "cube.frag.inc"
+	};
+
+	// Fragment Shader that does its color math with 16-bit floats
+	const unsigned char fs_half_code[] = {
+		#include "cube_half.frag.inc"
+	};
+
+	// Fragment Shader that picks its texture from the bindless array
+	const unsigned char fs_bindless_code[] = {
+		#include "cube_bindless.frag.inc"
+	};
+
+	// Fragment Shader that picks its layer of the texture array
+	const unsigned char fs_array_code[] = {
+		#include "cube_array.frag.inc"
+	};
+
+	// If you do not want to do this ^^^
+	// if you would prefer to take the compiled shader files
+	// and load them at runtime, you can make an empty array
+	// of bytes: char* vs_code = nullptr, char* fs_code = nullptr,
+	// Then you can use Helper::ReadFile to laod data from the 
+	// comopiled shader file into the byte arrays when the program
+	// launches, it works exactly the same as reading the PNG texture
+	// file, like we did before. If you want to use compiled shader
+	// files, then delete the lines in the compileShaders.cmd file
+	// that say:
+	//		del cube.vert.spv
+	//		del cube2.vert.spv
+
+	// Now, we need CreateInfo for each Shader Module.
+	// A Shader Module is a piece of a total Shader Program.
+	// One Shader Program is a combination of a vertex shader,
+	// a pixel shader, and sometimes more. So an individual
+	// vertex shader is a shader module, and a fragment shader
+	// is a shader module. We make a CreateInfo with the required sType
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+
+	// We give a pointer to the bytes of the compiled vertex shader,
+	// and the number of bytes that are in the compiled vertex shader
+	shaderInfo.pCode = (uint32_t*)vs_code;
+	shaderInfo.codeSize = sizeof(vs_code);
+
+	// pick the other vertex shader, if we use push constants
+	if (use_push_constants)
+	{
+		shaderInfo.pCode = (uint32_t*)vs_push_code;
+		shaderInfo.codeSize = sizeof(vs_push_code);
+	}
+
+	// pick the instanced vertex shaders, if we use instancing
+	if (use_instancing)
+	{
+		shaderInfo.pCode = (uint32_t*)(use_push_constants ? vs_instanced_push_code : vs_instanced_code);
+		shaderInfo.codeSize = use_push_constants ? sizeof(vs_instanced_push_code) : sizeof(vs_instanced_code);
+	}
+
+	if (use_gpu_animation)
+	{
+		shaderInfo.pCode = (uint32_t*)vs_animated_code;
+		shaderInfo.codeSize = sizeof(vs_animated_code);
+	}
+
+	if (use_vertex_pulling)
+	{
+		shaderInfo.pCode = (uint32_t*)vs_pull_code;
+		shaderInfo.codeSize = sizeof(vs_pull_code);
+	}
+
+	// With runtime shaders, the same vertex shader is compiled from
+	// its GLSL file, if it is there and it has no errors. Otherwise
+	// we keep using the one from the .inc file
+	std::vector<uint32_t> vsRuntime;
+	select_shader_sources();
+
+	if (use_runtime_shaders && shader_compiler->Compile(vs_source_name, VK_SHADER_STAGE_VERTEX_BIT, &vsRuntime))
+	{
+		shaderInfo.pCode = vsRuntime.data();
+		shaderInfo.codeSize = vsRuntime.size() * sizeof(uint32_t);
+	}
+
+	// Then we use the createInfo to make the shader module
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &vert_shader_module);
+
+	// We are going to re-use the createInfo that we used for the
+	// vertex shader, to make the createInfo for the fragment shader.
+	// All we have to do is replace the vertex shader data with
+	// the fragment shader data
+
+	// we give the pointer to compiled fragment shader bytes
+	// and the number of bytes in the compiled fragment shader
+	shaderInfo.pCode = (uint32_t*)fs_code;
+	shaderInfo.codeSize = sizeof(fs_code);
+
+	if (use_half_precision)
+	{
+		shaderInfo.pCode = (uint32_t*)fs_half_code;
+		shaderInfo.codeSize = sizeof(fs_half_code);
+	}
+
+	if (use_bindless_textures)
+	{
+		shaderInfo.pCode = (uint32_t*)fs_bindless_code;
+		shaderInfo.codeSize = sizeof(fs_bindless_code);
+	}
+
+	if (use_texture_arrays)
+	{
+		shaderInfo.pCode = (uint32_t*)fs_array_code;
+		shaderInfo.codeSize = sizeof(fs_array_code);
+	}
+
+	std::vector<uint32_t> fsRuntime;
+
+	if (use_runtime_shaders && shader_compiler->Compile(fs_source_name, VK_SHADER_STAGE_FRAGMENT_BIT, &fsRuntime))
+	{
+		shaderInfo.pCode = fsRuntime.data();
+		shaderInfo.codeSize = fsRuntime.size() * sizeof(uint32_t);
+	}
+
+	// Every fragment shader of the cube has its texture at binding 1
+	// of set 0. With the sets split by frequency, the texture is in the
+	// material set, so a copy of the SPIR-V gets the new set number
+	std::vector<uint32_t> fsMoved;
+
+	if (use_frequency_sets)
+	{
+		fsMoved.assign(shaderInfo.pCode, shaderInfo.pCode + shaderInfo.codeSize / sizeof(uint32_t));
+		DescriptorSets::MoveBinding(&fsMoved, 1, DESCRIPTOR_SET_MATERIAL);
+		shaderInfo.pCode = fsMoved.data();
+	}
+
+	// Then we use the createInfo to make the shader module
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &frag_shader_module);
+
+	// The pipeline is made in create_pipeline. With async pipelines
+	// we first make a pipeline with DISABLE_OPTIMIZATION, which the driver
+	// can make much faster, because it skips most of the work of compiling
+	// the shaders. We draw with that one right away, while the real,
+	// optimized pipeline is made by the pipeline compiler on another
+	// thread. update_pipeline switches to it when it is ready
+	if (use_async_pipelines)
+	{
+		pipeline = create_pipeline(VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT, basePipeline);
+
+		// The optimized pipeline has the same state as the fast one, so it
+		// is made as a derivative of it. The fast one is only retired after
+		// the optimized one is ready, so it is still alive on the other thread
+		VkPipeline fallback = pipeline;
+		pipeline_future = pipeline_compiler->Submit([this, fallback]() { return create_pipeline(0, fallback); });
+		pipeline_pending = true;
+		return;
+	}
+
+	pipeline = create_pipeline(0, basePipeline);
+	pipeline_pending = false;
+
+	// Now that our shaders are now copied into the pipeline,
+	// we do not need the individual modules anymore.
+	// destroy shader modules, now that they aren't needed
+	forget_pipeline_parts((uint64_t)frag_shader_module);
+	forget_pipeline_parts((uint64_t)vert_shader_module);
+	vkDestroyShaderModule(device, frag_shader_module, HostAllocator::callbacks);
+	vkDestroyShaderModule(device, vert_shader_module, HostAllocator::callbacks);
+}
+
+PipelineVariant Demo::get_pipeline_variant(bool depthOnly)
+{
+	// the layout, the shaders, and the vertex input that the options
+	// of this run picked. The depth-only shader only exists while
+	// prepare_depth_prepass runs, which can be at the same time as
+	// the optimized pipeline is made, so only that one reads it
+	PipelineVariant variant = {};
+	variant.layout = pipeline_layout;
+	variant.vertModule = vert_shader_module;
+	variant.fragModule = frag_shader_module;
+	variant.depthModule = depthOnly ? depth_vert_shader_module : VK_NULL_HANDLE;
+	variant.positionStride = position_stride;
+	variant.instancing = use_instancing;
+	variant.animation = use_gpu_animation;
+	variant.pulling = use_vertex_pulling;
+	variant.compact = use_compact_vertices;
+	return variant;
+}
+
+VkPipeline Demo::create_pipeline(VkPipelineCreateFlags flags, VkPipeline basePipeline, bool depthOnly, bool boxes, const PipelineVariant* variant)
+{
+	// Everything in here only reads members of Demo that do not change
+	// while the program runs (the layout, the render pass, the shader
+	// modules), so this can run on another thread, while we draw
+
+	// The layout, the shaders, and the vertex input come from the
+	// variant, without one they are the ones that the options picked
+	PipelineVariant v = (variant != nullptr) ? *variant : get_pipeline_variant(depthOnly);
+
+	// This is the CreateInfo for full pipeline
+	// This will be the largest CreateInfo structure of the
+	// entire Vulkan program, so get ready for it
+
+	// first we give the pipeline our required sType, then
+	// we give it the pipeline layout and the render pass 
+	// that we made earlier
+	VkGraphicsPipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeInfo.layout = v.layout;
+	pipeInfo.renderPass = render_pass;
+
+	// With the depth pre-pass, the depth-only pipeline is
+	// used in the first subpass, and this one in the second
+	if (use_depth_prepass)
+		pipeInfo.subpass = depthOnly ? 0 : 1;
+
+	// With dynamic rendering, there is no render pass to tell the
+	// pipeline about the attachments, so it gets their formats instead.
+	// The depth-only pipeline has no color attachment, like the
+	// first subpass. The stencil of the depth format is never used
+	VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	renderingInfo.colorAttachmentCount = depthOnly ? 0 : 1;
+	renderingInfo.pColorAttachmentFormats = &format;
+	renderingInfo.depthAttachmentFormat = depth_buffer_format;
+
+	if (use_dynamic_rendering)
+	{
+		pipeInfo.pNext = &renderingInfo;
+		pipeInfo.renderPass = VK_NULL_HANDLE;
+		pipeInfo.subpass = 0;
+	}
+
+	// With variable rate shading, the rate of the pipeline is 1x1, until
+	// record_draws sets the rate of each draw (a dynamic state, below).
+	// The rate of the primitive is kept (we never write one), and then
+	// it is combined with the rate of the shading rate image.
+	// The depth-only pipeline has no fragment shader to make cheaper
+	VkPipelineFragmentShadingRateStateCreateInfoKHR shadingRateState = {};
+	shadingRateState.sType = VK_STRUCTURE_TYPE_PIPELINE_FRAGMENT_SHADING_RATE_STATE_CREATE_INFO_KHR;
+	shadingRateState.fragmentSize.width = 1;
+	shadingRateState.fragmentSize.height = 1;
+	shadingRateState.combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+	shadingRateState.combinerOps[1] = use_shading_rate_image ? shading_rate_combiner : VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+
+	if ((use_shading_rate || use_shading_rate_image) && !depthOnly)
+	{
+		shadingRateState.pNext = pipeInfo.pNext;
+		pipeInfo.pNext = &shadingRateState;
+	}
+
+	// Vertex input binding
+	// This example uses a single vertex input binding at binding point 0 (see vkCmdBindVertexBuffers)
+	// The binding description says that vertices will be given to the GPU, one at a time,
+	// and we tell it how large each Vertex is. If the GPU has a Vertex Buffer that is 100kb large,
+	// the GPU needs to know where each vertex starts and ends, and it knows that by knowing
+	// how large each vertex is, which we tell it here
+	VkVertexInputBindingDescription vertexInputBinding = {};
+	vertexInputBinding.binding = 0;
+	vertexInputBinding.stride = sizeof(VertexStructure);
+	vertexInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	// Input attribute bindings describe shader attribute locations and memory layouts
+	// This is very similar to how vertex attributes work in any other. Basically,
+	// in the last structure, we say how large each vertex is, but in this structure,
+	// we say how large each piece of the vertex is
+	VkVertexInputAttributeDescription vertexInputAttributs[7];
+	memset(vertexInputAttributs, 0, sizeof(VkVertexInputAttributeDescription) * 7);
+
+	// location = 0, because this is the first element of the vertex
+	vertexInputAttributs[0].location = 0;
+
+	// offsetof returns 0, because position starts 0 bytes after the start of the vertex
+	vertexInputAttributs[0].offset = offsetof(VertexStructure, position);
+
+	// format is R32-G32-B32, because there are three 32-bit floats in the position data,
+	// one float for X, one float for Y, and one float for Z, of each position, of each vertex
+	vertexInputAttributs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+
+	// location = 1, because this is the second element of the vertex
+	vertexInputAttributs[1].location = 1;
+
+	// offsetof returns 12, because uv starts 12 bytes after the start of the vertex,
+	// because there are 12 bits in position (3 floats that are 4 bytes large)
+	vertexInputAttributs[1].offset = offsetof(VertexStructure, uv);	
+
+	// format is R32-B32, because there are two floats in every UV.
+	vertexInputAttributs[1].format = VK_FORMAT_R32G32_SFLOAT;
+
+	// The compact vertex has the same locations, but smaller formats, and
+	// the GPU converts them to floats for us, see CompactVertexStructure.
+	// The vertex shader still gets a vec3 and a vec2, the 4th half
+	// float of the position is ignored, because the shader only asks for 3
+	if (v.compact)
+	{
+		vertexInputBinding.stride = sizeof(CompactVertexStructure);
+		vertexInputAttributs[0].offset = offsetof(CompactVertexStructure, position);
+		vertexInputAttributs[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		vertexInputAttributs[1].offset = offsetof(CompactVertexStructure, uv);
+		vertexInputAttributs[1].format = VK_FORMAT_R16G16_UNORM;
+	}
+
+	// With instancing, there is a second binding (binding point 1),
+	// which is the instance buffer. The inputRate is INSTANCE, so the
+	// GPU moves to the next matrix once per instance, rather than once
+	// per vertex. The matrix is location = 2 in cube_instanced.vert,
+	// and each of its 4 columns takes one location, from 2 to 5
+	VkVertexInputBindingDescription vertexInputBindings[3];
+	vertexInputBindings[0] = vertexInputBinding;
+	vertexInputBindings[1].binding = 1;
+	vertexInputBindings[1].stride = sizeof(glm::mat4);
+	vertexInputBindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		vertexInputAttributs[2 + i].location = 2 + i;
+		vertexInputAttributs[2 + i].binding = 1;
+		vertexInputAttributs[2 + i].offset = i * sizeof(glm::vec4);
+		vertexInputAttributs[2 + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	}
+
+	// With GPU animation, the animation buffer is a third binding, also
+	// once per instance, and its vec4 is location = 6 in cube_animated.vert
+	vertexInputBindings[2].binding = 2;
+	vertexInputBindings[2].stride = sizeof(glm::vec4);
+	vertexInputBindings[2].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	vertexInputAttributs[6].location = 6;
+	vertexInputAttributs[6].binding = 2;
+	vertexInputAttributs[6].offset = 0;
+	vertexInputAttributs[6].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+
+	// Vertex Input State
+	// This combines the last two structures we made
+	// We give it the requires sType, we give it the number of 
+	// binding descriptions, which is one, and we give it the 
+	// pointer to the bindingInput, because it is not an array.
+	// We tell it how many attributes there are (two) (pos and uv),
+	// then we give it the array of two attributes (which is already
+	// a pointer)
+	VkPipelineVertexInputStateCreateInfo vi = {};
+	vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vi.vertexBindingDescriptionCount = 1;
+	vi.pVertexBindingDescriptions = &vertexInputBinding;
+	vi.vertexAttributeDescriptionCount = 2;
+	vi.pVertexAttributeDescriptions = vertexInputAttributs;
+
+	// use both bindings, and all six attributes, with instancing
+	if (v.instancing)
+	{
+		vi.vertexBindingDescriptionCount = 2;
+		vi.pVertexBindingDescriptions = vertexInputBindings;
+		vi.vertexAttributeDescriptionCount = 6;
+	}
+
+	if (v.animation)
+	{
+		vi.vertexBindingDescriptionCount = 3;
+		vi.vertexAttributeDescriptionCount = 7;
+	}
+
+	// The depth-only pipeline reads the position buffer, which has
+	// nothing but positions. The UV is not used, so the instance
+	// matrix moves down to take its place in the array
+	if (depthOnly)
+	{
+		vertexInputBinding.stride = v.positionStride;
+		vertexInputBindings[0].stride = v.positionStride;
+
+		for (uint32_t i = 1; i < 5; i++)
+			vertexInputAttributs[i] = vertexInputAttributs[i + 1];
+
+		vi.vertexAttributeDescriptionCount = v.instancing ? 5 : 1;
+	}
+
+	// With vertex pulling, the shader has no inputs at
+	// all, it only needs gl_VertexIndex, see cube_pull.vert
+	if (v.pulling)
+	{
+		vi.vertexBindingDescriptionCount = 0;
+		vi.vertexAttributeDescriptionCount = 0;
+	}
+	
+	// we put the InputStateCrateInfo into the PipelineCreateInfo
+	pipeInfo.pVertexInputState = &vi;
+
+	// All that, and now the pipeline knows how to take in
+	// each vertex as input. Next, we will tell the GPU what
+	// to do with the vertices. In thsi case, we want to draw 
+	// a list of trangles with the vertices. This will connect
+	// vertices 0, 1, and 2 together, then it will connect 3, 4,
+	// and 5 toghether, and so on
+
+	// Input Assembly State
+	// we give it the required sType, and then we tell it
+	// that we want to draw triangles, but you could also draw
+	// points or lines if someone wanted to try that. In this case,
+	// we set Topology to TRIANGLE_LIST, so that we can draw triangles
+	VkPipelineInputAssemblyStateCreateInfo ia = {};
+	ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	
+	// we give the InputAssemblyStateCreateInfo to the PipelineCreateInfo
+	pipeInfo.pInputAssemblyState = &ia;
+
+	// This is an of DynamicStates
+	// This is part of the DynamicStateCreateInfo
+	// which goes into PipelineCreateInfo. We want
+	// two types of dynamic states, we want the
+	// viewport and the scissor, which we set in
+	// the command buffers that draw our scene
+	VkDynamicState dynamicStateEnables[VK_DYNAMIC_STATE_RANGE_SIZE];
+	memset(dynamicStateEnables, 0, sizeof dynamicStateEnables);
+	dynamicStateEnables[0] = VK_DYNAMIC_STATE_VIEWPORT;
+	dynamicStateEnables[1] = VK_DYNAMIC_STATE_SCISSOR;
+
+	// This is the dynamic state
+	// we give it the requierd sType, we tell it that
+	// we have two dynamicStates, and we give the array
+	// of dynamic states that we have
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStateEnables;
+
+	// the rate of each draw is set in the command buffer too
+	if (use_shading_rate && !depthOnly)
+		dynamicStateEnables[dynamicState.dynamicStateCount++] = VK_DYNAMIC_STATE_FRAGMENT_SHADING_RATE_KHR;
+
+	// we give our DynamicStateCreateInfo to the PipelineCreateInfo
+	pipeInfo.pDynamicState = &dynamicState;
+
+	// We tell Vulkan how many viewports and scissors there are.
+	// I know this feels repetitive, it is, but after we set this
+	// up, we don't need to change it. We will change some parts of
+	// the pipeline after this in future tutorials, but we won't change
+	// anything to do with viewport and scissor
+	
+	// give it the sType it requires
+	// let it know that there is one viewport and one scissor
+	VkPipelineViewportStateCreateInfo vp = {};
+	vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	vp.viewportCount = 1;
+	vp.scissorCount = 1;
+
+	// give the viewportStateCreateInfo to the PipelineCreateInfo
+	pipeInfo.pViewportState = &vp;
+
+	// This structure togggles all the options in the rasterizer,
+	// which is what converts polygons into pixels, so that they can
+	// be shaded in the fragment shader. There are around 10 different
+	// variables that we can configure with the rasterizer, but for
+	// now we will keep it simple, we give it the required sType,
+	// we say that we want the polygons to be filled (opposed to lines),
+	// we cull the back sides of the polygon faces, so that only the
+	// front sides of the polygons are drawn. If you don't know what that does
+	// try replacing VK_CULL_MODE_BACK_BIT with VK_CULL_MODE_FRONT_BIT, and then
+	// only the front sides of the polygon will be drawn. Alternatively, if you
+	// want both sides of the polygons to be drawn (which is useless when 
+	// drawing a cube), try VK_CULL_MODE_NONE_BIT.
+	// We set the line width to 1.0f, even though we aren't drawing lines,
+	// because Vulkan validator will yell at us if we don't
+	VkPipelineRasterizationStateCreateInfo rs = {};
+	rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rs.polygonMode = VK_POLYGON_MODE_FILL;
+	rs.cullMode = VK_CULL_MODE_BACK_BIT;
+	rs.lineWidth = 1.0f;
+
+	// the occlusion boxes are not a part of the mesh, seeing
+	// the inside of one still means that it is not hidden
+	if (boxes)
+		rs.cullMode = VK_CULL_MODE_NONE;
+
+	// give the RasterizationInfo to the PipelineCreateInfo
+	pipeInfo.pRasterizationState = &rs;
+
+	// one of these is needed for every render target
+	// there is one in this case, which is the swapchain,
+	// so we create an array of one blendAttachmentState
+
+	// this handles transparency. In this case, we do not
+	// want transparency, so we set blending to disable,
+	// and we set the colorWrite to 0xF, which is the maximum
+	// value, so the polygons are 100% drawn.
+	VkPipelineColorBlendAttachmentState att_state[1];
+	memset(att_state, 0, sizeof(att_state));
+	att_state[0].colorWriteMask = 0xF;
+	att_state[0].blendEnable = VK_FALSE;
+
+	// create the blend attachment state, which holds
+	// all of our blendStateAttachments. In this case, we
+	// give it the requierd sType, we tell it there is one
+	// member of the array of attachments, and we give it the
+	// array of one attachment
+	VkPipelineColorBlendStateCreateInfo cb = {};
+	cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	cb.attachmentCount = 1;
+	cb.pAttachments = att_state;
+
+	// the first subpass of the depth pre-pass has no color attachment
+	if (depthOnly)
+		cb.attachmentCount = 0;
+	
+	// give the blendState to the PipelineCreateInfo
+	pipeInfo.pColorBlendState = &cb;
+
+	// Now that we've gone through all the necessary 
+	// struggle to make a depth buffer, allocate data on 
+	// the GPU for it, make a vkImageView to make it accessible,
+	// and setup our renderpass + framebuffer to use the depth buffer,
+	// we can finally tell the computer what to do with 
+	// the depth buffer. Here we create the DepthStateCreateInfo
+
+	// First we give it the necessary sType,
+	// we set DepthTest to true, because we want to compare depth
+	// of each pixel to the depth buffer, we enable writing to the
+	// depth buffer, we use the LESS_OR_EQUAL operation, so that
+	// new pixels are drawn to the screen if they are closer to 
+	// the camera than any pixel that is already rendered (or equal),
+	// then we let the pipeline know that we are always comparing depths
+	VkPipelineDepthStencilStateCreateInfo ds = {};
+	ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	ds.depthTestEnable = VK_TRUE;
+	ds.depthWriteEnable = VK_TRUE;
+	ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	ds.back.compareOp = VK_COMPARE_OP_ALWAYS;
+
+	// After the depth pre-pass, the depth buffer already has the
+	// closest depth of every pixel, so only the triangle that made it
+	// is drawn (EQUAL), and there is nothing left to write
+	if (use_depth_prepass && !depthOnly)
+	{
+		ds.depthWriteEnable = VK_FALSE;
+		ds.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	}
+
+	// The occlusion boxes are the depth-only pipeline, without writing
+	// depth. They are only tested, a box must never hide anything
+	if (boxes)
+		ds.depthWriteEnable = VK_FALSE;
+
+	// give the depthState to the PipelineCreateInfo
+	pipeInfo.pDepthStencilState = &ds;
+
+	// multisample state
+	// this allows for multisample anti-aliasing (MSAA).
+	// The number of samples has to match the attachments of
+	// the render pass, so it is msaa_sample_count, which is
+	// 1 unless msaa_samples asked for more, see prepare_msaa_target
+	VkPipelineMultisampleStateCreateInfo ms = {};
+	ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	ms.rasterizationSamples = msaa_sample_count;
+
+	// give multisample state to the PipelineCreateInfo
+	pipeInfo.pMultisampleState = &ms;
+
+	// We create a list of pipeline stages
+	// In this case, there are two stages, a vertex shader
+	// and a fragment shader. We make the array, and use
+	// memset to set all bytes in the array to zero
+	VkPipelineShaderStageCreateInfo shaderStages[2];
+	memset(&shaderStages, 0, sizeof(VkPipelineShaderStageCreateInfo) * 2);
+
+	// First we give the required sType, then
+	// we declare that thish particular stage is
+	// a vertex shader (VERTEX_BIT), then we give
+	// the vertex shader module that we made earlier,
+	// and we let the pipeline know that the entry
+	// function is "main". Rather than having 
+	// "void main() {...}", you can actually call the 
+	// function anything, as long as it matches the 
+	// name that is given here
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = v.vertModule;
+	shaderStages[0].pName = "main";
+
+	// First we give the required sType, then
+	// we declare that thish particular stage is
+	// a fragment shader (FRAGMENT_BIT), then we give
+	// the fragment shader module that we made earlier,
+	// and we let the pipeline know that the entry
+	// function is "main".
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = v.fragModule;
+	shaderStages[1].pName = "main";
+
+	// The fragment shader has specialization constants, which are
+	// like #define's that are given to the driver when the pipeline is
+	// made, instead of when the shader is compiled. Each map entry says
+	// which constant_id is where in shader_constants, and the driver
+	// builds a version of the shader just for these values, so one compiled
+	// shader can become many variants, and none of them have to branch
+	VkSpecializationMapEntry specEntries[1] = {};
+	specEntries[0].constantID = 0;
+	specEntries[0].offset = offsetof(ShaderConstants, textured);
+	specEntries[0].size = sizeof(VkBool32);
+
+	VkSpecializationInfo specInfo = {};
+	specInfo.mapEntryCount = 1;
+	specInfo.pMapEntries = specEntries;
+	specInfo.dataSize = sizeof(ShaderConstants);
+	specInfo.pData = &shader_constants;
+
+	shaderStages[1].pSpecializationInfo = &specInfo;
+
+	// we let the PipelienCreateInfo know that there are two
+	// shader stages, and we give it the array of stages
+	// that we just made a moment ago
+	pipeInfo.stageCount = 2;
+	pipeInfo.pStages = shaderStages;
+
+	// The depth-only pipeline has no fragment shader at all, the
+	// depth of every pixel comes straight from the rasterizer
+	if (depthOnly)
+	{
+		shaderStages[0].module = v.depthModule;
+		pipeInfo.stageCount = 1;
+	}
+
+	// Now that we have completed the PipelineCreateInfo,
+	// we can create the pipeline. The pipelineCache was made
+	// in prepare_pipeline_cache, if it was loaded from the disk,
+	// then the driver can skip compiling the shaders again
+
+	// The flags say if this is the fast (unoptimized) pipeline
+	// that is used while the real one is being made
+	pipeInfo.flags = flags;
+
+	// With pipeline derivatives, every pipeline allows other pipelines to
+	// be made from it, and if there is a base pipeline, this one is made
+	// as a derivative of it. A derivative tells the driver that most of the
+	// state is the same as the base, so it can reuse work from it, instead
+	// of building everything again. basePipelineIndex is -1, because the
+	// base is a handle, not another member of the same vkCreateGraphicsPipelines
+	if (use_pipeline_derivatives && !depthOnly)
+	{
+		pipeInfo.flags |= VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+
+		if (basePipeline != VK_NULL_HANDLE)
+		{
+			pipeInfo.flags |= VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+			pipeInfo.basePipelineHandle = basePipeline;
+			pipeInfo.basePipelineIndex = -1;
+		}
+	}
+
+	// Every pipeline that is bound while rendering with a shading
+	// rate attachment has to say so, the depth-only pipeline too
+	if (use_shading_rate_image)
+		pipeInfo.flags |= VK_PIPELINE_CREATE_RENDERING_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR;
+
+	// With pipeline libraries, the same state is split into its parts,
+	// and only the parts that were never made before are compiled, see
+	// PipelineLibrary. Linking ignores the derivative flags from above
+	if (pipeline_library != nullptr)
+		return pipeline_library->Create(pipelineCache, pipeInfo);
+
+	// create the pipeline, with our pipeInfo structure
+	// and then our pipeline is stored into the cache.
+	// This can run on a thread of the pipeline compiler,
+	// so it makes its own VkPipeline and returns it
+	VkPipeline result = VK_NULL_HANDLE;
+	vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipeInfo, HostAllocator::callbacks, &result);
+	return result;
+}
+
+void Demo::prewarm_pipeline_cache()
+{
+	// The same .inc files as prepare_pipeline and prepare_depth_prepass.
+	// Vertex pulling is not prewarmed, because it is the only vertex
+	// shader that needs a feature of the device (buffer device address)
+	const unsigned char vs_code[] = {
+		#include "cube.vert.inc"
+	};
+
+	const unsigned char vs_push_code[] = {
+		#include "cube_push.vert.inc"
+	};
+
+	const unsigned char vs_instanced_code[] = {
+		#include "cube_instanced.vert.inc"
+	};
+
+	const unsigned char vs_instanced_push_code[] = {
+		#include "cube_instanced_push.vert.inc"
+	};
+
+	const unsigned char vs_animated_code[] = {
+		#include "cube_animated.vert.inc"
+	};
+
+	const unsigned char vs_depth_code[] = {
+		#include "cube_depth.vert.inc"
+	};
+
+	const unsigned char vs_depth_push_code[] = {
+		#include "cube_depth_push.vert.inc"
+	};
+
+	const unsigned char vs_depth_instanced_code[] = {
+		#include "cube_depth_instanced.vert.inc"
+	};
+
+	const unsigned char vs_depth_instanced_push_code[] = {
+		#include "cube_depth_instanced_push.vert.inc"
+	};
+
+	const unsigned char fs_code[] = {
+		#include "cube.frag.inc"
+	};
+
+	const unsigned char fs_half_code[] = {
+		#include "cube_half.frag.inc"
+	};
+
+	const unsigned char fs_bindless_code[] = {
+		#include "cube_bindless.frag.inc"
+	};
+
+	const unsigned char fs_array_code[] = {
+		#include "cube_array.frag.inc"
+	};
+
+	std::vector<VkShaderModule> modules;
+
+	auto makeModule = [&](const unsigned char* code, size_t size, bool fragment)
+	{
+		VkShaderModuleCreateInfo shaderInfo = {};
+		shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		shaderInfo.pCode = (const uint32_t*)code;
+		shaderInfo.codeSize = size;
+
+		// the texture moves to the material set, like in prepare_pipeline
+		std::vector<uint32_t> fsMoved;
+
+		if (fragment && use_frequency_sets)
+		{
+			fsMoved.assign(shaderInfo.pCode, shaderInfo.pCode + size / sizeof(uint32_t));
+			DescriptorSets::MoveBinding(&fsMoved, 1, DESCRIPTOR_SET_MATERIAL);
+			shaderInfo.pCode = fsMoved.data();
+		}
+
+		VkShaderModule module = VK_NULL_HANDLE;
+		vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &module);
+		modules.push_back(module);
+		return module;
+	};
+
+	// One layout without push constants for the matrix, and one with.
+	// The descriptor sets, and the texture push constant of bindless
+	// textures, are the same as in the layout that this run uses
+	VkPipelineLayout layouts[2] =
+	{
+		create_pipeline_layout(false, false),
+		create_pipeline_layout(true, false)
+	};
+
+	// Every vertex shader that prepare_pipeline can pick, with the
+	// depth-only shader that prepare_depth_prepass picks next to it
+	struct VertexPath
+	{
+		VkShaderModule vertModule;
+		VkShaderModule depthModule;
+		bool push;
+		bool instancing;
+		bool animation;
+	};
+
+	VkShaderModule depthInstanced = makeModule(vs_depth_instanced_code, sizeof(vs_depth_instanced_code), false);
+
+	VertexPath paths[] =
+	{
+		{ makeModule(vs_code, sizeof(vs_code), false), makeModule(vs_depth_code, sizeof(vs_depth_code), false), false, false, false },
+		{ makeModule(vs_push_code, sizeof(vs_push_code), false), makeModule(vs_depth_push_code, sizeof(vs_depth_push_code), false), true, false, false },
+		{ makeModule(vs_instanced_code, sizeof(vs_instanced_code), false), depthInstanced, false, true, false },
+		{ makeModule(vs_instanced_push_code, sizeof(vs_instanced_push_code), false), makeModule(vs_depth_instanced_push_code, sizeof(vs_depth_instanced_push_code), false), true, true, false },
+		{ makeModule(vs_animated_code, sizeof(vs_animated_code), false), depthInstanced, false, true, true }
+	};
+
+	// The fragment shaders need the descriptors of this run, so bindless
+	// textures and texture arrays only have their own. The half precision
+	// shader is only there when the device was made with 16-bit floats
+	std::vector<VkShaderModule> fragModules;
+
+	if (use_texture_arrays)
+		fragModules.push_back(makeModule(fs_array_code, sizeof(fs_array_code), true));
+	else if (use_bindless_textures)
+		fragModules.push_back(makeModule(fs_bindless_code, sizeof(fs_bindless_code), true));
+	else
+	{
+		fragModules.push_back(makeModule(fs_code, sizeof(fs_code), true));
+
+		if (use_half_precision)
+			fragModules.push_back(makeModule(fs_half_code, sizeof(fs_half_code), true));
+	}
+
+	// Compact vertices are only there when the GPU can read
+	// their formats, the same check as prepare_vb_ib
+	VkFormatProperties posProps;
+	VkFormatProperties uvProps;
+	vkGetPhysicalDeviceFormatProperties(gpu, VK_FORMAT_R16G16B16A16_SFLOAT, &posProps);
+	vkGetPhysicalDeviceFormatProperties(gpu, VK_FORMAT_R16G16_UNORM, &uvProps);
+
+	bool compactSupported =
+		(posProps.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) &&
+		(uvProps.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT);
+
+	// Every pipeline is a job of the pipeline compiler, so the driver
+	// compiles them on all of its threads at the same time. The render
+	// pass is the one of this run, so the depth-only pipelines are only
+	// made with the pre-pass, which has the subpass that they draw in
+	PipelineCompiler compiler(PIPELINE_COMPILER_MAX_THREADS);
+	std::vector<std::shared_future<VkPipeline>> futures;
+
+	CpuClock::time_point start = CpuClock::now();
+
+	for (const VertexPath& path : paths)
+	{
+		for (uint32_t compact = 0; compact < (compactSupported ? 2u : 1u); compact++)
+		{
+			PipelineVariant variant = {};
+			variant.layout = layouts[path.push ? 1 : 0];
+			variant.vertModule = path.vertModule;
+			variant.depthModule = path.depthModule;
+			variant.positionStride = compact ? sizeof(CompactVertexStructure::position) : sizeof(VertexStructure::position);
+			variant.instancing = path.instancing;
+			variant.animation = path.animation;
+			variant.pulling = false;
+			variant.compact = (compact != 0);
+
+			for (VkShaderModule fragModule : fragModules)
+			{
+				variant.fragModule = fragModule;
+				futures.push_back(compiler.Submit([this, variant]() { return create_pipeline(0, VK_NULL_HANDLE, false, false, &variant); }));
+			}
+
+			if (use_depth_prepass)
+				futures.push_back(compiler.Submit([this, variant]() { return create_pipeline(0, VK_NULL_HANDLE, true, false, &variant); }));
+		}
+	}
+
+	// The pipelines themselves are never used, only
+	// what the driver compiled for them, in the cache
+	uint32_t madeCount = 0;
+
+	for (std::shared_future<VkPipeline>& future : futures)
+	{
+		VkPipeline made = future.get();
+
+		if (made != VK_NULL_HANDLE)
+			madeCount++;
+
+		vkDestroyPipeline(device, made, HostAllocator::callbacks);
+	}
+
+	float ms = std::chrono::duration<float>(CpuClock::now() - start).count() * 1000.0f;
+
+	// With pipeline libraries, most of those pipelines were only
+	// linked, each shader and vertex format was compiled once
+	if (pipeline_library != nullptr)
+		printf("Prewarm compiled %u pipeline parts, and reused %u\n", pipeline_library->GetPartCount(), pipeline_library->GetReuseCount());
+
+	for (VkShaderModule module : modules)
+	{
+		forget_pipeline_parts((uint64_t)module);
+		vkDestroyShaderModule(device, module, HostAllocator::callbacks);
+	}
+
+	forget_pipeline_parts((uint64_t)layouts[0]);
+	forget_pipeline_parts((uint64_t)layouts[1]);
+	vkDestroyPipelineLayout(device, layouts[0], HostAllocator::callbacks);
+	vkDestroyPipelineLayout(device, layouts[1], HostAllocator::callbacks);
+
+	printf("Prewarmed %u of %u pipelines on %u threads in %.1f ms\n", madeCount, (uint32_t)futures.size(), PIPELINE_COMPILER_MAX_THREADS, ms);
+
+	// saved now, and not only when the program closes,
+	// so the cache is there even if this run crashes
+	save_pipeline_cache();
+}
+
+void Demo::prepare_depth_prepass()
+{
+	// The depth-only vertex shaders are the same as the normal ones,
+	// without the UV, see cube_depth.vert. They are always taken from
+	// the .inc files, because only the normal ones are hot reloaded
+	const unsigned char vs_code[] = {
+		#include "cube_depth.vert.inc"
+	};
+
+	const unsigned char vs_push_code[] = {
+		#include "cube_depth_push.vert.inc"
+	};
+
+	const unsigned char vs_instanced_code[] = {
+		#include "cube_depth_instanced.vert.inc"
+	};
+
+	const unsigned char vs_instanced_push_code[] = {
+		#include "cube_depth_instanced_push.vert.inc"
+	};
+
+	// pick the shader the same way as prepare_pipeline
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = (uint32_t*)(use_push_constants ? vs_push_code : vs_code);
+	shaderInfo.codeSize = use_push_constants ? sizeof(vs_push_code) : sizeof(vs_code);
+
+	if (use_instancing)
+	{
+		shaderInfo.pCode = (uint32_t*)(use_push_constants ? vs_instanced_push_code : vs_instanced_code);
+		shaderInfo.codeSize = use_push_constants ? sizeof(vs_instanced_push_code) : sizeof(vs_instanced_code);
+	}
+
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &depth_vert_shader_module);
+
+	// it uses the same layout as the main pipeline, so the
+	// descriptors and push constants are the same in both passes
+	depth_pipeline = create_pipeline(0, VK_NULL_HANDLE, true);
+
+	// the boxes of the occlusion queries are drawn in the pre-pass too
+	if (use_occlusion_queries)
+		occlusion_pipeline = create_pipeline(0, VK_NULL_HANDLE, true, true);
+
+	forget_pipeline_parts((uint64_t)depth_vert_shader_module);
+	vkDestroyShaderModule(device, depth_vert_shader_module, HostAllocator::callbacks);
+
+	// The pre-pass has its own secondary command buffers, because
+	// they are executed in the first subpass, with the same slices
+	prepass_recorder = new CommandRecorder(device, graphics_queue_family_index, frame_lag, job_system, recorder->GetThreadCount());
+}
+
+void Demo::prepare_shadow_cache()
+{
+	// The light is the sun, which is so far away that its rays are
+	// parallel, so the map is an orthographic projection, which is
+	// big enough for every object of the scene, from above
+	glm::vec3 low = glm::vec3(1e30f);
+	glm::vec3 high = glm::vec3(-1e30f);
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		glm::vec3 position = object_transforms.GetPosition(i);
+		low = glm::min(low, position);
+		high = glm::max(high, position);
+	}
+
+	// the positions are the centers of the objects, so
+	// there is some more room for the size of each one
+	glm::vec3 center = (low + high) * 0.5f;
+	float radius = glm::length(high - low) * 0.5f + 2.0f;
+	glm::vec3 direction = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+
+	glm::mat4x4 view = glm::lookAt(center - direction * radius * 2.0f, center, glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4x4 projection = glm::ortho(-radius, radius, -radius, radius, radius, radius * 3.0f);
+	shadow_matrix = projection * view;
+
+	// In the generated scene, only the animated objects move.
+	// Without it, every cube spins, so every cube is dynamic
+	shadow_mvps.resize(scene_object_count);
+	shadow_dynamic.assign(scene_object_count, use_scene_generator ? 0 : 1);
+
+	if (use_scene_generator)
+	{
+		for (uint32_t i : scene_generator->animated)
+			shadow_dynamic[i] = 1;
+	}
+
+	// the casters read the position buffer of the mesh
+	// pool, like the depth pre-pass, see prepare_vb_ib
+	VkFormat positionFormat = use_compact_vertices ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R32G32B32_SFLOAT;
+
+	shadow_cache = new ShadowCache(device, allocator);
+	shadow_cache->PreparePipeline(pipelineCache, positionFormat, position_stride);
+}
+
+ShadowCaster Demo::get_shadow_caster(uint32_t object)
+{
+	// The shadow does not depend on where the camera is, so every
+	// caster is drawn with the first LOD, in the range of its mesh,
+	// the same way as record_draws
+	const MeshLod& lod = mesh_lods[0];
+
+	ShadowCaster caster = {};
+	caster.mvp = shadow_mvps[object];
+	caster.indexCount = lod.indexCount;
+	caster.firstIndex = lod.firstIndex;
+	caster.vertexOffset = (int32_t)cube_mesh.firstVertex;
+
+	if (scene_meshes.size() > 1)
+	{
+		const MeshRange& range = scene_meshes[scene_generator->meshes[object] % scene_meshes.size()];
+		caster.firstIndex = range.firstIndex + (lod.firstIndex - cube_mesh.firstIndex);
+		caster.vertexOffset = (int32_t)range.firstVertex;
+	}
+
+	return caster;
+}
+
+void Demo::update_shadow_casters()
+{
+	// the matrix of every object, as the light sees it
+	TransformBatch(&object_transforms, 0, scene_object_count, shadow_matrix, nullptr, shadow_mvps.data());
+
+	shadow_dynamic_casters.clear();
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		if (shadow_dynamic[i])
+			shadow_dynamic_casters.push_back(get_shadow_caster(i));
+	}
+
+	// the static casters are only needed when their layer is drawn
+	if (!shadow_cache->NeedsStatic())
+		return;
+
+	shadow_static_casters.clear();
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		if (!shadow_dynamic[i])
+			shadow_static_casters.push_back(get_shadow_caster(i));
+	}
+}
+
+void Demo::prepare_object_picker()
+{
+	// the pick draws the position buffer, like the shadow cache
+	VkFormat positionFormat = use_compact_vertices ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R32G32B32_SFLOAT;
+
+	object_picker = new ObjectPicker(device, allocator, frame_lag);
+	object_picker->PreparePipeline(pipelineCache, positionFormat, position_stride);
+}
+
+void Demo::update_pick_draws()
+{
+	// Every object is drawn with the LOD and the matrix that the main
+	// pass uses in this frame, so the IDs cover the same pixels as the
+	// image on the screen. The ID is the object plus one, because
+	// PICK_NO_OBJECT (0) is where nothing was drawn
+	pick_draws.resize(scene_object_count);
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		const MeshLod& lod = mesh_lods[object_lods[i]];
+
+		PickDraw& draw = pick_draws[i];
+		draw.mvp = object_mvps[i];
+		draw.object = i + 1;
+		draw.indexCount = lod.indexCount;
+		draw.firstIndex = lod.firstIndex;
+		draw.vertexOffset = (int32_t)cube_mesh.firstVertex;
+
+		if (scene_meshes.size() > 1)
+		{
+			const MeshRange& range = scene_meshes[scene_generator->meshes[i] % scene_meshes.size()];
+			draw.firstIndex = range.firstIndex + (lod.firstIndex - cube_mesh.firstIndex);
+			draw.vertexOffset = (int32_t)range.firstVertex;
+		}
+	}
+}
+
+void Demo::read_pick(uint32_t slot)
+{
+	uint32_t object;
+	uint32_t x;
+	uint32_t y;
+	uint64_t frame;
+
+	if (!object_picker->Read(slot, &object, &x, &y, &frame))
+		return;
+
+	unsigned long long later = (unsigned long long)(frame_count - frame);
+
+	if (object == PICK_NO_OBJECT)
+		printf("Picked nothing at (%u, %u), %llu frames after the click\n", x, y, later);
+	else
+		printf("Picked object %u at (%u, %u), %llu frames after the click\n", object - 1, x, y, later);
+}
+
+void Demo::prepare_framebuffers()
+{
+	// Remember when we had VkImage for the swapchain 
+	// images and the depth buffer? Remember how we created
+	// a VkImageView to hold each VkImage? Here is where 
+	// that is important
+
+	// The framebuffer holds the VkImageViews that
+	// will be written to by the GPU at the end of
+	// rendering each scene. 
+	
+	// When we created the swapchain, it was mentioned that
+	// the GPU will be swapping which image in the swapchain
+	// will be sent to the screen, and which image will be 
+	// written to by the GPU.
+
+	// If we put one swapchain image into a framebuffer,
+	// we cannot change which swapchain image is in that
+	// framebuffer, and the framebuffer tells the GPU 
+	// where to render an image to (the swapchain image).
+
+	// Therefore, we need one framebuffer for each swapchain image.
+
+	// The HUD has a framebuffer for each swapchain image too, even
+	// with dynamic rendering or the offscreen target, because it
+	// always draws into the swapchain image, after everything else
+	for (uint32_t i = 0; i < swapchainImageCount; i++)
+	{
+		swapchain_image_resources[i].hudFramebuffer = VK_NULL_HANDLE;
+
+		if (use_hud)
+			swapchain_image_resources[i].hudFramebuffer = hud->CreateFramebuffer(swapchain_image_resources[i].view, width, height);
+	}
+
+	// With dynamic rendering, there are no framebuffers at all,
+	// the image views are given to the GPU every frame, so a
+	// resize makes nothing here (destroying VK_NULL_HANDLE does nothing)
+	if (use_dynamic_rendering)
+	{
+		offscreen_framebuffer = VK_NULL_HANDLE;
+
+		for (uint32_t i = 0; i < swapchainImageCount; i++)
+			swapchain_image_resources[i].framebuffer = VK_NULL_HANDLE;
+
+		return;
+	}
+
+	// We create an array of two attachments,
+	// as described in the render pass, one will
+	// be used to export color of the image, and
+	// the other will be used for writing the depth buffer
+	VkImageView attachments[3];
+
+	// The second attachment (at index 1) will be
+	// the depth buffer. That will be consistent
+	// for every framebuffer
+	attachments[1] = depthBufferGPU->imageView;
+
+	// With MSAA, every framebuffer draws into the same
+	// multisampled image, and resolves into its swapchain image
+	uint32_t swapchainAttachment = 0;
+
+	if (msaaColorGPU != nullptr)
+	{
+		attachments[0] = msaaColorGPU->imageView;
+		swapchainAttachment = 2;
+	}
+
+	// the scene color is the same for every framebuffer too
+	if (sceneColorGPU != nullptr)
+		attachments[2] = sceneColorGPU->imageView;
+
+	// we create a structure of information that will be used
+	// to create each framebuffer. sType will be the same
+	// for every FrameBufferCreateInfo
+	VkFramebufferCreateInfo fb_info = {};
+	fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+
+	// We give it the renderpass, which describes how
+	// each attachment will be used (color vs depth)
+	fb_info.renderPass = render_pass;
+
+	// We give it the array of attachments,
+	// and we mention that there are two elements
+	// in the array. Keep in mind that this is a pointer
+	// to the array, so we can change the array before
+	// submitting the CreateInfo
+	fb_info.attachmentCount = (msaaColorGPU != nullptr || sceneColorGPU != nullptr) ? 3 : 2;
+	fb_info.pAttachments = attachments;
+
+	// We give the width and height of the frameBuffer
+	// which is the same as the screen dimensions
+	fb_info.width = width;
+	fb_info.height = height;
+	
+	// We will only have one layer,
+	// don't worry about multpile layers,
+	// that is for advacned topics
+	fb_info.layers = 1;
+
+	// With the offscreen target, there is one framebuffer, which never
+	// has a swapchain image in it, and the swapchain images have no
+	// framebuffers at all (destroying VK_NULL_HANDLE does nothing)
+	offscreen_framebuffer = VK_NULL_HANDLE;
+
+	if (offscreenColorGPU != nullptr)
+	{
+		attachments[swapchainAttachment] = offscreenColorGPU->imageView;
+		vkCreateFramebuffer(device, &fb_info, HostAllocator::callbacks, &offscreen_framebuffer);
+
+		for (uint32_t i = 0; i < swapchainImageCount; i++)
+			swapchain_image_resources[i].framebuffer = VK_NULL_HANDLE;
+
+		return;
+	}
+
+	// loop through every swapchain image we have
+	for (uint32_t i = 0; i < swapchainImageCount; i++)
+	{
+		// set the first member of the attachment array (index 0)
+		// to the swapchain image that we want to render to, for each
+		// framebuffer
+		attachments[swapchainAttachment] = swapchain_image_resources[i].view;
+
+		// create a framebuffer for each swapchain image
+		// based on the information provided.
+		// This will be stored in the array of swapchain_image_resources
+		// along with the Image, ImageView, and commmandBuffer of each
+		// swapchain image. Command buffers for drawing will be explained soon.
+		vkCreateFramebuffer(device, &fb_info, HostAllocator::callbacks, &swapchain_image_resources[i].framebuffer);
+	}
+}
+
+void Demo::prepare_frame_cmds()
+{
+	// Rather than recording one command buffer for each swapchain
+	// image once, and submitting the same commands again and again,
+	// we record a new command buffer every frame. That way, the scene
+	// can change from one frame to the next (objects can be added or 
+	// removed), without waiting for the device to be idle.
+
+	// Each frame_index gets its own command pool. When we come back
+	// to a frame_index, we already waited for its fence, so nothing
+	// from that pool is still on the GPU, and we can reset the whole
+	// pool at once with vkResetCommandPool, which is cheaper than
+	// resetting command buffers one at a time.
+
+	// A command pool is needed to create command buffers,
+	// command buffers will handle every command that we want
+	// to give to the GPU. TRANSIENT tells the driver that the
+	// command buffers from this pool will be re-recorded very often
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = graphics_queue_family_index;
+
+	frame_cmd_pool.resize(frame_lag);
+	frame_cmd.resize(frame_lag);
+
+	for (uint32_t i = 0; i < frame_lag; i++)
+	{
+		vkCreateCommandPool(device, &poolInfo, HostAllocator::callbacks, &frame_cmd_pool[i]);
+
+		// one primary command buffer in each pool,
+		// it is submitted to the queue in draw()
+		VkCommandBufferAllocateInfo cmdInfo = {};
+		cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmdInfo.commandPool = frame_cmd_pool[i];
+		cmdInfo.commandBufferCount = 1;
+
+		vkAllocateCommandBuffers(device, &cmdInfo, &frame_cmd[i]);
+	}
+
+	// With async compute, each frame_index also has a pool
+	// in the compute family, for the culling pass
+	poolInfo.queueFamilyIndex = compute_queue_family_index;
+
+	compute_cmd_pool.resize(use_async_compute ? frame_lag : 0);
+	compute_cmd.resize(compute_cmd_pool.size());
+
+	for (size_t i = 0; i < compute_cmd_pool.size(); i++)
+	{
+		vkCreateCommandPool(device, &poolInfo, HostAllocator::callbacks, &compute_cmd_pool[i]);
+
+		VkCommandBufferAllocateInfo cmdInfo = {};
+		cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmdInfo.commandPool = compute_cmd_pool[i];
+		cmdInfo.commandBufferCount = 1;
+
+		vkAllocateCommandBuffers(device, &cmdInfo, &compute_cmd[i]);
+	}
+}
+
+void Demo::record_compute_cmd(uint32_t slot)
+{
+	// This records the culling pass of one frame_index, for the
+	// compute queue. It is the same pass that record_cmd adds
+	// to the frame graph without async compute
+	VkCommandBuffer cmd = compute_cmd[slot];
+	DeviceTable::ResetCommandPool(device, compute_cmd_pool[slot], 0);
+
+	VkCommandBufferBeginInfo cmd_buf_info = {};
+	cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	DeviceTable::BeginCommandBuffer(cmd, &cmd_buf_info);
+
+	// The draws of this slot were last read by the frame frame_lag
+	// frames ago, which draw() already waited for on the CPU, and the
+	// semaphore makes the graphics queue wait for the new draws, so
+	// there is no barrier here, only the one inside Cull
+	uint32_t firstObject = (use_dynamic_instances && !use_instance_deltas) ? slot * instance_count : 0;
+	culler->Cull(cmd, slot, object_mvps[0], mesh_lods[object_lods[0]].indexCount, mesh_lods[object_lods[0]].firstIndex, firstObject);
+
+	DeviceTable::EndCommandBuffer(cmd);
+}
+
+void Demo::record_cmd(uint32_t image, uint32_t slot)
+{
+	// This records the command buffer of one frame_index (slot),
+	// drawing into one swapchain image. It is called every
+	// frame in draw(), after the swapchain image is acquired
+	VkCommandBuffer cmd = frame_cmd[slot];
+
+	// Create the information needed to start the command buffer,
+	// we give it the required sType to get started
+	// This command buffer is only submitted once, before
+	// it is recorded again, so we tell the driver that
+	VkCommandBufferBeginInfo cmd_buf_info = {};
+	cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	// With a device group, this slot is only drawn by its own GPU
+	VkDeviceGroupCommandBufferBeginInfoKHR groupBeginInfo = {};
+	groupBeginInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_COMMAND_BUFFER_BEGIN_INFO_KHR;
+	groupBeginInfo.deviceMask = 1u << (slot % device_group_count);
+
+	if (use_device_group)
+		cmd_buf_info.pNext = &groupBeginInfo;
+
+	// Set our clear colors. This sets the background 
+	// color to "cornflower blue", which was the default
+	// clear color for XNA and MonoGame, it looks nice,
+	// but literally this can be anything
+	VkClearValue clear_values[3];
+	clear_values[0].color.float32[0] = 100.0f / 255.0f;
+	clear_values[0].color.float32[1] = 149.0f / 255.0f;
+	clear_values[0].color.float32[2] = 237.0f / 255.0f;
+	clear_values[0].color.float32[3] = 0.0f;
+	
+	// reset depth to maximum depth, so that we can draw over it
+	clear_values[1].depthStencil.depth = 1.0f;
+	clear_values[1].depthStencil.stencil = 0;
+
+	// with the post subpass, the scene color is cleared
+	// instead of the first attachment, which is not loaded
+	clear_values[2] = clear_values[0];
+
+	// setup everything we need to begin using a render pass,
+	// give it the render pass we made, give it the dimensions
+	// of the window, give it the 2 clear values (color and depth)
+	VkRenderPassBeginInfo rp_begin = {};
+	rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	rp_begin.renderPass = render_pass;
+	rp_begin.renderArea.extent.width = render_width;
+	rp_begin.renderArea.extent.height = render_height;
+	rp_begin.clearValueCount = use_post_subpass ? 3 : 2;
+	rp_begin.pClearValues = clear_values;
+
+	// The RenderPassBeginInfo needs a framebuffer to know which
+	// image and depth buffer to render to, so give the framebuffer
+	// that is in the array of swapchain_image_resources
+	rp_begin.framebuffer = swapchain_image_resources[image].framebuffer;
+
+	// the offscreen framebuffer is the same for every swapchain image
+	if (use_offscreen_target)
+		rp_begin.framebuffer = offscreen_framebuffer;
+
+	// begin our command buffer
+	// we can now put commands into this command buffer
+	DeviceTable::BeginCommandBuffer(cmd, &cmd_buf_info);
+
+	// write a timestamp before anything else happens in this frame,
+	// this also reads the timestamps from the last use of this slot
+	gpu_timer->Begin(cmd, slot);
+
+	// the secondary command buffers of this frame count their binds again
+	draw_state_stats.recorded = 0;
+	draw_state_stats.elided = 0;
+	draw_state_stats.draws = 0;
+
+	// The passes of the frame are added to the frame graph, with what
+	// they read and write, and the graph records the barriers between
+	// them (see FrameGraph.cpp). The graph remembers the resources from
+	// the last frame, so the first passes wait for the last frame too
+	frame_graph->SetImage(graph_depth, depthBufferGPU->image, depth_aspect, 1);
+
+	// The matrices that changed in this frame are copied into the
+	// instance buffer before anything reads it, the culling pass or
+	// the draws. A frame where nothing moved has no pass at all
+	if (use_instance_deltas)
+	{
+		frame_graph->SetBuffer(graph_instances, instanceDataGPU.buffer);
+
+		if (instance_scatter->GetCount(slot) > 0)
+		{
+			uint32_t pass = frame_graph->AddPass("Instance deltas",
+				[this, slot](VkCommandBuffer c) { instance_scatter->Record(c, slot); });
+
+			frame_graph->Use(pass, graph_instances, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+		}
+	}
+
+	// The culling pass is a compute shader, so it has to
+	// run before the render pass begins. It uses the MVP of
+	// this frame, from update_uniform_buffer
+	// With async compute, it already ran on the compute queue (see
+	// record_compute_cmd), and the render pass waits for it with a
+	// semaphore, so the graph only needs to know about the buffers
+	if (use_gpu_culling && use_async_compute)
+	{
+		frame_graph->SetBuffer(graph_draws, culler->drawBuffer->buffer);
+		frame_graph->SetBuffer(graph_counts, culler->countBuffer->buffer);
+	}
+
+	if (use_gpu_culling && !use_async_compute)
+	{
+		frame_graph->SetBuffer(graph_draws, culler->drawBuffer->buffer);
+		frame_graph->SetBuffer(graph_counts, culler->countBuffer->buffer);
+		frame_graph->SetBuffer(graph_occlusion, culler->occlusionBuffer->buffer);
+
+		// the depth buffer still has the last frame in it,
+		// this is the last time it is read before it is cleared
+		if (use_occlusion_culling)
+		{
+			frame_graph->SetImage(graph_pyramid, hiz_pyramid->image->image, VK_IMAGE_ASPECT_COLOR_BIT, hiz_pyramid->levels);
+
+			uint32_t pass = frame_graph->AddPass("Depth pyramid",
+				[this](VkCommandBuffer c) { hiz_pass->Build(c, hiz_pyramid); });
+
+			// nothing has drawn into a new depth buffer yet,
+			// so the pyramid does not read it (see HiZPass::Build)
+			if (hiz_pyramid->hasDepth)
+				frame_graph->Use(pass, graph_depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
+			// every level is made again, what it had before does not matter
+			frame_graph->Use(pass, graph_pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, FRAME_ACCESS_DISCARD);
+		}
+
+		// with dynamic instances, this frame has its own slice of
+		// the instances, unless the deltas keep them in one buffer
+		uint32_t firstObject = (use_dynamic_instances && !use_instance_deltas) ? slot * instance_count : 0;
+
+		uint32_t pass = frame_graph->AddPass("GPU culling",
+			[this, slot, firstObject](VkCommandBuffer c)
+			{
+				culler->Cull(c, slot, object_mvps[0], mesh_lods[object_lods[0]].indexCount, mesh_lods[object_lods[0]].firstIndex, firstObject, hiz_pyramid);
+			});
+
+		frame_graph->Use(pass, graph_draws, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		frame_graph->Use(pass, graph_counts, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		frame_graph->Use(pass, graph_occlusion, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		if (use_occlusion_culling)
+			frame_graph->Use(pass, graph_pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+
+		if (use_instance_deltas)
+			frame_graph->Use(pass, graph_instances, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	// The rates of the shading rate image are written again when the
+	// size that is drawn changes (with dynamic resolution, or when the
+	// window is resized), and copied before the render pass reads them
+	if (use_shading_rate_image)
+	{
+		frame_graph->SetImage(graph_shading_rate, shading_rate_image->image->image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+		if (shading_rate_image->Update(slot, render_width, render_height))
+		{
+			uint32_t pass = frame_graph->AddPass("Shading rate",
+				[this, slot](VkCommandBuffer c) { shading_rate_image->Record(c, slot); });
+
+			frame_graph->Use(pass, graph_shading_rate, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, FRAME_ACCESS_DISCARD);
+		}
+	}
+
+	// The queries are reset outside of the render pass, and the first
+	// reset fills the predicates, before any query was copied to them
+	if (use_occlusion_queries)
+	{
+		frame_graph->SetBuffer(graph_predicates, occlusion_queries->predicates.buffer);
+
+		bool clear = occlusion_queries->NeedsClear();
+		uint32_t pass = frame_graph->AddPass("Occlusion reset",
+			[this](VkCommandBuffer c) { occlusion_queries->Reset(c); });
+
+		if (clear)
+			frame_graph->Use(pass, graph_predicates, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+
+	// The cube is skinned before anything draws it. Bone 1 swings the
+	// top of the cube around the Z axis, through the middle of the cube,
+	// so its bind pose is where the bone starts, and the matrix of each
+	// bone is only its rotation. It stops while the animation is paused
+	bool skinPositions = use_depth_prepass || use_shadow_cache || use_gpu_picking;
+
+	if (use_compute_skinning)
+	{
+		float time = std::chrono::duration<float>((animation_paused ? pause_start : CpuClock::now()) - animation_start).count();
+
+		glm::mat4 bones[2];
+		bones[0] = glm::mat4(1.0f);
+		bones[1] = glm::rotate(glm::mat4(1.0f), sinf(time * 2.0f) * 0.6f, glm::vec3(0.0f, 0.0f, 1.0f));
+
+		frame_graph->SetBuffer(graph_mesh_vertices, mesh_pool->vertexBuffer.buffer);
+
+		if (skinPositions)
+			frame_graph->SetBuffer(graph_mesh_positions, mesh_pool->positionBuffer.buffer);
+
+		uint32_t pass = frame_graph->AddPass("Skinning",
+			[this, bones](VkCommandBuffer c) { skinning_pass->Skin(c, bones, 2); });
+
+		frame_graph->Use(pass, graph_mesh_vertices, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+		if (skinPositions)
+			frame_graph->Use(pass, graph_mesh_positions, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	// The shadow map is drawn before the render pass, which is where
+	// it would be read. Most frames only draw the objects that moved,
+	// the layers have their own barriers, see ShadowCache.cpp
+	if (use_shadow_cache)
+	{
+		uint32_t shadowPass = frame_graph->AddPass("Shadow map",
+			[this](VkCommandBuffer c)
+			{
+				shadow_cache->Record(c, mesh_pool->positionBuffer.buffer, mesh_pool->indexBuffer.buffer, mesh_pool->GetIndexType(),
+					shadow_static_casters, shadow_dynamic_casters);
+			});
+
+		// the casters are drawn from the skinned positions
+		if (use_compute_skinning)
+			frame_graph->Use(shadowPass, graph_mesh_positions, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+
+	// The particles move before the render pass draws them. They move
+	// by the time since the last frame, and stop while the animation is
+	// paused. The steps inside of the pass have their own barriers, the
+	// graph waits for the draw of the last frame, and the draw waits for it
+	if (use_gpu_particles)
+	{
+		CpuClock::time_point now = CpuClock::now();
+		float dt = std::min(std::chrono::duration<float>(now - particle_time).count(), 0.1f);
+		particle_time = now;
+
+		if (animation_paused)
+			dt = 0.0f;
+
+		particle_emit_accumulator += dt * particle_emit_rate;
+		uint32_t emitCount = (uint32_t)particle_emit_accumulator;
+		particle_emit_accumulator -= emitCount;
+
+		frame_graph->SetBuffer(graph_particle_counters, particle_system->counterBuffer->buffer);
+		frame_graph->SetBuffer(graph_particle_instances, particle_system->instanceBuffer->buffer);
+
+		uint32_t pass = frame_graph->AddPass("Particles",
+			[this, dt, emitCount](VkCommandBuffer c)
+			{
+				const MeshLod& lod = mesh_lods.back();
+				particle_system->Update(c, dt, emitCount, lod.indexCount, lod.firstIndex, (int32_t)cube_mesh.firstVertex);
+			});
+
+		frame_graph->Use(pass, graph_particle_counters, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		frame_graph->Use(pass, graph_particle_instances, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	// The draws of the render pass are recorded by several threads (see
+	// record_render_pass). The render pass waits for its attachments with
+	// its own subpass dependencies (see prepare_render_pass), so the graph
+	// only remembers that it wrote them.
+	// With dynamic rendering, there are no subpass dependencies, so the
+	// graph records the barriers for the attachments, and changes their
+	// layouts. They are all cleared, so their old contents are thrown away
+	uint32_t renderPass = frame_graph->AddPass("Render pass",
+		[this, &rp_begin, image, slot](VkCommandBuffer c) { record_render_pass(c, rp_begin, image, slot); });
+
+	uint32_t attachmentFlags = use_dynamic_rendering ? FRAME_ACCESS_DISCARD : FRAME_ACCESS_RENDER_PASS;
+
+	// the images of each phase might share memory with the images
+	// of another phase, see TransientPool.cpp. The first pass of
+	// the frame is the culling phase, or the render pass without it
+	transient_pool->AddAliasBarriers(frame_graph, 0, FRAME_PHASE_CULLING);
+	transient_pool->AddAliasBarriers(frame_graph, renderPass, FRAME_PHASE_RENDER_PASS);
+
+	// The render pass leaves the depth in its finalLayout, dynamic
+	// rendering leaves it in the layout that it was drawn in, and the
+	// depth pyramid of the next frame changes it to the layout it reads
+	VkImageLayout depthLayout = (use_occlusion_culling || use_temporal_upscale) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	if (use_dynamic_rendering)
+		depthLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	frame_graph->Use(renderPass, graph_depth,
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		depthLayout, attachmentFlags);
+
+	// the multisampled color is only used inside of the render pass
+	if (use_dynamic_rendering && msaaColorGPU != nullptr)
+	{
+		frame_graph->SetImage(graph_msaa, msaaColorGPU->image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		frame_graph->Use(renderPass, graph_msaa, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, FRAME_ACCESS_DISCARD);
+	}
+
+	// the rasterizer reads the shading rate image, it is only
+	// ever attached with dynamic rendering
+	if (use_shading_rate_image)
+	{
+		frame_graph->Use(renderPass, graph_shading_rate, VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR,
+			VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR, VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR);
+	}
+
+	// the instances that the scatter pass wrote
+	if (use_instance_deltas)
+		frame_graph->Use(renderPass, graph_instances, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+	// the draws read the commands that the culling pass wrote
+	if (use_gpu_culling)
+	{
+		frame_graph->Use(renderPass, graph_draws, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+		frame_graph->Use(renderPass, graph_counts, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+	}
+
+	// Every pass of the render pass draws the skinned vertices, vertex
+	// pulling reads them in the vertex shader, and the depth pre-pass
+	// reads the positions
+	if (use_compute_skinning)
+	{
+		frame_graph->Use(renderPass, graph_mesh_vertices, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+		if (skinPositions)
+			frame_graph->Use(renderPass, graph_mesh_positions, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+
+	// the particles are drawn with the draw command and
+	// the instances that the simulation just wrote
+	if (use_gpu_particles)
+	{
+		frame_graph->Use(renderPass, graph_particle_counters, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+		frame_graph->Use(renderPass, graph_particle_instances, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+
+	// The draws read the predicates of the last frame, and then the
+	// results of this frame are copied over them, for the next frame
+	if (use_occlusion_queries)
+	{
+		frame_graph->Use(renderPass, graph_predicates, VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT,
+			VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT);
+
+		uint32_t pass = frame_graph->AddPass("Occlusion results",
+			[this](VkCommandBuffer c) { occlusion_queries->CopyResults(c); });
+
+		frame_graph->Use(pass, graph_predicates, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+
+	// The pick has its own images, so it can go anywhere after the
+	// skinning, the graph only has to know about the positions that
+	// it reads. The copy into the buffer of this slot is a part of it
+	if (object_picker != nullptr && object_picker->HasRequest())
+	{
+		uint64_t frame = frame_count;
+
+		uint32_t pass = frame_graph->AddPass("Pick",
+			[this, slot, frame](VkCommandBuffer c)
+			{
+				object_picker->Record(c, slot, frame, render_width, render_height, mesh_pool->positionBuffer.buffer,
+					mesh_pool->indexBuffer.buffer, mesh_pool->GetIndexType(), pick_draws);
+			});
+
+		if (use_compute_skinning)
+			frame_graph->Use(pass, graph_mesh_positions, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+
+	// copy (and scale) the offscreen image to the swapchain image
+	if (use_offscreen_target)
+	{
+		// with dynamic rendering, the upscale changes it to TRANSFER_SRC
+		frame_graph->SetImage(graph_offscreen, offscreenColorGPU->image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		frame_graph->Use(renderPass, graph_offscreen, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			use_dynamic_rendering ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, attachmentFlags);
+
+		// The swapchain image was not written in this frame, so its old
+		// contents are thrown away (UNDEFINED). The wait for the acquire
+		// semaphore is at COLOR_ATTACHMENT_OUTPUT (see draw), so the
+		// barrier starts at that stage, to come after the wait
+		frame_graph->SetImage(graph_swapchain, swapchain_image_resources[image].image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		frame_graph->Reset(graph_swapchain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+		// The temporal upscaler reads the image that was drawn, the
+		// depth, and the history of the last frame, and writes the other
+		// history image, which is then blitted instead of the offscreen
+		// image. It is the first pass of the upscale phase
+		uint32_t blitSource = graph_offscreen;
+		uint32_t pass;
+
+		if (use_temporal_upscale)
+		{
+			temporal_history->Swap();
+			uint32_t written = graph_history[temporal_history->current];
+			uint32_t read = graph_history[1 - temporal_history->current];
+
+			frame_graph->SetImage(written, temporal_history->images[temporal_history->current]->image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+			frame_graph->SetImage(read, temporal_history->images[1 - temporal_history->current]->image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+			pass = frame_graph->AddPass("Temporal upscale",
+				[this](VkCommandBuffer c) { record_temporal(c); });
+
+			transient_pool->AddAliasBarriers(frame_graph, pass, FRAME_PHASE_UPSCALE);
+
+			frame_graph->Use(pass, graph_offscreen, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			frame_graph->Use(pass, graph_depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			frame_graph->Use(pass, read, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			frame_graph->Use(pass, written, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, FRAME_ACCESS_DISCARD);
+
+			blitSource = written;
+		}
+
+		pass = frame_graph->AddPass("Upscale",
+			[this, image](VkCommandBuffer c) { record_upscale(c, image); });
+
+		if (!use_temporal_upscale)
+			transient_pool->AddAliasBarriers(frame_graph, pass, FRAME_PHASE_UPSCALE);
+
+		frame_graph->Use(pass, blitSource, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		frame_graph->Use(pass, graph_swapchain, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, FRAME_ACCESS_DISCARD);
+
+		// The same image is scaled into every output window that has an
+		// image in this frame. Their swapchain images are not resources
+		// of the graph, each window makes its own barriers (see RecordBlit)
+		if (use_output_windows)
+		{
+			pass = frame_graph->AddPass("Output windows",
+				[this](VkCommandBuffer c)
+				{
+					VkImage source = offscreenColorGPU->image;
+					uint32_t sourceWidth = render_width;
+					uint32_t sourceHeight = render_height;
+
+					if (use_temporal_upscale)
+					{
+						source = temporal_history->images[temporal_history->current]->image;
+						sourceWidth = width;
+						sourceHeight = height;
+					}
+
+					for (size_t i = 0; i < output_windows.size(); i++)
+					{
+						if (output_windows[i]->currentImage != UINT32_MAX)
+							output_windows[i]->RecordBlit(c, source, sourceWidth, sourceHeight);
+					}
+				});
+
+			frame_graph->Use(pass, blitSource, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		}
+	}
+
+	// Without the offscreen target, the render pass draws into the
+	// swapchain image, and only a capture or the HUD needs to know
+	// about it. Dynamic rendering needs the graph to change its layout
+	bool capture = use_frame_capture && (frame_count % capture_interval) == 0;
+
+	// The encoder gets every frame that it has a free slot for. When it
+	// is behind, this frame is dropped, and nothing waits for it
+	uint32_t encodeSlot = UINT32_MAX;
+	encode_number = 0;
+
+	if (use_encoder_output)
+		encodeSlot = encoder_bridge->Begin(&encode_number);
+
+	bool encode = (encodeSlot != UINT32_MAX);
+
+	if ((capture || encode || use_dynamic_rendering || use_hud) && !use_offscreen_target)
+	{
+		frame_graph->SetImage(graph_swapchain, swapchain_image_resources[image].image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		frame_graph->Reset(graph_swapchain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		frame_graph->Use(renderPass, graph_swapchain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			use_dynamic_rendering ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : present_layout, attachmentFlags);
+	}
+
+	// copy the finished image into this slot's capture buffer
+	if (capture)
+	{
+		uint64_t frame = frame_count;
+
+		uint32_t pass = frame_graph->AddPass("Capture",
+			[this, slot, image, frame](VkCommandBuffer c)
+			{
+				frame_capture->Record(c, slot, swapchain_image_resources[image].image, width, height, frame);
+			});
+
+		frame_graph->Use(pass, graph_swapchain, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	}
+
+	// blit the finished image into the encoder's slot, on the GPU
+	if (encode)
+	{
+		uint32_t pass = frame_graph->AddPass("Encode",
+			[this, encodeSlot, image](VkCommandBuffer c)
+			{
+				encoder_bridge->Record(c, encodeSlot, swapchain_image_resources[image].image, width, height);
+			});
+
+		frame_graph->Use(pass, graph_swapchain, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	}
+
+	// The HUD comes after the capture, so the saved images are only the
+	// scene. It blends on top of the image, so it reads and writes it
+	if (use_hud)
+	{
+		uint32_t pass = frame_graph->AddPass("HUD",
+			[this, slot, image](VkCommandBuffer c) { record_hud(c, slot, image); });
+
+		frame_graph->Use(pass, graph_swapchain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	}
+
+	// and then the swapchain image is ready to be presented
+	if (use_offscreen_target || capture || encode || use_dynamic_rendering || use_hud)
+	{
+		uint32_t pass = frame_graph->AddPass("Present", nullptr);
+		frame_graph->Use(pass, graph_swapchain, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, present_layout);
+	}
+
+	frame_graph->Execute(cmd);
+
+	gpu_timer->Mark(cmd, slot, GPU_TIMESTAMP_PASS_END);
+	gpu_timer->End(cmd, slot);
+
+	// end our command buffer
+	DeviceTable::EndCommandBuffer(cmd);
+}
+
+void Demo::save_capture(uint32_t slot)
+{
+	uint32_t captureWidth;
+	uint32_t captureHeight;
+	uint64_t frame;
+
+	const uint8_t* pixels = frame_capture->Read(slot, &captureWidth, &captureHeight, &frame);
+
+	if (pixels == nullptr)
+		return;
+
+	char path[64];
+	snprintf(path, sizeof(path), "capture_%05llu.ppm", (unsigned long long)frame);
+
+	frame_capture->Save(path, pixels, captureWidth, captureHeight);
+}
+
+void Demo::record_hud(VkCommandBuffer cmd, uint32_t slot, uint32_t image)
+{
+	// The CPU time is the same as in finish_benchmark, and the draws
+	// are the ones of this frame, the render pass was recorded before
+	double cpuMs =
+		cpu_profiler->GetAverage(CPU_MARKER_UPDATE_UNIFORMS) +
+		cpu_profiler->GetAverage(CPU_MARKER_ACQUIRE) +
+		cpu_profiler->GetAverage(CPU_MARKER_RECORD) +
+		cpu_profiler->GetAverage(CPU_MARKER_SUBMIT) +
+		cpu_profiler->GetAverage(CPU_MARKER_PRESENT);
+
+	// all of the heaps together, usage is what the driver
+	// says that our process uses, if it has the memory budget
+	VkDeviceSize usage = 0;
+	VkDeviceSize budget = 0;
+
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+	{
+		MemoryHeapStats stats = allocator->GetHeapStats(i);
+		usage += stats.usage;
+		budget += stats.budget;
+	}
+
+	char text[512];
+	snprintf(text, sizeof(text),
+		"CPU %.2f MS\n"
+		"GPU %.2f MS\n"
+		"PRESENT %s\n"
+		"FRAMES IN FLIGHT %u\n"
+		"DRAWS %u\n"
+		"MEMORY %llu / %llu MB",
+		cpuMs,
+		gpu_timer->GetAverageFrameMs(),
+		present_mode_name(currentPresentMode),
+		frame_lag,
+		(uint32_t)draw_state_stats.draws,
+		(unsigned long long)(usage >> 20),
+		(unsigned long long)(budget >> 20));
+
+	hud->SetText(slot, text, width, height);
+	hud->Record(cmd, slot, swapchain_image_resources[image].hudFramebuffer, width, height);
+}
+
+void Demo::record_render_pass(VkCommandBuffer cmd, const VkRenderPassBeginInfo& rp_begin, uint32_t image, uint32_t slot)
+{
+	// the render pass is timed by itself, without the culling pass
+	gpu_timer->Mark(cmd, slot, GPU_TIMESTAMP_PASS_BEGIN);
+
+	// the query counts every draw in the render pass, it
+	// begins out here, because it is reset in Begin
+	if (use_pipeline_statistics)
+		pipeline_stats->Begin(cmd, slot, render_width, render_height);
+
+	// the hardware counters of the render pass, which
+	// can not begin inside of it either, see Begin
+	if (use_performance_counters)
+		performance_counters->Begin(cmd, slot);
+
+	// With dynamic rendering, the attachments are the image views of
+	// this frame, with the same load and store ops as the attachments
+	// of prepare_render_pass. The frame graph already changed their
+	// layouts, and the graph changes them again after the render pass
+	VkRenderingAttachmentInfoKHR colorAttachment = {};
+	colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	colorAttachment.imageView = swapchain_image_resources[image].view;
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.clearValue = rp_begin.pClearValues[0];
+
+	if (use_offscreen_target)
+		colorAttachment.imageView = offscreenColorGPU->imageView;
+
+	// With MSAA, the multisampled image is drawn into, and the
+	// samples are averaged into the image that would have been drawn
+	// into without MSAA, at the end of the render pass, like the
+	// resolve attachment of the subpass
+	if (msaaColorGPU != nullptr)
+	{
+		colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+		colorAttachment.resolveImageView = colorAttachment.imageView;
+		colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.imageView = msaaColorGPU->imageView;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+
+	VkRenderingAttachmentInfoKHR depthAttachment = {};
+	depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	depthAttachment.imageView = depthBufferGPU->imageView;
+	depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = (use_occlusion_culling || use_temporal_upscale) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.clearValue = rp_begin.pClearValues[1];
+
+	VkRenderingInfoKHR renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+	renderingInfo.renderArea = rp_begin.renderArea;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+	renderingInfo.pDepthAttachment = &depthAttachment;
+
+	// the shading rate image says how coarse each part of the
+	// screen is shaded, the depth pre-pass gets it too
+	VkRenderingFragmentShadingRateAttachmentInfoKHR shadingRateAttachment = {};
+	shadingRateAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_FRAGMENT_SHADING_RATE_ATTACHMENT_INFO_KHR;
+
+	if (use_shading_rate_image)
+	{
+		shadingRateAttachment.imageView = shading_rate_image->image->imageView;
+		shadingRateAttachment.imageLayout = VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
+		shadingRateAttachment.shadingRateAttachmentTexelSize = shading_rate_image->texelSize;
+		renderingInfo.pNext = &shadingRateAttachment;
+	}
+
+	// The draws themselves are recorded into secondary command
+	// buffers, by several threads at once (see CommandRecorder.cpp).
+	// The secondary command buffers need to know which render pass
+	// and framebuffer they will be used inside of
+	VkCommandBufferInheritanceInfo inherit = {};
+	inherit.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inherit.renderPass = render_pass;
+	inherit.subpass = 0;
+	inherit.framebuffer = rp_begin.framebuffer;
+
+	// Without a render pass, they need to know the formats
+	// and the samples of the attachments instead
+	VkCommandBufferInheritanceRenderingInfoKHR inheritRendering = {};
+	inheritRendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+	inheritRendering.colorAttachmentCount = 1;
+	inheritRendering.pColorAttachmentFormats = &format;
+	inheritRendering.depthAttachmentFormat = depth_buffer_format;
+	inheritRendering.rasterizationSamples = msaa_sample_count;
+
+	if (use_dynamic_rendering)
+	{
+		inherit.pNext = &inheritRendering;
+		inherit.framebuffer = VK_NULL_HANDLE;
+	}
+
+	// the secondary command buffers run while the pipeline statistics
+	// query is active, so they need to know which counters it has
+	if (use_pipeline_statistics)
+		inherit.pipelineStatistics = PIPELINE_STATS_FLAGS;
+
+	// the contents are SECONDARY_COMMAND_BUFFERS, because the
+	// draw commands are not recorded in this command buffer,
+	// they are recorded in secondary command buffers
+	if (!use_dynamic_rendering)
+		DeviceTable::CmdBeginRenderPass(cmd, &rp_begin, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+	// With the depth pre-pass, the first subpass draws the same
+	// scene, with the depth-only pipeline, and then the main
+	// draws are recorded for the second subpass
+	if (use_depth_prepass)
+	{
+		// With dynamic rendering, the pre-pass is rendering of its
+		// own, with only the depth, which is kept for the main draws
+		if (use_dynamic_rendering)
+		{
+			VkRenderingAttachmentInfoKHR prepassDepth = depthAttachment;
+			prepassDepth.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+			VkRenderingInfoKHR prepassInfo = renderingInfo;
+			prepassInfo.colorAttachmentCount = 0;
+			prepassInfo.pColorAttachments = nullptr;
+			prepassInfo.pDepthAttachment = &prepassDepth;
+
+			inheritRendering.colorAttachmentCount = 0;
+			fpCmdBeginRenderingKHR(cmd, &prepassInfo);
+		}
+
+		prepass_recorder->Record(slot, inherit, scene_object_count,
+			[this, slot](VkCommandBuffer secondary, uint32_t first, uint32_t count)
+			{
+				DEBUG_LABEL_BEGIN(secondary, "Depth pre-pass");
+				record_draws(secondary, slot, first, count, true);
+				DEBUG_LABEL_END(secondary);
+			},
+			&prepass_cmds);
+
+		DeviceTable::CmdExecuteCommands(cmd, (uint32_t)prepass_cmds.size(), prepass_cmds.data());
+
+		if (use_dynamic_rendering)
+		{
+			fpCmdEndRenderingKHR(cmd);
+
+			// this is the dependency between the two subpasses, the
+			// main draws test against the depth that the pre-pass wrote
+			VkMemoryBarrier depthBarrier = {};
+			depthBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+			DeviceTable::CmdPipelineBarrier(cmd,
+				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				VK_DEPENDENCY_BY_REGION_BIT, 1, &depthBarrier, 0, NULL, 0, NULL);
+
+			depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			inheritRendering.colorAttachmentCount = 1;
+		}
+		else
+		{
+			DeviceTable::CmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			inherit.subpass = 1;
+		}
+	}
+
+	if (use_dynamic_rendering)
+		fpCmdBeginRenderingKHR(cmd, &renderingInfo);
+
+	// Every thread calls record_draws, with its own
+	// secondary command buffer and its own slice of the scene
+	recorder->Record(slot, inherit, scene_object_count,
+		[this, slot](VkCommandBuffer secondary, uint32_t first, uint32_t count)
+		{
+			DEBUG_LABEL_BEGIN(secondary, "Draw objects");
+			record_draws(secondary, slot, first, count);
+			DEBUG_LABEL_END(secondary);
+		},
+		&secondary_cmds);
+
+	// run every secondary command buffer inside of our render pass
+	DeviceTable::CmdExecuteCommands(cmd, (uint32_t)secondary_cmds.size(), secondary_cmds.data());
+
+	// The post subpass is one draw, so it is recorded right here,
+	// inline, it reads what the draws above wrote, at its own pixel
+	if (use_post_subpass)
+	{
+		DeviceTable::CmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
+		post_subpass->Record(cmd, rp_begin.renderArea.extent.width, rp_begin.renderArea.extent.height);
+	}
+
+	// Note that ending the renderpass changes the image's layout from
+	// COLOR_ATTACHMENT_OPTIMAL to PRESENT_SRC_KHR.
+	// Ending dynamic rendering changes no layouts
+	if (use_dynamic_rendering)
+		fpCmdEndRenderingKHR(cmd);
+	else
+		DeviceTable::CmdEndRenderPass(cmd);
+
+	if (use_performance_counters)
+		performance_counters->End(cmd, slot);
+
+	if (use_pipeline_statistics)
+		pipeline_stats->End(cmd, slot);
+}
+
+void Demo::record_draws(VkCommandBuffer cmd, uint32_t slot, uint32_t first, uint32_t count, bool depthOnly)
+{
+	// This is called by the threads of the CommandRecorder.
+	// Secondary command buffers do not inherit any state from
+	// the primary command buffer (other than the render pass),
+	// so each one binds everything that it needs, by itself.
+	// The binds go through a CommandState, which skips a bind
+	// when the same thing is already bound, and counts them
+	CommandState state(cmd);
+
+	// Bind our pipeline, let Vulkan know that it is a GRAPHICS pipeline.
+	// There are other types of pipelines, so we need to specify GRAPHICS.
+	// The depth pre-pass binds its own pipeline, everything else is the same
+	state.BindPipeline(depthOnly ? depth_pipeline : pipeline);
+
+	// Bind our descriptor set to the GRAPHICS pipeline
+	// Multiple pipelines of different types can be bound
+	// to a command buffer at the same time.
+	// The dynamic offset picks the slice of the
+	// uniform buffer that belongs to this frame_index
+	// With push descriptors, the descriptors of this frame_index are
+	// written into the command buffer, from one struct, with one call
+	VkDescriptorSet set = (use_texture_streaming || use_placeholder_texture || use_video_texture) ?
+		streamed_sets[slot] : descriptor_set;
+
+	if (use_push_descriptors)
+		fpCmdPushDescriptorSetWithTemplateKHR(cmd, descriptor_template, pipeline_layout, 0, &descriptor_data[slot]);
+	else
+	{
+		uint32_t dynamicOffset = slot * uniform_slice_size;
+		state.BindDescriptorSet(pipeline_layout, set, dynamicOffset);
+	}
+
+	// the texture is the same for every cube, so the material
+	// set is bound once, the frame set can change under it
+	if (use_frequency_sets)
+		state.BindStaticSet(pipeline_layout, DESCRIPTOR_SET_MATERIAL, material_set);
+
+	// This sets the scale of the viewport.
+	// It takes the fully-rendered image, and scales it down to a portion of the
+	// screen provided by the dimensions specified in viewport. If you don't want to scale the
+	// image down, leave the viewport as it is. If you want to see what it does, change
+	// "width" and "height" to "width/2" and "height/2". That will draw the final image at 25% size in 
+	// the top-left corner of the window. This can be used for splitscreen multiplayer. If you want to
+	// utilize this feature, the image might look squished or stretched. To fix this, go back to 
+	// glm::perspective and change the aspect ratio to match the ratio of the  viewport. If you do not 
+	// know what glm::perspective is that comes in a future tutorial, and that means I accidentally
+	// left the comment about glm::persepctive here by mistake
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)render_width;
+	viewport.height = (float)render_height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	state.SetViewport(viewport);
+
+	// Bonus trick that you can try on your own
+	//===============================================================
+
+	// Exzap, from Cemu, has a trick where he adjusts for Vulkan's inverted Y-axis by flipping
+	// the viewport, rather than altering the projection matrix. The reason why I personally don't use 
+	// this trick here, is because it requires Vulkan 1.1, or it requires Vulkan 1.0 to use the 
+	// extension VK_KHR_MAINTENANCE1_EXTENSION_NAME. There is nothing wrong with adding the extension, 
+	// nor is there anything wrong with Vulkan 1.1, but for these simple tutorials, I want to make sure
+	// that nobody has compatibility problems. Anyone who has a GPU that supports Vulkan 1.0 should
+	// be able to run this tutorial, with only the SURFACE_EXTENSION and WIN32_EXTENSION
+
+	// However, I do use Vulkan 1.1 in other personal projects, and I flip the viewport in those projects.
+	// If anyone wants to try this trick for themselves, go back to the prepare_instance() function
+	// and enable the extension in Vulkan 1.0, or try enabling Vulkan 1.1, then delete the adjustment to the 
+	// perspective projection (in update_uniform_buffer, and in prepare_uniform_buffer), then flip 
+	// the Viewport here in this function. All Vulkan 1.0 maintenance features are in Vulkan 1.1
+
+	// And now, back to the tutorial
+
+	// Scissor tests clip to a rectangle inside that viewport.
+	// If you do not want to clip the image, then leave the 
+	// Scissor the way it is. If you want to see what it does, change
+	// "width" and "height" to "width/2" and "height/2".
+	// That will draw the final image at 100% size, but it will only
+	// draw the top-left quadrant of the window. This can be used
+	// for black cinematic bars on the screen during cutscenes.
+
+	VkRect2D rect = {};
+	rect.offset.x = 0;
+	rect.offset.y = 0;
+	rect.extent.width = render_width;
+	rect.extent.height = render_height;
+	state.SetScissor(rect);
+
+	// Bind the vertex buffer of the mesh pool
+	// The offset is zero, which means we are starting with
+	// the first vertex in the buffer, every mesh is a range of
+	// it, which the draw picks with vertexOffset. We are binding
+	// 1 buffer, which is the GPU buffer, but this can be used to
+	// bind arrays of vertex buffers
+	// With vertex pulling, nothing is bound, the shader
+	// gets the address of the same buffer instead
+	if (use_vertex_pulling)
+		state.PushConstants(pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexPullConstants), &vertex_pull_constants);
+	else
+		state.BindVertexBuffer(0, depthOnly ? mesh_pool->positionBuffer.buffer : mesh_pool->vertexBuffer.buffer, 0);
+
+	// With instancing, the instance buffer is bound at binding
+	// point 1, the GPU reads one element of it for each instance.
+	// Dynamic instances are bound at the slice of this frame,
+	// with deltas they are in the same buffer as static ones
+	if (use_instancing && (!use_dynamic_instances || use_instance_deltas))
+		state.BindVertexBuffer(1, instanceDataGPU.buffer, 0);
+
+	// the axis and the speed of every instance
+	if (use_gpu_animation)
+		state.BindVertexBuffer(2, animationDataGPU.buffer, 0);
+
+	if (use_dynamic_instances && !use_instance_deltas)
+	{
+		VkDeviceSize sliceOffset = (VkDeviceSize)slot * instance_count * sizeof(glm::mat4);
+		state.BindVertexBuffer(1, instanceDataCPU.buffer, sliceOffset);
+	}
+
+	// Bind the index buffer of the mesh pool
+	// This is a 16-bit index buffer, because the data in the buffer
+	// is an array of 'short', which each have 16 bits. A model with
+	// too many vertices for 16 bits uses VK_INDEX_TYPE_UINT32,
+	// and every mesh in the pool has the same index type
+	state.BindIndexBuffer(mesh_pool->indexBuffer.buffer, 0, mesh_pool->GetIndexType());
+
+	// With variable rate shading, the rate is set before a draw when
+	// it is not the rate that the last draw had. The rate is a dynamic
+	// state of the pipeline, so it starts unset in every command buffer.
+	// The combiners are the same as the ones of the pipeline
+	bool shadingRates = use_shading_rate && !depthOnly;
+	VkExtent2D shadingRate = { 0, 0 };
+	VkFragmentShadingRateCombinerOpKHR combinerOps[2] =
+	{
+		VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR,
+		use_shading_rate_image ? shading_rate_combiner : VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR
+	};
+
+	// With GPU culling, the GPU already wrote the draws
+	if (use_gpu_culling)
+	{
+		// the LOD of each instance is picked on the GPU,
+		// so all of them are shaded at every pixel
+		if (shadingRates)
+		{
+			shadingRate = { 1, 1 };
+			fpCmdSetFragmentShadingRateKHR(cmd, &shadingRate, combinerOps);
+		}
+
+		if (use_push_constants)
+			state.PushConstants(pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4x4), &object_mvps[0]);
+
+		// all instances are drawn together, with one texture
+		if (use_bindless_textures || use_texture_arrays)
+			state.PushConstants(pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4x4), sizeof(uint32_t), &object_textures[0]);
+
+		culler->Draw(cmd, slot);
+		state.CountDraws(1);
+
+		if (particle_system != nullptr && first + count == scene_object_count)
+			record_particle_draws(cmd, state);
+
+		state.Finish(&draw_state_stats);
+		return;
+	}
+
+	// With the render queue, the slice is a slice of the sorted
+	// packets of this pass, and each packet says which cube it is
+	const RenderPacket* packets = nullptr;
+
+	if (use_render_queue)
+	{
+		uint32_t passCount = 0;
+		packets = render_queue->GetPass(depthOnly ? RENDER_PASS_DEPTH_PREPASS : RENDER_PASS_MAIN, &passCount);
+	}
+
+	// Draw every cube in our slice of the scene
+	for (uint32_t n = first; n < first + count; n++)
+	{
+		uint32_t i = (packets != nullptr) ? packets[n].object : n;
+
+		// If we are using push constants, the MVP matrix of this
+		// cube is put directly into the command buffer
+		if (use_push_constants)
+			state.PushConstants(pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4x4), &object_mvps[i]);
+
+		// With the uniform arena, the matrix is copied into this
+		// frame's slice of the uniform buffer instead, and the same
+		// descriptor set is bound again, at the offset of the copy.
+		// If the slice is full, the cube keeps the matrix of the frame
+		if (use_uniform_arena)
+		{
+			VkDeviceSize offset = 0;
+			uniform_struct* constants = (uniform_struct*)uniform_arena->Allocate(sizeof(uniform_struct), &offset);
+
+			if (constants != nullptr)
+			{
+				constants->mvp = object_mvps[i];
+				constants->time = glm::vec4(0.0f);
+				state.BindDescriptorSet(pipeline_layout, set, (uint32_t)offset);
+			}
+		}
+
+		// With bindless textures, the index of this cube's texture
+		// is all that changes, the descriptor set stays the same.
+		// Cubes next to each other often have the same texture,
+		// then the push is skipped. A layer of the texture
+		// array is pushed the same way
+		if (use_bindless_textures || use_texture_arrays)
+			state.PushConstants(pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4x4), sizeof(uint32_t), &object_textures[i]);
+
+		if (shadingRates)
+		{
+			VkExtent2D rate = select_shading_rate(object_lods[i]);
+
+			if (rate.width != shadingRate.width || rate.height != shadingRate.height)
+			{
+				shadingRate = rate;
+				fpCmdSetFragmentShadingRateKHR(cmd, &shadingRate, combinerOps);
+			}
+		}
+
+		// With occlusion queries, the GPU skips everything until
+		// End, when the predicate of this cube is 0
+		bool conditional = use_occlusion_queries && object_conditional[i];
+
+		if (conditional)
+		{
+			VkConditionalRenderingBeginInfoEXT conditionalInfo = {};
+			conditionalInfo.sType = VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT;
+			conditionalInfo.buffer = occlusion_queries->predicates.buffer;
+			conditionalInfo.offset = occlusion_queries->GetOffset(i);
+			fpCmdBeginConditionalRenderingEXT(cmd, &conditionalInfo);
+		}
+
+		// Draw the indexed triangle
+		// We have 36 indices in the index buffer for each LOD (more
+		// for the LODs with more detail), and we draw the range of the
+		// LOD that this cube uses. We are drawing these indices instance_count times,
+		// which is one time, unless we are using instancing.
+		// The first instance has to be zero, so that the first
+		// cube in the instance buffer is used
+		// With meshlets, the draws of this cube were written by
+		// cull_meshlets, into the slice of this frame. A cube with no
+		// visible meshlets has no draws
+		if (use_meshlets)
+		{
+			VkDeviceSize drawStride = sizeof(VkDrawIndexedIndirectCommand);
+			VkDeviceSize drawOffset = ((VkDeviceSize)slot * meshlet_slice_draws + object_meshlet_first[i]) * drawStride;
+
+			if (meshlet_multi_draw && object_meshlet_count[i] > 0)
+			{
+				DeviceTable::CmdDrawIndexedIndirect(cmd, meshlet_draws_cpu.buffer, drawOffset, object_meshlet_count[i], (uint32_t)drawStride);
+				state.CountDraws(1);
+			}
+
+			for (uint32_t d = 0; d < object_meshlet_count[i] && !meshlet_multi_draw; d++)
+				DeviceTable::CmdDrawIndexedIndirect(cmd, meshlet_draws_cpu.buffer, drawOffset + d * drawStride, 1, (uint32_t)drawStride);
+
+			if (!meshlet_multi_draw)
+				state.CountDraws(object_meshlet_count[i]);
+		}
+		else
+		{
+			const MeshLod& lod = mesh_lods[object_lods[i]];
+			// with CPU culling, only the visible instances are in the buffer
+			uint32_t drawInstances = use_cpu_culling ? visible_instance_count : instance_count;
+
+			// A generated mesh has the same LODs as the cube,
+			// at the same place from the start of its indices
+			uint32_t firstIndex = lod.firstIndex;
+			uint32_t firstVertex = cube_mesh.firstVertex;
+
+			if (scene_meshes.size() > 1)
+			{
+				const MeshRange& range = scene_meshes[scene_generator->meshes[i] % scene_meshes.size()];
+				firstIndex = range.firstIndex + (lod.firstIndex - cube_mesh.firstIndex);
+				firstVertex = range.firstVertex;
+			}
+
+			DeviceTable::CmdDrawIndexed(cmd, lod.indexCount, drawInstances, firstIndex, (int32_t)firstVertex, 0);
+			state.CountDraws(1);
+		}
+
+		if (conditional)
+			fpCmdEndConditionalRenderingEXT(cmd);
+	}
+
+	// The boxes are tested after every cube of the pre-pass has written
+	// its depth, so the last slice of the pre-pass draws all of them
+	if (use_occlusion_queries && depthOnly && first + count == scene_object_count)
+		record_occlusion_boxes(cmd, state);
+
+	// the last slice also draws the voxel world
+	if (voxel_world != nullptr && first + count == scene_object_count)
+		record_voxel_draws(cmd, state);
+
+	// and the particles, in both passes, so that the main pass
+	// finds the EQUAL depth of every particle too
+	if (particle_system != nullptr && first + count == scene_object_count)
+		record_particle_draws(cmd, state);
+
+	state.Finish(&draw_state_stats);
+}
+
+void Demo::record_particle_draws(VkCommandBuffer cmd, CommandState& state)
+{
+	// Every particle is an instance of the smallest LOD of the cube,
+	// so the particles are drawn with the pipeline, the vertex buffer,
+	// and the index buffer that the cubes use, only the instances come
+	// from another buffer. The instances are in world space, like the
+	// instances of the cubes, so they use the same MVP
+	state.BindVertexBuffer(1, particle_system->instanceBuffer->buffer, 0);
+
+	if (use_push_constants)
+		state.PushConstants(pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4x4), &object_mvps[0]);
+
+	if (use_bindless_textures || use_texture_arrays)
+		state.PushConstants(pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4x4), sizeof(uint32_t), &object_textures[0]);
+
+	particle_system->Draw(cmd);
+	state.CountDraws(1);
+}
+
+void Demo::record_voxel_draws(VkCommandBuffer cmd, CommandState& state)
+{
+	// Every chunk is a range of the same buffers as the cubes, and it
+	// uses the same pipeline, so all that changes is the matrix. The
+	// indices of a chunk start at 0, and vertexOffset is its slot
+	for (const VoxelDraw& draw : voxel_draws)
+	{
+		state.PushConstants(pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4x4), &draw.mvp);
+
+		if (use_bindless_textures || use_texture_arrays)
+			state.PushConstants(pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4x4), sizeof(uint32_t), &object_textures[0]);
+
+		DeviceTable::CmdDrawIndexed(cmd, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+	}
+
+	state.CountDraws((uint32_t)voxel_draws.size());
+}
+
+void Demo::record_occlusion_boxes(VkCommandBuffer cmd, CommandState& state)
+{
+	// The box pipeline tests depth without writing it, and the
+	// query of each cube counts the pixels of its box that passed.
+	// Everything else that the pre-pass bound stays the same
+	state.BindPipeline(occlusion_pipeline);
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		state.PushConstants(pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4x4), &object_mvps[i]);
+
+		occlusion_queries->Begin(cmd, i);
+		DeviceTable::CmdDrawIndexed(cmd, occlusion_box.indexCount, 1, occlusion_box.firstIndex, (int32_t)occlusion_box.firstVertex, 0);
+		occlusion_queries->End(cmd, i);
+	}
+
+	state.CountDraws(scene_object_count);
+}
+
+void Demo::prepare()
+{
+	// We will be calling prepare() multiple times.
+	// Some Vulkan assets only need to be created once, like
+	// the instance, the device, and the queue (i'll explain those later),
+	// while some things need to be destroyed and rebuilt, like the 
+	// depth buffer and swapchain images (I'll explain those later).
+
+	// We keep track of a variable called firstInit, to determine
+	// if we have run the prepare() function before. "firstInit"
+	// is initialized as true at the top of Demo.cpp, and it is
+	// set to false after the first initialization is done
+
+	if (firstInit)
+	{
+		// Validation will tell us if our Vulkan code is correct.
+		// Sometimes, our code will execute the way we want it to,
+		// but just becasue the code runs, does not mean the code
+		// is correct. If you've ever used HTML, you may have used
+		// and HTML validator, where your website might look correct,
+		// but the validator will tell you that the code is wrong
+
+		// If you run in Debug mode, no Validator text will appear,
+		// text from Validator will only appear if you are in Release Mode
+
+		// During development, this is a great tool. However, when it is
+		// time to release a software or game, you don't want this running
+		// in the background because it will continue constantly checking for errors
+		// even if there are no errors. So this comes from layer_flags, which
+		// has validation by default in debug builds only (see Main.cpp),
+		// and it can be turned on with "-validate" in release builds too
+		validate = (layer_flags & LAYER_VALIDATION) != 0;
+
+		// The MVP matrix can be given to the vertex shader in two ways.
+		// If this is false, it is read from a uniform buffer (cube.vert).
+		// If this is true, it is written directly into the command buffer
+		// with vkCmdPushConstants (cube_push.vert), which needs no descriptor
+		// and no uniform memory.
+		// With many objects, each with their own matrix, push constants
+		// are the fastest way to give each draw its own matrix
+		use_push_constants = false;
+
+		// The number of levels of detail of the cube mesh, see
+		// build_cube_mesh. With one, the mesh is the 12 triangles
+		// of CubeDataArrays.h, with 3, the closest LOD has 192 triangles
+		mesh_lod_count = 1;
+
+		if (mesh_lod_count > MESH_MAX_LODS)
+			mesh_lod_count = MESH_MAX_LODS;
+
+		// With compact vertices, each vertex is 12 bytes instead of 20,
+		// see CompactVertexStructure. prepare_vb_ib turns this off
+		// if the GPU can not read the compact formats
+		use_compact_vertices = true;
+
+		// The cube shows its texture. If this is false, the same fragment
+		// shader is specialized to draw the UVs as colors instead, without
+		// reading the texture, see ShaderConstants
+		shader_constants.textured = VK_TRUE;
+
+		// With runtime shaders, the GLSL files are compiled with shaderc
+		// when the program starts, so a changed shader does not need
+		// compileShaders.cmd, or a rebuild. Each compiled shader is saved
+		// in SHADER_CACHE_DIR, so the next start does not compile anything.
+		// If a GLSL file is missing or has an error, its .inc file is used
+		use_runtime_shaders = true;
+
+		// With hot reload, saving cube.vert or cube.frag (or whichever
+		// ones the pipeline uses) rebuilds the pipeline while the program
+		// runs, so a shader can be changed without closing the program.
+		// This needs runtime shaders, and a benchmark should never stop
+		// to check files, so neither of them use it
+		use_shader_hot_reload = use_runtime_shaders && (benchmark_frames == 0);
+
+		// With async pipelines, the first frames are drawn with a pipeline
+		// that the driver did not optimize, which is much faster to make,
+		// while the optimized one is made on another thread, so the window
+		// never waits for the driver to compile. A benchmark measures the
+		// optimized pipeline only, so it waits for it, like before
+		use_async_pipelines = (benchmark_frames == 0);
+
+		// Pipelines are made as derivatives of the pipeline that they
+		// replace (the fast pipeline, or the pipeline before a hot reload),
+		// see create_pipeline. Some drivers ignore this, but it never hurts
+		use_pipeline_derivatives = true;
+
+		// When the GPU has graphics pipeline libraries, pipelines are
+		// linked from parts instead, and the parts that did not change
+		// are never compiled again. Derivatives are only used without them
+		use_pipeline_library = true;
+
+		// The prewarm makes the pipelines of every vertex shader, vertex
+		// format, and fragment shader that the options can pick, on the
+		// threads of a pipeline compiler, when the pipeline cache was not
+		// loaded. It only pays off if the options change between runs, so
+		// it is off by default, "-prewarm" can also do it once and quit
+		use_pipeline_prewarm = false;
+
+		// Pipeline statistics count the vertices, triangles, and shader
+		// invocations of the render pass, so we can see how many triangles
+		// culling saves, and how much overdraw there is. Counting can make
+		// the GPU a little slower, so this is only for measuring
+		use_pipeline_statistics = false;
+
+		// Performance counters are the vendor's own counters, like cache
+		// hit rates, how busy the ALUs are, and memory bandwidth. Every GPU
+		// has different ones, so they are picked by name, with commas in
+		// between. When none of them are found, the names that the GPU
+		// has are printed. Counting can make the GPU slower too
+		use_performance_counters = false;
+		performance_counter_names = "";
+		performance_counters = nullptr;
+
+		// With the depth pre-pass, every object is drawn twice. First
+		// only its depth, with a position-only vertex buffer, and no
+		// fragment shader. Then the real pass tests depth with EQUAL, so
+		// the fragment shader runs once for each pixel, no matter how many
+		// triangles cover it. This only pays off when the fragment shader
+		// is expensive, the pipeline statistics show how many fragment
+		// shader invocations it saves
+		use_depth_prepass = false;
+
+		// With bindless textures, all textures are in one array of
+		// descriptors, and each cube gives the fragment shader the index
+		// of its texture with push constants (cube_bindless.frag), so
+		// cubes with different textures never need a different descriptor
+		// set. This is turned off in prepare_physical_device if the GPU
+		// does not support descriptor indexing
+		use_bindless_textures = false;
+
+		// With half precision, the color math of the fragment shader is
+		// done with 16-bit floats (cube_half.frag, and post_half.frag for
+		// the post subpass). GPUs with double-rate FP16 do it in half of
+		// the time, and with half of the registers, which leaves room for
+		// more threads. This is turned off in prepare_physical_device if
+		// the GPU does not support shaderFloat16. The bindless and the
+		// array shaders have no 16-bit variant, they keep 32-bit floats
+		use_half_precision = false;
+
+		// With texture transcoding, there is one texture file for every
+		// GPU: the PNG file is decoded, and then encoded in the best format
+		// that this GPU can sample (ASTC 4x4 on phones, BC1 on desktops),
+		// with every mip level, by the job system, see TextureTranscoder.h.
+		// This replaces the KTX2 files of prepare_compressed_texture. When
+		// this is on, texture streaming is turned off, it needs a KTX2 file
+		use_texture_transcoding = false;
+
+		// With texture streaming, only the smallest mip levels of the
+		// compressed texture are loaded at the start, and the bigger
+		// levels are loaded when the cubes get close enough to need them,
+		// see TextureStreamer.cpp. The textures never use more than
+		// texture_budget bytes, the least recently used ones give their
+		// levels back first. It only works with KTX2 files, which have
+		// every level ready to copy, and not with bindless textures
+		use_texture_streaming = false;
+		texture_budget = 64 * 1024 * 1024;
+		texture_streamer = nullptr;
+
+		if (use_bindless_textures)
+			use_texture_streaming = false;
+
+		// With sparse textures, the streamer binds memory to the levels
+		// of one image, instead of making a new image for each change,
+		// see SparseTilePool.cpp. The GPU and the format of the texture
+		// have to support sparse residency, see prepare_device
+		use_sparse_textures = false;
+		sparse_pool = nullptr;
+
+		if (!use_texture_streaming)
+			use_sparse_textures = false;
+
+		// With defragmentation, the frames that load no texture levels
+		// copy the streamed textures out of the emptiest memory block,
+		// into the holes of the other blocks, so the allocator can free
+		// it (see MemoryAllocator::FindDefragBlock). Sparse textures do
+		// not need it, their pages all have the same size
+		use_defragmentation = false;
+
+		if (use_defragmentation && (!use_texture_streaming || use_sparse_textures))
+		{
+			printf("Defragmentation needs texture streaming without sparse textures, it is disabled\n");
+			use_defragmentation = false;
+		}
+
+		// the blocks of a shared allocator also hold the textures of
+		// the other Demos, which this one can not move out of them
+		if (use_defragmentation && device_context->shared)
+		{
+			printf("Defragmentation can not empty the blocks of a shared allocator, it is disabled\n");
+			use_defragmentation = false;
+		}
+
+		// With push descriptors, there is no descriptor set, every
+		// command buffer writes the uniform buffer and the texture
+		// into itself, from one DescriptorSetData (see record_draws).
+		// A push descriptor layout can not be update-after-bind, so this
+		// can not be used together with bindless textures. This is
+		// turned off in prepare_physical_device if the GPU does not support it
+		use_push_descriptors = false;
+
+		// Anisotropic filtering makes the texture sharper on surfaces
+		// that are at a steep angle to the camera, see prepare_sampler.
+		// This is turned off in prepare_device_queue if the GPU does
+		// not support it
+		use_anisotropy = true;
+
+		if (use_bindless_textures)
+			use_push_descriptors = false;
+
+		// The number of cubes in the scene. They are placed in
+		// a grid in prepare_scene. Each cube needs its own matrix,
+		// so more than one cube needs push constants
+		scene_object_count = 1;
+
+		// The stress test replaces the grid with a generated scene, of
+		// any size, with scene_params.meshCount meshes and textureCount
+		// textures, where animatedFraction of the objects spin. Use it
+		// with "-benchmark" to see how each renderer path scales
+		use_scene_generator = false;
+		scene_generator = nullptr;
+		scene_params.objectCount = 10000;
+		scene_params.meshCount = 16;
+		scene_params.textureCount = 16;
+		scene_params.animatedFraction = 0.1f;
+		scene_params.seed = 1;
+
+		if (stress_objects > 0)
+		{
+			use_scene_generator = true;
+			scene_params.objectCount = stress_objects;
+		}
+
+		// With the scene snapshot, the first run saves the scene that the
+		// generator made (and the instances) into scene_snapshot_path, as
+		// one flat binary file, with offsets instead of pointers. Every run
+		// after that maps the file, and copies each array of it with one
+		// memcpy, instead of making a million objects from random numbers,
+		// one at a time (see SceneFile.cpp). The instance buffer is uploaded
+		// straight from the mapped file. Delete the file to make the scene
+		// again, after scene_params changed. The grid is never saved
+		use_scene_snapshot = false;
+		scene_snapshot_path = "scene.vscn";
+		scene_snapshot = nullptr;
+
+		if (use_scene_snapshot && !use_scene_generator)
+		{
+			printf("The scene snapshot is only for the generated scene, it is disabled\n");
+			use_scene_snapshot = false;
+		}
+
+		if (use_scene_snapshot)
+		{
+			scene_snapshot = new SceneFile();
+
+			if (scene_snapshot->Load(scene_snapshot_path))
+			{
+				printf("Mapped the scene snapshot %s: %u objects, %u instances, seed %u\n", scene_snapshot_path,
+					scene_snapshot->objectCount, scene_snapshot->instanceCount, scene_snapshot->seed);
+			}
+			else
+			{
+				delete scene_snapshot;
+				scene_snapshot = nullptr;
+			}
+		}
+
+		if (use_scene_generator)
+		{
+			scene_generator = (scene_snapshot != nullptr) ? new SceneGenerator(*scene_snapshot) : new SceneGenerator(scene_params);
+			scene_object_count = scene_generator->params.objectCount;
+		}
+
+		// With texture arrays, the generated textures are one image, with
+		// one descriptor, and each object pushes the layer of its texture
+		// (cube_array.frag), like the index of bindless textures, so neither
+		// the layout nor the GPU needs descriptor indexing. The cube's own
+		// texture is not in the array, so it is not streamed either
+		use_texture_arrays = false;
+		texture_packer = nullptr;
+
+		if (!use_scene_generator)
+			use_texture_arrays = false;
+
+		if (use_texture_arrays)
+		{
+			if (use_bindless_textures)
+				printf("The generated textures are packed into an array, bindless textures are disabled\n");
+
+			use_bindless_textures = false;
+			use_texture_streaming = false;
+			use_sparse_textures = false;
+			texture_packer = new TexturePacker();
+		}
+
+		// With asynchronous reads, the streamer loads the levels with
+		// overlapped reads, many chunks at once (see AsyncFileReader.h),
+		// instead of touching the mapped file, which stops the frame on
+		// every page that is not in memory yet. It needs texture streaming
+		use_async_reads = false;
+		async_reader = nullptr;
+
+		if (use_async_reads && !use_texture_streaming)
+		{
+			printf("Asynchronous reads need texture streaming, they are disabled\n");
+			use_async_reads = false;
+		}
+
+		// With GPU decompression, a KTX2 texture that is compressed in the
+		// asset pack is decompressed by a compute shader, from the staging
+		// buffer into device-local memory (see GpuDecompressor.h), instead
+		// of by MappedFile on the CPU. The streamer loads levels from its
+		// own mapping of the file later, so it does not use this
+		use_gpu_decompression = false;
+		gpu_decompressor = nullptr;
+
+		if (use_gpu_decompression && use_texture_streaming)
+		{
+			printf("GPU decompression does not work with texture streaming, it is disabled\n");
+			use_gpu_decompression = false;
+		}
+
+		// With the texture cache, a PNG that did not change since the last
+		// launch is not decoded again, its RGBA pixels are copied from a
+		// file next to it, which is named after the hash of the PNG (see
+		// TextureLoader.h). The first launch decodes, and saves the files
+		use_texture_cache = false;
+
+		// With GPU texture compression, each texture that the scene
+		// generator makes is compressed to BC1 by a compute shader after
+		// it is uploaded (see TextureCompressor.h), so it takes an eighth
+		// of the memory. The texture arrays are packed from the pixels
+		// on the CPU, so only the bindless textures are compressed
+		use_gpu_texture_compression = false;
+		texture_compressor = nullptr;
+
+		if (use_gpu_texture_compression && use_texture_arrays)
+		{
+			printf("GPU texture compression does not work with texture arrays, it is disabled\n");
+			use_gpu_texture_compression = false;
+		}
+
+		// With host image copy, a texture that has all of its levels (a
+		// KTX2 file, or a generated texture) is copied into its image by the
+		// CPU, with vkCopyMemoryToImageEXT, instead of through the staging
+		// ring and a copy on the transfer queue. The data is only read once,
+		// and the queue is free during the load. It is turned off in
+		// prepare_physical_device if the GPU does not support it
+		use_host_image_copy = false;
+
+		// With the placeholder texture, the PNG is decoded in the
+		// background, and the first frames are drawn with a small
+		// checkerboard instead (see create_placeholder_texture). The logo
+		// replaces it in the frame where its upload is finished. A
+		// compressed texture is not decoded, so it does not need this
+		use_placeholder_texture = false;
+		texture_loader = nullptr;
+		pending_texture = nullptr;
+		pending_texture_ticket = 0;
+		texture_generation = 0;
+
+		// the bindless array and the texture arrays
+		// are written once, with the textures they have
+		if (use_placeholder_texture && (use_bindless_textures || use_texture_arrays))
+		{
+			printf("The placeholder texture does not work with bindless textures or texture arrays, it is disabled\n");
+			use_placeholder_texture = false;
+		}
+
+		// With the video texture, the cubes show a video instead of the
+		// logo. The frames are in a YCbCr format, like a video decoder
+		// gives them, and the sampler converts them to RGB (see
+		// VideoTexture.h). The sampler has to be in the descriptor set
+		// layout, so every cube has to use the same texture
+		use_video_texture = false;
+		video_format = VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+		video_texture = nullptr;
+		video_frame_index = 0;
+
+		if (use_video_texture && (use_bindless_textures || use_texture_arrays))
+		{
+			printf("The video texture does not work with bindless textures or texture arrays, it is disabled\n");
+			use_video_texture = false;
+		}
+
+		// the video replaces the texture that these would load
+		if (use_video_texture)
+		{
+			use_texture_streaming = false;
+			use_sparse_textures = false;
+			use_placeholder_texture = false;
+		}
+
+		// With the sets split by frequency, the pipeline layout has one
+		// set for each DescriptorFrequency (see DescriptorSets.h), instead
+		// of one set with everything. A draw only binds the sets that
+		// changed, so when the uniform arena binds the frame set at the
+		// offset of each cube, the texture stays bound. A texture that
+		// changes with the frame (streaming, the placeholder, the video)
+		// is in a set for each frame_index, push descriptors are one set,
+		// and bindless textures are one array that is never rebound, so
+		// those keep the one set
+		use_frequency_sets = false;
+		material_set = VK_NULL_HANDLE;
+
+		for (uint32_t i = 0; i < DESCRIPTOR_SET_COUNT; i++)
+			frequency_layouts[i] = VK_NULL_HANDLE;
+
+		if (use_frequency_sets && (use_push_descriptors || use_bindless_textures ||
+			use_texture_streaming || use_placeholder_texture || use_video_texture))
+		{
+			printf("The descriptor sets can not be split with this texture, there is one set\n");
+			use_frequency_sets = false;
+		}
+
+		// With external memory, memory and semaphores can be shared with
+		// another process, which can then write what the cubes show, or
+		// read what we made, without a copy through the CPU. If the
+		// variable VKCUBE_SHARED_TEXTURE is "name,width,height", the cubes
+		// sample the texture that another process exported with that name
+		use_external_memory = false;
+		shared_texture = nullptr;
+
+		// The voxel world is a terrain of voxel_params.chunksX by chunksY
+		// by chunksZ chunks, drawn under the cubes. Press V to dig a hole
+		// into it, only the chunks that the hole touches are meshed again.
+		// Its quads are bigger than one block, so their UVs go past 1,
+		// and the compact vertices can not hold that. Every chunk has
+		// its own matrix, so it also needs push constants
+		use_voxel_world = false;
+		voxel_world = nullptr;
+		voxel_params.chunksX = 4;
+		voxel_params.chunksY = 2;
+		voxel_params.chunksZ = 4;
+		voxel_params.seed = 1;
+		voxel_params.streamRadius = 0;
+		voxel_params.maxChunks = 0;
+		voxel_fly_speed = 0.0f;
+		voxel_center = glm::vec3(0.0f);
+
+		// With streaming, the world has no end in x and z. The camera
+		// flies over it, the chunks up to streamRadius chunks away are
+		// loaded on the JobSystem while the frames go on, and the blocks
+		// of twice as many chunks as the ring are kept, so flying back
+		// does not make the terrain again. The GPU memory is one slot
+		// for each chunk of the ring, it never grows
+		use_voxel_streaming = false;
+
+		if (use_voxel_streaming)
+		{
+			uint32_t side = 3 * 2 + 1;
+			voxel_params.streamRadius = 3;
+			voxel_params.maxChunks = 2 * side * side * voxel_params.chunksY;
+			voxel_fly_speed = 16.0f;
+		}
+
+		if (!use_voxel_world)
+			use_voxel_streaming = false;
+
+		if (use_voxel_world)
+		{
+			if (use_compact_vertices)
+				printf("The voxel world needs float vertices, compact vertices are disabled\n");
+
+			use_compact_vertices = false;
+			use_push_constants = true;
+			voxel_world = new VoxelWorld(voxel_params);
+		}
+
+		// With the uniform arena, each slice of the uniform buffer has
+		// room for the constants of every draw of the frame, and a draw
+		// copies its matrix there, and binds the descriptor set at that
+		// dynamic offset, see UniformArena.h. It is the other way (than push
+		// constants) to give every cube its own matrix, for constants that
+		// are too big for the 128 bytes of push constants. Push descriptors
+		// have no dynamic offset, so it does not work with them
+		use_uniform_arena = false;
+		uniform_arena = nullptr;
+
+		if (use_uniform_arena && (use_push_constants || use_push_descriptors))
+		{
+			printf("The uniform arena needs the uniform buffer and a descriptor set, it is disabled\n");
+			use_uniform_arena = false;
+		}
+
+		if (scene_object_count > 1 && !use_uniform_arena)
+			use_push_constants = true;
+
+		// With the render queue, the cubes are not drawn in the order
+		// of the grid. Every frame, their draws are sorted by pipeline,
+		// then texture (so the same texture is pushed once for many
+		// cubes in a row), then front to back, so the closest cubes
+		// fill the depth buffer first, and the GPU can skip the pixels
+		// of the cubes behind them before their fragment shader runs
+		use_render_queue = true;
+		render_queue = nullptr;
+
+		// made in prepare_vb_ib
+		mesh_pool = nullptr;
+
+		// The number of instances of every cube. When this is more
+		// than one, each cube of the scene is replaced by a block of
+		// small cubes (see prepare_instances), all drawn in one draw call.
+		// Set this to 100000 for the instancing benchmark scene
+		instance_count = 1;
+		use_instancing = (instance_count > 1);
+
+		// With GPU culling, a compute shader tests every instance
+		// against the view frustum, and writes the draws for the
+		// visible instances, see CullingPass.cpp. This only works
+		// with instancing, because the instances are the objects
+		use_gpu_culling = false;
+
+		if (!use_instancing)
+			use_gpu_culling = false;
+
+		// the instanced shaders also read the matrix of each instance, and
+		// the arena only has room for the draws of cubes drawn one by one
+		if (use_uniform_arena && use_instancing)
+		{
+			printf("The uniform arena does not work with instancing, it is disabled\n");
+			use_uniform_arena = false;
+			use_push_constants = (scene_object_count > 1);
+		}
+
+		// With occlusion culling, the GPU culling pass also skips the
+		// instances that are hidden behind what was drawn in the last
+		// frame, see HiZPass.cpp. It is part of the GPU culling pass,
+		// and it is turned off in prepare_depth_buffer if the depth
+		// buffer can not be read by a shader
+		use_occlusion_culling = false;
+
+		if (!use_gpu_culling)
+			use_occlusion_culling = false;
+
+		// With occlusion queries, the bounding box of every cube is drawn
+		// at the end of the depth pre-pass, inside of an occlusion query,
+		// and in the next frame, the GPU skips the cubes whose box had no
+		// pixel that passed the depth test, with conditional rendering (see
+		// OcclusionQueries.cpp). It is a simpler kind of occlusion culling
+		// than the depth pyramid, for cubes that are drawn one at a time.
+		// It needs the pre-pass, so the boxes are tested against the depth
+		// of the whole scene, and a matrix for every cube (push constants,
+		// without instancing). It is turned off in prepare_physical_device
+		// if the GPU does not have conditional rendering
+		use_occlusion_queries = false;
+		occlusion_queries = nullptr;
+
+		if (use_occlusion_queries && (!use_depth_prepass || !use_push_constants || use_instancing))
+		{
+			printf("Occlusion queries need the depth pre-pass and push constants, without instancing, they are disabled\n");
+			use_occlusion_queries = false;
+		}
+
+		// With async compute, the GPU culling pass is submitted to a
+		// compute-only queue (see prepare_device_queue), so it runs at
+		// the same time as the graphics queue. Occlusion culling reads
+		// the depth buffer, which the graphics queue writes every frame,
+		// so with occlusion culling everything stays on the graphics queue
+		use_async_compute = false;
+
+		if (!use_gpu_culling || use_occlusion_culling)
+			use_async_compute = false;
+
+		// With vertex pulling, the vertex shader reads the vertices from
+		// the mesh pool by itself (see cube_pull.vert), instead of the
+		// fixed vertex input state in create_pipeline, so the same shader
+		// and pipeline work with both vertex formats. It replaces cube.vert,
+		// so it only works without push constants, instancing, and the
+		// depth pre-pass, which have their own vertex shaders. It is turned
+		// off in prepare_physical_device if the GPU can not do it
+		use_vertex_pulling = false;
+
+		if (use_vertex_pulling && (use_push_constants || use_instancing || use_depth_prepass))
+		{
+			printf("Vertex pulling only works with cube.vert, it is disabled\n");
+			use_vertex_pulling = false;
+		}
+
+		// With meshlets, every LOD of the mesh is split into clusters of
+		// up to 64 vertices and 124 triangles when it is built (see
+		// MeshOptimizer::BuildMeshlets), and every frame the CPU skips
+		// the clusters of each cube that are outside of the view, or that
+		// face away from the camera (see cull_meshlets). This pays off for
+		// models with many triangles, the cube at mesh_lod_count = 1 is
+		// a single meshlet. The instances of a cube are all drawn with one
+		// draw, which can not skip different meshlets for each of them,
+		// so this only works without instancing
+		use_meshlets = false;
+		meshlet_slice_draws = 0;
+		meshlets_tested = 0;
+		meshlets_culled = 0;
+
+		if (use_meshlets && use_instancing)
+		{
+			printf("Meshlets do not work with instancing, they are disabled\n");
+			use_meshlets = false;
+		}
+
+		// With the shadow cache, there is a shadow map of the sun, in two
+		// layers (see ShadowCache.h). The objects that never move are drawn
+		// into the static layer once, and each frame only the objects that
+		// moved are drawn on top of a copy of it, so a generated scene with
+		// few animated objects has a shadow map that costs almost nothing.
+		// Every instance of a cube would have to be a caster of its own,
+		// so this only works without instancing
+		use_shadow_cache = false;
+		shadow_cache = nullptr;
+
+		if (use_shadow_cache && use_instancing)
+		{
+			printf("The shadow cache does not work with instancing, it is disabled\n");
+			use_shadow_cache = false;
+		}
+
+		// With dynamic resolution, the scene is drawn with fewer
+		// pixels when the GPU takes longer than the target time, and
+		// with more pixels when it has time to spare, and the image is
+		// scaled up to the window. The frame rate holds steady on a slow
+		// GPU, without anyone picking a resolution by hand. It is turned
+		// off in prepare_swapchain if the swapchain can not be blitted to
+		use_dynamic_resolution = false;
+		dynamic_resolution = nullptr;
+		dynamic_resolution_frames = 0;
+
+		// With temporal upscaling, the scene is drawn with fewer pixels
+		// than the window (2/3 of each side, less than half of the
+		// pixels), and every frame is moved by a different part of a
+		// pixel. The upscaler reprojects the frames before it with the
+		// depth and the matrices of both frames, and blends them, so the
+		// window gets a sharp image from the samples of several frames,
+		// at a fraction of the fragment shader work (see TemporalPass.h).
+		// It draws offscreen, and dynamic resolution can still pick the
+		// render size. It is turned off in prepare_depth_buffer if the
+		// depth can not be sampled, or with MSAA
+		use_temporal_upscale = false;
+		temporal_render_scale = 0.67f;
+		temporal_blend = 0.1f;
+		temporal_pass = nullptr;
+		temporal_history = nullptr;
+		temporal_jitter = glm::vec2(0.0f);
+		temporal_vp = glm::mat4(1.0f);
+		temporal_previous_vp = glm::mat4(1.0f);
+
+		// With the offscreen target, nothing is drawn into the swapchain
+		// images, the framebuffer only has images that we made, and the
+		// result is copied to the swapchain at the end of the frame. Then
+		// the render pass does not depend on the swapchain at all, which
+		// costs one blit per frame. Dynamic resolution draws offscreen,
+		// so it needs it
+		use_offscreen_target = false;
+
+		// With dynamic rendering, there is no VkRenderPass, and no
+		// VkFramebuffer for each swapchain image. The render pass begins
+		// with vkCmdBeginRenderingKHR, on the image views of this frame, so
+		// a resize makes no framebuffers, and the images that are drawn
+		// into could change from one frame to the next. The frame graph
+		// changes the layouts, instead of the subpass dependencies. This is
+		// turned off in prepare_physical_device if the GPU does not support it
+		use_dynamic_rendering = false;
+
+		// With variable rate shading, the cubes that are far away are
+		// shaded once for every 2x2 or 4x4 pixels (use_shading_rate),
+		// and so are the edges of the screen (use_shading_rate_image),
+		// which saves fragment shader work when the scene is limited by
+		// the fragment shader. They are turned off in prepare_physical_device
+		// if the GPU does not support them, the image only works with
+		// dynamic rendering
+		use_shading_rate = false;
+		use_shading_rate_image = false;
+		shading_rate_texel = { 16, 16 };
+		shading_rate_combiner = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+
+		// With the post subpass, the render pass gets one more subpass
+		// at the end, which reads what the scene drew as an input
+		// attachment, and writes the color grade of it into the color
+		// attachment (see PostSubpass.h). A tiled GPU does both subpasses
+		// while the pixels are in its tile memory, so the grade costs no
+		// memory bandwidth. It needs a render pass, and one sample per
+		// pixel, see prepare_depth_buffer
+		use_post_subpass = false;
+		post_subpass = nullptr;
+
+		// With output windows, output_window_count more windows show the
+		// scene, next to the main window, like the screens of a video
+		// wall. They share the device, and everything that was loaded,
+		// and each one has its own swapchain (see OutputWindow.cpp).
+		// The scene is drawn once, offscreen, and scaled into each of them
+		use_output_windows = false;
+		output_window_count = 1;
+
+		// With a device group, a computer with several linked GPUs
+		// (SLI or CrossFire) uses all of them, and they take turns
+		// drawing frames (see prepare_physical_device). Everything that
+		// reads what an earlier frame wrote on the GPU would read it from
+		// the wrong GPU, so those features are off: occlusion culling
+		// (last frame's depth), dynamic resolution (last frames' timers),
+		// and sparse textures are only bound on one GPU. The output
+		// windows have swapchains of their own, without device masks
+		use_device_group = false;
+		device_group_count = 1;
+
+		if (use_device_group)
+		{
+			use_async_compute = false;
+			use_occlusion_culling = false;
+			use_dynamic_resolution = false;
+			use_output_windows = false;
+			use_sparse_textures = false;
+			use_temporal_upscale = false;
+		}
+
+		if (use_dynamic_resolution || use_output_windows || use_temporal_upscale)
+			use_offscreen_target = true;
+
+		// With dynamic instances, a few of the instances spin every
+		// frame, and the instance buffer is written by the CPU, with
+		// only the matrices that changed, see update_instances
+		use_dynamic_instances = false;
+
+		if (!use_instancing)
+			use_dynamic_instances = false;
+
+		// With device-local host buffers, the buffers that the CPU writes
+		// every frame (the uniform buffer, and the dynamic instances) are
+		// in memory that is DEVICE_LOCAL and HOST_VISIBLE, if the GPU has
+		// it. Then the CPU writes straight into VRAM, and the GPU never
+		// reads them over PCIe. It is checked when the allocator is made
+		use_device_local_host_buffers = false;
+
+		// host visible VRAM is on every GPU of a device group,
+		// and memory like that can not be mapped
+		if (use_device_group)
+			use_device_local_host_buffers = false;
+
+		// With cached staging, the staging ring that every upload is
+		// copied through is in HOST_CACHED memory. On some GPUs, the
+		// HOST_COHERENT memory is uncached, and the big memcpy's of the
+		// texture levels are faster into cached memory. If the cached
+		// memory is not coherent, each write is flushed with
+		// vkFlushMappedMemoryRanges, rounded out to nonCoherentAtomSize
+		use_cached_staging = false;
+
+		// With an upload budget, the uploads that can wait (the streamed
+		// texture levels, and the meshes of the voxel chunks) stop for the
+		// frame when they have started upload_budget_copies copies, or as
+		// many bytes as the transfer queue copies in upload_budget_ms. The
+		// speed is measured with timestamps around every upload batch, so
+		// walking into a lot of new terrain, or turning to see a lot of new
+		// textures, spreads the copies over a few frames, instead of making
+		// one frame wait for all of them. The closest things go first
+		use_upload_budget = false;
+		upload_budget_ms = 2.0;
+		upload_budget_copies = 16;
+
+		// With a wide swapchain format, the swapchain (and the offscreen
+		// image, which has its format) is 10 bits per channel, or half
+		// floats, when the surface has them, which shows smooth gradients
+		// without banding. Otherwise the cheapest format is picked, which
+		// is 8 bits per channel, see SelectSurfaceFormat. The color space
+		// stays sRGB, the shaders do not write HDR values
+		use_wide_swapchain_format = false;
+
+		// With frame capture, the final image of every capture_interval'th
+		// frame is copied into a CPU buffer at the end of the frame, and
+		// saved as capture_<frame>.ppm when that frame's fence is waited
+		// on anyway, frame_lag frames later (see FrameCapture.cpp), so
+		// capturing never waits for the GPU. The swapchain has to allow
+		// TRANSFER_SRC, and have 4 bytes per pixel, see prepare_buffers
+		use_frame_capture = false;
+		capture_interval = 60;
+		frame_capture = nullptr;
+
+		if (use_device_group)
+			use_frame_capture = false;
+
+		// If the variable VKCUBE_ENCODER_OUTPUT is "name,width,height",
+		// every frame is given to a hardware encoder in another process,
+		// through external memory, so the pixels never go through the CPU
+		// (see EncoderBridge.h). It needs timeline semaphores, and the
+		// swapchain has to allow TRANSFER_SRC, see prepare_buffers
+		use_encoder_output = (getenv("VKCUBE_ENCODER_OUTPUT") != nullptr) && !use_device_group;
+		encoder_bridge = nullptr;
+		encode_number = 0;
+
+		if (use_encoder_output)
+			use_external_memory = true;
+
+		// The HUD draws the CPU and GPU time of the frame, the present
+		// mode, the frames in flight, the draw calls, and the memory in
+		// the top left corner of the window (see HudOverlay.h), so the
+		// numbers are on the screen without reading the console
+		use_hud = false;
+		hud = nullptr;
+
+		// The metrics export is for displays that nobody is watching.
+		// Every metrics_interval_ms, the percentiles of the frame time,
+		// the GPU time, the late and dropped presents (from display
+		// timing), and the memory budget are sent as StatsD over UDP to
+		// metrics_host, from a thread of its own (see MetricsExporter.h)
+		use_metrics_export = false;
+		metrics_host = "127.0.0.1";
+		metrics_port = 8125;
+		metrics_interval_ms = 10000;
+		metrics_exporter = nullptr;
+
+		// The telemetry channel is the same kind of numbers, for every
+		// frame, in a named ring of shared memory that a watchdog on this
+		// machine can read, for kiosks that have no network to send them
+		// to. Each slot has a seqlock, so the demo never waits for readers
+		use_telemetry_channel = false;
+		telemetry_channel_name = "vkcube_telemetry";
+		telemetry_channel = nullptr;
+
+		// The trace capture writes a Chrome trace of a few frames,
+		// with the CPU markers of the profiler, and the GPU timestamps
+		// of the GpuTimer, to see how the frames in flight overlap
+		use_trace_capture = false;
+		trace_start_frame = 240;
+		trace_frames = 120;
+		trace_capture = nullptr;
+
+		// The spike detector is for the hitches that only happen once
+		// in a while. Every spike is written to SPIKE_LOG_FILE, with the
+		// CPU markers of the frames before it, the memory blocks that
+		// were made or freed, and the state of the swapchain
+		use_spike_detector = false;
+		spike_threshold_ms = 50.0;
+		spike_median_multiple = 2.0;
+		spike_detector = nullptr;
+		swapchain_count = 0;
+
+		// The instance hierarchy moves whole layers of instances at
+		// once, through their parent. The hierarchy is updated on the
+		// job system, so it only makes sense with dynamic instances
+		use_instance_hierarchy = false;
+
+		if (!use_dynamic_instances)
+			use_instance_hierarchy = false;
+
+		// CPU culling tests every instance against the view frustum,
+		// with SIMD, and only writes the visible ones to the instance
+		// buffer (see update_instances). The CPU writes the instance
+		// buffer with dynamic instances only, and there is no reason
+		// to cull on the CPU if the GPU already does it
+		use_cpu_culling = false;
+
+		if (!use_dynamic_instances || use_gpu_culling)
+			use_cpu_culling = false;
+
+		// With instance deltas, the dynamic instances stay in one buffer in
+		// VRAM, like static instances, and each frame only sends the matrices
+		// that changed, each one with its index, through a ring that a compute
+		// shader reads, and copies them to their place (see InstanceScatter.h).
+		// CPU culling writes a new list of matrices every frame, so there are
+		// no changes to send, and with async compute the culling shader would
+		// read the instances on the other queue, before they are copied
+		use_instance_deltas = false;
+		instance_scatter = nullptr;
+
+		if (use_instance_deltas && (!use_dynamic_instances || use_cpu_culling || use_async_compute))
+		{
+			printf("Instance deltas need dynamic instances, without CPU culling or async compute, they are disabled\n");
+			use_instance_deltas = false;
+		}
+
+		// With GPU animation, the CPU does not turn anything. Every
+		// instance has an axis and a speed, which are uploaded once, and
+		// the vertex shader turns each cube by the time of the frame (see
+		// cube_animated.vert), so however many cubes move, the CPU does the
+		// same work, and writes the same 80 bytes, in every frame. It reads
+		// the time from the uniform buffer, so it needs instancing without
+		// push constants, and the CPU does not move the instances as well.
+		// The depth pre-pass and vertex pulling have their own shaders
+		use_gpu_animation = false;
+		animation_start = CpuClock::now();
+
+		if (use_gpu_animation && (!use_instancing || use_push_constants || use_dynamic_instances || use_depth_prepass || use_vertex_pulling))
+		{
+			printf("GPU animation needs instancing with a uniform buffer, without dynamic instances, the depth pre-pass, or vertex pulling, it is disabled\n");
+			use_gpu_animation = false;
+		}
+
+		// With GPU particles, a fountain of particles is simulated by
+		// compute shaders, and drawn as tiny cubes, with the instanced
+		// pipeline, with one indirect draw that the GPU counted (see
+		// ParticleSystem.cpp). The particles are instances of the cube,
+		// so this needs instancing. The animated shader would read an axis
+		// for every particle, and vertex pulling has no instances at all
+		use_gpu_particles = false;
+		particle_capacity = 1024 * 1024;
+		particle_emit_rate = 200000.0f;
+		particle_emit_accumulator = 0.0;
+		particle_time = CpuClock::now();
+		particle_system = nullptr;
+
+		if (use_gpu_particles && (!use_instancing || use_gpu_animation || use_vertex_pulling))
+		{
+			printf("GPU particles need instancing, without GPU animation or vertex pulling, they are disabled\n");
+			use_gpu_particles = false;
+		}
+
+		// With compute skinning, the cube is a skinned mesh, with a bone
+		// for its bottom half, which stays still, and one for its top
+		// half, which swings from side to side. A compute shader skins its
+		// vertices once in every frame, straight into the mesh pool (see
+		// SkinningPass.cpp), so the depth pre-pass, the shadow map, and
+		// the main pass all draw the same skinned vertices, and none of
+		// their vertex shaders skin anything. With more LODs, the cube has
+		// vertices in the middle of its sides too, so it bends smoothly
+		use_compute_skinning = false;
+		skinning_pass = nullptr;
+
+		// With GPU picking, a click with the left mouse button finds the
+		// object under the mouse. The objects are drawn again, only in a
+		// few pixels around the mouse, into an image of object IDs, which
+		// is copied into a small buffer of the frame slot, and read when
+		// the slot comes around again (see ObjectPicker.cpp), so the pick
+		// never waits for the GPU, and it is printed frame_lag frames after
+		// the click. Each object is drawn with its own matrix, like the
+		// shadow cache, so the instances of a cube, and the GPU animation
+		// (which turns the cubes in the vertex shader) can not be picked.
+		// Vertex pulling reads the vertices in the shader, the pick draws
+		// the position buffer instead, so they could be made the same,
+		// but they are not
+		use_gpu_picking = false;
+		object_picker = nullptr;
+
+		if (use_gpu_picking && (use_instancing || use_gpu_animation || use_vertex_pulling))
+		{
+			printf("GPU picking does not work with instancing, GPU animation, or vertex pulling, it is disabled\n");
+			use_gpu_picking = false;
+		}
+
+		// With the fixed timestep, the simulation is not tied to the
+		// frame rate. One step is the 0.025 radians that the cube used
+		// to turn in every frame, and there are 60 steps every second,
+		// which is the same speed as before at 60 frames per second
+		use_fixed_timestep = false;
+		simulation_time = CpuClock::now();
+		simulation_accumulator = 0.0;
+		simulation_alpha = 0.0f;
+		simulation_steps = 0;
+		spin_angle = 0.0f;
+		previous_spin_angle = 0.0f;
+		animation_paused = false;
+
+		// With render on demand, the demo draws nothing while the
+		// scene, the camera, and the window stay the same. This is
+		// for a screen that shows the same thing for a long time,
+		// like a kiosk, so the CPU and GPU can rest. It does not
+		// matter for the benchmark, which always draws
+		use_render_on_demand = false;
+		redraw_frames = 0;
+
+		// With incremental present, the compositor is told which part
+		// of the image changed, which is where the cubes are. Only the
+		// cubes of the scene objects are measured, so this does not work
+		// with instancing, and the temporal upscaler leaves a trail of
+		// old frames in its history, outside of where the cubes are now
+		use_incremental_present = false;
+		previous_dirty_rect_valid = false;
+
+		if (use_incremental_present && (use_instancing || use_temporal_upscale))
+		{
+			printf("Incremental present does not work with instancing or the temporal upscaler, it is disabled\n");
+			use_incremental_present = false;
+		}
+
+		// the numbers of the HUD change every frame, outside of the cubes
+		if (use_incremental_present && use_hud)
+		{
+			printf("Incremental present does not work with the HUD, it is disabled\n");
+			use_incremental_present = false;
+		}
+
+		// With timeline semaphores, one counter on the GPU says which
+		// frames are done (see draw), and the uploader uses another one
+		// for its batches, instead of one fence for each. This is turned
+		// off in prepare_physical_device if the GPU does not support it
+		use_timeline_semaphores = true;
+
+		// With submit batching, the submissions of the uploader, and of
+		// the texture streamer, do not go to the graphics queue right
+		// away. They are put in a SubmitBatch, and sent together with
+		// the frame, so the frame only calls vkQueueSubmit once
+		use_submit_batching = true;
+
+		// With the host allocator, every CPU allocation of the driver goes
+		// through our callbacks, small ones come from pools, and all of
+		// them are counted by scope, which the memory report (M) prints.
+		// It is off by default, because it also takes a lock for each
+		// allocation, turn it on to see how much memory the driver uses
+		use_host_allocator = false;
+
+		// With large pages, the big arrays that every frame walks
+		// through (the transforms and model matrices of the objects, and
+		// the frame arena, once it grows that big) are kept in 2MB pages
+		// instead of 4KB pages, so the loops over them miss the TLB a
+		// lot less (see LargePages.h). The user needs the "Lock pages in
+		// memory" right for this, which nobody has by default
+		use_large_pages = false;
+
+		if (use_large_pages && !LargePages::Enable())
+		{
+			printf("Large pages are not available (is \"Lock pages in memory\" granted?), they are disabled\n");
+			use_large_pages = false;
+		}
+
+		// In low latency mode, draw() updates the matrices as late as it
+		// can, right before the command buffer is recorded and submitted,
+		// so the frame shows what happened as recently as possible. If
+		// the GPU supports present wait, it also waits for the last frame
+		// to be on the screen, so frames can not pile up in the queue
+		low_latency = false;
+
+		// With polled acquire, draw() does not sleep in the driver while
+		// it waits for a swapchain image, it asks without a timeout, and
+		// does the rest of the CPU work of the frame in between, see
+		// run_frame_work. That helps when the presentation engine holds
+		// on to the images, like FIFO with a GPU that is ahead of the screen
+		use_polled_acquire = false;
+
+		// With the present thread, the presents happen on another thread.
+		// Low latency mode wants the present to be done before it starts
+		// the next frame, which is the opposite, so it does not use it
+		use_present_thread = false;
+		present_thread = nullptr;
+
+		if (use_present_thread && low_latency)
+		{
+			printf("The present thread does not work with low latency mode, it is disabled\n");
+			use_present_thread = false;
+		}
+
+		// With latency markers, the demo measures the time from reading
+		// the input to the image being on the screen, and prints it every
+		// LATENCY_REPORT_FRAMES frames. If the GPU has VK_NV_low_latency2,
+		// the markers also go to the driver, and if it has VK_AMD_anti_lag,
+		// the driver is told where the input and the present are. Both of
+		// them make the CPU wait before it reads the input, instead of
+		// letting the frame wait in the queue (see prepare_physical_device)
+		use_latency_markers = false;
+		latency_markers = nullptr;
+
+		// In headless mode ("-headless"), everything that needs a window,
+		// or a swapchain to present to, is turned off, and frame capture
+		// is turned on, it is how the frames leave the GPU. Render on
+		// demand would wait for window events that never come
+		if (window_mode == WINDOW_MODE_HEADLESS)
+		{
+			use_output_windows = false;
+			use_device_group = false;
+			use_incremental_present = false;
+			use_render_on_demand = false;
+			use_polled_acquire = false;
+			use_present_thread = false;
+			use_latency_markers = false;
+			low_latency = false;
+			use_frame_capture = true;
+		}
+
+		// Our scene is one small cube, so 16 bits of depth is plenty,
+		// and it is half as much memory (and bandwidth) as 32 bits.
+		// Set this to true for a scene with a lot more depth, where
+		// far away polygons start to fight over the same depth values
+		depth_high_precision = false;
+
+		// MSAA smooths the edges of the triangles, by testing depth
+		// and coverage at several samples in each pixel. The samples are
+		// only kept in a transient image, which a tiled GPU keeps in its
+		// tile memory, and they are resolved (averaged) into the swapchain
+		// image by the subpass itself, so there is no extra full-screen
+		// pass, and the samples are never written to memory. Set this to
+		// 2, 4, or 8, the GPU might support less, see select_msaa_samples
+		msaa_samples = 1;
+		msaa_sample_count = VK_SAMPLE_COUNT_1_BIT;
+
+		// The present mode, unless one was given on the command line
+		// (see prepare_swapchain). A benchmark should not be limited
+		// by the monitor, so it uses IMMEDIATE
+		if (present_mode == VK_PRESENT_MODE_MAX_ENUM_KHR)
+			present_mode = (benchmark_frames > 0) ? VK_PRESENT_MODE_IMMEDIATE_KHR : VK_PRESENT_MODE_FIFO_KHR;
+
+		// The auto-tuner replaces MSAA, the render scale, the frames in
+		// flight, the present mode, and the culling path with the ones
+		// that are best for the GPU, once the GPU is picked (see
+		// tune_settings). MSAA and the render scale are as high as they
+		// can be while the frame takes at most auto_tune_target_ms.
+		// "-autotune" turns this on, and tunes again
+		use_auto_tuning = false;
+		auto_tune_target_ms = 1000.0 / 60.0;
+
+		if (auto_tune_retune)
+			use_auto_tuning = true;
+
+		// The job system has one thread for each core, except for
+		// this one, which runs jobs too while it waits for them. It is
+		// made before everything else, so every part of the startup
+		// can use it, and it is deleted last, in the destructor
+		uint32_t cores = std::thread::hardware_concurrency();
+		uint32_t workers = (cores > 1) ? cores - 1 : 1;
+		job_system = new JobSystem(workers);
+
+		// With thread scheduling, the render thread joins the "Games"
+		// task of MMCSS, and the present thread joins "Playback", which
+		// run before the normal threads of every process, so a busy
+		// machine can not make them miss the vsync (see ThreadScheduler.h).
+		// The render thread also gets render_core to itself, the workers
+		// of the job system run on the other cores. The upload work runs
+		// on the render thread, so it is scheduled with it
+		use_thread_scheduling = false;
+		render_core = 1;
+		render_schedule = { L"Games", AVRT_PRIORITY_HIGH, 0 };
+		present_schedule = { L"Playback", AVRT_PRIORITY_HIGH, 0 };
+
+		// the render core needs to be one of ours, and needs
+		// another core next to it, that the workers can use
+		if (use_thread_scheduling && (cores < 2 || render_core >= cores || render_core >= sizeof(DWORD_PTR) * 8))
+			printf("Core %u can not be given to the render thread, the threads are not pinned\n", render_core);
+		else if (use_thread_scheduling)
+		{
+			render_schedule.affinity = ThreadScheduler::CoreMask(render_core);
+
+			if (!job_system->SetWorkerAffinity(ThreadScheduler::AllCoresExcept(render_core)))
+				printf("The workers could not be moved away from core %u\n", render_core);
+		}
+
+		// During development, it is good to have a console window.
+		// You can read errors, and write printf statements.
+		// However, if you want to release a software or game, you may
+		// not want a console window. Simply comment out this line to 
+		// disable the console window.
+		// measure how long each step of the startup takes,
+		// the report is printed at the end of prepare()
+		startup_timeline.Start();
+		startup_timeline.Step("prepare_console");
+		prepare_console();
+
+		// everything that Helper::DbgMsg logs is written
+		// by this thread, once the console is there
+		Logger::Start(nullptr);
+
+		// set the width and height of the window
+		// literally set this to whatever you want
+		width = 640;
+		height = 360;
+
+		// build the window with the Win32 API. This will look similar to how
+		// a window is created in a DirectX 11/12 engine, and we will use the
+		// WndProc from main.cpp to create the window
+		startup_timeline.Step("prepare_window");
+		prepare_window();
+
+		// We create an instance of Vulkan, this allows us to use VUlkan
+		// commands on the CPU, but we will not yet be able to talk to 
+		// the graphics device, that comes later
+		// The callbacks have to be there before the instance is made,
+		// every object is destroyed with the callbacks that made it
+		if (use_host_allocator)
+			HostAllocator::Enable();
+
+		// the first Demo of the instance, and of the device, makes them
+		makes_instance = device_context->instanceContext->Join();
+		makes_device = device_context->Join();
+
+		startup_timeline.Step("prepare_instance");
+		prepare_instance();
+
+		// Soem Vulkan functions are not available in the SDK's
+		// .lib or .dll files, but instead are inside the driver,
+		// this is how you get some of them from the instance
+		prepare_instance_functionPointers();
+
+		// The physical device gives us all the properties of the GPU
+		// that we want to use to render, such as the name of the GPU,
+		// how much memory it has, what features it supports, etc.
+		// We cannot send commands to the GPU through the PhysicalDevice,
+		// but we can use it to determine what our GPU can do.
+		startup_timeline.Step("prepare_physical_device");
+		prepare_physical_device();
+
+		// we create the surface of Vulkan, which helps Vulkan move a
+		// fully-rendered image from the graphics card to the screen
+		startup_timeline.Step("prepare_surface");
+		prepare_surface();
+
+		// The PhysicalDevice and the Device both refer to the same
+		// GPU. The difference is that PhysicalDevice tells us the 
+		// GPU's properties, while Device allows us to send commands
+		// to the GPU.
+
+		// The queue, is exactly what it sounds like. If you have
+		// never used a queue before, do a google search on 
+		// std::queue to understand the concepts. The queue that
+		// we use here is not made with std::queue, but it works
+		// the same way. The VkQUeue is the middle-man between
+		// C++ and the GPU (VkDevice). C++ will submit commands
+		// to the queue, and then the queue will shovel the commands
+		// into the GPU. We have to create the Device and the Queue
+		// at the same time
+
+		// Create the Device and the Queue
+		startup_timeline.Step("prepare_device_queue");
+		prepare_device_queue();
+
+		// Soem Vulkan functions are not available in the SDK's
+		// .lib or .dll files, but instead are inside the driver,
+		// this is how you get some of them from the device
+		prepare_device_functionPointers();
+
+		// the markers are made before the swapchain, which
+		// gives them the swapchain in prepare_swapchain
+		if (use_latency_markers)
+		{
+			latency_markers = new LatencyMarkers(device);
+
+			if (latency_nv_enabled)
+				latency_markers->EnableNV(fpSetLatencySleepModeNV, fpLatencySleepNV, fpSetLatencyMarkerNV, fpWaitSemaphoresKHR);
+
+			if (anti_lag_enabled)
+				latency_markers->EnableAMD(fpAntiLagUpdateAMD);
+		}
+
+		// The Swapchain and currentPresentMode
+		// variables will be thoroughly explained
+		// in the prepare_swapchain() function
+
+		// sometimes this does not default to NULL
+		// so lets set it to NULL here. If this line
+		// is removed, then a validation error is risked.
+		swapchain = VK_NULL_HANDLE;
+
+		// no frames have been drawn yet
+		frame_count = 0;
+
+		// Set the current present mode of the swapchain
+		currentPresentMode = (VkPresentModeKHR)0;
+	}
+
+	// build the swapchain, and also
+	// prepare the images that are
+	// in the swapchain
+	startup_timeline.Step("prepare_swapchain");
+	prepare_swapchain();
+
+	// If the screen is minimized, do not contineu the function.
+	// Exit the prepaer() function, stop drawing to the screen,
+	// and come back later when the window is not minimized anymore.
+	if (is_minimized)
+	{
+		prepared = false;
+		return;
+	}
+
+	// The output windows are made on this thread, like the main
+	// window, so their messages come to the same message loop (see
+	// WinMain). Their swapchains are made when they are first drawn
+	if (firstInit && use_output_windows)
+	{
+		for (uint32_t i = 0; i < output_window_count; i++)
+		{
+			OutputWindow* w = new OutputWindow(inst, gpu, device, name, name,
+				640 + (int)(i + 1) * width, 0, width, height, frame_lag, present_mode, format);
+
+			if (!w->IsSupported(graphics_queue_family_index))
+			{
+				printf("Output window %u can not be presented to, it is disabled\n", i);
+				delete w;
+				continue;
+			}
+
+			output_windows.push_back(w);
+		}
+
+		if (output_windows.empty())
+			use_output_windows = false;
+	}
+
+	// Once the device exists, some steps of the startup do not need
+	// the mesh, the textures, or each other, so they run on the threads
+	// of the job system, while this thread loads the assets below. Each
+	// task only starts when the tasks that it needs are done, and this
+	// thread waits for a task right before it needs what the task made
+	InitGraph* initGraph = nullptr;
+	uint32_t cacheTask = 0;
+	std::vector<uint32_t> pipelineDeps;
+
+	if (firstInit)
+	{
+		initGraph = new InitGraph(job_system);
+
+		// the pipeline cache is read from the disk
+		cacheTask = initGraph->Add("prepare_pipeline_cache", [this]() { prepare_pipeline_cache(); });
+		pipelineDeps.push_back(cacheTask);
+
+		// the shader compiler is only needed
+		// if the shaders are compiled at runtime
+		shader_compiler = nullptr;
+
+		// The GLSL files are compiled now, while the assets load, and the
+		// results go into the shader cache, so prepare_pipeline only has
+		// to read them from there. The pipeline needs this to be done
+		if (use_runtime_shaders)
+		{
+			shader_compiler = new ShaderCompiler();
+			select_shader_sources();
+
+			pipelineDeps.push_back(initGraph->Add("compile shaders", [this]()
+			{
+				std::vector<uint32_t> spirv;
+				shader_compiler->Compile(vs_source_name, VK_SHADER_STAGE_VERTEX_BIT, &spirv);
+				shader_compiler->Compile(fs_source_name, VK_SHADER_STAGE_FRAGMENT_BIT, &spirv);
+			}));
+		}
+
+		// The command pools, the recording threads, the query pools,
+		// and the fences and semaphores only need the device, and
+		// nothing is drawn until prepare() is done, so this can happen
+		// at the same time as everything else
+		initGraph->Add("prepare_frame_cmds and prepare_synchronization", [this]()
+		{
+			// We make one command pool and one command buffer for each
+			// frame_index. The command buffer is recorded every frame in
+			// draw(), with the framebuffer of the swapchain image that
+			// we are drawing to, so nothing needs to be rebuilt here
+			// when the window is resized
+			prepare_frame_cmds();
+
+			// The CommandRecorder splits the draws of the scene into
+			// slices, which the job system records at the same time.
+			// One slice for each thread that can run jobs (the workers
+			// and the render thread), and never more than 8
+			uint32_t slices = job_system->GetWorkerCount() + 1;
+			slices = (slices > 8) ? 8 : slices;
+
+			recorder = new CommandRecorder(device, graphics_queue_family_index, frame_lag, job_system, slices);
+
+			// the draws are sorted on the same threads as they are recorded
+			if (use_render_queue)
+				render_queue = new RenderQueue(job_system);
+
+			// measures the GPU time of every frame, and prints
+			// the stats to the console every few seconds
+			gpu_timer = new GpuTimer(device, gpu, graphics_queue_family_index, frame_lag);
+
+			// one capture buffer for each frame in flight
+			if (use_frame_capture)
+				frame_capture = new FrameCapture(device, allocator, frame_lag, format);
+
+			// the images and semaphores that the encoder opens
+			if (use_encoder_output)
+				prepare_encoder_output();
+
+			// one slice of letters for each frame in flight, the
+			// render pass is needed before the framebuffers
+			if (use_hud)
+				hud = new HudOverlay(device, allocator, format, frame_lag);
+
+			if (use_metrics_export)
+			{
+				metrics_exporter = new MetricsExporter(metrics_host, metrics_port, "vkcube.", metrics_interval_ms);
+
+				if (!metrics_exporter->IsOpen())
+				{
+					printf("The metrics socket could not be made, the metrics export is disabled\n");
+					delete metrics_exporter;
+					metrics_exporter = nullptr;
+					use_metrics_export = false;
+				}
+			}
+
+			if (use_telemetry_channel)
+			{
+				telemetry_channel = new TelemetryChannel(telemetry_channel_name);
+
+				if (!telemetry_channel->IsOpen())
+				{
+					printf("The telemetry shared memory could not be made, the telemetry channel is disabled\n");
+					delete telemetry_channel;
+					telemetry_channel = nullptr;
+					use_telemetry_channel = false;
+				}
+			}
+
+			// counts the work of the render pass, if we want to
+			pipeline_stats = nullptr;
+
+			if (use_pipeline_statistics)
+				pipeline_stats = new PipelineStatistics(device, frame_lag);
+
+			// this takes the profiling lock, before any
+			// command buffer with its queries is begun
+			if (use_performance_counters)
+			{
+				performance_counters = new PerformanceCounters(device, gpu, graphics_queue_family_index, frame_lag, performance_counter_names,
+					fpEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR, fpGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR,
+					fpAcquireProfilingLockKHR, fpReleaseProfilingLockKHR);
+
+				if (!performance_counters->supported)
+				{
+					delete performance_counters;
+					performance_counters = nullptr;
+					use_performance_counters = false;
+				}
+			}
+
+			// measures the CPU time of every part of draw()
+			cpu_profiler = new CpuProfiler();
+
+			if (use_spike_detector)
+				spike_detector = new SpikeDetector(SPIKE_LOG_FILE, spike_threshold_ms, spike_median_multiple);
+
+			// both of them send their times to the trace
+			if (use_trace_capture)
+			{
+				trace_capture = new TraceCapture(device, fpGetCalibratedTimestampsEXT, frame_lag);
+				cpu_profiler->SetTrace(trace_capture);
+				gpu_timer->SetTrace(trace_capture);
+			}
+
+			// This function handles the synchronization of the
+			// CPU and GPU, to make sure that one does not get
+			// too far ahead of the other.
+
+			// In this function, we create more fences, and 
+			// something called "semaphores" to control the flow
+			// of the program. To assure the command buffers
+			// only draw when they are ready to be drawn,
+			// and also let us know when each command buffer 
+			// is finished drawing
+			prepare_synchronization();
+		});
+	}
+
+	// create the allocator, the uploader, and every
+	// asset that does not depend on the window size
+	if (firstInit)
+	{
+		// Get Memory Properteis from our GPU
+		// This will tell us how much memory the GPU has,
+		// and also tell us information about the memory.
+		// Having these properties will enable us to 
+		// create and store data in a way that is compatible
+		// with the GPU that is currently being used
+		vkGetPhysicalDeviceMemoryProperties(gpu, &memory_properties);
+
+		// Every buffer and texture in the program will get its
+		// memory from this allocator. Rather than calling
+		// vkAllocateMemory once per buffer, the allocator makes
+		// a few big blocks of memory, and gives a piece of a block
+		// to each buffer and texture. Look at MemoryAllocator.cpp
+		// for more information. Demos that share the device share
+		// its allocator, which the first one made
+		startup_timeline.Step("MemoryAllocator and Uploader");
+
+		if (makes_device)
+		{
+			allocator = new MemoryAllocator(device, gpu);
+			device_context->allocator = allocator;
+
+			if (memory_budget_enabled)
+				allocator->EnableBudget(fpGetPhysicalDeviceMemoryProperties2KHR);
+
+			if (dedicated_allocation_enabled)
+				allocator->EnableDedicated(fpGetImageMemoryRequirements2KHR, fpGetBufferMemoryRequirements2KHR);
+		}
+		else
+			allocator = device_context->allocator;
+
+		// Without resizable BAR, the window is only 256 MB, but our
+		// buffers are small, so they fit in it too
+		if (use_device_local_host_buffers)
+		{
+			VkDeviceSize barSize = allocator->GetHostVisibleDeviceLocalSize();
+
+			if (barSize == 0)
+			{
+				printf("The GPU has no device-local host-visible memory, device-local host buffers are disabled\n");
+				use_device_local_host_buffers = false;
+			}
+			else
+				printf("Device-local host-visible memory: %llu MB\n", (unsigned long long)(barSize >> 20));
+		}
+
+		// Fences and semaphores for work that only needs them for a
+		// while, like upload batches, are taken from this pool and
+		// given back, instead of being made and destroyed each time
+		sync_pool = new SyncPool(device);
+
+		// Anything that a frame on the GPU might still use is retired
+		// here, instead of being destroyed, and draw() destroys it when
+		// the frames that could use it are done, see DeletionQueue.cpp
+		deletion_queue = new DeletionQueue(device);
+
+		// Copies, readbacks, and other work that is recorded once, in
+		// one frame, take their command buffers from here. Each thread
+		// of the job system (and the render thread) has its own pools
+		oneshot_cmds = new CommandBufferPool(device, graphics_queue_family_index, frame_lag, job_system->GetWorkerCount() + 1);
+
+		// The lists that draw builds every frame (semaphores, swapchains,
+		// barriers) come from this, instead of std::vector, so that
+		// drawing a frame does not call new or malloc
+		frame_arena = new FrameArena();
+
+		// The Uploader records all copies from CPU buffers to
+		// GPU buffers and textures, and submits them to the
+		// transfer queue. Look at Uploader.cpp for more information
+		uploader = new Uploader(
+			device,
+			allocator,
+			queue, graphics_queue_family_index,
+			transfer_queue, transfer_queue_family_index,
+			sync_pool,
+			use_cached_staging);
+
+		if (use_timeline_semaphores)
+			uploader->EnableTimeline(fpWaitSemaphoresKHR, fpGetSemaphoreCounterValueKHR);
+
+		if (use_host_image_copy)
+			uploader->EnableHostImageCopy(fpTransitionImageLayoutEXT, fpCopyMemoryToImageEXT);
+
+		if (use_upload_budget)
+			uploader->EnableBudget(gpu, upload_budget_ms, upload_budget_copies);
+
+		// The present thread only presents the main swapchain. The
+		// output windows need the result of each present right away,
+		// and device groups pick a GPU for each present in draw()
+		if (use_present_thread && (use_output_windows || use_device_group))
+		{
+			printf("The present thread does not work with output windows or device groups, it is disabled\n");
+			use_present_thread = false;
+		}
+
+		// Display timing reads the past presents from the swapchain
+		// in every frame, which the present thread could be using at
+		// the same time, so the presents are not timed with it
+		if (use_present_thread)
+		{
+			display_timing_enabled = false;
+			present_thread = new PresentThread(queue, fpQueuePresentKHR, use_thread_scheduling ? &present_schedule : nullptr);
+		}
+
+		// Sparse binds go straight to the graphics queue
+		// (see SparseTilePool), and they could get ahead of
+		// the submissions that are waiting in the batch
+		graphics_submits = nullptr;
+
+		if (use_submit_batching && use_sparse_textures)
+		{
+			printf("Submit batching does not work with sparse textures, submit batching is disabled\n");
+			use_submit_batching = false;
+		}
+
+		if (use_submit_batching)
+		{
+			graphics_submits = new SubmitBatch(queue);
+			uploader->EnableBatching(graphics_submits);
+		}
+
+		// prepare the vertex buffer and
+		// the index buffer that the cube
+		// will use to draw
+		startup_timeline.Step("prepare_vb_ib");
+		prepare_vb_ib();
+
+		// place every cube of the scene
+		startup_timeline.Step("prepare_scene");
+		prepare_scene();
+
+		// make the instance buffer, if we use instancing
+		startup_timeline.Step("prepare_instances");
+		prepare_instances();
+
+		// the first run saves the scene, the next runs are done with the file
+		if (use_scene_snapshot)
+			save_scene_snapshot();
+
+		// Before continuing, please look at
+		// the shader files.
+		
+		// Inside cube.vert you will see the 
+		// uniform buffer that we are trying
+		// to prepare, which has one 4x4 matrix
+		// inside of it
+
+		// Insdie cube.frag, you will see the
+		// texture: uniform sampler2D samplerColor;
+
+		// The uniform buffer has a binding of 0
+		// the texture has a binding of 1
+		// Keep this in mind while moving through
+		// the next few functions
+
+		// prepare the uniform buffer with the 
+		// MVP matrix that gets sent to the shader
+		startup_timeline.Step("prepare_uniform_buffer");
+		prepare_uniform_buffer();
+
+		// A sampler is used by the graphics card to 
+		// get each pixel from the texture, depending
+		// on what UV coordinates we are looking for.
+		startup_timeline.Step("prepare_sampler");
+		prepare_sampler();
+
+		// load the RIT texture that gets sent to 
+		// the shader, you can load any PNG texture
+		// The pipeline cache is still being loaded by the init
+		// graph, so this one pipeline is made without it
+		if (use_gpu_decompression)
+			gpu_decompressor = new GpuDecompressor(device, VK_NULL_HANDLE, allocator, queue, oneshot_cmds, sync_pool);
+
+		if (use_gpu_texture_compression && !TextureCompressor::IsSupported(gpu))
+		{
+			printf("The GPU can not sample BC1 textures, GPU texture compression is disabled\n");
+			use_gpu_texture_compression = false;
+		}
+
+		if (use_gpu_texture_compression)
+			texture_compressor = new TextureCompressor(device, VK_NULL_HANDLE, allocator, queue, oneshot_cmds, sync_pool);
+
+		if (use_video_texture && !VideoTexture::IsSupported(gpu, video_format))
+		{
+			printf("The GPU can not sample the video format, the video texture is disabled\n");
+			use_video_texture = false;
+		}
+
+		startup_timeline.Step("prepare_textures");
+		prepare_textures();
+
+		// give every cube the index of its
+		// texture in the bindless texture array
+		startup_timeline.Step("prepare_bindless_textures");
+		prepare_bindless_textures();
+
+		// This is the layout, which will be given to 
+		// the pipeline, and it will tell the pipeline to 
+		// expect one uniform buffer and one texture
+		// for each draw call. If you have 100 different models,
+		// if each one uses one uniform buffer and one texture,
+		// then there should only be two descriptors here
+		startup_timeline.Step("prepare_descriptor_layout");
+		prepare_descriptor_layout();
+
+		// this is the descriptor pool, which will tell 
+		// the GPU how many different descriptors there will 
+		// be throughout the duration of the entire program.
+	
+		// If you have 100 different models, in the scene
+		// if each one uses one uniform buffer and one texture,
+		// then there should be 200 descriptors in the pool
+		startup_timeline.Step("prepare_descriptor_pool");
+		prepare_descriptor_pool();
+
+		// this creates the descriptor set. Right now there
+		// is only one descriptor set. A descriptor set is 
+		// a combination of descriptors (uniform buffers and textures)
+		// that fit the description of the descriptor_layout.
+		
+		// If you have 100 models in the scene that each 
+		// have one uniform buffer and one texture, you have
+		// a choice to make.
+		
+		// You can have 100 descriptor sets, each with one 
+		// uniform buffer and one texture (per model).
+
+		// You can have one descriptor set, and then
+		// erase the contents of the set and rewrite
+		// the contents between each draw call.
+
+		// Personally I think performance is the same,
+		// one option uses more memory and the other 
+		// option uses more processing, pick your poison.
+		// personally I have one descriptor set, which
+		// gets wiped and refilled between draw calls.
+		startup_timeline.Step("prepare_descriptor_set");
+		prepare_descriptor_set();
+
+		// submit every copy that was given to the uploader,
+		// on the transfer queue (if the GPU has one). This does
+		// not wait for the copies to finish. The uploader deletes
+		// the CPU buffers after the GPU is done with them, which
+		// it checks every frame in draw(). If this is not the first
+		// initialization, there is nothing to copy, so resizing
+		// the window never waits for uploads
+		startup_timeline.Step("Uploader Submit");
+		UploadTicket uploadTicket = uploader->Submit();
+
+		// The graphics queue is ordered behind the uploads, but the
+		// compute queue is not, and the culling pass reads the
+		// instance buffer, so with async compute we wait for them
+		if (use_async_compute)
+			uploader->Wait(uploadTicket);
+	}
+
+	// This creates the depth buffer.
+	// unlike other buffrs that are generated on the CPU
+	// and then (sometimes) copied to the GPU, this depth
+	// buffer is generated on GPU space, and left alone. 
+	// The GPU reads the buffer, the GPU writes to the buffer,
+	// so it gets created in GPU memory, then CPU
+	// leaves it alone
+	startup_timeline.Step("prepare_depth_buffer");
+	transient_pool = new TransientPool(device, allocator);
+	prepare_depth_buffer();
+
+	// the multisampled color image has the size of the
+	// window too, so it is made again with the depth buffer
+	prepare_msaa_target();
+	prepare_scene_color();
+	prepare_offscreen_target();
+
+	// now that the pool knows every image, and the
+	// phases they are used in, they get their memory
+	transient_pool->Build();
+
+	if (firstInit)
+	{
+		// The renderpass describes what type of
+		// data will be outputted by the GPU when
+		// it is done rendering a scene. In this example,
+		// it will create a color image (which is written
+		// to the swapchain), and a depth image, which
+		// is written to the depth buffer. We do not provide
+		// any buffers for the GPU to write to, we just say
+		// what type of data we want to be written
+		startup_timeline.Step("prepare_render_pass");
+		prepare_render_pass();
+	}
+
+	// we prepare the framebuffes, which say 
+	// specifically what buffers should be written
+	// to by the GPU. This is where we specifically
+	// say to write to the depth buffer and
+	// swapchain images, by giving the VkImageViews
+	// of those images.
+	startup_timeline.Step("prepare_framebuffers");
+	prepare_framebuffers();
+
+	// The post subpass reads the scene color of this size. The old
+	// descriptor pool points at the scene color of the last size, so
+	// it is kept until the frames that use it are done
+	if (use_post_subpass)
+	{
+		if (firstInit)
+			post_subpass = new PostSubpass(device);
+
+		VkDescriptorPool oldPool = post_subpass->SetInput(sceneColorGPU->imageView);
+
+		if (oldPool != VK_NULL_HANDLE)
+			deletion_queue->Retire(VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)oldPool, frame_count);
+	}
+
+	// We only prepare the pipeline once
+	// This includes loading shaders
+	if (firstInit)
+	{
+		// We prepare the graphics pipeline, which 
+		// describes every stage that the GPU will go
+		// through while the scene is being rendered:
+		// InputState, Vertex Shader, Fragment Shader,
+		// Blending, etc.
+		// The pipeline cache was loaded from the disk by a task
+		// of the init graph, and the shaders were compiled by another
+
+		// The pipeline compiler makes the optimized pipeline on
+		// another thread. We only have one pipeline, so one thread
+		// is enough, more pipelines could use more threads
+		pipeline_compiler = nullptr;
+
+		if (use_async_pipelines)
+			pipeline_compiler = new PipelineCompiler(1);
+
+		// the parts of the pipelines go into the pipeline cache too
+		pipeline_library = nullptr;
+
+		if (use_pipeline_library)
+			pipeline_library = new PipelineLibrary(device);
+
+		// The render pass and the descriptor layout are done, so the
+		// pipeline can be made on another thread too, when the pipeline
+		// cache and the shaders are ready, while we make the culling pass
+		uint32_t pipelineTask = initGraph->Add("prepare_pipeline", [this]() { prepare_pipeline(); }, pipelineDeps);
+
+		// make the culling pass, if we use GPU culling,
+		// it has a compute pipeline of its own, which
+		// also goes into the pipeline cache
+		startup_timeline.Step("wait for prepare_pipeline_cache");
+		initGraph->Wait(cacheTask);
+
+		startup_timeline.Step("CullingPass");
+		culler = nullptr;
+		hiz_pass = nullptr;
+
+		if (use_gpu_culling)
+		{
+			VkBuffer instanceBuffer = (use_dynamic_instances && !use_instance_deltas) ? instanceDataCPU.buffer : instanceDataGPU.buffer;
+			culler = new CullingPass(device, allocator, instanceBuffer, instance_count, pipelineCache, fpCmdDrawIndexedIndirectCountKHR, use_occlusion_culling,
+				frame_lag, (uint32_t)async_compute_families.size(), async_compute_families.data());
+		}
+
+		if (use_occlusion_culling)
+			hiz_pass = new HiZPass(device, pipelineCache, sampler_cache);
+
+		if (use_gpu_particles)
+			particle_system = new ParticleSystem(device, allocator, particle_capacity, pipelineCache);
+
+		if (use_compute_skinning)
+			skinning_pass->PreparePipeline(pipelineCache);
+
+		if (use_instance_deltas)
+			instance_scatter->PreparePipeline(pipelineCache);
+
+		if (use_occlusion_queries)
+			occlusion_queries = new OcclusionQueries(device, allocator, scene_object_count);
+
+		if (use_temporal_upscale)
+			temporal_pass = new TemporalPass(device, pipelineCache, sampler_cache);
+
+		if (use_shadow_cache)
+			prepare_shadow_cache();
+
+		if (use_gpu_picking)
+			prepare_object_picker();
+
+		if (use_hud)
+			hud->PreparePipeline(pipelineCache);
+
+		// the post subpass comes after the main subpass
+		if (use_post_subpass)
+			post_subpass->PreparePipeline(pipelineCache, render_pass, use_depth_prepass ? 2 : 1, use_half_precision);
+
+		startup_timeline.Step("wait for prepare_pipeline");
+		initGraph->Wait(pipelineTask);
+
+		// the depth-only pipeline needs the layout and the
+		// render pass, so it is made after the main pipeline
+		if (use_depth_prepass)
+			prepare_depth_prepass();
+
+		// the main pipeline went into the cache already,
+		// the prewarm adds the ones that the other options use
+		if (use_pipeline_prewarm && !pipeline_cache_valid)
+			prewarm_pipeline_cache();
+
+		if (use_runtime_shaders)
+			printf("Shaders: %u from the shader cache, %u compiled\n", shader_compiler->cacheHits, shader_compiler->compileCount);
+
+		// remember when the shaders were saved, so
+		// that reload_shaders can see when they change
+		if (use_shader_hot_reload)
+		{
+			vs_write_time = shader_compiler->GetWriteTime(vs_source_name);
+			fs_write_time = shader_compiler->GetWriteTime(fs_source_name);
+		}
+	}
+
+	// The depth pyramid has the size of the depth buffer, so it
+	// is made again every time the depth buffer is made again
+	hiz_pyramid = nullptr;
+
+	if (use_occlusion_culling)
+		hiz_pyramid = new HiZPyramid(device, allocator, hiz_pass->reduceLayout, culler->pyramidLayout, hiz_pass->sampler, depthBufferGPU, width, height);
+
+	// the shading rate image covers the whole window, like the depth buffer
+	shading_rate_image = nullptr;
+
+	if (use_shading_rate_image)
+		shading_rate_image = new ShadingRateImage(device, allocator, width, height, shading_rate_texel, frame_lag);
+
+	// the history has the size of the window, and
+	// reads the offscreen image and the depth buffer
+	temporal_history = nullptr;
+
+	if (use_temporal_upscale)
+	{
+		temporal_history = new TemporalHistory(device, allocator, temporal_pass->layout,
+			temporal_pass->pointSampler, temporal_pass->linearSampler, offscreenColorGPU, depthBufferGPU, width, height);
+	}
+
+	// The frame graph keeps its resources for the whole demo. The images
+	// that were just made start over, even if a new image happens to get
+	// the handle of an old one, its layout is UNDEFINED
+	if (firstInit)
+	{
+		frame_graph = new FrameGraph(frame_arena);
+		graph_depth = frame_graph->AddImage("Depth buffer");
+		graph_pyramid = frame_graph->AddImage("Depth pyramid");
+		graph_draws = frame_graph->AddBuffer("Draw commands");
+		graph_counts = frame_graph->AddBuffer("Draw count");
+		graph_occlusion = frame_graph->AddBuffer("Occlusion constants");
+		graph_particle_counters = frame_graph->AddBuffer("Particle counters");
+		graph_particle_instances = frame_graph->AddBuffer("Particle instances");
+		graph_mesh_vertices = frame_graph->AddBuffer("Mesh pool vertices");
+		graph_mesh_positions = frame_graph->AddBuffer("Mesh pool positions");
+		graph_instances = frame_graph->AddBuffer("Instance matrices");
+		graph_offscreen = frame_graph->AddImage("Offscreen color");
+		graph_swapchain = frame_graph->AddImage("Swapchain image");
+		graph_msaa = frame_graph->AddImage("MSAA color");
+		graph_shading_rate = frame_graph->AddImage("Shading rate");
+		graph_predicates = frame_graph->AddBuffer("Occlusion predicates");
+		graph_history[0] = frame_graph->AddImage("Temporal history 0");
+		graph_history[1] = frame_graph->AddImage("Temporal history 1");
+	}
+
+	frame_graph->Reset(graph_depth);
+	frame_graph->Reset(graph_pyramid);
+	frame_graph->Reset(graph_offscreen);
+	frame_graph->Reset(graph_msaa);
+	frame_graph->Reset(graph_shading_rate);
+	frame_graph->Reset(graph_history[0]);
+	frame_graph->Reset(graph_history[1]);
+
+	// Every task of the init graph has to be done before the first frame.
+	// The time of each task goes into the startup report, the tasks ran
+	// at the same time as the steps of this thread
+	if (initGraph != nullptr)
+	{
+		startup_timeline.Step("wait for the init graph");
+		initGraph->WaitAll();
+
+		for (uint32_t i = 0; i < initGraph->GetCount(); i++)
+			startup_timeline.AddTask(initGraph->GetName(i), initGraph->GetMs(i));
+
+		delete initGraph;
+	}
+
+	// Our "repare" functions above may generate pipeline commands
+	// that need to be executed before beginning the render loop.
+	// Such as copying buffers from CPU to GPU, these commands
+	// have been added to the command buffer, and now we execute the buffer
+
+	// set the current buffer (from zero to the number of swapchain images)
+	// to zero by default, because that's a good place to start
+	current_buffer = 0;
+
+	// print the startup report, sorted from the slowest step,
+	// this does nothing when prepare() runs again after a resize
+	startup_timeline.Finish();
+
+	// our demo is prepared, and ready to start rendering
+	prepared = true;
+
+	// Everything that prepare() made is new, so we draw, even with
+	// render on demand. After a resize, this is the only way to
+	// get an image with the new size on the screen
+	request_redraw();
+
+	// Our first initialization is done, so we set this to false.
+	// We will call prepare() many times, so we don't want to redo
+	// the things that we only need to initailize once. After the
+	// first initialization, we only want to redo things that depend
+	// on window size (which will be changing):
+	// depth buffer, swapchain images, framebuffers, etc.
+	firstInit = false;
+}
+
+void Demo::delete_resolution_dependencies()
+{
+	// depth buffer on the GPU (and the other images of
+	// the pool), and its pyramid
+	delete transient_pool;
+	delete hiz_pyramid;
+	delete shading_rate_image;
+	delete temporal_history;
+
+	// with the offscreen target, this is the only framebuffer
+	if (offscreen_framebuffer != VK_NULL_HANDLE)
+		vkDestroyFramebuffer(device, offscreen_framebuffer, HostAllocator::callbacks);
+
+	// Loop through each swapchain image
+	for (uint32_t i = 0; i < swapchainImageCount; i++)
+	{
+		// delete the "image" of this swapchain image
+		vkDestroyImageView(device, swapchain_image_resources[i].view, HostAllocator::callbacks);
+
+		// delete the framebuffer that is associated with this swapchain image
+		vkDestroyFramebuffer(device, swapchain_image_resources[i].framebuffer, HostAllocator::callbacks);
+		vkDestroyFramebuffer(device, swapchain_image_resources[i].hudFramebuffer, HostAllocator::callbacks);
+	}
+
+	// delete the array of swapchain_image_resources,
+	// which holds all the data that we deleted above ^^
+	// so that we can reallocate new images later
+	free(swapchain_image_resources);
+}
+
+void Demo::retire_resolution_dependencies()
+{
+	// This is the same as delete_resolution_dependencies, but
+	// the depth buffer and the swapchain_image_resources are kept
+	// until every frame that uses them is done, so that we do not
+	// need to wait for the GPU to be idle when the window is resized
+	for (uint32_t i = 0; i < swapchainImageCount; i++)
+	{
+		deletion_queue->Retire(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)swapchain_image_resources[i].view, frame_count);
+		deletion_queue->Retire(VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)swapchain_image_resources[i].framebuffer, frame_count);
+		deletion_queue->Retire(VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)swapchain_image_resources[i].hudFramebuffer, frame_count);
+	}
+
+	deletion_queue->Retire(VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)offscreen_framebuffer, frame_count);
+
+	// the depth buffer, the MSAA color, and the offscreen color
+	// are in the transient pool, the pyramid reads the depth buffer
+	SwapchainImageResources* resources = swapchain_image_resources;
+	TransientPool* transients = transient_pool;
+	HiZPyramid* pyramid = hiz_pyramid;
+	ShadingRateImage* shadingRate = shading_rate_image;
+	TemporalHistory* history = temporal_history;
+
+	deletion_queue->Retire([resources, transients, pyramid, shadingRate, history]()
+		{
+			free(resources);
+			delete pyramid;
+			delete shadingRate;
+			delete history;
+			delete transients;
+		},
+		frame_count);
+
+	swapchain_image_resources = nullptr;
+	transient_pool = nullptr;
+	depthBufferGPU = nullptr;
+	msaaColorGPU = nullptr;
+	sceneColorGPU = nullptr;
+	offscreenColorGPU = nullptr;
+	offscreen_framebuffer = VK_NULL_HANDLE;
+	hiz_pyramid = nullptr;
+	shading_rate_image = nullptr;
+	temporal_history = nullptr;
+}
+
+void Demo::retire_swapchain(VkSwapchainKHR old)
+{
+	// The old swapchain is retired by itself, because a minimized
+	// window retires the framebuffers, but it keeps the swapchain
+	// until a new swapchain is made (to give it as oldSwapchain)
+	PFN_vkDestroySwapchainKHR destroySwapchain = fpDestroySwapchainKHR;
+	VkDevice d = device;
+
+	deletion_queue->Retire([destroySwapchain, d, old]()
+		{
+			destroySwapchain(d, old, HostAllocator::callbacks);
+		},
+		frame_count);
+}
+
+const char* Demo::present_mode_name(VkPresentModeKHR mode)
+{
+	switch (mode)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+	case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+	case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+	default: return "UNKNOWN";
+	}
+}
+
+void Demo::set_present_mode(VkPresentModeKHR mode)
+{
+	present_mode = mode;
+
+	// The present mode can only be changed by making a new swapchain.
+	// resize() already does that, without waiting for the GPU, so
+	// we use it, with the same width and height as before
+	if (firstInit == false && !is_minimized)
+		resize(true);
+}
+
+void Demo::print_memory_report()
+{
+	allocator->UpdateBudget();
+	allocator->PrintReport();
+
+	// there is no pool while the window is minimized
+	if (transient_pool != nullptr)
+		printf("Transient images: %llu MB of memory for %llu MB of images\n",
+			(unsigned long long)(transient_pool->GetSize() >> 20),
+			(unsigned long long)(transient_pool->GetImageBytes() >> 20));
+
+	if (use_texture_streaming)
+		printf("Streamed textures: %llu MB of %llu MB\n",
+			(unsigned long long)(texture_streamer->GetResidentBytes() >> 20),
+			(unsigned long long)(texture_budget >> 20));
+
+	printf("Sync pool: %u fences, %u semaphores\n", sync_pool->fenceCount, sync_pool->semaphoreCount);
+	printf("One-shot command buffers: %u\n", (uint32_t)oneshot_cmds->allocatedCount);
+	printf("Frame arena: %llu KB at most in one frame\n", (unsigned long long)(frame_arena->peakBytes >> 10));
+
+	if (use_shadow_cache)
+		printf("Shadow map: %u static casters, drawn %u times, %u dynamic casters, drawn in %u frames\n",
+			(uint32_t)shadow_static_casters.size(), shadow_cache->staticDraws,
+			(uint32_t)shadow_dynamic_casters.size(), shadow_cache->dynamicDraws);
+
+	if (use_uniform_arena)
+		printf("Uniform arena: %llu KB of %llu KB at most in one frame, %llu draws did not fit\n",
+			(unsigned long long)(uniform_arena->peakBytes >> 10),
+			(unsigned long long)(uniform_arena->GetCapacity() >> 10),
+			(unsigned long long)uniform_arena->failedAllocations);
+
+	if (use_large_pages)
+		printf("Large pages: %llu MB\n", (unsigned long long)(LargePages::GetAllocatedBytes() >> 20));
+
+	// nothing, unless use_host_allocator is on
+	HostAllocator::PrintReport();
+}
+
+void Demo::cycle_present_mode()
+{
+	// go to the next mode in this list, and back to the start
+	VkPresentModeKHR modes[4] =
+	{
+		VK_PRESENT_MODE_FIFO_KHR,
+		VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+		VK_PRESENT_MODE_MAILBOX_KHR,
+		VK_PRESENT_MODE_IMMEDIATE_KHR
+	};
+
+	uint32_t next = 0;
+	for (uint32_t i = 0; i < 4; i++)
+		if (modes[i] == present_mode)
+			next = (i + 1) % 4;
+
+	set_present_mode(modes[next]);
+}
+
+void Demo::resize(bool force)
+{
+	// Do not try to resize the window
+	// if we haven't initialized the program yet,
+	// that would just be a waste
+
+	// Because WndProc can call resize()
+	// prior to initialization (which is rare),
+	// we need to check to see if we've already
+	// initialized
+	if (firstInit == false)
+	{
+		// Windows sends WM_SIZE for things that do not change the
+		// size, like restoring a window to the size it already had,
+		// or moving it to another monitor. The pipeline and the
+		// command buffers do not depend on the size at all (the
+		// viewport and scissor are dynamic, and set every frame in
+		// record_draws), so if the swapchain is already the right
+		// size, there is nothing to rebuild, and we keep drawing.
+		// set_present_mode uses force, because it needs a new
+		// swapchain even when the size is the same
+		if (!force && !is_minimized &&
+			(uint32_t)width == swapchain_extent.width && (uint32_t)height == swapchain_extent.height)
+			return;
+
+		// If the window is currently minimized, then the 
+		// width and height are zero, which means that the
+		// resolution-dependent assets were never built,
+		// so there would be nothing to delete
+
+		// only delete the resolution-dependent assets
+		// if the demo is not currently minimized	
+
+		// Keep in mind, if we are trying to resize the window WHILE is_minimized is false,
+		// that means that the program was already minimized, and resize() was called after 
+		// trying to un-minimize the window
+		if (!is_minimized)
+		{
+			// we are no longer prepared to render
+			prepared = false;
+
+			// We do not wait for the GPU to be idle here. Frames that
+			// are still on the GPU might be using the depth buffer and
+			// the framebuffers, so we retire them, and they are destroyed
+			// in draw(), when the fences tell us those frames are done.
+			// The GPU keeps drawing while the window is being resized
+
+			// retire only the things that depend on the size
+			// of the screen, like depth buffer and framebuffers.
+			// The swapchain is retired when the new one is made
+			retire_resolution_dependencies();
+		}
+	
+		// run the prepare function.
+		// firstInit is false, so it will only
+		// rebuild things that depend on image size,
+		// like depth buffer and swapchain, etc.
+		prepare();
+		swapchain_stale = false;
+	}
+}
+
+void Demo::build_render_queue()
+{
+	// Every cube is drawn once in each pass. There is only one
+	// pipeline in each pass, so that part of the key is zero for now.
+	// The texture only matters with bindless textures, without them
+	// every cube uses the same descriptor set
+	render_queue->Clear();
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		// The w of the clip position of the cube's center is its
+		// distance along the view direction, and the MVP gives the
+		// clip position of (0, 0, 0, 1), which is the center
+		float depth = object_mvps[i][3][3];
+		uint32_t material = (use_bindless_textures || use_texture_arrays) ? object_textures[i] : 0;
+
+		if (use_depth_prepass)
+			render_queue->Submit(RenderQueue::MakeKey(RENDER_PASS_DEPTH_PREPASS, 0, 0, depth), i);
+
+		render_queue->Submit(RenderQueue::MakeKey(RENDER_PASS_MAIN, 0, material, depth), i);
+	}
+
+	render_queue->Sort();
+}
+
+void Demo::update_occlusion_queries()
+{
+	// The query of a cube says if its box could be seen in the last
+	// frame. That is only worth trusting when the cube was inside of
+	// the view in the last frame too, a cube outside of the view has
+	// no pixels, so its query is 0 even when nothing is in front of it.
+	// When the camera is inside of a box, its faces can be clipped by
+	// the near plane, then the query can miss it too
+	glm::vec4 planes[6];
+	ExtractFrustumPlanes(view_projection, planes);
+
+	uint32_t visibleCount = CullSpheres(&object_transforms, planes, lod_object_radius, occlusion_visible.data());
+	glm::vec3 eye = camera.GetPosition();
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		bool inside = glm::distance(eye, object_transforms.GetPosition(i)) <= lod_object_radius;
+		object_conditional[i] = (object_in_view[i] && !inside) ? 1 : 0;
+		object_in_view[i] = 0;
+	}
+
+	// remember the cubes of this frame for the next one
+	for (uint32_t v = 0; v < visibleCount; v++)
+		object_in_view[occlusion_visible[v]] = 1;
+}
+
+void Demo::cull_meshlets()
+{
+	// where the camera is in the world, the view matrix
+	// moves it to (0, 0, 0), the camera still knows it
+	glm::vec3 eye = camera.GetPosition();
+
+	meshlet_draws.clear();
+	meshlets_tested = 0;
+	meshlets_culled = 0;
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		const MeshLod& lod = mesh_lods[object_lods[i]];
+
+		// The planes come from the MVP, so they are in the space of the
+		// cube, like the meshlets, and the camera is moved into it too
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(object_mvps[i], planes);
+		glm::vec3 localEye = glm::vec3(glm::inverse(object_models[i]) * glm::vec4(eye, 1.0f));
+
+		object_meshlet_first[i] = (uint32_t)meshlet_draws.size();
+
+		for (uint32_t m = lod.firstMeshlet; m < lod.firstMeshlet + lod.meshletCount; m++)
+		{
+			const Meshlet& meshlet = mesh_meshlets[m];
+			meshlets_tested++;
+
+			if (!IsMeshletVisible(meshlet, planes, localEye))
+			{
+				meshlets_culled++;
+				continue;
+			}
+
+			// The meshlets are next to each other in the index buffer,
+			// so a meshlet right after the last one that is drawn makes
+			// that draw longer, instead of adding a draw
+			size_t drawCount = meshlet_draws.size();
+
+			if (drawCount > object_meshlet_first[i] &&
+				meshlet_draws[drawCount - 1].firstIndex + meshlet_draws[drawCount - 1].indexCount == meshlet.firstIndex)
+			{
+				meshlet_draws[drawCount - 1].indexCount += meshlet.indexCount;
+				continue;
+			}
+
+			VkDrawIndexedIndirectCommand draw = {};
+			draw.indexCount = meshlet.indexCount;
+			draw.instanceCount = 1;
+			draw.firstIndex = meshlet.firstIndex;
+			draw.vertexOffset = (int32_t)cube_mesh.firstVertex;
+			draw.firstInstance = 0;
+			meshlet_draws.push_back(draw);
+		}
+
+		object_meshlet_count[i] = (uint32_t)meshlet_draws.size() - object_meshlet_first[i];
+	}
+
+	// the GPU reads this frame's slice, when it runs the draws
+	if (!meshlet_draws.empty())
+	{
+		meshlet_draws_cpu.Store(meshlet_draws.data(), (int)(meshlet_draws.size() * sizeof(VkDrawIndexedIndirectCommand)),
+			(VkDeviceSize)frame_index * meshlet_slice_draws * sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+// The index-th number of the Halton sequence in this base, from 0 to
+// 1. Each number falls in the biggest gap that the ones before it left
+static float halton(uint32_t index, uint32_t base)
+{
+	float result = 0.0f;
+	float fraction = 1.0f;
+
+	while (index > 0)
+	{
+		fraction /= (float)base;
+		result += fraction * (float)(index % base);
+		index /= base;
+	}
+
+	return result;
+}
+
+void Demo::update_uniform_buffer()
+{
+	mark_latency(LATENCY_MARKER_SIMULATION_START);
+
+	// The projection only changes when the window is resized, and
+	// the view only when the camera moves, so in most frames this
+	// is a compare, and the camera gives back the matrices that
+	// it already had. If this looks confusing, go back to
+	// prepare_uniform_buffers and read those comments
+	camera.SetAspect((float)width / (float)height);
+
+	view_matrix = camera.GetView();
+	projection_matrix = camera.GetProjection();
+	view_projection = camera.GetViewProjection();
+
+	// With temporal upscaling, the whole image is moved by less than
+	// a pixel, to a different place inside of the pixel in every frame.
+	// The places come from the Halton sequence (in base 2 and 3), which
+	// covers the pixel evenly, and it starts over every 8 frames. The
+	// translation is in clip space, which moves the image without
+	// changing the depth, and one pixel is 2 / render_width of clip space
+	if (use_temporal_upscale)
+	{
+		temporal_previous_vp = temporal_vp;
+		temporal_vp = view_projection;
+
+		uint32_t index = (uint32_t)(frame_count % 8) + 1;
+		temporal_jitter = glm::vec2(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+
+		glm::vec3 offset(2.0f * temporal_jitter.x / render_width, 2.0f * temporal_jitter.y / render_height, 0.0f);
+		// the jitter is in front of the projection, so the
+		// view-projection gets the same one, in one multiply
+		glm::mat4x4 jitter = glm::translate(glm::mat4(1.0f), offset);
+		projection_matrix = jitter * projection_matrix;
+		view_projection = jitter * view_projection;
+	}
+
+	// This is our model matrix
+	// Just like OpenGL, it handles the position, rotation, and scale of our 
+	// object, which is the cube in this case. We make our model matrix equal 
+	// to model matrix of the previous frame, with an addition of a "spin_angle" 
+	// rotation on the Y axis. This makes the cube rotate 0.025 radians each 
+	// frame, which is about 1.5 degrees per frame
+	// With GPU animation, the cubes turn in the vertex shader instead.
+	// With the fixed timestep, the simulation sets the model matrix
+	if (use_fixed_timestep)
+		update_simulation();
+	else if (!use_gpu_animation && !animation_paused)
+		model_matrix = glm::rotate(model_matrix, (float)0.025f, glm::vec3(0.0f, 1.0f, 0.0f));
+
+	// make temporary data where
+	// we can store data that will be
+	// in our buffer
+	uniform_struct temporaryData;
+
+	// create the MVP from the three matrices, just like we did
+	// when we first made the buffer, the camera already has two
+	// of them multiplied together
+	glm::mat4x4	MVP = view_projection * model_matrix;
+
+	// put our MVP into the temporary data buffer
+	temporaryData.mvp = MVP;
+
+	// Save the matrix of every cube for vkCmdPushConstants, each
+	// cube is moved to its own place in the grid, and spins like the
+	// model matrix. TransformBatch does 4 or 8 cubes at a time with
+	// SIMD, instead of two matrix multiplications for every cube
+	glm::quat spin = glm::quat_cast(model_matrix);
+
+	// in the generated scene, only the animated objects
+	// spin, the others keep the rotation that they had
+	if (use_scene_generator)
+	{
+		for (uint32_t i : scene_generator->animated)
+			object_transforms.SetRotation(i, spin);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < scene_object_count; i++)
+			object_transforms.SetRotation(i, spin);
+	}
+
+	glm::mat4x4 VP = view_projection;
+	TransformBatch(&object_transforms, 0, scene_object_count, VP, use_meshlets ? object_models.data() : nullptr, object_mvps.data());
+
+	// the objects are only drawn for a pick in a frame that has one
+	if (object_picker != nullptr && object_picker->HasRequest())
+		update_pick_draws();
+
+	// the objects that moved are drawn into the shadow map again
+	if (use_shadow_cache)
+		update_shadow_casters();
+
+	// the chunks that were edited get their new meshes, and
+	// the ones that can be seen are drawn after the cubes
+	// With streaming, the world slides under the camera, with the time
+	// of the simulation, and the ring follows the camera in the blocks
+	if (voxel_world != nullptr)
+	{
+		float time = (float)(((double)simulation_steps + simulation_alpha) * SIMULATION_STEP);
+		glm::mat4x4 model = glm::translate(voxel_model, glm::vec3(-voxel_fly_speed * time, 0.0f, 0.0f));
+		glm::vec3 eye = camera.GetPosition();
+
+		voxel_center = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.0f));
+		voxel_world->SetCenter(voxel_center);
+		voxel_world->Update(frame_count, get_completed_frames());
+		voxel_world->Cull(VP, model, &voxel_draws);
+	}
+
+	// move the instances that change this frame, and write
+	// them into this frame's slice of the instance buffer
+	if (use_dynamic_instances)
+		update_instances();
+
+	// pick the level of detail of every cube, from how
+	// big it is on the screen, for record_draws
+	for (uint32_t i = 0; i < scene_object_count; i++)
+		object_lods[i] = select_lod(i);
+
+	// and which meshlets of that LOD can be seen
+	if (use_meshlets)
+		cull_meshlets();
+
+	// and which cubes can be skipped by their occlusion query
+	if (use_occlusion_queries)
+		update_occlusion_queries();
+
+	// sort the draws of this frame, now that the cubes have moved
+	if (use_render_queue)
+		build_render_queue();
+
+	// With push constants, the matrix goes into the
+	// command buffer, so there is no buffer to update
+	if (use_push_constants)
+		return;
+
+	// the draws of the last frame that used this slice are done
+	if (use_uniform_arena)
+		uniform_arena->Reset(frame_index);
+
+	// We store data into the buffer, just like
+	// we did when we first made the buffer. We
+	// do not need to destroy and rebuild the buffer,
+	// we can reuse it. We only write to the slice of
+	// this frame_index, because the GPU might still be
+	// reading the other slice for the previous frame
+	// With GPU animation, the time goes in too, which is
+	// everything that the vertex shader needs to turn the cubes
+	if (use_gpu_animation)
+	{
+		// the time of the simulation, between its last two steps,
+		// or the real time, without the fixed timestep
+		float time = use_fixed_timestep ?
+			(float)(((double)simulation_steps + simulation_alpha) * SIMULATION_STEP) :
+			std::chrono::duration<float>((animation_paused ? pause_start : CpuClock::now()) - animation_start).count();
+
+		temporaryData.time = glm::vec4(time, 0.0f, 0.0f, 0.0f);
+		matrixBufferCPU.Store(&temporaryData, sizeof(uniform_struct), frame_index * uniform_slice_size);
+		return;
+	}
+
+	matrixBufferCPU.Store(&MVP[0][0], sizeof(MVP), frame_index * uniform_slice_size);
+}
+
+// Takes as many steps of the simulation as the time since the last
+// frame covers, and then puts the state between the last two steps
+// into the model matrix. The time that is left over, which is not
+// enough for a whole step, waits for the next frame
+void Demo::update_simulation()
+{
+	// while the animation is paused, the time
+	// goes by, but the simulation does not get it
+	CpuClock::time_point now = CpuClock::now();
+	if (!animation_paused)
+		simulation_accumulator += std::chrono::duration<double>(now - simulation_time).count();
+	simulation_time = now;
+
+	// A benchmark takes exactly one step in every frame, so every run
+	// draws the same frames, no matter how fast they are. Then a trace
+	// of it (see benchmark.cmd) is the same on every computer
+	if (benchmark_frames > 0)
+		simulation_accumulator = SIMULATION_STEP;
+
+	// If the frame took very long, we do not try to catch up,
+	// because more steps make the next frame even longer
+	if (simulation_accumulator > MAX_SIMULATION_STEPS * SIMULATION_STEP)
+		simulation_accumulator = MAX_SIMULATION_STEPS * SIMULATION_STEP;
+
+	while (simulation_accumulator >= SIMULATION_STEP)
+	{
+		step_simulation();
+		simulation_accumulator -= SIMULATION_STEP;
+	}
+
+	// How far we are between the last step and the next one, from
+	// 0 to 1. We draw the cube between the angles of the last two
+	// steps, which is a little bit behind the real time, but
+	// every frame shows exactly where the cube is at that moment
+	simulation_alpha = (float)(simulation_accumulator / SIMULATION_STEP);
+
+	if (!use_gpu_animation)
+	{
+		float angle = glm::mix(previous_spin_angle, spin_angle, simulation_alpha);
+		model_matrix = glm::rotate(glm::mat4(), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+}
+
+// Finds the part of the swapchain image that the cubes cover in this
+// frame. Every cube fits in a box that goes lod_object_radius from its
+// middle in every direction, so the 8 corners of that box are projected
+// to the screen, and the rectangle around all of them is returned, with
+// a few pixels more for antialiasing and for the upscaling filter
+VkRectLayerKHR Demo::find_dirty_rect()
+{
+	VkRectLayerKHR rect = {};
+	rect.extent = swapchain_extent;
+
+	glm::mat4 VP = view_projection;
+	float minX = 1.0f;
+	float minY = 1.0f;
+	float maxX = -1.0f;
+	float maxY = -1.0f;
+
+	for (uint32_t i = 0; i < scene_object_count; i++)
+	{
+		glm::vec3 center = object_transforms.GetPosition(i);
+
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 offset(
+				(corner & 1) ? lod_object_radius : -lod_object_radius,
+				(corner & 2) ? lod_object_radius : -lod_object_radius,
+				(corner & 4) ? lod_object_radius : -lod_object_radius);
+
+			glm::vec4 clip = VP * glm::vec4(center + offset, 1.0f);
+
+			// A corner that is behind the camera has no place on the
+			// screen, the cube could cover anything, so the whole image
+			// is dirty. The near plane is at 0.1, see update_uniform_buffer
+			if (clip.w <= 0.1f)
+				return rect;
+
+			minX = std::min(minX, clip.x / clip.w);
+			minY = std::min(minY, clip.y / clip.w);
+			maxX = std::max(maxX, clip.x / clip.w);
+			maxY = std::max(maxY, clip.y / clip.w);
+		}
+	}
+
+	// from -1 to 1 on the screen, to pixels. The Y axis is
+	// already flipped in the projection matrix, so -1 is the top
+	float width = (float)swapchain_extent.width;
+	float height = (float)swapchain_extent.height;
+
+	int32_t left = (int32_t)floorf((minX * 0.5f + 0.5f) * width) - 2;
+	int32_t top = (int32_t)floorf((minY * 0.5f + 0.5f) * height) - 2;
+	int32_t right = (int32_t)ceilf((maxX * 0.5f + 0.5f) * width) + 2;
+	int32_t bottom = (int32_t)ceilf((maxY * 0.5f + 0.5f) * height) + 2;
+
+	left = std::max(left, 0);
+	top = std::max(top, 0);
+	right = std::min(right, (int32_t)swapchain_extent.width);
+	bottom = std::min(bottom, (int32_t)swapchain_extent.height);
+
+	// If no cube is on the screen, nothing changed, but a region
+	// without rectangles means the whole image, so we say that
+	// one pixel in the corner changed instead
+	if (right <= left || bottom <= top)
+	{
+		rect.extent.width = 1;
+		rect.extent.height = 1;
+		return rect;
+	}
+
+	rect.offset.x = left;
+	rect.offset.y = top;
+	rect.extent.width = (uint32_t)(right - left);
+	rect.extent.height = (uint32_t)(bottom - top);
+	return rect;
+}
+
+// One step of the simulation, which moves
+// everything by SIMULATION_STEP seconds
+void Demo::step_simulation()
+{
+	previous_spin_angle = spin_angle;
+	spin_angle += 0.025f;
+
+	// Both angles go back by a full turn together, so the
+	// angle does not grow until the float loses precision,
+	// and the angle between them stays the same
+	if (previous_spin_angle > 2.0f * 3.14159265f)
+	{
+		previous_spin_angle -= 2.0f * 3.14159265f;
+		spin_angle -= 2.0f * 3.14159265f;
+	}
+
+	// the dynamic instances move in steps too, but they are
+	// not in between two steps, they jump from one to the next
+	if (use_dynamic_instances)
+		move_instances(simulation_steps);
+
+	simulation_steps++;
+}
+
+// True if the image was put on the screen more than
+// one refresh after the time that we asked for
+// Finds "key": in the text of a JSON file, and reads
+// the number after it. This is enough for the files that
+// finish_benchmark writes, it is not a real JSON parser
+static bool read_json_number(const char* text, const char* key, double* value)
+{
+	char pattern[64];
+	snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+	const char* found = strstr(text, pattern);
+	if (found == nullptr)
+		return false;
+
+	return sscanf(found + strlen(pattern), "%lf", value) == 1;
+}
+
+// the value that percent of the sorted times are below
+static double sorted_percentile(const std::vector<double>& sorted, uint32_t percent)
+{
+	if (sorted.size() == 0)
+		return 0.0;
+
+	return sorted[(sorted.size() - 1) * percent / 100];
+}
+
+// One result of the benchmark, and how much higher than the
+// baseline it can be (in percent) before it is a regression
+struct BenchmarkResult
+{
+	const char* key;
+	const char* unit;
+	double value;
+	double tolerance;
+};
+
+static bool present_was_late(uint64_t desired, uint64_t actual, uint64_t refresh)
+{
+	return actual > desired && actual > desired + refresh;
+}
+
+// True if the image could have been put on the screen earlier: the
+// earliest time it could have been shown was at least 2ms before it
+// was shown, and the GPU finished it at least 2ms before it was needed
+static bool present_could_be_earlier(uint64_t earliest, uint64_t actual, uint64_t margin)
+{
+	return earliest < actual && actual - earliest >= PRESENT_EARLY_MARGIN && margin >= PRESENT_EARLY_MARGIN;
+}
+
+void Demo::update_target_IPD()
+{
+	// Get the timing of every present that finished since the last
+	// time that we asked. The times are in nanoseconds
+	uint32_t count = 0;
+	fpGetPastPresentationTimingGOOGLE(device, swapchain, &count, NULL);
+
+	if (count == 0)
+		return;
+
+	VkPastPresentationTimingGOOGLE* past = (VkPastPresentationTimingGOOGLE*)
+		frame_arena->Allocate(count * sizeof(VkPastPresentationTimingGOOGLE));
+	fpGetPastPresentationTimingGOOGLE(device, swapchain, &count, past);
+
+	bool early = false;
+	bool late = false;
+	bool calibrate = false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		// How long it took from the moment that we called present,
+		// until the image was on the screen
+		uint64_t cpuTime = present_cpu_times[past[i].presentID % PRESENT_HISTORY];
+		if (past[i].actualPresentTime > cpuTime)
+		{
+			present_latency_total += (past[i].actualPresentTime - cpuTime) / 1000000.0;
+			present_latency_count++;
+		}
+
+		// and how long it took from reading the input
+		if (use_latency_markers)
+			latency_markers->OnPresented(present_frame_ids[past[i].presentID % PRESENT_HISTORY], past[i].actualPresentTime);
+
+		if (use_metrics_export)
+			metrics_exporter->AddPresent(past[i].presentID,
+				present_was_late(past[i].desiredPresentTime, past[i].actualPresentTime, refresh_duration));
+
+		if (use_telemetry_channel)
+			telemetry_channel->AddPresent(past[i].presentID,
+				present_was_late(past[i].desiredPresentTime, past[i].actualPresentTime, refresh_duration));
+
+		if (!syncd_with_actual_presents)
+		{
+			// This is the first timing we got for this swapchain. The
+			// presents that are still waiting were scheduled without
+			// knowing where the monitor's refresh was, so they are not
+			// really late, we do not count them when we see them
+			calibrate = true;
+			last_late_id = next_present_id - 1;
+			last_early_id = 0;
+			syncd_with_actual_presents = true;
+			break;
+		}
+		else if (present_could_be_earlier(past[i].earliestPresentTime, past[i].actualPresentTime, past[i].presentMargin))
+		{
+			// We only speed up after two seconds of early presents,
+			// so the frame rate does not jump up and down
+			if (last_early_id == past[i].presentID)
+			{
+				early = true;
+				last_early_id = 0;
+			}
+			else if (last_early_id == 0)
+			{
+				// this is the first early present, find
+				// the ID of the present two seconds from now
+				last_early_id = past[i].presentID + (uint32_t)(2000000000ULL / target_IPD);
+			}
+
+			late = false;
+			last_late_id = 0;
+		}
+		else if (present_was_late(past[i].desiredPresentTime, past[i].actualPresentTime, refresh_duration))
+		{
+			// The timing comes back a few frames after the present, so
+			// the presents after this one are probably late too. We only
+			// slow down once for all of them, and not again until
+			// a present after them is late
+			if (last_late_id == 0 || last_late_id < past[i].presentID)
+			{
+				late = true;
+				last_late_id = next_present_id - 1;
+			}
+
+			early = false;
+			last_early_id = 0;
+		}
+		else
+		{
+			// this present was right on time
+			early = false;
+			late = false;
+			calibrate = true;
+			last_early_id = 0;
+			last_late_id = 0;
+		}
+	}
+
+	// Two seconds of early presents, try one refresh less for each image
+	if (early && refresh_duration_multiplier > 1)
+	{
+		refresh_duration_multiplier--;
+		target_IPD = refresh_duration * refresh_duration_multiplier;
+	}
+
+	// A new late present, give each image one refresh more
+	if (late)
+	{
+		refresh_duration_multiplier++;
+		target_IPD = refresh_duration * refresh_duration_multiplier;
+	}
+
+	// Line up the next desired time with the last real present,
+	// so that we are in step with the monitor's refresh
+	if (calibrate)
+	{
+		uint64_t multiple = next_present_id - past[count - 1].presentID;
+		prev_desired_present_time = past[count - 1].actualPresentTime + multiple * target_IPD;
+	}
+
+	// print the latency every few hundred presents
+	if (present_latency_count >= GPU_TIMER_HISTORY)
+	{
+		printf("Present latency: avg %.3f ms, one image every %u refreshes\n",
+			present_latency_total / present_latency_count,
+			(uint32_t)refresh_duration_multiplier);
+
+		present_latency_total = 0;
+		present_latency_count = 0;
+	}
+}
+
+void Demo::draw()
+{
+	// When the program is first initialized, we should have an open fence.
+	// Aside from that, the fence will only be open if the queue is available.
+	// We wait until this fence is open. If it is already open by the time the C++
+	// code gets here, then it continues as normal is if the line weren't here.
+	// If it is closed, then it means that the Queue is still working on another frame.
+	// That means, our C++ code will pause here, and it will not move to the next line,
+	// until this fence is open (which will be when the queue is done).
+
+	// Waiting for this fence will confirm that we can draw a frame to this 
+	// to this frame index at this time (out of two possible slots).
+	// The benchmark starts with the first frame
+	if (frame_count == 0)
+		benchmark_start = CpuClock::now();
+
+	if (use_trace_capture)
+	{
+		if (frame_count == trace_start_frame)
+			start_trace();
+
+		trace_capture->BeginFrame(frame_count);
+	}
+
+	// Every CpuScope measures the time until the end of its { },
+	// which the profiler keeps, so we can see where the frame goes
+	cpu_profiler->BeginFrame();
+	// With timeline semaphores, we wait for the same frame, the one
+	// from frame_lag frames ago, by waiting for its number
+	{
+		CpuScope scope(cpu_profiler, CPU_MARKER_WAIT_FENCE);
+
+		if (use_timeline_semaphores)
+		{
+			if (frame_count >= frame_lag)
+				wait_for_frames(frame_count + 1 - frame_lag);
+		}
+		else
+			DeviceTable::WaitForFences(device, 1, &drawFences[frame_index], VK_TRUE, UINT64_MAX);
+	}
+
+	// If we got past the last line, it means that the fence is open,
+	// and we are ready to continue. Picture this in your mind, the 
+	// fence is open, so we walk through, and close the fence behind us.
+	// A timeline semaphore never needs to be reset
+	if (!use_timeline_semaphores)
+		DeviceTable::ResetFences(device, 1, &drawFences[frame_index]);
+
+	// Destroy the resources of old swapchains, and everything else
+	// that was retired, if the frames that used them are done. This
+	// is after the wait, so get_completed_frames counts this slot's frame
+	deletion_queue->BeginFrame(get_completed_frames());
+
+	// the last frame of this frame_index is done, so the
+	// descriptor sets that it made for one frame are free again
+	descriptor_allocator->BeginFrame(frame_index);
+
+	// and so are the one-shot command buffers that it submitted
+	oneshot_cmds->BeginFrame(frame_index);
+
+	// The arrays of the last frame were only used on the CPU,
+	// and that frame was submitted, so they are all gone now
+	frame_arena->Reset();
+
+	// In low latency mode, wait until the last frame is on the
+	// screen. The timeout makes sure that we never wait forever,
+	// if the presentation engine drops a frame
+	if (present_wait_enabled && frame_count > swapchain_first_frame)
+	{
+		CpuScope scope(cpu_profiler, CPU_MARKER_WAIT_FENCE);
+		VkResult presented = fpWaitForPresentKHR(device, swapchain, frame_count, PRESENT_WAIT_TIMEOUT);
+
+		// Without display timing, the end of the wait is the closest
+		// that we get to the time when the last frame was on the screen
+		if (use_latency_markers && !display_timing_enabled && presented == VK_SUCCESS)
+		{
+			uint64_t now = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				CpuClock::now().time_since_epoch()).count();
+			latency_markers->OnPresented(frame_count, now);
+		}
+	}
+
+	// With a device group, the GPUs take turns, each frame_index
+	// is always drawn by the same one (see prepare_physical_device)
+	uint32_t deviceIndex = frame_index % device_group_count;
+
+	// if another window took the monitor, and our
+	// window is in front again, take the monitor back
+	acquire_full_screen_exclusive();
+
+	// Get the index of the next available swapchain image.
+	// When the next image is available, it will trigger the
+	// image_aquired_semaphore as complete.
+	// The CPU work of the frame that does not need the image (see
+	// run_frame_work) usually runs before this. With polled acquire,
+	// we ask for the image without waiting, and if it is not ready,
+	// because the presentation engine still has all of the images,
+	// we do one piece of that work and ask again. We only wait in the
+	// driver when there is no work left, so the time that the CPU
+	// would sleep is spent on this frame instead
+	uint32_t nextWork = 0;
+	VkResult acquired = VK_NOT_READY;
+
+	if (use_polled_acquire)
+	{
+		while (nextWork < FRAME_WORK_COUNT)
+		{
+			{
+				CpuScope scope(cpu_profiler, CPU_MARKER_ACQUIRE);
+				acquired = acquire_next_image(0);
+			}
+
+			if (acquired != VK_NOT_READY && acquired != VK_TIMEOUT)
+				break;
+
+			run_frame_work(nextWork++);
+		}
+	}
+	else
+	{
+		while (nextWork < FRAME_WORK_COUNT)
+			run_frame_work(nextWork++);
+	}
+
+	{
+		CpuScope scope(cpu_profiler, CPU_MARKER_ACQUIRE);
+
+		if (acquired == VK_NOT_READY || acquired == VK_TIMEOUT)
+			acquire_next_image(UINT64_MAX);
+
+		// a window that is minimized shows nothing in this frame
+		for (size_t i = 0; i < output_windows.size(); i++)
+			output_windows[i]->Acquire(frame_index);
+	}
+
+	// the work that did not fit into the wait for the image
+	while (nextWork < FRAME_WORK_COUNT)
+		run_frame_work(nextWork++);
+
+	// Acquiring can wait for the monitor, so in low latency mode,
+	// the matrices are made after it. Push constants and the culling
+	// pass put the matrices in the command buffer, so they have to be
+	// ready before it is recorded, which is as late as we can go
+	if (low_latency)
+	{
+		CpuScope scope(cpu_profiler, CPU_MARKER_UPDATE_UNIFORMS);
+		update_uniform_buffer();
+	}
 
-	// By using #include, we can put those 
-	// arrays into the C++ program, and then
-	// we can compile the arrays into the EXE
+	// With async compute, the culling pass goes to the compute queue
+	// first, it only needs this frame's MVP. The GPU can run it while
+	// the graphics queue still finishes the last frame
+	if (use_async_compute)
+	{
+		CpuScope scope(cpu_profiler, CPU_MARKER_SUBMIT);
+		record_compute_cmd(frame_index);
+
+		VkSubmitInfo computeSubmit = {};
+		computeSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		computeSubmit.commandBufferCount = 1;
+		computeSubmit.pCommandBuffers = &compute_cmd[frame_index];
+		computeSubmit.signalSemaphoreCount = 1;
+		computeSubmit.pSignalSemaphores = &compute_complete_semaphores[frame_index];
+
+		QueueLock queueLock;
+		DeviceTable::QueueSubmit(compute_queue, 1, &computeSubmit, VK_NULL_HANDLE);
+	}
 
-	// Vertex Shader compiled to header
-	const unsigned char vs_code[] = {
-		#include "cube.vert.inc"
-	};
+	// the matrices are done, everything after
+	// this is building and submitting the frame
+	mark_latency(LATENCY_MARKER_SIMULATION_END);
+	mark_latency(LATENCY_MARKER_RENDER_SUBMIT_START);
 
-	// Fragment Shader compiled to header
-	const unsigned char fs_code[] = {
-		#include "cube.frag.inc"
-	};
+	// Record this frame's command buffer. It is only used by frames
+	// with this frame_index, and we already waited for the fence of
+	// this frame_index, so the GPU is not using it anymore. Resetting
+	// the pool resets every command buffer that came from it
+	{
+		CpuScope scope(cpu_profiler, CPU_MARKER_RECORD);
+		DeviceTable::ResetCommandPool(device, frame_cmd_pool[frame_index], 0);
 
-	// If you do not want to do this ^^^
-	// if you would prefer to take the compiled shader files
-	// and load them at runtime, you can make an empty array
-	// of bytes: char* vs_code = nullptr, char* fs_code = nullptr,
-	// Then you can use Helper::ReadFile to laod data from the 
-	// comopiled shader file into the byte arrays when the program
-	// launches, it works exactly the same as reading the PNG texture
-	// file, like we did before. If you want to use compiled shader
-	// files, then delete the lines in the compileShaders.cmd file
-	// that say:
-	//		del cube.vert.spv
-	//		del cube2.vert.spv
+		// the resolution of this frame comes from the GPU times
+		// of the frames before it, see DynamicResolution.cpp
+		if (use_dynamic_resolution)
+			update_render_size();
 
-	// Now, we need CreateInfo for each Shader Module.
-	// A Shader Module is a piece of a total Shader Program.
-	// One Shader Program is a combination of a vertex shader,
-	// a pixel shader, and sometimes more. So an individual
-	// vertex shader is a shader module, and a fragment shader
-	// is a shader module. We make a CreateInfo with the required sType
-	VkShaderModuleCreateInfo shaderInfo = {};
-	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		record_cmd(current_buffer, frame_index);
+	}
 
-	// We give a pointer to the bytes of the compiled vertex shader,
-	// and the number of bytes that are in the compiled vertex shader
-	shaderInfo.pCode = (uint32_t*)vs_code;
-	shaderInfo.codeSize = sizeof(vs_code);
+	// Wait for the image acquired semaphore to be signaled to ensure
+	// that the image won't be rendered to until the presentation
+	// engine has fully released ownership to the application, and it is
+	// okay to render to the image.
+	VkPipelineStageFlags pipe_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
-	// Then we use the createInfo to make the shader module
-	vkCreateShaderModule(device, &shaderInfo, NULL, &vert_shader_module);
+	// We are about to make a submission to the queue.
+	// Just like all queues, handles the first submission it gets,
+	// then the next, then the next, just like people standing in line at a store.
 
-	// We are going to re-use the createInfo that we used for the
-	// vertex shader, to make the createInfo for the fragment shader.
-	// All we have to do is replace the vertex shader data with
-	// the fragment shader data
+	// This submission will execute one command buffer, which is 
+	// the command buffer that is attached to the swapchain image that we can draw with.
+	// This submission will stay in the queue, and wait to be executed, until the 
+	// "image_aquired" semaphore is completed by fpAcquireNextImageKHR, because we cannot
+	// render to an image until we have one that is available.
+	// After the submission is finished executing, it will trigger the draw_complete
+	// semaphore as finished
 
-	// we give the pointer to compiled fragment shader bytes
-	// and the number of bytes in the compiled fragment shader
-	shaderInfo.pCode = (uint32_t*)fs_code;
-	shaderInfo.codeSize = sizeof(fs_code);
+	// We submit the command buffer that we just recorded, which
+	// draws to the swapchain image that is ready to be drawn to,
+	// which we determined with fpAcquireNextImageKHR
+
+	// The output windows are only written by blits, so their
+	// images are waited for at the TRANSFER stage. Each of them
+	// that has an image in this frame is presented below, together
+	// with the main swapchain
+	// The arrays have room for the main swapchain, the culling
+	// pass, and every output window, and they come from the frame
+	// arena, the output windows without an image leave a gap
+	size_t maxWaits = output_windows.size() + 2;
+	size_t maxSwapchains = output_windows.size() + 1;
+
+	VkSemaphore* waitSemaphores = (VkSemaphore*)frame_arena->Allocate(maxWaits * sizeof(VkSemaphore));
+	VkPipelineStageFlags* waitStages = (VkPipelineStageFlags*)frame_arena->Allocate(maxWaits * sizeof(VkPipelineStageFlags));
+	VkSwapchainKHR* presentSwapchains = (VkSwapchainKHR*)frame_arena->Allocate(maxSwapchains * sizeof(VkSwapchainKHR));
+	uint32_t* presentImages = (uint32_t*)frame_arena->Allocate(maxSwapchains * sizeof(uint32_t));
+	OutputWindow** presentWindows = (OutputWindow**)frame_arena->Allocate(maxSwapchains * sizeof(OutputWindow*));
+
+	uint32_t waitCount = 0;
+	uint32_t swapchainCount = 0;
+
+	// a headless image was not acquired, and it is not presented
+	bool headless = (window_mode == WINDOW_MODE_HEADLESS);
+
+	if (!headless)
+	{
+		waitSemaphores[0] = image_acquired_semaphores[frame_index];
+		waitStages[0] = pipe_stage_flags;
+		presentSwapchains[0] = swapchain;
+		presentImages[0] = current_buffer;
+		waitCount = 1;
+		swapchainCount = 1;
+	}
 
-	// Then we use the createInfo to make the shader module
-	vkCreateShaderModule(device, &shaderInfo, NULL, &frag_shader_module);
+	// the draws are read at DRAW_INDIRECT, everything
+	// before that can start before the culling is done
+	if (use_async_compute)
+	{
+		waitSemaphores[waitCount] = compute_complete_semaphores[frame_index];
+		waitStages[waitCount] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+		waitCount++;
+	}
 
-	// We create a list of pipeline stages
-	// In this case, there are two stages, a vertex shader
-	// and a fragment shader. We make the array, and use
-	// memset to set all bytes in the array to zero
-	VkPipelineShaderStageCreateInfo shaderStages[2];
-	memset(&shaderStages, 0, sizeof(VkPipelineShaderStageCreateInfo) * 2);
+	for (size_t i = 0; i < output_windows.size(); i++)
+	{
+		OutputWindow* w = output_windows[i];
 
-	// First we give the required sType, then
-	// we declare that thish particular stage is
-	// a vertex shader (VERTEX_BIT), then we give
-	// the vertex shader module that we made earlier,
-	// and we let the pipeline know that the entry
-	// function is "main". Rather than having 
-	// "void main() {...}", you can actually call the 
-	// function anything, as long as it matches the 
-	// name that is given here
-	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-	shaderStages[0].module = vert_shader_module;
-	shaderStages[0].pName = "main";
+		if (w->currentImage == UINT32_MAX)
+			continue;
 
-	// First we give the required sType, then
-	// we declare that thish particular stage is
-	// a fragment shader (FRAGMENT_BIT), then we give
-	// the fragment shader module that we made earlier,
-	// and we let the pipeline know that the entry
-	// function is "main".
-	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	shaderStages[1].module = frag_shader_module;
-	shaderStages[1].pName = "main";
+		waitSemaphores[waitCount] = w->GetSemaphore(frame_index);
+		waitStages[waitCount] = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		waitCount++;
 
-	// we let the PipelienCreateInfo know that there are two
-	// shader stages, and we give it the array of stages
-	// that we just made a moment ago
-	pipeInfo.stageCount = 2;
-	pipeInfo.pStages = shaderStages;
+		// the main swapchain is first, so window i is at i + 1
+		presentSwapchains[swapchainCount] = w->swapchain;
+		presentImages[swapchainCount] = w->currentImage;
+		presentWindows[swapchainCount - 1] = w;
+		swapchainCount++;
+	}
 
-	// Now that we have completed the PipelineCreateInfo,
-	// we want to create a PipelineCache, so that we
-	// can cache the pipeline after we create it. Caching
-	// the pipeline allows the GPU to use the pipeline more
-	// effeciently. We don't need to use the cache anywhere,
-	// we just need to create it, and the Vulkan driver will
-	// use the cache automatically, which is the only thing
-	// that the driver really does automatically for us
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.pWaitDstStageMask = waitStages;
+	submit_info.waitSemaphoreCount = waitCount;
+	submit_info.pWaitSemaphores = waitSemaphores;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &frame_cmd[frame_index];
+	submit_info.signalSemaphoreCount = 1;
+	submit_info.pSignalSemaphores = &draw_complete_semaphores[frame_index];
 
-	// We have a CacheCreateInfo with the required sType,
-	// and that is all that we need for now
-	VkPipelineCacheCreateInfo cacheInfo = {};
-	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	// With timeline semaphores, the submission also signals the timeline
+	// with the number of this frame. Each signaled semaphore needs a
+	// value, the binary semaphore (draw_complete) ignores its value
+	VkSemaphore signalSemaphores[3] = { draw_complete_semaphores[frame_index], frame_timeline, VK_NULL_HANDLE };
+	uint64_t signalValues[3] = { 0, frame_count + 1, 0 };
 
-	// We create an empty pipeline cache object, based on 
-	// the information given, which isn't a lot of information but
-	// still required to make it work
-	vkCreatePipelineCache(device, &cacheInfo, NULL, &pipelineCache);
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.signalSemaphoreValueCount = 2;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
 
-	// create the pipeline, with our pipeInfo structure
-	// and then our pipeline is stored into the cache
-	vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipeInfo, NULL, &pipeline);
+	VkFence submitFence = drawFences[frame_index];
 
-	// Now that our shaders are now copied into the pipeline,
-	// we do not need the individual modules anymore.
-	// destroy shader modules, now that they aren't needed
-	vkDestroyShaderModule(device, frag_shader_module, NULL);
-	vkDestroyShaderModule(device, vert_shader_module, NULL);
-}
+	if (use_timeline_semaphores)
+	{
+		submit_info.pNext = &timelineInfo;
+		submit_info.signalSemaphoreCount = 2;
+		submit_info.pSignalSemaphores = signalSemaphores;
+		submitFence = VK_NULL_HANDLE;
+	}
 
-void Demo::prepare_framebuffers()
-{
-	// Remember when we had VkImage for the swapchain 
-	// images and the depth buffer? Remember how we created
-	// a VkImageView to hold each VkImage? Here is where 
-	// that is important
+	// Nothing presents a headless frame, so nothing would wait for
+	// draw_complete, and it can not be signaled again while it is
+	// still signaled. Only the timeline is signaled, if there is one
+	if (headless && use_timeline_semaphores)
+	{
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &signalSemaphores[1];
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &signalValues[1];
+	}
+	else if (headless)
+		submit_info.signalSemaphoreCount = 0;
 
-	// The framebuffer holds the VkImageViews that
-	// will be written to by the GPU at the end of
-	// rendering each scene. 
-	
-	// When we created the swapchain, it was mentioned that
-	// the GPU will be swapping which image in the swapchain
-	// will be sent to the screen, and which image will be 
-	// written to by the GPU.
+	// When this frame gave an image to the encoder, the encoder's
+	// semaphore gets its number too (see EncoderBridge). It comes after
+	// the timeline, which is always signaled when there is an encoder
+	if (encode_number != 0)
+	{
+		signalSemaphores[2] = encoder_bridge->rendered->semaphore;
+		signalValues[2] = encode_number;
+		submit_info.signalSemaphoreCount++;
+		timelineInfo.signalSemaphoreValueCount++;
+	}
 
-	// If we put one swapchain image into a framebuffer,
-	// we cannot change which swapchain image is in that
-	// framebuffer, and the framebuffer tells the GPU 
-	// where to render an image to (the swapchain image).
+	// the NV driver is told which present this submission belongs to
+	VkLatencySubmissionPresentIdNV latencySubmitInfo = {};
+	latencySubmitInfo.sType = VK_STRUCTURE_TYPE_LATENCY_SUBMISSION_PRESENT_ID_NV;
+	latencySubmitInfo.presentID = frame_count + 1;
 
-	// Therefore, we need one framebuffer for each swapchain image.
+	if (latency_nv_enabled)
+	{
+		latencySubmitInfo.pNext = timelineInfo.pNext;
+		timelineInfo.pNext = &latencySubmitInfo;
+	}
 
-	// We create an array of two attachments,
-	// as described in the render pass, one will
-	// be used to export color of the image, and
-	// the other will be used for writing the depth buffer
-	VkImageView attachments[2];
+	// With a device group, the command buffer only runs on this
+	// frame's GPU, and that GPU waits for, and signals, the semaphores
+	uint32_t* waitDeviceIndices = (uint32_t*)frame_arena->Allocate(waitCount * sizeof(uint32_t));
+	uint32_t signalDeviceIndices[3] = { deviceIndex, deviceIndex, deviceIndex };
+
+	for (uint32_t i = 0; i < waitCount; i++)
+		waitDeviceIndices[i] = deviceIndex;
+	uint32_t commandDeviceMask = 1u << deviceIndex;
+
+	VkDeviceGroupSubmitInfoKHR groupSubmitInfo = {};
+	groupSubmitInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO_KHR;
+	groupSubmitInfo.waitSemaphoreCount = waitCount;
+	groupSubmitInfo.pWaitSemaphoreDeviceIndices = waitDeviceIndices;
+	groupSubmitInfo.commandBufferCount = 1;
+	groupSubmitInfo.pCommandBufferDeviceMasks = &commandDeviceMask;
+	groupSubmitInfo.signalSemaphoreCount = submit_info.signalSemaphoreCount;
+	groupSubmitInfo.pSignalSemaphoreDeviceIndices = signalDeviceIndices;
+
+	if (use_device_group)
+	{
+		groupSubmitInfo.pNext = submit_info.pNext;
+		submit_info.pNext = &groupSubmitInfo;
+	}
 
-	// The second attachment (at index 1) will be
-	// the depth buffer. That will be consistent
-	// for every framebuffer
-	attachments[1] = depthBufferGPU->imageView;
+	// Thish fence is currently closed, it will open when
+	// the queue's submission is complete
+	{
+		CpuScope scope(cpu_profiler, CPU_MARKER_SUBMIT);
+
+		// The uploads and the defragmentation of this frame are
+		// already in the batch, the frame goes last, and all of them
+		// go to the GPU with one vkQueueSubmit
+		// This frame signals draw_complete_semaphores[frame_index], which
+		// the present from frame_lag frames ago waits for. The present
+		// thread has to be past that present, otherwise the semaphore
+		// would be signaled twice before anything waited for it
+		if (use_present_thread)
+			present_thread->Wait(frame_lag - 1);
+
+		if (use_submit_batching)
+		{
+			graphics_submits->Add(submit_info);
+			graphics_submits->Flush(submitFence);
+		}
+		else
+		{
+			QueueLock queueLock;
+			DeviceTable::QueueSubmit(queue, 1, &submit_info, submitFence);
+		}
+	}
 
-	// we create a structure of information that will be used
-	// to create each framebuffer. sType will be the same
-	// for every FrameBufferCreateInfo
-	VkFramebufferCreateInfo fb_info = {};
-	fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	mark_latency(LATENCY_MARKER_RENDER_SUBMIT_END);
 
-	// We give it the renderpass, which describes how
-	// each attachment will be used (color vs depth)
-	fb_info.renderPass = render_pass;
+	// the frame is done, frame capture reads it back later
+	if (headless)
+	{
+		end_frame();
+		return;
+	}
 
-	// We give it the array of attachments,
-	// and we mention that there are two elements
-	// in the array. Keep in mind that this is a pointer
-	// to the array, so we can change the array before
-	// submitting the CreateInfo
-	fb_info.attachmentCount = 2;
-	fb_info.pAttachments = attachments;
+	// We are now submitting the command buffer that will draw
+	// an image to the screen. Here is how it will work.
+	// The command buffer we are submitting will bind a pipeline,
+	// the pipeline has a fragment shader that will export color
+	// to a framebuffer that was binded to the pipline. This 
+	// framebuffer has a swapchain image inside of it, and the
+	// swapchain image is connected to the VkSurface, which
+	// is connected to our HWND Window, which is on the screen.
+	// This repeats every frame, for everything we want to draw
 
-	// We give the width and height of the frameBuffer
-	// which is the same as the screen dimensions
-	fb_info.width = width;
-	fb_info.height = height;
-	
-	// We will only have one layer,
-	// don't worry about multpile layers,
-	// that is for advacned topics
-	fb_info.layers = 1;
+	// We wait for the draw_complete semaphore to finish, because we 
+	// shouldn't send an image to the screen if the image is not finished
+	// rendering
 
-	// loop through every swapchain image we have
-	for (uint32_t i = 0; i < swapchainImageCount; i++)
+	VkPresentInfoKHR present = {};
+	present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	present.waitSemaphoreCount = 1;
+	present.pWaitSemaphores = &draw_complete_semaphores[frame_index];
+	present.swapchainCount = swapchainCount;
+	present.pSwapchains = presentSwapchains;
+	present.pImageIndices = presentImages;
+
+	// one result for each swapchain, so that one window
+	// that needs a new swapchain does not hide the others
+	VkResult* presentResults = (VkResult*)frame_arena->Allocate(swapchainCount * sizeof(VkResult));
+	present.pResults = presentResults;
+
+	// With display timing, look at how the last presents went, and
+	// ask for this image to be shown target_IPD after the last one.
+	// The very first image has nothing to line up with, so we guess
+	// half of target_IPD from now, and update_target_IPD corrects it
+	// The chained structs need one entry for each swapchain, the
+	// output windows show the same image as the main window, so
+	// they get the same time and the same ID
+	VkPresentTimeGOOGLE presentTime = {};
+	VkPresentTimesInfoGOOGLE presentTimes = {};
+	VkPresentTimeGOOGLE* windowTimes = nullptr;
+
+	if (display_timing_enabled)
 	{
-		// set the first member of the attachment array (index 0)
-		// to the swapchain image that we want to render to, for each
-		// framebuffer
-		attachments[0] = swapchain_image_resources[i].view;
+		update_target_IPD();
 
-		// create a framebuffer for each swapchain image
-		// based on the information provided.
-		// This will be stored in the array of swapchain_image_resources
-		// along with the Image, ImageView, and commmandBuffer of each
-		// swapchain image. Command buffers for drawing will be explained soon.
-		vkCreateFramebuffer(device, &fb_info, NULL, &swapchain_image_resources[i].framebuffer);
+		uint64_t now = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			CpuClock::now().time_since_epoch()).count();
+
+		if (prev_desired_present_time == 0)
+			presentTime.desiredPresentTime = now + (target_IPD >> 1);
+		else
+			presentTime.desiredPresentTime = prev_desired_present_time + target_IPD;
+
+		presentTime.presentID = next_present_id++;
+		prev_desired_present_time = presentTime.desiredPresentTime;
+		present_cpu_times[presentTime.presentID % PRESENT_HISTORY] = now;
+		present_frame_ids[presentTime.presentID % PRESENT_HISTORY] = frame_count + 1;
+
+		windowTimes = (VkPresentTimeGOOGLE*)frame_arena->Allocate(swapchainCount * sizeof(VkPresentTimeGOOGLE));
+
+		for (uint32_t i = 0; i < swapchainCount; i++)
+			windowTimes[i] = presentTime;
+
+		presentTimes.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+		presentTimes.swapchainCount = swapchainCount;
+		presentTimes.pTimes = windowTimes;
+		present.pNext = &presentTimes;
 	}
-}
 
-void Demo::build_swapchain_cmds()
-{
-	// Create the information needed to start the command buffer,
-	// we give it the required sType to get started
-	VkCommandBufferBeginInfo cmd_buf_info = {};
-	cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	// Each present gets an ID, which is the number of the frame
+	// (starting at 1), so that present wait can wait for it
+	uint64_t* presentIds = (uint64_t*)frame_arena->Allocate(swapchainCount * sizeof(uint64_t));
 
-	// Set our clear colors. This sets the background 
-	// color to "cornflower blue", which was the default
-	// clear color for XNA and MonoGame, it looks nice,
-	// but literally this can be anything
-	VkClearValue clear_values[2];
-	clear_values[0].color.float32[0] = 100.0f / 255.0f;
-	clear_values[0].color.float32[1] = 149.0f / 255.0f;
-	clear_values[0].color.float32[2] = 237.0f / 255.0f;
-	clear_values[0].color.float32[3] = 0.0f;
-	
-	// reset depth to maximum depth, so that we can draw over it
-	clear_values[1].depthStencil.depth = 1.0f;
-	clear_values[1].depthStencil.stencil = 0;
+	for (uint32_t i = 0; i < swapchainCount; i++)
+		presentIds[i] = frame_count + 1;
 
-	// setup everything we need to begin using a render pass,
-	// give it the render pass we made, give it the dimensions
-	// of the window, give it the 2 clear values (color and depth)
-	VkRenderPassBeginInfo rp_begin = {};
-	rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	rp_begin.renderPass = render_pass;
-	rp_begin.renderArea.extent.width = width;
-	rp_begin.renderArea.extent.height = height;
-	rp_begin.clearValueCount = 2;
-	rp_begin.pClearValues = clear_values;
+	VkPresentIdKHR presentIdInfo = {};
+	presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentIdInfo.swapchainCount = swapchainCount;
+	presentIdInfo.pPresentIds = presentIds;
 
-	// Get ready to begin a command buffer, the level will
-	// be primary, because this is the command buffer that
-	// is submitted to the queue. We are creating
-	// one command buffer at a time, which is why Count is 1,
-	// even though we will use this information to make 3 buffers,
-	// because they are being made one-at-a-time
-	VkCommandBufferAllocateInfo cmdInfo = {};
-	cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	cmdInfo.commandPool = cmd_pool;
-	cmdInfo.commandBufferCount = 1;
-
-	// create a new command buffer for each swapchain image.
-	// Each command buffer has its own framebuffer, and each framebuffer
-	// has its own swapchain image. This allows us to swap command buffers
-	// when drawing, which allows us to swap the image we are rendering to,
-	// which allows us to utilize the swapchain
-	for (uint32_t i = 0; i < swapchainImageCount; i++)
+	if (present_id_enabled)
 	{
-		// create a command buffer
-		VkCommandBuffer cmd;
-
-		// allocate new memory for this command buffer.
-		// If this is the first time we are here, then of course it has not been allocated yet.
-		// If we are calling prepare() again after resizing the screen, then the command buffer
-		// was deleted when we resized the window (because swapchain image was deleted, which
-		// deletes the frame buffer and command buffer that correspond) so now we have to 
-		// reallocate it
-		vkAllocateCommandBuffers(device, &cmdInfo, &cmd);
-
-		// The RenderPassBeginInfo needs a framebuffer to know which
-		// image and depth buffer to render to, so give the framebuffer
-		// that is in the array of swapchain_image_resources
-		rp_begin.framebuffer = swapchain_image_resources[i].framebuffer;
-
-		// begin our command buffer
-		// we can now put commands into this command buffer
-		vkBeginCommandBuffer(cmd, &cmd_buf_info);
-
-		// the contents are INLINE, because we are calling each command in this 
-		// command buffer, one at a time. Sounds obvious, but this
-		// will change in advanced tutorials
-		vkCmdBeginRenderPass(cmd, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
-
-		// Bind our pipeline, let Vulkan know that it is a GRAPHICS pipeline.
-		// There are other types of pipelines, so we need to specify GRAPHICS.
-		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-		// Bind our descriptor set to the GRAPHICS pipeline
-		// Multiple pipelines of different types can be bound
-		// to a command buffer at the same time
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1,
-			&descriptor_set, 0, NULL);
-
-		// This sets the scale of the viewport.
-		// It takes the fully-rendered image, and scales it down to a portion of the
-		// screen provided by the dimensions specified in viewport. If you don't want to scale the
-		// image down, leave the viewport as it is. If you want to see what it does, change
-		// "width" and "height" to "width/2" and "height/2". That will draw the final image at 25% size in 
-		// the top-left corner of the window. This can be used for splitscreen multiplayer. If you want to
-		// utilize this feature, the image might look squished or stretched. To fix this, go back to 
-		// glm::perspective and change the aspect ratio to match the ratio of the  viewport. If you do not 
-		// know what glm::perspective is that comes in a future tutorial, and that means I accidentally
-		// left the comment about glm::persepctive here by mistake
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)width;
-		viewport.height = (float)height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		vkCmdSetViewport(cmd, 0, 1, &viewport);
-
-		// Bonus trick that you can try on your own
-		//===============================================================
-
-		// Exzap, from Cemu, has a trick where he adjusts for Vulkan's inverted Y-axis by flipping
-		// the viewport, rather than altering the projection matrix. The reason why I personally don't use 
-		// this trick here, is because it requires Vulkan 1.1, or it requires Vulkan 1.0 to use the 
-		// extension VK_KHR_MAINTENANCE1_EXTENSION_NAME. There is nothing wrong with adding the extension, 
-		// nor is there anything wrong with Vulkan 1.1, but for these simple tutorials, I want to make sure
-		// that nobody has compatibility problems. Anyone who has a GPU that supports Vulkan 1.0 should
-		// be able to run this tutorial, with only the SURFACE_EXTENSION and WIN32_EXTENSION
-
-		// However, I do use Vulkan 1.1 in other personal projects, and I flip the viewport in those projects.
-		// If anyone wants to try this trick for themselves, go back to the prepare_instance() function
-		// and enable the extension in Vulkan 1.0, or try enabling Vulkan 1.1, then delete the adjustment to the 
-		// perspective projection (in update_uniform_buffer, and in prepare_uniform_buffer), then flip 
-		// the Viewport here in this function. All Vulkan 1.0 maintenance features are in Vulkan 1.1
-
-		// And now, back to the tutorial
-
-		// Scissor tests clip to a rectangle inside that viewport.
-		// If you do not want to clip the image, then leave the 
-		// Scissor the way it is. If you want to see what it does, change
-		// "width" and "height" to "width/2" and "height/2".
-		// That will draw the final image at 100% size, but it will only
-		// draw the top-left quadrant of the window. This can be used
-		// for black cinematic bars on the screen during cutscenes.
-
-		VkRect2D rect = {};
-		rect.offset.x = 0;
-		rect.offset.y = 0;
-		rect.extent.width = width;
-		rect.extent.height = height;
-		vkCmdSetScissor(cmd, 0, 1, &rect);
-
-		// Bind triangle vertex buffer
-		// The offset is zero, which means we are starting with
-		// the first vertex in the buffer. We are binding 1 buffer,
-		// which is the GPU buffer, but this can be used to bind 
-		// arrays of vertex buffers
-		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(cmd, 0, 1, &vertexDataGPU->buffer, offsets);
-
-		// Bind triangle index buffer
-		// This is a 32-bit index buffer, because the data in the buffer
-		// is an array of integers, which each have 32 bits. If you want 16-bit
-		// index buffer, the buffer has to be an array of 'short', and the type 
-		// has to be changed to VK_INDEX_TYPE_UINT16, but for now, leave it as
-		// VK_INDEX_TYPE_UINT32
-		vkCmdBindIndexBuffer(cmd, indexDataGPU->buffer, 0, VK_INDEX_TYPE_UINT32);
+		presentIdInfo.pNext = present.pNext;
+		present.pNext = &presentIdInfo;
+	}
 
-		// Draw the indexed triangle
-		// We have 36 indices in the index buffer
-		// We are drawing these 36 indices one time
-		vkCmdDrawIndexed(cmd, 36, 1, 0, 0, 1);
+	// With a device group, the image is presented by the GPU that was
+	// picked for this frame's GPU in prepare_swapchain, which is LOCAL
+	// if it is the same GPU, and REMOTE if the image is copied over.
+	// Output windows are off with device groups, so there is one swapchain
+	uint32_t presentDevice = device_group_present_device[deviceIndex];
+	uint32_t presentDeviceMask = 1u << presentDevice;
+
+	VkDeviceGroupPresentInfoKHR groupPresentInfo = {};
+	groupPresentInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_INFO_KHR;
+	groupPresentInfo.swapchainCount = 1;
+	groupPresentInfo.pDeviceMasks = &presentDeviceMask;
+	groupPresentInfo.mode = (presentDevice == deviceIndex) ?
+		VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR : VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR;
+
+	if (use_device_group)
+	{
+		groupPresentInfo.pNext = present.pNext;
+		present.pNext = &groupPresentInfo;
+	}
+
+	// With incremental present, the main swapchain gets the part of
+	// the image that changed, which is where the cubes are now, and
+	// where they were in the last present, because that part is the
+	// background again. A region without rectangles means that the
+	// whole image changed, which is what the output windows get, and
+	// what the main window gets when it has a new swapchain
+	VkRectLayerKHR dirtyRect = {};
+	VkPresentRegionKHR* regions = nullptr;
+	VkPresentRegionsKHR presentRegions = {};
+
+	if (use_incremental_present)
+	{
+		VkRectLayerKHR rect = find_dirty_rect();
+		dirtyRect = rect;
+
+		if (previous_dirty_rect_valid)
+		{
+			int32_t minX = std::min(rect.offset.x, previous_dirty_rect.offset.x);
+			int32_t minY = std::min(rect.offset.y, previous_dirty_rect.offset.y);
+			int32_t maxX = std::max(rect.offset.x + (int32_t)rect.extent.width, previous_dirty_rect.offset.x + (int32_t)previous_dirty_rect.extent.width);
+			int32_t maxY = std::max(rect.offset.y + (int32_t)rect.extent.height, previous_dirty_rect.offset.y + (int32_t)previous_dirty_rect.extent.height);
+
+			dirtyRect.offset.x = minX;
+			dirtyRect.offset.y = minY;
+			dirtyRect.extent.width = (uint32_t)(maxX - minX);
+			dirtyRect.extent.height = (uint32_t)(maxY - minY);
+		}
+
+		regions = (VkPresentRegionKHR*)frame_arena->Allocate(swapchainCount * sizeof(VkPresentRegionKHR));
+		memset(regions, 0, swapchainCount * sizeof(VkPresentRegionKHR));
 
-		// Note that ending the renderpass changes the image's layout from
-		// COLOR_ATTACHMENT_OPTIMAL to PRESENT_SRC_KHR.
-		vkCmdEndRenderPass(cmd);
+		if (previous_dirty_rect_valid)
+		{
+			regions[0].rectangleCount = 1;
+			regions[0].pRectangles = &dirtyRect;
+		}
 
-		// end our command buffer
-		vkEndCommandBuffer(cmd);
+		presentRegions.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+		presentRegions.swapchainCount = swapchainCount;
+		presentRegions.pRegions = regions;
+		presentRegions.pNext = present.pNext;
+		present.pNext = &presentRegions;
 
-		// set the swapchain command buffer equal to the
-		// cmd that we just created here, and then move on
-		// to the next command buffer in the array
-		swapchain_image_resources[i].cmd = cmd;
+		previous_dirty_rect = rect;
+		previous_dirty_rect_valid = true;
 	}
-}
 
-void Demo::prepare()
-{
-	// We will be calling prepare() multiple times.
-	// Some Vulkan assets only need to be created once, like
-	// the instance, the device, and the queue (i'll explain those later),
-	// while some things need to be destroyed and rebuilt, like the 
-	// depth buffer and swapchain images (I'll explain those later).
+	// submit the presentInfo to the queue.
+	// The queue will execute our request to present
+	// an image as soon as it is done rendering the
+	// image that we want rendered in the command buffer
+	// With the present thread, it gets copies of the chained structs,
+	// because the frame arena is reset before the thread might get to them
+	VkResult mainPresentResult;
+	mark_latency(LATENCY_MARKER_PRESENT_START);
+	{
+		CpuScope scope(cpu_profiler, CPU_MARKER_PRESENT);
 
-	// We keep track of a variable called firstInit, to determine
-	// if we have run the prepare() function before. "firstInit"
-	// is initialized as true at the top of Demo.cpp, and it is
-	// set to false after the first initialization is done
+		if (use_present_thread)
+		{
+			PresentRequest request = {};
+			request.swapchain = swapchain;
+			request.imageIndex = current_buffer;
+			request.waitSemaphore = draw_complete_semaphores[frame_index];
+			request.hasRegion = use_incremental_present;
 
-	if (firstInit)
-	{
-		// Validation will tell us if our Vulkan code is correct.
-		// Sometimes, our code will execute the way we want it to,
-		// but just becasue the code runs, does not mean the code
-		// is correct. If you've ever used HTML, you may have used
-		// and HTML validator, where your website might look correct,
-		// but the validator will tell you that the code is wrong
+			if (use_incremental_present)
+			{
+				request.rectangleCount = regions[0].rectangleCount;
+				request.rectangle = dirtyRect;
+			}
 
-		// If you run in Debug mode, no Validator text will appear,
-		// text from Validator will only appear if you are in Release Mode
+			// the result of the last present that is done
+			mainPresentResult = present_thread->GetLastResult();
+			present_thread->Push(request);
+		}
+		else
+		{
+			QueueLock queueLock;
+			fpQueuePresentKHR(queue, &present);
+			mainPresentResult = presentResults[0];
+		}
+	}
+	mark_latency(LATENCY_MARKER_PRESENT_END);
 
-		// During development, this is a great tool. However, when it is
-		// time to release a software or game, you don't want this running
-		// in the background because it will continue constantly checking for errors
-		// even if there are no errors. So, when you want to release a software or
-		// game, simply set this to false.
-		validate = true;
+	// the main swapchain is rebuilt by WM_SIZE, the
+	// output windows rebuild theirs when they need it
+	for (uint32_t i = 0; i + 1 < swapchainCount; i++)
+		presentWindows[i]->SetPresentResult(presentResults[i + 1]);
 
-		// During development, it is good to have a console window.
-		// You can read errors, and write printf statements.
-		// However, if you want to release a software or game, you may
-		// not want a console window. Simply comment out this line to 
-		// disable the console window.
-		prepare_console();
+	// Windows takes the monitor away when another window comes to the
+	// front (like with Alt+Tab), then presents fail until we take it back
+	if (mainPresentResult == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT)
+		full_screen_exclusive_acquired = false;
 
-		// set the width and height of the window
-		// literally set this to whatever you want
-		width = 640;
-		height = 360;
+	// While the window is dragged, the render thread keeps drawing into
+	// the old swapchain for a while (see RenderLoop), which most drivers
+	// scale into the window. The ones that can not say so here
+	swapchain_stale = (mainPresentResult == VK_SUBOPTIMAL_KHR || mainPresentResult == VK_ERROR_OUT_OF_DATE_KHR);
 
-		// build the window with the Win32 API. This will look similar to how
-		// a window is created in a DirectX 11/12 engine, and we will use the
-		// WndProc from main.cpp to create the window
-		prepare_window();
+	end_frame();
+}
 
-		// We create an instance of Vulkan, this allows us to use VUlkan
-		// commands on the CPU, but we will not yet be able to talk to 
-		// the graphics device, that comes later
-		prepare_instance();
+void Demo::end_frame()
+{
+	cpu_profiler->EndFrame();
 
-		// Soem Vulkan functions are not available in the SDK's
-		// .lib or .dll files, but instead are inside the driver,
-		// this is how you get some of them from the instance
-		prepare_instance_functionPointers();
+	if (use_metrics_export)
+		export_metrics();
 
-		// The physical device gives us all the properties of the GPU
-		// that we want to use to render, such as the name of the GPU,
-		// how much memory it has, what features it supports, etc.
-		// We cannot send commands to the GPU through the PhysicalDevice,
-		// but we can use it to determine what our GPU can do.
-		prepare_physical_device();
+	if (use_telemetry_channel)
+		publish_telemetry();
 
-		// we create the surface of Vulkan, which helps Vulkan move a
-		// fully-rendered image from the graphics card to the screen
-		prepare_surface();
+	if (use_spike_detector)
+		check_spike();
 
-		// The PhysicalDevice and the Device both refer to the same
-		// GPU. The difference is that PhysicalDevice tells us the 
-		// GPU's properties, while Device allows us to send commands
-		// to the GPU.
+	// The memory is only our blocks, not the usage that the driver
+	// reports, so it is the same on every run of the same settings
+	if (benchmark_frames > 0)
+	{
+		VkDeviceSize bytes = 0;
 
-		// The queue, is exactly what it sounds like. If you have
-		// never used a queue before, do a google search on 
-		// std::queue to understand the concepts. The queue that
-		// we use here is not made with std::queue, but it works
-		// the same way. The VkQUeue is the middle-man between
-		// C++ and the GPU (VkDevice). C++ will submit commands
-		// to the queue, and then the queue will shovel the commands
-		// into the GPU. We have to create the Device and the Queue
-		// at the same time
+		for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+			bytes += allocator->GetHeapStats(i).blockBytes;
 
-		// Create the Device and the Queue
-		prepare_device_queue();
+		benchmark_peak_memory = std::max(benchmark_peak_memory, bytes);
+	}
 
-		// Soem Vulkan functions are not available in the SDK's
-		// .lib or .dll files, but instead are inside the driver,
-		// this is how you get some of them from the device
-		prepare_device_functionPointers();
+	// increment our frame counter
+	frame_index += 1;
+	frame_index %= frame_lag;
+	frame_count++;
 
-		// The Swapchain and currentPresentMode
-		// variables will be thoroughly explained
-		// in the prepare_swapchain() function
+	if (benchmark_frames > 0 && frame_count == benchmark_frames)
+		finish_benchmark();
+}
 
-		// sometimes this does not default to NULL
-		// so lets set it to NULL here. If this line
-		// is removed, then a validation error is risked.
-		swapchain = VK_NULL_HANDLE;
+void Demo::export_metrics()
+{
+	// the whole frame, from the start of the last one, which
+	// is what the screen sees, and the newest GPU time
+	CpuFrameSample sample = cpu_profiler->GetSample(cpu_profiler->GetSampleCount() - 1);
+	metrics_exporter->AddFrame(sample.ms[CPU_MARKER_FRAME], gpu_timer->GetLastFrameMs());
 
-		// Set the current present mode of the swapchain
-		currentPresentMode = (VkPresentModeKHR)0;
-	}
+	if (!metrics_exporter->IsIntervalOver())
+		return;
 
-	// build the swapchain, and also
-	// prepare the images that are
-	// in the swapchain
-	prepare_swapchain();
+	// the memory is only read once for each interval
+	VkDeviceSize usage = 0;
+	VkDeviceSize budget = 0;
 
-	// If the screen is minimized, do not contineu the function.
-	// Exit the prepaer() function, stop drawing to the screen,
-	// and come back later when the window is not minimized anymore.
-	if (is_minimized)
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
 	{
-		prepared = false;
-		return;
+		MemoryHeapStats stats = allocator->GetHeapStats(i);
+		usage += stats.usage;
+		budget += stats.budget;
 	}
 
-	// we need to create a commmand pool
-	// This command pool will hold all of our commands
-	// on the CPU, prior to sending them to the GPU
+	metrics_exporter->SetMemory(usage, budget);
+	metrics_exporter->EndInterval();
+}
 
-	// This command pool will be used for all commands
-	// in the entire program. At first, commands in this pool
-	// will be part of the init-command-buffer, which allows
-	// us to send initial buffers (textures and such) from CPU 
-	// to GPU
+void Demo::publish_telemetry()
+{
+	// the same numbers as export_metrics, but for
+	// every frame, the monitor does the statistics
+	CpuFrameSample cpuSample = cpu_profiler->GetSample(cpu_profiler->GetSampleCount() - 1);
 
-	// Later on, we will use this cmd_pool to handle draw commands,
-	// after the inital loading is done
+	TelemetrySample sample = {};
+	sample.frame = frame_count;
+	sample.cpuMs = (float)cpuSample.ms[CPU_MARKER_FRAME];
+	sample.gpuMs = (float)gpu_timer->GetLastFrameMs();
+	sample.draws = (uint32_t)draw_state_stats.draws;
 
-	// create the pool, based on the info provided
-	if (firstInit)
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
 	{
-		// Get Memory Properteis from our GPU
-		// This will tell us how much memory the GPU has,
-		// and also tell us information about the memory.
-		// Having these properties will enable us to 
-		// create and store data in a way that is compatible
-		// with the GPU that is currently being used
-		vkGetPhysicalDeviceMemoryProperties(gpu, &memory_properties);
+		MemoryHeapStats stats = allocator->GetHeapStats(i);
+		sample.memoryUsage += stats.usage;
+		sample.memoryBudget += stats.budget;
+	}
 
-		// A command pool is needed to create command buffers,
-		// command buffers will handle every command that we want
-		// to give to the GPU. Thankfully, creating an empty pool
-		// of command buffers only takes 4 lines of code.
-		// Later on, we will put command buffers in the command pool
-
-		// VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
-		// allows us to reset command pools, without needing to destroy and reallocate them
-		// sType will always be VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO for cmd pools
-
-		// create a structure that holds the information
-		// give it the sType, and give it the flag
-		VkCommandPoolCreateInfo cmd_pool_info = {};
-		cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-
-		// create the command pool, based on the information
-		vkCreateCommandPool(device, &cmd_pool_info, NULL, &cmd_pool);
-
-		// create a fence, we don't need to give any 
-		// special configuration to this fence, so we
-		// just give it the sType
-		VkFenceCreateInfo fenceInfo = {};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-
-		// we create a fence
-		// a fence will allow us to control the 
-		// flow of the program. The fence will tell
-		// us when the GPU is finished executing a job
-		vkCreateFence(device, &fenceInfo, NULL, &initFence);
-	
-		// build the initialization command buffer,
-		// which will allow us to send buffers from CPU to GPU,
-		// like vertex buffers, index buffers, textures, etc.
-		prepare_init_cmd();
-
-		// begin the command buffer,
-		// this allows all future commands to be
-		// recorded into this buffer. It will be 
-		// executed when we are done giving it all the 
-		// commands we want (for all buffers, and such).
-		begin_init_cmd();
+	telemetry_channel->Publish(sample);
+}
 
-		// prepare the vertex buffer and
-		// the index buffer that the cube
-		// will use to draw
-		prepare_vb_ib();
+void Demo::check_spike()
+{
+	SpikeSwapchainState state;
+	state.presentMode = present_mode_name(currentPresentMode);
+	state.imageCount = swapchainImageCount;
+	state.width = width;
+	state.height = height;
+	state.renderWidth = render_width;
+	state.renderHeight = render_height;
+	state.frameLag = frame_lag;
+	state.recreations = swapchain_count > 0 ? swapchain_count - 1 : 0;
+
+	spike_detector->Check(frame_count, cpu_profiler, allocator, state);
+}
 
-		// Before continuing, please look at
-		// the shader files.
-		
-		// Inside cube.vert you will see the 
-		// uniform buffer that we are trying
-		// to prepare, which has one 4x4 matrix
-		// inside of it
+void Demo::finish_benchmark()
+{
+	// wait for the last frames to finish on the GPU,
+	// so that the time includes all of their work
+	if (use_timeline_semaphores)
+		wait_for_frames(frame_count);
+	else
+		DeviceTable::WaitForFences(device, frame_lag, drawFences.data(), VK_TRUE, UINT64_MAX);
+
+	double seconds = std::chrono::duration<double>(CpuClock::now() - benchmark_start).count();
+
+	// The CPU time is the time that draw() spends working, it does
+	// not include waiting for the fences, which is waiting for the GPU
+	double cpuMs =
+		cpu_profiler->GetAverage(CPU_MARKER_UPDATE_UNIFORMS) +
+		cpu_profiler->GetAverage(CPU_MARKER_ACQUIRE) +
+		cpu_profiler->GetAverage(CPU_MARKER_RECORD) +
+		cpu_profiler->GetAverage(CPU_MARKER_SUBMIT) +
+		cpu_profiler->GetAverage(CPU_MARKER_PRESENT);
+
+	printf("Benchmark: %u frames in %.3f s, %.1f frames/s, GPU %.3f ms, CPU %.3f ms\n",
+		benchmark_frames,
+		seconds,
+		benchmark_frames / seconds,
+		gpu_timer->GetAverageFrameMs(),
+		cpuMs);
+
+	// how many barriers the last frame needed, and in how many calls
+	printf("Frame graph: %u barriers in %u vkCmdPipelineBarrier calls\n",
+		frame_graph->barrierCount, frame_graph->batchCount);
+
+	// and how many binds the draws of the last frame needed
+	printf("Draw state: %u binds recorded, %u redundant binds skipped\n",
+		(uint32_t)draw_state_stats.recorded, (uint32_t)draw_state_stats.elided);
+
+	if (use_render_queue)
+		printf("Render queue: %u packets, %u of %u radix sort steps needed\n",
+			render_queue->GetCount(), render_queue->sortedDigits, RENDER_QUEUE_DIGITS);
+
+	if (use_meshlets)
+		printf("Meshlets: %u of %u culled in the last frame, in %u draws\n",
+			meshlets_culled, meshlets_tested, (uint32_t)meshlet_draws.size());
+
+	// The frame times of the benchmark, from the ring of the CPU
+	// profiler. A stall in a few frames is lost in the average, but
+	// it moves the 99th percentile. The ring keeps the last
+	// CPU_PROFILER_HISTORY frames, which is all of a short benchmark
+	uint32_t sampleCount = std::min(cpu_profiler->GetSampleCount(), benchmark_frames);
+	uint32_t firstSample = cpu_profiler->GetSampleCount() - sampleCount;
+
+	std::vector<double> frameTimes(sampleCount);
+	for (uint32_t i = 0; i < sampleCount; i++)
+		frameTimes[i] = cpu_profiler->GetSample(firstSample + i).ms[CPU_MARKER_FRAME];
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	double p50Ms = sorted_percentile(frameTimes, 50);
+	double p95Ms = sorted_percentile(frameTimes, 95);
+	double p99Ms = sorted_percentile(frameTimes, 99);
+	double startupMs = startup_timeline.GetTotalMs();
+	double peakMemoryMB = benchmark_peak_memory / (1024.0 * 1024.0);
+
+	printf("Frame time: p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, startup %.1f ms, peak memory %.1f MB\n",
+		p50Ms, p95Ms, p99Ms, startupMs, peakMemoryMB);
+
+	print_memory_report();
+
+	// The results, for scripts to read, with the GPU and the
+	// driver, because results of different ones are not the same
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(gpu, &properties);
+
+	double frameMs = seconds * 1000.0 / benchmark_frames;
+	double gpuMs = gpu_timer->GetAverageFrameMs();
+
+	char json[1024];
+	int length = snprintf(json, sizeof(json),
+		"{\n"
+		"\t\"device\": \"%s\",\n"
+		"\t\"driver\": %u,\n"
+		"\t\"frames\": %u,\n"
+		"\t\"seconds\": %.4f,\n"
+		"\t\"frameMs\": %.4f,\n"
+		"\t\"gpuMs\": %.4f,\n"
+		"\t\"cpuMs\": %.4f,\n"
+		"\t\"frameP50Ms\": %.4f,\n"
+		"\t\"frameP95Ms\": %.4f,\n"
+		"\t\"frameP99Ms\": %.4f,\n"
+		"\t\"startupMs\": %.4f,\n"
+		"\t\"peakMemoryMB\": %.4f\n"
+		"}\n",
+		properties.deviceName,
+		properties.driverVersion,
+		benchmark_frames,
+		seconds,
+		frameMs,
+		gpuMs,
+		cpuMs,
+		p50Ms,
+		p95Ms,
+		p99Ms,
+		startupMs,
+		peakMemoryMB);
+
+	if (!Helper::WriteFile(BENCHMARK_FILE, json, (size_t)length))
+		printf("Could not write %s\n", BENCHMARK_FILE);
+
+	// Each result is compared on its own. The GPU time does not change
+	// when only the CPU got slower, and the other way around, so
+	// this says which side of the program has the regression
+	char* baseline = nullptr;
+	int baselineSize = 0;
+	Helper::ReadFile(BENCHMARK_BASELINE_FILE, &baseline, &baselineSize);
+
+	if (baseline != nullptr)
+	{
+		// the times of another GPU say nothing about this change
+		char device[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE + 16];
+		snprintf(device, sizeof(device), "\"device\": \"%s\"", properties.deviceName);
 
-		// Insdie cube.frag, you will see the
-		// texture: uniform sampler2D samplerColor;
+		if (strstr(baseline, device) == nullptr)
+		{
+			printf("The baseline was measured on another GPU, it is not compared\n");
+			free(baseline);
+			baseline = nullptr;
+		}
+	}
 
-		// The uniform buffer has a binding of 0
-		// the texture has a binding of 1
-		// Keep this in mind while moving through
-		// the next few functions
+	if (baseline != nullptr)
+	{
+		BenchmarkResult results[] =
+		{
+			{ "frameMs", "ms", frameMs, BENCHMARK_TOLERANCE },
+			{ "gpuMs", "ms", gpuMs, BENCHMARK_TOLERANCE },
+			{ "cpuMs", "ms", cpuMs, BENCHMARK_TOLERANCE },
+			{ "frameP50Ms", "ms", p50Ms, BENCHMARK_PERCENTILE_TOLERANCE },
+			{ "frameP95Ms", "ms", p95Ms, BENCHMARK_PERCENTILE_TOLERANCE },
+			{ "frameP99Ms", "ms", p99Ms, BENCHMARK_PERCENTILE_TOLERANCE },
+			{ "startupMs", "ms", startupMs, BENCHMARK_STARTUP_TOLERANCE },
+			{ "peakMemoryMB", "MB", peakMemoryMB, BENCHMARK_MEMORY_TOLERANCE }
+		};
+
+		for (uint32_t i = 0; i < sizeof(results) / sizeof(results[0]); i++)
+		{
+			// a baseline from before a result was added does not have it
+			double before = 0.0;
+			if (!read_json_number(baseline, results[i].key, &before) || before <= 0.0)
+				continue;
 
-		// prepare the uniform buffer with the 
-		// MVP matrix that gets sent to the shader
-		prepare_uniform_buffer();
+			double change = (results[i].value - before) * 100.0 / before;
+			bool regressed = change > results[i].tolerance;
 
-		// A sampler is used by the graphics card to 
-		// get each pixel from the texture, depending
-		// on what UV coordinates we are looking for.
-		prepare_sampler();
+			printf("Baseline %s: %.3f %s, now %.3f %s (%+.1f%%)%s\n",
+				results[i].key, before, results[i].unit, results[i].value, results[i].unit,
+				change, regressed ? ", REGRESSION" : "");
 
-		// load the RIT texture that gets sent to 
-		// the shader, you can load any PNG texture
-		prepare_textures();
+			if (regressed)
+				benchmark_regressed = true;
+		}
 
-		// This is the layout, which will be given to 
-		// the pipeline, and it will tell the pipeline to 
-		// expect one uniform buffer and one texture
-		// for each draw call. If you have 100 different models,
-		// if each one uses one uniform buffer and one texture,
-		// then there should only be two descriptors here
-		prepare_descriptor_layout();
+		free(baseline);
+	}
 
-		// this is the descriptor pool, which will tell 
-		// the GPU how many different descriptors there will 
-		// be throughout the duration of the entire program.
-	
-		// If you have 100 different models, in the scene
-		// if each one uses one uniform buffer and one texture,
-		// then there should be 200 descriptors in the pool
-		prepare_descriptor_pool();
+	benchmark_done = true;
+}
 
-		// this creates the descriptor set. Right now there
-		// is only one descriptor set. A descriptor set is 
-		// a combination of descriptors (uniform buffers and textures)
-		// that fit the description of the descriptor_layout.
-		
-		// If you have 100 models in the scene that each 
-		// have one uniform buffer and one texture, you have
-		// a choice to make.
-		
-		// You can have 100 descriptor sets, each with one 
-		// uniform buffer and one texture (per model).
+// "-microbench" runs this instead of drawing, see MicroBenchmark.h.
+// It only needs the device, the queue, and the allocator that
+// prepare() made, the window is never drawn to
+void Demo::run_microbenchmarks()
+{
+	{
+		QueueLock queueLock;
+		vkDeviceWaitIdle(device);
+	}
 
-		// You can have one descriptor set, and then
-		// erase the contents of the set and rewrite
-		// the contents between each draw call.
+	MicroBenchmark bench(device, gpu, allocator, queue, graphics_queue_family_index, sampler_cache);
+	bench.Run(MICROBENCH_FILE);
 
-		// Personally I think performance is the same,
-		// one option uses more memory and the other 
-		// option uses more processing, pick your poison.
-		// personally I have one descriptor set, which
-		// gets wiped and refilled between draw calls.
-		prepare_descriptor_set();
-	}
+	print_memory_report();
+}
 
-	// if this is not the first initialization
-	// then do not recreate things that we already have,
-	// just begin the command buffer again (which we reset
-	// the last time we executed it), so now it is empty,
-	// and we can use it again. We can use it to build the 
-	// depth buffer, which depends on swapchain resolution
-	else
+void Demo::tune_settings(VkPhysicalDeviceProperties properties)
+{
+	AutoTuner tuner(properties, BENCHMARK_FILE);
+	tuner.targetMs = auto_tune_target_ms;
+
+	// what the demo would use without the tuner
+	TunedSettings settings;
+	settings.msaaSamples = msaa_samples;
+	settings.renderScale = use_temporal_upscale ? temporal_render_scale : 1.0f;
+	settings.frameLag = frame_lag;
+	settings.presentMode = present_mode;
+	settings.culling = use_gpu_culling ? TUNE_CULLING_GPU : (use_cpu_culling ? TUNE_CULLING_CPU : TUNE_CULLING_NONE);
+
+	if (auto_tune_retune || !tuner.Load(&settings))
 	{
-		// begin the command buffer,
-		// this allows all future commands to be
-		// recorded into this buffer. It will be 
-		// executed when we are done giving it all the 
-		// commands we want (for all buffers, and such).
-		begin_init_cmd();
+		// Only the culling paths that this scene can use. CPU culling
+		// needs dynamic instances, and GPU culling needs instancing
+		tuner.cullingPaths.push_back(TUNE_CULLING_NONE);
+		if (use_dynamic_instances)
+			tuner.cullingPaths.push_back(TUNE_CULLING_CPU);
+		if (use_instancing)
+			tuner.cullingPaths.push_back(TUNE_CULLING_GPU);
+
+		for (uint32_t lag = 1; lag <= MAX_FRAME_LAG && lag <= 3; lag++)
+			tuner.frameLags.push_back(lag);
+
+		// the modes that never tear, IMMEDIATE is
+		// always the fastest, but it is not what we want
+		tuner.presentModes.push_back(VK_PRESENT_MODE_FIFO_KHR);
+		tuner.presentModes.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+
+		// only the sample counts that the color and the depth both have
+		VkSampleCountFlags counts =
+			properties.limits.framebufferColorSampleCounts &
+			properties.limits.framebufferDepthSampleCounts;
+
+		for (uint32_t samples = 8; samples >= 1; samples /= 2)
+			if (counts & samples)
+				tuner.msaaLevels.push_back(samples);
+
+		// the render scale is only for temporal upscaling
+		if (use_temporal_upscale)
+		{
+			tuner.renderScales.push_back(1.0f);
+			tuner.renderScales.push_back(0.85f);
+			tuner.renderScales.push_back(0.67f);
+			tuner.renderScales.push_back(0.5f);
+		}
+		else
+			tuner.renderScales.push_back(settings.renderScale);
+
+		tuner.Tune(&settings);
+		tuner.Save(settings);
 	}
 
-	// This creates the depth buffer.
-	// unlike other buffrs that are generated on the CPU
-	// and then (sometimes) copied to the GPU, this depth
-	// buffer is generated on GPU space, and left alone. 
-	// The GPU reads the buffer, the GPU writes to the buffer,
-	// so it gets created in GPU memory, then CPU
-	// leaves it alone
-	prepare_depth_buffer();
+	printf("Tuned settings: MSAA %u, render scale %.2f, %u frames in flight, %s, culling %u\n",
+		settings.msaaSamples, settings.renderScale, settings.frameLag,
+		present_mode_name(settings.presentMode), settings.culling);
 
-	// This end the initialization command buffer,
-	// and submit all of the commands that we have
-	// been giving to the init_cmd command buffer
-	// throughout the prepre() function, including
-	// building buffers on the GPU
-	execute_init_cmd();
+	apply_tuned_settings(settings);
+}
 
-	if (firstInit)
-	{
-		// if this is our first time loading,
-		// we cand delete the CPU buffers that
-		// we built. Now that they are copied to
-		// the GPU, we don't need them on the CPU
-		// anymore
+void Demo::apply_tuned_settings(const TunedSettings& settings)
+{
+	msaa_samples = settings.msaaSamples;
 
-		delete vertexDataCPU;
-		delete indexDataCPU;
-		delete textureCPU;
+	if (use_temporal_upscale)
+		temporal_render_scale = settings.renderScale;
 
-		// The renderpass describes what type of
-		// data will be outputted by the GPU when
-		// it is done rendering a scene. In this example,
-		// it will create a color image (which is written
-		// to the swapchain), and a depth image, which
-		// is written to the depth buffer. We do not provide
-		// any buffers for the GPU to write to, we just say
-		// what type of data we want to be written
-		prepare_render_pass();
-	}
+	frame_lag = std::max(1u, std::min(settings.frameLag, (uint32_t)MAX_FRAME_LAG));
+	present_mode = settings.presentMode;
 
-	// we prepare the framebuffes, which say 
-	// specifically what buffers should be written
-	// to by the GPU. This is where we specifically
-	// say to write to the depth buffer and
-	// swapchain images, by giving the VkImageViews
-	// of those images.
-	prepare_framebuffers();
+	// The same rules as in prepare(), a path that this scene can
+	// not use is left off, and what needs GPU culling goes with it
+	use_gpu_culling = (settings.culling == TUNE_CULLING_GPU) && use_instancing;
+	use_cpu_culling = (settings.culling == TUNE_CULLING_CPU) && use_dynamic_instances;
 
-	// We only prepare the pipeline once
-	// This includes loading shaders
-	if (firstInit)
-	{
-		// We prepare the graphics pipeline, which 
-		// describes every stage that the GPU will go
-		// through while the scene is being rendered:
-		// InputState, Vertex Shader, Fragment Shader,
-		// Blending, etc.
-		prepare_pipeline();
+	// the CPU writes the visible instances, there are no deltas
+	if (use_cpu_culling)
+		use_instance_deltas = false;
+
+	if (!use_gpu_culling)
+	{
+		use_occlusion_culling = false;
+		use_async_compute = false;
 	}
+}
+
+void Demo::reload_shaders()
+{
+	// This runs between frames, on the render thread, so nothing is being
+	// recorded right now. Checking the files every frame would be a waste,
+	// a person can not save a file 60 times per second. With render on
+	// demand, when nothing is drawn, the frame count does not move, but
+	// then this only runs every RENDER_ON_DEMAND_POLL_MS anyway
+	if (needs_redraw() && frame_count % SHADER_RELOAD_INTERVAL != 0)
+		return;
 
-	// We bulid three command buffers, one for each swapchain image.
-	// When we build the command buffer, we give it a framebuffer,
-	// which has all the image buffers that the GPU will draw to,
-	// but after we create a command buffer, we cannot change the framebuffer.
-	// So we build one command buffer per swapchain image, then when it
-	// is time to execute the command buffers, we swap command buffers,
-	// to swap between swapchain images that we are drawing to
-	build_swapchain_cmds();
+	uint64_t vsTime = shader_compiler->GetWriteTime(vs_source_name);
+	uint64_t fsTime = shader_compiler->GetWriteTime(fs_source_name);
 
-	// We only need to do this the first time
-	// the program loads, after that, we can 
-	// reset and reuse this again and again
-	if (firstInit)
-	{
-		// This function handles the synchronization of the
-		// CPU and GPU, to make sure that one does not get
-		// too far ahead of the other.
+	if (vsTime == vs_write_time && fsTime == fs_write_time)
+		return;
 
-		// In this function, we create more fences, and 
-		// something called "semaphores" to control the flow
-		// of the program. To assure the command buffers
-		// only draw when they are ready to be drawn,
-		// and also let us know when each command buffer 
-		// is finished drawing
-		prepare_synchronization();
+	vs_write_time = vsTime;
+	fs_write_time = fsTime;
+
+	// Compile both shaders first. If one of them has an error, the error
+	// is printed, and we keep the pipeline that we have, so a typo never
+	// closes the program. The results go into the shader cache, so
+	// prepare_pipeline reads them from there, instead of compiling again
+	std::vector<uint32_t> spirv;
+
+	if (!shader_compiler->Compile(vs_source_name, VK_SHADER_STAGE_VERTEX_BIT, &spirv) ||
+		!shader_compiler->Compile(fs_source_name, VK_SHADER_STAGE_FRAGMENT_BIT, &spirv))
+	{
+		printf("Keeping the old shaders\n");
+		return;
 	}
 
-	// Our "repare" functions above may generate pipeline commands
-	// that need to be executed before beginning the render loop.
-	// Such as copying buffers from CPU to GPU, these commands
-	// have been added to the command buffer, and now we execute the buffer
+	// The frames that are still on the GPU use the old pipeline, so
+	// it is retired below, instead of waiting for them. Buffers, textures,
+	// descriptors, the swapchain, and the device all stay the way they are
+	// if the optimized pipeline of the old shaders
+	// is still being made, it is not needed anymore
+	discard_pending_pipeline();
+
+	// The old pipeline stays alive until the new one is made,
+	// so the new one can be a derivative of it. Only the shaders
+	// change, everything else in the pipeline is the same
+	VkPipeline oldPipeline = pipeline;
+	VkPipelineLayout oldLayout = pipeline_layout;
+	VkDescriptorUpdateTemplateKHR oldTemplate = descriptor_template;
+
+	// every command buffer is recorded again in the next
+	// draw, so they all pick up the new pipeline by themselves
+	prepare_pipeline(use_pipeline_derivatives ? oldPipeline : VK_NULL_HANDLE);
+
+	// the pipeline is destroyed before its layout
+	deletion_queue->Retire(VK_OBJECT_TYPE_PIPELINE, (uint64_t)oldPipeline, frame_count);
+	deletion_queue->Retire(VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)oldLayout, frame_count);
+
+	// the linked pipelines do not need their parts, only the new
+	// layout will make pipelines, so the parts of the old one can go
+	forget_pipeline_parts((uint64_t)oldLayout);
+
+	// the push descriptor template belongs to the
+	// pipeline layout, so prepare_pipeline made a new one
+	if (use_push_descriptors)
+	{
+		PFN_vkDestroyDescriptorUpdateTemplateKHR destroyTemplate = fpDestroyDescriptorUpdateTemplateKHR;
+		VkDevice d = device;
 
-	// set the current buffer (from zero to the number of swapchain images)
-	// to zero by default, because that's a good place to start
-	current_buffer = 0;
+		deletion_queue->Retire([destroyTemplate, d, oldTemplate]()
+			{
+				destroyTemplate(d, oldTemplate, HostAllocator::callbacks);
+			},
+			frame_count);
+	}
 
-	// our demo is prepared, and ready to start rendering
-	prepared = true;
+	printf("Reloaded %s and %s\n", vs_source_name, fs_source_name);
 
-	// Our first initialization is done, so we set this to false.
-	// We will call prepare() many times, so we don't want to redo
-	// the things that we only need to initailize once. After the
-	// first initialization, we only want to redo things that depend
-	// on window size (which will be changing):
-	// depth buffer, swapchain images, renderpass (which has window dimensions),
-	// primary command buffers (which need the new swapchain images), etc.
-	firstInit = false;
+	// the new shaders might draw something else
+	request_redraw();
 }
 
-void Demo::delete_resolution_dependencies()
+void Demo::update_pipeline()
 {
-	// depth buffer on the GPU
-	delete depthBufferGPU;
-
-	// Loop through each swapchain image
-	for (uint32_t i = 0; i < swapchainImageCount; i++)
-	{
-		// delete the "image" of this swapchain image
-		vkDestroyImageView(device, swapchain_image_resources[i].view, NULL);
+	// This runs between frames, so no thread is recording
+	// with the pipeline right now. A future that is not ready yet
+	// returns right away, we never wait for the pipeline compiler
+	if (!pipeline_pending)
+		return;
 
-		// delete the framebuffer that is associated with this swapchain image
-		vkDestroyFramebuffer(device, swapchain_image_resources[i].framebuffer, NULL);
+	if (pipeline_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
 
-		// delee the primary command buffer that is associated with this framebuffer
-		vkFreeCommandBuffers(device, cmd_pool, 1, &swapchain_image_resources[i].cmd);
-	}
+	// The frames in flight are still drawing with the unoptimized
+	// pipeline, so it is retired, and destroyed when they are done,
+	// just like an old swapchain
+	deletion_queue->Retire(VK_OBJECT_TYPE_PIPELINE, (uint64_t)pipeline, frame_count);
+
+	// every command buffer is recorded again in the
+	// next draw, so they all use the new pipeline
+	pipeline = pipeline_future.get();
+	pipeline_pending = false;
+
+	// nothing else will be made from the shader modules
+	forget_pipeline_parts((uint64_t)frag_shader_module);
+	forget_pipeline_parts((uint64_t)vert_shader_module);
+	vkDestroyShaderModule(device, frag_shader_module, HostAllocator::callbacks);
+	vkDestroyShaderModule(device, vert_shader_module, HostAllocator::callbacks);
+}
 
-	// delete the array of swapchain_image_resources,
-	// which holds all the data that we deleted above ^^
-	// so that we can reallocate new images later
-	free(swapchain_image_resources);
+void Demo::forget_pipeline_parts(uint64_t handle)
+{
+	// Every shader module and layout that pipelines were made with
+	// comes here before it is destroyed, so the pipeline library
+	// destroys the parts that were made with it, see PipelineLibrary::Forget
+	if (pipeline_library != nullptr)
+		pipeline_library->Forget(handle);
 }
 
-void Demo::resize()
+void Demo::discard_pending_pipeline()
 {
-	// Do not try to resize the window
-	// if we haven't initialized the program yet,
-	// that would just be a waste
+	// Waits for the pipeline compiler to finish the optimized
+	// pipeline, and destroys it, because we do not want it anymore
+	if (!pipeline_pending)
+		return;
 
-	// Because WndProc can call resize()
-	// prior to initialization (which is rare),
-	// we need to check to see if we've already
-	// initialized
-	if (firstInit == false)
-	{
-		// If the window is currently minimized, then the 
-		// width and height are zero, which means that the
-		// resolution-dependent assets were never built,
-		// so there would be nothing to delete
+	vkDestroyPipeline(device, pipeline_future.get(), HostAllocator::callbacks);
+	pipeline_pending = false;
 
-		// only delete the resolution-dependent assets
-		// if the demo is not currently minimized	
+	forget_pipeline_parts((uint64_t)frag_shader_module);
+	forget_pipeline_parts((uint64_t)vert_shader_module);
+	vkDestroyShaderModule(device, frag_shader_module, HostAllocator::callbacks);
+	vkDestroyShaderModule(device, vert_shader_module, HostAllocator::callbacks);
+}
 
-		// Keep in mind, if we are trying to resize the window WHILE is_minimized is false,
-		// that means that the program was already minimized, and resize() was called after 
-		// trying to un-minimize the window
-		if (!is_minimized)
+// One piece of the CPU work of the frame, that can run before or after
+// the swapchain image is acquired, because it does not use the image
+void Demo::run_frame_work(uint32_t work)
+{
+	switch (work)
+	{
+	// the frame that last used this frame_index is done,
+	// so if it copied its image, that copy is done too
+	case FRAME_WORK_CAPTURE:
+		if (use_frame_capture)
+			save_capture(frame_index);
+
+		// and the same for the pick of that frame
+		if (object_picker != nullptr)
+			read_pick(frame_index);
+		break;
+
+	// check if any uploads are finished, so that
+	// the uploader can delete their CPU buffers,
+	// and the upload budget starts over
+	case FRAME_WORK_UPLOADS:
+		uploader->Poll();
+		uploader->BeginFrame();
+		break;
+
+	// the budget changes when other programs use the GPU, so
+	// the allocator asks for it again every few frames
+	case FRAME_WORK_BUDGET:
+		if (frame_count % MEMORY_BUDGET_UPDATE_FRAMES == 0)
+			allocator->UpdateBudget();
+		break;
+
+	// ask for the texture levels that the last frame needed, and
+	// load them, then this frame_index gets the newest texture
+	case FRAME_WORK_STREAMING:
+		if (use_texture_streaming)
 		{
-			// we are no longer prepared to render
-			prepared = false;
+			request_texture_levels();
+			texture_streamer->Update(frame_count, get_completed_frames());
+			update_streamed_descriptors(frame_index);
+		}
+		else if (use_placeholder_texture)
+			update_placeholder_texture(frame_index);
+		else if (use_video_texture)
+			update_video_texture(frame_index);
+		break;
 
-			// vkDeviceWaitIdle actually does not wait until the device is idle, which is stupid.
-			// What vkDeviceWaitIdle does, is wait until every queue on the device is idle. The 
-			// queue sends command buffers to the GPU with VkSubmitInfo. There is one problem though,
-			// the queue can be empty, after the last command buffer is given to the GPU, and then
-			// a command buffer will still be in the middle of executing on the GPU while vkDeviceWaitIdle
-			// stops waiting (when the queues are empty). 
-			vkDeviceWaitIdle(device);
-
-			// To absolutely confirm that all of the GPU's tasks are finished, we need to wait for 
-			// the fences to be completed too. 
-			
-			// However, because the window was minimized (and now it is running this function
-			// while we are trying to unminimize the window), we know nothing was being drawn 
-			// to the screen while the window was minimized, so we don't need to check the
-			// fences to see if a draw is complete, if we know that a draw wasn't started
-
-			// delete only the things that depend on the size
-			// of the screen, like depth buffer and swapchain
-			delete_resolution_dependencies();
+	// update the data in the uniform buffer
+	// this recalculates the model matrix (for rotation)
+	// and the projection matrix (for the window dimensions),
+	// it does not recalculate the view matrix, becasue we are
+	// not moving the camera. This happens after the fence,
+	// because then we know the GPU is done with this slice.
+	// In low latency mode, this happens after the image is acquired
+	case FRAME_WORK_UNIFORMS:
+		if (!low_latency)
+		{
+			CpuScope scope(cpu_profiler, CPU_MARKER_UPDATE_UNIFORMS);
+			update_uniform_buffer();
 		}
-	
-		// run the prepare function.
-		// firstInit is false, so it will only
-		// rebuild things that depend on image size,
-		// like depth buffer and swapchain, etc.
-		prepare();
+		break;
 	}
 }
 
-void Demo::update_uniform_buffer()
+// Asks for the next swapchain image, and waits at most timeout
+// nanoseconds for it. VK_NOT_READY or VK_TIMEOUT means that there
+// was no image yet, then the semaphore is not signaled either
+VkResult Demo::acquire_next_image(uint64_t timeout)
 {
-	// create projection matrix
-	// If this looks confusing, go back to
-	// prepare_uniform_buffers and read those comments
-	projection_matrix = glm::perspective(45.0f * 3.14159f / 180.0f, (float)width / (float)height, 0.1f, 100.0f);
+	// the headless images take turns, see prepare_headless_images
+	if (window_mode == WINDOW_MODE_HEADLESS)
+	{
+		current_buffer = (uint32_t)(frame_count % swapchainImageCount);
+		return VK_SUCCESS;
+	}
 
-	// flip the Y axis, just like before in prepare_uniform_buffers
-	projection_matrix[1][1] *= -1;
+	// Only one thread may use the swapchain at a time. While the present
+	// thread still has a present, the image that it frees is not ready
+	// anyway, so without a timeout we say so, instead of waiting for it
+	if (use_present_thread)
+	{
+		if (timeout == 0 && present_thread->GetPending() > 0)
+			return VK_NOT_READY;
 
-	// This is our model matrix
-	// Just like OpenGL, it handles the position, rotation, and scale of our 
-	// object, which is the cube in this case. We make our model matrix equal 
-	// to model matrix of the previous frame, with an addition of a "spin_angle" 
-	// rotation on the Y axis. This makes the cube rotate 0.025 radians each 
-	// frame, which is about 1.5 degrees per frame
-	model_matrix = glm::rotate(model_matrix, (float)0.025f, glm::vec3(0.0f, 1.0f, 0.0f));
+		present_thread->Wait(0);
+	}
 
-	// make temporary data where
-	// we can store data that will be
-	// in our buffer
-	uniform_struct temporaryData;
+	// With a device group, the GPUs take turns, each frame_index
+	// is always drawn by the same one (see prepare_physical_device),
+	// and the image has to be ready for the GPU that draws this frame
+	if (use_device_group)
+	{
+		VkAcquireNextImageInfoKHR acquireInfo = {};
+		acquireInfo.sType = VK_STRUCTURE_TYPE_ACQUIRE_NEXT_IMAGE_INFO_KHR;
+		acquireInfo.swapchain = swapchain;
+		acquireInfo.timeout = timeout;
+		acquireInfo.semaphore = image_acquired_semaphores[frame_index];
+		acquireInfo.deviceMask = 1u << (frame_index % device_group_count);
+		return fpAcquireNextImage2KHR(device, &acquireInfo, &current_buffer);
+	}
 
-	// create the MVP from the three matrices,
-	// just like we did when we first made the buffer
-	glm::mat4x4	MVP = projection_matrix * view_matrix * model_matrix;
+	return fpAcquireNextImageKHR(device, swapchain, timeout,
+		image_acquired_semaphores[frame_index], VK_NULL_HANDLE, &current_buffer);
+}
 
-	// put our MVP into the temporary data buffer
-	temporaryData.mvp = MVP;
+void Demo::acquire_full_screen_exclusive()
+{
+	// Only the window in front can own the monitor, otherwise
+	// we would take the monitor from the window that is in front
+	if (!full_screen_exclusive_enabled || full_screen_exclusive_acquired)
+		return;
 
-	// We store data into the buffer, just like
-	// we did when we first made the buffer. We
-	// do not need to destroy and rebuild the buffer,
-	// we can reuse it
-	matrixBufferCPU->Store(&MVP[0][0], sizeof(MVP));
+	if (GetForegroundWindow() != window)
+		return;
+
+	// the present thread must be done with the swapchain
+	if (use_present_thread)
+		present_thread->Wait(0);
+
+	VkResult result = fpAcquireFullScreenExclusiveModeEXT(device, swapchain);
+	full_screen_exclusive_acquired = (result == VK_SUCCESS);
+
+	// Failing is not an error, presents still work, they are just
+	// composed by the desktop, like a borderless window. We try
+	// again in the next frame, and only say it once
+	if (result == VK_SUCCESS)
+		printf("The swapchain owns the monitor\n");
 }
 
-void Demo::draw()
+void Demo::start_trace()
 {
-	// update the data in the uniform buffer
-	// this recalculates the model matrix (for rotation)
-	// and the projection matrix (for the window dimensions),
-	// it does not recalculate the view matrix, becasue we are
-	// not moving the camera
-	update_uniform_buffer();
+	if (use_trace_capture)
+		trace_capture->Start(frame_count, trace_frames, TRACE_FILE);
+}
 
-	// When the program is first initialized, we should have an open fence.
-	// Aside from that, the fence will only be open if the queue is available.
-	// We wait until this fence is open. If it is already open by the time the C++
-	// code gets here, then it continues as normal is if the line weren't here.
-	// If it is closed, then it means that the Queue is still working on another frame.
-	// That means, our C++ code will pause here, and it will not move to the next line,
-	// until this fence is open (which will be when the queue is done).
+void Demo::toggle_animation()
+{
+	animation_paused = !animation_paused;
+
+	// The GPU animation time is the time since animation_start,
+	// so when it starts again, animation_start moves forward by
+	// the time that it was paused, and the cubes continue from
+	// where they stopped, instead of jumping
+	if (animation_paused)
+		pause_start = CpuClock::now();
+	else
+		animation_start += CpuClock::now() - pause_start;
 
-	// Waiting for this fence will confirm that we can draw a frame to this 
-	// to this frame index at this time (out of two possible slots).
-	vkWaitForFences(device, 1, &drawFences[frame_index], VK_TRUE, UINT64_MAX);
+	request_redraw();
+}
 
-	// If we got past the last line, it means that the fence is open,
-	// and we are ready to continue. Picture this in your mind, the 
-	// fence is open, so we walk through, and close the fence behind us
-	vkResetFences(device, 1, &drawFences[frame_index]);
+void Demo::pick_object(uint32_t x, uint32_t y)
+{
+	if (object_picker == nullptr || width == 0 || height == 0)
+		return;
 
-	// Get the index of the next available swapchain image.
-	// When the next image is available, it will trigger the
-	// image_aquired_semaphore as complete
-	fpAcquireNextImageKHR(device, swapchain, UINT64_MAX,
-		image_acquired_semaphores[frame_index], VK_NULL_HANDLE, &current_buffer);
+	// The scene is drawn at the render size, which is smaller than
+	// the window with dynamic resolution, and then scaled up to it
+	uint32_t renderX = (uint32_t)((uint64_t)x * render_width / width);
+	uint32_t renderY = (uint32_t)((uint64_t)y * render_height / height);
 
-	// Wait for the image acquired semaphore to be signaled to ensure
-	// that the image won't be rendered to until the presentation
-	// engine has fully released ownership to the application, and it is
-	// okay to render to the image.
-	VkPipelineStageFlags pipe_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	object_picker->Request(renderX, renderY);
+	request_redraw();
+}
 
-	// We are about to make a submission to the queue.
-	// Just like all queues, handles the first submission it gets,
-	// then the next, then the next, just like people standing in line at a store.
+void Demo::dig_voxel_world()
+{
+	if (voxel_world == nullptr)
+		return;
 
-	// This submission will execute one command buffer, which is 
-	// the command buffer that is attached to the swapchain image that we can draw with.
-	// This submission will stay in the queue, and wait to be executed, until the 
-	// "image_aquired" semaphore is completed by fpAcquireNextImageKHR, because we cannot
-	// render to an image until we have one that is available.
-	// After the submission is finished executing, it will trigger the draw_complete
-	// semaphore as finished
+	// A ball of air, at a random place on the top of the terrain.
+	// It is often on the side of a chunk, so more than one chunk
+	// is meshed again, and the faces between them have to match.
+	// While streaming, the place is in the ring around the camera
+	int radius = 6;
+	int sizeX = voxel_params.chunksX * VOXEL_CHUNK_SIZE;
+	int sizeY = voxel_params.chunksY * VOXEL_CHUNK_SIZE;
+	int sizeZ = voxel_params.chunksZ * VOXEL_CHUNK_SIZE;
+	int startX = 0;
+	int startZ = 0;
+
+	if (use_voxel_streaming)
+	{
+		sizeX = sizeZ = (voxel_params.streamRadius * 2 + 1) * VOXEL_CHUNK_SIZE;
+		startX = (int)voxel_center.x - sizeX / 2;
+		startZ = (int)voxel_center.z - sizeZ / 2;
+	}
 
-	// Here we cycle between the command buffers for each swapchain image
-	// We submit the command buffer that corresponds to the swapchain image
-	// that is ready to be drawn to, which we determine with fpAcquireNextImageKHR
+	int cx = startX + rand() % sizeX;
+	int cz = startZ + rand() % sizeZ;
+	int cy = sizeY - 1;
 
-	VkSubmitInfo submit_info = {};
-	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_info.pWaitDstStageMask = &pipe_stage_flags;
-	submit_info.waitSemaphoreCount = 1;
-	submit_info.pWaitSemaphores = &image_acquired_semaphores[frame_index];
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &swapchain_image_resources[current_buffer].cmd;
-	submit_info.signalSemaphoreCount = 1;
-	submit_info.pSignalSemaphores = &draw_complete_semaphores[frame_index];
+	while (cy > 0 && voxel_world->GetBlock(cx, cy, cz) == VOXEL_AIR)
+		cy--;
 
-	// Thish fence is currently closed, it will open when
-	// the queue's submission is complete
-	vkQueueSubmit(queue, 1, &submit_info, drawFences[frame_index]);
+	for (int y = cy - radius; y <= cy + radius; y++)
+	{
+		for (int z = cz - radius; z <= cz + radius; z++)
+		{
+			for (int x = cx - radius; x <= cx + radius; x++)
+			{
+				int dx = x - cx;
+				int dy = y - cy;
+				int dz = z - cz;
 
-	// We are now submitting the command buffer that will draw
-	// an image to the screen. Here is how it will work.
-	// The command buffer we are submitting will bind a pipeline,
-	// the pipeline has a fragment shader that will export color
-	// to a framebuffer that was binded to the pipline. This 
-	// framebuffer has a swapchain image inside of it, and the
-	// swapchain image is connected to the VkSurface, which
-	// is connected to our HWND Window, which is on the screen.
-	// This repeats every frame, for everything we want to draw
+				if (dx * dx + dy * dy + dz * dz <= radius * radius)
+					voxel_world->SetBlock(x, y, z, VOXEL_AIR);
+			}
+		}
+	}
 
-	// We wait for the draw_complete semaphore to finish, because we 
-	// shouldn't send an image to the screen if the image is not finished
-	// rendering
+	request_redraw();
+}
 
-	VkPresentInfoKHR present = {};
-	present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	present.waitSemaphoreCount = 1;
-	present.pWaitSemaphores = &draw_complete_semaphores[frame_index];
-	present.swapchainCount = 1;
-	present.pSwapchains = &swapchain;
-	present.pImageIndices = &current_buffer;
+void Demo::request_redraw()
+{
+	uint32_t frames = use_temporal_upscale ? TEMPORAL_REDRAW_FRAMES : REDRAW_FRAMES;
 
-	// submit the presentInfo to the queue.
-	// The queue will execute our request to present
-	// an image as soon as it is done rendering the
-	// image that we want rendered in the command buffer
-	fpQueuePresentKHR(queue, &present);
+	if (redraw_frames < frames)
+		redraw_frames = frames;
+}
 
-	// increment our frame counter
-	frame_index += 1;
-	frame_index %= FRAME_LAG;
+void Demo::sleep_for_latency()
+{
+	// The frame that is drawn next is frame_count + 1, which is
+	// also its present ID. If the window is minimized, there is
+	// no swapchain to sleep for
+	if (use_latency_markers && prepared)
+		latency_markers->Sleep(frame_count + 1);
+}
+
+void Demo::mark_latency(LatencyMarker marker)
+{
+	if (use_latency_markers)
+		latency_markers->Mark(frame_count + 1, marker);
+}
+
+bool Demo::needs_redraw()
+{
+	// without render on demand, and in the
+	// benchmark, every frame is drawn
+	if (!use_render_on_demand || benchmark_frames > 0)
+		return true;
+
+	// while the animation runs, the scene is
+	// different in every frame, so we draw all of them
+	return !animation_paused || redraw_frames > 0;
 }
 
 void Demo::run()
@@ -3659,12 +13737,83 @@ void Demo::run()
 	// program is prepared to draw
 
 	if (prepared)
+	{
+		// rebuild the pipeline if a shader file was saved
+		if (use_shader_hot_reload)
+			reload_shaders();
+
+		// switch to the optimized pipeline, if it is ready
+		update_pipeline();
+
+		// With render on demand, nothing is drawn if nothing
+		// changed, the last image that we presented stays up
+		if (!needs_redraw())
+			return;
+
 		draw();
+
+		if (redraw_frames > 0)
+			redraw_frames--;
+	}
 }
 
 
-Demo::Demo()
+Demo::Demo(uint32_t benchmarkFrames, VkPresentModeKHR presentMode, uint32_t frameLag, uint32_t layerFlags, uint32_t targetFps, uint32_t windowMode, const TunedSettings* candidate, bool retune, uint32_t stressObjects, DeviceContext* deviceContext)
 {
+	// The number of frames that can be in flight at the same time.
+	// One frame has the lowest latency, because the CPU waits for
+	// the GPU to finish each frame before it starts the next one.
+	// More frames keep the GPU busy, even if one frame takes longer
+	// on the CPU. Zero means the default, which is two
+	frame_lag = (frameLag == 0) ? DEFAULT_FRAME_LAG : frameLag;
+	frame_lag = (frame_lag > MAX_FRAME_LAG) ? MAX_FRAME_LAG : frame_lag;
+
+	// prepare() has not run yet for this demo
+	firstInit = true;
+
+	// without a context from outside, nothing is shared
+	owns_device_context = (deviceContext == nullptr);
+	device_context = owns_device_context ? new DeviceContext(new InstanceContext(), false) : deviceContext;
+
+	// If this is more than zero, we are in benchmark mode,
+	// which is set with "-benchmark N" on the command line
+	benchmark_frames = benchmarkFrames;
+	benchmark_done = false;
+	benchmark_regressed = false;
+	benchmark_peak_memory = 0;
+
+	// the scene generator is turned on in prepare(), with this many objects
+	stress_objects = stressObjects;
+
+	// MAX_ENUM means that prepare() picks the mode
+	present_mode = presentMode;
+
+	// a candidate of the tuner never tunes by itself
+	has_tune_candidate = (candidate != nullptr);
+	if (has_tune_candidate)
+		tune_candidate = *candidate;
+	auto_tune_retune = retune && !has_tune_candidate;
+
+	// the layers that prepare_instance looks for
+	layer_flags = layerFlags;
+
+	// prepare_window makes a popup window for the fullscreen modes
+	window_mode = windowMode;
+
+	// PRESENT_SRC_KHR is only for swapchain images, the headless
+	// images are left ready to be copied from (see prepare_headless_images)
+	present_layout = (window_mode == WINDOW_MODE_HEADLESS) ?
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	// the benchmark measures how fast we can go, so it has no limit
+	frame_limiter = new FrameLimiter();
+	frame_limiter->SetTargetFps(benchmark_frames > 0 ? 0 : targetFps);
+
+	present_latency_total = 0;
+	present_latency_count = 0;
+	memset(present_cpu_times, 0, sizeof(present_cpu_times));
+	memset(present_frame_ids, 0, sizeof(present_frame_ids));
+
 	// Welcome to the Demo constructor
 	// The Demo class will handle the majority
 	// of our code in this tutorial
@@ -3681,23 +13830,35 @@ Demo::Demo()
 
 Demo::~Demo()
 {
+	// the presents that are left go to the queue first,
+	// then nothing else uses the queue
+	delete present_thread;
+
 	// vkDeviceWaitIdle actually does not wait until the device is idle, which is stupid.
 	// What vkDeviceWaitIdle does, is wait until every queue on the device is idle. The 
 	// queue sends command buffers to the GPU with VkSubmitInfo. There is one problem though,
 	// the queue can be empty, after the last command buffer is given to the GPU, and then
 	// a command buffer will still be in the middle of executing on the GPU while vkDeviceWaitIdle
 	// stops waiting (when the queues are empty). 
-	vkDeviceWaitIdle(device);
+	// Every queue of the device is used while it waits, so
+	// the Demos that share the device can not submit now
+	{
+		QueueLock queueLock;
+		vkDeviceWaitIdle(device);
+	}
+
+	// The last Demo that uses the device (or the instance) destroys
+	// it, along with the cache and the allocator, everyone else only
+	// destroys what they made themselves
+	bool lastDeviceUser = device_context->Leave();
+	bool lastInstanceUser = device_context->instanceContext->Leave();
 
 	// To absolutely confirm that all of the GPU's tasks are finished, we need to wait for 
 	// the fences to be completed too. 
 
-	// We already called VkWaitForFences with the initFence after the init_cmd buffer was 
-	// executed, so we do not need to check for the initFence
 	// When we are certain that the GPU is completely idle, we can start deleting things
-	vkDestroyFence(device, initFence, NULL);
 
-	for (uint32_t i = 0; i < FRAME_LAG; i++)
+	for (uint32_t i = 0; i < frame_lag; i++)
 	{
 		// we wait for draw fences prior to rendering each image,
 		// but we do not check fences after, which means that the fences
@@ -3705,31 +13866,152 @@ Demo::~Demo()
 		// last frame is done rendering
 
 		// wait for the draw fence
-		vkWaitForFences(device, 1, &drawFences[i], VK_TRUE, UINT64_MAX);
+		DeviceTable::WaitForFences(device, 1, &drawFences[i], VK_TRUE, UINT64_MAX);
 
 		// Then we destroy all of the fences that we used for drawing
-		vkDestroyFence(device, drawFences[i], NULL);
+		vkDestroyFence(device, drawFences[i], HostAllocator::callbacks);
 
 		// Then we destroy all of the semaphores that were used for drawing
-		vkDestroySemaphore(device, image_acquired_semaphores[i], NULL);
-		vkDestroySemaphore(device, draw_complete_semaphores[i], NULL);
+		vkDestroySemaphore(device, image_acquired_semaphores[i], HostAllocator::callbacks);
+		vkDestroySemaphore(device, draw_complete_semaphores[i], HostAllocator::callbacks);
+
+		// destroying the pool also frees this frame's command buffer
+		vkDestroyCommandPool(device, frame_cmd_pool[i], HostAllocator::callbacks);
+	}
+
+	for (size_t i = 0; i < compute_cmd_pool.size(); i++)
+	{
+		vkDestroySemaphore(device, compute_complete_semaphores[i], HostAllocator::callbacks);
+		vkDestroyCommandPool(device, compute_cmd_pool[i], HostAllocator::callbacks);
+	}
+
+	if (frame_timeline != VK_NULL_HANDLE)
+		vkDestroySemaphore(device, frame_timeline, HostAllocator::callbacks);
+
+	// destroys the semaphore of the NV sleep
+	delete latency_markers;
+	delete trace_capture;
+	delete spike_detector;
+
+	// destroy the command pools of the recorder
+	delete recorder;
+	delete render_queue;
+	delete shadow_cache;
+
+	if (use_depth_prepass)
+		delete prepass_recorder;
+	delete gpu_timer;
+	delete dynamic_resolution;
+	delete pipeline_stats;
+	delete performance_counters;
+
+	// write the CPU times of the last frames to a file, which can be
+	// opened in a spreadsheet, and show a histogram in the console
+	cpu_profiler->ExportCsv(CPU_PROFILE_FILE);
+	cpu_profiler->PrintHistogram();
+	delete cpu_profiler;
+	delete frame_limiter;
+
+	// We destroy our uniform buffer (which was on the CPU),
+	// then all of our GPU buffers that were originally made
+	// from staging buffers. They are members, so they would be
+	// destroyed after the device, unless we destroy them here
+	delete uniform_arena;
+	matrixBufferCPU.Destroy();
+	meshlet_draws_cpu.Destroy();
+	delete mesh_pool;
+	delete culler;
+	delete hiz_pass;
+	delete particle_system;
+	delete skinning_pass;
+	delete instance_scatter;
+	delete object_picker;
+	delete temporal_pass;
+	delete occlusion_queries;
+	delete frame_graph;
+	delete frame_capture;
+
+	if (encoder_bridge != nullptr)
+	{
+		printf("Gave %llu frames to the encoder, dropped %llu\n",
+			(unsigned long long)encoder_bridge->GetSentCount(), (unsigned long long)encoder_bridge->GetDroppedCount());
+		delete encoder_bridge;
+	}
+
+	delete hud;
+	delete post_subpass;
+	delete metrics_exporter;
+	delete telemetry_channel;
+
+	for (size_t i = 0; i < output_windows.size(); i++)
+		delete output_windows[i];
+	instanceDataGPU.Destroy();
+	animationDataGPU.Destroy();
+	instanceDataCPU.Destroy();
+	delete instance_hierarchy;
+	delete instance_transforms;
+
+	// a streamed texture belongs to the streamer
+	// the pages of a sparse texture come from the pool
+	delete gpu_decompressor;
+	delete texture_compressor;
+
+	// the streamer cancels its reads before the reader is deleted
+	if (use_texture_streaming)
+	{
+		delete texture_streamer;
+		delete async_reader;
+		delete sparse_pool;
+	}
+	else if (use_video_texture)
+		delete video_texture;
+	else
+		delete textureGPU;
+
+	// the shared texture was deleted just before its memory
+	delete shared_texture;
+
+	// the loader can not be deleted while its jobs are running
+	if (texture_loader != nullptr)
+	{
+		job_system->Wait(&texture_decode);
+		delete texture_loader;
 	}
 
-	// We delete our uniform buffer (which was on the CPU),
-	// then we destroy all of our GPU buffers that were 
-	// originally made from staging buffers
-	delete matrixBufferCPU;
-	delete vertexDataGPU;
-	delete indexDataGPU;
-	delete textureGPU;
+	delete pending_texture;
+
+	for (TextureGPU* texture : scene_textures)
+		delete texture;
+
+	delete scene_generator;
+	delete scene_snapshot;
+	delete texture_packer;
+	delete voxel_world;
 
 	// delete render pass
-	vkDestroyRenderPass(device, render_pass, NULL);
+	vkDestroyRenderPass(device, render_pass, HostAllocator::callbacks);
 
-	// We destroy the pipeline data
-	vkDestroyPipeline(device, pipeline, NULL);
-	vkDestroyPipelineCache(device, pipelineCache, NULL);
-	vkDestroyPipelineLayout(device, pipeline_layout, NULL);
+	// We destroy the pipeline data. If the optimized pipeline
+	// is still being made, we wait for it, and destroy it too
+	discard_pending_pipeline();
+	delete pipeline_compiler;
+	delete pipeline_library;
+	vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+
+	if (use_depth_prepass)
+		vkDestroyPipeline(device, depth_pipeline, HostAllocator::callbacks);
+
+	if (use_occlusion_queries)
+		vkDestroyPipeline(device, occlusion_pipeline, HostAllocator::callbacks);
+
+	// save the cache to the disk, before we destroy it,
+	// so that the next launch of the program is faster
+	if (lastDeviceUser)
+	{
+		save_pipeline_cache();
+		vkDestroyPipelineCache(device, pipelineCache, HostAllocator::callbacks);
+	}
+	vkDestroyPipelineLayout(device, pipeline_layout, HostAllocator::callbacks);
 
 	// If the window is currently minimized, then the 
 	// width and height are zero, which means that the
@@ -3746,34 +14028,93 @@ Demo::~Demo()
 		delete_resolution_dependencies();
 	}
 
-	// destroy the swapchain
-	fpDestroySwapchainKHR(device, swapchain, NULL);
+	// every frame is done, so everything that
+	// was retired can be destroyed now
+	deletion_queue->Flush();
+
+	// destroy the swapchain, or the images that headless mode
+	// drew into, which have no swapchain to destroy them
+	if (swapchain != VK_NULL_HANDLE)
+		fpDestroySwapchainKHR(device, swapchain, HostAllocator::callbacks);
+
+	for (size_t i = 0; i < headless_images.size(); i++)
+		delete headless_images[i];
+
+	// delete the uploader, and its command pools
+	delete uploader;
 
-	// destroy the sampler
-	vkDestroySampler(device, sampler, NULL);
+	// the uploader flushed it when it waited for its batches
+	delete graphics_submits;
 
-	// destroy the descriptor pool, which holds
+	// everything that used the pool gave back what it took
+	delete sync_pool;
+
+	// it was flushed above, so it is empty
+	delete deletion_queue;
+
+	delete oneshot_cmds;
+
+	// the frame graph only points into it
+	delete frame_arena;
+
+	// Every buffer and texture has been deleted, and they
+	// all gave their memory back to the allocator, so now
+	// the allocator can give its blocks back to the driver
+	if (lastDeviceUser)
+		delete allocator;
+
+	// destroy every sampler
+	delete sampler_cache;
+
+	// the shader compiler, if we made one
+	delete shader_compiler;
+
+	// destroy the descriptor pools, which hold
 	// all of our uniforms. This will also destroy
-	// all Descriptor Sets that were in the pool, so we
+	// all Descriptor Sets that were in the pools, so we
 	// don't need to destroy the descriptor set by ourselves
-	vkDestroyDescriptorPool(device, desc_pool, NULL);
+	delete descriptor_allocator;
+
+	// destroy the template, if we made one
+	if (descriptor_template != VK_NULL_HANDLE)
+		fpDestroyDescriptorUpdateTemplateKHR(device, descriptor_template, HostAllocator::callbacks);
 
 	// destroy the layout of the descriptor sets
-	vkDestroyDescriptorSetLayout(device, desc_layout, NULL);
+	vkDestroyDescriptorSetLayout(device, desc_layout, HostAllocator::callbacks);
 
-	// Destroy the command pool, because we don't need to 
-	// send commands to the GPU anymore. This also destroys
-	// all command buffers that used the command pool, so
-	// we don't need to free command buffers by ourselves
-	vkDestroyCommandPool(device, cmd_pool, NULL);
+	if (use_frequency_sets)
+	{
+		vkDestroyDescriptorSetLayout(device, frequency_layouts[DESCRIPTOR_SET_PASS], HostAllocator::callbacks);
+		vkDestroyDescriptorSetLayout(device, frequency_layouts[DESCRIPTOR_SET_MATERIAL], HostAllocator::callbacks);
+	}
 
 	// Destroy device, which also destroys queues
 	// at the exact same time
-	vkDestroyDevice(device, NULL);
+	if (lastDeviceUser)
+		vkDestroyDevice(device, HostAllocator::callbacks);
 
-	// destroy the surface
-	vkDestroySurfaceKHR(inst, surface, NULL);
+	DeviceTable::Unload();
+
+	// destroy the surface, headless mode has none
+	if (surface != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(inst, surface, HostAllocator::callbacks);
 
 	// Destroy Vulkan Instance
-	vkDestroyInstance(inst, NULL);
+	if (lastInstanceUser)
+		vkDestroyInstance(inst, HostAllocator::callbacks);
+
+	// everyone who gave jobs to the job
+	// system is gone, so its threads can stop
+	delete job_system;
+
+	// the last messages are written out, when
+	// no other Demo is left that could log
+	if (lastInstanceUser)
+		Logger::Stop();
+
+	if (owns_device_context)
+	{
+		delete device_context->instanceContext;
+		delete device_context;
+	}
 }
@@ -30,6 +30,86 @@ that utilizes Vulkan, see more at http://cemu.info
 #include "BufferCPU.h"
 #include "BufferGPU.h"
 #include "TextureGPU.h"
+#include "MemoryAllocator.h"
+#include "DescriptorAllocator.h"
+#include "SamplerCache.h"
+#include "ShaderCompiler.h"
+#include "PipelineCompiler.h"
+#include "PipelineLibrary.h"
+#include "Uploader.h"
+#include "CommandRecorder.h"
+#include "CommandState.h"
+#include "RenderQueue.h"
+#include "MeshPool.h"
+#include "CommandBufferPool.h"
+#include "CullingPass.h"
+#include "HiZPass.h"
+#include "OcclusionQueries.h"
+#include "KtxFile.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "TextureLoader.h"
+#include "GpuTimer.h"
+#include "StartupTimeline.h"
+#include "JobSystem.h"
+#include "InitGraph.h"
+#include "PipelineStatistics.h"
+#include "PerformanceCounters.h"
+#include "CpuProfiler.h"
+#include "TimelineSemaphore.h"
+#include "PresentWait.h"
+#include "DynamicRendering.h"
+#include "FragmentShadingRate.h"
+#include "HostImageCopy.h"
+#include "ShadingRateImage.h"
+#include "TransformBatch.h"
+#include "TransformStore.h"
+#include "TransformHierarchy.h"
+#include "FrustumCulling.h"
+#include "DynamicResolution.h"
+#include "TemporalPass.h"
+#include "TextureStreamer.h"
+#include "TransientPool.h"
+#include "FrameCapture.h"
+#include "FrameLimiter.h"
+#include "PresentThread.h"
+#include "LatencyMarkers.h"
+#include "HudOverlay.h"
+#include "MetricsExporter.h"
+#include "TraceCapture.h"
+#include "SpikeDetector.h"
+#include "MicroBenchmark.h"
+#include "SceneGenerator.h"
+#include "AutoTuner.h"
+#include "VoxelWorld.h"
+#include "TexturePacker.h"
+#include "AssetPack.h"
+#include "AsyncFileReader.h"
+#include "GpuDecompressor.h"
+#include "ImageDecoder.h"
+#include "TextureCompressor.h"
+#include "VideoTexture.h"
+#include "ExternalMemory.h"
+#include "EncoderBridge.h"
+#include "ThreadScheduler.h"
+#include "UniformArena.h"
+#include "DescriptorSets.h"
+#include "ShadowCache.h"
+#include "PostSubpass.h"
+#include "TextureTranscoder.h"
+#include "ParticleSystem.h"
+#include "SkinningPass.h"
+#include "ObjectPicker.h"
+#include "SceneFile.h"
+#include "TelemetryChannel.h"
+#include "Camera.h"
+#include "InstanceScatter.h"
+#include "SurfaceFormat.h"
+#include "OutputWindow.h"
+#include "FrameGraph.h"
+#include "FrameArena.h"
+#include "DeletionQueue.h"
+#include "DeviceContext.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -37,18 +117,181 @@ that utilizes Vulkan, see more at http://cemu.info
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
-// Allow a maximum of two outstanding presentation operations.
-#define FRAME_LAG 2
+// Allow a maximum of two outstanding presentation operations,
+// unless another number is given with "-frames N" (see frame_lag)
+#define DEFAULT_FRAME_LAG 2
+#define MAX_FRAME_LAG 4
+
+// the pipeline cache is saved to this file when the program
+// closes, and loaded from it when the program launches
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+
+// the cube mesh is built from CubeDataArrays.h the first
+// time the program runs, and saved to this file, after that
+// it is loaded from the file, see prepare_vb_ib
+#define MESH_FILE "cube.mesh"
+
+// with dynamic instances, how many instances
+// spin in each frame, see update_instances
+#define DYNAMIC_INSTANCES_PER_FRAME 1024
+
+// with the fixed timestep, the simulation moves forward
+// by this many seconds in each step, see update_simulation
+#define SIMULATION_STEP (1.0 / 60.0)
+
+// after a long stall (like a breakpoint, or a hidden window),
+// at most this many steps are taken in one frame, the rest
+// of the time is dropped, instead of catching up for seconds
+#define MAX_SIMULATION_STEPS 8
+
+// the number of textures in the bindless texture array, this
+// has to match the size of the array in cube_bindless.frag
+#define BINDLESS_TEXTURE_COUNT 1024
+
+// the CPU time of the last frames is written
+// to this file when the program closes
+#define CPU_PROFILE_FILE "cpu_profile.csv"
+
+// the trace capture writes here, open it in
+// chrome://tracing, or in ui.perfetto.dev
+#define TRACE_FILE "trace.json"
+
+// the spike detector adds every spike to the end of this file
+#define SPIKE_LOG_FILE "spikes.log"
+
+// A benchmark writes its results here. When the baseline file
+// is there too (a copy of the results of an older run), every result
+// that is more than BENCHMARK_TOLERANCE percent slower is a regression.
+// The slowest frames change more from run to run than the average, the
+// startup depends on what the disk has cached, and the memory should
+// not change at all, so each of those has its own tolerance
+#define BENCHMARK_FILE "benchmark.json"
+#define BENCHMARK_BASELINE_FILE "benchmark_baseline.json"
+#define BENCHMARK_TOLERANCE 5.0
+#define BENCHMARK_PERCENTILE_TOLERANCE 10.0
+#define BENCHMARK_STARTUP_TOLERANCE 20.0
+#define BENCHMARK_MEMORY_TOLERANCE 1.0
+
+// the CPU time of this many presents is kept, to
+// measure how long each one took to reach the screen
+#define PRESENT_HISTORY 64
+
+// the shader files are checked for changes every
+// this many frames, when shader hot reload is on
+#define SHADER_RELOAD_INTERVAL 30
+
+// With render on demand, after something changes, this many frames
+// are drawn, because the occlusion queries and the Hi-Z pyramid use
+// the frame before. The temporal upscaler needs more, to fill its history
+#define REDRAW_FRAMES 2
+#define TEMPORAL_REDRAW_FRAMES 16
+
+// when there is nothing to draw, the render thread sleeps
+// this long at most, so it still sees saved shader files
+#define RENDER_ON_DEMAND_POLL_MS 100
+
+// while the edge of the window is dragged, the swapchain
+// is rebuilt at most this often, see RenderLoop
+#define LIVE_RESIZE_INTERVAL_MS 100
+
+// a present could have happened earlier if it had
+// at least this many nanoseconds (2ms) to spare
+#define PRESENT_EARLY_MARGIN 2000000ULL
+
+// the longest time that low latency mode waits
+// for a frame to be on the screen (100ms)
+#define PRESENT_WAIT_TIMEOUT 100000000ULL
+
+// The layers that can be turned on when the program starts, with
+// "-validate", "-api_dump", "-monitor", or with the VKCUBE_LAYERS
+// environment variable, like VKCUBE_LAYERS=validation,monitor.
+// Debug builds turn on validation by default, release builds turn
+// on nothing, so a released program never pays for a layer
+#define LAYER_VALIDATION 0x1
+#define LAYER_API_DUMP 0x2
+#define LAYER_MONITOR 0x4
+
+// How the window is shown, picked with "-borderless" or "-exclusive"
+// on the command line. Borderless covers the whole monitor with a window
+// that has no border, then Windows gives the swapchain to the monitor
+// directly (independent flip), instead of copying it into the desktop.
+// Exclusive also asks the driver to own the monitor, with
+// VK_EXT_full_screen_exclusive, and falls back to borderless without it
+#define WINDOW_MODE_WINDOWED 0
+#define WINDOW_MODE_BORDERLESS 1
+#define WINDOW_MODE_EXCLUSIVE 2
+
+// "-headless" makes no window, no surface, and no swapchain, for
+// machines without a desktop, like a render farm. The frames are drawn
+// into images of our own (see prepare_headless_images), and frame
+// capture reads them back, which is the only way to see them
+#define WINDOW_MODE_HEADLESS 3
+
+// The CPU work of each frame that does not use the swapchain image,
+// in the order that it runs, see run_frame_work. With polled acquire,
+// the steps run while the image is not ready yet
+enum FrameWork
+{
+	FRAME_WORK_CAPTURE,
+	FRAME_WORK_UPLOADS,
+	FRAME_WORK_BUDGET,
+	FRAME_WORK_STREAMING,
+	FRAME_WORK_UNIFORMS,
+	FRAME_WORK_COUNT
+};
 
 typedef struct {
 	VkImage image;
 	VkImageView view;
-
-	VkCommandBuffer cmd;
 	VkFramebuffer framebuffer;
+	// the HUD draws on top of the finished image, in its own render pass
+	VkFramebuffer hudFramebuffer;
 } SwapchainImageResources;
 
+
+// Every descriptor of descriptor_set, packed together. The update
+// template reads the descriptors straight out of this struct, at the
+// offsets of its members, see prepare_descriptor_template
+typedef struct {
+	VkDescriptorBufferInfo uniformBuffer;
+	VkDescriptorImageInfo texture;
+} DescriptorSetData;
+
+// The values of the specialization constants of the fragment shader,
+// each member is one constant_id, see prepare_pipeline. A bool constant
+// has to be a VkBool32, which is 4 bytes, not a C++ bool
+typedef struct {
+	VkBool32 textured;
+} ShaderConstants;
+
+// Everything that create_pipeline takes from the options, so a
+// pipeline can also be made for options that this run does not use,
+// see prewarm_pipeline_cache. positionStride is only read by the
+// depth-only pipeline, and depthModule is its vertex shader
+typedef struct {
+	VkPipelineLayout layout;
+	VkShaderModule vertModule;
+	VkShaderModule fragModule;
+	VkShaderModule depthModule;
+	uint32_t positionStride;
+	bool instancing;
+	bool animation;
+	bool pulling;
+	bool compact;
+} PipelineVariant;
+
+// The push constants of cube_pull.vert, which has no vertex input,
+// it reads vertexWords 32-bit words for each vertex, starting at the
+// device address of the vertex buffer. compact is 1 for
+// CompactVertexStructure, and 0 for VertexStructure
+typedef struct {
+	VkDeviceAddress vertices;
+	uint32_t vertexWords;
+	uint32_t compact;
+} VertexPullConstants;
+
 class Demo
 {
 public:
@@ -58,8 +301,37 @@ public:
 
 	VkSurfaceKHR surface;
 	bool prepared;
+
+	// This boolean keeps track of how many times we have executed the
+	// "prepare()" function. If we have never used the function before
+	// then we know we are initializing the demo for the first time,
+	// if the boolean is false, then we know the demo has already
+	// been initialized. It belongs to each demo (not to the file),
+	// so that a second Demo in the same process starts from the beginning
+	bool firstInit;
 	bool is_minimized;
 
+	// The instance, the device, the pipeline cache, and the allocator can
+	// be shared with other Demos, see DeviceContext.h. A Demo that is made
+	// without a context makes its own, and shares it with nobody.
+	// makes_instance and makes_device are true for the Demo that joined
+	// first, which made them, every other one takes them from the context
+	DeviceContext* device_context;
+	bool owns_device_context;
+	bool makes_instance;
+	bool makes_device;
+
+	// true when the last present said that the swapchain does not fit
+	// the window anymore, then a resize that is waiting is done right away
+	bool swapchain_stale;
+
+	// The size that the current swapchain and everything that
+	// depends on it were built with, see resize()
+	VkExtent2D swapchain_extent;
+
+	// Frame pacing with VK_GOOGLE_display_timing, see
+	// update_target_IPD. All of the times are in nanoseconds
+	bool display_timing_enabled;
 	bool syncd_with_actual_presents;
 	uint64_t refresh_duration;
 	uint64_t refresh_duration_multiplier;
@@ -69,14 +341,53 @@ public:
 	uint32_t last_early_id;  // 0 if no early images
 	uint32_t last_late_id;   // 0 if no late images
 
+	// when present was called for each present ID, and the
+	// total time from present to the screen, for the average
+	uint64_t present_cpu_times[PRESENT_HISTORY];
+
+	// the frame (present ID of VK_KHR_present_id) that was
+	// presented with each display timing present ID
+	uint64_t present_frame_ids[PRESENT_HISTORY];
+	double present_latency_total;
+	uint32_t present_latency_count;
+
 	VkInstance inst;
 	VkPhysicalDevice gpu;
 	VkDevice device;
 	VkQueue queue;
-	VkSemaphore image_acquired_semaphores[FRAME_LAG];
-	VkSemaphore draw_complete_semaphores[FRAME_LAG];
+	uint32_t graphics_queue_family_index;
+
+	// queue for copying data from CPU to GPU, this is the
+	// same as "queue" if the GPU has no transfer-only family
+	VkQueue transfer_queue;
+	uint32_t transfer_queue_family_index;
+
+	// With async compute, the GPU culling pass is submitted to a queue of
+	// a compute-only family. The buffers that both queues use are shared
+	// by async_compute_families, and compute_complete_semaphores[slot]
+	// tells the graphics queue when the culling is done, see draw
+	bool use_async_compute;
+	VkQueue compute_queue;
+	uint32_t compute_queue_family_index;
+	std::vector<uint32_t> async_compute_families;
+	std::vector<VkCommandPool> compute_cmd_pool;
+	std::vector<VkCommandBuffer> compute_cmd;
+	std::vector<VkSemaphore> compute_complete_semaphores;
+
+	// the number of frames in flight, each one has
+	// its own semaphores, fence, and command buffer
+	uint32_t frame_lag;
+	std::vector<VkSemaphore> image_acquired_semaphores;
+	std::vector<VkSemaphore> draw_complete_semaphores;
+
 	VkPhysicalDeviceMemoryProperties memory_properties;
 
+	// gives out memory to every buffer and texture
+	MemoryAllocator* allocator;
+
+	// records and submits every CPU to GPU copy
+	Uploader* uploader;
+
 	uint32_t enabled_extension_count;
 	uint32_t enabled_layer_count;
 	char *extension_names[64];
@@ -84,8 +395,48 @@ public:
 
 	int width, height;
 	VkFormat format;
+
+	// With the offscreen target, the scene is drawn into images that
+	// belong to us (offscreenColorGPU and offscreen_framebuffer), not
+	// into the swapchain images, and then offscreenColorGPU is blitted
+	// to the swapchain image that we present
+	bool use_offscreen_target;
+	VkFramebuffer offscreen_framebuffer;
+
+	// With output windows, the offscreen image is also blitted into
+	// the swapchains of other windows, which are presented together
+	// with the main swapchain, in one vkQueuePresentKHR
+	bool use_output_windows;
+	uint32_t output_window_count;
+	std::vector<OutputWindow*> output_windows;
+
+	// With dynamic resolution, the scene is drawn into the top-left
+	// render_width x render_height pixels of offscreenColorGPU, which
+	// has the size of the window, and then it is scaled up to the
+	// swapchain image with a blit. Without it, these are width and height
+	bool use_dynamic_resolution;
+	DynamicResolution* dynamic_resolution;
+	uint32_t render_width, render_height;
+	uint64_t dynamic_resolution_frames;
+	TextureGPU* offscreenColorGPU;
 	VkColorSpaceKHR color_space;
 
+	// With temporal upscaling, the scene is drawn at temporal_render_scale
+	// of the window (or at the size that dynamic resolution picks), with a
+	// different jitter in every frame, and temporal_pass blends it into the
+	// history, at the size of the window (see TemporalPass.h). The history
+	// is what is blitted to the swapchain. temporal_vp is the view and
+	// projection of this frame without the jitter, and temporal_previous_vp
+	// is the one of the last frame, which is where the history was drawn
+	bool use_temporal_upscale;
+	float temporal_render_scale;
+	float temporal_blend;
+	TemporalPass* temporal_pass;
+	TemporalHistory* temporal_history;
+	glm::vec2 temporal_jitter;
+	glm::mat4 temporal_vp;
+	glm::mat4 temporal_previous_vp;
+
 	// Function pointers that we get from the instance
 	PFN_vkGetPhysicalDeviceSurfaceSupportKHR fpGetPhysicalDeviceSurfaceSupportKHR;
 	PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR fpGetPhysicalDeviceSurfaceCapabilitiesKHR;
@@ -93,6 +444,40 @@ public:
 	PFN_vkGetPhysicalDeviceSurfacePresentModesKHR fpGetPhysicalDeviceSurfacePresentModesKHR;
 	PFN_vkGetSwapchainImagesKHR fpGetSwapchainImagesKHR;
 	PFN_vkGetDeviceProcAddr fpGetDeviceProcAddr;
+	PFN_vkGetPhysicalDeviceFeatures2KHR fpGetPhysicalDeviceFeatures2KHR;
+	PFN_vkGetPhysicalDeviceProperties2KHR fpGetPhysicalDeviceProperties2KHR;
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR fpGetPhysicalDeviceMemoryProperties2KHR;
+	PFN_vkGetPhysicalDeviceImageFormatProperties2KHR fpGetPhysicalDeviceImageFormatProperties2KHR;
+	PFN_vkGetPhysicalDeviceSurfaceCapabilities2KHR fpGetPhysicalDeviceSurfaceCapabilities2KHR;
+
+	// true if VK_KHR_get_physical_device_properties2 is enabled
+	bool properties2_enabled;
+
+	// true if VK_KHR_external_memory_capabilities and
+	// VK_KHR_external_semaphore_capabilities are enabled
+	bool external_capabilities_enabled;
+
+	// One of the WINDOW_MODE values. With WINDOW_MODE_EXCLUSIVE,
+	// full_screen_exclusive_enabled is true if the driver can do it,
+	// and full_screen_exclusive_acquired is true while we own the
+	// monitor, which is lost when another window comes to the front.
+	// window_monitor is the monitor that the window covers
+	uint32_t window_mode;
+	HMONITOR window_monitor;
+	bool surface_capabilities2_enabled;
+	bool full_screen_exclusive_enabled;
+	bool full_screen_exclusive_acquired;
+	PFN_vkAcquireFullScreenExclusiveModeEXT fpAcquireFullScreenExclusiveModeEXT;
+
+	// With a device group, the device is made from several linked GPUs,
+	// which take turns drawing frames. device_group_present_device[i] is
+	// the GPU that presents the images of GPU i, see prepare_swapchain
+	bool use_device_group;
+	bool device_group_creation_enabled;
+	std::vector<VkPhysicalDevice> device_group_devices;
+	uint32_t device_group_count;
+	uint32_t device_group_present_device[VK_MAX_DEVICE_GROUP_SIZE];
+	PFN_vkEnumeratePhysicalDeviceGroupsKHR fpEnumeratePhysicalDeviceGroupsKHR;
 
 
 	// Function pointers that we get from the device
@@ -100,49 +485,810 @@ public:
 	PFN_vkDestroySwapchainKHR fpDestroySwapchainKHR;
 	PFN_vkAcquireNextImageKHR fpAcquireNextImageKHR;
 	PFN_vkQueuePresentKHR fpQueuePresentKHR;
+	PFN_vkCmdDrawIndexedIndirectCountKHR fpCmdDrawIndexedIndirectCountKHR;
+	PFN_vkGetRefreshCycleDurationGOOGLE fpGetRefreshCycleDurationGOOGLE;
+	PFN_vkGetPastPresentationTimingGOOGLE fpGetPastPresentationTimingGOOGLE;
+	PFN_vkWaitSemaphoresKHR fpWaitSemaphoresKHR;
+	PFN_vkGetSemaphoreCounterValueKHR fpGetSemaphoreCounterValueKHR;
+	PFN_vkWaitForPresentKHR fpWaitForPresentKHR;
+	PFN_vkSetLatencySleepModeNV fpSetLatencySleepModeNV;
+	PFN_vkLatencySleepNV fpLatencySleepNV;
+	PFN_vkSetLatencyMarkerNV fpSetLatencyMarkerNV;
+	PFN_vkAntiLagUpdateAMD fpAntiLagUpdateAMD;
+	PFN_vkGetCalibratedTimestampsEXT fpGetCalibratedTimestampsEXT;
+	PFN_vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR fpEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR;
+	PFN_vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR fpGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR;
+	PFN_vkAcquireProfilingLockKHR fpAcquireProfilingLockKHR;
+	PFN_vkReleaseProfilingLockKHR fpReleaseProfilingLockKHR;
+	PFN_vkCmdBeginRenderingKHR fpCmdBeginRenderingKHR;
+	PFN_vkCmdEndRenderingKHR fpCmdEndRenderingKHR;
+	PFN_vkGetBufferDeviceAddressEXT fpGetBufferDeviceAddressEXT;
+	PFN_vkCmdSetFragmentShadingRateKHR fpCmdSetFragmentShadingRateKHR;
+	PFN_vkCmdBeginConditionalRenderingEXT fpCmdBeginConditionalRenderingEXT;
+	PFN_vkCmdEndConditionalRenderingEXT fpCmdEndConditionalRenderingEXT;
+	PFN_vkTransitionImageLayoutEXT fpTransitionImageLayoutEXT;
+	PFN_vkCopyMemoryToImageEXT fpCopyMemoryToImageEXT;
+	PFN_vkCreateSamplerYcbcrConversionKHR fpCreateSamplerYcbcrConversionKHR;
+	PFN_vkDestroySamplerYcbcrConversionKHR fpDestroySamplerYcbcrConversionKHR;
+	PFN_vkGetMemoryWin32HandleKHR fpGetMemoryWin32HandleKHR;
+	PFN_vkGetMemoryWin32HandlePropertiesKHR fpGetMemoryWin32HandlePropertiesKHR;
+	PFN_vkGetSemaphoreWin32HandleKHR fpGetSemaphoreWin32HandleKHR;
+	PFN_vkImportSemaphoreWin32HandleKHR fpImportSemaphoreWin32HandleKHR;
+	PFN_vkCreateDescriptorUpdateTemplateKHR fpCreateDescriptorUpdateTemplateKHR;
+	PFN_vkDestroyDescriptorUpdateTemplateKHR fpDestroyDescriptorUpdateTemplateKHR;
+	PFN_vkUpdateDescriptorSetWithTemplateKHR fpUpdateDescriptorSetWithTemplateKHR;
+	PFN_vkCmdPushDescriptorSetWithTemplateKHR fpCmdPushDescriptorSetWithTemplateKHR;
+	PFN_vkGetImageMemoryRequirements2KHR fpGetImageMemoryRequirements2KHR;
+	PFN_vkGetBufferMemoryRequirements2KHR fpGetBufferMemoryRequirements2KHR;
+	PFN_vkAcquireNextImage2KHR fpAcquireNextImage2KHR;
+	PFN_vkGetDeviceGroupPresentCapabilitiesKHR fpGetDeviceGroupPresentCapabilitiesKHR;
+	PFN_vkGetDeviceGroupSurfacePresentModesKHR fpGetDeviceGroupSurfacePresentModesKHR;
 
 	// swapchain, and the swapchain images
 	VkSwapchainKHR swapchain;
 	uint32_t swapchainImageCount;
 	SwapchainImageResources *swapchain_image_resources;
 
-	// current mode of the swapchain
+	// true if VK_KHR_swapchain is enabled, which headless mode does
+	// not need. Without a swapchain, the images that we draw into are
+	// headless_images, and the frame leaves them in present_layout,
+	// which is TRANSFER_SRC_OPTIMAL instead of PRESENT_SRC_KHR
+	bool swapchain_enabled;
+	std::vector<TextureGPU*> headless_images;
+	VkImageLayout present_layout;
+
+	// how many swapchains were made, the first one too
+	uint64_t swapchain_count;
+
+	// current mode of the swapchain, and the mode that we want,
+	// which is used if the GPU and the surface support it
 	VkPresentModeKHR currentPresentMode;
+	VkPresentModeKHR present_mode;
+
+	// With a wide swapchain format, the swapchain has 10-bit or half
+	// float channels if the surface has them, instead of 8-bit ones
+	bool use_wide_swapchain_format;
 
 	// fences that are used for drawing
-	VkFence drawFences[FRAME_LAG];
+	std::vector<VkFence> drawFences;
 	int frame_index;
 
+	// if this is true, frames are tracked with one timeline
+	// semaphore, which counts the frames that are done
+	bool use_timeline_semaphores;
+	VkSemaphore frame_timeline;
+
+	// the submissions to the graphics queue that go with the next frame
+	bool use_submit_batching;
+
+	// the driver's CPU memory comes from HostAllocator, see HostAllocator.cpp
+	bool use_host_allocator;
+
+	// big CPU arrays are in large pages, see LargePages.h
+	bool use_large_pages;
+	SubmitBatch* graphics_submits;
+
+	// fences and binary semaphores that are given out and taken back
+	SyncPool* sync_pool;
+
+	// command buffers for one-shot work, one pool for
+	// each thread and frame slot, see CommandBufferPool.cpp
+	CommandBufferPool* oneshot_cmds;
+
+	// arrays that the CPU only needs while it builds one
+	// frame come from here, see FrameArena.cpp
+	FrameArena* frame_arena;
+
+	// low latency mode, and present wait, which it uses if it
+	// can. swapchain_first_frame is the first frame that was
+	// presented with the current swapchain
+	bool low_latency;
+	bool present_wait_enabled;
+
+	// true if every present has a VkPresentIdKHR, which present
+	// wait needs, and the NV latency markers too
+	bool present_id_enabled;
+
+	// With polled acquire, the image is acquired with a timeout
+	// of zero, and the FRAME_WORK steps fill the wait, see draw
+	bool use_polled_acquire;
+
+	// With the present thread, draw() gives its present to
+	// present_thread, which calls vkQueuePresentKHR, so draw()
+	// never waits inside of the present, see PresentThread.h
+	bool use_present_thread;
+	PresentThread* present_thread;
+
+	// With latency markers, each frame remembers when it read the
+	// input, simulated, submitted, and presented, and the time until
+	// it was on the screen is printed, see LatencyMarkers.h. The NV
+	// and AMD low latency extensions are used if the GPU has them
+	bool use_latency_markers;
+	bool latency_nv_enabled;
+	bool anti_lag_enabled;
+	LatencyMarkers* latency_markers;
+
+	// true if VK_EXT_memory_budget is enabled, then the
+	// allocator knows the real budget of each heap
+	bool memory_budget_enabled;
+
+	// true if VK_KHR_dedicated_allocation is enabled, then big
+	// images can get memory of their own, see MemoryAllocator::AllocateImage
+	bool dedicated_allocation_enabled;
+	uint64_t swapchain_first_frame;
+
+	// the number of frames that have been drawn,
+	// and resources that are waiting for frames to finish
+	// (like an old swapchain, or a pipeline that was replaced)
+	uint64_t frame_count;
+	DeletionQueue* deletion_queue;
+
+	// each frame_index has a command pool, which is reset
+	// every frame, and a command buffer that is recorded every frame
+	std::vector<VkCommandPool> frame_cmd_pool;
+	std::vector<VkCommandBuffer> frame_cmd;
+
+	// the threads that every part of the demo gives its jobs to
+	JobSystem* job_system;
+
+	// With thread scheduling, the render thread (see RenderLoop in
+	// Main.cpp) and the present thread apply these schedules, and the
+	// workers of the job system stay off of render_core
+	bool use_thread_scheduling;
+	uint32_t render_core;
+	ThreadSchedule render_schedule;
+	ThreadSchedule present_schedule;
+
+	// records the draws in secondary command buffers, on many threads
+	CommandRecorder* recorder;
+	std::vector<VkCommandBuffer> secondary_cmds;
+
+	// With the render queue, every draw of the frame is a packet with
+	// a sort key (pass, pipeline, texture, depth), and record_draws
+	// draws the cubes in the order of the sorted keys, see build_render_queue
+	bool use_render_queue;
+	RenderQueue* render_queue;
+
+	// the binds that record_draws recorded in the last
+	// frame, and the ones that it skipped (see CommandState)
+	CommandStateStats draw_state_stats;
+
+	// With the depth pre-pass, the render pass has two subpasses.
+	// The first one only draws depth, with depth_pipeline, and its
+	// own secondary command buffers. Then the main pass only shades
+	// the pixels where its depth is EQUAL to the closest depth
+	bool use_depth_prepass;
+	VkPipeline depth_pipeline;
+	VkShaderModule depth_vert_shader_module;
+	CommandRecorder* prepass_recorder;
+	std::vector<VkCommandBuffer> prepass_cmds;
+
+	// With occlusion queries, the box of every cube is tested at the end
+	// of the depth pre-pass, with occlusion_pipeline, which tests depth
+	// but never writes it, and the GPU skips the cubes whose box was
+	// hidden in the last frame, see OcclusionQueries.h. occlusion_box is
+	// the bounding box of the cube mesh, in the mesh pool. A cube is drawn
+	// without the condition (object_conditional is 0) when the camera is
+	// inside of its box, or when it was outside of the view in the last
+	// frame, because then its query could not see it
+	bool use_occlusion_queries;
+	OcclusionQueries* occlusion_queries;
+	VkPipeline occlusion_pipeline;
+	MeshRange occlusion_box;
+	std::vector<uint8_t> object_in_view;
+	std::vector<uint8_t> object_conditional;
+	std::vector<uint32_t> occlusion_visible;
+
+	// timestamps of every frame on the GPU
+	GpuTimer* gpu_timer;
+
+	// With pipeline statistics, the vertices, triangles, and shader
+	// invocations of the render pass are counted, and printed
+	bool use_pipeline_statistics;
+	PipelineStatistics* pipeline_stats;
+
+	// With performance counters, the hardware counters that are named
+	// in performance_counter_names are read around the render pass, and
+	// printed, if the GPU has VK_KHR_performance_query
+	bool use_performance_counters;
+	bool performance_query_enabled;
+	const char* performance_counter_names;
+	PerformanceCounters* performance_counters;
+
+	// time that each part of draw() takes on the CPU
+	CpuProfiler* cpu_profiler;
+
+	// time that each step of prepare() takes, the first time
+	StartupTimeline startup_timeline;
+
+	// In benchmark mode, the demo draws this many frames as fast
+	// as it can, prints the results, and sets benchmark_done.
+	// Zero means the demo runs normally, until the window closes
+	uint32_t benchmark_frames;
+	bool benchmark_done;
+	bool benchmark_regressed;
+	CpuClock::time_point benchmark_start;
+
+	// the most memory that our blocks held at the end of a frame
+	// of the benchmark, which is compared with the baseline too
+	VkDeviceSize benchmark_peak_memory;
+
+	// With auto tuning, the settings of AutoTuner.h come from
+	// AUTO_TUNE_FILE for this GPU, or the tuner finds them, the first
+	// time (or again with "-autotune"). A candidate of the tuner gets
+	// its settings on the command line, in tune_candidate
+	bool use_auto_tuning;
+	bool auto_tune_retune;
+	double auto_tune_target_ms;
+	bool has_tune_candidate;
+	TunedSettings tune_candidate;
+
 	// sampler that is used by all textures
+	// the sampler of textureGPU, which comes from the sampler cache,
+	// and uses anisotropic filtering if use_anisotropy is true
 	VkSampler sampler;
+	SamplerCache* sampler_cache;
+	bool use_anisotropy;
+
+	// Every mesh is a range of the pool's vertex buffer and index
+	// buffer, so every draw binds the same two buffers. The pool
+	// also has the positions of the vertices, for the depth pre-pass
+	MeshPool* mesh_pool;
+	MeshRange cube_mesh;
+	uint32_t position_stride;
 
-	BufferCPU* vertexDataCPU;
-	BufferGPU* vertexDataGPU;
-	BufferCPU* indexDataCPU;
-	BufferGPU* indexDataGPU;
-	BufferCPU* textureCPU;
+	// the levels of detail of the cube, their firstIndex is
+	// already in the pool's index buffer, see prepare_vb_ib
+	std::vector<MeshLod> mesh_lods;
+
+	// how many levels of detail build_cube_mesh makes
+	uint32_t mesh_lod_count;
+
+	// if this is true, the vertex buffer has half-float
+	// positions and 16-bit UVs, see CompactVertexStructure
+	bool use_compact_vertices;
+
+	// With vertex pulling, the pipeline has no vertex input state,
+	// cube_pull.vert reads each vertex from the mesh pool, through the
+	// device address that is in vertex_pull_constants, and decodes
+	// it itself, so one pipeline works with either vertex format
+	bool use_vertex_pulling;
+	VertexPullConstants vertex_pull_constants;
+	BufferGPU instanceDataGPU;
 	TextureGPU* textureGPU;
+
+	// With texture streaming, textureGPU belongs to the streamer, and
+	// it is replaced when more (or less) of its levels are resident.
+	// Each frame_index has its own descriptor set, which is written
+	// again when the streamer's generation is not the one it has
+	bool use_texture_streaming;
+	VkDeviceSize texture_budget;
+	TextureStreamer* texture_streamer;
+	std::vector<VkDescriptorSet> streamed_sets;
+	std::vector<uint32_t> streamed_set_generations;
+
+	// With sparse textures, the streamed texture is one sparse image,
+	// and its levels get pages from sparse_pool when they are loaded
+	bool use_sparse_textures;
+	SparseTilePool* sparse_pool;
+
+	// With defragmentation, the streamer moves its textures out of
+	// memory blocks that are mostly empty, so they can be freed
+	bool use_defragmentation;
+
+	// With asynchronous reads, the streamer reads the levels that it
+	// loads with async_reader, instead of from the mapped file
+	bool use_async_reads;
+	AsyncFileReader* async_reader;
+
+	// With GPU decompression, a compressed texture that is compressed in
+	// the asset pack too is decompressed by gpu_decompressor, on the GPU
+	bool use_gpu_decompression;
+	GpuDecompressor* gpu_decompressor;
+
+	// With the texture cache, the TextureLoader keeps the decoded pixels
+	// of every image next to it, and copies them from there next time
+	bool use_texture_cache;
+
+	// With GPU texture compression, the generated textures of the scene
+	// are compressed to BC1 by texture_compressor, after they are made
+	bool use_gpu_texture_compression;
+	TextureCompressor* texture_compressor;
+
+	// With host image copy, the textures that do not need GenerateMips
+	// are copied into their images by the CPU (VK_EXT_host_image_copy),
+	// see add_host_transfer_usage and Uploader::EnableHostImageCopy
+	bool use_host_image_copy;
+
+	// With the placeholder texture, textureGPU is a checkerboard until
+	// texture_loader has decoded the PNG (texture_decode is zero), and
+	// pending_texture is uploaded. Then it is the logo, and
+	// texture_generation says which streamed_sets are out of date
+	bool use_placeholder_texture;
+	TextureLoader* texture_loader;
+	JobCounter texture_decode;
+	TextureGPU* pending_texture;
+	UploadTicket pending_texture_ticket;
+	uint32_t texture_generation;
+
+	// With the video texture, the cubes show video_texture instead of the
+	// logo, a new frame of the video goes into it every frame (from
+	// MakeTestFrame, into video_frame), and textureGPU is the image that
+	// it shows. video_format is NV12, or P010 for 10 bit video
+	bool use_video_texture;
+	VkFormat video_format;
+	VideoTexture* video_texture;
+	std::vector<uint8_t> video_frame;
+	uint32_t video_frame_index;
+
+	// With external memory, images, buffers, and semaphores can be shared
+	// with other processes (see ExternalMemory.h). If VKCUBE_SHARED_TEXTURE
+	// names a texture that another process exported, the cubes sample it,
+	// and shared_texture is its memory, see prepare_shared_texture
+	bool use_external_memory;
+	ExternalFunctions external_functions;
+	ExternalMemory* shared_texture;
+
 	TextureGPU* depthBufferGPU;
 
-	VkCommandPool cmd_pool;
-	VkCommandBuffer initCmd;
-	VkFence initFence;
+	// the aspects of the depth format, with stencil if it has any
+	VkImageAspectFlags depth_aspect;
+
+	// the format of the depth buffer, it stays the same when the
+	// depth buffer is made again, so pipelines can read it on any thread
+	VkFormat depth_buffer_format;
+
+	// The depth buffer, the MSAA color, and the offscreen color belong
+	// to this pool, images that are never used at the same time in a
+	// frame share memory, see TransientPool.cpp
+	TransientPool* transient_pool;
+
+	// if this is true, the depth buffer uses a 32-bit format,
+	// otherwise it uses the smallest format that the GPU supports
+	bool depth_high_precision;
+
+	// With MSAA, the scene is drawn into msaaColorGPU (and the depth
+	// buffer) with msaa_sample_count samples per pixel, and resolved
+	// into the swapchain image at the end of the subpass.
+	// msaa_samples is how many samples we ask for (1, 2, 4, or 8)
+	uint32_t msaa_samples;
+	VkSampleCountFlagBits msaa_sample_count;
+	TextureGPU* msaaColorGPU;
+
+	// With the post subpass, the scene is drawn into sceneColorGPU, and
+	// the last subpass of the render pass grades it into the color
+	// attachment, while it is still in the tile memory, see PostSubpass.h
+	bool use_post_subpass;
+	PostSubpass* post_subpass;
+	TextureGPU* sceneColorGPU;
+
+	// With variable rate shading (VK_KHR_fragment_shading_rate), one
+	// invocation of the fragment shader can shade 2x2 or 4x4 pixels.
+	// With use_shading_rate, each draw picks its rate from its LOD, so
+	// the cubes that are far away are shaded coarser (see record_draws).
+	// With the shading rate image, the edges of the screen are shaded
+	// coarser too (see ShadingRateImage.cpp), which needs dynamic
+	// rendering. shading_rate_combiner is how the rate of the draw and
+	// the rate of the image become one, and shading_rate_texel is how
+	// many pixels one texel of the image covers
+	bool use_shading_rate;
+	bool use_shading_rate_image;
+	VkExtent2D shading_rate_texel;
+	VkFragmentShadingRateCombinerOpKHR shading_rate_combiner;
+	ShadingRateImage* shading_rate_image;
+
 	VkPipelineLayout pipeline_layout;
 	VkDescriptorSetLayout desc_layout;
+
+	// With the sets split by frequency, desc_layout is the layout of
+	// the frame set (the uniform buffer), and material_set has the
+	// texture, see DescriptorSets.h
+	bool use_frequency_sets;
+	VkDescriptorSetLayout frequency_layouts[DESCRIPTOR_SET_COUNT];
+	VkDescriptorSet material_set;
 	VkPipelineCache pipelineCache;
+	// With dynamic rendering, there is no render pass and there are no
+	// framebuffers, record_render_pass begins rendering straight on the
+	// image views, and the frame graph does the layout transitions
+	bool use_dynamic_rendering;
 	VkRenderPass render_pass;
 	VkPipeline pipeline;
 
+	// the variant of the fragment shader that the pipeline uses
+	ShaderConstants shader_constants;
+
+	// With async pipelines, we draw with a pipeline that was made
+	// without optimizations, until the pipeline compiler is done with
+	// the optimized one (pipeline_future), see update_pipeline
+	bool use_async_pipelines;
+	PipelineCompiler* pipeline_compiler;
+	std::shared_future<VkPipeline> pipeline_future;
+	bool pipeline_pending;
+
+	// new pipelines are derivatives of the ones they replace
+	bool use_pipeline_derivatives;
+
+	// With pipeline libraries (VK_EXT_graphics_pipeline_library), every
+	// pipeline is linked from four parts, and each part is only compiled
+	// once, see PipelineLibrary. Without them, we use derivatives
+	bool use_pipeline_library;
+	PipelineLibrary* pipeline_library;
+
+	// With the prewarm, every pipeline that the other options could
+	// ask for is made when the pipeline cache was not loaded (the first
+	// run, or a new driver), so turning them on later compiles nothing.
+	// "-prewarm" does the same, saves the cache, and quits
+	bool use_pipeline_prewarm;
+	bool pipeline_cache_valid;
+
+	// If this is true, the shaders are compiled from their GLSL
+	// files when the program starts (or read from the shader cache),
+	// instead of using the .inc files, see prepare_pipeline
+	bool use_runtime_shaders;
+	ShaderCompiler* shader_compiler;
+
+	// With hot reload, the GLSL files of the pipeline are checked
+	// every SHADER_RELOAD_INTERVAL frames, and the pipeline is rebuilt
+	// when one of them is saved, see reload_shaders
+	bool use_shader_hot_reload;
+	const char* vs_source_name;
+	const char* fs_source_name;
+	uint64_t vs_write_time;
+	uint64_t fs_write_time;
+
+	// The camera keeps its view and projection until it moves, or
+	// the window is resized. projection_matrix and view_projection
+	// are the ones of this frame, with the temporal jitter
+	Camera camera;
 	glm::mat4x4 projection_matrix;
 	glm::mat4x4 view_matrix;
+	glm::mat4x4 view_projection;
 	glm::mat4x4 model_matrix;
 
-	BufferCPU* matrixBufferCPU;
+	// one uniform buffer, cut into frame_lag slices,
+	// so that each frame in flight has its own matrices
+	BufferCPU matrixBufferCPU;
+	uint32_t uniform_slice_size;
+
+	// every cube gets its own matrix from the rest of
+	// its frame's slice, at its own dynamic offset
+	bool use_uniform_arena;
+	UniformArena* uniform_arena;
 	VkDescriptorSet descriptor_set;
-	VkDescriptorPool desc_pool;
+	DescriptorAllocator* descriptor_allocator;
+
+	// With an update template, all descriptors of a set are written from
+	// one DescriptorSetData, with one call. With push descriptors, there is
+	// no descriptor set at all, each command buffer gets the descriptors of
+	// its frame_index (descriptor_data[slot]) written straight into it
+	bool update_template_enabled;
+	bool use_push_descriptors;
+	VkDescriptorUpdateTemplateKHR descriptor_template;
+	std::vector<DescriptorSetData> descriptor_data;
+
+	// The layers that were asked for, on the command line or in the
+	// VKCUBE_LAYERS environment variable (see LAYER_VALIDATION).
+	// validate is true if LAYER_VALIDATION is one of them
+	uint32_t layer_flags;
 
+	// With "-fps N" on the command line, the render thread waits
+	// here before each frame, so there are at most N frames every
+	// second (see RenderLoop). The benchmark is never limited
+	FrameLimiter* frame_limiter;
 	bool validate;
 
+	// true if the MVP matrix is given with push constants,
+	// rather than the uniform buffer
+	bool use_push_constants;
+
+	// every cube in the scene has a position in the grid,
+	// and an MVP matrix, which is given with push constants.
+	// The MVPs are made by TransformBatch, from the transforms
+	uint32_t scene_object_count;
+	TransformArrays object_transforms;
+
+	// With the scene generator, the scene is made from scene_params
+	// (see SceneGenerator.h) instead of the grid. Its meshes are in the
+	// mesh pool after the cube, and its textures are bindless textures
+	bool use_scene_generator;
+	SceneParams scene_params;
+
+	// "-stress N" turns the scene generator on, with N objects,
+	// so scripts can benchmark both scenes, zero keeps the config
+	uint32_t stress_objects;
+	SceneGenerator* scene_generator;
+	std::vector<MeshRange> scene_meshes;
+
+	// With the scene snapshot, the generated scene (and the instances)
+	// is saved into scene_snapshot_path, and the next runs map that file
+	// instead of making the scene again, see SceneFile.h. scene_snapshot
+	// is the file that was loaded, until prepare is done with it
+	bool use_scene_snapshot;
+	const char* scene_snapshot_path;
+	SceneFile* scene_snapshot;
+	std::vector<TextureGPU*> scene_textures;
+
+	// With texture arrays, the generated textures are packed into
+	// layers of one texture array when they are made (see TexturePacker),
+	// instead of one image each, and each object pushes its layer
+	bool use_texture_arrays;
+	TexturePacker* texture_packer;
+
+	// With the voxel world, terrain made of blocks is drawn under the
+	// cubes, from chunks that are meshed on the JobSystem (see
+	// VoxelWorld.h). voxel_model puts the blocks into the scene, and
+	// voxel_draws are the chunks that pass the frustum test this frame.
+	// With streaming, the world moves under the camera at voxel_fly_speed
+	// blocks every second, and voxel_center is the camera, in blocks
+	bool use_voxel_world;
+	bool use_voxel_streaming;
+	VoxelParams voxel_params;
+	VoxelWorld* voxel_world;
+	glm::mat4x4 voxel_model;
+	float voxel_fly_speed;
+	glm::vec3 voxel_center;
+	std::vector<VoxelDraw> voxel_draws;
+	std::vector<glm::mat4x4> object_mvps;
+
+	// The shadow map of the sun, see ShadowCache.h. shadow_mvps are the
+	// matrices of every object as the light sees it, and the objects with
+	// shadow_dynamic set are drawn every frame, the others are static
+	bool use_shadow_cache;
+	ShadowCache* shadow_cache;
+	glm::mat4x4 shadow_matrix;
+	std::vector<glm::mat4x4> shadow_mvps;
+	std::vector<uint8_t> shadow_dynamic;
+	std::vector<ShadowCaster> shadow_static_casters;
+	std::vector<ShadowCaster> shadow_dynamic_casters;
+
+	// the level of detail that each cube is drawn with, and the
+	// radius of one cube (smaller with instancing), see select_lod
+	std::vector<uint32_t> object_lods;
+	float lod_object_radius;
+
+	// With meshlets, every level of detail is drawn as the meshlets
+	// that are visible, see cull_meshlets. The meshlets of each cube
+	// that pass are merged into draws, which are written to this frame's
+	// slice of meshlet_draws_cpu, and each cube draws them with one
+	// vkCmdDrawIndexedIndirect (or one for each draw, without
+	// multiDrawIndirect). object_models is for the camera position in
+	// the space of each cube, which the cone test needs
+	bool use_meshlets;
+	bool meshlet_multi_draw;
+	std::vector<Meshlet> mesh_meshlets;
+	std::vector<glm::mat4x4> object_models;
+	std::vector<uint32_t> object_meshlet_first;
+	std::vector<uint32_t> object_meshlet_count;
+	std::vector<VkDrawIndexedIndirectCommand> meshlet_draws;
+	BufferCPU meshlet_draws_cpu;
+	uint32_t meshlet_slice_draws;
+	uint32_t meshlets_tested;
+	uint32_t meshlets_culled;
+
+	// With bindless textures, every texture is in one big array
+	// of descriptors, and each cube picks its texture from the array
+	// with an index, see prepare_bindless_textures
+	bool use_bindless_textures;
+	std::vector<TextureGPU*> bindless_textures;
+	std::vector<uint32_t> object_textures;
+
+	// With half precision, the fragment shaders that have a 16-bit
+	// variant (cube_half.frag and post_half.frag) use it, which needs
+	// shaderFloat16 from VK_KHR_shader_float16_int8
+	bool use_half_precision;
+
+	// With texture transcoding, the texture is made from the PNG file,
+	// in the best compressed format of this GPU, when it is loaded,
+	// instead of one KTX2 file for each format, see TextureTranscoder.h
+	bool use_texture_transcoding;
+
+	// every cube of the scene can be drawn many times,
+	// in one draw call, with instancing
+	uint32_t instance_count;
+	bool use_instancing;
+
+	// The model matrix of every instance comes from instance_transforms.
+	// Without dynamic instances, the matrices are uploaded once, to
+	// instanceDataGPU. With dynamic instances, some of them change every
+	// frame, and only those are written to this frame's slice of
+	// instanceDataCPU, which the GPU reads directly, see update_instances
+	bool use_dynamic_instances;
+
+	// With instance deltas, the dynamic instances are in instanceDataGPU
+	// too, and only the matrices that changed are sent, with the index of
+	// their instance, which instance_scatter copies into place on the GPU
+	bool use_instance_deltas;
+	InstanceScatter* instance_scatter;
+
+	// With GPU animation, every instance spins around its own axis, at
+	// its own speed, which are in animationDataGPU (one vec4 each, read
+	// at binding 2), uploaded once. cube_animated.vert turns the cube
+	// with the time in the uniform buffer, the seconds since
+	// animation_start, so the CPU only writes the time in every frame
+	bool use_gpu_animation;
+	BufferGPU animationDataGPU;
+	CpuClock::time_point animation_start;
+
+	// With GPU particles, particle_system emits, moves, and draws up to
+	// particle_capacity particles, without the CPU, see ParticleSystem.h.
+	// particle_emit_rate particles are born every second, the fraction
+	// of a particle that is left over waits for the next frame
+	bool use_gpu_particles;
+	uint32_t particle_capacity;
+	float particle_emit_rate;
+	double particle_emit_accumulator;
+	CpuClock::time_point particle_time;
+	ParticleSystem* particle_system;
+
+	// With compute skinning, skinning_pass bends the vertices of the
+	// cube in the mesh pool once in every frame, with two bones, and
+	// every pass draws the bent cube from the pool, see SkinningPass.h
+	bool use_compute_skinning;
+	SkinningPass* skinning_pass;
+
+	// With GPU picking, a click draws the objects again into a tiny
+	// image of object IDs, around the mouse, and object_picker reads
+	// the ID a few frames later, without waiting, see ObjectPicker.h.
+	// pick_draws is the list of draws of the frame that picks
+	bool use_gpu_picking;
+	ObjectPicker* object_picker;
+	std::vector<PickDraw> pick_draws;
+
+	// With the fixed timestep, the cubes do not move by a fixed amount
+	// in every frame, they move in steps of SIMULATION_STEP seconds. Every
+	// frame takes as many steps as the time since the last frame covers,
+	// and draws the state between the last two steps, by how far it is
+	// into the next step (simulation_alpha), so the cubes move at the same
+	// speed, and smoothly, however fast or slow the frames are drawn
+	bool use_fixed_timestep;
+	CpuClock::time_point simulation_time;
+	double simulation_accumulator;
+	float simulation_alpha;
+	uint64_t simulation_steps;
+	float spin_angle;
+	float previous_spin_angle;
+
+	// Space stops and starts the animation, the
+	// GPU animation time does not move while it is paused
+	bool animation_paused;
+	CpuClock::time_point pause_start;
+
+	// With render on demand, a frame is only drawn when something
+	// changed since the last one: the window (resize, present mode,
+	// shown again), the shaders, or the scene, which changes in every
+	// frame while the animation is running. The camera never moves.
+	// Otherwise draw() is skipped, and the last image stays on the
+	// screen. redraw_frames is how many frames are still needed
+	bool use_render_on_demand;
+	uint32_t redraw_frames;
+
+	// With incremental present, every present says which part of the
+	// main swapchain image changed since the last present (the cubes of
+	// this frame and of the last one, see find_dirty_rect), so the
+	// compositor only copies that part. previous_dirty_rect is not valid
+	// after the swapchain is made, then the whole image is new
+	bool use_incremental_present;
+	VkRectLayerKHR previous_dirty_rect;
+	bool previous_dirty_rect_valid;
+
+	// With device-local host buffers, the uniform buffer and the dynamic
+	// instance buffer are in VRAM that the CPU can write (resizable BAR)
+	bool use_device_local_host_buffers;
+
+	// With cached staging, the Uploader's staging ring is in HOST_CACHED
+	// memory, which is flushed after every write (see MemoryAllocator::Flush)
+	bool use_cached_staging;
+
+	// With an upload budget, texture streaming and the voxel meshes
+	// only start as many copies in a frame as the transfer queue does in
+	// upload_budget_ms (timed with timestamps), and at most
+	// upload_budget_copies of them, the rest waits, see Uploader::TakeBudget
+	bool use_upload_budget;
+	double upload_budget_ms;
+	uint32_t upload_budget_copies;
+
+	// With frame capture, every capture_interval frames, the swapchain
+	// image is copied into frame_capture, and saved frame_lag frames later
+	bool use_frame_capture;
+	uint32_t capture_interval;
+	FrameCapture* frame_capture;
+
+	// With encoder output, the final image of every frame is blitted into
+	// device memory that a hardware encoder in another process opened,
+	// see EncoderBridge.h. encode_number is the number of the image that
+	// the submit of this frame signals, 0 if the frame was dropped
+	bool use_encoder_output;
+	EncoderBridge* encoder_bridge;
+	uint64_t encode_number;
+
+	// With the HUD, the frame times, the present mode, the draws, and
+	// the memory are drawn in the corner of the window, every frame
+	bool use_hud;
+	HudOverlay* hud;
+
+	// With the metrics export, the frame times, the presents, and
+	// the memory of every interval are sent to a StatsD server
+	bool use_metrics_export;
+	const char* metrics_host;
+	uint16_t metrics_port;
+	uint32_t metrics_interval_ms;
+	MetricsExporter* metrics_exporter;
+
+	// With the telemetry channel, the numbers of every frame are
+	// written into a ring in shared memory, for monitors on this
+	// machine that can not use a socket (see TelemetryChannel.h)
+	bool use_telemetry_channel;
+	const char* telemetry_channel_name;
+	TelemetryChannel* telemetry_channel;
+
+	// With the trace capture, trace_frames frames of CPU markers and GPU
+	// timestamps are written to TRACE_FILE, at trace_start_frame, and
+	// every time T is pressed. With VK_EXT_calibrated_timestamps, the
+	// GPU times are on the same clock as the CPU (see TraceCapture.h)
+	bool use_trace_capture;
+	bool calibrated_timestamps_enabled;
+	uint64_t trace_start_frame;
+	uint32_t trace_frames;
+	TraceCapture* trace_capture;
+
+	// With the spike detector, a frame that takes longer than
+	// spike_threshold_ms, or spike_median_multiple times the median
+	// of the frames before it, is written to SPIKE_LOG_FILE, with
+	// what the last frames did (see SpikeDetector.h)
+	bool use_spike_detector;
+	double spike_threshold_ms;
+	double spike_median_multiple;
+	SpikeDetector* spike_detector;
+	TransformStore* instance_transforms;
+	BufferCPU instanceDataCPU;
+	uint32_t instance_spin_first;
+
+	// With the instance hierarchy, every layer of the block of instances
+	// is a parent, and its instances are its children, so turning a
+	// layer turns all of its instances, see prepare_instances
+	bool use_instance_hierarchy;
+	TransformHierarchy* instance_hierarchy;
+
+	// With CPU culling, only the instances that are in the view
+	// frustum are written to the instance buffer, one after the
+	// other, and only visible_instance_count instances are drawn
+	bool use_cpu_culling;
+	std::vector<uint32_t> visible_instances;
+	uint32_t visible_instance_count;
+
+	// the instances are culled and drawn by the GPU
+	bool use_gpu_culling;
+	bool draw_indirect_count_supported;
+	CullingPass* culler;
+
+	// With occlusion culling, the culling pass also tests the
+	// instances against the depth pyramid of the last frame, which
+	// hiz_pass makes from the depth buffer at the start of every frame
+	bool use_occlusion_culling;
+	HiZPass* hiz_pass;
+	HiZPyramid* hiz_pyramid;
+
+	// The passes of every frame, and what they read and write, the
+	// graph records the barriers between them (see FrameGraph.cpp).
+	// These are the resources that more than one pass uses
+	FrameGraph* frame_graph;
+	uint32_t graph_depth;
+	uint32_t graph_pyramid;
+	uint32_t graph_draws;
+	uint32_t graph_counts;
+	uint32_t graph_occlusion;
+	uint32_t graph_particle_counters;
+	uint32_t graph_particle_instances;
+	uint32_t graph_mesh_vertices;
+	uint32_t graph_mesh_positions;
+	uint32_t graph_instances;
+	uint32_t graph_offscreen;
+	uint32_t graph_swapchain;
+	uint32_t graph_msaa;
+	uint32_t graph_shading_rate;
+	uint32_t graph_predicates;
+	uint32_t graph_history[2];
+
 	VkShaderModule vert_shader_module;
 	VkShaderModule frag_shader_module;
 
@@ -151,38 +1297,141 @@ public:
 	void prepare_console();
 	void prepare_window();
 	void prepare_instance();
+	static uint64_t score_physical_device(VkPhysicalDevice physical_device, bool needsSwapchain);
 	void prepare_physical_device();
 	void prepare_instance_functionPointers();
 	void prepare_surface();
 	void prepare_device_queue();
 	void prepare_device_functionPointers();
 	void prepare_synchronization();
+	uint64_t get_completed_frames();
+	void wait_for_frames(uint64_t count);
 	void prepare_swapchain();
-	void prepare_init_cmd();
-	void begin_init_cmd();
+	void prepare_headless_images();
 	void prepare_uniform_buffer();
 	void prepare_sampler();
+	bool prepare_compressed_texture();
+	bool prepare_transcoded_texture();
 	void prepare_textures();
+	bool prepare_shared_texture();
+	void prepare_encoder_output();
+	TextureGPU* create_logo_texture(TextureLoader* loader);
+	TextureGPU* create_placeholder_texture();
+	void update_placeholder_texture(uint32_t slot);
+	void update_video_texture(uint32_t slot);
+	void prepare_bindless_textures();
+	void prepare_scene_textures();
+	void add_host_transfer_usage(VkImageCreateInfo* info);
+	void prepare_texture_arrays();
+	void prepare_voxel_world();
 	void prepare_descriptor_layout();
 	void prepare_descriptor_pool();
 	void prepare_descriptor_set();
+	void prepare_descriptor_template(VkDescriptorUpdateTemplateTypeKHR type);
+	std::vector<char> build_cube_mesh();
 	void prepare_vb_ib();
+	void prepare_occlusion_box(const MeshFile& mesh);
+	void prepare_skinning(const MeshFile& mesh);
+	void prepare_scene();
+	void prepare_instances();
+	void save_scene_snapshot();
+	void prepare_animation();
+	uint32_t select_lod(uint32_t object);
+	VkExtent2D select_shading_rate(uint32_t lod);
+	void request_texture_levels();
+	void update_streamed_descriptors(uint32_t slot);
+	void write_frame_descriptors(uint32_t slot, uint32_t generation);
+	VkFormat select_depth_format();
 	void prepare_depth_buffer();
-	void execute_init_cmd();
+	VkSampleCountFlagBits select_msaa_samples();
+	void prepare_msaa_target();
+	void prepare_scene_color();
+	void prepare_offscreen_target();
+	void update_render_size();
+	void record_upscale(VkCommandBuffer cmd, uint32_t image);
+	void record_temporal(VkCommandBuffer cmd);
 	void prepare_render_pass();
-	void prepare_pipeline();
+	void prepare_pipeline_cache();
+	void save_pipeline_cache();
+	void select_shader_sources();
+	void prepare_pipeline(VkPipeline basePipeline = VK_NULL_HANDLE);
+	VkPipelineLayout create_pipeline_layout(bool pushMatrix, bool pullVertices);
+	PipelineVariant get_pipeline_variant(bool depthOnly);
+	VkPipeline create_pipeline(VkPipelineCreateFlags flags, VkPipeline basePipeline, bool depthOnly = false, bool boxes = false, const PipelineVariant* variant = nullptr);
+	void prewarm_pipeline_cache();
+	void prepare_depth_prepass();
+	void prepare_shadow_cache();
+	void update_shadow_casters();
+	ShadowCaster get_shadow_caster(uint32_t object);
+	void prepare_object_picker();
+	void update_pick_draws();
+	void read_pick(uint32_t slot);
+	void update_pipeline();
+	void discard_pending_pipeline();
+	void forget_pipeline_parts(uint64_t handle);
+	void reload_shaders();
 	void prepare_framebuffers();
-	void build_swapchain_cmds();
+	void prepare_frame_cmds();
+	void record_cmd(uint32_t image, uint32_t slot);
+	void record_compute_cmd(uint32_t slot);
+	void save_capture(uint32_t slot);
+	void record_hud(VkCommandBuffer cmd, uint32_t slot, uint32_t image);
+	void export_metrics();
+	void publish_telemetry();
+	void check_spike();
+	void record_render_pass(VkCommandBuffer cmd, const VkRenderPassBeginInfo& rp_begin, uint32_t image, uint32_t slot);
+	void record_draws(VkCommandBuffer cmd, uint32_t slot, uint32_t first, uint32_t count, bool depthOnly = false);
 	void prepare();
 
 
 	void delete_resolution_dependencies();
-	void resize();
+	void retire_resolution_dependencies();
+	void retire_swapchain(VkSwapchainKHR old);
+	static const char* present_mode_name(VkPresentModeKHR mode);
+	void set_present_mode(VkPresentModeKHR mode);
+	void cycle_present_mode();
+	void acquire_full_screen_exclusive();
+	void run_frame_work(uint32_t work);
+	VkResult acquire_next_image(uint64_t timeout);
+	void toggle_animation();
+	void dig_voxel_world();
+
+	// x and y are a pixel of the window, the
+	// object there is printed a few frames later
+	void pick_object(uint32_t x, uint32_t y);
+	void request_redraw();
+	bool needs_redraw();
+	void sleep_for_latency();
+	void mark_latency(LatencyMarker marker);
+
+	// prints how much memory each heap uses (the M key)
+	void print_memory_report();
+
+	// records the next trace_frames frames into TRACE_FILE (the T key)
+	void start_trace();
+	void resize(bool force = false);
 	void update_uniform_buffer();
+	void update_instances();
+	void move_instances(uint64_t step);
+	void update_simulation();
+	VkRectLayerKHR find_dirty_rect();
+	void step_simulation();
+	void build_render_queue();
+	void cull_meshlets();
+	void update_occlusion_queries();
+	void record_voxel_draws(VkCommandBuffer cmd, CommandState& state);
+	void record_particle_draws(VkCommandBuffer cmd, CommandState& state);
+	void record_occlusion_boxes(VkCommandBuffer cmd, CommandState& state);
+	void update_target_IPD();
 	void draw();
+	void end_frame();
 	void run();
+	void finish_benchmark();
+	void run_microbenchmarks();
+	void tune_settings(VkPhysicalDeviceProperties properties);
+	void apply_tuned_settings(const TunedSettings& settings);
 
-	Demo();
+	Demo(uint32_t benchmarkFrames = 0, VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR, uint32_t frameLag = 0, uint32_t layerFlags = 0, uint32_t targetFps = 0, uint32_t windowMode = WINDOW_MODE_WINDOWED, const TunedSettings* candidate = nullptr, bool retune = false, uint32_t stressObjects = 0, DeviceContext* deviceContext = nullptr);
 	~Demo();
 };
 
@@ -0,0 +1,292 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "DescriptorAllocator.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+
+// Before the allocator, prepare_descriptor_pool made one pool that had
+// room for exactly one set. A scene where sets are made while it runs
+// would need to guess how big the pool should be, and would fail once
+// the guess was too small.
+
+// The allocator makes pools for DESCRIPTOR_SETS_PER_POOL sets at a time,
+// and when one is full, it makes another one. Sets are never freed one
+// at a time, so a pool can never have holes in it (fragmentation), and
+// allocating a set is always just taking the next one from the last pool.
+
+// Sets that are only needed for one frame come from the pools of that
+// frame_index, which are all reset with vkResetDescriptorPool when we come
+// back to that frame_index, which gives all of their sets back at once.
+
+// GetSet keeps every set that it makes, by layout and by the descriptors
+// that were written into it, so that asking for the same set again does not
+// allocate or write anything
+
+bool DescriptorBindingKey::operator==(const DescriptorBindingKey& other) const
+{
+	return binding == other.binding &&
+		arrayElement == other.arrayElement &&
+		type == other.type &&
+		buffer == other.buffer &&
+		offset == other.offset &&
+		range == other.range &&
+		sampler == other.sampler &&
+		imageView == other.imageView &&
+		imageLayout == other.imageLayout;
+}
+
+bool DescriptorSetKey::operator==(const DescriptorSetKey& other) const
+{
+	return layout == other.layout && bindings == other.bindings;
+}
+
+// FNV-1a, one 64-bit value at a time
+static void HashValue(uint64_t* hash, uint64_t value)
+{
+	*hash ^= value;
+	*hash *= 1099511628211ull;
+}
+
+size_t DescriptorSetKeyHash::operator()(const DescriptorSetKey& key) const
+{
+	uint64_t hash = 14695981039346656037ull;
+	HashValue(&hash, (uint64_t)key.layout);
+
+	for (const DescriptorBindingKey& b : key.bindings)
+	{
+		HashValue(&hash, ((uint64_t)b.binding << 32) | b.arrayElement);
+		HashValue(&hash, (uint64_t)b.type);
+		HashValue(&hash, (uint64_t)b.buffer);
+		HashValue(&hash, (uint64_t)b.offset);
+		HashValue(&hash, (uint64_t)b.range);
+		HashValue(&hash, (uint64_t)b.sampler);
+		HashValue(&hash, (uint64_t)b.imageView);
+		HashValue(&hash, (uint64_t)b.imageLayout);
+	}
+
+	return (size_t)hash;
+}
+
+DescriptorAllocator::DescriptorAllocator(
+	VkDevice d,
+	const VkDescriptorPoolSize* sizes, uint32_t sizeCount,
+	uint32_t frameCount,
+	uint32_t sets,
+	VkDescriptorPoolCreateFlags flags)
+{
+	device = d;
+	setSizes.assign(sizes, sizes + sizeCount);
+	setsPerPool = sets;
+	poolFlags = flags;
+
+	frames.resize(frameCount);
+	for (DescriptorFramePools& frame : frames)
+		frame.current = 0;
+
+	frameIndex = 0;
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+	// destroying a pool also destroys every set in it,
+	// including the sets in the cache
+	for (VkDescriptorPool pool : pools)
+		vkDestroyDescriptorPool(device, pool, HostAllocator::callbacks);
+
+	for (DescriptorFramePools& frame : frames)
+		for (VkDescriptorPool pool : frame.pools)
+			vkDestroyDescriptorPool(device, pool, HostAllocator::callbacks);
+}
+
+VkDescriptorPool DescriptorAllocator::CreatePool()
+{
+	// room for setsPerPool sets, with the
+	// descriptors that one set needs
+	std::vector<VkDescriptorPoolSize> poolSizes = setSizes;
+	for (VkDescriptorPoolSize& size : poolSizes)
+		size.descriptorCount *= setsPerPool;
+
+	VkDescriptorPoolCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	info.flags = poolFlags;
+	info.maxSets = setsPerPool;
+	info.poolSizeCount = (uint32_t)poolSizes.size();
+	info.pPoolSizes = poolSizes.data();
+
+	VkDescriptorPool pool;
+	VkResult err = vkCreateDescriptorPool(device, &info, HostAllocator::callbacks, &pool);
+
+	if (err != VK_SUCCESS)
+		ERR_EXIT("vkCreateDescriptorPool failed", "Descriptor Allocator Failure");
+
+	return pool;
+}
+
+bool DescriptorAllocator::AllocateFromPool(VkDescriptorPool pool, VkDescriptorSetLayout layout, VkDescriptorSet* set)
+{
+	VkDescriptorSetAllocateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	info.descriptorPool = pool;
+	info.descriptorSetCount = 1;
+	info.pSetLayouts = &layout;
+
+	// A full pool says OUT_OF_POOL_MEMORY, or FRAGMENTED_POOL,
+	// either way, the set has to come from another pool
+	VkResult err = DeviceTable::AllocateDescriptorSets(device, &info, set);
+
+	if (err == VK_ERROR_OUT_OF_POOL_MEMORY || err == VK_ERROR_FRAGMENTED_POOL)
+		return false;
+
+	if (err != VK_SUCCESS)
+		ERR_EXIT("vkAllocateDescriptorSets failed", "Descriptor Allocator Failure");
+
+	return true;
+}
+
+VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+	VkDescriptorSet set = VK_NULL_HANDLE;
+
+	// Only the last pool can have room in it, every
+	// pool before it was full when it was made
+	if (!pools.empty() && AllocateFromPool(pools.back(), layout, &set))
+		return set;
+
+	pools.push_back(CreatePool());
+
+	// A new pool that can not fit one set means that the
+	// sizes given to the constructor are too small for this layout
+	if (!AllocateFromPool(pools.back(), layout, &set))
+		ERR_EXIT("A descriptor set does not fit in an empty pool", "Descriptor Allocator Failure");
+
+	return set;
+}
+
+VkDescriptorSet DescriptorAllocator::AllocateFrame(VkDescriptorSetLayout layout)
+{
+	DescriptorFramePools& frame = frames[frameIndex];
+	VkDescriptorSet set = VK_NULL_HANDLE;
+
+	// The pools of a frame are kept after they are reset,
+	// so after the first few frames, no pools are made anymore
+	while (frame.current < frame.pools.size())
+	{
+		if (AllocateFromPool(frame.pools[frame.current], layout, &set))
+			return set;
+
+		frame.current++;
+	}
+
+	frame.pools.push_back(CreatePool());
+
+	if (!AllocateFromPool(frame.pools[frame.current], layout, &set))
+		ERR_EXIT("A descriptor set does not fit in an empty pool", "Descriptor Allocator Failure");
+
+	return set;
+}
+
+VkDescriptorSet DescriptorAllocator::GetSet(VkDescriptorSetLayout layout, const VkWriteDescriptorSet* writes, uint32_t writeCount)
+{
+	// The key is the layout, and every descriptor that is written.
+	// One write can have an array of descriptors, each one
+	// of them is a separate part of the key
+	DescriptorSetKey key = {};
+	key.layout = layout;
+
+	for (uint32_t i = 0; i < writeCount; i++)
+	{
+		for (uint32_t j = 0; j < writes[i].descriptorCount; j++)
+		{
+			DescriptorBindingKey b = {};
+			b.binding = writes[i].dstBinding;
+			b.arrayElement = writes[i].dstArrayElement + j;
+			b.type = writes[i].descriptorType;
+
+			if (writes[i].pBufferInfo != NULL)
+			{
+				b.buffer = writes[i].pBufferInfo[j].buffer;
+				b.offset = writes[i].pBufferInfo[j].offset;
+				b.range = writes[i].pBufferInfo[j].range;
+			}
+
+			if (writes[i].pImageInfo != NULL)
+			{
+				b.sampler = writes[i].pImageInfo[j].sampler;
+				b.imageView = writes[i].pImageInfo[j].imageView;
+				b.imageLayout = writes[i].pImageInfo[j].imageLayout;
+			}
+
+			key.bindings.push_back(b);
+		}
+	}
+
+	auto found = cache.find(key);
+	if (found != cache.end())
+		return found->second;
+
+	// this is a new set, so allocate it, and write
+	// the descriptors into it, one time
+	VkDescriptorSet set = Allocate(layout);
+
+	std::vector<VkWriteDescriptorSet> setWrites(writes, writes + writeCount);
+	for (VkWriteDescriptorSet& write : setWrites)
+		write.dstSet = set;
+
+	DeviceTable::UpdateDescriptorSets(device, writeCount, setWrites.data(), 0, NULL);
+
+	cache[key] = set;
+	return set;
+}
+
+void DescriptorAllocator::BeginFrame(uint32_t frame)
+{
+	// The GPU is done with the last frame that used this
+	// frame_index, so all of its sets can be given back at once.
+	// Only the pools that were used need to be reset
+	frameIndex = frame;
+	DescriptorFramePools& framePools = frames[frameIndex];
+
+	for (uint32_t i = 0; i < framePools.pools.size() && i <= framePools.current; i++)
+		DeviceTable::ResetDescriptorPool(device, framePools.pools[i], 0);
+
+	framePools.current = 0;
+}
+
+uint32_t DescriptorAllocator::GetPoolCount()
+{
+	uint32_t count = (uint32_t)pools.size();
+
+	for (DescriptorFramePools& frame : frames)
+		count += (uint32_t)frame.pools.size();
+
+	return count;
+}
+
+uint32_t DescriptorAllocator::GetCachedSetCount()
+{
+	return (uint32_t)cache.size();
+}
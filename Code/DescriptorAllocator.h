@@ -0,0 +1,120 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include <unordered_map>
+
+// every pool that the allocator makes has room for this many sets,
+// unless another number is given to the constructor
+#define DESCRIPTOR_SETS_PER_POOL 64
+
+// One descriptor that was written into a cached set. Sets with the
+// same layout, and the same list of these, are the same set
+struct DescriptorBindingKey
+{
+	uint32_t binding;
+	uint32_t arrayElement;
+	VkDescriptorType type;
+
+	// buffer descriptors
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize range;
+
+	// image descriptors
+	VkSampler sampler;
+	VkImageView imageView;
+	VkImageLayout imageLayout;
+
+	bool operator==(const DescriptorBindingKey& other) const;
+};
+
+struct DescriptorSetKey
+{
+	VkDescriptorSetLayout layout;
+	std::vector<DescriptorBindingKey> bindings;
+
+	bool operator==(const DescriptorSetKey& other) const;
+};
+
+struct DescriptorSetKeyHash
+{
+	size_t operator()(const DescriptorSetKey& key) const;
+};
+
+// The pools that one frame_index allocates from. They
+// are all reset when we come back to that frame_index
+struct DescriptorFramePools
+{
+	std::vector<VkDescriptorPool> pools;
+	uint32_t current;
+};
+
+class DescriptorAllocator
+{
+private:
+	VkDevice device;
+
+	// how many descriptors of each type one set needs (on average),
+	// every pool has room for setsPerPool sets of this size
+	std::vector<VkDescriptorPoolSize> setSizes;
+	uint32_t setsPerPool;
+	VkDescriptorPoolCreateFlags poolFlags;
+
+	// pools for sets that stay until the allocator is deleted,
+	// new sets always come from the last one
+	std::vector<VkDescriptorPool> pools;
+
+	// pools for sets that are only used for one frame
+	std::vector<DescriptorFramePools> frames;
+	uint32_t frameIndex;
+
+	// sets that were made by GetSet
+	std::unordered_map<DescriptorSetKey, VkDescriptorSet, DescriptorSetKeyHash> cache;
+
+	VkDescriptorPool CreatePool();
+	bool AllocateFromPool(VkDescriptorPool pool, VkDescriptorSetLayout layout, VkDescriptorSet* set);
+
+public:
+	DescriptorAllocator(
+		VkDevice d,
+		const VkDescriptorPoolSize* sizes, uint32_t sizeCount,
+		uint32_t frameCount,
+		uint32_t sets = DESCRIPTOR_SETS_PER_POOL,
+		VkDescriptorPoolCreateFlags flags = 0);
+	~DescriptorAllocator();
+
+	VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+	VkDescriptorSet AllocateFrame(VkDescriptorSetLayout layout);
+	VkDescriptorSet GetSet(VkDescriptorSetLayout layout, const VkWriteDescriptorSet* writes, uint32_t writeCount);
+
+	void BeginFrame(uint32_t frame);
+
+	uint32_t GetPoolCount();
+	uint32_t GetCachedSetCount();
+};
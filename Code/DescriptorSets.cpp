@@ -0,0 +1,92 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "DescriptorSets.h"
+#include "HostAllocator.h"
+
+// the few parts of the SPIR-V format that are needed here,
+// see the SPIR-V specification (spirv.h has the same numbers)
+#define SPIRV_MAGIC 0x07230203
+#define SPIRV_HEADER_WORDS 5
+#define SPIRV_OP_DECORATE 71
+#define SPIRV_DECORATION_BINDING 33
+#define SPIRV_DECORATION_DESCRIPTOR_SET 34
+
+void DescriptorSets::MoveBinding(std::vector<uint32_t>* spirv, uint32_t binding, uint32_t set)
+{
+	std::vector<uint32_t>& words = *spirv;
+
+	if (words.size() < SPIRV_HEADER_WORDS || words[0] != SPIRV_MAGIC)
+		return;
+
+	// Every instruction starts with one word, that has the number of
+	// words in the instruction at the top, and the opcode at the bottom.
+	// A decoration is: OpDecorate, the id, the decoration, its value.
+	// The first pass finds the ids that are at this binding
+	std::vector<uint32_t> ids;
+
+	for (size_t i = SPIRV_HEADER_WORDS; i < words.size();)
+	{
+		uint32_t count = words[i] >> 16;
+		uint32_t opcode = words[i] & 0xFFFF;
+
+		if (count == 0 || i + count > words.size())
+			return;
+
+		if (opcode == SPIRV_OP_DECORATE && count == 4 &&
+			words[i + 2] == SPIRV_DECORATION_BINDING && words[i + 3] == binding)
+			ids.push_back(words[i + 1]);
+
+		i += count;
+	}
+
+	// the second pass changes the set of those ids, if they are
+	// in set 0, a binding that is already somewhere else stays there
+	for (size_t i = SPIRV_HEADER_WORDS; i < words.size(); i += words[i] >> 16)
+	{
+		uint32_t count = words[i] >> 16;
+		uint32_t opcode = words[i] & 0xFFFF;
+
+		if (opcode != SPIRV_OP_DECORATE || count != 4 ||
+			words[i + 2] != SPIRV_DECORATION_DESCRIPTOR_SET || words[i + 3] != 0)
+			continue;
+
+		for (uint32_t id : ids)
+		{
+			if (words[i + 1] == id)
+				words[i + 3] = set;
+		}
+	}
+}
+
+VkDescriptorSetLayout DescriptorSets::CreateEmptyLayout(VkDevice device)
+{
+	VkDescriptorSetLayoutCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	vkCreateDescriptorSetLayout(device, &info, HostAllocator::callbacks, &layout);
+	return layout;
+}
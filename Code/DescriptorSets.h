@@ -0,0 +1,62 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <stdint.h>
+#include <vector>
+
+// The sets of the pipeline layout, by how often what is in them changes.
+// A draw only binds the sets that are different from the last draw,
+// and binding a set leaves the sets after it alone, as long as the
+// pipeline layout is the same, so what changes the most goes last:
+// - the frame set has the uniform buffer, its slice is picked with
+//   the dynamic offset (every draw with the uniform arena)
+// - the pass set has what one pass reads from the passes before it
+// - the material set has the textures, which change between materials
+// The constants of each object are not in a set, they are push
+// constants (or a dynamic offset into the uniform arena)
+enum DescriptorFrequency
+{
+	DESCRIPTOR_SET_FRAME = 0,
+	DESCRIPTOR_SET_PASS = 1,
+	DESCRIPTOR_SET_MATERIAL = 2,
+	DESCRIPTOR_SET_COUNT = 3
+};
+
+// The shaders of the cube were written with everything in set 0. Instead
+// of a second copy of every shader, the set of each binding is changed
+// in the SPIR-V, before the shader module is made
+class DescriptorSets
+{
+public:
+	// every variable at this binding in set 0 is moved to the set
+	static void MoveBinding(std::vector<uint32_t>* spirv, uint32_t binding, uint32_t set);
+
+	// a layout with no bindings, for a set that the cube does
+	// not use, so that the sets after it keep their numbers
+	static VkDescriptorSetLayout CreateEmptyLayout(VkDevice device);
+};
@@ -0,0 +1,96 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "DeviceContext.h"
+#include "DeviceTable.h"
+#include <algorithm>
+
+InstanceContext::InstanceContext()
+{
+	users = 0;
+	instance = VK_NULL_HANDLE;
+}
+
+bool InstanceContext::Join()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return users++ == 0;
+}
+
+bool InstanceContext::Leave()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return --users == 0;
+}
+
+bool InstanceContext::HasExtension(const char* name)
+{
+	return std::find(extensions.begin(), extensions.end(), name) != extensions.end();
+}
+
+DeviceContext::DeviceContext(InstanceContext* instance, bool isShared, uint32_t gpu)
+{
+	users = 0;
+	instanceContext = instance;
+	shared = isShared;
+	gpuIndex = gpu;
+	this->gpu = VK_NULL_HANDLE;
+	device = VK_NULL_HANDLE;
+	pipelineCache = VK_NULL_HANDLE;
+	allocator = nullptr;
+
+	// the lock is taken from the first submit of the first
+	// Demo on, so that no submit is ever made without it
+	if (shared)
+		QueueLock::Enable();
+}
+
+DeviceContext::~DeviceContext()
+{
+	if (shared)
+		QueueLock::Disable();
+}
+
+bool DeviceContext::Join()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return users++ == 0;
+}
+
+bool DeviceContext::Leave()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return --users == 0;
+}
+
+bool DeviceContext::HasExtension(const char* name)
+{
+	return std::find(extensions.begin(), extensions.end(), name) != extensions.end();
+}
+
+bool DeviceContext::HasQueueFamily(uint32_t family)
+{
+	return std::find(queueFamilies.begin(), queueFamilies.end(), family) != queueFamilies.end();
+}
@@ -0,0 +1,103 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <mutex>
+#include <vector>
+#include <string>
+
+class MemoryAllocator;
+
+// One VkInstance, for every render context (Demo) of the process.
+// The first Demo that joins makes it (see Demo::prepare_instance),
+// the others use it, and the last one that leaves destroys it.
+// The Demos are made one after another, on one thread, and they
+// can draw on many threads after that
+class InstanceContext
+{
+private:
+	std::mutex mutex;
+	uint32_t users;
+
+public:
+	VkInstance instance;
+
+	// what the instance was made with, a Demo that joins
+	// later can not turn on anything that is not in here
+	std::vector<std::string> extensions;
+
+	InstanceContext();
+
+	// returns true for the first one, which makes the instance
+	bool Join();
+
+	// returns true for the last one, which destroys it
+	bool Leave();
+
+	bool HasExtension(const char* name);
+};
+
+// One VkDevice, and everything that is made once for it: the queues,
+// the pipeline cache, and the memory allocator. Like InstanceContext,
+// the first Demo that joins makes them, and the last one destroys them.
+// With shared, more than one Demo uses the device at the same time,
+// which is known before the first one is made (see Main.cpp). Then
+// every submit and present takes QueueLock, because the queues are
+// shared too, and the allocator takes its lock
+class DeviceContext
+{
+private:
+	std::mutex mutex;
+	uint32_t users;
+
+public:
+	InstanceContext* instanceContext;
+	bool shared;
+
+	// the GPU on the list of vkEnumeratePhysicalDevices,
+	// UINT32_MAX picks the best one (see prepare_physical_device)
+	uint32_t gpuIndex;
+
+	VkPhysicalDevice gpu;
+	VkDevice device;
+	VkPipelineCache pipelineCache;
+	MemoryAllocator* allocator;
+
+	// what the device was made with, the same as for the instance
+	std::vector<std::string> extensions;
+	std::vector<uint32_t> queueFamilies;
+
+	DeviceContext(InstanceContext* instance, bool isShared, uint32_t gpu = UINT32_MAX);
+	~DeviceContext();
+
+	// the same as for InstanceContext
+	bool Join();
+	bool Leave();
+
+	bool HasExtension(const char* name);
+	bool HasQueueFamily(uint32_t family);
+};
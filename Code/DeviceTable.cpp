@@ -0,0 +1,119 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "DeviceTable.h"
+
+#define DEVICE_TABLE_DEFINE(name) PFN_vk##name DeviceTable::name = vk##name;
+DEVICE_TABLE_FUNCTIONS(DEVICE_TABLE_DEFINE)
+#undef DEVICE_TABLE_DEFINE
+
+VkDevice DeviceTable::loadedDevice = VK_NULL_HANDLE;
+uint32_t DeviceTable::loadCount = 0;
+bool DeviceTable::manyDevices = false;
+
+void DeviceTable::Load(PFN_vkGetDeviceProcAddr getDeviceProcAddr, VkDevice device)
+{
+	loadCount++;
+
+	// a second Demo that shares the device gets the same functions,
+	// so only the first one fills the table
+	if (device == loadedDevice || manyDevices)
+		return;
+
+	// The functions of one device can not be called with another, the
+	// loader's functions look up the driver of each device every time
+	if (loadedDevice != VK_NULL_HANDLE)
+	{
+		manyDevices = true;
+		Reset();
+		return;
+	}
+
+	loadedDevice = device;
+
+	// Every function in the list is part of Vulkan 1.0, so the
+	// driver always has it. If it still returns NULL, the member
+	// keeps the loader's function, which always works
+#define DEVICE_TABLE_LOAD(name)														\
+	{																				\
+		PFN_vk##name fn = (PFN_vk##name)getDeviceProcAddr(device, "vk" #name);		\
+		if (fn != NULL)																\
+			name = fn;																\
+	}
+
+	DEVICE_TABLE_FUNCTIONS(DEVICE_TABLE_LOAD)
+#undef DEVICE_TABLE_LOAD
+}
+
+void DeviceTable::Unload()
+{
+	if (loadCount > 0)
+		loadCount--;
+
+	// the other Demos are still drawing
+	if (loadCount > 0)
+		return;
+
+	loadedDevice = VK_NULL_HANDLE;
+	manyDevices = false;
+
+	// nothing may call the functions of a destroyed device,
+	// so the table is the same as it was before Load
+	Reset();
+}
+
+void DeviceTable::Reset()
+{
+#define DEVICE_TABLE_UNLOAD(name) name = vk##name;
+	DEVICE_TABLE_FUNCTIONS(DEVICE_TABLE_UNLOAD)
+#undef DEVICE_TABLE_UNLOAD
+}
+
+std::mutex QueueLock::mutex;
+std::atomic<uint32_t> QueueLock::users(0);
+
+void QueueLock::Enable()
+{
+	users++;
+}
+
+void QueueLock::Disable()
+{
+	users--;
+}
+
+QueueLock::QueueLock()
+{
+	locked = users > 0;
+
+	if (locked)
+		mutex.lock();
+}
+
+QueueLock::~QueueLock()
+{
+	if (locked)
+		mutex.unlock();
+}
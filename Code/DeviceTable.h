@@ -0,0 +1,143 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <mutex>
+#include <atomic>
+
+// Every device function that is called every frame. Each one becomes
+// a member of DeviceTable with the same name, without the "vk", so
+// vkCmdDrawIndexed is called as DeviceTable::CmdDrawIndexed. To call
+// another function through the table, add it to this list
+#define DEVICE_TABLE_FUNCTIONS(X) \
+	/* the queues, and waiting for them */ \
+	X(QueueSubmit) \
+	X(QueueBindSparse) \
+	X(WaitForFences) \
+	X(ResetFences) \
+	X(GetFenceStatus) \
+	/* recording command buffers */ \
+	X(BeginCommandBuffer) \
+	X(EndCommandBuffer) \
+	X(ResetCommandBuffer) \
+	X(ResetCommandPool) \
+	/* descriptors, memory, and queries */ \
+	X(AllocateDescriptorSets) \
+	X(ResetDescriptorPool) \
+	X(UpdateDescriptorSets) \
+	X(FlushMappedMemoryRanges) \
+	X(InvalidateMappedMemoryRanges) \
+	X(GetQueryPoolResults) \
+	/* commands */ \
+	X(CmdBeginRenderPass) \
+	X(CmdNextSubpass) \
+	X(CmdEndRenderPass) \
+	X(CmdExecuteCommands) \
+	X(CmdBindPipeline) \
+	X(CmdBindDescriptorSets) \
+	X(CmdPushConstants) \
+	X(CmdBindVertexBuffers) \
+	X(CmdBindIndexBuffer) \
+	X(CmdSetViewport) \
+	X(CmdSetScissor) \
+	X(CmdDraw) \
+	X(CmdDrawIndexed) \
+	X(CmdDrawIndexedIndirect) \
+	X(CmdDispatch) \
+	X(CmdDispatchIndirect) \
+	X(CmdPipelineBarrier) \
+	X(CmdCopyBuffer) \
+	X(CmdCopyImage) \
+	X(CmdCopyBufferToImage) \
+	X(CmdCopyImageToBuffer) \
+	X(CmdBlitImage) \
+	X(CmdFillBuffer) \
+	X(CmdUpdateBuffer) \
+	X(CmdResetQueryPool) \
+	X(CmdBeginQuery) \
+	X(CmdEndQuery) \
+	X(CmdCopyQueryPoolResults) \
+	X(CmdWriteTimestamp)
+
+// The functions that vulkan-1.lib gives us are trampolines in the loader.
+// Every call looks up the dispatch table of the device (through the
+// command buffer, or the queue), and then jumps to the driver. The
+// functions that vkGetDeviceProcAddr returns go straight to the driver,
+// or to the first layer, like the validation layer, so the layers
+// still see every call. Load fills the table once, after vkCreateDevice.
+// Until then, every member is the loader's function, so the table can be
+// used at any time. The table is static, like HostAllocator::callbacks,
+// so it can only go straight to one VkDevice. Every Demo that uses the
+// device loads it (see DeviceContext.h), and when a Demo loads a second
+// device (one for each GPU), the table goes back to the loader's functions
+// for good, because they work with every device
+class DeviceTable
+{
+private:
+	static VkDevice loadedDevice;
+	static uint32_t loadCount;
+	static bool manyDevices;
+
+	// puts the loader's functions back into the table
+	static void Reset();
+
+public:
+#define DEVICE_TABLE_DECLARE(name) static PFN_vk##name name;
+	DEVICE_TABLE_FUNCTIONS(DEVICE_TABLE_DECLARE)
+#undef DEVICE_TABLE_DECLARE
+
+	// gets every function of the list from the device
+	static void Load(PFN_vkGetDeviceProcAddr getDeviceProcAddr, VkDevice device);
+
+	// Goes back to the loader's functions, after the device is destroyed.
+	// Each Load needs an Unload, the table is not reset until the last one
+	static void Unload();
+};
+
+// Vulkan says that only one thread may use a queue at a time. Usually
+// the render thread is the only one, but with the present thread (see
+// PresentThread.h), two threads use the queues, then every QueueSubmit,
+// QueueBindSparse, and present holds this lock, for as long as the call
+// takes. Several Demos that share one device (see DeviceContext.h) use
+// the same queues, from their own threads, which needs the lock too.
+// Everyone who needs it calls Enable, and Disable when they are done,
+// while nobody needs it, the lock is never taken
+class QueueLock
+{
+private:
+	bool locked;
+	static std::atomic<uint32_t> users;
+
+public:
+	static std::mutex mutex;
+
+	static void Enable();
+	static void Disable();
+
+	QueueLock();
+	~QueueLock();
+};
@@ -0,0 +1,112 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+
+// VK_KHR_dynamic_rendering is newer than the Vulkan headers in the
+// Include folder, so we declare the parts that we use, the same way
+// as PresentWait.h. They are skipped when the headers are new enough
+#ifndef VK_KHR_dynamic_rendering
+#define VK_KHR_dynamic_rendering 1
+#define VK_KHR_DYNAMIC_RENDERING_SPEC_VERSION 1
+#define VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME "VK_KHR_dynamic_rendering"
+
+#define VK_STRUCTURE_TYPE_RENDERING_INFO_KHR ((VkStructureType)1000044000)
+#define VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR ((VkStructureType)1000044001)
+#define VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR ((VkStructureType)1000044002)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR ((VkStructureType)1000044003)
+#define VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR ((VkStructureType)1000044004)
+
+typedef VkFlags VkRenderingFlagsKHR;
+
+// the draws are in secondary command buffers, like
+// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+#define VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR ((VkRenderingFlagsKHR)0x00000001)
+#define VK_RENDERING_SUSPENDING_BIT_KHR ((VkRenderingFlagsKHR)0x00000002)
+#define VK_RENDERING_RESUMING_BIT_KHR ((VkRenderingFlagsKHR)0x00000004)
+
+typedef struct VkRenderingAttachmentInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkImageView imageView;
+	VkImageLayout imageLayout;
+	VkResolveModeFlagBitsKHR resolveMode;
+	VkImageView resolveImageView;
+	VkImageLayout resolveImageLayout;
+	VkAttachmentLoadOp loadOp;
+	VkAttachmentStoreOp storeOp;
+	VkClearValue clearValue;
+} VkRenderingAttachmentInfoKHR;
+
+typedef struct VkRenderingInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkRenderingFlagsKHR flags;
+	VkRect2D renderArea;
+	uint32_t layerCount;
+	uint32_t viewMask;
+	uint32_t colorAttachmentCount;
+	const VkRenderingAttachmentInfoKHR* pColorAttachments;
+	const VkRenderingAttachmentInfoKHR* pDepthAttachment;
+	const VkRenderingAttachmentInfoKHR* pStencilAttachment;
+} VkRenderingInfoKHR;
+
+typedef struct VkPipelineRenderingCreateInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	uint32_t viewMask;
+	uint32_t colorAttachmentCount;
+	const VkFormat* pColorAttachmentFormats;
+	VkFormat depthAttachmentFormat;
+	VkFormat stencilAttachmentFormat;
+} VkPipelineRenderingCreateInfoKHR;
+
+typedef struct VkPhysicalDeviceDynamicRenderingFeaturesKHR
+{
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 dynamicRendering;
+} VkPhysicalDeviceDynamicRenderingFeaturesKHR;
+
+typedef struct VkCommandBufferInheritanceRenderingInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkRenderingFlagsKHR flags;
+	uint32_t viewMask;
+	uint32_t colorAttachmentCount;
+	const VkFormat* pColorAttachmentFormats;
+	VkFormat depthAttachmentFormat;
+	VkFormat stencilAttachmentFormat;
+	VkSampleCountFlagBits rasterizationSamples;
+} VkCommandBufferInheritanceRenderingInfoKHR;
+
+typedef void (VKAPI_PTR *PFN_vkCmdBeginRenderingKHR)(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR* pRenderingInfo);
+typedef void (VKAPI_PTR *PFN_vkCmdEndRenderingKHR)(VkCommandBuffer commandBuffer);
+#endif
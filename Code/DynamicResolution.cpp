@@ -0,0 +1,81 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#include "DynamicResolution.h"
+#include <math.h>
+
+// When we are over the target, the scale goes down. When we are
+// under it by more than this, the scale goes up. Between the two,
+// nothing changes, so the resolution does not flicker back and forth
+#define DYNAMIC_RESOLUTION_HEADROOM 0.85
+
+DynamicResolution::DynamicResolution(double target, float min, uint32_t frameLatency)
+{
+	targetMs = target;
+	minScale = min;
+	scale = 1.0f;
+	filteredMs = 0;
+	latency = frameLatency;
+	cooldown = 0;
+}
+
+float DynamicResolution::Update(double gpuMs)
+{
+	if (gpuMs <= 0)
+		return scale;
+
+	// the first time is taken as it is,
+	// later times are averaged into it
+	if (filteredMs == 0)
+		filteredMs = gpuMs;
+	else
+		filteredMs = filteredMs * 0.9 + gpuMs * 0.1;
+
+	if (cooldown > 0)
+	{
+		cooldown--;
+		return scale;
+	}
+
+	if (filteredMs <= targetMs && filteredMs >= targetMs * DYNAMIC_RESOLUTION_HEADROOM)
+		return scale;
+
+	// the number of pixels that fits in the target, and we
+	// only go half of the way there, to not overshoot
+	float ideal = scale * (float)sqrt(targetMs / filteredMs);
+	float next = scale + (ideal - scale) * 0.5f;
+
+	next = (next < minScale) ? minScale : next;
+	next = (next > 1.0f) ? 1.0f : next;
+
+	if (next != scale)
+	{
+		scale = next;
+		cooldown = latency;
+	}
+
+	return scale;
+}
@@ -0,0 +1,62 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#pragma once
+#include <stdint.h>
+
+// Picks the resolution that the scene is drawn at, so that the GPU
+// time of a frame stays close to targetMs. The GPU time of our frame
+// is mostly spent on pixels, so it grows with the number of pixels,
+// which is scale * scale, and the controller moves the scale towards
+// scale * sqrt(targetMs / gpuMs). The GPU times arrive frame_lag frames
+// late, so after every change it waits for the new times to show up,
+// otherwise it would keep changing the scale for the same slow frames
+class DynamicResolution
+{
+private:
+	// the GPU time, smoothed over a few frames, so that one
+	// slow frame does not make the whole image blurry
+	double filteredMs;
+
+	// frames to wait before the scale can change again
+	uint32_t latency;
+	uint32_t cooldown;
+
+public:
+	// the GPU time that we want, in milliseconds
+	double targetMs;
+
+	// the scale of the width and the height,
+	// between minScale and 1 (the window size)
+	float minScale;
+	float scale;
+
+	DynamicResolution(double target, float min, uint32_t frameLatency);
+
+	// called with the GPU time of every frame that was measured,
+	// returns the scale that the next frame should use
+	float Update(double gpuMs);
+};
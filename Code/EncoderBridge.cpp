@@ -0,0 +1,234 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#include "EncoderBridge.h"
+#include "DeviceTable.h"
+#include <stdio.h>
+
+// An encoder needs the pixels in memory that it can read, and the
+// usual way is to copy the image into a CPU buffer, like FrameCapture,
+// and then give the buffer to the encoder, which copies it to the GPU
+// again, because that is where the hardware encoder is. Here, the
+// image stays in device memory, and the encoder opens that memory. The
+// Vulkan headers in the Include folder (1.1.114) have no video encode
+// queue, so the encoding itself is done by the other process
+
+// the names of shared objects are wide strings, like in prepare_shared_texture
+static void MakeName(wchar_t* wideName, size_t count, const char* name, const char* suffix)
+{
+	char full[256];
+	snprintf(full, sizeof(full), "%s%s", name, suffix);
+
+	size_t i = 0;
+
+	for (; full[i] != 0 && i < count - 1; i++)
+		wideName[i] = (wchar_t)full[i];
+
+	wideName[i] = 0;
+}
+
+EncoderBridge::EncoderBridge(
+	VkDevice d,
+	MemoryAllocator* a,
+	const ExternalFunctions* f,
+	PFN_vkGetSemaphoreCounterValueKHR counterValue,
+	uint32_t family,
+	uint32_t slotCount,
+	uint32_t w,
+	uint32_t h,
+	VkFormat fmt,
+	const char* name)
+{
+	device = d;
+	getCounterValue = counterValue;
+	queueFamily = family;
+	width = w;
+	height = h;
+	format = fmt;
+	sent = 0;
+	dropped = 0;
+
+	if (slotCount > ENCODER_BRIDGE_MAX_SLOTS)
+		slotCount = ENCODER_BRIDGE_MAX_SLOTS;
+
+	if (slotCount == 0)
+		slotCount = 1;
+
+	wchar_t wideName[256];
+
+	rendered = new ExternalSemaphore(device, f);
+	MakeName(wideName, 256, name, "_rendered");
+	ready = rendered->Export(wideName, true);
+
+	encoded = new ExternalSemaphore(device, f);
+	MakeName(wideName, 256, name, "_encoded");
+	ready = ready && encoded->Export(wideName, true);
+
+	// The encoder opens every slot with this same create info. It
+	// reads the image, it might copy it too, and the old contents never
+	// matter, because every frame blits over the whole image
+	VkExternalMemoryImageCreateInfoKHR externalInfo = ExternalMemory::GetImageInfo();
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.pNext = &externalInfo;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = format;
+	image_create_info.extent.width = width;
+	image_create_info.extent.height = height;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	slots.resize(slotCount);
+
+	for (uint32_t i = 0; i < slotCount; i++)
+	{
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), "_image_%u", i);
+		MakeName(wideName, 256, name, suffix);
+
+		EncodeSlot& s = slots[i];
+		s.texture = new TextureGPU(device, a, image_create_info, VK_IMAGE_ASPECT_COLOR_BIT, true);
+		s.memory = new ExternalMemory(device, a, f);
+		s.number = 0;
+
+		ready = ready && s.memory->ExportImage(s.texture, wideName);
+		s.texture->SetName("Encoder slot");
+	}
+}
+
+EncoderBridge::~EncoderBridge()
+{
+	// the images are destroyed before their memory
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		delete slots[i].texture;
+		delete slots[i].memory;
+	}
+
+	delete rendered;
+	delete encoded;
+}
+
+bool EncoderBridge::IsReady()
+{
+	return ready;
+}
+
+uint32_t EncoderBridge::Begin(uint64_t* number)
+{
+	uint64_t next = sent + 1;
+	uint32_t slot = (uint32_t)((next - 1) % slots.size());
+	EncodeSlot& s = slots[slot];
+
+	// The encoder signals encoded after it waited for rendered, so
+	// when it is done with the last image of this slot, our blit of that
+	// image is done too. Reading the value never waits for anything
+	if (s.number != 0)
+	{
+		uint64_t done = 0;
+		getCounterValue(device, encoded->semaphore, &done);
+
+		if (done < s.number)
+		{
+			dropped++;
+			return UINT32_MAX;
+		}
+	}
+
+	s.number = next;
+	sent = next;
+	*number = next;
+	return slot;
+}
+
+void EncoderBridge::Record(VkCommandBuffer cmd, uint32_t slot, VkImage source, uint32_t sourceWidth, uint32_t sourceHeight)
+{
+	VkImage image = slots[slot].texture->image;
+
+	// The encoder is done with the slot (see Begin), and the old
+	// contents do not matter, so the image starts UNDEFINED, which
+	// does not need the external queue family to give it back
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, NULL, 0, NULL, 1, &barrier);
+
+	// the window can be any size, the encoder always gets its own size
+	VkImageBlit blit = {};
+	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.srcSubresource.layerCount = 1;
+	blit.srcOffsets[1].x = (int32_t)sourceWidth;
+	blit.srcOffsets[1].y = (int32_t)sourceHeight;
+	blit.srcOffsets[1].z = 1;
+	blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.dstSubresource.layerCount = 1;
+	blit.dstOffsets[1].x = (int32_t)width;
+	blit.dstOffsets[1].y = (int32_t)height;
+	blit.dstOffsets[1].z = 1;
+
+	DeviceTable::CmdBlitImage(cmd,
+		source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &blit, VK_FILTER_LINEAR);
+
+	// The release half of the barrier that gives the image to the
+	// encoder, which acquires it from VK_QUEUE_FAMILY_EXTERNAL in GENERAL
+	// layout, after it waited for rendered (see ExternalMemory::AcquireImage)
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = queueFamily;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL_KHR;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+uint64_t EncoderBridge::GetSentCount()
+{
+	return sent;
+}
+
+uint64_t EncoderBridge::GetDroppedCount()
+{
+	return dropped;
+}
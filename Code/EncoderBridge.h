@@ -0,0 +1,113 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "ExternalMemory.h"
+#include "TimelineSemaphore.h"
+
+// the most images that can wait for the encoder at the same time
+#define ENCODER_BRIDGE_MAX_SLOTS 8
+
+// one image that the encoder reads, in memory that it opened by name
+struct EncodeSlot
+{
+	TextureGPU* texture;
+	ExternalMemory* memory;
+
+	// the number of the last image that was copied in here, 0 if none
+	uint64_t number;
+};
+
+// Gives the final image of each frame to a hardware encoder in another
+// process (an NVENC or AMF bridge), without the pixels ever going
+// through the CPU, which is what FrameCapture does. Every slot is an
+// image in device memory that the encoder opened by its name (see
+// ExternalMemory), and the GPU blits the frame into it, at the size that
+// the encoder wants. Two timeline semaphores are shared too:
+//
+// <name>_rendered: we signal n, when the n'th image is in its slot
+// <name>_encoded: the encoder signals n, when it is done reading it
+//
+// Image n is always in slot (n - 1) % slotCount, so the encoder waits
+// for n on the first semaphore, encodes the slot, and signals n on the
+// second. The encoder works on one image while we draw the next, and
+// when it falls behind, the frames that have no free slot are dropped,
+// the GPU and the CPU never wait for the encoder
+class EncoderBridge
+{
+private:
+	VkDevice device;
+	PFN_vkGetSemaphoreCounterValueKHR getCounterValue;
+	std::vector<EncodeSlot> slots;
+	uint32_t queueFamily;
+	bool ready;
+
+	// the number of the last image that was given to the encoder
+	uint64_t sent;
+	uint64_t dropped;
+
+public:
+	uint32_t width;
+	uint32_t height;
+	VkFormat format;
+
+	ExternalSemaphore* rendered;
+	ExternalSemaphore* encoded;
+
+	// Makes the slots and the semaphores, and exports them with names
+	// that start with name. Check IsReady, exporting can fail
+	EncoderBridge(
+		VkDevice d,
+		MemoryAllocator* a,
+		const ExternalFunctions* f,
+		PFN_vkGetSemaphoreCounterValueKHR counterValue,
+		uint32_t family,
+		uint32_t slotCount,
+		uint32_t w,
+		uint32_t h,
+		VkFormat fmt,
+		const char* name);
+
+	// nothing can be using the slots anymore
+	~EncoderBridge();
+
+	bool IsReady();
+
+	// The slot of the next image, or UINT32_MAX when the encoder is still
+	// reading that slot, and this frame is dropped. number is the value
+	// that the submit of this frame signals on rendered
+	uint32_t Begin(uint64_t* number);
+
+	// Blits the image, which has to be in TRANSFER_SRC_OPTIMAL layout,
+	// into the slot, and gives the slot to the encoder (from the queue
+	// family of the constructor to the external one), in GENERAL layout
+	void Record(VkCommandBuffer cmd, uint32_t slot, VkImage source, uint32_t sourceWidth, uint32_t sourceHeight);
+
+	uint64_t GetSentCount();
+	uint64_t GetDroppedCount();
+};
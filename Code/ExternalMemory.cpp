@@ -0,0 +1,287 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "ExternalMemory.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include "TimelineSemaphore.h"
+
+ExternalMemory::ExternalMemory(VkDevice d, MemoryAllocator* a, const ExternalFunctions* f)
+{
+	device = d;
+	allocator = a;
+	fns = f;
+	memory = VK_NULL_HANDLE;
+	size = 0;
+	handle = NULL;
+}
+
+ExternalMemory::~ExternalMemory()
+{
+	if (handle != NULL)
+		CloseHandle(handle);
+
+	if (memory != VK_NULL_HANDLE)
+		vkFreeMemory(device, memory, HostAllocator::callbacks);
+}
+
+VkExternalMemoryImageCreateInfoKHR ExternalMemory::GetImageInfo()
+{
+	VkExternalMemoryImageCreateInfoKHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO_KHR;
+	info.handleTypes = EXTERNAL_MEMORY_HANDLE_TYPE;
+	return info;
+}
+
+VkExternalMemoryBufferCreateInfoKHR ExternalMemory::GetBufferInfo()
+{
+	VkExternalMemoryBufferCreateInfoKHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO_KHR;
+	info.handleTypes = EXTERNAL_MEMORY_HANDLE_TYPE;
+	return info;
+}
+
+bool ExternalMemory::Allocate(VkMemoryRequirements reqs, VkImage image, VkBuffer buffer, bool exported, HANDLE importHandle, const wchar_t* name)
+{
+	// The memory belongs to this one image (or buffer)
+	VkMemoryDedicatedAllocateInfoKHR dedicatedInfo = {};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+	dedicatedInfo.image = image;
+	dedicatedInfo.buffer = buffer;
+
+	// Exported memory says which handles can be made from it, and
+	// the name that other processes can open it with
+	VkExportMemoryWin32HandleInfoKHR exportNameInfo = {};
+	exportNameInfo.sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_WIN32_HANDLE_INFO_KHR;
+	exportNameInfo.pNext = &dedicatedInfo;
+	exportNameInfo.dwAccess = GENERIC_ALL;
+	exportNameInfo.name = name;
+
+	VkExportMemoryAllocateInfoKHR exportInfo = {};
+	exportInfo.sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO_KHR;
+	exportInfo.pNext = &exportNameInfo;
+	exportInfo.handleTypes = EXTERNAL_MEMORY_HANDLE_TYPE;
+
+	// Imported memory is not allocated, it is the memory that
+	// the handle (or the name) points to. The handle says which
+	// memory types it can be, a name can not be asked
+	VkImportMemoryWin32HandleInfoKHR importInfo = {};
+	importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR;
+	importInfo.pNext = &dedicatedInfo;
+	importInfo.handleType = EXTERNAL_MEMORY_HANDLE_TYPE;
+	importInfo.handle = importHandle;
+	importInfo.name = (importHandle == NULL) ? name : nullptr;
+
+	uint32_t typeBits = reqs.memoryTypeBits;
+
+	if (!exported && importHandle != NULL)
+	{
+		VkMemoryWin32HandlePropertiesKHR handleProperties = {};
+		handleProperties.sType = VK_STRUCTURE_TYPE_MEMORY_WIN32_HANDLE_PROPERTIES_KHR;
+
+		if (fns->getMemoryHandleProperties(device, EXTERNAL_MEMORY_HANDLE_TYPE, importHandle, &handleProperties) != VK_SUCCESS)
+			return false;
+
+		typeBits &= handleProperties.memoryTypeBits;
+	}
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = exported ? (const void*)&exportInfo : (const void*)&importInfo;
+	allocInfo.allocationSize = reqs.size;
+
+	if (!MemoryAllocator::memory_type_from_properties(allocator->GetMemoryProperties(),
+		typeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocInfo.memoryTypeIndex))
+	{
+		return false;
+	}
+
+	if (vkAllocateMemory(device, &allocInfo, HostAllocator::callbacks, &memory) != VK_SUCCESS)
+	{
+		memory = VK_NULL_HANDLE;
+		return false;
+	}
+
+	size = reqs.size;
+
+	if (!exported)
+		return true;
+
+	VkMemoryGetWin32HandleInfoKHR getInfo = {};
+	getInfo.sType = VK_STRUCTURE_TYPE_MEMORY_GET_WIN32_HANDLE_INFO_KHR;
+	getInfo.memory = memory;
+	getInfo.handleType = EXTERNAL_MEMORY_HANDLE_TYPE;
+
+	if (fns->getMemoryHandle(device, &getInfo, &handle) != VK_SUCCESS)
+	{
+		handle = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+bool ExternalMemory::ExportImage(TextureGPU* texture, const wchar_t* name)
+{
+	if (!Allocate(texture->GetRequirements(), texture->image, VK_NULL_HANDLE, true, NULL, name))
+		return false;
+
+	texture->Bind(memory, 0);
+	return true;
+}
+
+bool ExternalMemory::ExportBuffer(BufferGPU* buffer, const wchar_t* name)
+{
+	if (!Allocate(buffer->GetRequirements(), VK_NULL_HANDLE, buffer->buffer, true, NULL, name))
+		return false;
+
+	buffer->Bind(memory, 0);
+	return true;
+}
+
+bool ExternalMemory::ImportImage(TextureGPU* texture, HANDLE importHandle, const wchar_t* name)
+{
+	if (!Allocate(texture->GetRequirements(), texture->image, VK_NULL_HANDLE, false, importHandle, name))
+		return false;
+
+	texture->Bind(memory, 0);
+	return true;
+}
+
+bool ExternalMemory::ImportBuffer(BufferGPU* buffer, HANDLE importHandle, const wchar_t* name)
+{
+	if (!Allocate(buffer->GetRequirements(), VK_NULL_HANDLE, buffer->buffer, false, importHandle, name))
+		return false;
+
+	buffer->Bind(memory, 0);
+	return true;
+}
+
+void ExternalMemory::AcquireImage(VkCommandBuffer cmd, TextureGPU* texture, VkImageLayout oldLayout, uint32_t dstFamily)
+{
+	// the writes of the other process were made
+	// visible by its release, so there is no srcAccessMask
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL_KHR;
+	barrier.dstQueueFamilyIndex = dstFamily;
+	barrier.image = texture->image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = texture->mipLevels;
+	barrier.subresourceRange.layerCount = 1;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+ExternalSemaphore::ExternalSemaphore(VkDevice d, const ExternalFunctions* f)
+{
+	device = d;
+	fns = f;
+	semaphore = VK_NULL_HANDLE;
+	handle = NULL;
+}
+
+ExternalSemaphore::~ExternalSemaphore()
+{
+	if (handle != NULL)
+		CloseHandle(handle);
+
+	if (semaphore != VK_NULL_HANDLE)
+		vkDestroySemaphore(device, semaphore, HostAllocator::callbacks);
+}
+
+bool ExternalSemaphore::Export(const wchar_t* name, bool timeline)
+{
+	VkExportSemaphoreWin32HandleInfoKHR exportNameInfo = {};
+	exportNameInfo.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_WIN32_HANDLE_INFO_KHR;
+	exportNameInfo.dwAccess = GENERIC_ALL;
+	exportNameInfo.name = name;
+
+	VkExportSemaphoreCreateInfoKHR exportInfo = {};
+	exportInfo.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO_KHR;
+	exportInfo.pNext = &exportNameInfo;
+	exportInfo.handleTypes = EXTERNAL_SEMAPHORE_HANDLE_TYPE;
+
+	VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = 0;
+
+	if (timeline)
+		exportNameInfo.pNext = &typeInfo;
+
+	VkSemaphoreCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	createInfo.pNext = &exportInfo;
+
+	if (vkCreateSemaphore(device, &createInfo, HostAllocator::callbacks, &semaphore) != VK_SUCCESS)
+	{
+		semaphore = VK_NULL_HANDLE;
+		return false;
+	}
+
+	VkSemaphoreGetWin32HandleInfoKHR getInfo = {};
+	getInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_WIN32_HANDLE_INFO_KHR;
+	getInfo.semaphore = semaphore;
+	getInfo.handleType = EXTERNAL_SEMAPHORE_HANDLE_TYPE;
+
+	if (fns->getSemaphoreHandle(device, &getInfo, &handle) != VK_SUCCESS)
+	{
+		handle = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+bool ExternalSemaphore::Import(HANDLE importHandle, const wchar_t* name)
+{
+	// the semaphore is made like any other, and then
+	// its payload is replaced with the one of the handle
+	VkSemaphoreCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	if (vkCreateSemaphore(device, &createInfo, HostAllocator::callbacks, &semaphore) != VK_SUCCESS)
+	{
+		semaphore = VK_NULL_HANDLE;
+		return false;
+	}
+
+	VkImportSemaphoreWin32HandleInfoKHR importInfo = {};
+	importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_WIN32_HANDLE_INFO_KHR;
+	importInfo.semaphore = semaphore;
+	importInfo.handleType = EXTERNAL_SEMAPHORE_HANDLE_TYPE;
+	importInfo.handle = importHandle;
+	importInfo.name = (importHandle == NULL) ? name : nullptr;
+
+	return fns->importSemaphoreHandle(device, &importInfo) == VK_SUCCESS;
+}
@@ -0,0 +1,124 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "MemoryAllocator.h"
+#include "TextureGPU.h"
+#include "BufferGPU.h"
+
+// The handles that are shared with other processes are NT handles,
+// which can be duplicated into another process (DuplicateHandle), or
+// opened there by the name that they were exported with
+#define EXTERNAL_MEMORY_HANDLE_TYPE VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT_KHR
+#define EXTERNAL_SEMAPHORE_HANDLE_TYPE VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_BIT_KHR
+
+// the functions of VK_KHR_external_memory_win32
+// and VK_KHR_external_semaphore_win32
+struct ExternalFunctions
+{
+	PFN_vkGetMemoryWin32HandleKHR getMemoryHandle;
+	PFN_vkGetMemoryWin32HandlePropertiesKHR getMemoryHandleProperties;
+	PFN_vkGetSemaphoreWin32HandleKHR getSemaphoreHandle;
+	PFN_vkImportSemaphoreWin32HandleKHR importSemaphoreHandle;
+};
+
+// Memory that another process can see. It is one VkDeviceMemory that
+// is dedicated to one image or buffer (every driver allows that for
+// external memory, and some drivers require it), so it does not come
+// from the blocks of the MemoryAllocator. The image or buffer is made
+// with bindLater, and with the info from GetImageInfo or GetBufferInfo
+// in its pNext, and Export or Import binds it. Both processes have to
+// make the image (or buffer) with the same create info
+class ExternalMemory
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+	const ExternalFunctions* fns;
+
+	bool Allocate(VkMemoryRequirements reqs, VkImage image, VkBuffer buffer, bool exported, HANDLE importHandle, const wchar_t* name);
+
+public:
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+
+	// The handle of exported memory, which this owns, and closes in the
+	// destructor. An imported handle stays with whoever gave it to us,
+	// because importing a Win32 handle does not take it
+	HANDLE handle;
+
+	ExternalMemory(VkDevice d, MemoryAllocator* a, const ExternalFunctions* f);
+
+	// the image or buffer that is bound to it has to be destroyed first
+	~ExternalMemory();
+
+	// goes into the pNext of the VkImageCreateInfo or VkBufferCreateInfo
+	static VkExternalMemoryImageCreateInfoKHR GetImageInfo();
+	static VkExternalMemoryBufferCreateInfoKHR GetBufferInfo();
+
+	// Allocates memory for the texture (or buffer), binds it, and gets the
+	// handle, which can be given to another process. With a name, the other
+	// process can also open it by that name, instead of getting the handle
+	bool ExportImage(TextureGPU* texture, const wchar_t* name = nullptr);
+	bool ExportBuffer(BufferGPU* buffer, const wchar_t* name = nullptr);
+
+	// Binds the texture (or buffer) to memory that another process
+	// exported, either with a handle that was duplicated into this
+	// process, or (with a NULL handle) by the name that it was exported with
+	bool ImportImage(TextureGPU* texture, HANDLE importHandle, const wchar_t* name = nullptr);
+	bool ImportBuffer(BufferGPU* buffer, HANDLE importHandle, const wchar_t* name = nullptr);
+
+	// The other process releases the image to VK_QUEUE_FAMILY_EXTERNAL,
+	// in oldLayout, and this records the other half of that barrier, on
+	// a queue of dstFamily, which leaves it in SHADER_READ_ONLY layout
+	static void AcquireImage(VkCommandBuffer cmd, TextureGPU* texture, VkImageLayout oldLayout, uint32_t dstFamily);
+};
+
+// A binary semaphore that another process can signal or wait on, so that
+// it knows when we are done reading what it wrote, and we know when
+// it is done writing it. Export makes a new one that can be shared,
+// Import makes one that has the payload of the other process
+class ExternalSemaphore
+{
+private:
+	VkDevice device;
+	const ExternalFunctions* fns;
+
+public:
+	VkSemaphore semaphore;
+
+	// the exported handle, which this owns, like ExternalMemory
+	HANDLE handle;
+
+	ExternalSemaphore(VkDevice d, const ExternalFunctions* f);
+	~ExternalSemaphore();
+
+	// A timeline semaphore (see TimelineSemaphore.h) counts up from 0
+	// instead, so both processes can ask how far the other one is
+	bool Export(const wchar_t* name = nullptr, bool timeline = false);
+	bool Import(HANDLE importHandle, const wchar_t* name = nullptr);
+};
@@ -0,0 +1,120 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+
+// VK_KHR_fragment_shading_rate is newer than the Vulkan headers in the
+// Include folder, so we declare the parts that we use, the same way
+// as DynamicRendering.h. They are skipped when the headers are new enough.
+// The image layout, the access, the stage, and the usage are the same
+// values as the ones of VK_NV_shading_rate_image, which the headers have
+#ifndef VK_KHR_fragment_shading_rate
+#define VK_KHR_fragment_shading_rate 1
+#define VK_KHR_FRAGMENT_SHADING_RATE_SPEC_VERSION 2
+#define VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME "VK_KHR_fragment_shading_rate"
+
+#define VK_STRUCTURE_TYPE_FRAGMENT_SHADING_RATE_ATTACHMENT_INFO_KHR ((VkStructureType)1000226000)
+#define VK_STRUCTURE_TYPE_PIPELINE_FRAGMENT_SHADING_RATE_STATE_CREATE_INFO_KHR ((VkStructureType)1000226001)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_PROPERTIES_KHR ((VkStructureType)1000226002)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR ((VkStructureType)1000226003)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_KHR ((VkStructureType)1000226004)
+
+// the attachment of dynamic rendering, from VK_KHR_dynamic_rendering
+#define VK_STRUCTURE_TYPE_RENDERING_FRAGMENT_SHADING_RATE_ATTACHMENT_INFO_KHR ((VkStructureType)1000044006)
+
+#define VK_DYNAMIC_STATE_FRAGMENT_SHADING_RATE_KHR ((VkDynamicState)1000226000)
+#define VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR VK_IMAGE_LAYOUT_SHADING_RATE_OPTIMAL_NV
+#define VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR VK_ACCESS_SHADING_RATE_IMAGE_READ_BIT_NV
+#define VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR VK_PIPELINE_STAGE_SHADING_RATE_IMAGE_BIT_NV
+#define VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR VK_IMAGE_USAGE_SHADING_RATE_IMAGE_BIT_NV
+
+// pipelines that are used while rendering with a shading rate attachment
+#define VK_PIPELINE_CREATE_RENDERING_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR ((VkPipelineCreateFlagBits)0x00200000)
+
+// How two shading rates become one. combinerOps[0] combines the rate
+// of the draw with the rate of the primitive, and combinerOps[1]
+// combines that with the rate of the attachment
+typedef enum VkFragmentShadingRateCombinerOpKHR
+{
+	VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR = 0,
+	VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR = 1,
+	VK_FRAGMENT_SHADING_RATE_COMBINER_OP_MIN_KHR = 2,
+	VK_FRAGMENT_SHADING_RATE_COMBINER_OP_MAX_KHR = 3,
+	VK_FRAGMENT_SHADING_RATE_COMBINER_OP_MUL_KHR = 4,
+	VK_FRAGMENT_SHADING_RATE_COMBINER_OP_MAX_ENUM_KHR = 0x7FFFFFFF
+} VkFragmentShadingRateCombinerOpKHR;
+
+typedef struct VkPipelineFragmentShadingRateStateCreateInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkExtent2D fragmentSize;
+	VkFragmentShadingRateCombinerOpKHR combinerOps[2];
+} VkPipelineFragmentShadingRateStateCreateInfoKHR;
+
+typedef struct VkPhysicalDeviceFragmentShadingRateFeaturesKHR
+{
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 pipelineFragmentShadingRate;
+	VkBool32 primitiveFragmentShadingRate;
+	VkBool32 attachmentFragmentShadingRate;
+} VkPhysicalDeviceFragmentShadingRateFeaturesKHR;
+
+typedef struct VkPhysicalDeviceFragmentShadingRatePropertiesKHR
+{
+	VkStructureType sType;
+	void* pNext;
+	VkExtent2D minFragmentShadingRateAttachmentTexelSize;
+	VkExtent2D maxFragmentShadingRateAttachmentTexelSize;
+	uint32_t maxFragmentShadingRateAttachmentTexelSizeAspectRatio;
+	VkBool32 primitiveFragmentShadingRateWithMultipleViewports;
+	VkBool32 layeredShadingRateAttachments;
+	VkBool32 fragmentShadingRateNonTrivialCombinerOps;
+	VkExtent2D maxFragmentSize;
+	uint32_t maxFragmentSizeAspectRatio;
+	uint32_t maxFragmentShadingRateCoverageSamples;
+	VkSampleCountFlagBits maxFragmentShadingRateRasterizationSamples;
+	VkBool32 fragmentShadingRateWithShaderDepthStencilWrites;
+	VkBool32 fragmentShadingRateWithSampleMask;
+	VkBool32 fragmentShadingRateWithShaderSampleMask;
+	VkBool32 fragmentShadingRateWithConservativeRasterization;
+	VkBool32 fragmentShadingRateWithFragmentShaderInterlock;
+	VkBool32 fragmentShadingRateWithCustomSampleLocations;
+	VkBool32 fragmentShadingRateStrictMultiplyCombiner;
+} VkPhysicalDeviceFragmentShadingRatePropertiesKHR;
+
+typedef struct VkRenderingFragmentShadingRateAttachmentInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkImageView imageView;
+	VkImageLayout imageLayout;
+	VkExtent2D shadingRateAttachmentTexelSize;
+} VkRenderingFragmentShadingRateAttachmentInfoKHR;
+
+typedef void (VKAPI_PTR *PFN_vkCmdSetFragmentShadingRateKHR)(VkCommandBuffer commandBuffer, const VkExtent2D* pFragmentSize, const VkFragmentShadingRateCombinerOpKHR combinerOps[2]);
+#endif
@@ -0,0 +1,116 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "FrameArena.h"
+#include "LargePages.h"
+#include <stdlib.h>
+
+// A linear allocator: there is no list of free memory, no locking,
+// and freeing one allocation is not possible, which makes Allocate
+// a few additions. That is fine for a frame, because everything
+// that the frame allocates is thrown away at the same time
+
+// A block that is as big as a large page gets one, if they are
+// enabled (see LargePages.h), smaller blocks come from malloc
+static ArenaBlock create_block(size_t size)
+{
+	ArenaBlock block;
+	block.data = (uint8_t*)LargePages::Allocate(size);
+	block.size = size;
+	return block;
+}
+
+FrameArena::FrameArena(size_t blockSize)
+{
+	blocks.push_back(create_block(blockSize));
+	current = 0;
+	offset = 0;
+	used = 0;
+	peakBytes = 0;
+}
+
+FrameArena::~FrameArena()
+{
+	for (size_t i = 0; i < blocks.size(); i++)
+		LargePages::Free(blocks[i].data);
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	// the blocks come from malloc (or VirtualAlloc), which aligns to at least 16,
+	// so aligning the offset aligns the address too
+	size_t start = (offset + alignment - 1) & ~(alignment - 1);
+
+	// Try the next blocks, and if none of them have room, add a block
+	// that is big enough. This only happens in the first frames, or
+	// when a frame needs more than any frame before it
+	while (start + bytes > blocks[current].size)
+	{
+		current++;
+		start = 0;
+
+		if (current == blocks.size())
+		{
+			size_t size = blocks.back().size;
+
+			while (size < bytes)
+				size *= 2;
+
+			blocks.push_back(create_block(size));
+		}
+	}
+
+	offset = start + bytes;
+	used += bytes;
+
+	return blocks[current].data + start;
+}
+
+void FrameArena::Reset()
+{
+	if (used > peakBytes)
+		peakBytes = used;
+
+	// If the last frame needed more than one block, the blocks are
+	// replaced by one that is big enough for the biggest frame (with
+	// room for the alignment), so frames never move between blocks
+	if (current > 0)
+	{
+		for (size_t i = 0; i < blocks.size(); i++)
+			LargePages::Free(blocks[i].data);
+
+		size_t size = blocks[0].size;
+
+		while (size < peakBytes * 2)
+			size *= 2;
+
+		blocks.clear();
+		blocks.push_back(create_block(size));
+	}
+
+	current = 0;
+	offset = 0;
+	used = 0;
+}
@@ -0,0 +1,81 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// the arena starts with one block of this size,
+// and adds more blocks if a frame needs more
+#define FRAME_ARENA_BLOCK_SIZE (64 * 1024)
+
+// every allocation starts at a multiple of this,
+// which is enough for any Vulkan struct
+#define FRAME_ARENA_ALIGNMENT 16
+
+// one block of memory that the arena hands out, from the start to the end
+struct ArenaBlock
+{
+	uint8_t* data;
+	size_t size;
+};
+
+// Memory for the arrays that the CPU only needs while it builds one
+// frame, like the semaphores that a submission waits for, or the
+// barriers of the frame graph. Allocate moves a pointer forward, and
+// Reset (at the start of every frame) moves it back to the start, so
+// after the first few frames, the frame never calls new or malloc.
+// Nothing in the arena is destroyed, so it is only for plain structs.
+// Only the render thread uses it
+class FrameArena
+{
+private:
+	std::vector<ArenaBlock> blocks;
+
+	// the block that is being handed out, and
+	// how much of it has been handed out
+	uint32_t current;
+	size_t offset;
+
+	// bytes handed out since Reset
+	size_t used;
+
+public:
+	// The most bytes that one frame used. If a frame needs
+	// more than the first block, Reset makes one block of
+	// this size, so that the next frames fit in one block
+	size_t peakBytes;
+
+	FrameArena(size_t blockSize = FRAME_ARENA_BLOCK_SIZE);
+	~FrameArena();
+
+	// The memory is not cleared, and it stays valid until the next
+	// Reset. A size of zero returns a valid pointer that is not used
+	void* Allocate(size_t bytes, size_t alignment = FRAME_ARENA_ALIGNMENT);
+
+	// everything that was allocated since the last Reset is gone
+	void Reset();
+};
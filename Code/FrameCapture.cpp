@@ -0,0 +1,160 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "FrameCapture.h"
+#include "DeviceTable.h"
+#include <stdio.h>
+
+// Tools that capture frames usually wait for the whole GPU with
+// vkDeviceWaitIdle, and then map the image, so the CPU and the GPU
+// take turns, and the frame rate drops while capturing. Instead, the
+// copy is just one more command at the end of the frame, and nobody
+// looks at the buffer until that frame's fence is signaled anyway.
+
+// The buffers are HOST_CACHED, if the GPU has that, because the CPU
+// reads every byte of them, and reading uncached memory is very slow.
+// Cached memory might not be coherent, then Read invalidates it first
+
+FrameCapture::FrameCapture(VkDevice d, MemoryAllocator* a, uint32_t slotCount, VkFormat f)
+{
+	device = d;
+	allocator = a;
+	format = f;
+
+	// the buffers are made when the first copy
+	// is recorded, when we know the size of the image
+	CaptureSlot empty = {};
+	slots.resize(slotCount, empty);
+}
+
+FrameCapture::~FrameCapture()
+{
+	// the device is idle when the demo deletes us
+	for (size_t i = 0; i < slots.size(); i++)
+		delete slots[i].buffer;
+}
+
+void FrameCapture::Record(VkCommandBuffer cmd, uint32_t slot, VkImage image, uint32_t width, uint32_t height, uint64_t frame)
+{
+	CaptureSlot& s = slots[slot];
+	VkDeviceSize size = (VkDeviceSize)width * height * 4;
+
+	// The last frame of this slot is done, so its buffer can be
+	// deleted. It only grows, after a resize to a smaller window
+	// the same buffer is used
+	if (s.buffer == nullptr || s.size < size)
+	{
+		delete s.buffer;
+
+		VkBufferCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		info.size = size;
+
+		s.buffer = new BufferCPU(device, allocator, info, true, false, true);
+		s.buffer->SetName("Frame capture");
+		s.size = size;
+	}
+
+	s.width = width;
+	s.height = height;
+	s.frame = frame;
+	s.recorded = true;
+
+	// bufferRowLength and bufferImageHeight are 0,
+	// so the rows are packed right after each other
+	VkBufferImageCopy region = {};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { width, height, 1 };
+
+	DeviceTable::CmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, s.buffer->buffer, 1, &region);
+
+	// Waiting for a fence does not make the GPU's writes visible to
+	// the CPU by itself, this barrier to the HOST stage does that
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+const uint8_t* FrameCapture::Read(uint32_t slot, uint32_t* width, uint32_t* height, uint64_t* frame)
+{
+	CaptureSlot& s = slots[slot];
+
+	if (!s.recorded)
+		return nullptr;
+
+	s.recorded = false;
+
+	VkDeviceSize size = (VkDeviceSize)s.width * s.height * 4;
+	s.buffer->Invalidate(0, size);
+
+	*width = s.width;
+	*height = s.height;
+	*frame = s.frame;
+
+	return (const uint8_t*)s.buffer->GetPointer();
+}
+
+bool FrameCapture::Save(const char* path, const uint8_t* pixels, uint32_t width, uint32_t height)
+{
+	FILE* file = fopen(path, "wb");
+
+	if (file == nullptr)
+	{
+		printf("Could not write the frame capture %s\n", path);
+		return false;
+	}
+
+	// The swapchain is usually BGRA, and PPM is RGB, so the red and
+	// blue bytes are swapped, and alpha is dropped. Each row is
+	// converted first, and then written with one fwrite
+	bool bgra = (format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB);
+
+	fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+	std::vector<uint8_t> row(width * 3);
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* src = pixels + (size_t)y * width * 4;
+
+		for (uint32_t x = 0; x < width; x++)
+		{
+			row[x * 3 + 0] = src[x * 4 + (bgra ? 2 : 0)];
+			row[x * 3 + 1] = src[x * 4 + 1];
+			row[x * 3 + 2] = src[x * 4 + (bgra ? 0 : 2)];
+		}
+
+		fwrite(row.data(), 1, row.size(), file);
+	}
+
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,78 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "BufferCPU.h"
+#include "MemoryAllocator.h"
+
+// the image of one frame, which the GPU copies into a CPU buffer
+struct CaptureSlot
+{
+	BufferCPU* buffer;
+	VkDeviceSize size;
+
+	// the size of the image, and the frame that it came from
+	uint32_t width;
+	uint32_t height;
+	uint64_t frame;
+
+	// true if a copy was recorded, and it has not been read yet
+	bool recorded;
+};
+
+// Copies the final image of a frame into a CPU buffer, so it can be
+// saved (or sent somewhere) without stopping the GPU. Each frame slot
+// has its own buffer, which is read when that slot is used again,
+// frame_lag frames later. The fence of the slot was already waited on
+// by then, so reading never stalls, just like GpuTimer
+class FrameCapture
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+	std::vector<CaptureSlot> slots;
+
+public:
+	// the format of the images, 4 bytes per pixel
+	VkFormat format;
+
+	FrameCapture(VkDevice d, MemoryAllocator* a, uint32_t slotCount, VkFormat f);
+	~FrameCapture();
+
+	// Records the copy of the image, which has to be in
+	// TRANSFER_SRC_OPTIMAL layout, into the buffer of the slot
+	void Record(VkCommandBuffer cmd, uint32_t slot, VkImage image, uint32_t width, uint32_t height, uint64_t frame);
+
+	// The pixels of the slot, after the fence of the frame that
+	// recorded it, or nullptr if nothing was recorded. Each
+	// capture is only given out once
+	const uint8_t* Read(uint32_t slot, uint32_t* width, uint32_t* height, uint64_t* frame);
+
+	// writes the pixels that Read gave, as a binary PPM file
+	bool Save(const char* path, const uint8_t* pixels, uint32_t width, uint32_t height);
+};
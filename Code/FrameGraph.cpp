@@ -0,0 +1,333 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#include "FrameGraph.h"
+#include "DeviceTable.h"
+#include "DebugUtils.h"
+
+// Every barrier in the frame used to be written by hand, in the pass
+// that needed it, so each pass waited for everything that could have
+// come before it, in a barrier of its own. Here, each pass only says
+// what it reads and writes, and the graph remembers what was last done
+// to each resource. A barrier is only recorded if a pass writes what
+// was read or written before, reads what was written, or needs
+// another layout. Two reads of the same data need no barrier at all.
+//
+// A barrier can be recorded anywhere after the last pass that used the
+// resource, and before the pass that needs it. So if an earlier pass
+// already has barriers, and none of the passes in between touch the
+// resource, the barrier joins them. One vkCmdPipelineBarrier with a lot
+// of barriers is cheaper than a lot of calls with one barrier each: the
+// GPU drains its work once, instead of once per barrier.
+//
+// Barriers that do not change a layout all go into one VkMemoryBarrier,
+// a memory barrier covers every buffer and image at once, and drivers
+// handle it the same way as a list of buffer barriers
+
+// every access bit that writes memory, the rest only read
+#define FRAME_WRITE_ACCESS (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+FrameGraph::FrameGraph(FrameArena* frameArena)
+{
+	arena = frameArena;
+	images = nullptr;
+	passCount = 0;
+	barrierCount = 0;
+	batchCount = 0;
+}
+
+uint32_t FrameGraph::AddResource(const char* name)
+{
+	FrameResource r = {};
+	r.name = name;
+	r.lastPass = -1;
+	resources.push_back(r);
+
+	Reset((uint32_t)resources.size() - 1);
+	return (uint32_t)resources.size() - 1;
+}
+
+uint32_t FrameGraph::AddBuffer(const char* name)
+{
+	return AddResource(name);
+}
+
+uint32_t FrameGraph::AddImage(const char* name)
+{
+	return AddResource(name);
+}
+
+void FrameGraph::SetBuffer(uint32_t resource, VkBuffer buffer)
+{
+	FrameResource& r = resources[resource];
+
+	if (r.buffer != buffer)
+		Reset(resource);
+
+	r.buffer = buffer;
+}
+
+void FrameGraph::SetImage(uint32_t resource, VkImage image, VkImageAspectFlags aspect, uint32_t levels)
+{
+	FrameResource& r = resources[resource];
+
+	if (r.image != image)
+		Reset(resource);
+
+	r.image = image;
+	r.aspect = aspect;
+	r.levels = levels;
+}
+
+void FrameGraph::Reset(uint32_t resource, VkPipelineStageFlags readyStages)
+{
+	FrameResource& r = resources[resource];
+
+	// it looks like it was written at readyStages, with no
+	// memory to make visible, so the first pass only waits
+	// for those stages (if there are any)
+	r.writeStages = readyStages;
+	r.writeAccess = 0;
+	r.readStages = 0;
+	r.visibleStages = 0;
+	r.visibleAccess = 0;
+	r.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+uint32_t FrameGraph::AddPass(const char* name, std::function<void(VkCommandBuffer)> record)
+{
+	if (passCount == passes.size())
+		passes.push_back(FramePass());
+
+	// clear keeps the memory of the lists
+	FramePass& pass = passes[passCount];
+	pass.name = name;
+	pass.record = record;
+	pass.accesses.clear();
+	pass.memoryBarriers.clear();
+
+	return passCount++;
+}
+
+void FrameGraph::Use(uint32_t pass, uint32_t resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, uint32_t flags)
+{
+	FrameAccess a;
+	a.resource = resource;
+	a.stages = stages;
+	a.access = access;
+	a.layout = layout;
+	a.flags = flags;
+	passes[pass].accesses.push_back(a);
+}
+
+void FrameGraph::AddMemoryBarrier(uint32_t pass, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+{
+	FrameMemoryBarrier b;
+	b.srcStages = srcStages;
+	b.srcAccess = srcAccess;
+	b.dstStages = dstStages;
+	b.dstAccess = dstAccess;
+	passes[pass].memoryBarriers.push_back(b);
+}
+
+FrameBatch* FrameGraph::GetBatch(uint32_t pass)
+{
+	if (!batches.empty() && batches.back().pass == pass)
+		return &batches.back();
+
+	// its image barriers start after the ones of the last batch
+	FrameBatch batch = {};
+	batch.pass = pass;
+	batch.memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+	if (!batches.empty())
+		batch.firstImage = batches.back().firstImage + batches.back().imageCount;
+
+	batches.push_back(batch);
+
+	return &batches.back();
+}
+
+void FrameGraph::Execute(VkCommandBuffer cmd)
+{
+	batches.clear();
+	barrierCount = 0;
+
+	// each access makes one image barrier at most, so this is
+	// enough for the frame, and the arena makes it cheap to ask
+	// for more than we need. It is gone at the next frame
+	size_t accessCount = 0;
+
+	for (uint32_t p = 0; p < passCount; p++)
+		accessCount += passes[p].accesses.size();
+
+	images = (VkImageMemoryBarrier*)arena->Allocate(accessCount * sizeof(VkImageMemoryBarrier));
+
+	for (size_t i = 0; i < resources.size(); i++)
+		resources[i].lastPass = -1;
+
+	// First every barrier is worked out, in the order of the passes,
+	// then everything is recorded. A barrier goes into the newest
+	// batch if that batch comes after the last pass that used the
+	// resource, otherwise it starts a new batch, right before the pass
+	// that needs it. This makes as few batches as possible
+	for (uint32_t p = 0; p < passCount; p++)
+	{
+		FramePass& pass = passes[p];
+
+		// these can not move, they are recorded right before the pass
+		for (size_t i = 0; i < pass.memoryBarriers.size(); i++)
+		{
+			FrameMemoryBarrier& b = pass.memoryBarriers[i];
+			FrameBatch* batch = GetBatch(p);
+			batch->srcStages |= b.srcStages;
+			batch->dstStages |= b.dstStages;
+			batch->memory.srcAccessMask |= b.srcAccess;
+			batch->memory.dstAccessMask |= b.dstAccess;
+			barrierCount++;
+		}
+
+		for (size_t i = 0; i < pass.accesses.size(); i++)
+		{
+			FrameAccess& a = pass.accesses[i];
+			FrameResource& r = resources[a.resource];
+
+			bool write = (a.access & FRAME_WRITE_ACCESS) != 0;
+			bool transition = (r.image != VK_NULL_HANDLE) && (a.layout != r.layout);
+
+			bool needed = false;
+			VkPipelineStageFlags srcStages = 0;
+			VkAccessFlags srcAccess = r.writeAccess;
+
+			if (write || transition)
+			{
+				// A write waits for every read and write before it, and
+				// so does a layout transition, because it writes the image
+				srcStages = r.writeStages | r.readStages;
+				needed = (srcStages != 0) || transition;
+
+				r.writeStages = a.stages;
+				r.writeAccess = a.access & FRAME_WRITE_ACCESS;
+				r.readStages = 0;
+				r.visibleStages = a.stages;
+				r.visibleAccess = a.access & ~FRAME_WRITE_ACCESS;
+			}
+			else
+			{
+				// a read only waits if the last write was not made
+				// visible to this stage, and this kind of read, yet
+				srcStages = r.writeStages;
+				needed = (r.writeStages != 0) &&
+					(((a.stages & ~r.visibleStages) != 0) || ((a.access & ~r.visibleAccess) != 0));
+
+				r.readStages |= a.stages;
+
+				if (needed)
+				{
+					r.visibleStages |= a.stages;
+					r.visibleAccess |= a.access;
+				}
+			}
+
+			VkImageLayout oldLayout = (a.flags & FRAME_ACCESS_DISCARD) ? VK_IMAGE_LAYOUT_UNDEFINED : r.layout;
+
+			if (r.image != VK_NULL_HANDLE)
+				r.layout = a.layout;
+
+			int32_t lastPass = r.lastPass;
+			r.lastPass = (int32_t)p;
+
+			if (!needed || (a.flags & FRAME_ACCESS_RENDER_PASS))
+				continue;
+
+			// a transition with nothing before it does not
+			// wait for anything, but it needs a stage
+			if (srcStages == 0)
+				srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+			FrameBatch* batch = nullptr;
+
+			if (!batches.empty() && (int32_t)batches.back().pass > lastPass)
+				batch = &batches.back();
+			else
+				batch = GetBatch(p);
+
+			batch->srcStages |= srcStages;
+			batch->dstStages |= a.stages;
+			barrierCount++;
+
+			if (!transition)
+			{
+				batch->memory.srcAccessMask |= srcAccess;
+				batch->memory.dstAccessMask |= a.access;
+				continue;
+			}
+
+			VkImageMemoryBarrier imageBarrier = {};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = srcAccess;
+			imageBarrier.dstAccessMask = a.access;
+			imageBarrier.oldLayout = oldLayout;
+			imageBarrier.newLayout = a.layout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = r.image;
+			imageBarrier.subresourceRange.aspectMask = r.aspect;
+			imageBarrier.subresourceRange.levelCount = r.levels;
+			imageBarrier.subresourceRange.layerCount = 1;
+			images[batch->firstImage + batch->imageCount] = imageBarrier;
+			batch->imageCount++;
+		}
+	}
+
+	batchCount = (uint32_t)batches.size();
+
+	size_t nextBatch = 0;
+
+	for (uint32_t p = 0; p < passCount; p++)
+	{
+		if (nextBatch < batches.size() && batches[nextBatch].pass == p)
+		{
+			FrameBatch& batch = batches[nextBatch++];
+			bool memory = (batch.memory.srcAccessMask | batch.memory.dstAccessMask) != 0;
+
+			DeviceTable::CmdPipelineBarrier(cmd,
+				batch.srcStages, batch.dstStages, 0,
+				memory ? 1 : 0, memory ? &batch.memory : NULL,
+				0, NULL,
+				batch.imageCount, batch.imageCount == 0 ? NULL : &images[batch.firstImage]);
+		}
+
+		if (passes[p].record)
+		{
+			DEBUG_LABEL_BEGIN(cmd, passes[p].name);
+			passes[p].record(cmd);
+			DEBUG_LABEL_END(cmd);
+		}
+	}
+
+	passCount = 0;
+}
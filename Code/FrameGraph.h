@@ -0,0 +1,175 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include <functional>
+#include "FrameArena.h"
+
+// how a pass uses a resource, other than its stages and access
+enum FrameAccessFlags
+{
+	// the pass does not need the old contents, so an
+	// image can go from UNDEFINED to the new layout
+	FRAME_ACCESS_DISCARD = 0x1,
+
+	// The render pass waits for this itself, with its subpass
+	// dependencies, so the graph records no barrier for it.
+	// The layout is the finalLayout of the attachment
+	FRAME_ACCESS_RENDER_PASS = 0x2
+};
+
+// A buffer or an image that the passes of a frame use. The graph
+// lives as long as the demo, so the resources remember how they were
+// left by the last frame, and the first pass of the next frame waits
+// for that, just like it would wait for a pass of the same frame
+struct FrameResource
+{
+	const char* name;
+	VkBuffer buffer;
+	VkImage image;
+	VkImageAspectFlags aspect;
+	uint32_t levels;
+
+	// the stages that wrote it last, and what they wrote
+	VkPipelineStageFlags writeStages;
+	VkAccessFlags writeAccess;
+
+	// the stages that read it since then, and the stages and reads
+	// that a barrier has already made the last write visible to
+	VkPipelineStageFlags readStages;
+	VkPipelineStageFlags visibleStages;
+	VkAccessFlags visibleAccess;
+
+	VkImageLayout layout;
+
+	// the last pass of this frame that used it, -1 if none did yet
+	int32_t lastPass;
+};
+
+struct FrameAccess
+{
+	uint32_t resource;
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkImageLayout layout;
+	uint32_t flags;
+};
+
+// a barrier that a pass asks for, which is not about one
+// resource, like the barrier for images that share memory
+struct FrameMemoryBarrier
+{
+	VkPipelineStageFlags srcStages;
+	VkAccessFlags srcAccess;
+	VkPipelineStageFlags dstStages;
+	VkAccessFlags dstAccess;
+};
+
+struct FramePass
+{
+	const char* name;
+	std::function<void(VkCommandBuffer)> record;
+	std::vector<FrameAccess> accesses;
+	std::vector<FrameMemoryBarrier> memoryBarriers;
+};
+
+// Every barrier that is recorded before one pass, in one vkCmdPipelineBarrier.
+// Barriers are only ever added to the newest batch, so the image
+// barriers of all batches are one array, in the order of the batches
+struct FrameBatch
+{
+	uint32_t pass;
+	VkPipelineStageFlags srcStages;
+	VkPipelineStageFlags dstStages;
+	VkMemoryBarrier memory;
+	uint32_t firstImage;
+	uint32_t imageCount;
+};
+
+// The passes of a frame say which resources they read and write,
+// and the graph works out the barriers between them, and records
+// as few vkCmdPipelineBarrier calls as it can (see FrameGraph.cpp).
+// Barriers inside of a pass (like between the levels of the depth
+// pyramid) are still recorded by the pass itself
+class FrameGraph
+{
+private:
+	std::vector<FrameResource> resources;
+	std::vector<FrameBatch> batches;
+
+	// The passes are kept after Execute, and used again by the
+	// next frame, so their lists of accesses keep their memory.
+	// Only the first passCount of them are in this frame
+	std::vector<FramePass> passes;
+	uint32_t passCount;
+
+	// the image barriers of the frame come from here
+	FrameArena* arena;
+	VkImageMemoryBarrier* images;
+
+	uint32_t AddResource(const char* name);
+	FrameBatch* GetBatch(uint32_t pass);
+
+public:
+	// number of barriers and vkCmdPipelineBarrier
+	// calls that the last Execute recorded
+	uint32_t barrierCount;
+	uint32_t batchCount;
+
+	FrameGraph(FrameArena* frameArena);
+
+	// Resources are added once, and then each frame says which
+	// buffer or image the resource is, if that changed since the
+	// last frame (like after a resize), the resource starts over
+	uint32_t AddBuffer(const char* name);
+	uint32_t AddImage(const char* name);
+	void SetBuffer(uint32_t resource, VkBuffer buffer);
+	void SetImage(uint32_t resource, VkImage image, VkImageAspectFlags aspect, uint32_t levels);
+
+	// Forgets what was done to the resource, it is UNDEFINED, and
+	// the first pass that uses it only waits for readyStages, like
+	// the stage that waits for the semaphore of a swapchain image
+	void Reset(uint32_t resource, VkPipelineStageFlags readyStages = 0);
+
+	// The passes run in the order that they are added. A pass without
+	// a record function only changes the layouts, like the final
+	// transition of the swapchain image to PRESENT_SRC
+	uint32_t AddPass(const char* name, std::function<void(VkCommandBuffer)> record);
+
+	// the stages of the pass that use the resource, and how, the
+	// layout is ignored for buffers. One pass uses a resource once
+	void Use(uint32_t pass, uint32_t resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED, uint32_t flags = 0);
+
+	// a barrier that is recorded right before the pass
+	void AddMemoryBarrier(uint32_t pass, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+
+	// records the barriers and the passes, and then
+	// forgets the passes, the resources are kept
+	void Execute(VkCommandBuffer cmd);
+};
@@ -0,0 +1,111 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "FrameLimiter.h"
+#include <stdio.h>
+
+// Windows 10 (version 1803) and newer have a timer that does not
+// wait for the next timer tick, which is 15.6ms long by default.
+// Older SDKs do not have the name, and older versions of Windows
+// fail to make the timer, then we use a normal one
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+FrameLimiter::FrameLimiter()
+{
+	timer = CreateWaitableTimerEx(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	highResolution = (timer != nullptr);
+
+	if (!highResolution)
+		timer = CreateWaitableTimerEx(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+
+	spinTime = highResolution ? std::chrono::microseconds(1000) : std::chrono::microseconds(16000);
+	interval = CpuClock::duration::zero();
+}
+
+FrameLimiter::~FrameLimiter()
+{
+	if (timer != nullptr)
+		CloseHandle(timer);
+}
+
+void FrameLimiter::SetTargetFps(uint32_t fps)
+{
+	if (fps == 0)
+	{
+		interval = CpuClock::duration::zero();
+		return;
+	}
+
+	interval = std::chrono::duration_cast<CpuClock::duration>(std::chrono::duration<double>(1.0 / fps));
+	deadline = CpuClock::now();
+
+	printf("Frame rate limit: %u frames per second, %s timer\n", fps, highResolution ? "high resolution" : "normal");
+}
+
+bool FrameLimiter::IsActive()
+{
+	return interval != CpuClock::duration::zero();
+}
+
+void FrameLimiter::Wait()
+{
+	if (!IsActive())
+		return;
+
+	// The frames are spaced from the deadline, not from when we woke
+	// up, so waking up a little late does not make every frame late.
+	// If the frame before took longer than interval, we are already
+	// behind, and the next deadline starts from now, otherwise we would
+	// draw a few frames with no wait at all to catch up
+	CpuClock::time_point now = CpuClock::now();
+	deadline += interval;
+
+	if (deadline < now)
+	{
+		deadline = now;
+		return;
+	}
+
+	// sleep until spinTime before the deadline. The time is
+	// negative, which means that it is relative to now, and it
+	// is in units of 100 nanoseconds
+	CpuClock::duration sleep = (deadline - now) - spinTime;
+
+	if (timer != nullptr && sleep > CpuClock::duration::zero())
+	{
+		LARGE_INTEGER due;
+		due.QuadPart = -(LONGLONG)(std::chrono::duration_cast<std::chrono::nanoseconds>(sleep).count() / 100);
+
+		if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE))
+			WaitForSingleObject(timer, INFINITE);
+	}
+
+	// and spin for the rest, it is short enough
+	// that it does not cost much power
+	while (CpuClock::now() < deadline)
+		YieldProcessor();
+}
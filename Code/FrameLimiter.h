@@ -0,0 +1,63 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <windows.h>
+#include <stdint.h>
+#include "CpuProfiler.h"
+
+// Keeps the frames from coming faster than a target frame rate. FIFO
+// already waits for the monitor, but MAILBOX and IMMEDIATE draw as
+// many frames as the GPU can, and most of them are never seen, which
+// only makes the computer hot. Wait sleeps on a waitable timer until
+// a little before the next frame should start, and spins for the rest,
+// because a timer can wake up late, but it can never wake up early
+class FrameLimiter
+{
+private:
+	HANDLE timer;
+
+	// the high resolution timer wakes up within about half of a
+	// millisecond, the old one only within a whole timer tick,
+	// so the old one needs to stop sleeping earlier
+	bool highResolution;
+	CpuClock::duration spinTime;
+
+	// when the next frame should start, and how far apart frames are,
+	// interval is zero when there is no limit
+	CpuClock::time_point deadline;
+	CpuClock::duration interval;
+
+public:
+	FrameLimiter();
+	~FrameLimiter();
+
+	// zero turns the limit off
+	void SetTargetFps(uint32_t fps);
+	bool IsActive();
+
+	// sleeps until it is time for the next frame
+	void Wait();
+};
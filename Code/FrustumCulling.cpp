@@ -0,0 +1,150 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "FrustumCulling.h"
+#include "SimdLanes.h"
+
+// GPU culling (see CullingPass) needs a compute queue, and indirect
+// draws. Without them, the CPU can still skip the objects that are
+// outside of the view, before their matrices go into the instance
+// buffer. Like TransformBatch, the spheres are tested 4 or 8 at a
+// time, and each test is 6 dot products, one for each plane
+
+void ExtractFrustumPlanes(const glm::mat4& mvp, glm::vec4 planes[6])
+{
+	// Each plane is a row of the matrix added to (or subtracted
+	// from) the fourth row (Gribb and Hartmann). Vulkan depth goes
+	// from 0 to w, so the near plane is just the third row
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+
+	planes[0] = row[3] + row[0];	// left
+	planes[1] = row[3] - row[0];	// right
+	planes[2] = row[3] + row[1];	// top or bottom
+	planes[3] = row[3] - row[1];	// bottom or top
+	planes[4] = row[2];				// near
+	planes[5] = row[3] - row[2];	// far
+
+	// normalize the planes, so that the distance to
+	// the plane can be compared to the radius of an object
+	for (int i = 0; i < 6; i++)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+uint32_t CullSpheres(TransformArrays* t, const glm::vec4 planes[6], float radius, uint32_t* visible)
+{
+	uint32_t count = t->GetCount();
+	uint32_t visibleCount = 0;
+	uint32_t i = 0;
+
+#if SIMD_LANES > 1
+	Lanes nx[6];
+	Lanes ny[6];
+	Lanes nz[6];
+	Lanes nw[6];
+
+	for (int p = 0; p < 6; p++)
+	{
+		nx[p] = LANES_SET1(planes[p].x);
+		ny[p] = LANES_SET1(planes[p].y);
+		nz[p] = LANES_SET1(planes[p].z);
+		nw[p] = LANES_SET1(planes[p].w);
+	}
+
+	Lanes negRadius = LANES_SET1(-radius);
+
+	for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+	{
+		Lanes px = LANES_LOAD(&t->posX[i]);
+		Lanes py = LANES_LOAD(&t->posY[i]);
+		Lanes pz = LANES_LOAD(&t->posZ[i]);
+
+		Lanes scale = LANES_MAX(LANES_MAX(LANES_LOAD(&t->scaleX[i]), LANES_LOAD(&t->scaleY[i])), LANES_LOAD(&t->scaleZ[i]));
+		Lanes negR = LANES_MUL(negRadius, scale);
+
+		// every bit of a lane is 1 while the sphere
+		// is in front of (or touching) every plane
+		Lanes inside = LANES_CMPGE(LANES_ADD(LANES_ADD(LANES_MUL(nx[0], px), LANES_MUL(ny[0], py)), LANES_ADD(LANES_MUL(nz[0], pz), nw[0])), negR);
+
+		for (int p = 1; p < 6; p++)
+		{
+			Lanes d = LANES_ADD(LANES_ADD(LANES_MUL(nx[p], px), LANES_MUL(ny[p], py)), LANES_ADD(LANES_MUL(nz[p], pz), nw[p]));
+			inside = LANES_AND(inside, LANES_CMPGE(d, negR));
+		}
+
+		// one bit for each object, the visible
+		// ones are written in the same order
+		int mask = LANES_MASK(inside);
+
+		while (mask != 0)
+		{
+			int lane = 0;
+			while (!(mask & (1 << lane)))
+				lane++;
+
+			visible[visibleCount++] = i + lane;
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	// the objects that do not fill a whole register
+	for (; i < count; i++)
+	{
+		glm::vec3 center = t->GetPosition(i);
+		float scale = glm::max(glm::max(t->scaleX[i], t->scaleY[i]), t->scaleZ[i]);
+		float r = radius * scale;
+
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+			inside = glm::dot(glm::vec3(planes[p]), center) + planes[p].w >= -r;
+
+		if (inside)
+			visible[visibleCount++] = i;
+	}
+
+	return visibleCount;
+}
+
+bool IsMeshletVisible(const Meshlet& meshlet, const glm::vec4 planes[6], glm::vec3 camera)
+{
+	glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+
+	for (int p = 0; p < 6; p++)
+	{
+		if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -meshlet.radius)
+			return false;
+	}
+
+	// The cone test from meshoptimizer: the meshlet faces away if the
+	// direction from the camera to the sphere is inside of the cone,
+	// by at least the size of the sphere, so the test does not depend
+	// on where in the sphere each triangle is
+	glm::vec3 axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+	glm::vec3 toCenter = center - camera;
+
+	return glm::dot(toCenter, axis) < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
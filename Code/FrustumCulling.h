@@ -0,0 +1,49 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include "TransformBatch.h"
+#include "MeshFile.h"
+
+// Gets the six planes of the view frustum from an MVP matrix. The
+// planes are in the space that the MVP starts in, and they are
+// normalized, so a point's distance to a plane is dot(n, p) + w
+void ExtractFrustumPlanes(const glm::mat4& mvp, glm::vec4 planes[6]);
+
+// Tests the bounding sphere of every object against the planes, 4 or 8
+// objects at a time. The sphere is at the position of the object, and
+// its radius is radius times the largest scale of the object. The index
+// of every object that is at least partly inside is written to visible,
+// which needs room for every object, and the number of them is returned
+uint32_t CullSpheres(TransformArrays* transforms, const glm::vec4 planes[6], float radius, uint32_t* visible);
+
+// Tests one meshlet of an object, against the planes from the object's
+// MVP, and the camera's position in the space of the object. It is
+// not visible if its sphere is outside of a plane, or if every triangle
+// in it faces away from the camera, see Meshlet in MeshFile.h
+bool IsMeshletVisible(const Meshlet& meshlet, const glm::vec4 planes[6], glm::vec3 camera);
@@ -0,0 +1,239 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "GpuDecompressor.h"
+#include "AssetPack.h"
+#include "BufferCPU.h"
+#include "BufferGPU.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <string.h>
+
+GpuDecompressor::GpuDecompressor(VkDevice d, VkPipelineCache cache, MemoryAllocator* a, VkQueue q, CommandBufferPool* c, SyncPool* s)
+{
+	device = d;
+	allocator = a;
+	queue = q;
+	cmds = c;
+	syncPool = s;
+
+	// The shader reads the blob at binding 0, and
+	// writes the file at binding 1
+	VkDescriptorSetLayoutBinding bindings[2];
+	memset(bindings, 0, sizeof(bindings));
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+	vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &layout);
+
+	// the number of blocks is a push constant
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(uint32_t);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &layout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &pipelineLayoutInfo, HostAllocator::callbacks, &pipelineLayout);
+
+	// Compute Shader compiled to header, see compileShaders.cmd
+	const unsigned char cs_code[] = {
+		#include "cube_decompress.comp.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = (uint32_t*)cs_code;
+	shaderInfo.codeSize = sizeof(cs_code);
+
+	VkShaderModule module;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &module);
+
+	VkComputePipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeInfo.stage.module = module;
+	pipeInfo.stage.pName = "main";
+	pipeInfo.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the decompression pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, module, HostAllocator::callbacks);
+
+	VkDescriptorPoolSize poolSize;
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = 2;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &descPool);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, &descSet);
+}
+
+GpuDecompressor::~GpuDecompressor()
+{
+	vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+	vkDestroyDescriptorPool(device, descPool, HostAllocator::callbacks);
+	vkDestroyDescriptorSetLayout(device, layout, HostAllocator::callbacks);
+}
+
+void GpuDecompressor::Record(VkCommandBuffer cmd, VkBuffer src, VkBuffer dst, uint32_t blockCount)
+{
+	VkDescriptorBufferInfo bufferInfo[2] = {};
+	bufferInfo[0].buffer = src;
+	bufferInfo[0].range = VK_WHOLE_SIZE;
+	bufferInfo[1].buffer = dst;
+	bufferInfo[1].range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[2];
+	memset(writes, 0, sizeof(writes));
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = descSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfo[i];
+	}
+
+	DeviceTable::UpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descSet, 0, NULL);
+	DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &blockCount);
+
+	DeviceTable::CmdDispatch(cmd, (blockCount + DECOMPRESS_WORKGROUP_SIZE - 1) / DECOMPRESS_WORKGROUP_SIZE, 1, 1);
+}
+
+void GpuDecompressor::UploadTexture(TextureGPU* texture, const char* blob, size_t blobSize, size_t size,
+	uint32_t regionCount, const VkBufferImageCopy* regions)
+{
+	AssetPackBlocks blocks;
+	memcpy(&blocks, blob, sizeof(blocks));
+
+	// The shader reads and writes whole uints, so both buffers are
+	// rounded up to 4 bytes. The few bytes after the blob are never
+	// used, they are only in the same word as its last bytes
+	VkBufferCreateInfo buf_info = {};
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.size = (blobSize + 3) & ~(size_t)3;
+	buf_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	BufferCPU staging(device, allocator, buf_info);
+	staging.SetName("Compressed staging buffer");
+	staging.Store((void*)blob, (int)blobSize);
+
+	buf_info.size = (size + 3) & ~(size_t)3;
+	buf_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	BufferGPU decompressed(device, allocator, buf_info);
+	decompressed.SetName("Decompressed buffer");
+
+	VkCommandBuffer cmd = cmds->Begin();
+	Record(cmd, staging.buffer, decompressed.buffer, blocks.blockCount);
+
+	// the copies read what the shader wrote
+	VkBufferMemoryBarrier bufferBarrier = {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = decompressed.buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	VkImageMemoryBarrier imageBarrier = texture->BeginCopy(regionCount, regions, false);
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, NULL, 1, &bufferBarrier, 1, &imageBarrier);
+
+	DeviceTable::CmdCopyBufferToImage(cmd, decompressed.buffer, texture->image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions);
+
+	// this is the queue that draws, so nothing is released
+	if (texture->EndCopy(VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, &imageBarrier))
+	{
+		DeviceTable::CmdPipelineBarrier(cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, NULL, 0, NULL, 1, &imageBarrier);
+	}
+
+	DeviceTable::EndCommandBuffer(cmd);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+
+	// Both buffers are deleted when this returns, so we wait for the
+	// GPU here, like SparseTilePool::Flush. Loading is the only time
+	// that this runs, so no frame is waiting for it
+	VkFence fence = syncPool->AcquireFence();
+
+	VkResult err;
+	{
+		QueueLock queueLock;
+		err = DeviceTable::QueueSubmit(queue, 1, &submitInfo, fence);
+	}
+	if (err != VK_SUCCESS)
+		ERR_EXIT("vkQueueSubmit failed\n", "Decompression Failure");
+
+	DeviceTable::WaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	syncPool->ReleaseFence(fence);
+}
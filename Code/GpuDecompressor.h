@@ -0,0 +1,77 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "MemoryAllocator.h"
+#include "TextureGPU.h"
+#include "CommandBufferPool.h"
+#include "SyncPool.h"
+
+// the number of blocks in one workgroup
+// of the shader (local_size_x)
+#define DECOMPRESS_WORKGROUP_SIZE 64
+
+// Decompresses the compressed blobs of the asset pack on the GPU, in the
+// spirit of DirectStorage. The blob goes into a staging buffer as it is
+// in the pack, cube_decompress.comp turns it back into the file, in a
+// device-local buffer, and the file is copied from there. The CPU only
+// copies the compressed bytes, and every block of 64 KB is decompressed
+// by its own invocation, at the same time as all of the others
+class GpuDecompressor
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+	VkQueue queue;
+	CommandBufferPool* cmds;
+	SyncPool* syncPool;
+
+	VkDescriptorSetLayout layout;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+	VkDescriptorPool descPool;
+	VkDescriptorSet descSet;
+
+public:
+	// The work goes to this queue (which has to be able to use compute
+	// shaders), in command buffers from cmds
+	GpuDecompressor(VkDevice d, VkPipelineCache cache, MemoryAllocator* a, VkQueue q, CommandBufferPool* c, SyncPool* s);
+	~GpuDecompressor();
+
+	// Records the shader, which reads the blob from src, and writes the
+	// file to dst. dst needs STORAGE_BUFFER usage, and room for the
+	// whole file, rounded up to 4 bytes. Only one decompression can be
+	// on the GPU at a time, because they share the descriptor set
+	void Record(VkCommandBuffer cmd, VkBuffer src, VkBuffer dst, uint32_t blockCount);
+
+	// Decompresses a KTX2 file from its blob, and copies the regions of
+	// the texture from it, their offsets are from the start of the file.
+	// Then the texture is ready for the fragment shader. This waits for
+	// the GPU, it is for loading, not for the frames
+	void UploadTexture(TextureGPU* texture, const char* blob, size_t blobSize, size_t size,
+		uint32_t regionCount, const VkBufferImageCopy* regions);
+};
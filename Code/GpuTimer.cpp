@@ -0,0 +1,230 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "GpuTimer.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <stdio.h>
+#include <algorithm>
+
+// A timestamp query asks the GPU to write down its clock, when every
+// command before it has reached a pipeline stage. The difference of
+// two timestamps is how long the GPU took to run the commands between
+// them. The clock counts in "ticks", and timestampPeriod tells us how
+// many nanoseconds one tick is
+
+GpuTimer::GpuTimer(VkDevice d, VkPhysicalDevice gpu, uint32_t queueFamily, uint32_t slots)
+{
+	device = d;
+	slotCount = slots;
+	pool = VK_NULL_HANDLE;
+	period = 1.0f;
+	validMask = 0;
+	supported = false;
+	totalFrameMs = 0;
+	totalFrames = 0;
+	lastFrameMs = 0;
+	trace = nullptr;
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(gpu, &props);
+
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, NULL);
+
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, families.data());
+
+	// If a queue family has 0 valid bits, it can not write timestamps
+	uint32_t validBits = families[queueFamily].timestampValidBits;
+
+	if (validBits == 0 || props.limits.timestampPeriod == 0.0f)
+	{
+		printf("This queue can not write timestamps, GPU times are not measured\n");
+		return;
+	}
+
+	period = props.limits.timestampPeriod;
+	validMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+
+	// one set of timestamps for every slot
+	VkQueryPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = slotCount * GPU_TIMESTAMP_COUNT;
+	vkCreateQueryPool(device, &poolInfo, HostAllocator::callbacks, &pool);
+
+	written.resize(slotCount, false);
+	frameTimes.reserve(GPU_TIMER_HISTORY);
+	passTimes.reserve(GPU_TIMER_HISTORY);
+	supported = true;
+}
+
+GpuTimer::~GpuTimer()
+{
+	if (pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, pool, HostAllocator::callbacks);
+}
+
+void GpuTimer::ReadSlot(uint32_t slot)
+{
+	if (!written[slot])
+		return;
+
+	written[slot] = false;
+
+	// There is no WAIT flag, so if the results are somehow not
+	// ready, we get VK_NOT_READY, and we skip this frame
+	uint64_t ticks[GPU_TIMESTAMP_COUNT];
+
+	VkResult result = DeviceTable::GetQueryPoolResults(device, pool,
+		slot * GPU_TIMESTAMP_COUNT, GPU_TIMESTAMP_COUNT,
+		sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS)
+		return;
+
+	for (uint32_t i = 0; i < GPU_TIMESTAMP_COUNT; i++)
+		ticks[i] &= validMask;
+
+	if (trace != nullptr && trace->IsActive())
+	{
+		trace->AddGpu("frame", ticks[GPU_TIMESTAMP_FRAME_BEGIN], ticks[GPU_TIMESTAMP_FRAME_END]);
+		trace->AddGpu("render pass", ticks[GPU_TIMESTAMP_PASS_BEGIN], ticks[GPU_TIMESTAMP_PASS_END]);
+	}
+
+	// ticks to nanoseconds to milliseconds. The mask also
+	// handles a clock that wrapped around between timestamps
+	double frame = ((ticks[GPU_TIMESTAMP_FRAME_END] - ticks[GPU_TIMESTAMP_FRAME_BEGIN]) & validMask) * period / 1000000.0;
+	double pass = ((ticks[GPU_TIMESTAMP_PASS_END] - ticks[GPU_TIMESTAMP_PASS_BEGIN]) & validMask) * period / 1000000.0;
+
+	frameTimes.push_back(frame);
+	passTimes.push_back(pass);
+
+	totalFrameMs += frame;
+	totalFrames++;
+	lastFrameMs = frame;
+
+	if (frameTimes.size() >= GPU_TIMER_HISTORY)
+	{
+		Print();
+		frameTimes.clear();
+		passTimes.clear();
+	}
+}
+
+void GpuTimer::SetTrace(TraceCapture* t)
+{
+	trace = t;
+
+	if (trace != nullptr)
+		trace->SetGpuClock(period, validMask);
+}
+
+void GpuTimer::Begin(VkCommandBuffer cmd, uint32_t slot)
+{
+	if (!supported)
+		return;
+
+	// the last frame of this slot is done,
+	// so its timestamps can be read now
+	ReadSlot(slot);
+
+	// queries have to be reset before they are written again
+	DeviceTable::CmdResetQueryPool(cmd, pool, slot * GPU_TIMESTAMP_COUNT, GPU_TIMESTAMP_COUNT);
+
+	Mark(cmd, slot, GPU_TIMESTAMP_FRAME_BEGIN);
+}
+
+void GpuTimer::Mark(VkCommandBuffer cmd, uint32_t slot, GpuTimestamp timestamp)
+{
+	if (!supported)
+		return;
+
+	// BOTTOM_OF_PIPE waits for every command
+	// before this to completely finish
+	DeviceTable::CmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, slot * GPU_TIMESTAMP_COUNT + timestamp);
+}
+
+void GpuTimer::End(VkCommandBuffer cmd, uint32_t slot)
+{
+	if (!supported)
+		return;
+
+	Mark(cmd, slot, GPU_TIMESTAMP_FRAME_END);
+	written[slot] = true;
+}
+
+GpuTimeStats GpuTimer::GetStats(std::vector<double>& times)
+{
+	GpuTimeStats stats = {};
+
+	if (times.size() == 0)
+		return stats;
+
+	// sorting a copy gives us the min, and the 99th percentile
+	std::vector<double> sorted = times;
+	std::sort(sorted.begin(), sorted.end());
+
+	double sum = 0;
+	for (size_t i = 0; i < sorted.size(); i++)
+		sum += sorted[i];
+
+	stats.min = sorted[0];
+	stats.avg = sum / sorted.size();
+	stats.p99 = sorted[(sorted.size() - 1) * 99 / 100];
+	return stats;
+}
+
+void GpuTimer::Print()
+{
+	if (!supported || frameTimes.size() == 0)
+		return;
+
+	GpuTimeStats frame = GetStats(frameTimes);
+	GpuTimeStats pass = GetStats(passTimes);
+
+	printf("GPU frame: min %.3f ms, avg %.3f ms, p99 %.3f ms | render pass: min %.3f ms, avg %.3f ms, p99 %.3f ms\n",
+		frame.min, frame.avg, frame.p99,
+		pass.min, pass.avg, pass.p99);
+}
+
+double GpuTimer::GetAverageFrameMs()
+{
+	if (totalFrames == 0)
+		return 0;
+
+	return totalFrameMs / totalFrames;
+}
+
+double GpuTimer::GetLastFrameMs()
+{
+	return lastFrameMs;
+}
+
+uint64_t GpuTimer::GetMeasuredFrames()
+{
+	return totalFrames;
+}
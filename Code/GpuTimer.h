@@ -0,0 +1,119 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "TraceCapture.h"
+
+// how many frames of GPU times are kept, the
+// stats are printed each time the history is full
+#define GPU_TIMER_HISTORY 240
+
+// The timestamps that are written in every frame
+enum GpuTimestamp
+{
+	GPU_TIMESTAMP_FRAME_BEGIN,
+	GPU_TIMESTAMP_PASS_BEGIN,
+	GPU_TIMESTAMP_PASS_END,
+	GPU_TIMESTAMP_FRAME_END,
+	GPU_TIMESTAMP_COUNT
+};
+
+// min, average, and 99th percentile, in milliseconds
+struct GpuTimeStats
+{
+	double min;
+	double avg;
+	double p99;
+};
+
+// Measures how long each frame takes on the GPU, with timestamp
+// queries. Each frame slot has its own queries, which are read when
+// that slot is recorded again, frame_lag frames later. The fence of
+// the slot was already waited on by then, so reading never stalls
+class GpuTimer
+{
+private:
+	VkDevice device;
+	VkQueryPool pool;
+	uint32_t slotCount;
+
+	// nanoseconds per timestamp tick, and
+	// the bits of each timestamp that are valid
+	float period;
+	uint64_t validMask;
+
+	// true if the queries of a slot were written,
+	// and have not been read yet
+	std::vector<bool> written;
+
+	// milliseconds of the last GPU_TIMER_HISTORY frames
+	std::vector<double> frameTimes;
+	std::vector<double> passTimes;
+
+	// the sum of every frame that was measured
+	double totalFrameMs;
+	uint64_t totalFrames;
+
+	// the time of the newest frame that was read
+	double lastFrameMs;
+
+	// the timestamps also go to the trace, while it records
+	TraceCapture* trace;
+
+	void ReadSlot(uint32_t slot);
+	GpuTimeStats GetStats(std::vector<double>& times);
+
+public:
+	// false if the queue family can not write timestamps,
+	// then every function here does nothing
+	bool supported;
+
+	GpuTimer(VkDevice d, VkPhysicalDevice gpu, uint32_t queueFamily, uint32_t slots);
+	~GpuTimer();
+
+	// Begin is called first thing in the command buffer of a slot,
+	// End is called last, and Mark is called around the render pass
+	void Begin(VkCommandBuffer cmd, uint32_t slot);
+	void Mark(VkCommandBuffer cmd, uint32_t slot, GpuTimestamp timestamp);
+	void End(VkCommandBuffer cmd, uint32_t slot);
+
+	void Print();
+
+	// nullptr for no trace, the trace gets
+	// the period and valid bits of the clock
+	void SetTrace(TraceCapture* t);
+
+	// the average GPU time of every frame that was measured
+	double GetAverageFrameMs();
+
+	// The time of the newest frame that was measured, and how many
+	// frames were measured so far. When the count changes, there is
+	// a new time, see Demo::update_render_size
+	double GetLastFrameMs();
+	uint64_t GetMeasuredFrames();
+};
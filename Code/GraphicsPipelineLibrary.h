@@ -0,0 +1,101 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+
+// VK_EXT_graphics_pipeline_library and VK_KHR_pipeline_library are newer
+// than the Vulkan headers in the Include folder (1.1.114), so we declare
+// the parts that we use, the same way as PresentWait.h. They are
+// skipped when the headers are new enough
+#ifndef VK_KHR_pipeline_library
+#define VK_KHR_pipeline_library 1
+#define VK_KHR_PIPELINE_LIBRARY_SPEC_VERSION 1
+#define VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME "VK_KHR_pipeline_library"
+
+#define VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR ((VkStructureType)1000290000)
+
+// a pipeline with this flag is a library, which is never bound,
+// it is only linked into other pipelines
+#define VK_PIPELINE_CREATE_LIBRARY_BIT_KHR ((VkPipelineCreateFlagBits)0x00000800)
+
+typedef struct VkPipelineLibraryCreateInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	uint32_t libraryCount;
+	const VkPipeline* pLibraries;
+} VkPipelineLibraryCreateInfoKHR;
+#endif
+
+#ifndef VK_EXT_graphics_pipeline_library
+#define VK_EXT_graphics_pipeline_library 1
+#define VK_EXT_GRAPHICS_PIPELINE_LIBRARY_SPEC_VERSION 1
+#define VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME "VK_EXT_graphics_pipeline_library"
+
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT ((VkStructureType)1000320000)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT ((VkStructureType)1000320001)
+#define VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT ((VkStructureType)1000320002)
+
+// Linking with this flag optimizes across the libraries, which is
+// slower, but as fast to draw with as a whole pipeline. That needs
+// libraries that were made with the RETAIN flag
+#define VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT ((VkPipelineCreateFlagBits)0x00000400)
+#define VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT ((VkPipelineCreateFlagBits)0x00800000)
+
+// the four parts that a graphics pipeline is split into
+typedef enum VkGraphicsPipelineLibraryFlagBitsEXT
+{
+	VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT = 0x00000001,
+	VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT = 0x00000002,
+	VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT = 0x00000004,
+	VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT = 0x00000008,
+	VK_GRAPHICS_PIPELINE_LIBRARY_FLAG_BITS_MAX_ENUM_EXT = 0x7FFFFFFF
+} VkGraphicsPipelineLibraryFlagBitsEXT;
+
+typedef VkFlags VkGraphicsPipelineLibraryFlagsEXT;
+
+typedef struct VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT
+{
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 graphicsPipelineLibrary;
+} VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT;
+
+typedef struct VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT
+{
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 graphicsPipelineLibraryFastLinking;
+	VkBool32 graphicsPipelineLibraryIndependentInterpolationDecoration;
+} VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT;
+
+typedef struct VkGraphicsPipelineLibraryCreateInfoEXT
+{
+	VkStructureType sType;
+	void* pNext;
+	VkGraphicsPipelineLibraryFlagsEXT flags;
+} VkGraphicsPipelineLibraryCreateInfoEXT;
+#endif
@@ -23,6 +23,7 @@ that utilizes Vulkan, see more at http://cemu.info
 */
 
 #include "Helper.h"
+#include "AssetPack.h"
 
 #define _GNU_SOURCE
 #include <stdio.h>
@@ -34,74 +35,14 @@ that utilizes Vulkan, see more at http://cemu.info
 #include <signal.h>
 #include <vector>
 
-void Helper::DbgMsg(char *fmt, ...)
-{
-	va_list va;
-	va_start(va, fmt);
-	vprintf(fmt, va);
-	va_end(va);
-	fflush(stdout);
-}
-
-// This is a common helper function that is used in many Vulkan
-// tutorials. From one tutorial to the next, it does not require
-// a lot of changes
-
-// memory_properties is a structure of VkPhysicalDeviceMemoryProperties
-// which holds arrays of memory types (VkMemoryType), and arrays of memory heaps (VkMemoryHeaps)
-// memoryTypeIndex is an index identifying a memory type from the memoryTypes array
-
-// typeBits are gotten from memory requirements (you'll see that in the buffer classes)
-// requirements_mask tells us if the buffer is on CPU or GPU, and read/write access permissions
-
-bool Helper::memory_type_from_properties(VkPhysicalDeviceMemoryProperties memory_properties, uint32_t requiredBits, VkFlags requirements_mask, uint32_t *typeIndex)
-{
-	// If students have trouble understanding this function, 
-	// don't worry it will never need to be changed
-
-	// Loop through all memory types that are available to us
-	// Search memtypes to find first index of the memoryType array
-	// that has the properties that we need
-
-	// There are usually around 11 types of memory
-	// Here is a list of them
-	// https://www.khronos.org/registry/vulkan/specs/1.1-extensions/man/html/VkMemoryPropertyFlagBits.html
-	// Notice a pattern? The list of types look like this:
-	// 0001 = 1
-	// 0010 = 2
-	// 0100 = 4
-	// 1000 = 8
-	// etc
-
-	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
-	{
-		// Check if this type is needed from VkMemoryRequirements
-		// this checks if the last bit in the byte is 1
-		if ((requiredBits & 1) == 1)
-		{
-			// If we need this type of daa
-			// check to see if this memoryType supports the required
-			// mask (device, local, coherent, etc)
-			if ((memory_properties.memoryTypes[i].propertyFlags & requirements_mask) == requirements_mask)
-			{
-				// if it does, then record this data
-				*typeIndex = i;
-				
-				// we found it, so return true
-				return true;
-			}
-		}
-
-		// this shifts all bits to the right,
-		// notice the pattern of FlagBits
-		requiredBits >>= 1;
-	}
-
-	// No memory types matched, return failure
-	// There is no index in the memoryType array
-	// that supports the memory that we want to allocate
-	return false;
-}
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // This function simply reads a file,
 // records every byte into an array of bytes,
@@ -112,6 +53,14 @@ void Helper::ReadFile(const char* path, char** data, int* size)
 	// open the file 
 	FILE *fp = fopen(path, "rb");
 
+	// if the file does not exist, there is no data
+	if (fp == NULL)
+	{
+		*data = nullptr;
+		*size = 0;
+		return;
+	}
+
 	// Go to the end of the file
 	fseek(fp, 0L, SEEK_END);
 
@@ -133,4 +82,176 @@ void Helper::ReadFile(const char* path, char** data, int* size)
 
 	// close the file
 	fclose(fp);
+}
+
+// This writes an array of bytes to a file,
+// and replaces the file if it already exists.
+// This returns false if the file could not be written
+bool Helper::WriteFile(const char* path, const void* data, size_t size)
+{
+	// open the file
+	FILE *fp = fopen(path, "wb");
+
+	if (fp == NULL)
+		return false;
+
+	// dump every byte from the array
+	// into the file
+	size_t written = fwrite(data, 1, size, fp);
+
+	// close the file
+	fclose(fp);
+
+	return written == size;
+}
+
+MappedFile::MappedFile()
+{
+	data = nullptr;
+	size = 0;
+	file = nullptr;
+	mapping = nullptr;
+	packed = false;
+	owned = nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+	// the pack was mapped when the program started,
+	// so a file in it needs no call to the system at all
+	if (AssetPack::global != nullptr)
+	{
+		const AssetPackEntry* entry = AssetPack::global->Find(path);
+
+		if (entry != nullptr)
+		{
+			const char* stored = AssetPack::global->GetData(entry);
+
+			if (entry->flags & ASSET_PACK_COMPRESSED)
+			{
+				owned = (char*)malloc((size_t)entry->size);
+
+				if (!AssetPack::Decompress(stored, (size_t)entry->storedSize, owned, (size_t)entry->size))
+				{
+					printf("%s is broken in the asset pack\n", path);
+					free(owned);
+					owned = nullptr;
+					return false;
+				}
+
+				stored = owned;
+			}
+
+			packed = true;
+			data = stored;
+			size = (size_t)entry->size;
+			return true;
+		}
+	}
+
+#ifdef _WIN32
+	// open the file, we only read it, from start to end
+	HANDLE fileHandle = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+
+	// a file with nothing in it can not be mapped
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	// make a read-only mapping of the whole file,
+	// and then a view of the whole mapping
+	HANDLE mappingHandle = CreateFileMapping(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (mappingHandle == NULL)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+	if (view == NULL)
+	{
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	file = fileHandle;
+	mapping = mappingHandle;
+	data = (const char*)view;
+	size = (size_t)fileSize.QuadPart;
+#else
+	// the same thing, with mmap
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// the mapping keeps the file open by itself
+	close(fd);
+
+	if (view == MAP_FAILED)
+		return false;
+
+	data = (const char*)view;
+	size = (size_t)info.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data == nullptr)
+		return;
+
+	// the pack stays mapped, only a decompressed copy is ours
+	if (packed)
+	{
+		free(owned);
+		owned = nullptr;
+		packed = false;
+		data = nullptr;
+		size = 0;
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mapping);
+	CloseHandle((HANDLE)file);
+#else
+	munmap((void*)data, size);
+#endif
+
+	data = nullptr;
+	size = 0;
+	file = nullptr;
+	mapping = nullptr;
 }
\ No newline at end of file
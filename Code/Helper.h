@@ -25,6 +25,7 @@ that utilizes Vulkan, see more at http://cemu.info
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vulkan/vk_sdk_platform.h>
+#include "Logger.h"
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 
@@ -46,17 +47,57 @@ that utilizes Vulkan, see more at http://cemu.info
         exit(1);                                                                 \
     } while (0)
 
+// A read-only view of a whole file. The operating system maps the
+// file into our memory, so reading the view reads straight from
+// the file cache, nothing is copied into a buffer of our own.
+// The file is unmapped when the MappedFile is deleted.
+// If the global AssetPack has the path in it, the view is
+// of the blob in the pack instead (see AssetPack)
+class MappedFile
+{
+private:
+	const char* data;
+	size_t size;
+
+	// the file and the mapping, from the operating system
+	void* file;
+	void* mapping;
+
+	// A file from the pack is not mapped by itself, data points into
+	// the mapping of the pack, or into owned, if the blob was compressed
+	bool packed;
+	char* owned;
+
+	// a MappedFile can not be copied, because
+	// both copies would unmap the same view
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	// returns false if the file does not exist, or is empty
+	bool Open(const char* path);
+	void Close();
+
+	const char* GetData() { return data; }
+	size_t GetSize() { return size; }
+};
+
 class Helper
 {
 public:
-	static void DbgMsg(char *fmt, ...);
-
-	static bool memory_type_from_properties(
-		VkPhysicalDeviceMemoryProperties memory_properties,
-		uint32_t typeBits,
-		VkFlags requirements_mask,
-		uint32_t *typeIndex);
-	
+	// Formats like printf, but on the logging thread, this
+	// thread only copies the arguments (see Logger.h)
+	template<typename... Args>
+	static void DbgMsg(const char* fmt, Args... args)
+	{
+		Logger::Write(fmt, args...);
+	}
+
 	static void ReadFile(const char* path, char** data, int* size);
+
+	static bool WriteFile(const char* path, const void* data, size_t size);
 };
 
@@ -0,0 +1,173 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "HiZPass.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <string.h>
+
+HiZPass::HiZPass(VkDevice d, VkPipelineCache cache, SamplerCache* samplers)
+{
+	device = d;
+
+	// The shader reads the level above (or the depth buffer) at
+	// binding 0, and writes one level at binding 1
+	VkDescriptorSetLayoutBinding bindings[2];
+	memset(bindings, 0, sizeof(bindings));
+
+	bindings[0].binding = 0;
+	bindings[0].descriptorCount = 1;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorCount = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+	vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &reduceLayout);
+
+	// the size of the level that is read, and
+	// the level that is written, are push constants
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(HiZConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &reduceLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &pipelineLayoutInfo, HostAllocator::callbacks, &pipelineLayout);
+
+	// Compute Shader compiled to header, see compileShaders.cmd
+	const unsigned char cs_code[] = {
+		#include "cube_hiz.comp.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = (uint32_t*)cs_code;
+	shaderInfo.codeSize = sizeof(cs_code);
+
+	VkShaderModule module;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &module);
+
+	VkComputePipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeInfo.stage.module = module;
+	pipeInfo.stage.pName = "main";
+	pipeInfo.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the depth pyramid pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, module, HostAllocator::callbacks);
+
+	// The sampler comes from the cache, like every other sampler,
+	// so the cache destroys it, not us
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	sampler = samplers->Get(samplerInfo);
+}
+
+HiZPass::~HiZPass()
+{
+	vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+	vkDestroyDescriptorSetLayout(device, reduceLayout, HostAllocator::callbacks);
+}
+
+void HiZPass::Build(VkCommandBuffer cmd, HiZPyramid* pyramid)
+{
+	// The frame graph already waited for the render pass of the last
+	// frame to write the depth buffer, and for the culling pass of the
+	// last frame to read the pyramid, and the pyramid is in GENERAL
+	// (see Demo::record_cmd), so the levels can be written right away
+
+	// Nothing has drawn into this depth buffer yet (it was just made),
+	// so there is nothing to read, and the culling pass can not use
+	// the pyramid in this frame. The pyramid is still in GENERAL
+	// now, which is the layout that the culling set expects
+	pyramid->ready = pyramid->hasDepth;
+	pyramid->hasDepth = true;
+
+	if (!pyramid->ready)
+		return;
+
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+	// each level reads the level that was just written
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	for (uint32_t i = 0; i < pyramid->levels; i++)
+	{
+		HiZConstants constants;
+		constants.sourceWidth = (int32_t)((i == 0) ? pyramid->depthWidth : pyramid->GetLevelWidth(i - 1));
+		constants.sourceHeight = (int32_t)((i == 0) ? pyramid->depthHeight : pyramid->GetLevelHeight(i - 1));
+		constants.destWidth = (int32_t)pyramid->GetLevelWidth(i);
+		constants.destHeight = (int32_t)pyramid->GetLevelHeight(i);
+
+		DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &pyramid->reduceSets[i], 0, NULL);
+		DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZConstants), &constants);
+
+		DeviceTable::CmdDispatch(cmd,
+			(constants.destWidth + HIZ_WORKGROUP_SIZE - 1) / HIZ_WORKGROUP_SIZE,
+			(constants.destHeight + HIZ_WORKGROUP_SIZE - 1) / HIZ_WORKGROUP_SIZE,
+			1);
+
+		// after the last level, the frame graph waits
+		// for the pyramid, with the culling pass's barriers
+		if (i + 1 == pyramid->levels)
+			break;
+
+		DeviceTable::CmdPipelineBarrier(cmd,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, NULL, 0, NULL);
+	}
+}
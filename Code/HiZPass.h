@@ -0,0 +1,73 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "HiZPyramid.h"
+#include "SamplerCache.h"
+
+// the size of the workgroups of the reduce shader,
+// it must match local_size_x and local_size_y
+#define HIZ_WORKGROUP_SIZE 8
+
+// This is given to the reduce shader with push
+// constants, it must match ReduceVals in cube_hiz.comp
+struct HiZConstants
+{
+	int32_t sourceWidth;
+	int32_t sourceHeight;
+	int32_t destWidth;
+	int32_t destHeight;
+};
+
+// Makes the depth pyramid of the last frame's depth buffer, with a
+// compute shader that runs once for every level. The pipeline does not
+// depend on the size of the window, so it is made once, and the pyramid
+// (which does depend on it) is made with the depth buffer, see HiZPyramid
+class HiZPass
+{
+private:
+	VkDevice device;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+public:
+	// every pyramid allocates its sets with this layout
+	VkDescriptorSetLayout reduceLayout;
+
+	// a NEAREST sampler, depth formats might not be
+	// filterable, and texelFetch never filters anyway
+	VkSampler sampler;
+
+	HiZPass(VkDevice d, VkPipelineCache cache, SamplerCache* samplers);
+	~HiZPass();
+
+	// This must be recorded outside of a render pass, before
+	// the render pass that draws into the depth buffer again.
+	// It only has the barriers between its own levels, the
+	// barriers before and after it come from the frame graph
+	void Build(VkCommandBuffer cmd, HiZPyramid* pyramid);
+};
@@ -0,0 +1,202 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "HiZPyramid.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <string.h>
+
+HiZPyramid::HiZPyramid(
+	VkDevice d,
+	MemoryAllocator* a,
+	VkDescriptorSetLayout reduceLayout,
+	VkDescriptorSetLayout cullLayout,
+	VkSampler sampler,
+	TextureGPU* depthBuffer,
+	uint32_t width,
+	uint32_t height)
+{
+	device = d;
+	depthWidth = width;
+	depthHeight = height;
+	hasDepth = false;
+	ready = false;
+
+	// Each level is half the size of the one above it, rounded
+	// up, so that the last texel of an odd size is not lost. The
+	// last level is 1x1, one texel for the whole screen
+	levels = 1;
+	while (GetLevelWidth(levels - 1) > 1 || GetLevelHeight(levels - 1) > 1)
+		levels++;
+
+	// The pyramid is written by a compute shader (STORAGE),
+	// and read by the next level and the culling shader (SAMPLED)
+	VkImageCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	info.imageType = VK_IMAGE_TYPE_2D;
+	info.format = VK_FORMAT_R32_SFLOAT;
+	info.extent.width = GetLevelWidth(0);
+	info.extent.height = GetLevelHeight(0);
+	info.extent.depth = 1;
+	info.mipLevels = levels;
+	info.arrayLayers = 1;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	image = new TextureGPU(device, a, info, VK_IMAGE_ASPECT_COLOR_BIT);
+	image->SetName("Depth pyramid");
+	image->format = info.format;
+
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = info.format;
+	viewInfo.image = image->image;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	levelViews.resize(levels);
+
+	for (uint32_t i = 0; i < levels; i++)
+	{
+		viewInfo.subresourceRange.baseMipLevel = i;
+		vkCreateImageView(device, &viewInfo, HostAllocator::callbacks, &levelViews[i]);
+	}
+
+	// the depth buffer is read with the depth aspect only,
+	// even if its format has stencil
+	viewInfo.format = depthBuffer->format;
+	viewInfo.image = depthBuffer->image;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	vkCreateImageView(device, &viewInfo, HostAllocator::callbacks, &depthView);
+
+	// Every level has a set with the level that it reads, and the
+	// level that it writes, and the culling shader has one more set
+	VkDescriptorPoolSize poolSizes[2];
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = levels + 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = levels;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = levels + 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &descPool);
+
+	std::vector<VkDescriptorSetLayout> layouts(levels, reduceLayout);
+	reduceSets.resize(levels);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descPool;
+	allocInfo.descriptorSetCount = levels;
+	allocInfo.pSetLayouts = layouts.data();
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, reduceSets.data());
+
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &cullLayout;
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, &cullSet);
+
+	// The pyramid stays in GENERAL, so that a level can be written,
+	// and then read by the next level, without changing its layout.
+	// The render pass leaves the depth buffer in DEPTH_STENCIL_READ_ONLY
+	std::vector<VkDescriptorImageInfo> imageInfos(levels * 2 + 1);
+	std::vector<VkWriteDescriptorSet> writes(levels * 2 + 1);
+	memset(writes.data(), 0, writes.size() * sizeof(VkWriteDescriptorSet));
+
+	for (uint32_t i = 0; i < levels; i++)
+	{
+		VkDescriptorImageInfo& source = imageInfos[i * 2];
+		source.sampler = sampler;
+		source.imageView = (i == 0) ? depthView : levelViews[i - 1];
+		source.imageLayout = (i == 0) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo& dest = imageInfos[i * 2 + 1];
+		dest.sampler = VK_NULL_HANDLE;
+		dest.imageView = levelViews[i];
+		dest.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		for (uint32_t j = 0; j < 2; j++)
+		{
+			VkWriteDescriptorSet& write = writes[i * 2 + j];
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = reduceSets[i];
+			write.dstBinding = j;
+			write.descriptorCount = 1;
+			write.descriptorType = (j == 0) ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			write.pImageInfo = &imageInfos[i * 2 + j];
+		}
+	}
+
+	VkDescriptorImageInfo& whole = imageInfos[levels * 2];
+	whole.sampler = sampler;
+	whole.imageView = image->imageView;
+	whole.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet& cullWrite = writes[levels * 2];
+	cullWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	cullWrite.dstSet = cullSet;
+	cullWrite.dstBinding = 0;
+	cullWrite.descriptorCount = 1;
+	cullWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	cullWrite.pImageInfo = &whole;
+
+	DeviceTable::UpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, NULL);
+}
+
+HiZPyramid::~HiZPyramid()
+{
+	// destroying the pool also frees the sets
+	vkDestroyDescriptorPool(device, descPool, HostAllocator::callbacks);
+
+	for (uint32_t i = 0; i < levels; i++)
+		vkDestroyImageView(device, levelViews[i], HostAllocator::callbacks);
+
+	vkDestroyImageView(device, depthView, HostAllocator::callbacks);
+	delete image;
+}
+
+uint32_t HiZPyramid::GetLevelWidth(uint32_t level)
+{
+	// level 0 is already half of the depth buffer
+	uint32_t w = depthWidth;
+	for (uint32_t i = 0; i <= level; i++)
+		w = (w + 1) / 2;
+	return w;
+}
+
+uint32_t HiZPyramid::GetLevelHeight(uint32_t level)
+{
+	uint32_t h = depthHeight;
+	for (uint32_t i = 0; i <= level; i++)
+		h = (h + 1) / 2;
+	return h;
+}
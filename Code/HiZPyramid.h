@@ -0,0 +1,92 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "TextureGPU.h"
+
+// The depth pyramid (Hi-Z) of one depth buffer. Level 0 is half as
+// wide and half as tall as the depth buffer, and every texel keeps the
+// farthest depth of the 2x2 texels under it, so one texel of a small
+// level says how far away everything in a big part of the screen is.
+// It depends on the size of the window, just like the depth buffer,
+// so it is made again (and retired) with the depth buffer
+class HiZPyramid
+{
+private:
+	VkDevice device;
+	VkDescriptorPool descPool;
+
+public:
+	// R32_SFLOAT, with every level, its imageView has every
+	// level too, which is what the culling shader reads
+	TextureGPU* image;
+
+	// one view for each level, each level is written
+	// by itself, and read to make the next level
+	std::vector<VkImageView> levelViews;
+
+	// the depth buffer, with only the depth aspect,
+	// because a sampled view can only have one aspect
+	VkImageView depthView;
+
+	// one set for each level, the level above it (or the
+	// depth buffer), and the level that is written
+	std::vector<VkDescriptorSet> reduceSets;
+
+	// the set that the culling shader reads the pyramid with
+	VkDescriptorSet cullSet;
+
+	uint32_t depthWidth;
+	uint32_t depthHeight;
+	uint32_t levels;
+
+	// false until a frame has drawn into the depth buffer,
+	// before that, there is nothing to make the pyramid from
+	bool hasDepth;
+
+	// true if the pyramid was made in the frame that is
+	// being recorded, then the culling pass can read it
+	bool ready;
+
+	HiZPyramid(
+		VkDevice d,
+		MemoryAllocator* a,
+		VkDescriptorSetLayout reduceLayout,
+		VkDescriptorSetLayout cullLayout,
+		VkSampler sampler,
+		TextureGPU* depthBuffer,
+		uint32_t width,
+		uint32_t height);
+
+	~HiZPyramid();
+
+	// the size of a level of the pyramid
+	uint32_t GetLevelWidth(uint32_t level);
+	uint32_t GetLevelHeight(uint32_t level);
+};
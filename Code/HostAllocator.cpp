@@ -0,0 +1,243 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "HostAllocator.h"
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+
+// The driver tells us the size and the alignment of an allocation, but
+// not the size of a free or of a reallocation, so every allocation has
+// this header right in front of it. The header is 16 bytes, and the
+// memory in front of the allocation is a multiple of the alignment, so
+// the header always fits, and the allocation stays aligned
+struct HostHeader
+{
+	uint64_t size;
+
+	// from the start of the chunk (or the _aligned_malloc
+	// block) to the allocation, which is after the header
+	uint32_t offset;
+
+	// the pool, or HOST_POOL_CLASS_COUNT if
+	// it came straight from _aligned_malloc
+	uint8_t sizeClass;
+	uint8_t scope;
+	uint16_t unused;
+};
+
+void* HostAllocator::freeChunks[HOST_POOL_CLASS_COUNT] = {};
+std::mutex HostAllocator::lock;
+VkAllocationCallbacks HostAllocator::table = {};
+const VkAllocationCallbacks* HostAllocator::callbacks = NULL;
+HostScopeStats HostAllocator::scopes[HOST_SCOPE_COUNT] = {};
+uint64_t HostAllocator::pageBytes = 0;
+
+static const char* scope_names[HOST_SCOPE_COUNT] = { "Command", "Object", "Cache", "Device", "Instance" };
+
+void HostAllocator::Enable()
+{
+	table.pUserData = NULL;
+	table.pfnAllocation = Allocate;
+	table.pfnReallocation = Reallocate;
+	table.pfnFree = Free;
+	table.pfnInternalAllocation = InternalAllocate;
+	table.pfnInternalFree = InternalFree;
+
+	callbacks = &table;
+}
+
+void* HostAllocator::TakeChunk(uint32_t sizeClass)
+{
+	if (freeChunks[sizeClass] == nullptr)
+	{
+		// Cut a new page into chunks. The page starts at a multiple
+		// of the biggest chunk size, and every chunk starts at a
+		// multiple of its size, so a chunk is aligned to its size
+		size_t chunkSize = (size_t)HOST_POOL_MIN_SIZE << sizeClass;
+		uint8_t* page = (uint8_t*)_aligned_malloc(HOST_POOL_PAGE_SIZE, HOST_POOL_MAX_SIZE);
+
+		if (page == nullptr)
+			return nullptr;
+
+		pageBytes += HOST_POOL_PAGE_SIZE;
+
+		for (size_t offset = 0; offset < HOST_POOL_PAGE_SIZE; offset += chunkSize)
+		{
+			void** chunk = (void**)(page + offset);
+			*chunk = freeChunks[sizeClass];
+			freeChunks[sizeClass] = chunk;
+		}
+	}
+
+	void** chunk = (void**)freeChunks[sizeClass];
+	freeChunks[sizeClass] = *chunk;
+	return chunk;
+}
+
+// pUserData is always NULL, see HostAllocator::Enable,
+// so the callbacks that do not pass it on leave it unnamed
+void* VKAPI_PTR HostAllocator::Allocate(void*, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (size == 0)
+		return nullptr;
+
+	// the header goes into the space in front of the
+	// allocation, which is a multiple of the alignment
+	if (alignment < sizeof(HostHeader))
+		alignment = sizeof(HostHeader);
+
+	size_t offset = alignment;
+	size_t needed = offset + size;
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	// the smallest pool that fits, a chunk is aligned to its
+	// size, so it also has to be as big as the alignment
+	uint32_t sizeClass = 0;
+	while (sizeClass < HOST_POOL_CLASS_COUNT && ((size_t)HOST_POOL_MIN_SIZE << sizeClass) < needed)
+		sizeClass++;
+
+	uint8_t* base = nullptr;
+
+	if (sizeClass < HOST_POOL_CLASS_COUNT)
+		base = (uint8_t*)TakeChunk(sizeClass);
+	else
+		base = (uint8_t*)_aligned_malloc(needed, alignment);
+
+	// the driver handles this as VK_ERROR_OUT_OF_HOST_MEMORY
+	if (base == nullptr)
+		return nullptr;
+
+	uint8_t* memory = base + offset;
+
+	HostHeader* header = (HostHeader*)memory - 1;
+	header->size = size;
+	header->offset = (uint32_t)offset;
+	header->sizeClass = (uint8_t)sizeClass;
+	header->scope = (uint8_t)scope;
+
+	HostScopeStats& s = scopes[scope];
+	s.bytes += size;
+	s.liveCount++;
+	s.totalCount++;
+
+	if (s.bytes > s.peakBytes)
+		s.peakBytes = s.bytes;
+
+	return memory;
+}
+
+void* VKAPI_PTR HostAllocator::Reallocate(void* user, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (original == nullptr)
+		return Allocate(user, size, alignment, scope);
+
+	if (size == 0)
+	{
+		Free(user, original);
+		return nullptr;
+	}
+
+	// If it fails, the original allocation has to stay as it was.
+	// Pools can not grow a chunk in place, so it is always a copy
+	void* memory = Allocate(user, size, alignment, scope);
+
+	if (memory == nullptr)
+		return nullptr;
+
+	HostHeader* header = (HostHeader*)original - 1;
+	memcpy(memory, original, (size_t)(header->size < size ? header->size : size));
+
+	Free(user, original);
+	return memory;
+}
+
+void VKAPI_PTR HostAllocator::Free(void*, void* memory)
+{
+	if (memory == nullptr)
+		return;
+
+	HostHeader* header = (HostHeader*)memory - 1;
+	uint8_t* base = (uint8_t*)memory - header->offset;
+	uint32_t sizeClass = header->sizeClass;
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	HostScopeStats& s = scopes[header->scope];
+	s.bytes -= header->size;
+	s.liveCount--;
+
+	// the chunk goes back to the front of its pool,
+	// so the next allocation gets memory that is in the cache
+	if (sizeClass < HOST_POOL_CLASS_COUNT)
+	{
+		void** chunk = (void**)base;
+		*chunk = freeChunks[sizeClass];
+		freeChunks[sizeClass] = chunk;
+	}
+	else
+		_aligned_free(base);
+}
+
+void VKAPI_PTR HostAllocator::InternalAllocate(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	scopes[scope].internalBytes += size;
+}
+
+void VKAPI_PTR HostAllocator::InternalFree(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	scopes[scope].internalBytes -= size;
+}
+
+void HostAllocator::PrintReport()
+{
+	if (callbacks == NULL)
+		return;
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	printf("Driver host memory, %llu KB in pool pages:\n", (unsigned long long)(pageBytes >> 10));
+
+	for (uint32_t i = 0; i < HOST_SCOPE_COUNT; i++)
+	{
+		HostScopeStats& s = scopes[i];
+
+		if (s.totalCount == 0 && s.internalBytes == 0)
+			continue;
+
+		// if "live" keeps going up while nothing new is made,
+		// something is not being destroyed
+		printf("  %s: %llu KB (peak %llu KB), %llu live, %llu total, %llu KB internal\n",
+			scope_names[i],
+			(unsigned long long)(s.bytes >> 10),
+			(unsigned long long)(s.peakBytes >> 10),
+			(unsigned long long)s.liveCount,
+			(unsigned long long)s.totalCount,
+			(unsigned long long)(s.internalBytes >> 10));
+	}
+}
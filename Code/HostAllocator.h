@@ -0,0 +1,107 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <stdint.h>
+#include <mutex>
+
+// Allocations up to this size come from pools, one pool for each
+// power of two, the smallest is HOST_POOL_MIN_SIZE. Bigger ones
+// go straight to _aligned_malloc, those are rare, and usually stay
+#define HOST_POOL_MIN_SIZE 32
+#define HOST_POOL_MAX_SIZE 4096
+#define HOST_POOL_CLASS_COUNT 8
+
+// each pool gets more chunks by this many bytes at a time
+#define HOST_POOL_PAGE_SIZE (64 * 1024)
+
+// the count of VkSystemAllocationScope values
+#define HOST_SCOPE_COUNT 5
+
+// What the driver has allocated for one VkSystemAllocationScope
+// (command, object, cache, device, instance)
+struct HostScopeStats
+{
+	// the bytes that are allocated right now, and
+	// the most that were ever allocated at once
+	uint64_t bytes;
+	uint64_t peakBytes;
+
+	// allocations that are not freed yet, and every
+	// allocation since the start (with reallocations)
+	uint64_t liveCount;
+	uint64_t totalCount;
+
+	// memory that the driver allocated by itself (like executable
+	// memory for shaders), it only tells us about it
+	uint64_t internalBytes;
+};
+
+// The driver allocates CPU memory for every object that we make, and
+// for every command that we record. Every vkCreate, vkAllocate, vkDestroy
+// and vkFree call gives HostAllocator::callbacks as its pAllocator, which
+// is NULL (so the driver uses its own heap) until Enable is called.
+// Then the small allocations come from size-class pools, and every
+// allocation is counted by its scope, so we can see how much memory
+// the driver uses, and if it keeps growing in a long run.
+// Enable must be called before the instance is made, because an object
+// has to be destroyed with the same callbacks that made it
+class HostAllocator
+{
+private:
+	// the free chunks of each pool, a free chunk
+	// holds the pointer to the next free chunk
+	static void* freeChunks[HOST_POOL_CLASS_COUNT];
+
+	// the driver can allocate on any thread
+	static std::mutex lock;
+
+	static VkAllocationCallbacks table;
+
+	static void* VKAPI_PTR Allocate(void* user, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void* VKAPI_PTR Reallocate(void* user, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void VKAPI_PTR Free(void* user, void* memory);
+	static void VKAPI_PTR InternalAllocate(void* user, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static void VKAPI_PTR InternalFree(void* user, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+	static void* TakeChunk(uint32_t sizeClass);
+
+public:
+	// NULL until Enable is called
+	static const VkAllocationCallbacks* callbacks;
+
+	static HostScopeStats scopes[HOST_SCOPE_COUNT];
+
+	// pages that the pools took from _aligned_malloc, the pools
+	// keep them until the program ends, and use them again
+	static uint64_t pageBytes;
+
+	static void Enable();
+
+	// a line for each scope that was used, like "Object: 120 KB"
+	static void PrintReport();
+};
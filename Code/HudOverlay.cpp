@@ -0,0 +1,427 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "HudOverlay.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <string.h>
+
+// A 5 by 7 font, for the characters from ' ' to '_', lower case
+// letters are drawn as upper case. Each letter is 5 columns from left
+// to right, and in each column, the lowest bit is the top row
+static const uint8_t hud_font[][5] =
+{
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+	{ 0x00, 0x00, 0x5F, 0x00, 0x00 }, // '!'
+	{ 0x00, 0x07, 0x00, 0x07, 0x00 }, // '"'
+	{ 0x14, 0x7F, 0x14, 0x7F, 0x14 }, // '#'
+	{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, // '$'
+	{ 0x23, 0x13, 0x08, 0x64, 0x62 }, // '%'
+	{ 0x36, 0x49, 0x55, 0x22, 0x50 }, // '&'
+	{ 0x00, 0x05, 0x03, 0x00, 0x00 }, // '''
+	{ 0x00, 0x1C, 0x22, 0x41, 0x00 }, // '('
+	{ 0x00, 0x41, 0x22, 0x1C, 0x00 }, // ')'
+	{ 0x14, 0x08, 0x3E, 0x08, 0x14 }, // '*'
+	{ 0x08, 0x08, 0x3E, 0x08, 0x08 }, // '+'
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, // ','
+	{ 0x08, 0x08, 0x08, 0x08, 0x08 }, // '-'
+	{ 0x00, 0x60, 0x60, 0x00, 0x00 }, // '.'
+	{ 0x20, 0x10, 0x08, 0x04, 0x02 }, // '/'
+	{ 0x3E, 0x51, 0x49, 0x45, 0x3E }, // '0'
+	{ 0x00, 0x42, 0x7F, 0x40, 0x00 }, // '1'
+	{ 0x42, 0x61, 0x51, 0x49, 0x46 }, // '2'
+	{ 0x21, 0x41, 0x45, 0x4B, 0x31 }, // '3'
+	{ 0x18, 0x14, 0x12, 0x7F, 0x10 }, // '4'
+	{ 0x27, 0x45, 0x45, 0x45, 0x39 }, // '5'
+	{ 0x3C, 0x4A, 0x49, 0x49, 0x30 }, // '6'
+	{ 0x01, 0x71, 0x09, 0x05, 0x03 }, // '7'
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, // '8'
+	{ 0x06, 0x49, 0x49, 0x29, 0x1E }, // '9'
+	{ 0x00, 0x36, 0x36, 0x00, 0x00 }, // ':'
+	{ 0x00, 0x56, 0x36, 0x00, 0x00 }, // ';'
+	{ 0x08, 0x14, 0x22, 0x41, 0x00 }, // '<'
+	{ 0x14, 0x14, 0x14, 0x14, 0x14 }, // '='
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 }, // '>'
+	{ 0x02, 0x01, 0x51, 0x09, 0x06 }, // '?'
+	{ 0x32, 0x49, 0x79, 0x41, 0x3E }, // '@'
+	{ 0x7E, 0x11, 0x11, 0x11, 0x7E }, // 'A'
+	{ 0x7F, 0x49, 0x49, 0x49, 0x36 }, // 'B'
+	{ 0x3E, 0x41, 0x41, 0x41, 0x22 }, // 'C'
+	{ 0x7F, 0x41, 0x41, 0x22, 0x1C }, // 'D'
+	{ 0x7F, 0x49, 0x49, 0x49, 0x41 }, // 'E'
+	{ 0x7F, 0x09, 0x09, 0x09, 0x01 }, // 'F'
+	{ 0x3E, 0x41, 0x49, 0x49, 0x7A }, // 'G'
+	{ 0x7F, 0x08, 0x08, 0x08, 0x7F }, // 'H'
+	{ 0x00, 0x41, 0x7F, 0x41, 0x00 }, // 'I'
+	{ 0x20, 0x40, 0x41, 0x3F, 0x01 }, // 'J'
+	{ 0x7F, 0x08, 0x14, 0x22, 0x41 }, // 'K'
+	{ 0x7F, 0x40, 0x40, 0x40, 0x40 }, // 'L'
+	{ 0x7F, 0x02, 0x0C, 0x02, 0x7F }, // 'M'
+	{ 0x7F, 0x04, 0x08, 0x10, 0x7F }, // 'N'
+	{ 0x3E, 0x41, 0x41, 0x41, 0x3E }, // 'O'
+	{ 0x7F, 0x09, 0x09, 0x09, 0x06 }, // 'P'
+	{ 0x3E, 0x41, 0x51, 0x21, 0x5E }, // 'Q'
+	{ 0x7F, 0x09, 0x19, 0x29, 0x46 }, // 'R'
+	{ 0x46, 0x49, 0x49, 0x49, 0x31 }, // 'S'
+	{ 0x01, 0x01, 0x7F, 0x01, 0x01 }, // 'T'
+	{ 0x3F, 0x40, 0x40, 0x40, 0x3F }, // 'U'
+	{ 0x1F, 0x20, 0x40, 0x20, 0x1F }, // 'V'
+	{ 0x3F, 0x40, 0x38, 0x40, 0x3F }, // 'W'
+	{ 0x63, 0x14, 0x08, 0x14, 0x63 }, // 'X'
+	{ 0x07, 0x08, 0x70, 0x08, 0x07 }, // 'Y'
+	{ 0x61, 0x51, 0x49, 0x45, 0x43 }, // 'Z'
+	{ 0x00, 0x7F, 0x41, 0x41, 0x00 }, // '['
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, // '\\'
+	{ 0x00, 0x41, 0x41, 0x7F, 0x00 }, // ']'
+	{ 0x04, 0x02, 0x01, 0x02, 0x04 }, // '^'
+	{ 0x40, 0x40, 0x40, 0x40, 0x40 }, // '_'
+};
+
+// the colors of the text, and of the panel behind it, which lets
+// some of the scene through, in R8G8B8A8_UNORM (red is the lowest byte)
+#define HUD_TEXT_COLOR 0xFFFFFFFF
+#define HUD_PANEL_COLOR 0xB0000000
+#define HUD_PANEL_BIT 0x80000000
+
+HudOverlay::HudOverlay(VkDevice d, MemoryAllocator* a, VkFormat format, uint32_t frameLag)
+{
+	device = d;
+	pipelineLayout = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+
+	// The image already has the finished frame in it, so it is loaded,
+	// and the HUD is blended on top. The frame graph puts the image into
+	// COLOR_ATTACHMENT_OPTIMAL before, and into PRESENT_SRC after
+	VkAttachmentDescription attachment = {};
+	attachment.format = format;
+	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorReference = {};
+	colorReference.attachment = 0;
+	colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorReference;
+
+	VkRenderPassCreateInfo rpInfo = {};
+	rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	rpInfo.attachmentCount = 1;
+	rpInfo.pAttachments = &attachment;
+	rpInfo.subpassCount = 1;
+	rpInfo.pSubpasses = &subpass;
+
+	if (vkCreateRenderPass(device, &rpInfo, HostAllocator::callbacks, &renderPass) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the render pass of the HUD\n", "Render Pass Failure");
+	}
+
+	// The letters are written every frame, straight into mapped
+	// memory, there are only a few hundred of them
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	bufferInfo.size = (VkDeviceSize)frameLag * HUD_MAX_GLYPHS * sizeof(HudGlyph);
+
+	glyphBuffer = BufferCPU(device, a, bufferInfo, true);
+	glyphBuffer.SetName("HUD glyphs");
+
+	glyphCounts.resize(frameLag, 0);
+}
+
+HudOverlay::~HudOverlay()
+{
+	glyphBuffer.Destroy();
+
+	if (pipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	if (pipelineLayout != VK_NULL_HANDLE)
+		vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+
+	vkDestroyRenderPass(device, renderPass, HostAllocator::callbacks);
+}
+
+void HudOverlay::PreparePipeline(VkPipelineCache cache)
+{
+	// nothing is bound but the instances
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	vkCreatePipelineLayout(device, &layoutInfo, HostAllocator::callbacks, &pipelineLayout);
+
+	// Shaders compiled to header, see compileShaders.cmd
+	const unsigned char vs_code[] = {
+		#include "hud.vert.inc"
+	};
+
+	const unsigned char fs_code[] = {
+		#include "hud.frag.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+
+	VkShaderModule vertModule;
+	shaderInfo.pCode = (uint32_t*)vs_code;
+	shaderInfo.codeSize = sizeof(vs_code);
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &vertModule);
+
+	VkShaderModule fragModule;
+	shaderInfo.pCode = (uint32_t*)fs_code;
+	shaderInfo.codeSize = sizeof(fs_code);
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &fragModule);
+
+	VkPipelineShaderStageCreateInfo stages[2] = {};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = vertModule;
+	stages[0].pName = "main";
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = fragModule;
+	stages[1].pName = "main";
+
+	// one HudGlyph for each instance, the corners
+	// of the quad come from the vertex index
+	VkVertexInputBindingDescription binding = {};
+	binding.binding = 0;
+	binding.stride = sizeof(HudGlyph);
+	binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	VkVertexInputAttributeDescription attributes[3] = {};
+	attributes[0].location = 0;
+	attributes[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	attributes[0].offset = offsetof(HudGlyph, x);
+	attributes[1].location = 1;
+	attributes[1].format = VK_FORMAT_R32G32_UINT;
+	attributes[1].offset = offsetof(HudGlyph, bits);
+	attributes[2].location = 2;
+	attributes[2].format = VK_FORMAT_R8G8B8A8_UNORM;
+	attributes[2].offset = offsetof(HudGlyph, color);
+
+	VkPipelineVertexInputStateCreateInfo vi = {};
+	vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vi.vertexBindingDescriptionCount = 1;
+	vi.pVertexBindingDescriptions = &binding;
+	vi.vertexAttributeDescriptionCount = 3;
+	vi.pVertexAttributeDescriptions = attributes;
+
+	VkPipelineInputAssemblyStateCreateInfo ia = {};
+	ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+	// the size of the window changes, the pipeline does not
+	VkPipelineViewportStateCreateInfo vp = {};
+	vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	vp.viewportCount = 1;
+	vp.scissorCount = 1;
+
+	VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkPipelineRasterizationStateCreateInfo rs = {};
+	rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rs.polygonMode = VK_POLYGON_MODE_FILL;
+	rs.cullMode = VK_CULL_MODE_NONE;
+	rs.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rs.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo ms = {};
+	ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// the panel is see-through, the text is not
+	VkPipelineColorBlendAttachmentState blend = {};
+	blend.blendEnable = VK_TRUE;
+	blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	blend.colorBlendOp = VK_BLEND_OP_ADD;
+	blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	blend.alphaBlendOp = VK_BLEND_OP_ADD;
+	blend.colorWriteMask = 0xF;
+
+	VkPipelineColorBlendStateCreateInfo cb = {};
+	cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	cb.attachmentCount = 1;
+	cb.pAttachments = &blend;
+
+	VkGraphicsPipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeInfo.stageCount = 2;
+	pipeInfo.pStages = stages;
+	pipeInfo.pVertexInputState = &vi;
+	pipeInfo.pInputAssemblyState = &ia;
+	pipeInfo.pViewportState = &vp;
+	pipeInfo.pRasterizationState = &rs;
+	pipeInfo.pMultisampleState = &ms;
+	pipeInfo.pColorBlendState = &cb;
+	pipeInfo.pDynamicState = &dynamicState;
+	pipeInfo.layout = pipelineLayout;
+	pipeInfo.renderPass = renderPass;
+
+	if (vkCreateGraphicsPipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the HUD pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, vertModule, HostAllocator::callbacks);
+	vkDestroyShaderModule(device, fragModule, HostAllocator::callbacks);
+}
+
+VkFramebuffer HudOverlay::CreateFramebuffer(VkImageView view, uint32_t width, uint32_t height)
+{
+	VkFramebufferCreateInfo fbInfo = {};
+	fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	fbInfo.renderPass = renderPass;
+	fbInfo.attachmentCount = 1;
+	fbInfo.pAttachments = &view;
+	fbInfo.width = width;
+	fbInfo.height = height;
+	fbInfo.layers = 1;
+
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	vkCreateFramebuffer(device, &fbInfo, HostAllocator::callbacks, &framebuffer);
+	return framebuffer;
+}
+
+HudGlyph* HudOverlay::GetSlice(uint32_t slot)
+{
+	return (HudGlyph*)glyphBuffer.GetPointer() + (size_t)slot * HUD_MAX_GLYPHS;
+}
+
+void HudOverlay::GetGlyphBits(char c, uint32_t bits[2])
+{
+	if (c >= 'a' && c <= 'z')
+		c = c - 'a' + 'A';
+
+	// anything that is not in the font is a space
+	if (c < ' ' || c > '_')
+		c = ' ';
+
+	const uint8_t* columns = hud_font[c - ' '];
+	bits[0] = columns[0] | (columns[1] << 8) | (columns[2] << 16) | ((uint32_t)columns[3] << 24);
+	bits[1] = columns[4];
+}
+
+void HudOverlay::SetText(uint32_t slot, const char* text, uint32_t width, uint32_t height)
+{
+	HudGlyph* glyphs = GetSlice(slot);
+
+	// from pixels to clip space, where the top left corner is (-1, -1)
+	float scaleX = 2.0f / width;
+	float scaleY = 2.0f / height;
+	float cellWidth = HUD_CELL_WIDTH * HUD_SCALE * scaleX;
+	float cellHeight = HUD_CELL_HEIGHT * HUD_SCALE * scaleY;
+	float left = HUD_MARGIN * scaleX - 1.0f;
+	float top = HUD_MARGIN * scaleY - 1.0f;
+
+	// the first instance is the panel, which is
+	// drawn first, so the text is blended on top
+	uint32_t count = 1;
+	uint32_t column = 0;
+	uint32_t line = 0;
+	uint32_t longest = 0;
+
+	for (const char* c = text; *c != '\0' && count < HUD_MAX_GLYPHS; c++)
+	{
+		if (*c == '\n')
+		{
+			column = 0;
+			line++;
+			continue;
+		}
+
+		// spaces are not drawn, they only move the next letter
+		if (*c != ' ')
+		{
+			HudGlyph& glyph = glyphs[count++];
+			glyph.x = left + column * cellWidth;
+			glyph.y = top + line * cellHeight;
+			glyph.width = cellWidth;
+			glyph.height = cellHeight;
+			glyph.color = HUD_TEXT_COLOR;
+			GetGlyphBits(*c, glyph.bits);
+		}
+
+		column++;
+
+		if (column > longest)
+			longest = column;
+	}
+
+	// the panel is a little bigger than the text
+	float border = (HUD_MARGIN / 2) * scaleX;
+	HudGlyph& panel = glyphs[0];
+	panel.x = left - border;
+	panel.y = top - (HUD_MARGIN / 2) * scaleY;
+	panel.width = longest * cellWidth + 2.0f * border;
+	panel.height = (line + 1) * cellHeight + HUD_MARGIN * scaleY;
+	panel.color = HUD_PANEL_COLOR;
+	panel.bits[0] = 0;
+	panel.bits[1] = HUD_PANEL_BIT;
+
+	glyphCounts[slot] = count;
+}
+
+void HudOverlay::Record(VkCommandBuffer cmd, uint32_t slot, VkFramebuffer framebuffer, uint32_t width, uint32_t height)
+{
+	VkRenderPassBeginInfo rpBegin = {};
+	rpBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	rpBegin.renderPass = renderPass;
+	rpBegin.framebuffer = framebuffer;
+	rpBegin.renderArea.extent.width = width;
+	rpBegin.renderArea.extent.height = height;
+
+	DeviceTable::CmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	VkViewport viewport = {};
+	viewport.width = (float)width;
+	viewport.height = (float)height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	DeviceTable::CmdSetViewport(cmd, 0, 1, &viewport);
+	DeviceTable::CmdSetScissor(cmd, 0, 1, &rpBegin.renderArea);
+
+	VkDeviceSize offset = (VkDeviceSize)slot * HUD_MAX_GLYPHS * sizeof(HudGlyph);
+	DeviceTable::CmdBindVertexBuffers(cmd, 0, 1, &glyphBuffer.buffer, &offset);
+
+	// four corners for each letter, all of the letters in one draw
+	DeviceTable::CmdDraw(cmd, 4, glyphCounts[slot], 0, 0);
+
+	DeviceTable::CmdEndRenderPass(cmd);
+}
@@ -0,0 +1,101 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "BufferCPU.h"
+
+// the most letters (and panels) in one frame of the HUD
+#define HUD_MAX_GLYPHS 1024
+
+// Each letter is 5 by 7 pixels of the font, in a cell of 6 by 8,
+// and each pixel of the font is HUD_SCALE by HUD_SCALE pixels of the
+// window. The text starts HUD_MARGIN pixels from the top left corner
+#define HUD_CELL_WIDTH 6
+#define HUD_CELL_HEIGHT 8
+#define HUD_SCALE 2
+#define HUD_MARGIN 8
+
+// One instance of the HUD's draw, it must match the inputs of
+// hud.vert. color is R8G8B8A8_UNORM, and bits has one byte for each
+// column of the letter. A panel has the top bit of bits[1] set,
+// then the whole quad is filled
+struct HudGlyph
+{
+	float x;
+	float y;
+	float width;
+	float height;
+	uint32_t bits[2];
+	uint32_t color;
+};
+
+// A text overlay, which is drawn on top of the finished image, right
+// before it is presented, so it shows what the demo is doing on the
+// screen itself, without attaching a profiler. Every letter is one
+// instance of a quad, and the font is in the instance data, so there
+// is no texture and no descriptor set, the whole HUD is one draw.
+// It has its own render pass, after the upscale, because the scene
+// might be drawn at a lower resolution, with jitter (see TemporalPass),
+// and the text has to be sharp at the size of the window
+class HudOverlay
+{
+private:
+	VkDevice device;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	// one slice of HUD_MAX_GLYPHS for each frame slot, written
+	// by the CPU while another slot is drawn by the GPU
+	BufferCPU glyphBuffer;
+	std::vector<uint32_t> glyphCounts;
+
+	HudGlyph* GetSlice(uint32_t slot);
+	static void GetGlyphBits(char c, uint32_t bits[2]);
+
+public:
+	// loads the swapchain image, and leaves it in COLOR_ATTACHMENT_OPTIMAL,
+	// the frame graph changes the layouts before and after it
+	VkRenderPass renderPass;
+
+	HudOverlay(VkDevice d, MemoryAllocator* a, VkFormat format, uint32_t frameLag);
+	~HudOverlay();
+
+	// the pipeline goes into the pipeline cache, which might not
+	// be loaded yet when the render pass is needed
+	void PreparePipeline(VkPipelineCache cache);
+
+	// one for every swapchain image, the caller destroys or retires it
+	VkFramebuffer CreateFramebuffer(VkImageView view, uint32_t width, uint32_t height);
+
+	// Lays out the text for this slot, in a panel in the top left
+	// corner of a window of this size, '\n' starts a new line
+	void SetText(uint32_t slot, const char* text, uint32_t width, uint32_t height);
+
+	// draws the text of this slot, outside of any other render pass
+	void Record(VkCommandBuffer cmd, uint32_t slot, VkFramebuffer framebuffer, uint32_t width, uint32_t height);
+};
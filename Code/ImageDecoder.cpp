@@ -0,0 +1,465 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "ImageDecoder.h"
+#include "SimdLanes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// STB Image gives back its own array of pixels, which would then be
+// copied into the mapped buffer of the image. Instead, the first
+// allocation that has exactly the size of the RGBA pixels (which is
+// always the array that it gives back, for PNG files) gets the mapped
+// buffer itself, so STB Image writes the rows straight into it. Each
+// worker decodes one image at a time, so the target is per thread
+static thread_local uint8_t* decodeTarget = nullptr;
+static thread_local size_t decodeTargetSize = 0;
+
+static void* DecodeMalloc(size_t size)
+{
+	if (decodeTarget != nullptr && size == decodeTargetSize)
+	{
+		uint8_t* target = decodeTarget;
+		decodeTarget = nullptr;
+		return target;
+	}
+
+	return malloc(size);
+}
+
+// The mapped buffer can not grow, so if STB Image ever makes it bigger,
+// it gets a copy in normal memory. The buffer itself is never freed,
+// the TextureLoader owns it
+static void* DecodeRealloc(void* p, size_t oldSize, size_t newSize, uint8_t* staging)
+{
+	if (p != nullptr && p == staging)
+	{
+		void* copy = malloc(newSize);
+
+		if (copy != nullptr)
+			memcpy(copy, p, (oldSize < newSize) ? oldSize : newSize);
+
+		return copy;
+	}
+
+	return realloc(p, newSize);
+}
+
+static thread_local uint8_t* decodeStaging = nullptr;
+
+static void DecodeFree(void* p)
+{
+	if (p != nullptr && p != decodeStaging)
+		free(p);
+}
+
+#define STBI_ONLY_PNG
+#define STBI_MALLOC(sz) DecodeMalloc(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) DecodeRealloc(p, oldsz, newsz, decodeStaging)
+#define STBI_REALLOC(p, newsz) DecodeRealloc(p, 0, newsz, decodeStaging)
+#define STBI_FREE(p) DecodeFree(p)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+const char* StbDecoder::GetName()
+{
+	return "stb_image";
+}
+
+bool StbDecoder::Info(const uint8_t* data, size_t size, int* width, int* height)
+{
+	int nchan;
+	return stbi_info_from_memory(data, (int)size, width, height, &nchan) != 0;
+}
+
+bool StbDecoder::Decode(const uint8_t* data, size_t size, uint8_t* dest, int width, int height)
+{
+	int w;
+	int h;
+	int nchan;
+
+	// STB Image decodes into dest, see DecodeMalloc
+	size_t pixels = (size_t)width * height * 4;
+
+	decodeTarget = dest;
+	decodeTargetSize = pixels;
+	decodeStaging = dest;
+
+	stbi_uc* img = stbi_load_from_memory(data, (int)size, &w, &h, &nchan, 4);
+
+	decodeTarget = nullptr;
+	decodeStaging = nullptr;
+
+	if (img == nullptr || w != width || h != height)
+	{
+		if (img != dest)
+			stbi_image_free(img);
+
+		return false;
+	}
+
+	// If the pixels ended up somewhere else (a file that is not a
+	// PNG, or a decoder that changed), they are copied, like before
+	if (img != dest)
+	{
+		memcpy(dest, img, pixels);
+		stbi_image_free(img);
+	}
+
+	return true;
+}
+
+// The parts of the PNG that the fast path needs. The pixels are
+// in the IDAT chunks, which are one zlib stream, split anywhere
+struct PngHeader
+{
+	int width;
+	int height;
+
+	// 3 for RGB, 4 for RGBA
+	int bpp;
+};
+
+static uint32_t ReadBigEndian(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// Walks the chunks of the file. This returns false for every PNG that
+// the fast path does not handle, and then STB Image decodes it. If
+// idat is not nullptr, the IDAT chunks are joined into it
+static bool ReadPng(const uint8_t* data, size_t size, PngHeader* header, std::vector<uint8_t>* idat)
+{
+	static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	// the signature, then IHDR, which is always the first chunk
+	if (size < 8 + 8 + 13 || memcmp(data, signature, 8) != 0 || memcmp(data + 12, "IHDR", 4) != 0)
+		return false;
+
+	const uint8_t* ihdr = data + 16;
+	uint32_t width = ReadBigEndian(ihdr);
+	uint32_t height = ReadBigEndian(ihdr + 4);
+	uint8_t depth = ihdr[8];
+	uint8_t color = ihdr[9];
+
+	// 8 bits, RGB (2) or RGBA (6), the only compression and
+	// filter methods that exist (0), and not interlaced (0)
+	if (width == 0 || height == 0 || width > (1 << 24) || height > (1 << 24) ||
+		depth != 8 || (color != 2 && color != 6) || ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] != 0)
+		return false;
+
+	header->width = (int)width;
+	header->height = (int)height;
+	header->bpp = (color == 6) ? 4 : 3;
+
+	size_t offset = 8;
+	bool sawData = false;
+
+	while (offset + 12 <= size)
+	{
+		uint32_t length = ReadBigEndian(data + offset);
+		const uint8_t* type = data + offset + 4;
+		const uint8_t* chunk = data + offset + 8;
+
+		if (length > size - offset - 12)
+			return false;
+
+		// tRNS gives RGB a color that is transparent, and CgBI is
+		// the iPhone format, with its pixels in a different order
+		if (memcmp(type, "tRNS", 4) == 0 || memcmp(type, "CgBI", 4) == 0)
+			return false;
+
+		if (memcmp(type, "IDAT", 4) == 0)
+		{
+			if (idat != nullptr)
+				idat->insert(idat->end(), chunk, chunk + length);
+
+			sawData = true;
+		}
+
+		if (memcmp(type, "IEND", 4) == 0)
+			break;
+
+		offset += 12 + length;
+	}
+
+	return sawData;
+}
+
+#if SIMD_LANES > 1
+
+// One pixel (3 or 4 bytes) in the low bytes of a register.
+// RGB rows are not a multiple of 4 bytes, so this never
+// reads or writes past the pixel
+static inline __m128i LoadPixel(const uint8_t* p, int bpp)
+{
+	uint32_t v = 0;
+	memcpy(&v, p, bpp);
+	return _mm_cvtsi32_si128((int)v);
+}
+
+static inline void StorePixel(uint8_t* p, __m128i v, int bpp)
+{
+	uint32_t x = (uint32_t)_mm_cvtsi128_si32(v);
+	memcpy(p, &x, bpp);
+}
+
+static inline __m128i AbsEpi16(__m128i x)
+{
+	return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+// Undoes the filter of one row. prior is the row above, after it was
+// unfiltered (zeros for the first row). Up has no chain from one pixel
+// to the next, so it is 16 bytes at a time. Sub is too, for RGBA: the
+// 4 pixels are added up inside the register (each one plus the one
+// before, then plus the two before), then the last pixel of the block
+// before is added to all of them. Avg and Paeth need the pixel that
+// was just written, so those are one pixel at a time, in a register
+static void UnfilterRow(uint8_t* out, const uint8_t* in, const uint8_t* prior, int filter, size_t rowBytes, int bpp)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	switch (filter)
+	{
+	case 0:
+	{
+		memcpy(out, in, rowBytes);
+		break;
+	}
+	case 1:
+	{
+		__m128i a = zero;
+
+		if (bpp == 4)
+		{
+			for (; i + 16 <= rowBytes; i += 16)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+				v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+				v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+				v = _mm_add_epi8(v, a);
+				_mm_storeu_si128((__m128i*)(out + i), v);
+				a = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+			}
+		}
+
+		for (; i < rowBytes; i += bpp)
+		{
+			a = _mm_add_epi8(LoadPixel(in + i, bpp), a);
+			StorePixel(out + i, a, bpp);
+		}
+		break;
+	}
+	case 2:
+	{
+		for (; i + 16 <= rowBytes; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(prior + i));
+			_mm_storeu_si128((__m128i*)(out + i), _mm_add_epi8(v, b));
+		}
+
+		for (; i < rowBytes; i++)
+			out[i] = in[i] + prior[i];
+		break;
+	}
+	case 3:
+	{
+		// _mm_avg_epu8 rounds up, and the filter rounds down,
+		// so the low bit is taken off when a + b is odd
+		const __m128i one = _mm_set1_epi8(1);
+		__m128i a = zero;
+
+		for (; i < rowBytes; i += bpp)
+		{
+			__m128i b = LoadPixel(prior + i, bpp);
+			__m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+			a = _mm_add_epi8(LoadPixel(in + i, bpp), avg);
+			StorePixel(out + i, a, bpp);
+		}
+		break;
+	}
+	case 4:
+	{
+		// a is the pixel to the left, b is above, and c is above
+		// and to the left, each as 16 bit numbers, because the
+		// distances are from -255 to 510
+		__m128i a = zero;
+		__m128i c = zero;
+
+		for (; i < rowBytes; i += bpp)
+		{
+			__m128i b = _mm_unpacklo_epi8(LoadPixel(prior + i, bpp), zero);
+
+			__m128i pa = AbsEpi16(_mm_sub_epi16(b, c));
+			__m128i pb = AbsEpi16(_mm_sub_epi16(a, c));
+			__m128i pc = AbsEpi16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+			__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+			// a wins a tie with b or c, and b wins a tie with c
+			__m128i useA = _mm_cmpeq_epi16(smallest, pa);
+			__m128i useB = _mm_cmpeq_epi16(smallest, pb);
+			__m128i pred = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+			pred = _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, pred));
+
+			__m128i x = _mm_add_epi8(LoadPixel(in + i, bpp), _mm_packus_epi16(pred, pred));
+			StorePixel(out + i, x, bpp);
+
+			a = _mm_unpacklo_epi8(x, zero);
+			c = b;
+		}
+		break;
+	}
+	}
+}
+
+#else
+
+// without SSE2, the same filters, one byte at a time
+static void UnfilterRow(uint8_t* out, const uint8_t* in, const uint8_t* prior, int filter, size_t rowBytes, int bpp)
+{
+	for (size_t i = 0; i < rowBytes; i++)
+	{
+		int a = (i >= (size_t)bpp) ? out[i - bpp] : 0;
+		int b = prior[i];
+		int c = (i >= (size_t)bpp) ? prior[i - bpp] : 0;
+		int pred = 0;
+
+		if (filter == 1)
+			pred = a;
+		else if (filter == 2)
+			pred = b;
+		else if (filter == 3)
+			pred = (a + b) >> 1;
+		else if (filter == 4)
+		{
+			int pa = abs(b - c);
+			int pb = abs(a - c);
+			int pc = abs(a + b - 2 * c);
+			pred = (pa <= pb && pa <= pc) ? a : ((pb <= pc) ? b : c);
+		}
+
+		out[i] = (uint8_t)(in[i] + pred);
+	}
+}
+
+#endif
+
+const char* PngDecoder::GetName()
+{
+	return "png " SIMD_PATH;
+}
+
+bool PngDecoder::Info(const uint8_t* data, size_t size, int* width, int* height)
+{
+	PngHeader header;
+
+	if (!ReadPng(data, size, &header, nullptr))
+		return false;
+
+	*width = header.width;
+	*height = header.height;
+	return true;
+}
+
+bool PngDecoder::Decode(const uint8_t* data, size_t size, uint8_t* dest, int width, int height)
+{
+	PngHeader header;
+	std::vector<uint8_t> idat;
+
+	if (!ReadPng(data, size, &header, &idat) || header.width != width || header.height != height)
+		return false;
+
+	// every row starts with the byte of its filter
+	size_t rowBytes = (size_t)width * header.bpp;
+	size_t stride = rowBytes + 1;
+	size_t expected = stride * height;
+
+	if (expected > 0x7fffffff)
+		return false;
+
+	// The inflate is the one from STB Image, it is given the exact size,
+	// so it never grows its array. decodeTarget is not set here, so
+	// this is an allocation of its own, never the mapped buffer
+	int length = 0;
+	uint8_t* raw = (uint8_t*)stbi_zlib_decode_malloc_guesssize_headerflag(
+		(const char*)idat.data(), (int)idat.size(), (int)expected, &length, 1);
+
+	if (raw == nullptr || (size_t)length < expected)
+	{
+		stbi_image_free(raw);
+		return false;
+	}
+
+	// RGBA rows are unfiltered straight into dest, and the row above
+	// is read back from dest. RGB rows are unfiltered into two rows
+	// that take turns, then each one gets its alpha on the way to dest
+	std::vector<uint8_t> zeros(rowBytes, 0);
+	std::vector<uint8_t> rgb(header.bpp == 3 ? rowBytes * 2 : 0);
+	bool ok = true;
+
+	for (int y = 0; y < height; y++)
+	{
+		const uint8_t* in = raw + stride * y;
+		uint8_t filter = in[0];
+
+		if (filter > 4)
+		{
+			ok = false;
+			break;
+		}
+
+		uint8_t* row = dest + rowBytes * y;
+
+		if (header.bpp == 4)
+		{
+			const uint8_t* prior = (y > 0) ? row - rowBytes : zeros.data();
+			UnfilterRow(row, in + 1, prior, filter, rowBytes, 4);
+		}
+		else
+		{
+			uint8_t* out = rgb.data() + rowBytes * (y & 1);
+			const uint8_t* prior = (y > 0) ? rgb.data() + rowBytes * ((y - 1) & 1) : zeros.data();
+			UnfilterRow(out, in + 1, prior, filter, rowBytes, 3);
+
+			uint8_t* pixel = dest + (size_t)width * 4 * y;
+
+			for (int x = 0; x < width; x++)
+			{
+				pixel[x * 4 + 0] = out[x * 3 + 0];
+				pixel[x * 4 + 1] = out[x * 3 + 1];
+				pixel[x * 4 + 2] = out[x * 3 + 2];
+				pixel[x * 4 + 3] = 255;
+			}
+		}
+	}
+
+	stbi_image_free(raw);
+	return ok;
+}
@@ -0,0 +1,75 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Turns the bytes of an image file into RGBA pixels. The TextureLoader
+// has a list of these, and each image goes to the first one that can
+// read its header, so a faster decoder only has to handle the files
+// that it is good at, and STB Image (which reads nearly anything) is
+// always the last one in the list
+class ImageDecoder
+{
+public:
+	virtual ~ImageDecoder() {}
+
+	// for the messages and the benchmarks
+	virtual const char* GetName() = 0;
+
+	// Reads the width and height from the header of the file. This
+	// returns false if this decoder can not decode the file, and then
+	// the next decoder in the list gets it
+	virtual bool Info(const uint8_t* data, size_t size, int* width, int* height) = 0;
+
+	// Writes width * height RGBA pixels to dest, which can be
+	// mapped memory. This is called on many threads at once
+	virtual bool Decode(const uint8_t* data, size_t size, uint8_t* dest, int width, int height) = 0;
+};
+
+// The fallback, it decodes any PNG, and
+// writes the rows straight into dest
+class StbDecoder : public ImageDecoder
+{
+public:
+	const char* GetName();
+	bool Info(const uint8_t* data, size_t size, int* width, int* height);
+	bool Decode(const uint8_t* data, size_t size, uint8_t* dest, int width, int height);
+};
+
+// The fast path, for the PNG files that nearly every texture is:
+// 8 bits per channel, RGB or RGBA, not interlaced. STB Image unfilters
+// each byte one at a time, into its own array, then converts that to
+// RGBA in another pass. This one unfilters 16 bytes at a time with
+// SSE2 (or one pixel at a time, for the filters that need the pixel
+// before), straight into dest. Any other PNG goes to STB Image
+class PngDecoder : public ImageDecoder
+{
+public:
+	const char* GetName();
+	bool Info(const uint8_t* data, size_t size, int* width, int* height);
+	bool Decode(const uint8_t* data, size_t size, uint8_t* dest, int width, int height);
+};
@@ -0,0 +1,120 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "InitGraph.h"
+#include "CpuProfiler.h"
+
+// The startup used to run every prepare_ function one after the other.
+// Once the device exists, some of them do not need each other at all:
+// loading the pipeline cache, compiling the shaders, and making the
+// command pools and fences can all happen while the main thread loads
+// the mesh and the textures. Vulkan lets many threads create objects
+// with the same VkDevice at the same time, as long as no two threads
+// use the same pool, or the same queue, at the same time
+
+InitGraph::InitGraph(JobSystem* js)
+{
+	jobs = js;
+}
+
+InitGraph::~InitGraph()
+{
+	// every task is finished before it is deleted
+	WaitAll();
+
+	for (InitTask* task : tasks)
+		delete task;
+}
+
+uint32_t InitGraph::Add(const char* name, std::function<void()> job, std::vector<uint32_t> deps)
+{
+	InitTask* task = new InitTask();
+	task->name = name;
+	task->job = job;
+	task->deps = deps;
+	task->ms = 0;
+
+	uint32_t index;
+	std::vector<JobCounter*> depCounters;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		index = (uint32_t)tasks.size();
+		tasks.push_back(task);
+
+		for (uint32_t dep : deps)
+			depCounters.push_back(&tasks[dep]->done);
+	}
+
+	// the job system starts the task when
+	// the counter of every dep is zero
+	jobs->RunAfter(depCounters, [task]()
+	{
+		CpuClock::time_point start = CpuClock::now();
+		task->job();
+		task->ms = std::chrono::duration<double, std::milli>(CpuClock::now() - start).count();
+	}, &task->done);
+
+	return index;
+}
+
+void InitGraph::Wait(uint32_t task)
+{
+	JobCounter* counter;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		counter = &tasks[task]->done;
+	}
+
+	// this thread runs other jobs while it waits
+	jobs->Wait(counter);
+}
+
+void InitGraph::WaitAll()
+{
+	uint32_t count = GetCount();
+
+	for (uint32_t i = 0; i < count; i++)
+		Wait(i);
+}
+
+uint32_t InitGraph::GetCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (uint32_t)tasks.size();
+}
+
+const char* InitGraph::GetName(uint32_t task)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return tasks[task]->name;
+}
+
+double InitGraph::GetMs(uint32_t task)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return tasks[task]->ms;
+}
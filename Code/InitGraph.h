@@ -0,0 +1,77 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include "JobSystem.h"
+
+// one step of the startup, which can run on another thread
+// after every task in deps is finished
+struct InitTask
+{
+	const char* name;
+	std::function<void()> job;
+	std::vector<uint32_t> deps;
+
+	// zero when the job is done
+	JobCounter done;
+
+	// how long the job took, in milliseconds
+	double ms;
+};
+
+// Runs the steps of the startup that do not depend on each other at the
+// same time. Each task lists the tasks that it needs, and it only starts
+// when all of them are done. The thread that adds the tasks keeps doing
+// its own steps, and calls Wait when it needs the result of a task.
+// The tasks run on the threads of the JobSystem
+class InitGraph
+{
+private:
+	JobSystem* jobs;
+
+	// The tasks are pointers, so they do not move when more
+	// tasks are added, the mutex protects the vector
+	std::mutex mutex;
+	std::vector<InitTask*> tasks;
+
+public:
+	InitGraph(JobSystem* js);
+	~InitGraph();
+
+	// deps can only have tasks that were added before this one,
+	// returns the index of the task, for Wait and deps
+	uint32_t Add(const char* name, std::function<void()> job, std::vector<uint32_t> deps = std::vector<uint32_t>());
+
+	void Wait(uint32_t task);
+	void WaitAll();
+
+	uint32_t GetCount();
+	const char* GetName(uint32_t task);
+	double GetMs(uint32_t task);
+};
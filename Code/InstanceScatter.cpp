@@ -0,0 +1,230 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "InstanceScatter.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <string.h>
+
+// Before this, dynamic instances were in a CPU buffer with one slice
+// for each frame in flight, and the vertex shader read every matrix
+// over PCIe, in every frame, even the ones that never moved. Each slice
+// also had to get the matrices that changed in the other slices. Now
+// there is only one copy of the matrices, in VRAM, and each change is
+// sent once, in the frame that it happened
+
+InstanceScatter::InstanceScatter(VkDevice d, MemoryAllocator* a, VkBuffer instances, uint32_t slotCount)
+{
+	device = d;
+	pipeline = VK_NULL_HANDLE;
+
+	slots.resize(slotCount);
+
+	for (uint32_t i = 0; i < slotCount; i++)
+	{
+		slots[i].offset = 0;
+		slots[i].consumed = 0;
+		slots[i].count = 0;
+	}
+
+	// The shader reads the deltas right out of the ring, so
+	// they are never copied to the GPU before they are scattered
+	ring = new StagingRing(device, a, INSTANCE_DELTA_RING_SIZE, false, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+	// the deltas at binding 0, and the instances at binding 1
+	VkDescriptorSetLayoutBinding bindings[2];
+	memset(bindings, 0, sizeof(bindings));
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+	vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &descLayout);
+
+	VkDescriptorPoolSize poolSize;
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = 2;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &descPool);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &descLayout;
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, &descSet);
+
+	// The whole ring is bound once, and each frame tells the shader
+	// where its deltas start, so the set never has to change
+	VkDescriptorBufferInfo bufferInfo[2] = {};
+	bufferInfo[0].buffer = ring->GetBuffer();
+	bufferInfo[0].range = VK_WHOLE_SIZE;
+	bufferInfo[1].buffer = instances;
+	bufferInfo[1].range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[2];
+	memset(writes, 0, sizeof(writes));
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = descSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfo[i];
+	}
+
+	DeviceTable::UpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(ScatterConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &pipelineLayoutInfo, HostAllocator::callbacks, &pipelineLayout);
+}
+
+void InstanceScatter::PreparePipeline(VkPipelineCache cache)
+{
+	// Compute Shader compiled to header, see compileShaders.cmd
+	const unsigned char cs_code[] = {
+		#include "instance_scatter.comp.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = (uint32_t*)cs_code;
+	shaderInfo.codeSize = sizeof(cs_code);
+
+	VkShaderModule module;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &module);
+
+	VkComputePipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeInfo.stage.module = module;
+	pipeInfo.stage.pName = "main";
+	pipeInfo.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the instance scatter pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, module, HostAllocator::callbacks);
+}
+
+InstanceScatter::~InstanceScatter()
+{
+	vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+
+	// destroying the pool also frees the set
+	vkDestroyDescriptorPool(device, descPool, HostAllocator::callbacks);
+	vkDestroyDescriptorSetLayout(device, descLayout, HostAllocator::callbacks);
+
+	delete ring;
+}
+
+void InstanceScatter::Write(uint32_t slot, TransformStore* store)
+{
+	// Slots are used in order, so the deltas of this slot are always
+	// the oldest ones in the ring, and the ring is given them back in
+	// the same order that it gave them out
+	ScatterSlot& s = slots[slot];
+
+	if (s.consumed > 0)
+		ring->Release(s.consumed);
+
+	s.consumed = 0;
+	s.count = 0;
+
+	uint32_t wanted = store->CountStale(0);
+
+	if (wanted == 0)
+		return;
+
+	// When there is not enough room for all of them (the other frames in
+	// flight still have their deltas in the ring), half as many are tried,
+	// until some fit. The rest stay stale, and go in the next frame
+	uint32_t count = wanted;
+
+	while (count > 0 && !ring->Allocate((VkDeviceSize)count * sizeof(TransformDelta), &s.offset, &s.consumed))
+		count /= 2;
+
+	if (count == 0)
+		return;
+
+	TransformDelta* out = (TransformDelta*)(ring->GetPointer() + s.offset);
+	s.count = store->WriteDeltas(0, count, out);
+	ring->Flush(s.offset, (VkDeviceSize)s.count * sizeof(TransformDelta));
+}
+
+uint32_t InstanceScatter::GetCount(uint32_t slot)
+{
+	return slots[slot].count;
+}
+
+void InstanceScatter::Record(VkCommandBuffer cmd, uint32_t slot)
+{
+	const ScatterSlot& s = slots[slot];
+
+	if (s.count == 0)
+		return;
+
+	// the ring is aligned to 16 bytes, which is one vec4
+	ScatterConstants constants;
+	constants.first = (uint32_t)(s.offset / 16);
+	constants.count = s.count;
+
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descSet, 0, NULL);
+	DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ScatterConstants), &constants);
+
+	// one invocation for every delta
+	DeviceTable::CmdDispatch(cmd, (s.count + INSTANCE_SCATTER_WORKGROUP_SIZE - 1) / INSTANCE_SCATTER_WORKGROUP_SIZE, 1, 1);
+}
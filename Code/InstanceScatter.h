@@ -0,0 +1,104 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "StagingRing.h"
+#include "TransformStore.h"
+
+// the number of deltas that each workgroup
+// of the scatter shader copies (local_size_x)
+#define INSTANCE_SCATTER_WORKGROUP_SIZE 64
+
+// the size of the ring that the deltas of every frame
+// in flight are written to, 80 bytes for each delta
+#define INSTANCE_DELTA_RING_SIZE (2 * 1024 * 1024)
+
+// This is given to the scatter shader with push constants,
+// it must match ScatterVals in instance_scatter.comp.
+// first is where the deltas start in the ring, in vec4s
+struct ScatterConstants
+{
+	uint32_t first;
+	uint32_t count;
+};
+
+// the deltas that one frame slot wrote into the ring
+struct ScatterSlot
+{
+	VkDeviceSize offset;
+	VkDeviceSize consumed;
+	uint32_t count;
+};
+
+// Keeps the dynamic instances in one device-local instance buffer, and
+// only sends the matrices that changed. Every frame, the CPU writes the
+// changed matrices, each with the index of its instance, one after the
+// other into a ring that stays mapped (see StagingRing), and a compute
+// shader copies each one to its place in the instance buffer. So the
+// draws read VRAM, like static instances, and the bytes that cross the
+// bus in a frame are only the deltas, not a whole slice of matrices
+class InstanceScatter
+{
+private:
+	VkDevice device;
+	StagingRing* ring;
+
+	std::vector<ScatterSlot> slots;
+
+	VkDescriptorSetLayout descLayout;
+	VkDescriptorPool descPool;
+	VkDescriptorSet descSet;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+public:
+	// instances is the device-local instance buffer,
+	// which needs STORAGE usage, with a mat4 for every instance
+	InstanceScatter(VkDevice d, MemoryAllocator* a, VkBuffer instances, uint32_t slotCount);
+	~InstanceScatter();
+
+	// the compute pipeline goes into the pipeline
+	// cache, so it is made when the cache is ready
+	void PreparePipeline(VkPipelineCache cache);
+
+	// Writes every matrix that is stale in slice 0 of the store into
+	// the ring, for this slot. The deltas of this slot from frame_lag
+	// frames ago are given back first, their fence was already waited
+	// on. When the ring is too full, some matrices wait for a later frame
+	void Write(uint32_t slot, TransformStore* store);
+
+	// how many deltas Record copies for this slot
+	uint32_t GetCount(uint32_t slot);
+
+	// Copies the deltas of the slot into the instance buffer. This must
+	// be recorded outside of a render pass, the frame graph waits for the
+	// draws of the last frame to read the instances, and for this to
+	// write them (COMPUTE_SHADER)
+	void Record(VkCommandBuffer cmd, uint32_t slot);
+};
@@ -0,0 +1,276 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "JobSystem.h"
+#include "ThreadScheduler.h"
+
+// Before this, every part of the program that used threads made its own.
+// With the recorder's threads, the texture decoders, and the startup
+// threads all alive at once, there were more threads than cores, and
+// the OS had to switch between them. Now there is one thread for each
+// core, and everyone gives them small jobs.
+
+// Each thread has its own queue, so two threads that add jobs at the
+// same time do not wait for the same mutex. When a thread has nothing
+// left in its queue, it steals a job from the queue of another thread,
+// so the work spreads out by itself, even if one thread added all of it
+
+// the queue of the thread that is running right now, worker
+// threads use their own, every other thread uses queue 0
+static thread_local JobSystem* currentSystem = nullptr;
+static thread_local uint32_t currentQueue = 0;
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+	queued = 0;
+	quit = false;
+
+	if (workerCount > JOB_SYSTEM_MAX_WORKERS)
+		workerCount = JOB_SYSTEM_MAX_WORKERS;
+
+	if (workerCount == 0)
+		workerCount = 1;
+
+	// one queue for the other threads, and one for each worker
+	for (uint32_t i = 0; i < workerCount + 1; i++)
+		queues.push_back(new JobQueue());
+
+	for (uint32_t i = 0; i < workerCount; i++)
+		threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i + 1));
+}
+
+JobSystem::~JobSystem()
+{
+	// Everyone who used the job system waited for their jobs
+	// before they were deleted, so the queues are empty here
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		quit = true;
+	}
+
+	wake.notify_all();
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (JobQueue* queue : queues)
+		delete queue;
+}
+
+void JobSystem::Push(const JobEntry& entry)
+{
+	uint32_t index = (currentSystem == this) ? currentQueue : 0;
+
+	// The mutex is locked while queued changes, so a worker can not
+	// check queued, and then miss the notify before it falls asleep.
+	// queued grows before the job is in the queue, so it can never
+	// be smaller than the number of jobs that someone can take
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queued++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->jobs.push_back(entry);
+	}
+
+	wake.notify_one();
+}
+
+void JobSystem::Run(Job job, JobCounter* counter)
+{
+	if (counter != nullptr)
+		counter->value++;
+
+	JobEntry entry;
+	entry.job = job;
+	entry.counter = counter;
+	Push(entry);
+}
+
+void JobSystem::RunAfter(std::vector<JobCounter*> deps, Job job, JobCounter* counter)
+{
+	// the counter is larger right away, so someone who waits
+	// for it also waits while the job waits for its deps
+	if (counter != nullptr)
+		counter->value++;
+
+	std::shared_ptr<PendingJob> pending = std::make_shared<PendingJob>();
+	pending->entry.job = job;
+	pending->entry.counter = counter;
+
+	// one extra, so the job can not start
+	// before every dep has been looked at
+	pending->depsLeft = (uint32_t)deps.size() + 1;
+
+	{
+		// Finish locks this mutex before it looks for the jobs that
+		// wait for a counter, so a counter can not reach zero between
+		// the check below and adding the job to the waiting list
+		std::lock_guard<std::mutex> lock(waitingMutex);
+
+		for (JobCounter* dep : deps)
+		{
+			if (dep->value == 0)
+				pending->depsLeft--;
+			else
+				waiting.push_back(std::make_pair(dep, pending));
+		}
+	}
+
+	if (pending->depsLeft.fetch_sub(1) == 1)
+		Push(pending->entry);
+}
+
+bool JobSystem::TryRun()
+{
+	uint32_t index = (currentSystem == this) ? currentQueue : 0;
+	uint32_t queueCount = (uint32_t)queues.size();
+
+	JobEntry entry;
+	bool found = false;
+
+	// our own queue first, newest job first
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+
+		if (!queues[index]->jobs.empty())
+		{
+			entry = queues[index]->jobs.back();
+			queues[index]->jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// then steal the oldest job of another queue
+	for (uint32_t i = 1; i < queueCount && !found; i++)
+	{
+		JobQueue* victim = queues[(index + i) % queueCount];
+		std::lock_guard<std::mutex> lock(victim->mutex);
+
+		if (!victim->jobs.empty())
+		{
+			entry = victim->jobs.front();
+			victim->jobs.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	queued--;
+	entry.job();
+	Finish(entry.counter);
+	return true;
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (counter == nullptr)
+		return;
+
+	if (counter->value.fetch_sub(1) != 1)
+		return;
+
+	// this counter is zero now, so every job
+	// that waits for it has one less dep
+	std::vector<std::shared_ptr<PendingJob>> ready;
+
+	{
+		std::lock_guard<std::mutex> lock(waitingMutex);
+
+		for (size_t i = 0; i < waiting.size();)
+		{
+			if (waiting[i].first == counter)
+			{
+				if (waiting[i].second->depsLeft.fetch_sub(1) == 1)
+					ready.push_back(waiting[i].second);
+
+				waiting[i] = waiting.back();
+				waiting.pop_back();
+			}
+			else
+				i++;
+		}
+	}
+
+	for (std::shared_ptr<PendingJob>& pending : ready)
+		Push(pending->entry);
+}
+
+void JobSystem::WorkerLoop(uint32_t index)
+{
+	currentSystem = this;
+	currentQueue = index;
+
+	while (true)
+	{
+		if (TryRun())
+			continue;
+
+		// sleep until a job is added, or until we quit
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return quit || queued > 0; });
+
+		if (quit)
+			return;
+	}
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	while (counter->value != 0)
+	{
+		if (TryRun())
+			continue;
+
+		// Nothing to steal, the last jobs are running on other
+		// threads. They are usually short, so we only give up
+		// the rest of our time slice, instead of sleeping
+		std::this_thread::yield();
+	}
+}
+
+uint32_t JobSystem::GetWorkerCount()
+{
+	return (uint32_t)threads.size();
+}
+
+bool JobSystem::SetWorkerAffinity(uint64_t affinity)
+{
+	bool pinned = true;
+
+	for (std::thread& thread : threads)
+		pinned &= ThreadScheduler::SetAffinity(thread, (DWORD_PTR)affinity);
+
+	return pinned;
+}
+
+uint32_t JobSystem::GetThreadIndex()
+{
+	return currentQueue;
+}
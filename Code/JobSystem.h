@@ -0,0 +1,131 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+// the most threads that the job system makes, the thread
+// that calls Wait also runs jobs, so it is not counted
+#define JOB_SYSTEM_MAX_WORKERS 16
+
+typedef std::function<void()> Job;
+
+// Counts the jobs that were given to the job system, and are not
+// finished yet. Wait returns when the counter is zero, and a job can
+// be told to start only after one or more counters are zero
+struct JobCounter
+{
+	std::atomic<uint32_t> value;
+
+	JobCounter() : value(0) {}
+};
+
+// a job, and the counter that it makes smaller when it finishes
+struct JobEntry
+{
+	Job job;
+	JobCounter* counter;
+};
+
+// a job that is waiting for its dependencies, it
+// goes into a queue when depsLeft reaches zero
+struct PendingJob
+{
+	JobEntry entry;
+	std::atomic<uint32_t> depsLeft;
+};
+
+// Each queue belongs to one thread. That thread adds and takes jobs at
+// the back, so the jobs it just added are still in its cache, other
+// threads steal from the front, so they rarely touch the same end
+struct JobQueue
+{
+	std::mutex mutex;
+	std::deque<JobEntry> jobs;
+};
+
+// One pool of threads for the whole program. The TextureLoader, the
+// CommandRecorder, and the InitGraph all give their work to this,
+// instead of each one having threads of its own that fight over the
+// same cores. Queue 0 is for the threads that are not workers
+class JobSystem
+{
+private:
+	std::vector<std::thread> threads;
+	std::vector<JobQueue*> queues;
+
+	// the jobs that are in a queue, the workers
+	// sleep on wake while this is zero
+	std::atomic<uint32_t> queued;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool quit;
+
+	// jobs that are waiting for a counter to reach zero
+	std::mutex waitingMutex;
+	std::vector<std::pair<JobCounter*, std::shared_ptr<PendingJob>>> waiting;
+
+	void Push(const JobEntry& entry);
+	bool TryRun();
+	void Finish(JobCounter* counter);
+	void WorkerLoop(uint32_t index);
+
+public:
+	JobSystem(uint32_t workerCount);
+	~JobSystem();
+
+	// runs the job on any thread, counter
+	// (if there is one) is one larger until it is done
+	void Run(Job job, JobCounter* counter = nullptr);
+
+	// same as Run, but the job only starts after
+	// every counter in deps has reached zero
+	void RunAfter(std::vector<JobCounter*> deps, Job job, JobCounter* counter = nullptr);
+
+	// Returns when the counter is zero. The thread that waits
+	// runs other jobs in the meantime, instead of sleeping,
+	// so a job can wait for other jobs without a deadlock
+	void Wait(JobCounter* counter);
+
+	uint32_t GetWorkerCount();
+
+	// Puts every worker on the cores of the mask, like every core
+	// but the one of the render thread, so a worker never takes
+	// its core (see ThreadScheduler.h). False if one could not move
+	bool SetWorkerAffinity(uint64_t affinity);
+
+	// The queue of the thread that calls it, from 1 to GetWorkerCount()
+	// on the workers, and 0 on every other thread. Something that
+	// keeps one of a thing per thread can use this as the index
+	static uint32_t GetThreadIndex();
+};
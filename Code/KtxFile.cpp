@@ -0,0 +1,150 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "KtxFile.h"
+#include "Helper.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every KTX2 file starts with these 12 bytes
+static const uint8_t ktx2Identifier[12] =
+{
+	0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+// The header comes right after the identifier
+struct Ktx2Header
+{
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+// After the header, there is one of these for each mip level
+struct Ktx2Level
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+KtxFile::KtxFile()
+{
+	format = VK_FORMAT_UNDEFINED;
+	width = 0;
+	height = 0;
+	levelCount = 0;
+}
+
+bool KtxFile::Load(const char* path)
+{
+	if (!file.Open(path))
+		return false;
+
+	return Parse(file.GetData(), file.GetSize(), path);
+}
+
+bool KtxFile::Parse(const char* data, size_t size, const char* path)
+{
+	// check the identifier, and make sure the header fits
+	if (size < sizeof(ktx2Identifier) + sizeof(Ktx2Header) ||
+		memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) != 0)
+	{
+		printf("%s is not a KTX2 file\n", path);
+		return false;
+	}
+
+	Ktx2Header header;
+	memcpy(&header, data + sizeof(ktx2Identifier), sizeof(header));
+
+	// We only load simple 2D textures, one image per level, that
+	// are not supercompressed (Basis Universal needs a transcoder).
+	// levelCount of zero means "make the mips yourself", and we
+	// can not do that with compressed formats
+	if (header.vkFormat == VK_FORMAT_UNDEFINED ||
+		header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 ||
+		header.levelCount == 0 || header.supercompressionScheme != 0)
+	{
+		printf("%s is a KTX2 file that we can not load\n", path);
+		return false;
+	}
+
+	size_t levelIndex = sizeof(ktx2Identifier) + sizeof(Ktx2Header);
+
+	if (levelIndex + header.levelCount * sizeof(Ktx2Level) > size)
+	{
+		printf("%s is too small\n", path);
+		return false;
+	}
+
+	format = (VkFormat)header.vkFormat;
+	width = header.pixelWidth;
+	height = header.pixelHeight;
+	levelCount = header.levelCount;
+
+	// Make one copy region for each level. The blocks of each
+	// level are tightly packed, so bufferRowLength and
+	// bufferImageHeight are zero
+	regions.resize(levelCount);
+	levelSizes.resize(levelCount);
+
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		Ktx2Level level;
+		memcpy(&level, data + levelIndex + i * sizeof(Ktx2Level), sizeof(level));
+
+		if (level.byteOffset + level.byteLength > (uint64_t)size)
+		{
+			printf("%s has a mip level outside of the file\n", path);
+			return false;
+		}
+
+		VkBufferImageCopy& region = regions[i];
+		memset(&region, 0, sizeof(region));
+		region.bufferOffset = level.byteOffset;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+		region.imageExtent.width = (width >> i) > 0 ? (width >> i) : 1;
+		region.imageExtent.height = (height >> i) > 0 ? (height >> i) : 1;
+		region.imageExtent.depth = 1;
+
+		levelSizes[i] = level.byteLength;
+	}
+
+	return true;
+}
@@ -0,0 +1,70 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "Helper.h"
+
+// A KTX2 file holds a texture that is ready for the GPU, in a
+// VkFormat (usually a compressed format like BC1, BC7, or ASTC),
+// with every mip level already made. There is nothing to decode,
+// the blocks are copied straight to the GPU. See
+// https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+class KtxFile
+{
+private:
+	// the file is mapped, not copied, so the
+	// staging ring copies straight from the file
+	MappedFile file;
+
+public:
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+
+	// where each mip level is in the file, level 0 is first
+	std::vector<VkBufferImageCopy> regions;
+
+	// how many bytes each mip level has in the file
+	std::vector<VkDeviceSize> levelSizes;
+
+	KtxFile();
+
+	// returns false if the file does not exist,
+	// or if it is not a KTX2 file that we can use
+	bool Load(const char* path);
+
+	// Reads the header and the level index from data, without keeping
+	// anything mapped. size is the size of the whole file, but data only
+	// needs the start of it (with GpuDecompressor, the rest of the file
+	// is only ever decompressed on the GPU). path is for the messages
+	bool Parse(const char* data, size_t size, const char* path);
+
+	const char* GetData() { return file.GetData(); }
+	size_t GetSize() { return file.GetSize(); }
+};
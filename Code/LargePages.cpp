@@ -0,0 +1,127 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "LargePages.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+bool LargePages::enabled = false;
+size_t LargePages::pageSize = 0;
+std::mutex LargePages::lock;
+std::unordered_map<void*, size_t> LargePages::allocations;
+
+bool LargePages::Enable()
+{
+	if (enabled)
+		return true;
+
+	// zero if the CPU (or the version of Windows) has no large pages
+	size_t minimum = GetLargePageMinimum();
+
+	if (minimum == 0)
+		return false;
+
+	// The user can have the right, and it still starts turned off
+	// in every process, so we turn it on in the token of this one
+	HANDLE token;
+
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		return false;
+
+	TOKEN_PRIVILEGES privileges = {};
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+	bool found = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) != 0;
+
+	// AdjustTokenPrivileges succeeds even if the user does not have
+	// the right, then the error says that it was not assigned
+	bool adjusted = found &&
+		AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+		GetLastError() == ERROR_SUCCESS;
+
+	CloseHandle(token);
+
+	if (!adjusted)
+		return false;
+
+	pageSize = minimum;
+	enabled = true;
+	return true;
+}
+
+void* LargePages::Allocate(size_t bytes)
+{
+	// A small array would waste most of a large page, so only
+	// allocations of at least one page get them. They are rounded
+	// up to whole pages, which VirtualAlloc needs
+	if (enabled && bytes >= pageSize)
+	{
+		size_t size = (bytes + pageSize - 1) & ~(pageSize - 1);
+		void* memory = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+		// Windows can run out of large pages when memory is
+		// fragmented, even if there is memory left, then malloc
+		if (memory != nullptr)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			allocations[memory] = size;
+			return memory;
+		}
+	}
+
+	return malloc(bytes);
+}
+
+void LargePages::Free(void* memory)
+{
+	if (memory == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto found = allocations.find(memory);
+
+		if (found != allocations.end())
+		{
+			allocations.erase(found);
+			VirtualFree(memory, 0, MEM_RELEASE);
+			return;
+		}
+	}
+
+	free(memory);
+}
+
+size_t LargePages::GetAllocatedBytes()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	size_t total = 0;
+
+	for (auto& allocation : allocations)
+		total += allocation.second;
+
+	return total;
+}
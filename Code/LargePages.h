@@ -0,0 +1,88 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <windows.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Every page of memory that the CPU touches needs an entry in the TLB
+// (the cache of the page table), which only has room for a few thousand
+// of them. The per-frame loops walk through big arrays, like the
+// transforms of every object, and with 4KB pages, a few MB of arrays
+// need more entries than there are, so the loops miss the TLB all the
+// time. A large page is 2MB, then the same arrays need a few entries.
+// Large pages can not be paged out, so Windows only gives them to a user
+// that has the "Lock pages in memory" right (SeLockMemoryPrivilege),
+// and Enable fails without it. Until Enable works, and for allocations
+// that are smaller than one large page, Allocate is just malloc
+class LargePages
+{
+private:
+	static bool enabled;
+	static size_t pageSize;
+
+	// the allocations that are large pages, and their sizes,
+	// everything else came from malloc
+	static std::mutex lock;
+	static std::unordered_map<void*, size_t> allocations;
+
+public:
+	// turns on the privilege that large pages need, false if
+	// the user does not have it, then nothing uses large pages
+	static bool Enable();
+	static bool IsEnabled() { return enabled; }
+	static size_t GetPageSize() { return pageSize; }
+
+	// the memory is aligned to at least 16 bytes, like malloc
+	static void* Allocate(size_t bytes);
+	static void Free(void* memory);
+
+	// the bytes that are in large pages right now
+	static size_t GetAllocatedBytes();
+};
+
+// Lets a std::vector keep its elements in large pages
+// (when it is big enough), like LargePageVector<float>
+template <typename T>
+struct LargePageAllocator
+{
+	typedef T value_type;
+
+	LargePageAllocator() {}
+	template <typename U> LargePageAllocator(const LargePageAllocator<U>&) {}
+
+	T* allocate(size_t count) { return (T*)LargePages::Allocate(count * sizeof(T)); }
+	void deallocate(T* memory, size_t) { LargePages::Free(memory); }
+
+	template <typename U> bool operator==(const LargePageAllocator<U>&) const { return true; }
+	template <typename U> bool operator!=(const LargePageAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using LargePageVector = std::vector<T, LargePageAllocator<T>>;
@@ -0,0 +1,245 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "LatencyMarkers.h"
+#include "HostAllocator.h"
+#include <stdio.h>
+#include <string.h>
+
+static uint64_t NowNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		CpuClock::now().time_since_epoch()).count();
+}
+
+LatencyMarkers::LatencyMarkers(VkDevice device)
+{
+	this->device = device;
+	swapchain = VK_NULL_HANDLE;
+
+	nvEnabled = false;
+	fpSetLatencySleepModeNV = NULL;
+	fpLatencySleepNV = NULL;
+	fpSetLatencyMarkerNV = NULL;
+	fpWaitSemaphoresKHR = NULL;
+	sleepSemaphore = VK_NULL_HANDLE;
+	sleepValue = 0;
+
+	amdEnabled = false;
+	fpAntiLagUpdateAMD = NULL;
+
+	memset(frameIds, 0, sizeof(frameIds));
+	memset(times, 0, sizeof(times));
+
+	count = 0;
+	inputToSubmitTotal = 0.0;
+	submitToPresentTotal = 0.0;
+	inputToPhotonTotal = 0.0;
+	inputToPhotonMin = 0.0;
+	inputToPhotonMax = 0.0;
+}
+
+LatencyMarkers::~LatencyMarkers()
+{
+	if (sleepSemaphore != VK_NULL_HANDLE)
+		vkDestroySemaphore(device, sleepSemaphore, HostAllocator::callbacks);
+}
+
+void LatencyMarkers::EnableNV(
+	PFN_vkSetLatencySleepModeNV sleepModeFn,
+	PFN_vkLatencySleepNV sleepFn,
+	PFN_vkSetLatencyMarkerNV markerFn,
+	PFN_vkWaitSemaphoresKHR waitFn)
+{
+	fpSetLatencySleepModeNV = sleepModeFn;
+	fpLatencySleepNV = sleepFn;
+	fpSetLatencyMarkerNV = markerFn;
+	fpWaitSemaphoresKHR = waitFn;
+
+	// the driver signals this when the frame can start
+	VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	vkCreateSemaphore(device, &semaphoreInfo, HostAllocator::callbacks, &sleepSemaphore);
+
+	nvEnabled = true;
+}
+
+void LatencyMarkers::EnableAMD(PFN_vkAntiLagUpdateAMD antiLagFn)
+{
+	fpAntiLagUpdateAMD = antiLagFn;
+	amdEnabled = true;
+}
+
+void LatencyMarkers::SetSwapchain(VkSwapchainKHR swapchain)
+{
+	this->swapchain = swapchain;
+
+	if (!nvEnabled)
+		return;
+
+	// Turn on the low latency mode of the driver. The boost keeps the
+	// GPU clocks up, even when it waits for the CPU. There is no
+	// minimum interval, the frame limiter (see FrameLimiter.h)
+	// already keeps the frames apart if there is a limit
+	VkLatencySleepModeInfoNV modeInfo = {};
+	modeInfo.sType = VK_STRUCTURE_TYPE_LATENCY_SLEEP_MODE_INFO_NV;
+	modeInfo.lowLatencyMode = VK_TRUE;
+	modeInfo.lowLatencyBoost = VK_TRUE;
+	modeInfo.minimumIntervalUs = 0;
+	fpSetLatencySleepModeNV(device, swapchain, &modeInfo);
+}
+
+void LatencyMarkers::AntiLag(VkAntiLagStageAMD stage, uint64_t frameId)
+{
+	VkAntiLagPresentationInfoAMD presentationInfo = {};
+	presentationInfo.sType = VK_STRUCTURE_TYPE_ANTI_LAG_PRESENTATION_INFO_AMD;
+	presentationInfo.stage = stage;
+	presentationInfo.frameIndex = frameId;
+
+	// no maximum frame rate, that is the frame limiter's job
+	VkAntiLagDataAMD data = {};
+	data.sType = VK_STRUCTURE_TYPE_ANTI_LAG_DATA_AMD;
+	data.mode = VK_ANTI_LAG_MODE_ON_AMD;
+	data.maxFPS = 0;
+	data.pPresentationInfo = &presentationInfo;
+	fpAntiLagUpdateAMD(device, &data);
+}
+
+void LatencyMarkers::Sleep(uint64_t frameId)
+{
+	// The driver knows when the GPU will be ready for the next
+	// frame, from the markers of the last frames. It signals the
+	// semaphore when the CPU should start, so the input that we
+	// read next is as new as it can be when the GPU draws it
+	if (nvEnabled && swapchain != VK_NULL_HANDLE)
+	{
+		sleepValue++;
+
+		VkLatencySleepInfoNV sleepInfo = {};
+		sleepInfo.sType = VK_STRUCTURE_TYPE_LATENCY_SLEEP_INFO_NV;
+		sleepInfo.signalSemaphore = sleepSemaphore;
+		sleepInfo.value = sleepValue;
+
+		if (fpLatencySleepNV(device, swapchain, &sleepInfo) == VK_SUCCESS)
+		{
+			VkSemaphoreWaitInfoKHR waitInfo = {};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &sleepSemaphore;
+			waitInfo.pValues = &sleepValue;
+			fpWaitSemaphoresKHR(device, &waitInfo, UINT64_MAX);
+		}
+	}
+
+	// anti-lag sleeps inside of this call, if it has to
+	if (amdEnabled)
+		AntiLag(VK_ANTI_LAG_STAGE_INPUT_AMD, frameId);
+
+	Mark(frameId, LATENCY_MARKER_INPUT_SAMPLE);
+}
+
+void LatencyMarkers::Mark(uint64_t frameId, LatencyMarker marker)
+{
+	// the slot still has a frame from LATENCY_HISTORY frames ago,
+	// or this frame was not drawn (render on demand), and is
+	// started again, then the old times do not belong to this frame
+	uint32_t slot = (uint32_t)(frameId % LATENCY_HISTORY);
+
+	if (frameIds[slot] != frameId)
+	{
+		frameIds[slot] = frameId;
+		memset(times[slot], 0, sizeof(times[slot]));
+	}
+
+	times[slot][marker] = NowNs();
+
+	// the present stage is right before vkQueuePresentKHR
+	if (amdEnabled && marker == LATENCY_MARKER_PRESENT_START)
+		AntiLag(VK_ANTI_LAG_STAGE_PRESENT_AMD, frameId);
+
+	if (nvEnabled && swapchain != VK_NULL_HANDLE)
+	{
+		VkSetLatencyMarkerInfoNV markerInfo = {};
+		markerInfo.sType = VK_STRUCTURE_TYPE_SET_LATENCY_MARKER_INFO_NV;
+		markerInfo.presentID = frameId;
+		markerInfo.marker = (VkLatencyMarkerNV)marker;
+		fpSetLatencyMarkerNV(device, swapchain, &markerInfo);
+	}
+}
+
+void LatencyMarkers::OnPresented(uint64_t frameId, uint64_t timeNs)
+{
+	// the markers of this frame are gone already, if
+	// the timing came back too late, or it was never marked
+	uint32_t slot = (uint32_t)(frameId % LATENCY_HISTORY);
+
+	if (frameIds[slot] != frameId)
+		return;
+
+	uint64_t* frame = times[slot];
+	uint64_t input = frame[LATENCY_MARKER_INPUT_SAMPLE];
+	uint64_t submit = frame[LATENCY_MARKER_RENDER_SUBMIT_END];
+
+	if (input == 0 || submit < input || timeNs < submit)
+		return;
+
+	double inputToPhoton = (timeNs - input) / 1000000.0;
+	inputToSubmitTotal += (submit - input) / 1000000.0;
+	submitToPresentTotal += (timeNs - submit) / 1000000.0;
+	inputToPhotonTotal += inputToPhoton;
+
+	if (count == 0 || inputToPhoton < inputToPhotonMin)
+		inputToPhotonMin = inputToPhoton;
+
+	if (count == 0 || inputToPhoton > inputToPhotonMax)
+		inputToPhotonMax = inputToPhoton;
+
+	// each frame is only counted once
+	frameIds[slot] = 0;
+	count++;
+
+	if (count < LATENCY_REPORT_FRAMES)
+		return;
+
+	printf("Latency: input to photon %.2f ms (min %.2f, max %.2f), input to submit %.2f ms, submit to present %.2f ms%s%s\n",
+		inputToPhotonTotal / count,
+		inputToPhotonMin,
+		inputToPhotonMax,
+		inputToSubmitTotal / count,
+		submitToPresentTotal / count,
+		nvEnabled ? ", NV low latency" : "",
+		amdEnabled ? ", AMD anti-lag" : "");
+
+	count = 0;
+	inputToSubmitTotal = 0.0;
+	submitToPresentTotal = 0.0;
+	inputToPhotonTotal = 0.0;
+}
@@ -0,0 +1,125 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include "CpuProfiler.h"
+#include "TimelineSemaphore.h"
+#include "LowLatency.h"
+
+// how many frames of markers are kept, the times of a frame are
+// needed until its present is on the screen, which is a few frames
+#define LATENCY_HISTORY 64
+
+// how many frames are averaged for each line of the report
+#define LATENCY_REPORT_FRAMES 300
+
+// The points of a frame that are marked, in the same order as
+// VkLatencyMarkerNV, so they can be given to the driver as they are
+enum LatencyMarker
+{
+	LATENCY_MARKER_SIMULATION_START,
+	LATENCY_MARKER_SIMULATION_END,
+	LATENCY_MARKER_RENDER_SUBMIT_START,
+	LATENCY_MARKER_RENDER_SUBMIT_END,
+	LATENCY_MARKER_PRESENT_START,
+	LATENCY_MARKER_PRESENT_END,
+	LATENCY_MARKER_INPUT_SAMPLE,
+	LATENCY_MARKER_COUNT
+};
+
+// Remembers when each frame reached each marker, and measures the
+// time from reading the input to the image being on the screen,
+// which is the latency that the player feels. The frame ID is the
+// same number as the present ID (frame_count + 1), so the markers
+// can be matched with the present timing.
+// If the GPU has VK_NV_low_latency2, the markers also go to the
+// driver, and Sleep waits until the driver says it is time to start
+// the frame, so that the frame does not wait in the queue after it
+// is submitted. VK_AMD_anti_lag does the same thing without
+// markers, it is just told where the input and the present are
+class LatencyMarkers
+{
+private:
+	VkDevice device;
+	VkSwapchainKHR swapchain;
+
+	// VK_NV_low_latency2 signals a timeline semaphore when it is
+	// time to start the frame, each sleep waits for the next value
+	bool nvEnabled;
+	PFN_vkSetLatencySleepModeNV fpSetLatencySleepModeNV;
+	PFN_vkLatencySleepNV fpLatencySleepNV;
+	PFN_vkSetLatencyMarkerNV fpSetLatencyMarkerNV;
+	PFN_vkWaitSemaphoresKHR fpWaitSemaphoresKHR;
+	VkSemaphore sleepSemaphore;
+	uint64_t sleepValue;
+
+	bool amdEnabled;
+	PFN_vkAntiLagUpdateAMD fpAntiLagUpdateAMD;
+
+	// the CPU time of each marker, in nanoseconds, for the
+	// last LATENCY_HISTORY frames, in the slot frameId % LATENCY_HISTORY
+	uint64_t frameIds[LATENCY_HISTORY];
+	uint64_t times[LATENCY_HISTORY][LATENCY_MARKER_COUNT];
+
+	// the frames that are on the screen since the last report
+	uint32_t count;
+	double inputToSubmitTotal;
+	double submitToPresentTotal;
+	double inputToPhotonTotal;
+	double inputToPhotonMin;
+	double inputToPhotonMax;
+
+	void AntiLag(VkAntiLagStageAMD stage, uint64_t frameId);
+
+public:
+	LatencyMarkers(VkDevice device);
+	~LatencyMarkers();
+
+	// gives the functions of the extensions, each one is
+	// only used if it was given
+	void EnableNV(
+		PFN_vkSetLatencySleepModeNV sleepModeFn,
+		PFN_vkLatencySleepNV sleepFn,
+		PFN_vkSetLatencyMarkerNV markerFn,
+		PFN_vkWaitSemaphoresKHR waitFn);
+	void EnableAMD(PFN_vkAntiLagUpdateAMD antiLagFn);
+
+	// the NV markers and the sleep belong to a swapchain, which needs
+	// VkSwapchainLatencyCreateInfoNV, this is called after each one is made
+	void SetSwapchain(VkSwapchainKHR swapchain);
+
+	// waits until it is time to start frameId, and marks when its
+	// input is read, so this is called right before the input is read
+	void Sleep(uint64_t frameId);
+
+	// remembers that frameId reached the marker now
+	void Mark(uint64_t frameId, LatencyMarker marker);
+
+	// frameId was on the screen at timeNs, on the same clock as
+	// CpuClock, which adds it to the report
+	void OnPresented(uint64_t frameId, uint64_t timeNs);
+};
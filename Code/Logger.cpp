@@ -0,0 +1,385 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "Logger.h"
+#include <string.h>
+#include <chrono>
+
+std::vector<LogRing*> Logger::rings;
+std::mutex Logger::ringMutex;
+thread_local LogRing* Logger::localRing = nullptr;
+
+std::thread Logger::thread;
+std::mutex Logger::mutex;
+std::condition_variable Logger::condition;
+std::atomic<bool> Logger::running(false);
+bool Logger::quit = false;
+FILE* Logger::file = nullptr;
+
+// the text that Drain collects, before it writes it all at once
+#define LOG_OUTPUT_SIZE (64 * 1024)
+
+static uint64_t NowNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Logger::Start(const char* path)
+{
+	if (running)
+		return;
+
+	file = nullptr;
+
+	if (path != nullptr)
+	{
+		file = fopen(path, "a");
+
+		if (file == nullptr)
+			printf("Could not open %s, the log only goes to the console\n", path);
+	}
+
+	quit = false;
+	thread = std::thread(&Logger::Run);
+	running = true;
+}
+
+void Logger::Stop()
+{
+	if (!running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	condition.notify_all();
+	thread.join();
+	running = false;
+
+	if (file != nullptr)
+	{
+		fclose(file);
+		file = nullptr;
+	}
+
+	// The threads that logged might still be alive, so their
+	// rings are kept, new messages are printed right away anyway
+}
+
+LogRing* Logger::GetRing()
+{
+	// the first message of a thread makes its ring,
+	// which is the only time that a lock is taken
+	if (localRing == nullptr)
+	{
+		LogRing* ring = new LogRing();
+		ring->head = 0;
+		ring->tail = 0;
+		ring->dropped = 0;
+
+		std::lock_guard<std::mutex> lock(ringMutex);
+		rings.push_back(ring);
+		localRing = ring;
+	}
+
+	return localRing;
+}
+
+void Logger::Push(const char* format, const LogArg* args, uint32_t count)
+{
+	LogRecord record;
+	record.ns = NowNs();
+	record.format = format;
+	record.argCount = count;
+	memcpy(record.args, args, count * sizeof(LogArg));
+
+	// every string is copied, as much of it as fits, and each
+	// one ends with its own zero, even when it was cut
+	uint32_t used = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		LogArg& arg = record.args[i];
+		if (arg.type != LOG_ARG_STRING)
+			continue;
+
+		if (args[i].s == nullptr)
+		{
+			arg.offset = LOG_NULL_STRING;
+			continue;
+		}
+
+		size_t room = LOG_STRING_SIZE - used - 1;
+		size_t length = strnlen(args[i].s, room);
+
+		memcpy(record.strings + used, args[i].s, length);
+		record.strings[used + length] = '\0';
+
+		// once they are full, the rest of the strings
+		// are empty ones, on the last zero
+		arg.offset = used;
+		used += (uint32_t)length + 1;
+		if (used > LOG_STRING_SIZE - 1)
+			used = LOG_STRING_SIZE - 1;
+	}
+
+	// without the thread, there is nobody to write it later
+	if (!running)
+	{
+		char text[1024];
+		Format(record, text, sizeof(text));
+		fputs(text, stdout);
+		fflush(stdout);
+		return;
+	}
+
+	LogRing* ring = GetRing();
+
+	// the logging thread moves tail, so it might be further
+	// than this, which only means that there is more room
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	uint64_t tail = ring->tail.load(std::memory_order_acquire);
+
+	if (head - tail >= LOG_RING_SIZE)
+	{
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring->records[head % LOG_RING_SIZE] = record;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+size_t Logger::Format(const LogRecord& record, char* out, size_t size)
+{
+	// The format is read one conversion at a time, and each one is
+	// given to snprintf with its own argument. The length modifiers
+	// (l, ll, z, and so on) are replaced, because every integer was
+	// stored as 64 bits, which would not match a plain %d
+	size_t length = 0;
+	uint32_t next = 0;
+	const char* c = record.format;
+
+	while (*c != '\0' && length + 1 < size)
+	{
+		if (*c != '%')
+		{
+			out[length++] = *c++;
+			continue;
+		}
+
+		if (c[1] == '%')
+		{
+			out[length++] = '%';
+			c += 2;
+			continue;
+		}
+
+		// flags, width, and precision are kept
+		char spec[32];
+		size_t specLength = 0;
+		spec[specLength++] = *c++;
+
+		while (*c != '\0' && strchr("-+ #0123456789.", *c) != nullptr && specLength < sizeof(spec) - 4)
+			spec[specLength++] = *c++;
+
+		while (*c != '\0' && strchr("hljztLI6432", *c) != nullptr)
+			c++;
+
+		char conversion = *c;
+		if (conversion == '\0')
+			break;
+		c++;
+
+		int written = 0;
+		size_t room = size - length;
+
+		if (next >= record.argCount)
+		{
+			written = snprintf(out + length, room, "(missing)");
+		}
+		else
+		{
+			const LogArg& arg = record.args[next++];
+
+			bool isInteger = (arg.type == LOG_ARG_INT || arg.type == LOG_ARG_UINT);
+			long long integer = (arg.type == LOG_ARG_INT) ? (long long)arg.i : (long long)arg.u;
+
+			if (strchr("di", conversion) != nullptr && isInteger)
+			{
+				spec[specLength++] = 'l';
+				spec[specLength++] = 'l';
+				spec[specLength++] = conversion;
+				spec[specLength] = '\0';
+				written = snprintf(out + length, room, spec, integer);
+			}
+			else if (strchr("uxXo", conversion) != nullptr && isInteger)
+			{
+				spec[specLength++] = 'l';
+				spec[specLength++] = 'l';
+				spec[specLength++] = conversion;
+				spec[specLength] = '\0';
+				written = snprintf(out + length, room, spec, (unsigned long long)integer);
+			}
+			else if (conversion == 'c' && isInteger)
+			{
+				spec[specLength++] = 'c';
+				spec[specLength] = '\0';
+				written = snprintf(out + length, room, spec, (int)integer);
+			}
+			else if (strchr("feEgGaA", conversion) != nullptr && (arg.type == LOG_ARG_DOUBLE || isInteger))
+			{
+				spec[specLength++] = conversion;
+				spec[specLength] = '\0';
+				written = snprintf(out + length, room, spec, arg.type == LOG_ARG_DOUBLE ? arg.d : (double)integer);
+			}
+			else if (conversion == 's' && arg.type == LOG_ARG_STRING)
+			{
+				spec[specLength++] = 's';
+				spec[specLength] = '\0';
+				written = snprintf(out + length, room, spec, arg.offset != LOG_NULL_STRING ? record.strings + arg.offset : "(null)");
+			}
+			else if (conversion == 'p')
+			{
+				written = snprintf(out + length, room, "%p", arg.p);
+			}
+			else
+			{
+				written = snprintf(out + length, room, "(bad %%%c)", conversion);
+			}
+		}
+
+		if (written > 0)
+			length += ((size_t)written < room) ? (size_t)written : room - 1;
+	}
+
+	out[length] = '\0';
+	return length;
+}
+
+void Logger::Drain()
+{
+	static char output[LOG_OUTPUT_SIZE];
+	size_t length = 0;
+
+	std::vector<LogRing*> all;
+	{
+		std::lock_guard<std::mutex> lock(ringMutex);
+		all = rings;
+	}
+
+	// how far each ring is filled right now, messages that
+	// come in while this runs are written the next time
+	std::vector<uint64_t> heads(all.size());
+	for (size_t r = 0; r < all.size(); r++)
+		heads[r] = all[r]->head.load(std::memory_order_acquire);
+
+	while (true)
+	{
+		// the oldest message of every ring goes first,
+		// so the messages of all threads are in order
+		size_t oldest = SIZE_MAX;
+		uint64_t oldestNs = UINT64_MAX;
+
+		for (size_t r = 0; r < all.size(); r++)
+		{
+			uint64_t tail = all[r]->tail.load(std::memory_order_relaxed);
+
+			if (tail < heads[r] && all[r]->records[tail % LOG_RING_SIZE].ns < oldestNs)
+			{
+				oldest = r;
+				oldestNs = all[r]->records[tail % LOG_RING_SIZE].ns;
+			}
+		}
+
+		if (oldest == SIZE_MAX)
+			break;
+
+		LogRing* ring = all[oldest];
+		uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+
+		// the output is written when a message might not fit
+		if (length + 1024 > LOG_OUTPUT_SIZE)
+		{
+			fwrite(output, 1, length, stdout);
+			if (file != nullptr)
+				fwrite(output, 1, length, file);
+			length = 0;
+		}
+
+		length += Format(ring->records[tail % LOG_RING_SIZE], output + length, 1024);
+		ring->tail.store(tail + 1, std::memory_order_release);
+	}
+
+	for (size_t r = 0; r < all.size(); r++)
+	{
+		// there has to be room before the count is taken,
+		// or it would be lost along with the line
+		if (length + 64 > LOG_OUTPUT_SIZE)
+		{
+			fwrite(output, 1, length, stdout);
+			if (file != nullptr)
+				fwrite(output, 1, length, file);
+			length = 0;
+		}
+
+		uint32_t dropped = all[r]->dropped.exchange(0, std::memory_order_relaxed);
+
+		if (dropped > 0)
+			length += snprintf(output + length, 64, "Logger: %u messages were dropped\n", dropped);
+	}
+
+	if (length == 0)
+		return;
+
+	fwrite(output, 1, length, stdout);
+	fflush(stdout);
+
+	if (file != nullptr)
+	{
+		fwrite(output, 1, length, file);
+		fflush(file);
+	}
+}
+
+void Logger::Run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (!quit)
+	{
+		// nobody wakes this thread for a message, that would be
+		// a system call in the thread that logs, it just looks
+		condition.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_MS));
+
+		lock.unlock();
+		Drain();
+		lock.lock();
+	}
+
+	lock.unlock();
+	Drain();
+}
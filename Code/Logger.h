@@ -0,0 +1,164 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+// how many messages each thread can have waiting, a power of two.
+// When a ring is full, the message is dropped (and counted), the
+// thread that logs never waits for the logging thread
+#define LOG_RING_SIZE 1024
+
+// the most arguments of one message, after the format
+#define LOG_MAX_ARGS 8
+
+// the bytes of one message for the text of its string arguments,
+// with their ends, a longer string is cut
+#define LOG_STRING_SIZE 256
+
+// how often the logging thread writes what is waiting
+#define LOG_FLUSH_MS 10
+
+enum LogArgType
+{
+	LOG_ARG_INT,
+	LOG_ARG_UINT,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_STRING,
+	LOG_ARG_POINTER
+};
+
+// One argument of a message, as it was given, it is only
+// turned into text later, on the logging thread. A string is
+// given as s, and Push copies it into the message, after that
+// it is the offset of its copy in the strings of the message
+struct LogArg
+{
+	uint32_t type;
+	union
+	{
+		int64_t i;
+		uint64_t u;
+		double d;
+		const char* s;
+		uint32_t offset;
+		const void* p;
+	};
+};
+
+// the offset of a string argument that was nullptr
+#define LOG_NULL_STRING UINT32_MAX
+
+// The format is the "id" of the message. It has to be a string
+// literal (or live until the program ends), because only the pointer
+// is kept. String arguments are copied into strings, because the
+// logging thread reads them long after the caller might have freed
+// them, so they can be in buffers on the stack
+struct LogRecord
+{
+	uint64_t ns;
+	const char* format;
+	uint32_t argCount;
+	LogArg args[LOG_MAX_ARGS];
+	char strings[LOG_STRING_SIZE];
+};
+
+// A ring of messages from one thread to the logging thread. Only
+// its thread writes head, and only the logging thread writes tail,
+// so neither one needs a lock
+struct LogRing
+{
+	LogRecord records[LOG_RING_SIZE];
+	std::atomic<uint64_t> head;
+	std::atomic<uint64_t> tail;
+	std::atomic<uint32_t> dropped;
+};
+
+// Logs like printf, but the thread that logs only copies the format
+// and the arguments into a ring of its own, which takes well under a
+// microsecond, so logging can stay on in the hot paths. The logging
+// thread turns them into text and writes them, in the order of their
+// times. Before Start, and after Stop, messages are printed right away
+class Logger
+{
+private:
+	static std::vector<LogRing*> rings;
+	static std::mutex ringMutex;
+	static thread_local LogRing* localRing;
+
+	static std::thread thread;
+	static std::mutex mutex;
+	static std::condition_variable condition;
+	static std::atomic<bool> running;
+	static bool quit;
+	static FILE* file;
+
+	static void SetArg(LogArg& arg, int value) { arg.type = LOG_ARG_INT; arg.i = value; }
+	static void SetArg(LogArg& arg, long value) { arg.type = LOG_ARG_INT; arg.i = value; }
+	static void SetArg(LogArg& arg, long long value) { arg.type = LOG_ARG_INT; arg.i = value; }
+	static void SetArg(LogArg& arg, unsigned int value) { arg.type = LOG_ARG_UINT; arg.u = value; }
+	static void SetArg(LogArg& arg, unsigned long value) { arg.type = LOG_ARG_UINT; arg.u = value; }
+	static void SetArg(LogArg& arg, unsigned long long value) { arg.type = LOG_ARG_UINT; arg.u = value; }
+	static void SetArg(LogArg& arg, double value) { arg.type = LOG_ARG_DOUBLE; arg.d = value; }
+	static void SetArg(LogArg& arg, const char* value) { arg.type = LOG_ARG_STRING; arg.s = value; }
+	static void SetArg(LogArg& arg, const void* value) { arg.type = LOG_ARG_POINTER; arg.p = value; }
+
+	static LogRing* GetRing();
+	static void Push(const char* format, const LogArg* args, uint32_t count);
+	static void Run();
+	static void Drain();
+	static size_t Format(const LogRecord& record, char* out, size_t size);
+
+public:
+	// starts the logging thread, everything also goes
+	// to the file at path, unless it is nullptr
+	static void Start(const char* path);
+
+	// writes every message that is waiting, then stops the thread
+	static void Stop();
+
+	template<typename... Args>
+	static void Write(const char* format, Args... args)
+	{
+		static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many arguments for one log message");
+
+		// one more, so there is an array even without arguments
+		LogArg packed[sizeof...(Args) + 1];
+		uint32_t i = 0;
+		int expand[] = { 0, (SetArg(packed[i++], args), 0)... };
+		(void)expand;
+
+		Push(format, packed, (uint32_t)sizeof...(Args));
+	}
+};
+
+// logs a message, the same way as printf
+#define LOG(...) Logger::Write(__VA_ARGS__)
@@ -0,0 +1,149 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+
+// VK_NV_low_latency2 and VK_AMD_anti_lag are newer than the Vulkan
+// headers in the Include folder, so we declare the parts that we use,
+// the same way as PresentWait.h. They are skipped when the headers
+// are new enough to have them
+#ifndef VK_NV_low_latency2
+#define VK_NV_low_latency2 1
+#define VK_NV_LOW_LATENCY_2_SPEC_VERSION 2
+#define VK_NV_LOW_LATENCY_2_EXTENSION_NAME "VK_NV_low_latency2"
+
+#define VK_STRUCTURE_TYPE_LATENCY_SLEEP_MODE_INFO_NV ((VkStructureType)1000505000)
+#define VK_STRUCTURE_TYPE_LATENCY_SLEEP_INFO_NV ((VkStructureType)1000505001)
+#define VK_STRUCTURE_TYPE_SET_LATENCY_MARKER_INFO_NV ((VkStructureType)1000505002)
+#define VK_STRUCTURE_TYPE_LATENCY_SUBMISSION_PRESENT_ID_NV ((VkStructureType)1000505005)
+#define VK_STRUCTURE_TYPE_SWAPCHAIN_LATENCY_CREATE_INFO_NV ((VkStructureType)1000505007)
+
+typedef enum VkLatencyMarkerNV
+{
+	VK_LATENCY_MARKER_SIMULATION_START_NV = 0,
+	VK_LATENCY_MARKER_SIMULATION_END_NV = 1,
+	VK_LATENCY_MARKER_RENDERSUBMIT_START_NV = 2,
+	VK_LATENCY_MARKER_RENDERSUBMIT_END_NV = 3,
+	VK_LATENCY_MARKER_PRESENT_START_NV = 4,
+	VK_LATENCY_MARKER_PRESENT_END_NV = 5,
+	VK_LATENCY_MARKER_INPUT_SAMPLE_NV = 6,
+	VK_LATENCY_MARKER_MAX_ENUM_NV = 0x7FFFFFFF
+} VkLatencyMarkerNV;
+
+typedef struct VkLatencySleepModeInfoNV
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkBool32 lowLatencyMode;
+	VkBool32 lowLatencyBoost;
+	uint32_t minimumIntervalUs;
+} VkLatencySleepModeInfoNV;
+
+typedef struct VkLatencySleepInfoNV
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkSemaphore signalSemaphore;
+	uint64_t value;
+} VkLatencySleepInfoNV;
+
+typedef struct VkSetLatencyMarkerInfoNV
+{
+	VkStructureType sType;
+	const void* pNext;
+	uint64_t presentID;
+	VkLatencyMarkerNV marker;
+} VkSetLatencyMarkerInfoNV;
+
+typedef struct VkLatencySubmissionPresentIdNV
+{
+	VkStructureType sType;
+	const void* pNext;
+	uint64_t presentID;
+} VkLatencySubmissionPresentIdNV;
+
+typedef struct VkSwapchainLatencyCreateInfoNV
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkBool32 latencyModeEnable;
+} VkSwapchainLatencyCreateInfoNV;
+
+typedef VkResult (VKAPI_PTR *PFN_vkSetLatencySleepModeNV)(VkDevice device, VkSwapchainKHR swapchain, const VkLatencySleepModeInfoNV* pSleepModeInfo);
+typedef VkResult (VKAPI_PTR *PFN_vkLatencySleepNV)(VkDevice device, VkSwapchainKHR swapchain, const VkLatencySleepInfoNV* pSleepInfo);
+typedef void (VKAPI_PTR *PFN_vkSetLatencyMarkerNV)(VkDevice device, VkSwapchainKHR swapchain, const VkSetLatencyMarkerInfoNV* pLatencyMarkerInfo);
+#endif
+
+#ifndef VK_AMD_anti_lag
+#define VK_AMD_anti_lag 1
+#define VK_AMD_ANTI_LAG_SPEC_VERSION 1
+#define VK_AMD_ANTI_LAG_EXTENSION_NAME "VK_AMD_anti_lag"
+
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ANTI_LAG_FEATURES_AMD ((VkStructureType)1000476000)
+#define VK_STRUCTURE_TYPE_ANTI_LAG_DATA_AMD ((VkStructureType)1000476001)
+#define VK_STRUCTURE_TYPE_ANTI_LAG_PRESENTATION_INFO_AMD ((VkStructureType)1000476002)
+
+typedef enum VkAntiLagModeAMD
+{
+	VK_ANTI_LAG_MODE_DRIVER_CONTROL_AMD = 0,
+	VK_ANTI_LAG_MODE_ON_AMD = 1,
+	VK_ANTI_LAG_MODE_OFF_AMD = 2,
+	VK_ANTI_LAG_MODE_MAX_ENUM_AMD = 0x7FFFFFFF
+} VkAntiLagModeAMD;
+
+typedef enum VkAntiLagStageAMD
+{
+	VK_ANTI_LAG_STAGE_INPUT_AMD = 0,
+	VK_ANTI_LAG_STAGE_PRESENT_AMD = 1,
+	VK_ANTI_LAG_STAGE_MAX_ENUM_AMD = 0x7FFFFFFF
+} VkAntiLagStageAMD;
+
+typedef struct VkPhysicalDeviceAntiLagFeaturesAMD
+{
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 antiLag;
+} VkPhysicalDeviceAntiLagFeaturesAMD;
+
+typedef struct VkAntiLagPresentationInfoAMD
+{
+	VkStructureType sType;
+	void* pNext;
+	VkAntiLagStageAMD stage;
+	uint64_t frameIndex;
+} VkAntiLagPresentationInfoAMD;
+
+typedef struct VkAntiLagDataAMD
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkAntiLagModeAMD mode;
+	uint32_t maxFPS;
+	const VkAntiLagPresentationInfoAMD* pPresentationInfo;
+} VkAntiLagDataAMD;
+
+typedef void (VKAPI_PTR *PFN_vkAntiLagUpdateAMD)(VkDevice device, const VkAntiLagDataAMD* pData);
+#endif
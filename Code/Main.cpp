@@ -24,14 +24,253 @@ that utilizes Vulkan, see more at http://cemu.info
  
 #include "Demo.h"
 #include "Main.h"
+#include "WindowEventQueue.h"
+#include "RawInput.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include <vector>
 
-// Make this global, so it can be initialized in WinMain
-// and used in WndProc
-Demo* demo;
+// keyboard keys, by virtual key code, which is one byte
+bool keys[256];
 
-// keyboard keys
-bool keys[255];
+// "-headless 600" quits after 600 frames, zero draws until Ctrl+C
+uint32_t headlessFrames = 0;
+
+// One Demo, and everything that WndProc and the render loop need to
+// talk to it. With "-contexts N", there are N of them, which share one
+// instance and one device (see DeviceContext.h). Each one has its own
+// window (or none, in headless mode), and its own render thread
+struct RenderContext
+{
+	Demo* demo;
+
+	// The window's messages are handled on the main thread, and the
+	// demo draws on the render thread. WndProc puts everything that
+	// the demo needs to know about into this queue
+	WindowEventQueue windowEvents;
+	std::atomic<bool> quitRender;
+	std::thread renderThread;
+
+	// Keys and mouse buttons are read with Raw Input, which puts them
+	// into windowEvents (see RawInput.h). Raw Input goes to one window
+	// of the process, so only the first context has it. If it is not
+	// there, WndProc sends the keys from WM_KEYDOWN and WM_KEYUP instead
+	RawInput* rawInput;
+};
+
+// every context, so that Ctrl+C can stop all of them.
+// WndProc finds the context of a window in GWLP_USERDATA
+std::vector<RenderContext*> renderContexts;
+
+// the devices that the contexts use, one for each GPU, see "-gpus"
+std::vector<DeviceContext*> deviceContexts;
+
+void RenderLoop(RenderContext* context)
+{
+	Demo* demo = context->demo;
+	WindowEventQueue& windowEvents = context->windowEvents;
+
+	// With thread scheduling, this thread joins its MMCSS task,
+	// and goes to its own core, see ThreadScheduler.h
+	HANDLE task = demo->use_thread_scheduling ? ThreadScheduler::Apply(demo->render_schedule, "render") : NULL;
+
+	// false when the window is hidden, then
+	// nobody can see what we draw
+	bool visible = true;
+
+	// Dragging the edge of the window sends a lot of
+	// WM_SIZE messages. Rebuilding the swapchain for each
+	// of them is slow, and only the last size matters,
+	// so we only remember the newest size here
+	bool resized = false;
+	uint32_t newWidth = 0;
+	uint32_t newHeight = 0;
+
+	// While the window is dragged (between WM_ENTERSIZEMOVE and
+	// WM_EXITSIZEMOVE), the swapchain is only rebuilt every
+	// LIVE_RESIZE_INTERVAL_MS, and the frames in between keep drawing
+	// into the old one, so the cubes keep moving while the edge moves,
+	// without a full rebuild for every frame. Letting go rebuilds it
+	// with the final size right away
+	bool sizing = false;
+	CpuClock::time_point lastResize = CpuClock::now();
+
+	while (!context->quitRender)
+	{
+		// With a frame rate limit, we sleep here, until it is time for
+		// the next frame. This is before the events are read, and before
+		// draw() moves the cubes, so the frame uses the newest input and
+		// the newest time, and the wait does not add latency. Sleeping
+		// after the frame would show input that is a whole wait old
+		demo->frame_limiter->Wait();
+
+		// With latency markers, the low latency extensions of NV and
+		// AMD can wait a little longer here, until the GPU is ready for
+		// the next frame, and then the input below is read (see LatencyMarkers.h)
+		demo->sleep_for_latency();
+
+		// handle every event that came from the window
+		// since the last frame, in the same order, before
+		// drawing, so input never waits behind a frame
+		WindowEvent event;
+
+		while (windowEvents.Pop(&event))
+		{
+			if (event.type == WINDOW_EVENT_RESIZE)
+			{
+				resized = true;
+				newWidth = event.a;
+				newHeight = event.b;
+			}
+
+			// P switches to the next present mode
+			else if (event.type == WINDOW_EVENT_KEY_DOWN && event.a == 'P')
+				demo->cycle_present_mode();
+
+			// M prints how much memory the demo uses
+			else if (event.type == WINDOW_EVENT_KEY_DOWN && event.a == 'M')
+				demo->print_memory_report();
+
+			// T writes a trace of the next frames, if it is turned on
+			else if (event.type == WINDOW_EVENT_KEY_DOWN && event.a == 'T')
+				demo->start_trace();
+
+			// V digs a hole into the voxel world, if there is one
+			else if (event.type == WINDOW_EVENT_KEY_DOWN && event.a == 'V')
+				demo->dig_voxel_world();
+
+			// Space stops and starts the animation
+			else if (event.type == WINDOW_EVENT_KEY_DOWN && event.a == VK_SPACE)
+				demo->toggle_animation();
+
+			// a click picks the object under the mouse, if picking is on
+			else if (event.type == WINDOW_EVENT_CLICK)
+				demo->pick_object(event.a, event.b);
+
+			else if (event.type == WINDOW_EVENT_SIZE_MOVE)
+				sizing = (event.a != 0);
+
+			else if (event.type == WINDOW_EVENT_VISIBILITY)
+			{
+				visible = (event.a != 0);
+
+				// the window might not show the old image anymore
+				if (visible)
+					demo->request_redraw();
+			}
+		}
+
+		// When the window is opened, resized,
+		// minimized, or maximized, then rebuild
+		// all assets that depend on window size,
+		// one time, with the final size. While the
+		// window is dragged, it can wait a little,
+		// unless the driver can not draw the old size
+		double sinceResize = std::chrono::duration<double, std::milli>(CpuClock::now() - lastResize).count();
+		bool throttled = sizing && sinceResize < LIVE_RESIZE_INTERVAL_MS && !demo->swapchain_stale;
+
+		if (resized && !throttled)
+		{
+			demo->width = newWidth;
+			demo->height = newHeight;
+			demo->resize();
+
+			resized = false;
+			lastResize = CpuClock::now();
+		}
+
+		// If the window is minimized, there is no swapchain, and
+		// if the window is hidden, nobody can see it. Either way
+		// there is nothing to draw, so instead of spinning through
+		// the loop at 100% CPU, we sleep until the window sends
+		// another event (like being restored), or until we quit.
+		// The benchmark always draws, so that it can finish, and
+		// without a window, nothing would ever wake us up again
+		if ((demo->is_minimized || !visible) && demo->benchmark_frames == 0 && demo->window != NULL)
+		{
+			windowEvents.Wait();
+			continue;
+		}
+
+		// This is the demo's main update function,
+		// It will update everything related to the demo.
+		// Go to Demo.cpp and look for Demo::run() to learn
+		// about how this works
+		demo->run();
+
+		// The benchmark quits by itself, after its last frame.
+		// Closing the window tells the main thread to stop.
+		// In headless mode, this is the main thread
+		if (demo->benchmark_done)
+		{
+			if (demo->window != NULL)
+				PostMessage(demo->window, WM_CLOSE, 0, 0);
+			break;
+		}
+
+		// Headless mode has no window to close, so
+		// it stops after its frames, if it has a count
+		if (headlessFrames > 0 && demo->frame_count >= headlessFrames)
+			break;
+
+		// With render on demand, if nothing changed, we sleep
+		// until the window sends an event. We wake up a few times
+		// every second, so run() can check the shader files
+		// A resize that is waiting for its turn is
+		// done after the interval, even without events
+		if (!demo->needs_redraw())
+			windowEvents.WaitFor(resized ? LIVE_RESIZE_INTERVAL_MS : RENDER_ON_DEMAND_POLL_MS);
+	}
+
+	ThreadScheduler::Revert(task);
+}
+
+// Without a window, Ctrl+C (or Ctrl+Break) in the console is how
+// headless mode is stopped. This runs on a thread of its own, so it
+// only tells the render loops to stop, each loop finishes its frame,
+// and WinMain deletes the demos like it always does
+BOOL WINAPI ConsoleCtrlHandler(DWORD type)
+{
+	if (type != CTRL_C_EVENT && type != CTRL_BREAK_EVENT)
+		return FALSE;
+
+	for (size_t i = 0; i < renderContexts.size(); i++)
+	{
+		renderContexts[i]->quitRender = true;
+		renderContexts[i]->windowEvents.Wake();
+	}
+
+	return TRUE;
+}
+
+// Deletes every context, the last one first, so the first Demo,
+// which made the device, is the last to go (any of them could destroy
+// it, see DeviceContext::Leave), and then the devices that they used.
+// Returns true if a benchmark got slower
+static bool DeleteRenderContexts()
+{
+	bool regressed = false;
+
+	while (!renderContexts.empty())
+	{
+		RenderContext* context = renderContexts.back();
+		regressed = regressed || context->demo->benchmark_regressed;
+
+		delete context->demo;
+		delete context->rawInput;
+		delete context;
+		renderContexts.pop_back();
+	}
+
+	for (size_t i = 0; i < deviceContexts.size(); i++)
+		delete deviceContexts[i];
+
+	deviceContexts.clear();
+	return regressed;
+}
 
 // WndProc is the default function that Windows uses to handle
 // handle a window. We do not need to call this function ourselves,
@@ -40,6 +279,13 @@ bool keys[255];
 // using the window, etc
 LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) 
 {
+	// The context of the window, which WinMain gave to it after the
+	// Demo was made. Output windows have none, and the messages that
+	// come while the Demo is being made are not sent anywhere
+	RenderContext* context = (RenderContext*)GetWindowLongPtr(hWnd, GWLP_USERDATA);
+	Demo* demo = (context != nullptr) ? context->demo : nullptr;
+	bool rawKeys = (context != nullptr) && (context->rawInput != nullptr) && context->rawInput->IsRegistered();
+
 	// when the window tries to close
 	// this sets msg.message to WM_QUIT
 	// in the main loop (in WinMain)
@@ -47,24 +293,82 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 		PostQuitMessage(0);
 
 	// When the window is opened, resized,
-	// minimized, or maximized, then rebuild
-	// all assets that depend on window size
-	else if (uMsg == WM_SIZE && (demo != nullptr))
+	// minimized, or maximized, then the render
+	// thread rebuilds all assets that depend on window size.
+	// Output windows (see OutputWindow.cpp) use this WndProc
+	// too, but they handle their own size
+	else if (uMsg == WM_SIZE && (demo != nullptr) && hWnd == demo->window)
+	{
+		WindowEvent event = { WINDOW_EVENT_RESIZE, LOWORD(lParam), HIWORD(lParam) };
+		context->windowEvents.Push(event);
+	}
+
+	// The size move loop of Windows runs inside of DispatchMessage, until
+	// the user lets go of the window, so this thread does not come back
+	// to GetMessage for that time. The render thread draws by itself,
+	// so it keeps drawing, it only needs to know when the drag starts
+	// and ends, to throttle the resizes in between
+	else if ((uMsg == WM_ENTERSIZEMOVE || uMsg == WM_EXITSIZEMOVE) && (demo != nullptr) && hWnd == demo->window)
+	{
+		WindowEvent event = { WINDOW_EVENT_SIZE_MOVE, (uMsg == WM_ENTERSIZEMOVE) ? 1u : 0u, 0 };
+		context->windowEvents.Push(event);
+	}
+
+	// When the window is hidden or shown, let the render
+	// thread know, so it can stop drawing while it is hidden
+	else if (uMsg == WM_SHOWWINDOW && (demo != nullptr) && hWnd == demo->window)
+	{
+		WindowEvent event = { WINDOW_EVENT_VISIBILITY, (uint32_t)wParam, 0 };
+		context->windowEvents.Push(event);
+	}
+
+	// Raw Input for the main window, it also reads all of
+	// the other inputs that are waiting, so the message loop
+	// does not get one message for each move of the mouse
+	else if (uMsg == WM_INPUT && rawKeys)
+		context->rawInput->OnInput((HRAWINPUT)lParam);
+
+	// the key releases do not come while the window
+	// is in the background, so every key is released now
+	else if (uMsg == WM_KILLFOCUS && (demo != nullptr) && hWnd == demo->window && rawKeys)
+		context->rawInput->ReleaseAll();
+
+	// Raw Input only says how far the mouse moved, the place of
+	// a click comes from WM_LBUTTONDOWN, in pixels of the client area
+	else if (uMsg == WM_LBUTTONDOWN && (demo != nullptr) && hWnd == demo->window)
 	{
-		demo->width = LOWORD(lParam);
-		demo->height = HIWORD(lParam);
-		demo->resize();
+		WindowEvent event = { WINDOW_EVENT_CLICK, (uint32_t)LOWORD(lParam), (uint32_t)HIWORD(lParam) };
+		context->windowEvents.Push(event);
 	}
 
 	// when a key is hit
 	// set a member of the "keys" array to true
 	else if (uMsg == WM_KEYDOWN)
-		keys[(char)wParam] = true;
+	{
+		keys[wParam & 0xFF] = true;
+
+		// Tell the render thread about the key. Bit 30 is set
+		// when the key was already down (holding the key repeats it).
+		// With Raw Input, the key was already sent by OnInput
+		if (!(lParam & (1 << 30)) && (context != nullptr) && !rawKeys)
+		{
+			WindowEvent event = { WINDOW_EVENT_KEY_DOWN, (uint32_t)wParam, 0 };
+			context->windowEvents.Push(event);
+		}
+	}
 
 	// when a key is released
 	// set a member of the "keys" array to false
 	else if (uMsg == WM_KEYUP)
-		keys[(char)wParam] = false;
+	{
+		keys[wParam & 0xFF] = false;
+
+		if ((context != nullptr) && !rawKeys)
+		{
+			WindowEvent event = { WINDOW_EVENT_KEY_UP, (uint32_t)wParam, 0 };
+			context->windowEvents.Push(event);
+		}
+	}
 
 	// this will be the return statement every time
 	// WndProc is called. Keep in mind, this function is 
@@ -73,16 +377,298 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 	return (DefWindowProc(hWnd, uMsg, wParam, lParam));
 }
 
+// every file that the demo reads, which "-pack" puts in the asset pack
+static const char* packedAssets[] =
+{
+	"../../../Assets/logo.png",
+	"../../../Assets/logo_bc7.ktx2",
+	"../../../Assets/logo_astc.ktx2",
+	"../../../Assets/logo_bc1.ktx2",
+};
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow) 
 {
+	// "-pack" writes every asset into one file, and quits
+	if (strstr(pCmdLine, "-pack") != nullptr)
+	{
+		uint32_t count = sizeof(packedAssets) / sizeof(packedAssets[0]);
+		bool built = AssetPack::Build(ASSET_PACK_FILE, packedAssets, count);
+		printf(built ? "wrote %s\n" : "could not write %s\n", ASSET_PACK_FILE);
+		return built ? 0 : 1;
+	}
+
+	// If the pack is there, it is mapped now, once, and every file
+	// that is in it is read from it, instead of from its own path.
+	// It stays mapped until WinMain returns, after the demo is deleted
+	AssetPack assetPack;
+
+	if (assetPack.Open(ASSET_PACK_FILE))
+		AssetPack::global = &assetPack;
+
+	// If the program is launched with "-benchmark 1000", then it
+	// draws 1000 frames as fast as it can, prints how fast they
+	// were, and quits. This lets scripts run the same test again
+	// and again, to see if a change made the program faster or slower
+	uint32_t benchmarkFrames = 0;
+	const char* benchmarkArg = strstr(pCmdLine, "-benchmark");
+
+	if (benchmarkArg != nullptr)
+	{
+		benchmarkFrames = (uint32_t)atoi(benchmarkArg + strlen("-benchmark"));
+
+		// "-benchmark" by itself draws 1000 frames
+		if (benchmarkFrames == 0)
+			benchmarkFrames = 1000;
+	}
+
+	// "-present mailbox" picks the present mode that the program
+	// starts with, it can be fifo, relaxed, mailbox, or immediate
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+	const char* presentArg = strstr(pCmdLine, "-present ");
+
+	if (presentArg != nullptr)
+	{
+		presentArg += strlen("-present ");
+
+		if (strncmp(presentArg, "fifo", 4) == 0)
+			presentMode = VK_PRESENT_MODE_FIFO_KHR;
+		else if (strncmp(presentArg, "relaxed", 7) == 0)
+			presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		else if (strncmp(presentArg, "mailbox", 7) == 0)
+			presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+		else if (strncmp(presentArg, "immediate", 9) == 0)
+			presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+	}
+
+	// "-frames 1" lets only one frame be in flight at a time, which
+	// has the lowest latency, "-frames 3" keeps the GPU busier
+	uint32_t frameLag = 0;
+	const char* framesArg = strstr(pCmdLine, "-frames");
+
+	if (framesArg != nullptr)
+		frameLag = (uint32_t)atoi(framesArg + strlen("-frames"));
+
+	// "-fps 60" draws at most 60 frames every second. This is for
+	// MAILBOX and IMMEDIATE, which are not limited by the monitor,
+	// to save power when a higher frame rate would not be seen
+	uint32_t targetFps = 0;
+	const char* fpsArg = strstr(pCmdLine, "-fps");
+
+	if (fpsArg != nullptr)
+		targetFps = (uint32_t)atoi(fpsArg + strlen("-fps"));
+
+	// Layers sit between our code and the driver, see prepare_instance.
+	// Debug builds use the validation layer by default, release builds
+	// use no layers at all, unless they are asked for on the command line
+	// ("-validate", "-api_dump", "-monitor", "-novalidate"), or with
+	// the VKCUBE_LAYERS environment variable, like "validation,monitor"
+#ifdef _DEBUG
+	uint32_t layerFlags = LAYER_VALIDATION;
+#else
+	uint32_t layerFlags = 0;
+#endif
+
+	const char* layerEnv = getenv("VKCUBE_LAYERS");
+
+	if (layerEnv != nullptr)
+	{
+		if (strstr(layerEnv, "validation") != nullptr)
+			layerFlags |= LAYER_VALIDATION;
+		if (strstr(layerEnv, "api_dump") != nullptr)
+			layerFlags |= LAYER_API_DUMP;
+		if (strstr(layerEnv, "monitor") != nullptr)
+			layerFlags |= LAYER_MONITOR;
+	}
+
+	if (strstr(pCmdLine, "-validate") != nullptr)
+		layerFlags |= LAYER_VALIDATION;
+	if (strstr(pCmdLine, "-novalidate") != nullptr)
+		layerFlags &= ~LAYER_VALIDATION;
+	if (strstr(pCmdLine, "-api_dump") != nullptr)
+		layerFlags |= LAYER_API_DUMP;
+	if (strstr(pCmdLine, "-monitor") != nullptr)
+		layerFlags |= LAYER_MONITOR;
+
+	// "-borderless" covers the whole monitor with the window, and
+	// "-exclusive" also lets the swapchain own the monitor, see WINDOW_MODE
+	uint32_t windowMode = WINDOW_MODE_WINDOWED;
+
+	if (strstr(pCmdLine, "-borderless") != nullptr)
+		windowMode = WINDOW_MODE_BORDERLESS;
+	if (strstr(pCmdLine, "-exclusive") != nullptr)
+		windowMode = WINDOW_MODE_EXCLUSIVE;
+
+	// "-headless" draws without a window, see WINDOW_MODE_HEADLESS.
+	// Together with "-benchmark N", it quits after N frames, and
+	// "-headless N" quits after N frames too, without the benchmark.
+	// Without a count, it draws until Ctrl+C is pressed in the console
+	const char* headlessArg = strstr(pCmdLine, "-headless");
+	bool headless = headlessArg != nullptr;
+
+	if (headless)
+	{
+		windowMode = WINDOW_MODE_HEADLESS;
+		headlessFrames = (uint32_t)atoi(headlessArg + strlen("-headless"));
+	}
+
 	// First we create demo, the demo's constructor will
 	// do all the initialization for the whole program.
 	// Go to Demo.cpp and look for Demo::Demo to learn
 	// about how this works
-	demo = new Demo();
+	// "-candidate" is how the auto-tuner gives settings to the
+	// copies of the demo that it benchmarks, and "-autotune" tunes
+	// the settings for this GPU again, see AutoTuner.h
+	TunedSettings candidate;
+	bool hasCandidate = AutoTuner::ParseCandidate(pCmdLine, &candidate);
+	bool retune = strstr(pCmdLine, "-autotune") != nullptr;
+
+	// "-stress 10000" draws the generated scene with 10000 objects,
+	// instead of the grid, so that benchmark.cmd can test both
+	uint32_t stressObjects = 0;
+	const char* stressArg = strstr(pCmdLine, "-stress");
+
+	if (stressArg != nullptr)
+		stressObjects = (uint32_t)atoi(stressArg + strlen("-stress"));
+
+	// "-contexts 4" makes four Demos, which draw at the same time, each
+	// on its own thread, like a server that draws many sessions. They
+	// share one instance, one device, the pipeline cache, and the
+	// allocator, so the second one does not pay for any of them again.
+	// Every Demo is made before any of them draws, see DeviceContext.h
+	uint32_t contextCount = 1;
+	const char* contextsArg = strstr(pCmdLine, "-contexts");
+
+	if (contextsArg != nullptr)
+		contextCount = (uint32_t)atoi(contextsArg + strlen("-contexts"));
+
+	if (contextCount == 0)
+		contextCount = 1;
+
+	// "-gpus" draws on every GPU of the computer at the same time, like
+	// a node of a render farm, and "-gpus 2" on two of them. Unlike a
+	// device group (see prepare_physical_device), the GPUs do not have
+	// to be linked, or of the same kind. Each GPU gets a device of its
+	// own, the instance is shared, and "-contexts N" makes N Demos on
+	// each GPU. This is only for headless mode, where every Demo has its
+	// own render thread, and nobody needs a window on each GPU
+	const char* gpusArg = headless ? strstr(pCmdLine, "-gpus") : nullptr;
+	uint32_t gpuLimit = 1;
+
+	if (gpusArg != nullptr)
+	{
+		gpuLimit = (uint32_t)atoi(gpusArg + strlen("-gpus"));
+
+		// "-gpus" by itself uses all of them
+		if (gpuLimit == 0)
+			gpuLimit = UINT32_MAX;
+	}
+
+	InstanceContext sharedInstance;
+
+	// makes the Demos of one device, which are in the same order in
+	// renderContexts as their devices are in deviceContexts
+	auto makeRenderContexts = [&](DeviceContext* deviceContext)
+	{
+		for (uint32_t i = 0; i < contextCount; i++)
+		{
+			RenderContext* context = new RenderContext();
+			context->demo = new Demo(benchmarkFrames, presentMode, frameLag, layerFlags, targetFps, windowMode,
+				hasCandidate ? &candidate : nullptr, retune, stressObjects, deviceContext);
+			context->quitRender = false;
+			context->rawInput = nullptr;
+			renderContexts.push_back(context);
+
+			if (context->demo->window != NULL)
+				SetWindowLongPtr(context->demo->window, GWLP_USERDATA, (LONG_PTR)context);
+		}
+	};
+
+	// The first device is on the best GPU (or on VKCUBE_GPU),
+	// and it makes the instance that the other GPUs are found with
+	deviceContexts.push_back(new DeviceContext(&sharedInstance, contextCount > 1));
+	makeRenderContexts(deviceContexts[0]);
+
+	if (gpuLimit > 1)
+	{
+		uint32_t gpuCount = 0;
+		vkEnumeratePhysicalDevices(sharedInstance.instance, &gpuCount, NULL);
+
+		std::vector<VkPhysicalDevice> gpus(gpuCount);
+
+		if (gpuCount > 0)
+			vkEnumeratePhysicalDevices(sharedInstance.instance, &gpuCount, gpus.data());
+
+		// every other GPU that can draw, in the order of the list
+		for (uint32_t i = 0; i < gpuCount && deviceContexts.size() < gpuLimit; i++)
+		{
+			if (gpus[i] == deviceContexts[0]->gpu || Demo::score_physical_device(gpus[i], false) == 0)
+				continue;
+
+			DeviceContext* deviceContext = new DeviceContext(&sharedInstance, contextCount > 1, i);
+			deviceContexts.push_back(deviceContext);
+			makeRenderContexts(deviceContext);
+		}
+
+		printf("Drawing on %d GPUs, with %d contexts on each\n", (uint32_t)deviceContexts.size(), contextCount);
+	}
+
+	RenderContext* mainContext = renderContexts[0];
+
+	// "-microbench" measures the uploads, the allocations, and
+	// the creation of objects, one at a time, and then quits
+	if (strstr(pCmdLine, "-microbench") != nullptr)
+	{
+		mainContext->demo->run_microbenchmarks();
+		DeleteRenderContexts();
+		return 0;
+	}
+
+	// "-prewarm" makes every pipeline that the options can pick,
+	// and saves them in the pipeline cache, as a step of the install,
+	// so the first run with any options compiles nothing
+	if (strstr(pCmdLine, "-prewarm") != nullptr)
+	{
+		mainContext->demo->prewarm_pipeline_cache();
+		DeleteRenderContexts();
+		return 0;
+	}
+
+	// Without a window, there are no messages to wait for, and
+	// no input, so this thread draws the frames of the first
+	// context itself, and every other one gets a thread
+	if (headless)
+	{
+		SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
+
+		for (size_t i = 1; i < renderContexts.size(); i++)
+			renderContexts[i]->renderThread = std::thread(RenderLoop, renderContexts[i]);
+
+		RenderLoop(mainContext);
+
+		for (size_t i = 1; i < renderContexts.size(); i++)
+			renderContexts[i]->renderThread.join();
+
+		SetConsoleCtrlHandler(ConsoleCtrlHandler, FALSE);
+
+		return DeleteRenderContexts() ? 1 : 0;
+	}
+
+	// the input goes to the window that this thread made
+	mainContext->rawInput = new RawInput(&mainContext->windowEvents);
+
+	if (!mainContext->rawInput->Register(mainContext->demo->window))
+		printf("Raw Input could not be registered, the keys come from WM_KEYDOWN\n");
+
+	// Each demo draws on its own thread, so a lot of window
+	// messages at once can not slow down the drawing, and waiting
+	// for the GPU can not make the window stop responding
+	for (size_t i = 0; i < renderContexts.size(); i++)
+		renderContexts[i]->renderThread = std::thread(RenderLoop, renderContexts[i]);
 
 	// The main loop of our program.
-	// This will repeat infinitely until we tell it to stop
+	// This will repeat infinitely until we tell it to stop.
+	// This thread only handles the window's messages, so it
+	// sleeps in GetMessage until the window sends one
 	while (true)
 	{
 		// MSG is a message that the Window sends to us,
@@ -90,34 +676,45 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine,
 		// of the window been it?"
 		MSG msg = {};
 
-		// This function gets a message from the window
-		PeekMessage(&msg, NULL, 0, 0, PM_REMOVE);
-
+		// This function waits for a message from the window.
 		// if the windoww sent us a message that the
 		// X button in the corner of the window has been hit,
-		// or if someone hit the Escape key in the window,
-		// (which is determined in Wnd_Proc), then "break" 
-		// the loop. "break" quites the loop
-		if (msg.message == WM_QUIT || keys[VK_ESCAPE]) break;
-
-		// We are done with the message from this frame,
-		// so now dispatch the message, and allow Win32 to 
-		// look for a new message in the next frame
+		// then GetMessage returns 0 (or -1 if something went wrong),
+		// and we "break" the loop. "break" quites the loop
+		if (GetMessage(&msg, NULL, 0, 0) <= 0) break;
+
+		// give the message to WndProc
 		DispatchMessage(&msg);
 
-		// This is the demo's main update function,
-		// It will update everything related to the demo.
-		// Go to Demo.cpp and look for Demo::run() to learn
-		// about how this works
-		demo->run();
+		// if someone hit the Escape key in the window,
+		// (which is determined in Wnd_Proc), then quit
+		if (keys[VK_ESCAPE]) break;
 	}
 
+	// stop the render threads, each one finishes the
+	// frame that it is drawing, and then it returns.
+	// If it is sleeping because the window is minimized,
+	// Wake makes it stop sleeping
+	for (size_t i = 0; i < renderContexts.size(); i++)
+	{
+		renderContexts[i]->quitRender = true;
+		renderContexts[i]->windowEvents.Wake();
+	}
+
+	for (size_t i = 0; i < renderContexts.size(); i++)
+		renderContexts[i]->renderThread.join();
+
 	// After the loop is finished, it is time to quit the demo.
 	// This will call demo's deconstructor, and delete everything
 	// that we created in the demo. If we do not delete demo, we 
 	// will have memory leaks. Go to Demo.cpp and look for
 	// Demo::~Demo() to learn about how this works
-	delete demo;
+	bool regressed = DeleteRenderContexts();
+
+	// a benchmark is run by a script, so nobody is there to press
+	// Spacebar, and the exit code tells the script if it got slower
+	if (benchmarkFrames > 0)
+		return regressed ? 1 : 0;
 
 	// This is just a helpful reminder that checks for bugs
 	// when it is time to release software, comment this out
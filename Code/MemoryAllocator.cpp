@@ -0,0 +1,940 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#include "MemoryAllocator.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <algorithm>
+
+// Every time we call vkAllocateMemory, the driver has to find
+// memory for us, which is slow, and there is a limit to how many
+// allocations we can have at the same time (maxMemoryAllocationCount),
+// which can be as low as 4096. If every buffer and every texture
+// had its own allocation, we would hit that limit very quickly
+// in a big scene.
+
+// Instead, this class allocates a few large "blocks" of memory,
+// and then gives out small pieces of those blocks to each
+// BufferCPU, BufferGPU, and TextureGPU. Each block keeps a list
+// of the ranges that nobody is using (a free list). When a piece
+// is freed, it goes back onto the list, and it is merged with
+// its neighbors so that the block does not turn into crumbs
+
+// The allocator also counts how much of each heap it uses. If the
+// process uses more than its budget, the driver moves some of its
+// memory to system RAM (paging), which makes the GPU very slow, so
+// near the budget the blocks get smaller, and the texture streamer
+// keeps fewer levels (see TextureStreamer::MakeRoom)
+
+MemoryAllocator::MemoryAllocator(VkDevice d, VkPhysicalDevice gpu)
+{
+	// save device, so that we can
+	// allocate and free memory with it
+	device = d;
+
+	// get the memory types and memory heaps of the GPU
+	vkGetPhysicalDeviceMemoryProperties(gpu, &memory_properties);
+
+	// We need three limits from the GPU.
+	// bufferImageGranularity is how far apart a buffer and an
+	// optimally-tiled image must be, if they share one block.
+	// maxMemoryAllocationCount is the number of vkAllocateMemory
+	// calls that can be active at the same time.
+	// nonCoherentAtomSize is the size that every flush of
+	// non-coherent memory must be rounded to
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(gpu, &props);
+	bufferImageGranularity = props.limits.bufferImageGranularity;
+	maxMemoryAllocationCount = props.limits.maxMemoryAllocationCount;
+	nonCoherentAtomSize = props.limits.nonCoherentAtomSize;
+
+	// until EnableBudget, the budget is a guess
+	this->gpu = gpu;
+	fpGetPhysicalDeviceMemoryProperties2KHR = NULL;
+
+	// until EnableDedicated, everything shares blocks
+	fpGetImageMemoryRequirements2KHR = NULL;
+	fpGetBufferMemoryRequirements2KHR = NULL;
+
+	defragMoves = 0;
+	defragBytes = 0;
+	eventCount = 0;
+
+	for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; i++)
+	{
+		heaps[i] = {};
+		blockBytesAtUpdate[i] = 0;
+		overBudget[i] = false;
+	}
+
+	UpdateBudget();
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	// By the time the allocator is deleted, every buffer
+	// and texture should have been deleted, but we free
+	// every block anyways, so that nothing leaks
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		if (blocks[i]->allocationCount > 0)
+			printf("MemoryAllocator: block %d still has %d allocations\n", (int)i, blocks[i]->allocationCount);
+
+		DestroyBlock(blocks[i]);
+	}
+
+	blocks.clear();
+}
+
+// This is a common helper function that is used in many Vulkan
+// tutorials. From one tutorial to the next, it does not require
+// a lot of changes
+
+// memory_properties is a structure of VkPhysicalDeviceMemoryProperties
+// which holds arrays of memory types (VkMemoryType), and arrays of memory heaps (VkMemoryHeaps)
+// memoryTypeIndex is an index identifying a memory type from the memoryTypes array
+
+// typeBits are gotten from memory requirements (you'll see that in the buffer classes)
+// requirements_mask tells us if the buffer is on CPU or GPU, and read/write access permissions
+
+bool MemoryAllocator::memory_type_from_properties(VkPhysicalDeviceMemoryProperties memory_properties, uint32_t requiredBits, VkFlags requirements_mask, uint32_t *typeIndex)
+{
+	// If students have trouble understanding this function,
+	// don't worry it will never need to be changed
+
+	// Loop through all memory types that are available to us
+	// Search memtypes to find first index of the memoryType array
+	// that has the properties that we need
+
+	// There are usually around 11 types of memory
+	// Here is a list of them
+	// https://www.khronos.org/registry/vulkan/specs/1.1-extensions/man/html/VkMemoryPropertyFlagBits.html
+	// Notice a pattern? The list of types look like this:
+	// 0001 = 1
+	// 0010 = 2
+	// 0100 = 4
+	// 1000 = 8
+	// etc
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+	{
+		// Check if this type is needed from VkMemoryRequirements
+		// this checks if the last bit in the byte is 1
+		if ((requiredBits & 1) == 1)
+		{
+			// If we need this type of daa
+			// check to see if this memoryType supports the required
+			// mask (device, local, coherent, etc)
+			if ((memory_properties.memoryTypes[i].propertyFlags & requirements_mask) == requirements_mask)
+			{
+				// if it does, then record this data
+				*typeIndex = i;
+
+				// we found it, so return true
+				return true;
+			}
+		}
+
+		// this shifts all bits to the right,
+		// notice the pattern of FlagBits
+		requiredBits >>= 1;
+	}
+
+	// No memory types matched, return failure
+	// There is no index in the memoryType array
+	// that supports the memory that we want to allocate
+	return false;
+}
+
+MemoryBlock* MemoryAllocator::CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize minSize, bool linear, VkImage dedicatedImage, VkBuffer dedicatedBuffer)
+{
+	// If we already have as many allocations as the driver allows,
+	// then we cannot make another block
+	if (blocks.size() >= maxMemoryAllocationCount)
+		return nullptr;
+
+	// Host-visible memory is usually a lot smaller than
+	// VRAM, so we give it smaller blocks
+	VkMemoryPropertyFlags flags = memory_properties.memoryTypes[memoryTypeIndex].propertyFlags;
+	VkDeviceSize blockSize = (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? MEMORY_BLOCK_SIZE_DEVICE : MEMORY_BLOCK_SIZE_HOST;
+
+	// if one resource is bigger than a block,
+	// then it gets a block that fits it perfectly
+	if (minSize > blockSize)
+		blockSize = minSize;
+
+	// Lazily allocated memory is only for transient attachments
+	// (like the depth buffer), which are rebuilt with the swapchain.
+	// Each one gets a block that fits it exactly, rather than
+	// a big block that other attachments would never share
+	if (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+		blockSize = minSize;
+
+	// a dedicated block is exactly the size of its resource
+	bool dedicated = (dedicatedImage != VK_NULL_HANDLE || dedicatedBuffer != VK_NULL_HANDLE);
+
+	if (dedicated)
+		blockSize = minSize;
+
+	// Never ask for more than 1/8 of the heap at a time,
+	// unless the resource itself needs that much
+	uint32_t heap = memory_properties.memoryTypes[memoryTypeIndex].heapIndex;
+	VkDeviceSize heapSize = memory_properties.memoryHeaps[heap].size;
+	if (blockSize > heapSize / 8 && minSize <= heapSize / 8)
+		blockSize = heapSize / 8;
+
+	// Close to the budget, a big block would mostly be empty space
+	// that pushes us over it, so we only ask for what is needed
+	MemoryHeapStats stats = GetHeapStats(heap);
+	VkDeviceSize limit = stats.budget / 100 * MEMORY_BUDGET_PERCENT;
+
+	if (stats.usage + blockSize > limit)
+		blockSize = minSize;
+
+	// The resource still gets its memory, (the depth buffer can not be
+	// skipped), but the driver might start paging, so we say it once
+	if (stats.usage + blockSize > stats.budget && !overBudget[heap])
+	{
+		printf("MemoryAllocator: heap %u is over its budget of %llu MB\n",
+			heap, (unsigned long long)(stats.budget >> 20));
+		overBudget[heap] = true;
+	}
+
+	VkMemoryAllocateInfo memAllocInfo = {};
+	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memAllocInfo.allocationSize = blockSize;
+	memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	// This tells the driver which resource the memory is for, so it
+	// can put it where that resource is the fastest (for example, with
+	// compression for a render target), only one of them is set
+	VkMemoryDedicatedAllocateInfoKHR dedicatedInfo = {};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+	dedicatedInfo.image = dedicatedImage;
+	dedicatedInfo.buffer = dedicatedBuffer;
+
+	if (dedicated)
+		memAllocInfo.pNext = &dedicatedInfo;
+
+	// the time includes the second try, if there is one
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	VkDeviceMemory memory;
+	VkResult err = vkAllocateMemory(device, &memAllocInfo, HostAllocator::callbacks, &memory);
+
+	// If the big block did not fit, try one more time,
+	// with only the amount of memory that we actually need
+	if (err != VK_SUCCESS && blockSize > minSize)
+	{
+		blockSize = minSize;
+		memAllocInfo.allocationSize = blockSize;
+		err = vkAllocateMemory(device, &memAllocInfo, HostAllocator::callbacks, &memory);
+	}
+
+	if (err != VK_SUCCESS)
+		return nullptr;
+
+	// The whole block starts out as one big free range
+	MemoryBlock* block = new MemoryBlock();
+	block->memory = memory;
+	block->size = blockSize;
+	block->memoryTypeIndex = memoryTypeIndex;
+	block->linear = linear;
+	block->dedicated = dedicated;
+	block->mapCount = 0;
+	block->mapped = nullptr;
+	block->allocationCount = 0;
+
+	MemoryRange everything = { 0, blockSize };
+	block->freeList.push_back(everything);
+
+	heaps[heap].blockBytes += blockSize;
+
+	AddEvent(start, block, true);
+
+	blocks.push_back(block);
+	return block;
+}
+
+void MemoryAllocator::DestroyBlock(MemoryBlock* block)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (block->mapCount > 0)
+		vkUnmapMemory(device, block->memory);
+
+	vkFreeMemory(device, block->memory, HostAllocator::callbacks);
+
+	AddEvent(start, block, false);
+
+	heaps[memory_properties.memoryTypes[block->memoryTypeIndex].heapIndex].blockBytes -= block->size;
+	delete block;
+}
+
+void MemoryAllocator::AddEvent(std::chrono::steady_clock::time_point start, const MemoryBlock* block, bool allocated)
+{
+	// written over the oldest event, like the frames of the CpuProfiler
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	MemoryEvent& event = events[eventCount % MEMORY_EVENT_HISTORY];
+	event.time = now;
+	event.ms = std::chrono::duration<double, std::milli>(now - start).count();
+	event.size = block->size;
+	event.memoryTypeIndex = block->memoryTypeIndex;
+	event.allocated = allocated;
+	event.dedicated = block->dedicated;
+	eventCount++;
+}
+
+uint32_t MemoryAllocator::GetEventCount()
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	return (eventCount < MEMORY_EVENT_HISTORY) ? (uint32_t)eventCount : MEMORY_EVENT_HISTORY;
+}
+
+MemoryEvent MemoryAllocator::GetEvent(uint32_t index)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	uint64_t first = eventCount - GetEventCount();
+	return events[(first + index) % MEMORY_EVENT_HISTORY];
+}
+
+bool MemoryAllocator::AllocateFromBlock(MemoryBlock* block, VkMemoryRequirements reqs, MemoryAllocation* alloc)
+{
+	// Look through every free range in the block, and find
+	// the range that leaves the least amount of space behind
+	// after we fit our resource inside of it (best-fit).
+	// This keeps large free ranges available for large resources
+	size_t best = SIZE_MAX;
+	VkDeviceSize bestOffset = 0;
+	VkDeviceSize bestWaste = ~(VkDeviceSize)0;
+	VkDeviceSize bestPadding = ~(VkDeviceSize)0;
+
+	for (size_t i = 0; i < block->freeList.size(); i++)
+	{
+		MemoryRange range = block->freeList[i];
+
+		// every resource needs to start at an offset that
+		// is a multiple of its alignment (always a power of two)
+		VkDeviceSize aligned = (range.offset + reqs.alignment - 1) & ~(reqs.alignment - 1);
+
+		if (aligned + reqs.size > range.offset + range.size)
+			continue;
+
+		// The waste is the padding in front of the aligned offset,
+		// plus what is left after the end of the resource. Both
+		// become small free ranges. If two ranges waste the same,
+		// the one with less padding is better, because it is cut
+		// into fewer pieces, and keeps its leftover in one range
+		VkDeviceSize padding = aligned - range.offset;
+		VkDeviceSize leftover = (range.offset + range.size) - (aligned + reqs.size);
+		VkDeviceSize waste = padding + leftover;
+
+		if (waste < bestWaste || (waste == bestWaste && padding < bestPadding))
+		{
+			best = i;
+			bestOffset = aligned;
+			bestWaste = waste;
+			bestPadding = padding;
+		}
+	}
+
+	// nothing in this block was big enough
+	if (best == SIZE_MAX)
+		return false;
+
+	// Cut the free range into pieces: the padding before our
+	// aligned offset (if any), our resource, and whatever is
+	// left after our resource (if any)
+	MemoryRange range = block->freeList[best];
+	block->freeList.erase(block->freeList.begin() + best);
+
+	VkDeviceSize end = bestOffset + reqs.size;
+	VkDeviceSize rangeEnd = range.offset + range.size;
+
+	if (rangeEnd > end)
+	{
+		MemoryRange after = { end, rangeEnd - end };
+		block->freeList.insert(block->freeList.begin() + best, after);
+	}
+
+	if (bestOffset > range.offset)
+	{
+		MemoryRange before = { range.offset, bestOffset - range.offset };
+		block->freeList.insert(block->freeList.begin() + best, before);
+	}
+
+	alloc->memory = block->memory;
+	alloc->offset = bestOffset;
+	alloc->size = reqs.size;
+	alloc->memoryTypeIndex = block->memoryTypeIndex;
+	alloc->block = block;
+
+	block->allocationCount++;
+	heaps[memory_properties.memoryTypes[block->memoryTypeIndex].heapIndex].usedBytes += reqs.size;
+	return true;
+}
+
+bool MemoryAllocator::Allocate(VkMemoryRequirements reqs, VkMemoryPropertyFlags flags, bool linear, MemoryAllocation* alloc)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	// find the memory type that the resource can live in,
+	// the same way that every wrapper class used to do it
+	uint32_t memoryTypeIndex;
+	if (!memory_type_from_properties(memory_properties, reqs.memoryTypeBits, flags, &memoryTypeIndex))
+		return false;
+
+	// If buffers and optimal images could end up next to each
+	// other closer than bufferImageGranularity, they would alias
+	// each other on some GPUs. The easiest solution is to never
+	// put them in the same block. If the granularity is 1, then
+	// it doesn't matter, and everything can share blocks
+	bool blockLinear = (bufferImageGranularity > 1) ? linear : true;
+
+	// try every block that already exists
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		if (blocks[i]->memoryTypeIndex != memoryTypeIndex || blocks[i]->linear != blockLinear || blocks[i]->dedicated)
+			continue;
+
+		if (AllocateFromBlock(blocks[i], reqs, alloc))
+			return true;
+	}
+
+	// none of the blocks had room, so make a new one.
+	// Alignment padding can take up to (alignment - 1) bytes
+	MemoryBlock* block = CreateBlock(memoryTypeIndex, reqs.size + reqs.alignment, blockLinear);
+
+	if (block == nullptr)
+		return false;
+
+	return AllocateFromBlock(block, reqs, alloc);
+}
+
+bool MemoryAllocator::AllocateDedicated(VkMemoryRequirements reqs, VkMemoryPropertyFlags flags, bool linear, VkImage image, VkBuffer buffer, MemoryAllocation* alloc)
+{
+	uint32_t memoryTypeIndex;
+	if (!memory_type_from_properties(memory_properties, reqs.memoryTypeBits, flags, &memoryTypeIndex))
+		return false;
+
+	// the resource starts at offset 0, so there is no padding
+	MemoryBlock* block = CreateBlock(memoryTypeIndex, reqs.size, linear, image, buffer);
+
+	if (block == nullptr)
+		return false;
+
+	return AllocateFromBlock(block, reqs, alloc);
+}
+
+bool MemoryAllocator::AllocateImage(VkImage image, VkMemoryRequirements reqs, VkMemoryPropertyFlags flags, bool linear, MemoryAllocation* alloc)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	// Drivers usually want big render targets (like the depth buffer)
+	// to have their own memory, and some images need it. The
+	// driver tells us with VkMemoryDedicatedRequirements
+	if (fpGetImageMemoryRequirements2KHR != NULL)
+	{
+		VkMemoryDedicatedRequirementsKHR dedicatedReqs = {};
+		dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR;
+
+		VkMemoryRequirements2KHR reqs2 = {};
+		reqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR;
+		reqs2.pNext = &dedicatedReqs;
+
+		VkImageMemoryRequirementsInfo2KHR info = {};
+		info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR;
+		info.image = image;
+		fpGetImageMemoryRequirements2KHR(device, &info, &reqs2);
+
+		// If a dedicated block does not fit, a piece of a shared
+		// block might, unless the driver requires a dedicated one
+		if (dedicatedReqs.prefersDedicatedAllocation || dedicatedReqs.requiresDedicatedAllocation)
+		{
+			if (AllocateDedicated(reqs, flags, linear, image, VK_NULL_HANDLE, alloc))
+				return true;
+
+			if (dedicatedReqs.requiresDedicatedAllocation)
+				return false;
+		}
+	}
+
+	return Allocate(reqs, flags, linear, alloc);
+}
+
+bool MemoryAllocator::AllocateBuffer(VkBuffer buffer, VkMemoryRequirements reqs, VkMemoryPropertyFlags flags, MemoryAllocation* alloc)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	// the same as AllocateImage, buffers are always linear
+	if (fpGetBufferMemoryRequirements2KHR != NULL)
+	{
+		VkMemoryDedicatedRequirementsKHR dedicatedReqs = {};
+		dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR;
+
+		VkMemoryRequirements2KHR reqs2 = {};
+		reqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR;
+		reqs2.pNext = &dedicatedReqs;
+
+		VkBufferMemoryRequirementsInfo2KHR info = {};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2_KHR;
+		info.buffer = buffer;
+		fpGetBufferMemoryRequirements2KHR(device, &info, &reqs2);
+
+		if (dedicatedReqs.prefersDedicatedAllocation || dedicatedReqs.requiresDedicatedAllocation)
+		{
+			if (AllocateDedicated(reqs, flags, true, VK_NULL_HANDLE, buffer, alloc))
+				return true;
+
+			if (dedicatedReqs.requiresDedicatedAllocation)
+				return false;
+		}
+	}
+
+	return Allocate(reqs, flags, true, alloc);
+}
+
+void MemoryAllocator::EnableDedicated(PFN_vkGetImageMemoryRequirements2KHR fpImage, PFN_vkGetBufferMemoryRequirements2KHR fpBuffer)
+{
+	fpGetImageMemoryRequirements2KHR = fpImage;
+	fpGetBufferMemoryRequirements2KHR = fpBuffer;
+}
+
+void MemoryAllocator::Free(MemoryAllocation* alloc)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	MemoryBlock* block = alloc->block;
+
+	if (block == nullptr)
+		return;
+
+	// find where this range belongs in the sorted free list
+	size_t i = 0;
+	while (i < block->freeList.size() && block->freeList[i].offset < alloc->offset)
+		i++;
+
+	MemoryRange range = { alloc->offset, alloc->size };
+	block->freeList.insert(block->freeList.begin() + i, range);
+
+	// merge with the range after us, if they touch
+	if (i + 1 < block->freeList.size() &&
+		block->freeList[i].offset + block->freeList[i].size == block->freeList[i + 1].offset)
+	{
+		block->freeList[i].size += block->freeList[i + 1].size;
+		block->freeList.erase(block->freeList.begin() + i + 1);
+	}
+
+	// merge with the range before us, if they touch
+	if (i > 0 &&
+		block->freeList[i - 1].offset + block->freeList[i - 1].size == block->freeList[i].offset)
+	{
+		block->freeList[i - 1].size += block->freeList[i].size;
+		block->freeList.erase(block->freeList.begin() + i);
+	}
+
+	block->allocationCount--;
+	heaps[memory_properties.memoryTypes[block->memoryTypeIndex].heapIndex].usedBytes -= alloc->size;
+	alloc->block = nullptr;
+
+	// A dedicated block can never be used by anything else,
+	// so it goes back to the driver as soon as it is empty
+	if (block->dedicated)
+	{
+		for (size_t k = 0; k < blocks.size(); k++)
+		{
+			if (blocks[k] == block)
+			{
+				blocks.erase(blocks.begin() + k);
+				break;
+			}
+		}
+
+		DestroyBlock(block);
+		return;
+	}
+
+	// If the block is now completely empty, give it back to the
+	// driver, but only if there is another empty block of the
+	// same kind. Keeping one around means that something like
+	// the depth buffer can be deleted and rebuilt during a resize
+	// without calling vkAllocateMemory again
+	if (block->allocationCount == 0)
+	{
+		for (size_t j = 0; j < blocks.size(); j++)
+		{
+			MemoryBlock* other = blocks[j];
+
+			if (other != block &&
+				!other->dedicated &&
+				other->allocationCount == 0 &&
+				other->memoryTypeIndex == block->memoryTypeIndex &&
+				other->linear == block->linear)
+			{
+				for (size_t k = 0; k < blocks.size(); k++)
+				{
+					if (blocks[k] == block)
+					{
+						blocks.erase(blocks.begin() + k);
+						break;
+					}
+				}
+
+				DestroyBlock(block);
+				break;
+			}
+		}
+	}
+}
+
+void* MemoryAllocator::Map(MemoryAllocation* alloc)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	MemoryBlock* block = alloc->block;
+
+	// A VkDeviceMemory can only be mapped once at a time,
+	// but many resources share one block now. So, we map
+	// the whole block the first time that anyone asks,
+	// and we count how many people are using the mapping
+	if (block->mapCount == 0)
+		vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, (void**)&block->mapped);
+
+	block->mapCount++;
+
+	// give back the pointer to where this
+	// resource lives inside the mapped block
+	return block->mapped + alloc->offset;
+}
+
+void MemoryAllocator::Unmap(MemoryAllocation* alloc)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	MemoryBlock* block = alloc->block;
+
+	// only unmap when the last person is done with it
+	block->mapCount--;
+
+	if (block->mapCount == 0)
+	{
+		vkUnmapMemory(device, block->memory);
+		block->mapped = nullptr;
+	}
+}
+
+bool MemoryAllocator::IsCoherent(MemoryAllocation* alloc)
+{
+	VkMemoryPropertyFlags flags = memory_properties.memoryTypes[alloc->memoryTypeIndex].propertyFlags;
+	return (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+VkMappedMemoryRange MemoryAllocator::GetMappedRange(MemoryAllocation* alloc, VkDeviceSize offset, VkDeviceSize size)
+{
+	MemoryBlock* block = alloc->block;
+
+	// The range is relative to the start of the block, and it
+	// has to start and end on a multiple of nonCoherentAtomSize
+	// (unless it ends at the end of the block). The bytes around
+	// it belong to our neighbors, which is fine, flushing or
+	// invalidating more than we need never hurts them, because
+	// the CPU and the GPU never share bytes at the same time
+	VkDeviceSize start = alloc->offset + offset;
+	VkDeviceSize end = start + size;
+
+	start = start - (start % nonCoherentAtomSize);
+	end = ((end + nonCoherentAtomSize - 1) / nonCoherentAtomSize) * nonCoherentAtomSize;
+
+	if (end > block->size)
+		end = block->size;
+
+	VkMappedMemoryRange range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = block->memory;
+	range.offset = start;
+	range.size = end - start;
+
+	return range;
+}
+
+void MemoryAllocator::Flush(MemoryAllocation* alloc, VkDeviceSize offset, VkDeviceSize size)
+{
+	// HOST_COHERENT memory is seen by the GPU as soon as we
+	// write it, so there is nothing to flush
+	if (IsCoherent(alloc))
+		return;
+
+	// Non-coherent memory (which is usually HOST_CACHED) has
+	// to be flushed before the GPU can see what we wrote,
+	// because our writes might still be in the CPU's caches
+	VkMappedMemoryRange range = GetMappedRange(alloc, offset, size);
+	DeviceTable::FlushMappedMemoryRanges(device, 1, &range);
+}
+
+void MemoryAllocator::Invalidate(MemoryAllocation* alloc, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (IsCoherent(alloc))
+		return;
+
+	// The CPU's caches might still have old bytes of
+	// this range, which the GPU wrote over since then
+	VkMappedMemoryRange range = GetMappedRange(alloc, offset, size);
+	DeviceTable::InvalidateMappedMemoryRanges(device, 1, &range);
+}
+
+VkPhysicalDeviceMemoryProperties MemoryAllocator::GetMemoryProperties()
+{
+	return memory_properties;
+}
+
+VkDeviceSize MemoryAllocator::GetHostVisibleDeviceLocalSize()
+{
+	VkMemoryPropertyFlags needed =
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+	{
+		if ((memory_properties.memoryTypes[i].propertyFlags & needed) == needed)
+			return memory_properties.memoryHeaps[memory_properties.memoryTypes[i].heapIndex].size;
+	}
+
+	return 0;
+}
+
+uint32_t MemoryAllocator::GetBlockCount()
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	return (uint32_t)blocks.size();
+}
+
+VkDeviceSize MemoryAllocator::GetFreeBytes(MemoryBlock* block)
+{
+	VkDeviceSize bytes = 0;
+
+	for (size_t i = 0; i < block->freeList.size(); i++)
+		bytes += block->freeList[i].size;
+
+	return bytes;
+}
+
+// When textures are streamed in and out for a long time, the blocks
+// end up with a few resources each, and a lot of holes between them.
+// Nothing can give those holes back to the driver, only an empty block
+// can be freed. So the defragmenter picks the emptiest block, and the
+// owners of its resources copy them into the holes of the other blocks
+// (see TextureGPU::Relocate). When the last one is gone, Free gives the
+// block back, and the memory that we use stays close to what we need
+MemoryBlock* MemoryAllocator::FindDefragBlock(VkMemoryPropertyFlags flags)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	MemoryBlock* best = nullptr;
+	VkDeviceSize bestUsed = 0;
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		MemoryBlock* block = blocks[i];
+
+		// a dedicated block has nothing to give back
+		if (block->dedicated || block->allocationCount == 0)
+			continue;
+
+		if ((memory_properties.memoryTypes[block->memoryTypeIndex].propertyFlags & flags) != flags)
+			continue;
+
+		VkDeviceSize used = block->size - GetFreeBytes(block);
+
+		if (used * 100 >= block->size * MEMORY_DEFRAG_PERCENT)
+			continue;
+
+		// Everything in it has to fit into the other blocks of its kind,
+		// the holes might be too small for some of the resources, then
+		// those stay where they are
+		VkDeviceSize room = 0;
+
+		for (size_t j = 0; j < blocks.size(); j++)
+		{
+			MemoryBlock* other = blocks[j];
+
+			if (other != block && !other->dedicated &&
+				other->memoryTypeIndex == block->memoryTypeIndex && other->linear == block->linear)
+				room += GetFreeBytes(other);
+		}
+
+		if (room < used)
+			continue;
+
+		// the block with the smallest part in use
+		if (best == nullptr || used * best->size < bestUsed * block->size)
+		{
+			best = block;
+			bestUsed = used;
+		}
+	}
+
+	return best;
+}
+
+bool MemoryAllocator::AllocateElsewhere(VkMemoryRequirements reqs, MemoryBlock* avoid, MemoryAllocation* alloc)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	if ((reqs.memoryTypeBits & (1 << avoid->memoryTypeIndex)) == 0)
+		return false;
+
+	// the blocks of the same kind, the fullest first
+	std::vector<MemoryBlock*> candidates;
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		MemoryBlock* block = blocks[i];
+
+		if (block != avoid && !block->dedicated &&
+			block->memoryTypeIndex == avoid->memoryTypeIndex && block->linear == avoid->linear)
+			candidates.push_back(block);
+	}
+
+	std::sort(candidates.begin(), candidates.end(),
+		[this](MemoryBlock* a, MemoryBlock* b) { return GetFreeBytes(a) < GetFreeBytes(b); });
+
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		if (AllocateFromBlock(candidates[i], reqs, alloc))
+		{
+			defragMoves++;
+			defragBytes += alloc->size;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void MemoryAllocator::EnableBudget(PFN_vkGetPhysicalDeviceMemoryProperties2KHR fp)
+{
+	fpGetPhysicalDeviceMemoryProperties2KHR = fp;
+	UpdateBudget();
+}
+
+void MemoryAllocator::UpdateBudget()
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	// The budget changes when other programs use the GPU, so it
+	// is asked for again every MEMORY_BUDGET_UPDATE_FRAMES frames
+	if (fpGetPhysicalDeviceMemoryProperties2KHR != NULL)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+		budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2KHR props = {};
+		props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+		props.pNext = &budget;
+		fpGetPhysicalDeviceMemoryProperties2KHR(gpu, &props);
+
+		for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+		{
+			heaps[i].usage = budget.heapUsage[i];
+			heaps[i].budget = budget.heapBudget[i];
+			blockBytesAtUpdate[i] = heaps[i].blockBytes;
+		}
+
+		return;
+	}
+
+	// This is the same guess that most allocators make, other
+	// programs and the driver itself need some of the heap too
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+	{
+		heaps[i].usage = heaps[i].blockBytes;
+		heaps[i].budget = memory_properties.memoryHeaps[i].size / 10 * 8;
+		blockBytesAtUpdate[i] = heaps[i].blockBytes;
+	}
+}
+
+MemoryHeapStats MemoryAllocator::GetHeapStats(uint32_t heap)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	MemoryHeapStats stats = heaps[heap];
+
+	// add the blocks that were made (or freed) since UpdateBudget
+	VkDeviceSize usage = stats.usage + stats.blockBytes;
+	stats.usage = (usage > blockBytesAtUpdate[heap]) ? usage - blockBytesAtUpdate[heap] : 0;
+
+	return stats;
+}
+
+VkDeviceSize MemoryAllocator::GetAvailable(VkMemoryPropertyFlags flags)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	uint32_t memoryTypeIndex;
+	if (!memory_type_from_properties(memory_properties, ~0u, flags, &memoryTypeIndex))
+		return 0;
+
+	uint32_t heap = memory_properties.memoryTypes[memoryTypeIndex].heapIndex;
+	MemoryHeapStats stats = GetHeapStats(heap);
+	VkDeviceSize limit = stats.budget / 100 * MEMORY_BUDGET_PERCENT;
+
+	// the free space in our blocks does not count against the budget
+	VkDeviceSize free = stats.blockBytes - stats.usedBytes;
+
+	if (stats.usage >= limit)
+		return free;
+
+	return limit - stats.usage + free;
+}
+
+void MemoryAllocator::PrintReport()
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+	{
+		MemoryHeapStats stats = GetHeapStats(i);
+		bool deviceLocal = (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+
+		printf("Memory heap %u (%s): %llu MB used in %llu MB of blocks, process usage %llu MB, budget %llu MB of %llu MB\n",
+			i,
+			deviceLocal ? "device" : "host",
+			(unsigned long long)(stats.usedBytes >> 20),
+			(unsigned long long)(stats.blockBytes >> 20),
+			(unsigned long long)(stats.usage >> 20),
+			(unsigned long long)(stats.budget >> 20),
+			(unsigned long long)(memory_properties.memoryHeaps[i].size >> 20));
+	}
+
+	uint32_t dedicated = 0;
+	for (size_t i = 0; i < blocks.size(); i++)
+		dedicated += blocks[i]->dedicated ? 1 : 0;
+
+	printf("Memory blocks: %u (%u dedicated)\n", GetBlockCount(), dedicated);
+
+	if (defragMoves > 0)
+		printf("Defragmentation: %u moves, %llu MB copied\n", defragMoves, (unsigned long long)(defragBytes >> 20));
+}
@@ -0,0 +1,250 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include <chrono>
+#include <mutex>
+
+// Every block that the allocator asks the driver for
+// will be at least this big. Anything that is larger than
+// a block gets a block of its own that is exactly its size
+#define MEMORY_BLOCK_SIZE_DEVICE (64 * 1024 * 1024)
+#define MEMORY_BLOCK_SIZE_HOST (16 * 1024 * 1024)
+
+// When a heap gets this close to its budget (out of 100),
+// new blocks are only as big as the resource that needs them,
+// and the texture streamer stops loading more levels
+#define MEMORY_BUDGET_PERCENT 90
+
+// how often (in frames) the demo asks the driver for the budget
+#define MEMORY_BUDGET_UPDATE_FRAMES 30
+
+// A block that is used less than this much (out of 100) is emptied
+// by the defragmenter, if what is in it fits into the other blocks
+#define MEMORY_DEFRAG_PERCENT 50
+
+// the most bytes that the defragmenter copies in one frame
+#define MEMORY_DEFRAG_BYTES_PER_FRAME (16 * 1024 * 1024)
+
+// how many blocks that were made or freed the
+// allocator remembers, older events are written over
+#define MEMORY_EVENT_HISTORY 64
+
+struct MemoryBlock;
+
+// One vkAllocateMemory or vkFreeMemory of a block, which
+// is slow enough to show up in the time of a frame
+struct MemoryEvent
+{
+	std::chrono::steady_clock::time_point time;
+	double ms;
+	VkDeviceSize size;
+	uint32_t memoryTypeIndex;
+	bool allocated;
+	bool dedicated;
+};
+
+// One piece of a MemoryBlock that was given
+// to a buffer or an image. The wrapper classes
+// keep one of these instead of a VkDeviceMemory
+struct MemoryAllocation
+{
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	uint32_t memoryTypeIndex;
+	MemoryBlock* block;
+};
+
+// a range of bytes inside a block that nobody is using
+struct MemoryRange
+{
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
+
+// how much memory of one heap is used, see GetHeapStats
+struct MemoryHeapStats
+{
+	// the bytes of the blocks that we allocated,
+	// and how many of those bytes resources are using
+	VkDeviceSize blockBytes;
+	VkDeviceSize usedBytes;
+
+	// With VK_EXT_memory_budget, the driver tells us how much of the
+	// heap our process uses (usage), and how much it can use before
+	// the driver starts moving memory to the system (budget).
+	// Without it, usage is our blocks, and budget is 80% of the heap
+	VkDeviceSize usage;
+	VkDeviceSize budget;
+};
+
+// One real vkAllocateMemory allocation, which
+// gets cut into smaller pieces for many resources
+struct MemoryBlock
+{
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint32_t memoryTypeIndex;
+
+	// true if this block holds buffers and linear images,
+	// false if it holds optimally-tiled images
+	bool linear;
+
+	// true if this block belongs to one image or buffer,
+	// nothing else is placed in it, see AllocateImage
+	bool dedicated;
+
+	// how many vkMapMemory calls are active
+	// on this block, and where it is mapped
+	uint32_t mapCount;
+	uint8_t* mapped;
+
+	// free ranges, sorted by offset
+	std::vector<MemoryRange> freeList;
+	uint32_t allocationCount;
+};
+
+// Any thread can use the allocator. Demos that share one device
+// (see DeviceContext.h) share its allocator too, and every one of
+// them allocates on its own threads. AllocateImage and AllocateBuffer
+// call Allocate with the lock held, so the lock is recursive
+class MemoryAllocator
+{
+private:
+	VkDevice device;
+	std::recursive_mutex lock;
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	VkDeviceSize bufferImageGranularity;
+	uint32_t maxMemoryAllocationCount;
+	VkDeviceSize nonCoherentAtomSize;
+
+	// all blocks of every memory type
+	std::vector<MemoryBlock*> blocks;
+
+	// The budget is from the last UpdateBudget. Blocks that were made
+	// or freed since then are not in the driver's usage yet, so the
+	// difference to blockBytesAtUpdate is added to it
+	VkPhysicalDevice gpu;
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR fpGetPhysicalDeviceMemoryProperties2KHR;
+	MemoryHeapStats heaps[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize blockBytesAtUpdate[VK_MAX_MEMORY_HEAPS];
+	bool overBudget[VK_MAX_MEMORY_HEAPS];
+
+	// VK_KHR_dedicated_allocation, see EnableDedicated
+	PFN_vkGetImageMemoryRequirements2KHR fpGetImageMemoryRequirements2KHR;
+	PFN_vkGetBufferMemoryRequirements2KHR fpGetBufferMemoryRequirements2KHR;
+
+	// a ring of the newest block events
+	MemoryEvent events[MEMORY_EVENT_HISTORY];
+	uint64_t eventCount;
+
+	void AddEvent(std::chrono::steady_clock::time_point start, const MemoryBlock* block, bool allocated);
+	MemoryBlock* CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize minSize, bool linear,
+		VkImage dedicatedImage = VK_NULL_HANDLE, VkBuffer dedicatedBuffer = VK_NULL_HANDLE);
+	bool AllocateDedicated(VkMemoryRequirements reqs, VkMemoryPropertyFlags flags, bool linear,
+		VkImage image, VkBuffer buffer, MemoryAllocation* alloc);
+	void DestroyBlock(MemoryBlock* block);
+	bool AllocateFromBlock(MemoryBlock* block, VkMemoryRequirements reqs, MemoryAllocation* alloc);
+	VkDeviceSize GetFreeBytes(MemoryBlock* block);
+	VkMappedMemoryRange GetMappedRange(MemoryAllocation* alloc, VkDeviceSize offset, VkDeviceSize size);
+
+public:
+	// how many resources the defragmenter moved, and their bytes
+	uint32_t defragMoves;
+	VkDeviceSize defragBytes;
+
+	MemoryAllocator(VkDevice d, VkPhysicalDevice gpu);
+	~MemoryAllocator();
+
+	static bool memory_type_from_properties(
+		VkPhysicalDeviceMemoryProperties memory_properties,
+		uint32_t typeBits,
+		VkFlags requirements_mask,
+		uint32_t *typeIndex);
+
+	bool Allocate(VkMemoryRequirements reqs, VkMemoryPropertyFlags flags, bool linear, MemoryAllocation* alloc);
+	void Free(MemoryAllocation* alloc);
+
+	// The same as Allocate, but if the driver prefers (or requires)
+	// that the image or buffer has a VkDeviceMemory of its own,
+	// then it gets a dedicated block, instead of a piece of one
+	bool AllocateImage(VkImage image, VkMemoryRequirements reqs, VkMemoryPropertyFlags flags, bool linear, MemoryAllocation* alloc);
+	bool AllocateBuffer(VkBuffer buffer, VkMemoryRequirements reqs, VkMemoryPropertyFlags flags, MemoryAllocation* alloc);
+
+	// Uses VK_KHR_dedicated_allocation, which
+	// needs VK_KHR_get_memory_requirements2
+	void EnableDedicated(PFN_vkGetImageMemoryRequirements2KHR fpImage, PFN_vkGetBufferMemoryRequirements2KHR fpBuffer);
+
+	void* Map(MemoryAllocation* alloc);
+	void Unmap(MemoryAllocation* alloc);
+	void Flush(MemoryAllocation* alloc, VkDeviceSize offset, VkDeviceSize size);
+
+	// the opposite of Flush, call it after the GPU wrote to
+	// the memory, and before the CPU reads what it wrote
+	void Invalidate(MemoryAllocation* alloc, VkDeviceSize offset, VkDeviceSize size);
+	bool IsCoherent(MemoryAllocation* alloc);
+
+	VkPhysicalDeviceMemoryProperties GetMemoryProperties();
+
+	// The size of the heap of memory that is DEVICE_LOCAL and
+	// HOST_VISIBLE at the same time, or 0 if the GPU has none. Without
+	// resizable BAR, it is a 256 MB window, with it, it is all of VRAM
+	VkDeviceSize GetHostVisibleDeviceLocalSize();
+	uint32_t GetBlockCount();
+
+	// Uses VK_EXT_memory_budget, which needs
+	// VK_KHR_get_physical_device_properties2
+	void EnableBudget(PFN_vkGetPhysicalDeviceMemoryProperties2KHR fp);
+
+	// asks the driver for the budget of every heap again
+	void UpdateBudget();
+
+	MemoryHeapStats GetHeapStats(uint32_t heap);
+
+	// How many bytes of memory with these flags can still be
+	// allocated before the heap reaches MEMORY_BUDGET_PERCENT of its
+	// budget, including the free space in the blocks that we have
+	VkDeviceSize GetAvailable(VkMemoryPropertyFlags flags);
+
+	// The block that the defragmenter should empty: the least used block
+	// with these flags, if what is in it fits into the free space of
+	// the other blocks of its kind. nullptr if no block is worth it
+	MemoryBlock* FindDefragBlock(VkMemoryPropertyFlags flags);
+
+	// Like Allocate, but never in avoid, and never in a new block, so
+	// that a resource in avoid can move somewhere else. The fullest
+	// blocks are tried first, so the holes in them are filled
+	bool AllocateElsewhere(VkMemoryRequirements reqs, MemoryBlock* avoid, MemoryAllocation* alloc);
+
+	// prints the stats of every heap to the console
+	void PrintReport();
+
+	// the newest block events, index 0 is the oldest, see SpikeDetector
+	uint32_t GetEventCount();
+	MemoryEvent GetEvent(uint32_t index);
+};
@@ -0,0 +1,197 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "MeshFile.h"
+#include <stdio.h>
+#include <string.h>
+
+// rounds an offset up to the next section boundary
+static uint64_t AlignSection(uint64_t offset)
+{
+	return (offset + MESH_SECTION_ALIGNMENT - 1) & ~(uint64_t)(MESH_SECTION_ALIGNMENT - 1);
+}
+
+MeshFile::MeshFile()
+{
+	vertexFormat = MESH_VERTEX_FLOAT;
+	vertexStride = 0;
+	vertexCount = 0;
+	indexCount = 0;
+	indexType = VK_INDEX_TYPE_UINT32;
+	lodCount = 0;
+	memset(lods, 0, sizeof(lods));
+	vertices = nullptr;
+	vertexSize = 0;
+	indices = nullptr;
+	indexSize = 0;
+	meshlets = nullptr;
+	meshletCount = 0;
+}
+
+bool MeshFile::Load(const char* path)
+{
+	if (!file.Open(path))
+		return false;
+
+	return Parse(file.GetData(), file.GetSize(), path);
+}
+
+void MeshFile::Close()
+{
+	file.Close();
+	vertices = nullptr;
+	vertexSize = 0;
+	indices = nullptr;
+	indexSize = 0;
+	meshlets = nullptr;
+	meshletCount = 0;
+}
+
+bool MeshFile::Parse(const char* data, size_t size, const char* name)
+{
+	MeshFileHeader header;
+
+	if (size < sizeof(header))
+	{
+		printf("%s is not a mesh file\n", name);
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(header));
+
+	if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION)
+	{
+		printf("%s is not a mesh file that we can load\n", name);
+		return false;
+	}
+
+	// make sure that every section is inside of the file, and that
+	// the sizes match the counts, so nothing can read past the end
+	uint32_t indexStride = (header.indexType == VK_INDEX_TYPE_UINT16) ? 2 : 4;
+
+	if (header.vertexOffset + header.vertexSize > (uint64_t)size ||
+		header.indexOffset + header.indexSize > (uint64_t)size ||
+		header.meshletOffset + header.meshletSize > (uint64_t)size ||
+		header.vertexSize != (uint64_t)header.vertexCount * header.vertexStride ||
+		header.indexSize != (uint64_t)header.indexCount * indexStride ||
+		header.meshletSize != (uint64_t)header.meshletCount * sizeof(Meshlet))
+	{
+		printf("%s has a section outside of the file\n", name);
+		return false;
+	}
+
+	// every LOD has to be inside of the index buffer
+	if (header.lodCount == 0 || header.lodCount > MESH_MAX_LODS)
+	{
+		printf("%s has %d levels of detail\n", name, header.lodCount);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header.lodCount; i++)
+	{
+		if ((uint64_t)header.lods[i].firstIndex + header.lods[i].indexCount > header.indexCount ||
+			(uint64_t)header.lods[i].firstMeshlet + header.lods[i].meshletCount > header.meshletCount)
+		{
+			printf("%s has a level of detail outside of the index buffer\n", name);
+			return false;
+		}
+	}
+
+	// and every meshlet has to be inside of the index buffer too
+	const Meshlet* fileMeshlets = (const Meshlet*)(data + header.meshletOffset);
+
+	for (uint32_t i = 0; i < header.meshletCount; i++)
+	{
+		if ((uint64_t)fileMeshlets[i].firstIndex + fileMeshlets[i].indexCount > header.indexCount)
+		{
+			printf("%s has a meshlet outside of the index buffer\n", name);
+			return false;
+		}
+	}
+
+	vertexFormat = (MeshVertexFormat)header.vertexFormat;
+	vertexStride = header.vertexStride;
+	vertexCount = header.vertexCount;
+	indexCount = header.indexCount;
+	indexType = (VkIndexType)header.indexType;
+	lodCount = header.lodCount;
+	memcpy(lods, header.lods, sizeof(lods));
+
+	vertices = data + header.vertexOffset;
+	vertexSize = (size_t)header.vertexSize;
+	indices = data + header.indexOffset;
+	indexSize = (size_t)header.indexSize;
+	meshlets = fileMeshlets;
+	meshletCount = header.meshletCount;
+
+	return true;
+}
+
+std::vector<char> MeshFile::Build(
+	MeshVertexFormat format,
+	uint32_t stride,
+	uint32_t vertexCount,
+	const void* vertexData,
+	uint32_t indexCount,
+	VkIndexType indexType,
+	const void* indexData,
+	uint32_t lodCount,
+	const MeshLod* lods,
+	uint32_t meshletCount,
+	const Meshlet* meshlets)
+{
+	uint32_t indexStride = (indexType == VK_INDEX_TYPE_UINT16) ? 2 : 4;
+
+	// The header is first, then the vertices, then the indices,
+	// then the meshlets, each one starting on a section boundary
+	MeshFileHeader header = {};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertexFormat = format;
+	header.vertexStride = stride;
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.indexType = indexType;
+	header.lodCount = lodCount;
+	header.meshletCount = meshletCount;
+	memcpy(header.lods, lods, lodCount * sizeof(MeshLod));
+	header.vertexOffset = AlignSection(sizeof(header));
+	header.vertexSize = (uint64_t)vertexCount * stride;
+	header.indexOffset = AlignSection(header.vertexOffset + header.vertexSize);
+	header.indexSize = (uint64_t)indexCount * indexStride;
+	header.meshletOffset = AlignSection(header.indexOffset + header.indexSize);
+	header.meshletSize = (uint64_t)meshletCount * sizeof(Meshlet);
+
+	// the padding between sections is filled with zeros
+	std::vector<char> bytes((size_t)(header.meshletOffset + header.meshletSize), 0);
+	memcpy(bytes.data(), &header, sizeof(header));
+	memcpy(bytes.data() + header.vertexOffset, vertexData, (size_t)header.vertexSize);
+	memcpy(bytes.data() + header.indexOffset, indexData, (size_t)header.indexSize);
+
+	if (meshletCount > 0)
+		memcpy(bytes.data() + header.meshletOffset, meshlets, (size_t)header.meshletSize);
+
+	return bytes;
+}
@@ -0,0 +1,174 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "Helper.h"
+
+// "VMSH" in the first four bytes of the file
+#define MESH_FILE_MAGIC 0x48534D56
+#define MESH_FILE_VERSION 3
+
+// the most levels of detail that one mesh can have
+#define MESH_MAX_LODS 4
+
+// the most vertices and triangles in one meshlet, which is what
+// mesh shaders are usually given, see MeshOptimizer::BuildMeshlets
+#define MESH_MESHLET_MAX_VERTICES 64
+#define MESH_MESHLET_MAX_TRIANGLES 124
+
+// every section of the file starts at a multiple
+// of this, so the mapped data is always aligned
+#define MESH_SECTION_ALIGNMENT 16
+
+// the layout of each vertex in the vertex section,
+// see VertexStructure and CompactVertexStructure in Demo.cpp
+enum MeshVertexFormat
+{
+	MESH_VERTEX_FLOAT = 0,
+	MESH_VERTEX_COMPACT = 1
+};
+
+// One level of detail: a range of the index buffer. LOD 0 has the
+// most triangles, and each LOD after it has fewer. The renderer uses
+// the first LOD that the object is at least minScreenHeight of
+// the screen for (1.0 is as tall as the screen), see select_lod
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float minScreenHeight;
+
+	// the meshlets that cover this range of indices
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	uint32_t padding[3];
+};
+
+// A small cluster of triangles that are next to each other, which is
+// a range of the index buffer. The sphere is around every vertex of
+// the cluster, and every triangle faces within the cone: the angle
+// between its normal and coneAxis is at most acos(sqrt(1 - coneCutoff^2)).
+// A cluster that is outside of the view, or that only has triangles
+// that face away from the camera, does not need to be drawn, see
+// IsMeshletVisible. A coneCutoff of 1 means that the triangles
+// face too many ways for the cone to cull anything
+struct Meshlet
+{
+	float center[3];
+	float radius;
+	float coneAxis[3];
+	float coneCutoff;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t padding[2];
+};
+
+// The file starts with this header. The vertices and indices
+// are stored exactly the way that the GPU reads them, so loading
+// a mesh is only mapping the file, and copying each section
+// into the staging ring, with nothing to convert
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexFormat;
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexType;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	uint32_t padding;
+
+	uint64_t vertexOffset;
+	uint64_t vertexSize;
+	uint64_t indexOffset;
+	uint64_t indexSize;
+	uint64_t meshletOffset;
+	uint64_t meshletSize;
+
+	// only the first lodCount are used
+	MeshLod lods[MESH_MAX_LODS];
+};
+
+class MeshFile
+{
+private:
+	// the file is mapped, not copied, so the
+	// staging ring copies straight from the file
+	MappedFile file;
+
+public:
+	MeshVertexFormat vertexFormat;
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	VkIndexType indexType;
+
+	// every LOD shares the same vertices,
+	// and has its own range of indices
+	uint32_t lodCount;
+	MeshLod lods[MESH_MAX_LODS];
+
+	// these point into the mapped file
+	// (or into the memory given to Parse)
+	const char* vertices;
+	size_t vertexSize;
+	const char* indices;
+	size_t indexSize;
+	const Meshlet* meshlets;
+	uint32_t meshletCount;
+
+	MeshFile();
+
+	// returns false if the file does not exist,
+	// or if it is not a mesh file that we can use
+	bool Load(const char* path);
+
+	// unmaps the file, the sections can not be used after this
+	void Close();
+
+	// reads a mesh that is already in memory, the
+	// memory has to exist as long as the MeshFile does
+	bool Parse(const char* data, size_t size, const char* name);
+
+	// makes the bytes of a mesh file, they can be
+	// saved with Helper::WriteFile, or given to Parse
+	static std::vector<char> Build(
+		MeshVertexFormat format,
+		uint32_t stride,
+		uint32_t vertexCount,
+		const void* vertexData,
+		uint32_t indexCount,
+		VkIndexType indexType,
+		const void* indexData,
+		uint32_t lodCount,
+		const MeshLod* lods,
+		uint32_t meshletCount,
+		const Meshlet* meshlets);
+};
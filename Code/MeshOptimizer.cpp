@@ -0,0 +1,530 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "MeshOptimizer.h"
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+
+// These constants come from Tom Forsyth's article, see
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRIANGLE_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+// How much we want to use a vertex next. Vertices that are in the
+// cache score higher, and vertices that only have a few triangles
+// left score higher, so they get finished and leave the cache
+static float VertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	// this vertex is not used by any triangles that are left
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+
+	if (cachePosition >= 0)
+	{
+		// The three vertices of the last triangle get a fixed score,
+		// so that we do not choose a triangle that uses them again
+		// (it would be drawn the same way either way)
+		if (cachePosition < 3)
+		{
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			float scaler = 1.0f / (MESH_OPTIMIZE_CACHE_SIZE - 3);
+			score = 1.0f - (cachePosition - 3) * scaler;
+			score = powf(score, CACHE_DECAY_POWER);
+		}
+	}
+
+	score += VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+
+	if (triangleCount == 0)
+		return;
+
+	// For each vertex, make a list of the triangles that use it.
+	// All the lists are in one array, and firstTriangle says
+	// where the list of each vertex starts
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		remaining[indices[i]]++;
+
+	std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+
+	std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+	std::vector<uint32_t> filled(vertexCount, 0);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			vertexTriangles[firstTriangle[v] + filled[v]++] = (uint32_t)t;
+		}
+	}
+
+	// the score of every vertex, and of every triangle
+	// (which is the sum of the scores of its vertices)
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScore[v] = VertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] =
+			vertexScore[indices[t * 3]] +
+			vertexScore[indices[t * 3 + 1]] +
+			vertexScore[indices[t * 3 + 2]];
+	}
+
+	// the new order of the triangles
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	// The simulated cache. There is room for three more vertices than
+	// the cache, because a new triangle pushes up to three vertices
+	// in before the oldest ones fall out
+	std::vector<uint32_t> cache;
+	cache.reserve(MESH_OPTIMIZE_CACHE_SIZE + 3);
+
+	// when nothing in the cache has triangles left, we look through
+	// the triangles in order, starting where we stopped last time
+	size_t scanStart = 0;
+	int64_t best = 0;
+	for (size_t t = 1; t < triangleCount; t++)
+		if (triangleScore[t] > triangleScore[best])
+			best = (int64_t)t;
+
+	while (best >= 0)
+	{
+		// draw the best triangle
+		emitted[best] = true;
+		uint32_t tri[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+
+		for (int k = 0; k < 3; k++)
+		{
+			output.push_back(tri[k]);
+			remaining[tri[k]]--;
+
+			// take the triangle out of the list of each of its vertices,
+			// so the score of a vertex only counts triangles that are left
+			uint32_t* list = &vertexTriangles[firstTriangle[tri[k]]];
+			uint32_t count = remaining[tri[k]] + 1;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				if (list[i] == (uint32_t)best)
+				{
+					list[i] = list[count - 1];
+					break;
+				}
+			}
+		}
+
+		// the vertices of this triangle move to the front of the cache
+		std::vector<uint32_t> newCache(tri, tri + 3);
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+				newCache.push_back(cache[i]);
+		}
+
+		// vertices that fell out of the cache lose their cache score
+		for (size_t i = MESH_OPTIMIZE_CACHE_SIZE; i < newCache.size(); i++)
+			vertexScore[newCache[i]] = VertexScore(-1, remaining[newCache[i]]);
+
+		if (newCache.size() > MESH_OPTIMIZE_CACHE_SIZE)
+			newCache.resize(MESH_OPTIMIZE_CACHE_SIZE);
+
+		cache.swap(newCache);
+
+		// Only the vertices in the cache changed their score (and the
+		// ones that just fell out, which are not interesting anymore).
+		// Update them, then update the triangles that use them, and
+		// the best of those triangles is the next one that we draw
+		for (size_t i = 0; i < cache.size(); i++)
+			vertexScore[cache[i]] = VertexScore((int)i, remaining[cache[i]]);
+
+		best = -1;
+		float bestScore = -1.0f;
+
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			uint32_t v = cache[i];
+			for (uint32_t j = 0; j < remaining[v]; j++)
+			{
+				uint32_t t = vertexTriangles[firstTriangle[v] + j];
+				float score =
+					vertexScore[indices[t * 3]] +
+					vertexScore[indices[t * 3 + 1]] +
+					vertexScore[indices[t * 3 + 2]];
+				triangleScore[t] = score;
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = (int64_t)t;
+				}
+			}
+		}
+
+		// nothing in the cache is connected to a triangle that is left,
+		// so start a new part of the mesh with the next triangle
+		if (best < 0)
+		{
+			while (scanStart < triangleCount && emitted[scanStart])
+				scanStart++;
+
+			if (scanStart < triangleCount)
+				best = (int64_t)scanStart;
+		}
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+// one group of triangles for OptimizeOverdraw
+struct OverdrawCluster
+{
+	size_t firstIndex;
+	size_t indexCount;
+	float sortKey;
+};
+
+void MeshOptimizer::OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride)
+{
+	size_t triangleCount = indexCount / 3;
+
+	if (triangleCount == 0)
+		return;
+
+	// get the position of a vertex
+	const char* base = (const char*)positions;
+	#define POSITION(v) ((const float*)(base + (size_t)(v) * positionStride))
+
+	// Cut the triangles into clusters. A new cluster starts every time
+	// that a triangle misses the cache with all three vertices, because
+	// that is where OptimizeVertexCache jumped to a new part of the mesh,
+	// so moving the clusters around does not hurt the vertex cache much
+	std::vector<OverdrawCluster> clusters;
+	std::vector<uint32_t> cache;
+
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			if (std::find(cache.begin(), cache.end(), v) == cache.end())
+			{
+				misses++;
+				cache.insert(cache.begin(), v);
+				if (cache.size() > MESH_CACHE_SIZE)
+					cache.pop_back();
+			}
+		}
+
+		if (t == 0 || misses == 3)
+		{
+			OverdrawCluster cluster = { t * 3, 0, 0.0f };
+			clusters.push_back(cluster);
+		}
+
+		clusters.back().indexCount += 3;
+	}
+
+	// the center of the whole mesh
+	float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		for (int k = 0; k < 3; k++)
+			meshCenter[k] += POSITION(indices[i])[k] / (float)indexCount;
+	}
+
+	// A cluster that points away from the center of the mesh is on the
+	// outside of the mesh, and it probably covers other clusters. The key
+	// is how much the cluster's average normal points away from the center
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+
+		for (size_t i = clusters[c].firstIndex; i < clusters[c].firstIndex + clusters[c].indexCount; i += 3)
+		{
+			const float* a = POSITION(indices[i]);
+			const float* b = POSITION(indices[i + 1]);
+			const float* d = POSITION(indices[i + 2]);
+
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+
+			// the cross product is as long as twice the area, so
+			// big triangles count more than small ones
+			normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+			normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+			normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+
+			for (int k = 0; k < 3; k++)
+				center[k] += (a[k] + b[k] + d[k]) / (float)clusters[c].indexCount;
+		}
+
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length > 0.0f)
+		{
+			for (int k = 0; k < 3; k++)
+				normal[k] /= length;
+		}
+
+		clusters[c].sortKey =
+			(center[0] - meshCenter[0]) * normal[0] +
+			(center[1] - meshCenter[1]) * normal[1] +
+			(center[2] - meshCenter[2]) * normal[2];
+	}
+
+	#undef POSITION
+
+	// outside clusters first, stable so that equal
+	// clusters keep the order of the vertex cache pass
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const OverdrawCluster& a, const OverdrawCluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indexCount);
+
+	for (size_t c = 0; c < clusters.size(); c++)
+		output.insert(output.end(), indices + clusters[c].firstIndex, indices + clusters[c].firstIndex + clusters[c].indexCount);
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(void* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexStride)
+{
+	// remap[old vertex] is the new vertex, in the order
+	// that the index buffer uses them for the first time
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	uint32_t next = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (remap[indices[i]] == UINT32_MAX)
+			remap[indices[i]] = next++;
+
+		indices[i] = remap[indices[i]];
+	}
+
+	// move the vertices to their new places,
+	// vertices that nobody uses are left behind
+	std::vector<char> copy((char*)vertices, (char*)vertices + vertexCount * vertexStride);
+
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] != UINT32_MAX)
+			memcpy((char*)vertices + remap[v] * vertexStride, copy.data() + v * vertexStride, vertexStride);
+	}
+
+	return next;
+}
+
+// Finds the sphere and the cone of the triangles of one meshlet
+static void FinishMeshlet(Meshlet* meshlet, const uint32_t* indices, const float* positions, size_t positionStride)
+{
+	const char* base = (const char*)positions;
+	#define POSITION(v) ((const float*)(base + (size_t)(v) * positionStride))
+
+	// The sphere is at the center of the box around the vertices,
+	// and it is as big as the farthest vertex from that center
+	float boxMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boxMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (uint32_t i = 0; i < meshlet->indexCount; i++)
+	{
+		const float* p = POSITION(indices[i]);
+		for (int k = 0; k < 3; k++)
+		{
+			boxMin[k] = std::min(boxMin[k], p[k]);
+			boxMax[k] = std::max(boxMax[k], p[k]);
+		}
+	}
+
+	float radius = 0.0f;
+	for (int k = 0; k < 3; k++)
+		meshlet->center[k] = (boxMin[k] + boxMax[k]) * 0.5f;
+
+	for (uint32_t i = 0; i < meshlet->indexCount; i++)
+	{
+		const float* p = POSITION(indices[i]);
+		float d[3] = { p[0] - meshlet->center[0], p[1] - meshlet->center[1], p[2] - meshlet->center[2] };
+		radius = std::max(radius, sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+	}
+
+	meshlet->radius = radius;
+
+	// The axis of the cone is the average direction of the triangles,
+	// each one counts the same, no matter how big it is. The cross
+	// product points out of the front of the triangle, see CubeDataArrays.h
+	std::vector<float> normals;
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (uint32_t i = 0; i < meshlet->indexCount; i += 3)
+	{
+		const float* a = POSITION(indices[i]);
+		const float* b = POSITION(indices[i + 1]);
+		const float* c = POSITION(indices[i + 2]);
+
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] =
+		{
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0]
+		};
+
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+		// a triangle with no area can not be seen from either side
+		if (length == 0.0f)
+			continue;
+
+		for (int k = 0; k < 3; k++)
+		{
+			normals.push_back(n[k] / length);
+			axis[k] += n[k] / length;
+		}
+	}
+
+	#undef POSITION
+
+	float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+	// The cone has to hold every normal, so its angle is the
+	// biggest angle between the axis and a normal. If that is
+	// 90 degrees or more (or close to it), some triangle can always
+	// be seen, from wherever the camera is, and the cone can not cull
+	float minDot = 1.0f;
+
+	for (int k = 0; k < 3; k++)
+		meshlet->coneAxis[k] = (axisLength > 0.0f) ? axis[k] / axisLength : 0.0f;
+
+	for (size_t n = 0; n < normals.size(); n += 3)
+	{
+		float dot = normals[n] * meshlet->coneAxis[0] + normals[n + 1] * meshlet->coneAxis[1] + normals[n + 2] * meshlet->coneAxis[2];
+		minDot = std::min(minDot, dot);
+	}
+
+	if (axisLength == 0.0f || minDot <= 0.1f)
+		meshlet->coneCutoff = 1.0f;
+	else
+		meshlet->coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+void MeshOptimizer::BuildMeshlets(const uint32_t* indices, size_t indexCount, uint32_t firstIndex, const float* positions, size_t positionStride, std::vector<Meshlet>* meshlets)
+{
+	// The triangles are added in order, and a meshlet is finished
+	// when the next triangle would give it too many vertices. After
+	// OptimizeVertexCache, the triangles in a row are next to each
+	// other, so the meshlets are small patches of the surface
+	uint32_t vertices[MESH_MESHLET_MAX_VERTICES];
+	uint32_t vertexCount = 0;
+
+	Meshlet meshlet = {};
+	meshlet.firstIndex = firstIndex;
+
+	for (size_t t = 0; t < indexCount / 3; t++)
+	{
+		const uint32_t* triangle = indices + t * 3;
+
+		// how many vertices of this triangle are not in the meshlet yet
+		uint32_t newVertices = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			if (std::find(vertices, vertices + vertexCount, triangle[k]) == vertices + vertexCount)
+				newVertices++;
+		}
+
+		if (vertexCount + newVertices > MESH_MESHLET_MAX_VERTICES ||
+			meshlet.indexCount / 3 == MESH_MESHLET_MAX_TRIANGLES)
+		{
+			FinishMeshlet(&meshlet, indices + (meshlet.firstIndex - firstIndex), positions, positionStride);
+			meshlets->push_back(meshlet);
+
+			meshlet = {};
+			meshlet.firstIndex = firstIndex + (uint32_t)(t * 3);
+			vertexCount = 0;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (std::find(vertices, vertices + vertexCount, triangle[k]) == vertices + vertexCount)
+				vertices[vertexCount++] = triangle[k];
+		}
+
+		meshlet.indexCount += 3;
+	}
+
+	if (meshlet.indexCount > 0)
+	{
+		FinishMeshlet(&meshlet, indices + (meshlet.firstIndex - firstIndex), positions, positionStride);
+		meshlets->push_back(meshlet);
+	}
+}
+
+MeshCacheStats MeshOptimizer::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	// A FIFO cache, like most GPUs have. A vertex that is
+	// already in the cache does not move to the front
+	std::vector<uint32_t> cache;
+	size_t transforms = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (std::find(cache.begin(), cache.end(), indices[i]) != cache.end())
+			continue;
+
+		transforms++;
+		cache.insert(cache.begin(), indices[i]);
+
+		if (cache.size() > cacheSize)
+			cache.pop_back();
+	}
+
+	MeshCacheStats stats;
+	stats.acmr = (indexCount >= 3) ? (float)transforms / (float)(indexCount / 3) : 0.0f;
+	stats.atvr = (vertexCount > 0) ? (float)transforms / (float)vertexCount : 0.0f;
+	return stats;
+}
@@ -0,0 +1,107 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "MeshFile.h"
+
+// the number of vertices that the cache simulation (and the
+// vertex cache optimization) assumes that the GPU remembers.
+// Real GPUs are different, but 16 to 32 is a good guess for all of them
+#define MESH_CACHE_SIZE 16
+#define MESH_OPTIMIZE_CACHE_SIZE 32
+
+// how well the GPU can reuse vertices for an index buffer
+struct MeshCacheStats
+{
+	// Average Cache Miss Ratio: vertex shader runs per triangle.
+	// It is 3.0 if no vertex is ever reused, and 0.5 is about the
+	// best that a big grid of triangles can get
+	float acmr;
+
+	// Average Transform to Vertex Ratio: vertex shader runs per
+	// vertex. 1.0 is perfect, every vertex runs the shader one time
+	float atvr;
+};
+
+// Each function changes a mesh that is made of triangles (three
+// indices each). They are slow compared to drawing, so they run
+// when a mesh is imported (see build_cube_mesh in Demo.cpp),
+// and the result is saved in the mesh file
+class MeshOptimizer
+{
+public:
+	// Reorders the triangles, so that triangles that share vertices
+	// are drawn close together, and the GPU finds more vertices in its
+	// cache. This is Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+	static void OptimizeVertexCache(
+		uint32_t* indices,
+		size_t indexCount,
+		size_t vertexCount);
+
+	// Reorders groups of triangles (after OptimizeVertexCache) so that
+	// the groups that face outwards are drawn first. Those usually hide
+	// the groups behind them, so less pixels are shaded twice.
+	// positions points to the X of the first vertex, and
+	// positionStride is the number of bytes between vertices
+	static void OptimizeOverdraw(
+		uint32_t* indices,
+		size_t indexCount,
+		const float* positions,
+		size_t positionStride);
+
+	// Reorders the vertices to be in the order that the indices use them,
+	// so the GPU reads the vertex buffer from start to end. Vertices that
+	// are not used are removed. Returns the new number of vertices
+	static size_t OptimizeVertexFetch(
+		void* vertices,
+		uint32_t* indices,
+		size_t indexCount,
+		size_t vertexCount,
+		size_t vertexStride);
+
+	// Cuts the triangles of indices (after the other optimizations,
+	// so triangles that are next to each other are already close
+	// together) into meshlets of at most MESH_MESHLET_MAX_VERTICES
+	// vertices and MESH_MESHLET_MAX_TRIANGLES triangles, in the same
+	// order, and adds them to meshlets. firstIndex is where indices
+	// starts in the whole index buffer, for the range of each meshlet
+	static void BuildMeshlets(
+		const uint32_t* indices,
+		size_t indexCount,
+		uint32_t firstIndex,
+		const float* positions,
+		size_t positionStride,
+		std::vector<Meshlet>* meshlets);
+
+	// Simulates a FIFO vertex cache to find the ACMR and ATVR
+	static MeshCacheStats AnalyzeVertexCache(
+		const uint32_t* indices,
+		size_t indexCount,
+		size_t vertexCount,
+		uint32_t cacheSize = MESH_CACHE_SIZE);
+};
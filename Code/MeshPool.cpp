@@ -0,0 +1,153 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "MeshPool.h"
+#include "Helper.h"
+#include <vector>
+#include <string.h>
+
+MeshPool::MeshPool(
+	VkDevice d,
+	MemoryAllocator* a,
+	uint32_t stride,
+	uint32_t posStride,
+	VkIndexType type,
+	uint32_t maxVertices,
+	uint32_t maxIndices,
+	VkBufferUsageFlags extraUsage)
+{
+	device = d;
+	allocator = a;
+	vertexStride = stride;
+	positionStride = posStride;
+	indexType = type;
+	indexSize = (type == VK_INDEX_TYPE_UINT16) ? 2 : 4;
+	vertexCapacity = maxVertices;
+	indexCapacity = maxIndices;
+	vertexCount = 0;
+	indexCount = 0;
+
+	// The buffers are made big enough for every mesh at the
+	// start, so nothing is ever copied to a bigger buffer, and
+	// a range that was handed out never moves
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | extraUsage;
+	info.size = (VkDeviceSize)vertexCapacity * vertexStride;
+
+	vertexBuffer = BufferGPU(device, allocator, info);
+	vertexBuffer.SetName("Mesh pool vertices");
+
+	if (positionStride > 0)
+	{
+		info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | extraUsage;
+		info.size = (VkDeviceSize)vertexCapacity * positionStride;
+		positionBuffer = BufferGPU(device, allocator, info);
+		positionBuffer.SetName("Mesh pool positions");
+	}
+
+	info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.size = (VkDeviceSize)indexCapacity * indexSize;
+
+	indexBuffer = BufferGPU(device, allocator, info);
+	indexBuffer.SetName("Mesh pool indices");
+}
+
+MeshPool::~MeshPool()
+{
+	vertexBuffer.Destroy();
+	positionBuffer.Destroy();
+	indexBuffer.Destroy();
+}
+
+MeshRange MeshPool::Add(Uploader* uploader, const void* vertices, uint32_t vertices_count, const void* indices, uint32_t indices_count)
+{
+	MeshRange range = Reserve(vertices_count, indices_count);
+	Write(uploader, range, vertices, vertices_count, indices, indices_count);
+	return range;
+}
+
+MeshRange MeshPool::Reserve(uint32_t vertices_count, uint32_t indices_count)
+{
+	if (vertexCount + vertices_count > vertexCapacity || indexCount + indices_count > indexCapacity)
+		ERR_EXIT("The mesh pool is full\n", "Mesh Failure");
+
+	MeshRange range;
+	range.firstVertex = vertexCount;
+	range.vertexCount = vertices_count;
+	range.firstIndex = indexCount;
+	range.indexCount = indices_count;
+
+	vertexCount += vertices_count;
+	indexCount += indices_count;
+	return range;
+}
+
+UploadTicket MeshPool::Write(Uploader* uploader, const MeshRange& range, const void* vertices, uint32_t vertices_count, const void* indices, uint32_t indices_count)
+{
+	if (vertices_count > range.vertexCount || indices_count > range.indexCount)
+		ERR_EXIT("The mesh is bigger than its range in the pool\n", "Mesh Failure");
+
+	// Each range goes right after the one before it, the uploader
+	// copies the mesh into that part of the buffer, and the rest of
+	// the buffer (the meshes that are already there) is not touched
+	uploader->UploadBuffer(&vertexBuffer, (void*)vertices, (int)(vertices_count * vertexStride),
+		VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		(VkDeviceSize)range.firstVertex * vertexStride);
+
+	// The position stream has the same vertices in the same order,
+	// so the same vertexOffset works for both of them
+	if (positionStride > 0)
+	{
+		std::vector<char> positions((size_t)vertices_count * positionStride);
+
+		for (uint32_t i = 0; i < vertices_count; i++)
+			memcpy(&positions[(size_t)i * positionStride], (const char*)vertices + (size_t)i * vertexStride, positionStride);
+
+		uploader->UploadBuffer(&positionBuffer, positions.data(), (int)positions.size(),
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			(VkDeviceSize)range.firstVertex * positionStride);
+	}
+
+	// every copy is in the same batch, so this ticket covers all of them
+	return uploader->UploadBuffer(&indexBuffer, (void*)indices, (int)(indices_count * indexSize),
+		VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		(VkDeviceSize)range.firstIndex * indexSize);
+}
+
+VkIndexType MeshPool::GetIndexType()
+{
+	return indexType;
+}
+
+uint32_t MeshPool::GetVertexCount()
+{
+	return vertexCount;
+}
+
+uint32_t MeshPool::GetIndexCount()
+{
+	return indexCount;
+}
@@ -0,0 +1,110 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "BufferGPU.h"
+#include "Uploader.h"
+
+// Where one mesh is in the pool. firstIndex and vertexOffset are
+// given straight to vkCmdDrawIndexed, the indices of the mesh start
+// at 0, and the GPU adds vertexOffset to them
+struct MeshRange
+{
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+// Every mesh shares one vertex buffer and one index buffer, so the
+// scene binds them one time, and a draw only needs the range of its
+// mesh. That is also what lets one indirect draw cover every mesh,
+// because an indirect command can change firstIndex and vertexOffset,
+// but it can not change which buffers are bound.
+// Space is handed out from the front, and never given back, meshes
+// are added while loading, and they all live until the pool is destroyed.
+// A mesh that changes (like a chunk of the VoxelWorld) reserves its
+// space one time, and writes a new mesh into that space when it changes
+class MeshPool
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+
+	uint32_t vertexStride;
+	uint32_t positionStride;
+	VkIndexType indexType;
+	uint32_t indexSize;
+
+	uint32_t vertexCapacity;
+	uint32_t indexCapacity;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+
+public:
+	BufferGPU vertexBuffer;
+	BufferGPU indexBuffer;
+
+	// Only the positions of every vertex, for passes that read
+	// nothing else (the depth pre-pass). It is empty if
+	// positionStride is 0
+	BufferGPU positionBuffer;
+
+	// The position must be the first positionStride
+	// bytes of every vertex, it is copied from there.
+	// extraUsage is added to the usage of the vertex buffer (and of
+	// the position buffer), like SHADER_DEVICE_ADDRESS when a shader
+	// reads the vertices itself, or STORAGE when a shader writes them
+	MeshPool(
+		VkDevice d,
+		MemoryAllocator* a,
+		uint32_t stride,
+		uint32_t posStride,
+		VkIndexType type,
+		uint32_t maxVertices,
+		uint32_t maxIndices,
+		VkBufferUsageFlags extraUsage = 0);
+
+	~MeshPool();
+
+	// Copies the mesh into the pool with the uploader, the
+	// vertices and indices can be freed as soon as it returns
+	MeshRange Add(Uploader* uploader, const void* vertices, uint32_t vertices_count, const void* indices, uint32_t indices_count);
+
+	// Takes the space for a mesh of up to that many vertices
+	// and indices, without copying anything into it
+	MeshRange Reserve(uint32_t vertices_count, uint32_t indices_count);
+
+	// Copies a mesh into the start of a range that was added or
+	// reserved, it can be smaller than the range. The GPU must not
+	// be reading that range anymore, the rest of the pool can be in use
+	UploadTicket Write(Uploader* uploader, const MeshRange& range, const void* vertices, uint32_t vertices_count, const void* indices, uint32_t indices_count);
+
+	VkIndexType GetIndexType();
+	uint32_t GetVertexCount();
+	uint32_t GetIndexCount();
+};
@@ -0,0 +1,272 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+// winsock2.h has to come before windows.h, which
+// would include the old winsock.h instead
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "MetricsExporter.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+MetricsExporter::MetricsExporter(const char* host, uint16_t p, const char* namePrefix, uint32_t ms)
+{
+	socketHandle = (uintptr_t)INVALID_SOCKET;
+	address = 0;
+	port = htons(p);
+	prefix = namePrefix;
+	intervalMs = ms;
+	lastPresentId = 0;
+	pending = false;
+	quit = false;
+	sentIntervals = 0;
+	skippedIntervals = 0;
+
+	Clear(current);
+	Clear(sending);
+	intervalStart = CpuClock::now();
+
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+		return;
+
+	if (inet_pton(AF_INET, host, &address) != 1)
+	{
+		printf("Metrics: %s is not an IPv4 address\n", host);
+		return;
+	}
+
+	// nothing is ever received, so the socket does not need to be bound
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == INVALID_SOCKET)
+		return;
+
+	socketHandle = (uintptr_t)s;
+
+	thread = std::thread(&MetricsExporter::Run, this);
+}
+
+MetricsExporter::~MetricsExporter()
+{
+	if (thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		condition.notify_all();
+		thread.join();
+	}
+
+	if ((SOCKET)socketHandle != INVALID_SOCKET)
+		closesocket((SOCKET)socketHandle);
+
+	WSACleanup();
+}
+
+bool MetricsExporter::IsOpen()
+{
+	return (SOCKET)socketHandle != INVALID_SOCKET;
+}
+
+void MetricsExporter::Clear(MetricsInterval& interval)
+{
+	// the frame times are written before they are read,
+	// there is no need to clear all of them
+	interval.frameCount = 0;
+	interval.seconds = 0;
+	interval.gpuMsTotal = 0;
+	interval.gpuMsMax = 0;
+	interval.gpuFrames = 0;
+	interval.latePresents = 0;
+	interval.droppedPresents = 0;
+	interval.memoryUsage = 0;
+	interval.memoryBudget = 0;
+}
+
+void MetricsExporter::AddFrame(double frameMs, double gpuMs)
+{
+	if (current.frameCount < METRICS_MAX_FRAMES)
+		current.frameMs[current.frameCount] = (float)frameMs;
+
+	current.frameCount++;
+
+	// zero means that the GPU has not finished a frame yet
+	if (gpuMs > 0)
+	{
+		current.gpuMsTotal += gpuMs;
+		current.gpuMsMax = std::max(current.gpuMsMax, gpuMs);
+		current.gpuFrames++;
+	}
+}
+
+void MetricsExporter::AddPresent(uint32_t presentID, bool late)
+{
+	// the IDs in between were replaced by newer images (in MAILBOX),
+	// or thrown away by the driver, so they were never on the screen
+	if (lastPresentId != 0 && presentID > lastPresentId + 1)
+		current.droppedPresents += presentID - lastPresentId - 1;
+
+	if (presentID > lastPresentId)
+		lastPresentId = presentID;
+
+	if (late)
+		current.latePresents++;
+}
+
+bool MetricsExporter::IsIntervalOver()
+{
+	return std::chrono::duration<double, std::milli>(CpuClock::now() - intervalStart).count() >= intervalMs;
+}
+
+void MetricsExporter::SetMemory(uint64_t usage, uint64_t budget)
+{
+	current.memoryUsage = usage;
+	current.memoryBudget = budget;
+}
+
+void MetricsExporter::EndInterval()
+{
+	CpuClock::time_point now = CpuClock::now();
+	current.seconds = std::chrono::duration<double>(now - intervalStart).count();
+	intervalStart = now;
+
+	// The copy is a few kilobytes, once every few seconds. If the
+	// thread still has the last interval, or has the lock right now,
+	// this interval is skipped, so the render thread never waits
+	bool handed = false;
+
+	if (mutex.try_lock())
+	{
+		if (!pending)
+		{
+			memcpy(&sending, &current, sizeof(MetricsInterval));
+			pending = true;
+			handed = true;
+		}
+
+		mutex.unlock();
+	}
+
+	if (handed)
+		condition.notify_one();
+	else
+		skippedIntervals++;
+
+	Clear(current);
+}
+
+uint32_t MetricsExporter::Format(MetricsInterval& interval)
+{
+	uint32_t stored = std::min(interval.frameCount, (uint32_t)METRICS_MAX_FRAMES);
+
+	// the percentiles of the frame time, sorted in place,
+	// the render thread does not touch this copy anymore
+	float p50 = 0;
+	float p90 = 0;
+	float p99 = 0;
+	float worst = 0;
+
+	if (stored > 0)
+	{
+		std::sort(interval.frameMs, interval.frameMs + stored);
+		p50 = interval.frameMs[(stored - 1) * 50 / 100];
+		p90 = interval.frameMs[(stored - 1) * 90 / 100];
+		p99 = interval.frameMs[(stored - 1) * 99 / 100];
+		worst = interval.frameMs[stored - 1];
+	}
+
+	double fps = interval.seconds > 0 ? interval.frameCount / interval.seconds : 0;
+	double gpuAvg = interval.gpuFrames > 0 ? interval.gpuMsTotal / interval.gpuFrames : 0;
+	double budgetUsed = interval.memoryBudget > 0 ? 100.0 * interval.memoryUsage / interval.memoryBudget : 0;
+
+	// Gauges (g) are the value of this interval, counters (c)
+	// are added up by the server, one metric on each line
+	int length = snprintf(packet, sizeof(packet),
+		"%sframe_ms.p50:%.3f|g\n"
+		"%sframe_ms.p90:%.3f|g\n"
+		"%sframe_ms.p99:%.3f|g\n"
+		"%sframe_ms.max:%.3f|g\n"
+		"%sfps:%.2f|g\n"
+		"%sgpu_ms.avg:%.3f|g\n"
+		"%sgpu_ms.max:%.3f|g\n"
+		"%spresents.late:%u|c\n"
+		"%spresents.dropped:%u|c\n"
+		"%smemory.usage_mb:%llu|g\n"
+		"%smemory.budget_mb:%llu|g\n"
+		"%smemory.budget_used:%.1f|g",
+		prefix, p50,
+		prefix, p90,
+		prefix, p99,
+		prefix, worst,
+		prefix, fps,
+		prefix, gpuAvg,
+		prefix, interval.gpuMsMax,
+		prefix, interval.latePresents,
+		prefix, interval.droppedPresents,
+		prefix, (unsigned long long)(interval.memoryUsage >> 20),
+		prefix, (unsigned long long)(interval.memoryBudget >> 20),
+		prefix, budgetUsed);
+
+	if (length < 0)
+		return 0;
+
+	return std::min((uint32_t)length, (uint32_t)sizeof(packet) - 1);
+}
+
+void MetricsExporter::Run()
+{
+	sockaddr_in destination = {};
+	destination.sin_family = AF_INET;
+	destination.sin_port = port;
+	destination.sin_addr.s_addr = address;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		condition.wait(lock, [this]() { return pending || quit; });
+
+		if (!pending)
+			break;
+
+		// sending is ours until pending is false again,
+		// so the lock is not needed to read it
+		lock.unlock();
+
+		uint32_t length = Format(sending);
+
+		// a server that is not running is not an error, UDP
+		// does not know, and the metrics of this interval are lost
+		if (length > 0)
+			sendto((SOCKET)socketHandle, packet, (int)length, 0, (sockaddr*)&destination, sizeof(destination));
+
+		sentIntervals++;
+
+		lock.lock();
+		pending = false;
+	}
+}
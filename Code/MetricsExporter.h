@@ -0,0 +1,130 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "CpuProfiler.h"
+
+// the most frames of one interval that go into the percentiles,
+// an interval with more frames still counts all of them
+#define METRICS_MAX_FRAMES 4096
+
+// StatsD packets should fit into one UDP datagram
+// without being split, on any network
+#define METRICS_PACKET_SIZE 1024
+
+// Everything that is measured in one interval. It has a fixed
+// size, so the render thread never allocates to fill it
+struct MetricsInterval
+{
+	float frameMs[METRICS_MAX_FRAMES];
+	uint32_t frameCount;
+	double seconds;
+
+	double gpuMsTotal;
+	double gpuMsMax;
+	uint32_t gpuFrames;
+
+	// from display timing, presents that were on the screen later than
+	// we wanted, and presents that were never on the screen at all
+	uint32_t latePresents;
+	uint32_t droppedPresents;
+
+	uint64_t memoryUsage;
+	uint64_t memoryBudget;
+};
+
+// Sends the numbers of the demo to a StatsD server, like Telegraf or
+// the Datadog agent, which can be running on the same computer. The
+// render thread fills an interval, and every intervalMs it hands the
+// interval to the exporter thread, which finds the percentiles, and
+// sends them in one UDP packet. UDP does not wait for anybody, so a
+// display that runs with nobody listening is not slowed down at all.
+// If the thread is still busy with the last interval, the new one is
+// thrown away (and counted), the render thread never waits for it
+class MetricsExporter
+{
+private:
+	// a SOCKET, this header does not include winsock2.h, which
+	// has to be included before windows.h everywhere it is used
+	uintptr_t socketHandle;
+	uint32_t address;
+	uint16_t port;
+	const char* prefix;
+
+	// filled by the render thread
+	MetricsInterval current;
+	CpuClock::time_point intervalStart;
+	uint32_t intervalMs;
+	uint32_t lastPresentId;
+
+	// read by the exporter thread, only while pending is true
+	MetricsInterval sending;
+	char packet[METRICS_PACKET_SIZE];
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool pending;
+	bool quit;
+
+	void Clear(MetricsInterval& interval);
+	void Run();
+	uint32_t Format(MetricsInterval& interval);
+
+public:
+	// the intervals that were sent, and the
+	// ones that the exporter was too busy for
+	std::atomic<uint32_t> sentIntervals;
+	std::atomic<uint32_t> skippedIntervals;
+
+	// host is an IPv4 address, the names in the
+	// packets start with prefix, like "vkcube."
+	MetricsExporter(const char* host, uint16_t port, const char* prefix, uint32_t intervalMs);
+
+	// sends the interval that is pending, then stops
+	~MetricsExporter();
+
+	// false if the socket could not be made
+	bool IsOpen();
+
+	// the time of one frame, from the start of the last one,
+	// and the GPU time of the newest frame that the GPU finished
+	void AddFrame(double frameMs, double gpuMs);
+
+	// one present that came back from display timing, presentID
+	// counts up, so a present that is skipped was never shown
+	void AddPresent(uint32_t presentID, bool late);
+
+	// true when the interval is over, then the caller
+	// sets the memory, and calls EndInterval
+	bool IsIntervalOver();
+	void SetMemory(uint64_t usage, uint64_t budget);
+	void EndInterval();
+};
@@ -0,0 +1,549 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "MicroBenchmark.h"
+#include "HostAllocator.h"
+#include "BufferCPU.h"
+#include "BufferGPU.h"
+#include "TextureGPU.h"
+#include "TemporalPass.h"
+#include "ImageDecoder.h"
+#include "Helper.h"
+#include <stdarg.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double ElapsedMs(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// bytes in a number of milliseconds, as GB every second
+static double GBs(double bytes, double ms)
+{
+	return (ms > 0.0) ? bytes / (ms * 1000000.0) : 0.0;
+}
+
+MicroBenchmark::MicroBenchmark(VkDevice d, VkPhysicalDevice gpu, MemoryAllocator* a, VkQueue q, uint32_t queueFamily, SamplerCache* s)
+{
+	device = d;
+	allocator = a;
+	queue = q;
+	samplers = s;
+	file = nullptr;
+	first = true;
+
+	// the same check as in GpuTimer
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(gpu, &props);
+
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, NULL);
+
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, families.data());
+
+	uint32_t validBits = families[queueFamily].timestampValidBits;
+	timestampPeriod = (validBits == 0) ? 0.0f : props.limits.timestampPeriod;
+	validMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+
+	if (timestampPeriod == 0.0f)
+		printf("This queue can not write timestamps, the uploads are timed on the CPU\n");
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	vkCreateCommandPool(device, &poolInfo, HostAllocator::callbacks, &commandPool);
+
+	VkCommandBufferAllocateInfo cmdInfo = {};
+	cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cmdInfo.commandPool = commandPool;
+	cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cmdInfo.commandBufferCount = 1;
+	vkAllocateCommandBuffers(device, &cmdInfo, &cmd);
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	vkCreateFence(device, &fenceInfo, HostAllocator::callbacks, &fence);
+
+	VkQueryPoolCreateInfo queryInfo = {};
+	queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = 2;
+	vkCreateQueryPool(device, &queryInfo, HostAllocator::callbacks, &queryPool);
+}
+
+MicroBenchmark::~MicroBenchmark()
+{
+	vkDestroyQueryPool(device, queryPool, HostAllocator::callbacks);
+	vkDestroyFence(device, fence, HostAllocator::callbacks);
+	vkDestroyCommandPool(device, commandPool, HostAllocator::callbacks);
+}
+
+void MicroBenchmark::BeginGroup(const char* name)
+{
+	fprintf(file, "\t\"%s\": [\n", name);
+	first = true;
+	printf("%s\n", name);
+}
+
+void MicroBenchmark::EndGroup()
+{
+	fprintf(file, "\n\t]");
+}
+
+// one result is one JSON object, in its group
+void MicroBenchmark::Result(const char* format, ...)
+{
+	char text[512];
+
+	va_list va;
+	va_start(va, format);
+	vsnprintf(text, sizeof(text), format, va);
+	va_end(va);
+
+	fprintf(file, "%s\t\t{ %s }", first ? "" : ",\n", text);
+	printf("  %s\n", text);
+	first = false;
+}
+
+VkCommandBuffer MicroBenchmark::Begin()
+{
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkResetCommandBuffer(cmd, 0);
+	vkBeginCommandBuffer(cmd, &beginInfo);
+	vkCmdResetQueryPool(cmd, queryPool, 0, 2);
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+	return cmd;
+}
+
+double MicroBenchmark::Submit()
+{
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+	vkEndCommandBuffer(cmd);
+
+	VkSubmitInfo submit = {};
+	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit.commandBufferCount = 1;
+	submit.pCommandBuffers = &cmd;
+
+	// without timestamps, the time from the submit
+	// to the fence is the closest that we can get
+	BenchClock::time_point start = BenchClock::now();
+	vkQueueSubmit(queue, 1, &submit, fence);
+	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	double wallMs = ElapsedMs(start);
+	vkResetFences(device, 1, &fence);
+
+	if (timestampPeriod == 0.0f)
+		return wallMs;
+
+	uint64_t ticks[2];
+	vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+	return (double)((ticks[1] - ticks[0]) & validMask) * timestampPeriod / 1000000.0;
+}
+
+void MicroBenchmark::StoreCPU()
+{
+	// Store maps, copies, and unmaps each time, unless the buffer is
+	// persistent, then it only copies. Every size moves about 256 MB,
+	// so that the small ones are not just the time of one call
+	BeginGroup("BufferCPU::Store");
+
+	for (uint32_t persistent = 0; persistent < 2; persistent++)
+	{
+		for (int size = 4 * 1024; size <= 64 * 1024 * 1024; size *= 4)
+		{
+			VkBufferCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			info.size = size;
+			info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+			BufferCPU buffer(device, allocator, info, persistent == 1);
+			std::vector<uint8_t> data(size, 0x5a);
+
+			uint32_t count = (uint32_t)std::max(4, (256 * 1024 * 1024) / size);
+
+			BenchClock::time_point start = BenchClock::now();
+			for (uint32_t i = 0; i < count; i++)
+				buffer.Store(data.data(), size);
+			double ms = ElapsedMs(start);
+
+			Result("\"persistent\": %s, \"bytes\": %d, \"calls\": %u, \"callUs\": %.3f, \"GBs\": %.3f",
+				persistent ? "true" : "false", size, count, ms * 1000.0 / count, GBs((double)size * count, ms));
+		}
+	}
+
+	EndGroup();
+}
+
+void MicroBenchmark::UploadBuffer()
+{
+	// the time of the copy on the GPU, from the staging buffer
+	// to the buffer in device memory, including its barriers
+	BeginGroup("BufferGPU::Store");
+
+	for (int size = 4 * 1024; size <= 64 * 1024 * 1024; size *= 4)
+	{
+		VkBufferCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		info.size = size;
+		info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		BufferCPU staging(device, allocator, info);
+
+		info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		BufferGPU buffer(device, allocator, info);
+
+		// the first copy can be slower (the driver might
+		// still be setting things up), so it is not counted
+		double best = 0.0;
+
+		for (uint32_t i = 0; i < 5; i++)
+		{
+			buffer.Store(Begin(), staging.buffer, size);
+			double ms = Submit();
+
+			if (i == 1 || (i > 1 && ms < best))
+				best = ms;
+		}
+
+		Result("\"bytes\": %d, \"gpuMs\": %.4f, \"GBs\": %.3f", size, best, GBs(size, best));
+	}
+
+	EndGroup();
+}
+
+void MicroBenchmark::UploadTexture()
+{
+	// the same as UploadBuffer, to an RGBA image of one level,
+	// which the GPU has to lay out in its own tiled order
+	BeginGroup("TextureGPU::Store");
+
+	for (int side = 256; side <= 4096; side *= 2)
+	{
+		int size = side * side * 4;
+
+		VkBufferCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		info.size = size;
+		info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		BufferCPU staging(device, allocator, info);
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageInfo.extent = { (uint32_t)side, (uint32_t)side, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		TextureGPU texture(device, allocator, imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		double best = 0.0;
+
+		for (uint32_t i = 0; i < 5; i++)
+		{
+			texture.Store(Begin(), staging.buffer, side, side);
+			double ms = Submit();
+
+			if (i == 1 || (i > 1 && ms < best))
+				best = ms;
+		}
+
+		Result("\"width\": %d, \"height\": %d, \"bytes\": %d, \"gpuMs\": %.4f, \"GBs\": %.3f",
+			side, side, size, best, GBs(size, best));
+	}
+
+	EndGroup();
+}
+
+void MicroBenchmark::Allocation()
+{
+	// Each size makes MICROBENCH_OBJECTS objects, and then frees them,
+	// once through the BufferGPU wrapper (which also creates and
+	// destroys the VkBuffer), and once through the allocator alone
+	BeginGroup("allocation");
+
+	std::vector<double> times(MICROBENCH_OBJECTS);
+
+	for (VkDeviceSize size = 256; size <= 4 * 1024 * 1024; size *= 16)
+	{
+		VkBufferCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		info.size = size;
+		info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+		std::vector<BufferGPU> buffers(MICROBENCH_OBJECTS);
+
+		for (uint32_t i = 0; i < MICROBENCH_OBJECTS; i++)
+		{
+			BenchClock::time_point start = BenchClock::now();
+			buffers[i] = BufferGPU(device, allocator, info);
+			times[i] = ElapsedMs(start);
+		}
+
+		// the median says what it usually costs, the max
+		// is when a new block had to come from the driver
+		std::sort(times.begin(), times.end());
+		double createUs = times[MICROBENCH_OBJECTS / 2] * 1000.0;
+		double createMaxUs = times.back() * 1000.0;
+
+		// the requirements of these buffers, for the allocator test
+		VkMemoryRequirements reqs;
+		vkGetBufferMemoryRequirements(device, buffers[0].buffer, &reqs);
+
+		for (uint32_t i = 0; i < MICROBENCH_OBJECTS; i++)
+		{
+			BenchClock::time_point start = BenchClock::now();
+			buffers[i].Destroy();
+			times[i] = ElapsedMs(start);
+		}
+
+		std::sort(times.begin(), times.end());
+		double destroyUs = times[MICROBENCH_OBJECTS / 2] * 1000.0;
+
+		Result("\"path\": \"BufferGPU\", \"bytes\": %llu, \"createUs\": %.3f, \"createMaxUs\": %.3f, \"destroyUs\": %.3f",
+			(unsigned long long)size, createUs, createMaxUs, destroyUs);
+
+		std::vector<MemoryAllocation> allocations(MICROBENCH_OBJECTS);
+
+		for (uint32_t i = 0; i < MICROBENCH_OBJECTS; i++)
+		{
+			BenchClock::time_point start = BenchClock::now();
+			allocator->Allocate(reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, &allocations[i]);
+			times[i] = ElapsedMs(start);
+		}
+
+		std::sort(times.begin(), times.end());
+		createUs = times[MICROBENCH_OBJECTS / 2] * 1000.0;
+		createMaxUs = times.back() * 1000.0;
+
+		for (uint32_t i = 0; i < MICROBENCH_OBJECTS; i++)
+		{
+			BenchClock::time_point start = BenchClock::now();
+			allocator->Free(&allocations[i]);
+			times[i] = ElapsedMs(start);
+		}
+
+		std::sort(times.begin(), times.end());
+		destroyUs = times[MICROBENCH_OBJECTS / 2] * 1000.0;
+
+		Result("\"path\": \"MemoryAllocator\", \"bytes\": %llu, \"createUs\": %.3f, \"createMaxUs\": %.3f, \"destroyUs\": %.3f",
+			(unsigned long long)size, createUs, createMaxUs, destroyUs);
+	}
+
+	EndGroup();
+}
+
+void MicroBenchmark::Creation()
+{
+	BeginGroup("creation");
+
+	// a layout like the one of the temporal pass, which has
+	// images, samplers, and a storage image
+	VkDescriptorSetLayoutBinding bindings[4];
+	memset(bindings, 0, sizeof(bindings));
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = (i == 3) ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = bindings;
+
+	VkDescriptorSetLayout layout;
+	BenchClock::time_point start = BenchClock::now();
+	for (uint32_t i = 0; i < MICROBENCH_OBJECTS; i++)
+	{
+		vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &layout);
+		vkDestroyDescriptorSetLayout(device, layout, HostAllocator::callbacks);
+	}
+	Result("\"object\": \"VkDescriptorSetLayout\", \"us\": %.3f", ElapsedMs(start) * 1000.0 / MICROBENCH_OBJECTS);
+
+	vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &layout);
+
+	VkDescriptorPoolSize poolSizes[2];
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = 3 * MICROBENCH_OBJECTS;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = MICROBENCH_OBJECTS;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = MICROBENCH_OBJECTS;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	VkDescriptorPool pool;
+	start = BenchClock::now();
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &pool);
+	Result("\"object\": \"VkDescriptorPool\", \"us\": %.3f", ElapsedMs(start) * 1000.0);
+
+	// one set at a time, the way that most code allocates them
+	VkDescriptorSetAllocateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = pool;
+	setInfo.descriptorSetCount = 1;
+	setInfo.pSetLayouts = &layout;
+
+	std::vector<VkDescriptorSet> sets(MICROBENCH_OBJECTS);
+	start = BenchClock::now();
+	for (uint32_t i = 0; i < MICROBENCH_OBJECTS; i++)
+		vkAllocateDescriptorSets(device, &setInfo, &sets[i]);
+	Result("\"object\": \"VkDescriptorSet\", \"us\": %.3f", ElapsedMs(start) * 1000.0 / MICROBENCH_OBJECTS);
+
+	start = BenchClock::now();
+	vkResetDescriptorPool(device, pool, 0);
+	Result("\"object\": \"vkResetDescriptorPool\", \"us\": %.3f", ElapsedMs(start) * 1000.0);
+
+	vkDestroyDescriptorPool(device, pool, HostAllocator::callbacks);
+	vkDestroyDescriptorSetLayout(device, layout, HostAllocator::callbacks);
+
+	// A whole compute pipeline, with its layouts, and without a pipeline
+	// cache, so the driver compiles the shader every time (unless it
+	// has a cache of its own, which the first and the median show)
+	std::vector<double> times(MICROBENCH_PIPELINES);
+
+	for (uint32_t i = 0; i < MICROBENCH_PIPELINES; i++)
+	{
+		start = BenchClock::now();
+		TemporalPass* pass = new TemporalPass(device, VK_NULL_HANDLE, samplers);
+		times[i] = ElapsedMs(start);
+		delete pass;
+	}
+
+	double firstMs = times[0];
+	std::sort(times.begin(), times.end());
+	Result("\"object\": \"VkPipeline\", \"firstMs\": %.3f, \"ms\": %.3f", firstMs, times[MICROBENCH_PIPELINES / 2]);
+
+	EndGroup();
+}
+
+void MicroBenchmark::Decoders()
+{
+	// Every decoder gets the same file, on this thread, into normal
+	// memory. MBs is the size of the RGBA pixels that came out, which
+	// is the number to compare, because the file size depends on how
+	// well it was compressed. A decoder that does not take the file
+	// (the fast path only reads some PNG files) is not in the results
+	BeginGroup("ImageDecoder::Decode");
+
+	MappedFile image;
+
+	if (!image.Open(MICROBENCH_IMAGE))
+	{
+		printf("Could not open %s, the decoders were not tested\n", MICROBENCH_IMAGE);
+		EndGroup();
+		return;
+	}
+
+	PngDecoder png;
+	StbDecoder stb;
+	ImageDecoder* decoders[] = { &png, &stb };
+
+	for (uint32_t i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++)
+	{
+		const uint8_t* data = (const uint8_t*)image.GetData();
+		int width;
+		int height;
+
+		if (!decoders[i]->Info(data, image.GetSize(), &width, &height))
+			continue;
+
+		std::vector<uint8_t> pixels((size_t)width * height * 4);
+		bool ok = true;
+
+		BenchClock::time_point start = BenchClock::now();
+		for (uint32_t d = 0; d < MICROBENCH_DECODES && ok; d++)
+			ok = decoders[i]->Decode(data, image.GetSize(), pixels.data(), width, height);
+		double ms = ElapsedMs(start);
+
+		if (!ok)
+		{
+			printf("%s could not decode %s\n", decoders[i]->GetName(), MICROBENCH_IMAGE);
+			continue;
+		}
+
+		Result("\"decoder\": \"%s\", \"width\": %d, \"height\": %d, \"decodeMs\": %.3f, \"MBs\": %.1f",
+			decoders[i]->GetName(), width, height, ms / MICROBENCH_DECODES, GBs((double)pixels.size() * MICROBENCH_DECODES, ms) * 1000.0);
+	}
+
+	image.Close();
+	EndGroup();
+}
+
+bool MicroBenchmark::Run(const char* path)
+{
+	file = fopen(path, "w");
+
+	if (file == nullptr)
+	{
+		printf("Could not write %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\n");
+
+	StoreCPU();
+	fprintf(file, ",\n");
+	UploadBuffer();
+	fprintf(file, ",\n");
+	UploadTexture();
+	fprintf(file, ",\n");
+	Allocation();
+	fprintf(file, ",\n");
+	Creation();
+	fprintf(file, ",\n");
+	Decoders();
+
+	fprintf(file, "\n}\n");
+	fclose(file);
+	file = nullptr;
+
+	printf("The microbenchmarks were written to %s\n", path);
+	return true;
+}
@@ -0,0 +1,97 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <stdio.h>
+#include "MemoryAllocator.h"
+#include "SamplerCache.h"
+
+// the microbenchmarks write their results here
+#define MICROBENCH_FILE "microbench.json"
+
+// how many objects each allocation test makes, and
+// how many times each creation test is repeated
+#define MICROBENCH_OBJECTS 256
+#define MICROBENCH_PIPELINES 16
+
+// the image that each ImageDecoder decodes, and how many times
+#define MICROBENCH_IMAGE "../../../Assets/logo.png"
+#define MICROBENCH_DECODES 64
+
+// Measures the paths that move data and make objects, one at a time,
+// outside of any frame: BufferCPU::Store, the uploads of BufferGPU::Store
+// and TextureGPU::Store (timed on the GPU with timestamps), how long the
+// wrappers and the sub-allocator take to allocate and free, and how long
+// descriptor sets and pipelines take to create, and how fast each
+// ImageDecoder decodes the same PNG. Running this on two
+// drivers (or two GPUs) and comparing the files shows which one is faster
+class MicroBenchmark
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+	VkQueue queue;
+	SamplerCache* samplers;
+
+	// nanoseconds for each tick of a timestamp, zero if the
+	// queue can not write timestamps, and its valid bits
+	float timestampPeriod;
+	uint64_t validMask;
+
+	VkCommandPool commandPool;
+	VkCommandBuffer cmd;
+	VkFence fence;
+	VkQueryPool queryPool;
+
+	FILE* file;
+
+	// the first result of each group has no comma before it
+	bool first;
+
+	void BeginGroup(const char* name);
+	void EndGroup();
+	void Result(const char* format, ...);
+
+	// records cmd between two timestamps, runs it, waits
+	// for it, and gives the GPU time in milliseconds
+	VkCommandBuffer Begin();
+	double Submit();
+
+	void StoreCPU();
+	void UploadBuffer();
+	void UploadTexture();
+	void Allocation();
+	void Creation();
+	void Decoders();
+
+public:
+	MicroBenchmark(VkDevice d, VkPhysicalDevice gpu, MemoryAllocator* a, VkQueue q, uint32_t queueFamily, SamplerCache* s);
+	~MicroBenchmark();
+
+	// runs every test, and writes the results to path
+	bool Run(const char* path);
+};
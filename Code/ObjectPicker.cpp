@@ -0,0 +1,456 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "ObjectPicker.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+
+// Picking with the CPU would test a ray against the triangles of every
+// object, which is what the GPU already does for every pixel. Reading
+// the ID back right away would wait for the whole frame to finish with
+// vkDeviceWaitIdle or a fence, so the CPU and the GPU would take turns.
+// Instead, the answer is read a few frames later, when it is already
+// there, which is still much sooner than anyone can see
+
+// R32_UINT can always be a color attachment, and a copy source,
+// and every GPU can draw depth into D16
+#define PICK_ID_FORMAT VK_FORMAT_R32_UINT
+#define PICK_DEPTH_FORMAT VK_FORMAT_D16_UNORM
+
+ObjectPicker::ObjectPicker(VkDevice d, MemoryAllocator* a, uint32_t slotCount)
+{
+	device = d;
+	pipelineLayout = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+
+	requested = false;
+	requestX = 0;
+	requestY = 0;
+	picksRecorded = 0;
+	picksRead = 0;
+
+	// The images are only as big as the rectangle, the viewport
+	// moves the scene so that the rectangle lands on them
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = PICK_ID_FORMAT;
+	imageInfo.extent = { PICK_RECT_SIZE, PICK_RECT_SIZE, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	idImage = new TextureGPU(device, a, imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+	idImage->SetName("Object IDs");
+
+	imageInfo.format = PICK_DEPTH_FORMAT;
+	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	depthImage = new TextureGPU(device, a, imageInfo, VK_IMAGE_ASPECT_DEPTH_BIT);
+	depthImage->SetName("Object ID depth");
+
+	// The IDs are cleared to PICK_NO_OBJECT, and left in TRANSFER_SRC
+	// for the copy. The depth is only needed while the pass draws
+	VkAttachmentDescription attachments[2] = {};
+	attachments[0].format = PICK_ID_FORMAT;
+	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	attachments[1] = attachments[0];
+	attachments[1].format = PICK_DEPTH_FORMAT;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorReference = {};
+	colorReference.attachment = 0;
+	colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthReference = {};
+	depthReference.attachment = 1;
+	depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorReference;
+	subpass.pDepthStencilAttachment = &depthReference;
+
+	// The first dependency waits for the copy of the last pick (in an
+	// earlier frame, that might still be running) before the IDs are
+	// cleared, and for the last pass to be done with the depth. The
+	// second one makes the IDs visible to the copy after the pass
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	VkRenderPassCreateInfo rpInfo = {};
+	rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	rpInfo.attachmentCount = 2;
+	rpInfo.pAttachments = attachments;
+	rpInfo.subpassCount = 1;
+	rpInfo.pSubpasses = &subpass;
+	rpInfo.dependencyCount = 2;
+	rpInfo.pDependencies = dependencies;
+
+	if (vkCreateRenderPass(device, &rpInfo, HostAllocator::callbacks, &renderPass) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the render pass of the object picker\n", "Render Pass Failure");
+	}
+
+	VkImageView views[2] = { idImage->imageView, depthImage->imageView };
+
+	VkFramebufferCreateInfo fbInfo = {};
+	fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	fbInfo.renderPass = renderPass;
+	fbInfo.attachmentCount = 2;
+	fbInfo.pAttachments = views;
+	fbInfo.width = PICK_RECT_SIZE;
+	fbInfo.height = PICK_RECT_SIZE;
+	fbInfo.layers = 1;
+	vkCreateFramebuffer(device, &fbInfo, HostAllocator::callbacks, &framebuffer);
+
+	// One small buffer for each frame in flight, always mapped.
+	// They are HOST_CACHED, if the GPU has that, like FrameCapture
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.size = PICK_RECT_SIZE * PICK_RECT_SIZE * sizeof(uint32_t);
+
+	PickSlot empty = {};
+	slots.resize(slotCount, empty);
+
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		slots[i].buffer = new BufferCPU(device, a, bufferInfo, true, false, true);
+		slots[i].buffer->SetName("Object pick readback");
+	}
+}
+
+ObjectPicker::~ObjectPicker()
+{
+	// the device is idle when the demo deletes us
+	for (size_t i = 0; i < slots.size(); i++)
+		delete slots[i].buffer;
+
+	if (pipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	if (pipelineLayout != VK_NULL_HANDLE)
+		vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+
+	vkDestroyFramebuffer(device, framebuffer, HostAllocator::callbacks);
+	vkDestroyRenderPass(device, renderPass, HostAllocator::callbacks);
+
+	delete idImage;
+	delete depthImage;
+}
+
+void ObjectPicker::PreparePipeline(VkPipelineCache cache, VkFormat positionFormat, uint32_t positionStride)
+{
+	// The matrix of each draw is pushed for the vertex shader, and
+	// the ID right after it, for the fragment shader (object_pick.frag)
+	VkPushConstantRange pushRanges[2] = {};
+	pushRanges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushRanges[0].offset = 0;
+	pushRanges[0].size = sizeof(glm::mat4);
+	pushRanges[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushRanges[1].offset = sizeof(glm::mat4);
+	pushRanges[1].size = sizeof(uint32_t);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.pushConstantRangeCount = 2;
+	layoutInfo.pPushConstantRanges = pushRanges;
+	vkCreatePipelineLayout(device, &layoutInfo, HostAllocator::callbacks, &pipelineLayout);
+
+	// the same vertex shader as the depth pre-pass with push constants,
+	// so the objects are exactly where the main pass draws them
+	const unsigned char vs_code[] = {
+		#include "cube_depth_push.vert.inc"
+	};
+
+	const unsigned char fs_code[] = {
+		#include "object_pick.frag.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = (uint32_t*)vs_code;
+	shaderInfo.codeSize = sizeof(vs_code);
+
+	VkShaderModule vertModule;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &vertModule);
+
+	shaderInfo.pCode = (uint32_t*)fs_code;
+	shaderInfo.codeSize = sizeof(fs_code);
+
+	VkShaderModule fragModule;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &fragModule);
+
+	VkPipelineShaderStageCreateInfo stages[2] = {};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = vertModule;
+	stages[0].pName = "main";
+	stages[1] = stages[0];
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = fragModule;
+
+	// the position buffer of the mesh pool, see prepare_vb_ib
+	VkVertexInputBindingDescription binding = {};
+	binding.binding = 0;
+	binding.stride = positionStride;
+	binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	VkVertexInputAttributeDescription attribute = {};
+	attribute.location = 0;
+	attribute.binding = 0;
+	attribute.format = positionFormat;
+	attribute.offset = 0;
+
+	VkPipelineVertexInputStateCreateInfo vi = {};
+	vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vi.vertexBindingDescriptionCount = 1;
+	vi.pVertexBindingDescriptions = &binding;
+	vi.vertexAttributeDescriptionCount = 1;
+	vi.pVertexAttributeDescriptions = &attribute;
+
+	VkPipelineInputAssemblyStateCreateInfo ia = {};
+	ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	// the viewport moves with every pick, so it is dynamic,
+	// the scissor is the whole rectangle, it never changes
+	VkRect2D scissor = {};
+	scissor.extent.width = PICK_RECT_SIZE;
+	scissor.extent.height = PICK_RECT_SIZE;
+
+	VkPipelineViewportStateCreateInfo vp = {};
+	vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	vp.viewportCount = 1;
+	vp.scissorCount = 1;
+	vp.pScissors = &scissor;
+
+	VkDynamicState dynamicState = VK_DYNAMIC_STATE_VIEWPORT;
+
+	VkPipelineDynamicStateCreateInfo dynamicInfo = {};
+	dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicInfo.dynamicStateCount = 1;
+	dynamicInfo.pDynamicStates = &dynamicState;
+
+	// the same culling as the main pipeline, the back
+	// of an object is never what the mouse points at
+	VkPipelineRasterizationStateCreateInfo rs = {};
+	rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rs.polygonMode = VK_POLYGON_MODE_FILL;
+	rs.cullMode = VK_CULL_MODE_BACK_BIT;
+	rs.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo ms = {};
+	ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo ds = {};
+	ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	ds.depthTestEnable = VK_TRUE;
+	ds.depthWriteEnable = VK_TRUE;
+	ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+	// an integer attachment can not blend, the ID is just written
+	VkPipelineColorBlendAttachmentState blendAttachment = {};
+	blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+
+	VkPipelineColorBlendStateCreateInfo cb = {};
+	cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	cb.attachmentCount = 1;
+	cb.pAttachments = &blendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeInfo.stageCount = 2;
+	pipeInfo.pStages = stages;
+	pipeInfo.pVertexInputState = &vi;
+	pipeInfo.pInputAssemblyState = &ia;
+	pipeInfo.pViewportState = &vp;
+	pipeInfo.pRasterizationState = &rs;
+	pipeInfo.pMultisampleState = &ms;
+	pipeInfo.pDepthStencilState = &ds;
+	pipeInfo.pColorBlendState = &cb;
+	pipeInfo.pDynamicState = &dynamicInfo;
+	pipeInfo.layout = pipelineLayout;
+	pipeInfo.renderPass = renderPass;
+
+	if (vkCreateGraphicsPipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the object picker pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, vertModule, HostAllocator::callbacks);
+	vkDestroyShaderModule(device, fragModule, HostAllocator::callbacks);
+}
+
+void ObjectPicker::Request(uint32_t x, uint32_t y)
+{
+	requested = true;
+	requestX = x;
+	requestY = y;
+}
+
+void ObjectPicker::Record(VkCommandBuffer cmd, uint32_t slot, uint64_t frame, uint32_t renderWidth, uint32_t renderHeight,
+	VkBuffer positionBuffer, VkBuffer indexBuffer, VkIndexType indexType, const std::vector<PickDraw>& draws)
+{
+	if (!requested)
+		return;
+
+	requested = false;
+
+	PickSlot& s = slots[slot];
+	s.x = requestX;
+	s.y = requestY;
+	s.frame = frame;
+	s.recorded = true;
+	picksRecorded++;
+
+	VkClearValue clears[2] = {};
+	clears[0].color.uint32[0] = PICK_NO_OBJECT;
+	clears[1].depthStencil.depth = 1.0f;
+
+	VkRenderPassBeginInfo rpBegin = {};
+	rpBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	rpBegin.renderPass = renderPass;
+	rpBegin.framebuffer = framebuffer;
+	rpBegin.renderArea.extent.width = PICK_RECT_SIZE;
+	rpBegin.renderArea.extent.height = PICK_RECT_SIZE;
+	rpBegin.clearValueCount = 2;
+	rpBegin.pClearValues = clears;
+
+	DeviceTable::CmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	// The viewport is the whole rendered image, moved up and to the
+	// left, so that the pixel that was clicked is the middle of the
+	// rectangle. Everything outside of the rectangle is not drawn
+	int32_t half = PICK_RECT_SIZE / 2;
+
+	VkViewport viewport = {};
+	viewport.x = (float)(half - (int32_t)requestX);
+	viewport.y = (float)(half - (int32_t)requestY);
+	viewport.width = (float)renderWidth;
+	viewport.height = (float)renderHeight;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	DeviceTable::CmdSetViewport(cmd, 0, 1, &viewport);
+
+	VkDeviceSize offset = 0;
+	DeviceTable::CmdBindVertexBuffers(cmd, 0, 1, &positionBuffer, &offset);
+	DeviceTable::CmdBindIndexBuffer(cmd, indexBuffer, 0, indexType);
+
+	for (const PickDraw& draw : draws)
+	{
+		DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &draw.mvp);
+		DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4), sizeof(uint32_t), &draw.object);
+		DeviceTable::CmdDrawIndexed(cmd, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+	}
+
+	DeviceTable::CmdEndRenderPass(cmd);
+
+	// the render pass left the IDs in TRANSFER_SRC, the rows
+	// are packed right after each other, like FrameCapture
+	VkBufferImageCopy region = {};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { PICK_RECT_SIZE, PICK_RECT_SIZE, 1 };
+
+	DeviceTable::CmdCopyImageToBuffer(cmd, idImage->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, s.buffer->buffer, 1, &region);
+
+	// Waiting for a fence does not make the GPU's writes visible to
+	// the CPU by itself, this barrier to the HOST stage does that
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+bool ObjectPicker::Read(uint32_t slot, uint32_t* object, uint32_t* x, uint32_t* y, uint64_t* frame)
+{
+	PickSlot& s = slots[slot];
+
+	if (!s.recorded)
+		return false;
+
+	s.recorded = false;
+	picksRead++;
+
+	s.buffer->Invalidate(0, PICK_RECT_SIZE * PICK_RECT_SIZE * sizeof(uint32_t));
+	const uint32_t* ids = (const uint32_t*)s.buffer->GetPointer();
+
+	// the pixel that was clicked, or else the
+	// closest pixel of the rectangle that has an object
+	int32_t half = PICK_RECT_SIZE / 2;
+	int32_t closest = INT32_MAX;
+	uint32_t found = PICK_NO_OBJECT;
+
+	for (int32_t py = 0; py < PICK_RECT_SIZE; py++)
+	{
+		for (int32_t px = 0; px < PICK_RECT_SIZE; px++)
+		{
+			uint32_t id = ids[py * PICK_RECT_SIZE + px];
+			int32_t distance = (px - half) * (px - half) + (py - half) * (py - half);
+
+			if (id != PICK_NO_OBJECT && distance < closest)
+			{
+				closest = distance;
+				found = id;
+			}
+		}
+	}
+
+	*object = found;
+	*x = s.x;
+	*y = s.y;
+	*frame = s.frame;
+	return true;
+}
@@ -0,0 +1,127 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "BufferCPU.h"
+#include "TextureGPU.h"
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+// the width and height of the rectangle that one pick draws,
+// around the pixel that was clicked, this must be odd
+#define PICK_RECT_SIZE 5
+
+// the object ID of a pixel where nothing was drawn
+#define PICK_NO_OBJECT 0
+
+// One draw into the object ID image. object is the ID that the
+// pixels of this draw get, the rest is the same as a ShadowCaster
+struct PickDraw
+{
+	glm::mat4 mvp;
+	uint32_t object;
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+};
+
+// the pick of one frame slot, after the GPU copied it
+struct PickSlot
+{
+	BufferCPU* buffer;
+
+	// the pixel that was clicked, and the frame that drew it
+	uint32_t x;
+	uint32_t y;
+	uint64_t frame;
+
+	// true if a pick was recorded, and it has not been read yet
+	bool recorded;
+};
+
+// Finds the object under the mouse on the GPU. The objects are drawn
+// again into a tiny R32_UINT image, only in the rectangle around the
+// pixel that was clicked, with the ID of each object instead of a color,
+// and the rectangle is copied into the buffer of the frame slot. Like
+// FrameCapture, the buffer is read when the slot is used again, frame_lag
+// frames later, after its fence was already waited on, so a pick never
+// waits for the GPU, it only arrives a few frames after the click
+class ObjectPicker
+{
+private:
+	VkDevice device;
+
+	// the IDs and the depth of the rectangle
+	TextureGPU* idImage;
+	TextureGPU* depthImage;
+
+	VkRenderPass renderPass;
+	VkFramebuffer framebuffer;
+
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	std::vector<PickSlot> slots;
+
+	// the click that the next Record draws
+	bool requested;
+	uint32_t requestX;
+	uint32_t requestY;
+
+public:
+	// how many picks were recorded, and how many were read
+	uint32_t picksRecorded;
+	uint32_t picksRead;
+
+	ObjectPicker(VkDevice d, MemoryAllocator* a, uint32_t slotCount);
+	~ObjectPicker();
+
+	// The vertex shader is cube_depth_push.vert, which reads
+	// the positions of the mesh pool, in this format and stride
+	void PreparePipeline(VkPipelineCache cache, VkFormat positionFormat, uint32_t positionStride);
+
+	// x and y are a pixel of the rendered image,
+	// a newer click replaces one that was not drawn yet
+	void Request(uint32_t x, uint32_t y);
+	bool HasRequest() { return requested; }
+
+	// Draws the pick that was requested, in an image that is as big as
+	// renderWidth and renderHeight, and copies it into the buffer of the
+	// slot. The barriers are recorded here, like in ShadowCache, the frame
+	// graph only has to know that the positions are read
+	void Record(VkCommandBuffer cmd, uint32_t slot, uint64_t frame, uint32_t renderWidth, uint32_t renderHeight,
+		VkBuffer positionBuffer, VkBuffer indexBuffer, VkIndexType indexType, const std::vector<PickDraw>& draws);
+
+	// The object under the pick of the slot, after the fence of the frame
+	// that recorded it, or false if nothing was recorded. When the clicked
+	// pixel has no object, the closest object in the rectangle is taken,
+	// so a click that barely misses a thin edge still finds it. Each
+	// pick is only given out once
+	bool Read(uint32_t slot, uint32_t* object, uint32_t* x, uint32_t* y, uint64_t* frame);
+};
@@ -0,0 +1,83 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "OcclusionQueries.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+
+OcclusionQueries::OcclusionQueries(VkDevice d, MemoryAllocator* a, uint32_t objects)
+{
+	device = d;
+	objectCount = objects;
+	cleared = false;
+
+	VkQueryPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+	poolInfo.queryCount = objectCount;
+	vkCreateQueryPool(device, &poolInfo, HostAllocator::callbacks, &queryPool);
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.usage = VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.size = (VkDeviceSize)objectCount * sizeof(uint32_t);
+
+	predicates = BufferGPU(device, a, bufferInfo);
+	predicates.SetName("Occlusion predicates");
+}
+
+OcclusionQueries::~OcclusionQueries()
+{
+	vkDestroyQueryPool(device, queryPool, HostAllocator::callbacks);
+}
+
+void OcclusionQueries::Reset(VkCommandBuffer cmd)
+{
+	DeviceTable::CmdResetQueryPool(cmd, queryPool, 0, objectCount);
+
+	if (!cleared)
+		DeviceTable::CmdFillBuffer(cmd, predicates.buffer, 0, VK_WHOLE_SIZE, 1);
+
+	cleared = true;
+}
+
+void OcclusionQueries::Begin(VkCommandBuffer cmd, uint32_t object)
+{
+	// not PRECISE, conditional rendering only
+	// needs to know if the count is 0 or not
+	DeviceTable::CmdBeginQuery(cmd, queryPool, object, 0);
+}
+
+void OcclusionQueries::End(VkCommandBuffer cmd, uint32_t object)
+{
+	DeviceTable::CmdEndQuery(cmd, queryPool, object);
+}
+
+void OcclusionQueries::CopyResults(VkCommandBuffer cmd)
+{
+	// 32-bit results, one after the other, like the predicates
+	DeviceTable::CmdCopyQueryPoolResults(cmd, queryPool, 0, objectCount,
+		predicates.buffer, 0, sizeof(uint32_t), VK_QUERY_RESULT_WAIT_BIT);
+}
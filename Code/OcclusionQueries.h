@@ -0,0 +1,75 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "MemoryAllocator.h"
+#include "BufferGPU.h"
+
+// One occlusion query for every object, on its bounding box, and the
+// buffer that the results are copied into, which vkCmdBeginConditionalRenderingEXT
+// reads. An object is skipped by the GPU when no pixel of its box passed
+// the depth test in the last frame, without the CPU ever reading the
+// queries, so nothing waits for the GPU. The results are one frame old,
+// an object that comes out from behind another one is drawn one frame late
+class OcclusionQueries
+{
+private:
+	VkDevice device;
+	uint32_t objectCount;
+
+	// false until the first frame has filled the predicates
+	bool cleared;
+
+public:
+	VkQueryPool queryPool;
+
+	// one uint32_t for every object, 0 if its box was hidden.
+	// It is CONDITIONAL_RENDERING, and TRANSFER_DST for the copy
+	BufferGPU predicates;
+
+	OcclusionQueries(VkDevice d, MemoryAllocator* a, uint32_t objects);
+	~OcclusionQueries();
+
+	// Resets the queries before the render pass, it can not be done
+	// inside of one. The first time, every predicate is set to 1,
+	// nothing has been tested yet, so everything is drawn. NeedsClear
+	// says if the next Reset writes the predicates, for the frame graph
+	void Reset(VkCommandBuffer cmd);
+	bool NeedsClear() { return !cleared; }
+
+	// around the draw of the box of one object
+	void Begin(VkCommandBuffer cmd, uint32_t object);
+	void End(VkCommandBuffer cmd, uint32_t object);
+
+	// Copies the results after the render pass, they are 0 or
+	// not 0, which is all that conditional rendering looks at.
+	// The copy waits for the results on the GPU, not on the CPU
+	void CopyResults(VkCommandBuffer cmd);
+
+	// where the predicate of an object is in predicates
+	VkDeviceSize GetOffset(uint32_t object) { return (VkDeviceSize)object * sizeof(uint32_t); }
+};
@@ -0,0 +1,290 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "OutputWindow.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include "SurfaceFormat.h"
+#include <stdio.h>
+
+// For a wall of monitors, each screen gets its own window. One program
+// with one VkDevice draws all of them, so the meshes, the textures, and
+// the pipelines are only loaded once, and the scene is only drawn once.
+// Drawing a different camera in each window would need a render pass
+// per window, here each window shows the scaled image of the demo
+
+OutputWindow::OutputWindow(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice d, const char* className, const char* title, int x, int y, uint32_t w, uint32_t h, uint32_t frameLag, VkPresentModeKHR mode, VkFormat preferredFormat)
+{
+	inst = instance;
+	gpu = physicalDevice;
+	device = d;
+	presentMode = mode;
+	swapchain = VK_NULL_HANDLE;
+	format = VK_FORMAT_UNDEFINED;
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	width = w;
+	height = h;
+	currentImage = UINT32_MAX;
+	outOfDate = true;
+
+	// The size of these windows can not be changed by dragging
+	// their edges, so there are no WM_SIZE messages to handle
+	// while the window is being dragged (see WndProc)
+	DWORD style = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX | WS_VISIBLE;
+
+	RECT wr = { 0, 0, (LONG)w, (LONG)h };
+	AdjustWindowRect(&wr, style, FALSE);
+
+	window = CreateWindowEx(0, className, title, style,
+		x, y, wr.right - wr.left, wr.bottom - wr.top,
+		NULL, NULL, (HINSTANCE)0, NULL);
+
+	VkWin32SurfaceCreateInfoKHR createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+	createInfo.hwnd = window;
+
+	vkCreateWin32SurfaceKHR(inst, &createInfo, HostAllocator::callbacks, &surface);
+
+	// The image is blitted into the swapchain, so the swapchain can
+	// have any format that the surface likes, the blit converts it.
+	// The format of the main window (the image) is taken when it is
+	// as cheap as the surface's cheapest, then the blit only copies
+	uint32_t formatCount = 0;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &formatCount, NULL);
+
+	std::vector<VkSurfaceFormatKHR> formats(formatCount);
+	vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &formatCount, formats.data());
+
+	if (formatCount > 0)
+	{
+		VkSurfaceFormatKHR selected = SelectSurfaceFormat(formats.data(), formatCount, false, preferredFormat, VK_FORMAT_B8G8R8A8_UNORM);
+		format = selected.format;
+		colorSpace = selected.colorSpace;
+	}
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	acquired.resize(frameLag);
+
+	for (uint32_t i = 0; i < frameLag; i++)
+		vkCreateSemaphore(device, &semaphoreInfo, HostAllocator::callbacks, &acquired[i]);
+}
+
+OutputWindow::~OutputWindow()
+{
+	// the device is idle when the demo deletes us
+	for (size_t i = 0; i < acquired.size(); i++)
+		vkDestroySemaphore(device, acquired[i], HostAllocator::callbacks);
+
+	if (swapchain != VK_NULL_HANDLE)
+		vkDestroySwapchainKHR(device, swapchain, HostAllocator::callbacks);
+
+	vkDestroySurfaceKHR(inst, surface, HostAllocator::callbacks);
+	DestroyWindow(window);
+}
+
+bool OutputWindow::IsSupported(uint32_t queueFamily)
+{
+	VkBool32 supported = VK_FALSE;
+	vkGetPhysicalDeviceSurfaceSupportKHR(gpu, queueFamily, surface, &supported);
+
+	if (!supported || format == VK_FORMAT_UNDEFINED)
+		return false;
+
+	// the swapchain images are written by a blit
+	VkSurfaceCapabilitiesKHR caps;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, surface, &caps);
+
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(gpu, format, &props);
+
+	return (caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+		(props.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+}
+
+void OutputWindow::CreateSwapchain()
+{
+	// This only happens when the window is first shown, or after it
+	// was minimized, which is rare enough that we wait for the GPU,
+	// instead of keeping the old swapchain until its frames are done
+	// (like Demo::prepare_buffers does for the main window)
+	vkDeviceWaitIdle(device);
+
+	VkSurfaceCapabilitiesKHR caps;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, surface, &caps);
+
+	// a minimized window has no size, and no swapchain
+	if (caps.currentExtent.width == 0 || caps.currentExtent.height == 0)
+		return;
+
+	if (caps.currentExtent.width != UINT32_MAX)
+	{
+		width = caps.currentExtent.width;
+		height = caps.currentExtent.height;
+	}
+
+	uint32_t imageCount = caps.minImageCount + 1;
+
+	if (caps.maxImageCount > 0 && imageCount > caps.maxImageCount)
+		imageCount = caps.maxImageCount;
+
+	// FIFO is the only mode that every surface has
+	uint32_t modeCount = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &modeCount, NULL);
+
+	std::vector<VkPresentModeKHR> modes(modeCount);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &modeCount, modes.data());
+
+	VkPresentModeKHR mode = VK_PRESENT_MODE_FIFO_KHR;
+
+	for (uint32_t i = 0; i < modeCount; i++)
+	{
+		if (modes[i] == presentMode)
+			mode = presentMode;
+	}
+
+	VkSwapchainKHR oldSwapchain = swapchain;
+
+	VkSwapchainCreateInfoKHR swapchain_ci = {};
+	swapchain_ci.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	swapchain_ci.surface = surface;
+	swapchain_ci.minImageCount = imageCount;
+	swapchain_ci.imageFormat = format;
+	swapchain_ci.imageColorSpace = colorSpace;
+	swapchain_ci.imageExtent.width = width;
+	swapchain_ci.imageExtent.height = height;
+	swapchain_ci.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	swapchain_ci.preTransform = caps.currentTransform;
+	swapchain_ci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	swapchain_ci.imageArrayLayers = 1;
+	swapchain_ci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	swapchain_ci.presentMode = mode;
+	swapchain_ci.oldSwapchain = oldSwapchain;
+	swapchain_ci.clipped = true;
+
+	if (!(caps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR))
+		swapchain_ci.compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+
+	vkCreateSwapchainKHR(device, &swapchain_ci, HostAllocator::callbacks, &swapchain);
+
+	if (oldSwapchain != VK_NULL_HANDLE)
+		vkDestroySwapchainKHR(device, oldSwapchain, HostAllocator::callbacks);
+
+	uint32_t count = 0;
+	vkGetSwapchainImagesKHR(device, swapchain, &count, NULL);
+
+	images.resize(count);
+	vkGetSwapchainImagesKHR(device, swapchain, &count, images.data());
+
+	outOfDate = false;
+}
+
+bool OutputWindow::Acquire(uint32_t slot)
+{
+	currentImage = UINT32_MAX;
+
+	if (outOfDate)
+		CreateSwapchain();
+
+	if (outOfDate)
+		return false;
+
+	VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
+		acquired[slot], VK_NULL_HANDLE, &currentImage);
+
+	// the semaphore is not signaled when this fails, so nothing
+	// waits for it, and the swapchain is made again next frame
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+	{
+		currentImage = UINT32_MAX;
+		outOfDate = true;
+		return false;
+	}
+
+	return true;
+}
+
+VkSemaphore OutputWindow::GetSemaphore(uint32_t slot)
+{
+	return acquired[slot];
+}
+
+void OutputWindow::RecordBlit(VkCommandBuffer cmd, VkImage src, uint32_t srcWidth, uint32_t srcHeight)
+{
+	// The old contents do not matter, so the image starts UNDEFINED.
+	// The frame waits for the acquire semaphore at the TRANSFER
+	// stage, so the barrier starts there, to come after the wait
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = images[currentImage];
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, NULL, 0, NULL, 1, &barrier);
+
+	VkImageBlit blit = {};
+	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.srcSubresource.layerCount = 1;
+	blit.srcOffsets[1].x = (int32_t)srcWidth;
+	blit.srcOffsets[1].y = (int32_t)srcHeight;
+	blit.srcOffsets[1].z = 1;
+	blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.dstSubresource.layerCount = 1;
+	blit.dstOffsets[1].x = (int32_t)width;
+	blit.dstOffsets[1].y = (int32_t)height;
+	blit.dstOffsets[1].z = 1;
+
+	DeviceTable::CmdBlitImage(cmd,
+		src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		images[currentImage], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &blit, VK_FILTER_LINEAR);
+
+	// the present waits for the draw_complete semaphore,
+	// which makes the blit visible to it
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+void OutputWindow::SetPresentResult(VkResult result)
+{
+	// a minimized window, or a window that moved to a monitor
+	// with another format, needs a new swapchain
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+		outOfDate = true;
+}
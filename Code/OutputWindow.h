@@ -0,0 +1,102 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+
+// Another window that shows what the demo draws, with its own surface
+// and swapchain, on the same VkDevice. The demo draws the scene once,
+// into the offscreen image, and every OutputWindow gets a scaled copy
+// of it, just like the main swapchain does (see Demo::record_upscale).
+// All of the swapchains are presented with one vkQueuePresentKHR
+class OutputWindow
+{
+private:
+	VkInstance inst;
+	VkPhysicalDevice gpu;
+	VkDevice device;
+	VkSurfaceKHR surface;
+	VkPresentModeKHR presentMode;
+
+	std::vector<VkImage> images;
+
+	// one semaphore for each frame in flight, like
+	// the demo's image_acquired_semaphores
+	std::vector<VkSemaphore> acquired;
+
+	// true if the swapchain has to be made again
+	// before the next image is acquired
+	bool outOfDate;
+
+	void CreateSwapchain();
+
+public:
+	HWND window;
+	VkSwapchainKHR swapchain;
+	VkFormat format;
+	VkColorSpaceKHR colorSpace;
+	uint32_t width;
+	uint32_t height;
+
+	// the image that was acquired for this frame,
+	// UINT32_MAX if this frame shows nothing in this window
+	uint32_t currentImage;
+
+	// the window uses the class that the demo registered,
+	// so its messages go to the same WndProc
+	OutputWindow(
+		VkInstance instance,
+		VkPhysicalDevice physicalDevice,
+		VkDevice d,
+		const char* className,
+		const char* title,
+		int x,
+		int y,
+		uint32_t w,
+		uint32_t h,
+		uint32_t frameLag,
+		VkPresentModeKHR mode,
+		VkFormat preferredFormat);
+
+	~OutputWindow();
+
+	// true if the present queue family can show images in this window
+	bool IsSupported(uint32_t queueFamily);
+
+	// Gets the image for this frame into currentImage, the frame's
+	// submission has to wait for GetSemaphore at the TRANSFER stage.
+	// Returns false if the window can not show anything right now
+	bool Acquire(uint32_t slot);
+	VkSemaphore GetSemaphore(uint32_t slot);
+
+	// scales the src image (in TRANSFER_SRC layout) into
+	// currentImage, and makes it ready to present
+	void RecordBlit(VkCommandBuffer cmd, VkImage src, uint32_t srcWidth, uint32_t srcHeight);
+
+	// what vkQueuePresentKHR said about this swapchain
+	void SetPresentResult(VkResult result);
+};
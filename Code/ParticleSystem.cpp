@@ -0,0 +1,329 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "ParticleSystem.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <stddef.h>
+#include <string.h>
+
+// Each half of the particle buffer starts at a multiple of this, which
+// is the largest minStorageBufferOffsetAlignment allowed
+#define PARTICLE_HALF_ALIGNMENT 256
+
+ParticleSystem::ParticleSystem(VkDevice d, MemoryAllocator* a, uint32_t count, VkPipelineCache cache)
+{
+	device = d;
+	capacity = count;
+	sourceHalf = 0;
+	cleared = false;
+	seed = 0;
+
+	// a fountain, the particles go up, and fall
+	// back down, for two seconds each
+	origin = glm::vec3(0.0f, 0.0f, 0.0f);
+	gravity = glm::vec3(0.0f, -4.0f, 0.0f);
+	speed = 2.0f;
+	life = 2.0f;
+	size = 0.02f;
+
+	// Only the GPU ever touches these buffers, so they are all in
+	// device-local memory. The shaders read and write them (STORAGE),
+	// the counters are also the arguments of the indirect dispatch and
+	// the indirect draw (INDIRECT), and they are cleared with
+	// vkCmdUpdateBuffer (TRANSFER_DST). The instances are also
+	// the vertex buffer of the instanced pipeline (VERTEX)
+	VkDeviceSize halfSize = (VkDeviceSize)capacity * sizeof(Particle);
+	halfSize = (halfSize + PARTICLE_HALF_ALIGNMENT - 1) & ~(VkDeviceSize)(PARTICLE_HALF_ALIGNMENT - 1);
+
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	info.size = halfSize * 2;
+
+	particleBuffer = new BufferGPU(device, a, info);
+	particleBuffer->SetName("Particles");
+
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.size = sizeof(ParticleCounters) * 2;
+	counterBuffer = new BufferGPU(device, a, info);
+	counterBuffer->SetName("Particle counters");
+
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	info.size = (VkDeviceSize)capacity * sizeof(glm::mat4);
+	instanceBuffer = new BufferGPU(device, a, info);
+	instanceBuffer->SetName("Particle instances");
+
+	// The shaders have four storage buffers, the source half, the
+	// destination half, the counters, and the instances. The emit
+	// shader only uses the source half and the counters
+	VkDescriptorSetLayoutBinding bindings[4];
+	memset(bindings, 0, sizeof(bindings));
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = bindings;
+	vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &descLayout);
+
+	// two sets, with four storage buffers each
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = 8;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 2;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &descPool);
+
+	VkDescriptorSetLayout setLayouts[2] = { descLayout, descLayout };
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descPool;
+	allocInfo.descriptorSetCount = 2;
+	allocInfo.pSetLayouts = setLayouts;
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, descSets);
+
+	// Set 0 reads half 0 and writes half 1, set 1 is the other way.
+	// The counters of both halves are in both sets, the shaders
+	// pick the ones that they need with sourceHalf
+	VkDescriptorBufferInfo bufferInfo[2][4] = {};
+	VkWriteDescriptorSet writes[8];
+	memset(writes, 0, sizeof(writes));
+
+	for (uint32_t s = 0; s < 2; s++)
+	{
+		bufferInfo[s][0].buffer = particleBuffer->buffer;
+		bufferInfo[s][0].offset = s * halfSize;
+		bufferInfo[s][0].range = halfSize;
+		bufferInfo[s][1].buffer = particleBuffer->buffer;
+		bufferInfo[s][1].offset = (1 - s) * halfSize;
+		bufferInfo[s][1].range = halfSize;
+		bufferInfo[s][2].buffer = counterBuffer->buffer;
+		bufferInfo[s][2].range = VK_WHOLE_SIZE;
+		bufferInfo[s][3].buffer = instanceBuffer->buffer;
+		bufferInfo[s][3].range = VK_WHOLE_SIZE;
+
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			VkWriteDescriptorSet& write = writes[s * 4 + i];
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = descSets[s];
+			write.dstBinding = i;
+			write.descriptorCount = 1;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			write.pBufferInfo = &bufferInfo[s][i];
+		}
+	}
+
+	DeviceTable::UpdateDescriptorSets(device, 8, writes, 0, NULL);
+
+	// Both shaders use the same layout, the push constants
+	// are as big as the bigger one of the two
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(ParticleEmitConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &pipelineLayoutInfo, HostAllocator::callbacks, &pipelineLayout);
+
+	// Compute Shaders compiled to header, see compileShaders.cmd
+	const unsigned char emit_code[] = {
+		#include "particle_emit.comp.inc"
+	};
+
+	const unsigned char simulate_code[] = {
+		#include "particle_simulate.comp.inc"
+	};
+
+	emitPipeline = CreatePipeline(cache, emit_code, sizeof(emit_code));
+	simulatePipeline = CreatePipeline(cache, simulate_code, sizeof(simulate_code));
+}
+
+VkPipeline ParticleSystem::CreatePipeline(VkPipelineCache cache, const unsigned char* code, size_t codeSize)
+{
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = (const uint32_t*)code;
+	shaderInfo.codeSize = codeSize;
+
+	VkShaderModule module;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &module);
+
+	VkComputePipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeInfo.stage.module = module;
+	pipeInfo.stage.pName = "main";
+	pipeInfo.layout = pipelineLayout;
+
+	VkPipeline pipeline;
+
+	if (vkCreateComputePipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the particle pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, module, HostAllocator::callbacks);
+	return pipeline;
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	vkDestroyPipeline(device, emitPipeline, HostAllocator::callbacks);
+	vkDestroyPipeline(device, simulatePipeline, HostAllocator::callbacks);
+	vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+
+	// destroying the pool also frees the sets
+	vkDestroyDescriptorPool(device, descPool, HostAllocator::callbacks);
+	vkDestroyDescriptorSetLayout(device, descLayout, HostAllocator::callbacks);
+
+	delete particleBuffer;
+	delete counterBuffer;
+	delete instanceBuffer;
+}
+
+void ParticleSystem::Update(VkCommandBuffer cmd, float dt, uint32_t emitCount, uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset)
+{
+	uint32_t destHalf = 1 - sourceHalf;
+
+	// The simulation of the last frame wrote the half that is the source
+	// now, and read the half that is written now, and the counters of
+	// both. The frame graph only knows about the counters and the
+	// instances, and how the render pass used them, so this waits
+	// for the shaders of the last frame by itself
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+
+	// The destination half starts with no particles, and with no
+	// workgroups, the shaders add to both. The draw command of each
+	// half is written here too, only instanceCount comes from the GPU.
+	// The first time, the source half is cleared too
+	ParticleCounters counters[2] = {};
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		counters[i].dispatch = { 0, 1, 1 };
+		counters[i].draw.indexCount = indexCount;
+		counters[i].draw.firstIndex = firstIndex;
+		counters[i].draw.vertexOffset = vertexOffset;
+	}
+
+	if (!cleared)
+	{
+		DeviceTable::CmdUpdateBuffer(cmd, counterBuffer->buffer, 0, sizeof(counters), counters);
+		cleared = true;
+	}
+	else
+		DeviceTable::CmdUpdateBuffer(cmd, counterBuffer->buffer, destHalf * sizeof(ParticleCounters), sizeof(ParticleCounters), &counters[destHalf]);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+
+	DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descSets[sourceHalf], 0, NULL);
+
+	// the new particles go at the end of the source half,
+	// one invocation for each of them
+	if (emitCount > 0)
+	{
+		ParticleEmitConstants emit = {};
+		emit.origin = glm::vec4(origin, speed);
+		emit.params = glm::vec4(life, size, 0.0f, 0.0f);
+		emit.emitCount = emitCount;
+		emit.capacity = capacity;
+		emit.sourceHalf = sourceHalf;
+		emit.seed = seed;
+		seed += emitCount;
+
+		DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, emitPipeline);
+		DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(emit), &emit);
+		DeviceTable::CmdDispatch(cmd, (emitCount + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+
+		// the simulation reads the particles, and the number of
+		// workgroups is read from the counters, before it starts
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		DeviceTable::CmdPipelineBarrier(cmd,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, NULL, 0, NULL);
+	}
+
+	// The simulation has as many workgroups as the source half needs,
+	// which the last simulation and the emit shader wrote. With no
+	// particles, the dispatch has zero workgroups, and does nothing
+	ParticleSimulateConstants simulate = {};
+	simulate.gravity = glm::vec4(gravity, dt);
+	simulate.capacity = capacity;
+	simulate.sourceHalf = sourceHalf;
+
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, simulatePipeline);
+	DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(simulate), &simulate);
+	DeviceTable::CmdDispatchIndirect(cmd, counterBuffer->buffer, sourceHalf * sizeof(ParticleCounters));
+
+	// the particles that are alive are in the other half now,
+	// the frame graph waits for the shader before the draw
+	sourceHalf = destHalf;
+}
+
+void ParticleSystem::Draw(VkCommandBuffer cmd)
+{
+	// One draw, with one instance for every particle, the
+	// simulation counted them in the draw command of this half
+	VkDeviceSize offset = sourceHalf * sizeof(ParticleCounters) + offsetof(ParticleCounters, draw);
+	DeviceTable::CmdDrawIndexedIndirect(cmd, counterBuffer->buffer, offset, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,147 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "BufferGPU.h"
+#include "MemoryAllocator.h"
+
+#include <glm/glm.hpp>
+
+// the number of particles that each workgroup of the
+// particle shaders works on (local_size_x)
+#define PARTICLE_WORKGROUP_SIZE 64
+
+// One particle, in the particle buffer,
+// it must match Particle in particle_simulate.comp
+struct Particle
+{
+	// w is the life that is left, in seconds
+	glm::vec4 position;
+
+	// w is the size of the particle
+	glm::vec4 velocity;
+};
+
+// The counters of one half of the particle buffer. The simulation of
+// the particles in this half is dispatched with the first part, and
+// the particles themselves are drawn with the second part, both of
+// them are written by the GPU. It must match Counters in the shaders
+struct ParticleCounters
+{
+	VkDispatchIndirectCommand dispatch;
+	VkDrawIndexedIndirectCommand draw;
+};
+
+// these are given to the shaders with push constants,
+// they must match EmitVals and SimulateVals
+struct ParticleEmitConstants
+{
+	// w is the speed of the new particles
+	glm::vec4 origin;
+
+	// x is the life of a new particle, y is its size
+	glm::vec4 params;
+	uint32_t emitCount;
+	uint32_t capacity;
+	uint32_t sourceHalf;
+	uint32_t seed;
+};
+
+struct ParticleSimulateConstants
+{
+	// w is the time of the step, in seconds
+	glm::vec4 gravity;
+	uint32_t capacity;
+	uint32_t sourceHalf;
+};
+
+// Particles that live on the GPU only. The particle buffer has two
+// halves, every frame the new particles are added to the end of one half
+// (particle_emit.comp), and then every particle of that half moves, and
+// the ones that are still alive are copied into the other half, without
+// gaps (particle_simulate.comp). The simulation also writes the model
+// matrix of every particle into the instance buffer, and counts them in
+// the draw command, so the particles are drawn with the same instanced
+// pipeline as the cubes, with one indirect draw. The CPU never knows how
+// many particles are alive, the GPU even picks the number of workgroups
+// of the simulation (vkCmdDispatchIndirect), so the cost on the CPU is
+// the same for a million particles as it is for ten
+class ParticleSystem
+{
+private:
+	VkDevice device;
+	uint32_t capacity;
+
+	// which half has the particles that were
+	// alive at the end of the last frame
+	uint32_t sourceHalf;
+
+	// the counters are cleared the first time
+	bool cleared;
+	uint32_t seed;
+
+	VkDescriptorSetLayout descLayout;
+	VkDescriptorPool descPool;
+
+	// one set for each direction, from half 0 to half 1, and back
+	VkDescriptorSet descSets[2];
+	VkPipelineLayout pipelineLayout;
+	VkPipeline emitPipeline;
+	VkPipeline simulatePipeline;
+
+	VkPipeline CreatePipeline(VkPipelineCache cache, const unsigned char* code, size_t size);
+
+public:
+	// both halves, one after the other, and the counters of both halves
+	BufferGPU* particleBuffer;
+	BufferGPU* counterBuffer;
+
+	// the model matrix of every particle that is alive,
+	// bound as the instance buffer when the particles are drawn
+	BufferGPU* instanceBuffer;
+
+	// where the particles are born, and how they move
+	glm::vec3 origin;
+	glm::vec3 gravity;
+	float speed;
+	float life;
+	float size;
+
+	ParticleSystem(VkDevice d, MemoryAllocator* a, uint32_t count, VkPipelineCache cache);
+	~ParticleSystem();
+
+	// Adds emitCount particles, and moves every particle by dt seconds.
+	// The draw uses the indices of the mesh that every particle is.
+	// This must be recorded outside of a render pass. The barriers
+	// between the steps are recorded here, the frame graph waits for
+	// the counters (DRAW_INDIRECT) and the instances (VERTEX_INPUT)
+	void Update(VkCommandBuffer cmd, float dt, uint32_t emitCount, uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset);
+
+	// This is recorded inside the render pass, after the instanced
+	// pipeline, the vertex buffer, and the index buffer are bound
+	void Draw(VkCommandBuffer cmd);
+};
@@ -0,0 +1,316 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "PerformanceCounters.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+// The driver lists every counter that a queue family has, with a name
+// and a description. A query pool is made for the counters that we want,
+// and the GPU might need more than one pass (submitting the same work
+// more than once) to count all of them. We only ever submit a frame
+// once, so counters are dropped from the end of the list until one
+// pass is enough. Counters with COMMAND_BUFFER scope would have to
+// begin with the command buffer, so only counters that can be read
+// around the render pass are used
+
+// true if the name of a counter is the same as the
+// name between start and end, without looking at the case
+static bool NameMatches(const char* counterName, const char* start, const char* end)
+{
+	size_t length = end - start;
+
+	if (strlen(counterName) != length)
+		return false;
+
+	for (size_t i = 0; i < length; i++)
+		if (tolower((unsigned char)counterName[i]) != tolower((unsigned char)start[i]))
+			return false;
+
+	return true;
+}
+
+PerformanceCounters::PerformanceCounters(VkDevice d, VkPhysicalDevice gpu, uint32_t queueFamily, uint32_t slots, const char* names,
+	PFN_vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR fpEnumerateCounters,
+	PFN_vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR fpGetPasses,
+	PFN_vkAcquireProfilingLockKHR fpAcquireProfilingLockKHR,
+	PFN_vkReleaseProfilingLockKHR fpReleaseProfilingLockKHR)
+{
+	device = d;
+	pool = VK_NULL_HANDLE;
+	slotCount = slots;
+	releaseProfilingLock = fpReleaseProfilingLockKHR;
+	locked = false;
+	frames = 0;
+	supported = false;
+
+	uint32_t available = 0;
+	fpEnumerateCounters(gpu, queueFamily, &available, NULL, NULL);
+
+	std::vector<VkPerformanceCounterKHR> allCounters(available);
+	std::vector<VkPerformanceCounterDescriptionKHR> allDescriptions(available);
+
+	for (uint32_t i = 0; i < available; i++)
+	{
+		allCounters[i] = {};
+		allCounters[i].sType = VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_KHR;
+		allDescriptions[i] = {};
+		allDescriptions[i].sType = VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_DESCRIPTION_KHR;
+	}
+
+	if (available > 0)
+		fpEnumerateCounters(gpu, queueFamily, &available, allCounters.data(), allDescriptions.data());
+
+	// find each name of the list, in the order of the list
+	std::vector<uint32_t> indices;
+	const char* start = names;
+
+	while (*start != '\0')
+	{
+		const char* end = start;
+		while (*end != '\0' && *end != ',')
+			end++;
+
+		bool found = false;
+
+		for (uint32_t i = 0; i < available && end > start; i++)
+		{
+			if (!NameMatches(allDescriptions[i].name, start, end))
+				continue;
+
+			found = true;
+
+			if (allCounters[i].scope == VK_PERFORMANCE_COUNTER_SCOPE_COMMAND_BUFFER_KHR)
+				printf("Performance counter %s counts whole command buffers, it is not used\n", allDescriptions[i].name);
+			else
+				indices.push_back(i);
+
+			break;
+		}
+
+		if (!found && end > start)
+			printf("Performance counter %.*s was not found\n", (int)(end - start), start);
+
+		start = (*end == ',') ? end + 1 : end;
+	}
+
+	// Each counter needs some of the GPU's hardware to count
+	// it, and some of them can not be counted at the same time
+	VkQueryPoolPerformanceCreateInfoKHR performanceInfo = {};
+	performanceInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_PERFORMANCE_CREATE_INFO_KHR;
+	performanceInfo.queueFamilyIndex = queueFamily;
+
+	while (!indices.empty())
+	{
+		performanceInfo.counterIndexCount = (uint32_t)indices.size();
+		performanceInfo.pCounterIndices = indices.data();
+
+		uint32_t passes = 0;
+		fpGetPasses(gpu, &performanceInfo, &passes);
+
+		if (passes <= 1)
+			break;
+
+		printf("Performance counter %s needs another pass, it is not used\n", allDescriptions[indices.back()].name);
+		indices.pop_back();
+	}
+
+	if (indices.empty())
+	{
+		// so the next run can pick some of them
+		printf("No performance counters are used, this GPU has %u:\n", available);
+
+		for (uint32_t i = 0; i < available; i++)
+			printf("    %s (%s): %s\n", allDescriptions[i].name, UnitName(allCounters[i].unit), allDescriptions[i].description);
+
+		return;
+	}
+
+	// The lock says that nobody else profiles the GPU now,
+	// with no timeout, because the lock is needed to continue
+	VkAcquireProfilingLockInfoKHR lockInfo = {};
+	lockInfo.sType = VK_STRUCTURE_TYPE_ACQUIRE_PROFILING_LOCK_INFO_KHR;
+	lockInfo.timeout = UINT64_MAX;
+
+	if (fpAcquireProfilingLockKHR(device, &lockInfo) != VK_SUCCESS)
+	{
+		printf("The profiling lock was not given, performance counters are disabled\n");
+		return;
+	}
+
+	locked = true;
+
+	// two queries for every slot, see uses
+	VkQueryPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.pNext = &performanceInfo;
+	poolInfo.queryType = VK_QUERY_TYPE_PERFORMANCE_QUERY_KHR;
+	poolInfo.queryCount = slotCount * 2;
+
+	if (vkCreateQueryPool(device, &poolInfo, HostAllocator::callbacks, &pool) != VK_SUCCESS)
+	{
+		printf("The performance query pool could not be made, performance counters are disabled\n");
+		pool = VK_NULL_HANDLE;
+		return;
+	}
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		counters.push_back(allCounters[indices[i]]);
+		descriptions.push_back(allDescriptions[indices[i]]);
+	}
+
+	uses.resize(slotCount, 0);
+	written.resize(slotCount * 2, false);
+	results.resize(counters.size());
+	totals.resize(counters.size(), 0.0);
+
+	printf("Performance counters: %u counters\n", (uint32_t)counters.size());
+	supported = true;
+}
+
+PerformanceCounters::~PerformanceCounters()
+{
+	if (pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, pool, HostAllocator::callbacks);
+
+	if (locked)
+		releaseProfilingLock(device);
+}
+
+double PerformanceCounters::ToDouble(const VkPerformanceCounterResultKHR& result, VkPerformanceCounterStorageKHR storage)
+{
+	switch (storage)
+	{
+	case VK_PERFORMANCE_COUNTER_STORAGE_INT32_KHR: return result.int32;
+	case VK_PERFORMANCE_COUNTER_STORAGE_INT64_KHR: return (double)result.int64;
+	case VK_PERFORMANCE_COUNTER_STORAGE_UINT32_KHR: return result.uint32;
+	case VK_PERFORMANCE_COUNTER_STORAGE_UINT64_KHR: return (double)result.uint64;
+	case VK_PERFORMANCE_COUNTER_STORAGE_FLOAT32_KHR: return result.float32;
+	case VK_PERFORMANCE_COUNTER_STORAGE_FLOAT64_KHR: return result.float64;
+	default: return 0.0;
+	}
+}
+
+const char* PerformanceCounters::UnitName(VkPerformanceCounterUnitKHR unit)
+{
+	switch (unit)
+	{
+	case VK_PERFORMANCE_COUNTER_UNIT_GENERIC_KHR: return "count";
+	case VK_PERFORMANCE_COUNTER_UNIT_PERCENTAGE_KHR: return "%";
+	case VK_PERFORMANCE_COUNTER_UNIT_NANOSECONDS_KHR: return "ns";
+	case VK_PERFORMANCE_COUNTER_UNIT_BYTES_KHR: return "bytes";
+	case VK_PERFORMANCE_COUNTER_UNIT_BYTES_PER_SECOND_KHR: return "bytes/s";
+	case VK_PERFORMANCE_COUNTER_UNIT_KELVIN_KHR: return "K";
+	case VK_PERFORMANCE_COUNTER_UNIT_WATTS_KHR: return "W";
+	case VK_PERFORMANCE_COUNTER_UNIT_VOLTS_KHR: return "V";
+	case VK_PERFORMANCE_COUNTER_UNIT_AMPS_KHR: return "A";
+	case VK_PERFORMANCE_COUNTER_UNIT_HERTZ_KHR: return "Hz";
+	case VK_PERFORMANCE_COUNTER_UNIT_CYCLES_KHR: return "cycles";
+	default: return "";
+	}
+}
+
+void PerformanceCounters::ReadQuery(uint32_t query)
+{
+	if (!written[query])
+		return;
+
+	written[query] = false;
+
+	// one result for every counter, in the order of counters
+	uint32_t size = (uint32_t)(results.size() * sizeof(VkPerformanceCounterResultKHR));
+
+	VkResult result = DeviceTable::GetQueryPoolResults(device, pool, query, 1,
+		size, results.data(), size, 0);
+
+	if (result != VK_SUCCESS)
+		return;
+
+	for (size_t i = 0; i < counters.size(); i++)
+		totals[i] += ToDouble(results[i], counters[i].storage);
+
+	frames++;
+
+	if (frames >= PERFORMANCE_COUNTERS_HISTORY)
+	{
+		Print();
+
+		for (size_t i = 0; i < totals.size(); i++)
+			totals[i] = 0.0;
+		frames = 0;
+	}
+}
+
+void PerformanceCounters::Begin(VkCommandBuffer cmd, uint32_t slot)
+{
+	if (!supported)
+		return;
+
+	uint32_t use = uses[slot]++;
+
+	// the first frame of the slot resets both queries, the
+	// next frame can begin the one that was not used last time
+	if (use == 0)
+	{
+		DeviceTable::CmdResetQueryPool(cmd, pool, slot * 2, 2);
+		return;
+	}
+
+	uint32_t query = slot * 2 + (use & 1);
+	uint32_t other = slot * 2 + 1 - (use & 1);
+
+	// the last frame of this slot used the other query, and it is
+	// done, so it can be read now, and reset for the next frame
+	ReadQuery(other);
+
+	DeviceTable::CmdResetQueryPool(cmd, pool, other, 1);
+	DeviceTable::CmdBeginQuery(cmd, pool, query, 0);
+}
+
+void PerformanceCounters::End(VkCommandBuffer cmd, uint32_t slot)
+{
+	if (!supported || uses[slot] <= 1)
+		return;
+
+	uint32_t query = slot * 2 + ((uses[slot] - 1) & 1);
+
+	DeviceTable::CmdEndQuery(cmd, pool, query);
+	written[query] = true;
+}
+
+void PerformanceCounters::Print()
+{
+	if (frames == 0)
+		return;
+
+	printf("Performance counters per frame:\n");
+
+	for (size_t i = 0; i < counters.size(); i++)
+		printf("    %s: %.3f %s\n", descriptions[i].name, totals[i] / frames, UnitName(counters[i].unit));
+}
@@ -0,0 +1,93 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "PerformanceQuery.h"
+
+// how many frames of counters are added up,
+// before the averages are printed
+#define PERFORMANCE_COUNTERS_HISTORY 240
+
+// Reads the hardware counters of the GPU (cache hits, how busy the
+// ALUs are, memory bandwidth, whatever the driver has) in the render
+// pass of each frame, with VK_KHR_performance_query. The counters are
+// different on every GPU, so they are picked by their names, and if
+// none of the names are found, the names that the GPU has are printed
+// instead. Like PipelineStatistics, each frame slot has its own query,
+// which is read when the slot is recorded again
+class PerformanceCounters
+{
+private:
+	VkDevice device;
+	VkQueryPool pool;
+	uint32_t slotCount;
+	PFN_vkReleaseProfilingLockKHR releaseProfilingLock;
+	bool locked;
+
+	// the counters that we picked, and what they are
+	std::vector<VkPerformanceCounterKHR> counters;
+	std::vector<VkPerformanceCounterDescriptionKHR> descriptions;
+
+	// Each slot has two queries, and uses them one after the other.
+	// A performance query can not be reset in the same command buffer
+	// that begins it, so each frame resets the query that the next frame
+	// of the slot will use. The first frame of a slot only resets both
+	std::vector<uint32_t> uses;
+	std::vector<bool> written;
+
+	// the results of one query, and the sums since the last print
+	std::vector<VkPerformanceCounterResultKHR> results;
+	std::vector<double> totals;
+	uint32_t frames;
+
+	void ReadQuery(uint32_t query);
+	double ToDouble(const VkPerformanceCounterResultKHR& result, VkPerformanceCounterStorageKHR storage);
+	static const char* UnitName(VkPerformanceCounterUnitKHR unit);
+
+public:
+	// false if none of the counters were found,
+	// then every function here does nothing
+	bool supported;
+
+	// names is a list of counter names, with commas between them, the
+	// case does not matter. The profiling lock is taken here, it has
+	// to be held before any command buffer with the queries is begun
+	PerformanceCounters(VkDevice d, VkPhysicalDevice gpu, uint32_t queueFamily, uint32_t slots, const char* names,
+		PFN_vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR fpEnumerateCounters,
+		PFN_vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR fpGetPasses,
+		PFN_vkAcquireProfilingLockKHR fpAcquireProfilingLockKHR,
+		PFN_vkReleaseProfilingLockKHR fpReleaseProfilingLockKHR);
+	~PerformanceCounters();
+
+	// Begin is called before the render pass begins, and End
+	// after it ends, the counters can not begin inside of it
+	void Begin(VkCommandBuffer cmd, uint32_t slot);
+	void End(VkCommandBuffer cmd, uint32_t slot);
+
+	void Print();
+};
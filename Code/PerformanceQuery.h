@@ -0,0 +1,141 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+
+// VK_KHR_performance_query is newer than the Vulkan headers in the
+// Include folder, so we declare the parts that we use, the same way
+// as PresentWait.h. They are skipped when the headers have them
+#ifndef VK_KHR_performance_query
+#define VK_KHR_performance_query 1
+#define VK_KHR_PERFORMANCE_QUERY_SPEC_VERSION 1
+#define VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME "VK_KHR_performance_query"
+
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PERFORMANCE_QUERY_FEATURES_KHR ((VkStructureType)1000116000)
+#define VK_STRUCTURE_TYPE_QUERY_POOL_PERFORMANCE_CREATE_INFO_KHR ((VkStructureType)1000116002)
+#define VK_STRUCTURE_TYPE_ACQUIRE_PROFILING_LOCK_INFO_KHR ((VkStructureType)1000116004)
+#define VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_KHR ((VkStructureType)1000116005)
+#define VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_DESCRIPTION_KHR ((VkStructureType)1000116006)
+#define VK_QUERY_TYPE_PERFORMANCE_QUERY_KHR ((VkQueryType)1000116000)
+
+typedef enum VkPerformanceCounterUnitKHR
+{
+	VK_PERFORMANCE_COUNTER_UNIT_GENERIC_KHR = 0,
+	VK_PERFORMANCE_COUNTER_UNIT_PERCENTAGE_KHR = 1,
+	VK_PERFORMANCE_COUNTER_UNIT_NANOSECONDS_KHR = 2,
+	VK_PERFORMANCE_COUNTER_UNIT_BYTES_KHR = 3,
+	VK_PERFORMANCE_COUNTER_UNIT_BYTES_PER_SECOND_KHR = 4,
+	VK_PERFORMANCE_COUNTER_UNIT_KELVIN_KHR = 5,
+	VK_PERFORMANCE_COUNTER_UNIT_WATTS_KHR = 6,
+	VK_PERFORMANCE_COUNTER_UNIT_VOLTS_KHR = 7,
+	VK_PERFORMANCE_COUNTER_UNIT_AMPS_KHR = 8,
+	VK_PERFORMANCE_COUNTER_UNIT_HERTZ_KHR = 9,
+	VK_PERFORMANCE_COUNTER_UNIT_CYCLES_KHR = 10,
+	VK_PERFORMANCE_COUNTER_UNIT_MAX_ENUM_KHR = 0x7FFFFFFF
+} VkPerformanceCounterUnitKHR;
+
+typedef enum VkPerformanceCounterScopeKHR
+{
+	VK_PERFORMANCE_COUNTER_SCOPE_COMMAND_BUFFER_KHR = 0,
+	VK_PERFORMANCE_COUNTER_SCOPE_RENDER_PASS_KHR = 1,
+	VK_PERFORMANCE_COUNTER_SCOPE_COMMAND_KHR = 2,
+	VK_PERFORMANCE_COUNTER_SCOPE_MAX_ENUM_KHR = 0x7FFFFFFF
+} VkPerformanceCounterScopeKHR;
+
+typedef enum VkPerformanceCounterStorageKHR
+{
+	VK_PERFORMANCE_COUNTER_STORAGE_INT32_KHR = 0,
+	VK_PERFORMANCE_COUNTER_STORAGE_INT64_KHR = 1,
+	VK_PERFORMANCE_COUNTER_STORAGE_UINT32_KHR = 2,
+	VK_PERFORMANCE_COUNTER_STORAGE_UINT64_KHR = 3,
+	VK_PERFORMANCE_COUNTER_STORAGE_FLOAT32_KHR = 4,
+	VK_PERFORMANCE_COUNTER_STORAGE_FLOAT64_KHR = 5,
+	VK_PERFORMANCE_COUNTER_STORAGE_MAX_ENUM_KHR = 0x7FFFFFFF
+} VkPerformanceCounterStorageKHR;
+
+typedef VkFlags VkPerformanceCounterDescriptionFlagsKHR;
+typedef VkFlags VkAcquireProfilingLockFlagsKHR;
+
+typedef struct VkPhysicalDevicePerformanceQueryFeaturesKHR
+{
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 performanceCounterQueryPools;
+	VkBool32 performanceCounterMultipleQueryPools;
+} VkPhysicalDevicePerformanceQueryFeaturesKHR;
+
+typedef struct VkPerformanceCounterKHR
+{
+	VkStructureType sType;
+	void* pNext;
+	VkPerformanceCounterUnitKHR unit;
+	VkPerformanceCounterScopeKHR scope;
+	VkPerformanceCounterStorageKHR storage;
+	uint8_t uuid[VK_UUID_SIZE];
+} VkPerformanceCounterKHR;
+
+typedef struct VkPerformanceCounterDescriptionKHR
+{
+	VkStructureType sType;
+	void* pNext;
+	VkPerformanceCounterDescriptionFlagsKHR flags;
+	char name[VK_MAX_DESCRIPTION_SIZE];
+	char category[VK_MAX_DESCRIPTION_SIZE];
+	char description[VK_MAX_DESCRIPTION_SIZE];
+} VkPerformanceCounterDescriptionKHR;
+
+typedef struct VkQueryPoolPerformanceCreateInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	uint32_t queueFamilyIndex;
+	uint32_t counterIndexCount;
+	const uint32_t* pCounterIndices;
+} VkQueryPoolPerformanceCreateInfoKHR;
+
+typedef union VkPerformanceCounterResultKHR
+{
+	int32_t int32;
+	int64_t int64;
+	uint32_t uint32;
+	uint64_t uint64;
+	float float32;
+	double float64;
+} VkPerformanceCounterResultKHR;
+
+typedef struct VkAcquireProfilingLockInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkAcquireProfilingLockFlagsKHR flags;
+	uint64_t timeout;
+} VkAcquireProfilingLockInfoKHR;
+
+typedef VkResult (VKAPI_PTR *PFN_vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR)(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t* pCounterCount, VkPerformanceCounterKHR* pCounters, VkPerformanceCounterDescriptionKHR* pCounterDescriptions);
+typedef void (VKAPI_PTR *PFN_vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR)(VkPhysicalDevice physicalDevice, const VkQueryPoolPerformanceCreateInfoKHR* pPerformanceQueryCreateInfo, uint32_t* pNumPasses);
+typedef VkResult (VKAPI_PTR *PFN_vkAcquireProfilingLockKHR)(VkDevice device, const VkAcquireProfilingLockInfoKHR* pInfo);
+typedef void (VKAPI_PTR *PFN_vkReleaseProfilingLockKHR)(VkDevice device);
+#endif
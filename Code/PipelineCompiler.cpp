@@ -0,0 +1,102 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "PipelineCompiler.h"
+
+// vkCreateGraphicsPipelines is where the driver turns SPIR-V into
+// code for the GPU, which can take a long time, especially the first
+// time, when the pipeline cache does not have it yet. Before this,
+// the first frame waited until every pipeline was made.
+
+// Now, the demo makes a fast, unoptimized pipeline right away and draws
+// with it, while the real pipeline is made here. When its future is ready,
+// the demo switches to it between two frames (see Demo::update_pipeline)
+
+PipelineCompiler::PipelineCompiler(uint32_t threadCount)
+{
+	quit = false;
+
+	if (threadCount > PIPELINE_COMPILER_MAX_THREADS)
+		threadCount = PIPELINE_COMPILER_MAX_THREADS;
+
+	if (threadCount == 0)
+		threadCount = 1;
+
+	for (uint32_t i = 0; i < threadCount; i++)
+		threads.push_back(std::thread(&PipelineCompiler::WorkerLoop, this));
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+	// The jobs that are still waiting are finished first, so
+	// every future that was given out gets its pipeline, and
+	// the caller can destroy it
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+
+	wake.notify_all();
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::Submit(PipelineJob job)
+{
+	std::packaged_task<VkPipeline()> task(job);
+	std::shared_future<VkPipeline> future = task.get_future().share();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(task));
+	}
+
+	wake.notify_one();
+	return future;
+}
+
+void PipelineCompiler::WorkerLoop()
+{
+	while (true)
+	{
+		std::packaged_task<VkPipeline()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return quit || !jobs.empty(); });
+
+			if (jobs.empty())
+				return;
+
+			task = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		// the driver compiles the pipeline here, with
+		// the mutex unlocked, so other jobs can start
+		task();
+	}
+}
@@ -0,0 +1,66 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+// the most threads that compile pipelines at the same time
+#define PIPELINE_COMPILER_MAX_THREADS 4
+
+// a function that creates one pipeline, and returns it
+typedef std::function<VkPipeline()> PipelineJob;
+
+// Creates pipelines on background threads, so that the thread that
+// draws never has to wait for the driver to compile shaders. Each job
+// gives back a future, which is ready when its pipeline is made.
+// All jobs should use the same VkPipelineCache, which the driver
+// lets many threads use at the same time
+class PipelineCompiler
+{
+private:
+	std::vector<std::thread> threads;
+
+	// everything below is protected by the mutex
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::packaged_task<VkPipeline()>> jobs;
+	bool quit;
+
+	void WorkerLoop();
+
+public:
+	PipelineCompiler(uint32_t threadCount);
+	~PipelineCompiler();
+
+	std::shared_future<VkPipeline> Submit(PipelineJob job);
+};
@@ -0,0 +1,440 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#include "PipelineLibrary.h"
+#include "DynamicRendering.h"
+#include "FragmentShadingRate.h"
+#include "HostAllocator.h"
+#include <string.h>
+
+// A graphics pipeline has everything from the vertex format to the
+// blending, so changing any of it means compiling a whole new pipeline.
+// With VK_EXT_graphics_pipeline_library, the pipeline is split into four
+// libraries, and each one is only compiled once. The prewarm makes every
+// fragment shader with every vertex format, which would be one pipeline
+// for each pair, but with libraries, every shader is compiled only once,
+// and the pairs are only linked
+
+// FNV-1a, one 64-bit value at a time, like DescriptorAllocator
+static void HashValue(uint64_t* hash, uint64_t value)
+{
+	*hash ^= value;
+	*hash *= 1099511628211ull;
+}
+
+// FNV-1a over every byte, for the specialization data and the names
+static void HashBytes(uint64_t* hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		*hash ^= bytes[i];
+		*hash *= 1099511628211ull;
+	}
+}
+
+static void HashFloat(uint64_t* hash, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	HashValue(hash, bits);
+}
+
+static void HashStage(uint64_t* hash, const VkPipelineShaderStageCreateInfo& stage)
+{
+	HashValue(hash, (uint64_t)stage.stage);
+	HashValue(hash, (uint64_t)stage.flags);
+	HashValue(hash, (uint64_t)stage.module);
+	HashBytes(hash, stage.pName, strlen(stage.pName));
+
+	// the same shader with other specialization
+	// constants is another shader for the driver
+	if (stage.pSpecializationInfo != nullptr)
+	{
+		const VkSpecializationInfo* spec = stage.pSpecializationInfo;
+		HashBytes(hash, spec->pMapEntries, spec->mapEntryCount * sizeof(VkSpecializationMapEntry));
+		HashBytes(hash, spec->pData, spec->dataSize);
+	}
+}
+
+// The demo only chains the formats of dynamic rendering and the
+// shading rate of the pipeline. Any other structure only adds its sType
+static void HashChain(uint64_t* hash, const void* next)
+{
+	while (next != nullptr)
+	{
+		const VkBaseInStructure* base = (const VkBaseInStructure*)next;
+		HashValue(hash, (uint64_t)base->sType);
+
+		if (base->sType == VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR)
+		{
+			const VkPipelineRenderingCreateInfoKHR* rendering = (const VkPipelineRenderingCreateInfoKHR*)next;
+			HashValue(hash, rendering->viewMask);
+			HashBytes(hash, rendering->pColorAttachmentFormats, rendering->colorAttachmentCount * sizeof(VkFormat));
+			HashValue(hash, (uint64_t)rendering->depthAttachmentFormat);
+			HashValue(hash, (uint64_t)rendering->stencilAttachmentFormat);
+		}
+
+		if (base->sType == VK_STRUCTURE_TYPE_PIPELINE_FRAGMENT_SHADING_RATE_STATE_CREATE_INFO_KHR)
+		{
+			const VkPipelineFragmentShadingRateStateCreateInfoKHR* rate = (const VkPipelineFragmentShadingRateStateCreateInfoKHR*)next;
+			HashValue(hash, ((uint64_t)rate->fragmentSize.width << 32) | rate->fragmentSize.height);
+			HashValue(hash, ((uint64_t)rate->combinerOps[0] << 32) | rate->combinerOps[1]);
+		}
+
+		next = base->pNext;
+	}
+}
+
+static void HashMultisample(uint64_t* hash, const VkPipelineMultisampleStateCreateInfo* ms)
+{
+	HashValue(hash, (uint64_t)ms->rasterizationSamples);
+	HashValue(hash, ms->sampleShadingEnable);
+	HashFloat(hash, ms->minSampleShading);
+	HashValue(hash, ms->alphaToCoverageEnable);
+	HashValue(hash, ms->alphaToOneEnable);
+
+	// one 32-bit mask for every 32 samples
+	if (ms->pSampleMask != nullptr)
+		HashBytes(hash, ms->pSampleMask, ((ms->rasterizationSamples + 31) / 32) * sizeof(VkSampleMask));
+}
+
+// These flags only matter for the linked pipeline, or not at all
+static const VkPipelineCreateFlags linkOnlyFlags =
+	VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT |
+	VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT |
+	VK_PIPELINE_CREATE_DERIVATIVE_BIT |
+	VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+
+PipelineLibrary::PipelineLibrary(VkDevice d)
+{
+	device = d;
+	partsMade = 0;
+	partsReused = 0;
+}
+
+PipelineLibrary::~PipelineLibrary()
+{
+	// the pipelines that were linked from the parts
+	// do not need them, so they can be destroyed first
+	for (PipelinePart& part : parts)
+		vkDestroyPipeline(device, part.library, HostAllocator::callbacks);
+}
+
+VkPipeline PipelineLibrary::GetPart(VkPipelineCache cache, const VkGraphicsPipelineCreateInfo& info, VkGraphicsPipelineLibraryFlagsEXT type)
+{
+	// The part gets only the state that belongs to it, the rest stays
+	// NULL, and the key only has that state, so two pipelines that
+	// only have another fragment shader share the other three parts
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo = {};
+	libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+	libraryInfo.flags = type;
+
+	VkPipelineCreateFlags partFlags = info.flags & ~linkOnlyFlags;
+
+	// every part keeps what the driver needs to
+	// optimize across the parts, when they are linked
+	VkGraphicsPipelineCreateInfo partInfo = {};
+	partInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	partInfo.pNext = &libraryInfo;
+	partInfo.flags = partFlags | VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+	partInfo.basePipelineIndex = -1;
+
+	VkPipelineShaderStageCreateInfo stages[PIPELINE_LIBRARY_MAX_HANDLES];
+	uint64_t handles[PIPELINE_LIBRARY_MAX_HANDLES] = {};
+	uint32_t handleCount = 0;
+
+	uint64_t key = 14695981039346656037ull;
+	HashValue(&key, (uint64_t)type);
+	HashValue(&key, (uint64_t)partFlags);
+
+	// dynamic state that does not belong to
+	// the part is ignored by the driver
+	partInfo.pDynamicState = info.pDynamicState;
+
+	if (info.pDynamicState != nullptr)
+		HashBytes(&key, info.pDynamicState->pDynamicStates, info.pDynamicState->dynamicStateCount * sizeof(VkDynamicState));
+
+	// The vertex input part has the vertex format and the topology,
+	// it has no shaders, so it does not need the layout either
+	if (type == VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT)
+	{
+		const VkPipelineVertexInputStateCreateInfo* vi = info.pVertexInputState;
+		const VkPipelineInputAssemblyStateCreateInfo* ia = info.pInputAssemblyState;
+
+		partInfo.pVertexInputState = vi;
+		partInfo.pInputAssemblyState = ia;
+
+		for (uint32_t i = 0; i < vi->vertexBindingDescriptionCount; i++)
+		{
+			const VkVertexInputBindingDescription& b = vi->pVertexBindingDescriptions[i];
+			HashValue(&key, ((uint64_t)b.binding << 32) | b.stride);
+			HashValue(&key, (uint64_t)b.inputRate);
+		}
+
+		for (uint32_t i = 0; i < vi->vertexAttributeDescriptionCount; i++)
+		{
+			const VkVertexInputAttributeDescription& a = vi->pVertexAttributeDescriptions[i];
+			HashValue(&key, ((uint64_t)a.location << 32) | a.binding);
+			HashValue(&key, ((uint64_t)a.format << 32) | a.offset);
+		}
+
+		HashValue(&key, (uint64_t)ia->topology);
+		HashValue(&key, ia->primitiveRestartEnable);
+	}
+
+	// The other three parts all need the render pass and the subpass,
+	// or the formats of dynamic rendering, which are in the chain
+	else
+	{
+		libraryInfo.pNext = (void*)info.pNext;
+		partInfo.renderPass = info.renderPass;
+		partInfo.subpass = info.subpass;
+
+		HashChain(&key, info.pNext);
+		HashValue(&key, (uint64_t)info.renderPass);
+		HashValue(&key, info.subpass);
+	}
+
+	// The shaders before the rasterizer, and the rasterizer itself.
+	// The viewport and the scissor are dynamic in the demo, so the
+	// viewport state only has their numbers
+	if (type == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT)
+	{
+		const VkPipelineRasterizationStateCreateInfo* rs = info.pRasterizationState;
+
+		partInfo.pViewportState = info.pViewportState;
+		partInfo.pRasterizationState = rs;
+		partInfo.pTessellationState = info.pTessellationState;
+
+		if (info.pViewportState != nullptr)
+		{
+			HashValue(&key, ((uint64_t)info.pViewportState->viewportCount << 32) | info.pViewportState->scissorCount);
+
+			if (info.pViewportState->pViewports != nullptr)
+				HashBytes(&key, info.pViewportState->pViewports, info.pViewportState->viewportCount * sizeof(VkViewport));
+
+			if (info.pViewportState->pScissors != nullptr)
+				HashBytes(&key, info.pViewportState->pScissors, info.pViewportState->scissorCount * sizeof(VkRect2D));
+		}
+
+		HashValue(&key, ((uint64_t)rs->depthClampEnable << 32) | rs->rasterizerDiscardEnable);
+		HashValue(&key, ((uint64_t)rs->polygonMode << 32) | rs->cullMode);
+		HashValue(&key, ((uint64_t)rs->frontFace << 32) | rs->depthBiasEnable);
+		HashFloat(&key, rs->depthBiasConstantFactor);
+		HashFloat(&key, rs->depthBiasClamp);
+		HashFloat(&key, rs->depthBiasSlopeFactor);
+		HashFloat(&key, rs->lineWidth);
+
+		if (info.pTessellationState != nullptr)
+			HashValue(&key, info.pTessellationState->patchControlPoints);
+	}
+
+	// The fragment shader, and the depth test that runs
+	// around it. A pipeline without a fragment shader
+	// still has this part, it only has no stage
+	if (type == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)
+	{
+		const VkPipelineDepthStencilStateCreateInfo* ds = info.pDepthStencilState;
+
+		partInfo.pDepthStencilState = ds;
+		partInfo.pMultisampleState = info.pMultisampleState;
+
+		HashValue(&key, ((uint64_t)ds->depthTestEnable << 32) | ds->depthWriteEnable);
+		HashValue(&key, ((uint64_t)ds->depthCompareOp << 32) | ds->depthBoundsTestEnable);
+		HashValue(&key, ds->stencilTestEnable);
+		HashBytes(&key, &ds->front, sizeof(VkStencilOpState));
+		HashBytes(&key, &ds->back, sizeof(VkStencilOpState));
+		HashFloat(&key, ds->minDepthBounds);
+		HashFloat(&key, ds->maxDepthBounds);
+		HashMultisample(&key, info.pMultisampleState);
+	}
+
+	// The blending, and the samples of the attachments
+	if (type == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)
+	{
+		const VkPipelineColorBlendStateCreateInfo* cb = info.pColorBlendState;
+
+		partInfo.pColorBlendState = cb;
+		partInfo.pMultisampleState = info.pMultisampleState;
+
+		HashValue(&key, ((uint64_t)cb->logicOpEnable << 32) | cb->logicOp);
+		HashBytes(&key, cb->pAttachments, cb->attachmentCount * sizeof(VkPipelineColorBlendAttachmentState));
+		HashBytes(&key, cb->blendConstants, sizeof(cb->blendConstants));
+		HashMultisample(&key, info.pMultisampleState);
+	}
+
+	// The two parts with shaders get the layout, and only their stages.
+	// The layout and the modules are the handles of the part, see Forget
+	if (type == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT ||
+		type == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)
+	{
+		partInfo.layout = info.layout;
+		handles[handleCount++] = (uint64_t)info.layout;
+		HashValue(&key, (uint64_t)info.layout);
+
+		bool fragment = (type == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+
+		for (uint32_t i = 0; i < info.stageCount; i++)
+		{
+			if ((info.pStages[i].stage == VK_SHADER_STAGE_FRAGMENT_BIT) != fragment)
+				continue;
+
+			stages[partInfo.stageCount++] = info.pStages[i];
+			handles[handleCount++] = (uint64_t)info.pStages[i].module;
+			HashStage(&key, info.pStages[i]);
+		}
+
+		partInfo.pStages = (partInfo.stageCount > 0) ? stages : nullptr;
+	}
+
+	// Another thread might be making the same part right now. Both
+	// make it, because the lock is not held while the driver compiles,
+	// and the one that finishes second destroys its own
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (PipelinePart& part : parts)
+		{
+			if (part.key == key && part.type == type)
+			{
+				partsReused++;
+				return part.library;
+			}
+		}
+	}
+
+	VkPipeline library = VK_NULL_HANDLE;
+
+	if (vkCreateGraphicsPipelines(device, cache, 1, &partInfo, HostAllocator::callbacks, &library) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (PipelinePart& part : parts)
+	{
+		if (part.key == key && part.type == type)
+		{
+			vkDestroyPipeline(device, library, HostAllocator::callbacks);
+			partsReused++;
+			return part.library;
+		}
+	}
+
+	PipelinePart part = {};
+	part.key = key;
+	part.type = type;
+	part.library = library;
+	memcpy(part.handles, handles, sizeof(handles));
+	parts.push_back(part);
+	partsMade++;
+
+	return library;
+}
+
+VkPipeline PipelineLibrary::Create(VkPipelineCache cache, const VkGraphicsPipelineCreateInfo& info)
+{
+	static const VkGraphicsPipelineLibraryFlagsEXT types[4] =
+	{
+		VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+	};
+
+	VkPipeline libraries[4];
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		libraries[i] = GetPart(cache, info, types[i]);
+
+		if (libraries[i] == VK_NULL_HANDLE)
+			return VK_NULL_HANDLE;
+	}
+
+	VkPipelineLibraryCreateInfoKHR linkInfo = {};
+	linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	linkInfo.libraryCount = 4;
+	linkInfo.pLibraries = libraries;
+
+	// The linked pipeline only has the parts and the layout. The fast
+	// pipeline (DISABLE_OPTIMIZATION) is only linked, which takes almost
+	// no time, the others are optimized across the parts, which is
+	// slower, but they are as fast to draw with as a whole pipeline
+	VkGraphicsPipelineCreateInfo linkedInfo = {};
+	linkedInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	linkedInfo.pNext = &linkInfo;
+	linkedInfo.flags = info.flags & ~linkOnlyFlags;
+	linkedInfo.layout = info.layout;
+	linkedInfo.basePipelineIndex = -1;
+
+	if ((info.flags & VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT) == 0)
+		linkedInfo.flags |= VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+
+	VkPipeline result = VK_NULL_HANDLE;
+	vkCreateGraphicsPipelines(device, cache, 1, &linkedInfo, HostAllocator::callbacks, &result);
+	return result;
+}
+
+void PipelineLibrary::Forget(uint64_t handle)
+{
+	// the empty handles of a part are zero
+	if (handle == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (size_t i = 0; i < parts.size();)
+	{
+		bool uses = false;
+
+		for (uint32_t h = 0; h < PIPELINE_LIBRARY_MAX_HANDLES; h++)
+			uses |= (parts[i].handles[h] == handle);
+
+		if (!uses)
+		{
+			i++;
+			continue;
+		}
+
+		// the order of the parts does not matter, so
+		// the last one takes the place of this one
+		vkDestroyPipeline(device, parts[i].library, HostAllocator::callbacks);
+		parts[i] = parts.back();
+		parts.pop_back();
+	}
+}
+
+uint32_t PipelineLibrary::GetPartCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return partsMade;
+}
+
+uint32_t PipelineLibrary::GetReuseCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return partsReused;
+}
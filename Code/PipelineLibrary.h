@@ -0,0 +1,87 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include <mutex>
+#include "GraphicsPipelineLibrary.h"
+
+// the most handles that one part uses, the layout and up to
+// five shader modules (vertex, two tessellation, geometry, fragment)
+#define PIPELINE_LIBRARY_MAX_HANDLES 6
+
+// One part of a graphics pipeline (VK_EXT_graphics_pipeline_library).
+// key is a hash of the state of the part, and handles are the objects
+// that it was made with, so it can be destroyed when they are
+struct PipelinePart
+{
+	uint64_t key;
+	VkGraphicsPipelineLibraryFlagsEXT type;
+	VkPipeline library;
+	uint64_t handles[PIPELINE_LIBRARY_MAX_HANDLES];
+};
+
+// Makes graphics pipelines out of four libraries: the vertex input,
+// the shaders before the rasterizer, the fragment shader, and the
+// output (the blending and the attachments). Each part is only made
+// once, so pipelines that only change one part (another fragment
+// shader, or another vertex format) only compile that part, and the
+// rest is linked, which is much faster than a whole pipeline.
+// Create can be called on many threads at the same time
+class PipelineLibrary
+{
+private:
+	VkDevice device;
+
+	// everything below is protected by the mutex
+	std::mutex mutex;
+	std::vector<PipelinePart> parts;
+	uint32_t partsMade;
+	uint32_t partsReused;
+
+	VkPipeline GetPart(VkPipelineCache cache, const VkGraphicsPipelineCreateInfo& info, VkGraphicsPipelineLibraryFlagsEXT type);
+
+public:
+	PipelineLibrary(VkDevice device);
+	~PipelineLibrary();
+
+	// Makes the same pipeline as vkCreateGraphicsPipelines would, with
+	// info, by linking its parts. With DISABLE_OPTIMIZATION in the flags,
+	// the parts are only linked, which is fast, without it the driver
+	// optimizes across them, see VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT.
+	// The derivative flags are ignored, a library has nothing to derive from
+	VkPipeline Create(VkPipelineCache cache, const VkGraphicsPipelineCreateInfo& info);
+
+	// Destroys every part that was made with this shader module or
+	// pipeline layout. This has to be called before the handle is
+	// destroyed, because the driver can give the same handle to the
+	// next object, and then an old part would look like a new one
+	void Forget(uint64_t handle);
+
+	uint32_t GetPartCount();
+	uint32_t GetReuseCount();
+};
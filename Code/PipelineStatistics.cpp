@@ -0,0 +1,131 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "PipelineStatistics.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <stdio.h>
+#include <string.h>
+
+// A pipeline statistics query counts the work of every draw that happens
+// between vkCmdBeginQuery and vkCmdEndQuery. This is how we can see how
+// much culling saves (fewer vertices and triangles), and how much
+// overdraw there is (the fragment shader runs more than once per pixel).
+// It needs the pipelineStatisticsQuery feature, and because our draws are
+// in secondary command buffers, the inheritedQueries feature too
+
+PipelineStatistics::PipelineStatistics(VkDevice d, uint32_t slots)
+{
+	device = d;
+	slotCount = slots;
+	memset(totals, 0, sizeof(totals));
+	totalPixels = 0;
+	frames = 0;
+
+	// one query for every slot
+	VkQueryPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	poolInfo.queryCount = slotCount;
+	poolInfo.pipelineStatistics = PIPELINE_STATS_FLAGS;
+	vkCreateQueryPool(device, &poolInfo, HostAllocator::callbacks, &pool);
+
+	written.resize(slotCount, false);
+	pixels.resize(slotCount, 0);
+}
+
+PipelineStatistics::~PipelineStatistics()
+{
+	vkDestroyQueryPool(device, pool, HostAllocator::callbacks);
+}
+
+void PipelineStatistics::ReadSlot(uint32_t slot)
+{
+	if (!written[slot])
+		return;
+
+	written[slot] = false;
+
+	// one query gives one number for every
+	// counter, in the order of PipelineStat
+	uint64_t results[PIPELINE_STAT_COUNT];
+
+	VkResult result = DeviceTable::GetQueryPoolResults(device, pool, slot, 1,
+		sizeof(results), results, sizeof(results), VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS)
+		return;
+
+	for (uint32_t i = 0; i < PIPELINE_STAT_COUNT; i++)
+		totals[i] += results[i];
+
+	totalPixels += pixels[slot];
+	frames++;
+
+	if (frames >= PIPELINE_STATS_HISTORY)
+	{
+		Print();
+		memset(totals, 0, sizeof(totals));
+		totalPixels = 0;
+		frames = 0;
+	}
+}
+
+void PipelineStatistics::Begin(VkCommandBuffer cmd, uint32_t slot, uint32_t width, uint32_t height)
+{
+	// the last frame of this slot is done,
+	// so its query can be read now
+	ReadSlot(slot);
+
+	DeviceTable::CmdResetQueryPool(cmd, pool, slot, 1);
+	DeviceTable::CmdBeginQuery(cmd, pool, slot, 0);
+
+	pixels[slot] = (uint64_t)width * height;
+}
+
+void PipelineStatistics::End(VkCommandBuffer cmd, uint32_t slot)
+{
+	DeviceTable::CmdEndQuery(cmd, pool, slot);
+	written[slot] = true;
+}
+
+void PipelineStatistics::Print()
+{
+	if (frames == 0)
+		return;
+
+	// Clipping invocations are the triangles that went into clipping,
+	// clipping primitives are the ones that came out, so the difference
+	// is what was outside of the screen. Fragment shader invocations per
+	// pixel is the overdraw, 1.0 would mean every pixel is shaded once
+	printf("Pipeline stats per frame: %llu vertices, %llu triangles, %llu VS, %llu clipped in, %llu clipped out, %llu FS, %.2f FS per pixel\n",
+		(unsigned long long)(totals[PIPELINE_STAT_IA_VERTICES] / frames),
+		(unsigned long long)(totals[PIPELINE_STAT_IA_PRIMITIVES] / frames),
+		(unsigned long long)(totals[PIPELINE_STAT_VS_INVOCATIONS] / frames),
+		(unsigned long long)(totals[PIPELINE_STAT_CLIPPING_INVOCATIONS] / frames),
+		(unsigned long long)(totals[PIPELINE_STAT_CLIPPING_PRIMITIVES] / frames),
+		(unsigned long long)(totals[PIPELINE_STAT_FS_INVOCATIONS] / frames),
+		totalPixels ? (double)totals[PIPELINE_STAT_FS_INVOCATIONS] / totalPixels : 0.0);
+}
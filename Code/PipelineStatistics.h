@@ -0,0 +1,91 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+
+// how many frames of statistics are added up,
+// before the averages are printed
+#define PIPELINE_STATS_HISTORY 240
+
+// The counters that are asked for, the query writes
+// them in the order of their bits, which is this order
+#define PIPELINE_STATS_FLAGS ( \
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT)
+
+enum PipelineStat
+{
+	PIPELINE_STAT_IA_VERTICES,
+	PIPELINE_STAT_IA_PRIMITIVES,
+	PIPELINE_STAT_VS_INVOCATIONS,
+	PIPELINE_STAT_CLIPPING_INVOCATIONS,
+	PIPELINE_STAT_CLIPPING_PRIMITIVES,
+	PIPELINE_STAT_FS_INVOCATIONS,
+	PIPELINE_STAT_COUNT
+};
+
+// Counts what the GPU did in the render pass of each frame, with a
+// pipeline statistics query: how many vertices went in, how many times
+// the vertex shader ran, how many triangles survived clipping, and how
+// many times the fragment shader ran. Like GpuTimer, each frame slot
+// has its own query, which is read when the slot is recorded again
+class PipelineStatistics
+{
+private:
+	VkDevice device;
+	VkQueryPool pool;
+	uint32_t slotCount;
+
+	// true if the query of a slot was written,
+	// and the pixels of the window when it was
+	std::vector<bool> written;
+	std::vector<uint64_t> pixels;
+
+	// the sums of the frames since the last print
+	uint64_t totals[PIPELINE_STAT_COUNT];
+	uint64_t totalPixels;
+	uint32_t frames;
+
+	void ReadSlot(uint32_t slot);
+
+public:
+	PipelineStatistics(VkDevice d, uint32_t slots);
+	~PipelineStatistics();
+
+	// Begin is called before the render pass begins, and End after it
+	// ends. The first reads the last results of the slot, and resets
+	// the query, which can not be done inside of a render pass
+	void Begin(VkCommandBuffer cmd, uint32_t slot, uint32_t width, uint32_t height);
+	void End(VkCommandBuffer cmd, uint32_t slot);
+
+	void Print();
+};
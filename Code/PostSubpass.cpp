@@ -0,0 +1,248 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "PostSubpass.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+
+PostSubpass::PostSubpass(VkDevice d)
+{
+	device = d;
+	pipelineLayout = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+	descPool = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+
+	constants.gain = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	constants.lift = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	// the scene color, as an input attachment of the fragment shader
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+	vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &layout);
+}
+
+PostSubpass::~PostSubpass()
+{
+	if (descPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(device, descPool, HostAllocator::callbacks);
+	if (pipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	if (pipelineLayout != VK_NULL_HANDLE)
+		vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+
+	vkDestroyDescriptorSetLayout(device, layout, HostAllocator::callbacks);
+}
+
+void PostSubpass::PreparePipeline(VkPipelineCache cache, VkRenderPass renderPass, uint32_t subpass, bool halfPrecision)
+{
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(PostConstants);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &layout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &layoutInfo, HostAllocator::callbacks, &pipelineLayout);
+
+	// Shaders compiled to header, see compileShaders.cmd
+	const unsigned char vs_code[] = {
+		#include "post.vert.inc"
+	};
+
+	const unsigned char fs_code[] = {
+		#include "post.frag.inc"
+	};
+
+	const unsigned char fs_half_code[] = {
+		#include "post_half.frag.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+
+	VkShaderModule vertModule;
+	shaderInfo.pCode = (uint32_t*)vs_code;
+	shaderInfo.codeSize = sizeof(vs_code);
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &vertModule);
+
+	VkShaderModule fragModule;
+	shaderInfo.pCode = (uint32_t*)(halfPrecision ? fs_half_code : fs_code);
+	shaderInfo.codeSize = halfPrecision ? sizeof(fs_half_code) : sizeof(fs_code);
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &fragModule);
+
+	VkPipelineShaderStageCreateInfo stages[2] = {};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = vertModule;
+	stages[0].pName = "main";
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = fragModule;
+	stages[1].pName = "main";
+
+	// the corners of the triangle come from the vertex index
+	VkPipelineVertexInputStateCreateInfo vi = {};
+	vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo ia = {};
+	ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	// the render area changes with dynamic resolution, the pipeline does not
+	VkPipelineViewportStateCreateInfo vp = {};
+	vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	vp.viewportCount = 1;
+	vp.scissorCount = 1;
+
+	VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkPipelineRasterizationStateCreateInfo rs = {};
+	rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rs.polygonMode = VK_POLYGON_MODE_FILL;
+	rs.cullMode = VK_CULL_MODE_NONE;
+	rs.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rs.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo ms = {};
+	ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// the subpass has no depth attachment, every pixel is written once
+	VkPipelineDepthStencilStateCreateInfo ds = {};
+	ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+
+	VkPipelineColorBlendAttachmentState blend = {};
+	blend.colorWriteMask = 0xF;
+
+	VkPipelineColorBlendStateCreateInfo cb = {};
+	cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	cb.attachmentCount = 1;
+	cb.pAttachments = &blend;
+
+	VkGraphicsPipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeInfo.stageCount = 2;
+	pipeInfo.pStages = stages;
+	pipeInfo.pVertexInputState = &vi;
+	pipeInfo.pInputAssemblyState = &ia;
+	pipeInfo.pViewportState = &vp;
+	pipeInfo.pRasterizationState = &rs;
+	pipeInfo.pMultisampleState = &ms;
+	pipeInfo.pDepthStencilState = &ds;
+	pipeInfo.pColorBlendState = &cb;
+	pipeInfo.pDynamicState = &dynamicState;
+	pipeInfo.layout = pipelineLayout;
+	pipeInfo.renderPass = renderPass;
+	pipeInfo.subpass = subpass;
+
+	if (vkCreateGraphicsPipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the post subpass pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, vertModule, HostAllocator::callbacks);
+	vkDestroyShaderModule(device, fragModule, HostAllocator::callbacks);
+}
+
+VkDescriptorPool PostSubpass::SetInput(VkImageView sceneColor)
+{
+	VkDescriptorPool oldPool = descPool;
+
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	poolSize.descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &descPool);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, &set);
+
+	// an input attachment has no sampler, and it is read in the
+	// layout that the post subpass gives it
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageView = sceneColor;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	write.pImageInfo = &imageInfo;
+	DeviceTable::UpdateDescriptorSets(device, 1, &write, 0, NULL);
+
+	return oldPool;
+}
+
+void PostSubpass::Record(VkCommandBuffer cmd, uint32_t width, uint32_t height)
+{
+	VkViewport viewport = {};
+	viewport.width = (float)width;
+	viewport.height = (float)height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent.width = width;
+	scissor.extent.height = height;
+
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &set, 0, NULL);
+	DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PostConstants), &constants);
+	DeviceTable::CmdSetViewport(cmd, 0, 1, &viewport);
+	DeviceTable::CmdSetScissor(cmd, 0, 1, &scissor);
+
+	// one triangle that covers the whole render area
+	DeviceTable::CmdDraw(cmd, 3, 1, 0, 0);
+}
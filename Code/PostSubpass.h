@@ -0,0 +1,92 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <glm/glm.hpp>
+
+// The scene is drawn into an image of this format, and the post
+// subpass writes the graded color into the real color attachment.
+// It has more precision than the swapchain, so the grade does not
+// show steps in dark gradients
+#define POST_SCENE_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+
+// This is given to post.frag with push constants,
+// it must match PostVals in post.frag
+struct PostConstants
+{
+	// rgb is multiplied into the color (the exposure),
+	// w is the saturation, 1 changes nothing
+	glm::vec4 gain;
+
+	// rgb is added after the gain, w is unused
+	glm::vec4 lift;
+};
+
+// The color grade, as the last subpass of the render pass. The main
+// subpass draws into the scene color, and this subpass reads it as an
+// input attachment, one pixel at a time, and writes the color
+// attachment. On a tiled GPU, both subpasses run on one tile before
+// the next tile starts, so the scene color never leaves the tile
+// memory, it is TRANSIENT, and the grade does not read or write a
+// whole image in memory, like a pass of its own would.
+// The pipeline is made once, the descriptor set points at the scene
+// color, which has the size of the window, so it is written again
+// after every resize, see SetInput
+class PostSubpass
+{
+private:
+	VkDevice device;
+	VkDescriptorSetLayout layout;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	// one set, in a pool of its own, so the pool of the
+	// last size can be retired while a frame still uses it
+	VkDescriptorPool descPool;
+	VkDescriptorSet set;
+
+public:
+	// the grade of every frame, starts out as no change at all
+	PostConstants constants;
+
+	PostSubpass(VkDevice d);
+	~PostSubpass();
+
+	// The pipeline is used in this subpass of the render pass, which
+	// must be the last one. With halfPrecision, it uses post_half.frag,
+	// which needs shaderFloat16
+	void PreparePipeline(VkPipelineCache cache, VkRenderPass renderPass, uint32_t subpass, bool halfPrecision);
+
+	// Points the descriptor set at the scene color of this size. The
+	// pool of the last size is returned (or VK_NULL_HANDLE), the caller
+	// destroys it when no frame uses it anymore
+	VkDescriptorPool SetInput(VkImageView sceneColor);
+
+	// This must be recorded inline, in the post subpass,
+	// after vkCmdNextSubpass, the size is the render area
+	void Record(VkCommandBuffer cmd, uint32_t width, uint32_t height);
+};
@@ -0,0 +1,150 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "PresentThread.h"
+#include "DeviceTable.h"
+
+PresentThread::PresentThread(VkQueue presentQueue, PFN_vkQueuePresentKHR fpQueuePresentKHR, const ThreadSchedule* threadSchedule)
+{
+	queue = presentQueue;
+	queuePresent = fpQueuePresentKHR;
+
+	hasSchedule = (threadSchedule != nullptr);
+	if (hasSchedule)
+		schedule = *threadSchedule;
+	busy = false;
+	quit = false;
+	lastResult = VK_SUCCESS;
+
+	// from now on, two threads use the queue
+	QueueLock::Enable();
+
+	thread = std::thread(&PresentThread::Run, this);
+}
+
+PresentThread::~PresentThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	condition.notify_all();
+	thread.join();
+
+	QueueLock::Disable();
+}
+
+void PresentThread::Push(const PresentRequest& request)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.push_back(request);
+	}
+	condition.notify_all();
+}
+
+uint32_t PresentThread::GetPending()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (uint32_t)requests.size() + (busy ? 1 : 0);
+}
+
+void PresentThread::Wait(uint32_t maxPending)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	condition.wait(lock, [this, maxPending]()
+	{
+		return (uint32_t)requests.size() + (busy ? 1 : 0) <= maxPending;
+	});
+}
+
+VkResult PresentThread::GetLastResult()
+{
+	return lastResult;
+}
+
+void PresentThread::Run()
+{
+	// a present that is late misses the vsync,
+	// so this thread can be scheduled like the render thread
+	HANDLE task = hasSchedule ? ThreadScheduler::Apply(schedule, "present") : NULL;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		// sleep until there is a present, the ones that are
+		// left when we quit are still presented first
+		condition.wait(lock, [this]() { return quit || !requests.empty(); });
+
+		if (requests.empty())
+		{
+			ThreadScheduler::Revert(task);
+			return;
+		}
+
+		PresentRequest request = requests.front();
+		requests.pop_front();
+		busy = true;
+
+		// the render thread can push more presents, and
+		// submit its next frame, while we are in the driver
+		lock.unlock();
+
+		VkPresentInfoKHR present = {};
+		present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		present.waitSemaphoreCount = 1;
+		present.pWaitSemaphores = &request.waitSemaphore;
+		present.swapchainCount = 1;
+		present.pSwapchains = &request.swapchain;
+		present.pImageIndices = &request.imageIndex;
+
+		VkPresentRegionKHR region = {};
+		region.rectangleCount = request.rectangleCount;
+		region.pRectangles = &request.rectangle;
+
+		VkPresentRegionsKHR presentRegions = {};
+		presentRegions.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+		presentRegions.swapchainCount = 1;
+		presentRegions.pRegions = &region;
+
+		if (request.hasRegion)
+		{
+			present.pNext = &presentRegions;
+		}
+
+		VkResult result;
+		{
+			QueueLock queueLock;
+			result = queuePresent(queue, &present);
+		}
+		lastResult = result;
+
+		lock.lock();
+		busy = false;
+		condition.notify_all();
+	}
+}
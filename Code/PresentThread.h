@@ -0,0 +1,101 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include "ThreadScheduler.h"
+
+// Everything that one present needs. The render thread builds the
+// chained structs of its present in the frame arena, which is reset
+// in the next frame, so the present thread gets copies of them instead
+struct PresentRequest
+{
+	VkSwapchainKHR swapchain;
+	uint32_t imageIndex;
+	VkSemaphore waitSemaphore;
+
+	// VK_KHR_incremental_present, zero
+	// rectangles means the whole image
+	bool hasRegion;
+	uint32_t rectangleCount;
+	VkRectLayerKHR rectangle;
+};
+
+// Calls vkQueuePresentKHR on its own thread. In FIFO mode, some drivers
+// block inside of the present until the monitor is ready for the next
+// image, which can be most of a refresh. With this thread, the render
+// thread only puts the present in a queue, and starts on the next frame
+// right away. The queue is shared with the render thread, so every
+// submit and present holds QueueLock (see DeviceTable.h)
+class PresentThread
+{
+private:
+	VkQueue queue;
+	PFN_vkQueuePresentKHR queuePresent;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<PresentRequest> requests;
+
+	// true while the thread is inside of the present,
+	// then it is not in requests anymore, but not done
+	bool busy;
+	bool quit;
+
+	// the result of the newest present
+	std::atomic<VkResult> lastResult;
+
+	// the MMCSS task and cores of the thread, if it has any
+	bool hasSchedule;
+	ThreadSchedule schedule;
+
+	void Run();
+
+public:
+	// the thread applies threadSchedule (if there is one) when it starts
+	PresentThread(VkQueue presentQueue, PFN_vkQueuePresentKHR fpQueuePresentKHR, const ThreadSchedule* threadSchedule = nullptr);
+
+	// presents everything that is still in the queue, then stops
+	~PresentThread();
+
+	void Push(const PresentRequest& request);
+
+	// the presents that were pushed and are not done yet
+	uint32_t GetPending();
+
+	// Returns when at most maxPending presents are not done. With zero,
+	// the thread is not using any swapchain anymore, so the render thread
+	// can acquire, or make a new swapchain, without racing it
+	void Wait(uint32_t maxPending);
+
+	VkResult GetLastResult();
+};
@@ -0,0 +1,163 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "RawInput.h"
+#include <string.h>
+
+// the usage page and usages of the keyboard and the mouse, see
+// "HID Usage Tables", older SDKs do not have the names
+#define RAW_INPUT_USAGE_PAGE_GENERIC 0x01
+#define RAW_INPUT_USAGE_MOUSE 0x02
+#define RAW_INPUT_USAGE_KEYBOARD 0x06
+
+RawInput::RawInput(WindowEventQueue* eventQueue)
+{
+	queue = eventQueue;
+	registered = false;
+	memset(down, 0, sizeof(down));
+	motionX = 0;
+	motionY = 0;
+}
+
+bool RawInput::Register(HWND window)
+{
+	// No RIDEV_NOLEGACY, the window still gets WM_KEYDOWN and the
+	// mouse messages, so Alt+F4, and dragging the window, still work.
+	// No RIDEV_INPUTSINK, the input only comes while the window is in front
+	RAWINPUTDEVICE devices[2] = {};
+	devices[0].usUsagePage = RAW_INPUT_USAGE_PAGE_GENERIC;
+	devices[0].usUsage = RAW_INPUT_USAGE_KEYBOARD;
+	devices[0].dwFlags = 0;
+	devices[0].hwndTarget = window;
+
+	devices[1].usUsagePage = RAW_INPUT_USAGE_PAGE_GENERIC;
+	devices[1].usUsage = RAW_INPUT_USAGE_MOUSE;
+	devices[1].dwFlags = 0;
+	devices[1].hwndTarget = window;
+
+	registered = (RegisterRawInputDevices(devices, 2, sizeof(RAWINPUTDEVICE)) == TRUE);
+	return registered;
+}
+
+bool RawInput::IsRegistered()
+{
+	return registered;
+}
+
+void RawInput::OnInput(HRAWINPUT handle)
+{
+	// The input of this message has to be read with GetRawInputData,
+	// DefWindowProc frees it. A keyboard or a mouse always fits into one
+	// RAWINPUT, other devices (HID) are not registered
+	UINT size = sizeof(RAWINPUT);
+
+	if (GetRawInputData(handle, RID_INPUT, &buffer[0], &size, sizeof(RAWINPUTHEADER)) != (UINT)-1)
+		Handle(&buffer[0]);
+
+	// Then everything else that is waiting. Each input is a different
+	// size, so NEXTRAWINPUTBLOCK finds the next one, and it also knows
+	// the alignment of a 32 bit program on 64 bit Windows
+	while (true)
+	{
+		size = sizeof(buffer);
+		UINT count = GetRawInputBuffer(buffer, &size, sizeof(RAWINPUTHEADER));
+
+		if (count == 0 || count == (UINT)-1)
+			break;
+
+		RAWINPUT* input = buffer;
+
+		for (UINT i = 0; i < count; i++)
+		{
+			Handle(input);
+			input = NEXTRAWINPUTBLOCK(input);
+		}
+	}
+}
+
+void RawInput::Handle(const RAWINPUT* input)
+{
+	if (input->header.dwType == RIM_TYPEKEYBOARD)
+	{
+		const RAWKEYBOARD& keyboard = input->data.keyboard;
+
+		// 255 is sent for the extra scan codes of some keys
+		// (like Pause), which are not a key by themselves
+		if (keyboard.VKey >= 255)
+			return;
+
+		SetKey(keyboard.VKey, (keyboard.Flags & RI_KEY_BREAK) == 0);
+	}
+	else if (input->header.dwType == RIM_TYPEMOUSE)
+	{
+		const RAWMOUSE& mouse = input->data.mouse;
+
+		// a tablet, or a remote desktop, sends where the
+		// mouse is, instead of how far it moved
+		if (!(mouse.usFlags & MOUSE_MOVE_ABSOLUTE))
+		{
+			motionX.fetch_add(mouse.lLastX, std::memory_order_relaxed);
+			motionY.fetch_add(mouse.lLastY, std::memory_order_relaxed);
+		}
+
+		// the buttons are keys too, with their virtual key codes
+		if (mouse.usButtonFlags & RI_MOUSE_LEFT_BUTTON_DOWN)
+			SetKey(VK_LBUTTON, true);
+		if (mouse.usButtonFlags & RI_MOUSE_LEFT_BUTTON_UP)
+			SetKey(VK_LBUTTON, false);
+		if (mouse.usButtonFlags & RI_MOUSE_RIGHT_BUTTON_DOWN)
+			SetKey(VK_RBUTTON, true);
+		if (mouse.usButtonFlags & RI_MOUSE_RIGHT_BUTTON_UP)
+			SetKey(VK_RBUTTON, false);
+		if (mouse.usButtonFlags & RI_MOUSE_MIDDLE_BUTTON_DOWN)
+			SetKey(VK_MBUTTON, true);
+		if (mouse.usButtonFlags & RI_MOUSE_MIDDLE_BUTTON_UP)
+			SetKey(VK_MBUTTON, false);
+	}
+}
+
+void RawInput::SetKey(uint32_t key, bool isDown)
+{
+	// a key that repeats, or a release that we already sent
+	if (down[key] == isDown)
+		return;
+
+	down[key] = isDown;
+
+	WindowEvent event = { isDown ? WINDOW_EVENT_KEY_DOWN : WINDOW_EVENT_KEY_UP, key, 0 };
+	queue->Push(event);
+}
+
+void RawInput::ReleaseAll()
+{
+	for (uint32_t i = 0; i < 256; i++)
+		SetKey(i, false);
+}
+
+void RawInput::TakeMouseMotion(int32_t* x, int32_t* y)
+{
+	*x = motionX.exchange(0, std::memory_order_relaxed);
+	*y = motionY.exchange(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,83 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <windows.h>
+#include <stdint.h>
+#include <atomic>
+#include "WindowEventQueue.h"
+
+// how many raw inputs GetRawInputBuffer reads in one call
+#define RAW_INPUT_BUFFER_COUNT 64
+
+// Reads the keyboard and the mouse with Raw Input, instead of
+// WM_KEYDOWN and WM_KEYUP. A mouse that reports 1000 (or 8000) times
+// every second sends that many WM_INPUT messages, so each WM_INPUT
+// also reads every other input that is waiting with GetRawInputBuffer,
+// which takes them out of the message queue, and the message loop only
+// sees a few of them. Keys and mouse buttons go to the render thread
+// through the WindowEventQueue, which it reads right before each frame.
+// Mouse movement is only added up, so it never fills the queue, and
+// the render thread takes the sum with TakeMouseMotion
+class RawInput
+{
+private:
+	WindowEventQueue* queue;
+	bool registered;
+
+	// which keys are down, Raw Input repeats the key while it is
+	// held, like WM_KEYDOWN does, but the render thread only wants
+	// the first one. Only the window's thread uses this
+	bool down[256];
+
+	// the mouse movement since the last TakeMouseMotion
+	std::atomic<int32_t> motionX;
+	std::atomic<int32_t> motionY;
+
+	RAWINPUT buffer[RAW_INPUT_BUFFER_COUNT];
+
+	void Handle(const RAWINPUT* input);
+	void SetKey(uint32_t key, bool isDown);
+
+public:
+	RawInput(WindowEventQueue* eventQueue);
+
+	// sends the keyboard and the mouse to the window, while it is in
+	// front. Returns false if Windows refuses, then WM_KEYDOWN is used
+	bool Register(HWND window);
+	bool IsRegistered();
+
+	// handles the input of one WM_INPUT message, and reads all of the
+	// others that are waiting, this is called before DefWindowProc
+	void OnInput(HRAWINPUT handle);
+
+	// The window does not get the key releases while it is in the
+	// background, so when it loses the focus, every key is released
+	void ReleaseAll();
+
+	// the mouse movement (in mouse counts) since the last call,
+	// this is read by the render thread
+	void TakeMouseMotion(int32_t* x, int32_t* y);
+};
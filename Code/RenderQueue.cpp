@@ -0,0 +1,186 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "RenderQueue.h"
+#include <string.h>
+
+RenderQueue::RenderQueue(JobSystem* js)
+{
+	jobs = js;
+	sortedDigits = 0;
+
+	for (uint32_t i = 0; i < RENDER_PASS_COUNT; i++)
+		passCounts[i] = 0;
+}
+
+uint64_t RenderQueue::MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth)
+{
+	// The bits of a positive float are in the same order as the
+	// floats themselves, so the depth can be sorted as an integer.
+	// Negative depths (behind the camera) all become zero
+	uint32_t depthBits = 0;
+
+	if (depth > 0.0f)
+		memcpy(&depthBits, &depth, sizeof(uint32_t));
+
+	return
+		((uint64_t)pass << RENDER_KEY_PASS_SHIFT) |
+		((uint64_t)(pipeline & RENDER_KEY_PIPELINE_MASK) << RENDER_KEY_PIPELINE_SHIFT) |
+		((uint64_t)(material & RENDER_KEY_MATERIAL_MASK) << RENDER_KEY_MATERIAL_SHIFT) |
+		(uint64_t)depthBits;
+}
+
+void RenderQueue::Clear()
+{
+	packets.clear();
+
+	for (uint32_t i = 0; i < RENDER_PASS_COUNT; i++)
+		passCounts[i] = 0;
+}
+
+void RenderQueue::Submit(uint64_t key, uint32_t object)
+{
+	RenderPacket packet;
+	packet.key = key;
+	packet.object = object;
+	packet.padding = 0;
+	packets.push_back(packet);
+
+	// the pass is the top of the key, so the count of each
+	// pass is all that GetPass needs to find its packets
+	passCounts[key >> RENDER_KEY_PASS_SHIFT]++;
+}
+
+void RenderQueue::ForEachPart(uint32_t partCount, const std::function<void(uint32_t, uint32_t, uint32_t)>& fn)
+{
+	uint32_t count = (uint32_t)packets.size();
+	uint32_t perPart = (count + partCount - 1) / partCount;
+
+	for (uint32_t part = 1; part < partCount; part++)
+	{
+		uint32_t begin = part * perPart;
+		uint32_t end = (begin + perPart < count) ? begin + perPart : count;
+		jobs->Run([&fn, part, begin, end]() { fn(part, begin, end); }, &counter);
+	}
+
+	fn(0, 0, (perPart < count) ? perPart : count);
+	jobs->Wait(&counter);
+}
+
+void RenderQueue::Sort()
+{
+	uint32_t count = (uint32_t)packets.size();
+	sortedDigits = 0;
+
+	if (count < 2)
+		return;
+
+	uint32_t partCount = 1;
+
+	if (count >= RENDER_QUEUE_PARALLEL_MIN)
+		partCount = jobs->GetWorkerCount() + 1;
+
+	scratch.resize(count);
+	histograms.resize(partCount * RENDER_QUEUE_BUCKETS);
+
+	RenderPacket* src = packets.data();
+	RenderPacket* dst = scratch.data();
+
+	for (uint32_t digit = 0; digit < RENDER_QUEUE_DIGITS; digit++)
+	{
+		uint32_t shift = digit * RENDER_QUEUE_RADIX_BITS;
+
+		// every part counts how many of its keys have each digit
+		ForEachPart(partCount, [this, src, shift](uint32_t part, uint32_t begin, uint32_t end)
+		{
+			uint32_t* histogram = &histograms[part * RENDER_QUEUE_BUCKETS];
+			memset(histogram, 0, RENDER_QUEUE_BUCKETS * sizeof(uint32_t));
+
+			for (uint32_t i = begin; i < end; i++)
+				histogram[(src[i].key >> shift) & (RENDER_QUEUE_BUCKETS - 1)]++;
+		});
+
+		// The packets with digit 0 go first, the ones of part 0 before
+		// the ones of part 1, then digit 1, and so on, so each count
+		// becomes the first place of its digit in its part. If every
+		// key has the same digit, nothing would move
+		uint32_t place = 0;
+		bool skip = false;
+
+		for (uint32_t bucket = 0; bucket < RENDER_QUEUE_BUCKETS; bucket++)
+		{
+			uint32_t bucketStart = place;
+
+			for (uint32_t part = 0; part < partCount; part++)
+			{
+				uint32_t& h = histograms[part * RENDER_QUEUE_BUCKETS + bucket];
+				uint32_t n = h;
+				h = place;
+				place += n;
+			}
+
+			if (place - bucketStart == count)
+				skip = true;
+		}
+
+		if (skip)
+			continue;
+
+		// every part moves its packets to their places, in the
+		// same order as before, which keeps the sort stable
+		ForEachPart(partCount, [this, src, dst, shift](uint32_t part, uint32_t begin, uint32_t end)
+		{
+			uint32_t* next = &histograms[part * RENDER_QUEUE_BUCKETS];
+
+			for (uint32_t i = begin; i < end; i++)
+				dst[next[(src[i].key >> shift) & (RENDER_QUEUE_BUCKETS - 1)]++] = src[i];
+		});
+
+		RenderPacket* swap = src;
+		src = dst;
+		dst = swap;
+		sortedDigits++;
+	}
+
+	// after an odd number of steps, the sorted packets are in scratch
+	if (src != packets.data())
+		packets.swap(scratch);
+}
+
+const RenderPacket* RenderQueue::GetPass(uint32_t pass, uint32_t* count)
+{
+	uint32_t first = 0;
+
+	for (uint32_t i = 0; i < pass; i++)
+		first += passCounts[i];
+
+	*count = passCounts[pass];
+	return packets.data() + first;
+}
+
+uint32_t RenderQueue::GetCount()
+{
+	return (uint32_t)packets.size();
+}
@@ -0,0 +1,118 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "JobSystem.h"
+
+// The passes of the render queue, in the order that they are drawn.
+// The pass is in the highest bits of the key, so the packets of each
+// pass are next to each other after the sort
+enum RenderQueuePass
+{
+	RENDER_PASS_DEPTH_PREPASS,
+	RENDER_PASS_MAIN,
+	RENDER_PASS_COUNT
+};
+
+// Where each part is in the 64-bit sort key, from the highest bits to
+// the lowest. Packets are sorted by pass first, then by pipeline, then
+// by material (the descriptor set or the texture), so draws that need
+// the same state are next to each other, and then by depth, front to
+// back, so the closest objects fill the depth buffer first, and early-Z
+// can skip the pixels of everything behind them
+#define RENDER_KEY_PASS_SHIFT 62
+#define RENDER_KEY_PIPELINE_SHIFT 48
+#define RENDER_KEY_MATERIAL_SHIFT 32
+#define RENDER_KEY_PIPELINE_MASK 0xFF
+#define RENDER_KEY_MATERIAL_MASK 0xFFFF
+
+// the radix sort takes 8 bits of the key at a time
+#define RENDER_QUEUE_RADIX_BITS 8
+#define RENDER_QUEUE_BUCKETS (1 << RENDER_QUEUE_RADIX_BITS)
+#define RENDER_QUEUE_DIGITS (64 / RENDER_QUEUE_RADIX_BITS)
+
+// With fewer packets than this, the sort runs on one thread, because
+// waking up the workers takes longer than sorting them
+#define RENDER_QUEUE_PARALLEL_MIN 8192
+
+// One draw of one object, the object is the index of the cube
+struct RenderPacket
+{
+	uint64_t key;
+	uint32_t object;
+	uint32_t padding;
+};
+
+// The draws of a frame are given to the queue as packets, the queue
+// sorts them by their keys with a radix sort, and then they are
+// recorded in that order (see record_draws). The radix sort goes
+// through the key 8 bits at a time, from the lowest bits, and each
+// step is stable, so the order of the key is kept in the end. A step
+// where every key has the same 8 bits would not move anything, so it
+// is skipped, which is most of them when the scene has one pipeline.
+// Big queues are sorted by the JobSystem: each thread counts the
+// digits of its own part of the packets, and then moves its packets to
+// the places that the counts of all the parts add up to
+class RenderQueue
+{
+private:
+	JobSystem* jobs;
+	JobCounter counter;
+
+	std::vector<RenderPacket> packets;
+	std::vector<RenderPacket> scratch;
+
+	// one histogram for each part, which becomes the
+	// place that the next packet of each digit goes to
+	std::vector<uint32_t> histograms;
+
+	uint32_t passCounts[RENDER_PASS_COUNT];
+
+	// runs fn(part, begin, end) for every part of the packets, part 0
+	// on this thread, the others as jobs, and returns when all are done
+	void ForEachPart(uint32_t partCount, const std::function<void(uint32_t, uint32_t, uint32_t)>& fn);
+
+public:
+	// the steps of the radix sort that the last Sort did,
+	// the others were skipped, out of RENDER_QUEUE_DIGITS
+	uint32_t sortedDigits;
+
+	RenderQueue(JobSystem* js);
+
+	// the depth is the distance from the camera, objects
+	// behind the camera have the smallest depths
+	static uint64_t MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth);
+
+	// forgets the packets of the last frame, the memory is kept
+	void Clear();
+	void Submit(uint64_t key, uint32_t object);
+	void Sort();
+
+	// the packets of one pass, after Sort
+	const RenderPacket* GetPass(uint32_t pass, uint32_t* count);
+	uint32_t GetCount();
+};
@@ -0,0 +1,166 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "SamplerCache.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include <string.h>
+#include <stdio.h>
+
+bool SamplerKey::operator==(const SamplerKey& other) const
+{
+	return memcmp(&info, &other.info, sizeof(info)) == 0;
+}
+
+size_t SamplerKeyHash::operator()(const SamplerKey& key) const
+{
+	// FNV-1a over every byte of the key
+	const uint8_t* bytes = (const uint8_t*)&key.info;
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < sizeof(key.info); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return (size_t)hash;
+}
+
+SamplerCache::SamplerCache(VkDevice d, VkPhysicalDevice gpu, bool anisotropy)
+{
+	device = d;
+
+	// maxSamplerAllocationCount is how many samplers can exist at
+	// the same time, maxSamplerAnisotropy is the most anisotropy
+	// that one sampler can have
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(gpu, &props);
+
+	maxSamplerCount = props.limits.maxSamplerAllocationCount;
+	maxAnisotropy = props.limits.maxSamplerAnisotropy;
+
+	// this is true if the samplerAnisotropy
+	// feature was enabled when the device was made
+	anisotropyEnabled = anisotropy;
+}
+
+SamplerCache::~SamplerCache()
+{
+	for (auto& pair : samplers)
+		vkDestroySampler(device, pair.second, HostAllocator::callbacks);
+}
+
+SamplerKey SamplerCache::MakeKey(const VkSamplerCreateInfo& info)
+{
+	// Every byte starts as zero, including the padding between
+	// members, then every member is copied. pNext is not part of
+	// the key, and the samplers in the cache never have one
+	SamplerKey key;
+	memset(&key, 0, sizeof(key));
+
+	key.info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	key.info.flags = info.flags;
+	key.info.magFilter = info.magFilter;
+	key.info.minFilter = info.minFilter;
+	key.info.mipmapMode = info.mipmapMode;
+	key.info.addressModeU = info.addressModeU;
+	key.info.addressModeV = info.addressModeV;
+	key.info.addressModeW = info.addressModeW;
+	key.info.mipLodBias = info.mipLodBias;
+	key.info.compareEnable = info.compareEnable;
+	key.info.compareOp = info.compareEnable ? info.compareOp : VK_COMPARE_OP_NEVER;
+	key.info.minLod = info.minLod;
+	key.info.maxLod = info.maxLod;
+	key.info.borderColor = info.borderColor;
+	key.info.unnormalizedCoordinates = info.unnormalizedCoordinates;
+
+	// Without the feature, anisotropy is turned off, and with it, it is
+	// never more than the GPU supports. Because this happens before
+	// the lookup, asking for 16x on a GPU that only has 8x gives the same
+	// sampler as asking for 8x. Anisotropy of 1 is the same as none
+	key.info.anisotropyEnable = VK_FALSE;
+	key.info.maxAnisotropy = 1.0f;
+
+	if (anisotropyEnabled && info.anisotropyEnable && info.maxAnisotropy > 1.0f)
+	{
+		key.info.anisotropyEnable = VK_TRUE;
+		key.info.maxAnisotropy = (info.maxAnisotropy > maxAnisotropy) ? maxAnisotropy : info.maxAnisotropy;
+	}
+
+	return key;
+}
+
+VkSampler SamplerCache::FindClosest(const SamplerKey& key)
+{
+	// If the GPU can not have any more samplers, the texture gets
+	// a sampler that filters the same way, or any sampler at all. It
+	// will not look exactly right, but it is better than crashing
+	VkSampler closest = VK_NULL_HANDLE;
+
+	for (auto& pair : samplers)
+	{
+		const VkSamplerCreateInfo& info = pair.first.info;
+
+		if (info.magFilter == key.info.magFilter &&
+			info.minFilter == key.info.minFilter &&
+			info.mipmapMode == key.info.mipmapMode)
+			return pair.second;
+
+		if (closest == VK_NULL_HANDLE)
+			closest = pair.second;
+	}
+
+	return closest;
+}
+
+VkSampler SamplerCache::Get(const VkSamplerCreateInfo& info)
+{
+	SamplerKey key = MakeKey(info);
+
+	auto found = samplers.find(key);
+	if (found != samplers.end())
+		return found->second;
+
+	if (samplers.size() >= maxSamplerCount)
+	{
+		printf("maxSamplerAllocationCount (%u) samplers already exist, reusing a similar sampler\n", maxSamplerCount);
+		return FindClosest(key);
+	}
+
+	VkSampler sampler;
+	VkResult err = vkCreateSampler(device, &key.info, HostAllocator::callbacks, &sampler);
+
+	if (err != VK_SUCCESS)
+		ERR_EXIT("vkCreateSampler failed", "Sampler Cache Failure");
+
+	samplers[key] = sampler;
+	return sampler;
+}
+
+uint32_t SamplerCache::GetSamplerCount()
+{
+	return (uint32_t)samplers.size();
+}
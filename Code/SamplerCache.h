@@ -0,0 +1,74 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <unordered_map>
+
+// the most anisotropy that we ask for, the cache
+// lowers it to what the GPU supports
+#define SAMPLER_MAX_ANISOTROPY 16.0f
+
+// Everything in a VkSamplerCreateInfo, other than sType and pNext.
+// The unused bytes (padding) are always zero, so two keys
+// can be compared and hashed as plain bytes
+struct SamplerKey
+{
+	VkSamplerCreateInfo info;
+
+	bool operator==(const SamplerKey& other) const;
+};
+
+struct SamplerKeyHash
+{
+	size_t operator()(const SamplerKey& key) const;
+};
+
+// Every sampler in the program comes from here. Two textures that ask
+// for the same sampler get the same VkSampler, so there are only as many
+// samplers as there are different ways to read textures, which matters
+// because a GPU can have as few as 4000 samplers at once
+class SamplerCache
+{
+private:
+	VkDevice device;
+	uint32_t maxSamplerCount;
+	bool anisotropyEnabled;
+	float maxAnisotropy;
+
+	std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash> samplers;
+
+	SamplerKey MakeKey(const VkSamplerCreateInfo& info);
+	VkSampler FindClosest(const SamplerKey& key);
+
+public:
+	SamplerCache(VkDevice d, VkPhysicalDevice gpu, bool anisotropy);
+	~SamplerCache();
+
+	VkSampler Get(const VkSamplerCreateInfo& info);
+
+	uint32_t GetSamplerCount();
+};
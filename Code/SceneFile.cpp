@@ -0,0 +1,227 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "SceneFile.h"
+#include <stdio.h>
+#include <string.h>
+
+// Saving the scene as text (or as one record for each object) would
+// mean parsing every object again when it is loaded, which is slower
+// than generating it. Every array of the file is one section instead,
+// that can be used right where it is mapped, or copied with one memcpy
+
+// rounds an offset up to the next section boundary
+static uint64_t AlignSection(uint64_t offset)
+{
+	return (offset + SCENE_SECTION_ALIGNMENT - 1) & ~(uint64_t)(SCENE_SECTION_ALIGNMENT - 1);
+}
+
+SceneFile::SceneFile()
+{
+	objectCount = 0;
+	meshCount = 0;
+	textureCount = 0;
+	animatedCount = 0;
+	instanceCount = 0;
+	seed = 0;
+	objectTransforms = nullptr;
+	objectMeshes = nullptr;
+	objectTextures = nullptr;
+	animated = nullptr;
+	meshScales = nullptr;
+	instanceTransforms = nullptr;
+	instanceModels = nullptr;
+}
+
+bool SceneFile::Load(const char* path)
+{
+	if (!file.Open(path))
+		return false;
+
+	return Parse(file.GetData(), file.GetSize(), path);
+}
+
+void SceneFile::Close()
+{
+	file.Close();
+	objectTransforms = nullptr;
+	objectMeshes = nullptr;
+	objectTextures = nullptr;
+	animated = nullptr;
+	meshScales = nullptr;
+	instanceTransforms = nullptr;
+	instanceModels = nullptr;
+}
+
+bool SceneFile::Parse(const char* data, size_t size, const char* name)
+{
+	SceneFileHeader header;
+
+	if (size < sizeof(header))
+	{
+		printf("%s is not a scene file\n", name);
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(header));
+
+	if (header.magic != SCENE_FILE_MAGIC || header.version != SCENE_FILE_VERSION)
+	{
+		printf("%s is not a scene file that we can load\n", name);
+		return false;
+	}
+
+	// make sure that every section is inside of the file,
+	// and starts on a boundary, so nothing can read past the end
+	uint64_t transformSize = (uint64_t)header.objectCount * SCENE_TRANSFORM_FLOATS * sizeof(float);
+	uint64_t objectSize = (uint64_t)header.objectCount * sizeof(uint32_t);
+
+	struct Section { uint64_t offset; uint64_t size; };
+	Section sections[] =
+	{
+		{ header.objectTransformOffset, transformSize },
+		{ header.objectMeshOffset, objectSize },
+		{ header.objectTextureOffset, objectSize },
+		{ header.animatedOffset, (uint64_t)header.animatedCount * sizeof(uint32_t) },
+		{ header.meshScaleOffset, (uint64_t)header.meshCount * sizeof(glm::vec3) },
+		{ header.instanceTransformOffset, (uint64_t)header.instanceCount * SCENE_TRANSFORM_FLOATS * sizeof(float) },
+		{ header.instanceModelOffset, (uint64_t)header.instanceCount * sizeof(glm::mat4) }
+	};
+
+	for (const Section& section : sections)
+	{
+		if (section.offset + section.size > (uint64_t)size || (section.offset % SCENE_SECTION_ALIGNMENT) != 0)
+		{
+			printf("%s has a section outside of the file\n", name);
+			return false;
+		}
+	}
+
+	if (header.objectCount == 0 || header.meshCount == 0 || header.textureCount == 0 || header.animatedCount > header.objectCount)
+	{
+		printf("%s has %u objects, %u meshes, and %u textures\n", name, header.objectCount, header.meshCount, header.textureCount);
+		return false;
+	}
+
+	// The references are the only thing that is checked one at a time,
+	// a mesh or a texture that does not exist would be read out of
+	// bounds later. This is only a compare for each, nothing is parsed
+	const uint32_t* fileMeshes = (const uint32_t*)(data + header.objectMeshOffset);
+	const uint32_t* fileTextures = (const uint32_t*)(data + header.objectTextureOffset);
+	const uint32_t* fileAnimated = (const uint32_t*)(data + header.animatedOffset);
+	uint32_t badReferences = 0;
+
+	for (uint32_t i = 0; i < header.objectCount; i++)
+		badReferences += (fileMeshes[i] >= header.meshCount) + (fileTextures[i] >= header.textureCount);
+
+	for (uint32_t i = 0; i < header.animatedCount; i++)
+		badReferences += (fileAnimated[i] >= header.objectCount);
+
+	if (badReferences > 0)
+	{
+		printf("%s has %u references to meshes, textures, or objects that it does not have\n", name, badReferences);
+		return false;
+	}
+
+	objectCount = header.objectCount;
+	meshCount = header.meshCount;
+	textureCount = header.textureCount;
+	animatedCount = header.animatedCount;
+	instanceCount = header.instanceCount;
+	seed = header.seed;
+
+	objectTransforms = (const float*)(data + header.objectTransformOffset);
+	objectMeshes = fileMeshes;
+	objectTextures = fileTextures;
+	animated = fileAnimated;
+	meshScales = (const glm::vec3*)(data + header.meshScaleOffset);
+	instanceTransforms = (const float*)(data + header.instanceTransformOffset);
+	instanceModels = (const glm::mat4*)(data + header.instanceModelOffset);
+
+	return true;
+}
+
+std::vector<char> SceneFile::Build(
+	TransformArrays* objects,
+	const uint32_t* meshes,
+	const uint32_t* textures,
+	uint32_t animatedCount,
+	const uint32_t* animatedObjects,
+	uint32_t meshCount,
+	const glm::vec3* scales,
+	uint32_t textureCount,
+	uint32_t sceneSeed,
+	TransformStore* instances)
+{
+	uint32_t objectCount = objects->GetCount();
+	uint32_t instanceCount = (instances != nullptr) ? instances->GetCount() : 0;
+
+	// The header is first, then each section in the order of the
+	// header, each one starting on a section boundary
+	SceneFileHeader header = {};
+	header.magic = SCENE_FILE_MAGIC;
+	header.version = SCENE_FILE_VERSION;
+	header.objectCount = objectCount;
+	header.meshCount = meshCount;
+	header.textureCount = textureCount;
+	header.animatedCount = animatedCount;
+	header.instanceCount = instanceCount;
+	header.seed = sceneSeed;
+
+	uint64_t transformSize = (uint64_t)objectCount * SCENE_TRANSFORM_FLOATS * sizeof(float);
+	uint64_t objectSize = (uint64_t)objectCount * sizeof(uint32_t);
+	uint64_t instanceTransformSize = (uint64_t)instanceCount * SCENE_TRANSFORM_FLOATS * sizeof(float);
+	uint64_t instanceModelSize = (uint64_t)instanceCount * sizeof(glm::mat4);
+
+	header.objectTransformOffset = AlignSection(sizeof(header));
+	header.objectMeshOffset = AlignSection(header.objectTransformOffset + transformSize);
+	header.objectTextureOffset = AlignSection(header.objectMeshOffset + objectSize);
+	header.animatedOffset = AlignSection(header.objectTextureOffset + objectSize);
+	header.meshScaleOffset = AlignSection(header.animatedOffset + (uint64_t)animatedCount * sizeof(uint32_t));
+	header.instanceTransformOffset = AlignSection(header.meshScaleOffset + (uint64_t)meshCount * sizeof(glm::vec3));
+	header.instanceModelOffset = AlignSection(header.instanceTransformOffset + instanceTransformSize);
+
+	// the padding between sections is filled with zeros
+	std::vector<char> bytes((size_t)(header.instanceModelOffset + instanceModelSize), 0);
+	char* out = bytes.data();
+	memcpy(out, &header, sizeof(header));
+
+	objects->Store((float*)(out + header.objectTransformOffset));
+	memcpy(out + header.objectMeshOffset, meshes, (size_t)objectSize);
+	memcpy(out + header.objectTextureOffset, textures, (size_t)objectSize);
+
+	if (animatedCount > 0)
+		memcpy(out + header.animatedOffset, animatedObjects, animatedCount * sizeof(uint32_t));
+
+	memcpy(out + header.meshScaleOffset, scales, meshCount * sizeof(glm::vec3));
+
+	if (instanceCount > 0)
+	{
+		instances->GetTransforms()->Store((float*)(out + header.instanceTransformOffset));
+		memcpy(out + header.instanceModelOffset, instances->GetModels(), (size_t)instanceModelSize);
+	}
+
+	return bytes;
+}
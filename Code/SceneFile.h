@@ -0,0 +1,139 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "Helper.h"
+#include "TransformBatch.h"
+#include "TransformStore.h"
+
+// "VSCN" in the first four bytes of the file
+#define SCENE_FILE_MAGIC 0x4E435356
+#define SCENE_FILE_VERSION 1
+
+// every section of the file starts at a multiple of this,
+// so the mapped matrices and arrays are always aligned
+#define SCENE_SECTION_ALIGNMENT 16
+
+// the position, rotation, and scale of one object are ten
+// floats, in ten arrays, in the order of TransformArrays
+#define SCENE_TRANSFORM_FLOATS 10
+
+// The file starts with this header. Every section is found by its
+// offset from the start of the file, there are no pointers in the
+// file, so it can be mapped at any address. The size of each section
+// comes from the counts. The arrays are stored exactly the way that
+// TransformArrays, SceneGenerator, and the instance buffer have them,
+// so loading a scene is only mapping the file and copying each section
+struct SceneFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t objectCount;
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t animatedCount;
+	uint32_t instanceCount;
+
+	// the seed of the scene that was saved, only to print it
+	uint32_t seed;
+
+	// objectCount * SCENE_TRANSFORM_FLOATS floats
+	uint64_t objectTransformOffset;
+
+	// the mesh and the texture of every object, as a uint32_t
+	uint64_t objectMeshOffset;
+	uint64_t objectTextureOffset;
+
+	// the objects that spin, in order
+	uint64_t animatedOffset;
+
+	// 3 floats for each mesh, see SceneGenerator::meshScales
+	uint64_t meshScaleOffset;
+
+	// instanceCount * SCENE_TRANSFORM_FLOATS floats, and then
+	// the model matrix of every instance, which is what the
+	// instance buffer has, so it can be uploaded from the file
+	uint64_t instanceTransformOffset;
+	uint64_t instanceModelOffset;
+};
+
+// A snapshot of the generated scene (and the instances of the cube),
+// which is written once, and then mapped by every run after that, so
+// a scene of a million objects does not have to be made again from
+// random numbers, one object at a time. Like MeshFile, the file is
+// mapped, not read, and every pointer points into the mapped file
+class SceneFile
+{
+private:
+	MappedFile file;
+
+public:
+	uint32_t objectCount;
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t animatedCount;
+	uint32_t instanceCount;
+	uint32_t seed;
+
+	// these point into the mapped file
+	// (or into the memory given to Parse)
+	const float* objectTransforms;
+	const uint32_t* objectMeshes;
+	const uint32_t* objectTextures;
+	const uint32_t* animated;
+	const glm::vec3* meshScales;
+	const float* instanceTransforms;
+	const glm::mat4* instanceModels;
+
+	SceneFile();
+
+	// returns false if the file does not exist,
+	// or if it is not a scene file that we can use
+	bool Load(const char* path);
+
+	// unmaps the file, the sections can not be used after this
+	void Close();
+
+	// reads a scene that is already in memory, the
+	// memory has to exist as long as the SceneFile does
+	bool Parse(const char* data, size_t size, const char* name);
+
+	// Makes the bytes of a scene file, they can be saved with
+	// Helper::WriteFile, or given to Parse. instances can be
+	// nullptr, then the file has no instances
+	static std::vector<char> Build(
+		TransformArrays* objects,
+		const uint32_t* meshes,
+		const uint32_t* textures,
+		uint32_t animatedCount,
+		const uint32_t* animatedObjects,
+		uint32_t meshCount,
+		const glm::vec3* scales,
+		uint32_t textureCount,
+		uint32_t sceneSeed,
+		TransformStore* instances);
+};
@@ -0,0 +1,173 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "SceneGenerator.h"
+#include "SceneFile.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <glm/gtc/packing.hpp>
+
+// the objects of the grid are this far apart, like in prepare_scene
+#define SCENE_SPACING 3.0f
+
+float SceneGenerator::Random()
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (float)(state >> 8) / (float)(1 << 24);
+}
+
+SceneGenerator::SceneGenerator(SceneParams p)
+{
+	params = p;
+	params.objectCount = std::max(1u, std::min(params.objectCount, 1000000u));
+	params.meshCount = std::max(1u, params.meshCount);
+	params.textureCount = std::max(1u, params.textureCount);
+	params.animatedFraction = std::max(0.0f, std::min(params.animatedFraction, 1.0f));
+
+	// xorshift can not start at 0
+	state = (params.seed != 0) ? params.seed : 1;
+
+	// The grid is as wide as it is deep, and a quarter of that high, so
+	// that the camera sees a big part of it. The first row is in front
+	uint32_t side = (uint32_t)ceil(cbrt((double)params.objectCount * 4.0));
+	uint32_t height = std::max(1u, (side + 3) / 4);
+
+	positions.resize(params.objectCount);
+	meshes.resize(params.objectCount);
+	textures.resize(params.objectCount);
+
+	for (uint32_t i = 0; i < params.objectCount; i++)
+	{
+		uint32_t x = i % side;
+		uint32_t z = (i / side) % side;
+		uint32_t y = i / (side * side);
+
+		// the noise is small enough that two objects never touch
+		glm::vec3 noise(Random() - 0.5f, Random() - 0.5f, Random() - 0.5f);
+
+		positions[i] = glm::vec3(
+			((float)x - (float)(side - 1) / 2.0f),
+			((float)y - (float)(height - 1) / 2.0f),
+			-(float)z) * SCENE_SPACING + noise;
+
+		meshes[i] = (uint32_t)(Random() * params.meshCount) % params.meshCount;
+		textures[i] = (uint32_t)(Random() * params.textureCount) % params.textureCount;
+
+		if (Random() < params.animatedFraction)
+			animated.push_back(i);
+	}
+
+	// The first mesh is the cube itself, the others are smaller on
+	// some of the axes, never bigger, so that the radius of the cube
+	// still covers every mesh for culling and the LOD
+	meshScales.resize(params.meshCount);
+	meshScales[0] = glm::vec3(1.0f);
+
+	for (uint32_t m = 1; m < params.meshCount; m++)
+		meshScales[m] = glm::vec3(0.5f + 0.5f * Random(), 0.5f + 0.5f * Random(), 0.5f + 0.5f * Random());
+}
+
+SceneGenerator::SceneGenerator(const SceneFile& file)
+{
+	params.objectCount = file.objectCount;
+	params.meshCount = file.meshCount;
+	params.textureCount = file.textureCount;
+	params.animatedFraction = (float)file.animatedCount / (float)file.objectCount;
+	params.seed = file.seed;
+	state = (params.seed != 0) ? params.seed : 1;
+
+	// The positions are the first three arrays of the transforms in the
+	// file, which prepare_scene loads as they are. These are only for
+	// anyone else who asks the generator where an object is
+	positions.resize(file.objectCount);
+
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		const float* axis = file.objectTransforms + (size_t)c * file.objectCount;
+
+		for (uint32_t i = 0; i < file.objectCount; i++)
+			positions[i][c] = axis[i];
+	}
+
+	meshes.assign(file.objectMeshes, file.objectMeshes + file.objectCount);
+	textures.assign(file.objectTextures, file.objectTextures + file.objectCount);
+	animated.assign(file.animated, file.animated + file.animatedCount);
+	meshScales.assign(file.meshScales, file.meshScales + file.meshCount);
+}
+
+void SceneGenerator::BuildMesh(uint32_t mesh, const MeshFile& base, std::vector<char>* vertices)
+{
+	vertices->assign(base.vertices, base.vertices + (size_t)base.vertexCount * base.vertexStride);
+
+	glm::vec3 scale = meshScales[mesh];
+
+	// the position is at the start of both vertex formats,
+	// everything after it (the UV, the normal) stays the same
+	for (uint32_t v = 0; v < base.vertexCount; v++)
+	{
+		char* vertex = vertices->data() + (size_t)v * base.vertexStride;
+
+		if (base.vertexFormat == MESH_VERTEX_COMPACT)
+		{
+			uint16_t half[3];
+			memcpy(half, vertex, sizeof(half));
+
+			for (uint32_t c = 0; c < 3; c++)
+				half[c] = glm::packHalf1x16(glm::unpackHalf1x16(half[c]) * scale[c]);
+
+			memcpy(vertex, half, sizeof(half));
+		}
+		else
+		{
+			glm::vec3 p;
+			memcpy(&p, vertex, sizeof(p));
+			p *= scale;
+			memcpy(vertex, &p, sizeof(p));
+		}
+	}
+}
+
+void SceneGenerator::BuildTexture(uint32_t texture, std::vector<uint32_t>* pixels)
+{
+	// Every texture gets a color from its index, the golden
+	// ratio spreads the colors of the first ones far apart
+	float hue = fmodf((float)texture * 0.618034f, 1.0f);
+	glm::vec3 color = glm::clamp(glm::abs(glm::fract(glm::vec3(hue) + glm::vec3(1.0f, 2.0f / 3.0f, 1.0f / 3.0f)) * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+
+	uint32_t light = 0xff000000 |
+		((uint32_t)(color.b * 255.0f) << 16) |
+		((uint32_t)(color.g * 255.0f) << 8) |
+		(uint32_t)(color.r * 255.0f);
+	uint32_t dark = 0xff000000 | ((light >> 1) & 0x007f7f7f);
+
+	pixels->resize(SCENE_TEXTURE_SIZE * SCENE_TEXTURE_SIZE);
+
+	for (uint32_t y = 0; y < SCENE_TEXTURE_SIZE; y++)
+		for (uint32_t x = 0; x < SCENE_TEXTURE_SIZE; x++)
+			(*pixels)[y * SCENE_TEXTURE_SIZE + x] = (((x / 8) + (y / 8)) & 1) ? dark : light;
+}
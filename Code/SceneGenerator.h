@@ -0,0 +1,99 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MeshFile.h"
+
+class SceneFile;
+
+// The textures that the generator makes are this many
+// pixels on each side, small enough that thousands fit
+#define SCENE_TEXTURE_SIZE 64
+
+// What the generated scene looks like. The same parameters (and the
+// same seed) always make the same scene, so two runs of the benchmark
+// with different renderer paths draw exactly the same thing
+struct SceneParams
+{
+	// how many objects, from 1 to 1000000
+	uint32_t objectCount;
+
+	// how many different meshes, and textures, the objects use.
+	// Each one is its own range of the mesh pool, or its own image,
+	// so more of them means fewer draws that look the same to the GPU
+	uint32_t meshCount;
+	uint32_t textureCount;
+
+	// how many of the objects (from 0 to 1) spin in every frame,
+	// the others keep the rotation that they started with
+	float animatedFraction;
+
+	uint32_t seed;
+};
+
+// Makes a scene of any size for the stress tests, out of the cube. The
+// objects fill a box (a grid with a little bit of noise), the meshes are
+// the cube stretched in different ways, and the textures are checkerboards
+// of different colors. It only makes the data, Demo puts it into the mesh
+// pool, the bindless textures, and the transforms (see prepare_scene)
+class SceneGenerator
+{
+private:
+	uint32_t state;
+
+	// a random number with xorshift, from 0 to 1
+	float Random();
+
+public:
+	SceneParams params;
+
+	// for every object, where it is,
+	// and which mesh and texture it uses
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> meshes;
+	std::vector<uint32_t> textures;
+
+	// the objects that spin, in order
+	std::vector<uint32_t> animated;
+
+	// how much each mesh is stretched, on each axis
+	std::vector<glm::vec3> meshScales;
+
+	SceneGenerator(SceneParams p);
+
+	// the scene that was saved in a SceneFile, the arrays are
+	// copied, so the file can be closed after this
+	SceneGenerator(const SceneFile& file);
+
+	// a copy of the vertices of the base mesh (in its own
+	// format), with the positions multiplied by meshScales[mesh]
+	void BuildMesh(uint32_t mesh, const MeshFile& base, std::vector<char>* vertices);
+
+	// SCENE_TEXTURE_SIZE * SCENE_TEXTURE_SIZE RGBA pixels
+	void BuildTexture(uint32_t texture, std::vector<uint32_t>* pixels);
+};
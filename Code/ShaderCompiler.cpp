@@ -0,0 +1,156 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "ShaderCompiler.h"
+#include "Helper.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <windows.h>
+
+// Before the compiler, a shader could only be changed by running
+// compileShaders.cmd, which makes the .inc files, and then
+// building the program again. The .inc files are still there, and
+// Demo uses them whenever a shader can not be compiled here
+
+ShaderCompiler::ShaderCompiler()
+{
+	compiler = shaderc_compiler_initialize();
+	options = shaderc_compile_options_initialize();
+
+	// the same as the .inc files, which are optimized and stripped
+	// of debug information by spirv-opt in compileShaders.cmd
+	shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+	shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+
+	cacheHits = 0;
+	compileCount = 0;
+
+	// make the cache folder, if it is not there yet
+	CreateDirectory(SHADER_CACHE_DIR, NULL);
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+	shaderc_compile_options_release(options);
+	shaderc_compiler_release(compiler);
+}
+
+uint64_t ShaderCompiler::Hash(const char* data, size_t size, uint64_t hash)
+{
+	// FNV-1a, continuing from the hash that is given
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (uint8_t)data[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+shaderc_shader_kind ShaderCompiler::GetKind(VkShaderStageFlagBits stage)
+{
+	if (stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+		return shaderc_glsl_fragment_shader;
+
+	if (stage == VK_SHADER_STAGE_COMPUTE_BIT)
+		return shaderc_glsl_compute_shader;
+
+	return shaderc_glsl_vertex_shader;
+}
+
+bool ShaderCompiler::Compile(const char* name, VkShaderStageFlagBits stage, std::vector<uint32_t>* spirv)
+{
+	std::string path = std::string(SHADER_SOURCE_DIR) + name;
+
+	// If the source file is not there (the program was copied
+	// somewhere else), the caller uses its .inc file instead
+	MappedFile source;
+	if (!source.Open(path.c_str()))
+		return false;
+
+	// The name of the cache file is the hash of everything that
+	// changes the result: the source, the stage, and the options
+	uint64_t hash = 14695981039346656037ull;
+	uint32_t header[2] = { SHADER_CACHE_VERSION, (uint32_t)stage };
+	hash = Hash((const char*)header, sizeof(header), hash);
+	hash = Hash(source.GetData(), source.GetSize(), hash);
+
+	char cachePath[256];
+	sprintf(cachePath, "%s/%s.%016llx.spv", SHADER_CACHE_DIR, name, (unsigned long long)hash);
+
+	// A warm start, the shader did not change since it was compiled,
+	// so the SPIR-V is read from the cache. It has to start with the
+	// SPIR-V magic number, or the file is broken, and we compile again
+	MappedFile cached;
+	if (cached.Open(cachePath) && (cached.GetSize() % 4) == 0 &&
+		*(const uint32_t*)cached.GetData() == 0x07230203)
+	{
+		spirv->resize(cached.GetSize() / 4);
+		memcpy(spirv->data(), cached.GetData(), cached.GetSize());
+		cacheHits++;
+		return true;
+	}
+
+	cached.Close();
+
+	shaderc_compilation_result_t result = shaderc_compile_into_spv(
+		compiler, source.GetData(), source.GetSize(),
+		GetKind(stage), name, "main", options);
+
+	// if the shader has an error, print it, and let
+	// the caller use the shader that it already had
+	if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success)
+	{
+		printf("Failed to compile %s:\n%s\n", name, shaderc_result_get_error_message(result));
+		shaderc_result_release(result);
+		return false;
+	}
+
+	size_t size = shaderc_result_get_length(result);
+	spirv->resize(size / 4);
+	memcpy(spirv->data(), shaderc_result_get_bytes(result), size);
+	shaderc_result_release(result);
+
+	compileCount++;
+
+	if (!Helper::WriteFile(cachePath, spirv->data(), size))
+		printf("Failed to save %s to the shader cache\n", name);
+
+	return true;
+}
+
+uint64_t ShaderCompiler::GetWriteTime(const char* name)
+{
+	std::string path = std::string(SHADER_SOURCE_DIR) + name;
+
+	// This only reads the file's information from the file
+	// system, not the file itself, so it is cheap to call often
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &info))
+		return 0;
+
+	return ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+}
@@ -0,0 +1,72 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <shaderc/shaderc.h>
+#include <vector>
+
+// where the GLSL files are, from the folder that the program runs in
+// (the same way that Assets/logo.png is found)
+#define SHADER_SOURCE_DIR "../../../Code/"
+
+// compiled shaders are saved in this folder, one file for each
+// source file, named after the hash of the source file
+#define SHADER_CACHE_DIR "shader_cache"
+
+// Change this when the compile options change, so that
+// shaders in the cache that were compiled with the old
+// options are not used anymore
+#define SHADER_CACHE_VERSION 1
+
+// Compiles GLSL to SPIR-V while the program runs, with shaderc.
+// Each result is saved in SHADER_CACHE_DIR, by the hash of the
+// source, so the next time the program runs, a shader that did not
+// change is read from the cache, and is never compiled again
+class ShaderCompiler
+{
+private:
+	shaderc_compiler_t compiler;
+	shaderc_compile_options_t options;
+
+	static uint64_t Hash(const char* data, size_t size, uint64_t hash);
+	static shaderc_shader_kind GetKind(VkShaderStageFlagBits stage);
+
+public:
+	ShaderCompiler();
+	~ShaderCompiler();
+
+	// how many shaders came from the cache, and
+	// how many had to be compiled
+	uint32_t cacheHits;
+	uint32_t compileCount;
+
+	bool Compile(const char* name, VkShaderStageFlagBits stage, std::vector<uint32_t>* spirv);
+
+	// when the source file was last saved,
+	// or zero if it is not there
+	uint64_t GetWriteTime(const char* name);
+};
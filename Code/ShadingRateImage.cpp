@@ -0,0 +1,130 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "ShadingRateImage.h"
+#include "DeviceTable.h"
+#include <math.h>
+
+ShadingRateImage::ShadingRateImage(
+	VkDevice d,
+	MemoryAllocator* a,
+	uint32_t windowWidth,
+	uint32_t windowHeight,
+	VkExtent2D texel,
+	uint32_t frameLag)
+{
+	device = d;
+	texelSize = texel;
+
+	// rounded up, so that the last pixels of the
+	// window are covered by a texel too
+	width = (windowWidth + texel.width - 1) / texel.width;
+	height = (windowHeight + texel.height - 1) / texel.height;
+
+	// nothing is in the image yet
+	renderWidth = 0;
+	renderHeight = 0;
+
+	// It is only ever copied into, and read by the rasterizer
+	VkImageCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	info.imageType = VK_IMAGE_TYPE_2D;
+	info.format = VK_FORMAT_R8_UINT;
+	info.extent.width = width;
+	info.extent.height = height;
+	info.extent.depth = 1;
+	info.mipLevels = 1;
+	info.arrayLayers = 1;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.usage = VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+	image = new TextureGPU(device, a, info, VK_IMAGE_ASPECT_COLOR_BIT);
+	image->SetName("Shading rate");
+	image->format = info.format;
+
+	// the offset of a copy has to be a multiple of 4
+	sliceSize = ((VkDeviceSize)width * height + 3) & ~(VkDeviceSize)3;
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.size = sliceSize * frameLag;
+
+	staging = BufferCPU(device, a, bufferInfo, true);
+	staging.SetName("Shading rate staging");
+}
+
+ShadingRateImage::~ShadingRateImage()
+{
+	staging.Destroy();
+	delete image;
+}
+
+bool ShadingRateImage::Update(uint32_t slot, uint32_t drawWidth, uint32_t drawHeight)
+{
+	if (drawWidth == renderWidth && drawHeight == renderHeight)
+		return false;
+
+	renderWidth = drawWidth;
+	renderHeight = drawHeight;
+
+	// The distance of each texel from the middle of the part that is
+	// drawn, where 1 is the edge, so the rings are ellipses with the
+	// shape of the screen. Inside of half of the way to the edge every
+	// pixel is shaded, then 2x2, and past 80% of the way, 4x4
+	uint8_t* rates = (uint8_t*)staging.GetPointer() + slot * sliceSize;
+
+	float centerX = drawWidth * 0.5f;
+	float centerY = drawHeight * 0.5f;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			float dx = ((x + 0.5f) * texelSize.width - centerX) / centerX;
+			float dy = ((y + 0.5f) * texelSize.height - centerY) / centerY;
+			float distance = sqrtf(dx * dx + dy * dy);
+
+			uint8_t rate = SHADING_RATE_4X4;
+
+			if (distance < 0.5f)
+				rate = SHADING_RATE_1X1;
+			else if (distance < 0.8f)
+				rate = SHADING_RATE_2X2;
+
+			rates[y * width + x] = rate;
+		}
+	}
+
+	staging.Flush(slot * sliceSize, sliceSize);
+	return true;
+}
+
+void ShadingRateImage::Record(VkCommandBuffer cmd, uint32_t slot)
+{
+	VkBufferImageCopy region = image->GetRegion((int)width, (int)height, slot * sliceSize);
+	DeviceTable::CmdCopyBufferToImage(cmd, staging.buffer, image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
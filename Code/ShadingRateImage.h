@@ -0,0 +1,88 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "MemoryAllocator.h"
+#include "BufferCPU.h"
+#include "TextureGPU.h"
+#include "FragmentShadingRate.h"
+
+// the rates that a texel of the image can have, each one is
+// (log2(width) << 2) | log2(height) of the size of the fragments
+#define SHADING_RATE_1X1 0
+#define SHADING_RATE_2X2 5
+#define SHADING_RATE_4X4 10
+
+// The shading rate attachment of dynamic rendering. Every texel of it
+// covers texelSize pixels of the screen, and says how big the fragments
+// are in that part of the screen. The middle of the screen, where the
+// player looks, is shaded at every pixel, and the edges of the screen
+// are shaded once for every 2x2 or 4x4 pixels, which cuts the fragment
+// shader invocations by a lot, where it is hard to see the difference.
+// It depends on the size of the window, like the depth pyramid, so it
+// is made again (and retired) with the depth buffer
+class ShadingRateImage
+{
+private:
+	VkDevice device;
+
+	// Every frame in flight has its own slice of rates, the
+	// CPU writes one slice while the GPU copies another one
+	BufferCPU staging;
+	VkDeviceSize sliceSize;
+
+public:
+	// R8_UINT, one texel for every texelSize pixels
+	TextureGPU* image;
+	VkExtent2D texelSize;
+	uint32_t width;
+	uint32_t height;
+
+	// the part of the window that the rates were made for, with
+	// dynamic resolution, only the top left of the window is drawn
+	uint32_t renderWidth;
+	uint32_t renderHeight;
+
+	ShadingRateImage(
+		VkDevice d,
+		MemoryAllocator* a,
+		uint32_t windowWidth,
+		uint32_t windowHeight,
+		VkExtent2D texel,
+		uint32_t frameLag);
+
+	~ShadingRateImage();
+
+	// Writes the rates for the size that is drawn this frame
+	// into the slice of this slot, if they are not already
+	// in the image. It returns true if Record has to copy them
+	bool Update(uint32_t slot, uint32_t drawWidth, uint32_t drawHeight);
+
+	// copies the slice of this slot into the image, the
+	// frame graph makes the image TRANSFER_DST before it
+	void Record(VkCommandBuffer cmd, uint32_t slot);
+};
@@ -0,0 +1,381 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "ShadowCache.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+
+// the depth bias of the shadow casters, so that a surface that
+// is lit does not shadow itself, where the depth of the map and
+// the depth of the pixel are almost the same
+#define SHADOW_DEPTH_BIAS_CONSTANT 1.25f
+#define SHADOW_DEPTH_BIAS_SLOPE 1.75f
+
+ShadowCache::ShadowCache(VkDevice d, MemoryAllocator* a)
+{
+	device = d;
+	pipelineLayout = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+
+	staticValid = false;
+	dynamicEmpty = false;
+	staticDraws = 0;
+	dynamicDraws = 0;
+
+	// The static layer is only a source of the copy. The dynamic
+	// layer is the destination, and the shaders sample it
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = SHADOW_MAP_FORMAT;
+	imageInfo.extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	staticMap = new TextureGPU(device, a, imageInfo, VK_IMAGE_ASPECT_DEPTH_BIT);
+	staticMap->SetName("Shadow map (static)");
+
+	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	dynamicMap = new TextureGPU(device, a, imageInfo, VK_IMAGE_ASPECT_DEPTH_BIT);
+	dynamicMap->SetName("Shadow map (dynamic)");
+
+	// The static layer throws away what it had, and the copy reads
+	// it after the pass. The dynamic layer keeps the copy, and the
+	// fragment shaders of the next passes read it
+	staticPass = CreateRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+	dynamicPass = CreateRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	VkFramebufferCreateInfo fbInfo = {};
+	fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	fbInfo.attachmentCount = 1;
+	fbInfo.width = SHADOW_MAP_SIZE;
+	fbInfo.height = SHADOW_MAP_SIZE;
+	fbInfo.layers = 1;
+
+	fbInfo.renderPass = staticPass;
+	fbInfo.pAttachments = &staticMap->imageView;
+	vkCreateFramebuffer(device, &fbInfo, HostAllocator::callbacks, &staticFramebuffer);
+
+	fbInfo.renderPass = dynamicPass;
+	fbInfo.pAttachments = &dynamicMap->imageView;
+	vkCreateFramebuffer(device, &fbInfo, HostAllocator::callbacks, &dynamicFramebuffer);
+}
+
+ShadowCache::~ShadowCache()
+{
+	if (pipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	if (pipelineLayout != VK_NULL_HANDLE)
+		vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+
+	vkDestroyFramebuffer(device, staticFramebuffer, HostAllocator::callbacks);
+	vkDestroyFramebuffer(device, dynamicFramebuffer, HostAllocator::callbacks);
+	vkDestroyRenderPass(device, staticPass, HostAllocator::callbacks);
+	vkDestroyRenderPass(device, dynamicPass, HostAllocator::callbacks);
+
+	delete staticMap;
+	delete dynamicMap;
+}
+
+VkRenderPass ShadowCache::CreateRenderPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkImageLayout finalLayout,
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	VkAttachmentDescription attachment = {};
+	attachment.format = SHADOW_MAP_FORMAT;
+	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp = loadOp;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout = initialLayout;
+	attachment.finalLayout = finalLayout;
+
+	VkAttachmentReference depthReference = {};
+	depthReference.attachment = 0;
+	depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.pDepthStencilAttachment = &depthReference;
+
+	// The first dependency waits for whoever read the layer before
+	// (the copy of an earlier frame, or a shader), so the pass does not
+	// write it while it is still being read. The depth that the pass
+	// wrote is read after it, by the copy or by a shader
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = 0;
+	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].dstStageMask = dstStage;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = dstAccess;
+
+	VkRenderPassCreateInfo rpInfo = {};
+	rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	rpInfo.attachmentCount = 1;
+	rpInfo.pAttachments = &attachment;
+	rpInfo.subpassCount = 1;
+	rpInfo.pSubpasses = &subpass;
+	rpInfo.dependencyCount = 2;
+	rpInfo.pDependencies = dependencies;
+
+	VkRenderPass pass = VK_NULL_HANDLE;
+
+	if (vkCreateRenderPass(device, &rpInfo, HostAllocator::callbacks, &pass) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the render pass of the shadow map\n", "Render Pass Failure");
+	}
+
+	return pass;
+}
+
+void ShadowCache::PreparePipeline(VkPipelineCache cache, VkFormat positionFormat, uint32_t positionStride)
+{
+	// the matrix of each caster is pushed, nothing else is bound
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(glm::mat4);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &layoutInfo, HostAllocator::callbacks, &pipelineLayout);
+
+	// The same vertex shader as the depth pre-pass with push
+	// constants, and no fragment shader, only depth is written
+	const unsigned char vs_code[] = {
+		#include "cube_depth_push.vert.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = (uint32_t*)vs_code;
+	shaderInfo.codeSize = sizeof(vs_code);
+
+	VkShaderModule vertModule;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &vertModule);
+
+	VkPipelineShaderStageCreateInfo stage = {};
+	stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stage.module = vertModule;
+	stage.pName = "main";
+
+	// the position buffer of the mesh pool, see prepare_vb_ib
+	VkVertexInputBindingDescription binding = {};
+	binding.binding = 0;
+	binding.stride = positionStride;
+	binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	VkVertexInputAttributeDescription attribute = {};
+	attribute.location = 0;
+	attribute.binding = 0;
+	attribute.format = positionFormat;
+	attribute.offset = 0;
+
+	VkPipelineVertexInputStateCreateInfo vi = {};
+	vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vi.vertexBindingDescriptionCount = 1;
+	vi.pVertexBindingDescriptions = &binding;
+	vi.vertexAttributeDescriptionCount = 1;
+	vi.pVertexAttributeDescriptions = &attribute;
+
+	VkPipelineInputAssemblyStateCreateInfo ia = {};
+	ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	// the map never changes size, so the viewport is in the pipeline
+	VkViewport viewport = {};
+	viewport.width = (float)SHADOW_MAP_SIZE;
+	viewport.height = (float)SHADOW_MAP_SIZE;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent.width = SHADOW_MAP_SIZE;
+	scissor.extent.height = SHADOW_MAP_SIZE;
+
+	VkPipelineViewportStateCreateInfo vp = {};
+	vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	vp.viewportCount = 1;
+	vp.pViewports = &viewport;
+	vp.scissorCount = 1;
+	vp.pScissors = &scissor;
+
+	// Both sides of every triangle are drawn, from the light, the back
+	// of a cube is as much in the way as the front. The bias pushes the
+	// depth away from the light, more where the surface is steep
+	VkPipelineRasterizationStateCreateInfo rs = {};
+	rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rs.polygonMode = VK_POLYGON_MODE_FILL;
+	rs.cullMode = VK_CULL_MODE_NONE;
+	rs.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rs.depthBiasEnable = VK_TRUE;
+	rs.depthBiasConstantFactor = SHADOW_DEPTH_BIAS_CONSTANT;
+	rs.depthBiasSlopeFactor = SHADOW_DEPTH_BIAS_SLOPE;
+	rs.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo ms = {};
+	ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo ds = {};
+	ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	ds.depthTestEnable = VK_TRUE;
+	ds.depthWriteEnable = VK_TRUE;
+	ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+	VkGraphicsPipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeInfo.stageCount = 1;
+	pipeInfo.pStages = &stage;
+	pipeInfo.pVertexInputState = &vi;
+	pipeInfo.pInputAssemblyState = &ia;
+	pipeInfo.pViewportState = &vp;
+	pipeInfo.pRasterizationState = &rs;
+	pipeInfo.pMultisampleState = &ms;
+	pipeInfo.pDepthStencilState = &ds;
+	pipeInfo.layout = pipelineLayout;
+	pipeInfo.renderPass = staticPass;
+
+	if (vkCreateGraphicsPipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the shadow map pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, vertModule, HostAllocator::callbacks);
+}
+
+void ShadowCache::Invalidate()
+{
+	staticValid = false;
+}
+
+void ShadowCache::Draw(VkCommandBuffer cmd, VkRenderPass pass, VkFramebuffer framebuffer, const std::vector<ShadowCaster>& casters)
+{
+	// only the static pass clears, to the far plane
+	VkClearValue clear = {};
+	clear.depthStencil.depth = 1.0f;
+
+	VkRenderPassBeginInfo rpBegin = {};
+	rpBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	rpBegin.renderPass = pass;
+	rpBegin.framebuffer = framebuffer;
+	rpBegin.renderArea.extent.width = SHADOW_MAP_SIZE;
+	rpBegin.renderArea.extent.height = SHADOW_MAP_SIZE;
+	rpBegin.clearValueCount = 1;
+	rpBegin.pClearValues = &clear;
+
+	DeviceTable::CmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	for (const ShadowCaster& caster : casters)
+	{
+		DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &caster.mvp);
+		DeviceTable::CmdDrawIndexed(cmd, caster.indexCount, 1, caster.firstIndex, caster.vertexOffset, 0);
+	}
+
+	DeviceTable::CmdEndRenderPass(cmd);
+}
+
+void ShadowCache::Record(VkCommandBuffer cmd, VkBuffer positionBuffer, VkBuffer indexBuffer, VkIndexType indexType,
+	const std::vector<ShadowCaster>& staticCasters, const std::vector<ShadowCaster>& dynamicCasters)
+{
+	// When nothing static changed, and nothing dynamic was drawn in the
+	// last frame or this one, the dynamic layer is still the static one
+	if (staticValid && dynamicEmpty && dynamicCasters.empty())
+		return;
+
+	VkDeviceSize offset = 0;
+	DeviceTable::CmdBindVertexBuffers(cmd, 0, 1, &positionBuffer, &offset);
+	DeviceTable::CmdBindIndexBuffer(cmd, indexBuffer, 0, indexType);
+
+	if (!staticValid)
+	{
+		Draw(cmd, staticPass, staticFramebuffer, staticCasters);
+		staticValid = true;
+		staticDraws++;
+	}
+
+	// What the dynamic layer had is replaced, so it starts as UNDEFINED.
+	// The barrier waits for the shaders of the last frame to be done
+	// reading it, and for the last frame's dynamic pass to be done writing
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = dynamicMap->image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+	// the composite of the two layers starts as the static layer
+	VkImageCopy region = {};
+	region.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+	region.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+	region.extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1 };
+
+	DeviceTable::CmdCopyImage(cmd,
+		staticMap->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		dynamicMap->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &region);
+
+	// and the objects that move are depth tested against it
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		0, 0, NULL, 0, NULL, 1, &barrier);
+
+	Draw(cmd, dynamicPass, dynamicFramebuffer, dynamicCasters);
+	dynamicEmpty = dynamicCasters.empty();
+	dynamicDraws++;
+}
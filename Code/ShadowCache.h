@@ -0,0 +1,117 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "TextureGPU.h"
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+// the width and height of both layers of the shadow map
+#define SHADOW_MAP_SIZE 2048
+
+// every GPU can draw depth into D16 and sample it, and
+// 16 bits is enough for the depth range of one light
+#define SHADOW_MAP_FORMAT VK_FORMAT_D16_UNORM
+
+// One draw into the shadow map, mvp is the matrix of the light
+// times the model matrix of the object, the rest is the range of
+// the mesh in the position buffer of the mesh pool
+struct ShadowCaster
+{
+	glm::mat4 mvp;
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+};
+
+// The shadow map of one light, in two layers. The static layer has
+// every object that does not move, it is drawn once, and then only
+// again after Invalidate (when the light moves, or an object that
+// was static changes). Every frame, the static layer is copied into
+// the dynamic layer, and only the objects that moved are drawn on
+// top of it, so the cost of the shadow map follows how much of the
+// scene moves, and not how big the scene is. When nothing moves,
+// the dynamic layer already has the right depth, and nothing is done.
+// The shaders read the dynamic layer, in DEPTH_STENCIL_READ_ONLY
+class ShadowCache
+{
+private:
+	VkDevice device;
+
+	TextureGPU* staticMap;
+	TextureGPU* dynamicMap;
+
+	// The static layer is cleared, and left in TRANSFER_SRC for the
+	// copy. The dynamic layer is loaded (the copy is in it), and left
+	// where a shader can read it. Both passes have the same attachment,
+	// so the one pipeline works with both
+	VkRenderPass staticPass;
+	VkRenderPass dynamicPass;
+	VkFramebuffer staticFramebuffer;
+	VkFramebuffer dynamicFramebuffer;
+
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	bool staticValid;
+
+	// the last frame drew no dynamic objects, so the
+	// dynamic layer is the same as the static layer
+	bool dynamicEmpty;
+
+	VkRenderPass CreateRenderPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkImageLayout finalLayout,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	void Draw(VkCommandBuffer cmd, VkRenderPass pass, VkFramebuffer framebuffer, const std::vector<ShadowCaster>& casters);
+
+public:
+	// how many times the static layer was drawn,
+	// and how many frames copied it into the dynamic layer
+	uint32_t staticDraws;
+	uint32_t dynamicDraws;
+
+	ShadowCache(VkDevice d, MemoryAllocator* a);
+	~ShadowCache();
+
+	// The vertex shader is cube_depth_push.vert, which reads
+	// the positions of the mesh pool, in this format and stride
+	void PreparePipeline(VkPipelineCache cache, VkFormat positionFormat, uint32_t positionStride);
+
+	// the static layer is drawn again in the next Record
+	void Invalidate();
+	bool NeedsStatic() { return !staticValid; }
+
+	// Draws whichever layers have to be drawn, staticCasters is only
+	// read if NeedsStatic is true. The barriers of both layers are
+	// recorded here, the frame graph does not know about them
+	void Record(VkCommandBuffer cmd, VkBuffer positionBuffer, VkBuffer indexBuffer, VkIndexType indexType,
+		const std::vector<ShadowCaster>& staticCasters, const std::vector<ShadowCaster>& dynamicCasters);
+
+	// the layer that the shaders read
+	TextureGPU* GetMap() { return dynamicMap; }
+};
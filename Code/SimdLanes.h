@@ -0,0 +1,69 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+
+// The SIMD width that the batch kernels (TransformBatch, FrustumCulling)
+// are compiled with, and a few macros, so that the same kernel works
+// with both widths. Each Lanes holds one number of 8 (AVX2) or 4 (SSE2)
+// objects. Without SIMD, SIMD_LANES is 1, and the kernels only use
+// their scalar loops
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_LANES 8
+#define SIMD_PATH "AVX2"
+typedef __m256 Lanes;
+#define LANES_LOAD(p) _mm256_loadu_ps(p)
+#define LANES_SET1(x) _mm256_set1_ps(x)
+#define LANES_ADD(a, b) _mm256_add_ps(a, b)
+#define LANES_SUB(a, b) _mm256_sub_ps(a, b)
+#define LANES_MUL(a, b) _mm256_mul_ps(a, b)
+#define LANES_MAX(a, b) _mm256_max_ps(a, b)
+#define LANES_MIN(a, b) _mm256_min_ps(a, b)
+#define LANES_AND(a, b) _mm256_and_ps(a, b)
+#define LANES_CMPGE(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define LANES_MASK(a) _mm256_movemask_ps(a)
+#define LANES_STORE(p, a) _mm256_storeu_ps(p, a)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_LANES 4
+#define SIMD_PATH "SSE2"
+typedef __m128 Lanes;
+#define LANES_LOAD(p) _mm_loadu_ps(p)
+#define LANES_SET1(x) _mm_set1_ps(x)
+#define LANES_ADD(a, b) _mm_add_ps(a, b)
+#define LANES_SUB(a, b) _mm_sub_ps(a, b)
+#define LANES_MUL(a, b) _mm_mul_ps(a, b)
+#define LANES_MAX(a, b) _mm_max_ps(a, b)
+#define LANES_MIN(a, b) _mm_min_ps(a, b)
+#define LANES_AND(a, b) _mm_and_ps(a, b)
+#define LANES_CMPGE(a, b) _mm_cmpge_ps(a, b)
+#define LANES_MASK(a) _mm_movemask_ps(a)
+#define LANES_STORE(p, a) _mm_storeu_ps(p, a)
+#else
+#define SIMD_LANES 1
+#define SIMD_PATH "scalar"
+#endif
@@ -0,0 +1,222 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "SkinningPass.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <string.h>
+
+SkinningPass::SkinningPass(VkDevice d, MemoryAllocator* a, Uploader* uploader, MeshPool* meshPool, const MeshRange& meshRange, const void* vertices, uint32_t vertexStride, uint32_t positionStride, bool compact, const uint32_t* skin)
+{
+	device = d;
+	pool = meshPool;
+	range = meshRange;
+	pipeline = VK_NULL_HANDLE;
+
+	// both vertex formats are a whole number of 32-bit words,
+	// and so is the position at the start of them
+	constants.vertexCount = range.vertexCount;
+	constants.firstVertex = range.firstVertex;
+	constants.vertexWords = vertexStride / sizeof(uint32_t);
+	constants.positionWords = positionStride / sizeof(uint32_t);
+	constants.compact = compact ? 1 : 0;
+
+	// The bind pose and the bones of every vertex never change, they
+	// are copied to the GPU once, and only the shader reads them
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.size = (VkDeviceSize)range.vertexCount * vertexStride;
+
+	bindPose = BufferGPU(device, a, info);
+	bindPose.SetName("Skinning bind pose");
+	uploader->UploadBuffer(&bindPose, (void*)vertices, (int)info.size, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	info.size = (VkDeviceSize)range.vertexCount * 2 * sizeof(uint32_t);
+	skinData = BufferGPU(device, a, info);
+	skinData.SetName("Skinning weights");
+	uploader->UploadBuffer(&skinData, (void*)skin, (int)info.size, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.size = SKIN_MAX_BONES * sizeof(glm::mat4);
+	boneBuffer = BufferGPU(device, a, info);
+	boneBuffer.SetName("Skinning bones");
+
+	// The shader has the bind pose, the weights, the bones, and
+	// the two buffers of the pool that it writes, at bindings 0 to 4
+	VkDescriptorSetLayoutBinding bindings[5];
+	memset(bindings, 0, sizeof(bindings));
+
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = (i == 2) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 5;
+	layoutInfo.pBindings = bindings;
+	vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &descLayout);
+
+	VkDescriptorPoolSize poolSizes[2];
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = 4;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[1].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &descPool);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &descLayout;
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, &descSet);
+
+	// Without a position buffer, the shader writes no positions,
+	// but the binding still needs a buffer, so it gets the vertices
+	VkDescriptorBufferInfo bufferInfo[5] = {};
+	bufferInfo[0].buffer = bindPose.buffer;
+	bufferInfo[1].buffer = skinData.buffer;
+	bufferInfo[2].buffer = boneBuffer.buffer;
+	bufferInfo[3].buffer = pool->vertexBuffer.buffer;
+	bufferInfo[4].buffer = (positionStride > 0) ? pool->positionBuffer.buffer : pool->vertexBuffer.buffer;
+
+	VkWriteDescriptorSet writes[5];
+	memset(writes, 0, sizeof(writes));
+
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		bufferInfo[i].range = VK_WHOLE_SIZE;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = descSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = bindings[i].descriptorType;
+		writes[i].pBufferInfo = &bufferInfo[i];
+	}
+
+	DeviceTable::UpdateDescriptorSets(device, 5, writes, 0, NULL);
+
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(SkinConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &pipelineLayoutInfo, HostAllocator::callbacks, &pipelineLayout);
+}
+
+void SkinningPass::PreparePipeline(VkPipelineCache cache)
+{
+	// Compute Shader compiled to header, see compileShaders.cmd
+	const unsigned char cs_code[] = {
+		#include "mesh_skin.comp.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = (uint32_t*)cs_code;
+	shaderInfo.codeSize = sizeof(cs_code);
+
+	VkShaderModule module;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &module);
+
+	VkComputePipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeInfo.stage.module = module;
+	pipeInfo.stage.pName = "main";
+	pipeInfo.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the skinning pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, module, HostAllocator::callbacks);
+}
+
+SkinningPass::~SkinningPass()
+{
+	vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+
+	// destroying the pool also frees the set
+	vkDestroyDescriptorPool(device, descPool, HostAllocator::callbacks);
+	vkDestroyDescriptorSetLayout(device, descLayout, HostAllocator::callbacks);
+
+	bindPose.Destroy();
+	skinData.Destroy();
+	boneBuffer.Destroy();
+}
+
+void SkinningPass::Skin(VkCommandBuffer cmd, const glm::mat4* bones, uint32_t boneCount)
+{
+	if (boneCount > SKIN_MAX_BONES)
+		boneCount = SKIN_MAX_BONES;
+
+	// The shader of the last frame read the bones, the frame graph
+	// does not know about them, so the copy waits for it by itself
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, NULL, 0, NULL, 0, NULL);
+
+	DeviceTable::CmdUpdateBuffer(cmd, boneBuffer.buffer, 0, boneCount * sizeof(glm::mat4), bones);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descSet, 0, NULL);
+	DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SkinConstants), &constants);
+
+	// one invocation for every vertex of the mesh
+	DeviceTable::CmdDispatch(cmd, (range.vertexCount + SKIN_WORKGROUP_SIZE - 1) / SKIN_WORKGROUP_SIZE, 1, 1);
+}
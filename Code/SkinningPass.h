@@ -0,0 +1,110 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "BufferGPU.h"
+#include "MemoryAllocator.h"
+#include "MeshPool.h"
+#include "Uploader.h"
+
+#include <glm/glm.hpp>
+
+// the number of vertices that each workgroup
+// of the skinning shader moves (local_size_x)
+#define SKIN_WORKGROUP_SIZE 64
+
+// the size of the bone array of mesh_skin.comp
+#define SKIN_MAX_BONES 64
+
+// This is given to the skinning shader with push
+// constants, it must match SkinVals in mesh_skin.comp
+struct SkinConstants
+{
+	uint32_t vertexCount;
+	uint32_t firstVertex;
+	uint32_t vertexWords;
+	uint32_t positionWords;
+	uint32_t compact;
+};
+
+// Skins one mesh of the mesh pool with a compute shader, once in every
+// frame. The bind pose of the mesh is kept in a buffer of its own, and
+// the shader writes the skinned vertices over the mesh's own range of
+// the pool's vertex buffer (and of its position buffer), so every pass
+// that draws the mesh (the depth pre-pass, the shadow map, the main
+// pass, the GPU culling draws) reads the same skinned vertices with
+// its usual pipeline, instead of every vertex shader skinning them
+// again. Each vertex has up to 4 bones, with 8-bit weights
+class SkinningPass
+{
+private:
+	VkDevice device;
+	MeshPool* pool;
+	MeshRange range;
+	SkinConstants constants;
+
+	BufferGPU bindPose;
+	BufferGPU skinData;
+
+	// the bones of this frame, written with vkCmdUpdateBuffer
+	BufferGPU boneBuffer;
+
+	VkDescriptorSetLayout descLayout;
+	VkDescriptorPool descPool;
+	VkDescriptorSet descSet;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+public:
+	// The vertices are the mesh that was added to the pool at range, in
+	// the format of the pool (compact, or floats), and skin has two words
+	// for every vertex: the indices of 4 bones, 8 bits each, and their 4
+	// weights, as 8-bit UNORMs. The pool's buffers need STORAGE usage
+	SkinningPass(
+		VkDevice d,
+		MemoryAllocator* a,
+		Uploader* uploader,
+		MeshPool* meshPool,
+		const MeshRange& meshRange,
+		const void* vertices,
+		uint32_t vertexStride,
+		uint32_t positionStride,
+		bool compact,
+		const uint32_t* skin);
+
+	~SkinningPass();
+
+	// the compute pipeline goes into the pipeline
+	// cache, so it is made when the cache is ready
+	void PreparePipeline(VkPipelineCache cache);
+
+	// Moves every vertex by the bones, which go from the bind pose to
+	// this frame. This must be recorded outside of a render pass, the
+	// frame graph waits for the draws of the last frame to read the
+	// vertices, and for this to write them (COMPUTE_SHADER)
+	void Skin(VkCommandBuffer cmd, const glm::mat4* bones, uint32_t boneCount);
+};
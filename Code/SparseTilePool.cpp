@@ -0,0 +1,187 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#include "SparseTilePool.h"
+#include "DeviceTable.h"
+#include "Helper.h"
+
+// Binding memory to a normal image happens once, with vkBindImageMemory,
+// before the image is used. Sparse images are bound on a queue, with
+// vkQueueBindSparse, like a command buffer is submitted, and they can
+// be bound again at any time. The GPU has to support the sparseBinding
+// and sparseResidencyImage2D features, and the queue family has to
+// have VK_QUEUE_SPARSE_BINDING_BIT, see Demo::prepare_device
+
+SparseTilePool::SparseTilePool(VkDevice d, MemoryAllocator* a, VkQueue q, SyncPool* pool)
+{
+	device = d;
+	allocator = a;
+	queue = q;
+	syncPool = pool;
+	pageCount = 0;
+}
+
+SparseTilePool::~SparseTilePool()
+{
+	// the images that used the pages are deleted before us
+	for (size_t i = 0; i < freePages.size(); i++)
+		allocator->Free(&freePages[i]);
+}
+
+bool SparseTilePool::AllocatePage(VkMemoryRequirements reqs, MemoryAllocation* page)
+{
+	// use a page that was freed before, if it has the same size,
+	// and its memory type is one that the image can use
+	for (size_t i = 0; i < freePages.size(); i++)
+	{
+		MemoryAllocation& p = freePages[i];
+
+		if (p.size == reqs.size && (reqs.memoryTypeBits & (1 << p.memoryTypeIndex)) &&
+			(p.offset % reqs.alignment) == 0)
+		{
+			*page = p;
+			freePages.erase(freePages.begin() + i);
+			pageCount++;
+			return true;
+		}
+	}
+
+	// Many pages fit in one block of the allocator. Sparse images
+	// are optimally tiled, so the pages are not linear
+	if (!allocator->Allocate(reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, page))
+		return false;
+
+	pageCount++;
+	return true;
+}
+
+void SparseTilePool::FreePage(MemoryAllocation* page)
+{
+	pageCount--;
+
+	if (freePages.size() < SPARSE_FREE_PAGE_COUNT)
+		freePages.push_back(*page);
+	else
+		allocator->Free(page);
+
+	*page = {};
+}
+
+void SparseTilePool::BindTile(VkImage image, VkImageSubresource subresource, VkOffset3D offset, VkExtent3D extent, MemoryAllocation* page)
+{
+	SparseBind bind = {};
+	bind.image = image;
+	bind.opaque = false;
+	bind.imageBind.subresource = subresource;
+	bind.imageBind.offset = offset;
+	bind.imageBind.extent = extent;
+
+	// without memory, the tile is unbound
+	if (page != nullptr)
+	{
+		bind.imageBind.memory = page->memory;
+		bind.imageBind.memoryOffset = page->offset;
+	}
+
+	binds.push_back(bind);
+}
+
+void SparseTilePool::UnbindTile(VkImage image, VkImageSubresource subresource, VkOffset3D offset, VkExtent3D extent)
+{
+	BindTile(image, subresource, offset, extent, nullptr);
+}
+
+void SparseTilePool::BindOpaque(VkImage image, VkDeviceSize resourceOffset, VkDeviceSize size, MemoryAllocation* memory)
+{
+	// The mip tail is all of the levels that are smaller than one
+	// tile, it does not have tiles, so it is bound as one range of bytes
+	SparseBind bind = {};
+	bind.image = image;
+	bind.opaque = true;
+	bind.opaqueBind.resourceOffset = resourceOffset;
+	bind.opaqueBind.size = size;
+	bind.opaqueBind.memory = memory->memory;
+	bind.opaqueBind.memoryOffset = memory->offset;
+
+	binds.push_back(bind);
+}
+
+void SparseTilePool::Flush()
+{
+	if (binds.empty())
+		return;
+
+	// each bind gets its own info, the infos
+	// point into binds, so it must not change now
+	std::vector<VkSparseImageMemoryBindInfo> imageInfos;
+	std::vector<VkSparseImageOpaqueMemoryBindInfo> opaqueInfos;
+
+	for (size_t i = 0; i < binds.size(); i++)
+	{
+		if (binds[i].opaque)
+		{
+			VkSparseImageOpaqueMemoryBindInfo info = {};
+			info.image = binds[i].image;
+			info.bindCount = 1;
+			info.pBinds = &binds[i].opaqueBind;
+			opaqueInfos.push_back(info);
+		}
+		else
+		{
+			VkSparseImageMemoryBindInfo info = {};
+			info.image = binds[i].image;
+			info.bindCount = 1;
+			info.pBinds = &binds[i].imageBind;
+			imageInfos.push_back(info);
+		}
+	}
+
+	VkBindSparseInfo bindInfo = {};
+	bindInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+	bindInfo.imageOpaqueBindCount = (uint32_t)opaqueInfos.size();
+	bindInfo.pImageOpaqueBinds = opaqueInfos.data();
+	bindInfo.imageBindCount = (uint32_t)imageInfos.size();
+	bindInfo.pImageBinds = imageInfos.data();
+
+	// The copies of the new levels go to another queue (see Uploader),
+	// and a semaphore between the queues would have to be waited on
+	// by the next upload. Binding does not happen often, so the
+	// simplest way is to wait for it here, on the CPU
+	VkFence fence = syncPool->AcquireFence();
+
+	VkResult err;
+	{
+		QueueLock queueLock;
+		err = DeviceTable::QueueBindSparse(queue, 1, &bindInfo, fence);
+	}
+	if (err != VK_SUCCESS)
+		ERR_EXIT("vkQueueBindSparse failed\n", "Sparse Binding Failure");
+
+	DeviceTable::WaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	syncPool->ReleaseFence(fence);
+
+	binds.clear();
+}
@@ -0,0 +1,91 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "SyncPool.h"
+
+// how many unused pages the pool keeps, so that a level that is
+// loaded again soon does not need new memory. The rest are freed
+#define SPARSE_FREE_PAGE_COUNT 64
+
+// one bind (or unbind, if memory is VK_NULL_HANDLE) that waits for Flush
+struct SparseBind
+{
+	VkImage image;
+
+	// true for a range of the mip tail (opaque),
+	// false for one tile of a level
+	bool opaque;
+	VkSparseMemoryBind opaqueBind;
+	VkSparseImageMemoryBind imageBind;
+};
+
+// A sparse image has no memory when it is created. Its levels are
+// made of tiles (pages), and each tile gets a page of memory from the
+// pool when it is needed, with vkQueueBindSparse. Only the tiles that
+// are bound use memory, so a huge texture can be used, while only the
+// levels that are seen are on the GPU. See TextureStreamer.cpp
+class SparseTilePool
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+
+	// a queue of a family with VK_QUEUE_SPARSE_BINDING_BIT
+	VkQueue queue;
+
+	// a fence is taken for each vkQueueBindSparse
+	SyncPool* syncPool;
+
+	std::vector<MemoryAllocation> freePages;
+	std::vector<SparseBind> binds;
+
+public:
+	// how many pages are bound to images right now
+	uint32_t pageCount;
+
+	SparseTilePool(VkDevice d, MemoryAllocator* a, VkQueue q, SyncPool* pool);
+	~SparseTilePool();
+
+	// Every page has the size and alignment of reqs, that is the size
+	// of one tile of the sparse image (see vkGetImageMemoryRequirements)
+	bool AllocatePage(VkMemoryRequirements reqs, MemoryAllocation* page);
+	void FreePage(MemoryAllocation* page);
+
+	// The binds wait until Flush. A page that is unbound can only be
+	// freed after Flush, and after the GPU stopped reading the tile
+	void BindTile(VkImage image, VkImageSubresource subresource, VkOffset3D offset, VkExtent3D extent, MemoryAllocation* page);
+	void UnbindTile(VkImage image, VkImageSubresource subresource, VkOffset3D offset, VkExtent3D extent);
+	void BindOpaque(VkImage image, VkDeviceSize resourceOffset, VkDeviceSize size, MemoryAllocation* memory);
+
+	// Sends the binds to the queue, and waits until they are done,
+	// so copies on any queue can use the tiles right after this
+	void Flush();
+};
@@ -0,0 +1,165 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "SpikeDetector.h"
+#include <algorithm>
+
+SpikeDetector::SpikeDetector(const char* path, double threshold, double multiple)
+{
+	thresholdMs = threshold;
+	medianMultiple = multiple;
+	windowCount = 0;
+	windowNext = 0;
+	lastLoggedFrame = 0;
+	logged = false;
+	spikeCount = 0;
+
+	// added to the end, so the spikes of every run are kept
+	log = fopen(path, "a");
+
+	if (log == nullptr)
+		printf("Could not open %s, spikes are only counted\n", path);
+}
+
+SpikeDetector::~SpikeDetector()
+{
+	if (log != nullptr)
+	{
+		fprintf(log, "%u spikes in this run\n\n", spikeCount);
+		fclose(log);
+	}
+}
+
+float SpikeDetector::GetMedian()
+{
+	// nth_element only sorts enough to put the middle one in its place
+	std::copy(window, window + windowCount, sorted);
+	std::nth_element(sorted, sorted + windowCount / 2, sorted + windowCount);
+	return sorted[windowCount / 2];
+}
+
+void SpikeDetector::Check(uint64_t frame, CpuProfiler* profiler, MemoryAllocator* allocator, const SpikeSwapchainState& swapchain)
+{
+	uint32_t samples = profiler->GetSampleCount();
+
+	if (samples == 0)
+		return;
+
+	float ms = (float)profiler->GetSample(samples - 1).ms[CPU_MARKER_FRAME];
+
+	// The median is of the frames before this one, after half of the
+	// window is full, so the first frames (which build the pipelines,
+	// and fill the caches) are not compared with nothing
+	bool spike = false;
+	float median = 0;
+
+	if (windowCount >= SPIKE_MEDIAN_WINDOW / 2)
+	{
+		median = GetMedian();
+		spike = (ms > thresholdMs) || (ms > median * medianMultiple);
+	}
+
+	window[windowNext] = ms;
+	windowNext = (windowNext + 1) % SPIKE_MEDIAN_WINDOW;
+	windowCount = std::min(windowCount + 1, (uint32_t)SPIKE_MEDIAN_WINDOW);
+
+	if (!spike)
+		return;
+
+	spikeCount++;
+
+	if (log == nullptr)
+		return;
+
+	fprintf(log, "Spike at frame %llu: %.3f ms, median %.3f ms (%.1fx)\n",
+		(unsigned long long)frame, ms, median, median > 0 ? ms / median : 0.0);
+
+	// the frames before this spike were already written with the last one
+	if (!logged || frame - lastLoggedFrame > SPIKE_CONTEXT_FRAMES)
+		WriteContext(profiler, allocator, swapchain);
+
+	logged = true;
+	lastLoggedFrame = frame;
+
+	// a crash after a spike should not lose it
+	fflush(log);
+}
+
+void SpikeDetector::WriteContext(CpuProfiler* profiler, MemoryAllocator* allocator, const SpikeSwapchainState& swapchain)
+{
+	fprintf(log, "  swapchain: %s, %u images, %ux%u, render %ux%u, %u frames in flight, %llu recreations\n",
+		swapchain.presentMode, swapchain.imageCount, swapchain.width, swapchain.height,
+		swapchain.renderWidth, swapchain.renderHeight, swapchain.frameLag,
+		(unsigned long long)swapchain.recreations);
+
+	// the CPU markers of the last frames, the spike is the last line
+	uint32_t samples = profiler->GetSampleCount();
+	uint32_t first = (samples > SPIKE_CONTEXT_FRAMES) ? samples - SPIKE_CONTEXT_FRAMES : 0;
+	double contextMs = 0;
+
+	fprintf(log, "  frames (ms):");
+	for (uint32_t m = 0; m < CPU_MARKER_COUNT; m++)
+		fprintf(log, " %s", CpuProfiler::GetMarkerName((CpuMarker)m));
+	fprintf(log, "\n");
+
+	for (uint32_t i = first; i < samples; i++)
+	{
+		CpuFrameSample sample = profiler->GetSample(i);
+		contextMs += sample.ms[CPU_MARKER_FRAME];
+
+		fprintf(log, "    %d:", (int)i - (int)(samples - 1));
+		for (uint32_t m = 0; m < CPU_MARKER_COUNT; m++)
+			fprintf(log, " %.3f", sample.ms[m]);
+		fprintf(log, "\n");
+	}
+
+	// The blocks of memory that were made or freed in those frames,
+	// vkAllocateMemory can take milliseconds when the driver has to
+	// clear the memory, or move other memory out of the way for it
+	CpuClock::time_point now = CpuClock::now();
+	uint32_t eventCount = allocator->GetEventCount();
+	uint32_t written = 0;
+
+	for (uint32_t i = 0; i < eventCount; i++)
+	{
+		MemoryEvent event = allocator->GetEvent(i);
+		double agoMs = std::chrono::duration<double, std::milli>(now - event.time).count();
+
+		if (agoMs > contextMs)
+			continue;
+
+		fprintf(log, "  memory: %.3f ms ago, %s %llu KB of type %u%s, took %.3f ms\n",
+			agoMs,
+			event.allocated ? "allocated" : "freed",
+			(unsigned long long)(event.size >> 10),
+			event.memoryTypeIndex,
+			event.dedicated ? " (dedicated)" : "",
+			event.ms);
+		written++;
+	}
+
+	if (written == 0)
+		fprintf(log, "  memory: no blocks were made or freed\n");
+}
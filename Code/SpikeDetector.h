@@ -0,0 +1,90 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include "CpuProfiler.h"
+#include "MemoryAllocator.h"
+
+// how many frames the moving median is taken over
+#define SPIKE_MEDIAN_WINDOW 64
+
+// how many frames before a spike are written to the log,
+// a spike this close to the last one only gets one line
+#define SPIKE_CONTEXT_FRAMES 32
+
+// What the swapchain looked like when a spike happened,
+// a resize or a new present mode is a common reason for one
+struct SpikeSwapchainState
+{
+	const char* presentMode;
+	uint32_t imageCount;
+	uint32_t width;
+	uint32_t height;
+	uint32_t renderWidth;
+	uint32_t renderHeight;
+	uint32_t frameLag;
+	uint64_t recreations;
+};
+
+// Finds the frames that took much longer than the frames around
+// them, and writes down what happened before them, so a hitch that
+// somebody saw on a display in the field can be looked at later. A
+// spike is a frame that is longer than thresholdMs, or longer than
+// medianMultiple times the median of the last SPIKE_MEDIAN_WINDOW
+// frames. The log gets the CPU markers of the last frames, the blocks
+// of memory that were made or freed, and the state of the swapchain
+class SpikeDetector
+{
+private:
+	FILE* log;
+	double thresholdMs;
+	double medianMultiple;
+
+	// the last frame times, in a ring, with a copy
+	// that is sorted (partly) to find the median
+	float window[SPIKE_MEDIAN_WINDOW];
+	float sorted[SPIKE_MEDIAN_WINDOW];
+	uint32_t windowCount;
+	uint32_t windowNext;
+
+	uint64_t lastLoggedFrame;
+	bool logged;
+
+	float GetMedian();
+	void WriteContext(CpuProfiler* profiler, MemoryAllocator* allocator, const SpikeSwapchainState& swapchain);
+
+public:
+	uint32_t spikeCount;
+
+	// the log is opened once, and every spike is added to it
+	SpikeDetector(const char* path, double threshold, double multiple);
+	~SpikeDetector();
+
+	// Called after CpuProfiler::EndFrame, with the newest frame
+	// of the profiler. Nothing is allocated unless it is a spike
+	void Check(uint64_t frame, CpuProfiler* profiler, MemoryAllocator* allocator, const SpikeSwapchainState& swapchain);
+};
@@ -0,0 +1,127 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#include "StagingRing.h"
+#include "Helper.h"
+
+// Before the ring, every upload made a BufferCPU, stored the data
+// in it, copied it to the GPU, and then deleted it. That is one
+// vkCreateBuffer, one allocation, one map, and one vkDestroyBuffer
+// for every upload.
+
+// The ring is one BufferCPU that is made once, and stays mapped.
+// An upload just moves the head forward, and memcpy's its data there.
+// When the GPU is done with the copies of an upload batch, the tail
+// moves forward by however many bytes that batch used
+
+StagingRing::StagingRing(VkDevice d, MemoryAllocator* a, VkDeviceSize s, bool cached, VkBufferUsageFlags extraUsage)
+{
+	size = s;
+	head = 0;
+	tail = 0;
+	used = 0;
+
+	// this buffer is usually only ever the source of a copy
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | extraUsage;
+	info.size = size;
+
+	// persistently mapped, see BufferCPU.cpp
+	buffer = new BufferCPU(d, a, info, true, false, cached);
+	buffer->SetName("Staging ring");
+	mapped = (uint8_t*)buffer->GetPointer();
+}
+
+StagingRing::~StagingRing()
+{
+	delete buffer;
+}
+
+bool StagingRing::Allocate(VkDeviceSize bytes, VkDeviceSize* offset, VkDeviceSize* consumed)
+{
+	// When nothing is in the ring, the next allocation can start at
+	// zero. Otherwise an empty ring would still skip (and charge) the
+	// bytes after the head, and refuse anything bigger than what is left
+	if (used == 0)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	// round the head up to the alignment
+	VkDeviceSize start = (head + STAGING_RING_ALIGNMENT - 1) & ~(VkDeviceSize)(STAGING_RING_ALIGNMENT - 1);
+
+	// If the allocation does not fit before the end of the
+	// ring, we skip the rest of the ring and start at zero.
+	// The bytes that we skip are still counted as used, so that
+	// they are given back when the tail goes past them
+	if (start + bytes > size)
+		start = 0;
+
+	// everything from the old head to the end of this allocation,
+	// including padding and skipped bytes
+	VkDeviceSize total = (start >= head) ? (start - head + bytes) : (size - head + bytes);
+
+	// not enough free space in the ring right now
+	if (used + total > size)
+		return false;
+
+	head = start + bytes;
+	if (head == size)
+		head = 0;
+
+	used += total;
+
+	*offset = start;
+	*consumed = total;
+	return true;
+}
+
+void StagingRing::Release(VkDeviceSize consumed)
+{
+	// the oldest bytes in the ring are free again
+	tail = (tail + consumed) % size;
+	used -= consumed;
+}
+
+uint8_t* StagingRing::GetPointer()
+{
+	return mapped;
+}
+
+void StagingRing::Flush(VkDeviceSize offset, VkDeviceSize bytes)
+{
+	buffer->Flush(offset, bytes);
+}
+
+VkBuffer StagingRing::GetBuffer()
+{
+	return buffer->buffer;
+}
+
+VkDeviceSize StagingRing::GetSize()
+{
+	return size;
+}
@@ -0,0 +1,70 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "BufferCPU.h"
+#include "MemoryAllocator.h"
+
+// size of the ring that all uploads are copied through,
+// anything bigger than this gets a BufferCPU of its own
+#define STAGING_RING_SIZE (8 * 1024 * 1024)
+
+// every allocation in the ring starts on a multiple of this,
+// which works for vkCmdCopyBuffer and for vkCmdCopyBufferToImage
+// with every format that has 16 bytes (or less) per texel block
+#define STAGING_RING_ALIGNMENT 16
+
+// One persistently mapped CPU buffer, which is used like a circle.
+// Allocations are taken from the "head", and they are given back at
+// the "tail", in the same order that they were taken
+class StagingRing
+{
+private:
+	BufferCPU* buffer;
+	uint8_t* mapped;
+
+	VkDeviceSize size;
+	VkDeviceSize head;
+	VkDeviceSize tail;
+	VkDeviceSize used;
+
+public:
+	// with cached, the ring is in HOST_CACHED memory, and every
+	// write has to be flushed, see BufferCPU. extraUsage is for a
+	// ring that a shader also reads, like STORAGE_BUFFER
+	StagingRing(VkDevice d, MemoryAllocator* a, VkDeviceSize s, bool cached = false, VkBufferUsageFlags extraUsage = 0);
+	~StagingRing();
+
+	bool Allocate(VkDeviceSize bytes, VkDeviceSize* offset, VkDeviceSize* consumed);
+	void Release(VkDeviceSize consumed);
+
+	uint8_t* GetPointer();
+
+	// call this after writing bytes of an allocation
+	void Flush(VkDeviceSize offset, VkDeviceSize bytes);
+	VkBuffer GetBuffer();
+	VkDeviceSize GetSize();
+};
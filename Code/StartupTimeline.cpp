@@ -0,0 +1,128 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "StartupTimeline.h"
+#include <stdio.h>
+#include <algorithm>
+
+StartupTimeline::StartupTimeline()
+{
+	current = nullptr;
+	active = false;
+	totalMs = 0;
+}
+
+void StartupTimeline::Start()
+{
+	steps.clear();
+	tasks.clear();
+	current = nullptr;
+	start = CpuClock::now();
+	stepStart = start;
+	active = true;
+}
+
+void StartupTimeline::EndStep()
+{
+	CpuClock::time_point now = CpuClock::now();
+
+	if (current != nullptr)
+	{
+		StartupStep step;
+		step.name = current;
+		step.ms = std::chrono::duration<double, std::milli>(now - stepStart).count();
+		steps.push_back(step);
+	}
+
+	stepStart = now;
+}
+
+void StartupTimeline::Step(const char* name)
+{
+	if (!active)
+		return;
+
+	EndStep();
+	current = name;
+}
+
+void StartupTimeline::AddTask(const char* name, double ms)
+{
+	if (!active)
+		return;
+
+	StartupStep task;
+	task.name = name;
+	task.ms = ms;
+	tasks.push_back(task);
+}
+
+double StartupTimeline::GetTotalMs()
+{
+	return totalMs;
+}
+
+void StartupTimeline::Finish()
+{
+	if (!active)
+		return;
+
+	EndStep();
+	active = false;
+
+	double total = std::chrono::duration<double, std::milli>(CpuClock::now() - start).count();
+	totalMs = total;
+
+	// the slowest steps are the ones worth making faster,
+	// so they are printed first
+	std::vector<StartupStep> sorted = steps;
+	std::sort(sorted.begin(), sorted.end(),
+		[](const StartupStep& a, const StartupStep& b) { return a.ms > b.ms; });
+
+	printf("Startup: %.1f ms in %u steps\n", total, (uint32_t)sorted.size());
+
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		printf("  %8.2f ms %5.1f%%  %s\n",
+			sorted[i].ms,
+			total > 0 ? sorted[i].ms * 100.0 / total : 0.0,
+			sorted[i].name);
+	}
+
+	if (tasks.size() == 0)
+		return;
+
+	// The tasks are not part of the total, they happened at the same
+	// time as the steps above. A "wait for" step above is the time that
+	// the main thread had nothing to do, until a task was finished
+	std::vector<StartupStep> sortedTasks = tasks;
+	std::sort(sortedTasks.begin(), sortedTasks.end(),
+		[](const StartupStep& a, const StartupStep& b) { return a.ms > b.ms; });
+
+	printf("Startup tasks on other threads:\n");
+
+	for (size_t i = 0; i < sortedTasks.size(); i++)
+		printf("  %8.2f ms         %s\n", sortedTasks[i].ms, sortedTasks[i].name);
+}
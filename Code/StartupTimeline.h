@@ -0,0 +1,75 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "CpuProfiler.h"
+
+// one step of the startup, and how long it took
+struct StartupStep
+{
+	const char* name;
+	double ms;
+};
+
+// Measures where the time goes when the program starts. Each Step
+// ends the step before it, so the steps cover the whole startup with
+// no gaps, and Finish prints them from the slowest to the fastest.
+// It only measures between Start and Finish, so calling Step when
+// prepare() runs again (after a resize) does nothing
+class StartupTimeline
+{
+private:
+	std::vector<StartupStep> steps;
+
+	// steps that ran on other threads, at the
+	// same time as the steps of the main thread
+	std::vector<StartupStep> tasks;
+
+	// the step that is being measured right now
+	const char* current;
+	CpuClock::time_point stepStart;
+	CpuClock::time_point start;
+	bool active;
+	double totalMs;
+
+	void EndStep();
+
+public:
+	StartupTimeline();
+
+	void Start();
+	void Step(const char* name);
+	void Finish();
+
+	// the whole startup, from Start to Finish,
+	// zero until Finish was called
+	double GetTotalMs();
+
+	// adds a step that was measured on another thread (see InitGraph),
+	// it is printed by itself, because it overlaps the other steps
+	void AddTask(const char* name, double ms);
+};
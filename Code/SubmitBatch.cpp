@@ -0,0 +1,144 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "SubmitBatch.h"
+#include "DeviceTable.h"
+#include "Helper.h"
+
+// Before the batch, the uploader, the texture streamer, and the frame
+// each called vkQueueSubmit on the graphics queue by themselves. Now
+// they each Add their submission, and draw() flushes all of them at
+// once, with the frame's submission at the end
+
+SubmitBatch::SubmitBatch(VkQueue q)
+{
+	queue = q;
+	fence = VK_NULL_HANDLE;
+	flushCount = 0;
+	submitCount = 0;
+}
+
+SubmitBatch::~SubmitBatch()
+{
+	// nothing that was added is lost
+	Flush();
+}
+
+void SubmitBatch::Add(const VkSubmitInfo& info, VkFence submitFence)
+{
+	// one call can only signal one fence
+	if (submitFence != VK_NULL_HANDLE && fence != VK_NULL_HANDLE)
+		Flush();
+
+	if (submitFence != VK_NULL_HANDLE)
+		fence = submitFence;
+
+	pending.push_back(PendingSubmit());
+	PendingSubmit& p = pending.back();
+
+	p.waitSemaphores.assign(info.pWaitSemaphores, info.pWaitSemaphores + info.waitSemaphoreCount);
+	p.waitStages.assign(info.pWaitDstStageMask, info.pWaitDstStageMask + info.waitSemaphoreCount);
+	p.commandBuffers.assign(info.pCommandBuffers, info.pCommandBuffers + info.commandBufferCount);
+	p.signalSemaphores.assign(info.pSignalSemaphores, info.pSignalSemaphores + info.signalSemaphoreCount);
+	p.pNext = info.pNext;
+
+	// The timeline values are almost always in a local struct, so
+	// they are copied, and the copy points to the rest of the chain
+	const VkTimelineSemaphoreSubmitInfoKHR* timeline = (const VkTimelineSemaphoreSubmitInfoKHR*)info.pNext;
+	p.hasTimeline = (timeline != NULL && timeline->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR);
+	p.timelineInfo = {};
+
+	if (p.hasTimeline)
+	{
+		p.waitValues.assign(timeline->pWaitSemaphoreValues, timeline->pWaitSemaphoreValues + timeline->waitSemaphoreValueCount);
+		p.signalValues.assign(timeline->pSignalSemaphoreValues, timeline->pSignalSemaphoreValues + timeline->signalSemaphoreValueCount);
+		p.timelineInfo = *timeline;
+		p.pNext = &p.timelineInfo;
+	}
+}
+
+void SubmitBatch::Flush(VkFence submitFence)
+{
+	if (submitFence != VK_NULL_HANDLE && fence != VK_NULL_HANDLE)
+		Flush();
+
+	if (submitFence != VK_NULL_HANDLE)
+		fence = submitFence;
+
+	if (pending.empty() && fence == VK_NULL_HANDLE)
+		return;
+
+	// The pointers are filled in now, because the
+	// vectors of an entry can not move after this
+	std::vector<VkSubmitInfo> infos(pending.size());
+
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		PendingSubmit& p = pending[i];
+
+		if (p.hasTimeline)
+		{
+			p.timelineInfo.pWaitSemaphoreValues = p.waitValues.data();
+			p.timelineInfo.pSignalSemaphoreValues = p.signalValues.data();
+		}
+
+		infos[i].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		infos[i].pNext = p.pNext;
+		infos[i].waitSemaphoreCount = (uint32_t)p.waitSemaphores.size();
+		infos[i].pWaitSemaphores = p.waitSemaphores.data();
+		infos[i].pWaitDstStageMask = p.waitStages.data();
+		infos[i].commandBufferCount = (uint32_t)p.commandBuffers.size();
+		infos[i].pCommandBuffers = p.commandBuffers.data();
+		infos[i].signalSemaphoreCount = (uint32_t)p.signalSemaphores.size();
+		infos[i].pSignalSemaphores = p.signalSemaphores.data();
+	}
+
+	// a submit with no VkSubmitInfo still signals the fence,
+	// after everything that was submitted to the queue before
+	VkResult err;
+	{
+		QueueLock queueLock;
+		err = DeviceTable::QueueSubmit(queue, (uint32_t)infos.size(), infos.data(), fence);
+	}
+
+	if (err != VK_SUCCESS)
+		ERR_EXIT("vkQueueSubmit failed\n", "Queue Submit Failure");
+
+	flushCount++;
+	submitCount += infos.size();
+
+	pending.clear();
+	fence = VK_NULL_HANDLE;
+}
+
+bool SubmitBatch::IsEmpty()
+{
+	return pending.empty();
+}
+
+VkQueue SubmitBatch::GetQueue()
+{
+	return queue;
+}
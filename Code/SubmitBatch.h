@@ -0,0 +1,92 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "TimelineSemaphore.h"
+#include <deque>
+#include <vector>
+
+// One submission that is waiting in a SubmitBatch. Everything that
+// the VkSubmitInfo pointed to is copied in here, so the caller's
+// arrays can go away before the batch is flushed
+struct PendingSubmit
+{
+	std::vector<VkSemaphore> waitSemaphores;
+	std::vector<VkPipelineStageFlags> waitStages;
+	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<VkSemaphore> signalSemaphores;
+
+	// the values of a VkTimelineSemaphoreSubmitInfoKHR, if the
+	// submission had one at the front of its pNext chain
+	bool hasTimeline;
+	std::vector<uint64_t> waitValues;
+	std::vector<uint64_t> signalValues;
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo;
+
+	// the rest of the pNext chain, which is not copied
+	const void* pNext;
+};
+
+// Collects the submissions of one queue, and sends all of them with
+// one vkQueueSubmit when Flush is called. Each vkQueueSubmit goes into
+// the kernel driver, so it costs a lot more than filling in one more
+// VkSubmitInfo. The submissions still run in the order of Add, and
+// they each wait for, and signal, their own semaphores
+class SubmitBatch
+{
+private:
+	VkQueue queue;
+
+	// a deque, so that the entries never move while more are added
+	std::deque<PendingSubmit> pending;
+
+	// vkQueueSubmit has one fence, for everything in the call
+	VkFence fence;
+
+public:
+	// the number of vkQueueSubmit calls, and of VkSubmitInfos in them
+	uint64_t flushCount;
+	uint64_t submitCount;
+
+	SubmitBatch(VkQueue q);
+	~SubmitBatch();
+
+	// Arrays of info, and a VkTimelineSemaphoreSubmitInfoKHR at the
+	// front of its pNext chain, are copied. Anything else in the chain
+	// has to stay alive until Flush. The fence signals when everything
+	// in the flush is done, which is never earlier than this submission.
+	// If the batch already has a fence, it is flushed first
+	void Add(const VkSubmitInfo& info, VkFence submitFence = VK_NULL_HANDLE);
+
+	// sends every submission with one vkQueueSubmit, and the fence
+	// (it can be VK_NULL_HANDLE). Call this before waiting on the CPU
+	// for anything that was added, or the wait never ends
+	void Flush(VkFence submitFence = VK_NULL_HANDLE);
+
+	bool IsEmpty();
+	VkQueue GetQueue();
+};
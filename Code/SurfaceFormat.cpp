@@ -0,0 +1,103 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "SurfaceFormat.h"
+
+// Before this, the first format in the list was used, and on some
+// drivers that is a 10-bit or a half float format, which costs more
+// bandwidth for every pixel, and every blit into the swapchain had to
+// convert the pixels, because the offscreen image has the same format
+
+SurfaceFormatClass GetSurfaceFormatClass(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+	case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+		return SURFACE_FORMAT_8_BIT;
+
+	case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+	case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+		return SURFACE_FORMAT_10_BIT;
+
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return SURFACE_FORMAT_HALF_FLOAT;
+
+	default:
+		return SURFACE_FORMAT_OTHER;
+	}
+}
+
+// lower is better
+static uint32_t get_rank(VkSurfaceFormatKHR format, bool wide)
+{
+	SurfaceFormatClass c = GetSurfaceFormatClass(format.format);
+	uint32_t rank = (uint32_t)c;
+
+	// with wide, 8-bit goes after the half floats
+	if (wide && c != SURFACE_FORMAT_OTHER)
+		rank = (c == SURFACE_FORMAT_8_BIT) ? (uint32_t)SURFACE_FORMAT_HALF_FLOAT : rank - 1;
+
+	// A color space for HDR would need the shaders to write
+	// PQ or linear values, so it is only used if it is all there is
+	if (format.colorSpace != VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+		rank += SURFACE_FORMAT_OTHER + 1;
+
+	return rank;
+}
+
+VkSurfaceFormatKHR SelectSurfaceFormat(const VkSurfaceFormatKHR* formats, uint32_t count, bool wide, VkFormat preferred, VkFormat fallback)
+{
+	VkSurfaceFormatKHR best;
+	best.format = fallback;
+	best.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+	if (count == 0 || (count == 1 && formats[0].format == VK_FORMAT_UNDEFINED))
+		return best;
+
+	uint32_t bestRank = UINT32_MAX;
+	bool bestPreferred = false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t rank = get_rank(formats[i], wide);
+		bool isPreferred = (formats[i].format == preferred);
+
+		// a later format only wins if it is cheaper, or
+		// if it is just as cheap, and it is the preferred one
+		if (rank < bestRank || (rank == bestRank && isPreferred && !bestPreferred))
+		{
+			best = formats[i];
+			bestRank = rank;
+			bestPreferred = isPreferred;
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,56 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <stdint.h>
+
+// How expensive a swapchain format is, the cheapest class is 0. Every
+// pixel of the swapchain is written (or blitted) once per frame, and
+// read again by the compositor or the display engine, so the bytes per
+// pixel are paid twice, in every frame. 10-bit formats have the same
+// size as 8-bit ones, but many compositors convert them, so they are
+// only cheaper than half floats, which are twice as big
+enum SurfaceFormatClass
+{
+	SURFACE_FORMAT_8_BIT,
+	SURFACE_FORMAT_10_BIT,
+	SURFACE_FORMAT_HALF_FLOAT,
+	SURFACE_FORMAT_OTHER
+};
+
+SurfaceFormatClass GetSurfaceFormatClass(VkFormat format);
+
+// Picks one of the formats that vkGetPhysicalDeviceSurfaceFormatsKHR
+// gave. Only the sRGB color space is used, because nothing here tone
+// maps for an HDR color space. The cheapest class is taken, or with
+// wide, the 10-bit formats first, then half floats, then 8-bit. If
+// preferred is in the list, in the cheapest class that the list has,
+// it is taken, so a swapchain can match an image that is blitted into
+// it. Otherwise, among formats of the same class, the first one wins,
+// which is the order the driver likes. A list that only has UNDEFINED
+// means that every format works, then fallback is returned
+VkSurfaceFormatKHR SelectSurfaceFormat(const VkSurfaceFormatKHR* formats, uint32_t count, bool wide, VkFormat preferred, VkFormat fallback);
@@ -0,0 +1,100 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "SyncPool.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+
+SyncPool::SyncPool(VkDevice d)
+{
+	device = d;
+	fenceCount = 0;
+	semaphoreCount = 0;
+}
+
+SyncPool::~SyncPool()
+{
+	for (size_t i = 0; i < freeFences.size(); i++)
+		vkDestroyFence(device, freeFences[i], HostAllocator::callbacks);
+
+	for (size_t i = 0; i < freeSemaphores.size(); i++)
+		vkDestroySemaphore(device, freeSemaphores[i], HostAllocator::callbacks);
+}
+
+VkFence SyncPool::AcquireFence()
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	if (freeFences.size() > 0)
+	{
+		VkFence fence = freeFences.back();
+		freeFences.pop_back();
+		return fence;
+	}
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence;
+	vkCreateFence(device, &fenceInfo, HostAllocator::callbacks, &fence);
+	fenceCount++;
+	return fence;
+}
+
+void SyncPool::ReleaseFence(VkFence fence)
+{
+	// resetting a fence that is not signaled does nothing,
+	// so it does not matter if the fence was ever submitted
+	DeviceTable::ResetFences(device, 1, &fence);
+
+	std::lock_guard<std::mutex> guard(lock);
+	freeFences.push_back(fence);
+}
+
+VkSemaphore SyncPool::AcquireSemaphore()
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	if (freeSemaphores.size() > 0)
+	{
+		VkSemaphore semaphore = freeSemaphores.back();
+		freeSemaphores.pop_back();
+		return semaphore;
+	}
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	VkSemaphore semaphore;
+	vkCreateSemaphore(device, &semaphoreInfo, HostAllocator::callbacks, &semaphore);
+	semaphoreCount++;
+	return semaphore;
+}
+
+void SyncPool::ReleaseSemaphore(VkSemaphore semaphore)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	freeSemaphores.push_back(semaphore);
+}
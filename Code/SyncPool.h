@@ -0,0 +1,72 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <mutex>
+#include <vector>
+
+// Fences and binary semaphores that are made once, and used again
+// and again. Work that needs a fence or a semaphore for a while (an
+// upload batch, a readback) takes one, and gives it back when the GPU
+// is done with it, so vkCreateFence and vkCreateSemaphore are only
+// called when the pool is empty. Any thread can use the pool
+class SyncPool
+{
+private:
+	VkDevice device;
+	std::mutex lock;
+
+	std::vector<VkFence> freeFences;
+	std::vector<VkSemaphore> freeSemaphores;
+
+public:
+	// how many were made, which stops growing once
+	// the pool has enough for all of the work in flight
+	uint32_t fenceCount;
+	uint32_t semaphoreCount;
+
+	SyncPool(VkDevice d);
+
+	// everything must have been given back, what is
+	// still out is not destroyed
+	~SyncPool();
+
+	// the fence is not signaled
+	VkFence AcquireFence();
+
+	// The fence must not be in a submission that is still running.
+	// It is reset here, so the next user gets it unsignaled
+	void ReleaseFence(VkFence fence);
+
+	// the semaphore is not signaled
+	VkSemaphore AcquireSemaphore();
+
+	// A binary semaphore can not be reset. The wait on it must
+	// have finished (the fence or the timeline of the submission
+	// that waited on it says so), then it is unsignaled again
+	void ReleaseSemaphore(VkSemaphore semaphore);
+};
@@ -0,0 +1,217 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TelemetryChannel.h"
+#include "CpuProfiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static uint64_t NowUs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(CpuClock::now().time_since_epoch()).count();
+}
+
+TelemetryChannel::TelemetryChannel(const char* channelName)
+{
+	mapping = nullptr;
+	header = nullptr;
+	latePresents = 0;
+	droppedPresents = 0;
+	lastPresentId = 0;
+	startUs = NowUs();
+
+	void* view = nullptr;
+
+#ifdef _WIN32
+	// The mapping is backed by the page file, not by a file of its own,
+	// and "Local\" keeps it in the session of the user that runs the demo
+	snprintf(name, sizeof(name), "Local\\%s", channelName);
+
+	HANDLE mappingHandle = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(TelemetryHeader), name);
+
+	if (mappingHandle == NULL)
+		return;
+
+	view = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(TelemetryHeader));
+
+	if (view == NULL)
+	{
+		CloseHandle(mappingHandle);
+		return;
+	}
+
+	mapping = mappingHandle;
+#else
+	// the same thing, with POSIX shared memory, which
+	// is unlinked again when the channel is deleted
+	snprintf(name, sizeof(name), "/%s", channelName);
+
+	int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+
+	if (fd < 0)
+		return;
+
+	if (ftruncate(fd, sizeof(TelemetryHeader)) != 0)
+	{
+		close(fd);
+		shm_unlink(name);
+		return;
+	}
+
+	view = mmap(NULL, sizeof(TelemetryHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	// the mapping keeps the memory open by itself
+	close(fd);
+
+	if (view == MAP_FAILED)
+	{
+		shm_unlink(name);
+		return;
+	}
+#endif
+
+	// A monitor can already have the mapping open (from the last run),
+	// so an old sample would still be there. Every slot starts over
+	// at sequence 0, and the magic is written last, so the monitor
+	// never reads a header that is only half done
+	header = (TelemetryHeader*)view;
+	header->magic = 0;
+	header->version = TELEMETRY_VERSION;
+	header->slotCount = TELEMETRY_SLOTS;
+	header->slotSize = sizeof(TelemetrySlot);
+	header->padding = 0;
+	header->written.store(0, std::memory_order_relaxed);
+
+#ifdef _WIN32
+	header->processId = (uint32_t)GetCurrentProcessId();
+#else
+	header->processId = (uint32_t)getpid();
+#endif
+
+	for (uint32_t i = 0; i < TELEMETRY_SLOTS; i++)
+	{
+		header->slots[i].sequence.store(0, std::memory_order_relaxed);
+		header->slots[i].padding = 0;
+		memset(&header->slots[i].sample, 0, sizeof(TelemetrySample));
+	}
+
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = TELEMETRY_MAGIC;
+}
+
+TelemetryChannel::~TelemetryChannel()
+{
+	if (header == nullptr)
+		return;
+
+	// the monitor sees that the demo is gone, when
+	// it keeps the mapping open after we close it
+	header->magic = 0;
+
+#ifdef _WIN32
+	UnmapViewOfFile(header);
+	CloseHandle((HANDLE)mapping);
+#else
+	munmap(header, sizeof(TelemetryHeader));
+	shm_unlink(name);
+#endif
+}
+
+void TelemetryChannel::AddPresent(uint32_t presentID, bool late)
+{
+	// the same counting as MetricsExporter::AddPresent, the IDs in
+	// between were replaced by newer images, or thrown away
+	if (lastPresentId != 0 && presentID > lastPresentId + 1)
+		droppedPresents += presentID - lastPresentId - 1;
+
+	if (presentID > lastPresentId)
+		lastPresentId = presentID;
+
+	if (late)
+		latePresents++;
+}
+
+void TelemetryChannel::Publish(TelemetrySample sample)
+{
+	sample.timeUs = NowUs() - startUs;
+	sample.latePresents = latePresents;
+	sample.droppedPresents = droppedPresents;
+	sample.padding = 0;
+
+	// Only this thread ever writes, so the sequence can be read and
+	// written without a compare exchange. It goes odd before the
+	// sample changes, and even again after, the fences keep the
+	// sample stores from moving outside of the two sequence stores
+	uint64_t written = header->written.load(std::memory_order_relaxed);
+	TelemetrySlot& slot = header->slots[written % TELEMETRY_SLOTS];
+
+	uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	memcpy(&slot.sample, &sample, sizeof(TelemetrySample));
+
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.sequence.store(sequence + 2, std::memory_order_relaxed);
+
+	header->written.store(written + 1, std::memory_order_release);
+}
+
+bool TelemetryChannel::ReadLatest(const TelemetryHeader* header, TelemetrySample* sample)
+{
+	if (header->magic != TELEMETRY_MAGIC || header->version != TELEMETRY_VERSION)
+		return false;
+
+	uint64_t written = header->written.load(std::memory_order_acquire);
+
+	if (written == 0)
+		return false;
+
+	const TelemetrySlot& slot = header->slots[(written - 1) % header->slotCount];
+
+	// an odd sequence is a write that is not done yet, and a sequence
+	// that changed while copying means the copy can be torn
+	uint32_t before = slot.sequence.load(std::memory_order_acquire);
+
+	if (before & 1)
+		return false;
+
+	memcpy(sample, (const void*)&slot.sample, sizeof(TelemetrySample));
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint32_t after = slot.sequence.load(std::memory_order_relaxed);
+
+	return before == after;
+}
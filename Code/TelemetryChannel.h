@@ -0,0 +1,133 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+// the shared memory starts with this, so a monitor
+// knows that it opened the right thing ("VTLM")
+#define TELEMETRY_MAGIC 0x4D4C5456
+#define TELEMETRY_VERSION 1
+
+// how many frames the ring keeps, a monitor that reads
+// at least every TELEMETRY_SLOTS frames never misses one
+#define TELEMETRY_SLOTS 256
+
+// The numbers of one frame. This is read by other programs,
+// so it only has fixed size types, and it never has pointers
+struct TelemetrySample
+{
+	uint64_t frame;
+
+	// microseconds since the channel was opened
+	uint64_t timeUs;
+
+	float cpuMs;
+	float gpuMs;
+	uint32_t draws;
+
+	// since the channel was opened, from display timing, presents
+	// that were on the screen later than we wanted, and presents
+	// that were never on the screen at all
+	uint32_t latePresents;
+	uint32_t droppedPresents;
+	uint32_t padding;
+
+	uint64_t memoryUsage;
+	uint64_t memoryBudget;
+};
+
+// One frame of the ring, with its own seqlock. The sequence is odd
+// while the demo writes the sample, and it goes up by two for every
+// write, so a reader that sees the same even number before and after
+// copying the sample knows that nothing changed it in between
+struct TelemetrySlot
+{
+	std::atomic<uint32_t> sequence;
+	uint32_t padding;
+	TelemetrySample sample;
+};
+
+// The layout of the whole shared memory. written is how many samples
+// were ever published, the newest one is in slot (written - 1) %
+// slotCount. A monitor only reads, it never writes anything in here
+struct TelemetryHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slotCount;
+	uint32_t slotSize;
+	uint32_t processId;
+	uint32_t padding;
+	std::atomic<uint64_t> written;
+	TelemetrySlot slots[TELEMETRY_SLOTS];
+};
+
+// Publishes the numbers of every frame into a named shared memory,
+// in a ring of TELEMETRY_SLOTS samples, so a watchdog or a monitor on
+// the same machine can read them without a socket, and without the
+// demo ever waiting for it. Publishing is a copy into the mapping,
+// the cost is a few stores per frame, even with nobody reading.
+// A monitor maps the same name itself, with OpenFileMapping and
+// MapViewOfFile on Windows, or shm_open and mmap everywhere else,
+// and then reads the header that it mapped with ReadLatest
+class TelemetryChannel
+{
+private:
+	// the mapping, from the operating system
+	void* mapping;
+	TelemetryHeader* header;
+	char name[64];
+
+	// counted by AddPresent, written with every sample
+	uint32_t latePresents;
+	uint32_t droppedPresents;
+	uint32_t lastPresentId;
+
+	uint64_t startUs;
+
+public:
+	// name is the name of the shared memory, like "vkcube_telemetry",
+	// it is "Local\name" on Windows, and "/name" everywhere else
+	TelemetryChannel(const char* name);
+	~TelemetryChannel();
+
+	// false if the shared memory could not be made
+	bool IsOpen() { return header != nullptr; }
+
+	// one present that came back from display timing, presentID
+	// counts up, so a present that is skipped was never shown
+	void AddPresent(uint32_t presentID, bool late);
+
+	// writes the sample of one frame into the next slot of the ring,
+	// timeUs, latePresents and droppedPresents are filled in here
+	void Publish(TelemetrySample sample);
+
+	// For monitors: copies the newest sample out of a header that was
+	// mapped by another process. Returns false if nothing was published
+	// yet, or if the demo kept writing the slot while it was read
+	static bool ReadLatest(const TelemetryHeader* header, TelemetrySample* sample);
+};
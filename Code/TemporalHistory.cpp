@@ -0,0 +1,156 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TemporalHistory.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <string.h>
+
+TemporalHistory::TemporalHistory(
+	VkDevice d,
+	MemoryAllocator* a,
+	VkDescriptorSetLayout layout,
+	VkSampler pointSampler,
+	VkSampler linearSampler,
+	TextureGPU* color,
+	TextureGPU* depthBuffer,
+	uint32_t w,
+	uint32_t h)
+{
+	device = d;
+	width = w;
+	height = h;
+	current = 0;
+	valid = false;
+
+	// Half floats keep more precision than the swapchain format, the
+	// history is blended again and again, and 8 bits would band
+	VkImageCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	info.imageType = VK_IMAGE_TYPE_2D;
+	info.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	info.extent.width = width;
+	info.extent.height = height;
+	info.extent.depth = 1;
+	info.mipLevels = 1;
+	info.arrayLayers = 1;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		images[i] = new TextureGPU(device, a, info, VK_IMAGE_ASPECT_COLOR_BIT);
+		images[i]->SetName((i == 0) ? "Temporal history 0" : "Temporal history 1");
+		images[i]->format = info.format;
+	}
+
+	// the depth buffer is read with the depth aspect only,
+	// even if its format has stencil
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = depthBuffer->format;
+	viewInfo.image = depthBuffer->image;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = 1;
+	vkCreateImageView(device, &viewInfo, HostAllocator::callbacks, &depthView);
+
+	// each set has three sampled images, and one storage image
+	VkDescriptorPoolSize poolSizes[2];
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = 6;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = 2;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 2;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &descPool);
+
+	VkDescriptorSetLayout layouts[2] = { layout, layout };
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descPool;
+	allocInfo.descriptorSetCount = 2;
+	allocInfo.pSetLayouts = layouts;
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, sets);
+
+	// The history that is written stays in GENERAL, and the one that
+	// is read is in SHADER_READ_ONLY, after the frame graph changes it.
+	// The render pass leaves the depth buffer in DEPTH_STENCIL_READ_ONLY
+	VkDescriptorImageInfo imageInfos[8];
+	VkWriteDescriptorSet writes[8];
+	memset(writes, 0, sizeof(writes));
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		VkDescriptorImageInfo* setInfos = &imageInfos[i * 4];
+
+		setInfos[0].sampler = pointSampler;
+		setInfos[0].imageView = color->imageView;
+		setInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		setInfos[1].sampler = pointSampler;
+		setInfos[1].imageView = depthView;
+		setInfos[1].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		setInfos[2].sampler = linearSampler;
+		setInfos[2].imageView = images[1 - i]->imageView;
+		setInfos[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		setInfos[3].sampler = VK_NULL_HANDLE;
+		setInfos[3].imageView = images[i]->imageView;
+		setInfos[3].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		for (uint32_t j = 0; j < 4; j++)
+		{
+			VkWriteDescriptorSet& write = writes[i * 4 + j];
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = sets[i];
+			write.dstBinding = j;
+			write.descriptorCount = 1;
+			write.descriptorType = (j == 3) ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			write.pImageInfo = &setInfos[j];
+		}
+	}
+
+	DeviceTable::UpdateDescriptorSets(device, 8, writes, 0, NULL);
+}
+
+TemporalHistory::~TemporalHistory()
+{
+	// destroying the pool also frees the sets
+	vkDestroyDescriptorPool(device, descPool, HostAllocator::callbacks);
+	vkDestroyImageView(device, depthView, HostAllocator::callbacks);
+
+	delete images[0];
+	delete images[1];
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "MemoryAllocator.h"
+#include "TextureGPU.h"
+
+// The two history images of the temporal upscaler. In every frame,
+// one of them is read (what the last frame wrote), and the other one
+// is written, and then they swap. The one that was written is what
+// is copied to the swapchain. It depends on the size of the window,
+// just like the depth buffer, so it is made again (and retired) with
+// the depth buffer
+class TemporalHistory
+{
+private:
+	VkDevice device;
+	VkDescriptorPool descPool;
+
+public:
+	// RGBA16F, written by the temporal shader (STORAGE), read
+	// by the next frame (SAMPLED), and blitted (TRANSFER_SRC)
+	TextureGPU* images[2];
+
+	// the depth buffer, with only the depth aspect,
+	// because a sampled view can only have one aspect
+	VkImageView depthView;
+
+	// sets[i] writes images[i], and reads the other image,
+	// with the offscreen color and the depth buffer
+	VkDescriptorSet sets[2];
+
+	uint32_t width;
+	uint32_t height;
+
+	// the image that the frame that is being recorded writes
+	uint32_t current;
+
+	// false until a frame has written the history, before
+	// that, there is no history to blend with
+	bool valid;
+
+	TemporalHistory(
+		VkDevice d,
+		MemoryAllocator* a,
+		VkDescriptorSetLayout layout,
+		VkSampler pointSampler,
+		VkSampler linearSampler,
+		TextureGPU* color,
+		TextureGPU* depthBuffer,
+		uint32_t w,
+		uint32_t h);
+
+	~TemporalHistory();
+
+	// called once per frame, before the frame is recorded
+	void Swap() { current = 1 - current; }
+};
\ No newline at end of file
@@ -0,0 +1,90 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <glm/glm.hpp>
+#include "TemporalHistory.h"
+#include "SamplerCache.h"
+
+// the size of the workgroups of the temporal shader,
+// it must match local_size_x and local_size_y
+#define TEMPORAL_WORKGROUP_SIZE 8
+
+// This is given to the temporal shader with push
+// constants, it must match TemporalVals in cube_temporal.comp
+struct TemporalConstants
+{
+	// from the clip space of this frame to the clip space of
+	// the last frame, both without the jitter
+	glm::mat4 reprojection;
+
+	// xy is the jitter of this frame, in pixels of the render size,
+	// z is how much of this frame goes into the history, w is unused
+	glm::vec4 jitter;
+
+	int32_t renderWidth;
+	int32_t renderHeight;
+	int32_t outputWidth;
+	int32_t outputHeight;
+};
+
+// The temporal upscaler. The scene is drawn at a lower resolution,
+// with the projection moved by less than a pixel in every frame
+// (the jitter), so each frame sees different places inside of the
+// pixels. This pass reprojects the history of the last frames to
+// where it is now, with the depth and the matrices of both frames,
+// and blends this frame into it, at the size of the window. After a
+// few frames, every pixel of the window has seen enough samples to
+// look close to a frame that was drawn at the size of the window.
+// The pipeline does not depend on the size of the window, so it is
+// made once, and the history (which does depend on it) is made with
+// the depth buffer, see TemporalHistory
+class TemporalPass
+{
+private:
+	VkDevice device;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+public:
+	// every history allocates its sets with this layout
+	VkDescriptorSetLayout layout;
+
+	// NEAREST for the image that was drawn and the depth,
+	// which are read with texelFetch, and LINEAR for the
+	// history, which is read between its pixels
+	VkSampler pointSampler;
+	VkSampler linearSampler;
+
+	TemporalPass(VkDevice d, VkPipelineCache cache, SamplerCache* samplers);
+	~TemporalPass();
+
+	// This must be recorded outside of a render pass, after the render
+	// pass that drew the image. It writes history->images[history->current],
+	// the barriers before and after it come from the frame graph
+	void Resolve(VkCommandBuffer cmd, TemporalHistory* history, const TemporalConstants& constants);
+};
\ No newline at end of file
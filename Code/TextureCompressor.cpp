@@ -0,0 +1,306 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TextureCompressor.h"
+#include "BufferGPU.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <string.h>
+#include <utility>
+
+// the push constants of cube_compress.comp
+struct CompressVals
+{
+	int32_t width;
+	int32_t height;
+	uint32_t blocksX;
+	uint32_t blocksY;
+};
+
+TextureCompressor::TextureCompressor(VkDevice d, VkPipelineCache cache, MemoryAllocator* a, VkQueue q, CommandBufferPool* c, SyncPool* s)
+{
+	device = d;
+	allocator = a;
+	queue = q;
+	cmds = c;
+	syncPool = s;
+	bytesBefore = 0;
+	bytesAfter = 0;
+
+	// The shader reads the texture at binding 0 (with texelFetch,
+	// so it needs no sampler), and writes the blocks at binding 1
+	VkDescriptorSetLayoutBinding bindings[2];
+	memset(bindings, 0, sizeof(bindings));
+
+	bindings[0].binding = 0;
+	bindings[0].descriptorCount = 1;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorCount = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+	vkCreateDescriptorSetLayout(device, &layoutInfo, HostAllocator::callbacks, &layout);
+
+	// the size of the texture, and its number of blocks
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(CompressVals);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &layout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &pipelineLayoutInfo, HostAllocator::callbacks, &pipelineLayout);
+
+	// Compute Shader compiled to header, see compileShaders.cmd
+	const unsigned char cs_code[] = {
+		#include "cube_compress.comp.inc"
+	};
+
+	VkShaderModuleCreateInfo shaderInfo = {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = (uint32_t*)cs_code;
+	shaderInfo.codeSize = sizeof(cs_code);
+
+	VkShaderModule module;
+	vkCreateShaderModule(device, &shaderInfo, HostAllocator::callbacks, &module);
+
+	VkComputePipelineCreateInfo pipeInfo = {};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeInfo.stage.module = module;
+	pipeInfo.stage.pName = "main";
+	pipeInfo.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(device, cache, 1, &pipeInfo, HostAllocator::callbacks, &pipeline) != VK_SUCCESS)
+	{
+		ERR_EXIT("Failed to create the texture compression pipeline\n", "Pipeline Failure");
+	}
+
+	vkDestroyShaderModule(device, module, HostAllocator::callbacks);
+
+	VkDescriptorPoolSize poolSizes[2];
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	poolSizes[0].descriptorCount = 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	vkCreateDescriptorPool(device, &poolInfo, HostAllocator::callbacks, &descPool);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+	DeviceTable::AllocateDescriptorSets(device, &allocInfo, &descSet);
+}
+
+TextureCompressor::~TextureCompressor()
+{
+	vkDestroyPipeline(device, pipeline, HostAllocator::callbacks);
+	vkDestroyPipelineLayout(device, pipelineLayout, HostAllocator::callbacks);
+	vkDestroyDescriptorPool(device, descPool, HostAllocator::callbacks);
+	vkDestroyDescriptorSetLayout(device, layout, HostAllocator::callbacks);
+}
+
+bool TextureCompressor::IsSupported(VkPhysicalDevice gpu)
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(gpu, COMPRESS_FORMAT, &props);
+
+	return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+void TextureCompressor::Record(VkCommandBuffer cmd, VkImageView source, VkBuffer dst, uint32_t width, uint32_t height)
+{
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageView = source;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = dst;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[2];
+	memset(writes, 0, sizeof(writes));
+
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = descSet;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorCount = 1;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	writes[0].pImageInfo = &imageInfo;
+
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet = descSet;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorCount = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[1].pBufferInfo = &bufferInfo;
+
+	DeviceTable::UpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+	CompressVals vals;
+	vals.width = (int32_t)width;
+	vals.height = (int32_t)height;
+	vals.blocksX = (width + 3) / 4;
+	vals.blocksY = (height + 3) / 4;
+
+	DeviceTable::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	DeviceTable::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descSet, 0, NULL);
+	DeviceTable::CmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vals), &vals);
+
+	DeviceTable::CmdDispatch(cmd,
+		(vals.blocksX + COMPRESS_WORKGROUP_SIZE - 1) / COMPRESS_WORKGROUP_SIZE,
+		(vals.blocksY + COMPRESS_WORKGROUP_SIZE - 1) / COMPRESS_WORKGROUP_SIZE, 1);
+}
+
+void TextureCompressor::Compress(TextureGPU* texture)
+{
+	uint32_t width = texture->extent.width;
+	uint32_t height = texture->extent.height;
+	uint32_t blockCount = ((width + 3) / 4) * ((height + 3) / 4);
+
+	// 8 bytes for every block, which the shader writes,
+	// and the copy moves into the compressed image
+	VkBufferCreateInfo buf_info = {};
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.size = (VkDeviceSize)blockCount * 8;
+	buf_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	BufferGPU blocks(device, allocator, buf_info);
+	blocks.SetName("Compressed blocks");
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = COMPRESS_FORMAT;
+	image_create_info.extent = texture->extent;
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	TextureGPU compressed(device, allocator, image_create_info, VK_IMAGE_ASPECT_COLOR_BIT);
+	compressed.SetName("Compressed texture");
+
+	VkCommandBuffer cmd = cmds->Begin();
+
+	// the texture was written by a copy or by a render pass,
+	// in a submission before this one, and the shader reads it
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+
+	Record(cmd, texture->imageView, blocks.buffer, width, height);
+
+	// The copy reads what the shader wrote. The blocks are tightly
+	// packed, so the row length is left at zero, a row length in pixels
+	// would have to be a multiple of 4, which the width might not be
+	VkBufferImageCopy region = compressed.GetRegion(width, height, 0);
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+
+	VkBufferMemoryBarrier bufferBarrier = {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = blocks.buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	VkImageMemoryBarrier imageBarrier = compressed.BeginCopy(1, &region, false);
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, NULL, 1, &bufferBarrier, 1, &imageBarrier);
+
+	DeviceTable::CmdCopyBufferToImage(cmd, blocks.buffer, compressed.image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	// this is the queue that draws, so nothing is released
+	if (compressed.EndCopy(VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, &imageBarrier))
+	{
+		DeviceTable::CmdPipelineBarrier(cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, NULL, 0, NULL, 1, &imageBarrier);
+	}
+
+	DeviceTable::EndCommandBuffer(cmd);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+
+	// The buffer of blocks is deleted when this returns, and so is the
+	// RGBA image, so we wait for the GPU here, like GpuDecompressor
+	VkFence fence = syncPool->AcquireFence();
+
+	VkResult err;
+	{
+		QueueLock queueLock;
+		err = DeviceTable::QueueSubmit(queue, 1, &submitInfo, fence);
+	}
+	if (err != VK_SUCCESS)
+		ERR_EXIT("vkQueueSubmit failed\n", "Compression Failure");
+
+	DeviceTable::WaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	syncPool->ReleaseFence(fence);
+
+	bytesBefore += texture->GetMemorySize();
+	bytesAfter += compressed.GetMemorySize();
+
+	// the RGBA image is destroyed, and the texture takes the BC1 image
+	*texture = std::move(compressed);
+}
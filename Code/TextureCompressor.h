@@ -0,0 +1,89 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include "MemoryAllocator.h"
+#include "TextureGPU.h"
+#include "CommandBufferPool.h"
+#include "SyncPool.h"
+
+// the shader has 8x8 invocations in each
+// workgroup, one for each block of 4x4 pixels
+#define COMPRESS_WORKGROUP_SIZE 8
+
+// the format that the textures are compressed to
+#define COMPRESS_FORMAT VK_FORMAT_BC1_RGB_UNORM_BLOCK
+
+// Compresses RGBA textures that were made while the program runs (the
+// generated textures of the scene, or anything that was drawn into a
+// texture) to BC1 on the GPU, with cube_compress.comp. A KTX2 file was
+// compressed before the program started, these can not be. BC1 is half
+// a byte per pixel, so the texture takes an eighth of the memory, and
+// every sample reads an eighth of the bytes. The shader uses the corners
+// of the box around the colors of each block, which is fast, and good
+// enough for textures that are not photos
+class TextureCompressor
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+	VkQueue queue;
+	CommandBufferPool* cmds;
+	SyncPool* syncPool;
+
+	VkDescriptorSetLayout layout;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+	VkDescriptorPool descPool;
+	VkDescriptorSet descSet;
+
+public:
+	// the memory of every texture before and after it was compressed
+	VkDeviceSize bytesBefore;
+	VkDeviceSize bytesAfter;
+
+	// The work goes to this queue (which has to be able to use compute
+	// shaders), in command buffers from cmds
+	TextureCompressor(VkDevice d, VkPipelineCache cache, MemoryAllocator* a, VkQueue q, CommandBufferPool* c, SyncPool* s);
+	~TextureCompressor();
+
+	// true if the GPU can sample COMPRESS_FORMAT
+	static bool IsSupported(VkPhysicalDevice gpu);
+
+	// Records the shader, which reads level 0 of source (in
+	// SHADER_READ_ONLY layout), and writes its blocks to dst, which
+	// needs STORAGE_BUFFER usage and 8 bytes for every block. Only one
+	// texture can be on the GPU at a time, they share the descriptor set
+	void Record(VkCommandBuffer cmd, VkImageView source, VkBuffer dst, uint32_t width, uint32_t height);
+
+	// Replaces the RGBA texture with a BC1 texture of the same size, with
+	// one level. The texture has to be SAMPLED and ready for the shaders.
+	// Everyone who has a pointer to the texture keeps it, but a
+	// descriptor of the old view has to be written again. This waits
+	// for the GPU, it is for loading, not for the frames
+	void Compress(TextureGPU* texture);
+};
@@ -24,9 +24,12 @@ that utilizes Vulkan, see more at http://cemu.info
 
 #include "TextureGPU.h"
 #include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <vector>
 
 // When we create a GPU buffer, we need the Device (lets us give commands to GPU),
-// we need the Memory Properties from the PhysicalDevice (same GPU, but the properties of teh GPU),
+// we need the MemoryAllocator, which hands out pieces of large memory blocks,
 // and we need the BufferCreateInfo, to tell us what type of buffer this is (uniform, vertex, index, etc)
 
 // Texture buffers are a little different from other GPU buffers. They require
@@ -36,56 +39,113 @@ that utilizes Vulkan, see more at http://cemu.info
 // pixel data that was in the texture file, but the GPU won't know what to do with it.
 // By using this special class, it allows the GPU to get information about our texture.
 
-// In addition to Device and Memory Properties,
+TextureGPU::TextureGPU()
+{
+	device = VK_NULL_HANDLE;
+	allocator = nullptr;
+	aspect = 0;
+	viewCreateInfo = {};
+	createInfo = {};
+	pendingMips = false;
+	copyRange = {};
+	format = VK_FORMAT_UNDEFINED;
+	image = VK_NULL_HANDLE;
+	imageView = VK_NULL_HANDLE;
+	extent = {};
+	mipLevels = 0;
+	sparse = false;
+	memory = {};
+}
+
+// In addition to Device and MemoryAllocator,
 // we need VkImageCreateInfo, and VkImageAspectFlags
 TextureGPU::TextureGPU(
 	VkDevice d,
-	VkPhysicalDeviceMemoryProperties memory_properties,
+	MemoryAllocator* a,
 	VkImageCreateInfo image_create_info,
-	VkImageAspectFlags aspect)
+	VkImageAspectFlags aspect,
+	bool bindLater,
+	bool arrayView,
+	const void* viewNext)
 {
 	// save device, so that
 	// we can use it to store
 	// data, and delete data
 	device = d;
 
+	// save the allocator, so that we can
+	// give our memory back when we are deleted
+	allocator = a;
+
+	// save the size of the image, and the number of
+	// mip levels, GenerateMips needs to know them
+	extent = image_create_info.extent;
+	mipLevels = image_create_info.mipLevels;
+	pendingMips = false;
+	sparse = (image_create_info.flags & VK_IMAGE_CREATE_SPARSE_BINDING_BIT) != 0;
+	memory = {};
+	createInfo = image_create_info;
+
 	// create image with the device, by using VkImageCreateInfo.
 	// This sepecifically makes a VkImage, rather than an ordinary
 	// VkBuffer, which allows the GPU to have image properteis
-	vkCreateImage(device, &image_create_info, NULL, &image);
-
-	// get memory requirements, so that we know
-	// what we need in order to allocate the memory
-	VkMemoryRequirements mem_reqs;
-	vkGetImageMemoryRequirements(device, image, &mem_reqs);
-
-	// create allocation information
-	// this uses the memory requirements
-	// to tell the device how to allocate the buffer
-	VkMemoryAllocateInfo memAllocInfo = {};
-	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAllocInfo.allocationSize = mem_reqs.size;
-
-	// This is exactly the same as BufferGPU,
-	// we are looking for memory on the Device (VkDevice),
-	// which allows us to store the data in the VRAM
-	Helper::memory_type_from_properties(
-		memory_properties,
-		mem_reqs.memoryTypeBits,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		&memAllocInfo.memoryTypeIndex);
-
-	// allocate memory
-	// our memoryAllocationInfo got the required size
-	// from the VkMemoryRequirements, and it got
-	// the type of memory from memory_type_from_properties
-	vkAllocateMemory(device, &memAllocInfo, NULL, &memory);
-
-	// After our memory is allocated, we have
-	// to bind the buffer to the memory, so that
-	// we can use the memory. Binding image memory
-	// requires a special vkBindImageMemory function
-	vkBindImageMemory(device, image, memory, 0);
+	vkCreateImage(device, &image_create_info, HostAllocator::callbacks, &image);
+
+	// every image gets a name, SetName can give it a better one
+	DEBUG_NAME(device, VK_OBJECT_TYPE_IMAGE, image, "TextureGPU");
+
+	// A sparse image is not bound to one piece of memory. Its
+	// pages are bound with vkQueueBindSparse by whoever made it,
+	// and they can be bound and unbound while the image exists.
+	// An image that is bound later shares memory that is not ours
+	if (!sparse && !bindLater)
+	{
+		// get memory requirements, so that we know
+		// what we need in order to allocate the memory
+		VkMemoryRequirements mem_reqs;
+		vkGetImageMemoryRequirements(device, image, &mem_reqs);
+
+		// This is exactly the same as BufferGPU,
+		// we are looking for memory on the Device (VkDevice),
+		// which allows us to store the data in the VRAM.
+		// Optimally-tiled images are not "linear", so the
+		// allocator keeps them away from buffers, to respect
+		// the GPU's bufferImageGranularity
+		bool linear = image_create_info.tiling == VK_IMAGE_TILING_LINEAR;
+		bool allocated = false;
+
+		// A transient attachment (like the depth buffer) is only used
+		// inside of a render pass, and nothing reads it afterwards.
+		// Tiled GPUs (like phones) keep it in on-chip tile memory, and
+		// with LAZILY_ALLOCATED memory, they never need real memory for
+		// it at all. Desktop GPUs usually do not have this memory type,
+		// so then we use normal DEVICE_LOCAL memory
+		if (image_create_info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+		{
+			allocated = allocator->AllocateImage(
+				image,
+				mem_reqs,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+				linear,
+				&memory);
+		}
+
+		if (!allocated && !allocator->AllocateImage(
+			image,
+			mem_reqs,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			linear,
+			&memory))
+		{
+			ERR_EXIT("Failed to allocate memory for TextureGPU\n", "Memory Allocation Failure");
+		}
+
+		// After our memory is allocated, we have
+		// to bind the buffer to the memory, so that
+		// we can use the memory. Binding image memory
+		// requires a special vkBindImageMemory function
+		vkBindImageMemory(device, image, memory.memory, memory.offset);
+	}
 
 	// When we created our Swapchain, it was mentioned
 	// that we had our images in the form of VkImage, but
@@ -104,9 +164,12 @@ TextureGPU::TextureGPU(
 	// We create this imageView almost exactly the same
 	// way as we did when we made the ImageViews for
 	// the Swapchain Images
+	// An image with more than one layer (see TexturePacker) is
+	// seen as one sampler2DArray, the shader picks the layer
 	VkImageViewCreateInfo viewInfo = {};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.pNext = viewNext;
+	viewInfo.viewType = (arrayView || image_create_info.arrayLayers > 1) ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = image_create_info.format;
 
 	// we hvae to label each of the color components
@@ -120,41 +183,244 @@ TextureGPU::TextureGPU(
 	// for depth, or several other types
 	viewInfo.subresourceRange.aspectMask = aspect;
 
-	// If you don't know what mipmaps are, or mipmap chains, 
-	// don't worry about it. This image (the swapchain image),
-	// does not have a mipmap chain, so the base level is 0,
-	// and there is 1 level. Honestly just don't worry about it.
+	// A mipmap chain is a list of smaller copies of the image,
+	// each one is half as wide and half as tall as the last one.
+	// The depth buffer has 1 level, and textures can have many,
+	// see GenerateMips. The view starts at level 0, and it
+	// includes every level that the image has
 	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.levelCount = mipLevels;
 
 	// Technically, in Vulkan's eyes, every image is an array
 	// so we tell it that there is one image in the array,
 	// and that the element of the array we want is 0,
 	// which literally means "there is one image, so use
-	// that one image"
+	// that one image". A texture array has every layer in the view
 	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = 1;
+	viewInfo.subresourceRange.layerCount = image_create_info.arrayLayers;
 
 	// Put the VKImage inside the VkImageViewInfo
 	viewInfo.image = image;
 
-	// Create the VkImageView given our VkImageViewInfo
-	vkCreateImageView(device, &viewInfo, NULL, &imageView);
-
 	// save the VkImageViewCreaetInfo, it will come in handy
 	// later when we are copying data from CPU to GPU
 	viewCreateInfo = viewInfo;
+	copyRange = viewInfo.subresourceRange;
+
+	// A view can only be made for an image that has memory,
+	// so an image that is bound later gets its view in Bind
+	imageView = VK_NULL_HANDLE;
+
+	if (bindLater)
+		return;
+
+	// Create the VkImageView given our VkImageViewInfo
+	vkCreateImageView(device, &viewInfo, HostAllocator::callbacks, &imageView);
+	DEBUG_NAME(device, VK_OBJECT_TYPE_IMAGE_VIEW, imageView, "TextureGPU");
+}
+
+TextureGPU::TextureGPU(TextureGPU&& other)
+{
+	Take(other);
+}
+
+TextureGPU& TextureGPU::operator=(TextureGPU&& other)
+{
+	// whatever this texture had before is destroyed first
+	if (this != &other)
+	{
+		Destroy();
+		Take(other);
+	}
+
+	return *this;
+}
+
+void TextureGPU::Take(TextureGPU& other)
+{
+	device = other.device;
+	allocator = other.allocator;
+	aspect = other.aspect;
+	viewCreateInfo = other.viewCreateInfo;
+	createInfo = other.createInfo;
+	pendingMips = other.pendingMips;
+	copyRange = other.copyRange;
+	format = other.format;
+	image = other.image;
+	imageView = other.imageView;
+	extent = other.extent;
+	mipLevels = other.mipLevels;
+	sparse = other.sparse;
+	memory = other.memory;
+
+	// the other one is empty now, so
+	// its destructor does nothing
+	other.image = VK_NULL_HANDLE;
+	other.imageView = VK_NULL_HANDLE;
+	other.memory = {};
 }
 
 TextureGPU::~TextureGPU()
 {
-	// First we destroy the memory,
-	// then we destroy the image that used the memory
-	// then we destroy the imageView that used the image
-	// the order doesn't really matter though
-	vkFreeMemory(device, memory, NULL);
-	vkDestroyImage(device, image, NULL);
-	vkDestroyImageView(device, imageView, NULL);
+	Destroy();
+}
+
+void TextureGPU::Destroy()
+{
+	// an empty (or moved) texture has nothing to destroy
+	if (image == VK_NULL_HANDLE)
+		return;
+
+	// First we destroy the imageView that used the image,
+	// then we destroy the image that used the memory,
+	// then we give the memory back to the allocator.
+	// Now that many resources share one block, the memory
+	// must be given back last, so that nothing else can be
+	// placed in it while our image still exists
+	vkDestroyImageView(device, imageView, HostAllocator::callbacks);
+	vkDestroyImage(device, image, HostAllocator::callbacks);
+
+	if (!sparse)
+		allocator->Free(&memory);
+
+	image = VK_NULL_HANDLE;
+	imageView = VK_NULL_HANDLE;
+	memory = {};
+}
+
+void TextureGPU::SetName(const char* name)
+{
+	DEBUG_NAME(device, VK_OBJECT_TYPE_IMAGE, image, name);
+
+	if (imageView != VK_NULL_HANDLE)
+		DEBUG_NAME(device, VK_OBJECT_TYPE_IMAGE_VIEW, imageView, name);
+}
+
+VkMemoryRequirements TextureGPU::GetRequirements()
+{
+	VkMemoryRequirements mem_reqs;
+	vkGetImageMemoryRequirements(device, image, &mem_reqs);
+	return mem_reqs;
+}
+
+void TextureGPU::Bind(VkDeviceMemory deviceMemory, VkDeviceSize offset)
+{
+	// memory.block stays nullptr, so the
+	// destructor does not give the memory back
+	vkBindImageMemory(device, image, deviceMemory, offset);
+
+	vkCreateImageView(device, &viewCreateInfo, HostAllocator::callbacks, &imageView);
+	DEBUG_NAME(device, VK_OBJECT_TYPE_IMAGE_VIEW, imageView, "TextureGPU");
+}
+
+TextureGPU* TextureGPU::Relocate(VkCommandBuffer cmd)
+{
+	// sparse images and images that share memory
+	// with others (see Bind) can not be moved
+	if (sparse || memory.block == nullptr)
+		return nullptr;
+
+	// find the room first, so that nothing
+	// changes if there is no room anywhere
+	MemoryAllocation moved;
+
+	if (!allocator->AllocateElsewhere(GetRequirements(), memory.block, &moved))
+		return nullptr;
+
+	// This makes a new image with no memory. We keep the new image,
+	// and the TextureGPU that we give back gets the old image, the old
+	// view, and the old memory, so deleting it frees the old block
+	TextureGPU* old = new TextureGPU(device, allocator, createInfo, viewCreateInfo.subresourceRange.aspectMask, true);
+
+	VkImage newImage = old->image;
+	old->image = image;
+	old->imageView = imageView;
+	old->memory = memory;
+	old->viewCreateInfo.image = image;
+
+	image = newImage;
+	memory = moved;
+	viewCreateInfo.image = image;
+
+	vkBindImageMemory(device, image, memory.memory, memory.offset);
+	vkCreateImageView(device, &viewCreateInfo, HostAllocator::callbacks, &imageView);
+	DEBUG_NAME(device, VK_OBJECT_TYPE_IMAGE_VIEW, imageView, "TextureGPU");
+
+	// The frames before this one read the old image in their fragment
+	// shaders, the copy has to wait for them. The new image has nothing
+	// in it yet, so its old layout is UNDEFINED
+	VkImageMemoryBarrier barriers[2] = {};
+
+	for (int i = 0; i < 2; i++)
+	{
+		barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].subresourceRange = viewCreateInfo.subresourceRange;
+	}
+
+	barriers[0].image = old->image;
+	barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	barriers[1].image = image;
+	barriers[1].srcAccessMask = 0;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, NULL, 0, NULL, 2, barriers);
+
+	// every level is copied with one call, the
+	// images are the same, so the extents match
+	std::vector<VkImageCopy> regions(mipLevels);
+
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		VkImageCopy region = {};
+		region.srcSubresource = { viewCreateInfo.subresourceRange.aspectMask, i, 0, createInfo.arrayLayers };
+		region.dstSubresource = region.srcSubresource;
+		region.extent.width = (extent.width >> i) > 0 ? (extent.width >> i) : 1;
+		region.extent.height = (extent.height >> i) > 0 ? (extent.height >> i) : 1;
+		region.extent.depth = 1;
+		regions[i] = region;
+	}
+
+	DeviceTable::CmdCopyImage(cmd,
+		old->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		(uint32_t)regions.size(), regions.data());
+
+	// the frames after this read the new image
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 0, NULL, 0, NULL, 1, &barriers[1]);
+
+	return old;
+}
+
+VkImageView TextureGPU::CreateView(uint32_t baseLevel)
+{
+	// A view that starts at a smaller level looks like a smaller
+	// texture to the shaders, they can not read the bigger levels
+	VkImageViewCreateInfo viewInfo = viewCreateInfo;
+	viewInfo.subresourceRange.baseMipLevel = baseLevel;
+	viewInfo.subresourceRange.levelCount = mipLevels - baseLevel;
+
+	VkImageView view;
+	vkCreateImageView(device, &viewInfo, HostAllocator::callbacks, &view);
+	DEBUG_NAME(device, VK_OBJECT_TYPE_IMAGE_VIEW, view, "TextureGPU level view");
+
+	return view;
 }
 
 // Keep in mind, this function is used to store data
@@ -163,8 +429,121 @@ TextureGPU::~TextureGPU()
 // it for the depth buffer, because depth buffers are not
 // copied from CPU to GPU, they are created on GPU, 
 // written to by the GPU, and read by the GPU.
-void TextureGPU::Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int width, int height)
+
+// srcFamily and dstFamily are only used if the copy happens on a
+// transfer queue, and the texture will be used on a graphics queue
+// of a different family, see Uploader.cpp
+void TextureGPU::Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int width, int height, VkDeviceSize srcOffset, uint32_t srcFamily, uint32_t dstFamily)
+{
+	VkBufferImageCopy copy_region = GetRegion(width, height, srcOffset);
+
+	// Only level 0 is in the CPU buffer, so if there
+	// are more levels, they are generated on the GPU
+	Copy(cmd, cpuBuffer, 1, &copy_region, mipLevels > 1, srcFamily, dstFamily);
+}
+
+VkBufferImageCopy TextureGPU::GetRegion(int width, int height, VkDeviceSize srcOffset)
+{
+	// Create information that lets us copy the buffer,
+	// by knowing the width, the height, which is needed
+	// twice for some reason, and where the pixels start
+	// in the CPU buffer
+	VkBufferImageCopy copy_region = {};
+	copy_region.bufferOffset = srcOffset;
+	copy_region.bufferRowLength = width;
+	copy_region.bufferImageHeight = height;
+	copy_region.imageExtent = { (uint32_t)width, (uint32_t)height, 1 };
+
+	// this subResource is not exactly the same as
+	// the imageCreateInfo subresource, so we put in
+	// values manually
+	copy_region.imageSubresource = 
+		{ viewCreateInfo.subresourceRange.aspectMask, 0, 0, 1 };
+
+	return copy_region;
+}
+
+// This is for textures that already have every mip level in the
+// CPU buffer (like KTX2 files, see KtxFile.cpp), with one region
+// for each level. Compressed formats cannot be blitted, so every
+// level has to come from the file
+void TextureGPU::StoreLevels(VkCommandBuffer cmd, VkBuffer cpuBuffer, uint32_t regionCount, const VkBufferImageCopy* regions, uint32_t srcFamily, uint32_t dstFamily)
+{
+	Copy(cmd, cpuBuffer, regionCount, regions, false, srcFamily, dstFamily);
+}
+
+VkResult TextureGPU::StoreHost(PFN_vkTransitionImageLayoutEXT transitionFn, PFN_vkCopyMemoryToImageEXT copyFn,
+	const void* data, uint32_t regionCount, const VkBufferImageCopy* regions)
+{
+	// The same levels as BeginCopy, and the layout is changed
+	// before the copy, the copy writes the image in that layout
+	BeginCopy(regionCount, regions, false);
+
+	VkHostImageLayoutTransitionInfoEXT transition = {};
+	transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+	transition.image = image;
+	transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	transition.subresourceRange = copyRange;
+
+	VkResult err = transitionFn(device, 1, &transition);
+
+	if (err != VK_SUCCESS)
+		return err;
+
+	// the regions point into data, instead of into a buffer
+	std::vector<VkMemoryToImageCopyEXT> copies(regionCount);
+
+	for (uint32_t i = 0; i < regionCount; i++)
+	{
+		VkMemoryToImageCopyEXT& copy = copies[i];
+		copy = {};
+		copy.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+		copy.pHostPointer = (const uint8_t*)data + regions[i].bufferOffset;
+		copy.memoryRowLength = regions[i].bufferRowLength;
+		copy.memoryImageHeight = regions[i].bufferImageHeight;
+		copy.imageSubresource = regions[i].imageSubresource;
+		copy.imageOffset = regions[i].imageOffset;
+		copy.imageExtent = regions[i].imageExtent;
+	}
+
+	VkCopyMemoryToImageInfoEXT copyInfo = {};
+	copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+	copyInfo.dstImage = image;
+	copyInfo.dstImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	copyInfo.regionCount = regionCount;
+	copyInfo.pRegions = copies.data();
+
+	return copyFn(device, &copyInfo);
+}
+
+VkImageMemoryBarrier TextureGPU::BeginCopy(uint32_t regionCount, const VkBufferImageCopy* regions, bool generateMips)
 {
+	// Acquire needs to know if the mips still need to be made
+	pendingMips = generateMips;
+
+	// GenerateMips writes every level, otherwise only the levels
+	// in the regions are written. A sparse image might not have
+	// memory for the other levels, and the shaders might be
+	// reading them, so their layouts are left alone
+	copyRange = viewCreateInfo.subresourceRange;
+
+	if (!generateMips)
+	{
+		uint32_t first = regions[0].imageSubresource.mipLevel;
+		uint32_t last = first;
+
+		for (uint32_t i = 1; i < regionCount; i++)
+		{
+			uint32_t level = regions[i].imageSubresource.mipLevel;
+			first = (level < first) ? level : first;
+			last = (level > last) ? level : last;
+		}
+
+		copyRange.baseMipLevel = first;
+		copyRange.levelCount = last - first + 1;
+	}
+
 	// If anyone thinks it will be easy to store GPU textures in VRAM
 	// as easy as it was to store other GPU buffers into VRAM,
 	// that person is in for a big surprise.
@@ -216,10 +595,25 @@ void TextureGPU::Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int width, int h
 	image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
 	image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 
+	// The levels of a sparse image can be loaded again after they
+	// were unbound, then they are not PREINITIALIZED anymore.
+	// UNDEFINED is always allowed, it throws the old pixels away
+	if (sparse)
+		image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
 	// copy data from the imageViewCreateInfo that we made
 	// in the TextureGPU constructor, into the memory barrier
 	image_memory_barrier.image = viewCreateInfo.image;
-	image_memory_barrier.subresourceRange = viewCreateInfo.subresourceRange;
+	image_memory_barrier.subresourceRange = copyRange;
+	image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+	return image_memory_barrier;
+}
+
+void TextureGPU::Copy(VkCommandBuffer cmd, VkBuffer cpuBuffer, uint32_t regionCount, const VkBufferImageCopy* regions, bool generateMips, uint32_t srcFamily, uint32_t dstFamily)
+{
+	VkImageMemoryBarrier image_memory_barrier = BeginCopy(regionCount, regions, generateMips);
 
 	// TOP_OF_PIPE is the stage that the GPU's memory is currently at, which is where all memory is initially
 	// VK_PIPELINE_STAGE_TRANSFER_BIT is the stage that we want the memory to be in, so we can transfer data to 
@@ -227,33 +621,68 @@ void TextureGPU::Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int width, int h
 	// vkCmdPipelineBarrier is a pause in the command buffer that waits
 	// for conditions to be met before proceding. This pause will happen
 	// while the command buffer is running, which will not happen until 
-	// we execute the initCmd in Demo.cpp
+	// the Uploader submits the command buffer
 	
 	// We move the memory (defined in image_memory_barrier) from top of pipe to the transfer stage
 	// The command buffer will not proceed until this is finished
-	vkCmdPipelineBarrier(cmd,
+	DeviceTable::CmdPipelineBarrier(cmd,
 		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
 		0, 0, NULL, 0, NULL,
 		1, &image_memory_barrier);
 
-	// Create information that lets us copy the buffer,
-	// by knowing the width, the height, which is needed
-	// twice for some reason
-	VkBufferImageCopy copy_region = {};
-	copy_region.bufferRowLength = width;
-	copy_region.bufferImageHeight = height;
-	copy_region.imageExtent = { (uint32_t)width, (uint32_t)height, 1 };
+	// Copy the image data from the CPU buffer to the GPU buffer
+	DeviceTable::CmdCopyBufferToImage(cmd, cpuBuffer, image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions);
 
-	// this subResource is not exactly the same as
-	// the imageCreateInfo subresource, so we put in
-	// values manually
-	copy_region.imageSubresource = 
-		{ viewCreateInfo.subresourceRange.aspectMask, 0, 0, 1 };
+	// the mips are made from level 0 right away
+	if (!EndCopy(srcFamily, dstFamily, &image_memory_barrier))
+	{
+		GenerateMips(cmd);
+		return;
+	}
 
-	// Copy the image data from the CPU buffer to the GPU buffer
-	vkCmdCopyBufferToImage(cmd, cpuBuffer, image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+	// VK_PIPELINE_STAGE_TRANSFER_BIT is the stage that the GPU's memory is currently at
+	// VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT is where memory can be accessed by the fragment shader,
+	// a release to another queue family does not wait for anything on this queue (BOTTOM_OF_PIPE)
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		(srcFamily != dstFamily) ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 0, NULL, 0, NULL,
+		1, &image_memory_barrier);
+}
+
+bool TextureGPU::EndCopy(uint32_t srcFamily, uint32_t dstFamily, VkImageMemoryBarrier* barrier)
+{
+	VkImageMemoryBarrier image_memory_barrier = {};
+	image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_memory_barrier.image = viewCreateInfo.image;
+	image_memory_barrier.subresourceRange = copyRange;
+
+	// If there is a mipmap chain, only level 0 was copied, and the
+	// other levels are made from level 0 with vkCmdBlitImage, which
+	// only works on a graphics queue. Every level stays in
+	// TRANSFER_DST for now, GenerateMips changes the layouts
+	if (pendingMips)
+	{
+		// On a transfer-only queue, release the texture to the graphics
+		// queue, without changing the layout, then Acquire() will
+		// generate the mips on the graphics queue
+		if (srcFamily == dstFamily)
+			return false;
+
+		image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		image_memory_barrier.dstAccessMask = 0;
+		image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		image_memory_barrier.srcQueueFamilyIndex = srcFamily;
+		image_memory_barrier.dstQueueFamilyIndex = dstFamily;
+
+		*barrier = image_memory_barrier;
+		return true;
+	}
 
 	// We are done writing to the GPU for this buffer
 	// so let's change AccessMask from WRITE_BIT, to nothing (0)
@@ -263,19 +692,141 @@ void TextureGPU::Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int width, int h
 	image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 	image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// VK_PIPELINE_STAGE_TRANSFER_BIT is the stage that the GPU's memory is currently at
-	// VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT is where memory can be accessed by the fragment shader
+	// If this command buffer is on a transfer-only queue, then 
+	// the fragment shader stage does not exist on this queue.
+	// Instead, this barrier "releases" the texture to dstFamily,
+	// and Acquire() finishes the job on the graphics queue
+	if (srcFamily != dstFamily)
+	{
+		image_memory_barrier.srcQueueFamilyIndex = srcFamily;
+		image_memory_barrier.dstQueueFamilyIndex = dstFamily;
+	}
+
+	*barrier = image_memory_barrier;
+	return true;
+}
 
-	// vkCmdPipelineBarrier is a pause in the command buffer that waits
-	// for conditions to be met before proceding. This pause will happen
-	// while the command buffer is running, which will not happen until 
-	// we execute the initCmd in Demo.cpp
-	
-	// We move the memory (defined in image_memory_barrier) from top of pipe to the transfer stage
-	// The command buffer will not proceed until this is finished
-	vkCmdPipelineBarrier(cmd,
+void TextureGPU::Acquire(VkCommandBuffer cmd, uint32_t srcFamily, uint32_t dstFamily)
+{
+	VkImageMemoryBarrier image_memory_barrier = GetAcquireBarrier(srcFamily, dstFamily);
+
+	DeviceTable::CmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		pendingMips ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 0, NULL, 0, NULL,
+		1, &image_memory_barrier);
+
+	// With a mipmap chain, the texture was released in TRANSFER_DST,
+	// so it is acquired in TRANSFER_DST, and then the mips are made
+	if (pendingMips)
+		GenerateMips(cmd);
+}
+
+VkImageMemoryBarrier TextureGPU::GetAcquireBarrier(uint32_t srcFamily, uint32_t dstFamily)
+{
+	// This is the second half of the ownership transfer.
+	// It must be recorded on a queue of dstFamily, and it
+	// must have the same layouts and families as the barrier
+	// that released the texture at the end of Store()
+	VkImageMemoryBarrier image_memory_barrier = {};
+	image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	image_memory_barrier.srcAccessMask = 0;
+	image_memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	image_memory_barrier.srcQueueFamilyIndex = srcFamily;
+	image_memory_barrier.dstQueueFamilyIndex = dstFamily;
+	image_memory_barrier.image = viewCreateInfo.image;
+	image_memory_barrier.subresourceRange = copyRange;
+
+	// the mips are made on this queue, so the texture stays in TRANSFER_DST
+	if (pendingMips)
+	{
+		image_memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	}
+
+	return image_memory_barrier;
+}
+
+// This must be recorded on a graphics queue, after level 0 was
+// copied, while every level is still in TRANSFER_DST. Each level is
+// made by shrinking the level before it with vkCmdBlitImage, and
+// then the level before it is given to the fragment shader
+void TextureGPU::GenerateMips(VkCommandBuffer cmd)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = viewCreateInfo.subresourceRange.aspectMask;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	int32_t width = (int32_t)extent.width;
+	int32_t height = (int32_t)extent.height;
+
+	for (uint32_t i = 1; i < mipLevels; i++)
+	{
+		// finish writing to the last level, so we can read from it
+		barrier.subresourceRange.baseMipLevel = i - 1;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		DeviceTable::CmdPipelineBarrier(cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, NULL, 0, NULL,
+			1, &barrier);
+
+		// each level is half the size of the last level,
+		// but never smaller than one pixel
+		int32_t nextWidth = width > 1 ? width / 2 : 1;
+		int32_t nextHeight = height > 1 ? height / 2 : 1;
+
+		VkImageBlit blit = {};
+		blit.srcSubresource = { barrier.subresourceRange.aspectMask, i - 1, 0, 1 };
+		blit.srcOffsets[1] = { width, height, 1 };
+		blit.dstSubresource = { barrier.subresourceRange.aspectMask, i, 0, 1 };
+		blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+
+		// LINEAR filtering averages the pixels
+		// of the last level, as it shrinks
+		DeviceTable::CmdBlitImage(cmd,
+			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+
+		// we are done with the last level, give it to the fragment shader
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		DeviceTable::CmdPipelineBarrier(cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, NULL, 0, NULL,
+			1, &barrier);
+
+		width = nextWidth;
+		height = nextHeight;
+	}
+
+	// the smallest level was never read, it was only written
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	DeviceTable::CmdPipelineBarrier(cmd,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
 		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 		0, 0, NULL, 0, NULL,
-		1, &image_memory_barrier);
+		1, &barrier);
 }
@@ -25,28 +25,162 @@ that utilizes Vulkan, see more at http://cemu.info
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vulkan/vk_sdk_platform.h>
+#include "MemoryAllocator.h"
+#include "DebugUtils.h"
+#include "HostImageCopy.h"
 
 class TextureGPU
 {
 private:
-	VkDeviceMemory memory;
+	MemoryAllocation memory;
+	MemoryAllocator* allocator;
 	VkDevice device;
 	VkImageAspectFlags aspect;
 	VkImageViewCreateInfo viewCreateInfo;
 
+	// Relocate makes another image just like this one
+	VkImageCreateInfo createInfo;
+
+	// true if the last copy needs GenerateMips
+	bool pendingMips;
+
+	// the levels that the last copy wrote, the barriers
+	// of Copy and Acquire only change those levels
+	VkImageSubresourceRange copyRange;
+
+	// takes everything from other, which is left empty
+	void Take(TextureGPU& other);
+
+	void Copy(
+		VkCommandBuffer cmd,
+		VkBuffer cpuBuffer,
+		uint32_t regionCount,
+		const VkBufferImageCopy* regions,
+		bool generateMips,
+		uint32_t srcFamily,
+		uint32_t dstFamily);
+
 public:
 	VkFormat format;
 	VkImage image;
 	VkImageView imageView;
 
+	// the size of mip level 0, and the number of mip levels
+	VkExtent3D extent;
+	uint32_t mipLevels;
+
+	// A sparse image (VK_IMAGE_CREATE_SPARSE_BINDING_BIT) has no
+	// memory of its own, its pages are bound later, see SparseTilePool
+	bool sparse;
+
+	// an empty texture, which has no image and no memory,
+	// so that a TextureGPU can be a member before it is made
+	TextureGPU();
+
+	// With bindLater, the image gets no memory and no view yet,
+	// whoever made it binds it to memory with Bind (see TransientPool).
+	// An image with more than one layer gets a 2D array view, and
+	// arrayView gives one to an image with one layer too. viewNext is
+	// the pNext of every view of the image (see VideoTexture), it has
+	// to stay alive as long as the texture does
 	TextureGPU(
 		VkDevice d,
-		VkPhysicalDeviceMemoryProperties memory_properties,
+		MemoryAllocator* a,
 		VkImageCreateInfo image_create_info,
-		VkImageAspectFlags aspectFlags);
+		VkImageAspectFlags aspectFlags,
+		bool bindLater = false,
+		bool arrayView = false,
+		const void* viewNext = nullptr);
+
+	// Only moved, never copied, like BufferGPU. Anything that keeps
+	// a pointer to the texture (a pending upload, the streamer) has to
+	// be done with it first, the image and its view move with it
+	TextureGPU(const TextureGPU&) = delete;
+	TextureGPU& operator=(const TextureGPU&) = delete;
+	TextureGPU(TextureGPU&& other);
+	TextureGPU& operator=(TextureGPU&& other);
 
 	~TextureGPU();
 
-	void Store(VkCommandBuffer cmd, VkBuffer cpuBuffer, int width, int height);
+	// destroys the image and its view now, and leaves
+	// it empty, no frame on the GPU can still be using it
+	void Destroy();
+
+	// the name that debuggers show for the image
+	// and its view (debug builds only)
+	void SetName(const char* name);
+
+	// the usage that the image was made with
+	VkImageUsageFlags GetUsage() { return createInfo.usage; }
+
+	// how much memory the image uses, and the block it is in
+	VkDeviceSize GetMemorySize() { return memory.size; }
+	MemoryBlock* GetBlock() { return memory.block; }
+
+	// Moves the image out of its block, for the defragmenter (see
+	// MemoryAllocator::FindDefragBlock). This records a copy into a new
+	// image in another block, and this TextureGPU keeps the new image,
+	// so everyone who has a pointer to it keeps working. It returns a
+	// TextureGPU with the old image and its memory, which has to be
+	// deleted when no frame reads it, or nullptr if there is no room.
+	// The image needs TRANSFER_SRC usage, and SHADER_READ_ONLY layout
+	TextureGPU* Relocate(VkCommandBuffer cmd);
+
+	// Makes another view of the image, which starts at baseLevel and
+	// has every level after it. Whoever asks for it has to destroy it
+	VkImageView CreateView(uint32_t baseLevel);
+
+	// binds an image that was made with bindLater
+	// to memory that someone else owns, and makes its view
+	VkMemoryRequirements GetRequirements();
+	void Bind(VkDeviceMemory deviceMemory, VkDeviceSize offset);
+
+	void Store(
+		VkCommandBuffer cmd,
+		VkBuffer cpuBuffer,
+		int width,
+		int height,
+		VkDeviceSize srcOffset = 0,
+		uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED,
+		uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED);
+
+	void StoreLevels(
+		VkCommandBuffer cmd,
+		VkBuffer cpuBuffer,
+		uint32_t regionCount,
+		const VkBufferImageCopy* regions,
+		uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED,
+		uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED);
+
+	// With VK_EXT_host_image_copy, the CPU copies the regions from data
+	// straight into the image, and changes its layout to SHADER_READ_ONLY
+	// itself, so there is no staging buffer, no command buffer, and no
+	// barrier. Each region's bufferOffset is where it starts in data.
+	// The image needs HOST_TRANSFER usage, and no frame can be using it
+	VkResult StoreHost(
+		PFN_vkTransitionImageLayoutEXT transitionFn,
+		PFN_vkCopyMemoryToImageEXT copyFn,
+		const void* data,
+		uint32_t regionCount,
+		const VkBufferImageCopy* regions);
+
+	void Acquire(VkCommandBuffer cmd, uint32_t srcFamily, uint32_t dstFamily);
+
+	// The parts of Store and Acquire, so that the Uploader can record
+	// the barriers of many textures together (see Uploader::RecordTextures).
+	// BeginCopy gives the barrier to TRANSFER_DST, then the regions are
+	// copied, and EndCopy gives the barrier after the copy. EndCopy
+	// returns false if GenerateMips has to be called instead
+	VkImageMemoryBarrier BeginCopy(uint32_t regionCount, const VkBufferImageCopy* regions, bool generateMips);
+	bool EndCopy(uint32_t srcFamily, uint32_t dstFamily, VkImageMemoryBarrier* barrier);
+	VkImageMemoryBarrier GetAcquireBarrier(uint32_t srcFamily, uint32_t dstFamily);
+
+	// true if the mips of the last copy still need to be made
+	bool NeedsMips() { return pendingMips; }
+
+	// the region that Store copies level 0 with
+	VkBufferImageCopy GetRegion(int width, int height, VkDeviceSize srcOffset);
+
+	void GenerateMips(VkCommandBuffer cmd);
 };
 
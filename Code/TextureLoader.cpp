@@ -0,0 +1,267 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TextureLoader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Decoding a PNG takes much longer than copying its pixels to the
+// GPU, and each image can be decoded without knowing about the others.
+// With hundreds of textures, decoding them one after another on the
+// main thread is the slowest part of starting the program.
+
+// The TextureLoader works in two steps. First, the main thread maps
+// every file, reads the width and height from its header (which is
+// very fast), and makes a CPU buffer that is big enough for its pixels.
+// This part is not done on the workers, so they do not allocate
+// anything, they only write into buffers that are already there.
+// Then, each image becomes a job of the JobSystem, which decodes it,
+// and writes the pixels into that image's buffer. Big and small images are mixed together, but a
+// thread that is done early steals the images that are left
+
+TextureLoader::TextureLoader(VkDevice d, MemoryAllocator* a, JobSystem* js)
+{
+	device = d;
+	allocator = a;
+	jobs = js;
+	useCache = false;
+	cacheHits = 0;
+	decodeCount = 0;
+
+	decoders.push_back(new PngDecoder());
+	decoders.push_back(new StbDecoder());
+}
+
+TextureLoader::~TextureLoader()
+{
+	// delete every buffer that was not given to the Uploader
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		if (images[i]->staging != nullptr)
+			delete images[i]->staging;
+
+		delete images[i];
+	}
+
+	images.clear();
+
+	for (size_t i = 0; i < decoders.size(); i++)
+		delete decoders[i];
+
+	decoders.clear();
+}
+
+void TextureLoader::EnableCache()
+{
+	useCache = true;
+}
+
+bool TextureLoader::OpenCache(DecodedImage* image)
+{
+	// FNV-1a of the whole file, so that any change to the image
+	// changes the name of its cache file. This reads every byte,
+	// but that is much faster than inflating them
+	const char* data = image->file.GetData();
+	size_t size = image->file.GetSize();
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (uint8_t)data[i];
+		hash *= 1099511628211ull;
+	}
+
+	char suffix[32];
+	sprintf(suffix, ".%016llx.rgba", (unsigned long long)hash);
+	image->cachePath = std::string(image->path) + suffix;
+
+	// the header has to match what the PNG says, and
+	// all of the pixels have to be there, or it is decoded
+	size_t pixels = (size_t)image->width * image->height * 4;
+
+	if (!image->cached.Open(image->cachePath.c_str()))
+		return false;
+
+	const uint32_t* header = (const uint32_t*)image->cached.GetData();
+
+	if (image->cached.GetSize() != 4 * sizeof(uint32_t) + pixels ||
+		header[0] != TEXTURE_CACHE_MAGIC || header[1] != TEXTURE_CACHE_VERSION ||
+		header[2] != (uint32_t)image->width || header[3] != (uint32_t)image->height)
+	{
+		image->cached.Close();
+		return false;
+	}
+
+	return true;
+}
+
+uint32_t TextureLoader::Add(const char* path)
+{
+	DecodedImage* image = new DecodedImage();
+	image->path = path;
+	image->width = 0;
+	image->height = 0;
+	image->decoder = nullptr;
+	image->staging = nullptr;
+
+	images.push_back(image);
+	return (uint32_t)images.size() - 1;
+}
+
+void TextureLoader::Decode()
+{
+	// This thread decodes images too, while it waits for the others
+	JobCounter counter;
+	Start(&counter);
+	jobs->Wait(&counter);
+}
+
+void TextureLoader::Start(JobCounter* counter)
+{
+	// Step 1, on this thread: map the files,
+	// and make a buffer for each image
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		DecodedImage* image = images[i];
+
+		if (!image->file.Open(image->path))
+		{
+			printf("Could not open %s\n", image->path);
+			continue;
+		}
+
+		for (size_t d = 0; d < decoders.size() && image->decoder == nullptr; d++)
+		{
+			if (decoders[d]->Info((const uint8_t*)image->file.GetData(), image->file.GetSize(), &image->width, &image->height))
+				image->decoder = decoders[d];
+		}
+
+		if (image->decoder == nullptr)
+		{
+			printf("Could not read the header of %s\n", image->path);
+			image->file.Close();
+			continue;
+		}
+
+		// 4 bytes per pixel (RGBA), the buffer stays mapped so that
+		// the workers can write to it. The decoder reads the row above
+		// to unfilter each row, and reading from write-combined memory
+		// is very slow, so the buffer is cached (and flushed after)
+		VkBufferCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		info.size = (VkDeviceSize)image->width * image->height * 4;
+
+		image->staging = new BufferCPU(device, allocator, info, true, false, true);
+		image->staging->SetName("Texture staging");
+
+		// a cached image does not need its file anymore
+		if (useCache && OpenCache(image))
+		{
+			image->file.Close();
+			cacheHits++;
+		}
+		else
+			decodeCount++;
+	}
+
+	// Step 2: one job for each image. The buffers were made on this
+	// thread, so the workers do not allocate, they only decode
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		DecodedImage* image = images[i];
+		jobs->Run([this, image]() { DecodeImage(image); }, counter);
+	}
+}
+
+void TextureLoader::DecodeImage(DecodedImage* image)
+{
+	if (image->staging == nullptr)
+		return;
+
+	// a warm start: the pixels go straight from the
+	// mapped cache file into the mapped buffer
+	if (image->cached.GetData() != nullptr)
+	{
+		size_t pixels = (size_t)image->width * image->height * 4;
+		memcpy(image->staging->GetPointer(), image->cached.GetData() + 4 * sizeof(uint32_t), pixels);
+		image->cached.Close();
+		image->staging->Flush(0, pixels);
+		return;
+	}
+
+	// the decoder writes the pixels straight into the mapped buffer
+	uint8_t* staging = (uint8_t*)image->staging->GetPointer();
+	size_t size = (size_t)image->width * image->height * 4;
+
+	bool decoded = image->decoder->Decode(
+		(const uint8_t*)image->file.GetData(),
+		image->file.GetSize(),
+		staging,
+		image->width,
+		image->height);
+
+	// we do not need the file anymore
+	image->file.Close();
+
+	if (!decoded)
+	{
+		printf("Could not decode %s with %s\n", image->path, image->decoder->GetName());
+
+		// the buffer can not be deleted here, because the
+		// allocator is not used on the workers, the destructor
+		// of the TextureLoader deletes it instead
+		image->width = 0;
+		image->height = 0;
+		return;
+	}
+
+	image->staging->Flush(0, size);
+
+	// The pixels are read back from the buffer, which is cached memory,
+	// see Decode. If the file can not be written (the folder is read
+	// only), the image is decoded again next time, nothing else changes
+	if (useCache)
+	{
+		std::vector<uint8_t> file(4 * sizeof(uint32_t) + size);
+		uint32_t header[4] = { TEXTURE_CACHE_MAGIC, TEXTURE_CACHE_VERSION, (uint32_t)image->width, (uint32_t)image->height };
+		memcpy(file.data(), header, sizeof(header));
+		memcpy(file.data() + sizeof(header), staging, size);
+
+		if (!Helper::WriteFile(image->cachePath.c_str(), file.data(), file.size()))
+			printf("Failed to save %s to the texture cache\n", image->path);
+	}
+}
+
+DecodedImage* TextureLoader::Get(uint32_t index)
+{
+	return images[index];
+}
+
+uint32_t TextureLoader::GetCount()
+{
+	return (uint32_t)images.size();
+}
@@ -0,0 +1,122 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include <string>
+#include "BufferCPU.h"
+#include "MemoryAllocator.h"
+#include "JobSystem.h"
+#include "Helper.h"
+#include "ImageDecoder.h"
+
+// The decoded pixels of an image are saved next to it, in a file that
+// is named after the hash of the image file (logo.png.<hash>.rgba), so
+// an image that did not change is never decoded again. The file starts
+// with these, then the width and the height, then the RGBA pixels.
+// Change the version when the layout of the file changes
+#define TEXTURE_CACHE_MAGIC 0x41424752
+#define TEXTURE_CACHE_VERSION 1
+
+// One image file that the TextureLoader decodes
+struct DecodedImage
+{
+	const char* path;
+
+	// the file, mapped into memory, until it is decoded
+	MappedFile file;
+
+	// With the cache, the name of the cache file of this image, and
+	// the cache file itself, mapped, if it was there (then the image
+	// is copied from it, not decoded)
+	std::string cachePath;
+	MappedFile cached;
+
+	int width;
+	int height;
+
+	// the first decoder that could read the header of the file
+	ImageDecoder* decoder;
+
+	// The RGBA pixels, in a CPU buffer that the Uploader can copy
+	// from. This is nullptr if the file could not be decoded.
+	// Whoever gives this to the Uploader should set it to nullptr,
+	// because the Uploader deletes it when the copy is done
+	BufferCPU* staging;
+};
+
+// Decodes many PNG (or JPG, TGA, etc) files at the same time, on
+// many threads. Each image is decoded straight into a mapped CPU
+// buffer, which is handed to the Uploader without another copy
+class TextureLoader
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+	JobSystem* jobs;
+
+	std::vector<DecodedImage*> images;
+
+	// tried in this order, the fast PNG path first,
+	// then STB Image for every file that it does not take
+	std::vector<ImageDecoder*> decoders;
+
+	// see EnableCache
+	bool useCache;
+
+	void DecodeImage(DecodedImage* image);
+	bool OpenCache(DecodedImage* image);
+
+public:
+	// how many images came from the cache, and how many were decoded
+	uint32_t cacheHits;
+	uint32_t decodeCount;
+
+	TextureLoader(VkDevice d, MemoryAllocator* a, JobSystem* js);
+	~TextureLoader();
+
+	// With the cache, Decode copies each image from its cache file, if
+	// the image did not change since it was decoded, and saves the
+	// pixels of the images that it does decode. Call it before Decode
+	void EnableCache();
+
+	// returns the index of the image, for Get
+	uint32_t Add(const char* path);
+
+	// decodes every image that was added, and
+	// returns when all of them are finished
+	void Decode();
+
+	// Same as Decode, but it returns after the buffers are made, and
+	// the images are decoded by the job system in the background. The
+	// counter is zero when all of them are finished, Get must not be
+	// called before that, and neither can the loader be deleted
+	void Start(JobCounter* counter);
+
+	DecodedImage* Get(uint32_t index);
+	uint32_t GetCount();
+};
@@ -0,0 +1,197 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TexturePacker.h"
+#include <string.h>
+
+TexturePacker::TexturePacker()
+{
+}
+
+TexturePacker::~TexturePacker()
+{
+	for (TextureGPU* texture : arrays)
+		delete texture;
+}
+
+uint32_t TexturePacker::Add(uint32_t width, uint32_t height, const uint32_t* pixels)
+{
+	PackerSource source;
+	source.width = width;
+	source.height = height;
+	source.pixels.assign(pixels, pixels + (size_t)width * height);
+	sources.push_back(source);
+
+	return (uint32_t)sources.size() - 1;
+}
+
+void TexturePacker::BuildMips(uint32_t width, uint32_t height, uint32_t levels, const uint32_t* pixels, uint32_t* dst)
+{
+	// Level 0 is the texture, and each level after it is the
+	// average of 2x2 pixels of the level before it. The levels
+	// are written one after the other, the smallest one last
+	memcpy(dst, pixels, (size_t)width * height * sizeof(uint32_t));
+
+	const uint32_t* src = dst;
+	dst += (size_t)width * height;
+
+	for (uint32_t level = 1; level < levels; level++)
+	{
+		uint32_t w = (width > 1) ? width / 2 : 1;
+		uint32_t h = (height > 1) ? height / 2 : 1;
+
+		for (uint32_t y = 0; y < h; y++)
+		{
+			for (uint32_t x = 0; x < w; x++)
+			{
+				// a side that is already 1 pixel reads the same pixel twice
+				uint32_t x0 = (width > 1) ? x * 2 : 0;
+				uint32_t y0 = (height > 1) ? y * 2 : 0;
+				uint32_t x1 = (width > 1) ? x0 + 1 : 0;
+				uint32_t y1 = (height > 1) ? y0 + 1 : 0;
+				uint32_t p[4] = { src[y0 * width + x0], src[y0 * width + x1], src[y1 * width + x0], src[y1 * width + x1] };
+				uint32_t out = 0;
+
+				for (uint32_t c = 0; c < 32; c += 8)
+				{
+					uint32_t sum = 0;
+					for (uint32_t i = 0; i < 4; i++)
+						sum += (p[i] >> c) & 0xFF;
+
+					out |= ((sum + 2) / 4) << c;
+				}
+
+				dst[y * w + x] = out;
+			}
+		}
+
+		src = dst;
+		dst += (size_t)w * h;
+		width = w;
+		height = h;
+	}
+}
+
+void TexturePacker::Pack(VkDevice device, MemoryAllocator* allocator, Uploader* uploader, uint32_t maxLayers)
+{
+	placements.assign(sources.size(), { 0, 0 });
+	std::vector<bool> packed(sources.size(), false);
+
+	// Each pass takes the first texture that is left, and every
+	// texture after it with the same size, up to maxLayers of them
+	for (size_t first = 0; first < sources.size(); first++)
+	{
+		if (packed[first])
+			continue;
+
+		uint32_t width = sources[first].width;
+		uint32_t height = sources[first].height;
+		std::vector<uint32_t> layers;
+
+		for (size_t i = first; i < sources.size() && layers.size() < maxLayers; i++)
+		{
+			if (!packed[i] && sources[i].width == width && sources[i].height == height)
+			{
+				placements[i] = { (uint32_t)arrays.size(), (uint32_t)layers.size() };
+				packed[i] = true;
+				layers.push_back((uint32_t)i);
+			}
+		}
+
+		// every level, down to 1x1
+		uint32_t levels = 1;
+		while ((width >> levels) > 0 || (height >> levels) > 0)
+			levels++;
+
+		size_t layerPixels = 0;
+		for (uint32_t level = 0; level < levels; level++)
+		{
+			uint32_t w = (width >> level) > 0 ? (width >> level) : 1;
+			uint32_t h = (height >> level) > 0 ? (height >> level) : 1;
+			layerPixels += (size_t)w * h;
+		}
+
+		std::vector<uint32_t> mips(layerPixels);
+		std::vector<uint32_t> data(layerPixels * layers.size());
+
+		// The copy of one level covers every layer, so the
+		// pixels are sorted by level, and then by layer
+		std::vector<VkBufferImageCopy> regions(levels);
+		size_t levelStart = 0;
+
+		for (uint32_t level = 0; level < levels; level++)
+		{
+			uint32_t w = (width >> level) > 0 ? (width >> level) : 1;
+			uint32_t h = (height >> level) > 0 ? (height >> level) : 1;
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = levelStart * sizeof(uint32_t);
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, (uint32_t)layers.size() };
+			region.imageExtent = { w, h, 1 };
+			regions[level] = region;
+
+			levelStart += (size_t)w * h * layers.size();
+		}
+
+		for (uint32_t l = 0; l < layers.size(); l++)
+		{
+			BuildMips(width, height, levels, sources[layers[l]].pixels.data(), mips.data());
+
+			size_t src = 0;
+			for (uint32_t level = 0; level < levels; level++)
+			{
+				uint32_t w = (width >> level) > 0 ? (width >> level) : 1;
+				uint32_t h = (height >> level) > 0 ? (height >> level) : 1;
+				size_t count = (size_t)w * h;
+				size_t dst = regions[level].bufferOffset / sizeof(uint32_t) + l * count;
+
+				memcpy(&data[dst], &mips[src], count * sizeof(uint32_t));
+				src += count;
+			}
+		}
+
+		VkImageCreateInfo image_create_info = {};
+		image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_create_info.imageType = VK_IMAGE_TYPE_2D;
+		image_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+		image_create_info.extent = { width, height, 1 };
+		image_create_info.mipLevels = levels;
+		image_create_info.arrayLayers = (uint32_t)layers.size();
+		image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		// the shader reads it as an array, even with one layer
+		TextureGPU* texture = new TextureGPU(device, allocator, image_create_info, VK_IMAGE_ASPECT_COLOR_BIT, false, true);
+		texture->SetName("Packed texture array");
+
+		uploader->UploadTextureLevels(texture, data.data(), data.size() * sizeof(uint32_t), levels, regions.data());
+		arrays.push_back(texture);
+	}
+
+	// the pixels are in the staging ring now
+	sources.clear();
+}
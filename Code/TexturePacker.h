@@ -0,0 +1,79 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "TextureGPU.h"
+#include "Uploader.h"
+
+// where one texture that was given to the packer ended up
+struct PackedTexture
+{
+	uint32_t array;
+	uint32_t layer;
+};
+
+// one texture that was added, until Pack copies it
+struct PackerSource
+{
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint32_t> pixels;
+};
+
+// Packs many small RGBA8 textures into a few texture arrays, when they
+// are imported. Every texture of the same size becomes a layer of the
+// same array, so a scene with a hundred small textures has one image,
+// one view, one allocation, and one descriptor, instead of a hundred
+// of each. A layer is a whole texture, so the UVs stay the same (there
+// is nothing to remap, unlike an atlas), REPEAT still works, and no mip
+// level mixes the pixels of two textures. The mips of every layer are
+// made on the CPU, because GenerateMips only makes them for layer 0
+class TexturePacker
+{
+private:
+	std::vector<PackerSource> sources;
+
+	static void BuildMips(uint32_t width, uint32_t height, uint32_t levels, const uint32_t* pixels, uint32_t* dst);
+
+public:
+	// the arrays that Pack made, and the array and layer of every
+	// texture, in the order that they were added
+	std::vector<TextureGPU*> arrays;
+	std::vector<PackedTexture> placements;
+
+	TexturePacker();
+	~TexturePacker();
+
+	// keeps a copy of the pixels, and returns the index
+	// of the texture in placements (after Pack)
+	uint32_t Add(uint32_t width, uint32_t height, const uint32_t* pixels);
+
+	// Makes the arrays, with up to maxLayers layers each
+	// (maxImageArrayLayers), and gives them to the uploader
+	void Pack(VkDevice device, MemoryAllocator* allocator, Uploader* uploader, uint32_t maxLayers);
+};
@@ -0,0 +1,752 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#include "TextureStreamer.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+#include <stdio.h>
+
+// Without sparse images, the memory of an image can not grow or
+// shrink, so changing which levels are resident means making another
+// image with those levels. Its levels are copied from the KTX2 file,
+// where they are stored ready for the GPU, so nothing is decoded.
+// The old image is kept until the frames that read it are done
+
+// With a SparseTilePool, each texture is one sparse image with every
+// level of the file, and no memory. The tail is bound when it is added,
+// and loading a level binds pages to the tiles of that level, then
+// copies it. The shaders read a view that starts at the resident level,
+// so they never see a level without memory. Going back to the tail
+// only makes a new view, the pages are unbound when no frame reads them
+
+TextureStreamer::TextureStreamer(VkDevice d, MemoryAllocator* a, Uploader* u, VkDeviceSize budgetBytes, SparseTilePool* p)
+{
+	device = d;
+	allocator = a;
+	uploader = u;
+	pool = p;
+	budget = budgetBytes;
+	residentBytes = 0;
+	generation = 0;
+	defragCmds = nullptr;
+	defragQueue = VK_NULL_HANDLE;
+	defragSubmits = nullptr;
+	reader = nullptr;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// the callbacks of the reads would upload into the images below
+	if (reader != nullptr)
+		reader->Cancel();
+
+	// the device is idle when the demo deletes us
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		StreamedTexture& t = textures[i];
+
+		// a sparse texture is its own pending image
+		if (t.pending != t.texture)
+			delete t.pending;
+
+		if (t.view != VK_NULL_HANDLE)
+			vkDestroyImageView(device, t.view, HostAllocator::callbacks);
+
+		delete t.texture;
+		delete t.file;
+
+		// the image is gone, so nothing uses the pages
+		for (size_t j = 0; j < t.pages.size(); j++)
+			for (size_t k = 0; k < t.pages[j].size(); k++)
+				pool->FreePage(&t.pages[j][k]);
+
+		for (size_t j = 0; j < t.tailMemory.size(); j++)
+			allocator->Free(&t.tailMemory[j]);
+	}
+
+	for (size_t i = 0; i < retired.size(); i++)
+	{
+		delete retired[i].texture;
+
+		if (retired[i].view != VK_NULL_HANDLE)
+			vkDestroyImageView(device, retired[i].view, HostAllocator::callbacks);
+
+		for (size_t j = 0; j < retired[i].pages.size(); j++)
+			pool->FreePage(&retired[i].pages[j]);
+	}
+}
+
+void TextureStreamer::EnableDefrag(VkQueue queue, CommandBufferPool* cmds, SubmitBatch* batch)
+{
+	if (pool != nullptr)
+		return;
+
+	defragQueue = queue;
+	defragCmds = cmds;
+	defragSubmits = batch;
+}
+
+void TextureStreamer::EnableAsyncReads(AsyncFileReader* r)
+{
+	reader = r;
+}
+
+TextureGPU* TextureStreamer::CreateLevels(StreamedTexture& t, uint32_t first, uint32_t index)
+{
+	KtxFile* file = t.file;
+
+	// level "first" of the file is level 0 of the image
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = file->format;
+	image_create_info.extent = file->regions[first].imageExtent;
+	image_create_info.mipLevels = file->levelCount - first;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+
+	// the defragmenter copies from it
+	if (defragCmds != nullptr)
+		image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	TextureGPU* texture = new TextureGPU(device, allocator, image_create_info, VK_IMAGE_ASPECT_COLOR_BIT);
+	texture->SetName("Streamed texture");
+
+	UploadLevels(t, texture, first, file->levelCount, 0, index);
+
+	residentBytes += texture->GetMemorySize();
+	return texture;
+}
+
+void TextureStreamer::UploadLevels(StreamedTexture& t, TextureGPU* texture, uint32_t first, uint32_t last, uint32_t imageFirst, uint32_t index)
+{
+	KtxFile* file = t.file;
+
+	// Only the bytes of the levels that we need go into the staging
+	// ring. The levels can be anywhere in the file (KTX2 puts the
+	// smallest first), so we copy from the first byte of any of them
+	// to the last byte of any of them. Level "first" of the file
+	// goes to level imageFirst of the image
+	std::vector<VkBufferImageCopy> regions(file->regions.begin() + first, file->regions.begin() + last);
+	VkDeviceSize start = regions[0].bufferOffset;
+	VkDeviceSize end = 0;
+
+	for (uint32_t i = 0; i < regions.size(); i++)
+	{
+		VkDeviceSize offset = regions[i].bufferOffset;
+		VkDeviceSize last = offset + file->levelSizes[first + i];
+
+		start = (offset < start) ? offset : start;
+		end = (last > end) ? last : end;
+	}
+
+	for (uint32_t i = 0; i < regions.size(); i++)
+	{
+		regions[i].bufferOffset -= start;
+		regions[i].imageSubresource.mipLevel = imageFirst + i;
+	}
+
+	if (reader == nullptr || index == UINT32_MAX || t.asyncFile == UINT32_MAX)
+	{
+		t.ticket = uploader->UploadTextureLevels(texture, (void*)(file->GetData() + start), end - start,
+			(uint32_t)regions.size(), regions.data());
+		return;
+	}
+
+	// The same bytes, read into the staging memory of the reader. The
+	// upload starts when they are there, and it is submitted by the
+	// Update that polled the reader. If the read failed, the mapping
+	// still has the bytes, so the level is loaded anyway, only slower
+	t.reading = true;
+
+	reader->Read(t.asyncFile, start, (size_t)(end - start),
+		[this, index, texture, start, regions](const char* data, size_t size, bool ok)
+	{
+		StreamedTexture& t = textures[index];
+
+		if (!ok)
+			data = t.file->GetData() + start;
+
+		t.ticket = uploader->UploadTextureLevels(texture, (void*)data, size,
+			(uint32_t)regions.size(), regions.data());
+		t.reading = false;
+	});
+}
+
+void TextureStreamer::CreateSparse(StreamedTexture& t)
+{
+	KtxFile* file = t.file;
+
+	// one image with every level of the file, and no memory yet
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = file->format;
+	image_create_info.extent = file->regions[0].imageExtent;
+	image_create_info.mipLevels = file->levelCount;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	t.texture = new TextureGPU(device, allocator, image_create_info, VK_IMAGE_ASPECT_COLOR_BIT);
+	t.pages.resize(file->levelCount);
+
+	// The alignment of a sparse image is the size of one tile,
+	// so every page of this image has that size and alignment
+	vkGetImageMemoryRequirements(device, t.texture->image, &t.pageReqs);
+	t.pageReqs.size = t.pageReqs.alignment;
+
+	// The color aspect says how many texels are in one tile
+	// (imageGranularity), and where the mip tail starts. Some GPUs
+	// also have a metadata aspect, which only has a mip tail
+	uint32_t count = 0;
+	vkGetImageSparseMemoryRequirements(device, t.texture->image, &count, NULL);
+	std::vector<VkSparseImageMemoryRequirements> reqs(count);
+	vkGetImageSparseMemoryRequirements(device, t.texture->image, &count, reqs.data());
+
+	t.sparseReqs = {};
+	t.sparseReqs.imageMipTailFirstLod = file->levelCount;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (reqs[i].formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT)
+			t.sparseReqs = reqs[i];
+
+		bool metadata = (reqs[i].formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT) != 0;
+
+		if (reqs[i].imageMipTailSize == 0 || (!metadata && reqs[i].imageMipTailFirstLod >= file->levelCount))
+			continue;
+
+		// the mip tail is bound once, and it stays bound
+		VkMemoryRequirements tailReqs = t.pageReqs;
+		tailReqs.size = reqs[i].imageMipTailSize;
+
+		MemoryAllocation tail;
+		if (!allocator->Allocate(tailReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &tail))
+			ERR_EXIT("Failed to allocate the mip tail of a sparse texture\n", "Memory Allocation Failure");
+
+		pool->BindOpaque(t.texture->image, reqs[i].imageMipTailOffset, reqs[i].imageMipTailSize, &tail);
+		t.tailMemory.push_back(tail);
+		residentBytes += tail.size;
+	}
+
+	// the levels of our tail that are too big for the mip tail
+	for (uint32_t i = t.tailLevel; i < file->levelCount; i++)
+		BindLevel(t, i, true);
+
+	pool->Flush();
+
+	UploadLevels(t, t.texture, t.tailLevel, file->levelCount, t.tailLevel);
+	t.view = t.texture->CreateView(t.tailLevel);
+}
+
+void TextureStreamer::BindLevel(StreamedTexture& t, uint32_t level, bool bind)
+{
+	// the mip tail is always bound
+	if (level >= t.sparseReqs.imageMipTailFirstLod)
+		return;
+
+	// The tiles of a level are a grid, the tiles at the right and
+	// bottom edges can be smaller than imageGranularity
+	VkExtent3D size = t.file->regions[level].imageExtent;
+	VkExtent3D tile = t.sparseReqs.formatProperties.imageGranularity;
+	VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0 };
+
+	for (uint32_t y = 0; y < size.height; y += tile.height)
+	{
+		for (uint32_t x = 0; x < size.width; x += tile.width)
+		{
+			VkOffset3D offset = { (int32_t)x, (int32_t)y, 0 };
+			VkExtent3D extent;
+			extent.width = (size.width - x < tile.width) ? size.width - x : tile.width;
+			extent.height = (size.height - y < tile.height) ? size.height - y : tile.height;
+			extent.depth = 1;
+
+			if (!bind)
+			{
+				pool->UnbindTile(t.texture->image, subresource, offset, extent);
+				continue;
+			}
+
+			MemoryAllocation page;
+			if (!pool->AllocatePage(t.pageReqs, &page))
+				ERR_EXIT("Failed to allocate a page of a sparse texture\n", "Memory Allocation Failure");
+
+			pool->BindTile(t.texture->image, subresource, offset, extent, &page);
+			t.pages[level].push_back(page);
+			residentBytes += page.size;
+		}
+	}
+}
+
+void TextureStreamer::SetView(StreamedTexture& t, uint32_t index, uint32_t level, uint64_t frame)
+{
+	// Frames before this one might be reading the old view. If we go
+	// back to fewer levels, the bigger ones are unbound when those
+	// frames are done, but their memory is not counted anymore
+	RetiredTexture old = {};
+	old.texture = nullptr;
+	old.retireFrame = frame;
+	old.view = t.view;
+	old.index = index;
+	old.firstLevel = t.residentLevel;
+	old.lastLevel = level;
+
+	for (uint32_t i = t.residentLevel; i < level; i++)
+	{
+		for (size_t j = 0; j < t.pages[i].size(); j++)
+		{
+			old.pages.push_back(t.pages[i][j]);
+			residentBytes -= t.pages[i][j].size;
+		}
+
+		t.pages[i].clear();
+	}
+
+	retired.push_back(old);
+
+	t.view = t.texture->CreateView(level);
+	t.residentLevel = level;
+	generation++;
+}
+
+void TextureStreamer::Replace(StreamedTexture& t, TextureGPU* texture, uint32_t level, uint64_t frame)
+{
+	// frames before this one might be reading the old image
+	RetiredTexture old = {};
+	old.texture = t.texture;
+	old.retireFrame = frame;
+	retired.push_back(old);
+
+	residentBytes -= t.texture->GetMemorySize();
+
+	t.texture = texture;
+	t.residentLevel = level;
+	generation++;
+}
+
+bool TextureStreamer::MakeRoom(VkDeviceSize bytes, uint32_t except, uint64_t frame)
+{
+	// If the GPU is almost out of memory (see MemoryAllocator::
+	// GetAvailable), the textures get less than their budget, so
+	// they load fewer levels, instead of making the driver page
+	VkDeviceSize limit = budget;
+	VkDeviceSize available = residentBytes + allocator->GetAvailable(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (available < limit)
+		limit = available;
+
+	// Send the least recently used textures back to their tail,
+	// until there is room. A texture that was used in this frame
+	// is never evicted, it would only be requested again
+	while (residentBytes + bytes > limit)
+	{
+		uint32_t oldest = UINT32_MAX;
+
+		for (uint32_t i = 0; i < textures.size(); i++)
+		{
+			StreamedTexture& t = textures[i];
+
+			if (i == except || t.pending != nullptr || t.lastUsed == frame || t.residentLevel == t.tailLevel)
+				continue;
+
+			if (oldest == UINT32_MAX || t.lastUsed < textures[oldest].lastUsed)
+				oldest = i;
+		}
+
+		if (oldest == UINT32_MAX)
+			return false;
+
+		// the tail is tiny, so it is made right away, and the big
+		// image is freed when the frames that read it are done.
+		// A sparse texture already has its tail
+		StreamedTexture& victim = textures[oldest];
+
+		if (pool != nullptr)
+			SetView(victim, oldest, victim.tailLevel, frame);
+		else
+		{
+			TextureGPU* tail = CreateLevels(victim, victim.tailLevel);
+			Replace(victim, tail, victim.tailLevel, frame);
+		}
+	}
+
+	return true;
+}
+
+VkDeviceSize TextureStreamer::GetLoadBytes(StreamedTexture& t, uint32_t level)
+{
+	VkDeviceSize bytes = 0;
+
+	// A sparse texture only needs pages for the levels that
+	// it does not have. A new image needs every level
+	if (pool != nullptr)
+	{
+		VkExtent3D tile = t.sparseReqs.formatProperties.imageGranularity;
+
+		for (uint32_t i = level; i < t.residentLevel && i < t.sparseReqs.imageMipTailFirstLod; i++)
+		{
+			VkExtent3D size = t.file->regions[i].imageExtent;
+			uint32_t tiles =
+				((size.width + tile.width - 1) / tile.width) *
+				((size.height + tile.height - 1) / tile.height);
+
+			bytes += tiles * t.pageReqs.size;
+		}
+
+		return bytes;
+	}
+
+	for (uint32_t i = level; i < t.file->levelCount; i++)
+		bytes += t.file->levelSizes[i];
+
+	return bytes;
+}
+
+uint32_t TextureStreamer::Add(KtxFile* file, const char* name, const char* path)
+{
+	StreamedTexture t = {};
+	t.file = file;
+	t.asyncFile = (reader != nullptr && path != nullptr) ? reader->Open(path) : UINT32_MAX;
+	t.reading = false;
+
+	// the tail starts at the first level that is small enough
+	t.tailLevel = file->levelCount - 1;
+
+	for (uint32_t i = 0; i < file->levelCount; i++)
+	{
+		if (file->regions[i].imageExtent.width <= STREAM_TAIL_SIZE &&
+			file->regions[i].imageExtent.height <= STREAM_TAIL_SIZE)
+		{
+			t.tailLevel = i;
+			break;
+		}
+	}
+
+	if (pool != nullptr)
+		CreateSparse(t);
+	else
+		t.texture = CreateLevels(t, t.tailLevel);
+
+	t.texture->SetName(name);
+	t.residentLevel = t.tailLevel;
+	t.requestedLevel = t.tailLevel;
+	t.pending = nullptr;
+
+	textures.push_back(t);
+	return (uint32_t)textures.size() - 1;
+}
+
+void TextureStreamer::Request(uint32_t index, uint32_t level, uint64_t frame)
+{
+	StreamedTexture& t = textures[index];
+
+	// many objects can ask for the same texture,
+	// the one that is closest wins
+	if (t.lastUsed != frame || level < t.requestedLevel)
+		t.requestedLevel = (level < t.tailLevel) ? level : t.tailLevel;
+
+	t.lastUsed = frame;
+}
+
+void TextureStreamer::Update(uint64_t frame, uint64_t completedFrames)
+{
+	// delete the images that no frame is reading anymore
+	std::vector<MemoryAllocation> unbound;
+
+	for (size_t i = 0; i < retired.size(); )
+	{
+		RetiredTexture& r = retired[i];
+
+		if (completedFrames < r.retireFrame)
+		{
+			i++;
+			continue;
+		}
+
+		delete r.texture;
+
+		if (r.view != VK_NULL_HANDLE)
+			vkDestroyImageView(device, r.view, HostAllocator::callbacks);
+
+		// A level that was loaded again has new pages bound already,
+		// which replaced the old ones, so it must not be unbound. If
+		// it was loaded and evicted again, the frames might still read
+		// the newer pages, so the newer retired entry unbinds it later
+		StreamedTexture& t = textures[r.index];
+
+		for (uint32_t level = r.firstLevel; level < r.lastLevel; level++)
+		{
+			bool newer = false;
+
+			for (size_t j = i + 1; j < retired.size(); j++)
+			{
+				if (retired[j].index == r.index && !retired[j].pages.empty() &&
+					level >= retired[j].firstLevel && level < retired[j].lastLevel)
+					newer = true;
+			}
+
+			if (t.pages[level].empty() && !newer)
+				BindLevel(t, level, false);
+		}
+
+		unbound.insert(unbound.end(), r.pages.begin(), r.pages.end());
+		retired.erase(retired.begin() + i);
+	}
+
+	// the pages can be used again when they are not bound anymore
+	if (!unbound.empty())
+	{
+		pool->Flush();
+
+		for (size_t i = 0; i < unbound.size(); i++)
+			pool->FreePage(&unbound[i]);
+	}
+
+	// the reads that are done start their uploads
+	if (reader != nullptr)
+		reader->Poll();
+
+	// An upload that is done replaces the image that we have. The
+	// frame could use the new image right away, and the GPU would
+	// wait for the copy, but a big level takes a while to copy, so
+	// the frames keep drawing the old one until the copy is done
+	for (uint32_t i = 0; i < textures.size(); i++)
+	{
+		StreamedTexture& t = textures[i];
+
+		if (t.pending != nullptr && !t.reading && uploader->IsComplete(t.ticket))
+		{
+			if (pool != nullptr)
+				SetView(t, i, t.pendingLevel, frame);
+			else
+				Replace(t, t.pending, t.pendingLevel, frame);
+
+			t.pending = nullptr;
+		}
+	}
+
+	// Start loading the textures that need more detail. Only the
+	// textures that were requested in this frame are seen, and the
+	// one that asks for the most detailed level is the closest to
+	// the camera (or the biggest on the screen), so it goes first,
+	// then the one that needs the most levels. A texture that needs
+	// less detail keeps what it has, until MakeRoom needs the memory
+	uint32_t loads = 0;
+	uint32_t maxLoads = uploader->IsBudgeted() ? UINT32_MAX : STREAM_LOADS_PER_FRAME;
+
+	while (loads < maxLoads)
+	{
+		uint32_t best = UINT32_MAX;
+		uint32_t bestLevel = UINT32_MAX;
+		uint32_t bestMissing = 0;
+
+		for (uint32_t i = 0; i < textures.size(); i++)
+		{
+			StreamedTexture& t = textures[i];
+
+			if (t.pending != nullptr || t.lastUsed != frame || t.requestedLevel >= t.residentLevel)
+				continue;
+
+			uint32_t missing = t.residentLevel - t.requestedLevel;
+
+			if (t.requestedLevel < bestLevel || (t.requestedLevel == bestLevel && missing > bestMissing))
+			{
+				best = i;
+				bestLevel = t.requestedLevel;
+				bestMissing = missing;
+			}
+		}
+
+		if (best == UINT32_MAX)
+			break;
+
+		// With an upload budget, the loads stop when this frame has
+		// copied enough, and the rest of the textures wait for the
+		// next frames, before anything is evicted to make room
+		StreamedTexture& t = textures[best];
+
+		if (!uploader->TakeBudget(GetLoadBytes(t, t.requestedLevel)))
+			break;
+
+		// The new image is a copy of the whole file from the requested
+		// level down, so it needs about 4/3 of the size of that level.
+		// If that does not fit, try one level less, until nothing fits
+		uint32_t level = t.requestedLevel;
+
+		for (; level < t.residentLevel; level++)
+		{
+			if (MakeRoom(GetLoadBytes(t, level), best, frame))
+				break;
+		}
+
+		// nothing fits, so we stop asking for it until the next frame
+		if (level >= t.residentLevel)
+		{
+			t.requestedLevel = t.residentLevel;
+			continue;
+		}
+
+		// The sparse image gets pages for the new levels, and only those
+		// levels are copied. It is its own pending image, the frames keep
+		// reading the old view until the copy is done
+		if (pool != nullptr)
+		{
+			for (uint32_t i = level; i < t.residentLevel; i++)
+				BindLevel(t, i, true);
+
+			pool->Flush();
+
+			UploadLevels(t, t.texture, level, t.residentLevel, level, best);
+			t.pending = t.texture;
+		}
+		else
+			t.pending = CreateLevels(t, level, best);
+
+		t.pendingLevel = level;
+		loads++;
+	}
+
+	// the loads, and the tails of the evicted textures, are
+	// submitted before the frame, this does nothing if there are none
+	uploader->Submit();
+
+	// The defragmenter only runs when nothing is loading, so it does
+	// not slow down the frames that need more detail, and no texture
+	// that it moves is being uploaded
+	if (defragCmds != nullptr && loads == 0)
+	{
+		bool pending = false;
+
+		for (size_t i = 0; i < textures.size(); i++)
+			pending |= (textures[i].pending != nullptr);
+
+		if (!pending)
+			Defragment(frame);
+	}
+}
+
+void TextureStreamer::Defragment(uint64_t frame)
+{
+	MemoryBlock* block = allocator->FindDefragBlock(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (block == nullptr)
+		return;
+
+	// The command buffer belongs to this frame, and it is used
+	// again when the frame is done, so nothing has to free it
+	VkCommandBuffer cmd = defragCmds->Begin();
+
+	// A few textures per frame, so that one frame does not wait
+	// for a lot of copies. The block might have other things in it,
+	// which are not ours, then it stays, but it is still emptier
+	VkDeviceSize bytes = 0;
+	uint32_t moves = 0;
+
+	for (uint32_t i = 0; i < textures.size() && bytes < MEMORY_DEFRAG_BYTES_PER_FRAME; i++)
+	{
+		StreamedTexture& t = textures[i];
+
+		if (t.texture->GetBlock() != block)
+			continue;
+
+		TextureGPU* old = t.texture->Relocate(cmd);
+
+		if (old == nullptr)
+			continue;
+
+		// The frames before this one might be reading the old image,
+		// it is deleted like an image that was replaced. The new one
+		// has the same size, so residentBytes does not change
+		RetiredTexture r = {};
+		r.texture = old;
+		r.retireFrame = frame;
+		retired.push_back(r);
+
+		bytes += old->GetMemorySize();
+		moves++;
+	}
+
+	DeviceTable::EndCommandBuffer(cmd);
+
+	// an empty command buffer is never submitted,
+	// the pool resets it with the rest of the frame
+	if (moves == 0)
+		return;
+
+	// The frame is submitted to the same queue after this, and the
+	// barriers at the end of the copies make its fragment shaders wait
+	// for them, so no semaphore is needed. The views changed, so the
+	// descriptors have to be written again
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+
+	// with a batch, it goes to the GPU together with the frame
+	if (defragSubmits != nullptr)
+		defragSubmits->Add(submitInfo);
+	else
+	{
+		QueueLock queueLock;
+		DeviceTable::QueueSubmit(defragQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
+
+	generation++;
+}
+
+TextureGPU* TextureStreamer::GetTexture(uint32_t index)
+{
+	return textures[index].texture;
+}
+
+VkImageView TextureStreamer::GetView(uint32_t index)
+{
+	StreamedTexture& t = textures[index];
+	return (t.view != VK_NULL_HANDLE) ? t.view : t.texture->imageView;
+}
+
+VkExtent3D TextureStreamer::GetExtent(uint32_t index)
+{
+	return textures[index].file->regions[0].imageExtent;
+}
+
+uint32_t TextureStreamer::GetResidentLevel(uint32_t index)
+{
+	return textures[index].residentLevel;
+}
+
+VkDeviceSize TextureStreamer::GetResidentBytes()
+{
+	return residentBytes;
+}
@@ -0,0 +1,204 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "TextureGPU.h"
+#include "MemoryAllocator.h"
+#include "Uploader.h"
+#include "KtxFile.h"
+#include "SparseTilePool.h"
+#include "CommandBufferPool.h"
+#include "AsyncFileReader.h"
+
+// Mip levels that are this many pixels wide (or less) are the "tail"
+// of a texture. The tail is tiny, so it is always on the GPU, and a
+// texture can always be drawn, even before its big levels are loaded
+#define STREAM_TAIL_SIZE 64
+
+// how many textures can start loading in one frame, so that a lot
+// of new requests do not fill the staging ring in one frame. With
+// an upload budget, the budget decides instead (see TakeBudget)
+#define STREAM_LOADS_PER_FRAME 1
+
+// One texture that is streamed from a KTX2 file. The GPU image only
+// has the levels from residentLevel to the smallest one, when more
+// detail is requested, a bigger image is made and uploaded, and when
+// it is done, it replaces the old one
+struct StreamedTexture
+{
+	KtxFile* file;
+
+	// the image that the shaders read right now
+	TextureGPU* texture;
+	uint32_t residentLevel;
+
+	// the first level of the tail, which is always resident
+	uint32_t tailLevel;
+
+	// the most detailed level that was asked for
+	// in this frame, and the last frame it was asked for
+	uint32_t requestedLevel;
+	uint64_t lastUsed;
+
+	// the image that is being uploaded, or nullptr
+	TextureGPU* pending;
+	uint32_t pendingLevel;
+	UploadTicket ticket;
+
+	// With asynchronous reads, the file that the reader has open
+	// (UINT32_MAX if it has none), and reading is true until the
+	// bytes of the pending levels are read, and ticket is valid
+	uint32_t asyncFile;
+	bool reading;
+
+	// With sparse images, texture has every level of the file, but
+	// only the resident levels have memory, and the shaders read
+	// them with this view, which starts at residentLevel
+	VkImageView view;
+
+	// the pages of each level, empty if the level is not bound,
+	// and the memory of the mip tail, which is always bound
+	std::vector<std::vector<MemoryAllocation>> pages;
+	std::vector<MemoryAllocation> tailMemory;
+	VkSparseImageMemoryRequirements sparseReqs;
+	VkMemoryRequirements pageReqs;
+};
+
+// an image that frames on the GPU might still read
+struct RetiredTexture
+{
+	TextureGPU* texture;
+	uint64_t retireFrame;
+
+	// With sparse images, this is the view of the old levels, and the
+	// pages of the levels from firstLevel to (but not including)
+	// lastLevel of the texture at index, which are unbound and freed
+	VkImageView view;
+	uint32_t index;
+	uint32_t firstLevel;
+	uint32_t lastLevel;
+	std::vector<MemoryAllocation> pages;
+};
+
+// Keeps the mip levels of many textures on the GPU, as long as they
+// fit in the budget. Each frame, the demo asks for the level that
+// each texture is seen at (Request), and Update loads the levels that
+// are missing. When there is no room, the texture that was used the
+// longest time ago (least recently used) goes back to its tail
+class TextureStreamer
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+	Uploader* uploader;
+
+	// nullptr if the textures are not sparse
+	SparseTilePool* pool;
+
+	std::vector<StreamedTexture> textures;
+	std::vector<RetiredTexture> retired;
+
+	// the memory of every texture and pending texture
+	VkDeviceSize residentBytes;
+
+	// nullptr unless EnableDefrag was called
+	CommandBufferPool* defragCmds;
+	VkQueue defragQueue;
+	SubmitBatch* defragSubmits;
+
+	// nullptr unless EnableAsyncReads was called
+	AsyncFileReader* reader;
+
+	// Without an index, the levels are copied from the mapped file right
+	// away. With one, and a reader, they are read asynchronously, and
+	// the upload starts in the callback (the tail is never read that way)
+	TextureGPU* CreateLevels(StreamedTexture& t, uint32_t first, uint32_t index = UINT32_MAX);
+	void UploadLevels(StreamedTexture& t, TextureGPU* texture, uint32_t first, uint32_t last, uint32_t imageFirst, uint32_t index = UINT32_MAX);
+	void Replace(StreamedTexture& t, TextureGPU* texture, uint32_t level, uint64_t frame);
+	bool MakeRoom(VkDeviceSize bytes, uint32_t except, uint64_t frame);
+	VkDeviceSize GetLoadBytes(StreamedTexture& t, uint32_t level);
+
+	// the sparse versions of CreateLevels and Replace
+	void CreateSparse(StreamedTexture& t);
+	void BindLevel(StreamedTexture& t, uint32_t level, bool bind);
+	void SetView(StreamedTexture& t, uint32_t index, uint32_t level, uint64_t frame);
+
+	// moves the textures out of the emptiest block, see EnableDefrag
+	void Defragment(uint64_t frame);
+
+public:
+	// the most memory that the textures can use
+	VkDeviceSize budget;
+
+	// This changes every time the image of any texture changes,
+	// so the descriptors of the texture have to be written again
+	uint32_t generation;
+
+	// With a pool, every texture is one sparse image, and the levels
+	// are bound and unbound, instead of making new images
+	TextureStreamer(VkDevice d, MemoryAllocator* a, Uploader* u, VkDeviceSize budgetBytes, SparseTilePool* p = nullptr);
+	~TextureStreamer();
+
+	// Streaming in and out leaves holes in the memory blocks. With this,
+	// frames that load nothing move the textures out of the emptiest
+	// block, into the holes of the others, so that the block can be
+	// freed. The copies are submitted to this queue (which the frames
+	// use too), before the frame, with command buffers of the frame
+	// from cmds. Call it before the first Add, the textures need
+	// TRANSFER_SRC usage. Not for sparse textures
+	void EnableDefrag(VkQueue queue, CommandBufferPool* cmds, SubmitBatch* batch = nullptr);
+
+	// With a reader, the levels that are loaded later are read from the
+	// file at the path given to Add, with AsyncFileReader, instead of
+	// from the mapping, so Update never waits for the disk. Call it
+	// before the first Add. The reader is polled by Update
+	void EnableAsyncReads(AsyncFileReader* r);
+
+	// The streamer takes ownership of the file, it stays mapped,
+	// because the levels are loaded from it later. Only the tail
+	// is uploaded now. Returns the index of the texture. path
+	// is only needed with EnableAsyncReads
+	uint32_t Add(KtxFile* file, const char* name, const char* path = nullptr);
+
+	// asks for the level that the texture is seen at in this frame
+	void Request(uint32_t index, uint32_t level, uint64_t frame);
+
+	// Called once per frame. Frames up to completedFrames are done on
+	// the GPU, so the images that they used can be deleted
+	void Update(uint64_t frame, uint64_t completedFrames);
+
+	TextureGPU* GetTexture(uint32_t index);
+
+	// the view that the shaders should use, and the
+	// size of level 0 of the file, even if it is not resident
+	VkImageView GetView(uint32_t index);
+	VkExtent3D GetExtent(uint32_t index);
+	uint32_t GetResidentLevel(uint32_t index);
+	VkDeviceSize GetResidentBytes();
+};
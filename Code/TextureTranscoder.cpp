@@ -0,0 +1,371 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TextureTranscoder.h"
+#include "SimdLanes.h"
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+// The block mode of every ASTC block that we write: a grid of 4x4
+// weights (one for each pixel), with 3 bits each, one plane. With one
+// partition, the block has 17 bits of mode and color format, and 48 bits
+// of weights. The 63 bits that are left hold the 6 endpoint values with
+// 8 bits each, which needs no trits or quints
+#define ASTC_BLOCK_MODE 0x053
+#define ASTC_CEM_LDR_RGB_DIRECT 8
+
+TextureTranscoder::TextureTranscoder(JobSystem* j)
+{
+	jobs = j;
+	format = VK_FORMAT_UNDEFINED;
+	levelCount = 0;
+	milliseconds = 0.0;
+	jobCount = 0;
+}
+
+VkFormat TextureTranscoder::SelectFormat(VkPhysicalDevice gpu)
+{
+	// ASTC 4x4 is one byte per pixel, with 8 colors on the line of
+	// each block, BC1 is half a byte, with 4 colors
+	const VkFormat candidates[] =
+	{
+		VK_FORMAT_ASTC_4x4_UNORM_BLOCK,
+		VK_FORMAT_BC1_RGB_UNORM_BLOCK,
+	};
+
+	VkFormatFeatureFlags needed =
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	for (uint32_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(gpu, candidates[i], &props);
+
+		if ((props.optimalTilingFeatures & needed) == needed)
+			return candidates[i];
+	}
+
+	return VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+uint32_t TextureTranscoder::GetBlockBytes(VkFormat f)
+{
+	if (f == VK_FORMAT_ASTC_4x4_UNORM_BLOCK)
+		return 16;
+	if (f == VK_FORMAT_BC1_RGB_UNORM_BLOCK)
+		return 8;
+
+	return 4;
+}
+
+// Writes count bits of value into the block, starting at bit pos,
+// the lowest bit first, the way ASTC counts its bits
+static void PutBits(uint8_t* block, uint32_t pos, uint32_t count, uint32_t value)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t bit = pos + i;
+
+		if ((value >> i) & 1)
+			block[bit >> 3] |= (uint8_t)(1u << (bit & 7));
+	}
+}
+
+// Where each of the 16 colors is on the line from e0 to e0 + dir, from
+// 0 to 1. This is the part of the encoder that runs for every pixel,
+// so it runs SIMD_LANES pixels at a time, the colors are in r, g, and b
+static void ProjectBlock(const float* r, const float* g, const float* b, const float e0[3], const float dir[3], float* t)
+{
+	float dd = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+	float inv = (dd > 1e-8f) ? 1.0f / dd : 0.0f;
+	uint32_t i = 0;
+
+#if SIMD_LANES > 1
+	Lanes dr = LANES_SET1(dir[0] * inv);
+	Lanes dg = LANES_SET1(dir[1] * inv);
+	Lanes db = LANES_SET1(dir[2] * inv);
+	Lanes er = LANES_SET1(e0[0]);
+	Lanes eg = LANES_SET1(e0[1]);
+	Lanes eb = LANES_SET1(e0[2]);
+	Lanes zero = LANES_SET1(0.0f);
+	Lanes one = LANES_SET1(1.0f);
+
+	for (; i + SIMD_LANES <= 16; i += SIMD_LANES)
+	{
+		Lanes pr = LANES_SUB(LANES_LOAD(r + i), er);
+		Lanes pg = LANES_SUB(LANES_LOAD(g + i), eg);
+		Lanes pb = LANES_SUB(LANES_LOAD(b + i), eb);
+		Lanes d = LANES_ADD(LANES_ADD(LANES_MUL(pr, dr), LANES_MUL(pg, dg)), LANES_MUL(pb, db));
+		LANES_STORE(t + i, LANES_MIN(LANES_MAX(d, zero), one));
+	}
+#endif
+
+	for (; i < 16; i++)
+	{
+		float d = ((r[i] - e0[0]) * dir[0] + (g[i] - e0[1]) * dir[1] + (b[i] - e0[2]) * dir[2]) * inv;
+		t[i] = (d < 0.0f) ? 0.0f : ((d > 1.0f) ? 1.0f : d);
+	}
+}
+
+void TextureTranscoder::EncodeRows(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* dst, uint32_t firstRow, uint32_t rowCount)
+{
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blockBytes = GetBlockBytes(format);
+
+	for (uint32_t by = firstRow; by < firstRow + rowCount; by++)
+	{
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			// a block that goes past the edge (a level that is not
+			// a multiple of 4) repeats the last row or column
+			float r[16], g[16], b[16];
+			float low[3] = { 1.0f, 1.0f, 1.0f };
+			float high[3] = { 0.0f, 0.0f, 0.0f };
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = bx * 4 + (i & 3);
+				uint32_t y = by * 4 + (i >> 2);
+				x = (x < width) ? x : width - 1;
+				y = (y < height) ? y : height - 1;
+
+				const uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+				r[i] = p[0] / 255.0f;
+				g[i] = p[1] / 255.0f;
+				b[i] = p[2] / 255.0f;
+
+				low[0] = fminf(low[0], r[i]);
+				low[1] = fminf(low[1], g[i]);
+				low[2] = fminf(low[2], b[i]);
+				high[0] = fmaxf(high[0], r[i]);
+				high[1] = fmaxf(high[1], g[i]);
+				high[2] = fmaxf(high[2], b[i]);
+			}
+
+			uint8_t* block = dst + ((size_t)by * blocksX + bx) * blockBytes;
+			memset(block, 0, blockBytes);
+
+			// The two colors are the corners of the box, moved in by a
+			// sixteenth, because the colors between them are spread along
+			// the line, and the ends of the box are rarely used
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				float inset = (high[c] - low[c]) * 0.0625f;
+				low[c] += inset;
+				high[c] -= inset;
+			}
+
+			float t[16];
+
+			if (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK)
+			{
+				// 5 bits of red, 6 of green, 5 of blue. high is never below
+				// low, so color0 is never smaller than color1, and the block
+				// has 4 colors, in the order 0, 2, 3, 1 along the line
+				uint32_t q0[3] = { (uint32_t)(high[0] * 31.0f + 0.5f), (uint32_t)(high[1] * 63.0f + 0.5f), (uint32_t)(high[2] * 31.0f + 0.5f) };
+				uint32_t q1[3] = { (uint32_t)(low[0] * 31.0f + 0.5f), (uint32_t)(low[1] * 63.0f + 0.5f), (uint32_t)(low[2] * 31.0f + 0.5f) };
+				uint32_t color0 = (q0[0] << 11) | (q0[1] << 5) | q0[2];
+				uint32_t color1 = (q1[0] << 11) | (q1[1] << 5) | q1[2];
+
+				float e0[3] = { q0[0] / 31.0f, q0[1] / 63.0f, q0[2] / 31.0f };
+				float dir[3] = { q1[0] / 31.0f - e0[0], q1[1] / 63.0f - e0[1], q1[2] / 31.0f - e0[2] };
+				ProjectBlock(r, g, b, e0, dir, t);
+
+				// with one color, the block would have 3 colors and black,
+				// so every pixel uses color0
+				uint32_t indices = 0;
+
+				if (color0 != color1)
+				{
+					for (uint32_t i = 0; i < 16; i++)
+					{
+						uint32_t j = (uint32_t)(t[i] * 3.0f + 0.5f);
+						indices |= ((0x78u >> (j * 2)) & 3u) << (i * 2);
+					}
+				}
+
+				uint32_t words[2] = { color0 | (color1 << 16), indices };
+				memcpy(block, words, 8);
+			}
+			else if (format == VK_FORMAT_ASTC_4x4_UNORM_BLOCK)
+			{
+				// The endpoints are 8 bits, low first, then high, for red,
+				// green, and blue. high is never below low, so the sum of the
+				// second endpoint is never smaller, and the GPU never swaps
+				// them for a blue contraction
+				uint32_t e[6];
+
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					e[c * 2] = (uint32_t)(low[c] * 255.0f + 0.5f);
+					e[c * 2 + 1] = (uint32_t)(high[c] * 255.0f + 0.5f);
+				}
+
+				PutBits(block, 0, 11, ASTC_BLOCK_MODE);
+				PutBits(block, 11, 2, 0);
+				PutBits(block, 13, 4, ASTC_CEM_LDR_RGB_DIRECT);
+
+				for (uint32_t v = 0; v < 6; v++)
+					PutBits(block, 17 + v * 8, 8, e[v]);
+
+				float e0[3] = { e[0] / 255.0f, e[2] / 255.0f, e[4] / 255.0f };
+				float dir[3] = { e[1] / 255.0f - e0[0], e[3] / 255.0f - e0[1], e[5] / 255.0f - e0[2] };
+				ProjectBlock(r, g, b, e0, dir, t);
+
+				// The weights are stored from the top of the block down, with
+				// their bits reversed: bit j of weight i is bit 127 - (3i + j).
+				// 3 bits are 8 steps from low to high, almost evenly spaced
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					uint32_t w = (uint32_t)(t[i] * 7.0f + 0.5f);
+
+					for (uint32_t j = 0; j < 3; j++)
+						PutBits(block, 127 - (i * 3 + j), 1, (w >> j) & 1);
+				}
+			}
+		}
+	}
+}
+
+void TextureTranscoder::Transcode(const uint8_t* rgba, uint32_t width, uint32_t height, VkFormat f)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	format = f;
+	uint32_t blockBytes = GetBlockBytes(format);
+	bool blocks = (format != VK_FORMAT_R8G8B8A8_UNORM);
+
+	// every level down to 1x1
+	levelCount = 1;
+
+	while ((width >> levelCount) > 0 || (height >> levelCount) > 0)
+		levelCount++;
+
+	// The levels are made on this thread first, each one is the average
+	// of 2x2 pixels of the one before it (a level that is 1 pixel wide
+	// or high averages the same pixel twice). This is fast next to the
+	// encoder, and each level needs the one before it
+	std::vector<std::vector<uint8_t>> levels(levelCount);
+	levels[0].assign(rgba, rgba + (size_t)width * height * 4);
+
+	for (uint32_t level = 1; level < levelCount; level++)
+	{
+		uint32_t srcW = (width >> (level - 1)) > 0 ? (width >> (level - 1)) : 1;
+		uint32_t srcH = (height >> (level - 1)) > 0 ? (height >> (level - 1)) : 1;
+		uint32_t w = (width >> level) > 0 ? (width >> level) : 1;
+		uint32_t h = (height >> level) > 0 ? (height >> level) : 1;
+
+		const uint8_t* src = levels[level - 1].data();
+		levels[level].resize((size_t)w * h * 4);
+		uint8_t* out = levels[level].data();
+
+		for (uint32_t y = 0; y < h; y++)
+		{
+			uint32_t y0 = y * 2;
+			uint32_t y1 = (y * 2 + 1 < srcH) ? y * 2 + 1 : y0;
+
+			for (uint32_t x = 0; x < w; x++)
+			{
+				uint32_t x0 = x * 2;
+				uint32_t x1 = (x * 2 + 1 < srcW) ? x * 2 + 1 : x0;
+
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					uint32_t sum =
+						src[((size_t)y0 * srcW + x0) * 4 + c] + src[((size_t)y0 * srcW + x1) * 4 + c] +
+						src[((size_t)y1 * srcW + x0) * 4 + c] + src[((size_t)y1 * srcW + x1) * 4 + c];
+					out[((size_t)y * w + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	// every level is tightly packed after the one before it,
+	// like in a KTX2 file, and the offsets are multiples of the
+	// block size, which vkCmdCopyBufferToImage needs
+	regions.resize(levelCount);
+	std::vector<VkDeviceSize> offsets(levelCount);
+	VkDeviceSize size = 0;
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		uint32_t w = (width >> level) > 0 ? (width >> level) : 1;
+		uint32_t h = (height >> level) > 0 ? (height >> level) : 1;
+
+		VkBufferImageCopy& region = regions[level];
+		memset(&region, 0, sizeof(region));
+		region.bufferOffset = size;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+		region.imageExtent = { w, h, 1 };
+
+		offsets[level] = size;
+		size += blocks ? (VkDeviceSize)((w + 3) / 4) * ((h + 3) / 4) * blockBytes : (VkDeviceSize)w * h * 4;
+	}
+
+	data.resize((size_t)size);
+	jobCount = 0;
+
+	// Without a compressed format, the levels are the texture
+	if (!blocks)
+	{
+		for (uint32_t level = 0; level < levelCount; level++)
+			memcpy(data.data() + offsets[level], levels[level].data(), levels[level].size());
+	}
+	else
+	{
+		// Every job writes its own rows of blocks, so the jobs share
+		// nothing but the levels, which nobody writes anymore
+		JobCounter counter;
+
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			uint32_t w = regions[level].imageExtent.width;
+			uint32_t h = regions[level].imageExtent.height;
+			uint32_t blocksY = (h + 3) / 4;
+			const uint8_t* src = levels[level].data();
+			uint8_t* dst = data.data() + offsets[level];
+
+			for (uint32_t row = 0; row < blocksY; row += TRANSCODE_ROWS_PER_JOB)
+			{
+				uint32_t count = (blocksY - row < TRANSCODE_ROWS_PER_JOB) ? blocksY - row : TRANSCODE_ROWS_PER_JOB;
+
+				jobs->Run([this, src, w, h, dst, row, count]()
+					{
+						EncodeRows(src, w, h, dst, row, count);
+					},
+					&counter);
+
+				jobCount++;
+			}
+		}
+
+		jobs->Wait(&counter);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
@@ -0,0 +1,78 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "JobSystem.h"
+
+// how many rows of blocks one job of the transcoder encodes
+#define TRANSCODE_ROWS_PER_JOB 8
+
+// Makes a compressed texture, with every mip level, from one RGBA
+// image, in the best format that this GPU can sample. There is one
+// texture file for every GPU, instead of one file for each format
+// (like logo_bc7.ktx2 and logo_astc.ktx2): phones get ASTC 4x4, desktop
+// GPUs get BC1, and a GPU that has neither gets RGBA. Every level is
+// cut into rows of blocks, and the rows are encoded by the job system,
+// on every core at once. The colors of each block are projected onto
+// the line between its two colors with SIMD (see SimdLanes.h).
+// The encoder is fast, not perfect: each block has one line of colors,
+// between the corners of the box around them, like TextureCompressor
+class TextureTranscoder
+{
+private:
+	JobSystem* jobs;
+
+	void EncodeRows(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* dst, uint32_t firstRow, uint32_t rowCount);
+
+public:
+	VkFormat format;
+	uint32_t levelCount;
+
+	// every level, one after the other, and where each level is in
+	// data, these are ready for Uploader::UploadTextureLevels
+	std::vector<uint8_t> data;
+	std::vector<VkBufferImageCopy> regions;
+
+	// how long the last Transcode took, and how many jobs it had
+	double milliseconds;
+	uint32_t jobCount;
+
+	TextureTranscoder(JobSystem* j);
+
+	// ASTC 4x4, then BC1, then R8G8B8A8, the first one that
+	// the GPU can sample with LINEAR filtering
+	static VkFormat SelectFormat(VkPhysicalDevice gpu);
+
+	// the number of bytes of each block of 4x4 pixels,
+	// or of each pixel, for R8G8B8A8
+	static uint32_t GetBlockBytes(VkFormat f);
+
+	// Makes the mip levels of the image, which has 4 bytes for each
+	// pixel, and encodes every level into f. This waits for the jobs
+	void Transcode(const uint8_t* rgba, uint32_t width, uint32_t height, VkFormat f);
+};
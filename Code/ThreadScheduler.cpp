@@ -0,0 +1,79 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "ThreadScheduler.h"
+#include <stdio.h>
+
+HANDLE ThreadScheduler::Apply(const ThreadSchedule& schedule, const char* threadName)
+{
+	if (schedule.affinity != 0 && SetThreadAffinityMask(GetCurrentThread(), schedule.affinity) == 0)
+		printf("The %s thread could not be pinned to its cores\n", threadName);
+
+	if (schedule.task == nullptr)
+		return NULL;
+
+	// Every thread of a task gets its own index, which
+	// MMCSS fills in, zero asks for a new one
+	DWORD taskIndex = 0;
+	HANDLE task = AvSetMmThreadCharacteristicsW(schedule.task, &taskIndex);
+
+	if (task == NULL)
+	{
+		printf("The %s thread could not join its MMCSS task\n", threadName);
+		return NULL;
+	}
+
+	AvSetMmThreadPriority(task, schedule.priority);
+	return task;
+}
+
+void ThreadScheduler::Revert(HANDLE task)
+{
+	if (task != NULL)
+		AvRevertMmThreadCharacteristics(task);
+}
+
+bool ThreadScheduler::SetAffinity(std::thread& thread, DWORD_PTR affinity)
+{
+	if (affinity == 0)
+		return true;
+
+	return SetThreadAffinityMask((HANDLE)thread.native_handle(), affinity) != 0;
+}
+
+DWORD_PTR ThreadScheduler::CoreMask(uint32_t core)
+{
+	return (DWORD_PTR)1 << core;
+}
+
+DWORD_PTR ThreadScheduler::AllCoresExcept(uint32_t core)
+{
+	// the cores of the process, which might not be all of them
+	DWORD_PTR processMask = 0;
+	DWORD_PTR systemMask = 0;
+	GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+
+	return processMask & ~CoreMask(core);
+}
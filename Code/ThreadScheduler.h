@@ -0,0 +1,63 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <windows.h>
+#include <avrt.h>
+#include <stdint.h>
+#include <thread>
+
+// How one thread is scheduled. MMCSS (the Multimedia Class Scheduler
+// Service) gives the threads of a task, like "Games" or "Playback", a
+// higher priority than everything else on the machine while they run,
+// so a busy background process can not make the frame miss the vsync.
+// A null task leaves the thread to the normal scheduler. affinity is
+// the mask of cores that the thread may run on, zero means any core
+struct ThreadSchedule
+{
+	const wchar_t* task;
+	AVRT_PRIORITY priority;
+	DWORD_PTR affinity;
+};
+
+// Puts threads into their MMCSS task, and on their cores. MMCSS
+// registers the thread that calls it, so each thread applies its own
+// schedule when it starts, and reverts it before it ends
+class ThreadScheduler
+{
+public:
+	// Applies the schedule to the thread that calls this. It returns
+	// the handle of the MMCSS task, or NULL if there is none (or if
+	// MMCSS said no), which has to be given to Revert
+	static HANDLE Apply(const ThreadSchedule& schedule, const char* threadName);
+	static void Revert(HANDLE task);
+
+	// the cores of another thread, like a worker of the job system
+	static bool SetAffinity(std::thread& thread, DWORD_PTR affinity);
+
+	// the mask of one core, and of every core except that one
+	static DWORD_PTR CoreMask(uint32_t core);
+	static DWORD_PTR AllCoresExcept(uint32_t core);
+};
@@ -0,0 +1,90 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+
+// VK_KHR_timeline_semaphore is newer than the Vulkan headers in
+// the Include folder. If the headers do not have it, we declare the
+// parts that we use here, exactly like the newer headers do. When the
+// headers are updated, VK_KHR_timeline_semaphore is defined by
+// vulkan_core.h, and everything below is skipped
+#ifndef VK_KHR_timeline_semaphore
+#define VK_KHR_timeline_semaphore 1
+#define VK_KHR_TIMELINE_SEMAPHORE_SPEC_VERSION 2
+#define VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME "VK_KHR_timeline_semaphore"
+
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR ((VkStructureType)1000207000)
+#define VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR ((VkStructureType)1000207002)
+#define VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR ((VkStructureType)1000207003)
+#define VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR ((VkStructureType)1000207004)
+
+typedef enum VkSemaphoreTypeKHR
+{
+	VK_SEMAPHORE_TYPE_BINARY_KHR = 0,
+	VK_SEMAPHORE_TYPE_TIMELINE_KHR = 1,
+	VK_SEMAPHORE_TYPE_MAX_ENUM_KHR = 0x7FFFFFFF
+} VkSemaphoreTypeKHR;
+
+typedef VkFlags VkSemaphoreWaitFlagsKHR;
+
+typedef struct VkPhysicalDeviceTimelineSemaphoreFeaturesKHR
+{
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 timelineSemaphore;
+} VkPhysicalDeviceTimelineSemaphoreFeaturesKHR;
+
+typedef struct VkSemaphoreTypeCreateInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkSemaphoreTypeKHR semaphoreType;
+	uint64_t initialValue;
+} VkSemaphoreTypeCreateInfoKHR;
+
+typedef struct VkTimelineSemaphoreSubmitInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	uint32_t waitSemaphoreValueCount;
+	const uint64_t* pWaitSemaphoreValues;
+	uint32_t signalSemaphoreValueCount;
+	const uint64_t* pSignalSemaphoreValues;
+} VkTimelineSemaphoreSubmitInfoKHR;
+
+typedef struct VkSemaphoreWaitInfoKHR
+{
+	VkStructureType sType;
+	const void* pNext;
+	VkSemaphoreWaitFlagsKHR flags;
+	uint32_t semaphoreCount;
+	const VkSemaphore* pSemaphores;
+	const uint64_t* pValues;
+} VkSemaphoreWaitInfoKHR;
+
+typedef VkResult (VKAPI_PTR *PFN_vkGetSemaphoreCounterValueKHR)(VkDevice device, VkSemaphore semaphore, uint64_t* pValue);
+typedef VkResult (VKAPI_PTR *PFN_vkWaitSemaphoresKHR)(VkDevice device, const VkSemaphoreWaitInfoKHR* pWaitInfo, uint64_t timeout);
+#endif
@@ -0,0 +1,230 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TraceCapture.h"
+#include <windows.h>
+#include <stdio.h>
+
+// the names of the rows in the trace viewer
+static const char* trackNames[TRACE_TRACK_COUNT] =
+{
+	"CPU render thread",
+	"GPU graphics queue"
+};
+
+TraceCapture::TraceCapture(VkDevice d, PFN_vkGetCalibratedTimestampsEXT fpGetCalibratedTimestampsEXT, uint32_t slots)
+{
+	device = d;
+	getCalibratedTimestamps = fpGetCalibratedTimestampsEXT;
+	period = 1.0f;
+	validMask = ~0ULL;
+	calibrated = false;
+	gpuBase = 0;
+	cpuBaseNs = 0;
+	path = nullptr;
+	active = false;
+	frame = 0;
+	endFrame = 0;
+	writeFrame = 0;
+	frameLag = slots;
+
+	events.reserve(TRACE_MAX_EVENTS);
+}
+
+void TraceCapture::SetGpuClock(float nsPerTick, uint64_t mask)
+{
+	period = nsPerTick;
+	validMask = mask;
+}
+
+void TraceCapture::Start(uint64_t nextFrame, uint32_t frameCount, const char* file)
+{
+	if (active)
+		return;
+
+	events.clear();
+	origin = CpuClock::now();
+	path = file;
+	active = true;
+	calibrated = false;
+	frame = nextFrame;
+	endFrame = nextFrame + frameCount;
+	writeFrame = endFrame + frameLag;
+
+	if (getCalibratedTimestamps == NULL)
+		printf("Trace: without VK_EXT_calibrated_timestamps, only the CPU is traced\n");
+
+	printf("Trace: recording %u frames\n", frameCount);
+}
+
+bool TraceCapture::IsActive()
+{
+	return active;
+}
+
+int64_t TraceCapture::ToNs(CpuClock::time_point t)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin).count();
+}
+
+void TraceCapture::Calibrate()
+{
+	if (getCalibratedTimestamps == NULL)
+		return;
+
+	// Both clocks, read by the driver as close together as it can,
+	// maxDeviation says how close that was, in nanoseconds
+	VkCalibratedTimestampInfoEXT infos[2] = {};
+	infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[1].timeDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+
+	uint64_t timestamps[2];
+	uint64_t maxDeviation;
+
+	if (getCalibratedTimestamps(device, 2, infos, timestamps, &maxDeviation) != VK_SUCCESS)
+		return;
+
+	// The CPU timestamp is in QueryPerformanceCounter ticks, the
+	// profiler uses CpuClock, so both of those are read right now,
+	// and the counter goes back to the time of the calibration
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	int64_t nowNs = ToNs(CpuClock::now());
+
+	int64_t agoTicks = (int64_t)(counter.QuadPart - timestamps[1]);
+	int64_t agoNs = (int64_t)((double)agoTicks * 1000000000.0 / (double)frequency.QuadPart);
+
+	gpuBase = timestamps[0] & validMask;
+	cpuBaseNs = nowNs - agoNs;
+	calibrated = true;
+}
+
+int64_t TraceCapture::GpuToNs(uint64_t ticks)
+{
+	// The difference can be negative, the timestamps of a
+	// frame are older than the calibration of a later frame.
+	// With fewer than 64 valid bits, the sign bit is moved
+	uint64_t diff = (ticks - gpuBase) & validMask;
+
+	if (validMask != ~0ULL && diff > (validMask >> 1))
+		diff -= validMask + 1;
+
+	return cpuBaseNs + (int64_t)((double)(int64_t)diff * period);
+}
+
+void TraceCapture::BeginFrame(uint64_t frameCount)
+{
+	if (!active)
+		return;
+
+	frame = frameCount;
+
+	// The clocks of the CPU and the GPU drift apart
+	// over time, so they are lined up again every frame
+	Calibrate();
+
+	if (frame >= writeFrame)
+	{
+		active = false;
+		Write();
+	}
+}
+
+void TraceCapture::Add(const char* name, uint32_t track, int64_t startNs, int64_t endNs)
+{
+	// Anything that started before the capture is left out,
+	// like the GPU frames that were recorded before it, and the
+	// array was made big enough before the capture started
+	if (startNs < 0 || events.size() >= TRACE_MAX_EVENTS)
+		return;
+
+	TraceEvent event;
+	event.name = name;
+	event.track = track;
+	event.frame = frame;
+	event.startNs = startNs;
+	event.durationNs = endNs - startNs;
+	events.push_back(event);
+}
+
+void TraceCapture::AddCpu(const char* name, CpuClock::time_point start, CpuClock::time_point end)
+{
+	if (!active || frame >= endFrame)
+		return;
+
+	Add(name, TRACE_TRACK_CPU, ToNs(start), ToNs(end));
+}
+
+void TraceCapture::AddGpu(const char* name, uint64_t beginTicks, uint64_t endTicks)
+{
+	if (!active || !calibrated)
+		return;
+
+	Add(name, TRACE_TRACK_GPU, GpuToNs(beginTicks), GpuToNs(endTicks));
+}
+
+bool TraceCapture::Write()
+{
+	FILE* file = fopen(path, "w");
+
+	if (file == nullptr)
+	{
+		printf("Could not write %s\n", path);
+		return false;
+	}
+
+	// The JSON object format, with one "complete" (X) event for each
+	// span, in microseconds, and the rows named by metadata (M) events
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (uint32_t t = 0; t < TRACE_TRACK_COUNT; t++)
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n", t, trackNames[t]);
+
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const TraceEvent& e = events[i];
+
+		// the GPU events come back later, so the
+		// frame of a GPU event is not the one it ran in
+		if (e.track == TRACE_TRACK_CPU)
+			fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+				e.name, e.track, e.startNs / 1000.0, e.durationNs / 1000.0, (unsigned long long)e.frame);
+		else
+			fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				e.name, e.track, e.startNs / 1000.0, e.durationNs / 1000.0);
+
+		fprintf(file, (i + 1 < events.size()) ? ",\n" : "\n");
+	}
+
+	fprintf(file, "]}\n");
+	fclose(file);
+
+	printf("Trace: %u events written to %s\n", (uint32_t)events.size(), path);
+	return true;
+}
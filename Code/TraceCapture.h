@@ -0,0 +1,116 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <stdint.h>
+#include <vector>
+#include "CpuProfiler.h"
+
+// the most events of one capture, they are allocated before
+// the capture starts, so recording one never allocates
+#define TRACE_MAX_EVENTS 65536
+
+// one row in the trace viewer
+enum TraceTrack
+{
+	TRACE_TRACK_CPU,
+	TRACE_TRACK_GPU,
+	TRACE_TRACK_COUNT
+};
+
+// One span of time, in nanoseconds since the capture started
+struct TraceEvent
+{
+	const char* name;
+	uint32_t track;
+	uint64_t frame;
+	int64_t startNs;
+	int64_t durationNs;
+};
+
+// Records the CPU markers of the profiler, and the GPU timestamps of
+// the GpuTimer, for a few frames, and writes them as a Chrome trace
+// (JSON), which chrome://tracing and ui.perfetto.dev can open. With
+// VK_EXT_calibrated_timestamps, the GPU reads its own clock and the
+// QueryPerformanceCounter at the same moment, so the GPU timestamps
+// can be moved onto the CPU's clock, and both rows of the trace line
+// up: which frame the GPU runs while the CPU records the next one,
+// and how long the CPU waits for the fence of the frame_lag'th frame
+class TraceCapture
+{
+private:
+	VkDevice device;
+	PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps;
+
+	// nanoseconds per timestamp tick, same as the GpuTimer
+	float period;
+	uint64_t validMask;
+
+	// the same moment on the GPU clock, and on the CPU clock
+	// (since origin), from the newest calibration
+	bool calibrated;
+	uint64_t gpuBase;
+	int64_t cpuBaseNs;
+
+	std::vector<TraceEvent> events;
+	CpuClock::time_point origin;
+	const char* path;
+	bool active;
+
+	// CPU events are kept until endFrame, GPU events come
+	// back frame_lag frames later, so the trace is written
+	// when writeFrame starts
+	uint64_t frame;
+	uint64_t endFrame;
+	uint64_t writeFrame;
+	uint32_t frameLag;
+
+	int64_t ToNs(CpuClock::time_point t);
+	int64_t GpuToNs(uint64_t ticks);
+	void Add(const char* name, uint32_t track, int64_t startNs, int64_t endNs);
+	void Calibrate();
+	bool Write();
+
+public:
+	// getCalibratedTimestamps is NULL without the extension,
+	// then only the CPU is in the trace
+	TraceCapture(VkDevice d, PFN_vkGetCalibratedTimestampsEXT fpGetCalibratedTimestampsEXT, uint32_t slots);
+
+	// from the GpuTimer, see GpuTimer::SetTrace
+	void SetGpuClock(float nsPerTick, uint64_t mask);
+
+	// records frameCount frames, starting with the next
+	// frame, and then writes them to this file
+	void Start(uint64_t nextFrame, uint32_t frameCount, const char* file);
+	bool IsActive();
+
+	// called before anything else in a frame
+	void BeginFrame(uint64_t frameCount);
+
+	void AddCpu(const char* name, CpuClock::time_point start, CpuClock::time_point end);
+	void AddGpu(const char* name, uint64_t beginTicks, uint64_t endTicks);
+};
@@ -0,0 +1,279 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TransformBatch.h"
+#include "SimdLanes.h"
+#include <string.h>
+
+// With thousands of objects, multiplying their matrices one at a time,
+// with a function call for each matrix, takes a big part of the frame.
+// Every object does exactly the same math, only with different numbers,
+// which is what SIMD is made for: one instruction does the same thing
+// to 4 floats (SSE2), or to 8 floats (AVX2), at the same time.
+
+// Each register holds the same number (like "the x of the position")
+// of 4 or 8 objects, so the math looks exactly like the math for one
+// object. Only at the end, the results are transposed, so that each
+// object gets its own matrices, in the normal glm layout
+
+void TransformArrays::Resize(uint32_t count)
+{
+	posX.resize(count, 0.0f);
+	posY.resize(count, 0.0f);
+	posZ.resize(count, 0.0f);
+	rotX.resize(count, 0.0f);
+	rotY.resize(count, 0.0f);
+	rotZ.resize(count, 0.0f);
+	rotW.resize(count, 1.0f);
+	scaleX.resize(count, 1.0f);
+	scaleY.resize(count, 1.0f);
+	scaleZ.resize(count, 1.0f);
+}
+
+uint32_t TransformArrays::GetCount()
+{
+	return (uint32_t)posX.size();
+}
+
+void TransformArrays::Load(const float* arrays, uint32_t count)
+{
+	Resize(count);
+
+	LargePageVector<float>* all[] = { &posX, &posY, &posZ, &rotX, &rotY, &rotZ, &rotW, &scaleX, &scaleY, &scaleZ };
+
+	for (uint32_t i = 0; i < 10; i++)
+		memcpy(all[i]->data(), arrays + (size_t)i * count, count * sizeof(float));
+}
+
+void TransformArrays::Store(float* arrays)
+{
+	uint32_t count = GetCount();
+
+	LargePageVector<float>* all[] = { &posX, &posY, &posZ, &rotX, &rotY, &rotZ, &rotW, &scaleX, &scaleY, &scaleZ };
+
+	for (uint32_t i = 0; i < 10; i++)
+		memcpy(arrays + (size_t)i * count, all[i]->data(), count * sizeof(float));
+}
+
+void TransformArrays::SetPosition(uint32_t index, glm::vec3 position)
+{
+	posX[index] = position.x;
+	posY[index] = position.y;
+	posZ[index] = position.z;
+}
+
+void TransformArrays::SetRotation(uint32_t index, glm::quat rotation)
+{
+	rotX[index] = rotation.x;
+	rotY[index] = rotation.y;
+	rotZ[index] = rotation.z;
+	rotW[index] = rotation.w;
+}
+
+void TransformArrays::SetScale(uint32_t index, glm::vec3 scale)
+{
+	scaleX[index] = scale.x;
+	scaleY[index] = scale.y;
+	scaleZ[index] = scale.z;
+}
+
+glm::vec3 TransformArrays::GetPosition(uint32_t index)
+{
+	return glm::vec3(posX[index], posY[index], posZ[index]);
+}
+
+// One object at a time, for the objects that are left over
+// after the SIMD loop, and for CPUs without SIMD. This is the
+// same math as glm::mat4_cast, glm::scale, and glm::translate
+static void transform_one(TransformArrays* t, uint32_t i, const glm::mat4& viewProj, glm::mat4* model, glm::mat4* mvp)
+{
+	float x2 = t->rotX[i] + t->rotX[i];
+	float y2 = t->rotY[i] + t->rotY[i];
+	float z2 = t->rotZ[i] + t->rotZ[i];
+
+	float xx = t->rotX[i] * x2;
+	float yy = t->rotY[i] * y2;
+	float zz = t->rotZ[i] * z2;
+	float xy = t->rotX[i] * y2;
+	float xz = t->rotX[i] * z2;
+	float yz = t->rotY[i] * z2;
+	float wx = t->rotW[i] * x2;
+	float wy = t->rotW[i] * y2;
+	float wz = t->rotW[i] * z2;
+
+	glm::mat4 m;
+	m[0] = glm::vec4(1.0f - (yy + zz), xy + wz, xz - wy, 0.0f) * t->scaleX[i];
+	m[1] = glm::vec4(xy - wz, 1.0f - (xx + zz), yz + wx, 0.0f) * t->scaleY[i];
+	m[2] = glm::vec4(xz + wy, yz - wx, 1.0f - (xx + yy), 0.0f) * t->scaleZ[i];
+	m[3] = glm::vec4(t->posX[i], t->posY[i], t->posZ[i], 1.0f);
+
+	if (model != nullptr)
+		*model = m;
+
+	if (mvp != nullptr)
+		*mvp = viewProj * m;
+}
+
+#if SIMD_LANES > 1
+
+// Turns 4 registers, which each hold one row of a column of the
+// matrices of 4 (or 8) objects, into that column of each object
+static inline void store_column(glm::mat4* out, uint32_t column, Lanes r0, Lanes r1, Lanes r2, Lanes r3)
+{
+#if SIMD_LANES == 8
+	// the same as _MM_TRANSPOSE4_PS, in both
+	// 128 bit halves of the registers at once
+	__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+	__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+	__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+	__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+
+	__m256 c0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 c1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 c2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 c3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+	// the low half is objects 0 to 3, the high half is objects 4 to 7
+	_mm_storeu_ps(&out[0][column][0], _mm256_castps256_ps128(c0));
+	_mm_storeu_ps(&out[1][column][0], _mm256_castps256_ps128(c1));
+	_mm_storeu_ps(&out[2][column][0], _mm256_castps256_ps128(c2));
+	_mm_storeu_ps(&out[3][column][0], _mm256_castps256_ps128(c3));
+	_mm_storeu_ps(&out[4][column][0], _mm256_extractf128_ps(c0, 1));
+	_mm_storeu_ps(&out[5][column][0], _mm256_extractf128_ps(c1, 1));
+	_mm_storeu_ps(&out[6][column][0], _mm256_extractf128_ps(c2, 1));
+	_mm_storeu_ps(&out[7][column][0], _mm256_extractf128_ps(c3, 1));
+#else
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	_mm_storeu_ps(&out[0][column][0], r0);
+	_mm_storeu_ps(&out[1][column][0], r1);
+	_mm_storeu_ps(&out[2][column][0], r2);
+	_mm_storeu_ps(&out[3][column][0], r3);
+#endif
+}
+
+#endif
+
+void TransformBatch(
+	TransformArrays* t,
+	uint32_t first,
+	uint32_t count,
+	const glm::mat4& viewProj,
+	glm::mat4* models,
+	glm::mat4* mvps)
+{
+	uint32_t end = first + count;
+	uint32_t i = first;
+
+#if SIMD_LANES > 1
+	// every number of the view projection matrix, in every lane
+	Lanes vp[4][4];
+	for (uint32_t c = 0; c < 4; c++)
+		for (uint32_t r = 0; r < 4; r++)
+			vp[c][r] = LANES_SET1(viewProj[c][r]);
+
+	Lanes zero = LANES_SET1(0.0f);
+	Lanes one = LANES_SET1(1.0f);
+
+	for (; i + SIMD_LANES <= end; i += SIMD_LANES)
+	{
+		Lanes qx = LANES_LOAD(&t->rotX[i]);
+		Lanes qy = LANES_LOAD(&t->rotY[i]);
+		Lanes qz = LANES_LOAD(&t->rotZ[i]);
+		Lanes qw = LANES_LOAD(&t->rotW[i]);
+
+		Lanes x2 = LANES_ADD(qx, qx);
+		Lanes y2 = LANES_ADD(qy, qy);
+		Lanes z2 = LANES_ADD(qz, qz);
+
+		Lanes xx = LANES_MUL(qx, x2);
+		Lanes yy = LANES_MUL(qy, y2);
+		Lanes zz = LANES_MUL(qz, z2);
+		Lanes xy = LANES_MUL(qx, y2);
+		Lanes xz = LANES_MUL(qx, z2);
+		Lanes yz = LANES_MUL(qy, z2);
+		Lanes wx = LANES_MUL(qw, x2);
+		Lanes wy = LANES_MUL(qw, y2);
+		Lanes wz = LANES_MUL(qw, z2);
+
+		Lanes sx = LANES_LOAD(&t->scaleX[i]);
+		Lanes sy = LANES_LOAD(&t->scaleY[i]);
+		Lanes sz = LANES_LOAD(&t->scaleZ[i]);
+
+		// m[column][row] of the model matrix, the
+		// 4th row of the first 3 columns is zero
+		Lanes m[4][3];
+		m[0][0] = LANES_MUL(LANES_SUB(one, LANES_ADD(yy, zz)), sx);
+		m[0][1] = LANES_MUL(LANES_ADD(xy, wz), sx);
+		m[0][2] = LANES_MUL(LANES_SUB(xz, wy), sx);
+		m[1][0] = LANES_MUL(LANES_SUB(xy, wz), sy);
+		m[1][1] = LANES_MUL(LANES_SUB(one, LANES_ADD(xx, zz)), sy);
+		m[1][2] = LANES_MUL(LANES_ADD(yz, wx), sy);
+		m[2][0] = LANES_MUL(LANES_ADD(xz, wy), sz);
+		m[2][1] = LANES_MUL(LANES_SUB(yz, wx), sz);
+		m[2][2] = LANES_MUL(LANES_SUB(one, LANES_ADD(xx, yy)), sz);
+		m[3][0] = LANES_LOAD(&t->posX[i]);
+		m[3][1] = LANES_LOAD(&t->posY[i]);
+		m[3][2] = LANES_LOAD(&t->posZ[i]);
+
+		if (models != nullptr)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+				store_column(&models[i], c, m[c][0], m[c][1], m[c][2], (c == 3) ? one : zero);
+		}
+
+		if (mvps == nullptr)
+			continue;
+
+		// mvp[c][r] is row r of viewProj times column c of the model
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			Lanes out[4];
+
+			for (uint32_t r = 0; r < 4; r++)
+			{
+				out[r] = LANES_ADD(
+					LANES_ADD(LANES_MUL(vp[0][r], m[c][0]), LANES_MUL(vp[1][r], m[c][1])),
+					LANES_MUL(vp[2][r], m[c][2]));
+
+				// the 4th row of the model is 1 in the last column
+				if (c == 3)
+					out[r] = LANES_ADD(out[r], vp[3][r]);
+			}
+
+			store_column(&mvps[i], c, out[0], out[1], out[2], out[3]);
+		}
+	}
+#endif
+
+	// the objects that do not fill a whole register
+	for (; i < end; i++)
+		transform_one(t, i, viewProj, (models != nullptr) ? &models[i] : nullptr, (mvps != nullptr) ? &mvps[i] : nullptr);
+}
+
+const char* GetTransformBatchPath()
+{
+	return SIMD_PATH;
+}
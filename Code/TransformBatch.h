@@ -0,0 +1,87 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "LargePages.h"
+
+// The transforms of many objects, as a structure of arrays. The x of
+// every position is next to the x of the next object, and so on, so
+// the batch kernel can load 4 (SSE) or 8 (AVX2) objects with one
+// instruction, instead of putting the pieces of one matrix together
+struct TransformArrays
+{
+	// every frame walks through all of them, so
+	// big arrays are kept in large pages (see LargePages.h)
+	LargePageVector<float> posX;
+	LargePageVector<float> posY;
+	LargePageVector<float> posZ;
+
+	// rotation, as a quaternion
+	LargePageVector<float> rotX;
+	LargePageVector<float> rotY;
+	LargePageVector<float> rotZ;
+	LargePageVector<float> rotW;
+
+	LargePageVector<float> scaleX;
+	LargePageVector<float> scaleY;
+	LargePageVector<float> scaleZ;
+
+	// new objects are at the origin, with no
+	// rotation, and a scale of 1
+	void Resize(uint32_t count);
+	uint32_t GetCount();
+
+	void SetPosition(uint32_t index, glm::vec3 position);
+	void SetRotation(uint32_t index, glm::quat rotation);
+	void SetScale(uint32_t index, glm::vec3 scale);
+	glm::vec3 GetPosition(uint32_t index);
+
+	// All ten arrays, one after the other, in the order above, with
+	// count floats in each one. This is how SceneFile saves them, so a
+	// loaded scene is ten memcpys, no matter how many objects it has
+	void Load(const float* arrays, uint32_t count);
+	void Store(float* arrays);
+};
+
+// Computes the model matrix (translate * rotate * scale), and the MVP
+// matrix, of objects [first, first + count). models can be nullptr,
+// if only the MVP matrices are needed, and mvps can be nullptr, if
+// only the model matrices are needed
+void TransformBatch(
+	TransformArrays* transforms,
+	uint32_t first,
+	uint32_t count,
+	const glm::mat4& viewProj,
+	glm::mat4* models,
+	glm::mat4* mvps);
+
+// "AVX2", "SSE2", or "scalar", whichever
+// one the kernel was compiled with
+const char* GetTransformBatchPath();
@@ -0,0 +1,204 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TransformHierarchy.h"
+#include <stdio.h>
+
+// A scene graph with a pointer from each node to its children is
+// slow to walk: every node is somewhere else in memory, and the
+// next node is not known until the current one is loaded. Here, the
+// nodes of a level are next to each other, and they only read the
+// level above them, which is finished, so each level is cut into
+// jobs of HIERARCHY_JOB_SIZE nodes, that all run at the same time.
+
+// The world transform of a child is the transform of its parent,
+// applied to the child's local transform. The scales are multiplied
+// per axis, which is exact while the scales of the parents are the
+// same on every axis (like everything in this demo), and close enough
+// otherwise, the same as most game engines, because a rotated,
+// non-uniform scale (a shear) does not fit into position, rotation,
+// and scale anymore
+
+TransformHierarchy::TransformHierarchy(JobSystem* js, TransformStore* s)
+{
+	jobs = js;
+	store = s;
+	levelStarts.push_back(0);
+}
+
+uint32_t TransformHierarchy::Add(uint32_t parent, glm::vec3 position, glm::quat rotation, glm::vec3 scale, uint32_t storeIndex)
+{
+	uint32_t index = GetCount();
+
+	if (parent != HIERARCHY_NONE && parent >= index)
+	{
+		printf("TransformHierarchy: the parent of node %u does not exist\n", index);
+		return HIERARCHY_NONE;
+	}
+
+	uint32_t level = (parent == HIERARCHY_NONE) ? 0 : levels[parent] + 1;
+	uint32_t lastLevel = (uint32_t)levelStarts.size() - 1;
+
+	// a node can only go into the last level, or start the next one
+	if (index > 0 && level == lastLevel + 1)
+		levelStarts.push_back(index);
+
+	else if (level != lastLevel)
+	{
+		printf("TransformHierarchy: node %u is not added breadth first\n", index);
+		return HIERARCHY_NONE;
+	}
+
+	parents.push_back(parent);
+	levels.push_back(level);
+	storeIndices.push_back(storeIndex);
+	dirty.push_back(1);
+	changed.push_back(0);
+
+	local.Resize(index + 1);
+	world.Resize(index + 1);
+	local.SetPosition(index, position);
+	local.SetRotation(index, rotation);
+	local.SetScale(index, scale);
+
+	return index;
+}
+
+void TransformHierarchy::SetLocalPosition(uint32_t node, glm::vec3 position)
+{
+	local.SetPosition(node, position);
+	dirty[node] = 1;
+}
+
+void TransformHierarchy::SetLocalRotation(uint32_t node, glm::quat rotation)
+{
+	local.SetRotation(node, rotation);
+	dirty[node] = 1;
+}
+
+void TransformHierarchy::SetLocalScale(uint32_t node, glm::vec3 scale)
+{
+	local.SetScale(node, scale);
+	dirty[node] = 1;
+}
+
+glm::quat TransformHierarchy::GetLocalRotation(uint32_t node)
+{
+	return glm::quat(local.rotW[node], local.rotX[node], local.rotY[node], local.rotZ[node]);
+}
+
+void TransformHierarchy::UpdateNodes(uint32_t first, uint32_t end)
+{
+	for (uint32_t i = first; i < end; i++)
+	{
+		uint32_t parent = parents[i];
+		bool parentChanged = (parent != HIERARCHY_NONE) && changed[parent];
+
+		changed[i] = dirty[i] || parentChanged;
+		dirty[i] = 0;
+
+		if (!changed[i])
+			continue;
+
+		glm::vec3 position = local.GetPosition(i);
+		glm::quat rotation(local.rotW[i], local.rotX[i], local.rotY[i], local.rotZ[i]);
+		glm::vec3 scale(local.scaleX[i], local.scaleY[i], local.scaleZ[i]);
+
+		if (parent != HIERARCHY_NONE)
+		{
+			glm::quat parentRotation(world.rotW[parent], world.rotX[parent], world.rotY[parent], world.rotZ[parent]);
+			glm::vec3 parentScale(world.scaleX[parent], world.scaleY[parent], world.scaleZ[parent]);
+
+			position = world.GetPosition(parent) + parentRotation * (parentScale * position);
+			rotation = parentRotation * rotation;
+			scale = parentScale * scale;
+		}
+
+		world.SetPosition(i, position);
+		world.SetRotation(i, rotation);
+		world.SetScale(i, scale);
+	}
+}
+
+uint32_t TransformHierarchy::Update()
+{
+	uint32_t nodeCount = GetCount();
+	uint32_t levelCount = GetLevelCount();
+
+	for (uint32_t l = 0; l < levelCount; l++)
+	{
+		uint32_t first = levelStarts[l];
+		uint32_t end = (l + 1 < levelCount) ? levelStarts[l + 1] : nodeCount;
+
+		// This level needs the one above it to be finished, so we
+		// wait for every job of this level before the next one starts.
+		// Small levels (like the roots) are not worth a job
+		JobCounter counter;
+
+		for (uint32_t j = first; j < end; j += HIERARCHY_JOB_SIZE)
+		{
+			uint32_t jobEnd = (j + HIERARCHY_JOB_SIZE < end) ? j + HIERARCHY_JOB_SIZE : end;
+
+			if (end - first <= HIERARCHY_JOB_SIZE)
+				UpdateNodes(j, jobEnd);
+			else
+				jobs->Run([this, j, jobEnd]() { UpdateNodes(j, jobEnd); }, &counter);
+		}
+
+		jobs->Wait(&counter);
+	}
+
+	// The store keeps one dirty bit for every 64 objects in one word,
+	// so it is given the new transforms here, on one thread. This is
+	// only a copy, the matrices are made later, in TransformStore::Update
+	uint32_t changedCount = 0;
+
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		if (!changed[i])
+			continue;
+
+		changedCount++;
+
+		if (storeIndices[i] == HIERARCHY_NONE)
+			continue;
+
+		store->SetPosition(storeIndices[i], world.GetPosition(i));
+		store->SetRotation(storeIndices[i], glm::quat(world.rotW[i], world.rotX[i], world.rotY[i], world.rotZ[i]));
+		store->SetScale(storeIndices[i], glm::vec3(world.scaleX[i], world.scaleY[i], world.scaleZ[i]));
+	}
+
+	return changedCount;
+}
+
+uint32_t TransformHierarchy::GetCount()
+{
+	return (uint32_t)parents.size();
+}
+
+uint32_t TransformHierarchy::GetLevelCount()
+{
+	return (parents.size() == 0) ? 0 : (uint32_t)levelStarts.size();
+}
@@ -0,0 +1,92 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "TransformBatch.h"
+#include "TransformStore.h"
+#include "JobSystem.h"
+
+// a node without a parent, or a node that has no object in the store
+#define HIERARCHY_NONE 0xFFFFFFFF
+
+// the number of nodes that one job updates
+#define HIERARCHY_JOB_SIZE 256
+
+// Parent and child transforms, in flat arrays instead of a tree of
+// pointers. The nodes are stored breadth first: every node of level 0
+// (the roots), then every node of level 1, and so on, so a node always
+// comes after its parent. Each level only needs the level above it,
+// so all of the nodes of one level are updated at the same time, on
+// the JobSystem, one level after the other
+class TransformHierarchy
+{
+private:
+	JobSystem* jobs;
+	TransformStore* store;
+
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> levels;
+	std::vector<uint32_t> storeIndices;
+
+	// level l is the nodes [levelStarts[l], levelStarts[l + 1])
+	std::vector<uint32_t> levelStarts;
+
+	// the transform of each node, relative to its parent,
+	// and relative to the world, which Update makes
+	TransformArrays local;
+	TransformArrays world;
+
+	// One byte for each node, so that the jobs never write to
+	// the same word. A node is dirty if its local transform
+	// changed, and changed if its world transform is new
+	std::vector<uint8_t> dirty;
+	std::vector<uint8_t> changed;
+
+	void UpdateNodes(uint32_t first, uint32_t end);
+
+public:
+	// the world transforms are written into the store
+	TransformHierarchy(JobSystem* js, TransformStore* s);
+
+	// Adds a node, and returns its index. Nodes must be added breadth
+	// first: the parent (if there is one) must be in the last level,
+	// or in the level before it. storeIndex is the object in the store
+	// that gets the world transform of this node, or HIERARCHY_NONE
+	uint32_t Add(uint32_t parent, glm::vec3 position, glm::quat rotation, glm::vec3 scale, uint32_t storeIndex);
+
+	void SetLocalPosition(uint32_t node, glm::vec3 position);
+	void SetLocalRotation(uint32_t node, glm::quat rotation);
+	void SetLocalScale(uint32_t node, glm::vec3 scale);
+	glm::quat GetLocalRotation(uint32_t node);
+
+	// Makes the world transform of every node that, or whose parent,
+	// changed, and gives them to the store. Returns how many changed
+	uint32_t Update();
+
+	uint32_t GetCount();
+	uint32_t GetLevelCount();
+};
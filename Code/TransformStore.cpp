@@ -0,0 +1,270 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "TransformStore.h"
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Most objects in a big scene do not move in most frames. Before this,
+// the matrix of every object was made again every frame, and all of
+// them were uploaded, even though most of them were the same as last
+// frame. Now the dirty bits say which objects changed, and everything
+// else is skipped, 64 objects at a time, when a whole word is zero
+
+// the index of the lowest bit that is set, word must not be zero
+static uint32_t lowest_bit(uint64_t word)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctzll(word);
+#endif
+}
+
+// Calls fn(first, count) for every run of objects
+// that have their bit set, and clears the bits
+template<typename Function>
+static void for_each_run(std::vector<uint64_t>& bits, uint32_t objectCount, Function fn)
+{
+	uint32_t runFirst = 0;
+	uint32_t runEnd = 0;
+
+	for (uint32_t w = 0; w < (uint32_t)bits.size(); w++)
+	{
+		uint64_t word = bits[w];
+		bits[w] = 0;
+
+		while (word != 0)
+		{
+			uint32_t index = w * 64 + lowest_bit(word);
+			word &= word - 1;
+
+			if (index >= objectCount)
+				break;
+
+			// the same run keeps going, or a new one begins
+			if (index != runEnd)
+			{
+				if (runEnd > runFirst)
+					fn(runFirst, runEnd - runFirst);
+
+				runFirst = index;
+			}
+
+			runEnd = index + 1;
+		}
+	}
+
+	if (runEnd > runFirst)
+		fn(runFirst, runEnd - runFirst);
+}
+
+TransformStore::TransformStore(uint32_t count, uint32_t sliceCount)
+{
+	transforms.Resize(count);
+	models.resize(count);
+
+	// every object starts dirty, so the first
+	// Update and Write fill everything
+	uint32_t wordCount = (count + 63) / 64;
+	dirty.resize(wordCount, ~0ull);
+	stale.resize(sliceCount);
+
+	for (uint32_t i = 0; i < sliceCount; i++)
+		stale[i].resize(wordCount, 0);
+}
+
+void TransformStore::MarkDirty(uint32_t index)
+{
+	dirty[index / 64] |= 1ull << (index % 64);
+}
+
+void TransformStore::SetPosition(uint32_t index, glm::vec3 position)
+{
+	transforms.SetPosition(index, position);
+	MarkDirty(index);
+}
+
+void TransformStore::SetRotation(uint32_t index, glm::quat rotation)
+{
+	transforms.SetRotation(index, rotation);
+	MarkDirty(index);
+}
+
+void TransformStore::SetScale(uint32_t index, glm::vec3 scale)
+{
+	transforms.SetScale(index, scale);
+	MarkDirty(index);
+}
+
+glm::vec3 TransformStore::GetPosition(uint32_t index)
+{
+	return transforms.GetPosition(index);
+}
+
+glm::quat TransformStore::GetRotation(uint32_t index)
+{
+	return glm::quat(transforms.rotW[index], transforms.rotX[index], transforms.rotY[index], transforms.rotZ[index]);
+}
+
+void TransformStore::Load(const float* arrays, const glm::mat4* matrices)
+{
+	uint32_t count = GetCount();
+	transforms.Load(arrays, count);
+	memcpy(models.data(), matrices, count * sizeof(glm::mat4));
+
+	for (size_t w = 0; w < dirty.size(); w++)
+		dirty[w] = 0;
+
+	for (size_t s = 0; s < stale.size(); s++)
+		for (size_t w = 0; w < dirty.size(); w++)
+			stale[s][w] = ~0ull;
+}
+
+uint32_t TransformStore::Update()
+{
+	// every slice needs the new matrices,
+	// so the dirty bits become stale bits
+	for (size_t s = 0; s < stale.size(); s++)
+		for (size_t w = 0; w < dirty.size(); w++)
+			stale[s][w] |= dirty[w];
+
+	uint32_t updated = 0;
+
+	// each run of dirty objects is one call of the SIMD
+	// kernel, which only makes the model matrices
+	for_each_run(dirty, GetCount(), [&](uint32_t first, uint32_t count)
+	{
+		TransformBatch(&transforms, first, count, glm::mat4(), models.data(), nullptr);
+		updated += count;
+	});
+
+	return updated;
+}
+
+uint32_t TransformStore::Write(uint32_t slice, glm::mat4* out)
+{
+	uint32_t written = 0;
+
+	for_each_run(stale[slice], GetCount(), [&](uint32_t first, uint32_t count)
+	{
+		memcpy(&out[first], &models[first], count * sizeof(glm::mat4));
+		written += count;
+	});
+
+	return written;
+}
+
+uint32_t TransformStore::CountStale(uint32_t slice)
+{
+	uint32_t count = 0;
+	uint32_t objectCount = GetCount();
+
+	for (uint32_t w = 0; w < (uint32_t)stale[slice].size(); w++)
+	{
+		uint64_t word = stale[slice][w];
+
+		// the last word can have bits after the last object
+		if ((w + 1) * 64 > objectCount)
+			word &= (1ull << (objectCount % 64)) - 1;
+
+		// Kernighan's loop, one step for every bit that is set,
+		// most words are zero, so this is fast enough
+		while (word != 0)
+		{
+			word &= word - 1;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+uint32_t TransformStore::WriteDeltas(uint32_t slice, uint32_t capacity, TransformDelta* out)
+{
+	uint32_t written = 0;
+	uint32_t objectCount = GetCount();
+	std::vector<uint64_t>& bits = stale[slice];
+
+	for (uint32_t w = 0; w < (uint32_t)bits.size() && written < capacity; w++)
+	{
+		uint64_t word = bits[w];
+
+		// only the bits of the objects that were written
+		// are cleared, the rest wait for the next call
+		while (word != 0 && written < capacity)
+		{
+			uint32_t bit = lowest_bit(word);
+			uint32_t index = w * 64 + bit;
+			word &= word - 1;
+			bits[w] &= ~(1ull << bit);
+
+			// the bits after the last object, in the last word
+			if (index >= objectCount)
+			{
+				bits[w] = 0;
+				break;
+			}
+
+			out[written].index = index;
+			out[written].model = models[index];
+			written++;
+		}
+	}
+
+	return written;
+}
+
+void TransformStore::MarkWritten(uint32_t slice)
+{
+	for (size_t w = 0; w < stale[slice].size(); w++)
+		stale[slice][w] = 0;
+}
+
+void TransformStore::Gather(const uint32_t* indices, uint32_t count, glm::mat4* out)
+{
+	for (uint32_t i = 0; i < count; i++)
+		out[i] = models[indices[i]];
+}
+
+TransformArrays* TransformStore::GetTransforms()
+{
+	return &transforms;
+}
+
+glm::mat4* TransformStore::GetModels()
+{
+	return models.data();
+}
+
+uint32_t TransformStore::GetCount()
+{
+	return (uint32_t)models.size();
+}
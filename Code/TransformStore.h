@@ -0,0 +1,113 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "TransformBatch.h"
+
+// One matrix that changed, and the object that it belongs to, for a
+// buffer that only gets the objects that changed (see WriteDeltas).
+// The index is padded to 16 bytes, so the matrix is aligned like a
+// vec4, and the shader can read a delta as 5 vec4s
+struct TransformDelta
+{
+	uint32_t index;
+	uint32_t padding[3];
+	glm::mat4 model;
+};
+
+// The transforms of many objects, and their model matrices. Setting
+// a transform marks the object as dirty, and Update only computes the
+// matrices of the dirty objects. The matrices are written to a buffer
+// that has one slice for each frame in flight, and each slice only
+// gets the matrices that changed since that slice was last written,
+// so the work of a frame depends on how many objects changed, not on
+// how many objects there are
+class TransformStore
+{
+private:
+	TransformArrays transforms;
+	LargePageVector<glm::mat4> models;
+
+	// one bit for each object, 64 objects in each word.
+	// A dirty object needs a new model matrix
+	std::vector<uint64_t> dirty;
+
+	// one set of bits for each slice of the output, an object is
+	// stale in a slice if that slice has an old matrix of it
+	std::vector<std::vector<uint64_t>> stale;
+
+	void MarkDirty(uint32_t index);
+
+public:
+	TransformStore(uint32_t count, uint32_t sliceCount);
+
+	void SetPosition(uint32_t index, glm::vec3 position);
+	void SetRotation(uint32_t index, glm::quat rotation);
+	void SetScale(uint32_t index, glm::vec3 scale);
+
+	glm::vec3 GetPosition(uint32_t index);
+	glm::quat GetRotation(uint32_t index);
+
+	// Takes the transforms (see TransformArrays::Load) and the model
+	// matrices that were saved from a store of the same size, so no
+	// object is dirty, but every slice still needs every matrix
+	void Load(const float* arrays, const glm::mat4* matrices);
+
+	// computes the model matrix of every dirty object,
+	// and returns how many there were
+	uint32_t Update();
+
+	// Copies every matrix that is stale in this slice into out, which
+	// has room for every object, usually the mapped slice of a buffer.
+	// Returns how many matrices were written
+	uint32_t Write(uint32_t slice, glm::mat4* out);
+
+	// how many objects have an old matrix in this slice
+	uint32_t CountStale(uint32_t slice);
+
+	// Copies up to capacity of the matrices that are stale in this slice
+	// into out, each one with its index, for a slice that is not mapped,
+	// and returns how many were written. The objects that did not fit
+	// stay stale, so the next call writes them
+	uint32_t WriteDeltas(uint32_t slice, uint32_t capacity, TransformDelta* out);
+
+	// the slice got every matrix in some other way,
+	// like a full upload, so nothing is stale in it
+	void MarkWritten(uint32_t slice);
+
+	// Copies the matrices of the objects in indices, one after the
+	// other, into out. This is for a list of visible objects, which is
+	// different every frame, so every matrix of the list is copied
+	void Gather(const uint32_t* indices, uint32_t count, glm::mat4* out);
+
+	// the positions, rotations, and scales, to read
+	// them with SIMD, like the frustum culling does
+	TransformArrays* GetTransforms();
+
+	glm::mat4* GetModels();
+	uint32_t GetCount();
+};
@@ -0,0 +1,220 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#include "TransientPool.h"
+#include "Helper.h"
+#include <algorithm>
+
+// MSAA, the offscreen target, and post-processing each add an image
+// with the size of the window, which is a lot of memory at 4K. Most of
+// them are only needed during a part of the frame, like the MSAA color,
+// which is resolved at the end of the render pass. This is the memory
+// part of a "frame graph": each image says in which phases it is used,
+// and images that are never alive at the same time use the same bytes
+
+TransientPool::TransientPool(VkDevice d, MemoryAllocator* a)
+{
+	device = d;
+	allocator = a;
+	memory = {};
+
+	for (uint32_t i = 0; i < FRAME_PHASE_COUNT; i++)
+		aliasedPhases[i] = false;
+}
+
+TransientPool::~TransientPool()
+{
+	// the images first, then the memory under them
+	for (size_t i = 0; i < images.size(); i++)
+		delete images[i].texture;
+
+	allocator->Free(&memory);
+}
+
+TextureGPU* TransientPool::Add(VkImageCreateInfo info, VkImageAspectFlags aspect, uint32_t firstPhase, uint32_t lastPhase, const char* name)
+{
+	TransientImage t = {};
+	t.name = name;
+	t.firstPhase = firstPhase;
+	t.lastPhase = lastPhase;
+
+	// A TRANSIENT attachment might never get real memory, if the
+	// GPU has LAZILY_ALLOCATED memory (see TextureGPU.cpp), that is
+	// better than any aliasing, so it keeps its own memory
+	uint32_t lazyType;
+	bool lazy = (info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+		MemoryAllocator::memory_type_from_properties(allocator->GetMemoryProperties(), ~0u,
+			VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyType);
+
+	t.aliased = !lazy;
+	t.texture = new TextureGPU(device, allocator, info, aspect, t.aliased);
+	t.texture->SetName(name);
+
+	if (t.aliased)
+		t.reqs = t.texture->GetRequirements();
+
+	images.push_back(t);
+	return t.texture;
+}
+
+bool TransientPool::Overlaps(const TransientImage& a, const TransientImage& b)
+{
+	return a.firstPhase <= b.lastPhase && b.firstPhase <= a.lastPhase;
+}
+
+void TransientPool::Build()
+{
+	// The biggest images are placed first, each one at the lowest
+	// offset where it does not touch the memory of an image that is
+	// alive at the same time. That is a greedy "interval coloring",
+	// it is not always the best, but it is very close with few images
+	std::vector<uint32_t> order;
+	uint32_t typeBits = ~0u;
+
+	for (uint32_t i = 0; i < images.size(); i++)
+	{
+		if (!images[i].aliased)
+			continue;
+
+		order.push_back(i);
+		typeBits &= images[i].reqs.memoryTypeBits;
+	}
+
+	if (order.empty())
+		return;
+
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+	{
+		return images[a].reqs.size > images[b].reqs.size;
+	});
+
+	VkDeviceSize size = 0;
+	VkDeviceSize alignment = 1;
+	std::vector<uint32_t> placed;
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		TransientImage& t = images[order[i]];
+		VkDeviceSize align = t.reqs.alignment;
+		alignment = (align > alignment) ? align : alignment;
+
+		// Try offset 0, and the end of every image that is placed.
+		// The lowest offset that does not collide with an image
+		// that is alive at the same time wins
+		std::vector<VkDeviceSize> candidates(1, 0);
+		for (size_t j = 0; j < placed.size(); j++)
+			candidates.push_back(images[placed[j]].offset + images[placed[j]].reqs.size);
+
+		VkDeviceSize best = ~(VkDeviceSize)0;
+
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			VkDeviceSize offset = (candidates[c] + align - 1) & ~(align - 1);
+			bool fits = true;
+
+			for (size_t j = 0; j < placed.size() && fits; j++)
+			{
+				TransientImage& other = images[placed[j]];
+
+				if (Overlaps(t, other) &&
+					offset < other.offset + other.reqs.size &&
+					other.offset < offset + t.reqs.size)
+					fits = false;
+			}
+
+			if (fits && offset < best)
+				best = offset;
+		}
+
+		t.offset = best;
+		placed.push_back(order[i]);
+
+		if (best + t.reqs.size > size)
+			size = best + t.reqs.size;
+	}
+
+	// Color and depth attachments share a memory type on every GPU
+	// that we know of, if they do not, the images can not be aliased
+	if (typeBits == 0)
+		ERR_EXIT("The transient images do not share a memory type\n", "Memory Allocation Failure");
+
+	VkMemoryRequirements reqs = {};
+	reqs.size = size;
+	reqs.alignment = alignment;
+	reqs.memoryTypeBits = typeBits;
+
+	if (!allocator->Allocate(reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &memory))
+		ERR_EXIT("Failed to allocate memory for TransientPool\n", "Memory Allocation Failure");
+
+	for (size_t i = 0; i < placed.size(); i++)
+	{
+		TransientImage& t = images[placed[i]];
+		t.texture->Bind(memory.memory, memory.offset + t.offset);
+		t.texture->SetName(t.name);
+
+		// remember which phases start with memory that was used before
+		for (size_t j = 0; j < placed.size(); j++)
+		{
+			TransientImage& other = images[placed[j]];
+
+			if (i != j && !Overlaps(t, other) &&
+				t.offset < other.offset + other.reqs.size &&
+				other.offset < t.offset + t.reqs.size)
+				aliasedPhases[t.firstPhase] = true;
+		}
+	}
+}
+
+void TransientPool::AddAliasBarriers(FrameGraph* graph, uint32_t pass, uint32_t phase)
+{
+	if (!aliasedPhases[phase])
+		return;
+
+	// The image that used this memory before might be in an earlier
+	// phase of this frame, or a later phase of the last frame.
+	// Either way, it came before us on the queue, so one barrier
+	// that waits for all of the writes before it is enough. The
+	// new image starts in UNDEFINED, like every render target.
+	// The graph records it with the other barriers of the pass
+	graph->AddMemoryBarrier(pass,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+}
+
+VkDeviceSize TransientPool::GetSize()
+{
+	return memory.size;
+}
+
+VkDeviceSize TransientPool::GetImageBytes()
+{
+	VkDeviceSize bytes = 0;
+
+	for (size_t i = 0; i < images.size(); i++)
+		bytes += images[i].aliased ? images[i].reqs.size : images[i].texture->GetMemorySize();
+
+	return bytes;
+}
@@ -0,0 +1,104 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "TextureGPU.h"
+#include "MemoryAllocator.h"
+#include "FrameGraph.h"
+
+// The parts of one frame, in the order that the command buffer runs
+// them (see Demo::record_cmd). A transient image is only used from its
+// first phase to its last phase, so images that are never used in the
+// same phase can share memory
+enum FramePhase
+{
+	FRAME_PHASE_CULLING,
+	FRAME_PHASE_RENDER_PASS,
+	FRAME_PHASE_UPSCALE,
+	FRAME_PHASE_COUNT
+};
+
+// one image of the pool, and where it lives in the pool's memory
+struct TransientImage
+{
+	TextureGPU* texture;
+	const char* name;
+	uint32_t firstPhase;
+	uint32_t lastPhase;
+
+	// false if the image has memory of its own (lazily allocated)
+	bool aliased;
+	VkMemoryRequirements reqs;
+	VkDeviceSize offset;
+};
+
+// Every image that only lives inside of a frame (and has the size of
+// the window) is added to the pool, and then Build places all of them
+// into one allocation. Two images that are used in different phases
+// can be placed at the same offset, so the pool needs less memory than
+// all of its images together. The pool is made again on every resize
+class TransientPool
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+
+	std::vector<TransientImage> images;
+	MemoryAllocation memory;
+
+	// true if an image that starts in this phase shares
+	// memory with an image that is used in another phase
+	bool aliasedPhases[FRAME_PHASE_COUNT];
+
+	bool Overlaps(const TransientImage& a, const TransientImage& b);
+
+public:
+	TransientPool(VkDevice d, MemoryAllocator* a);
+
+	// deletes every image of the pool, and its memory
+	~TransientPool();
+
+	// The image has no memory until Build, and the pool deletes it.
+	// An image that is read in the next frame lives in every phase
+	TextureGPU* Add(VkImageCreateInfo info, VkImageAspectFlags aspect, uint32_t firstPhase, uint32_t lastPhase, const char* name);
+
+	// Places every image, allocates the memory, and binds the images,
+	// after this, the images have their views
+	void Build();
+
+	// Called for the first pass of a phase. If an image of this phase
+	// shares memory with another image, the GPU has to finish with the
+	// other image first, in this frame, or in the frame before
+	void AddAliasBarriers(FrameGraph* graph, uint32_t pass, uint32_t phase);
+
+	// the memory of the pool, and the memory that
+	// its images would need without aliasing
+	VkDeviceSize GetSize();
+	VkDeviceSize GetImageBytes();
+};
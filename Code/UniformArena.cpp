@@ -0,0 +1,98 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "UniformArena.h"
+
+// Before the arena, the uniform buffer had room for one MVP in each
+// slice, which every cube used, and every cube that needed its own
+// matrix had to use push constants. The arena makes each slice bigger,
+// so that every draw can have its own constants in the same buffer,
+// behind the same descriptor, at a different dynamic offset.
+
+// The buffer is persistently mapped, and it is not HOST_CACHED (see
+// prepare_uniform_buffer), so a write through the pointer does not
+// need to be flushed before the GPU reads it
+
+UniformArena::UniformArena(BufferCPU* b, VkDeviceSize slice, VkDeviceSize reserve, VkDeviceSize align)
+{
+	buffer = b;
+	mapped = (uint8_t*)buffer->GetPointer();
+
+	sliceSize = slice;
+	reserved = reserve;
+	alignment = align;
+
+	start = reserved;
+	head = reserved;
+	end = sliceSize;
+
+	peakBytes = 0;
+	failedAllocations = 0;
+}
+
+void UniformArena::Reset(uint32_t slot)
+{
+	VkDeviceSize used = GetUsedBytes();
+
+	if (used > peakBytes)
+		peakBytes = used;
+
+	// the arena part of this slot's slice,
+	// after the uniform_struct of the frame
+	start = (VkDeviceSize)slot * sliceSize + reserved;
+	end = (VkDeviceSize)(slot + 1) * sliceSize;
+	head = start;
+}
+
+void* UniformArena::Allocate(VkDeviceSize bytes, VkDeviceSize* offset)
+{
+	// Every dynamic offset has to be a multiple of the alignment.
+	// The slice starts at a multiple of it, and so does the reserved
+	// part, so rounding up each size keeps every head aligned
+	VkDeviceSize size = (bytes + alignment - 1) & ~(alignment - 1);
+	VkDeviceSize first = head.fetch_add(size);
+
+	// The head keeps going past the end, which is fine, because
+	// nothing after the end is ever handed out, and Reset moves it back
+	if (first + size > end)
+	{
+		failedAllocations++;
+		return nullptr;
+	}
+
+	*offset = first;
+	return mapped + first;
+}
+
+VkDeviceSize UniformArena::GetUsedBytes()
+{
+	VkDeviceSize h = head;
+	return ((h < end) ? h : end) - start;
+}
+
+VkDeviceSize UniformArena::GetCapacity()
+{
+	return sliceSize - reserved;
+}
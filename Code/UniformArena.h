@@ -0,0 +1,82 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <atomic>
+#include "BufferCPU.h"
+
+// Per-draw constants, carved out of the uniform buffer. The buffer is
+// cut into one slice for each frame in flight (see prepare_uniform_buffer),
+// and every slice starts with the uniform_struct of that frame, the rest
+// of the slice belongs to the arena. Allocate moves the head of this
+// frame's slice forward, and Reset moves it back to the start when that
+// slice is written again, which is after the GPU is done with it.
+// The offset that Allocate returns is the dynamic offset of the
+// UNIFORM_BUFFER_DYNAMIC descriptor, so a draw with its own constants
+// costs one pointer bump and one vkCmdBindDescriptorSets, instead of
+// a buffer or a descriptor set of its own
+class UniformArena
+{
+private:
+	BufferCPU* buffer;
+	uint8_t* mapped;
+
+	VkDeviceSize sliceSize;
+	VkDeviceSize reserved;
+	VkDeviceSize alignment;
+
+	// the range of the slice that is being handed out. Many threads
+	// record draws at the same time (see CommandRecorder.cpp), so
+	// the head is moved with one atomic add
+	VkDeviceSize start;
+	std::atomic<VkDeviceSize> head;
+	VkDeviceSize end;
+
+public:
+	// the most bytes that one frame used, and the
+	// allocations that did not fit into their slice
+	VkDeviceSize peakBytes;
+	std::atomic<uint64_t> failedAllocations;
+
+	// reserved is the part of every slice that is not in the
+	// arena (the uniform_struct of that frame), and alignment
+	// is minUniformBufferOffsetAlignment of the GPU
+	UniformArena(BufferCPU* b, VkDeviceSize slice, VkDeviceSize reserve, VkDeviceSize align);
+
+	// everything that was allocated in this slot the last time
+	// it was used is gone, the GPU has to be done with it
+	void Reset(uint32_t slot);
+
+	// Returns where the bytes can be written, and their offset from
+	// the start of the buffer. When the slice is full, it returns
+	// nullptr, and the draw has to use the constants of the frame
+	void* Allocate(VkDeviceSize bytes, VkDeviceSize* offset);
+
+	// bytes handed out since Reset
+	VkDeviceSize GetUsedBytes();
+	VkDeviceSize GetCapacity();
+};
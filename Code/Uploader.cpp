@@ -0,0 +1,919 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#include "Uploader.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+#include "DeviceTable.h"
+
+// Many GPUs have a queue family that only supports transfer
+// commands. On desktop GPUs this is a copy engine that works
+// at the same time as the graphics engine, so copying a big
+// texture does not make the next frame wait.
+
+// Using two queue families comes with one extra rule: a buffer
+// or image that is made with VK_SHARING_MODE_EXCLUSIVE belongs
+// to one queue family at a time. After the transfer queue writes
+// to it, the transfer queue "releases" it with a barrier, and then
+// the graphics queue "acquires" it with an identical barrier.
+// If the GPU does not have a transfer-only family, then both
+// queues are the same, and none of that is needed
+
+// The Uploader never makes the CPU wait. When Submit() is called,
+// the copies go to the GPU with a fence, and the caller gets a ticket.
+// The render loop calls Poll() every frame, which checks the fences
+// and deletes the CPU buffers of every batch that is finished.
+
+// Draw commands do not need to wait for the ticket. Everything that
+// is submitted to the graphics queue after Submit() is ordered behind
+// the barriers (and the semaphore) that Submit() put on the graphics
+// queue, so the GPU itself will never read a half-copied buffer
+
+Uploader::Uploader(VkDevice d, MemoryAllocator* a, VkQueue gQueue, uint32_t gFamily, VkQueue tQueue, uint32_t tFamily, SyncPool* pool, bool cachedStaging)
+{
+	device = d;
+	allocator = a;
+	syncPool = pool;
+	graphicsQueue = gQueue;
+	graphicsFamily = gFamily;
+	transferQueue = tQueue;
+	transferFamily = tFamily;
+
+	dedicated = graphicsFamily != transferFamily;
+
+	current = nullptr;
+	nextTicket = 1;
+	completedTicket = 0;
+
+	timeline = VK_NULL_HANDLE;
+	fpWaitSemaphoresKHR = NULL;
+	fpGetSemaphoreCounterValueKHR = NULL;
+	graphicsSubmits = nullptr;
+	fpTransitionImageLayoutEXT = NULL;
+	fpCopyMemoryToImageEXT = NULL;
+
+	budgeted = false;
+	budgetMs = 0;
+	budgetCopies = 0;
+	budgetBytes = UPLOAD_DEFAULT_FRAME_BYTES;
+	queryPool = VK_NULL_HANDLE;
+	timedBatches = 0;
+	timestampPeriod = 1.0f;
+	timestampMask = 0;
+	bytesPerMs = 0;
+	frameBytes = 0;
+	frameCopies = 0;
+
+	// command pools belong to one queue family, so
+	// the transfer commands need a pool of their own
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = transferFamily;
+	vkCreateCommandPool(device, &poolInfo, HostAllocator::callbacks, &transferPool);
+
+	// the acquire commands only exist if the queues are different
+	graphicsPool = VK_NULL_HANDLE;
+
+	if (dedicated)
+	{
+		poolInfo.queueFamilyIndex = graphicsFamily;
+		vkCreateCommandPool(device, &poolInfo, HostAllocator::callbacks, &graphicsPool);
+	}
+
+	// make the staging ring, which stays mapped
+	// for the whole lifetime of the uploader. With
+	// cachedStaging, every memcpy into it is flushed
+	ring = new StagingRing(device, allocator, STAGING_RING_SIZE, cachedStaging);
+}
+
+Uploader::~Uploader()
+{
+	// submit anything that was recorded, and wait for 
+	// every batch, so that all CPU buffers get deleted
+	Wait(Submit());
+
+	// destroying the pools also frees the command buffers,
+	// the fences and semaphores went back to the SyncPool
+	for (size_t i = 0; i < freeBatches.size(); i++)
+		delete freeBatches[i];
+
+	freeBatches.clear();
+
+	// every batch is finished, nothing is using the ring
+	delete ring;
+
+	vkDestroyCommandPool(device, transferPool, HostAllocator::callbacks);
+
+	if (dedicated)
+		vkDestroyCommandPool(device, graphicsPool, HostAllocator::callbacks);
+
+	if (timeline != VK_NULL_HANDLE)
+		vkDestroySemaphore(device, timeline, HostAllocator::callbacks);
+
+	if (queryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, queryPool, HostAllocator::callbacks);
+}
+
+void Uploader::EnableBatching(SubmitBatch* batch)
+{
+	graphicsSubmits = batch;
+}
+
+void Uploader::EnableHostImageCopy(PFN_vkTransitionImageLayoutEXT transitionFn, PFN_vkCopyMemoryToImageEXT copyFn)
+{
+	fpTransitionImageLayoutEXT = transitionFn;
+	fpCopyMemoryToImageEXT = copyFn;
+}
+
+bool Uploader::CopyOnHost(TextureGPU* dst, const void* data, uint32_t regionCount, const VkBufferImageCopy* regions, bool generateMips)
+{
+	// The mips are made with vkCmdBlitImage, which needs a command
+	// buffer anyway, so those textures are copied the normal way
+	if (fpCopyMemoryToImageEXT == NULL || generateMips || data == nullptr ||
+		!(dst->GetUsage() & VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT))
+		return false;
+
+	// The texture is never used by the transfer queue, so it has
+	// nothing to release or acquire. If the driver could not copy
+	// it, it goes through a batch, which changes the layout again
+	if (dst->StoreHost(fpTransitionImageLayoutEXT, fpCopyMemoryToImageEXT, data, regionCount, regions) != VK_SUCCESS)
+	{
+		printf("The host image copy failed, the texture is uploaded with a staging buffer\n");
+		return false;
+	}
+
+	return true;
+}
+
+void Uploader::EnableTimeline(PFN_vkWaitSemaphoresKHR waitFn, PFN_vkGetSemaphoreCounterValueKHR valueFn)
+{
+	fpWaitSemaphoresKHR = waitFn;
+	fpGetSemaphoreCounterValueKHR = valueFn;
+
+	// A timeline semaphore holds a number that only goes up. The
+	// tickets of the batches count up too, and they finish in order,
+	// so when the semaphore's value is N, every ticket up to N is done.
+	// Nothing needs to be reset after a batch finishes, like a fence does
+	VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = completedTicket;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	vkCreateSemaphore(device, &semaphoreInfo, HostAllocator::callbacks, &timeline);
+}
+
+void Uploader::EnableBudget(VkPhysicalDevice gpu, double targetMs, uint32_t copyCount)
+{
+	budgeted = true;
+	budgetMs = targetMs;
+	budgetCopies = copyCount;
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(gpu, &props);
+
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, NULL);
+
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, families.data());
+
+	// Like GpuTimer, a queue family with 0 valid bits can not write
+	// timestamps, then the budget stays at UPLOAD_DEFAULT_FRAME_BYTES
+	uint32_t validBits = families[transferFamily].timestampValidBits;
+
+	if (validBits == 0 || props.limits.timestampPeriod == 0.0f)
+	{
+		printf("The transfer queue can not write timestamps, the upload budget is not measured\n");
+		return;
+	}
+
+	timestampPeriod = props.limits.timestampPeriod;
+	timestampMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+
+	VkQueryPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = UPLOAD_TIMED_BATCHES * 4;
+	vkCreateQueryPool(device, &poolInfo, HostAllocator::callbacks, &queryPool);
+}
+
+void Uploader::BeginFrame()
+{
+	frameBytes = 0;
+	frameCopies = 0;
+
+	if (!budgeted || bytesPerMs <= 0)
+		return;
+
+	// as many bytes as the copy engine moves in budgetMs
+	budgetBytes = (VkDeviceSize)(bytesPerMs * budgetMs);
+
+	if (budgetBytes < UPLOAD_MIN_FRAME_BYTES)
+		budgetBytes = UPLOAD_MIN_FRAME_BYTES;
+}
+
+bool Uploader::TakeBudget(VkDeviceSize bytes)
+{
+	if (!budgeted)
+		return true;
+
+	// The GPU has not finished the copies of the last frames yet,
+	// more copies would only wait behind them, and the frames that
+	// need the copy engine (or the graphics queue) would wait too
+	if (inFlight.size() >= UPLOAD_MAX_BATCHES_IN_FLIGHT)
+		return false;
+
+	if (frameCopies > 0 && (frameCopies >= budgetCopies || frameBytes + bytes > budgetBytes))
+		return false;
+
+	frameBytes += bytes;
+	frameCopies++;
+	return true;
+}
+
+void Uploader::Measure(UploadBatch* batch)
+{
+	// the pair that was reset in this submission can be used now
+	for (uint32_t p = 0; p < 2; p++)
+	{
+		if (batch->pairState[p] == 1)
+			batch->pairState[p] = 2;
+	}
+
+	if (batch->timedPair < 0)
+		return;
+
+	uint32_t first = batch->queryBase + batch->timedPair * 2;
+	batch->pairState[batch->timedPair] = 0;
+	batch->timedPair = -1;
+
+	if (batch->bytes < UPLOAD_MIN_MEASURED_BYTES)
+		return;
+
+	// the fence (or the timeline) of the batch is done,
+	// so the results are there, and this never waits
+	uint64_t ticks[2];
+
+	VkResult result = DeviceTable::GetQueryPoolResults(device, queryPool, first, 2,
+		sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS)
+		return;
+
+	double ms = (((ticks[1] & timestampMask) - (ticks[0] & timestampMask)) & timestampMask) * timestampPeriod / 1000000.0;
+
+	if (ms <= 0)
+		return;
+
+	// the speed of one batch jumps around, so it is averaged
+	double rate = (double)batch->bytes / ms;
+	bytesPerMs = (bytesPerMs <= 0) ? rate : (bytesPerMs * 0.9 + rate * 0.1);
+}
+
+UploadBatch* Uploader::GetBatch()
+{
+	// keep adding to the batch that is
+	// already being recorded, if there is one
+	if (current != nullptr)
+		return current;
+
+	// reuse a finished batch if there is one,
+	// otherwise make a new batch
+	if (freeBatches.size() > 0)
+	{
+		current = freeBatches.back();
+		freeBatches.pop_back();
+	}
+	else
+	{
+		current = new UploadBatch();
+
+		VkCommandBufferAllocateInfo cmdInfo = {};
+		cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmdInfo.commandPool = transferPool;
+		cmdInfo.commandBufferCount = 1;
+		vkAllocateCommandBuffers(device, &cmdInfo, &current->transferCmd);
+
+		current->acquireCmd = VK_NULL_HANDLE;
+
+		if (dedicated)
+		{
+			cmdInfo.commandPool = graphicsPool;
+			vkAllocateCommandBuffers(device, &cmdInfo, &current->acquireCmd);
+		}
+
+		// both pairs of timestamps have to be reset before they are used
+		current->queryBase = UINT32_MAX;
+		current->timedPair = -1;
+		current->pairState[0] = 0;
+		current->pairState[1] = 0;
+
+		if (queryPool != VK_NULL_HANDLE && timedBatches < UPLOAD_TIMED_BATCHES)
+			current->queryBase = 4 * timedBatches++;
+	}
+
+	// The fence and the semaphore are only held while the batch
+	// is on the GPU, see Retire. With a timeline semaphore,
+	// batches do not need fences
+	current->transferComplete = dedicated ? syncPool->AcquireSemaphore() : VK_NULL_HANDLE;
+	current->fence = (timeline == VK_NULL_HANDLE) ? syncPool->AcquireFence() : VK_NULL_HANDLE;
+
+	// the ticket is given out now, so that every
+	// Upload call can tell the caller which ticket
+	// its copy belongs to
+	current->ticket = nextTicket++;
+	current->ringBytes = 0;
+	current->bytes = 0;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	DeviceTable::BeginCommandBuffer(current->transferCmd, &beginInfo);
+
+	if (dedicated)
+		DeviceTable::BeginCommandBuffer(current->acquireCmd, &beginInfo);
+
+	// a pair that was reset in an earlier submission
+	// times every copy of this batch
+	if (current->queryBase != UINT32_MAX)
+	{
+		for (int p = 0; p < 2 && current->timedPair < 0; p++)
+		{
+			if (current->pairState[p] != 2)
+				continue;
+
+			current->timedPair = p;
+			DeviceTable::CmdWriteTimestamp(current->transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, current->queryBase + p * 2);
+		}
+	}
+
+	return current;
+}
+
+UploadTicket Uploader::UploadBuffer(BufferGPU* dst, BufferCPU* src, int size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage, VkDeviceSize dstOffset)
+{
+	UploadBatch* batch = GetBatch();
+
+	if (dedicated)
+	{
+		// copy, and release the buffer on the transfer queue,
+		// then acquire it on the graphics queue, where it will
+		// be read at dstStage (vertex input, for example)
+		dst->Store(batch->transferCmd, src->buffer, size, 0, transferFamily, graphicsFamily, dstOffset);
+		dst->Acquire(batch->acquireCmd, transferFamily, graphicsFamily, dstAccess, dstStage);
+	}
+	else
+	{
+		// one queue: the copy is followed by a normal barrier,
+		// so that the copy is finished before dstStage reads it
+		dst->Store(batch->transferCmd, src->buffer, size, 0, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dstOffset);
+		dst->Acquire(batch->transferCmd, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dstAccess, dstStage);
+	}
+
+	// src is deleted when this batch is finished
+	batch->staging.push_back(src);
+	batch->bytes += size;
+	return batch->ticket;
+}
+
+UploadTicket Uploader::UploadTexture(TextureGPU* dst, BufferCPU* src, int width, int height)
+{
+	// Only level 0 is in the CPU buffer, so if there
+	// are more levels, they are generated on the GPU
+	VkBufferImageCopy region = dst->GetRegion(width, height, 0);
+
+	// a mapped buffer can be copied by the CPU, then it is not needed
+	if (CopyOnHost(dst, src->GetPointer(), 1, &region, dst->mipLevels > 1))
+	{
+		delete src;
+		return completedTicket;
+	}
+
+	UploadBatch* batch = GetBatch();
+	AddTexture(batch, dst, src->buffer, 1, &region, dst->mipLevels > 1);
+
+	// src is deleted when this batch is finished
+	batch->staging.push_back(src);
+	batch->bytes += (VkDeviceSize)width * height * 4;
+	return batch->ticket;
+}
+
+BufferCPU* Uploader::MakeStaging(void* data, VkDeviceSize size)
+{
+	// This is for uploads that are bigger than the whole ring.
+	// It works just like uploads did before the ring existed,
+	// a BufferCPU is made for this one upload, and it is deleted
+	// when the batch is finished
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	info.size = size;
+
+	BufferCPU* staging = new BufferCPU(device, allocator, info);
+	staging->SetName("Upload staging");
+	staging->Store(data, (int)size);
+	return staging;
+}
+
+uint8_t* Uploader::AllocateRing(VkDeviceSize size, VkDeviceSize* offset)
+{
+	VkDeviceSize consumed;
+
+	// If the ring is full, we first check if any batches
+	// finished on their own. If that is not enough, we submit
+	// what we have, and wait for the oldest batch to finish.
+	// This only happens if a lot of data is uploaded at once
+	while (!ring->Allocate(size, offset, &consumed))
+	{
+		Poll();
+
+		if (ring->Allocate(size, offset, &consumed))
+			break;
+
+		if (inFlight.size() == 0)
+			Submit();
+
+		// Nothing was recorded, and nothing is in flight, so the ring
+		// is empty, and waiting would never free anything. The caller
+		// copies through a buffer of its own instead
+		if (inFlight.size() == 0)
+			return nullptr;
+
+		Wait(inFlight.front()->ticket);
+	}
+
+	// GetBatch is called after the ring allocation, because
+	// the loop above might have submitted the current batch
+	UploadBatch* batch = GetBatch();
+	batch->ringBytes += consumed;
+
+	return ring->GetPointer() + *offset;
+}
+
+UploadTicket Uploader::UploadBuffer(BufferGPU* dst, void* data, int size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage, VkDeviceSize dstOffset)
+{
+	if ((VkDeviceSize)size > ring->GetSize())
+		return UploadBuffer(dst, MakeStaging(data, size), size, dstAccess, dstStage, dstOffset);
+
+	// In the steady state, this is the whole upload:
+	// move the head of the ring, memcpy, and record a copy
+	VkDeviceSize offset;
+	uint8_t* ptr = AllocateRing(size, &offset);
+
+	if (ptr == nullptr)
+		return UploadBuffer(dst, MakeStaging(data, size), size, dstAccess, dstStage, dstOffset);
+
+	memcpy(ptr, data, size);
+	ring->Flush(offset, size);
+
+	UploadBatch* batch = GetBatch();
+
+	if (dedicated)
+	{
+		dst->Store(batch->transferCmd, ring->GetBuffer(), size, offset, transferFamily, graphicsFamily, dstOffset);
+		dst->Acquire(batch->acquireCmd, transferFamily, graphicsFamily, dstAccess, dstStage);
+	}
+	else
+	{
+		dst->Store(batch->transferCmd, ring->GetBuffer(), size, offset, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dstOffset);
+		dst->Acquire(batch->transferCmd, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dstAccess, dstStage);
+	}
+
+	batch->bytes += size;
+	return batch->ticket;
+}
+
+UploadTicket Uploader::UploadTexture(TextureGPU* dst, void* data, int width, int height)
+{
+	// 4 bytes per pixel (RGBA)
+	VkDeviceSize size = (VkDeviceSize)width * height * 4;
+
+	// no ring and no batch, the CPU copies the pixels into the image
+	VkBufferImageCopy hostRegion = dst->GetRegion(width, height, 0);
+
+	if (CopyOnHost(dst, data, 1, &hostRegion, dst->mipLevels > 1))
+		return completedTicket;
+
+	if (size > ring->GetSize())
+		return UploadTexture(dst, MakeStaging(data, size), width, height);
+
+	VkDeviceSize offset;
+	uint8_t* ptr = AllocateRing(size, &offset);
+
+	if (ptr == nullptr)
+		return UploadTexture(dst, MakeStaging(data, size), width, height);
+
+	memcpy(ptr, data, (size_t)size);
+	ring->Flush(offset, size);
+
+	UploadBatch* batch = GetBatch();
+
+	VkBufferImageCopy region = dst->GetRegion(width, height, offset);
+	AddTexture(batch, dst, ring->GetBuffer(), 1, &region, dst->mipLevels > 1);
+
+	batch->bytes += size;
+	return batch->ticket;
+}
+
+UploadTicket Uploader::UploadTextureLevels(TextureGPU* dst, void* data, VkDeviceSize size, uint32_t regionCount, const VkBufferImageCopy* regions)
+{
+	// every level is in data, so nothing is generated
+	if (CopyOnHost(dst, data, regionCount, regions, false))
+		return completedTicket;
+
+	// The regions are moved to wherever the data is put in the
+	// ring. The ring keeps every allocation 16-byte aligned, which
+	// is what compressed blocks need (BC1 is 8, BC7 and ASTC are 16)
+	std::vector<VkBufferImageCopy> moved(regions, regions + regionCount);
+	VkBuffer buffer;
+
+	VkDeviceSize offset = 0;
+	uint8_t* ptr = (size > ring->GetSize()) ? nullptr : AllocateRing(size, &offset);
+
+	if (ptr == nullptr)
+	{
+		BufferCPU* staging = MakeStaging(data, size);
+		GetBatch()->staging.push_back(staging);
+		buffer = staging->buffer;
+	}
+	else
+	{
+		memcpy(ptr, data, (size_t)size);
+		ring->Flush(offset, size);
+
+		for (uint32_t i = 0; i < regionCount; i++)
+			moved[i].bufferOffset += offset;
+
+		buffer = ring->GetBuffer();
+	}
+
+	UploadBatch* batch = GetBatch();
+	AddTexture(batch, dst, buffer, regionCount, moved.data(), false);
+
+	batch->bytes += size;
+	return batch->ticket;
+}
+
+void Uploader::AddTexture(UploadBatch* batch, TextureGPU* dst, VkBuffer buffer, uint32_t regionCount, const VkBufferImageCopy* regions, bool generateMips)
+{
+	// The barriers of every texture in the batch are recorded together,
+	// so the same texture can not be in there twice, its second copy
+	// has to come after the barriers of the first one
+	for (size_t i = 0; i < batch->textures.size(); i++)
+	{
+		if (batch->textures[i].texture == dst)
+		{
+			RecordTextures(batch);
+			break;
+		}
+	}
+
+	PendingTexture t;
+	t.texture = dst;
+	t.buffer = buffer;
+	t.regions.assign(regions, regions + regionCount);
+	t.generateMips = generateMips;
+	batch->textures.push_back(t);
+}
+
+void Uploader::RecordTextures(UploadBatch* batch)
+{
+	// Storing the textures one at a time records two barriers for each of
+	// them, and every barrier makes the transfer queue finish everything
+	// before it. Here, one barrier moves every texture to TRANSFER_DST,
+	// then every copy runs without anything in between, and one barrier
+	// moves every texture to the fragment shader (or releases it to the
+	// graphics queue). This is what TextureGPU::Store does, split in parts
+	if (batch->textures.empty())
+		return;
+
+	std::vector<VkImageMemoryBarrier> barriers;
+	barriers.reserve(batch->textures.size());
+
+	for (size_t i = 0; i < batch->textures.size(); i++)
+	{
+		PendingTexture& t = batch->textures[i];
+		barriers.push_back(t.texture->BeginCopy((uint32_t)t.regions.size(), t.regions.data(), t.generateMips));
+	}
+
+	DeviceTable::CmdPipelineBarrier(batch->transferCmd,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, NULL, 0, NULL,
+		(uint32_t)barriers.size(), barriers.data());
+
+	for (size_t i = 0; i < batch->textures.size(); i++)
+	{
+		PendingTexture& t = batch->textures[i];
+		DeviceTable::CmdCopyBufferToImage(batch->transferCmd, t.buffer, t.texture->image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)t.regions.size(), t.regions.data());
+	}
+
+	// The transfer queue cannot use the fragment shader stage,
+	// so with two queues, the textures are released at the end
+	// of the transfer, and the graphics queue acquires them
+	uint32_t srcFamily = dedicated ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+	uint32_t dstFamily = dedicated ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+
+	barriers.clear();
+
+	for (size_t i = 0; i < batch->textures.size(); i++)
+	{
+		VkImageMemoryBarrier barrier;
+
+		if (batch->textures[i].texture->EndCopy(srcFamily, dstFamily, &barrier))
+			barriers.push_back(barrier);
+	}
+
+	if (!barriers.empty())
+	{
+		DeviceTable::CmdPipelineBarrier(batch->transferCmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			dedicated ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, NULL, 0, NULL,
+			(uint32_t)barriers.size(), barriers.data());
+	}
+
+	// Textures with a mipmap chain make their levels after that, on the
+	// graphics queue. Each level reads the one before it, so these
+	// barriers can not be put together, but the others are not waiting
+	if (dedicated)
+	{
+		barriers.clear();
+		VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+		for (size_t i = 0; i < batch->textures.size(); i++)
+		{
+			TextureGPU* texture = batch->textures[i].texture;
+			barriers.push_back(texture->GetAcquireBarrier(srcFamily, dstFamily));
+
+			if (texture->NeedsMips())
+				dstStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		}
+
+		DeviceTable::CmdPipelineBarrier(batch->acquireCmd,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			dstStages,
+			0, 0, NULL, 0, NULL,
+			(uint32_t)barriers.size(), barriers.data());
+	}
+
+	VkCommandBuffer mipsCmd = dedicated ? batch->acquireCmd : batch->transferCmd;
+
+	for (size_t i = 0; i < batch->textures.size(); i++)
+	{
+		if (batch->textures[i].texture->NeedsMips())
+			batch->textures[i].texture->GenerateMips(mipsCmd);
+	}
+
+	batch->textures.clear();
+}
+
+UploadTicket Uploader::Submit()
+{
+	// nothing was recorded since the last Submit,
+	// so the newest ticket is the last one we gave out
+	if (current == nullptr)
+		return nextTicket - 1;
+
+	UploadBatch* batch = current;
+	current = nullptr;
+
+	// the copies into textures were saved for now
+	RecordTextures(batch);
+
+	// The second timestamp is written when every copy is done. The
+	// pair that is not ready is reset for the next submission of this
+	// batch, on the graphics queue, because a transfer queue can not
+	// reset queries. Its last results were already read in Measure
+	if (batch->queryBase != UINT32_MAX)
+	{
+		if (batch->timedPair >= 0)
+			DeviceTable::CmdWriteTimestamp(batch->transferCmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, batch->queryBase + batch->timedPair * 2 + 1);
+
+		VkCommandBuffer resetCmd = dedicated ? batch->acquireCmd : batch->transferCmd;
+
+		for (int p = 0; p < 2; p++)
+		{
+			if (p == batch->timedPair || batch->pairState[p] != 0)
+				continue;
+
+			DeviceTable::CmdResetQueryPool(resetCmd, queryPool, batch->queryBase + p * 2, 2);
+			batch->pairState[p] = 1;
+		}
+	}
+
+	DeviceTable::EndCommandBuffer(batch->transferCmd);
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &batch->transferCmd;
+
+	// The last submission of the batch signals the timeline with the
+	// ticket of the batch. Every semaphore that is signaled needs a
+	// value in this struct, binary semaphores ignore their value
+	uint64_t signalValue = batch->ticket;
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	if (dedicated)
+	{
+		// the transfer queue signals the semaphore when
+		// the copies are done, and the graphics queue waits
+		// for that semaphore before it acquires the resources
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &batch->transferComplete;
+		{
+			QueueLock queueLock;
+			DeviceTable::QueueSubmit(transferQueue, 1, &submit_info, VK_NULL_HANDLE);
+		}
+
+		DeviceTable::EndCommandBuffer(batch->acquireCmd);
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo acquire_info = {};
+		acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquire_info.waitSemaphoreCount = 1;
+		acquire_info.pWaitSemaphores = &batch->transferComplete;
+		acquire_info.pWaitDstStageMask = &waitStage;
+		acquire_info.commandBufferCount = 1;
+		acquire_info.pCommandBuffers = &batch->acquireCmd;
+
+		if (timeline != VK_NULL_HANDLE)
+		{
+			acquire_info.pNext = &timelineInfo;
+			acquire_info.signalSemaphoreCount = 1;
+			acquire_info.pSignalSemaphores = &timeline;
+		}
+
+		if (graphicsSubmits != nullptr)
+			graphicsSubmits->Add(acquire_info, batch->fence);
+		else
+		{
+			QueueLock queueLock;
+			DeviceTable::QueueSubmit(graphicsQueue, 1, &acquire_info, batch->fence);
+		}
+	}
+	else
+	{
+		if (timeline != VK_NULL_HANDLE)
+		{
+			submit_info.pNext = &timelineInfo;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores = &timeline;
+		}
+
+		// without a transfer family, this is the graphics queue
+		if (graphicsSubmits != nullptr)
+			graphicsSubmits->Add(submit_info, batch->fence);
+		else
+		{
+			QueueLock queueLock;
+			DeviceTable::QueueSubmit(transferQueue, 1, &submit_info, batch->fence);
+		}
+	}
+
+	inFlight.push_back(batch);
+	return batch->ticket;
+}
+
+void Uploader::Retire(UploadBatch* batch)
+{
+	// the GPU is done with every CPU buffer in this batch
+	for (size_t i = 0; i < batch->staging.size(); i++)
+		delete batch->staging[i];
+
+	batch->staging.clear();
+
+	// the GPU is also done with this batch's part of the ring
+	ring->Release(batch->ringBytes);
+	batch->ringBytes = 0;
+
+	// how long the copies took, for the budget
+	if (batch->queryBase != UINT32_MAX)
+		Measure(batch);
+
+	// The graphics queue waited on the semaphore in the same
+	// submission that the fence (or the timeline) tracks, so it
+	// is unsignaled again, and the pool resets the fence
+	if (batch->fence != VK_NULL_HANDLE)
+		syncPool->ReleaseFence(batch->fence);
+
+	if (batch->transferComplete != VK_NULL_HANDLE)
+		syncPool->ReleaseSemaphore(batch->transferComplete);
+
+	batch->fence = VK_NULL_HANDLE;
+	batch->transferComplete = VK_NULL_HANDLE;
+
+	DeviceTable::ResetCommandBuffer(batch->transferCmd, 0);
+
+	if (dedicated)
+		DeviceTable::ResetCommandBuffer(batch->acquireCmd, 0);
+
+	completedTicket = batch->ticket;
+	freeBatches.push_back(batch);
+}
+
+void Uploader::Poll()
+{
+	// Batches finish in the order they were submitted,
+	// so we check the oldest one first, and stop at the
+	// first batch that is still running. vkGetFenceStatus
+	// does not wait, it just tells us if the fence is open.
+	// With a timeline, one read of the semaphore's value tells
+	// us about every batch at once
+	uint64_t value = 0;
+
+	if (timeline != VK_NULL_HANDLE)
+		fpGetSemaphoreCounterValueKHR(device, timeline, &value);
+
+	while (inFlight.size() > 0)
+	{
+		UploadBatch* batch = inFlight.front();
+
+		if (timeline != VK_NULL_HANDLE)
+		{
+			if (value < batch->ticket)
+				break;
+		}
+		else if (DeviceTable::GetFenceStatus(device, batch->fence) != VK_SUCCESS)
+			break;
+
+		inFlight.erase(inFlight.begin());
+		Retire(batch);
+	}
+}
+
+bool Uploader::IsComplete(UploadTicket ticket)
+{
+	return ticket <= completedTicket;
+}
+
+void Uploader::Wait(UploadTicket ticket)
+{
+	// This is the only function that makes the CPU wait.
+	// It waits for every batch up to (and including) the
+	// batch with this ticket, which might still be in the
+	// graphics queue's SubmitBatch, so that is sent first
+	if (graphicsSubmits != nullptr)
+		graphicsSubmits->Flush();
+
+	if (timeline != VK_NULL_HANDLE && inFlight.size() > 0)
+	{
+		// wait for the newest batch that we need, which
+		// means that every batch before it is done too
+		uint64_t value = ticket;
+		if (value > inFlight.back()->ticket)
+			value = inFlight.back()->ticket;
+
+		VkSemaphoreWaitInfoKHR waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &timeline;
+		waitInfo.pValues = &value;
+		fpWaitSemaphoresKHR(device, &waitInfo, UINT64_MAX);
+	}
+
+	while (inFlight.size() > 0 && inFlight.front()->ticket <= ticket)
+	{
+		UploadBatch* batch = inFlight.front();
+
+		if (batch->fence != VK_NULL_HANDLE)
+			DeviceTable::WaitForFences(device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+
+		inFlight.erase(inFlight.begin());
+		Retire(batch);
+	}
+}
@@ -0,0 +1,262 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "BufferCPU.h"
+#include "BufferGPU.h"
+#include "TextureGPU.h"
+#include "StagingRing.h"
+#include "TimelineSemaphore.h"
+#include "SubmitBatch.h"
+#include "SyncPool.h"
+
+// Every submission to the Uploader gets a ticket number.
+// Tickets count up, and they finish in the same order
+// that they were submitted
+typedef uint64_t UploadTicket;
+
+// With a budget (see EnableBudget), this is how many bytes the
+// streaming work of one frame can copy, until the copies of a few
+// batches were timed, and the budget comes from how fast they were
+#define UPLOAD_DEFAULT_FRAME_BYTES (4 * 1024 * 1024)
+
+// the budget never goes below this, so streaming always moves forward
+#define UPLOAD_MIN_FRAME_BYTES (256 * 1024)
+
+// A batch that is smaller than this takes about as long as an empty
+// one, so its time says nothing about how fast the copies are
+#define UPLOAD_MIN_MEASURED_BYTES (64 * 1024)
+
+// When this many batches are still on the GPU, the copies are
+// behind, and no more streaming work starts until they catch up
+#define UPLOAD_MAX_BATCHES_IN_FLIGHT 4
+
+// only the first batches that are made have timestamps,
+// the batches are reused, so there are never many of them
+#define UPLOAD_TIMED_BATCHES 16
+
+// A copy into a texture, which is recorded with the other
+// textures of its batch, when the batch is submitted
+struct PendingTexture
+{
+	TextureGPU* texture;
+	VkBuffer buffer;
+	std::vector<VkBufferImageCopy> regions;
+	bool generateMips;
+};
+
+// One group of copies that is submitted together,
+// along with everything needed to know when it is done
+struct UploadBatch
+{
+	VkCommandBuffer transferCmd;
+	VkCommandBuffer acquireCmd;
+	VkSemaphore transferComplete;
+	VkFence fence;
+	UploadTicket ticket;
+
+	// bytes of the staging ring that this batch used,
+	// which are given back when the fence tells us the GPU is done
+	VkDeviceSize ringBytes;
+
+	// CPU buffers that were too big for the ring, which
+	// are deleted when the fence tells us the GPU is done
+	std::vector<BufferCPU*> staging;
+
+	// the texture copies that are not recorded yet
+	std::vector<PendingTexture> textures;
+
+	// With a budget, every batch has two pairs of timestamps in the
+	// query pool, starting at queryBase (UINT32_MAX if it has none).
+	// A pair can only be reset on a graphics queue, so while one pair
+	// times the copies, the other one is reset, see Uploader::Submit.
+	// timedPair is the pair that this submission writes, or -1
+	uint32_t queryBase;
+	int timedPair;
+	uint32_t pairState[2];
+
+	// how many bytes the copies of this batch have
+	VkDeviceSize bytes;
+};
+
+// The Uploader records every copy from a CPU buffer to a GPU
+// buffer or texture. If the GPU has a queue family that can only
+// do transfers (usually a DMA engine), the copies are submitted
+// there, so they do not take time away from the graphics queue.
+// Nothing here waits for the GPU, unless Wait() is called
+class Uploader
+{
+private:
+	VkDevice device;
+	MemoryAllocator* allocator;
+
+	// each batch takes its fence and its semaphore from
+	// here, and gives them back when it is finished
+	SyncPool* syncPool;
+
+	// all uploads that fit are copied through this ring
+	StagingRing* ring;
+
+	VkQueue graphicsQueue;
+	uint32_t graphicsFamily;
+	VkQueue transferQueue;
+	uint32_t transferFamily;
+
+	// copies are recorded in command buffers from this pool,
+	// and submitted to the transfer queue
+	VkCommandPool transferPool;
+
+	// When the copies happen on a different queue family, the
+	// graphics queue has to "acquire" every buffer and texture
+	// before it can use them, these commands come from this pool
+	VkCommandPool graphicsPool;
+
+	// the batch that is being recorded right now (or nullptr),
+	// batches that are on the GPU, and batches that can be reused
+	UploadBatch* current;
+	std::vector<UploadBatch*> inFlight;
+	std::vector<UploadBatch*> freeBatches;
+
+	UploadTicket nextTicket;
+	UploadTicket completedTicket;
+
+	// With a timeline semaphore, each batch signals its ticket
+	// number on the semaphore, instead of signaling a fence
+	VkSemaphore timeline;
+	PFN_vkWaitSemaphoresKHR fpWaitSemaphoresKHR;
+	PFN_vkGetSemaphoreCounterValueKHR fpGetSemaphoreCounterValueKHR;
+
+	// With batching, the submissions to the graphics queue are added
+	// to this, and sent together with the frame, see SubmitBatch.cpp
+	SubmitBatch* graphicsSubmits;
+
+	// With host image copy, see EnableHostImageCopy
+	PFN_vkTransitionImageLayoutEXT fpTransitionImageLayoutEXT;
+	PFN_vkCopyMemoryToImageEXT fpCopyMemoryToImageEXT;
+
+	// With a budget, see EnableBudget. The pool is VK_NULL_HANDLE
+	// if the transfer queue can not write timestamps
+	bool budgeted;
+	double budgetMs;
+	uint32_t budgetCopies;
+	VkDeviceSize budgetBytes;
+	VkQueryPool queryPool;
+	uint32_t timedBatches;
+	float timestampPeriod;
+	uint64_t timestampMask;
+
+	// how many bytes the GPU copies in a millisecond, from the
+	// timestamps, 0 until the first batch was measured
+	double bytesPerMs;
+
+	// the streaming work that was started in this frame
+	VkDeviceSize frameBytes;
+	uint32_t frameCopies;
+
+	void Measure(UploadBatch* batch);
+
+	UploadBatch* GetBatch();
+	void Retire(UploadBatch* batch);
+	BufferCPU* MakeStaging(void* data, VkDeviceSize size);
+
+	// nullptr if the ring can not fit size even when it is empty,
+	// then the caller copies through MakeStaging instead
+	uint8_t* AllocateRing(VkDeviceSize size, VkDeviceSize* offset);
+	void AddTexture(UploadBatch* batch, TextureGPU* dst, VkBuffer buffer, uint32_t regionCount, const VkBufferImageCopy* regions, bool generateMips);
+	void RecordTextures(UploadBatch* batch);
+	bool CopyOnHost(TextureGPU* dst, const void* data, uint32_t regionCount, const VkBufferImageCopy* regions, bool generateMips);
+
+public:
+	// true if transferQueue is not the graphics queue
+	bool dedicated;
+
+	Uploader(
+		VkDevice d,
+		MemoryAllocator* a,
+		VkQueue gQueue,
+		uint32_t gFamily,
+		VkQueue tQueue,
+		uint32_t tFamily,
+		SyncPool* pool,
+		bool cachedStaging = false);
+
+	~Uploader();
+
+	// Call this before the first upload, to track the batches
+	// with one timeline semaphore, instead of one fence per batch
+	void EnableTimeline(PFN_vkWaitSemaphoresKHR waitFn, PFN_vkGetSemaphoreCounterValueKHR valueFn);
+
+	// The batch must be for the graphics queue, and it is
+	// flushed by Wait, before the CPU waits for anything
+	void EnableBatching(SubmitBatch* batch);
+
+	// With host image copy, a texture that was made with HOST_TRANSFER
+	// usage is copied by the CPU, straight from the data into the image,
+	// when UploadTexture or UploadTextureLevels is called, instead of
+	// through the ring and a batch. Its ticket is already complete.
+	// Textures that need GenerateMips still go through a batch
+	void EnableHostImageCopy(PFN_vkTransitionImageLayoutEXT transitionFn, PFN_vkCopyMemoryToImageEXT copyFn);
+
+	// With a budget, the work that can wait (like streaming) asks
+	// TakeBudget before it uploads anything, and what does not fit is
+	// left for a later frame. Each frame can start copyCount copies, and
+	// as many bytes as the GPU copies in targetMs, which is measured with
+	// timestamps around every batch. Uploads that do not ask are never
+	// held back. Call it before the first upload
+	void EnableBudget(VkPhysicalDevice gpu, double targetMs, uint32_t copyCount);
+
+	// Starts the budget of a new frame, call it once per frame, after Poll
+	void BeginFrame();
+
+	// True if one more copy of this many bytes fits in this frame, then
+	// it is counted. The first copy of a frame always fits, so something
+	// bigger than the budget still loads, just alone. Nothing fits while
+	// UPLOAD_MAX_BATCHES_IN_FLIGHT batches are still copying. Without a
+	// budget, this is always true
+	bool TakeBudget(VkDeviceSize bytes);
+	bool IsBudgeted() { return budgeted; }
+
+	// The Uploader takes ownership of src, and deletes
+	// it after the GPU is finished copying from it.
+	// dstOffset is where the data goes in dst
+	UploadTicket UploadBuffer(BufferGPU* dst, BufferCPU* src, int size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage, VkDeviceSize dstOffset = 0);
+	UploadTicket UploadTexture(TextureGPU* dst, BufferCPU* src, int width, int height);
+
+	// These copy the data into the staging ring right away,
+	// so the caller can free the data as soon as they return
+	UploadTicket UploadBuffer(BufferGPU* dst, void* data, int size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage, VkDeviceSize dstOffset = 0);
+	UploadTicket UploadTexture(TextureGPU* dst, void* data, int width, int height);
+
+	// For textures that have every mip level in data (like KTX2 files),
+	// each region's bufferOffset is where its level starts in data
+	UploadTicket UploadTextureLevels(TextureGPU* dst, void* data, VkDeviceSize size, uint32_t regionCount, const VkBufferImageCopy* regions);
+
+	UploadTicket Submit();
+	void Poll();
+	bool IsComplete(UploadTicket ticket);
+	void Wait(UploadTicket ticket);
+};
@@ -0,0 +1,344 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "VideoTexture.h"
+#include "Helper.h"
+#include "HostAllocator.h"
+
+VideoTexture::VideoTexture(
+	VkDevice d,
+	VkPhysicalDevice gpu,
+	MemoryAllocator* a,
+	VkFormat f,
+	uint32_t w,
+	uint32_t h,
+	PFN_vkCreateSamplerYcbcrConversionKHR createFn,
+	PFN_vkDestroySamplerYcbcrConversionKHR destroyFn)
+{
+	device = d;
+	destroyConversion = destroyFn;
+	format = f;
+	width = w;
+	height = h;
+	current = -1;
+	generation = 0;
+	sampleSize = (format == VK_FORMAT_G8_B8R8_2PLANE_420_UNORM) ? 1 : 2;
+
+	// The chroma samples of most videos are between two brightness
+	// samples (MIDPOINT), some GPUs can only put them on the first one
+	// (COSITED_EVEN). With LINEAR, the color between two chroma samples
+	// is blended, which is smoother, if the format allows it
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(gpu, format, &props);
+	VkFormatFeatureFlags features = props.optimalTilingFeatures;
+
+	VkChromaLocation location = (features & VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT) ?
+		VK_CHROMA_LOCATION_MIDPOINT : VK_CHROMA_LOCATION_COSITED_EVEN;
+
+	VkFilter filter = (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_LINEAR_FILTER_BIT) ?
+		VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+	// BT.709 is the color space of HD video, and "narrow"
+	// means that Y goes from 16 to 235, not from 0 to 255
+	VkSamplerYcbcrConversionCreateInfoKHR conversionCreateInfo = {};
+	conversionCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO_KHR;
+	conversionCreateInfo.format = format;
+	conversionCreateInfo.ycbcrModel = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709_KHR;
+	conversionCreateInfo.ycbcrRange = VK_SAMPLER_YCBCR_RANGE_ITU_NARROW_KHR;
+	conversionCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	conversionCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	conversionCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	conversionCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	conversionCreateInfo.xChromaOffset = location;
+	conversionCreateInfo.yChromaOffset = location;
+	conversionCreateInfo.chromaFilter = filter;
+	conversionCreateInfo.forceExplicitReconstruction = VK_FALSE;
+
+	if (createFn(device, &conversionCreateInfo, HostAllocator::callbacks, &conversion) != VK_SUCCESS)
+		ERR_EXIT("Failed to create the YCbCr conversion\n", "Video Texture Failure");
+
+	conversionInfo = {};
+	conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO_KHR;
+	conversionInfo.conversion = conversion;
+
+	// The filter of the sampler has to be the same as the chroma
+	// filter, and a sampler with a conversion has to clamp to the edge
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.pNext = &conversionInfo;
+	samplerInfo.magFilter = filter;
+	samplerInfo.minFilter = filter;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1;
+	samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = 0.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+	vkCreateSampler(device, &samplerInfo, HostAllocator::callbacks, &sampler);
+
+	// Video frames have no mipmaps. Both planes are in one piece of
+	// memory (the image is not DISJOINT), so it is bound like any
+	// other image, and barriers use the COLOR aspect
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = format;
+	image_create_info.extent.width = width;
+	image_create_info.extent.height = height;
+	image_create_info.extent.depth = 1;
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	for (uint32_t i = 0; i < VIDEO_TEXTURE_IMAGES; i++)
+	{
+		images[i].texture = new TextureGPU(device, a, image_create_info,
+			VK_IMAGE_ASPECT_COLOR_BIT, false, false, &conversionInfo);
+
+		images[i].texture->SetName("Video texture");
+		images[i].ticket = 0;
+		images[i].pending = false;
+		images[i].usedUntil = 0;
+	}
+}
+
+VideoTexture::~VideoTexture()
+{
+	for (uint32_t i = 0; i < VIDEO_TEXTURE_IMAGES; i++)
+		delete images[i].texture;
+
+	vkDestroySampler(device, sampler, HostAllocator::callbacks);
+	destroyConversion(device, conversion, HostAllocator::callbacks);
+}
+
+bool VideoTexture::IsSupported(VkPhysicalDevice gpu, VkFormat f)
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(gpu, f, &props);
+
+	VkFormatFeatureFlags needed =
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+		VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+
+	VkFormatFeatureFlags chroma =
+		VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT |
+		VK_FORMAT_FEATURE_COSITED_CHROMA_SAMPLES_BIT;
+
+	return (props.optimalTilingFeatures & needed) == needed &&
+		(props.optimalTilingFeatures & chroma) != 0;
+}
+
+uint32_t VideoTexture::GetDescriptorCount(VkPhysicalDevice gpu, VkFormat f,
+	PFN_vkGetPhysicalDeviceImageFormatProperties2KHR propertiesFn)
+{
+	VkSamplerYcbcrConversionImageFormatPropertiesKHR conversionProperties = {};
+	conversionProperties.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_IMAGE_FORMAT_PROPERTIES_KHR;
+
+	VkImageFormatProperties2KHR properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
+	properties.pNext = &conversionProperties;
+
+	VkPhysicalDeviceImageFormatInfo2KHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
+	info.format = f;
+	info.type = VK_IMAGE_TYPE_2D;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	if (propertiesFn(gpu, &info, &properties) != VK_SUCCESS)
+		return 1;
+
+	uint32_t count = conversionProperties.combinedImageSamplerDescriptorCount;
+	return (count > 0) ? count : 1;
+}
+
+VkDeviceSize VideoTexture::GetFrameSize()
+{
+	// the CbCr plane has two samples for every
+	// 2x2 pixels, so it is half as big as the Y plane
+	VkDeviceSize lumaSize = (VkDeviceSize)width * height * sampleSize;
+	return lumaSize + lumaSize / 2;
+}
+
+TextureGPU* VideoTexture::Acquire(uint64_t completedFrames)
+{
+	for (uint32_t i = 0; i < VIDEO_TEXTURE_IMAGES; i++)
+	{
+		VideoImage& image = images[i];
+
+		if ((int)i == current || image.pending || completedFrames < image.usedUntil)
+			continue;
+
+		image.pending = true;
+		image.ticket = UINT64_MAX;
+		return image.texture;
+	}
+
+	return nullptr;
+}
+
+UploadTicket VideoTexture::Upload(Uploader* uploader, TextureGPU* image, const void* data)
+{
+	// One region for each plane. The Y plane is width x height, one sample
+	// per pixel, and the CbCr plane is half of that in each direction, with
+	// Cb and Cr next to each other. The aspect picks the plane, and the
+	// extent is in the texels of that plane
+	VkBufferImageCopy regions[2] = {};
+
+	regions[0].bufferOffset = 0;
+	regions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT_KHR;
+	regions[0].imageSubresource.layerCount = 1;
+	regions[0].imageExtent = { width, height, 1 };
+
+	regions[1].bufferOffset = (VkDeviceSize)width * height * sampleSize;
+	regions[1].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_1_BIT_KHR;
+	regions[1].imageSubresource.layerCount = 1;
+	regions[1].imageExtent = { width / 2, height / 2, 1 };
+
+	return uploader->UploadTextureLevels(image, (void*)data, GetFrameSize(), 2, regions);
+}
+
+void VideoTexture::Submit(TextureGPU* image, UploadTicket ticket)
+{
+	for (uint32_t i = 0; i < VIDEO_TEXTURE_IMAGES; i++)
+	{
+		if (images[i].texture == image)
+			images[i].ticket = ticket;
+	}
+}
+
+void VideoTexture::Update(Uploader* uploader, uint64_t frame)
+{
+	// the newest frame of the video has the largest ticket,
+	// the frames before it are skipped if they were too slow
+	int newest = -1;
+
+	for (uint32_t i = 0; i < VIDEO_TEXTURE_IMAGES; i++)
+	{
+		VideoImage& image = images[i];
+
+		if (!image.pending || image.ticket == UINT64_MAX)
+			continue;
+
+		if (current >= 0 && !uploader->IsComplete(image.ticket))
+			continue;
+
+		if (newest < 0 || image.ticket > images[newest].ticket)
+			newest = (int)i;
+	}
+
+	if (newest >= 0)
+	{
+		// the frames that are still on the GPU keep reading the old
+		// image, its usedUntil says when it can be written again
+		current = newest;
+		images[current].pending = false;
+		generation++;
+
+		// older frames that were finished after it are dropped
+		for (uint32_t i = 0; i < VIDEO_TEXTURE_IMAGES; i++)
+		{
+			VideoImage& image = images[i];
+
+			if (image.pending && image.ticket != UINT64_MAX && image.ticket < images[current].ticket)
+				image.pending = false;
+		}
+	}
+
+	if (current >= 0)
+		images[current].usedUntil = frame + 1;
+}
+
+TextureGPU* VideoTexture::GetTexture()
+{
+	return (current >= 0) ? images[current].texture : nullptr;
+}
+
+void VideoTexture::MakeTestFrame(uint32_t index, std::vector<uint8_t>& frame)
+{
+	// The Y, Cb, and Cr of the 75% color bars in BT.709: white, yellow,
+	// cyan, green, magenta, red, blue, and black. The bars move to the
+	// left by two pixels in every frame of the video
+	static const uint8_t bars[8][3] =
+	{
+		{ 180, 128, 128 },
+		{ 168,  44, 136 },
+		{ 145, 147,  44 },
+		{ 133,  63,  52 },
+		{  63, 193, 204 },
+		{  51, 109, 212 },
+		{  28, 212, 120 },
+		{  16, 128, 128 },
+	};
+
+	frame.resize((size_t)GetFrameSize());
+
+	uint8_t* luma = frame.data();
+	uint8_t* chroma = luma + (size_t)width * height * sampleSize;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			uint32_t bar = (((x + index * 2) % width) * 8) / width;
+			const uint8_t* c = bars[bar];
+
+			// a sample of P010 is 16 bits, the 10 bits of the
+			// value are at the top, so 8 bits are shifted by 8
+			size_t i = (size_t)y * width + x;
+
+			if (sampleSize == 1)
+				luma[i] = c[0];
+			else
+				((uint16_t*)luma)[i] = (uint16_t)(c[0] << 8);
+
+			// one Cb and one Cr for each 2x2 pixels
+			if ((x & 1) || (y & 1))
+				continue;
+
+			size_t j = ((size_t)(y / 2) * (width / 2) + x / 2) * 2;
+
+			if (sampleSize == 1)
+			{
+				chroma[j] = c[1];
+				chroma[j + 1] = c[2];
+			}
+			else
+			{
+				((uint16_t*)chroma)[j] = (uint16_t)(c[1] << 8);
+				((uint16_t*)chroma)[j + 1] = (uint16_t)(c[2] << 8);
+			}
+		}
+	}
+}
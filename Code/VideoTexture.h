@@ -0,0 +1,149 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_sdk_platform.h>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "TextureGPU.h"
+#include "Uploader.h"
+
+// the images that the frames of the video go into, one is
+// shown, the others are being written, or still being read
+// by frames on the GPU that showed them before
+#define VIDEO_TEXTURE_IMAGES 4
+
+// One image of a VideoTexture
+struct VideoImage
+{
+	TextureGPU* texture;
+
+	// the copy of the frame that is in the image
+	UploadTicket ticket;
+
+	// true from Acquire until the image is shown
+	bool pending;
+
+	// the frames before this one might still be reading it
+	uint64_t usedUntil;
+};
+
+// A texture that shows a video, in the format that video decoders
+// give (NV12, or P010 for 10 bits). The brightness (Y) is one plane,
+// and the color (Cb and Cr) is a second plane, at half the width
+// and half the height. The sampler has a VkSamplerYcbcrConversion,
+// so the texture unit turns each sample into RGB, and the shader is
+// the same one as for any other texture. The CPU never converts the
+// colors, and a frame is copied once, straight into its image.
+// A hardware decoder can write into the image from Acquire itself,
+// instead of Upload, then the frame is not copied at all
+class VideoTexture
+{
+private:
+	VkDevice device;
+	PFN_vkDestroySamplerYcbcrConversionKHR destroyConversion;
+
+	VkSamplerYcbcrConversion conversion;
+
+	// every view (and the sampler) has to be made with the conversion
+	VkSamplerYcbcrConversionInfoKHR conversionInfo;
+
+	VideoImage images[VIDEO_TEXTURE_IMAGES];
+
+	// the image that is shown, or -1 before the first frame
+	int current;
+
+	// 1 byte for each sample in NV12, 2 in P010
+	uint32_t sampleSize;
+
+public:
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+
+	// The sampler has to be an immutable sampler in the descriptor set
+	// layout, because of the conversion. Descriptors of the view ignore
+	// the sampler that they are written with
+	VkSampler sampler;
+
+	// this changes when another image is shown
+	uint32_t generation;
+
+	// The format is VK_FORMAT_G8_B8R8_2PLANE_420_UNORM (NV12), or
+	// VK_FORMAT_G10X6_B10X6R10X6_2PLANE_420_UNORM_3PACK16 (P010), and
+	// the width and height have to be even. The device needs the
+	// samplerYcbcrConversion feature, see IsSupported
+	VideoTexture(
+		VkDevice d,
+		VkPhysicalDevice gpu,
+		MemoryAllocator* a,
+		VkFormat f,
+		uint32_t w,
+		uint32_t h,
+		PFN_vkCreateSamplerYcbcrConversionKHR createFn,
+		PFN_vkDestroySamplerYcbcrConversionKHR destroyFn);
+
+	// nothing on the GPU can still be using it
+	~VideoTexture();
+
+	// true if the GPU can sample the format with a conversion
+	static bool IsSupported(VkPhysicalDevice gpu, VkFormat f);
+
+	// A conversion can need more than one descriptor for each texture,
+	// the descriptor pool needs room for that many (at least 1). This
+	// needs vkGetPhysicalDeviceImageFormatProperties2
+	static uint32_t GetDescriptorCount(VkPhysicalDevice gpu, VkFormat f,
+		PFN_vkGetPhysicalDeviceImageFormatProperties2KHR propertiesFn);
+
+	// the bytes of one frame, the Y plane followed by the CbCr plane
+	VkDeviceSize GetFrameSize();
+
+	// An image that no frame on the GPU is reading (completedFrames
+	// are done), which the next frame of the video can be written to,
+	// or nullptr if they are all in use. Give it to Submit after
+	TextureGPU* Acquire(uint64_t completedFrames);
+
+	// copies one frame (GetFrameSize bytes) into
+	// an image from Acquire, with the uploader
+	UploadTicket Upload(Uploader* uploader, TextureGPU* image, const void* data);
+
+	// the frame in the image is complete when the ticket is
+	void Submit(TextureGPU* image, UploadTicket ticket);
+
+	// Shows the newest image that is complete, and remembers that
+	// frame is using it. Before the first frame, the first image is shown
+	// even if its copy is not done, because the graphics queue waits for
+	// the uploads that were submitted before it
+	void Update(Uploader* uploader, uint64_t frame);
+
+	// the image that is shown, in SHADER_READ_ONLY layout
+	TextureGPU* GetTexture();
+
+	// Stands in for a video decoder. Writes one frame of moving color
+	// bars, in the format of this texture, with limited range BT.709
+	// colors (like most videos), so the colors are never RGB on the CPU
+	void MakeTestFrame(uint32_t index, std::vector<uint8_t>& frame);
+};
@@ -0,0 +1,734 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "VoxelWorld.h"
+#include "FrustumCulling.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// Division that rounds down, so block -1 is in chunk -1, not
+// chunk 0, the streamed world goes past 0 in x and z
+static int FloorDiv(int a, int b)
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+VoxelWorld::VoxelWorld(VoxelParams p)
+{
+	params = p;
+	pool = nullptr;
+	uploader = nullptr;
+	jobs = nullptr;
+	centerX = 0;
+	centerZ = 0;
+}
+
+VoxelWorld::~VoxelWorld()
+{
+	// a job might still be writing the blocks of a chunk
+	if (jobs != nullptr)
+		jobs->Wait(&loadCounter);
+
+	for (auto& it : chunks)
+		delete it.second;
+}
+
+uint64_t VoxelWorld::ChunkKey(int cx, int cy, int cz)
+{
+	// 21 bits for each coordinate, which is
+	// a million chunks in each direction
+	return ((uint64_t)(cx & 0x1FFFFF) << 42) | ((uint64_t)(cy & 0x1FFFFF) << 21) | (uint64_t)(cz & 0x1FFFFF);
+}
+
+VoxelChunk* VoxelWorld::GetChunk(int cx, int cy, int cz)
+{
+	auto it = chunks.find(ChunkKey(cx, cy, cz));
+	return (it != chunks.end()) ? it->second : nullptr;
+}
+
+bool VoxelWorld::InRing(int cx, int cy, int cz)
+{
+	if (cy < 0 || cy >= (int)params.chunksY)
+		return false;
+
+	// without streaming, the ring is the whole world
+	if (params.streamRadius == 0)
+		return cx >= 0 && cz >= 0 && cx < (int)params.chunksX && cz < (int)params.chunksZ;
+
+	int r = (int)params.streamRadius;
+	return abs(cx - centerX) <= r && abs(cz - centerZ) <= r;
+}
+
+uint32_t VoxelWorld::GetRingChunkCount()
+{
+	if (params.streamRadius == 0)
+		return params.chunksX * params.chunksY * params.chunksZ;
+
+	uint32_t side = params.streamRadius * 2 + 1;
+	return side * side * params.chunksY;
+}
+
+uint32_t VoxelWorld::GetChunkCount()
+{
+	return (uint32_t)chunks.size();
+}
+
+uint32_t VoxelWorld::GetVertexCapacity()
+{
+	return (GetRingChunkCount() + VOXEL_SPARE_SLOTS) * VOXEL_SLOT_QUADS * 4;
+}
+
+uint32_t VoxelWorld::GetIndexCapacity()
+{
+	return (GetRingChunkCount() + VOXEL_SPARE_SLOTS) * VOXEL_SLOT_QUADS * 6;
+}
+
+VoxelChunk* VoxelWorld::Load(int cx, int cy, int cz)
+{
+	VoxelChunk* chunk = new VoxelChunk();
+	chunk->x = cx;
+	chunk->y = cy;
+	chunk->z = cz;
+	chunk->generated = false;
+	chunk->ready = false;
+	chunk->dirty = false;
+	chunk->lastUsed = 0;
+	chunk->slot = VOXEL_NO_SLOT;
+	chunk->quadCount = 0;
+	chunk->pendingSlot = VOXEL_NO_SLOT;
+	chunk->pendingQuads = 0;
+	chunk->pendingTicket = 0;
+	chunk->meshedQuads = 0;
+	chunks[ChunkKey(cx, cy, cz)] = chunk;
+
+	// The terrain of one chunk only depends on where the chunk is,
+	// so it is made on any thread, and the job only touches the
+	// blocks of this chunk, which nothing reads until it is ready
+	jobs->Run([this, chunk]() { Generate(chunk); }, &loadCounter);
+	return chunk;
+}
+
+void VoxelWorld::Generate(VoxelChunk* chunk)
+{
+	// Rolling hills, from a few waves that go in different
+	// directions. The seed moves the waves, so every seed has
+	// different hills, and the same seed always has the same ones
+	const int N = VOXEL_CHUNK_SIZE;
+	int sizeY = params.chunksY * N;
+	float phase = (float)(params.seed % 1024) * 0.37f;
+
+	chunk->blocks.assign(VOXEL_CHUNK_BLOCKS, VOXEL_AIR);
+
+	for (int lz = 0; lz < N; lz++)
+	{
+		for (int lx = 0; lx < N; lx++)
+		{
+			int x = chunk->x * N + lx;
+			int z = chunk->z * N + lz;
+
+			float h = 0.5f +
+				0.20f * sinf(x * 0.050f + phase) * cosf(z * 0.040f - phase) +
+				0.10f * sinf((x + z) * 0.110f + phase * 2.0f) +
+				0.05f * cosf((x - z) * 0.230f - phase);
+
+			int height = (int)(h * sizeY);
+
+			if (height < 1)
+				height = 1;
+			if (height > sizeY)
+				height = sizeY;
+
+			// the top block is a different block than the ones under it
+			for (int ly = 0; ly < N; ly++)
+			{
+				int y = chunk->y * N + ly;
+
+				if (y < height)
+					chunk->blocks[(ly * N + lz) * N + lx] = (y == height - 1) ? 1 : 2;
+			}
+		}
+	}
+
+	chunk->generated = true;
+}
+
+uint8_t VoxelWorld::GetBlock(int x, int y, int z)
+{
+	int cx = FloorDiv(x, VOXEL_CHUNK_SIZE);
+	int cy = FloorDiv(y, VOXEL_CHUNK_SIZE);
+	int cz = FloorDiv(z, VOXEL_CHUNK_SIZE);
+	VoxelChunk* chunk = GetChunk(cx, cy, cz);
+
+	if (chunk == nullptr || !chunk->ready)
+		return VOXEL_AIR;
+
+	int lx = x - cx * VOXEL_CHUNK_SIZE;
+	int ly = y - cy * VOXEL_CHUNK_SIZE;
+	int lz = z - cz * VOXEL_CHUNK_SIZE;
+	return chunk->blocks[(ly * VOXEL_CHUNK_SIZE + lz) * VOXEL_CHUNK_SIZE + lx];
+}
+
+void VoxelWorld::MarkDirty(int cx, int cy, int cz)
+{
+	VoxelChunk* chunk = GetChunk(cx, cy, cz);
+
+	if (chunk != nullptr && chunk->ready)
+		chunk->dirty = true;
+}
+
+void VoxelWorld::SetBlock(int x, int y, int z, uint8_t block)
+{
+	int cx = FloorDiv(x, VOXEL_CHUNK_SIZE);
+	int cy = FloorDiv(y, VOXEL_CHUNK_SIZE);
+	int cz = FloorDiv(z, VOXEL_CHUNK_SIZE);
+	VoxelChunk* chunk = GetChunk(cx, cy, cz);
+
+	if (chunk == nullptr || !chunk->ready)
+		return;
+
+	int lx = x - cx * VOXEL_CHUNK_SIZE;
+	int ly = y - cy * VOXEL_CHUNK_SIZE;
+	int lz = z - cz * VOXEL_CHUNK_SIZE;
+	uint8_t& b = chunk->blocks[(ly * VOXEL_CHUNK_SIZE + lz) * VOXEL_CHUNK_SIZE + lx];
+
+	if (b == block)
+		return;
+
+	b = block;
+	chunk->dirty = true;
+
+	// the face between this block and the block in the next chunk
+	// belongs to the mesh of whichever block is solid
+	if (lx == 0) MarkDirty(cx - 1, cy, cz);
+	if (ly == 0) MarkDirty(cx, cy - 1, cz);
+	if (lz == 0) MarkDirty(cx, cy, cz - 1);
+	if (lx == VOXEL_CHUNK_SIZE - 1) MarkDirty(cx + 1, cy, cz);
+	if (ly == VOXEL_CHUNK_SIZE - 1) MarkDirty(cx, cy + 1, cz);
+	if (lz == VOXEL_CHUNK_SIZE - 1) MarkDirty(cx, cy, cz + 1);
+}
+
+void VoxelWorld::SetCenter(glm::vec3 position)
+{
+	centerX = FloorDiv((int)floorf(position.x), VOXEL_CHUNK_SIZE);
+	centerZ = FloorDiv((int)floorf(position.z), VOXEL_CHUNK_SIZE);
+}
+
+void VoxelWorld::Mesh(VoxelChunk* chunk)
+{
+	const int N = VOXEL_CHUNK_SIZE;
+	int base[3] = { chunk->x * N, chunk->y * N, chunk->z * N };
+
+	chunk->vertices.clear();
+	chunk->indices.clear();
+	chunk->meshedQuads = 0;
+
+	// One value for each face of a slice: 0 if there is no face,
+	// the block if the face points forward (+d), and the block
+	// plus 256 if it points back (-d), so faces only merge with
+	// faces of the same block that point the same way
+	uint16_t mask[VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE];
+
+	// d is the axis that the faces point along, u and v are the
+	// two axes of the slice, and e_u x e_v = e_d, so a quad with
+	// its corners in the order of u and then v faces forward
+	for (int d = 0; d < 3; d++)
+	{
+		int u = (d + 1) % 3;
+		int v = (d + 2) % 3;
+		int p[3];
+		int q[3] = { 0, 0, 0 };
+		q[d] = 1;
+
+		// Slice k is between the blocks at k - 1 and k. Slice 0 and
+		// slice N are the sides of the chunk, the blocks on the other
+		// side come from the next chunk, so a face that is covered
+		// by a block of the next chunk is not in the mesh either
+		for (int k = 0; k <= N; k++)
+		{
+			for (int j = 0; j < N; j++)
+			{
+				for (int i = 0; i < N; i++)
+				{
+					p[d] = k;
+					p[u] = i;
+					p[v] = j;
+
+					int wx = base[0] + p[0];
+					int wy = base[1] + p[1];
+					int wz = base[2] + p[2];
+					uint8_t a = GetBlock(wx - q[0], wy - q[1], wz - q[2]);
+					uint8_t b = GetBlock(wx, wy, wz);
+
+					// each face belongs to the chunk of its solid block
+					uint16_t face = 0;
+					if (a != VOXEL_AIR && b == VOXEL_AIR && k > 0)
+						face = a;
+					else if (a == VOXEL_AIR && b != VOXEL_AIR && k < N)
+						face = 256 + b;
+
+					mask[j * N + i] = face;
+				}
+			}
+
+			// Greedy meshing: start at the first face that is left,
+			// make the rectangle as wide as the same face goes, then as
+			// tall as every row under it is the same, and take those
+			// faces out of the mask. It does not find the fewest
+			// rectangles, but it is close, and it is one pass
+			for (int j = 0; j < N; j++)
+			{
+				for (int i = 0; i < N;)
+				{
+					uint16_t face = mask[j * N + i];
+
+					if (face == 0)
+					{
+						i++;
+						continue;
+					}
+
+					int w = 1;
+					while (i + w < N && mask[j * N + i + w] == face)
+						w++;
+
+					int h = 1;
+					bool grow = true;
+
+					while (j + h < N && grow)
+					{
+						for (int x = 0; x < w; x++)
+						{
+							if (mask[(j + h) * N + i + x] != face)
+							{
+								grow = false;
+								break;
+							}
+						}
+
+						if (grow)
+							h++;
+					}
+
+					for (int y = 0; y < h; y++)
+						memset(&mask[(j + y) * N + i], 0, w * sizeof(uint16_t));
+
+					// the corners, in the space of the chunk
+					float corner[4][3];
+					for (int c = 0; c < 4; c++)
+					{
+						corner[c][d] = (float)k;
+						corner[c][u] = (float)(i + ((c == 1 || c == 2) ? w : 0));
+						corner[c][v] = (float)(j + ((c == 2 || c == 3) ? h : 0));
+					}
+
+					float uvs[4][2] = { { 0.0f, 0.0f }, { (float)w, 0.0f }, { (float)w, (float)h }, { 0.0f, (float)h } };
+					uint32_t first = (uint32_t)chunk->vertices.size();
+
+					for (int c = 0; c < 4; c++)
+					{
+						VoxelVertex vertex;
+						memcpy(vertex.position, corner[c], sizeof(vertex.position));
+						memcpy(vertex.uv, uvs[c], sizeof(vertex.uv));
+						chunk->vertices.push_back(vertex);
+					}
+
+					// a face that points back is wound the other way,
+					// so that back-face culling keeps the outside of it
+					static const uint32_t forward[6] = { 0, 1, 2, 0, 2, 3 };
+					static const uint32_t backward[6] = { 0, 2, 1, 0, 3, 2 };
+					const uint32_t* order = (face < 256) ? forward : backward;
+
+					for (int n = 0; n < 6; n++)
+						chunk->indices.push_back(first + order[n]);
+
+					chunk->meshedQuads++;
+					i += w;
+				}
+			}
+		}
+	}
+}
+
+void VoxelWorld::Write(VoxelChunk* chunk, uint32_t slot)
+{
+	// The indices start at 0 in every slot, and the draw adds the
+	// first vertex of the slot, so 16-bit indices are enough, when
+	// that is the index type of the pool (the cube's index type)
+	const void* indices = chunk->indices.data();
+	std::vector<uint16_t> shortIndices;
+
+	if (pool->GetIndexType() == VK_INDEX_TYPE_UINT16)
+	{
+		shortIndices.assign(chunk->indices.begin(), chunk->indices.end());
+		indices = shortIndices.data();
+	}
+
+	chunk->pendingTicket = pool->Write(uploader, slots[slot],
+		chunk->vertices.data(), (uint32_t)chunk->vertices.size(),
+		indices, (uint32_t)chunk->indices.size());
+
+	chunk->pendingSlot = slot;
+	chunk->pendingQuads = chunk->meshedQuads;
+
+	// the mesh is in the staging ring now
+	chunk->vertices.clear();
+	chunk->indices.clear();
+}
+
+void VoxelWorld::MeshDirty(std::vector<VoxelChunk*>& meshing)
+{
+	// Every chunk is meshed by its own job. The jobs only read
+	// blocks, and only write the mesh of their own chunk, and
+	// no block changes until they are done, so nothing is locked
+	JobCounter counter;
+
+	for (VoxelChunk* chunk : meshing)
+		jobs->Run([this, chunk]() { Mesh(chunk); }, &counter);
+
+	jobs->Wait(&counter);
+}
+
+void VoxelWorld::Prepare(MeshPool* p, Uploader* u, JobSystem* j)
+{
+	pool = p;
+	uploader = u;
+	jobs = j;
+
+	uint32_t slotCount = GetRingChunkCount() + VOXEL_SPARE_SLOTS;
+	slots.resize(slotCount);
+
+	for (uint32_t s = 0; s < slotCount; s++)
+	{
+		slots[s] = pool->Reserve(VOXEL_SLOT_QUADS * 4, VOXEL_SLOT_QUADS * 6);
+		freeSlots.push_back(slotCount - 1 - s);
+	}
+
+	// While loading, every chunk of the ring is made at the same
+	// time, and the loading screen waits for all of them
+	int r = (params.streamRadius == 0) ? 0 : (int)params.streamRadius;
+	int minX = (params.streamRadius == 0) ? 0 : centerX - r;
+	int minZ = (params.streamRadius == 0) ? 0 : centerZ - r;
+	int maxX = (params.streamRadius == 0) ? (int)params.chunksX - 1 : centerX + r;
+	int maxZ = (params.streamRadius == 0) ? (int)params.chunksZ - 1 : centerZ + r;
+
+	std::vector<VoxelChunk*> meshing;
+
+	for (int cy = 0; cy < (int)params.chunksY; cy++)
+		for (int cz = minZ; cz <= maxZ; cz++)
+			for (int cx = minX; cx <= maxX; cx++)
+				meshing.push_back(Load(cx, cy, cz));
+
+	jobs->Wait(&loadCounter);
+
+	for (VoxelChunk* chunk : meshing)
+		chunk->ready = true;
+
+	// The copies are submitted with everything else that is
+	// loaded, and the graphics queue waits for them, so the
+	// meshes are drawn in the first frame, without their tickets
+	MeshDirty(meshing);
+
+	for (VoxelChunk* chunk : meshing)
+	{
+		if (chunk->meshedQuads > VOXEL_SLOT_QUADS)
+		{
+			printf("Voxel chunk %d %d %d has %u quads, the most is %u\n", chunk->x, chunk->y, chunk->z, chunk->meshedQuads, VOXEL_SLOT_QUADS);
+			chunk->vertices.clear();
+			chunk->indices.clear();
+			continue;
+		}
+
+		if (chunk->meshedQuads == 0)
+			continue;
+
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+
+		Write(chunk, slot);
+		chunk->slot = chunk->pendingSlot;
+		chunk->quadCount = chunk->pendingQuads;
+		chunk->pendingSlot = VOXEL_NO_SLOT;
+	}
+}
+
+void VoxelWorld::ReleaseSlot(VoxelChunk* chunk, uint64_t frame)
+{
+	if (chunk->slot != VOXEL_NO_SLOT)
+		retired.push_back({ chunk->slot, frame });
+
+	chunk->slot = VOXEL_NO_SLOT;
+	chunk->quadCount = 0;
+}
+
+void VoxelWorld::Stream(uint64_t frame)
+{
+	int r = (int)params.streamRadius;
+	uint32_t loads = 0;
+
+	// The ring is loaded from the middle out, one square around the
+	// center at a time, so the closest chunks are there first
+	for (int d = 0; d <= r; d++)
+	{
+		for (int cz = centerZ - d; cz <= centerZ + d; cz++)
+		{
+			for (int cx = centerX - d; cx <= centerX + d; cx++)
+			{
+				if (abs(cx - centerX) != d && abs(cz - centerZ) != d)
+					continue;
+
+				for (int cy = 0; cy < (int)params.chunksY; cy++)
+				{
+					VoxelChunk* chunk = GetChunk(cx, cy, cz);
+
+					if (chunk == nullptr && loads < VOXEL_LOADS_PER_FRAME)
+					{
+						chunk = Load(cx, cy, cz);
+						loads++;
+					}
+
+					if (chunk != nullptr)
+						chunk->lastUsed = frame;
+				}
+			}
+		}
+	}
+
+	// A chunk that left the ring is not drawn, so its slot goes
+	// to the chunks that came in. It keeps its blocks, and if
+	// it comes back, it only has to be meshed again
+	for (auto& it : chunks)
+	{
+		VoxelChunk* chunk = it.second;
+
+		if (chunk->slot != VOXEL_NO_SLOT && !InRing(chunk->x, chunk->y, chunk->z))
+		{
+			ReleaseSlot(chunk, frame);
+			chunk->dirty = true;
+		}
+	}
+
+	Evict();
+}
+
+void VoxelWorld::Evict()
+{
+	// The blocks of the chunks outside of the ring are a cache, with
+	// room for maxChunks chunks, in all. When it is full, the chunk that
+	// was in the ring the longest time ago is deleted. A chunk that is
+	// still loading, or copying a mesh, waits until it is done
+	while (chunks.size() > params.maxChunks)
+	{
+		auto oldest = chunks.end();
+
+		for (auto it = chunks.begin(); it != chunks.end(); ++it)
+		{
+			VoxelChunk* chunk = it->second;
+
+			if (!chunk->ready || chunk->slot != VOXEL_NO_SLOT || chunk->pendingSlot != VOXEL_NO_SLOT || InRing(chunk->x, chunk->y, chunk->z))
+				continue;
+
+			if (oldest == chunks.end() || chunk->lastUsed < oldest->second->lastUsed)
+				oldest = it;
+		}
+
+		if (oldest == chunks.end())
+			break;
+
+		delete oldest->second;
+		chunks.erase(oldest);
+	}
+}
+
+void VoxelWorld::Update(uint64_t frame, uint64_t completedFrames)
+{
+	// the slots that nothing draws anymore, once
+	// the last frame that drew them is done
+	for (size_t i = 0; i < retired.size();)
+	{
+		if (completedFrames < retired[i].retireFrame)
+		{
+			i++;
+			continue;
+		}
+
+		freeSlots.push_back(retired[i].slot);
+		retired[i] = retired.back();
+		retired.pop_back();
+	}
+
+	// A new mesh is drawn as soon as its copy is done, and the old
+	// slot is still read by the frames that are on the GPU now
+	for (auto& it : chunks)
+	{
+		VoxelChunk& chunk = *it.second;
+
+		if (chunk.pendingSlot == VOXEL_NO_SLOT || !uploader->IsComplete(chunk.pendingTicket))
+			continue;
+
+		ReleaseSlot(&chunk, frame);
+		chunk.slot = chunk.pendingSlot;
+		chunk.quadCount = chunk.pendingQuads;
+		chunk.pendingSlot = VOXEL_NO_SLOT;
+	}
+
+	// The chunks whose terrain is done can be read now. The chunks
+	// next to them showed the faces on that side, because a chunk
+	// that is not loaded is air, so they are meshed again too
+	for (auto& it : chunks)
+	{
+		VoxelChunk* chunk = it.second;
+
+		if (chunk->ready || !chunk->generated)
+			continue;
+
+		chunk->ready = true;
+		chunk->dirty = true;
+		MarkDirty(chunk->x - 1, chunk->y, chunk->z);
+		MarkDirty(chunk->x + 1, chunk->y, chunk->z);
+		MarkDirty(chunk->x, chunk->y - 1, chunk->z);
+		MarkDirty(chunk->x, chunk->y + 1, chunk->z);
+		MarkDirty(chunk->x, chunk->y, chunk->z - 1);
+		MarkDirty(chunk->x, chunk->y, chunk->z + 1);
+	}
+
+	if (params.streamRadius > 0)
+		Stream(frame);
+
+	// A chunk that is still copying its last mesh waits, and it
+	// stays dirty until then. So do the chunks that do not
+	// get a free slot, they are meshed in a later frame
+	std::vector<VoxelChunk*> meshing;
+
+	for (auto& it : chunks)
+	{
+		VoxelChunk* chunk = it.second;
+
+		if (chunk->ready && chunk->dirty && chunk->pendingSlot == VOXEL_NO_SLOT &&
+			InRing(chunk->x, chunk->y, chunk->z) && meshing.size() < freeSlots.size())
+		{
+			meshing.push_back(chunk);
+		}
+	}
+
+	if (meshing.empty())
+		return;
+
+	// The chunks closest to the center are written first, so when
+	// the upload budget runs out, the chunks that wait are far away
+	std::sort(meshing.begin(), meshing.end(), [this](VoxelChunk* a, VoxelChunk* b)
+	{
+		int da = (a->x - centerX) * (a->x - centerX) + (a->z - centerZ) * (a->z - centerZ);
+		int db = (b->x - centerX) * (b->x - centerX) + (b->z - centerZ) * (b->z - centerZ);
+		return da < db;
+	});
+
+	MeshDirty(meshing);
+
+	for (VoxelChunk* chunk : meshing)
+	{
+		// Not enough of the upload budget is left in this frame, so
+		// the mesh is thrown away, and the chunk is meshed again in a
+		// later frame. Meshing is cheap, next to a spike in the frame
+		VkDeviceSize bytes = chunk->vertices.size() * sizeof(VoxelVertex) + chunk->indices.size() * sizeof(uint32_t);
+
+		if (chunk->meshedQuads > 0 && chunk->meshedQuads <= VOXEL_SLOT_QUADS && !uploader->TakeBudget(bytes))
+		{
+			chunk->vertices.clear();
+			chunk->indices.clear();
+			continue;
+		}
+
+		chunk->dirty = false;
+
+		// the old mesh is drawn until the chunk is edited again
+		if (chunk->meshedQuads > VOXEL_SLOT_QUADS)
+		{
+			printf("Voxel chunk %d %d %d has %u quads, the most is %u\n", chunk->x, chunk->y, chunk->z, chunk->meshedQuads, VOXEL_SLOT_QUADS);
+			chunk->vertices.clear();
+			chunk->indices.clear();
+			continue;
+		}
+
+		// everything in the chunk was dug away
+		if (chunk->meshedQuads == 0)
+		{
+			ReleaseSlot(chunk, frame);
+			continue;
+		}
+
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		Write(chunk, slot);
+	}
+
+	uploader->Submit();
+}
+
+void VoxelWorld::Cull(const glm::mat4& vp, const glm::mat4& model, std::vector<VoxelDraw>* draws)
+{
+	draws->clear();
+
+	// The planes are in the space of the blocks, so each chunk
+	// is tested with the sphere around it, in blocks
+	glm::vec4 planes[6];
+	ExtractFrustumPlanes(vp * model, planes);
+
+	float half = VOXEL_CHUNK_SIZE * 0.5f;
+	float radius = half * 1.7320508f;
+
+	for (auto& it : chunks)
+	{
+		VoxelChunk& chunk = *it.second;
+
+		if (chunk.slot == VOXEL_NO_SLOT || !InRing(chunk.x, chunk.y, chunk.z))
+			continue;
+
+		glm::vec3 origin = glm::vec3((float)chunk.x, (float)chunk.y, (float)chunk.z) * (float)VOXEL_CHUNK_SIZE;
+		glm::vec3 center = origin + glm::vec3(half);
+		bool inside = true;
+
+		for (int p = 0; p < 6 && inside; p++)
+		{
+			if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius)
+				inside = false;
+		}
+
+		if (!inside)
+			continue;
+
+		const MeshRange& range = slots[chunk.slot];
+
+		VoxelDraw draw;
+		draw.mvp = vp * glm::translate(model, origin);
+		draw.firstIndex = range.firstIndex;
+		draw.indexCount = chunk.quadCount * 6;
+		draw.vertexOffset = (int32_t)range.firstVertex;
+		draws->push_back(draw);
+	}
+}
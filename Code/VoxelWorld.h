@@ -0,0 +1,226 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include "MeshPool.h"
+#include "JobSystem.h"
+
+// the blocks on each side of one chunk, and in the whole chunk
+#define VOXEL_CHUNK_SIZE 32
+#define VOXEL_CHUNK_BLOCKS (VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE)
+
+// The most quads that the mesh of one chunk can have. Each chunk gets
+// a slot of this size in the mesh pool, a chunk with more quads than
+// this (only a very noisy chunk) keeps the mesh that it had before
+#define VOXEL_SLOT_QUADS 2048
+
+// Slots that no chunk owns, a new mesh is copied into one of these
+// while the old mesh is still drawn, so the chunk never disappears
+#define VOXEL_SPARE_SLOTS 8
+
+// While streaming, at most this many chunks start loading in
+// one frame, so walking into new terrain does not cause a spike
+#define VOXEL_LOADS_PER_FRAME 8
+
+// a chunk that has no mesh in the pool
+#define VOXEL_NO_SLOT 0xFFFFFFFF
+
+// 0 is air, every other block is solid
+#define VOXEL_AIR 0
+
+// The size of the world in chunks, and the seed of its terrain (see
+// VoxelWorld.cpp). With streamRadius, the world has no end in x and
+// z, only the chunks that are up to streamRadius chunks away from
+// the center (SetCenter) are loaded and drawn, and chunksX and chunksZ
+// are not used. The chunks that leave that ring keep their blocks,
+// until more than maxChunks are loaded, then the ones that were
+// used least recently are unloaded
+struct VoxelParams
+{
+	uint32_t chunksX;
+	uint32_t chunksY;
+	uint32_t chunksZ;
+	uint32_t seed;
+	uint32_t streamRadius;
+	uint32_t maxChunks;
+};
+
+// The same layout as VertexStructure in Demo.cpp. The UV goes from
+// 0 to the size of the quad, in blocks, and the sampler repeats,
+// so a merged quad still shows the texture once on every block
+struct VoxelVertex
+{
+	float position[3];
+	float uv[2];
+};
+
+// one chunk that passed the frustum test, with the range
+// of its mesh in the pool, and the matrix that it is drawn with
+struct VoxelDraw
+{
+	glm::mat4 mvp;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t vertexOffset;
+};
+
+struct VoxelChunk
+{
+	// which chunk this is, and its blocks, x first, then z, then y
+	int x;
+	int y;
+	int z;
+	std::vector<uint8_t> blocks;
+
+	// The job that makes the terrain sets this when the blocks are
+	// done. Until Update sees it, and sets ready, nothing reads them
+	std::atomic<bool> generated;
+	bool ready;
+
+	// a block changed, so the mesh is old
+	bool dirty;
+
+	// the last frame that this chunk was in the ring
+	uint64_t lastUsed;
+
+	// the slot that is drawn, and how many quads it has
+	uint32_t slot;
+	uint32_t quadCount;
+
+	// the slot that a new mesh is being copied into,
+	// it is drawn when the ticket is complete
+	uint32_t pendingSlot;
+	uint32_t pendingQuads;
+	UploadTicket pendingTicket;
+
+	// what the meshing job wrote
+	std::vector<VoxelVertex> vertices;
+	std::vector<uint32_t> indices;
+	uint32_t meshedQuads;
+};
+
+// a slot that was drawn until retireFrame, it can only be
+// written again after the GPU has finished that frame
+struct RetiredVoxelSlot
+{
+	uint32_t slot;
+	uint64_t retireFrame;
+};
+
+// A world of blocks, in chunks of VOXEL_CHUNK_SIZE blocks on each side.
+// The mesh of a chunk only has the faces between a solid block and
+// air, and greedy meshing merges the faces next to each other into
+// rectangles, so a flat part of the terrain is a few quads, instead of
+// two triangles for every block. Every dirty chunk is meshed at the
+// same time, on the JobSystem, and only the chunks that were edited
+// are meshed again. The meshes are in the mesh pool, in slots that
+// were reserved when the world was made, so the same vertex buffer
+// and index buffer that draw the cubes also draw the world.
+// There is one slot for every chunk of the ring (and the spares), so
+// the GPU memory of the world has a fixed size, and a chunk that
+// leaves the ring gives its slot to the chunks that come in
+class VoxelWorld
+{
+private:
+	MeshPool* pool;
+	Uploader* uploader;
+	JobSystem* jobs;
+
+	// every chunk that is loaded (or loading), by ChunkKey
+	std::unordered_map<uint64_t, VoxelChunk*> chunks;
+	std::vector<MeshRange> slots;
+	std::vector<uint32_t> freeSlots;
+	std::vector<RetiredVoxelSlot> retired;
+
+	// the chunk that the center is in, and
+	// the counter of every job that makes terrain
+	int centerX;
+	int centerZ;
+	JobCounter loadCounter;
+
+	static uint64_t ChunkKey(int cx, int cy, int cz);
+	VoxelChunk* GetChunk(int cx, int cy, int cz);
+	bool InRing(int cx, int cy, int cz);
+	uint32_t GetRingChunkCount();
+	VoxelChunk* Load(int cx, int cy, int cz);
+	void Generate(VoxelChunk* chunk);
+	void MarkDirty(int cx, int cy, int cz);
+	void ReleaseSlot(VoxelChunk* chunk, uint64_t frame);
+	void Stream(uint64_t frame);
+	void Evict();
+	void Mesh(VoxelChunk* chunk);
+	void MeshDirty(std::vector<VoxelChunk*>& meshing);
+	void Write(VoxelChunk* chunk, uint32_t slot);
+
+public:
+	VoxelParams params;
+
+	VoxelWorld(VoxelParams p);
+
+	// waits for the chunks that are still loading
+	~VoxelWorld();
+
+	// The vertices and indices that every slot
+	// needs, for the size of the mesh pool
+	uint32_t GetVertexCapacity();
+	uint32_t GetIndexCapacity();
+
+	// Reserves the slots in the pool, and loads and meshes every
+	// chunk of the ring. The copies are in the uploader's batch, and
+	// they are submitted with the other copies of the loading screen
+	void Prepare(MeshPool* p, Uploader* u, JobSystem* j);
+
+	// Moves the ring while streaming, the position is in blocks
+	void SetCenter(glm::vec3 position);
+
+	// blocks outside of the world, or in a chunk
+	// that is not loaded yet, are air
+	uint8_t GetBlock(int x, int y, int z);
+
+	// Changes one block, its chunk is meshed again in the next
+	// Update, and the chunk next to it too, if the block is on
+	// the side of its chunk, because that face might have changed.
+	// A block in a chunk that is not loaded is not changed
+	void SetBlock(int x, int y, int z, uint8_t block);
+
+	// Draws the new meshes that finished copying, gives back the
+	// slots that the GPU is done with, loads the chunks that came
+	// into the ring, unloads the ones that were not used for the
+	// longest time, and meshes the dirty chunks
+	void Update(uint64_t frame, uint64_t completedFrames);
+
+	// the chunks that are in the frustum of vp, model puts
+	// the blocks of the world into the space of the scene
+	void Cull(const glm::mat4& vp, const glm::mat4& model, std::vector<VoxelDraw>* draws);
+
+	// the chunks that are loaded, and have their blocks in memory
+	uint32_t GetChunkCount();
+};
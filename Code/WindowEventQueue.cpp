@@ -0,0 +1,155 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#include "WindowEventQueue.h"
+
+WindowEventQueue::WindowEventQueue()
+{
+	head = 0;
+	tail = 0;
+	pendingResize = WINDOW_EVENT_NO_RESIZE;
+	sleeping = false;
+	woken = false;
+}
+
+bool WindowEventQueue::Push(WindowEvent event)
+{
+	uint32_t t = tail.load(std::memory_order_relaxed);
+
+	// if tail is a whole queue ahead of head, there is no room.
+	// The indices only count up, and wrap around by themselves
+	bool full = (t - head.load(std::memory_order_acquire) >= WINDOW_EVENT_QUEUE_SIZE);
+
+	if (full && event.type != WINDOW_EVENT_RESIZE)
+		return false;
+
+	if (full)
+	{
+		// only the newest size matters, so this replaces
+		// any resize that was waiting here before it
+		pendingResize.store(((uint64_t)event.a << 32) | event.b, std::memory_order_seq_cst);
+	}
+	else
+	{
+		events[t & (WINDOW_EVENT_QUEUE_SIZE - 1)] = event;
+
+		// A resize that is in the queue is newer than the one that
+		// is waiting, which would otherwise come out after it
+		if (event.type == WINDOW_EVENT_RESIZE)
+			pendingResize.store(WINDOW_EVENT_NO_RESIZE, std::memory_order_relaxed);
+
+		// The event is written before the other thread can see the new
+		// tail. This is seq_cst (not only release), together with the
+		// load of sleeping below, so that either Wait sees the new tail,
+		// or this sees that Wait is sleeping, they can not both miss
+		tail.store(t + 1, std::memory_order_seq_cst);
+	}
+
+	// Only when the render thread is sleeping in Wait, this wakes it up.
+	// Taking the lock makes sure that it is already sleeping (it holds
+	// the lock until it sleeps), so the notify can not come too early
+	if (sleeping.load(std::memory_order_seq_cst))
+	{
+		{
+			std::lock_guard<std::mutex> lock(waitMutex);
+		}
+		waitCondition.notify_one();
+	}
+
+	return !full;
+}
+
+bool WindowEventQueue::Pop(WindowEvent* event)
+{
+	uint32_t h = head.load(std::memory_order_relaxed);
+
+	// the resize that did not fit comes after everything in the queue
+	if (h == tail.load(std::memory_order_acquire))
+	{
+		uint64_t resize = pendingResize.exchange(WINDOW_EVENT_NO_RESIZE, std::memory_order_acquire);
+
+		if (resize == WINDOW_EVENT_NO_RESIZE)
+			return false;
+
+		event->type = WINDOW_EVENT_RESIZE;
+		event->a = (uint32_t)(resize >> 32);
+		event->b = (uint32_t)resize;
+		return true;
+	}
+
+	*event = events[h & (WINDOW_EVENT_QUEUE_SIZE - 1)];
+
+	// release: the event is read before the
+	// other thread can write over it
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
+
+bool WindowEventQueue::HasEvents()
+{
+	return head.load(std::memory_order_relaxed) != tail.load(std::memory_order_seq_cst) ||
+		pendingResize.load(std::memory_order_seq_cst) != WINDOW_EVENT_NO_RESIZE;
+}
+
+void WindowEventQueue::Wait()
+{
+	std::unique_lock<std::mutex> lock(waitMutex);
+
+	// Push only wakes us up after it sees this, and this is
+	// stored before the queue is checked for the first time
+	sleeping.store(true, std::memory_order_seq_cst);
+
+	// sleep until the queue is not empty, or until someone calls Wake
+	waitCondition.wait(lock, [this]()
+	{
+		return woken || HasEvents();
+	});
+
+	sleeping.store(false, std::memory_order_relaxed);
+	woken = false;
+}
+
+void WindowEventQueue::WaitFor(uint32_t milliseconds)
+{
+	std::unique_lock<std::mutex> lock(waitMutex);
+	sleeping.store(true, std::memory_order_seq_cst);
+
+	waitCondition.wait_for(lock, std::chrono::milliseconds(milliseconds), [this]()
+	{
+		return woken || HasEvents();
+	});
+
+	sleeping.store(false, std::memory_order_relaxed);
+	woken = false;
+}
+
+void WindowEventQueue::Wake()
+{
+	{
+		std::lock_guard<std::mutex> lock(waitMutex);
+		woken = true;
+	}
+	waitCondition.notify_one();
+}
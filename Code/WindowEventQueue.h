@@ -0,0 +1,113 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// the most events that can wait in the queue at once,
+// this must be a power of two
+#define WINDOW_EVENT_QUEUE_SIZE 256
+
+// pendingResize holds this when there is no resize waiting,
+// no window is 0xFFFFFFFF pixels wide
+#define WINDOW_EVENT_NO_RESIZE (~(uint64_t)0)
+
+enum WindowEventType
+{
+	WINDOW_EVENT_RESIZE,
+	WINDOW_EVENT_KEY_DOWN,
+	WINDOW_EVENT_KEY_UP,
+	WINDOW_EVENT_VISIBILITY,
+	WINDOW_EVENT_CLICK,
+	WINDOW_EVENT_SIZE_MOVE
+};
+
+// one message from the window, that the render thread needs.
+// For RESIZE, a and b are the width and height, for keys, a is the key,
+// for VISIBILITY, a is 1 when the window is shown and 0 when it is hidden,
+// for CLICK (the left mouse button), a and b are the pixel that was clicked,
+// for SIZE_MOVE, a is 1 when the user starts dragging the window (or its
+// edge), and 0 when they let go
+struct WindowEvent
+{
+	WindowEventType type;
+	uint32_t a;
+	uint32_t b;
+};
+
+// Sends events from the thread that owns the window (which pushes),
+// to the render thread (which pops). There is exactly one thread on
+// each side, so the queue does not need a lock, each side only
+// writes its own index, and reads the index of the other side
+class WindowEventQueue
+{
+private:
+	WindowEvent events[WINDOW_EVENT_QUEUE_SIZE];
+
+	// head is written by Pop, tail is written by Push
+	std::atomic<uint32_t> head;
+	std::atomic<uint32_t> tail;
+
+	// When the queue is full, a resize can not be dropped, the render
+	// thread needs the last size. It waits here instead (the width in
+	// the top half, the height in the bottom), and a newer one replaces
+	// it, and Pop gives it out after everything that was in the queue
+	std::atomic<uint64_t> pendingResize;
+
+	// Pushing and popping never lock. These are only used when the
+	// render thread has nothing to draw, and it sleeps in Wait until the
+	// window sends something. Push only takes the lock (to wake it up)
+	// when sleeping says that the render thread is in Wait or WaitFor
+	std::mutex waitMutex;
+	std::condition_variable waitCondition;
+	std::atomic<bool> sleeping;
+	bool woken;
+
+	// true if Pop would give out an event
+	bool HasEvents();
+
+public:
+	WindowEventQueue();
+
+	// Returns false if the queue is full, then the event is dropped.
+	// A resize is never dropped, it waits in pendingResize instead
+	bool Push(WindowEvent event);
+
+	// returns false if the queue is empty
+	bool Pop(WindowEvent* event);
+
+	// sleeps until there is an event to pop, or until Wake is called
+	void Wait();
+
+	// like Wait, but it stops sleeping after this many
+	// milliseconds, even if nothing happened
+	void WaitFor(uint32_t milliseconds);
+
+	// stops a Wait that is sleeping, even if there are no events
+	void Wake();
+};
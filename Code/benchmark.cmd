@@ -0,0 +1,96 @@
+rem Runs the benchmark with every scene and settings of the matrix below, and a replay of a
+rem recorded trace of it, and compares each of them with its own baseline.
+rem "benchmark.cmd record" records the trace with vktrace, which only has to be done again
+rem when the scene changes. "benchmark.cmd baseline" runs everything, and keeps the results
+rem as the baseline. "benchmark.cmd" runs everything, and says what got slower than the baseline.
+rem The baselines are in the Baselines folder next to this file, one for each run of the matrix,
+rem so they can be checked in, and every change is compared with the same numbers. They are only
+rem compared on the GPU that they were measured on, so make them on the machine that runs this.
+rem The replay sends the same Vulkan calls to the driver every time, without any of our
+rem CPU code, so when only the replay got slower, the GPU (or the driver) is the problem.
+rem Run it in the folder of vkcube.exe, like "..\..\benchmark.cmd", after a Release build
+@echo off
+setlocal
+
+set FRAMES=1000
+set TRACE=benchmark.vktrace
+set BASELINES=%~dp0Baselines
+set REPLAY_BASELINE=%BASELINES%\replay.txt
+rem in percent, like BENCHMARK_TOLERANCE in Demo.h
+set TOLERANCE=5
+set BIN=%~dp0..\Bin
+set VK_LAYER_PATH=%BIN%
+set MODE=%1
+
+if "%MODE%"=="record" goto record
+
+if not exist %TRACE% (
+	echo %TRACE% is missing, record it with "benchmark.cmd record"
+	exit /b 1
+)
+
+if not exist "%BASELINES%" mkdir "%BASELINES%"
+
+rem The matrix, each run is a name (of its baseline) and the options of the demo.
+rem "-candidate" is MSAA, render scale, frames in flight, present mode (1 is
+rem MAILBOX), and culling (0 none, 1 CPU, 2 GPU), like the runs of the auto tuner.
+rem The demo compares its own results with benchmark_baseline.json,
+rem and its exit code is 1 when something is slower
+set FAILED=0
+call :run grid ""
+call :run grid_msaa "-candidate 4 1.0 2 1 0"
+call :run grid_headless "-headless"
+call :run stress_none "-stress 10000 -candidate 1 1.0 2 1 0"
+call :run stress_cpu "-stress 10000 -candidate 1 1.0 2 1 1"
+call :run stress_gpu "-stress 10000 -candidate 1 1.0 2 1 2"
+
+rem vkreplay plays every frame of the trace, as fast as it can
+for /f %%t in ('powershell -NoProfile -Command "[int](Measure-Command { & '%BIN%\vkreplay.exe' -o %TRACE% | Out-Null }).TotalMilliseconds"') do set REPLAY_MS=%%t
+echo Replay: %REPLAY_MS% ms
+
+if "%MODE%"=="baseline" (
+	echo %REPLAY_MS%> "%REPLAY_BASELINE%"
+	echo The results are the new baseline
+	exit /b 0
+)
+
+if exist "%REPLAY_BASELINE%" (
+	set /p REPLAY_BEFORE=< "%REPLAY_BASELINE%"
+	call :compare_replay
+)
+
+if %FAILED%==1 (
+	echo Performance regression
+	exit /b 1
+)
+
+echo No performance regression
+exit /b 0
+
+rem The trace of the benchmark, which draws the same frames on every run
+:record
+"%BIN%\vktrace.exe" -p vkcube.exe -a "-benchmark %FRAMES% -novalidate" -w . -o %TRACE%
+exit /b
+
+rem One run of the matrix, with the baseline of its name. A baseline
+rem run has nothing to compare with, it only keeps the results
+:run
+echo Benchmark %1
+del benchmark_baseline.json 2> nul
+if not "%MODE%"=="baseline" if exist "%BASELINES%\%1.json" copy /y "%BASELINES%\%1.json" benchmark_baseline.json > nul
+vkcube.exe -benchmark %FRAMES% -novalidate %~2
+if errorlevel 1 (
+	echo %1: REGRESSION
+	set FAILED=1
+)
+if "%MODE%"=="baseline" copy /y benchmark.json "%BASELINES%\%1.json" > nul
+exit /b
+
+:compare_replay
+set /a REPLAY_LIMIT=REPLAY_BEFORE * (100 + TOLERANCE) / 100
+echo Baseline replay: %REPLAY_BEFORE% ms, now %REPLAY_MS% ms
+if %REPLAY_MS% GTR %REPLAY_LIMIT% (
+	echo Replay: REGRESSION
+	set FAILED=1
+)
+exit /b
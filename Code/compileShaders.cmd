@@ -1,11 +1,63 @@
-..\Bin\glslangValidator.exe -V cube.vert -o cube.vert.spv
-..\Bin\glslangValidator.exe -V cube.frag -o cube.frag.spv
-..\Bin\spirv-opt --strip-debug cube.vert.spv -o cube2.vert.spv
-..\Bin\spirv-opt --strip-debug cube.frag.spv -o cube2.frag.spv
-bin2hex --i cube2.vert.spv --o cube.vert.inc
-bin2hex --i cube2.frag.spv --o cube.frag.inc
-del cube.vert.spv
-del cube.frag.spv
-del cube2.vert.spv
-del cube2.frag.spv
-pause
\ No newline at end of file
+rem Compiles every shader to SPIR-V, optimizes it, and turns it into a .inc file.
+rem "compileShaders.cmd" uses the performance passes (-O), "compileShaders.cmd size"
+rem uses the size passes (-Os), and "compileShaders.cmd debug" only strips debug info.
+rem Both optimized profiles remove dead code and fold constants, and the
+rem instruction count of each shader is printed before and after spirv-opt
+@echo off
+setlocal
+
+set OPT_FLAGS=-O --strip-debug
+if "%1"=="size" set OPT_FLAGS=-Os --strip-debug
+if "%1"=="debug" set OPT_FLAGS=--strip-debug
+echo spirv-opt %OPT_FLAGS%
+
+call :compile cube vert cube2
+call :compile cube frag cube2
+call :compile cube_bindless frag cube2_bindless
+call :compile cube_array frag cube2_array
+call :compile cube_half frag cube2_half
+call :compile cube_push vert cube2_push
+call :compile cube_instanced vert cube2_instanced
+call :compile cube_instanced_push vert cube2_instanced_push
+call :compile cube_pull vert cube2_pull
+call :compile cube_animated vert cube2_animated
+call :compile cube_depth vert cube2_depth
+call :compile cube_depth_push vert cube2_depth_push
+call :compile cube_depth_instanced vert cube2_depth_instanced
+call :compile cube_depth_instanced_push vert cube2_depth_instanced_push
+call :compile cube_cull comp cube2_cull
+call :compile cube_cull_hiz comp cube2_cull_hiz
+call :compile cube_hiz comp cube2_hiz
+call :compile cube_temporal comp cube2_temporal
+call :compile cube_decompress comp cube2_decompress
+call :compile cube_compress comp cube2_compress
+call :compile particle_emit comp particle2_emit
+call :compile particle_simulate comp particle2_simulate
+call :compile mesh_skin comp mesh2_skin
+call :compile instance_scatter comp instance2_scatter
+call :compile object_pick frag object2_pick
+call :compile hud vert hud2
+call :compile hud frag hud2
+call :compile post vert post2
+call :compile post frag post2
+call :compile post_half frag post2_half
+
+pause
+exit /b
+
+rem %1 is the shader name, %2 is the stage, %3 is the name of the optimized file
+:compile
+..\Bin\glslangValidator.exe -V %1.%2 -o %1.%2.spv
+set OUT=%3.%2.spv
+..\Bin\spirv-opt %OPT_FLAGS% %1.%2.spv -o %OUT%
+
+rem spirv-dis writes one instruction per line, so
+rem counting the lines counts the instructions
+for /f %%c in ('..\Bin\spirv-dis --no-header %1.%2.spv ^| find /c /v ""') do set BEFORE=%%c
+for /f %%c in ('..\Bin\spirv-dis --no-header %OUT% ^| find /c /v ""') do set AFTER=%%c
+echo %1.%2: %BEFORE% instructions before, %AFTER% after
+
+bin2hex --i %OUT% --o %1.%2.inc
+del %1.%2.spv
+del %OUT%
+exit /b
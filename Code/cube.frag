@@ -26,10 +26,20 @@ that utilizes Vulkan, see more at http://cemu.info
 
 layout (binding = 1) uniform sampler2D samplerColor;
 
+// This is a specialization constant, prepare_pipeline gives it a
+// value when the pipeline is made (see ShaderConstants), and the driver
+// compiles the pipeline as if it was always that value, so the branch
+// that is not used is removed, and costs nothing
+layout (constant_id = 0) const bool TEXTURED = true;
+
 layout (location = 0) in vec2 uv;
 layout (location = 0) out vec4 outColor;
 
 void main() 
 {
-   outColor = texture(samplerColor, uv, 0);
+   // Without the texture, the UVs are drawn as colors
+   if (TEXTURED)
+      outColor = texture(samplerColor, uv, 0);
+   else
+      outColor = vec4(uv, 0.0, 1.0);
 }
\ No newline at end of file
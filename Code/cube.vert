@@ -33,6 +33,12 @@ layout (std140, binding = 0) uniform bufferVals {
 
 layout (location = 0) out vec2 outUV;
 
+// The depth pre-pass draws the same triangles with the depth-only
+// shader (cube_depth), and then this pass only draws the pixels with
+// the EQUAL depth. Invariant makes both shaders compute the exact same
+// position, the compiler can not optimize them differently
+invariant gl_Position;
+
 void main() 
 {	
 	outUV = inUV;
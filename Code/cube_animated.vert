@@ -0,0 +1,68 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec2 inUV;
+
+// this comes from the instance buffer, not the vertex buffer,
+// every cube (instance) has its own model matrix, which uses
+// locations 2 to 5, see prepare_instances in Demo.cpp
+layout (location = 2) in mat4 inInstance;
+
+// This comes from the animation buffer, which is also read once per
+// instance, and never changes. The cube spins around the axis in xyz,
+// w is how many radians it turns in a second
+layout (location = 6) in vec4 inAnimation;
+
+layout (std140, binding = 0) uniform bufferVals {
+    mat4 mvp;
+    // x is the time of this frame, in seconds
+    vec4 time;
+} myBufferVals;
+
+layout (location = 0) out vec2 outUV;
+
+// The depth pre-pass draws the same triangles with the depth-only
+// shader (cube_depth), and then this pass only draws the pixels with
+// the EQUAL depth. Invariant makes both shaders compute the exact same
+// position, the compiler can not optimize them differently
+invariant gl_Position;
+
+void main() 
+{	
+	// Rodrigues' rotation formula turns the position around the axis,
+	// by the angle that this cube has turned since the demo started.
+	// Nothing depends on the frame before, so the CPU only gives the time
+	vec3 axis = inAnimation.xyz;
+	float angle = myBufferVals.time.x * inAnimation.w;
+	float s = sin(angle);
+	float c = cos(angle);
+	vec3 p = inPos * c + cross(axis, inPos) * s + axis * (dot(axis, inPos) * (1.0 - c));
+
+	outUV = inUV;
+	gl_Position = myBufferVals.mvp * (inInstance * vec4(p, 1));
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#version 450
+
+// Every texture is in this one array, see prepare_descriptor_layout.
+// The size has to match BINDLESS_TEXTURE_COUNT in Demo.h
+layout (binding = 1) uniform sampler2D textures[1024];
+
+// The index of this cube's texture, it comes right after
+// the MVP matrix in the push constants (see record_draws)
+layout (push_constant) uniform PushConstants
+{
+	layout (offset = 64) uint textureIndex;
+} pc;
+
+// This is a specialization constant, prepare_pipeline gives it a
+// value when the pipeline is made (see ShaderConstants), and the driver
+// compiles the pipeline as if it was always that value, so the branch
+// that is not used is removed, and costs nothing
+layout (constant_id = 0) const bool TEXTURED = true;
+
+layout (location = 0) in vec2 uv;
+layout (location = 0) out vec4 outColor;
+
+void main() 
+{
+   // Without the texture, the UVs are drawn as colors
+   if (TEXTURED)
+      outColor = texture(textures[pc.textureIndex], uv, 0);
+   else
+      outColor = vec4(uv, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#version 450
+
+// The depth pre-pass only writes depth, so it only reads the
+// position, from its own vertex buffer that only has positions,
+// and there is no fragment shader, see prepare_depth_prepass
+
+layout (location = 0) in vec3 inPos;
+
+layout (std140, binding = 0) uniform bufferVals {
+    mat4 mvp;
+} myBufferVals;
+
+// This must be exactly the same position as the
+// main pass, see cube.vert
+invariant gl_Position;
+
+void main() 
+{	
+	gl_Position = myBufferVals.mvp * vec4(inPos, 1);
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#version 450
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+
+// The same as cube.frag, but the color is 16-bit (half precision)
+// after the texture is sampled, which needs shaderFloat16. A GPU with
+// double-rate FP16 does twice the math in the same time, and a 16-bit
+// value takes half of a register. The sampler still returns 32-bit
+// floats, and the output is 32-bit, so 16-bit storage is not needed
+layout (binding = 1) uniform sampler2D samplerColor;
+
+// see cube.frag
+layout (constant_id = 0) const bool TEXTURED = true;
+
+layout (location = 0) in vec2 uv;
+layout (location = 0) out vec4 outColor;
+
+void main() 
+{
+   f16vec4 color;
+
+   // Without the texture, the UVs are drawn as colors
+   if (TEXTURED)
+      color = f16vec4(texture(samplerColor, uv, 0));
+   else
+      color = f16vec4(f16vec2(uv), 0.0hf, 1.0hf);
+
+   outColor = vec4(color);
+}
@@ -0,0 +1,51 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec2 inUV;
+
+// this comes from the instance buffer, not the vertex buffer,
+// every cube (instance) has its own model matrix, which uses
+// locations 2 to 5, see prepare_instances in Demo.cpp
+layout (location = 2) in mat4 inInstance;
+
+layout (std140, binding = 0) uniform bufferVals {
+    mat4 mvp;
+} myBufferVals;
+
+layout (location = 0) out vec2 outUV;
+
+// The depth pre-pass draws the same triangles with the depth-only
+// shader (cube_depth), and then this pass only draws the pixels with
+// the EQUAL depth. Invariant makes both shaders compute the exact same
+// position, the compiler can not optimize them differently
+invariant gl_Position;
+
+void main() 
+{	
+	outUV = inUV;
+	gl_Position = myBufferVals.mvp * (inInstance * vec4(inPos, 1));
+}
\ No newline at end of file
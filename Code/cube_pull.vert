@@ -0,0 +1,77 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+// The vertices of the mesh pool, as 32-bit words. There is no vertex
+// input state, the shader finds its own vertex, and decodes it
+layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer VertexWords {
+    uint words[];
+};
+
+layout (std140, binding = 0) uniform bufferVals {
+    mat4 mvp;
+} myBufferVals;
+
+// the address of the vertex buffer, how many words each vertex
+// has, and which vertex format it is, see VertexPullConstants
+layout (push_constant) uniform PullVals {
+    VertexWords vertices;
+    uint vertexWords;
+    uint compact;
+} pull;
+
+layout (location = 0) out vec2 outUV;
+
+invariant gl_Position;
+
+void main() 
+{
+	// gl_VertexIndex already has the vertexOffset of the draw,
+	// so it is the vertex of the mesh in the whole pool
+	uint base = uint(gl_VertexIndex) * pull.vertexWords;
+	vec3 pos;
+	vec2 uv;
+
+	// see CompactVertexStructure, the position is four halfs
+	// (the last one is padding), and the UV is two 16-bit UNORMs
+	if (pull.compact != 0)
+	{
+		vec2 xy = unpackHalf2x16(pull.vertices.words[base]);
+		vec2 zw = unpackHalf2x16(pull.vertices.words[base + 1]);
+		pos = vec3(xy, zw.x);
+		uv = unpackUnorm2x16(pull.vertices.words[base + 2]);
+	}
+
+	// see VertexStructure, five floats
+	else
+	{
+		pos = uintBitsToFloat(uvec3(pull.vertices.words[base], pull.vertices.words[base + 1], pull.vertices.words[base + 2]));
+		uv = uintBitsToFloat(uvec2(pull.vertices.words[base + 3], pull.vertices.words[base + 4]));
+	}
+
+	outUV = uv;
+	gl_Position = myBufferVals.mvp * vec4(pos, 1);
+}
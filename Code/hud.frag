@@ -0,0 +1,53 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#version 450
+
+layout (location = 0) in vec2 cell;
+layout (location = 1) flat in uvec2 glyph;
+layout (location = 2) flat in vec4 glyphColor;
+
+layout (location = 0) out vec4 outColor;
+
+void main()
+{
+	// A letter is 5 by 7 pixels of the font, in a cell of 6 by 8,
+	// so there is space between the letters, and between the lines.
+	// Each column of the letter is one byte of glyph, the top row
+	// is the lowest bit, columns 0 to 3 are in x, and column 4 is in y
+	ivec2 p = ivec2(cell * vec2(6.0, 8.0));
+	uint bit = uint(p.x * 8 + p.y);
+
+	// the panel behind the text has the top bit set, it is solid
+	bool solid = (glyph.y & 0x80000000u) != 0u;
+	bool inside = p.x < 5 && p.y < 7;
+	uint word = (bit < 32u) ? glyph.x : glyph.y;
+	bool lit = ((word >> (bit & 31u)) & 1u) != 0u;
+
+	if (!(solid || (inside && lit)))
+		discard;
+
+	outColor = glyphColor;
+}
@@ -0,0 +1,53 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#version 450
+
+// One instance is one letter of the HUD, or the panel behind the
+// text (see HudOverlay.cpp). There is no vertex buffer for the quad,
+// the four corners of the strip come from the vertex index
+layout (location = 0) in vec4 rect;
+layout (location = 1) in uvec2 bits;
+layout (location = 2) in vec4 color;
+
+// where this pixel is inside of the letter's cell, from 0 to 1
+layout (location = 0) out vec2 cell;
+layout (location = 1) flat out uvec2 glyph;
+layout (location = 2) flat out vec4 glyphColor;
+
+void main()
+{
+	// 0 is the top left corner, 1 the top right,
+	// 2 the bottom left, and 3 the bottom right
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+
+	cell = corner;
+	glyph = bits;
+	glyphColor = color;
+
+	// rect is already in clip space, xy is the top left corner,
+	// and zw is the size
+	gl_Position = vec4(rect.xy + corner * rect.zw, 0.0, 1.0);
+}
@@ -0,0 +1,44 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#version 450
+
+// The object picker draws every object again, only in a tiny
+// rectangle around the mouse, and each pixel gets the ID of the
+// object that is closest there, instead of a color, see
+// ObjectPicker.cpp. The vertex shader is cube_depth_push.vert
+
+// the ID comes right after the matrix of the vertex shader
+layout (std140, push_constant) uniform PickVals {
+    layout (offset = 64) uint object;
+} pick;
+
+// the attachment is R32_UINT, so the output is a uint
+layout (location = 0) out uint outObject;
+
+void main() 
+{
+	outObject = pick.object;
+}
\ No newline at end of file
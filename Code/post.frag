@@ -0,0 +1,53 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#version 450
+
+// The color that the main subpass wrote, at this pixel. An input
+// attachment can only be read where the fragment is, so the GPU
+// can keep the whole image in its tile memory (see PostSubpass.h)
+layout (input_attachment_index = 0, binding = 0) uniform subpassInput sceneColor;
+
+layout (location = 0) out vec4 outColor;
+
+// it must match PostConstants in PostSubpass.h
+layout (std140, push_constant) uniform PostVals {
+    // rgb is multiplied into the color, w is the saturation
+    vec4 gain;
+    // rgb is added after the gain
+    vec4 lift;
+} post;
+
+void main()
+{
+	vec4 color = subpassLoad(sceneColor);
+
+	// the saturation moves the color away from (or towards)
+	// its own brightness, 0 is gray, and 1 changes nothing
+	float luma = dot(color.rgb, vec3(0.2126, 0.7152, 0.0722));
+	vec3 graded = mix(vec3(luma), color.rgb, post.gain.w);
+
+	outColor = vec4(graded * post.gain.rgb + post.lift.rgb, color.a);
+}
@@ -0,0 +1,52 @@
+/*
+Copyright 2019
+Original authors: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+<http://www.gnu.org/licenses/>.
+
+Special Thanks to Exzap from Team Cemu,
+he gave me advice on how to optimize Vulkan
+graphics, he is working on a Wii U emulator
+that utilizes Vulkan, see more at http://cemu.info
+*/
+
+
+#version 450
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+
+// The same as post.frag, but the grade is done with 16-bit floats,
+// which needs shaderFloat16. The input attachment, the push constants,
+// and the output stay 32-bit, so 16-bit storage is not needed
+layout (input_attachment_index = 0, binding = 0) uniform subpassInput sceneColor;
+
+layout (location = 0) out vec4 outColor;
+
+// it must match PostConstants in PostSubpass.h
+layout (std140, push_constant) uniform PostVals {
+    vec4 gain;
+    vec4 lift;
+} post;
+
+void main()
+{
+	f16vec4 color = f16vec4(subpassLoad(sceneColor));
+	f16vec4 gain = f16vec4(post.gain);
+	f16vec4 lift = f16vec4(post.lift);
+
+	float16_t luma = dot(color.rgb, f16vec3(0.2126hf, 0.7152hf, 0.0722hf));
+	f16vec3 graded = mix(f16vec3(luma), color.rgb, gain.w);
+
+	outColor = vec4(f16vec4(graded * gain.rgb + lift.rgb, color.a));
+}